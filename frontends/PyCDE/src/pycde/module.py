@@ -334,6 +334,9 @@ class _Generate:
     self.gen_func = gen_func
     self.modcls = None
     self.loc = get_user_loc()
+    # The modules already generated, keyed by the module name, which is
+    # derived from the parameters.
+    self.generated = {}
 
   def __call__(self, op):
     """Build an HWModuleOp and run the generator as the body builder."""
@@ -364,23 +367,30 @@ class _Generate:
     module_name = self.sanitize(module_name)
 
     # Track generated modules so we don't create unnecessary duplicates of
-    # modules that are structurally equivalent. If the module name exists in the
-    # top level MLIR module, assume that we've already generated it.
-    existing_module_names = [
-        o for o in mod.regions[0].blocks[0].operations
-        if mlir.ir.StringAttr(o.name).value == module_name
-    ]
-
-    if not existing_module_names:
-      with mlir.ir.InsertionPoint(mod.regions[0].blocks[0]), self.loc:
-        mod = ModuleDefinition(self.modcls,
-                               module_name,
-                               input_ports=self.modcls._input_ports,
-                               output_ports=self.modcls._output_ports,
-                               body_builder=self.gen_func)
+    # modules that are structurally equivalent. Instances with the same
+    # parameters reuse the module generated for the first one. Otherwise, if
+    # the module name exists in the top level MLIR module, assume that we've
+    # already generated it.
+    cached = self.generated.get(module_name)
+    if cached is not None and cached.operation.parent == mod:
+      mod = cached
     else:
-      assert (len(existing_module_names) == 1)
-      mod = existing_module_names[0]
+      existing_module_names = [
+          o for o in mod.regions[0].blocks[0].operations
+          if mlir.ir.StringAttr(o.name).value == module_name
+      ]
+
+      if not existing_module_names:
+        with mlir.ir.InsertionPoint(mod.regions[0].blocks[0]), self.loc:
+          mod = ModuleDefinition(self.modcls,
+                                 module_name,
+                                 input_ports=self.modcls._input_ports,
+                                 output_ports=self.modcls._output_ports,
+                                 body_builder=self.gen_func)
+      else:
+        assert (len(existing_module_names) == 1)
+        mod = existing_module_names[0]
+      self.generated[module_name] = mod
 
     # Build a replacement instance at the op to be replaced.
     op_names = [name for name, _ in self.modcls._input_ports]
@@ -11,6 +11,7 @@
 #ifndef CIRCT_C_DIALECT_COMB_H
 #define CIRCT_C_DIALECT_COMB_H
 
+#include "mlir-c/IR.h"
 #include "mlir-c/Registration.h"
 
 #ifdef __cplusplus
@@ -19,6 +20,22 @@ extern "C" {
 
 MLIR_DECLARE_CAPI_DIALECT_REGISTRATION(Combinational, comb);
 
+/// Create `numOps` operations named `opName`, e.g. "comb.add", which have
+/// `numOperands` operands each and one result of their first operand's type.
+/// The operands are indices into a list of values, which starts with the
+/// `numValues` given `values` and continues with the results of the created
+/// operations in order, so an operation can use the results of earlier ones.
+/// `operandIndices` holds the `numOperands` indices of each operation in
+/// turn. The operations are inserted at the end of `block`, before its
+/// terminator if it has one, and their results are stored in `results`.
+/// Returns false without creating any operation if the name is not registered
+/// or an index refers to a value that is not available yet.
+MLIR_CAPI_EXPORTED bool
+combCreateOps(MlirBlock block, MlirLocation loc, MlirStringRef opName,
+              intptr_t numOperands, intptr_t numValues, MlirValue const *values,
+              intptr_t numOps, intptr_t const *operandIndices,
+              MlirValue *results);
+
 #ifdef __cplusplus
 }
 #endif
@@ -104,6 +104,22 @@ MLIR_CAPI_EXPORTED MlirStringRef hwTypeAliasTypeGetName(MlirType typeAlias);
 
 MLIR_CAPI_EXPORTED MlirStringRef hwTypeAliasTypeGetScope(MlirType typeAlias);
 
+//===----------------------------------------------------------------------===//
+// Operation API.
+//===----------------------------------------------------------------------===//
+
+/// Create `numInstances` instances of the HW module or external module
+/// `module`, named `instanceNames`. `inputs` holds the inputs of each
+/// instance in turn, as many per instance as the module has. The instances
+/// are inserted at the end of `block`, before its terminator if it has one,
+/// and stored in `instances`.
+MLIR_CAPI_EXPORTED void hwCreateInstances(MlirBlock block, MlirLocation loc,
+                                          MlirOperation module,
+                                          intptr_t numInstances,
+                                          MlirStringRef const *instanceNames,
+                                          MlirValue const *inputs,
+                                          MlirOperation *instances);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,10 +15,24 @@ extern "C" {
 #endif
 
 /// Emits verilog for the specified module using the provided callback and user
-/// data
+/// data.  The output is buffered, the callback receives chunks of up to 64KiB.
 MlirLogicalResult mlirExportVerilog(MlirModule, MlirStringCallback,
                                     void *userData);
 
+/// Emits verilog for the specified module like `mlirExportVerilog`, handing
+/// the output to the callback in chunks of up to `chunkSize` bytes.
+MlirLogicalResult mlirExportVerilogWithChunkSize(MlirModule, size_t chunkSize,
+                                                 MlirStringCallback,
+                                                 void *userData);
+
+/// Emits verilog for the specified module into the file at `path`, which is
+/// created or overwritten. Fails if the file cannot be opened.
+MlirLogicalResult mlirExportVerilogToFile(MlirModule, MlirStringRef path);
+
+/// Emits verilog for the specified module as one file per module in the
+/// directory `dirname`, along with a `filelist.f` listing the files.
+MlirLogicalResult mlirExportSplitVerilog(MlirModule, MlirStringRef dirname);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,102 @@
+//===-- circt-c/Firtool.h - C API for the firtool pipeline --------*- C -*-===//
+//
+// This header declares the C interface for compiling FIRRTL in process with
+// the pipeline of firtool, without the cost of starting a tool and reparsing
+// its textual output on every compile.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_C_FIRTOOL_H
+#define CIRCT_C_FIRTOOL_H
+
+#include "mlir-c/IR.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The formats of the input.
+typedef enum CirctFirtoolInputFormat {
+  CirctFirtoolInputFIR,
+  CirctFirtoolInputMLIR,
+  CirctFirtoolInputFIRBytecode,
+} CirctFirtoolInputFormat;
+
+/// The formats of the output.
+typedef enum CirctFirtoolOutputFormat {
+  CirctFirtoolOutputMLIR,
+  CirctFirtoolOutputFIRBytecode,
+  CirctFirtoolOutputVerilog,
+  CirctFirtoolOutputSplitVerilog,
+  CirctFirtoolOutputDisabled,
+} CirctFirtoolOutputFormat;
+
+/// The options of a compilation, which default to the ones of the firtool
+/// command line.  Owned by the caller, and may be used for any number of
+/// compilations.
+typedef struct CirctFirtoolOptions {
+  void *ptr;
+} CirctFirtoolOptions;
+
+MLIR_CAPI_EXPORTED CirctFirtoolOptions circtFirtoolOptionsCreateDefault(void);
+MLIR_CAPI_EXPORTED void circtFirtoolOptionsDestroy(CirctFirtoolOptions);
+
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetOutputFormat(CirctFirtoolOptions,
+                                   CirctFirtoolOutputFormat format);
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetDisableOptimization(CirctFirtoolOptions, bool value);
+MLIR_CAPI_EXPORTED void circtFirtoolOptionsSetLowerToHW(CirctFirtoolOptions,
+                                                        bool value);
+MLIR_CAPI_EXPORTED void circtFirtoolOptionsSetDedup(CirctFirtoolOptions,
+                                                    bool value);
+MLIR_CAPI_EXPORTED void circtFirtoolOptionsSetInline(CirctFirtoolOptions,
+                                                     bool value);
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetPreserveAggregate(CirctFirtoolOptions, bool value);
+
+/// Set the directory the paths of the black box annotations are relative to.
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetBlackBoxRootPath(CirctFirtoolOptions,
+                                       MlirStringRef path);
+
+/// Set the lowering options of the emitter, in the syntax of the
+/// `-lowering-options` flag.
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetLoweringOptions(CirctFirtoolOptions,
+                                      MlirStringRef options);
+
+/// Set the directory split Verilog is written to.  It is created if needed.
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetOutputDirectory(CirctFirtoolOptions,
+                                      MlirStringRef directory);
+
+/// Time the phases and passes of each compilation, and hand the report to
+/// `callback` once it is done.  A null callback disables the timing.
+MLIR_CAPI_EXPORTED void
+circtFirtoolOptionsSetTimingCallback(CirctFirtoolOptions,
+                                     MlirStringCallback callback,
+                                     void *userData);
+
+/// Compile `input` in the given format with the firtool pipeline, and hand
+/// the output to `callback` in chunks.  `annotations` is the contents of an
+/// annotation file, or empty.  The dialects of the pipeline are loaded into
+/// `context`, and diagnostics are reported through its handlers.
+MLIR_CAPI_EXPORTED MlirLogicalResult circtFirtoolCompile(
+    MlirContext context, MlirStringRef input, MlirStringRef annotations,
+    CirctFirtoolInputFormat format, CirctFirtoolOptions options,
+    MlirStringCallback callback, void *userData);
+
+/// Compile `input` like `circtFirtoolCompile`, but return the module the
+/// pipeline produced instead of emitting it, or a null module on failure.
+/// Split Verilog is still written to the output directory, and the returned
+/// module keeps the bodies of its modules.
+MLIR_CAPI_EXPORTED MlirModule circtFirtoolCompileToModule(
+    MlirContext context, MlirStringRef input, MlirStringRef annotations,
+    CirctFirtoolInputFormat format, CirctFirtoolOptions options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIRCT_C_FIRTOOL_H
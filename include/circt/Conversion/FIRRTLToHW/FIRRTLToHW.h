@@ -24,7 +24,8 @@ class Pass;
 namespace circt {
 
 std::unique_ptr<mlir::Pass>
-createLowerFIRRTLToHWPass(llvm::Optional<bool> enableAnnotationWarning = false);
+createLowerFIRRTLToHWPass(llvm::Optional<bool> enableAnnotationWarning = false,
+                          bool groupDebugStatements = false);
 
 } // namespace circt
 
@@ -27,10 +27,20 @@ namespace circt {
 void populateLLHDToLLVMConversionPatterns(mlir::LLVMTypeConverter &converter,
                                           RewritePatternSet &patterns,
                                           size_t &sigCounter,
-                                          size_t &regCounter);
-
-/// Create an LLHD to LLVM conversion pass.
-std::unique_ptr<OperationPass<ModuleOp>> createConvertLLHDToLLVMPass();
+                                          size_t &regCounter,
+                                          bool inlineDrives = false);
+
+/// Create an LLHD to LLVM conversion pass. If `inlineDrives` is set, the
+/// drives of narrow integers are appended to the drive buffer of the
+/// simulation thread by the lowered code, only calling into the runtime when
+/// the buffer is full. If `staticLayout` is set, the instances and signals of
+/// the design are emitted as constant tables, which the init function maps to
+/// the state with a single runtime call. If `arena` is set, the init function
+/// carves the states and signal values of all instances out of a single
+/// allocation, rather than calling malloc for each.
+std::unique_ptr<OperationPass<ModuleOp>>
+createConvertLLHDToLLVMPass(bool inlineDrives = false,
+                            bool staticLayout = false, bool arena = false);
 
 } // namespace circt
 
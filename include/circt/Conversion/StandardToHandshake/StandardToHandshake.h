@@ -43,6 +43,9 @@ createHandshakeRemoveBlockPass();
 std::unique_ptr<mlir::OperationPass<handshake::FuncOp>>
 createHandshakeInsertBufferPass();
 
+std::unique_ptr<mlir::OperationPass<handshake::FuncOp>>
+createHandshakeOptimizePass();
+
 } // namespace circt
 
 #endif // MLIR_CONVERSION_STANDARDTOHANDSHAKE_H_
@@ -21,7 +21,10 @@
 namespace circt {
 namespace calyx {
 
+std::unique_ptr<mlir::Pass> createCompileControlPass();
 std::unique_ptr<mlir::Pass> createGoInsertionPass();
+std::unique_ptr<mlir::Pass> createInferStaticTimingPass();
+std::unique_ptr<mlir::Pass> createResourceSharingPass();
 
 /// Generate the code for registering passes.
 #define GEN_PASS_REGISTRATION
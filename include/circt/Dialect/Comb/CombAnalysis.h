@@ -0,0 +1,74 @@
+//===- CombAnalysis.h - Analyses of Comb operations -------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares bit-level analyses of the values computed by Comb
+// operations.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_COMB_COMBANALYSIS_H
+#define CIRCT_DIALECT_COMB_COMBANALYSIS_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Value.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/KnownBits.h"
+
+namespace circt {
+namespace comb {
+
+/// This computes which bits of integer values are known to be zero or one, and
+/// which bits of integer values are actually used.  Known bits are computed by
+/// looking through the Comb operations and constants defining a value, and
+/// demanded bits by looking through the Comb operations using it, both up to a
+/// fixed depth.  Anything else is conservatively treated as unknown or fully
+/// demanded.
+///
+/// The results are cached, so querying many values of the same subgraph is
+/// cheap.  The cache must be cleared when the IR it was computed from changes.
+class BitAnalysis {
+public:
+  /// Return the bits of an integer value known to be zero or one.
+  llvm::KnownBits getKnownBits(Value value) {
+    return computeKnownBits(value, 0);
+  }
+
+  /// Return the mask of the bits of an integer value which may affect the
+  /// users of the value.  Bits which are never looked at are cleared.
+  APInt getDemandedBits(Value value) { return computeDemandedBits(value, 0); }
+
+  /// Forget all cached results.
+  void clear() {
+    knownBits.clear();
+    demandedBits.clear();
+  }
+
+private:
+  llvm::KnownBits computeKnownBits(Value value, unsigned depth);
+  llvm::KnownBits computeKnownBitsOfOp(Operation *op, unsigned width,
+                                       unsigned depth);
+  APInt computeDemandedBits(Value value, unsigned depth);
+  APInt computeDemandedBitsOfUse(OpOperand &use, unsigned width,
+                                 unsigned depth);
+
+  DenseMap<Value, llvm::KnownBits> knownBits;
+  DenseMap<Value, APInt> demandedBits;
+};
+
+/// Return the bits of an integer value known to be zero or one.  This is a
+/// shorthand for a query on a fresh `BitAnalysis`.
+llvm::KnownBits computeKnownBits(Value value);
+
+/// Return the mask of the bits of an integer value which may affect its users.
+/// This is a shorthand for a query on a fresh `BitAnalysis`.
+APInt computeDemandedBits(Value value);
+
+} // namespace comb
+} // namespace circt
+
+#endif // CIRCT_DIALECT_COMB_COMBANALYSIS_H
@@ -118,3 +118,154 @@ module ESI_PipelineStage # (
     end
   end
 endmodule
+
+/// ESI_FIFO: a queue of up to DEPTH tokens, for buffers too deep to build out
+/// of pipeline stages economically. The tokens are kept in a memory with a
+/// registered read, which synthesis can map to block RAM, instead of two
+/// registers per stage. Adds one cycle of latency. Neither a_ready nor x_valid
+/// depend combinationally on the other side of the queue.
+module ESI_FIFO # (
+  int WIDTH = 8,
+  int DEPTH = 16
+) (
+  input logic clk,
+  input logic rstn,
+
+  // Input LI channel.
+  input logic a_valid,
+  input logic [WIDTH-1:0] a,
+  output logic a_ready,
+
+  // Output LI channel.
+  output logic x_valid,
+  output logic [WIDTH-1:0] x,
+  input logic x_ready
+);
+
+  localparam int PTR_WIDTH = DEPTH > 1 ? $clog2(DEPTH) : 1;
+
+  logic [WIDTH-1:0] mem [DEPTH];
+  logic [PTR_WIDTH-1:0] wr_ptr, rd_ptr, rd_ptr_next;
+  // The number of tokens in the queue, including the one at the output.
+  logic [PTR_WIDTH:0] count;
+
+  assign a_ready = count < DEPTH;
+  assign x_valid = count != 0;
+
+  // Did we accept a token this cycle?
+  wire a_rcv = a_valid && a_ready;
+  // We are transmitting a token on this cycle.
+  wire xmit = x_valid && x_ready;
+
+  function automatic logic [PTR_WIDTH-1:0] incr(logic [PTR_WIDTH-1:0] ptr);
+    return ptr == PTR_WIDTH'(DEPTH - 1) ? '0 : ptr + 1'b1;
+  endfunction
+
+  assign rd_ptr_next = xmit ? incr(rd_ptr) : rd_ptr;
+
+  always_ff @(posedge clk)
+    if (a_rcv)
+      mem[wr_ptr] <= a;
+
+  // Read the next head of the queue on every cycle so that the output is
+  // registered. A token written to the next head on the same cycle (the queue
+  // being empty after this cycle otherwise) isn't in the memory yet, so
+  // forward it.
+  always_ff @(posedge clk)
+    x <= (a_rcv && wr_ptr == rd_ptr_next) ? a : mem[rd_ptr_next];
+
+  always_ff @(posedge clk) begin
+    if (~rstn) begin
+      wr_ptr <= '0;
+      rd_ptr <= '0;
+      count <= '0;
+    end else begin
+      if (a_rcv)
+        wr_ptr <= incr(wr_ptr);
+      rd_ptr <= rd_ptr_next;
+      count <= count + a_rcv - xmit;
+    end
+  end
+endmodule
+
+/// ESI_ShiftRegister: an elastic buffer spanning DEPTH cycles like a chain of
+/// DEPTH pipeline stages, for long routes on FPGAs. The registers along the
+/// route carry no backpressure: the tokens, and the credits the output returns,
+/// go through plain shift registers, whose data has neither a reset nor an
+/// enable so that synthesis can map them to shift register LUTs. A single
+/// counter at the input holds the credits, the free slots of the queue at the
+/// output. The queue is a shift register too, read at its occupancy, and holds
+/// the tokens of a whole credit round trip so that the buffer can pass a token
+/// per cycle. Adds DEPTH + 1 cycles of latency. Neither a_ready nor x_valid
+/// depend combinationally on the other side of the buffer.
+module ESI_ShiftRegister # (
+  int WIDTH = 8,
+  int DEPTH = 4
+) (
+  input logic clk,
+  input logic rstn,
+
+  // Input LI channel.
+  input logic a_valid,
+  input logic [WIDTH-1:0] a,
+  output logic a_ready,
+
+  // Output LI channel.
+  output logic x_valid,
+  output logic [WIDTH-1:0] x,
+  input logic x_ready
+);
+
+  // A credit takes DEPTH cycles to reach the queue with its token, at least
+  // one in the queue, DEPTH to come back and one to be counted.
+  localparam int CREDITS = 2 * DEPTH + 2;
+  localparam int COUNT_WIDTH = $clog2(CREDITS + 1);
+
+  // The free slots of the queue, less the tokens on their way to it.
+  logic [COUNT_WIDTH-1:0] credits;
+  assign a_ready = credits != 0;
+
+  // Did we accept a token this cycle?
+  wire a_rcv = a_valid && a_ready;
+
+  // The route to the queue, and the route of the credits back.
+  logic [WIDTH-1:0] data_sr [DEPTH];
+  logic [DEPTH-1:0] valid_sr;
+  logic [DEPTH-1:0] credit_sr;
+  wire arrive = valid_sr[DEPTH-1];
+
+  // The queue at the output, the oldest token being at index count - 1.
+  logic [WIDTH-1:0] queue [CREDITS];
+  logic [COUNT_WIDTH-1:0] count;
+  assign x_valid = count != 0;
+  assign x = queue[count - 1'b1];
+
+  // We are transmitting a token on this cycle.
+  wire xmit = x_valid && x_ready;
+
+  always_ff @(posedge clk) begin
+    data_sr[0] <= a;
+    for (int i = 1; i < DEPTH; ++i)
+      data_sr[i] <= data_sr[i - 1];
+    if (arrive) begin
+      queue[0] <= data_sr[DEPTH - 1];
+      for (int i = 1; i < CREDITS; ++i)
+        queue[i] <= queue[i - 1];
+    end
+  end
+
+  // Only the single bit valids and credits along the route are reset.
+  always_ff @(posedge clk) begin
+    if (~rstn) begin
+      valid_sr <= '0;
+      credit_sr <= '0;
+      credits <= COUNT_WIDTH'(CREDITS);
+      count <= '0;
+    end else begin
+      valid_sr <= DEPTH'({valid_sr, a_rcv});
+      credit_sr <= DEPTH'({credit_sr, xmit});
+      credits <= credits - a_rcv + credit_sr[DEPTH - 1];
+      count <= count + arrive - xmit;
+    end
+  end
+endmodule
@@ -74,4 +74,35 @@ import "DPI-C" sv2cCosimserverEpTryGet =
     inout  int unsigned data_size
     );
 
+// Attempt to send several messages to a client in one call, so that the DPI
+// crossing is paid once per batch.
+// - return 0 on success, negative on failure (unregistered EP, full queue).
+import "DPI-C" sv2cCosimserverEpTryPutBatch =
+  function int cosim_ep_tryput_batch(
+    // The ID of the endpoint to which the data should be sent.
+    input int unsigned endpoint_id,
+    // The messages, in consecutive slots of msg_size bytes.
+    input byte unsigned data[],
+    // The size of each message.
+    input int msg_size,
+    // The number of messages to send.
+    input int num_msgs
+    );
+
+// Attempt to recieve several messages from a client in one call.
+//   - Returns negative when call failed (e.g. EP not registered).
+//   - The messages are put into consecutive slots of msg_size bytes.
+import "DPI-C" sv2cCosimserverEpTryGetBatch =
+  function int cosim_ep_tryget_batch(
+    // The ID of the endpoint from which data should be recieved.
+    input  int unsigned endpoint_id,
+    // The buffer in which to put the messages.
+    inout byte unsigned data[],
+    // The size of each message slot.
+    input  int unsigned msg_size,
+    // Input: the maximum number of messages to get.
+    // Output: the number of messages recieved, 0 if there was none.
+    inout  int unsigned num_msgs
+    );
+
 endpackage // Cosim_DpiPkg
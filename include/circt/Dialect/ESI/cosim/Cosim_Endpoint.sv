@@ -20,7 +20,11 @@ module Cosim_Endpoint
   parameter longint RECV_TYPE_ID = -1,
   parameter int RECV_TYPE_SIZE_BITS = -1,
   parameter longint SEND_TYPE_ID = -1,
-  parameter int SEND_TYPE_SIZE_BITS = -1
+  parameter int SEND_TYPE_SIZE_BITS = -1,
+  // The number of messages moved per DPI call. With more than one, messages
+  // to the client are gathered and sent together when the batch is full or
+  // when DataInValid drops, so they are delayed by at most BATCH_SIZE cycles.
+  parameter int BATCH_SIZE = 1
 )
 (
   input  logic clk,
@@ -65,38 +69,83 @@ module Cosim_Endpoint
       = RECV_TYPE_SIZE_BYTES_FLOOR * 8;
 
   byte unsigned DataOutBuffer[RECV_TYPE_SIZE_BYTES-1:0];
-  always @(posedge clk) begin
-    if (rstn && Initialized) begin
-      if (DataOutValid && DataOutReady) // A transfer occurred.
+  generate
+  if (BATCH_SIZE == 1) begin
+    always @(posedge clk) begin
+      if (rstn && Initialized) begin
+        if (DataOutValid && DataOutReady) // A transfer occurred.
+          DataOutValid <= 1'b0;
+
+        if (!DataOutValid || DataOutReady) begin
+          int data_limit;
+          int rc;
+
+          data_limit = RECV_TYPE_SIZE_BYTES;
+          rc = cosim_ep_tryget(ENDPOINT_ID, DataOutBuffer, data_limit);
+          if (rc < 0) begin
+            $error("cosim_ep_tryget(%d, *, %d -> %d) returned an error (%d)",
+              ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit, rc);
+          end else if (rc > 0) begin
+            $error("cosim_ep_tryget(%d, *, %d -> %d) had data left over! (%d)",
+              ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit, rc);
+          end else if (rc == 0) begin
+            if (data_limit == RECV_TYPE_SIZE_BYTES)
+              DataOutValid <= 1'b1;
+            else if (data_limit == 0)
+              begin end // No message.
+            else
+              $error(
+                "cosim_ep_tryget(%d, *, %d -> %d) did not load entire buffer!",
+                ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit);
+          end
+        end
+      end else begin
         DataOutValid <= 1'b0;
-
-      if (!DataOutValid || DataOutReady) begin
-        int data_limit;
-        int rc;
-
-        data_limit = RECV_TYPE_SIZE_BYTES;
-        rc = cosim_ep_tryget(ENDPOINT_ID, DataOutBuffer, data_limit);
-        if (rc < 0) begin
-          $error("cosim_ep_tryget(%d, *, %d -> %d) returned an error (%d)",
-            ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit, rc);
-        end else if (rc > 0) begin
-          $error("cosim_ep_tryget(%d, *, %d -> %d) had data left over! (%d)",
-            ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit, rc);
-        end else if (rc == 0) begin
-          if (data_limit == RECV_TYPE_SIZE_BYTES)
+      end
+    end
+  end else begin
+    // Messages fetched by the last batched call, handed out one per cycle.
+    byte unsigned DataOutBatch[RECV_TYPE_SIZE_BYTES*BATCH_SIZE-1:0];
+    int unsigned DataOutCount;
+    int unsigned DataOutNext;
+
+    always @(posedge clk) begin
+      if (rstn && Initialized) begin
+        if (DataOutValid && DataOutReady) // A transfer occurred.
+          DataOutValid <= 1'b0;
+
+        if (!DataOutValid || DataOutReady) begin
+          if (DataOutNext == DataOutCount) begin
+            int unsigned num_msgs;
+            int rc;
+
+            num_msgs = BATCH_SIZE;
+            rc = cosim_ep_tryget_batch(ENDPOINT_ID, DataOutBatch,
+                                       RECV_TYPE_SIZE_BYTES, num_msgs);
+            if (rc != 0) begin
+              $error("cosim_ep_tryget_batch(%d, *, %d, %d) error (%d)",
+                     ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, BATCH_SIZE, rc);
+              num_msgs = 0;
+            end
+            DataOutCount = num_msgs;
+            DataOutNext = 0;
+          end
+          if (DataOutNext < DataOutCount) begin
+            for (int i = 0; i < RECV_TYPE_SIZE_BYTES; i++)
+              DataOutBuffer[i] =
+                DataOutBatch[DataOutNext*RECV_TYPE_SIZE_BYTES + i];
+            DataOutNext++;
             DataOutValid <= 1'b1;
-          else if (data_limit == 0)
-            begin end // No message.
-          else
-            $error(
-              "cosim_ep_tryget(%d, *, %d -> %d) did not load entire buffer!",
-              ENDPOINT_ID, RECV_TYPE_SIZE_BYTES, data_limit);
+          end
         end
+      end else begin
+        DataOutValid <= 1'b0;
+        DataOutCount = 0;
+        DataOutNext = 0;
       end
-    end else begin
-      DataOutValid <= 1'b0;
     end
   end
+  endgenerate
 
   // Assign packed output bit array from unpacked byte array.
   genvar iOut;
@@ -136,17 +185,49 @@ module Cosim_Endpoint
   assign DataInReady = 1'b1;
   byte unsigned DataInBuffer[SEND_TYPE_SIZE_BYTES-1:0];
 
-  always@(posedge clk) begin
-    if (rstn && Initialized) begin
-      if (DataInValid) begin
-        int rc;
-        rc = cosim_ep_tryput(ENDPOINT_ID, DataInBuffer, SEND_TYPE_SIZE_BYTES);
-        if (rc != 0)
-          $error("cosim_ep_tryput(%d, *, %d) = %d Error! (Data lost)",
-            ENDPOINT_ID, SEND_TYPE_SIZE_BYTES, rc);
+  generate
+  if (BATCH_SIZE == 1) begin
+    always@(posedge clk) begin
+      if (rstn && Initialized) begin
+        if (DataInValid) begin
+          int rc;
+          rc = cosim_ep_tryput(ENDPOINT_ID, DataInBuffer, SEND_TYPE_SIZE_BYTES);
+          if (rc != 0)
+            $error("cosim_ep_tryput(%d, *, %d) = %d Error! (Data lost)",
+              ENDPOINT_ID, SEND_TYPE_SIZE_BYTES, rc);
+        end
+      end
+    end
+  end else begin
+    // Messages gathered for the next batched call.
+    byte unsigned DataInBatch[SEND_TYPE_SIZE_BYTES*BATCH_SIZE-1:0];
+    int DataInCount;
+
+    always@(posedge clk) begin
+      if (rstn && Initialized) begin
+        if (DataInValid) begin
+          for (int i = 0; i < SEND_TYPE_SIZE_BYTES; i++)
+            DataInBatch[DataInCount*SEND_TYPE_SIZE_BYTES + i] =
+              DataInBuffer[i];
+          DataInCount++;
+        end
+        // Flush when the batch is full or the input went idle.
+        if (DataInCount == BATCH_SIZE || (!DataInValid && DataInCount > 0))
+        begin
+          int rc;
+          rc = cosim_ep_tryput_batch(ENDPOINT_ID, DataInBatch,
+                                     SEND_TYPE_SIZE_BYTES, DataInCount);
+          if (rc != 0)
+            $error("cosim_ep_tryput_batch(%d, *, %d, %d) = %d (Data lost)",
+                   ENDPOINT_ID, SEND_TYPE_SIZE_BYTES, DataInCount, rc);
+          DataInCount = 0;
+        end
+      end else begin
+        DataInCount = 0;
       end
     end
   end
+  endgenerate
 
   // Assign packed input bit array to unpacked byte array.
   genvar iIn;
@@ -13,18 +13,76 @@
 #ifndef CIRCT_DIALECT_ESI_COSIM_ENDPOINT_H
 #define CIRCT_DIALECT_ESI_COSIM_ENDPOINT_H
 
+#include <array>
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <vector>
 
 namespace circt {
 namespace esi {
 namespace cosim {
 
+/// A bounded queue for exactly one producer thread and one consumer thread,
+/// which needs no lock. Each index is only written by one side: the producer
+/// publishes an element by advancing `tail` with release semantics, the
+/// consumer frees its slot by advancing `head`. The indices increase
+/// monotonically and are wrapped into the ring of `Capacity` slots, which
+/// must be a power of two.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+  static_assert(Capacity && (Capacity & (Capacity - 1)) == 0,
+                "the capacity must be a power of two");
+
+public:
+  /// Append a value. Return false if the queue is full. Producer only.
+  bool push(T value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots[t & (Capacity - 1)] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Remove the oldest value. Return false if the queue is empty. Consumer
+  /// only.
+  bool pop(T &value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    // Polling an empty queue, the common case, costs a single relaxed load.
+    if (h == tail.load(std::memory_order_relaxed))
+      return false;
+    // Synchronize with the push which published the element.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    value = std::move(slots[h & (Capacity - 1)]);
+    slots[h & (Capacity - 1)] = T();
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Return the oldest value without removing it, or null if the queue is
+  /// empty. Consumer only.
+  T *front() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return nullptr;
+    return &slots[h & (Capacity - 1)];
+  }
+
+private:
+  std::array<T, Capacity> slots;
+  /// The indices are on separate cache lines, so that the two threads don't
+  /// contend for them.
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
 /// Implements a bi-directional, thread-safe bridge between the RPC server and
-/// DPI functions.
+/// DPI functions. Each direction is a lock-free queue, written by one side and
+/// read by the other: a single RPC server thread serves each endpoint, and the
+/// simulator runs on a single thread.
 ///
 /// Several of the methods below are inline with the declaration to make them
 /// candidates for inlining during compilation. This is particularly important
@@ -54,61 +112,113 @@ public:
   bool setInUse();
   void returnForUse();
 
-  /// Queue message to the simulation.
-  void pushMessageToSim(BlobPtr msg) {
-    Lock g(m);
-    toCosim.push(msg);
+  /// The number of messages each direction can hold.
+  static constexpr size_t queueCapacity = 1024;
+
+  /// Get a zeroed blob of `size` bytes for a message to the simulation,
+  /// reusing the storage of a message the simulation consumed. Called by the
+  /// RPC server only.
+  BlobPtr allocMessageToSim(size_t size) { return toCosimPool.alloc(size); }
+  /// Hand back a message the simulation is done with. Called by the simulator
+  /// only.
+  void freeMessageToSim(BlobPtr msg) { toCosimPool.free(std::move(msg)); }
+
+  /// Get a zeroed blob of `size` bytes for a message to the RPC client.
+  /// Called by the simulator only.
+  BlobPtr allocMessageToClient(size_t size) {
+    return toClientPool.alloc(size);
   }
+  /// Hand back a message the RPC client is done with. Called by the RPC
+  /// server only.
+  void freeMessageToClient(BlobPtr msg) { toClientPool.free(std::move(msg)); }
+
+  /// Queue message to the simulation. Return false if the queue is full.
+  bool pushMessageToSim(BlobPtr msg) { return toCosim.push(std::move(msg)); }
 
   /// Pop from the to-simulator queue. Return true if there was a message in the
   /// queue.
-  bool getMessageToSim(BlobPtr &msg) {
-    Lock g(m);
-    if (toCosim.empty())
-      return false;
-    msg = toCosim.front();
-    toCosim.pop();
-    return true;
-  }
+  bool getMessageToSim(BlobPtr &msg) { return toCosim.pop(msg); }
 
-  /// Queue message to the RPC client.
-  void pushMessageToClient(BlobPtr msg) {
-    Lock g(m);
-    toClient.push(msg);
+  /// Queue message to the RPC client. Return false if the queue is full.
+  bool pushMessageToClient(BlobPtr msg) {
+    return toClient.push(std::move(msg));
   }
 
   /// Pop from the to-RPC-client queue. Return true if there was a message in
   /// the queue.
-  bool getMessageToClient(BlobPtr &msg) {
-    Lock g(m);
-    if (toClient.empty())
-      return false;
-    msg = toClient.front();
-    toClient.pop();
-    return true;
-  }
+  bool getMessageToClient(BlobPtr &msg) { return toClient.pop(msg); }
+
+  /// Return the oldest message in the to-RPC-client queue without removing
+  /// it, or null if there is none.
+  BlobPtr *peekMessageToClient() { return toClient.front(); }
+
+  /// The sizes of the SV arrays the simulator passes to receive and to send
+  /// messages, once their layout was validated, or -1. The arrays of an
+  /// endpoint always come from the same call sites, so they only need to be
+  /// checked on the first call. Only used by the simulator.
+  int simRecvArraySize = -1;
+  int simSendArraySize = -1;
+
+  /// The number of times the simulator polled for a message to the
+  /// simulation, which it does on every cycle it can take one. Transaction
+  /// logs use it as the cycle stamp of the messages. Only used by the
+  /// simulator.
+  uint64_t simPolls = 0;
 
 private:
+  /// Recycles the blobs of one direction. The producer of the messages
+  /// allocates them and the consumer frees them, handing them back through
+  /// a queue in the other direction, so that the steady state allocates no
+  /// memory.
+  class BlobPool {
+  public:
+    BlobPtr alloc(size_t size) {
+      BlobPtr blob;
+      if (!freed.pop(blob))
+        blob = std::make_shared<Blob>();
+      blob->assign(size, 0);
+      return blob;
+    }
+
+    void free(BlobPtr blob) {
+      // A blob still referenced elsewhere can't be reused, and the pool
+      // drops the blobs it has no room for.
+      if (blob.use_count() == 1)
+        freed.push(std::move(blob));
+    }
+
+  private:
+    SPSCQueue<BlobPtr, queueCapacity> freed;
+  };
+
   const uint64_t sendTypeId;
   const uint64_t recvTypeId;
   bool inUse;
 
   using Lock = std::lock_guard<std::mutex>;
 
-  /// This class needs to be thread-safe. All of the mutable member variables
-  /// are protected with this object-wide lock. This may be a performance issue
-  /// in the future.
+  /// Protects the inUse flag. The message queues need no lock.
   std::mutex m;
   /// Message queue from RPC client to the simulation.
-  std::queue<BlobPtr> toCosim;
+  SPSCQueue<BlobPtr, queueCapacity> toCosim;
   /// Message queue to RPC client from the simulation.
-  std::queue<BlobPtr> toClient;
+  SPSCQueue<BlobPtr, queueCapacity> toClient;
+  /// The storage of the messages in each direction.
+  BlobPool toCosimPool;
+  BlobPool toClientPool;
 };
 
 /// The Endpoint registry is where Endpoints report their existence (register)
 /// and they are looked up by RPC clients.
+///
+/// Endpoints register once, when the simulation starts, but are looked up on
+/// every poll. The lookups of the IDs below `denseIdLimit` thus take no lock:
+/// they go through an immutable table indexed by ID, which registration
+/// replaces with an extended copy.
 class EndpointRegistry {
 public:
+  EndpointRegistry();
+
   /// Register an Endpoint. Creates the Endpoint object and owns it. Returns
   /// false if unsuccessful.
   bool registerEndpoint(int epId, uint64_t sendTypeId, int sendTypeMaxSize,
@@ -119,6 +229,10 @@ public:
   /// is important here since this method is used in the polling call from the
   /// simulator. Returns nullptr if the endpoint cannot be found.
   Endpoint *operator[](int epId) {
+    if (epId >= 0 && epId < denseIdLimit) {
+      const auto *table = dense.load(std::memory_order_acquire);
+      return (size_t)epId < table->size() ? (*table)[epId] : nullptr;
+    }
     Lock g(m);
     auto it = endpoints.find(epId);
     if (it == endpoints.end())
@@ -135,11 +249,20 @@ public:
 private:
   using Lock = std::lock_guard<std::mutex>;
 
-  /// This object needs to be thread-safe. An object-wide mutex is sufficient.
+  /// The IDs which are looked up without a lock.
+  static constexpr int denseIdLimit = 1 << 16;
+
+  /// Protects the endpoint map and the registration. The lookups through the
+  /// dense table need no lock.
   std::mutex m;
 
   /// Endpoint ID to object pointer mapping.
   std::map<int, Endpoint> endpoints;
+
+  /// The endpoints indexed by ID, nullptr where there is none. Readers may
+  /// still use a table after it was replaced, so all of them are kept alive.
+  std::atomic<const std::vector<Endpoint *> *> dense;
+  std::vector<std::unique_ptr<std::vector<Endpoint *>>> denseTables;
 };
 
 } // namespace cosim
@@ -17,16 +17,26 @@
 #define CIRCT_DIALECT_ESI_COSIM_SERVER_H
 
 #include "circt/Dialect/ESI/cosim/Endpoint.h"
+#include <string>
 #include <thread>
 
 namespace circt {
 namespace esi {
 namespace cosim {
+namespace shm {
+struct Region;
+} // namespace shm
 
 /// The main RpcServer. Does not implement any capnp RPC interfaces but contains
 /// the capnp main RPC server. We run the capnp server in its own thread to be
 /// more responsive to network traffic and so as to not slow down the
 /// simulation.
+///
+/// The endpoints can be partitioned over several server threads, each with its
+/// own event loop listening on its own port, so that a slow client or a large
+/// message only stalls the endpoints of one thread. Thread `i` of `n` serves
+/// the endpoints whose ID is `i` modulo `n`, which keeps a single RPC thread
+/// per endpoint queue.
 class RpcServer {
 public:
   EndpointRegistry endpoints;
@@ -34,16 +44,51 @@ public:
   RpcServer();
   ~RpcServer();
 
-  /// Start and stop the server thread.
-  void run(uint16_t port);
+  /// Start and stop the server threads. With a non-zero `port`, thread `i`
+  /// listens on `port + i`.
+  void run(uint16_t port, unsigned numThreads = 1);
+  void stop();
+
+private:
+  using Lock = std::lock_guard<std::mutex>;
+
+  /// The main loop function of thread `thread` of `numThreads`. Exits on
+  /// shutdown.
+  void mainLoop(uint16_t port, unsigned thread, unsigned numThreads);
+  /// Record the port a thread listens on, and write them all to cosim.cfg
+  /// once they are all known.
+  void publishPort(unsigned thread, uint16_t port);
+
+  std::vector<std::thread> threads;
+  /// The ports of the threads, or zero while unknown.
+  std::vector<uint16_t> ports;
+  unsigned numPortsKnown;
+  volatile bool stopSig;
+  std::mutex m;
+  std::mutex portsMutex;
+};
+
+/// Serves the endpoints of a registry to clients on the same machine, through
+/// rings in a memory mapped file (see ShmTransport.h), instead of over TCP. A
+/// thread moves the messages between the rings and the endpoint queues,
+/// taking the place of the RPC server, so the two can't run at the same time.
+class ShmServer {
+public:
+  ShmServer(EndpointRegistry &endpoints);
+  ~ShmServer();
+
+  /// Create the file at `path`, and start and stop the server thread.
+  bool run(const std::string &path);
   void stop();
 
 private:
   using Lock = std::lock_guard<std::mutex>;
 
   /// The thread's main loop function. Exits on shutdown.
-  void mainLoop(uint16_t port);
+  void mainLoop();
 
+  EndpointRegistry &endpoints;
+  shm::Region *region;
   std::thread *mainThread;
   volatile bool stopSig;
   std::mutex m;
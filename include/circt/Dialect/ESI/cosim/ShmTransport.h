@@ -0,0 +1,124 @@
+//===- ShmTransport.h - ESI cosim shared memory layout ----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The layout of the memory mapped file through which clients on the same
+// machine talk to the cosim endpoints, bypassing the RPC server. The messages
+// in the rings are capnp messages in the standard flat serialization (segment
+// table followed by the segments), so clients can use `messageToFlatArray` and
+// `FlatArrayMessageReader`. This header has no dependencies so that host
+// software can include it directly.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_ESI_COSIM_SHMTRANSPORT_H
+#define CIRCT_DIALECT_ESI_COSIM_SHMTRANSPORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace circt {
+namespace esi {
+namespace cosim {
+namespace shm {
+
+/// "COSIMSHM", set once the region is initialized.
+constexpr uint64_t regionMagic = 0x4d4853494d534f43ULL;
+constexpr uint32_t regionVersion = 1;
+/// The number of endpoint slots in the region.
+constexpr uint32_t maxEndpoints = 64;
+/// The size of each ring, in 64-bit words. Must be a power of two.
+constexpr size_t ringWords = 1 << 13;
+
+/// A ring of word-sized messages, written by one process and read by another.
+/// Each message is a word holding its length in words followed by the
+/// message. As in `SPSCQueue`, each index is only written by one side and
+/// increases monotonically.
+struct Ring {
+  static_assert((ringWords & (ringWords - 1)) == 0,
+                "the ring size must be a power of two");
+
+  /// Append a message of `size` words. Return false if there isn't room for
+  /// it. Producer only.
+  bool write(const uint64_t *msg, size_t size) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (t + 1 + size - head.load(std::memory_order_acquire) > ringWords)
+      return false;
+    data[t % ringWords] = size;
+    copyIn(t + 1, msg, size);
+    tail.store(t + 1 + size, std::memory_order_release);
+    return true;
+  }
+
+  /// Remove the oldest message and put it in `msg`. Return false if the ring
+  /// is empty. Consumer only.
+  bool read(std::vector<uint64_t> &msg) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+    msg.resize(data[h % ringWords]);
+    copyOut(h + 1, msg.data(), msg.size());
+    head.store(h + 1 + msg.size(), std::memory_order_release);
+    return true;
+  }
+
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) uint64_t data[ringWords];
+
+private:
+  /// Copy words to and from the ring, starting at index `at` and wrapping
+  /// around its end.
+  void copyIn(uint64_t at, const uint64_t *src, size_t size) {
+    size_t start = at % ringWords;
+    size_t first = std::min(size, ringWords - start);
+    memcpy(&data[start], src, first * sizeof(uint64_t));
+    memcpy(&data[0], src + first, (size - first) * sizeof(uint64_t));
+  }
+  void copyOut(uint64_t at, uint64_t *dst, size_t size) const {
+    size_t start = at % ringWords;
+    size_t first = std::min(size, ringWords - start);
+    memcpy(dst, &data[start], first * sizeof(uint64_t));
+    memcpy(dst + first, &data[0], (size - first) * sizeof(uint64_t));
+  }
+};
+
+/// One endpoint, published by the simulation when it registers.
+struct EndpointSlot {
+  /// Non-zero once the fields below are valid.
+  std::atomic<uint32_t> valid;
+  /// Set by the client which opened the endpoint, with a compare-and-swap
+  /// from 0, and cleared when it closes it.
+  std::atomic<uint32_t> open;
+  int32_t endpointId;
+  uint64_t sendTypeId;
+  uint64_t recvTypeId;
+  /// Messages to the simulation, written by the client.
+  Ring toSim;
+  /// Messages to the client, written by the simulation.
+  Ring toClient;
+};
+
+/// The whole mapped file. It starts zeroed; `magic` is set last.
+struct Region {
+  std::atomic<uint64_t> magic;
+  uint32_t version;
+  /// The number of valid slots, which are filled in order.
+  std::atomic<uint32_t> numEndpoints;
+  EndpointSlot endpoints[maxEndpoints];
+};
+
+} // namespace shm
+} // namespace cosim
+} // namespace esi
+} // namespace circt
+
+#endif
@@ -0,0 +1,122 @@
+//===- TransactionLog.h - Cosim transaction record and replay ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Record the messages the cosim endpoints exchange with the host to a file,
+// and replay such a file to the simulation in place of the host.
+//
+// The file starts with the 8 byte magic number and the 4 byte version below,
+// followed by one record per message, with little endian integers:
+//   - the endpoint ID, 4 bytes;
+//   - the direction, 1 byte: 0 to the simulation, 1 to the host;
+//   - the cycle stamp and the size of the message, ULEB128 encoded;
+//   - the message.
+// The cycle stamp of a message is the number of times the simulation had
+// polled its endpoint (see `Endpoint::simPolls`).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_ESI_COSIM_TRANSACTIONLOG_H
+#define CIRCT_DIALECT_ESI_COSIM_TRANSACTIONLOG_H
+
+#include "circt/Dialect/ESI/cosim/Endpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace circt {
+namespace esi {
+namespace cosim {
+
+/// "COSIMLOG", at the start of the file.
+constexpr uint64_t transactionLogMagic = 0x474f4c4d49534f43ULL;
+constexpr uint32_t transactionLogVersion = 1;
+
+/// Appends the messages of the endpoints to a transaction log. Only used by
+/// the simulator thread, so it needs no lock.
+class TransactionRecorder {
+public:
+  ~TransactionRecorder();
+
+  /// Create the file at `path`. Return false if it cannot be created.
+  bool open(const std::string &path);
+
+  /// Append a message of endpoint `epId`, stamped with `cycle`.
+  void record(int epId, bool toHost, uint64_t cycle,
+              const Endpoint::Blob &msg);
+
+private:
+  void writeULEB128(uint64_t value);
+
+  FILE *file = nullptr;
+};
+
+/// Plays the host of a transaction log: the messages recorded to the
+/// simulation are queued on the endpoints at their cycle stamps, and the
+/// messages from the simulation are compared to the recorded ones. Only used
+/// by the simulator thread, which thus is on both sides of the endpoint
+/// queues.
+class TransactionReplayer {
+public:
+  /// Read the file at `path`. Return false if it cannot be read or is not a
+  /// transaction log.
+  bool load(const std::string &path);
+
+  /// Queue the messages to the simulation due by the current cycle stamp of
+  /// endpoint `epId` on `ep`. Called on every poll, hence inline.
+  void feed(int epId, Endpoint &ep) {
+    auto it = streams.find(epId);
+    if (it == streams.end())
+      return;
+    Stream &stream = it->second;
+    while (stream.nextToSim < stream.toSim.size()) {
+      const Message &msg = stream.toSim[stream.nextToSim];
+      if (msg.cycle > ep.simPolls)
+        return;
+      Endpoint::BlobPtr blob = ep.allocMessageToSim(msg.data.size());
+      memcpy(blob->data(), msg.data.data(), msg.data.size());
+      // A full queue takes the rest on a later poll.
+      if (!ep.pushMessageToSim(std::move(blob)))
+        return;
+      ++stream.nextToSim;
+    }
+  }
+
+  /// Compare a message from the simulation on endpoint `epId` to the next
+  /// one recorded.
+  void check(int epId, const Endpoint::Blob &msg);
+
+  /// Print how many messages were replayed and how many differed from the
+  /// log. Return true if the simulation sent exactly the recorded messages.
+  bool report();
+
+private:
+  struct Message {
+    uint64_t cycle;
+    Endpoint::Blob data;
+  };
+
+  /// The recorded messages of one endpoint, in each direction.
+  struct Stream {
+    std::vector<Message> toSim;
+    std::vector<Message> toHost;
+    size_t nextToSim = 0;
+    size_t nextToHost = 0;
+  };
+
+  std::unordered_map<int, Stream> streams;
+  /// The messages from the simulation which differ from the log, or which
+  /// were not recorded at all.
+  size_t mismatches = 0;
+};
+
+} // namespace cosim
+} // namespace esi
+} // namespace circt
+
+#endif
@@ -39,6 +39,18 @@ extern int sv2cCosimserverEpTryGet(unsigned int endpointId,
 extern int sv2cCosimserverEpTryPut(unsigned int endpointId,
                                    // NOLINTNEXTLINE(misc-misplaced-const)
                                    const svOpenArrayHandle data, int dataLimit);
+/// Try to get several messages, of at most `msgSize` bytes each, from a
+/// client.
+extern int sv2cCosimserverEpTryGetBatch(unsigned int endpointId,
+                                        // NOLINTNEXTLINE(misc-misplaced-const)
+                                        const svOpenArrayHandle data,
+                                        unsigned int msgSize,
+                                        unsigned int *numMsgs);
+/// Send several messages of `msgSize` bytes each to a client.
+extern int sv2cCosimserverEpTryPutBatch(unsigned int endpointId,
+                                        // NOLINTNEXTLINE(misc-misplaced-const)
+                                        const svOpenArrayHandle data,
+                                        int msgSize, int numMsgs);
 
 /// Start the server. Not required as the first endpoint registration will do
 /// this. Provided if one wants to start the server early.
@@ -0,0 +1,102 @@
+//===- AnnotationIndex.h - Circuit-wide annotation index --------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the FIRRTL AnnotationIndex, an analysis which finds all the
+// operations and ports in a circuit carrying an annotation of a given class.
+//
+//===----------------------------------------------------------------------===//
+#ifndef CIRCT_DIALECT_FIRRTL_ANNOTATIONINDEX_H
+#define CIRCT_DIALECT_FIRRTL_ANNOTATIONINDEX_H
+
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Support/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+
+namespace circt {
+namespace firrtl {
+
+/// This is something that an annotation is attached to: either an operation,
+/// or one of the ports of a module or external module.
+struct AnnotationTarget {
+  /// The port number used for annotations on the operation itself.
+  static constexpr unsigned noPort = ~0U;
+
+  AnnotationTarget(Operation *op, unsigned portNo = noPort)
+      : op(op), portNo(portNo) {}
+
+  /// Return true if this annotation is on a port of the operation.
+  bool isPort() const { return portNo != noPort; }
+
+  /// Return the annotations on this target.
+  AnnotationSet getAnnotations() const;
+
+  bool operator==(const AnnotationTarget &other) const {
+    return op == other.op && portNo == other.portNo;
+  }
+
+  Operation *op;
+  unsigned portNo;
+};
+
+/// This analysis indexes every annotation in a circuit by its class, so that
+/// passes looking for a few specific annotations don't need to walk every
+/// operation in the circuit.  The index is built from the annotations present
+/// when the analysis is constructed, walking the modules in parallel.  Passes
+/// which add or remove annotations can keep the index up to date with `update`
+/// and `erase`, or let it be invalidated.
+class AnnotationIndex {
+public:
+  explicit AnnotationIndex(Operation *operation);
+
+  /// Return the targets carrying an annotation with the specified class, in
+  /// the order they were indexed.  A target appears once for each matching
+  /// annotation it carries.
+  ArrayRef<AnnotationTarget> lookup(StringRef className) const;
+
+  /// Return true if any operation or port carries the specified class.
+  bool hasAnnotation(StringRef className) const {
+    return !lookup(className).empty();
+  }
+
+  /// Return the distinct operations carrying any of the specified classes,
+  /// either on themselves or on one of their ports.
+  void getOperations(ArrayRef<StringRef> classNames,
+                     SmallVectorImpl<Operation *> &results) const;
+
+  /// Re-index the annotations of an operation and its ports after they have
+  /// been changed.
+  void update(Operation *op);
+
+  /// Remove an operation from the index, e.g. before it is erased.
+  void erase(Operation *op);
+
+private:
+  /// An annotation class, and the target carrying an annotation of it.
+  using Entry = std::pair<StringRef, AnnotationTarget>;
+
+  /// Collect the annotation classes of an operation and its ports.
+  static void gather(Operation *op, SmallVectorImpl<Entry> &entries);
+
+  /// Add gathered annotation classes to the index.
+  void insert(ArrayRef<Entry> entries);
+
+  /// Add the annotations of an operation and its ports to the index.
+  void index(Operation *op);
+
+  /// The targets of each annotation class.
+  llvm::StringMap<SmallVector<AnnotationTarget, 1>> classTargets;
+
+  /// The classes each indexed operation has been recorded under.  This is
+  /// used to find the entries to update when an operation changes.
+  DenseMap<Operation *, SmallVector<StringRef, 2>> opClasses;
+};
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_ANNOTATIONINDEX_H
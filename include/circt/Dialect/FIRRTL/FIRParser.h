@@ -14,13 +14,19 @@
 #ifndef CIRCT_DIALECT_FIRRTL_FIRPARSER_H
 #define CIRCT_DIALECT_FIRRTL_FIRPARSER_H
 
+#include "mlir/Support/LogicalResult.h"
+#include <functional>
+
 namespace llvm {
 class SourceMgr;
 }
 
 namespace mlir {
+class Location;
 class MLIRContext;
+class Operation;
 class OwningModuleRef;
+class TimingScope;
 } // namespace mlir
 
 namespace circt {
@@ -30,11 +36,33 @@ struct FIRParserOptions {
   /// If this is set to true, the @info locators are ignored, and the locations
   /// are set to the location in the .fir file.
   bool ignoreInfoLocators = false;
+
+  /// If this is set to true, the @info locators are not decoded while parsing.
+  /// Instead, they are recorded as opaque locations pointing into the source
+  /// buffer, which must outlive the IR until materializeInfoLocators is run.
+  bool lazyInfoLocators = false;
+
+  /// If set, this is invoked on each module (an FModuleOp) as soon as its body
+  /// has been parsed, which allows module-local cleanups to overlap with the
+  /// parsing of other modules.  Module bodies are parsed in parallel, so this
+  /// may be called concurrently on different modules.  Returning failure
+  /// aborts the parse.
+  std::function<mlir::LogicalResult(mlir::Operation *)> moduleBodyCallback;
 };
 
+/// Parse the main buffer of the source manager as a .fir file.  If a timing
+/// scope is provided, the phases of the parser are timed as nested scopes.
 mlir::OwningModuleRef importFIRRTL(llvm::SourceMgr &sourceMgr,
                                    mlir::MLIRContext *context,
-                                   FIRParserOptions options = {});
+                                   FIRParserOptions options = {},
+                                   mlir::TimingScope *ts = nullptr);
+
+/// Decode a lazy @info locator produced by the parser into a real location.
+/// Any other location is returned unmodified.
+mlir::Location materializeInfoLocator(mlir::Location loc);
+
+/// Decode the lazy @info locators of all operations nested under `root`.
+void materializeInfoLocators(mlir::Operation *root);
 
 void registerFromFIRRTLTranslation();
 
@@ -0,0 +1,50 @@
+//===- FIRRTLBytecode.h - Binary serialization of FIRRTL IR -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the interface to the compact binary format used to pass FIRRTL
+// circuits between tools without going through textual MLIR.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_FIRRTL_FIRRTLBYTECODE_H
+#define CIRCT_DIALECT_FIRRTL_FIRRTLBYTECODE_H
+
+#include "circt/Support/LLVM.h"
+
+namespace llvm {
+class SourceMgr;
+} // namespace llvm
+
+namespace mlir {
+class MLIRContext;
+class Operation;
+class OwningModuleRef;
+} // namespace mlir
+
+namespace circt {
+namespace firrtl {
+
+/// Return true if the specified buffer starts with the bytecode magic number.
+bool isFIRRTLBytecode(StringRef buffer);
+
+/// Write the specified operation, along with everything nested in it, to the
+/// stream in the binary bytecode format.  Types, attributes and locations are
+/// uniqued into tables that are written once.  The bodies of modules are
+/// written as independent chunks so that the reader can materialize them in
+/// parallel.
+void writeFIRRTLBytecode(mlir::Operation *op, raw_ostream &os);
+
+/// Read a bytecode file from the main buffer of the source manager into a new
+/// module.  This emits a diagnostic and returns null on failure.
+mlir::OwningModuleRef importFIRRTLBytecode(llvm::SourceMgr &sourceMgr,
+                                           mlir::MLIRContext *context);
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_FIRRTLBYTECODE_H
@@ -188,4 +188,15 @@ public:
 #define GET_OP_CLASSES
 #include "circt/Dialect/FIRRTL/FIRRTL.h.inc"
 
+namespace circt {
+namespace firrtl {
+
+/// Verify a circuit and everything nested in it, like `mlir::verify` does.
+/// The circuit-wide checks, such as those of the symbol table, run first.  The
+/// modules are then verified in parallel when multithreading is enabled.
+LogicalResult verifyCircuit(CircuitOp circuit);
+
+} // namespace firrtl
+} // namespace circt
+
 #endif // CIRCT_DIALECT_FIRRTL_OPS_H
@@ -108,6 +108,11 @@ public:
   /// nested under another type.
   unsigned getMaxFieldID();
 
+  /// Return the type of the field with the given field ID, which may itself be
+  /// an aggregate.  This takes one lookup per level of nesting, and doesn't
+  /// look at any of the sibling fields.
+  FIRRTLType getFinalTypeByFieldID(unsigned fieldID);
+
   /// Returns the effective field id when treating the index field as the root
   /// of the type.  Essentially maps a fieldID to a fieldID after a subfield op.
   /// Returns the new id and whether the id is in the given child.
@@ -319,9 +324,14 @@ public:
 
   /// Find the element index corresponding to the desired fieldID.  If the
   /// fieldID corresponds to a field in a nested bundle, it will return the
-  /// index of the parent field.
+  /// index of the parent field.  This is a binary search over the precomputed
+  /// field IDs of the elements.
   unsigned getIndexForFieldID(unsigned fieldID);
 
+  /// Return the type of the element containing the field ID, and the field ID
+  /// relative to that element.  A field ID of 0 returns the bundle itself.
+  std::pair<FIRRTLType, unsigned> getSubTypeByFieldID(unsigned fieldID);
+
   /// Get the maximum field ID in this bundle.  This is helpful for constructing
   /// field IDs when this BundleType is nested in another aggregate type.
   unsigned getMaxFieldID();
@@ -363,6 +373,10 @@ public:
   /// the index of the parent element.
   unsigned getIndexForFieldID(unsigned fieldID);
 
+  /// Return the element type, and the field ID relative to the element which
+  /// contains the field ID.  A field ID of 0 returns the vector itself.
+  std::pair<FIRRTLType, unsigned> getSubTypeByFieldID(unsigned fieldID);
+
   /// Get the maximum field ID in this vector.  This is helpful for constructing
   /// field IDs when this VectorType is nested in another aggregate type.
   unsigned getMaxFieldID();
@@ -15,17 +15,25 @@
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Support/LLVM.h"
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/ilist.h"
 #include "llvm/ADT/iterator.h"
-#include <deque>
+#include "llvm/Support/Allocator.h"
 
 namespace circt {
 namespace firrtl {
 
 class InstanceGraphNode;
 
+/// The tag of the list of uses of a module, which links together every
+/// InstanceRecord targeting the same module.
+struct InstanceUseListTag {};
+
 /// This is an edge in the InstanceGraph. This tracks a specific instantiation
 /// of a module.
-class InstanceRecord {
+class InstanceRecord
+    : public llvm::ilist_node<InstanceRecord>,
+      public llvm::ilist_node<InstanceRecord,
+                              llvm::ilist_tag<InstanceUseListTag>> {
 public:
   InstanceRecord(InstanceOp instance, InstanceGraphNode *parent,
                  InstanceGraphNode *target)
@@ -40,6 +48,18 @@ public:
   /// Get the module which the InstanceOp is instantiating.
   InstanceGraphNode *getTarget() const { return target; }
 
+  /// Replace the InstanceOp being tracked, e.g. after the instance has been
+  /// recreated with different result types.
+  void setInstance(InstanceOp newInstance) { instance = newInstance; }
+
+  /// Change the module which is instantiated.  This only updates the graph,
+  /// the InstanceOp must be updated separately.
+  void setTarget(InstanceGraphNode *newTarget);
+
+  /// Remove this instance from the graph, and delete it.  This does not erase
+  /// the InstanceOp.
+  void erase();
+
 private:
   /// The InstanceOp that this is tracking.
   InstanceOp instance;
@@ -55,13 +75,12 @@ private:
 /// Circuit.  Both external modules and regular modules can be represented by
 /// this class. It is possible to efficiently iterate all modules instantiated
 /// by this module, as well as all instantiations of this module.
-class InstanceGraphNode {
-  using EdgeVec = std::deque<InstanceRecord>;
-  using UseVec = std::vector<InstanceRecord *>;
+class InstanceGraphNode : public llvm::ilist_node<InstanceGraphNode> {
+  using EdgeVec = llvm::iplist<InstanceRecord>;
+  using UseVec =
+      llvm::simple_ilist<InstanceRecord, llvm::ilist_tag<InstanceUseListTag>>;
 
-  static InstanceRecord *unwrap(EdgeVec::value_type &value) {
-    return &value;
-  }
+  static InstanceRecord *unwrap(EdgeVec::value_type &value) { return &value; }
   class InstanceIterator final
       : public llvm::mapped_iterator<EdgeVec::iterator, decltype(&unwrap)> {
   public:
@@ -71,6 +90,15 @@ class InstanceGraphNode {
               it, &unwrap) {}
   };
 
+  class UseIterator final
+      : public llvm::mapped_iterator<UseVec::iterator, decltype(&unwrap)> {
+  public:
+    /// Initializes the use iterator to the specified use list iterator.
+    UseIterator(UseVec::iterator it)
+        : llvm::mapped_iterator<UseVec::iterator, decltype(&unwrap)>(it,
+                                                                     &unwrap) {}
+  };
+
 public:
   InstanceGraphNode() : module(nullptr) {}
 
@@ -86,19 +114,21 @@ public:
   }
 
   /// Iterate the instance records which instantiate this module.
-  using use_iterator = UseVec::iterator;
-  use_iterator uses_begin() { return moduleUses.begin(); }
-  use_iterator uses_end() { return moduleUses.end(); }
+  using use_iterator = UseIterator;
+  use_iterator uses_begin() { return use_iterator(moduleUses.begin()); }
+  use_iterator uses_end() { return use_iterator(moduleUses.end()); }
   llvm::iterator_range<use_iterator> uses() {
     return llvm::make_range(uses_begin(), uses_end());
   }
 
-private:
+  /// Return true if this module is not instantiated anywhere.
+  bool noUses() const { return moduleUses.empty(); }
+
   /// Record a new instance op in the body of this module. Returns a newly
   /// allocated InstanceRecord which will be owned by this node.
-  InstanceRecord *recordInstance(InstanceOp instance,
-                                 InstanceGraphNode *target);
+  InstanceRecord *addInstance(InstanceOp instance, InstanceGraphNode *target);
 
+private:
   /// Record that a module instantiates this module.
   void recordUse(InstanceRecord *record);
 
@@ -106,7 +136,7 @@ private:
   Operation *module;
 
   /// List of instance operations in this module.  This member owns the
-  /// InstanceRecords, which may be pointed to by other InstanceGraohNode's use
+  /// InstanceRecords, which may be pointed to by other InstanceGraphNode's use
   /// lists.
   EdgeVec moduleInstances;
 
@@ -115,6 +145,7 @@ private:
 
   // Provide access to the constructor.
   friend class InstanceGraph;
+  friend class InstanceRecord;
 };
 
 /// This graph tracks modules and where they are instantiated. This is intended
@@ -123,18 +154,20 @@ private:
 ///
 /// To use this class, retrieve a cached copy from the analysis manager:
 ///   auto &instanceGraph = getAnalysis<InstanceGraph>(getOperation());
+///
+/// Passes which add, remove or retarget instances, or add and remove modules,
+/// can keep the graph up to date with the update methods below and mark it as
+/// preserved, so that later passes don't have to rebuild it.
 class InstanceGraph {
-
   /// Storage for InstanceGraphNodes.
-  using NodeVec = std::deque<InstanceGraphNode>;
+  using NodeVec = llvm::iplist<InstanceGraphNode>;
 
-  /// Iterator that unwraps a unique_ptr to return a regular pointer.
+  /// Iterator that unwraps a list node to return a regular pointer.
   static InstanceGraphNode *unwrap(NodeVec::value_type &value) {
     return &value;
   }
   struct NodeIterator final
-      : public llvm::mapped_iterator<NodeVec::iterator,
-                                     decltype(&unwrap)> {
+      : public llvm::mapped_iterator<NodeVec::iterator, decltype(&unwrap)> {
     /// Initializes the result type iterator to the specified result iterator.
     NodeIterator(NodeVec::iterator it)
         : llvm::mapped_iterator<NodeVec::iterator, decltype(&unwrap)>(
@@ -153,6 +186,9 @@ public:
   /// or an FExtModuleOp.
   InstanceGraphNode *lookup(Operation *op);
 
+  /// Lookup an module by name.
+  InstanceGraphNode *lookup(StringRef name);
+
   /// Lookup an InstanceGraphNode for a module. Operation must be an FModuleOp
   /// or an FExtModuleOp.
   InstanceGraphNode *operator[](Operation *op) { return lookup(op); }
@@ -167,19 +203,118 @@ public:
   iterator begin() { return nodes.begin(); }
   iterator end() { return nodes.end(); }
 
+  /// Add a new module to the graph, along with the instances in its body.
+  /// The modules it instantiates must already be in the graph.
+  InstanceGraphNode *addModule(Operation *module);
+
+  /// Remove a module from the graph, along with the instance records of its
+  /// body.  The module must not be instantiated anywhere.  This does not erase
+  /// the module operation, and must be called before it is erased.
+  void erase(InstanceGraphNode *node);
+
+  /// Update the graph after an instance has been replaced by a new one, which
+  /// may instantiate a different module.  This searches the instances of the
+  /// parent module, so passes replacing every instance of a module should
+  /// update the records directly.
+  void replaceInstance(InstanceOp instance, InstanceOp newInstance);
+
+  /// Make every instance of a module instantiate another module instead, both
+  /// in the graph and in the IR.  The old module is left without uses.
+  void replaceModule(Operation *oldModule, Operation *newModule);
+
 private:
   /// Get the node corresponding to the module.  If the node has does not exist
   /// yet, it will be created.
   InstanceGraphNode *getOrAddNode(StringRef name);
 
-  /// Lookup an module by name.
-  InstanceGraphNode *lookup(StringRef name);
+  /// Record the instance ops in the body of a module.
+  void addInstances(FModuleOp module, InstanceGraphNode *node);
 
   /// The storage for graph nodes, with deterministic iteration.
   NodeVec nodes;
 
   /// This maps each operation to its graph node.
-  llvm::StringMap<unsigned> nodeMap;
+  llvm::StringMap<InstanceGraphNode *> nodeMap;
+};
+
+/// An absolute instance path.
+using InstancePath = ArrayRef<InstanceOp>;
+
+/// This is a node in the trie of absolute instance paths.  A path is encoded as
+/// its last instance and the path to the module containing that instance, so
+/// paths with a common prefix share its storage.
+class InstancePathNode {
+public:
+  InstancePathNode(const InstancePathNode *parent, InstanceOp instance)
+      : parent(parent), instance(instance),
+        length(parent ? parent->length + 1 : 1) {}
+
+  /// Get the path to the module containing the last instance, or null if the
+  /// instance is in the top level module.
+  const InstancePathNode *getParent() const { return parent; }
+
+  /// Get the last instance of the path.
+  InstanceOp getInstance() const { return instance; }
+
+  /// Get the number of instances in the path.
+  unsigned size() const { return length; }
+
+  /// Append the instances of the path to the vector, from the top down.
+  void getPath(SmallVectorImpl<InstanceOp> &path) const;
+
+private:
+  const InstancePathNode *parent;
+  InstanceOp instance;
+  unsigned length;
+};
+
+/// This caches queries about the instance hierarchy below the top level module
+/// which would otherwise walk the InstanceGraph for each module asked about.
+/// Each answer is computed once, from the answers for the parent modules.  The
+/// cache must be invalidated when the InstanceGraph is changed.
+class InstancePathCache {
+public:
+  explicit InstancePathCache(InstanceGraph &instanceGraph)
+      : instanceGraph(instanceGraph) {}
+
+  /// Return the number of times a module is instantiated in the design, which
+  /// is also the number of absolute paths to it.  The top level module is
+  /// instantiated once, and unreachable modules are not instantiated.
+  uint64_t getInstanceCount(Operation *module);
+
+  /// Return the absolute paths to a module, as nodes of the path trie.  This
+  /// costs a constant amount of time and memory for each path.  The top level
+  /// module has a single empty path, represented by a null node.
+  ArrayRef<const InstancePathNode *> getPathNodes(Operation *module);
+
+  /// Return the absolute paths to a module, as arrays of instances.
+  ArrayRef<InstancePath> getAbsolutePaths(Operation *module);
+
+  /// Return the array of instances of a path in the trie.
+  InstancePath getAbsolutePath(const InstancePathNode *node);
+
+  /// Drop all the answers, which must be done after the InstanceGraph is
+  /// changed.  This frees the paths returned so far.
+  void invalidate();
+
+private:
+  uint64_t getInstanceCount(InstanceGraphNode *node);
+  ArrayRef<const InstancePathNode *> getPathNodes(InstanceGraphNode *node);
+
+  /// The instance graph of the IR.
+  InstanceGraph &instanceGraph;
+
+  /// An allocator for the path nodes, the instance paths, and the lists of
+  /// them.
+  llvm::BumpPtrAllocator allocator;
+
+  /// The number of times each module is instantiated.
+  DenseMap<InstanceGraphNode *, uint64_t> instanceCounts;
+
+  /// The paths to each module, and the arrays of instances for each of them.
+  DenseMap<InstanceGraphNode *, ArrayRef<const InstancePathNode *>> pathNodes;
+  DenseMap<InstanceGraphNode *, ArrayRef<InstancePath>> absolutePaths;
+  DenseMap<const InstancePathNode *, InstancePath> pathArrays;
 };
 
 } // namespace firrtl
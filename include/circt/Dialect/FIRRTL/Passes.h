@@ -23,30 +23,42 @@ class Pass;
 namespace circt {
 namespace firrtl {
 
-std::unique_ptr<mlir::Pass> createLowerFIRRTLTypesPass();
+std::unique_ptr<mlir::Pass>
+createLowerFIRRTLTypesPass(bool preserveAggregate = false);
 
 std::unique_ptr<mlir::Pass> createLowerBundleVectorTypesPass();
 
 std::unique_ptr<mlir::Pass> createIMConstPropPass();
 
+std::unique_ptr<mlir::Pass> createIMDeadCodeElimPass();
+
 std::unique_ptr<mlir::Pass> createInlinerPass();
 
+std::unique_ptr<mlir::Pass> createDedupPass();
+
 std::unique_ptr<mlir::Pass> createBlackBoxMemoryPass();
 
 std::unique_ptr<mlir::Pass> createExpandWhensPass();
 
+std::unique_ptr<mlir::Pass> createForwardConnectsPass();
+
+std::unique_ptr<mlir::Pass> createRegVectorToMemPass();
+
 std::unique_ptr<mlir::Pass> createInferWidthsPass();
 
 std::unique_ptr<mlir::Pass> createPrintInstanceGraphPass();
 
 std::unique_ptr<mlir::Pass>
 createBlackBoxReaderPass(llvm::Optional<StringRef> inputPrefix = {},
-                         llvm::Optional<StringRef> resourcePrefix = {});
+                         llvm::Optional<StringRef> resourcePrefix = {},
+                         llvm::Optional<uint64_t> inlineSizeLimit = {});
 
 std::unique_ptr<mlir::Pass> createGrandCentralPass();
 
 std::unique_ptr<mlir::Pass> createGrandCentralTapsPass();
 
+std::unique_ptr<mlir::Pass> createVerifyCircuitPass();
+
 /// Generate the code for registering passes.
 #define GEN_PASS_REGISTRATION
 #include "circt/Dialect/FIRRTL/Passes.h.inc"
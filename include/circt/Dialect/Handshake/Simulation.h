@@ -18,8 +18,60 @@
 #include "mlir/IR/MLIRContext.h"
 #include <string>
 
+/// The options of a simulation.
+struct SimulationOptions {
+  /// Lower handshake functions to instructions over dense register slots
+  /// before executing them, unless they use operations the compiled engine
+  /// does not support.
+  bool compiled = false;
+  /// With more than one thread, the compiled engine executes the operations
+  /// that are ready in parallel, in a non-deterministic order.
+  unsigned numThreads = 1;
+  /// Feed the lines of a batch into the function as fast as it accepts them,
+  /// instead of executing them back-to-back.
+  bool pipelined = false;
+  /// Print the tokens, waits and stalls of the operations and channels of
+  /// the compiled engine, and its critical path, on stderr.
+  bool perfReport = false;
+  /// Write the module to this file with these counters attached to the
+  /// operations as a `perf` dictionary.
+  std::string annotatePerf;
+  /// The cycles an access to a memory takes on top of the operation issuing
+  /// it, the number of accesses each bank of a memory serves per cycle, or
+  /// zero for any number, and the number of banks its addresses are
+  /// interleaved over. The `latency`, `ports` and `banks` attributes of a
+  /// `handshake.memory` override them for that memory. The model applies to
+  /// the memrefs of standard functions and to the memories of the compiled
+  /// engine.
+  unsigned memoryLatency = 0;
+  unsigned memoryPorts = 0;
+  unsigned memoryBanks = 1;
+
+  /// Whether the accesses to memories take longer than in the default model,
+  /// where they complete right away and never conflict.
+  bool hasMemoryModel() const {
+    return memoryLatency != 0 || memoryPorts != 0;
+  }
+
+  /// Whether the options need the compiled engine.
+  bool needsCompiled() const {
+    return compiled || numThreads > 1 || pipelined || perfReport ||
+           !annotatePerf.empty();
+  }
+};
+
+/// Execute `toplevelFunction` with the given arguments and print its results.
 bool simulate(llvm::StringRef toplevelFunction,
               llvm::ArrayRef<std::string> inputArgs,
-              mlir::OwningModuleRef &module, mlir::MLIRContext &context);
+              mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+              const SimulationOptions &options = SimulationOptions());
+
+/// Execute `toplevelFunction` once for every line of `batchFile`, which holds
+/// the arguments of one execution like the command line does, and print the
+/// results of every line. The simulated cycles per result and the results per
+/// second of wall time are reported on stderr.
+bool simulateBatch(llvm::StringRef toplevelFunction, llvm::StringRef batchFile,
+                   mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+                   const SimulationOptions &options = SimulationOptions());
 
 #endif
@@ -15,6 +15,8 @@
 
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "mlir/IR/BuiltinOps.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/DynamicLibrary.h"
 
 namespace mlir {
 class ExecutionEngine;
@@ -23,6 +25,10 @@ class ExecutionEngine;
 namespace llvm {
 class Error;
 class Module;
+class ThreadPool;
+namespace orc {
+class LLJIT;
+} // namespace orc
 } // namespace llvm
 
 namespace circt {
@@ -31,16 +37,64 @@ namespace sim {
 
 struct State;
 struct Instance;
+struct UpdateStaging;
+
+/// The initial values of some signals of a replica in a batch simulation, as
+/// pairs of signal paths, like "root/sub/sig", and integer values.
+using Stimulus = llvm::SmallVector<std::pair<std::string, std::string>, 4>;
+
+/// The performance counters of a simulation. The histograms have power of two
+/// buckets: bucket `i` counts the values between 2^i and 2^(i+1) - 1.
+struct Statistics {
+  // The steps simulated, and the distinct real times among them.
+  uint64_t steps = 0;
+  uint64_t realTimeSteps = 0;
+  // The drives applied from the event queue, the signal changes they caused,
+  // and the scheduled process wakeups.
+  uint64_t drives = 0;
+  uint64_t signalChanges = 0;
+  uint64_t wakeups = 0;
+  // The unit invocations, in total and per unit.
+  uint64_t activations = 0;
+  llvm::StringMap<uint64_t> unitActivations;
+  // The steps of each real time, counting the delta and epsilon steps.
+  llvm::SmallVector<uint64_t, 8> stepsPerRealTime;
+  // The pending slots of the event queue at each step.
+  llvm::SmallVector<uint64_t, 8> queueDepth;
+  // The wall time of the simulation, and the part spent in the units.
+  double totalSeconds = 0;
+  double unitSeconds = 0;
+  // The bytes of trace written.
+  uint64_t traceBytes = 0;
+
+  /// Print the statistics as a human readable report.
+  void print(llvm::raw_ostream &os) const;
+
+  /// Print the statistics as JSON.
+  void printJSON(llvm::raw_ostream &os) const;
+};
 
 class Engine {
 public:
   /// Initialize an LLHD simulation engine. This initializes the state, as well
-  /// as the mlir::ExecutionEngine with the given module.
+  /// as the mlir::ExecutionEngine with the given module. `queue` selects the
+  /// implementation of the event queue: 0 for the slot list, 1 for the timing
+  /// wheel. The instances woken up in a step run on `threads` threads, 0
+  /// meaning all the available hardware threads. If `vcd` is set, the trace
+  /// is written in the Value Change Dump format. If `asyncTrace` is set, the
+  /// trace is formatted and written on a background thread, the simulation
+  /// waiting for it when the unwritten changes take more than
+  /// `traceBufferSize` bytes, unless it is 0. If `precompiled` names an object
+  /// file written by emitObjectFile, or a shared library built from one, the
+  /// units are run from it instead of being lowered and JIT compiled.
   Engine(
       llvm::raw_ostream &out, ModuleOp module,
       llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
       llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-      std::string root, int mode, ArrayRef<StringRef> sharedLibPaths);
+      std::string root, int mode, ArrayRef<StringRef> sharedLibPaths,
+      int queue = 1, unsigned threads = 1, bool vcd = false,
+      bool asyncTrace = false, size_t traceBufferSize = 0,
+      StringRef precompiled = "");
 
   /// Default destructor
   ~Engine();
@@ -49,6 +103,56 @@ public:
   /// n=0 and T=0 make the simulation run indefinitely.
   int simulate(int n, uint64_t maxTime);
 
+  /// Simulate one independent replica of the design for each stimulus, with
+  /// the given signals set to the given values once initialized, sharing the
+  /// compiled code. The replicas run on the thread pool, each writing its
+  /// trace to its own stream of `outs`, and stop like `simulate`.
+  int simulateBatch(ArrayRef<Stimulus> stimuli,
+                    ArrayRef<llvm::raw_ostream *> outs, int n,
+                    uint64_t maxTime);
+
+  /// Compile the lowered module to a native object file at `path`. The object,
+  /// or a shared library built from it, can be simulated without compiling the
+  /// design again, the signals runtime being resolved at load time.
+  mlir::LogicalResult emitObjectFile(StringRef path);
+
+  /// Stop the simulation before the first step at or after `time` picoseconds
+  /// of simulation time, and write the state to a checkpoint at `path`.
+  void checkpointAt(uint64_t time, StringRef path) {
+    checkpointTime = time;
+    checkpointPath = path.str();
+  }
+
+  /// Start the simulation from the checkpoint at `path`, written for the same
+  /// design, instead of time 0.
+  void restoreFrom(StringRef path) { restorePath = path.str(); }
+
+  /// Evaluate the combinational entities, which have no registers and whose
+  /// drives all take effect in the same real-time step, once per step in
+  /// topological order, applying their drives without going through the event
+  /// queue. Their changes then appear in the step waking them up, instead of
+  /// in later delta and epsilon steps.
+  void setCycleBased(bool enable) { cycleBased = enable; }
+
+  /// Compile each unit on its first invocation rather than the whole design
+  /// before the simulation starts, for the units never activated not to be
+  /// compiled at all. If the instances run on several threads, the units
+  /// invoked at the same time, like those of the first step, are compiled
+  /// concurrently.
+  void setLazyCompilation(bool enable) { lazyCompilation = enable; }
+
+  /// Gather the performance counters of the simulations run by simulate. This
+  /// times each unit invocation, which slows the simulation down a bit.
+  void enableStatistics(bool enable) { collectStatistics = enable; }
+
+  /// Get the performance counters of the last simulation.
+  const Statistics &getStatistics() const { return statistics; }
+
+  /// Only trace the signals whose path in one of their instances matches one
+  /// of the `include` glob patterns, if any, and none of the `exclude` ones.
+  mlir::LogicalResult setTraceFilter(ArrayRef<std::string> include,
+                                     ArrayRef<std::string> exclude);
+
   /// Build the instance layout of the design.
   void buildLayout(ModuleOp module);
 
@@ -67,12 +171,70 @@ public:
 private:
   void walkEntity(EntityOp entity, Instance &child);
 
+  /// Record whether the instance of the given entity is combinational, and
+  /// the signals it drives.
+  void classifyEntity(EntityOp entity, Instance &inst);
+
+  /// Create the JIT compiling the lowered module.
+  mlir::LogicalResult createJIT();
+
+  /// Create the JIT compiling the functions of the lowered module on their
+  /// first call. Its functions are looked up like those of a precompiled
+  /// object.
+  mlir::LogicalResult createLazyJIT();
+
+  /// Load the precompiled design in the shared library or object file at
+  /// `path`.
+  mlir::LogicalResult loadPrecompiled(StringRef path);
+
+  /// Get the address of the given function of the precompiled design, or null
+  /// if it is missing.
+  void *lookupPrecompiled(StringRef name);
+
+  /// Initialize the signals and instances of a state built with the design's
+  /// layout, and look the units up.
+  mlir::LogicalResult prepare(std::unique_ptr<State> &sim);
+
+  /// Simulate the prepared state, writing its trace to `os`. Replicas of a
+  /// batch, given by their index, run their steps serially.
+  int run(std::unique_ptr<State> &sim, llvm::raw_ostream &os, int n,
+          uint64_t maxTime, int replica = -1);
+
+  /// Write the state to the checkpoint file. This empties the event queue.
+  mlir::LogicalResult writeCheckpoint();
+
+  /// Restore the state from the checkpoint file.
+  mlir::LogicalResult restoreCheckpoint();
+
+  /// Run the unit of the instance of `sim` with the given index.
+  void runInstance(State &sim, unsigned index);
+
+  /// Run the units of the given instances of `sim` on the thread pool.
+  void runInstancesInParallel(State &sim, ArrayRef<unsigned> instances);
+
   llvm::raw_ostream &out;
   std::string root;
+  int queueKind;
   std::unique_ptr<State> state;
   std::unique_ptr<mlir::ExecutionEngine> engine;
+  std::function<llvm::Error(llvm::Module *)> llvmTransformer;
+  std::vector<std::string> sharedLibPaths;
+  llvm::sys::DynamicLibrary library;
+  std::unique_ptr<llvm::orc::LLJIT> objectJIT;
   ModuleOp module;
   int traceMode;
+  bool vcd;
+  bool asyncTrace;
+  size_t traceBufferSize;
+  uint64_t checkpointTime = 0;
+  std::string checkpointPath;
+  std::string restorePath;
+  bool cycleBased = false;
+  bool lazyCompilation = false;
+  bool collectStatistics = false;
+  Statistics statistics;
+  std::unique_ptr<llvm::ThreadPool> pool;
+  std::vector<UpdateStaging> staging;
 };
 
 } // namespace sim
@@ -29,6 +29,14 @@ std::unique_ptr<OperationPass<ProcOp>> createMemoryToBlockArgumentPass();
 
 std::unique_ptr<OperationPass<ProcOp>> createEarlyCodeMotionPass();
 
+std::unique_ptr<OperationPass<ModuleOp>> createProbeCoalescingPass();
+
+std::unique_ptr<OperationPass<ModuleOp>>
+createDeadSignalEliminationPass(StringRef root = "root",
+                                bool namedOnly = false);
+
+std::unique_ptr<OperationPass<ModuleOp>> createEntityFusionPass();
+
 /// Register the LLHD Transformation passes.
 void initLLHDTransformationPasses();
 
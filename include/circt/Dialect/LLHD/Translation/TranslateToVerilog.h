@@ -15,6 +15,7 @@
 
 namespace llvm {
 class raw_ostream;
+class StringRef;
 } // namespace llvm
 
 namespace mlir {
@@ -27,6 +28,11 @@ namespace llhd {
 
 mlir::LogicalResult exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os);
 
+/// Export each entity of the module to a file of its own in the directory
+/// `dirname`, named after the entity, and list the files in `filelist.f`.
+mlir::LogicalResult exportSplitVerilog(mlir::ModuleOp module,
+                                       llvm::StringRef dirname);
+
 void registerToVerilogTranslation();
 
 } // namespace llhd
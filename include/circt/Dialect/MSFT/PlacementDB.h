@@ -0,0 +1,88 @@
+//===- PlacementDB.h - Database of placed entities --------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A database of the physical locations assigned to the entities of a design,
+// indexed by location for overlap detection and proximity queries.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_MSFT_PLACEMENTDB_H
+#define CIRCT_DIALECT_MSFT_PLACEMENTDB_H
+
+#include "circt/Dialect/MSFT/MSFTAttributes.h"
+#include "circt/Support/LLVM.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <tuple>
+
+namespace circt {
+namespace msft {
+
+/// The physical locations of the entities in one design. Each location holds
+/// at most one entity. Besides the exact locations, the placements are
+/// bucketed into a grid per device type, so the entities around a location
+/// can be found without scanning all of them.
+class PlacementDB {
+public:
+  /// An entity placed at a location.
+  struct PlacedInstance {
+    /// The hierarchical path of the entity, e.g. `$parent|inst|memBank`.
+    std::string path;
+    /// The operation carrying the location.
+    Operation *op;
+  };
+
+  /// `gridSize` is the width and height of the grid cells.
+  explicit PlacementDB(uint64_t gridSize = 16) : gridSize(gridSize) {}
+
+  /// Place `inst` at `loc`. Emit an error on the operation and fail if the
+  /// location is already occupied.
+  LogicalResult addPlacement(PhysLocationAttr loc, PlacedInstance inst);
+
+  /// Return the entity placed at `loc`, or null if there is none.
+  const PlacedInstance *getInstanceAt(PhysLocationAttr loc) const;
+
+  /// Collect the locations of the entities placed by `op`, in the order they
+  /// were added.
+  void getPlacementsOf(Operation *op,
+                       SmallVectorImpl<PhysLocationAttr> &locs) const;
+
+  /// Collect the locations of the given device type whose coordinates are at
+  /// most `radius` away from (`x`, `y`) in both directions.
+  void getNearby(DeviceType devType, uint64_t x, uint64_t y, uint64_t radius,
+                 SmallVectorImpl<PhysLocationAttr> &locs) const;
+
+  /// Call `fn` on each placement, in the order they were added.
+  void walkPlacements(
+      function_ref<void(PhysLocationAttr, const PlacedInstance &)> fn) const;
+
+  size_t size() const { return placements.size(); }
+
+private:
+  using GridCell = std::tuple<unsigned, uint64_t, uint64_t>;
+
+  GridCell getCell(DeviceType devType, uint64_t x, uint64_t y) const {
+    return GridCell((unsigned)devType, x / gridSize, y / gridSize);
+  }
+
+  uint64_t gridSize;
+  SmallVector<std::pair<PhysLocationAttr, PlacedInstance>> placements;
+  /// The index into `placements` of each occupied location. Locations are
+  /// uniqued attributes, so two of them compare equal iff they are the same.
+  DenseMap<PhysLocationAttr, unsigned> locations;
+  /// The indices into `placements` of the entities placed by each operation.
+  DenseMap<Operation *, SmallVector<unsigned, 2>> opPlacements;
+  /// The occupied locations in each grid cell.
+  DenseMap<GridCell, SmallVector<PhysLocationAttr, 4>> grid;
+};
+
+} // namespace msft
+} // namespace circt
+
+#endif // CIRCT_DIALECT_MSFT_PLACEMENTDB_H
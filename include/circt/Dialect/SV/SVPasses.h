@@ -28,11 +28,15 @@ namespace sv {
 
 std::unique_ptr<mlir::Pass> createPrettifyVerilogPass();
 std::unique_ptr<mlir::Pass> createHWCleanupPass();
-std::unique_ptr<mlir::Pass> createHWStubExternalModulesPass();
+std::unique_ptr<mlir::Pass> createHWValueNumberingPass();
+std::unique_ptr<mlir::Pass>
+createHWStubExternalModulesPass(bool interfaceOnly = false);
 std::unique_ptr<mlir::Pass> createHWLegalizeNamesPass();
 std::unique_ptr<mlir::Pass> createHWGeneratorCalloutPass();
-std::unique_ptr<mlir::Pass> createHWMemSimImplPass();
+std::unique_ptr<mlir::Pass>
+createHWMemSimImplPass(bool randomizeInit = false, bool readMemInit = false);
 std::unique_ptr<mlir::Pass> createSVExtractTestCodePass();
+std::unique_ptr<mlir::Pass> createHWMiterPass();
 /// Generate the code for registering passes.
 #define GEN_PASS_REGISTRATION
 #include "circt/Dialect/SV/SVPasses.h.inc"
@@ -0,0 +1,161 @@
+//===- CycleSimulator.h - Cycle-based simulator of HW modules ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a cycle-based simulator, which evaluates a `hw.module` of
+// `comb` logic and `seq.compreg` registers directly on the IR.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_SEQ_SIMULATOR_CYCLESIMULATOR_H
+#define CIRCT_DIALECT_SEQ_SIMULATOR_CYCLESIMULATOR_H
+
+#include "circt/Dialect/HW/HWOps.h"
+#include "mlir/IR/SymbolTable.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+namespace circt {
+namespace seq {
+namespace sim {
+
+/// A cycle-based simulator of a `hw.module`. The design is flattened through
+/// its instances, and its combinational logic is levelized once, so that each
+/// evaluation computes every operation exactly once in topological order.
+///
+/// Each step models one rising edge of all clocks at once: every register
+/// samples its input, or its reset value if its synchronous reset is asserted.
+/// Registers start out as zero. Only integer types are supported.
+///
+/// A simulation looks like:
+///
+///   CycleSimulator sim(module);
+///   if (failed(sim.build()))
+///     return failure();
+///   sim.setInput(0, APInt(8, 42));
+///   sim.eval();
+///   auto result = sim.getOutput(0);
+///   sim.step();
+///
+class CycleSimulator {
+public:
+  explicit CycleSimulator(hw::HWModuleOp top);
+
+  /// Flatten and levelize the design. Emit an error and fail if it contains
+  /// unsupported operations or types, or combinational cycles.
+  LogicalResult build();
+
+  unsigned getNumInputs() { return inputSlots.size(); }
+  unsigned getNumOutputs() { return outputSlots.size(); }
+  StringRef getInputName(unsigned idx);
+  StringRef getOutputName(unsigned idx);
+  unsigned getInputWidth(unsigned idx) { return getInput(idx).getBitWidth(); }
+
+  /// Return true if the input drives the clock of any register. Clocks are
+  /// only used to find the registers, their values don't matter.
+  bool isClockInput(unsigned idx) {
+    return clockSlots.count(inputSlots[idx]);
+  }
+
+  /// Set the value of an input, which must have the width of the port.
+  void setInput(unsigned idx, const APInt &value);
+  const APInt &getInput(unsigned idx) { return values[inputSlots[idx]]; }
+
+  /// Return the value of an output as of the last evaluation.
+  const APInt &getOutput(unsigned idx) { return values[outputSlots[idx]]; }
+
+  /// Compute the combinational logic from the inputs and registers.
+  void eval();
+
+  /// Clock all registers, which sample the values of the last evaluation.
+  void step();
+
+  /// Return the number of steps simulated.
+  uint64_t getCycle() { return cycle; }
+
+private:
+  enum class Kind {
+    Add,
+    Sub,
+    Mul,
+    DivU,
+    DivS,
+    ModU,
+    ModS,
+    Shl,
+    ShrU,
+    ShrS,
+    And,
+    Or,
+    Xor,
+    ICmp,
+    Parity,
+    Extract,
+    SExt,
+    Concat,
+    Mux,
+    Copy
+  };
+
+  /// A combinational operation, reading and writing slots of `values`.
+  struct Instruction {
+    Kind kind;
+    unsigned result;
+    SmallVector<unsigned, 2> operands;
+    /// The predicate of comparisons, or the low bit of extracts.
+    unsigned attr = 0;
+  };
+
+  /// A register, holding its value in the `data` slot.
+  struct Register {
+    unsigned data;
+    unsigned input;
+    Optional<unsigned> reset;
+    Optional<unsigned> resetValue;
+  };
+
+  static Optional<Kind> getKind(Operation *op);
+
+  /// Allocate a zero-initialized slot for a value of `type`, or return None if
+  /// the type isn't supported.
+  Optional<unsigned> addSlot(Type type);
+  LogicalResult compileModule(hw::HWModuleOp module,
+                              ArrayRef<unsigned> argSlots,
+                              SmallVectorImpl<unsigned> &resultSlots);
+  LogicalResult levelize();
+  void execute(const Instruction &inst);
+
+  hw::HWModuleOp top;
+  SymbolTableCollection symbolTable;
+
+  /// The modules being compiled, to reject recursive instantiations.
+  llvm::SmallPtrSet<Operation *, 8> activeModules;
+
+  /// The current value of every signal of the flattened design.
+  SmallVector<APInt> values;
+  SmallVector<unsigned> inputSlots;
+  SmallVector<unsigned> outputSlots;
+  llvm::DenseSet<unsigned> clockSlots;
+
+  /// The combinational operations, in topological order after `levelize`.
+  SmallVector<Instruction> instructions;
+  /// The operation that each instruction was compiled from, for diagnostics
+  /// during `levelize`.
+  SmallVector<Operation *> instructionOps;
+  SmallVector<Register> registers;
+  /// The next values of the registers, reused across steps.
+  SmallVector<APInt> nextValues;
+
+  uint64_t cycle = 0;
+};
+
+} // namespace sim
+} // namespace seq
+} // namespace circt
+
+#endif // CIRCT_DIALECT_SEQ_SIMULATOR_CYCLESIMULATOR_H
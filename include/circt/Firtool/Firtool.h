@@ -0,0 +1,199 @@
+//===- Firtool.h - The firtool compilation pipeline -------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the pipeline of firtool as a library, so that it can be
+// embedded in other tools and compile inputs in process: parsing, the passes
+// from FIRRTL down to HW and the emission of the output.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRTOOL_FIRTOOL_H
+#define CIRCT_FIRTOOL_FIRTOOL_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Support/Timing.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+class SourceMgr;
+} // namespace llvm
+
+namespace mlir {
+class PassManager;
+class ScopedDiagnosticHandler;
+} // namespace mlir
+
+namespace circt {
+struct ExportVerilogStatistics;
+
+namespace firtool {
+
+/// The formats of the inputs.
+enum InputFormatKind {
+  InputUnspecified,
+  InputFIRFile,
+  InputMLIRFile,
+  InputFIRBytecodeFile
+};
+
+/// The formats of the output.
+enum OutputFormatKind {
+  OutputMLIR,
+  OutputFIRBytecode,
+  OutputVerilog,
+  OutputSplitVerilog,
+  OutputDisabled
+};
+
+/// The stages of the pipeline after which a checkpoint can be written, in
+/// pipeline order.
+enum class CheckpointStage { None, Parse, LowerTypes, LowerToHW, Cleanup };
+
+StringRef getCheckpointStageName(CheckpointStage stage);
+
+/// The options of the pipeline, which default to the defaults of the firtool
+/// command line.
+struct FirtoolOptions {
+  OutputFormatKind outputFormat = OutputMLIR;
+
+  bool disableOptimization = false;
+  bool incrementalCanonicalize = false;
+  bool inliner = false;
+  bool dedup = false;
+  bool lowerToHW = false;
+  bool enableAnnotationWarning = false;
+  bool groupDebugStatements = false;
+  bool imconstprop = true;
+  bool imdce = false;
+  bool lowerTypes = true;
+  bool preserveAggregate = false;
+  bool randomizeMemInit = false;
+  bool readMemInit = false;
+  bool expandWhens = true;
+  bool forwardConnects = false;
+  bool blackBoxMemory = false;
+  bool inferWidths = true;
+  bool extractTestCode = false;
+  bool interfaceOnly = false;
+  bool grandCentral = false;
+
+  bool ignoreFIRLocations = false;
+  bool lazyFIRLocations = false;
+  bool streamModulePasses = false;
+
+  bool verifyPasses = true;
+  bool verifyBoundaries = false;
+
+  std::string blackBoxRootPath;
+  std::string blackBoxRootResourcePath;
+  uint64_t blackBoxInlineSizeLimit = 0;
+
+  /// Write a checkpoint of the IR to this directory after each stage, unless
+  /// empty.
+  std::string checkpointDir;
+
+  /// Only rewrite the split Verilog files whose contents changed.
+  bool incrementalSplitVerilog = false;
+
+  /// Copy the split Verilog files of the modules unchanged since an earlier
+  /// run from this directory rather than emit them again, unless empty.  See
+  /// `SplitVerilogCache`.
+  std::string splitVerilogCacheDir;
+
+  /// Distinguishes the entries of this build of the compiler in the split
+  /// Verilog cache from those of the others.
+  std::string splitVerilogCacheSalt;
+
+  /// Print the MLIR output one top-level module at a time on several threads,
+  /// without aliases.
+  bool parallelMLIROutput = false;
+
+  /// Let the split Verilog emission drop the body of each module once its
+  /// file is written.  This must be off if the module is used afterwards.
+  bool releaseEmittedModules = true;
+
+  /// Return true if the pipeline lowers the input to HW.
+  bool isLowering() const {
+    return lowerToHW || outputFormat == OutputVerilog ||
+           outputFormat == OutputSplitVerilog;
+  }
+};
+
+/// Load the dialects the pipeline works on into `context`.
+void loadFirtoolDialects(MLIRContext &context);
+
+/// Add the passes of the compilation pipeline for inputs of the given format,
+/// skipping the stages up to and including `resumeStage`.  The black box
+/// files are looked up in `blackBoxRoot`.
+void populateFirtoolPipeline(
+    mlir::PassManager &pm, const FirtoolOptions &options,
+    InputFormatKind format, StringRef blackBoxRoot,
+    CheckpointStage resumeStage = CheckpointStage::None);
+
+/// The hooks through which `compileFirtoolInput` hands the input back while it
+/// is compiled.  All of them are optional.
+struct FirtoolCallbacks {
+  /// Called at the end of the timing scope of the parser, e.g. to record the
+  /// memory use.
+  std::function<void(mlir::TimingScope &)> afterParse;
+
+  /// Called with the parsed module before the pipeline runs on it, e.g. to
+  /// set its lowering options.
+  std::function<void(ModuleOp)> prepareModule;
+
+  /// Return the pipeline resuming after the given stage.  This lets a caller
+  /// compiling many inputs build its pipelines once.  Without it, a pipeline
+  /// is built for each input, with its pass timings nested under the timing
+  /// scope of the input.  When resuming from a checkpoint, the black box root
+  /// which the checkpoint was written with is also given, and is empty
+  /// otherwise.  It is used unless the options name another one.
+  std::function<mlir::PassManager &(CheckpointStage, StringRef)>
+      getPipelineAfter;
+
+  /// Return a handler for the diagnostics of the input, given the source
+  /// manager holding the input and the annotations, e.g. a
+  /// SourceMgrDiagnosticHandler printing their source lines.  It lives until
+  /// the input is compiled.  Without it, the diagnostics are left to the
+  /// handlers the caller registered on the context.
+  std::function<std::unique_ptr<mlir::ScopedDiagnosticHandler>(
+      llvm::SourceMgr &)>
+      getDiagnosticHandler;
+};
+
+/// Parse `input` in the given format, run the pipeline on it and hand the
+/// result to `output`, under an "Output" timing scope.  The annotations, if
+/// any, are added to the source manager of the input.  The parser timings
+/// are nested under `ts`.  If `result` is given, the module is moved into it
+/// rather than destroyed, which lets firtool leak it on exit.  Diagnostics go
+/// to the handlers of the context, unless the callbacks provide one.
+LogicalResult compileFirtoolInput(
+    std::unique_ptr<llvm::MemoryBuffer> input,
+    std::unique_ptr<llvm::MemoryBuffer> annotations, InputFormatKind format,
+    const FirtoolOptions &options, MLIRContext &context,
+    mlir::TimingScope &ts, const FirtoolCallbacks &callbacks,
+    function_ref<LogicalResult(ModuleOp, mlir::TimingScope &)> output,
+    mlir::OwningModuleRef *result = nullptr);
+
+/// Emit `module` in the output format of `options` to `os`, or to one file
+/// per module in `outputDirectory` for split Verilog, which drops the body of
+/// each module once its file is written unless `releaseEmittedModules` is
+/// off in the options.  The Verilog emission statistics are
+/// collected in `statistics` if given.
+LogicalResult emitFirtoolOutput(ModuleOp module, const FirtoolOptions &options,
+                                raw_ostream *os, StringRef outputDirectory,
+                                mlir::TimingScope &ts,
+                                ExportVerilogStatistics *statistics = nullptr);
+
+} // namespace firtool
+} // namespace circt
+
+#endif // CIRCT_FIRTOOL_FIRTOOL_H
@@ -24,6 +24,45 @@ namespace scheduling {
 /// name). Fails if the dependence graph contains cycles.
 LogicalResult scheduleASAP(Problem &prob);
 
+/// This is a list scheduler for solving the resource-constrained scheduling
+/// problem. Operations are scheduled once all of their predecessors are, in
+/// the order of their distance to the end of the schedule along the longest
+/// path (the critical path heuristic). Each operation is assigned the earliest
+/// start time at which its operator type has not yet reached its limit. Fails
+/// if the dependence graph contains cycles.
+LogicalResult scheduleList(SharedOperatorsProblem &prob);
+
+/// The objectives optimized by the simplex scheduler.
+enum class SimplexObjective {
+  /// Minimize the sum of all start times, which also minimizes the latency of
+  /// the schedule.
+  Latency,
+  /// Among the schedules with minimal latency, minimize the total number of
+  /// time steps in which the operations' results have to be kept alive until
+  /// their last user starts, i.e. the register lifetimes.
+  RegisterLifetime
+};
+
+/// This scheduler formulates the basic scheduling problem as a system of
+/// difference constraints, and solves it to optimality w.r.t. \p objective
+/// with an in-tree simplex solver. The solution is exact, but the dense
+/// solver is meant for small kernels. Fails if the dependence graph contains
+/// cycles with a positive latency.
+LogicalResult
+scheduleSimplex(Problem &prob,
+                SimplexObjective objective = SimplexObjective::Latency);
+
+/// This is an iterative modulo scheduler for the modulo scheduling problem,
+/// following B. R. Rau, "Iterative Modulo Scheduling", MICRO 1994. It tries
+/// the initiation intervals upwards from the lower bound imposed by the limited
+/// operator types, skipping those that cannot satisfy the dependence cycles.
+/// For each candidate, operations are placed into a modulo reservation table,
+/// evicting and rescheduling conflicting operations within a fixed budget.
+/// Fails if no initiation interval up to the sequential execution of all
+/// operations admits a schedule, e.g. for cycles without a loop-carried
+/// dependence.
+LogicalResult scheduleModulo(ModuloProblem &prob);
+
 } // namespace scheduling
 } // namespace circt
 
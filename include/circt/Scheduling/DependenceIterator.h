@@ -78,10 +78,19 @@ private:
   };
 };
 
+/// A dependence in a finalized problem, together with its dense index and the
+/// dense index of its source operation.
+struct IndexedDependence {
+  Dependence dep;
+  unsigned index;
+  unsigned sourceIndex;
+};
+
 /// An iterator to transparently surface an operation's def-use dependences from
 /// the SSA subgraph (induced by the registered operations), as well as
 /// auxiliary, operation-to-operation dependences explicitly provided by the
-/// client.
+/// client. In a finalized problem, the iterator walks the precomputed
+/// adjacency arrays instead.
 class DependenceIterator
     : public llvm::iterator_facade_base<DependenceIterator,
                                         std::forward_iterator_tag, Dependence> {
@@ -113,6 +122,9 @@ private:
   unsigned auxPredIdx;
   llvm::SmallSetVector<Operation *, 4> *auxPreds;
 
+  const IndexedDependence *frozenDep;
+  const IndexedDependence *frozenEnd;
+
   Dependence dep;
 };
 
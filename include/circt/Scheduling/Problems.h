@@ -29,6 +29,65 @@
 namespace circt {
 namespace scheduling {
 
+namespace detail {
+
+/// Storage for a property of the operations or dependences of a problem. The
+/// values are kept in a hash map keyed by the component until the problem is
+/// finalized, and in a vector indexed by the components' dense indices
+/// afterwards.
+template <typename Key, typename T>
+class ComponentProperty {
+public:
+  Optional<T> lookup(const Key &key) const {
+    if (!indices)
+      return map.lookup(key);
+    auto it = indices->find(key);
+    if (it == indices->end())
+      return None;
+    return values[it->second];
+  }
+
+  Optional<T> &operator[](const Key &key) {
+    if (!indices)
+      return map[key];
+    auto it = indices->find(key);
+    assert(it != indices->end() && "not a component of the finalized problem");
+    return values[it->second];
+  }
+
+  /// Access the value of the component with the dense index \p idx. Only
+  /// valid after finalization.
+  Optional<T> &at(unsigned idx) {
+    assert(indices && "problem is not finalized");
+    return values[idx];
+  }
+
+  void clear() {
+    map.clear();
+    values.assign(values.size(), None);
+  }
+
+  /// Move the values into the vector, indexed according to \p newIndices.
+  /// Values of keys without an index are dropped.
+  void freeze(const llvm::DenseMap<Key, unsigned> &newIndices) {
+    values.assign(newIndices.size(), None);
+    for (auto &entry : map) {
+      auto it = newIndices.find(entry.first);
+      if (it != newIndices.end())
+        values[it->second] = entry.second;
+    }
+    map.clear();
+    indices = &newIndices;
+  }
+
+private:
+  llvm::DenseMap<Key, Optional<T>> map;
+  SmallVector<Optional<T>, 0> values;
+  const llvm::DenseMap<Key, unsigned> *indices = nullptr;
+};
+
+} // namespace detail
+
 /// This class models the most basic scheduling problem.
 ///
 /// A problem instance is comprised of:
@@ -73,6 +132,15 @@ namespace scheduling {
 /// a concrete scheduling algorithm, e.g. that there are start times available
 /// for each registered operation, and the precedence constraints as modeled by
 /// the dependences are satisfied.
+///
+/// Once constructed, a problem can be *finalized*. This assigns dense indices
+/// to the operations (their position in the operation set) and dependences,
+/// stores the operation and dependence properties in vectors indexed by them,
+/// and lays out the dependences of each operation contiguously. Schedulers use
+/// the index-based accessors of the finalized problem to avoid hashing in
+/// their inner loops. No operations or dependences can be inserted afterwards.
+/// Subclasses declaring additional operation or dependence properties must
+/// override `finalize` to freeze them.
 class Problem {
 public:
   /// Initialize a scheduling problem corresponding to \p containingOp.
@@ -99,15 +167,16 @@ public:
   using OperationSet = llvm::SetVector<Operation *>;
   using DependenceRange = llvm::iterator_range<detail::DependenceIterator>;
   using OperatorTypeSet = llvm::SetVector<OperatorType>;
+  using IndexedDependence = detail::IndexedDependence;
 
 protected:
   using AuxDependenceMap =
       llvm::DenseMap<Operation *, llvm::SmallSetVector<Operation *, 4>>;
 
   template <typename T>
-  using OperationProperty = llvm::DenseMap<Operation *, Optional<T>>;
+  using OperationProperty = detail::ComponentProperty<Operation *, T>;
   template <typename T>
-  using DependenceProperty = llvm::DenseMap<Dependence, Optional<T>>;
+  using DependenceProperty = detail::ComponentProperty<Dependence, T>;
   template <typename T>
   using OperatorTypeProperty = llvm::DenseMap<OperatorType, Optional<T>>;
   template <typename T>
@@ -133,12 +202,24 @@ private:
   // Pperator type properties
   OperatorTypeProperty<unsigned> latency;
 
+  // Finalized form
+  bool finalized = false;
+  SmallVector<IndexedDependence, 0> indexedDependences;
+  SmallVector<unsigned, 0> dependenceOffsets;
+
+protected:
+  llvm::DenseMap<Operation *, unsigned> operationIndices;
+  llvm::DenseMap<Dependence, unsigned> dependenceIndices;
+
   //===--------------------------------------------------------------------===//
   // Problem construction
   //===--------------------------------------------------------------------===//
 public:
   /// Include \p op in this scheduling problem.
-  void insertOperation(Operation *op) { operations.insert(op); }
+  void insertOperation(Operation *op) {
+    assert(!finalized && "problem is finalized");
+    operations.insert(op);
+  }
 
   /// Include \p dep in the scheduling problem. Return failure if \p dep does
   /// not represent a valid def-use or auxiliary dependence between operations.
@@ -210,6 +291,46 @@ public:
   /// Clear all properties that are part of the solution.
   virtual void clearSolution() { startTime.clear(); }
 
+  //===--------------------------------------------------------------------===//
+  // Finalized form
+  //===--------------------------------------------------------------------===//
+public:
+  /// Assign dense indices to the operations and dependences, and switch the
+  /// property storage to vectors indexed by them.
+  virtual void finalize();
+  bool isFinalized() { return finalized; }
+
+  /// Return the dense index of \p op, which must be part of the finalized
+  /// problem.
+  unsigned getOperationIndex(Operation *op) {
+    assert(finalized && "problem is not finalized");
+    assert(operationIndices.count(op) && "unknown operation");
+    return operationIndices.lookup(op);
+  }
+
+  /// Return the number of dependences in the finalized problem.
+  unsigned getNumDependences() {
+    assert(finalized && "problem is not finalized");
+    return indexedDependences.size();
+  }
+
+  /// Return the dependences whose destination is the operation with index
+  /// \p opIdx, in the same order as `getDependences`.
+  ArrayRef<IndexedDependence> getIndexedDependences(unsigned opIdx) {
+    assert(finalized && "problem is not finalized");
+    return ArrayRef<IndexedDependence>(indexedDependences)
+        .slice(dependenceOffsets[opIdx],
+               dependenceOffsets[opIdx + 1] - dependenceOffsets[opIdx]);
+  }
+
+  /// Access the start time of the operation with index \p opIdx.
+  Optional<unsigned> getStartTimeAt(unsigned opIdx) {
+    return startTime.at(opIdx);
+  }
+  void setStartTimeAt(unsigned opIdx, unsigned val) {
+    startTime.at(opIdx) = val;
+  }
+
   //===--------------------------------------------------------------------===//
   // Hooks to check/verify the different problem components
   //===--------------------------------------------------------------------===//
@@ -231,6 +352,111 @@ public:
   LogicalResult verify();
 };
 
+/// This class models a cyclic scheduling problem. Its solution can be used to
+/// construct a pipelined datapath with a fixed, integer initiation interval
+/// (II), in which the executions of multiple iterations/samples/etc. overlap.
+/// Operator types are assumed to be fully pipelined.
+///
+/// The dependence graph may contain cycles, as long as each of them contains a
+/// *loop-carried* dependence, i.e. one with a non-zero distance:
+///
+/// - `distance`, a dependence-property denoting the number of iterations
+///   between the source of the dependence producing a value, and the
+///   destination consuming it. Dependences without a distance are treated as
+///   having a distance of 0.
+/// - `initiationInterval`, a problem-property denoting the number of time
+///   steps between the start of consecutive iterations. Together with the
+///   start times, it is part of the solution.
+class CyclicProblem : public virtual Problem {
+public:
+  CyclicProblem(Operation *containingOp) : Problem(containingOp) {}
+
+private:
+  DependenceProperty<unsigned> distance;
+  ProblemProperty<unsigned> initiationInterval;
+
+public:
+  /// The distance determines whether a dependence has to be satisfied in the
+  /// same iteration (distance=0 or not set), or distance-many iterations
+  /// later.
+  Optional<unsigned> getDistance(Dependence dep) {
+    return distance.lookup(dep);
+  }
+  void setDistance(Dependence dep, unsigned val) { distance[dep] = val; }
+  /// Access the distance of the dependence with index \p depIdx.
+  Optional<unsigned> getDistanceAt(unsigned depIdx) {
+    return distance.at(depIdx);
+  }
+
+  /// The initiation interval (II) is the number of time steps between
+  /// subsequent iterations, i.e. a new iteration is started every II time
+  /// steps. The best possible value is 1, which means that a new iteration
+  /// can start in every time step.
+  Optional<unsigned> getInitiationInterval() { return initiationInterval; }
+  void setInitiationInterval(unsigned val) { initiationInterval = val; }
+
+  virtual void clearSolution() override {
+    Problem::clearSolution();
+    initiationInterval.reset();
+  }
+
+  virtual void finalize() override;
+
+protected:
+  /// Return success if the solution contains a non-zero II.
+  LogicalResult verifyInitiationInterval();
+
+  virtual LogicalResult verifyDependence(Dependence dep) override;
+  virtual LogicalResult verifyProblem() override;
+};
+
+/// This class models a resource-constrained scheduling problem. An operator
+/// type can be marked as a limited resource, e.g. the DSP blocks implementing
+/// the multipliers of a datapath:
+///
+/// - `limit`, an operator type-property denoting the maximum number of
+///   operations of that type that can be started in the same time step.
+///   Operator types without a limit are unlimited.
+///
+/// Operator types are assumed to be fully pipelined, i.e. an instance of a
+/// limited operator type is only occupied in the time step in which an
+/// operation is started on it.
+class SharedOperatorsProblem : public virtual Problem {
+public:
+  SharedOperatorsProblem(Operation *containingOp) : Problem(containingOp) {}
+
+private:
+  OperatorTypeProperty<unsigned> limit;
+
+public:
+  /// The limit is the maximum number of operations using \p opr that can be
+  /// started in the same time step.
+  Optional<unsigned> getLimit(OperatorType opr) { return limit.lookup(opr); }
+  void setLimit(OperatorType opr, unsigned val) { limit[opr] = val; }
+
+protected:
+  virtual LogicalResult checkOperatorType(OperatorType opr) override;
+  virtual LogicalResult verifyOperatorType(OperatorType opr) override;
+};
+
+/// This class models the modulo scheduling problem: a cyclic problem in which
+/// the operator types are shared between the overlapping iterations.
+///
+/// A solution is valid if, for every limited operator type, the number of
+/// operations started in each congruence class of time steps modulo the II
+/// does not exceed the limit, i.e. the operations fit into a *modulo
+/// reservation table*.
+class ModuloProblem : public virtual CyclicProblem,
+                      public virtual SharedOperatorsProblem {
+public:
+  ModuloProblem(Operation *containingOp)
+      : Problem(containingOp), CyclicProblem(containingOp),
+        SharedOperatorsProblem(containingOp) {}
+
+protected:
+  virtual LogicalResult verifyOperatorType(OperatorType opr) override;
+};
+
 } // namespace scheduling
 } // namespace circt
 
@@ -34,6 +34,10 @@ class Backedge;
 /// this class is destructed, usually at the end of a scope. It will check that
 /// invariant then erase all the backedge ops during destruction.
 ///
+/// The placeholder op of a backedge which has been assigned is reused for the
+/// next backedge of the same type built in the same block, so a builder which
+/// resolves its backedges as it goes only creates a handful of placeholders.
+///
 /// Example use:
 /// ```
 ///   circt::BackedgeBuilder back(rewriter, loc);
@@ -56,27 +60,42 @@ public:
   /// Create a typed backedge.
   Backedge get(mlir::Type resultType);
 
+  /// Return the number of placeholder ops created by this builder.
+  size_t getNumPlaceholders() const { return edges.size(); }
+
 private:
+  /// Make the placeholder of an assigned backedge available for reuse.
+  void release(mlir::Operation *op) { freeEdges.push_back(op); }
+
   mlir::OpBuilder &builder;
   mlir::PatternRewriter *rewriter;
   mlir::Location loc;
   llvm::SmallVector<mlir::Operation *, 16> edges;
+  /// The placeholders which are no longer used by any backedge.
+  llvm::SmallVector<mlir::Operation *, 4> freeEdges;
 };
 
 /// `Backedge` is a wrapper class around a `Value`. When assigned another
 /// `Value`, it replaces all uses of itself with the new `Value` then become a
-/// wrapper around the new `Value`.
+/// wrapper around the new `Value`.  Since the placeholder may then be reused,
+/// a backedge can be moved but not copied.
 class Backedge {
   friend class BackedgeBuilder;
 
   /// `Backedge` is constructed exclusively by `BackedgeBuilder`.
-  Backedge(mlir::Operation *op);
+  Backedge(BackedgeBuilder *owner, mlir::Operation *op);
 
 public:
+  Backedge(const Backedge &) = delete;
+  Backedge &operator=(const Backedge &) = delete;
+  Backedge(Backedge &&other);
+  Backedge &operator=(Backedge &&other);
+
   operator mlir::Value();
   void setValue(mlir::Value);
 
 private:
+  BackedgeBuilder *owner;
   mlir::Value value;
 };
 
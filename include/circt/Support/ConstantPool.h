@@ -0,0 +1,74 @@
+//===- ConstantPool.h - Share the constants of a block ----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pool of constants for lowerings which create many
+// copies of the same few constants.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_SUPPORT_CONSTANTPOOL_H
+#define CIRCT_SUPPORT_CONSTANTPOOL_H
+
+#include "mlir/IR/Attributes.h"
+#include "mlir/IR/Types.h"
+#include "mlir/IR/Value.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+
+namespace mlir {
+class Block;
+class OpBuilder;
+class Operation;
+} // namespace mlir
+
+namespace circt {
+
+/// A pool of the constants of a block, usually the body of a module.  Each
+/// constant is created once at the start of the block, keyed on its value and
+/// type, and then shared by all of its users, rather than being created next
+/// to each user and merged by CSE afterwards.
+///
+/// The pooled constants must not be erased while the pool is in use.
+///
+/// Example use:
+/// ```
+///   circt::ConstantPool pool(module.getBodyBlock());
+///   Value zero = pool.getOrCreate(builder, attr, attr.getType(), [&] {
+///     return builder.create<hw::ConstantOp>(loc, attr);
+///   });
+/// ```
+class ConstantPool {
+public:
+  explicit ConstantPool(mlir::Block *block) : block(block) {}
+
+  /// Return the pooled constant with `value` and `type`, or a null value.
+  mlir::Value lookup(mlir::Attribute value, mlir::Type type) const {
+    return constants.lookup({value, type});
+  }
+
+  /// Return the pooled constant with `value` and `type`.  If there is none
+  /// yet, move the insertion point of `builder` to the start of the block and
+  /// call `create` to build it.
+  mlir::Value getOrCreate(mlir::OpBuilder &builder, mlir::Attribute value,
+                          mlir::Type type,
+                          llvm::function_ref<mlir::Value()> create);
+
+  /// Add the constant `op`, e.g. the result of folding, to the pool.  If the
+  /// pool already has the same constant, `op` is erased and the pooled one is
+  /// returned.  Otherwise `op` is moved to the start of the block.
+  mlir::Value insert(mlir::Operation *op);
+
+private:
+  mlir::Block *block;
+  llvm::DenseMap<std::pair<mlir::Attribute, mlir::Type>, mlir::Value>
+      constants;
+};
+
+} // namespace circt
+
+#endif // CIRCT_SUPPORT_CONSTANTPOOL_H
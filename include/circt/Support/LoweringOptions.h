@@ -61,6 +61,27 @@ struct LoweringOptions {
   /// This is the target width of lines in an emitted verilog source file in
   /// columns.
   unsigned emittedLineLength = 90;
+
+  /// If true, ExportVerilog doesn't print the location of each statement as a
+  /// comment after it.
+  bool disallowLocationInfo = false;
+
+  /// The maximum number of muxes nested into each other in one emitted
+  /// expression, or zero for no limit.  Longer chains of ternary operators are
+  /// broken up with wires.
+  unsigned maximumMuxChainDepth = 0;
+
+  /// If true, the terms which recur among the variadic commutative operations
+  /// of a block, once they are balanced into binary trees, are computed once
+  /// and shared, at the cost of a temporary wire each.
+  bool shareVariadicSubterms = false;
+
+  /// Set the options of an emission profile, a named set of options tuned for
+  /// one consumer of the Verilog.  The `simulator` profile aims at fast
+  /// simulator builds: it breaks up deep ternary chains, which simulators
+  /// compile slowly, and drops the location comments.  Returns false if the
+  /// profile is unknown.
+  bool applyProfile(StringRef profile);
 };
 
 /// Register commandline options for the verilog emitter.
@@ -26,7 +26,8 @@ class OperationPass;
 
 namespace circt {
 
-std::unique_ptr<mlir::Pass> createSimpleCanonicalizerPass();
+std::unique_ptr<mlir::Pass>
+createSimpleCanonicalizerPass(bool incremental = false);
 
 /// Generate the code for registering passes.
 #define GEN_PASS_REGISTRATION
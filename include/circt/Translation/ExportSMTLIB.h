@@ -0,0 +1,38 @@
+//===- ExportSMTLIB.h - SMT-LIB Exporter ------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the interface to the SMT-LIB emitter.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_TRANSLATION_EXPORTSMTLIB_H
+#define CIRCT_TRANSLATION_EXPORTSMTLIB_H
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace mlir {
+struct LogicalResult;
+class ModuleOp;
+} // namespace mlir
+
+namespace circt {
+
+/// Export each hw.module of combinational logic with a single i1 output as an
+/// SMT-LIB 2 query, in the QF_BV logic, which is satisfiable if and only if
+/// the output can be 1.  Applied to the miters built by `-hw-miter`, an
+/// `unsat` answer proves the compared modules equivalent.
+mlir::LogicalResult exportSMTLIB(mlir::ModuleOp module, llvm::raw_ostream &os);
+
+/// Register a translation for exporting HW and Comb to SMT-LIB.
+void registerToSMTLIBTranslation();
+
+} // namespace circt
+
+#endif // CIRCT_TRANSLATION_EXPORTSMTLIB_H
@@ -14,29 +14,110 @@
 #define CIRCT_TRANSLATION_EXPORTVERILOG_H
 
 #include <functional>
+#include <string>
+#include <vector>
 
 namespace llvm {
 class raw_ostream;
 class StringRef;
+template <typename Fn>
+class function_ref;
 } // namespace llvm
 
 namespace mlir {
 struct LogicalResult;
 class ModuleOp;
+class TimingScope;
 } // namespace mlir
 
 namespace circt {
 
+/// Statistics gathered while exporting Verilog, one entry per emitted
+/// hw.module.
+struct ExportVerilogStatistics {
+  struct ModuleStatistics {
+    /// The name of the module.
+    std::string name;
+    /// The number of bytes of Verilog emitted for the module.
+    size_t bytesEmitted = 0;
+    /// The number of temporaries introduced to break up expressions which
+    /// grew too long.
+    size_t temporaries = 0;
+    /// The number of expressions emitted out of line into their own wire.
+    size_t spilledWires = 0;
+    /// The time spent emitting the module.
+    double seconds = 0;
+  };
+
+  /// The modules, sorted by name.
+  std::vector<ModuleStatistics> modules;
+
+  /// The number of split files copied from a `SplitVerilogCache` rather than
+  /// emitted.  Their modules are not listed above.
+  size_t cachedFiles = 0;
+
+  /// Print the statistics as a JSON object.
+  void printJSON(llvm::raw_ostream &os) const;
+};
+
 /// Export a module containing HW, and SV dialect code. Requires that the SV
 /// dialect is loaded in to the context.
-mlir::LogicalResult exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os);
+///
+/// If \p ts is set, the phases of the emission are timed under it.  If
+/// \p statistics is set, it is filled in with the statistics of each module.
+mlir::LogicalResult
+exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os,
+              mlir::TimingScope *ts = nullptr,
+              ExportVerilogStatistics *statistics = nullptr);
+
+/// Export a module like `exportVerilog` above, but hand the output to
+/// \p callback instead of writing it to a stream.  The output is buffered, so
+/// that the callback receives a few chunks of about \p chunkSize bytes rather
+/// than every small piece the emitter prints.  This lets embedding tools pass
+/// the output on to a file descriptor or a compressor without much overhead.
+mlir::LogicalResult
+exportVerilog(mlir::ModuleOp module,
+              llvm::function_ref<void(llvm::StringRef)> callback,
+              size_t chunkSize = 1 << 16, mlir::TimingScope *ts = nullptr,
+              ExportVerilogStatistics *statistics = nullptr);
+
+/// A directory of files emitted by earlier runs of `exportSplitVerilog`.
+///
+/// Each file holding modules or interfaces is keyed on its name, the printed
+/// operations in it, the ports and names of the modules they instantiate, the
+/// lowering options and the salt.  A file whose key is found in the directory
+/// is copied from there instead of emitted, so that only the modules changed
+/// since an earlier run are prepared and emitted again.  The bind files are
+/// always emitted, since they look into other modules.
+struct SplitVerilogCache {
+  std::string directory;
+  /// Identifies the emitter, so that the entries of another version of it are
+  /// never reused.
+  std::string salt;
+};
 
 /// Export a module containing HW, and SV dialect code, as one file per SV
 /// module. Requires that the SV dialect is loaded in to the context.
 ///
-/// Files are created in the directory indicated by \p dirname.
-mlir::LogicalResult exportSplitVerilog(mlir::ModuleOp module,
-                                       llvm::StringRef dirname);
+/// Files are created in the directory indicated by \p dirname.  If
+/// \p releaseModules is set, the body of each module is dropped as soon as its
+/// file has been written, which keeps the peak memory use down on large
+/// designs; the module is left invalid and may only be destroyed afterwards.
+///
+/// If \p incremental is set, the hash of each file's contents is recorded in
+/// `filelist.md5` next to `filelist.f`, and files whose contents match the
+/// hash recorded by the previous run are not rewritten.
+///
+/// If \p cache is set, the unchanged files are copied from it, and the
+/// emitted ones are added to it.
+///
+/// \p ts and \p statistics are used like in `exportVerilog`.
+mlir::LogicalResult
+exportSplitVerilog(mlir::ModuleOp module, llvm::StringRef dirname,
+                   bool releaseModules = false, bool incremental = false,
+                   mlir::TimingScope *ts = nullptr,
+                   ExportVerilogStatistics *statistics = nullptr,
+                   const SplitVerilogCache *cache = nullptr);
 
 /// Register a translation for exporting HW, Comb and SV to SystemVerilog.
 void registerToVerilogTranslation();
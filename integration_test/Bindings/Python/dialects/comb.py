@@ -181,6 +181,14 @@ with Context() as ctx, Location.unknown():
       # CHECK: comb.mux %[[BIT]], %[[CONST]], %[[CONST]]
       comb.MuxOp.create(i32, bit.result, const.result, const.result)
 
+      # CHECK: [[SUM0:%.+]] = comb.add %[[CONST]], %[[CONST]] : i32
+      # CHECK: [[SUM1:%.+]] = comb.add [[SUM0]], %[[CONST]] : i32
+      # CHECK: comb.xor [[SUM1]], [[SUM0]] : i32
+      sums = comb.create_ops("comb.add", module.operation, [const.result],
+                             [0, 0, 1, 0], 2)
+      comb.create_ops("comb.xor", module.operation,
+                      [sums[0].result, sums[1].result], [1, 0], 2)
+
     hw.HWModuleOp(name="test", body_builder=build)
 
   print(m)
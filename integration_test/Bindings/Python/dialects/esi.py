@@ -55,6 +55,13 @@ acc.print()
 print()  # Newline.
 # CHECK: hw.module.extern @IntAccumulator(%clk: i1, %ints: i32, %ints_valid: i1) -> (%ints_ready: i1, %sum: i32)
 
+mods = esisys.lookup_many(["IntAccumulator", "MyWidget", "IntProducer"])
+for mod in mods:
+  print(mod.attributes["sym_name"])
+# CHECK: "IntAccumulator"
+# CHECK: "MyWidget"
+# CHECK: "IntProducer"
+
 esisys.print()
 # CHECK-LABEL:  hw.module @MyWidget_esi(%foo: !esi.channel<i32>) {
 # CHECK-NEXT:     %rawOutput, %valid = esi.unwrap.vr %foo, %pearl.foo_ready : i32
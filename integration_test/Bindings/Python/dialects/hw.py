@@ -63,3 +63,28 @@ with Context() as ctx, Location.unknown():
   print(typeAlias.inner_type)
   print(typeAlias.scope)
   print(typeAlias.name)
+
+  # Bulk construction of instances.
+  m = Module.create()
+  with InsertionPoint(m.body):
+    leaf = hw.HWModuleOp(name="leaf",
+                         input_ports=[("a", i32)],
+                         output_ports=[("b", i32)],
+                         body_builder=lambda mod: {"b": mod.a})
+
+    def build_top(module):
+      insts = leaf.create_instances(["l0", "l1", "l2"],
+                                    [[module.x], [module.x], [module.x]])
+      return {"y": insts[2].results[0]}
+
+    hw.HWModuleOp(name="top",
+                  input_ports=[("x", i32)],
+                  output_ports=[("y", i32)],
+                  body_builder=build_top)
+
+  # CHECK-LABEL: hw.module @top(%x: i32) -> (%y: i32)
+  # CHECK-NEXT:    {{%.+}} = hw.instance "l0" @leaf(%x) : (i32) -> i32
+  # CHECK-NEXT:    {{%.+}} = hw.instance "l1" @leaf(%x) : (i32) -> i32
+  # CHECK-NEXT:    [[L2:%.+]] = hw.instance "l2" @leaf(%x) : (i32) -> i32
+  # CHECK-NEXT:    hw.output [[L2]] : i32
+  print(m)
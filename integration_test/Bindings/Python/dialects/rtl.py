@@ -8,7 +8,9 @@ from circt.dialects import hw
 from mlir.ir import *
 from mlir.passmanager import PassManager
 
+import os
 import sys
+import tempfile
 
 with Context() as ctx, Location.unknown():
   circt.register_dialects(ctx)
@@ -131,3 +133,29 @@ with Context() as ctx, Location.unknown():
   # CHECK: module swap
   # CHECK: module top
   circt.export_verilog(m, sys.stdout)
+
+  # CHECK-LABEL: === Verilog to a file descriptor ===
+  # CHECK: module MyWidget
+  # CHECK: module top
+  print("=== Verilog to a file descriptor ===")
+  sys.stdout.flush()
+  circt.export_verilog(m, sys.stdout.fileno())
+
+  # CHECK-LABEL: === Verilog to a file path ===
+  # CHECK: module MyWidget
+  # CHECK: module top
+  print("=== Verilog to a file path ===")
+  with tempfile.TemporaryDirectory() as tmpdir:
+    path = os.path.join(tmpdir, "out.sv")
+    circt.export_verilog(m, path)
+    with open(path) as f:
+      print(f.read())
+
+  # CHECK-LABEL: === Split Verilog ===
+  # CHECK: MyWidget.sv
+  # CHECK: top.sv
+  print("=== Split Verilog ===")
+  with tempfile.TemporaryDirectory() as tmpdir:
+    circt.export_split_verilog(m, tmpdir)
+    with open(os.path.join(tmpdir, "filelist.f")) as f:
+      print(f.read())
@@ -0,0 +1,59 @@
+# REQUIRES: bindings_python
+# RUN: %PYTHON% %s | FileCheck %s
+
+import circt
+
+from mlir.ir import *
+
+import os
+import tempfile
+
+circuit = """
+circuit Top :
+  module Top :
+    input a : UInt<4>
+    input b : UInt<4>
+    output c : UInt<5>
+    c <= add(a, b)
+"""
+
+with Context() as ctx, Location.unknown():
+  # CHECK-LABEL: === Verilog ===
+  # CHECK: module Top(
+  # CHECK: assign c =
+  print("=== Verilog ===")
+  print(circt.compile_firrtl(circuit))
+
+  # CHECK-LABEL: === MLIR ===
+  # CHECK: firrtl.circuit "Top"
+  print("=== MLIR ===")
+  print(circt.compile_firrtl(circuit, output_format="mlir"))
+
+  # CHECK-LABEL: === Module ===
+  # CHECK: hw.module @Top
+  print("=== Module ===")
+  module = circt.compile_firrtl_to_module(circuit, lower_to_hw=True)
+  print(module)
+
+  # CHECK-LABEL: === Split Verilog ===
+  # CHECK: Top.sv
+  print("=== Split Verilog ===")
+  with tempfile.TemporaryDirectory() as tmpdir:
+    circt.compile_firrtl(circuit,
+                         output_format="split-verilog",
+                         output_directory=tmpdir)
+    with open(os.path.join(tmpdir, "filelist.f")) as f:
+      print(f.read())
+
+  # CHECK-LABEL: === Timing ===
+  # CHECK: FIR Parser
+  print("=== Timing ===")
+  circt.compile_firrtl(circuit, timing=print)
+
+  # CHECK-LABEL: === Errors ===
+  # CHECK: unknown firtool option 'no_such_option'
+  print("=== Errors ===")
+  try:
+    circt.compile_firrtl(circuit, no_such_option=True)
+  except TypeError as e:
+    print(e)
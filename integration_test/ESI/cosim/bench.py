@@ -0,0 +1,21 @@
+#!/usr/bin/python3
+
+import json
+import subprocess
+
+
+def run(endpoints, first_endpoint, size, messages=200):
+  """Run esi-cosim-bench against the endpoints of the running simulation, on
+     whichever transport it serves, and print its results."""
+  cmd = [
+      "esi-cosim-bench", "--connect", f"--endpoints={endpoints}",
+      f"--first-endpoint={first_endpoint}", f"--size={size}",
+      f"--latency-messages={messages}", f"--throughput-messages={messages * 4}"
+  ]
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          universal_newlines=True,
+                          check=True)
+  print(result.stdout)
+  stats = json.loads(result.stdout)
+  assert stats["msgs_per_sec"] > 0
@@ -0,0 +1,73 @@
+// REQUIRES: esi-cosim
+// RUN: esi-cosim-runner.py %s %s
+// RUN: esi-cosim-runner.py --shm %s %s
+// PY: import bench
+// PY: bench.run(endpoints=1, first_endpoint=1, size=8)
+// PY: bench.run(endpoints=4, first_endpoint=1, size=8)
+// PY: bench.run(endpoints=2, first_endpoint=11, size=256)
+
+// Loopback endpoints for esi-cosim-bench, which loads them with messages of
+// UntypedData. Endpoints 1 to 4 carry 8 bytes of data, and endpoints 11 and 12
+// carry 256 bytes.
+
+import Cosim_DpiPkg::*;
+
+module BenchLoopback #(
+    parameter int ENDPOINT_ID = -1,
+    parameter int DATA_BYTES = -1
+) (
+    input logic clk,
+    input logic rstn
+);
+    localparam int TYPE_SIZE_BITS =
+        (1 * 64) + // root message
+        (1 * 64) + // data pointer
+        (((DATA_BYTES + 7) / 8) * 64); // data, rounded up to 8 bytes
+
+    wire DataOutValid;
+    wire DataOutReady = 1;
+    wire [TYPE_SIZE_BITS-1:0] DataOut;
+
+    logic DataInValid;
+    logic DataInReady;
+    logic [TYPE_SIZE_BITS-1:0] DataIn;
+
+    Cosim_Endpoint #(
+        .ENDPOINT_ID(ENDPOINT_ID),
+        .RECV_TYPE_ID(1),
+        .RECV_TYPE_SIZE_BITS(TYPE_SIZE_BITS),
+        .SEND_TYPE_ID(1),
+        .SEND_TYPE_SIZE_BITS(TYPE_SIZE_BITS)
+    ) ep (
+        .*
+    );
+
+    always@(posedge clk)
+    begin
+        if (rstn)
+        begin
+            if (DataOutValid && DataOutReady)
+                DataIn <= DataOut;
+            DataInValid <= DataOutValid && DataOutReady;
+        end
+        else
+        begin
+            DataInValid <= 0;
+        end
+    end
+endmodule
+
+module top(
+    input logic clk,
+    input logic rstn
+);
+    genvar i;
+    generate
+        for (i = 0; i < 4; i++)
+            BenchLoopback #(.ENDPOINT_ID(1 + i), .DATA_BYTES(8))
+                small (.*);
+        for (i = 0; i < 2; i++)
+            BenchLoopback #(.ENDPOINT_ID(11 + i), .DATA_BYTES(256))
+                large (.*);
+    endgenerate
+endmodule
@@ -1,6 +1,8 @@
 #!/usr/bin/python3
 
+import asyncio
 import capnp
+import collections
 import time
 
 
@@ -31,6 +33,11 @@ class CosimBase:
         return openResp.iface
     assert False, "Could not find specified EndpointID"
 
+  def openAsyncEP(self, recvType, epNum=1, sendType=None, **kwargs):
+    """Open the endpoint like openEP, to be used from asyncio"""
+    ep = self.openEP(epNum, sendType=sendType, recvType=recvType)
+    return AsyncEndpoint(ep, recvType, **kwargs)
+
   def readMsg(self, ep, expectedType):
     """Cosim doesn't currently support blocking reads. Implement a blocking
            read via polling."""
@@ -42,3 +49,77 @@ class CosimBase:
         time.sleep(0.01)
     assert recvResp.resp is not None
     return recvResp.resp.as_struct(expectedType)
+
+
+class AsyncEndpoint:
+  """Drives an open endpoint from asyncio. The requests are pipelined rather
+     than waited for one by one, and the batches of messages go in one request
+     each, so that the client keeps up with the endpoint queues instead of
+     paying a round trip per message."""
+
+  def __init__(self, ep, recvType, batchSize=256, pollInterval=0.001):
+    self.ep = ep
+    self.recvType = recvType
+    self.batchSize = batchSize
+    self.pollInterval = pollInterval
+    self.pendingSends = []
+    self.received = collections.deque()
+    self.lastFuture = None
+
+  def send(self, msg):
+    """Send a message without waiting for the server. See flush."""
+    self.pendingSends.append(self.ep.send(msg))
+
+  async def flush(self):
+    """Wait for the server to have queued all the messages sent."""
+    pending, self.pendingSends = self.pendingSends, []
+    for promise in pending:
+      await promise.a_wait()
+
+  async def send_batch(self, msgs):
+    """Send the messages batchSize at a time, in order, retrying the ones the
+       full queue of the endpoint didn't take"""
+    data = [msg.to_bytes() for msg in msgs]
+    while data:
+      resp = await self.ep.sendBatch(data[:self.batchSize]).a_wait()
+      data = data[resp.accepted:]
+      if resp.accepted == 0:
+        await asyncio.sleep(self.pollInterval)
+
+  async def recv_batch(self, maxMsgs=None):
+    """Receive the messages available, at most maxMsgs, without blocking"""
+    if maxMsgs is None:
+      maxMsgs = self.batchSize
+    msgs = []
+    while self.received and len(msgs) < maxMsgs:
+      msgs.append(self.received.popleft())
+    if len(msgs) < maxMsgs:
+      resp = await self.ep.recvBatch(maxMsgs - len(msgs)).a_wait()
+      msgs.extend(self.recvType.from_segments([data]) for data in resp.resps)
+    return msgs
+
+  async def recv(self):
+    """Receive the next message, polling the endpoint until there is one. The
+       messages fetched along with it are kept for the next calls."""
+    while not self.received:
+      self.received.extend(await self.recv_batch())
+      if not self.received:
+        await asyncio.sleep(self.pollInterval)
+    return self.received.popleft()
+
+  def recv_future(self):
+    """Return a future of the next message. Each future waits for the previous
+       one, so that they get the messages in the order they were requested."""
+    previous = self.lastFuture
+
+    async def next_msg():
+      if previous is not None:
+        await previous
+      return await self.recv()
+
+    self.lastFuture = asyncio.ensure_future(next_msg())
+    return self.lastFuture
+
+  async def close(self):
+    await self.flush()
+    await self.ep.close().a_wait()
@@ -5,6 +5,7 @@
 // PY: import loopback as test
 // PY: rpc = test.LoopbackTester(rpcschemapath, simhostport)
 // PY: rpc.test_i32(25)
+// PY: rpc.test_i32_async(100)
 // PY: rpc.test_keytext(25)
 
 hw.module @intLoopback(%clk:i1, %rstn:i1) -> () {
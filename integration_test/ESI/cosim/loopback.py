@@ -1,5 +1,6 @@
 #!/usr/bin/python3
 
+import asyncio
 import binascii
 import random
 import cosim
@@ -29,6 +30,21 @@ class LoopbackTester(cosim.CosimBase):
       print(f"Got {result}")
       assert (result.i == data)
 
+  def test_i32_async(self, num_msgs):
+    """Send all the messages in batches before receiving any of them."""
+
+    async def run():
+      ep = self.openAsyncEP(sendType=self.schema.I32,
+                            recvType=self.schema.I32)
+      data = [random.randint(0, 2**32 - 1) for _ in range(num_msgs)]
+      futures = [ep.recv_future() for _ in range(num_msgs)]
+      await ep.send_batch([self.schema.I32.new_message(i=d) for d in data])
+      results = [msg.i for msg in await asyncio.gather(*futures)]
+      await ep.close()
+      assert results == data
+
+    asyncio.run(run())
+
   def write_3bytes(self, ep):
     r = random.randrange(0, 2**24)
     data = r.to_bytes(3, 'big')
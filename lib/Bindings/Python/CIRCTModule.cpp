@@ -15,12 +15,14 @@
 #include "circt-c/Dialect/SV.h"
 #include "circt-c/Dialect/Seq.h"
 #include "circt-c/ExportVerilog.h"
+#include "circt-c/Firtool.h"
 #include "mlir-c/Bindings/Python/Interop.h"
 #include "mlir-c/Registration.h"
 #include "mlir/Bindings/Python/PybindAdaptors.h"
 
 #include "llvm-c/ErrorHandling.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "PybindUtils.h"
 #include <pybind11/pybind11.h>
@@ -31,6 +33,93 @@ static void registerPasses() {
   registerSVPasses();
 }
 
+static CirctFirtoolInputFormat getFirtoolInputFormat(const std::string &name) {
+  if (name == "fir")
+    return CirctFirtoolInputFIR;
+  if (name == "mlir")
+    return CirctFirtoolInputMLIR;
+  if (name == "firbc")
+    return CirctFirtoolInputFIRBytecode;
+  throw py::value_error("unknown input format '" + name +
+                        "', expected fir, mlir or firbc");
+}
+
+static CirctFirtoolOutputFormat
+getFirtoolOutputFormat(const std::string &name) {
+  if (name == "mlir")
+    return CirctFirtoolOutputMLIR;
+  if (name == "firbc")
+    return CirctFirtoolOutputFIRBytecode;
+  if (name == "verilog")
+    return CirctFirtoolOutputVerilog;
+  if (name == "split-verilog")
+    return CirctFirtoolOutputSplitVerilog;
+  if (name == "disable-output")
+    return CirctFirtoolOutputDisabled;
+  throw py::value_error("unknown output format '" + name +
+                        "', expected mlir, firbc, verilog, split-verilog or "
+                        "disable-output");
+}
+
+/// The firtool options given as keyword arguments, which the caller must
+/// destroy, and the output format among them, which defaults to Verilog.
+struct FirtoolKeywordOptions {
+  CirctFirtoolOptions options;
+  std::string outputFormat = "verilog";
+};
+
+static FirtoolKeywordOptions getFirtoolOptions(const py::kwargs &kwargs) {
+  FirtoolKeywordOptions result;
+  result.options = circtFirtoolOptionsCreateDefault();
+  auto options = result.options;
+  // The setters copy the strings.
+  auto setString = [&](void (*setter)(CirctFirtoolOptions, MlirStringRef),
+                       const std::string &value) {
+    setter(options, mlirStringRefCreate(value.data(), value.size()));
+  };
+  auto getPath = [](py::handle value) {
+    return py::module::import("os").attr("fspath")(value).cast<std::string>();
+  };
+  try {
+    for (auto item : kwargs) {
+      auto key = item.first.cast<std::string>();
+      auto value = item.second;
+      if (key == "output_format")
+        result.outputFormat = value.cast<std::string>();
+      else if (key == "disable_optimization")
+        circtFirtoolOptionsSetDisableOptimization(options, value.cast<bool>());
+      else if (key == "lower_to_hw")
+        circtFirtoolOptionsSetLowerToHW(options, value.cast<bool>());
+      else if (key == "dedup")
+        circtFirtoolOptionsSetDedup(options, value.cast<bool>());
+      else if (key == "inline")
+        circtFirtoolOptionsSetInline(options, value.cast<bool>());
+      else if (key == "preserve_aggregate")
+        circtFirtoolOptionsSetPreserveAggregate(options, value.cast<bool>());
+      else if (key == "black_box_root")
+        setString(circtFirtoolOptionsSetBlackBoxRootPath, getPath(value));
+      else if (key == "lowering_options")
+        setString(circtFirtoolOptionsSetLoweringOptions,
+                  value.cast<std::string>());
+      else if (key == "output_directory")
+        setString(circtFirtoolOptionsSetOutputDirectory, getPath(value));
+      else
+        throw py::type_error("unknown firtool option '" + key + "'");
+    }
+    circtFirtoolOptionsSetOutputFormat(
+        options, getFirtoolOutputFormat(result.outputFormat));
+  } catch (...) {
+    circtFirtoolOptionsDestroy(options);
+    throw;
+  }
+  return result;
+}
+
+/// Append a chunk of output to the `std::string` behind `userData`.
+static void appendToString(MlirStringRef chunk, void *userData) {
+  static_cast<std::string *>(userData)->append(chunk.data, chunk.length);
+}
+
 PYBIND11_MODULE(_circt, m) {
   m.doc() = "CIRCT Python Native Extension";
   registerPasses();
@@ -71,12 +160,139 @@ PYBIND11_MODULE(_circt, m) {
       },
       "Register CIRCT dialects on a PyMlirContext.");
 
-  m.def("export_verilog", [](MlirModule mod, py::object fileObject) {
-    circt::python::PyFileAccumulator accum(fileObject, false);
-    py::gil_scoped_release();
-    mlirExportVerilog(mod, accum.getCallback(), accum.getUserData());
-  });
+  m.def(
+      "export_verilog",
+      [](MlirModule mod, py::object fileObject) {
+        // Write straight to a file descriptor, without going through Python.
+        if (py::isinstance<py::int_>(fileObject)) {
+          llvm::raw_fd_ostream os(fileObject.cast<int>(),
+                                  /*shouldClose=*/false);
+          py::gil_scoped_release release;
+          mlirExportVerilog(
+              mod,
+              [](MlirStringRef chunk, void *userData) {
+                static_cast<llvm::raw_fd_ostream *>(userData)->write(
+                    chunk.data, chunk.length);
+              },
+              &os);
+          return;
+        }
+
+        // Open a file given by its path natively as well.
+        if (py::isinstance<py::str>(fileObject) ||
+            py::hasattr(fileObject, "__fspath__")) {
+          std::string path =
+              py::module::import("os").attr("fspath")(fileObject).cast<
+                  std::string>();
+          MlirLogicalResult result;
+          {
+            py::gil_scoped_release release;
+            result = mlirExportVerilogToFile(
+                mod, mlirStringRefCreate(path.data(), path.size()));
+          }
+          if (mlirLogicalResultIsFailure(result))
+            throw std::runtime_error("failed to export Verilog to " + path);
+          return;
+        }
+
+        circt::python::PyFileAccumulator accum(fileObject, false);
+        py::gil_scoped_release release;
+        mlirExportVerilog(mod, accum.getCallback(), accum.getUserData());
+      },
+      "Emit the Verilog of a module to a file object, file descriptor, or "
+      "file path. Only file objects hold the GIL while the output is "
+      "written.");
+
+  m.def(
+      "export_split_verilog",
+      [](MlirModule mod, py::object directory) {
+        std::string dirname =
+            py::module::import("os").attr("fspath")(directory).cast<
+                std::string>();
+        MlirLogicalResult result;
+        {
+          py::gil_scoped_release release;
+          result = mlirExportSplitVerilog(
+              mod, mlirStringRefCreate(dirname.data(), dirname.size()));
+        }
+        if (mlirLogicalResultIsFailure(result))
+          throw std::runtime_error("failed to export Verilog to " + dirname);
+      },
+      "Emit the Verilog of a module as one file per module in a directory, "
+      "with the GIL released.");
+
+  m.def(
+      "compile_firrtl",
+      [](const std::string &input, const std::string &inputFormat,
+         const std::string &annotations, py::object timing,
+         MlirContext context, py::kwargs kwargs) -> py::object {
+        auto format = getFirtoolInputFormat(inputFormat);
+        auto options = getFirtoolOptions(kwargs);
+        std::string report;
+        if (!timing.is_none())
+          circtFirtoolOptionsSetTimingCallback(options.options, appendToString,
+                                               &report);
+
+        std::string output;
+        MlirLogicalResult result;
+        {
+          py::gil_scoped_release release;
+          result = circtFirtoolCompile(
+              context, mlirStringRefCreate(input.data(), input.size()),
+              mlirStringRefCreate(annotations.data(), annotations.size()),
+              format, options.options, appendToString, &output);
+        }
+        circtFirtoolOptionsDestroy(options.options);
+        if (!timing.is_none())
+          timing(report);
+        if (mlirLogicalResultIsFailure(result))
+          throw std::runtime_error("failed to compile FIRRTL");
+
+        if (options.outputFormat == "split-verilog" ||
+            options.outputFormat == "disable-output")
+          return py::none();
+        if (options.outputFormat == "firbc")
+          return py::bytes(output);
+        return py::str(output);
+      },
+      py::arg("input"), py::arg("input_format") = "fir",
+      py::arg("annotations") = "", py::arg("timing") = py::none(),
+      py::arg("context") = py::none(),
+      "Compile FIRRTL in process with the firtool pipeline, with the GIL "
+      "released, and return the output, or None for split Verilog. The "
+      "keyword options are output_format (verilog by default), "
+      "disable_optimization, lower_to_hw, dedup, inline, preserve_aggregate, "
+      "black_box_root, lowering_options and output_directory. If given, "
+      "timing is called with the timing report.");
+
+  m.def(
+      "compile_firrtl_to_module",
+      [](const std::string &input, const std::string &inputFormat,
+         const std::string &annotations, MlirContext context,
+         py::kwargs kwargs) {
+        auto format = getFirtoolInputFormat(inputFormat);
+        auto options = getFirtoolOptions(kwargs);
+        MlirModule module;
+        {
+          py::gil_scoped_release release;
+          module = circtFirtoolCompileToModule(
+              context, mlirStringRefCreate(input.data(), input.size()),
+              mlirStringRefCreate(annotations.data(), annotations.size()),
+              format, options.options);
+        }
+        circtFirtoolOptionsDestroy(options.options);
+        if (mlirModuleIsNull(module))
+          throw std::runtime_error("failed to compile FIRRTL");
+        return module;
+      },
+      py::arg("input"), py::arg("input_format") = "fir",
+      py::arg("annotations") = "", py::arg("context") = py::none(),
+      "Compile FIRRTL like compile_firrtl, but return the module the "
+      "pipeline produced instead of emitting it. The output_format option "
+      "still selects the passes preparing the output.");
 
+  py::module comb = m.def_submodule("_comb", "Comb API");
+  circt::python::populateDialectCombSubmodule(comb);
   py::module esi = m.def_submodule("_esi", "ESI API");
   circt::python::populateDialectESISubmodule(esi);
   py::module msft = m.def_submodule("msft", "MSFT API");
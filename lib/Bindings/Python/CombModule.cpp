@@ -0,0 +1,59 @@
+//===- CombModule.cpp - Comb API pybind module ----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "DialectModules.h"
+
+#include "circt-c/Dialect/Comb.h"
+
+#include "mlir/Bindings/Python/PybindAdaptors.h"
+
+#include "PybindUtils.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+namespace py = pybind11;
+
+using namespace circt;
+
+/// Populate the comb python module.
+void circt::python::populateDialectCombSubmodule(py::module &m) {
+  m.doc() = "Comb dialect Python native extension";
+
+  m.def(
+      "create_ops",
+      [](std::string opName, MlirOperation parent, py::list values,
+         std::vector<intptr_t> operandIndices, intptr_t numOperands,
+         MlirLocation loc) {
+        if (numOperands < 1 || operandIndices.size() % numOperands != 0)
+          throw py::value_error("expected a multiple of num_operands indices");
+        std::vector<MlirValue> cValues;
+        cValues.reserve(values.size());
+        for (auto value : values)
+          cValues.push_back(python::getMlirValue(value));
+
+        size_t numOps = operandIndices.size() / numOperands;
+        std::vector<MlirValue> results(numOps);
+        if (!combCreateOps(python::getEntryBlock(parent), loc,
+                           mlirStringRefCreate(opName.data(), opName.size()),
+                           numOperands, cValues.size(), cValues.data(),
+                           numOps, operandIndices.data(), results.data()))
+          throw py::value_error("unknown operation or invalid operand index");
+
+        std::vector<MlirOperation> ops;
+        ops.reserve(numOps);
+        for (auto result : results)
+          ops.push_back(mlirOpResultGetOwner(result));
+        return ops;
+      },
+      "Create operations named `op_name` in `parent`, with `num_operands` "
+      "operands each. `operand_indices` holds the operands of each operation "
+      "in turn, as indices into `values` followed by the results of the "
+      "operations created before.",
+      py::arg("op_name"), py::arg("parent"), py::arg("values"),
+      py::arg("operand_indices"), py::arg("num_operands"),
+      py::arg("loc") = py::none());
+}
@@ -18,6 +18,7 @@
 namespace circt {
 namespace python {
 
+void populateDialectCombSubmodule(pybind11::module &m);
 void populateDialectESISubmodule(pybind11::module &m);
 void populateDialectHWSubmodule(pybind11::module &m);
 void populateDialectMSFTSubmodule(pybind11::module &m);
@@ -22,6 +22,7 @@
 #include "mlir/Support/FileUtilities.h"
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "PybindUtils.h"
 #include <pybind11/pybind11.h>
@@ -73,15 +74,32 @@ public:
     assert(!modOp->getRegions().empty());
     if (modOp.body().empty()) {
       modOp.body().push_back(loadedBlock);
+      indexSymbols(*loadedBlock);
       return;
     }
+    if (symbolIndexed)
+      indexSymbols(*loadedBlock);
     auto &ops = modOp.getBody()->getOperations();
     ops.splice(ops.end(), loadedBlock->getOperations());
   }
 
   MlirOperation lookup(std::string symbol) {
-    Operation *found = SymbolTable::lookupSymbolIn(mod(), symbol);
-    return wrap(found);
+    return wrap(lookupSymbol(symbol));
+  }
+
+  /// Drop the symbol index, e.g. after running passes which may have renamed
+  /// or erased modules.
+  void invalidateLookupIndex() {
+    symbolIndex.clear();
+    symbolIndexed = false;
+  }
+
+  std::vector<MlirOperation> lookupMany(std::vector<std::string> symbols) {
+    std::vector<MlirOperation> found;
+    found.reserve(symbols.size());
+    for (auto &symbol : symbols)
+      found.push_back(wrap(lookupSymbol(symbol)));
+    return found;
   }
 
   void printCapnpSchema(py::object fileObject) {
@@ -95,8 +113,40 @@ private:
   MLIRContext *ctxt() { return unwrap(cCtxt); }
   ModuleOp mod() { return unwrap(cModuleOp); }
 
+  /// Add the symbols defined in `block` to the index.
+  void indexSymbols(Block &block) {
+    for (auto &op : block)
+      if (auto name = op.getAttrOfType<StringAttr>(
+              SymbolTable::getSymbolAttrName()))
+        symbolIndex.try_emplace(name.getValue(), &op);
+  }
+
+  /// Look up a symbol of the system module in the index, which is built on
+  /// the first lookup and extended as files are loaded. Symbols defined
+  /// through other means are looked up in the module and added on a miss.
+  Operation *lookupSymbol(StringRef symbol) {
+    if (!symbolIndexed) {
+      if (!mod().body().empty())
+        indexSymbols(*mod().getBody());
+      symbolIndexed = true;
+    }
+    auto it = symbolIndex.find(symbol);
+    if (it != symbolIndex.end() && SymbolTable::getSymbolName(it->second) ==
+                                       StringRef(symbol))
+      return it->second;
+    Operation *found = SymbolTable::lookupSymbolIn(mod(), symbol);
+    if (found)
+      symbolIndex[symbol] = found;
+    return found;
+  }
+
   MlirContext cCtxt;
   MlirModule cModuleOp;
+
+  /// The top-level operations of the system module by symbol name. It must be
+  /// invalidated whenever modules are erased.
+  llvm::StringMap<Operation *> symbolIndex;
+  bool symbolIndexed = false;
 };
 
 using namespace mlir::python::adaptors;
@@ -116,6 +166,10 @@ void circt::python::populateDialectESISubmodule(py::module &m) {
       .def(py::init<MlirModule>())
       .def("load_mlir", &System::loadMlir, "Load an MLIR assembly file.")
       .def("lookup", &System::lookup, "Lookup an HW module and return it.")
+      .def("lookup_many", &System::lookupMany,
+           "Lookup a list of HW modules and return them in the same order.")
+      .def("invalidate_lookup_index", &System::invalidateLookupIndex,
+           "Forget the module index after modules were renamed or erased.")
       .def("print_cosim_schema", &System::printCapnpSchema,
            "Print the cosim RPC schema");
 
@@ -102,4 +102,28 @@ void circt::python::populateDialectHWSubmodule(py::module &m) {
         MlirStringRef cStr = hwTypeAliasTypeGetScope(self);
         return std::string(cStr.data, cStr.length);
       });
+
+  m.def(
+      "create_instances",
+      [](MlirOperation module, MlirOperation parent,
+         std::vector<std::string> names, py::list inputs, MlirLocation loc) {
+        std::vector<MlirStringRef> cNames;
+        cNames.reserve(names.size());
+        for (auto &name : names)
+          cNames.push_back(mlirStringRefCreate(name.data(), name.size()));
+        std::vector<MlirValue> cInputs;
+        cInputs.reserve(inputs.size());
+        for (auto input : inputs)
+          cInputs.push_back(python::getMlirValue(input));
+
+        std::vector<MlirOperation> instances(names.size());
+        hwCreateInstances(python::getEntryBlock(parent), loc, module,
+                          cNames.size(), cNames.data(), cInputs.data(),
+                          instances.data());
+        return instances;
+      },
+      "Create an instance of `module` in `parent` for each of the `names`. "
+      "`inputs` holds the inputs of each instance in turn.",
+      py::arg("module"), py::arg("parent"), py::arg("names"),
+      py::arg("inputs"), py::arg("loc") = py::none());
 }
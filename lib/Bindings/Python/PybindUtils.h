@@ -29,6 +29,17 @@ namespace py = pybind11;
 namespace circt {
 namespace python {
 
+/// Unwrap an `mlir.ir.Value` through its capsule.
+inline MlirValue getMlirValue(pybind11::handle value) {
+  pybind11::object capsule = value.attr(MLIR_PYTHON_CAPI_PTR_ATTR);
+  return mlirPythonCapsuleToValue(capsule.ptr());
+}
+
+/// Return the entry block of the single region of `parent`.
+inline MlirBlock getEntryBlock(MlirOperation parent) {
+  return mlirRegionGetFirstBlock(mlirOperationGetRegion(parent, 0));
+}
+
 /// Taken from PybindUtils.h in MLIR.
 /// Accumulates into a python file-like object, either writing text (default)
 /// or binary.
@@ -41,7 +52,7 @@ public:
 
   MlirStringCallback getCallback() {
     return [](MlirStringRef part, void *userData) {
-      pybind11::gil_scoped_acquire();
+      pybind11::gil_scoped_acquire acquire;
       PyFileAccumulator *accum = static_cast<PyFileAccumulator *>(userData);
       if (accum->binary) {
         // Note: Still has to copy and not avoidable with this API.
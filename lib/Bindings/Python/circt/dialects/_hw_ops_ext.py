@@ -143,6 +143,27 @@ class ModuleLike:
   def type(self):
     return FunctionType(TypeAttr(self.attributes["type"]).value)
 
+  def create_instances(self, names, inputs, *, loc=None, ip=None):
+    """
+    Create an instance of this module for each of the `names` in one native
+    call, which is much faster than creating the instances one by one.
+    - `inputs` holds a list of input values for each instance, in port order.
+    - The instances are appended to the module enclosing the insertion point.
+    Returns the instance operations.
+    """
+    if ip is None:
+      ip = InsertionPoint.current
+    if len(inputs) != len(names):
+      raise ValueError("expected the inputs of each instance")
+    num_inputs = len(self.type.inputs)
+    flat_inputs = []
+    for instance_inputs in inputs:
+      if len(instance_inputs) != num_inputs:
+        raise ValueError(f"expected {num_inputs} inputs per instance")
+      flat_inputs += [support.get_value(value) for value in instance_inputs]
+    return hw.create_instances(self.operation, ip.block.owner.operation,
+                               list(names), flat_inputs, loc)
+
   @property
   def name(self):
     return self.attributes["sym_name"]
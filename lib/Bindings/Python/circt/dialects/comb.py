@@ -4,6 +4,7 @@
 
 # Generated tablegen dialects end up in the mlir.dialects package for now.
 from mlir.dialects._comb_ops_gen import *
+from _circt._comb import *
 
 from circt.support import NamedValueOpView
 
@@ -65,6 +65,7 @@ class System(CppSystem):
     with self.ctxt:
       pm = PassManager.parse(",".join(self.passes))
       pm.run(self.mod)
+      self.invalidate_lookup_index()
       self.passed = True
 
   def print_verilog(self, out_stream: typing.TextIO = sys.stdout):
@@ -1,4 +1,4 @@
-//===- SVDialect.cpp - C Interface for the Comb Dialect -------------------===//
+//===- Comb.cpp - C Interface for the Comb Dialect ------------------------===//
 //
 //===----------------------------------------------------------------------===//
 
@@ -7,6 +7,49 @@
 #include "mlir/CAPI/IR.h"
 #include "mlir/CAPI/Registration.h"
 #include "mlir/CAPI/Support.h"
+#include "mlir/IR/Builders.h"
+
+using namespace mlir;
 
 MLIR_DEFINE_CAPI_DIALECT_REGISTRATION(Combinational, comb,
                                       circt::comb::CombDialect)
+
+bool combCreateOps(MlirBlock cBlock, MlirLocation cLoc, MlirStringRef opName,
+                   intptr_t numOperands, intptr_t numValues,
+                   MlirValue const *values, intptr_t numOps,
+                   intptr_t const *operandIndices, MlirValue *results) {
+  Block *block = unwrap(cBlock);
+  Location loc = unwrap(cLoc);
+  OperationName name(unwrap(opName), loc.getContext());
+  if (!name.getAbstractOperation() || numOperands < 1)
+    return false;
+  for (intptr_t i = 0; i < numOps; ++i)
+    for (intptr_t j = 0; j < numOperands; ++j) {
+      intptr_t index = operandIndices[i * numOperands + j];
+      if (index < 0 || index >= numValues + i)
+        return false;
+    }
+
+  OpBuilder builder = OpBuilder::atBlockEnd(block);
+  if (!block->empty() && block->back().hasTrait<OpTrait::IsTerminator>())
+    builder.setInsertionPoint(&block->back());
+
+  SmallVector<Value> available;
+  available.reserve(numValues + numOps);
+  for (intptr_t i = 0; i < numValues; ++i)
+    available.push_back(unwrap(values[i]));
+
+  SmallVector<Value, 4> operands;
+  for (intptr_t i = 0; i < numOps; ++i) {
+    operands.clear();
+    for (intptr_t j = 0; j < numOperands; ++j)
+      operands.push_back(available[operandIndices[i * numOperands + j]]);
+    OperationState state(loc, name);
+    state.addOperands(operands);
+    state.addTypes(operands.front().getType());
+    Value result = builder.createOperation(state)->getResult(0);
+    available.push_back(result);
+    results[i] = wrap(result);
+  }
+  return true;
+}
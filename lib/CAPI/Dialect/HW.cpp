@@ -17,6 +17,7 @@
 #include "mlir/CAPI/IR.h"
 #include "mlir/CAPI/Registration.h"
 #include "mlir/CAPI/Support.h"
+#include "mlir/IR/Builders.h"
 
 using namespace circt;
 using namespace circt::hw;
@@ -128,3 +129,40 @@ MlirStringRef hwTypeAliasTypeGetScope(MlirType typeAlias) {
   TypeAliasType type = unwrap(typeAlias).cast<TypeAliasType>();
   return wrap(type.getRef().getRootReference());
 }
+
+//===----------------------------------------------------------------------===//
+// Operation API.
+//===----------------------------------------------------------------------===//
+
+void hwCreateInstances(MlirBlock cBlock, MlirLocation cLoc,
+                       MlirOperation cModule, intptr_t numInstances,
+                       MlirStringRef const *instanceNames,
+                       MlirValue const *inputs, MlirOperation *instances) {
+  Block *block = unwrap(cBlock);
+  Location loc = unwrap(cLoc);
+  Operation *module = unwrap(cModule);
+  MLIRContext *ctxt = module->getContext();
+
+  // Everything but the names and inputs is shared by all instances.
+  FunctionType moduleType = getModuleType(module);
+  auto moduleName = FlatSymbolRefAttr::get(
+      ctxt, module->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName())
+                .getValue());
+  size_t numInputs = moduleType.getNumInputs();
+
+  OpBuilder builder = OpBuilder::atBlockEnd(block);
+  if (!block->empty() && block->back().hasTrait<OpTrait::IsTerminator>())
+    builder.setInsertionPoint(&block->back());
+
+  SmallVector<Value, 8> instInputs;
+  for (intptr_t i = 0; i < numInstances; ++i) {
+    instInputs.clear();
+    for (size_t j = 0; j < numInputs; ++j)
+      instInputs.push_back(unwrap(inputs[i * numInputs + j]));
+    auto inst = builder.create<InstanceOp>(
+        loc, moduleType.getResults(),
+        StringAttr::get(ctxt, unwrap(instanceNames[i])), moduleName,
+        instInputs, DictionaryAttr(), StringAttr());
+    instances[i] = wrap(inst.getOperation());
+  }
+}
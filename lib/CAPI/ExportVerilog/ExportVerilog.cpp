@@ -9,7 +9,7 @@
 #include "circt/Translation/ExportVerilog.h"
 #include "mlir/CAPI/IR.h"
 #include "mlir/CAPI/Support.h"
-#include "mlir/CAPI/Utils.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace circt;
@@ -17,6 +17,29 @@ using namespace circt;
 MlirLogicalResult mlirExportVerilog(MlirModule module,
                                     MlirStringCallback callback,
                                     void *userData) {
-  mlir::detail::CallbackOstream stream(callback, userData);
-  return wrap(exportVerilog(unwrap(module), stream));
+  return mlirExportVerilogWithChunkSize(module, 1 << 16, callback, userData);
+}
+
+MlirLogicalResult mlirExportVerilogWithChunkSize(MlirModule module,
+                                                 size_t chunkSize,
+                                                 MlirStringCallback callback,
+                                                 void *userData) {
+  auto emitChunk = [&](llvm::StringRef chunk) {
+    callback(wrap(chunk), userData);
+  };
+  return wrap(exportVerilog(unwrap(module), emitChunk, chunkSize));
+}
+
+MlirLogicalResult mlirExportVerilogToFile(MlirModule module,
+                                          MlirStringRef path) {
+  std::error_code error;
+  llvm::raw_fd_ostream os(unwrap(path), error);
+  if (error)
+    return mlirLogicalResultFailure();
+  return wrap(exportVerilog(unwrap(module), os));
+}
+
+MlirLogicalResult mlirExportSplitVerilog(MlirModule module,
+                                         MlirStringRef dirname) {
+  return wrap(exportSplitVerilog(unwrap(module), unwrap(dirname)));
 }
@@ -0,0 +1,238 @@
+//===- Firtool.cpp - C Interface to the firtool pipeline ------------------===//
+//
+//  Implements a C Interface for compiling FIRRTL with the firtool pipeline.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt-c/Firtool.h"
+
+#include "circt/Firtool/Firtool.h"
+#include "circt/Support/LoweringOptions.h"
+#include "mlir/CAPI/IR.h"
+#include "mlir/CAPI/Support.h"
+#include "mlir/CAPI/Utils.h"
+#include "mlir/CAPI/Wrap.h"
+#include "mlir/IR/Diagnostics.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace circt;
+using namespace circt::firtool;
+
+namespace {
+/// The options behind a `CirctFirtoolOptions`: the ones of the pipeline, and
+/// the ones which firtool takes care of itself around it.
+struct CAPIFirtoolOptions {
+  FirtoolOptions options;
+  std::string loweringOptions;
+  std::string outputDirectory;
+  MlirStringCallback timingCallback = nullptr;
+  void *timingUserData = nullptr;
+};
+} // namespace
+
+DEFINE_C_API_PTR_METHODS(CirctFirtoolOptions, CAPIFirtoolOptions)
+
+CirctFirtoolOptions circtFirtoolOptionsCreateDefault() {
+  return wrap(new CAPIFirtoolOptions());
+}
+
+void circtFirtoolOptionsDestroy(CirctFirtoolOptions options) {
+  delete unwrap(options);
+}
+
+void circtFirtoolOptionsSetOutputFormat(CirctFirtoolOptions options,
+                                        CirctFirtoolOutputFormat format) {
+  OutputFormatKind kind = OutputMLIR;
+  switch (format) {
+  case CirctFirtoolOutputMLIR:
+    kind = OutputMLIR;
+    break;
+  case CirctFirtoolOutputFIRBytecode:
+    kind = OutputFIRBytecode;
+    break;
+  case CirctFirtoolOutputVerilog:
+    kind = OutputVerilog;
+    break;
+  case CirctFirtoolOutputSplitVerilog:
+    kind = OutputSplitVerilog;
+    break;
+  case CirctFirtoolOutputDisabled:
+    kind = OutputDisabled;
+    break;
+  }
+  unwrap(options)->options.outputFormat = kind;
+}
+
+void circtFirtoolOptionsSetDisableOptimization(CirctFirtoolOptions options,
+                                               bool value) {
+  auto &firtoolOptions = unwrap(options)->options;
+  firtoolOptions.disableOptimization = value;
+  // Like -disable-opt, which also turns off constant propagation.
+  firtoolOptions.imconstprop = !value;
+}
+
+void circtFirtoolOptionsSetLowerToHW(CirctFirtoolOptions options,
+                                     bool value) {
+  unwrap(options)->options.lowerToHW = value;
+}
+
+void circtFirtoolOptionsSetDedup(CirctFirtoolOptions options, bool value) {
+  unwrap(options)->options.dedup = value;
+}
+
+void circtFirtoolOptionsSetInline(CirctFirtoolOptions options, bool value) {
+  unwrap(options)->options.inliner = value;
+}
+
+void circtFirtoolOptionsSetPreserveAggregate(CirctFirtoolOptions options,
+                                             bool value) {
+  unwrap(options)->options.preserveAggregate = value;
+}
+
+void circtFirtoolOptionsSetBlackBoxRootPath(CirctFirtoolOptions options,
+                                            MlirStringRef path) {
+  unwrap(options)->options.blackBoxRootPath = unwrap(path).str();
+}
+
+void circtFirtoolOptionsSetLoweringOptions(CirctFirtoolOptions options,
+                                           MlirStringRef loweringOptions) {
+  unwrap(options)->loweringOptions = unwrap(loweringOptions).str();
+}
+
+void circtFirtoolOptionsSetOutputDirectory(CirctFirtoolOptions options,
+                                           MlirStringRef directory) {
+  unwrap(options)->outputDirectory = unwrap(directory).str();
+}
+
+void circtFirtoolOptionsSetTimingCallback(CirctFirtoolOptions options,
+                                          MlirStringCallback callback,
+                                          void *userData) {
+  unwrap(options)->timingCallback = callback;
+  unwrap(options)->timingUserData = userData;
+}
+
+static InputFormatKind getInputFormat(CirctFirtoolInputFormat format) {
+  switch (format) {
+  case CirctFirtoolInputFIR:
+    return InputFIRFile;
+  case CirctFirtoolInputMLIR:
+    return InputMLIRFile;
+  case CirctFirtoolInputFIRBytecode:
+    return InputFIRBytecodeFile;
+  }
+  return InputUnspecified;
+}
+
+/// Compile `input` with the pipeline and hand the result to `output`,
+/// reporting the timings if requested.
+static LogicalResult
+compile(MlirContext context, MlirStringRef input, MlirStringRef annotations,
+        CirctFirtoolInputFormat format, CAPIFirtoolOptions &options,
+        function_ref<LogicalResult(ModuleOp, mlir::TimingScope &)> output,
+        OwningModuleRef *result) {
+  auto *ctx = unwrap(context);
+  loadFirtoolDialects(*ctx);
+  auto inputFormat = getInputFormat(format);
+  if (inputFormat == InputUnspecified)
+    return mlir::emitError(mlir::UnknownLoc::get(ctx), "unknown input format");
+
+  // Check the lowering options before compiling anything.
+  FirtoolCallbacks callbacks;
+  if (!options.loweringOptions.empty()) {
+    bool invalid = false;
+    LoweringOptions loweringOptions(
+        options.loweringOptions, [&](llvm::Twine message) {
+          mlir::emitError(mlir::UnknownLoc::get(ctx), message);
+          invalid = true;
+        });
+    if (invalid)
+      return failure();
+    callbacks.prepareModule = [loweringOptions](ModuleOp module) mutable {
+      loweringOptions.setAsAttribute(module);
+    };
+  }
+
+  if (options.options.outputFormat == OutputSplitVerilog) {
+    if (options.outputDirectory.empty())
+      return mlir::emitError(mlir::UnknownLoc::get(ctx),
+                             "split Verilog needs an output directory");
+    auto error = llvm::sys::fs::create_directories(options.outputDirectory);
+    if (error)
+      return mlir::emitError(mlir::UnknownLoc::get(ctx),
+                             "cannot create output directory '")
+             << options.outputDirectory << "': " << error.message();
+  }
+
+  auto inputBuffer =
+      llvm::MemoryBuffer::getMemBufferCopy(unwrap(input), "<input>");
+  std::unique_ptr<llvm::MemoryBuffer> annotationBuffer;
+  if (annotations.length != 0)
+    annotationBuffer = llvm::MemoryBuffer::getMemBufferCopy(
+        unwrap(annotations), "<annotations>");
+
+  // The timing manager prints its report when it goes away, which is before
+  // the stream it prints to does.
+  std::string report;
+  LogicalResult compiled = failure();
+  {
+    llvm::raw_string_ostream reportStream(report);
+    mlir::DefaultTimingManager tm;
+    tm.setEnabled(options.timingCallback != nullptr);
+    tm.setOutput(reportStream);
+    auto ts = tm.getRootScope();
+    compiled = compileFirtoolInput(std::move(inputBuffer),
+                                   std::move(annotationBuffer), inputFormat,
+                                   options.options, *ctx, ts, callbacks,
+                                   output, result);
+  }
+  if (options.timingCallback)
+    options.timingCallback(wrap(llvm::StringRef(report)),
+                           options.timingUserData);
+  return compiled;
+}
+
+MlirLogicalResult circtFirtoolCompile(MlirContext context, MlirStringRef input,
+                                      MlirStringRef annotations,
+                                      CirctFirtoolInputFormat format,
+                                      CirctFirtoolOptions options,
+                                      MlirStringCallback callback,
+                                      void *userData) {
+  auto &capiOptions = *unwrap(options);
+  auto emit = [&](ModuleOp module, mlir::TimingScope &ts) -> LogicalResult {
+    // Hand the output over in chunks rather than in the small pieces the
+    // emitters print.
+    mlir::detail::CallbackOstream stream(callback, userData);
+    stream.SetBufferSize(1 << 16);
+    auto result = emitFirtoolOutput(module, capiOptions.options, &stream,
+                                    capiOptions.outputDirectory, ts);
+    stream.flush();
+    return result;
+  };
+  return wrap(compile(context, input, annotations, format, capiOptions, emit,
+                      /*result=*/nullptr));
+}
+
+MlirModule circtFirtoolCompileToModule(MlirContext context,
+                                       MlirStringRef input,
+                                       MlirStringRef annotations,
+                                       CirctFirtoolInputFormat format,
+                                       CirctFirtoolOptions options) {
+  auto &capiOptions = *unwrap(options);
+  OwningModuleRef module;
+  auto keep = [&](ModuleOp module, mlir::TimingScope &ts) -> LogicalResult {
+    // Split Verilog is still written to the output directory, but the
+    // emitter must not drop the modules that are handed back.
+    if (capiOptions.options.outputFormat != OutputSplitVerilog)
+      return success();
+    auto emitOptions = capiOptions.options;
+    emitOptions.releaseEmittedModules = false;
+    return emitFirtoolOutput(module, emitOptions, /*os=*/nullptr,
+                             capiOptions.outputDirectory, ts);
+  };
+  if (failed(compile(context, input, annotations, format, capiOptions, keep,
+                     &module)))
+    return MlirModule{nullptr};
+  return wrap(module.release());
+}
@@ -19,13 +19,20 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/HW/HWTypes.h"
 #include "circt/Dialect/SV/SVOps.h"
+#include "circt/Support/ConstantPool.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/Pass/Pass.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TinyPtrVector.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/Parallel.h"
+#include <atomic>
+#include <chrono>
+#include <numeric>
+
+#define DEBUG_TYPE "lower-to-hw"
 
 using namespace circt;
 using namespace firrtl;
@@ -205,17 +212,52 @@ namespace {
 
 struct FIRRTLModuleLowering;
 
-/// This is state shared across the parallel module lowering logic.
+/// This is the state collected while lowering the body of a single module,
+/// for the side effects which reach outside of the module.  Each module body is
+/// lowered by a single thread, so this needs no locking.  Once all the bodies
+/// are lowered, these are merged into the circuit state in module order, which
+/// keeps the output independent of the threading.
+struct ModuleLoweringState {
+  explicit ModuleLoweringState(bool warn) : enableAnnotationWarning(warn) {}
+
+  bool used_PRINTF_COND = false;
+  bool used_STOP_COND = false;
+  bool used_RANDOMIZE_REG_INIT = false;
+
+  // Record the annotations left on an operation, to be warned about by the
+  // circuit state.  The operation itself may be gone by then.
+  void warnOnRemainingAnnotations(Operation *op, const AnnotationSet &annoSet) {
+    if (enableAnnotationWarning && !annoSet.empty())
+      remainingAnnotations.push_back({op->getLoc(), annoSet});
+  }
+
+  // The sv::BindOps created in the module, which are moved out of it once all
+  // modules have been processed.
+  SmallVector<sv::BindOp> binds;
+
+  // The number of temporary wires created while lowering the module, and the
+  // number of them that were optimized away.
+  size_t numTemporaryWires = 0;
+  size_t numTemporaryWiresErased = 0;
+
+private:
+  friend struct CircuitLoweringState;
+  bool enableAnnotationWarning;
+  SmallVector<std::pair<Location, AnnotationSet>> remainingAnnotations;
+};
+
+/// This is state shared across the parallel module lowering logic.  It is
+/// only read while the module bodies are lowered in parallel.
 struct CircuitLoweringState {
-  std::atomic<bool> used_PRINTF_COND{false};
-  std::atomic<bool> used_STOP_COND{false};
+  bool used_PRINTF_COND = false;
+  bool used_STOP_COND = false;
 
-  std::atomic<bool> used_RANDOMIZE_REG_INIT{false},
-      used_RANDOMIZE_MEM_INIT{false};
-  std::atomic<bool> used_RANDOMIZE_GARBAGE_ASSIGN{false};
+  bool used_RANDOMIZE_REG_INIT = false, used_RANDOMIZE_MEM_INIT = false;
+  bool used_RANDOMIZE_GARBAGE_ASSIGN = false;
 
-  CircuitLoweringState(CircuitOp circuitOp, bool warn)
-      : circuitOp(circuitOp), enableAnnotationWarning(warn) {}
+  CircuitLoweringState(CircuitOp circuitOp, bool warn, bool groupDebug)
+      : circuitOp(circuitOp), groupDebugStatements(groupDebug),
+        enableAnnotationWarning(warn) {}
 
   Operation *getNewModule(Operation *oldModule) {
     auto it = oldToNewModuleMap.find(oldModule);
@@ -223,16 +265,18 @@ struct CircuitLoweringState {
   }
 
   // Emit warnings on unprocessed annotations still remaining in the annoSet.
-  void warnOnRemainingAnnotations(Operation *op, const AnnotationSet &annoSet);
+  void warnOnRemainingAnnotations(Operation *op, const AnnotationSet &annoSet) {
+    warnOnRemainingAnnotations(op->getLoc(), annoSet);
+  }
+  void warnOnRemainingAnnotations(Location loc, const AnnotationSet &annoSet);
+
+  // Merge the side effects of lowering a module body into the circuit.
+  void merge(ModuleLoweringState &moduleState);
 
   CircuitOp circuitOp;
 
-  // Safely add a BindOp to global mutable state.  This will acquire a lock to
-  // do this safely.
-  void addBind(sv::BindOp op) {
-    std::lock_guard<std::mutex> lock(bindsMutex);
-    binds.push_back(op);
-  }
+  // Whether consecutive prints and stops share their guards.
+  const bool groupDebugStatements;
 
 private:
   friend struct FIRRTLModuleLowering;
@@ -245,30 +289,32 @@ private:
   // once about any annotation class.
   StringSet<> alreadyPrinted;
   const bool enableAnnotationWarning;
-  std::mutex annotationPrintingMtx;
 
   // Records any sv::BindOps that are found during the course of execution.
-  // This is unsafe to access directly and should only be used through addBind.
   SmallVector<sv::BindOp> binds;
-
-  // Control access to binds.
-  std::mutex bindsMutex;
 };
 
 void CircuitLoweringState::warnOnRemainingAnnotations(
-    Operation *op, const AnnotationSet &annoSet) {
+    Location loc, const AnnotationSet &annoSet) {
   if (!enableAnnotationWarning || annoSet.empty())
     return;
-  std::lock_guard<std::mutex> lock(annotationPrintingMtx);
 
   for (auto a : annoSet) {
     auto inserted = alreadyPrinted.insert(a.getClass());
     if (inserted.second)
-      mlir::emitWarning(op->getLoc(), "unprocessed annotation:'" +
-                                          a.getClass() +
-                                          "' still remaining after LowerToHW");
+      mlir::emitWarning(loc, "unprocessed annotation:'" + a.getClass() +
+                                 "' still remaining after LowerToHW");
   }
 }
+
+void CircuitLoweringState::merge(ModuleLoweringState &moduleState) {
+  used_PRINTF_COND |= moduleState.used_PRINTF_COND;
+  used_STOP_COND |= moduleState.used_STOP_COND;
+  used_RANDOMIZE_REG_INIT |= moduleState.used_RANDOMIZE_REG_INIT;
+  binds.append(moduleState.binds.begin(), moduleState.binds.end());
+  for (auto &locAndAnnos : moduleState.remainingAnnotations)
+    warnOnRemainingAnnotations(locAndAnnos.first, locAndAnnos.second);
+}
 } // end anonymous namespace
 
 namespace {
@@ -276,6 +322,7 @@ struct FIRRTLModuleLowering : public LowerFIRRTLToHWBase<FIRRTLModuleLowering> {
 
   void runOnOperation() override;
   void setEnableAnnotationWarning() { enableAnnotationWarning = true; }
+  void setGroupDebugStatements() { groupDebugStatements = true; }
 
 private:
   void lowerFileHeader(CircuitOp op, CircuitLoweringState &loweringState);
@@ -289,23 +336,31 @@ private:
                                       Block *topLevelModule,
                                       CircuitLoweringState &loweringState);
 
-  void lowerModuleBody(FModuleOp oldModule,
-                       CircuitLoweringState &loweringState);
+  void lowerModuleBody(FModuleOp oldModule, CircuitLoweringState &loweringState,
+                       ModuleLoweringState &moduleState);
   void lowerModuleOperations(hw::HWModuleOp module,
-                             CircuitLoweringState &loweringState);
+                             CircuitLoweringState &loweringState,
+                             ModuleLoweringState &moduleState);
 
   void lowerMemoryDecls(const SmallVector<FirMemory> &mems, Block *top,
                         CircuitLoweringState &loweringState);
+
+  using Clock = std::chrono::steady_clock;
+  void recordModuleTimes(ArrayRef<FModuleOp> modules,
+                         ArrayRef<Clock::duration> times);
 };
 
 } // end anonymous namespace
 
 /// This is the pass constructor.
 std::unique_ptr<mlir::Pass>
-circt::createLowerFIRRTLToHWPass(llvm::Optional<bool> enableAnnotationWarning) {
+circt::createLowerFIRRTLToHWPass(llvm::Optional<bool> enableAnnotationWarning,
+                                 bool groupDebugStatements) {
   auto pass = std::make_unique<FIRRTLModuleLowering>();
   if (enableAnnotationWarning.hasValue() && enableAnnotationWarning.getValue())
     pass->setEnableAnnotationWarning();
+  if (groupDebugStatements)
+    pass->setGroupDebugStatements();
   return pass;
 }
 
@@ -330,7 +385,8 @@ void FIRRTLModuleLowering::runOnOperation() {
 
   // Keep track of the mapping from old to new modules.  The result may be null
   // if lowering failed.
-  CircuitLoweringState state(circuit, enableAnnotationWarning);
+  CircuitLoweringState state(circuit, enableAnnotationWarning,
+                             groupDebugStatements);
 
   SmallVector<FModuleOp, 32> modulesToProcess;
 
@@ -371,14 +427,52 @@ void FIRRTLModuleLowering::runOnOperation() {
 
   // Now that we've lowered all of the modules, move the bodies over and update
   // any instances that refer to the old modules.
+  SmallVector<Clock::duration> moduleTimes(modulesToProcess.size());
+  SmallVector<ModuleLoweringState> moduleStates(
+      modulesToProcess.size(), ModuleLoweringState(enableAnnotationWarning));
+  auto lowerModuleAt = [&](size_t index) {
+    auto start = Clock::now();
+    lowerModuleBody(modulesToProcess[index], state, moduleStates[index]);
+    moduleTimes[index] = Clock::now() - start;
+  };
   if (getContext().isMultithreadingEnabled()) {
+    // Lower the largest modules first and hand the modules out one at a time,
+    // so that a large module near the end of the circuit doesn't leave the
+    // other threads idle while it is lowered.  The size of a module is
+    // estimated by the number of operations in its body.
+    SmallVector<std::pair<size_t, size_t>> worklist(modulesToProcess.size());
+    llvm::parallelForEachN(0, modulesToProcess.size(), [&](size_t index) {
+      auto &ops = modulesToProcess[index].getBodyBlock()->getOperations();
+      worklist[index] = {ops.size(), index};
+    });
+    std::stable_sort(worklist.begin(), worklist.end(),
+                     [](const std::pair<size_t, size_t> &lhs,
+                        const std::pair<size_t, size_t> &rhs) {
+                       return lhs.first > rhs.first;
+                     });
+
+    // Diagnostics are ordered by the position of the module in the circuit.
     mlir::ParallelDiagnosticHandler diagHandler(&getContext());
-    llvm::parallelForEachN(0, modulesToProcess.size(), [&](auto index) {
-      lowerModuleBody(modulesToProcess[index], state);
+    std::atomic<size_t> nextModule{0};
+    size_t numWorkers = std::min<size_t>(
+        llvm::parallel::strategy.compute_thread_count(), worklist.size());
+    llvm::parallelForEachN(0, numWorkers, [&](size_t) {
+      for (size_t i = nextModule++; i < worklist.size(); i = nextModule++) {
+        auto index = worklist[i].second;
+        diagHandler.setOrderIDForThread(index);
+        lowerModuleAt(index);
+        diagHandler.eraseOrderIDForThread();
+      }
     });
   } else {
-    for (auto module : modulesToProcess)
-      lowerModuleBody(module, state);
+    for (size_t i = 0, e = modulesToProcess.size(); i != e; ++i)
+      lowerModuleAt(i);
+  }
+  recordModuleTimes(modulesToProcess, moduleTimes);
+  for (auto &moduleState : moduleStates) {
+    state.merge(moduleState);
+    numTemporaryWires += moduleState.numTemporaryWires;
+    numTemporaryWiresErased += moduleState.numTemporaryWiresErased;
   }
 
   // Move binds from inside modules to outside modules.
@@ -402,6 +496,31 @@ void FIRRTLModuleLowering::runOnOperation() {
   circuit.erase();
 }
 
+/// Update the timing statistics with the time spent lowering the body of each
+/// module.  The slowest module is the critical path of the parallel lowering.
+void FIRRTLModuleLowering::recordModuleTimes(ArrayRef<FModuleOp> modules,
+                                             ArrayRef<Clock::duration> times) {
+  auto toMicroseconds = [](Clock::duration time) -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+  };
+  for (auto time : times) {
+    moduleTimeTotal += toMicroseconds(time);
+    moduleTimeMax.updateMax(toMicroseconds(time));
+  }
+
+  LLVM_DEBUG({
+    SmallVector<size_t> order(modules.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return times[lhs] > times[rhs];
+    });
+    llvm::dbgs() << "===- Module lowering times -===\n";
+    for (auto index : order)
+      llvm::dbgs() << llvm::formatv("{0,10} us  ", toMicroseconds(times[index]))
+                   << modules[index].getName() << "\n";
+  });
+}
+
 void FIRRTLModuleLowering::lowerMemoryDecls(const SmallVector<FirMemory> &mems,
                                             Block *top,
                                             CircuitLoweringState &state) {
@@ -809,7 +928,8 @@ static SmallVector<SubfieldOp> getAllFieldAccesses(Value structValue,
 /// firrtl.module's, we can go through and move the bodies over, updating the
 /// ports and instances.
 void FIRRTLModuleLowering::lowerModuleBody(
-    FModuleOp oldModule, CircuitLoweringState &loweringState) {
+    FModuleOp oldModule, CircuitLoweringState &loweringState,
+    ModuleLoweringState &moduleState) {
   auto newModule =
       dyn_cast_or_null<hw::HWModuleOp>(loweringState.getNewModule(oldModule));
   // Don't touch modules if we failed to lower ports.
@@ -903,7 +1023,7 @@ void FIRRTLModuleLowering::lowerModuleBody(
   cursor.erase();
 
   // Lower all of the other operations.
-  lowerModuleOperations(newModule, loweringState);
+  lowerModuleOperations(newModule, loweringState, moduleState);
 }
 
 //===----------------------------------------------------------------------===//
@@ -913,13 +1033,16 @@ void FIRRTLModuleLowering::lowerModuleBody(
 namespace {
 struct FIRRTLLowering : public FIRRTLVisitor<FIRRTLLowering, LogicalResult> {
 
-  FIRRTLLowering(hw::HWModuleOp module, CircuitLoweringState &circuitState)
+  FIRRTLLowering(hw::HWModuleOp module, CircuitLoweringState &circuitState,
+                 ModuleLoweringState &moduleState)
       : theModule(module), circuitState(circuitState),
-        builder(module.getLoc(), module.getContext()) {}
+        moduleState(moduleState),
+        builder(module.getLoc(), module.getContext()),
+        constantPool(module.getBodyBlock()) {}
 
   void run();
 
-  void optimizeTemporaryWire(sv::WireOp wire);
+  bool optimizeTemporaryWire(sv::WireOp wire);
 
   // Helpers.
   Value getOrCreateIntConstant(const APInt &value);
@@ -958,6 +1081,8 @@ struct FIRRTLLowering : public FIRRTLVisitor<FIRRTLLowering, LogicalResult> {
                                  std::function<void(void)> elseCtor = {});
   void addIfProceduralBlock(Value cond, std::function<void(void)> thenCtor,
                             std::function<void(void)> elseCtor = {});
+  void addToDebugStatementBlock(StringRef macro, Value cond,
+                                std::function<void(void)> fn);
 
   // Create a temporary wire at the current insertion point, and try to
   // eliminate it later as part of lowering post processing.
@@ -1101,9 +1226,12 @@ private:
   /// The module we're lowering into.
   hw::HWModuleOp theModule;
 
-  /// Global state.
+  /// Global state.  This is shared by all the threads, so it is read only.
   CircuitLoweringState &circuitState;
 
+  /// The side effects of this module on the circuit.
+  ModuleLoweringState &moduleState;
+
   /// This builder is set to the right location for each visit call.
   ImplicitLocOpBuilder builder;
 
@@ -1114,7 +1242,7 @@ private:
 
   /// This keeps track of constants that we have created so we can reuse them.
   /// This is populated by the getOrCreateIntConstant method.
-  DenseMap<Attribute, Value> hwConstantMap;
+  ConstantPool constantPool;
 
   // We auto-unique graph-level blocks to reduce the amount of generated
   // code and ensure that side effects are properly ordered in FIRRTL.
@@ -1138,8 +1266,9 @@ private:
 } // end anonymous namespace
 
 void FIRRTLModuleLowering::lowerModuleOperations(
-    hw::HWModuleOp module, CircuitLoweringState &loweringState) {
-  FIRRTLLowering(module, loweringState).run();
+    hw::HWModuleOp module, CircuitLoweringState &loweringState,
+    ModuleLoweringState &moduleState) {
+  FIRRTLLowering(module, loweringState, moduleState).run();
 }
 
 // This is the main entrypoint for the lowering pass.
@@ -1158,7 +1287,7 @@ void FIRRTLLowering::run() {
     builder.setInsertionPoint(&op);
     builder.setLoc(op.getLoc());
     auto done = succeeded(dispatchVisitor(&op));
-    circuitState.warnOnRemainingAnnotations(&op, AnnotationSet(&op));
+    moduleState.warnOnRemainingAnnotations(&op, AnnotationSet(&op));
     if (done)
       opsToRemove.push_back(&op);
     else {
@@ -1188,12 +1317,15 @@ void FIRRTLLowering::run() {
 
   // Now that the IR is in a stable form, try to eliminate temporary wires
   // inserted by MemOp insertions.
+  moduleState.numTemporaryWires = tmpWiresToOptimize.size();
   for (auto wire : tmpWiresToOptimize)
-    optimizeTemporaryWire(wire);
+    if (optimizeTemporaryWire(wire))
+      ++moduleState.numTemporaryWiresErased;
 }
 
-// Try to optimize out temporary wires introduced during lowering.
-void FIRRTLLowering::optimizeTemporaryWire(sv::WireOp wire) {
+// Try to optimize out temporary wires introduced during lowering.  Returns
+// true if the wire was removed.
+bool FIRRTLLowering::optimizeTemporaryWire(sv::WireOp wire) {
   // Wires have inout type, so they'll have connects and read_inout operations
   // that work on them.  If anything unexpected is found then leave it alone.
   SmallVector<sv::ReadInOutOp> reads;
@@ -1208,18 +1340,18 @@ void FIRRTLLowering::optimizeTemporaryWire(sv::WireOp wire) {
     // Otherwise must be a connect, and we must not have seen a write yet.
     auto assign = dyn_cast<sv::AssignOp>(user);
     if (!assign || write)
-      return;
+      return false;
     write = assign;
   }
 
   // Must have found the write!
   if (!write)
-    return;
+    return false;
 
   // If the write is happening at the module level then we don't have any
   // use-before-def checking to do, so we only handle that for now.
   if (!isa<hw::HWModuleOp>(write->getParentOp()))
-    return;
+    return false;
 
   auto connected = write.src();
 
@@ -1231,6 +1363,7 @@ void FIRRTLLowering::optimizeTemporaryWire(sv::WireOp wire) {
   // And remove the write and wire itself.
   write.erase();
   wire.erase();
+  return true;
 }
 
 //===----------------------------------------------------------------------===//
@@ -1243,13 +1376,9 @@ Value FIRRTLLowering::getOrCreateIntConstant(const APInt &value) {
   auto attr = builder.getIntegerAttr(
       builder.getIntegerType(value.getBitWidth()), value);
 
-  auto &entry = hwConstantMap[attr];
-  if (entry)
-    return entry;
-
-  OpBuilder entryBuilder(&theModule.getBodyBlock()->front());
-  entry = entryBuilder.create<hw::ConstantOp>(builder.getLoc(), attr);
-  return entry;
+  return constantPool.getOrCreate(builder, attr, attr.getType(), [&] {
+    return builder.create<hw::ConstantOp>(attr);
+  });
 }
 
 /// Zero bit operands end up looking like failures from getLoweredValue.  This
@@ -1301,6 +1430,14 @@ Value FIRRTLLowering::getLoweredAndExtendedValue(Value value, Type destType) {
   assert(value.getType().isa<FIRRTLType>() && destType.isa<FIRRTLType>() &&
          "input/output value should be FIRRTL");
 
+  // Bundles kept intact by type lowering are only connected to bundles of the
+  // same type, so there is nothing to extend.
+  if (destType.isa<BundleType>()) {
+    if (value.getType().cast<FIRRTLType>().getPassiveType() != destType)
+      return {};
+    return getLoweredValue(value);
+  }
+
   // We only know how to extend integer types with known width.
   auto destWidth = destType.cast<FIRRTLType>().getBitWidthOrSentinel();
   if (destWidth == -1)
@@ -1350,6 +1487,14 @@ Value FIRRTLLowering::getLoweredAndExtOrTruncValue(Value value, Type destType) {
   assert(value.getType().isa<FIRRTLType>() && destType.isa<FIRRTLType>() &&
          "input/output value should be FIRRTL");
 
+  // Bundles kept intact by type lowering always have the same type as the
+  // aggregate they are initialized from.
+  if (destType.isa<BundleType>()) {
+    if (value.getType().cast<FIRRTLType>().getPassiveType() != destType)
+      return {};
+    return getLoweredValue(value);
+  }
+
   // We only know how to adjust integer types with known width.
   auto destWidth = destType.cast<FIRRTLType>().getBitWidthOrSentinel();
   if (destWidth == -1)
@@ -1432,21 +1577,8 @@ LogicalResult FIRRTLLowering::setPossiblyFoldedLowering(Value orig,
                                                         Value result) {
   // If this is a constant, check to see if we have it in our unique mapping:
   // it could have come from folding an operation.
-  if (auto cst = dyn_cast_or_null<hw::ConstantOp>(result.getDefiningOp())) {
-    auto &entry = hwConstantMap[cst.valueAttr()];
-    if (entry == cst) {
-      // We're already using an entry in the constant map, nothing to do.
-    } else if (entry) {
-      // We already had this constant, reuse the one we have instead of the
-      // one we just folded.
-      result = entry;
-      cst->erase();
-    } else {
-      // This is a new constant.  Remember it!
-      entry = cst;
-      cst->moveBefore(&theModule.getBodyBlock()->front());
-    }
-  }
+  if (auto cst = dyn_cast_or_null<hw::ConstantOp>(result.getDefiningOp()))
+    result = constantPool.insert(cst);
 
   return setLowering(orig, result);
 }
@@ -1569,6 +1701,40 @@ void FIRRTLLowering::addIfProceduralBlock(Value cond,
   builder.create<sv::IfOp>(cond, thenCtor, elseCtor);
 }
 
+/// Emit a print or stop guarded by a macro such as `PRINTF_COND_ and by its
+/// own condition.  Without grouping each statement checks both in one `if`.
+/// With grouping the statement is added to the `if` on the macro right before
+/// the insertion point, if any, and to the `if` on its condition in there.
+void FIRRTLLowering::addToDebugStatementBlock(StringRef macro, Value cond,
+                                              std::function<void(void)> fn) {
+  if (!circuitState.groupDebugStatements) {
+    Value ifCond = builder.create<sv::VerbatimExprOp>(cond.getType(), macro);
+    ifCond = builder.createOrFold<comb::AndOp>(ifCond, cond);
+    addIfProceduralBlock(ifCond, fn);
+    return;
+  }
+
+  auto addToCondBlock = [&]() {
+    auto constCond = cond.getDefiningOp<hw::ConstantOp>();
+    if (constCond && constCond.value().isAllOnesValue())
+      fn();
+    else
+      addIfProceduralBlock(cond, fn);
+  };
+
+  auto insertIt = builder.getInsertionPoint();
+  if (insertIt != builder.getBlock()->begin())
+    if (auto ifOp = dyn_cast<sv::IfOp>(*--insertIt))
+      if (auto verbatim = ifOp.cond().getDefiningOp<sv::VerbatimExprOp>())
+        if (verbatim.string() == macro && !ifOp.hasElse()) {
+          runWithInsertionPointAtEndOfBlock(addToCondBlock, ifOp.thenRegion());
+          return;
+        }
+
+  Value macroCond = builder.create<sv::VerbatimExprOp>(cond.getType(), macro);
+  builder.create<sv::IfOp>(macroCond, addToCondBlock);
+}
+
 //===----------------------------------------------------------------------===//
 // Special Operations
 //===----------------------------------------------------------------------===//
@@ -1756,6 +1922,15 @@ void FIRRTLLowering::initializeRegister(Value reg, Value resetSignal) {
             emitRandomInit(arrayIndex, a.getElementType());
           }
         })
+        .Case<hw::StructType>([&](auto structType) {
+          // A struct is packed, so fill all of its bits at once.
+          auto width = hw::getBitWidth(structType);
+          if (width <= 0)
+            return;
+          auto value = getRandomValue(builder.getIntegerType(width));
+          builder.create<sv::BPAssignOp>(
+              reg, builder.create<hw::BitcastOp>(structType, value));
+        })
         .Default([&](auto type) { emitRandomInit(reg, type); });
   };
 
@@ -1764,7 +1939,7 @@ void FIRRTLLowering::initializeRegister(Value reg, Value resetSignal) {
   addToIfDefBlock("SYNTHESIS", std::function<void()>(), [&]() {
     addToInitialBlock([&]() {
       emitRandomizePrologIfNeeded();
-      circuitState.used_RANDOMIZE_REG_INIT = 1;
+      moduleState.used_RANDOMIZE_REG_INIT = true;
       addToIfDefProceduralBlock("RANDOMIZE_REG_INIT", [&]() {
         if (resetSignal) {
           addIfProceduralBlock(resetSignal, {}, [&]() { randomInit(); });
@@ -2037,9 +2212,9 @@ LogicalResult FIRRTLLowering::visitDecl(InstanceOp oldInstance) {
                         /*exclude_from_filelist=*/builder.getBoolAttr(true),
                         /*exclude_replicated_ops=*/builder.getBoolAttr(true),
                         bindOp.getContext()));
-    // Add the bind to the circuit state.  This will be moved outside of the
+    // Add the bind to the module state.  This will be moved outside of the
     // encapsulating module after all modules have been processed in parallel.
-    circuitState.addBind(bindOp);
+    moduleState.binds.push_back(bindOp);
   }
 
   // Create the new hw.instance operation.
@@ -2615,14 +2790,10 @@ LogicalResult FIRRTLLowering::visitStmt(PrintFOp op) {
   addToAlwaysBlock(clock, [&]() {
     // Emit an "#ifndef SYNTHESIS" guard into the always block.
     addToIfDefProceduralBlock("SYNTHESIS", std::function<void()>(), [&]() {
-      circuitState.used_PRINTF_COND = true;
+      moduleState.used_PRINTF_COND = true;
 
       // Emit an "sv.if '`PRINTF_COND_ & cond' into the #ifndef.
-      Value ifCond =
-          builder.create<sv::VerbatimExprOp>(cond.getType(), "`PRINTF_COND_");
-      ifCond = builder.createOrFold<comb::AndOp>(ifCond, cond);
-
-      addIfProceduralBlock(ifCond, [&]() {
+      addToDebugStatementBlock("`PRINTF_COND_", cond, [&]() {
         // Emit the sv.fwrite.
         builder.create<sv::FWriteOp>(op.formatString(), operands);
       });
@@ -2644,13 +2815,10 @@ LogicalResult FIRRTLLowering::visitStmt(StopOp op) {
   addToAlwaysBlock(clock, [&]() {
     // Emit an "#ifndef SYNTHESIS" guard into the always block.
     addToIfDefProceduralBlock("SYNTHESIS", std::function<void()>(), [&]() {
-      circuitState.used_STOP_COND = true;
+      moduleState.used_STOP_COND = true;
 
       // Emit an "sv.if '`STOP_COND_ & cond' into the #ifndef.
-      Value ifCond =
-          builder.create<sv::VerbatimExprOp>(cond.getType(), "`STOP_COND_");
-      ifCond = builder.createOrFold<comb::AndOp>(ifCond, cond);
-      addIfProceduralBlock(ifCond, [&]() {
+      addToDebugStatementBlock("`STOP_COND_", cond, [&]() {
         // Emit the sv.fatal or sv.finish.
         if (op.exitCode())
           builder.create<sv::FatalOp>();
@@ -19,8 +19,13 @@
 #include "circt/Dialect/LLHD/IR/LLHDDialect.h"
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Support/Parallel.h"
+
+#include <atomic>
 
 using namespace circt;
 using namespace llhd;
@@ -34,12 +39,10 @@ using namespace comb;
 namespace {
 struct HWToLLHDPass : public ConvertHWToLLHDBase<HWToLLHDPass> {
   void runOnOperation() override;
-};
 
-/// A helper type converter class that automatically populates the relevant
-/// materializations and type conversions for converting HW to LLHD.
-struct HWToLLHDTypeConverter : public TypeConverter {
-  HWToLLHDTypeConverter();
+private:
+  LogicalResult collectModules(ModuleOp module,
+                               SmallVectorImpl<HWModuleOp> &modules);
 };
 } // namespace
 
@@ -49,109 +52,150 @@ std::unique_ptr<OperationPass<ModuleOp>> circt::createConvertHWToLLHDPass() {
 }
 
 /// Forward declare conversion patterns.
-struct ConvertHWModule;
 struct ConvertOutput;
 struct ConvertInstance;
 
-/// This is the main entrypoint for the HW to LLHD conversion pass.
+/// Create the entity corresponding to a HW module and move the body of the
+/// module into it. All ports become signals: the input signals are probed at
+/// the start of the body, and the output signals are appended to the block
+/// arguments, since LLHD entity outputs are block arguments to the op.
+static EntityOp convertModuleSignature(HWModuleOp module) {
+  // Collect the HW module's port types.
+  FunctionType moduleType = module.getType();
+  unsigned numInputs = moduleType.getNumInputs();
+
+  // LLHD entities port types are all expressed as block arguments to the op,
+  // so collect all of the types in the expected order (inputs then outputs).
+  SmallVector<Type, 4> entityTypes;
+  for (auto type : moduleType.getInputs())
+    entityTypes.push_back(SigType::get(type));
+  SmallVector<Type, 4> outputTypes;
+  for (auto type : moduleType.getResults())
+    outputTypes.push_back(SigType::get(type));
+  entityTypes.append(outputTypes.begin(), outputTypes.end());
+
+  // Create the entity. Note that LLHD does not support parameterized
+  // entities, so this conversion does not support parameterized modules.
+  OpBuilder builder(module);
+  auto entity = builder.create<EntityOp>(module.getLoc(), numInputs);
+  entity->setAttr(entity.getTypeAttrName(),
+                  TypeAttr::get(builder.getFunctionType(entityTypes, {})));
+  entity.setName(module.getName());
+
+  // Move the HW module body into the entity body and probe the inputs.
+  Region &entityBodyRegion = entity.getBodyRegion();
+  entityBodyRegion.takeBody(module.getBodyRegion());
+  Block &body = entityBodyRegion.front();
+  builder.setInsertionPointToStart(&body);
+  for (auto arg : body.getArguments()) {
+    auto type = arg.getType();
+    arg.setType(SigType::get(type));
+    if (arg.use_empty())
+      continue;
+    auto prb = builder.create<PrbOp>(entity.getLoc(), type, arg);
+    arg.replaceAllUsesExcept(prb,
+                             SmallPtrSet<Operation *, 1>{prb.getOperation()});
+  }
+  entityBodyRegion.addArguments(outputTypes);
+
+  module.erase();
+  return entity;
+}
+
+/// Collect the modules to convert: all of them, or only the ones instantiated
+/// below the root module if one is set. The other modules are erased then.
+LogicalResult
+HWToLLHDPass::collectModules(ModuleOp module,
+                             SmallVectorImpl<HWModuleOp> &modules) {
+  if (root.empty()) {
+    llvm::append_range(modules, module.getOps<HWModuleOp>());
+    return success();
+  }
+
+  auto rootModule = module.lookupSymbol<HWModuleOp>(root);
+  if (!rootModule)
+    return module.emitError("root module '") << root << "' not found";
+
+  llvm::SetVector<Operation *> reachable;
+  reachable.insert(rootModule);
+  for (size_t i = 0; i < reachable.size(); ++i)
+    reachable[i]->walk([&](InstanceOp instance) {
+      if (auto child = module.lookupSymbol<HWModuleOp>(instance.moduleName()))
+        reachable.insert(child);
+    });
+
+  for (auto hwModule : llvm::make_early_inc_range(module.getOps<HWModuleOp>()))
+    if (reachable.count(hwModule))
+      modules.push_back(hwModule);
+    else
+      hwModule.erase();
+  return success();
+}
+
+/// This is the main entrypoint for the HW to LLHD conversion pass. The module
+/// signatures are converted first, serially, since the new entities are
+/// created in the parent module. The bodies are then converted in parallel,
+/// as they only refer to other modules by name.
 void HWToLLHDPass::runOnOperation() {
   MLIRContext &context = getContext();
   ModuleOp module = getOperation();
 
+  SmallVector<HWModuleOp> modules;
+  if (failed(collectModules(module, modules)))
+    return signalPassFailure();
+
+  SmallVector<EntityOp> entities;
+  for (auto hwModule : modules)
+    entities.push_back(convertModuleSignature(hwModule));
+
   // Mark the HW structure ops as illegal such that they get rewritten.
   ConversionTarget target(context);
   target.addLegalDialect<LLHDDialect>();
   target.addLegalDialect<CombDialect>();
-  target.addIllegalOp<HWModuleOp>();
   target.addIllegalOp<OutputOp>();
   target.addIllegalOp<InstanceOp>();
 
-  // Rewrite `hw.module`, `hw.output`, and `hw.instance`.
-  HWToLLHDTypeConverter typeConverter;
+  // Rewrite `hw.output` and `hw.instance`.
   RewritePatternSet patterns(&context);
-  mlir::populateFunctionLikeTypeConversionPattern<HWModuleOp>(patterns,
-                                                              typeConverter);
-  patterns.add<ConvertHWModule>(&context);
   patterns.add<ConvertInstance>(&context);
   patterns.add<ConvertOutput>(&context);
-  if (failed(applyPartialConversion(module, target, std::move(patterns))))
-    signalPassFailure();
-}
-
-//===----------------------------------------------------------------------===//
-// TypeConverter conversions and materializations
-//===----------------------------------------------------------------------===//
-
-HWToLLHDTypeConverter::HWToLLHDTypeConverter() {
-  // Convert any type by just wrapping it in `SigType`.
-  addConversion([](Type type) { return SigType::get(type); });
-
-  // Mark `SigType` legal by converting it to itself.
-  addConversion([](SigType type) { return type; });
+  FrozenRewritePatternSet frozenPatterns(std::move(patterns));
+
+  std::atomic<bool> anyFailed{false};
+  auto convertBody = [&](size_t index) {
+    auto entity = entities[index];
+    if (failed(applyPartialConversion(entity, target, frozenPatterns)))
+      anyFailed = true;
+
+    // Drop the probes of inputs only feeding other signals.
+    for (auto arg : entity.getArguments().take_front(entity.ins()))
+      for (auto *user : llvm::make_early_inc_range(arg.getUsers()))
+        if (auto prb = dyn_cast<PrbOp>(user))
+          if (prb.result().use_empty())
+            prb.erase();
+  };
+
+  if (context.isMultithreadingEnabled()) {
+    // Diagnostics are ordered by the position of the module in the design.
+    mlir::ParallelDiagnosticHandler diagHandler(&context);
+    llvm::parallelForEachN(0, entities.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      convertBody(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = entities.size(); i != e; ++i)
+      convertBody(i);
+  }
 
-  // Materialze probes when arguments are converted from any type to `SigType`.
-  addArgumentMaterialization(
-      [](OpBuilder &builder, Type type, ValueRange values, Location loc) {
-        assert(values.size() == 1);
-        auto op = builder.create<PrbOp>(loc, type, values[0]);
-        return op.getResult();
-      });
+  if (anyFailed)
+    signalPassFailure();
 }
 
 //===----------------------------------------------------------------------===//
 // Convert structure operations
 //===----------------------------------------------------------------------===//
 
-/// This works on each HW module, creates corresponding entities, moves the
-/// bodies of the modules into the entities, and converts the bodies.
-struct ConvertHWModule : public OpConversionPattern<HWModuleOp> {
-  using OpConversionPattern::OpConversionPattern;
-
-  LogicalResult
-  matchAndRewrite(HWModuleOp module, ArrayRef<Value> operands,
-                  ConversionPatternRewriter &rewriter) const override {
-    // Collect the HW module's port types.
-    FunctionType moduleType = module.getType();
-    unsigned numInputs = moduleType.getNumInputs();
-    TypeRange moduleInputs = moduleType.getInputs();
-    TypeRange moduleOutputs = moduleType.getResults();
-
-    // LLHD entities port types are all expressed as block arguments to the op,
-    // so collect all of the types in the expected order (inputs then outputs).
-    SmallVector<Type, 4> entityTypes(moduleInputs);
-    entityTypes.append(moduleOutputs.begin(), moduleOutputs.end());
-
-    // Ensure the input and output types have all been converted already. This
-    // is handled separately by the upstream FunctionLikeTypeConversionPattern.
-    if (!llvm::all_of(entityTypes,
-                      [](Type type) { return type.isa<SigType>(); }))
-      return rewriter.notifyMatchFailure(module, "Not all ports had SigType");
-
-    // Create the entity. Note that LLHD does not support parameterized
-    // entities, so this conversion does not support parameterized modules.
-    auto entity = rewriter.create<EntityOp>(module.getLoc(), numInputs);
-
-    // Inline the HW module body into the entity body.
-    Region &entityBodyRegion = entity.getBodyRegion();
-    rewriter.inlineRegionBefore(module.getBodyRegion(), entityBodyRegion,
-                                entityBodyRegion.end());
-
-    // Set the entity type and name attributes. Add block arguments for each
-    // output, since LLHD entity outputs are still block arguments to the op.
-    auto entityType = rewriter.getFunctionType(entityTypes, {});
-    rewriter.updateRootInPlace(entity, [&] {
-      entity->setAttr(entity.getTypeAttrName(), TypeAttr::get(entityType));
-      entity.setName(module.getName());
-      entityBodyRegion.addArguments(moduleOutputs);
-    });
-
-    // Erase the HW module.
-    rewriter.eraseOp(module);
-
-    return success();
-  }
-};
-
 /// This works on each output op, creating ops to drive the appropriate results.
 struct ConvertOutput : public OpConversionPattern<OutputOp> {
   using OpConversionPattern::OpConversionPattern;
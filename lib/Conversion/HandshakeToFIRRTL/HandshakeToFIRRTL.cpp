@@ -18,6 +18,8 @@
 #include "circt/Dialect/Handshake/Visitor.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/Utils.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/MathExtras.h"
 
@@ -470,23 +472,24 @@ static FModuleOp createTopModuleOp(handshake::FuncOp funcOp, unsigned numClocks,
 // FIRRTL Sub-module Related Functions
 //===----------------------------------------------------------------------===//
 
-/// Check whether a submodule with the same name has been created elsewhere.
-/// Return the matched submodule if true, otherwise return nullptr.
-static FModuleOp checkSubModuleOp(FModuleOp topModuleOp, Operation *oldOp) {
-  for (auto &op : topModuleOp->getParentRegion()->front()) {
-    if (auto subModuleOp = dyn_cast<FModuleOp>(op)) {
-      if (getSubModuleName(oldOp) == subModuleOp.getName()) {
-        return subModuleOp;
-      }
-    }
-  }
-  return FModuleOp(nullptr);
-}
+namespace {
+/// The sub-modules generated so far, by the name from getSubModuleName(),
+/// which identifies the operation and the signature they implement. A
+/// sub-module can only be instantiated within its circuit, so the ones
+/// generated for another handshake function are cloned into the circuit of
+/// the current one instead of being built again.
+struct SubModuleCache {
+  /// The sub-modules of the circuit being generated.
+  llvm::StringMap<FModuleOp> circuitModules;
+  /// The first sub-module generated for each name, across all circuits.
+  llvm::StringMap<FModuleOp> generated;
+};
+} // namespace
 
 /// All standard expressions and handshake elastic components will be converted
 /// to a FIRRTL sub-module and be instantiated in the top-module.
 static FModuleOp createSubModuleOp(FModuleOp topModuleOp, Operation *oldOp,
-                                   bool hasClock,
+                                   StringRef subModuleName, bool hasClock,
                                    ConversionPatternRewriter &rewriter) {
   rewriter.setInsertionPoint(topModuleOp);
   llvm::SmallVector<ModulePortInfo, 8> ports;
@@ -529,8 +532,27 @@ static FModuleOp createSubModuleOp(FModuleOp topModuleOp, Operation *oldOp,
   }
 
   return rewriter.create<FModuleOp>(
-      topModuleOp.getLoc(), rewriter.getStringAttr(getSubModuleName(oldOp)),
-      ports);
+      topModuleOp.getLoc(), rewriter.getStringAttr(subModuleName), ports);
+}
+
+/// Replace the output subfields of `oldOp` in `portList` with wires of the same
+/// types, returning the original subfields.
+static ValueVectorList
+replaceOutputsWithWires(Operation *oldOp, ValueVectorList &portList,
+                        Location insertLoc,
+                        ConversionPatternRewriter &rewriter) {
+  static const char *const fieldNames[] = {"Valid", "Ready", "Data"};
+  ValueVectorList outputs;
+  for (unsigned i = 0, e = oldOp->getNumResults(); i < e; ++i) {
+    ValueVector &subfields = portList[oldOp->getNumOperands() + i];
+    outputs.push_back(subfields);
+    for (unsigned j = 0, f = subfields.size(); j < f; ++j)
+      subfields[j] = rewriter.create<WireOp>(
+          insertLoc,
+          subfields[j].getType().cast<FIRRTLType>().getPassiveType(),
+          "out" + std::to_string(i) + fieldNames[j]);
+  }
+  return outputs;
 }
 
 /// Extract all subfields of all ports of the sub-module.
@@ -733,6 +755,22 @@ private:
 };
 } // namespace
 
+namespace {
+/// The operations whose outputs go through elastic buffers, and the number of
+/// buffer stages on each output.
+struct PipelinePolicy {
+  llvm::StringSet<> ops;
+  unsigned stages = 1;
+
+  /// Return the buffer stages on the outputs of `op`.
+  unsigned getStages(Operation *op) const {
+    if (!isa<ForkOp, JoinOp, MergeOp, ControlMergeOp>(op))
+      return 0;
+    return ops.count(op->getName().stripDialect()) ? stages : 0;
+  }
+};
+} // namespace
+
 /// Please refer to test_sink.mlir test case.
 bool HandshakeBuilder::visitHandshake(SinkOp op) {
   ValueVector argSubfields = portList.front();
@@ -2065,7 +2103,8 @@ static void convertReturnOp(Operation *oldOp, FModuleOp topModuleOp,
 /// 1)  Create and go into a new FIRRTL top-module;
 /// 2)  Inline Handshake FuncOp region into the FIRRTL top-module;
 /// 3)  Traverse and convert each Standard or Handshake operation:
-///   i)    Check if an identical sub-module exists. If so, skip to vi);
+///   i)    Check if an identical sub-module exists, or clone it from the
+///         circuit of another function. If so, skip to vi);
 ///   ii)   Create and go into a new FIRRTL sub-module;
 ///   iii)  Extract data (if applied), valid, and ready subfield from each port
 ///         of the sub-module;
@@ -2076,7 +2115,7 @@ static void convertReturnOp(Operation *oldOp, FModuleOp topModuleOp,
 /// 4)  Erase the Handshake FuncOp.
 ///
 /// createTopModuleOp():  1) and 2)
-/// checkSubModuleOp():   3.i)
+/// SubModuleCache:       3.i)
 /// createSubModuleOp():  3.ii)
 /// extractSubfields():   3.iii)
 /// build*Logic():        3.iv)
@@ -2084,7 +2123,10 @@ static void convertReturnOp(Operation *oldOp, FModuleOp topModuleOp,
 ///
 /// Please refer to test_addi.mlir test case.
 struct HandshakeFuncOpLowering : public OpConversionPattern<handshake::FuncOp> {
-  using OpConversionPattern<handshake::FuncOp>::OpConversionPattern;
+  HandshakeFuncOpLowering(MLIRContext *context, SubModuleCache &cache,
+                          const PipelinePolicy &policy)
+      : OpConversionPattern<handshake::FuncOp>(context), cache(cache),
+        policy(policy) {}
 
   LogicalResult
   matchAndRewrite(handshake::FuncOp funcOp, ArrayRef<Value> operands,
@@ -2094,6 +2136,7 @@ struct HandshakeFuncOpLowering : public OpConversionPattern<handshake::FuncOp> {
         funcOp.getLoc(), rewriter.getStringAttr(funcOp.getName()));
     rewriter.setInsertionPointToStart(circuitOp.getBody());
     auto topModuleOp = createTopModuleOp(funcOp, /*numClocks=*/1, rewriter);
+    cache.circuitModules.clear();
 
     // Traverse and convert each operation in funcOp.
     for (Operation &op : topModuleOp.getBody().front()) {
@@ -2103,12 +2146,24 @@ struct HandshakeFuncOpLowering : public OpConversionPattern<handshake::FuncOp> {
       // This branch takes care of all non-timing operations that require to
       // be instantiated in the top-module.
       else if (op.getDialect()->getNamespace() != "firrtl") {
-        FModuleOp subModuleOp = checkSubModuleOp(topModuleOp, &op);
+        unsigned stages = policy.getStages(&op);
+        std::string subModuleName = getSubModuleName(&op);
+        if (stages)
+          subModuleName += "_" + std::to_string(stages) + "stages";
+        FModuleOp &subModuleOp = cache.circuitModules[subModuleName];
         bool hasClock = op.hasTrait<mlir::OpTrait::HasClock>();
 
         // Check if the sub-module already exists.
         if (!subModuleOp) {
-          subModuleOp = createSubModuleOp(topModuleOp, &op, hasClock, rewriter);
+          if (auto generated = cache.generated.lookup(subModuleName)) {
+            rewriter.setInsertionPoint(topModuleOp);
+            subModuleOp = cast<FModuleOp>(rewriter.clone(*generated));
+          }
+        }
+        if (!subModuleOp) {
+          subModuleOp = createSubModuleOp(topModuleOp, &op, subModuleName,
+                                          hasClock || stages, rewriter);
+          cache.generated[subModuleName] = subModuleOp;
 
           Location insertLoc = subModuleOp.getLoc();
           auto &bodyBlock = subModuleOp.getBody().front();
@@ -2117,12 +2172,33 @@ struct HandshakeFuncOpLowering : public OpConversionPattern<handshake::FuncOp> {
           ValueVectorList portList =
               extractSubfields(subModuleOp, insertLoc, rewriter);
 
-          if (HandshakeBuilder(portList, insertLoc, rewriter)
-                  .dispatchHandshakeVisitor(&op)) {
+          // The logic of a pipelined operation drives wires, which are
+          // connected to the outputs through the buffer stages. The clock
+          // and reset ports added for them are not seen by the logic.
+          Value clock, reset;
+          ValueVectorList outputs;
+          if (stages) {
+            clock = portList[portList.size() - 2][0];
+            reset = portList.back()[0];
+            if (!hasClock)
+              portList.resize(portList.size() - 2);
+            outputs = replaceOutputsWithWires(&op, portList, insertLoc,
+                                              rewriter);
+          }
+
+          HandshakeBuilder builder(portList, insertLoc, rewriter);
+          if (builder.dispatchHandshakeVisitor(&op)) {
           } else if (StdExprBuilder(portList, insertLoc, rewriter)
                          .dispatchStdExprVisitor(&op)) {
           } else
             return op.emitError("unsupported operation type");
+
+          for (unsigned i = 0, e = outputs.size(); i < e; ++i) {
+            auto &wires = portList[op.getNumOperands() + i];
+            builder.buildSeqBufferLogic(stages, &wires, &outputs[i], clock,
+                                        reset,
+                                        /*isControl=*/wires.size() == 2);
+          }
         }
 
         // Instantiate the new created sub-module.
@@ -2136,6 +2212,10 @@ struct HandshakeFuncOpLowering : public OpConversionPattern<handshake::FuncOp> {
 
     return success();
   }
+
+private:
+  SubModuleCache &cache;
+  const PipelinePolicy &policy;
 };
 
 namespace {
@@ -2149,8 +2229,25 @@ public:
     target.addLegalDialect<FIRRTLDialect>();
     target.addIllegalDialect<handshake::HandshakeOpsDialect>();
 
+    PipelinePolicy policy;
+    policy.stages = pipelineStages;
+    for (auto &name : pipelineOps) {
+      if (!llvm::is_contained(
+              ArrayRef<StringRef>{"fork", "join", "merge", "control_merge"},
+              name)) {
+        op.emitError("Unknown pipelined operation: ") << name;
+        return signalPassFailure();
+      }
+      policy.ops.insert(name);
+    }
+    if (!pipelineOps.empty() && !pipelineStages) {
+      op.emitError("pipeline-stages must be positive");
+      return signalPassFailure();
+    }
+
+    SubModuleCache cache;
     RewritePatternSet patterns(op.getContext());
-    patterns.insert<HandshakeFuncOpLowering>(op.getContext());
+    patterns.insert<HandshakeFuncOpLowering>(op.getContext(), cache, policy);
 
     if (failed(applyPartialConversion(op, target, std::move(patterns))))
       signalPassFailure();
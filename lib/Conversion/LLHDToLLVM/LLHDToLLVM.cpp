@@ -81,12 +81,54 @@ static Type getLLVMSigType(LLVM::LLVMDialect *dialect) {
                                           {i8PtrTy, i64Ty, i64Ty, i64Ty});
 }
 
+/// Return the load of the field `index` of the signal struct `signal` that is
+/// already emitted in the current block of `builder`, before its insertion
+/// point, if there is one.
+static Value findSignalField(OpBuilder &builder, Value signal, int64_t index) {
+  Block *block = builder.getInsertionBlock();
+  auto insertPt = builder.getInsertionPoint();
+  auto isBefore = [&](Operation *op) {
+    return op->getBlock() == block &&
+           (insertPt == block->end() || op->isBeforeInBlock(&*insertPt));
+  };
+  auto isConstant = [](Value value, int64_t expected) {
+    auto constant = value.getDefiningOp<LLVM::ConstantOp>();
+    if (!constant)
+      return false;
+    auto attr = constant.value().dyn_cast<IntegerAttr>();
+    return attr && attr.getInt() == expected;
+  };
+
+  for (auto *user : signal.getUsers()) {
+    auto gep = dyn_cast<LLVM::GEPOp>(user);
+    if (!gep || gep.base() != signal || gep.indices().size() != 2 ||
+        !isConstant(gep.indices()[0], 0) ||
+        !isConstant(gep.indices()[1], index) || !isBefore(gep))
+      continue;
+    for (auto *gepUser : gep->getUsers())
+      if (isa<LLVM::LoadOp>(gepUser) && isBefore(gepUser))
+        return gepUser->getResult(0);
+  }
+  return {};
+}
+
 /// Extract the details from the given signal struct. The details are returned
-/// in the original struct order.
+/// in the original struct order. The details of a signal never change once it
+/// is allocated, so the ones already extracted in the current block, which
+/// runs within a single activation of the unit, are reused.
 static std::vector<Value> getSignalDetail(ConversionPatternRewriter &rewriter,
                                           LLVM::LLVMDialect *dialect,
                                           Location loc, Value signal,
                                           bool extractIndices = false) {
+  std::vector<Value> cached;
+  for (int64_t i = 0, e = extractIndices ? 4 : 2; i < e; ++i) {
+    auto field = findSignalField(rewriter, signal, i);
+    if (!field)
+      break;
+    cached.push_back(field);
+  }
+  if (cached.size() == (extractIndices ? 4u : 2u))
+    return cached;
 
   auto i8PtrTy =
       LLVM::LLVMPointerType::get(IntegerType::get(dialect->getContext(), 8));
@@ -682,6 +724,62 @@ static Value arrayBoundaryCheck(Location loc,
   return arg;
 }
 
+/// Return the size of `type` in bytes as a constant of type `resultTy`.
+static Value getSizeOf(OpBuilder &builder, Location loc, Type type,
+                       Type resultTy) {
+  auto ptrTy = LLVM::LLVMPointerType::get(type);
+  auto oneC = builder.create<LLVM::ConstantOp>(loc, builder.getI32Type(),
+                                               builder.getI32IntegerAttr(1));
+  auto null = builder.create<LLVM::NullOp>(loc, ptrTy);
+  auto gep = builder.create<LLVM::GEPOp>(loc, ptrTy, null,
+                                         ArrayRef<Value>({oneC}));
+  return builder.create<LLVM::PtrToIntOp>(loc, resultTy, gep);
+}
+
+/// Arrays of at least this many elements are sliced through memory, with a
+/// single copy, instead of element by element. The copies lower to wide moves
+/// in the generated code.
+static constexpr unsigned wideArrayLength = 8;
+
+/// Store `value` into a new stack slot and return the pointer to the slot.
+static Value spillToStack(Location loc, ConversionPatternRewriter &rewriter,
+                          Value value) {
+  auto oneC = rewriter.create<LLVM::ConstantOp>(loc, rewriter.getI32Type(),
+                                                rewriter.getI32IntegerAttr(1));
+  auto ptr = rewriter.create<LLVM::AllocaOp>(
+      loc, LLVM::LLVMPointerType::get(value.getType()), ArrayRef<Value>(oneC));
+  rewriter.create<LLVM::StoreOp>(loc, value, ptr);
+  return ptr;
+}
+
+/// Load a value of array type `sliceTy` starting at element `index` of the
+/// array pointed to by `arrPtr`, with a memcpy from the array to a new stack
+/// slot.
+static Value loadArraySlice(Location loc, ConversionPatternRewriter &rewriter,
+                            Type sliceTy, Value arrPtr, Value index) {
+  auto i8PtrTy = LLVM::LLVMPointerType::get(rewriter.getIntegerType(8));
+  auto i64Ty = rewriter.getI64Type();
+  auto elemTy = sliceTy.cast<LLVM::LLVMArrayType>().getElementType();
+  auto slicePtrTy = LLVM::LLVMPointerType::get(sliceTy);
+
+  auto zeroC = rewriter.create<LLVM::ConstantOp>(
+      loc, index.getType(), rewriter.getIntegerAttr(index.getType(), 0));
+  auto src = rewriter.create<LLVM::GEPOp>(
+      loc, LLVM::LLVMPointerType::get(elemTy), arrPtr,
+      ArrayRef<Value>({zeroC, index}));
+  auto oneC = rewriter.create<LLVM::ConstantOp>(loc, rewriter.getI32Type(),
+                                                rewriter.getI32IntegerAttr(1));
+  auto slicePtr =
+      rewriter.create<LLVM::AllocaOp>(loc, slicePtrTy, ArrayRef<Value>(oneC));
+  auto falseC = rewriter.create<LLVM::ConstantOp>(
+      loc, rewriter.getI1Type(), rewriter.getBoolAttr(false));
+  rewriter.create<LLVM::MemcpyOp>(
+      loc, rewriter.create<LLVM::BitcastOp>(loc, i8PtrTy, slicePtr),
+      rewriter.create<LLVM::BitcastOp>(loc, i8PtrTy, src),
+      getSizeOf(rewriter, loc, sliceTy, i64Ty), falseC);
+  return rewriter.create<LLVM::LoadOp>(loc, sliceTy, slicePtr);
+}
+
 //===----------------------------------------------------------------------===//
 // Type conversions
 //===----------------------------------------------------------------------===//
@@ -1087,13 +1185,185 @@ struct WaitOpConversion : public ConvertToLLVMPattern {
 };
 } // namespace
 
+/// Create a constant global holding an array of `rows`, built by `buildRow`
+/// in the initializer region of the global.
+template <typename T>
+static LLVM::GlobalOp
+createLayoutTable(ModuleOp module, Location loc, StringRef name, Type rowTy,
+                  ArrayRef<T> rows,
+                  function_ref<Value(OpBuilder &, const T &)> buildRow) {
+  OpBuilder moduleBuilder(module.getBodyRegion());
+  auto tableTy = LLVM::LLVMArrayType::get(rowTy, rows.size());
+  auto table = moduleBuilder.create<LLVM::GlobalOp>(
+      loc, tableTy, /*isConstant=*/true, LLVM::Linkage::Internal, name,
+      Attribute());
+  auto *block = new Block();
+  table.getInitializerRegion().push_back(block);
+  auto builder = OpBuilder::atBlockBegin(block);
+
+  Value value = builder.create<LLVM::UndefOp>(loc, tableTy);
+  for (auto row : llvm::enumerate(rows))
+    value = builder.create<LLVM::InsertValueOp>(
+        loc, value, buildRow(builder, row.value()),
+        builder.getI32ArrayAttr(row.index()));
+  builder.create<LLVM::ReturnOp>(loc, value);
+  return table;
+}
+
+/// The kinds of the fields of a unit state that a checkpoint relocates. They
+/// match the StateRelocation kinds of the runtime.
+enum class RelocationKind : uint64_t { signalDetail = 0, signalDetailPtr = 1 };
+
+/// Return true if `type` holds a signal struct or a pointer to one.
+static bool containsSignal(Type type, Type sigTy) {
+  if (type == sigTy || type == LLVM::LLVMPointerType::get(sigTy))
+    return true;
+  if (auto structTy = type.dyn_cast<LLVM::LLVMStructType>())
+    return llvm::any_of(structTy.getBody(), [&](Type elemTy) {
+      return containsSignal(elemTy, sigTy);
+    });
+  if (auto arrayTy = type.dyn_cast<LLVM::LLVMArrayType>())
+    return containsSignal(arrayTy.getElementType(), sigTy);
+  return false;
+}
+
+/// Collect the GEP index paths into `type` of the signal structs, which hold a
+/// pointer to the signal value, and of the pointers to signal structs.
+static void
+collectRelocations(Type type, Type sigTy, SmallVectorImpl<int32_t> &path,
+                   SmallVectorImpl<std::pair<SmallVector<int32_t, 4>,
+                                             RelocationKind>> &relocations) {
+  if (type == sigTy) {
+    relocations.push_back({SmallVector<int32_t, 4>(path.begin(), path.end()),
+                           RelocationKind::signalDetail});
+    return;
+  }
+  if (type == LLVM::LLVMPointerType::get(sigTy)) {
+    relocations.push_back({SmallVector<int32_t, 4>(path.begin(), path.end()),
+                           RelocationKind::signalDetailPtr});
+    return;
+  }
+  auto visit = [&](int32_t index, Type elemTy) {
+    if (!containsSignal(elemTy, sigTy))
+      return;
+    path.push_back(index);
+    collectRelocations(elemTy, sigTy, path, relocations);
+    path.pop_back();
+  };
+  if (auto structTy = type.dyn_cast<LLVM::LLVMStructType>())
+    for (auto elemTy : llvm::enumerate(structTy.getBody()))
+      visit(elemTy.index(), elemTy.value());
+  else if (auto arrayTy = type.dyn_cast<LLVM::LLVMArrayType>())
+    for (unsigned i = 0, e = arrayTy.getNumElements(); i < e; ++i)
+      visit(i, arrayTy.getElementType());
+}
+
+/// Get or create the relocation table of the states of `unit`, of type
+/// `stateTy`. It lists the offset and kind of each field of the state holding
+/// a signal struct or a pointer to one, which a checkpoint can't store as is.
+/// Return a null global if there are no such fields.
+static LLVM::GlobalOp getRelocationTable(ModuleOp module, Location loc,
+                                         StringRef unit, Type stateTy,
+                                         unsigned &numRelocations) {
+  auto *ctx = module.getContext();
+  auto sigTy = getLLVMSigType(ctx->getOrLoadDialect<LLVM::LLVMDialect>());
+  using Relocation = std::pair<SmallVector<int32_t, 4>, RelocationKind>;
+  SmallVector<int32_t, 4> path;
+  SmallVector<Relocation> relocations;
+  collectRelocations(stateTy, sigTy, path, relocations);
+  numRelocations = relocations.size();
+  if (relocations.empty())
+    return {};
+
+  auto name = ("relocations." + unit).str();
+  if (auto table = module.lookupSymbol<LLVM::GlobalOp>(name))
+    return table;
+
+  auto i32Ty = IntegerType::get(ctx, 32);
+  auto i64Ty = IntegerType::get(ctx, 64);
+  auto rowTy = LLVM::LLVMStructType::getLiteral(ctx, {i64Ty, i64Ty});
+  return createLayoutTable<Relocation>(
+      module, loc, name, rowTy, relocations,
+      [&](OpBuilder &builder, const Relocation &relocation) -> Value {
+        // The offset of the field, from a GEP into a null state.
+        SmallVector<Value, 4> indices;
+        indices.push_back(builder.create<LLVM::ConstantOp>(
+            loc, i32Ty, builder.getI32IntegerAttr(0)));
+        Type fieldTy = stateTy;
+        for (auto index : relocation.first) {
+          indices.push_back(builder.create<LLVM::ConstantOp>(
+              loc, i32Ty, builder.getI32IntegerAttr(index)));
+          if (auto structTy = fieldTy.dyn_cast<LLVM::LLVMStructType>())
+            fieldTy = structTy.getBody()[index];
+          else
+            fieldTy = fieldTy.cast<LLVM::LLVMArrayType>().getElementType();
+        }
+        auto null = builder.create<LLVM::NullOp>(
+            loc, LLVM::LLVMPointerType::get(stateTy));
+        auto gep = builder.create<LLVM::GEPOp>(
+            loc, LLVM::LLVMPointerType::get(fieldTy), null, indices);
+        Value row = builder.create<LLVM::UndefOp>(loc, rowTy);
+        row = builder.create<LLVM::InsertValueOp>(
+            loc, row, builder.create<LLVM::PtrToIntOp>(loc, i64Ty, gep),
+            builder.getI32ArrayAttr(0));
+        auto kind = builder.create<LLVM::ConstantOp>(
+            loc, i64Ty,
+            builder.getI64IntegerAttr((uint64_t)relocation.second));
+        return builder.create<LLVM::InsertValueOp>(loc, row, kind,
+                                                   builder.getI32ArrayAttr(1));
+      });
+}
+
 namespace {
+/// The instances and signals of the design collected by the static-layout
+/// lowering of the instances, emitted as constant tables once all instances
+/// are lowered.
+struct StaticLayout {
+  struct Signal {
+    LLVM::GlobalOp owner;
+    unsigned index;
+    LLVM::GlobalOp init;
+  };
+  struct Instance {
+    LLVM::GlobalOp owner;
+    bool isEntity;
+    unsigned numSenses;
+    Type stateTy;
+    /// The relocation table of the state, null if it has no entries.
+    LLVM::GlobalOp relocations;
+    unsigned numRelocations;
+  };
+  SmallVector<Signal> signals;
+  SmallVector<Instance> instances;
+};
+
+/// The single allocation of the init function that the instance lowering
+/// carves the entity and process states and the signal values out of, in
+/// place of one malloc for each.
+struct InitArena {
+  /// The allocArena call at the start of the init function. Its size operand
+  /// is updated as the instances are lowered.
+  LLVM::CallOp alloc;
+  /// The size of the arena so far, computed before the allocArena call.
+  Value size;
+};
+
+/// The alignment of every allocation carved out of the arena, enough for the
+/// widest integers.
+static constexpr uint64_t arenaAlignment = 16;
+
 /// Lower an llhd.inst operation to LLVM dialect. This generates malloc calls
 /// and allocSignal calls (to store the pointer into the state) for each signal
-/// in the instantiated entity.
+/// in the instantiated entity. With an arena, the states and signal values
+/// are carved out of it instead of malloc'd, next to the other allocations of
+/// the instance. With a static layout, the instance and its signals are only
+/// recorded in the layout instead.
 struct InstOpConversion : public ConvertToLLVMPattern {
-  explicit InstOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter)
-      : ConvertToLLVMPattern(InstOp::getOperationName(), ctx, typeConverter) {}
+  explicit InstOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter,
+                            StaticLayout *layout = nullptr,
+                            InitArena *arena = nullptr)
+      : ConvertToLLVMPattern(InstOp::getOperationName(), ctx, typeConverter),
+        layout(layout), arena(arena) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -1104,6 +1374,12 @@ struct InstOpConversion : public ConvertToLLVMPattern {
     auto module = op->getParentOfType<ModuleOp>();
     auto entity = op->getParentOfType<EntityOp>();
 
+    if (layout) {
+      addToLayout(instOp, module, entity);
+      rewriter.eraseOp(op);
+      return success();
+    }
+
     auto voidTy = getVoidType();
     auto i8PtrTy = getVoidPtrType();
     auto i1Ty = IntegerType::get(rewriter.getContext(), 1);
@@ -1116,11 +1392,28 @@ struct InstOpConversion : public ConvertToLLVMPattern {
         getOrInsertFunction(module, rewriter, op->getLoc(), "llhd_init",
                             initFuncTy, /*insertBodyAndTerminator=*/true);
 
-    // Get or insert the malloc function definition.
+    // Get or insert the malloc function definition, or allocate the arena at
+    // the start of the init function.
     // Malloc function signature: (i64 %size) -> i8* %pointer.
-    auto mallocSigFuncTy = LLVM::LLVMFunctionType::get(i8PtrTy, {i64Ty});
-    auto mallFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
-                                        "malloc", mallocSigFuncTy);
+    // allocArena function signature: (i8* %state, i64 %size) -> i8* %arena.
+    LLVM::LLVMFuncOp mallFunc;
+    if (!arena) {
+      auto mallocSigFuncTy = LLVM::LLVMFunctionType::get(i8PtrTy, {i64Ty});
+      mallFunc = getOrInsertFunction(module, rewriter, op->getLoc(), "malloc",
+                                     mallocSigFuncTy);
+    } else if (!arena->alloc) {
+      auto allocArenaFuncTy =
+          LLVM::LLVMFunctionType::get(i8PtrTy, {i8PtrTy, i64Ty});
+      auto allocArenaFunc = getOrInsertFunction(
+          module, rewriter, op->getLoc(), "allocArena", allocArenaFuncTy);
+      auto arenaBuilder =
+          OpBuilder::atBlockBegin(&initFunc.getBody().getBlocks().front());
+      arena->size = arenaBuilder.create<LLVM::ConstantOp>(
+          op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(0));
+      arena->alloc = arenaBuilder.create<LLVM::CallOp>(
+          op->getLoc(), i8PtrTy, rewriter.getSymbolRefAttr(allocArenaFunc),
+          ArrayRef<Value>({initFunc.getArgument(0), arena->size}));
+    }
 
     // Get or insert the allocSignal library call definition.
     // allocSignal function signature: (i8* %state, i8* %sig_name, i8*
@@ -1148,14 +1441,18 @@ struct InstOpConversion : public ConvertToLLVMPattern {
                             "addSigStructElement", addSigStructElemFuncTy);
 
     // Get or insert allocProc library call definition.
-    auto allocProcFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    // Signature: (i8* state, i8* owner, i8* procState, i64 size,
+    // i8* relocations, i64 numRelocations) -> void
+    auto allocProcFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty, i8PtrTy, i64Ty});
     auto allocProcFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
                                              "allocProc", allocProcFuncTy);
 
     // Get or insert allocEntity library call definition.
-    auto allocEntityFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    // Signature: (i8* state, i8* owner, i8* entityState, i64 size,
+    // i8* relocations, i64 numRelocations) -> void
+    auto allocEntityFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty, i8PtrTy, i64Ty});
     auto allocEntityFunc = getOrInsertFunction(
         module, rewriter, op->getLoc(), "allocEntity", allocEntityFuncTy);
 
@@ -1198,12 +1495,8 @@ struct InstOpConversion : public ConvertToLLVMPattern {
           initBuilder.create<LLVM::PtrToIntOp>(op->getLoc(), i64Ty, regGep);
 
       // Malloc reg state.
-      auto regMall =
-          initBuilder
-              .create<LLVM::CallOp>(op->getLoc(), i8PtrTy,
-                                    rewriter.getSymbolRefAttr(mallFunc),
-                                    ArrayRef<Value>({regSize}))
-              .getResult(0);
+      auto regMall = allocate(initBuilder, op->getLoc(), mallFunc, regSize,
+                              regStateTy, 1);
       auto regMallBC = initBuilder.create<LLVM::BitcastOp>(
           op->getLoc(), regStatePtrTy, regMall);
       auto zeroB = initBuilder.create<LLVM::ConstantOp>(
@@ -1230,9 +1523,13 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       }
 
       // Add reg state pointer to global state.
+      Value relocations, numRelocations;
+      getRelocations(initBuilder, op->getLoc(), module, child.getName(),
+                     regStateTy, relocations, numRelocations);
       initBuilder.create<LLVM::CallOp>(
           op->getLoc(), voidTy, rewriter.getSymbolRefAttr(allocEntityFunc),
-          ArrayRef<Value>({initStatePtr, owner, regMall}));
+          ArrayRef<Value>({initStatePtr, owner, regMall, regSize, relocations,
+                           numRelocations}));
 
       // Index of the signal in the entity's signal table.
       int initCounter = 0;
@@ -1266,12 +1563,8 @@ struct InstOpConversion : public ConvertToLLVMPattern {
         // shifts do not segfault.
         auto mallocSize =
             initBuilder.create<LLVM::MulOp>(op.getLoc(), i64Ty, size, twoC);
-        std::array<Value, 1> margs({mallocSize});
-        auto mall = initBuilder
-                        .create<LLVM::CallOp>(
-                            op.getLoc(), i8PtrTy,
-                            rewriter.getSymbolRefAttr(mallFunc), margs)
-                        .getResult(0);
+        auto mall = allocate(initBuilder, op.getLoc(), mallFunc, mallocSize,
+                             underlyingTy, 2);
 
         // Store the initial value.
         auto bitcast = initBuilder.create<LLVM::BitcastOp>(
@@ -1383,13 +1676,9 @@ struct InstOpConversion : public ConvertToLLVMPattern {
           ArrayRef<Value>({oneC}));
       auto procStateSize = initBuilder.create<LLVM::PtrToIntOp>(
           op->getLoc(), i64Ty, procStateGep);
-      std::array<Value, 1> procStateMArgs({procStateSize});
       auto procStateMall =
-          initBuilder
-              .create<LLVM::CallOp>(op->getLoc(), i8PtrTy,
-                                    rewriter.getSymbolRefAttr(mallFunc),
-                                    procStateMArgs)
-              .getResult(0);
+          allocate(initBuilder, op->getLoc(), mallFunc, procStateSize,
+                   procStatePtrTy.getElementType(), 1);
 
       auto procStateBC = initBuilder.create<LLVM::BitcastOp>(
           op->getLoc(), procStatePtrTy, procStateMall);
@@ -1407,12 +1696,9 @@ struct InstOpConversion : public ConvertToLLVMPattern {
           op->getLoc(), sensesPtrTy, sensesNullPtr, ArrayRef<Value>({oneC}));
       auto sensesSize =
           initBuilder.create<LLVM::PtrToIntOp>(op->getLoc(), i64Ty, sensesGep);
-      std::array<Value, 1> senseMArgs({sensesSize});
-      auto sensesMall = initBuilder
-                            .create<LLVM::CallOp>(
-                                op->getLoc(), i8PtrTy,
-                                rewriter.getSymbolRefAttr(mallFunc), senseMArgs)
-                            .getResult(0);
+      auto sensesMall =
+          allocate(initBuilder, op->getLoc(), mallFunc, sensesSize,
+                   sensesPtrTy.getElementType(), 1);
 
       auto sensesBC = initBuilder.create<LLVM::BitcastOp>(
           op->getLoc(), sensesPtrTy, sensesMall);
@@ -1440,7 +1726,13 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       initBuilder.create<LLVM::StoreOp>(op->getLoc(), sensesBC,
                                         procStateSensesPtr);
 
-      std::array<Value, 3> allocProcArgs({initStatePtr, owner, procStateMall});
+      Value relocations, numRelocations;
+      getRelocations(initBuilder, op->getLoc(), module, proc.getName(),
+                     procStatePtrTy.getElementType(), relocations,
+                     numRelocations);
+      std::array<Value, 6> allocProcArgs({initStatePtr, owner, procStateMall,
+                                          procStateSize, relocations,
+                                          numRelocations});
       initBuilder.create<LLVM::CallOp>(op->getLoc(), voidTy,
                                        rewriter.getSymbolRefAttr(allocProcFunc),
                                        allocProcArgs);
@@ -1449,9 +1741,283 @@ struct InstOpConversion : public ConvertToLLVMPattern {
     rewriter.eraseOp(op);
     return success();
   }
+
+private:
+  /// Get the address of the relocation table of the states of `unit` and its
+  /// number of entries, or a null address if there are none.
+  void getRelocations(OpBuilder &initBuilder, Location loc, ModuleOp module,
+                      StringRef unit, Type stateTy, Value &relocations,
+                      Value &numRelocations) const {
+    unsigned count;
+    auto table = getRelocationTable(module, loc, unit, stateTy, count);
+    auto i8PtrTy = getVoidPtrType();
+    if (table) {
+      auto addr = initBuilder.create<LLVM::AddressOfOp>(
+          loc, LLVM::LLVMPointerType::get(table.getType()), table.getName());
+      relocations = initBuilder.create<LLVM::BitcastOp>(loc, i8PtrTy, addr);
+    } else {
+      relocations = initBuilder.create<LLVM::NullOp>(loc, i8PtrTy);
+    }
+    numRelocations = initBuilder.create<LLVM::ConstantOp>(
+        loc, initBuilder.getI64Type(), initBuilder.getI64IntegerAttr(count));
+  }
+
+  /// Allocate `count` values of `type` in the init function, `size` bytes in
+  /// total. With an arena, they are carved out of it at the next free offset,
+  /// which is computed along with the size of the arena before it is
+  /// allocated. Otherwise they are malloc'd.
+  Value allocate(OpBuilder &initBuilder, Location loc,
+                 LLVM::LLVMFuncOp mallFunc, Value size, Type type,
+                 unsigned count) const {
+    auto i8PtrTy = getVoidPtrType();
+    if (!arena)
+      return initBuilder
+          .create<LLVM::CallOp>(loc, i8PtrTy,
+                                initBuilder.getSymbolRefAttr(mallFunc),
+                                ArrayRef<Value>({size}))
+          .getResult(0);
+
+    OpBuilder sizeBuilder(arena->alloc);
+    auto i64Ty = sizeBuilder.getI64Type();
+    auto getConst = [&](uint64_t value) -> Value {
+      return sizeBuilder.create<LLVM::ConstantOp>(
+          loc, i64Ty, sizeBuilder.getI64IntegerAttr(value));
+    };
+    Value arenaSize = getSizeOf(sizeBuilder, loc, type, i64Ty);
+    if (count != 1)
+      arenaSize = sizeBuilder.create<LLVM::MulOp>(loc, i64Ty, arenaSize,
+                                                  getConst(count));
+
+    // Round the end of the allocation up, such that the next one is aligned.
+    Value offset = arena->size;
+    Value end = sizeBuilder.create<LLVM::AddOp>(loc, i64Ty, offset, arenaSize);
+    end = sizeBuilder.create<LLVM::AddOp>(loc, i64Ty, end,
+                                          getConst(arenaAlignment - 1));
+    end = sizeBuilder.create<LLVM::AndOp>(loc, i64Ty, end,
+                                          getConst(~(arenaAlignment - 1)));
+    arena->size = end;
+    arena->alloc->setOperand(1, end);
+
+    return initBuilder.create<LLVM::GEPOp>(loc, i8PtrTy,
+                                           arena->alloc.getResult(0),
+                                           ArrayRef<Value>({offset}));
+  }
+
+  /// Record the instance and the signals of its entity in the layout. The
+  /// initial value of each signal is cloned once per entity, into the
+  /// initializer of a constant global.
+  void addToLayout(InstOp instOp, ModuleOp module, EntityOp entity) const {
+    auto loc = instOp.getLoc();
+    auto i1Ty = IntegerType::get(module.getContext(), 1);
+    auto i8Ty = IntegerType::get(module.getContext(), 8);
+    auto i32Ty = IntegerType::get(module.getContext(), 32);
+    OpBuilder moduleBuilder(module.getBodyRegion());
+
+    // Get the init function, which only maps the layout tables.
+    if (!module.lookupSymbol<LLVM::LLVMFuncOp>("llhd_init")) {
+      auto initFunc = moduleBuilder.create<LLVM::LLVMFuncOp>(
+          loc, "llhd_init",
+          LLVM::LLVMFunctionType::get(getVoidType(), {getVoidPtrType()}));
+      initFunc.addEntryBlock();
+      OpBuilder b(initFunc.getBody());
+      b.create<LLVM::ReturnOp>(loc, ValueRange());
+    }
+
+    // Get or create the owner name string.
+    auto ownerName = entity.getName().str() + "." + instOp.name().str();
+    auto owner = module.lookupSymbol<LLVM::GlobalOp>("instance." + ownerName);
+    if (!owner)
+      owner = moduleBuilder.create<LLVM::GlobalOp>(
+          loc, LLVM::LLVMArrayType::get(i8Ty, ownerName.size() + 1),
+          /*isConstant=*/true, LLVM::Linkage::Internal, "instance." + ownerName,
+          moduleBuilder.getStringAttr(ownerName + '\0'));
+
+    if (auto child = module.lookupSymbol<EntityOp>(instOp.callee())) {
+      auto stateTy = getRegStateTy(&getDialect(), child.getOperation());
+      unsigned numRelocations;
+      auto relocations = getRelocationTable(module, loc, child.getName(),
+                                            stateTy, numRelocations);
+      layout->instances.push_back(
+          {owner, true, 0, stateTy, relocations, numRelocations});
+
+      unsigned index = 0;
+      child.walk([&](SigOp sigOp) {
+        auto initName =
+            ("init." + child.getName() + "." + Twine(index)).str();
+        auto init = module.lookupSymbol<LLVM::GlobalOp>(initName);
+        if (!init) {
+          auto initTy = typeConverter->convertType(sigOp.init().getType());
+          init = moduleBuilder.create<LLVM::GlobalOp>(
+              sigOp.getLoc(), initTy, /*isConstant=*/true,
+              LLVM::Linkage::Internal, initName, Attribute());
+          auto *block = new Block();
+          init.getInitializerRegion().push_back(block);
+          auto initBuilder = OpBuilder::atBlockBegin(block);
+          auto initDef =
+              recursiveCloneInit(initBuilder, sigOp.init().getDefiningOp());
+          initBuilder.create<LLVM::ReturnOp>(sigOp.getLoc(),
+                                             initDef->getResult(0));
+        }
+        layout->signals.push_back({owner, index++, init});
+      });
+    } else if (auto proc = module.lookupSymbol<ProcOp>(instOp.callee())) {
+      auto sensesPtrTy = LLVM::LLVMPointerType::get(
+          LLVM::LLVMArrayType::get(i1Ty, proc.getNumArguments()));
+      auto procStateTy = LLVM::LLVMStructType::getLiteral(
+          module.getContext(),
+          {i32Ty, i32Ty, sensesPtrTy,
+           getProcPersistenceTy(&getDialect(), typeConverter, proc)});
+      unsigned numRelocations;
+      auto relocations = getRelocationTable(module, loc, proc.getName(),
+                                            procStateTy, numRelocations);
+      layout->instances.push_back({owner, false, proc.getNumArguments(),
+                                   procStateTy, relocations, numRelocations});
+    }
+  }
+
+  StaticLayout *layout;
+  InitArena *arena;
 };
 } // namespace
 
+/// Emit the layout collected by the instance lowering as constant tables, and
+/// map them to the state with a single allocLayout call in the init function.
+static void emitStaticLayout(ModuleOp module, StaticLayout &layout) {
+  auto initFunc = module.lookupSymbol<LLVM::LLVMFuncOp>("llhd_init");
+  if (!initFunc)
+    return;
+  auto loc = initFunc.getLoc();
+  auto *ctx = module.getContext();
+  auto voidTy = LLVM::LLVMVoidType::get(ctx);
+  auto i8PtrTy = LLVM::LLVMPointerType::get(IntegerType::get(ctx, 8));
+  auto i32Ty = IntegerType::get(ctx, 32);
+  auto i64Ty = IntegerType::get(ctx, 64);
+
+  // Table rows, matching the LayoutInstance, LayoutSignal and LayoutElement
+  // structs of the runtime.
+  auto instRowTy = LLVM::LLVMStructType::getLiteral(
+      ctx, {i8PtrTy, i32Ty, i32Ty, i64Ty, i8PtrTy, i64Ty});
+  auto sigRowTy = LLVM::LLVMStructType::getLiteral(
+      ctx, {i8PtrTy, i32Ty, i8PtrTy, i64Ty, i64Ty, i32Ty, i32Ty, i32Ty, i32Ty});
+  auto elemRowTy = LLVM::LLVMStructType::getLiteral(ctx, {i32Ty, i32Ty});
+
+  auto getAddress = [&](OpBuilder &builder, LLVM::GlobalOp global) -> Value {
+    auto addr = builder.create<LLVM::AddressOfOp>(
+        loc, LLVM::LLVMPointerType::get(global.getType()), global.getName());
+    return builder.create<LLVM::BitcastOp>(loc, i8PtrTy, addr);
+  };
+  auto getConst = [&](OpBuilder &builder, Type type, uint64_t value) -> Value {
+    return builder.create<LLVM::ConstantOp>(
+        loc, type, builder.getIntegerAttr(type, value));
+  };
+  auto buildStruct = [&](OpBuilder &builder, Type type,
+                         ArrayRef<Value> fields) -> Value {
+    Value value = builder.create<LLVM::UndefOp>(loc, type);
+    for (auto field : llvm::enumerate(fields))
+      value = builder.create<LLVM::InsertValueOp>(
+          loc, value, field.value(), builder.getI32ArrayAttr(field.index()));
+    return value;
+  };
+
+  auto instances = createLayoutTable<StaticLayout::Instance>(
+      module, loc, "layout.instances", instRowTy, layout.instances,
+      [&](OpBuilder &builder, const StaticLayout::Instance &inst) {
+        Value relocations =
+            inst.relocations
+                ? getAddress(builder, inst.relocations)
+                : builder.create<LLVM::NullOp>(loc, i8PtrTy).getResult();
+        return buildStruct(
+            builder, instRowTy,
+            {getAddress(builder, inst.owner),
+             getConst(builder, i32Ty, inst.isEntity),
+             getConst(builder, i32Ty, inst.numSenses),
+             getSizeOf(builder, loc, inst.stateTy, i64Ty), relocations,
+             getConst(builder, i64Ty, inst.numRelocations)});
+      });
+
+  // Collect the elements of the struct signals, referenced by index from the
+  // signal table.
+  using Element = std::pair<LLVM::LLVMStructType, unsigned>;
+  SmallVector<Element> elements;
+  unsigned numElements = 0;
+  auto signals = createLayoutTable<StaticLayout::Signal>(
+      module, loc, "layout.signals", sigRowTy, layout.signals,
+      [&](OpBuilder &builder, const StaticLayout::Signal &sig) {
+        auto type = sig.init.getType();
+        auto allocSize = getSizeOf(builder, loc, type, i64Ty);
+
+        // Get the amount of bytes required to represent an integer underlying
+        // type. Use the whole size of the type if not an integer.
+        Value size = allocSize;
+        if (auto intTy = type.dyn_cast<IntegerType>())
+          size =
+              getConst(builder, i64Ty, llvm::divideCeil(intTy.getWidth(), 8));
+
+        Value numArrayElements = getConst(builder, i32Ty, 0);
+        Value arrayElementSize = numArrayElements;
+        Value firstStructElement = numArrayElements;
+        Value numStructElements = numArrayElements;
+        if (auto arrayTy = type.dyn_cast<LLVM::LLVMArrayType>()) {
+          numArrayElements =
+              getConst(builder, i32Ty, arrayTy.getNumElements());
+          arrayElementSize =
+              getSizeOf(builder, loc, arrayTy.getElementType(), i32Ty);
+        } else if (auto structTy = type.dyn_cast<LLVM::LLVMStructType>()) {
+          firstStructElement = getConst(builder, i32Ty, numElements);
+          numStructElements =
+              getConst(builder, i32Ty, structTy.getBody().size());
+          for (unsigned i = 0, e = structTy.getBody().size(); i < e; ++i)
+            elements.push_back({structTy, i});
+          numElements += structTy.getBody().size();
+        }
+
+        return buildStruct(builder, sigRowTy,
+                           {getAddress(builder, sig.owner),
+                            getConst(builder, i32Ty, sig.index),
+                            getAddress(builder, sig.init), size, allocSize,
+                            numArrayElements, arrayElementSize,
+                            firstStructElement, numStructElements});
+      });
+
+  auto elementTable = createLayoutTable<Element>(
+      module, loc, "layout.elements", elemRowTy, elements,
+      [&](OpBuilder &builder, const Element &elem) {
+        auto structTy = elem.first;
+        auto elemTy = structTy.getBody()[elem.second];
+        auto null = builder.create<LLVM::NullOp>(
+            loc, LLVM::LLVMPointerType::get(structTy));
+        auto gep = builder.create<LLVM::GEPOp>(
+            loc, LLVM::LLVMPointerType::get(elemTy), null,
+            ArrayRef<Value>({getConst(builder, i32Ty, 0),
+                             getConst(builder, i32Ty, elem.second)}));
+        auto offset = builder.create<LLVM::PtrToIntOp>(loc, i32Ty, gep);
+        return buildStruct(builder, elemRowTy,
+                           {offset, getSizeOf(builder, loc, elemTy, i32Ty)});
+      });
+
+  // Signature: (i8* state, i8* instances, i64 numInstances, i8* signals,
+  // i64 numSignals, i8* elements) -> void
+  auto allocLayoutFunc = module.lookupSymbol<LLVM::LLVMFuncOp>("allocLayout");
+  if (!allocLayoutFunc) {
+    OpBuilder moduleBuilder(module.getBodyRegion());
+    allocLayoutFunc = moduleBuilder.create<LLVM::LLVMFuncOp>(
+        loc, "allocLayout",
+        LLVM::LLVMFunctionType::get(
+            voidTy, {i8PtrTy, i8PtrTy, i64Ty, i8PtrTy, i64Ty, i8PtrTy}));
+  }
+
+  auto initBuilder =
+      OpBuilder::atBlockTerminator(&initFunc.getBody().getBlocks().front());
+  initBuilder.create<LLVM::CallOp>(
+      loc, llvm::None, initBuilder.getSymbolRefAttr(allocLayoutFunc),
+      ArrayRef<Value>(
+          {initFunc.getArgument(0), getAddress(initBuilder, instances),
+           getConst(initBuilder, i64Ty, layout.instances.size()),
+           getAddress(initBuilder, signals),
+           getConst(initBuilder, i64Ty, layout.signals.size()),
+           getAddress(initBuilder, elementTable)}));
+}
+
 //===----------------------------------------------------------------------===//
 // Signal conversions
 //===----------------------------------------------------------------------===//
@@ -1565,9 +2131,11 @@ namespace {
 /// the module if missing. The required arguments are either generated or
 /// fetched.
 struct DrvOpConversion : public ConvertToLLVMPattern {
-  explicit DrvOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter)
+  explicit DrvOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter,
+                           bool inlineDrives)
       : ConvertToLLVMPattern(llhd::DrvOp::getOperationName(), ctx,
-                             typeConverter) {}
+                             typeConverter),
+        inlineDrives(inlineDrives) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -1639,6 +2207,12 @@ struct DrvOpConversion : public ConvertToLLVMPattern {
       rewriter.setInsertionPointToStart(drvBlock);
     }
 
+    // Append the drives of integers of at most 64 bits to the drive buffer of
+    // the thread, unless it is full, instead of calling driveSignal.
+    auto intTy = underlyingTy.dyn_cast<IntegerType>();
+    if (inlineDrives && intTy && intTy.getWidth() <= 64)
+      insertBufferedDrive(op, transformed, statePtr, sigWidth, rewriter);
+
     auto oneConst = rewriter.create<LLVM::ConstantOp>(
         op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(1));
     auto alloca = rewriter.create<LLVM::AllocaOp>(
@@ -1665,6 +2239,99 @@ struct DrvOpConversion : public ConvertToLLVMPattern {
     rewriter.eraseOp(op);
     return success();
   }
+
+private:
+  /// Insert the fast path of a drive: if the drive buffer returned by
+  /// getDriveBuffer has room left, the drive is appended to it and the rest of
+  /// the lowering, calling driveSignal, is skipped. The insertion point is
+  /// left in the slow path.
+  void insertBufferedDrive(Operation *op, DrvOpAdaptor &transformed,
+                           Value statePtr, Value sigWidth,
+                           ConversionPatternRewriter &rewriter) const {
+    auto loc = op->getLoc();
+    auto *ctx = rewriter.getContext();
+    auto module = op->getParentOfType<ModuleOp>();
+    auto i32Ty = IntegerType::get(ctx, 32);
+    auto i64Ty = IntegerType::get(ctx, 64);
+    auto i64PtrTy = LLVM::LLVMPointerType::get(i64Ty);
+    auto sigPtrTy = LLVM::LLVMPointerType::get(getLLVMSigType(&getDialect()));
+    auto recordPtrTy = LLVM::LLVMPointerType::get(
+        LLVM::LLVMStructType::getLiteral(
+            ctx, {sigPtrTy, i64Ty, i64Ty, i64Ty, i64Ty, i64Ty}));
+    auto bufferPtrTy =
+        LLVM::LLVMPointerType::get(LLVM::LLVMStructType::getLiteral(
+            ctx, {i64Ty, i64Ty, recordPtrTy}));
+
+    // The buffer of a thread doesn't change, let LLVM fold the calls made by
+    // a unit into one.
+    auto bufferFunc = getOrInsertFunction(
+        module, rewriter, loc, "getDriveBuffer",
+        LLVM::LLVMFunctionType::get(bufferPtrTy, {getVoidPtrType()}));
+    bufferFunc->setAttr("passthrough",
+                        rewriter.getStrArrayAttr({"readnone", "nounwind"}));
+    auto buffer =
+        rewriter
+            .create<LLVM::CallOp>(loc, bufferPtrTy,
+                                  rewriter.getSymbolRefAttr(bufferFunc),
+                                  statePtr)
+            .getResult(0);
+
+    auto fieldPtr = [&](Type ptrTy, Value base, unsigned field) {
+      auto zeroC = rewriter.create<LLVM::ConstantOp>(
+          loc, i32Ty, rewriter.getI32IntegerAttr(0));
+      auto fieldC = rewriter.create<LLVM::ConstantOp>(
+          loc, i32Ty, rewriter.getI32IntegerAttr(field));
+      return rewriter.create<LLVM::GEPOp>(loc, ptrTy, base,
+                                          ArrayRef<Value>({zeroC, fieldC}));
+    };
+    auto sizePtr = fieldPtr(i64PtrTy, buffer, 0);
+    auto size = rewriter.create<LLVM::LoadOp>(loc, i64Ty, sizePtr);
+    auto capacity = rewriter.create<LLVM::LoadOp>(
+        loc, i64Ty, fieldPtr(i64PtrTy, buffer, 1));
+    auto full = rewriter.create<LLVM::ICmpOp>(loc, LLVM::ICmpPredicate::uge,
+                                              size, capacity);
+
+    auto *block = rewriter.getInsertionBlock();
+    auto *continueBlock =
+        rewriter.splitBlock(block, rewriter.getInsertionPoint());
+    auto *fastBlock = rewriter.createBlock(continueBlock);
+    auto *slowBlock = rewriter.createBlock(continueBlock);
+    rewriter.setInsertionPointToEnd(block);
+    rewriter.create<LLVM::CondBrOp>(loc, full, slowBlock, fastBlock);
+
+    // Fill the next record of the buffer.
+    rewriter.setInsertionPointToStart(fastBlock);
+    SmallVector<Value, 3> time;
+    for (int32_t i = 0; i < 3; ++i)
+      time.push_back(rewriter.create<LLVM::ExtractValueOp>(
+          loc, i64Ty, transformed.time(), rewriter.getI32ArrayAttr(i)));
+    auto records = rewriter.create<LLVM::LoadOp>(
+        loc, recordPtrTy,
+        fieldPtr(LLVM::LLVMPointerType::get(recordPtrTy), buffer, 2));
+    auto record = rewriter.create<LLVM::GEPOp>(loc, recordPtrTy, records,
+                                               ArrayRef<Value>(size));
+    Value value = transformed.value();
+    if (value.getType() != i64Ty)
+      value = rewriter.create<LLVM::ZExtOp>(loc, i64Ty, value);
+    auto signalPtr = fieldPtr(LLVM::LLVMPointerType::get(sigPtrTy), record, 0);
+    rewriter.create<LLVM::StoreOp>(loc, transformed.signal(), signalPtr);
+    std::array<Value, 5> fields({value, sigWidth, time[0], time[1], time[2]});
+    for (size_t i = 0, e = fields.size(); i < e; ++i)
+      rewriter.create<LLVM::StoreOp>(loc, fields[i],
+                                     fieldPtr(i64PtrTy, record, i + 1));
+    auto oneC = rewriter.create<LLVM::ConstantOp>(
+        loc, i64Ty, rewriter.getI64IntegerAttr(1));
+    auto nextSize = rewriter.create<LLVM::AddOp>(loc, size, oneC);
+    rewriter.create<LLVM::StoreOp>(loc, nextSize, sizePtr);
+    rewriter.create<LLVM::BrOp>(loc, ValueRange(), continueBlock);
+
+    rewriter.setInsertionPointToStart(slowBlock);
+    auto slowBr =
+        rewriter.create<LLVM::BrOp>(loc, ValueRange(), continueBlock);
+    rewriter.setInsertionPoint(slowBr);
+  }
+
+  bool inlineDrives;
 };
 } // namespace
 
@@ -2284,6 +2951,16 @@ struct ExtractSliceOpConversion : public ConvertToLLVMPattern {
       auto llvmArrTy = typeConverter->convertType(arrTy);
       size_t startIndex = extsOp.startAttr().getInt();
 
+      // Copy wide slices at once.
+      if (arrTy.getLength() >= wideArrayLength) {
+        auto targetPtr =
+            spillToStack(op->getLoc(), rewriter, transformed.target());
+        rewriter.replaceOp(op, loadArraySlice(op->getLoc(), rewriter,
+                                              llvmArrTy, targetPtr,
+                                              startConst));
+        return success();
+      }
+
       Value slice = rewriter.create<LLVM::UndefOp>(
           op->getLoc(), typeConverter->convertType(arrTy));
 
@@ -2372,6 +3049,42 @@ struct DynExtractSliceOpConversion : public ConvertToLLVMPattern {
           op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(0));
       auto oneC = rewriter.create<LLVM::ConstantOp>(
           op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(1));
+      // Copy wide slices at once, out of a buffer holding the target followed
+      // by as many base values as the slice has elements. Clamping the start
+      // index to the length of the target then yields the base value for all
+      // the elements out of bounds, like the boundary checks below.
+      if (arrTy.getLength() >= wideArrayLength) {
+        auto length = targetTy.cast<LLVM::LLVMArrayType>().getNumElements();
+        auto bufferTy =
+            LLVM::LLVMArrayType::get(elemTy, length + arrTy.getLength());
+        auto bufferPtr = rewriter.create<LLVM::AllocaOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(bufferTy),
+            ArrayRef<Value>(oneC));
+        auto targetPtr = rewriter.create<LLVM::BitcastOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(targetTy), bufferPtr);
+        rewriter.create<LLVM::StoreOp>(op->getLoc(), transformed.target(),
+                                       targetPtr);
+        auto lengthC = rewriter.create<LLVM::ConstantOp>(
+            op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(length));
+        auto tailPtr = rewriter.create<LLVM::GEPOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(elemTy), bufferPtr,
+            ArrayRef<Value>({zeroC, lengthC}));
+        rewriter.create<LLVM::StoreOp>(
+            op->getLoc(), getBaseValue(op->getLoc(), rewriter, llvmArrTy),
+            rewriter.create<LLVM::BitcastOp>(
+                op->getLoc(), LLVM::LLVMPointerType::get(llvmArrTy), tailPtr));
+
+        auto start =
+            adjustBitWidth(op->getLoc(), rewriter, i64Ty, transformed.start());
+        auto inBounds = rewriter.create<LLVM::ICmpOp>(
+            op->getLoc(), LLVM::ICmpPredicate::ult, start, lengthC);
+        auto clamped = rewriter.create<LLVM::SelectOp>(op->getLoc(), inBounds,
+                                                       start, lengthC);
+        rewriter.replaceOp(op, loadArraySlice(op->getLoc(), rewriter,
+                                              llvmArrTy, bufferPtr, clamped));
+        return success();
+      }
+
       auto zextStart = zextByOne(op->getLoc(), rewriter, transformed.start());
 
       // LLVM::ExtractValueOp only takes attribute arguments for the indexes, so
@@ -2595,6 +3308,27 @@ struct InsertSliceOpConversion : public ConvertToLLVMPattern {
       auto llvmSliceTy = transformed.slice().getType();
       size_t startIndex = inssOp.startAttr().getInt();
 
+      // Store wide slices at once into a copy of the target.
+      if (llvmSliceTy.cast<LLVM::LLVMArrayType>().getNumElements() >=
+          wideArrayLength) {
+        auto i32Ty = rewriter.getI32Type();
+        auto targetPtr =
+            spillToStack(op->getLoc(), rewriter, transformed.target());
+        auto zeroC = rewriter.create<LLVM::ConstantOp>(
+            op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(0));
+        auto startC = rewriter.create<LLVM::ConstantOp>(
+            op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(startIndex));
+        auto dst = rewriter.create<LLVM::GEPOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(elemTy), targetPtr,
+            ArrayRef<Value>({zeroC, startC}));
+        rewriter.create<LLVM::StoreOp>(
+            op->getLoc(), transformed.slice(),
+            rewriter.create<LLVM::BitcastOp>(
+                op->getLoc(), LLVM::LLVMPointerType::get(llvmSliceTy), dst));
+        rewriter.replaceOpWithNewOp<LLVM::LoadOp>(op, llvmArrTy, targetPtr);
+        return success();
+      }
+
       Value insert = transformed.target();
       for (size_t i = 0,
                   e = llvmSliceTy.cast<LLVM::LLVMArrayType>().getNumElements();
@@ -2699,6 +3433,12 @@ using LoadOpConversion =
 namespace {
 struct LLHDToLLVMLoweringPass
     : public ConvertLLHDToLLVMBase<LLHDToLLVMLoweringPass> {
+  LLHDToLLVMLoweringPass() = default;
+  LLHDToLLVMLoweringPass(bool inlineDrives, bool staticLayout, bool arena) {
+    this->inlineDrives = inlineDrives;
+    this->staticLayout = staticLayout;
+    this->arena = arena;
+  }
   void runOnOperation() override;
 };
 } // namespace
@@ -2706,7 +3446,8 @@ struct LLHDToLLVMLoweringPass
 void circt::populateLLHDToLLVMConversionPatterns(LLVMTypeConverter &converter,
                                                  RewritePatternSet &patterns,
                                                  size_t &sigCounter,
-                                                 size_t &regCounter) {
+                                                 size_t &regCounter,
+                                                 bool inlineDrives) {
   MLIRContext *ctx = converter.getDialect()->getContext();
 
   // Value creation conversion patterns.
@@ -2737,7 +3478,8 @@ void circt::populateLLHDToLLVMConversionPatterns(LLVMTypeConverter &converter,
   patterns.add<EntityOpConversion>(ctx, converter, sigCounter, regCounter);
 
   // Signal conversion patterns.
-  patterns.add<PrbOpConversion, DrvOpConversion>(ctx, converter);
+  patterns.add<PrbOpConversion>(ctx, converter);
+  patterns.add<DrvOpConversion>(ctx, converter, inlineDrives);
   patterns.add<SigOpConversion>(ctx, converter, sigCounter);
   patterns.add<RegOpConversion>(ctx, converter, regCounter);
 
@@ -2768,7 +3510,11 @@ void LLHDToLLVMLoweringPass::runOnOperation() {
 
   // Apply a partial conversion first, lowering only the instances, to generate
   // the init function.
-  patterns.add<InstOpConversion>(&getContext(), converter);
+  StaticLayout layout;
+  InitArena initArena;
+  patterns.add<InstOpConversion>(&getContext(), converter,
+                                 staticLayout ? &layout : nullptr,
+                                 arena ? &initArena : nullptr);
 
   LLVMConversionTarget target(getContext());
   target.addIllegalOp<InstOp>();
@@ -2780,10 +3526,13 @@ void LLHDToLLVMLoweringPass::runOnOperation() {
     signalPassFailure();
   patterns.clear();
 
+  if (staticLayout)
+    emitStaticLayout(getOperation(), layout);
+
   // Setup the full conversion.
   populateStdToLLVMConversionPatterns(converter, patterns);
   populateLLHDToLLVMConversionPatterns(converter, patterns, sigCounter,
-                                       regCounter);
+                                       regCounter, inlineDrives);
 
   target.addLegalDialect<LLVM::LLVMDialect>();
   target.addLegalOp<ModuleOp>();
@@ -2795,6 +3544,9 @@ void LLHDToLLVMLoweringPass::runOnOperation() {
 }
 
 /// Create an LLHD to LLVM conversion pass.
-std::unique_ptr<OperationPass<ModuleOp>> circt::createConvertLLHDToLLVMPass() {
-  return std::make_unique<LLHDToLLVMLoweringPass>();
+std::unique_ptr<OperationPass<ModuleOp>>
+circt::createConvertLLHDToLLVMPass(bool inlineDrives, bool staticLayout,
+                                   bool arena) {
+  return std::make_unique<LLHDToLLVMLoweringPass>(inlineDrives, staticLayout,
+                                                  arena);
 }
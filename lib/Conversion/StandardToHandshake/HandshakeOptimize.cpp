@@ -0,0 +1,287 @@
+//===- HandshakeOptimize.cpp - Simplify handshake dataflow graphs ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass which removes the forks, sinks and buffers that
+// the lowering from the standard dialect leaves behind without a purpose, and
+// the conditional branches whose condition is a constant.  Every value of
+// handshake IR has a single use, so the rewrites keep each dropped token
+// consumed by a sink.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../PassDetail.h"
+#include "circt/Conversion/StandardToHandshake/StandardToHandshake.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace circt::handshake;
+
+/// Return the sink which is the only use of `value`, if any.
+static SinkOp getSink(Value value) {
+  if (!value.hasOneUse())
+    return {};
+  return dyn_cast<SinkOp>(*value.getUsers().begin());
+}
+
+/// Return true if `op` consumes one token of each operand every time it
+/// fires, and has no effect besides its results, so that it can be replaced
+/// by sinks of its operands once nothing observes its results.
+static bool isRemovableWhenSunk(Operation *op) {
+  if (isa<ForkOp, LazyForkOp, BufferOp, ConstantOp, BranchOp,
+          ConditionalBranchOp, JoinOp, SourceOp, NeverOp>(op))
+    return true;
+  // The merges pick their inputs, and the memory operations have effects.
+  auto *dialect = op->getDialect();
+  if (!dialect || isa<HandshakeOpsDialect>(dialect))
+    return false;
+  return MemoryEffectOpInterface::hasNoEffect(op);
+}
+
+namespace {
+struct HandshakeOptimizePass
+    : public HandshakeOptimizeBase<HandshakeOptimizePass> {
+  void runOnOperation() override;
+
+private:
+  bool simplifyFork(ForkOp fork);
+  bool forkConstant(ForkOp fork);
+  bool mergeBuffers(BufferOp buffer);
+  bool simplifyBranch(ConditionalBranchOp branch);
+  bool removeNeverInputs(MergeOp merge);
+  bool removeDeadOp(Operation *op);
+
+  void erase(Operation *op) {
+    erased.insert(op);
+    op->erase();
+  }
+
+  /// The operations erased in the current round, which may still be queued.
+  llvm::SmallPtrSet<Operation *, 16> erased;
+};
+} // end anonymous namespace
+
+/// Drop the outputs of `fork` which go into sinks, and take over the outputs
+/// of the forks it feeds.
+bool HandshakeOptimizePass::simplifyFork(ForkOp fork) {
+  Value operand = fork.getOperand();
+  SmallVector<Value> outputs;
+  SmallVector<Operation *> absorbed;
+  unsigned merged = 0, removed = 0;
+  for (auto result : fork.getResults()) {
+    if (auto sink = getSink(result)) {
+      absorbed.push_back(sink);
+      ++removed;
+      continue;
+    }
+    if (result.hasOneUse()) {
+      auto child = dyn_cast<ForkOp>(*result.getUsers().begin());
+      if (child && child != operand.getDefiningOp()) {
+        llvm::append_range(outputs, child.getResults());
+        absorbed.push_back(child);
+        ++merged;
+        continue;
+      }
+    }
+    outputs.push_back(result);
+  }
+  if (absorbed.empty())
+    return false;
+
+  OpBuilder builder(fork);
+  if (outputs.empty()) {
+    builder.create<SinkOp>(fork.getLoc(), operand);
+  } else if (outputs.size() == 1) {
+    outputs.front().replaceAllUsesWith(operand);
+  } else {
+    auto newFork =
+        builder.create<ForkOp>(fork.getLoc(), operand, outputs.size());
+    for (auto it : llvm::zip(outputs, newFork.getResults()))
+      std::get<0>(it).replaceAllUsesWith(std::get<1>(it));
+  }
+  for (auto *op : absorbed)
+    erase(op);
+  erase(fork);
+
+  numForksMerged += merged;
+  numForkOutputsRemoved += removed;
+  return true;
+}
+
+/// Replace the fork of a constant by one constant per output, triggered by a
+/// fork of its control, which exposes the constant to the users.
+bool HandshakeOptimizePass::forkConstant(ForkOp fork) {
+  auto constant = fork.getOperand().getDefiningOp<ConstantOp>();
+  if (!constant || !constant->hasOneUse() ||
+      constant.getOperand().getDefiningOp() == fork)
+    return false;
+
+  OpBuilder builder(fork);
+  auto controls = builder.create<ForkOp>(
+      fork.getLoc(), constant.getOperand(), fork.getNumResults());
+  for (auto it : llvm::zip(fork.getResults(), controls.getResults())) {
+    auto *copy = builder.clone(*constant);
+    copy->setOperand(0, std::get<1>(it));
+    std::get<0>(it).replaceAllUsesWith(copy->getResult(0));
+  }
+  erase(fork);
+  erase(constant);
+  return true;
+}
+
+/// Merge `buffer` with the buffer of the same kind feeding it. The slots of
+/// chained buffers add up, sequential or transparent alike.
+bool HandshakeOptimizePass::mergeBuffers(BufferOp buffer) {
+  auto input = buffer.getOperand().getDefiningOp<BufferOp>();
+  if (!input || input == buffer || !input->hasOneUse() ||
+      input.isSequential() != buffer.isSequential())
+    return false;
+
+  OpBuilder builder(buffer);
+  buffer->setAttr("slots",
+                  builder.getI32IntegerAttr(input.slots() + buffer.slots()));
+  buffer->setOperand(0, input.getOperand());
+  erase(input);
+  ++numBuffersMerged;
+  return true;
+}
+
+/// Connect the data of a branch on a constant condition to the taken side,
+/// and a `never` to the other one. The control of the constant is sunk.
+bool HandshakeOptimizePass::simplifyBranch(ConditionalBranchOp branch) {
+  auto constant = branch.conditionOperand().getDefiningOp<ConstantOp>();
+  if (!constant || !constant->hasOneUse())
+    return false;
+  auto value = constant.getValue().dyn_cast<IntegerAttr>();
+  if (!value)
+    return false;
+
+  bool taken = value.getValue().getBoolValue();
+  Value takenResult = taken ? branch.trueResult() : branch.falseResult();
+  Value otherResult = taken ? branch.falseResult() : branch.trueResult();
+  OpBuilder builder(branch);
+  if (takenResult.use_empty())
+    builder.create<SinkOp>(branch.getLoc(), branch.dataOperand());
+  else
+    takenResult.replaceAllUsesWith(branch.dataOperand());
+  if (auto sink = getSink(otherResult))
+    erase(sink);
+  else if (!otherResult.use_empty())
+    otherResult.replaceAllUsesWith(
+        builder.create<NeverOp>(branch.getLoc(), otherResult.getType()));
+  builder.create<SinkOp>(constant.getLoc(), constant.getOperand());
+  erase(branch);
+  erase(constant);
+  ++numBranchesSimplified;
+  return true;
+}
+
+/// Drop the inputs of `merge` which never carry a token, such as the ones
+/// left by `simplifyBranch`.
+bool HandshakeOptimizePass::removeNeverInputs(MergeOp merge) {
+  SmallVector<Value> inputs;
+  SmallVector<Operation *> nevers;
+  for (auto operand : merge->getOperands()) {
+    auto never = operand.getDefiningOp<NeverOp>();
+    if (never && never->hasOneUse())
+      nevers.push_back(never);
+    else
+      inputs.push_back(operand);
+  }
+  // A merge of nothing but nevers is a never itself.
+  if (inputs.empty() && !nevers.empty())
+    inputs.push_back(nevers.pop_back_val()->getResult(0));
+  if (nevers.empty())
+    return false;
+
+  if (inputs.size() == 1) {
+    merge.getResult().replaceAllUsesWith(inputs.front());
+  } else {
+    OpBuilder builder(merge);
+    auto newMerge =
+        builder.create<MergeOp>(merge.getLoc(), merge.getType(), inputs);
+    merge.getResult().replaceAllUsesWith(newMerge.getResult());
+  }
+  erase(merge);
+  for (auto *never : nevers)
+    erase(never);
+  return true;
+}
+
+/// Replace `op` by sinks of its operands if all of its results are sunk.
+bool HandshakeOptimizePass::removeDeadOp(Operation *op) {
+  if (op->getNumResults() == 0 || !isRemovableWhenSunk(op))
+    return false;
+  SmallVector<Operation *> sinks;
+  for (auto result : op->getResults()) {
+    auto sink = getSink(result);
+    if (!sink)
+      return false;
+    sinks.push_back(sink);
+  }
+
+  OpBuilder builder(op);
+  llvm::SmallDenseSet<Value> sunk;
+  for (auto operand : op->getOperands())
+    if (sunk.insert(operand).second)
+      builder.create<SinkOp>(op->getLoc(), operand);
+  for (auto *sink : sinks)
+    erase(sink);
+  erase(op);
+  ++numDeadOpsRemoved;
+  return true;
+}
+
+void HandshakeOptimizePass::runOnOperation() {
+  auto func = getOperation();
+
+  // Every rewrite may enable others around it, so repeat until nothing
+  // changes. Each round works on a snapshot of the operations.
+  bool changed = true, anyChanged = false;
+  while (changed) {
+    changed = false;
+    erased.clear();
+    SmallVector<Operation *> ops;
+    for (Block &block : func)
+      for (Operation &op : block)
+        ops.push_back(&op);
+
+    for (auto *op : ops) {
+      if (erased.count(op))
+        continue;
+      bool simplified =
+          TypeSwitch<Operation *, bool>(op)
+              .Case([&](ForkOp fork) {
+                return simplifyFork(fork) || forkConstant(fork);
+              })
+              .Case([&](BufferOp buffer) { return mergeBuffers(buffer); })
+              .Case([&](ConditionalBranchOp branch) {
+                return simplifyBranch(branch);
+              })
+              .Case([&](MergeOp merge) { return removeNeverInputs(merge); })
+              .Default([](Operation *) { return false; });
+      if (!simplified && !isa<ForkOp>(op))
+        simplified = removeDeadOp(op);
+      changed |= simplified;
+    }
+    anyChanged |= changed;
+  }
+
+  if (!anyChanged)
+    markAllAnalysesPreserved();
+}
+
+std::unique_ptr<mlir::OperationPass<handshake::FuncOp>>
+circt::createHandshakeOptimizePass() {
+  return std::make_unique<HandshakeOptimizePass>();
+}
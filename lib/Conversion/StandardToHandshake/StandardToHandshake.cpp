@@ -15,6 +15,7 @@
 #include "circt/Dialect/StaticLogic/StaticLogic.h"
 #include "mlir/Analysis/AffineAnalysis.h"
 #include "mlir/Analysis/AffineStructures.h"
+#include "mlir/Analysis/Utils.h"
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Affine/IR/AffineValueMap.h"
@@ -27,6 +28,7 @@
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/IR/Types.h"
 #include "mlir/IR/Value.h"
+#include "mlir/Interfaces/CallInterfaces.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Support/LLVM.h"
 #include "mlir/Transforms/DialectConversion.h"
@@ -44,6 +46,20 @@ typedef DenseMap<Block *, std::vector<Value>> BlockValues;
 typedef DenseMap<Block *, std::vector<Operation *>> BlockOps;
 typedef DenseMap<Value, Operation *> blockArgPairs;
 
+/// The blocks of a loop whose iterations may overlap. The memory accesses of
+/// its body signal their completion to the `completion` join, which waits for
+/// the previous iteration as well, instead of holding back the control token
+/// of the next iteration. The chain of completions is joined into the control
+/// of the exit block by `exitCompletion`.
+struct PipelinedLoop {
+  Block *header;
+  Block *body;
+  Block *latch;
+  Block *exit;
+  Operation *completion = nullptr;
+  Operation *exitCompletion = nullptr;
+};
+
 /// Remove basic blocks inside the given FuncOp. This allows the result to be
 /// a valid graph region, since multi-basic block regions are not allowed to
 /// be graph regions currently.
@@ -1111,11 +1127,17 @@ void setLoadDataInputs(std::vector<Operation *> memOps, Operation *memOp) {
 }
 
 void setJoinControlInputs(std::vector<Operation *> memOps, Operation *memOp,
-                          int offset, std::vector<int> cntrlInd) {
+                          int offset, std::vector<int> cntrlInd,
+                          const DenseMap<Block *, Operation *> &completions) {
   // Connect all memory ops to the join of that block (ensures that all mem
   // ops terminate before a new block starts)
   for (int i = 0, e = memOps.size(); i < e; ++i) {
     auto *op = memOps[i];
+    // The accesses of a pipelined loop body complete in the background.
+    if (auto *completion = completions.lookup(op->getBlock())) {
+      addValueToOperands(completion, memOp->getResult(offset + cntrlInd[i]));
+      continue;
+    }
     Value val = getBlockControlValue(op->getBlock());
     auto srcOp = val.getDefiningOp();
     if (!isa<JoinOp, StartOp>(srcOp)) {
@@ -1164,7 +1186,12 @@ void setMemOpControlInputs(ConversionPatternRewriter &rewriter,
 }
 
 void connectToMemory(handshake::FuncOp f, MemRefToMemoryAccessOp MemRefOps,
-                     bool lsq, ConversionPatternRewriter &rewriter) {
+                     bool lsq, ArrayRef<PipelinedLoop> pipelinedLoops,
+                     ConversionPatternRewriter &rewriter) {
+  DenseMap<Block *, Operation *> completions;
+  for (auto &loop : pipelinedLoops)
+    completions[loop.body] = loop.completion;
+
   // Add MemoryOps which represent the memory interface
   // Connect memory operations and control appropriately
   int mem_count = 0;
@@ -1233,7 +1260,11 @@ void connectToMemory(handshake::FuncOp f, MemRefToMemoryAccessOp MemRefOps,
     if (!lsq) {
       // Create Joins which join done signals from memory with the
       // control-only network
-      addJoinOps(rewriter, controlVals);
+      std::vector<Value> joinedVals;
+      for (auto val : controlVals)
+        if (!completions.count(val.getParentBlock()))
+          joinedVals.push_back(val);
+      addJoinOps(rewriter, joinedVals);
 
       // Connect all load/store done signals to the join of their block
       // Ensure that the block terminates only after all its accesses have
@@ -1243,7 +1274,8 @@ void connectToMemory(handshake::FuncOp f, MemRefToMemoryAccessOp MemRefOps,
       bool control = true;
 
       if (control)
-        setJoinControlInputs(memory.second, newOp, ld_count, newInd);
+        setJoinControlInputs(memory.second, newOp, ld_count, newInd,
+                             completions);
       else {
         for (int i = 0, e = cntrl_count; i < e; ++i) {
           rewriter.setInsertionPointAfter(newOp);
@@ -1285,6 +1317,169 @@ void replaceCallOps(handshake::FuncOp f, ConversionPatternRewriter &rewriter) {
   }
 }
 
+/// Split each `memref.alloc` into `numBanks` memories along its innermost
+/// dimension, such that its accesses spread over independent
+/// `handshake.memory` operations. Cyclic banking puts consecutive elements
+/// into consecutive banks, block banking puts consecutive ranges of elements
+/// into the same bank. A memory is only split when all its uses are affine
+/// loads and stores whose bank is known statically, as in unrolled loops.
+/// The accesses are updated in place, and the original allocation is left
+/// without uses for `removeAllocOps`.
+void bankMemories(handshake::FuncOp f, unsigned numBanks, bool cyclic,
+                  ConversionPatternRewriter &rewriter) {
+  SmallVector<memref::AllocOp, 4> allocOps;
+  f.walk([&](memref::AllocOp op) { allocOps.push_back(op); });
+
+  for (auto allocOp : allocOps) {
+    MemRefType type = allocOp.getType();
+    if (!type.hasStaticShape() || type.getRank() == 0)
+      continue;
+    int64_t dimSize = type.getShape().back();
+    if (dimSize % numBanks != 0)
+      continue;
+    int64_t blockSize = dimSize / numBanks;
+
+    // Compute the bank and the map into the bank of every access.
+    SmallVector<std::tuple<Operation *, unsigned, AffineMap>, 8> accesses;
+    bool bankable = true;
+    for (auto *user : allocOp->getUsers()) {
+      AffineMap map;
+      if (auto loadOp = dyn_cast<mlir::AffineLoadOp>(user))
+        map = loadOp.getAffineMap();
+      else if (auto storeOp = dyn_cast<mlir::AffineStoreOp>(user))
+        map = storeOp.getAffineMap();
+      if (!map) {
+        bankable = false;
+        break;
+      }
+
+      AffineExpr index = map.getResults().back();
+      AffineExpr bank = simplifyAffineExpr(
+          cyclic ? index % numBanks : index.floorDiv(blockSize),
+          map.getNumDims(), map.getNumSymbols());
+      auto bankConst = bank.dyn_cast<AffineConstantExpr>();
+      if (!bankConst) {
+        bankable = false;
+        break;
+      }
+
+      SmallVector<AffineExpr, 4> results(map.getResults().begin(),
+                                         map.getResults().end());
+      results.back() = simplifyAffineExpr(
+          cyclic ? index.floorDiv(numBanks) : index % blockSize,
+          map.getNumDims(), map.getNumSymbols());
+      accesses.emplace_back(user, bankConst.getValue(),
+                            AffineMap::get(map.getNumDims(),
+                                           map.getNumSymbols(), results,
+                                           map.getContext()));
+    }
+    if (!bankable || accesses.empty())
+      continue;
+
+    SmallVector<int64_t, 4> shape(type.getShape().begin(),
+                                  type.getShape().end());
+    shape.back() = blockSize;
+    MemRefType bankType = MemRefType::Builder(type).setShape(shape);
+    SmallVector<Value, 4> banks;
+    rewriter.setInsertionPointAfter(allocOp);
+    for (unsigned i = 0; i < numBanks; ++i)
+      banks.push_back(
+          rewriter.create<memref::AllocOp>(allocOp.getLoc(), bankType));
+
+    for (auto &access : accesses) {
+      Operation *op = std::get<0>(access);
+      op->replaceUsesOfWith(allocOp.getResult(), banks[std::get<1>(access)]);
+      op->setAttr(isa<mlir::AffineLoadOp>(op)
+                      ? mlir::AffineLoadOp::getMapAttrName()
+                      : mlir::AffineStoreOp::getMapAttrName(),
+                  AffineMapAttr::get(std::get<2>(access)));
+    }
+  }
+}
+
+/// Return whether the iterations of `forOp` can overlap: its body holds no
+/// nested regions or calls, and no memory dependence is carried from one
+/// iteration to another. The dependences within an iteration are still
+/// enforced by the control inputs of the accesses.
+bool isPipelinableLoop(mlir::AffineForOp forOp) {
+  SmallVector<Operation *, 8> accesses;
+  for (Operation &op : *forOp.getBody()) {
+    if (op.getNumRegions() != 0 || isa<CallOpInterface>(op) ||
+        isa<memref::LoadOp, memref::StoreOp>(op))
+      return false;
+    if (isa<mlir::AffineReadOpInterface, mlir::AffineWriteOpInterface>(op))
+      accesses.push_back(&op);
+  }
+  if (accesses.empty())
+    return false;
+
+  unsigned loopDepth = getNestingDepth(forOp) + 1;
+  for (auto *src : accesses) {
+    MemRefAccess srcAccess(src);
+    for (auto *dst : accesses) {
+      MemRefAccess dstAccess(dst);
+      if (srcAccess.memref != dstAccess.memref)
+        continue;
+      DependenceResult result = checkMemrefAccessDependence(
+          srcAccess, dstAccess, loopDepth, /*dependenceConstraints=*/nullptr,
+          /*dependenceComponents=*/nullptr);
+      if (result.value != DependenceResult::NoDependence)
+        return false;
+    }
+  }
+  return true;
+}
+
+/// Thread a control-only token through each pipelined loop, as an extra
+/// argument of its header. The token enters the loop from the control of the
+/// preheader, waits for the memory accesses of each iteration in the body and
+/// is joined into the control of the exit block. This runs on the CFG, so
+/// that the token gets its merges and branches like any other value.
+void addCompletionTokens(handshake::FuncOp f,
+                         MutableArrayRef<PipelinedLoop> pipelinedLoops,
+                         ConversionPatternRewriter &rewriter) {
+  Value start = getStartOp(&f.front())->getResult(0);
+  for (auto &loop : pipelinedLoops) {
+    auto token = loop.header->addArgument(rewriter.getNoneType());
+    for (auto *predBlock : loop.header->getPredecessors()) {
+      Operation *termOp = predBlock->getTerminator();
+      if (predBlock == loop.latch)
+        continue;
+      rewriter.setInsertionPoint(termOp);
+      auto init = rewriter.create<JoinOp>(termOp->getLoc(), start);
+      addValueToOperands(termOp, init);
+    }
+
+    Operation *bodyTermOp = loop.body->getTerminator();
+    rewriter.setInsertionPoint(bodyTermOp);
+    loop.completion = rewriter.create<JoinOp>(bodyTermOp->getLoc(), token);
+    addValueToOperands(loop.latch->getTerminator(),
+                       loop.completion->getResult(0));
+
+    rewriter.setInsertionPointToStart(loop.exit);
+    loop.exitCompletion =
+        rewriter.create<JoinOp>(loop.exit->front().getLoc(), token);
+  }
+}
+
+/// Make the exit block of each pipelined loop wait for the completion of all
+/// the memory accesses of the loop.
+void joinLoopCompletions(ArrayRef<PipelinedLoop> pipelinedLoops,
+                         ConversionPatternRewriter &rewriter) {
+  for (auto &loop : pipelinedLoops) {
+    Value done = loop.exitCompletion->getResult(0);
+    for (auto *user : llvm::make_early_inc_range(done.getUsers()))
+      if (isa<SinkOp>(user))
+        rewriter.eraseOp(user);
+
+    Value control = getBlockControlValue(loop.exit);
+    if (!isa<JoinOp>(control.getDefiningOp()))
+      addJoinOps(rewriter, {control});
+    addValueToOperands(getBlockControlValue(loop.exit).getDefiningOp(),
+                       done);
+  }
+}
+
 /// Rewrite affine.for operations in a handshake.func into its representations
 /// as a CFG in the standard dialect. Affine expressions in loop bounds will be
 /// expanded to code in the standard dialect that actually computes them. We
@@ -1297,8 +1492,9 @@ void replaceCallOps(handshake::FuncOp f, ConversionPatternRewriter &rewriter) {
 /// getting dependence information, should be carried out before calling this
 /// function; otherwise, the affine for loops will be destructed and key
 /// information will be missing.
-LogicalResult rewriteAffineFor(handshake::FuncOp f,
-                               ConversionPatternRewriter &rewriter) {
+LogicalResult
+rewriteAffineFor(handshake::FuncOp f, ConversionPatternRewriter &rewriter,
+                 std::vector<PipelinedLoop> *pipelinedLoops = nullptr) {
   // Get all affine.for operations in the function body.
   SmallVector<mlir::AffineForOp, 8> forOps;
   f.walk([&](mlir::AffineForOp op) { forOps.push_back(op); });
@@ -1306,6 +1502,7 @@ LogicalResult rewriteAffineFor(handshake::FuncOp f,
   // TODO: how to deal with nested loops?
   for (unsigned i = 0, e = forOps.size(); i < e; i++) {
     auto forOp = forOps[i];
+    bool pipelined = pipelinedLoops && isPipelinableLoop(forOp);
 
     // Insert lower and upper bounds right at the position of the original
     // affine.for operation.
@@ -1384,6 +1581,10 @@ LogicalResult rewriteAffineFor(handshake::FuncOp f,
     // Remove the original forOp and the terminator in the loop body.
     rewriter.eraseOp(terminator);
     rewriter.eraseOp(forOp);
+
+    if (pipelined)
+      pipelinedLoops->push_back(
+          {conditionBlock, firstBodyBlock, lastBodyBlock, endBlock});
   }
 
   return success();
@@ -1418,7 +1619,12 @@ struct HandshakeCanonicalizePattern : public ConversionPattern {
 };
 
 struct FuncOpLowering : public OpConversionPattern<mlir::FuncOp> {
-  using OpConversionPattern<mlir::FuncOp>::OpConversionPattern;
+  FuncOpLowering(MLIRContext *context, bool pipelineLoops, unsigned numBanks,
+                 bool cyclicBanking)
+      : OpConversionPattern<mlir::FuncOp>(context),
+        pipelineLoops(pipelineLoops), numBanks(numBanks),
+        cyclicBanking(cyclicBanking) {}
+
   LogicalResult
   matchAndRewrite(mlir::FuncOp funcOp, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const override {
@@ -1463,8 +1669,13 @@ struct FuncOpLowering : public OpConversionPattern<mlir::FuncOp> {
     rewriter.inlineRegionBefore(funcOp.getBody(), newFuncOp.getBody(),
                                 newFuncOp.end());
 
+    if (numBanks > 1)
+      bankMemories(newFuncOp, numBanks, cyclicBanking, rewriter);
+
     // Rewrite affine.for operations.
-    if (failed(rewriteAffineFor(newFuncOp, rewriter)))
+    std::vector<PipelinedLoop> pipelinedLoops;
+    if (failed(rewriteAffineFor(newFuncOp, rewriter,
+                                pipelineLoops ? &pipelinedLoops : nullptr)))
       return newFuncOp.emitOpError("failed to rewrite Affine loops");
 
     // Perform dataflow conversion
@@ -1474,6 +1685,8 @@ struct FuncOpLowering : public OpConversionPattern<mlir::FuncOp> {
 
     setControlOnlyPath(newFuncOp, rewriter);
 
+    addCompletionTokens(newFuncOp, pipelinedLoops, rewriter);
+
     addMergeOps(newFuncOp, rewriter);
 
     addBranchOps(newFuncOp, rewriter);
@@ -1487,7 +1700,9 @@ struct FuncOpLowering : public OpConversionPattern<mlir::FuncOp> {
     checkDataflowConversion(newFuncOp);
 
     bool lsq = false;
-    connectToMemory(newFuncOp, MemOps, lsq, rewriter);
+    connectToMemory(newFuncOp, MemOps, lsq, pipelinedLoops, rewriter);
+
+    joinLoopCompletions(pipelinedLoops, rewriter);
 
     // Apply signature conversion to set function arguments
     rewriter.applySignatureConversion(&newFuncOp.getBody(), result);
@@ -1505,6 +1720,11 @@ struct FuncOpLowering : public OpConversionPattern<mlir::FuncOp> {
 
     return success();
   }
+
+private:
+  bool pipelineLoops;
+  unsigned numBanks;
+  bool cyclicBanking;
 };
 
 namespace {
@@ -1597,15 +1817,165 @@ struct HandshakeInsertBufferPass
         insertBufferRecursive(childUse, builder, numSlots, callback);
   }
 
+  /// Return the cycles from the operands of `op` to its results, like
+  /// handshake-runner models them. Sequential buffers take a cycle per slot.
+  static unsigned getLatency(Operation *op) {
+    if (auto buffer = dyn_cast<handshake::BufferOp>(op))
+      return buffer.isSequential() ? buffer.getNumSlots().getZExtValue() : 0;
+    if (isa<handshake::ForkOp, handshake::JoinOp, handshake::StoreOp>(op))
+      return 1;
+    auto *dialect = op->getDialect();
+    return dialect && dialect->getNamespace() ==
+                          HandshakeOpsDialect::getDialectNamespace()
+               ? 0
+               : 1;
+  }
+
+  /// Return whether `op` waits for all its operands before it fires.
+  static bool synchronizesOperands(Operation *op) {
+    return op->getNumOperands() > 1 &&
+           !isa<handshake::MergeOp, handshake::ControlMergeOp,
+                handshake::MuxOp, handshake::MemoryOp, handshake::LoadOp,
+                handshake::BufferOp>(op);
+  }
+
+  /// Put a transparent buffer of `slots` slots in front of `use`, or grow the
+  /// buffer already feeding it.
+  void insertTransparentBuffer(OpOperand &use, unsigned slots,
+                               OpBuilder &builder) {
+    Value value = use.get();
+    if (auto buffer = value.getDefiningOp<handshake::BufferOp>()) {
+      if (buffer.getNumSlots().getZExtValue() < slots)
+        buffer->setAttr("slots", builder.getI32IntegerAttr(slots));
+      return;
+    }
+    builder.setInsertionPoint(use.getOwner());
+    auto buffer = builder.create<handshake::BufferOp>(
+        value.getLoc(), value.getType(), value, /*sequential=*/false,
+        /*control=*/value.getType().isa<NoneType>(), slots);
+    use.set(buffer);
+  }
+
+  /// Order the operations reachable from the arguments such that every
+  /// operand is defined before its use, except along the back edges of the
+  /// graph cycles, which are collected in `backEdges`.
+  void sortAcyclic(Operation *op, DenseSet<Operation *> &opVisited,
+                   DenseSet<Operation *> &opInFlight,
+                   DenseSet<OpOperand *> &backEdges,
+                   SmallVectorImpl<Operation *> &postOrder) {
+    opVisited.insert(op);
+    opInFlight.insert(op);
+    for (auto &use : op->getUses()) {
+      auto *user = use.getOwner();
+      if (opInFlight.count(user))
+        backEdges.insert(&use);
+      else if (!opVisited.count(user))
+        sortAcyclic(user, opVisited, opInFlight, backEdges, postOrder);
+    }
+    opInFlight.erase(op);
+    postOrder.push_back(op);
+  }
+
+  // Compute the cycle each token arrives at along the forward edges of the
+  // graph, and buffer the tokens arriving early at an operation waiting for
+  // all its operands, so that their producers are not stalled by the late
+  // ones.
+  void bufferThroughputStrategy() {
+    auto f = getOperation();
+    auto builder = OpBuilder(f.getContext());
+    DenseSet<Operation *> opVisited;
+    DenseSet<Operation *> opInFlight;
+    DenseSet<OpOperand *> backEdges;
+    SmallVector<Operation *, 32> postOrder;
+    for (auto arg : f.getArguments())
+      for (auto &use : arg.getUses())
+        if (!opVisited.count(use.getOwner()))
+          sortAcyclic(use.getOwner(), opVisited, opInFlight, backEdges,
+                      postOrder);
+
+    DenseMap<Value, unsigned> arrival;
+    auto getInputTime = [&](Operation *op) {
+      unsigned time = 0;
+      for (auto &operand : op->getOpOperands())
+        if (!backEdges.count(&operand))
+          time = std::max(time, arrival.lookup(operand.get()));
+      return time;
+    };
+    for (auto *op : llvm::reverse(postOrder)) {
+      unsigned time = getInputTime(op) + getLatency(op);
+      for (auto result : op->getResults())
+        arrival[result] = time;
+    }
+
+    for (auto *op : llvm::reverse(postOrder)) {
+      if (!synchronizesOperands(op))
+        continue;
+      unsigned time = getInputTime(op);
+      for (auto &operand : op->getOpOperands()) {
+        if (backEdges.count(&operand))
+          continue;
+        unsigned slack = time - arrival.lookup(operand.get());
+        unsigned slots = (slack + targetII - 1) / targetII;
+        if (slots)
+          insertTransparentBuffer(operand, slots, builder);
+      }
+    }
+  }
+
+  // Buffer the channels whose tokens handshake-runner found blocked behind
+  // the previous ones, with the slots for the cycles they were blocked per
+  // token at the target initiation interval.
+  void bufferProfileStrategy() {
+    auto f = getOperation();
+    auto builder = OpBuilder(f.getContext());
+    SmallVector<Operation *, 32> ops;
+    f.walk([&](Operation *op) {
+      if (op->hasAttr("perf"))
+        ops.push_back(op);
+    });
+    for (auto *op : ops) {
+      auto perf = op->getAttrOfType<DictionaryAttr>("perf");
+      op->removeAttr("perf");
+      auto tokens = perf ? perf.getAs<ArrayAttr>("tokens") : ArrayAttr();
+      auto blocked = perf ? perf.getAs<ArrayAttr>("blocked") : ArrayAttr();
+      if (!tokens || !blocked || tokens.size() != op->getNumResults() ||
+          blocked.size() != op->getNumResults()) {
+        op->emitError("malformed perf attribute");
+        signalPassFailure();
+        return;
+      }
+      for (auto result : op->getResults()) {
+        unsigned i = result.getResultNumber();
+        auto numTokens = tokens[i].cast<IntegerAttr>().getInt();
+        auto numBlocked = blocked[i].cast<IntegerAttr>().getInt();
+        if (numTokens <= 0 || numBlocked <= 0 || !result.hasOneUse())
+          continue;
+        auto perToken = (numBlocked + numTokens - 1) / numTokens;
+        unsigned slots = (perToken + targetII - 1) / targetII;
+        insertTransparentBuffer(*result.getUses().begin(), slots, builder);
+      }
+    }
+  }
+
   void runOnOperation() override {
     if (strategies.empty())
       strategies = {"cycles"};
+    if (targetII == 0) {
+      emitError(getOperation().getLoc())
+          << "The target initiation interval must be positive";
+      signalPassFailure();
+      return;
+    }
 
     for (auto strategy : strategies) {
       if (strategy == "cycles")
         bufferCyclesStrategy();
       else if (strategy == "all")
         bufferAllStrategy();
+      else if (strategy == "throughput")
+        bufferThroughputStrategy();
+      else if (strategy == "profile")
+        bufferProfileStrategy();
       else {
         emitError(getOperation().getLoc())
             << "Unknown buffer strategy: " << strategy;
@@ -1625,12 +1995,21 @@ struct HandshakeDataflowPass
     : public HandshakeDataflowBase<HandshakeDataflowPass> {
   void runOnOperation() override {
     ModuleOp m = getOperation();
+    if (memoryBanks == 0) {
+      m.emitError("The number of memory banks must be positive");
+      return signalPassFailure();
+    }
+    if (memoryBanking != "cyclic" && memoryBanking != "block") {
+      m.emitError("Unknown memory banking: ") << memoryBanking;
+      return signalPassFailure();
+    }
 
     ConversionTarget target(getContext());
     target.addLegalDialect<HandshakeOpsDialect, StandardOpsDialect>();
 
     RewritePatternSet patterns(&getContext());
-    patterns.insert<FuncOpLowering>(m.getContext());
+    patterns.insert<FuncOpLowering>(m.getContext(), pipelineLoops, memoryBanks,
+                                    memoryBanking == "cyclic");
 
     if (failed(applyPartialConversion(m, target, std::move(patterns))))
       signalPassFailure();
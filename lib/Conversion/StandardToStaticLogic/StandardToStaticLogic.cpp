@@ -13,9 +13,13 @@
 #include "circt/Conversion/StandardToStaticLogic/StandardToStaticLogic.h"
 #include "../PassDetail.h"
 #include "circt/Dialect/StaticLogic/StaticLogic.h"
+#include "circt/Scheduling/Algorithms.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "llvm/ADT/SetVector.h"
 
 using namespace circt;
+using namespace circt::scheduling;
 using namespace staticlogic;
 using namespace std;
 
@@ -62,7 +66,178 @@ valueVector getPipelineResults(Block &block) {
   return results;
 }
 
-static void createPipeline(mlir::FuncOp f, OpBuilder &builder) {
+/// A simple latency model for the operations in a pipeline: constants are
+/// free, multiplications, divisions and memory reads take several cycles, and
+/// all other operations take one cycle.
+static unsigned getOperatorLatency(Operation *op) {
+  if (op->hasTrait<OpTrait::ConstantLike>())
+    return 0;
+  if (isa<MulIOp, MulFOp>(op))
+    return 3;
+  if (isa<SignedDivIOp, UnsignedDivIOp, SignedRemIOp, UnsignedRemIOp, DivFOp,
+          RemFOp>(op))
+    return 8;
+  if (isa<memref::LoadOp>(op))
+    return 2;
+  return 1;
+}
+
+static Value getMemRef(Operation *op) {
+  if (auto load = dyn_cast<memref::LoadOp>(op))
+    return load.getMemRef();
+  if (auto store = dyn_cast<memref::StoreOp>(op))
+    return store.getMemRef();
+  return {};
+}
+
+/// Add the operations in the body of `pipeline` to `prob`. Besides the def-use
+/// dependences, accesses to the same memory stay in order if one of them is a
+/// store.
+static LogicalResult constructProblem(Problem &prob, PipelineOp pipeline) {
+  auto &body = pipeline.getRegion().front();
+  DenseMap<Value, SmallVector<Operation *, 4>> memAccesses;
+  for (auto &op : body.without_terminator()) {
+    prob.insertOperation(&op);
+    auto opr = prob.getOrInsertOperatorType(op.getName().getStringRef());
+    prob.setLatency(opr, getOperatorLatency(&op));
+    prob.setLinkedOperatorType(&op, opr);
+
+    auto memRef = getMemRef(&op);
+    if (!memRef)
+      continue;
+    auto &accesses = memAccesses[memRef];
+    for (auto *prev : accesses)
+      if (isa<memref::StoreOp>(op) || isa<memref::StoreOp>(prev))
+        if (failed(prob.insertDependence(std::make_pair(prev, &op))))
+          return failure();
+    accesses.push_back(&op);
+  }
+  return success();
+}
+
+/// Add the dependences between iterations of the pipelined loop body to the
+/// modulo problem `prob`, i.e. from the stores to the accesses of the same
+/// memory in the next iteration. One load and one store can be started per
+/// cycle.
+static LogicalResult constructModuloProblem(ModuloProblem &prob,
+                                            PipelineOp pipeline) {
+  if (failed(constructProblem(prob, pipeline)))
+    return failure();
+
+  auto &body = pipeline.getRegion().front();
+  for (auto &op : body.without_terminator()) {
+    auto opr = *prob.getLinkedOperatorType(&op);
+    if (isa<memref::LoadOp, memref::StoreOp>(op))
+      prob.setLimit(opr, 1);
+  }
+
+  DenseMap<Value, SmallVector<Operation *, 4>> memAccesses;
+  for (auto &op : body.without_terminator())
+    if (auto memRef = getMemRef(&op))
+      memAccesses[memRef].push_back(&op);
+  for (auto &entry : memAccesses) {
+    auto &accesses = entry.second;
+    for (unsigned i = 0, e = accesses.size(); i < e; ++i) {
+      if (!isa<memref::StoreOp>(accesses[i]))
+        continue;
+      for (unsigned j = 0; j <= i; ++j) {
+        auto dep = std::make_pair(accesses[i], accesses[j]);
+        if (failed(prob.insertDependence(dep)))
+          return failure();
+        prob.setDistance(dep, 1);
+      }
+    }
+  }
+  return success();
+}
+
+/// Split the body of `pipeline` into one block per time step of the schedule
+/// in `prob`, which become the stages of the pipeline. The terminator is placed
+/// into the stage in which the last result is available. Values used in later
+/// stages are passed on as block arguments, i.e. through pipeline registers.
+static void materializeStages(PipelineOp pipeline, Problem &prob,
+                              OpBuilder &builder) {
+  auto &region = pipeline.getRegion();
+  Block *entry = &region.front();
+  Operation *terminator = entry->getTerminator();
+
+  DenseMap<Operation *, unsigned> opStages;
+  unsigned lastStage = 0;
+  for (auto &op : entry->without_terminator()) {
+    unsigned startTime = *prob.getStartTime(&op);
+    opStages[&op] = startTime;
+    auto latency = *prob.getLatency(*prob.getLinkedOperatorType(&op));
+    lastStage = std::max(lastStage, startTime + latency);
+  }
+  opStages[terminator] = lastStage;
+
+  SmallVector<Block *> stages = {entry};
+  DenseMap<Block *, unsigned> blockStages = {{entry, 0}};
+  for (unsigned stage = 1; stage <= lastStage; ++stage) {
+    auto *block = new Block();
+    region.push_back(block);
+    stages.push_back(block);
+    blockStages[block] = stage;
+  }
+
+  // Moving the operations in their original order keeps them in a valid order
+  // within each stage.
+  for (auto &op : llvm::make_early_inc_range(*entry)) {
+    unsigned stage = opStages[&op];
+    if (stage > 0)
+      op.moveBefore(stages[stage], stages[stage]->end());
+  }
+
+  for (unsigned stage = 1; stage <= lastStage; ++stage) {
+    llvm::SetVector<Value> liveIns;
+    for (unsigned later = stage; later <= lastStage; ++later)
+      for (auto &op : *stages[later])
+        for (auto operand : op.getOperands()) {
+          auto def = blockStages.find(operand.getParentBlock());
+          if (def != blockStages.end() && def->second < stage)
+            liveIns.insert(operand);
+        }
+
+    for (auto value : liveIns) {
+      auto arg = stages[stage]->addArgument(value.getType());
+      value.replaceUsesWithIf(arg, [&](OpOperand &use) {
+        return blockStages[use.getOwner()->getBlock()] >= stage;
+      });
+    }
+
+    builder.setInsertionPointToEnd(stages[stage - 1]);
+    builder.create<mlir::BranchOp>(pipeline.getLoc(), stages[stage],
+                                   liveIns.getArrayRef());
+  }
+}
+
+/// Schedule the body of `pipeline` with `scheduler`, and split it into stages
+/// accordingly. The modulo scheduler additionally records the initiation
+/// interval of the pipeline in its `II` attribute.
+static LogicalResult schedulePipeline(PipelineOp pipeline, StringRef scheduler,
+                                      OpBuilder &builder) {
+  if (scheduler == "asap") {
+    Problem prob(pipeline);
+    if (failed(constructProblem(prob, pipeline)) || failed(prob.check()) ||
+        failed(scheduleASAP(prob)))
+      return failure();
+    materializeStages(pipeline, prob, builder);
+    return success();
+  }
+
+  assert(scheduler == "modulo" && "unknown scheduler");
+  ModuloProblem prob(pipeline);
+  if (failed(constructModuloProblem(prob, pipeline)) || failed(prob.check()) ||
+      failed(scheduleModulo(prob)))
+    return failure();
+  materializeStages(pipeline, prob, builder);
+  pipeline->setAttr("II",
+                    builder.getI64IntegerAttr(*prob.getInitiationInterval()));
+  return success();
+}
+
+static LogicalResult createPipeline(mlir::FuncOp f, OpBuilder &builder,
+                                    StringRef scheduler) {
   for (Block &block : f) {
     if (!block.front().mightHaveTrait<OpTrait::IsTerminator>()) {
 
@@ -103,8 +278,13 @@ static void createPipeline(mlir::FuncOp f, OpBuilder &builder) {
             }));
         resultIdx += 1;
       }
+
+      if (!scheduler.empty() &&
+          failed(schedulePipeline(pipeline, scheduler, builder)))
+        return pipeline.emitError("failed to schedule the pipeline");
     }
   }
+  return success();
 }
 
 namespace {
@@ -112,8 +292,14 @@ namespace {
 struct CreatePipelinePass : public CreatePipelineBase<CreatePipelinePass> {
   void runOnOperation() override {
     mlir::FuncOp f = getOperation();
+    if (!scheduler.empty() && scheduler != "asap" && scheduler != "modulo") {
+      f.emitError("unknown scheduler '") << scheduler << "'";
+      return signalPassFailure();
+    }
+
     auto builder = OpBuilder(f.getContext());
-    createPipeline(f, builder);
+    if (failed(createPipeline(f, builder, scheduler)))
+      signalPassFailure();
   }
 };
 
@@ -167,6 +167,11 @@ static void printComponentOp(OpAsmPrinter &p, ComponentOp &op) {
   auto outputPortTypes = functionType.getResults();
   auto outputPortNames = op->getAttrOfType<ArrayAttr>("outPortNames");
   printPortDefList(p, outputPortTypes, outputPortNames);
+  p.printOptionalAttrDictWithKeyword(
+      op->getAttrs(),
+      /*elidedAttrs=*/{SymbolTable::getSymbolAttrName(),
+                       ComponentOp::getTypeAttrName(), "inPortNames",
+                       "outPortNames"});
 
   p.printRegion(op.body(), /*printBlockTerminators=*/false,
                 /*printEmptyBlock=*/false);
@@ -234,7 +239,8 @@ static ParseResult parseComponentOp(OpAsmParser &parser,
   SmallVector<OpAsmParser::OperandType> inPorts, outPorts;
   SmallVector<Type> inPortTypes, outPortTypes;
   if (parseComponentSignature(parser, result, inPorts, inPortTypes, outPorts,
-                              outPortTypes))
+                              outPortTypes) ||
+      parser.parseOptionalAttrDictWithKeyword(result.attributes))
     return failure();
 
   // Build the component's type for FunctionLike trait.
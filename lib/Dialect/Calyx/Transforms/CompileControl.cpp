@@ -0,0 +1,216 @@
+//===- CompileControl.cpp - Compile Control Pass ----------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Contains the definitions of the Compile Control pass.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/Calyx/CalyxOps.h"
+#include "circt/Dialect/Calyx/CalyxPasses.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/SymbolTable.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace circt;
+using namespace calyx;
+using namespace mlir;
+
+namespace {
+
+/// Compiles the control schedule of a single component. Only the component
+/// itself is modified, so components are compiled independently of each
+/// other.
+class ControlCompiler {
+public:
+  ControlCompiler(ComponentOp component)
+      : component(component), wires(component.getWiresOp()),
+        symbolTable(wires), builder(component.getContext()) {}
+
+  /// Replaces each calyx.seq with an enable of a new group, which runs the
+  /// children of the sequence one after another.
+  LogicalResult compile();
+
+private:
+  LogicalResult compileSeq(SeqOp seq);
+
+  Value createConstant(Location loc, unsigned width, uint64_t value) {
+    return builder.create<hw::ConstantOp>(loc, APInt(width, value));
+  }
+
+  ComponentOp component;
+  WiresOp wires;
+  SymbolTable symbolTable;
+  OpBuilder builder;
+
+  /// The guards of the go signals set so far.
+  DenseMap<Operation *, Value> goGuards;
+};
+
+} // end anonymous namespace
+
+LogicalResult ControlCompiler::compile() {
+  // Inner sequences are visited first, and are enabled by their compiled
+  // groups by the time their parent is compiled.
+  auto result = component.getControlOp().walk([&](SeqOp seq) {
+    return failed(compileSeq(seq)) ? WalkResult::interrupt()
+                                   : WalkResult::advance();
+  });
+  return failure(result.wasInterrupted());
+}
+
+/// Returns true if `value` is defined inside of `group`, i.e. isn't visible to
+/// the assignments of other groups.
+static bool isDefinedIn(Value value, GroupOp group) {
+  Operation *def = value.getDefiningOp();
+  return def && group->isProperAncestor(def);
+}
+
+/// Builds a group driving an FSM register through the states 0 to N for a
+/// sequence of N enables. In state i, the i-th group is started until it is
+/// done, which advances the FSM to the next state. For example:
+///    ```mlir
+///      calyx.seq {
+///        calyx.enable @A
+///        calyx.enable @B
+///      }
+///      =>
+///      %seq_go = calyx.undef : i1
+///      calyx.group @seq {
+///        %go = calyx.group_go %seq_go : i1
+///        calyx.assign %fsm.in = %c1_i2, %a_done ? : i2
+///        calyx.assign %fsm.write_en = %true, %a_done ? : i1
+///        calyx.assign %fsm.in = %c2_i2, %b_done ? : i2
+///        calyx.assign %fsm.write_en = %true, %b_done ? : i1
+///        calyx.group_done %true, %in_final_state ? : i1
+///      }
+///      ...
+///      calyx.enable @seq
+///    ```
+/// where `%a_done` holds while the sequence runs, the FSM is in state 0 and
+/// `@A` is done. The go signal of `@A` is guarded by the sequence running, the
+/// FSM being in state 0 and `@A` not being done. The FSM is reset to state 0
+/// once the final state is reached, so the sequence may run again.
+///
+/// Whether the sequence runs is undefined until the sequence itself is
+/// compiled as part of its parent.
+LogicalResult ControlCompiler::compileSeq(SeqOp seq) {
+  Location loc = seq.getLoc();
+  auto enables = llvm::to_vector<4>(seq.getBody()->getOps<EnableOp>());
+  if (enables.size() != seq.getBody()->getOperations().size())
+    return seq.emitOpError("can only be compiled with enables as children");
+
+  // The wires are a graph region, so the guards are simply appended to them.
+  builder.setInsertionPointToEnd(wires.getBody());
+  Type i1Type = builder.getI1Type();
+  Value one = createConstant(loc, 1, 1);
+  Value running = builder.create<UndefinedOp>(loc, i1Type);
+  auto seqGroup = builder.create<GroupOp>(loc, builder.getStringAttr("seq"));
+  seqGroup.body().push_back(new Block());
+  // Renames the group if `seq` is taken already.
+  symbolTable.insert(seqGroup);
+
+  unsigned fsmWidth = std::max(1u, llvm::Log2_64_Ceil(enables.size() + 1));
+  Type fsmType = builder.getIntegerType(fsmWidth);
+  OpBuilder cellBuilder(wires);
+  auto fsm = cellBuilder.create<RegisterOp>(
+      loc, TypeRange{fsmType, i1Type, i1Type, i1Type, fsmType, i1Type},
+      builder.getStringAttr((seqGroup.sym_name() + "_fsm").str()));
+
+  OpBuilder groupBuilder(seqGroup.body());
+  groupBuilder.create<GroupGoOp>(loc, running);
+
+  for (auto indexedEnable : llvm::enumerate(enables)) {
+    EnableOp enable = indexedEnable.value();
+    auto group = symbolTable.lookup<GroupOp>(enable.groupName());
+    auto goOps = group.getBody()->getOps<GroupGoOp>();
+    if (goOps.empty())
+      return enable.emitOpError("enables group '")
+             << enable.groupName() << "' without a go signal; run "
+             << "'calyx-go-insertion' first";
+    GroupGoOp goOp = *goOps.begin();
+
+    auto doneOp = group.getDoneOp();
+    Value done = doneOp.src();
+    if (isDefinedIn(done, group) ||
+        (doneOp.guard() && isDefinedIn(doneOp.guard(), group)))
+      return enable.emitOpError("enables group '")
+             << enable.groupName()
+             << "' whose done signal is computed within the group";
+    if (doneOp.guard())
+      done = builder.create<comb::AndOp>(loc, done, doneOp.guard());
+
+    Value state = createConstant(loc, fsmWidth, indexedEnable.index());
+    Value nextState = createConstant(loc, fsmWidth, indexedEnable.index() + 1);
+    Value inState = builder.create<comb::ICmpOp>(loc, comb::ICmpPredicate::eq,
+                                                 fsm.out(), state);
+    Value active = builder.create<comb::AndOp>(loc, inState, running);
+
+    // The group runs while it is the current state's group and not yet done.
+    Value notDone = builder.create<comb::XorOp>(loc, done, one);
+    Value goGuard = builder.create<comb::AndOp>(loc, active, notDone);
+    auto groupRunning = goOp.src().getDefiningOp<UndefinedOp>();
+    if (groupRunning && llvm::count_if(groupRunning->getUsers(), [](auto *op) {
+          return isa<GroupGoOp>(op);
+        }) == 1) {
+      // This group is the only user of its go source, e.g. it is a compiled
+      // sequence whose children depend on it running.
+      groupRunning.replaceAllUsesWith(goGuard);
+      groupRunning.erase();
+      goGuards[goOp] = goGuard;
+    } else {
+      // Groups enabled several times run whenever any of their enables does.
+      Value &guard = goGuards[goOp];
+      if (guard)
+        guard = builder.create<comb::OrOp>(loc, guard, goGuard);
+      else
+        guard = goGuard;
+      goOp->setOperands({one, guard});
+    }
+
+    // Advance the FSM once the group is done.
+    Value advance = builder.create<comb::AndOp>(loc, active, done);
+    groupBuilder.create<AssignOp>(loc, fsm.in(), nextState, advance);
+    groupBuilder.create<AssignOp>(loc, fsm.write_en(), one, advance);
+  }
+
+  Value finalState = createConstant(loc, fsmWidth, enables.size());
+  Value inFinalState = builder.create<comb::ICmpOp>(
+      loc, comb::ICmpPredicate::eq, fsm.out(), finalState);
+  groupBuilder.create<GroupDoneOp>(loc, one, inFinalState);
+
+  // Outside of the group, so the FSM is reset after the group is done.
+  Value initialState = createConstant(loc, fsmWidth, 0);
+  builder.create<AssignOp>(loc, fsm.in(), initialState, inFinalState);
+  builder.create<AssignOp>(loc, fsm.write_en(), one, inFinalState);
+
+  OpBuilder controlBuilder(seq);
+  controlBuilder.create<EnableOp>(loc, seqGroup.sym_name());
+  seq.erase();
+  return success();
+}
+
+namespace {
+
+struct CompileControlPass : public CompileControlBase<CompileControlPass> {
+  void runOnOperation() override;
+};
+
+} // end anonymous namespace
+
+void CompileControlPass::runOnOperation() {
+  if (failed(ControlCompiler(getOperation()).compile()))
+    signalPassFailure();
+}
+
+std::unique_ptr<mlir::Pass> circt::calyx::createCompileControlPass() {
+  return std::make_unique<CompileControlPass>();
+}
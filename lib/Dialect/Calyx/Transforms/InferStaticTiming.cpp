@@ -0,0 +1,153 @@
+//===- InferStaticTiming.cpp - Infer Static Timing Pass ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Contains the definitions of the Infer Static Timing pass.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/Calyx/CalyxOps.h"
+#include "circt/Dialect/Calyx/CalyxPasses.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Matchers.h"
+
+using namespace circt;
+using namespace calyx;
+using namespace mlir;
+
+/// The name of the attribute holding the number of cycles a component, group
+/// or control operation takes from its go to its done signal.
+static constexpr StringRef staticAttrName = "static";
+
+static Optional<uint64_t> getStaticLatency(Operation *op) {
+  if (auto latency = op->getAttrOfType<IntegerAttr>(staticAttrName))
+    return latency.getValue().getZExtValue();
+  return None;
+}
+
+static void setStaticLatency(Operation *op, uint64_t latency) {
+  auto i64Type = IntegerType::get(op->getContext(), 64);
+  op->setAttr(staticAttrName, IntegerAttr::get(i64Type, latency));
+}
+
+/// Returns the index of the port named `name` with the given `direction` among
+/// the ports of `component`, i.e. of the results of its cells.
+static Optional<unsigned> getPortIndex(ComponentOp component, StringRef name,
+                                       PortDirection direction) {
+  auto ports = getComponentPortInfo(component);
+  for (unsigned i = 0, e = ports.size(); i < e; ++i)
+    if (ports[i].direction == direction && ports[i].name.getValue() == name)
+      return i;
+  return None;
+}
+
+/// Infers the latency of a group that unconditionally starts a single cell
+/// with a static latency, and signals its own completion with the cell's done
+/// port. For example, the following group takes as many cycles as `@Mul`:
+///    ```mlir
+///      calyx.group @Group1 {
+///        calyx.assign %mul.go = %true : i1
+///        calyx.group_done %mul.done : i1
+///      }
+///    ```
+static Optional<uint64_t> inferGroupLatency(GroupOp group) {
+  auto done = group.getDoneOp();
+  if (!done || done.guard())
+    return None;
+  auto cell = done.src().getDefiningOp<CellOp>();
+  if (!cell)
+    return None;
+  auto component = cell.getReferencedComponent();
+  if (!component)
+    return None;
+  auto latency = getStaticLatency(component);
+  auto goIndex = getPortIndex(component, "go", PortDirection::INPUT);
+  auto doneIndex = getPortIndex(component, "done", PortDirection::OUTPUT);
+  if (!latency || !goIndex || !doneIndex ||
+      done.src() != cell.getResult(*doneIndex))
+    return None;
+
+  Value go = cell.getResult(*goIndex);
+  bool startsCell = false;
+  for (auto assign : group.getBody()->getOps<AssignOp>()) {
+    if (assign.dest() != go)
+      continue;
+    // Any other driver of the go port may delay or restart the cell.
+    if (assign.guard() || !matchPattern(assign.src(), m_One()))
+      return None;
+    startsCell = true;
+  }
+  if (!startsCell)
+    return None;
+  return latency;
+}
+
+/// Returns the latency of the control operation `control`, and annotates the
+/// sequences with a static latency on the way.
+static Optional<uint64_t> inferControlLatency(Operation *control,
+                                              WiresOp wires) {
+  if (auto enable = dyn_cast<EnableOp>(control)) {
+    if (auto group = wires.lookupSymbol<GroupOp>(enable.groupName()))
+      return getStaticLatency(group);
+    return None;
+  }
+
+  SmallVector<Optional<uint64_t>> children;
+  for (auto &region : control->getRegions())
+    for (auto &block : region)
+      for (auto &child : block)
+        children.push_back(inferControlLatency(&child, wires));
+
+  if (!isa<ControlOp, SeqOp>(control) || children.empty() ||
+      llvm::any_of(children, [](auto latency) { return !latency; }))
+    return None;
+
+  uint64_t latency = 0;
+  for (auto child : children)
+    latency += *child;
+  if (isa<SeqOp>(control))
+    setStaticLatency(control, latency);
+  return latency;
+}
+
+namespace {
+
+struct InferStaticTimingPass
+    : public InferStaticTimingBase<InferStaticTimingPass> {
+  void runOnOperation() override;
+};
+
+} // end anonymous namespace
+
+void InferStaticTimingPass::runOnOperation() {
+  ProgramOp program = getOperation();
+
+  // Components may only be used by cells after their own latency is known, so
+  // iterate until no further component latency is inferred.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto component : program.body().front().getOps<ComponentOp>()) {
+      for (auto group : component.getWiresOp().getBody()->getOps<GroupOp>())
+        if (!getStaticLatency(group))
+          if (auto latency = inferGroupLatency(group))
+            setStaticLatency(group, *latency);
+
+      auto latency =
+          inferControlLatency(component.getControlOp(), component.getWiresOp());
+      if (latency && !getStaticLatency(component)) {
+        setStaticLatency(component, *latency);
+        changed = true;
+      }
+    }
+  }
+}
+
+std::unique_ptr<mlir::Pass> circt::calyx::createInferStaticTimingPass() {
+  return std::make_unique<InferStaticTimingPass>();
+}
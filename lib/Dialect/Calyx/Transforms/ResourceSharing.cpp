@@ -0,0 +1,143 @@
+//===- ResourceSharing.cpp - Resource Sharing Pass --------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Contains the definitions of the Resource Sharing pass.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/Calyx/CalyxOps.h"
+#include "circt/Dialect/Calyx/CalyxPasses.h"
+#include "circt/Support/LLVM.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
+
+using namespace circt;
+using namespace calyx;
+using namespace mlir;
+
+namespace {
+
+/// The pairs of groups that may be active at the same time, as derived from
+/// the control schedule of a component.
+class GroupConflicts {
+public:
+  GroupConflicts(ControlOp control) { collectGroups(control); }
+
+  /// Returns true if the groups `a` and `b` may be active at the same time.
+  /// Every group conflicts with itself.
+  bool conflict(StringRef a, StringRef b) const {
+    return a == b || conflicts.count(std::make_pair(a, b));
+  }
+
+private:
+  /// Returns the groups enabled within `control`, and records the conflicts
+  /// between the groups of parallel children.
+  SmallVector<StringRef> collectGroups(Operation *control);
+
+  DenseSet<std::pair<StringRef, StringRef>> conflicts;
+};
+
+} // end anonymous namespace
+
+SmallVector<StringRef> GroupConflicts::collectGroups(Operation *control) {
+  if (auto enable = dyn_cast<EnableOp>(control))
+    return {enable.groupName()};
+
+  SmallVector<SmallVector<StringRef>> children;
+  for (auto &region : control->getRegions())
+    for (auto &block : region)
+      for (auto &child : block)
+        children.push_back(collectGroups(&child));
+
+  // Only the children of sequential control run one at a time.
+  if (!isa<ControlOp, SeqOp>(control))
+    for (unsigned i = 0, e = children.size(); i < e; ++i)
+      for (unsigned j = i + 1; j < e; ++j)
+        for (auto a : children[i])
+          for (auto b : children[j]) {
+            conflicts.insert(std::make_pair(a, b));
+            conflicts.insert(std::make_pair(b, a));
+          }
+
+  SmallVector<StringRef> groups;
+  for (auto &childGroups : children)
+    groups.append(childGroups.begin(), childGroups.end());
+  return groups;
+}
+
+/// Returns the groups using the ports of `cell`, or None if a port is used
+/// outside of a group.
+static Optional<SmallVector<StringRef>> getUsingGroups(CellOp cell) {
+  llvm::SmallSetVector<StringRef, 4> groups;
+  for (auto result : cell.getResults()) {
+    for (auto *user : result.getUsers()) {
+      auto group = user->getParentOfType<GroupOp>();
+      if (!group)
+        return None;
+      groups.insert(group.sym_name());
+    }
+  }
+  return SmallVector<StringRef>(groups.begin(), groups.end());
+}
+
+namespace {
+
+/// A cell that other cells have been merged into, along with the groups
+/// using it.
+struct SharedCell {
+  CellOp cell;
+  SmallVector<StringRef> groups;
+};
+
+struct ResourceSharingPass : public ResourceSharingBase<ResourceSharingPass> {
+  void runOnOperation() override;
+};
+
+} // end anonymous namespace
+
+void ResourceSharingPass::runOnOperation() {
+  ComponentOp component = getOperation();
+  GroupConflicts conflicts(component.getControlOp());
+
+  // Greedily merge each shareable cell into the first earlier cell of the
+  // same component that is not used by a conflicting group.
+  llvm::StringMap<SmallVector<SharedCell, 2>> sharedCells;
+  auto cells = llvm::to_vector<8>(component.getBody()->getOps<CellOp>());
+  for (auto cell : cells) {
+    auto referenced = cell.getReferencedComponent();
+    if (!referenced || !referenced->hasAttr("share"))
+      continue;
+    auto groups = getUsingGroups(cell);
+    if (!groups)
+      continue;
+
+    auto &candidates = sharedCells[cell.componentName()];
+    auto compatible = llvm::find_if(candidates, [&](SharedCell &shared) {
+      return llvm::none_of(shared.groups, [&](StringRef a) {
+        return llvm::any_of(
+            *groups, [&](StringRef b) { return conflicts.conflict(a, b); });
+      });
+    });
+    if (compatible == candidates.end()) {
+      candidates.push_back({cell, std::move(*groups)});
+      continue;
+    }
+
+    for (auto ports :
+         llvm::zip(cell.getResults(), compatible->cell.getResults()))
+      std::get<0>(ports).replaceAllUsesWith(std::get<1>(ports));
+    compatible->groups.append(groups->begin(), groups->end());
+    cell.erase();
+  }
+}
+
+std::unique_ptr<mlir::Pass> circt::calyx::createResourceSharingPass() {
+  return std::make_unique<ResourceSharingPass>();
+}
@@ -0,0 +1,245 @@
+//===- CombAnalysis.cpp - Analyses of Comb operations ---------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Comb/CombAnalysis.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+using namespace circt;
+using namespace comb;
+using llvm::KnownBits;
+
+/// How many operations to look through when computing the known or demanded
+/// bits of a value.
+static constexpr unsigned maxDepth = 8;
+
+static unsigned getWidth(Value value) {
+  return hw::type_cast<IntegerType>(value.getType()).getWidth();
+}
+
+static KnownBits getConstantBits(const APInt &value) {
+  KnownBits result(value.getBitWidth());
+  result.One = value;
+  result.Zero = ~value;
+  return result;
+}
+
+//===----------------------------------------------------------------------===//
+// Known Bits
+//===----------------------------------------------------------------------===//
+
+KnownBits BitAnalysis::computeKnownBits(Value value, unsigned depth) {
+  auto it = knownBits.find(value);
+  if (it != knownBits.end())
+    return it->second;
+
+  auto width = getWidth(value);
+  auto *op = value.getDefiningOp();
+  if (!op || depth == maxDepth)
+    return KnownBits(width);
+
+  auto result = computeKnownBitsOfOp(op, width, depth + 1);
+  knownBits.insert({value, result});
+  return result;
+}
+
+KnownBits BitAnalysis::computeKnownBitsOfOp(Operation *op, unsigned width,
+                                            unsigned depth) {
+  auto getBits = [&](Value value) { return computeKnownBits(value, depth); };
+
+  return TypeSwitch<Operation *, KnownBits>(op)
+      .Case<hw::ConstantOp>(
+          [&](auto op) { return getConstantBits(op.value()); })
+      .Case<AndOp>([&](auto op) {
+        auto result = getConstantBits(APInt::getAllOnesValue(width));
+        for (auto input : op.inputs()) {
+          auto bits = getBits(input);
+          result.Zero |= bits.Zero;
+          result.One &= bits.One;
+        }
+        return result;
+      })
+      .Case<OrOp>([&](auto op) {
+        auto result = getConstantBits(APInt(width, 0));
+        for (auto input : op.inputs()) {
+          auto bits = getBits(input);
+          result.Zero &= bits.Zero;
+          result.One |= bits.One;
+        }
+        return result;
+      })
+      .Case<XorOp>([&](auto op) {
+        auto result = getConstantBits(APInt(width, 0));
+        for (auto input : op.inputs()) {
+          auto bits = getBits(input);
+          auto zero = (result.Zero & bits.Zero) | (result.One & bits.One);
+          result.One = (result.Zero & bits.One) | (result.One & bits.Zero);
+          result.Zero = zero;
+        }
+        return result;
+      })
+      .Case<ConcatOp>([&](auto op) {
+        // The first input is the most significant one.
+        KnownBits result(width);
+        unsigned offset = 0;
+        for (auto input : llvm::reverse(op.inputs())) {
+          auto bits = getBits(input);
+          result.Zero.insertBits(bits.Zero, offset);
+          result.One.insertBits(bits.One, offset);
+          offset += bits.getBitWidth();
+        }
+        return result;
+      })
+      .Case<ExtractOp>([&](auto op) {
+        auto bits = getBits(op.input());
+        return bits.extractBits(width, op.lowBit());
+      })
+      .Case<SExtOp>([&](auto op) {
+        // A known sign bit is replicated into the new bits.
+        auto bits = getBits(op.input());
+        KnownBits result(width);
+        result.Zero = bits.Zero.sext(width);
+        result.One = bits.One.sext(width);
+        return result;
+      })
+      .Case<MuxOp>([&](auto op) {
+        auto cond = getBits(op.cond());
+        if (cond.isConstant())
+          return getBits(cond.getConstant().getBoolValue() ? op.trueValue()
+                                                           : op.falseValue());
+        auto trueBits = getBits(op.trueValue());
+        auto falseBits = getBits(op.falseValue());
+        KnownBits result(width);
+        result.Zero = trueBits.Zero & falseBits.Zero;
+        result.One = trueBits.One & falseBits.One;
+        return result;
+      })
+      .Case<AddOp>([&](auto op) {
+        auto result = getBits(op.inputs()[0]);
+        for (auto input : op.inputs().drop_front())
+          result = KnownBits::computeForAddSub(/*Add=*/true, /*NSW=*/false,
+                                               result, getBits(input));
+        return result;
+      })
+      .Case<SubOp>([&](auto op) {
+        return KnownBits::computeForAddSub(/*Add=*/false, /*NSW=*/false,
+                                           getBits(op.lhs()),
+                                           getBits(op.rhs()));
+      })
+      .Case<ShlOp, ShrUOp>([&](auto op) {
+        // Only shifts by a known amount are handled.
+        auto amount = getBits(op.rhs());
+        if (!amount.isConstant())
+          return KnownBits(width);
+        if (amount.getConstant().uge(width))
+          return getConstantBits(APInt(width, 0));
+
+        auto shift = amount.getConstant().getZExtValue();
+        auto bits = getBits(op.lhs());
+        KnownBits result(width);
+        if (isa<ShlOp>(op.getOperation())) {
+          result.Zero = bits.Zero.shl(shift);
+          result.Zero.setLowBits(shift);
+          result.One = bits.One.shl(shift);
+        } else {
+          result.Zero = bits.Zero.lshr(shift);
+          result.Zero.setHighBits(shift);
+          result.One = bits.One.lshr(shift);
+        }
+        return result;
+      })
+      .Case<ICmpOp>([&](auto op) {
+        // Operands which differ in a known bit are never equal.
+        auto predicate = op.predicate();
+        if (predicate != ICmpPredicate::eq && predicate != ICmpPredicate::ne)
+          return KnownBits(width);
+        auto lhs = getBits(op.lhs());
+        auto rhs = getBits(op.rhs());
+        if (((lhs.One & rhs.Zero) | (lhs.Zero & rhs.One)).isNullValue())
+          return KnownBits(width);
+        return getConstantBits(APInt(1, predicate == ICmpPredicate::ne));
+      })
+      .Default([&](auto) { return KnownBits(width); });
+}
+
+//===----------------------------------------------------------------------===//
+// Demanded Bits
+//===----------------------------------------------------------------------===//
+
+APInt BitAnalysis::computeDemandedBits(Value value, unsigned depth) {
+  auto it = demandedBits.find(value);
+  if (it != demandedBits.end())
+    return it->second;
+
+  auto width = getWidth(value);
+  if (depth == maxDepth)
+    return APInt::getAllOnesValue(width);
+
+  APInt result(width, 0);
+  for (auto &use : value.getUses()) {
+    result |= computeDemandedBitsOfUse(use, width, depth + 1);
+    if (result.isAllOnesValue())
+      break;
+  }
+  demandedBits.insert({value, result});
+  return result;
+}
+
+APInt BitAnalysis::computeDemandedBitsOfUse(OpOperand &use, unsigned width,
+                                            unsigned depth) {
+  auto *user = use.getOwner();
+  auto allBits = APInt::getAllOnesValue(width);
+  auto getDemanded = [&](Value value) {
+    return computeDemandedBits(value, depth);
+  };
+
+  return TypeSwitch<Operation *, APInt>(user)
+      .Case<ExtractOp>([&](auto op) {
+        return getDemanded(op.result()).zext(width).shl(op.lowBit());
+      })
+      .Case<ConcatOp>([&](auto op) {
+        // The first input is the most significant one.
+        unsigned offset = 0;
+        for (auto input : op.inputs().drop_front(use.getOperandNumber() + 1))
+          offset += getWidth(input);
+        return getDemanded(op.result()).extractBits(width, offset);
+      })
+      .Case<AndOp, OrOp>([&](auto op) {
+        // Bits which another input forces to zero, in an `and`, or to one, in
+        // an `or`, don't matter.
+        auto result = getDemanded(op.result());
+        for (auto &operand : op->getOpOperands()) {
+          if (&operand == &use)
+            continue;
+          auto bits = computeKnownBits(operand.get(), depth);
+          result &= ~(isa<AndOp>(op.getOperation()) ? bits.Zero : bits.One);
+        }
+        return result;
+      })
+      .Case<XorOp>([&](auto op) { return getDemanded(op.result()); })
+      .Case<AddOp, SubOp, MulOp>([&](auto op) {
+        // The low bits of the result only depend on the low bits of the
+        // inputs.
+        auto demanded = getDemanded(op.result());
+        return APInt::getLowBitsSet(width, demanded.getActiveBits());
+      })
+      .Default([&](auto) { return allBits; });
+}
+
+//===----------------------------------------------------------------------===//
+// Convenience Entry Points
+//===----------------------------------------------------------------------===//
+
+KnownBits circt::comb::computeKnownBits(Value value) {
+  return BitAnalysis().getKnownBits(value);
+}
+
+APInt circt::comb::computeDemandedBits(Value value) {
+  return BitAnalysis().getDemandedBits(value);
+}
@@ -941,6 +941,106 @@ static mlir::Value sextToDestTypeAndFlip(mlir::Value op, Type destType,
   return rewriter.create<XorOp>(op.getLoc(), destType, newOperands);
 }
 
+namespace {
+/// One mux of a chain selecting on compares of a value against constants.
+struct MuxChainLink {
+  Value selector;
+  APInt constant;
+  /// The value selected if the selector equals the constant.
+  Value value;
+  /// The rest of the chain.
+  Value rest;
+};
+} // end anonymous namespace
+
+/// Match a mux whose condition compares a value to a constant, with `eq` or
+/// `ne`.
+static Optional<MuxChainLink> getMuxChainLink(MuxOp mux) {
+  auto icmp = mux.cond().getDefiningOp<ICmpOp>();
+  if (!icmp)
+    return None;
+  MuxChainLink link;
+  if (matchPattern(icmp.rhs(), m_RConstant(link.constant)))
+    link.selector = icmp.lhs();
+  else if (matchPattern(icmp.lhs(), m_RConstant(link.constant)))
+    link.selector = icmp.rhs();
+  else
+    return None;
+
+  if (icmp.predicate() == ICmpPredicate::eq) {
+    link.value = mux.trueValue();
+    link.rest = mux.falseValue();
+  } else if (icmp.predicate() == ICmpPredicate::ne) {
+    link.value = mux.falseValue();
+    link.rest = mux.trueValue();
+  } else {
+    return None;
+  }
+  return link;
+}
+
+/// Fold a chain of muxes comparing one selector against constants into a
+/// lookup of the selector in an array of the selected values:
+///
+///   mux(x == 0, a, mux(x == 1, b, mux(x == 2, c, mux(x == 3, d, e))))
+///     -> array_create(d, c, b, a)[x]
+///
+/// ExpandWhens leaves such chains behind for `when`/`elsewhen` chains on a
+/// selector.  Their conditions are mutually exclusive, so the lookup replaces
+/// a chain as deep as it is long with a single level of logic.  Only chains
+/// of at least 4 muxes whose selector is narrow enough for the array not to
+/// be mostly filled with the default value are folded.
+static LogicalResult foldMuxChain(MuxOp root, PatternRewriter &rewriter) {
+  constexpr unsigned minChainLength = 4;
+  constexpr unsigned maxSelectorWidth = 8;
+
+  auto first = getMuxChainLink(root);
+  if (!first)
+    return failure();
+  Value selector = first->selector;
+  unsigned width = selector.getType().getIntOrFloatBitWidth();
+  if (width == 0 || width > maxSelectorWidth)
+    return failure();
+
+  // Fold the chain from its head only, rather than piecemeal from its tail.
+  if (root->hasOneUse())
+    if (auto user = dyn_cast<MuxOp>(*root->user_begin()))
+      if (auto link = getMuxChainLink(user))
+        if (link->selector == selector && link->rest == root.getResult())
+          return failure();
+
+  // Walk the chain.  The outermost mux comparing against a constant wins, the
+  // ones further in are never selected.  The muxes used elsewhere end the
+  // chain, so that no logic gets duplicated.
+  SmallVector<Value> table(1ULL << width);
+  unsigned chainLength = 0;
+  Value rest = root.getResult();
+  while (auto mux = rest.getDefiningOp<MuxOp>()) {
+    if (mux != root && !mux->hasOneUse())
+      break;
+    auto link = getMuxChainLink(mux);
+    if (!link || link->selector != selector)
+      break;
+    auto &entry = table[link->constant.getZExtValue()];
+    if (!entry)
+      entry = link->value;
+    ++chainLength;
+    rest = link->rest;
+  }
+
+  unsigned numCases = llvm::count_if(table, [](Value v) { return bool(v); });
+  if (chainLength < minChainLength || table.size() > 4 * numCases)
+    return failure();
+
+  // The array lists the element at the highest index first.
+  SmallVector<Value> elements;
+  for (auto entry : llvm::reverse(table))
+    elements.push_back(entry ? entry : rest);
+  auto array = rewriter.create<hw::ArrayCreateOp>(root.getLoc(), elements);
+  rewriter.replaceOpWithNewOp<hw::ArrayGetOp>(root, array, selector);
+  return success();
+}
+
 LogicalResult MuxOp::canonicalize(MuxOp op, PatternRewriter &rewriter) {
   APInt value;
 
@@ -1014,6 +1114,10 @@ LogicalResult MuxOp::canonicalize(MuxOp op, PatternRewriter &rewriter) {
     }
   }
 
+  // mux(x == c0, a, mux(x == c1, b, ...)) -> array_create(..., b, a)[x]
+  if (succeeded(foldMuxChain(op, rewriter)))
+    return success();
+
   return failure();
 }
 
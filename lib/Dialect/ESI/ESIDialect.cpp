@@ -277,8 +277,9 @@ circt::esi::buildESIWrapper(OpBuilder &b, Operation *pearl,
     }
 
     Backedge ready = bb.get(modBuilder.getI1Type());
-    backedges.insert(std::make_pair(esiPort->second.ready.argNum, ready));
     auto unwrap = modBuilder.create<UnwrapValidReady>(arg, ready);
+    backedges.insert(
+        std::make_pair(esiPort->second.ready.argNum, std::move(ready)));
     pearlOperands[esiPort->second.data.argNum] = unwrap.rawOutput();
     pearlOperands[esiPort->second.valid.argNum] = unwrap.valid();
   }
@@ -296,8 +297,10 @@ circt::esi::buildESIWrapper(OpBuilder &b, Operation *pearl,
     Backedge data = bb.get(esiPort->second.data.type);
     Backedge valid = bb.get(modBuilder.getI1Type());
     auto wrap = modBuilder.create<WrapValidReady>(data, valid);
-    backedges.insert(std::make_pair(esiPort->second.data.argNum, data));
-    backedges.insert(std::make_pair(esiPort->second.valid.argNum, valid));
+    backedges.insert(
+        std::make_pair(esiPort->second.data.argNum, std::move(data)));
+    backedges.insert(
+        std::make_pair(esiPort->second.valid.argNum, std::move(valid)));
     outputs[port.argNum] = wrap.chanOutput();
     pearlOperands[esiPort->second.ready.argNum] = wrap.ready();
   }
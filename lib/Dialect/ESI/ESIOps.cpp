@@ -65,10 +65,12 @@ static void print(OpAsmPrinter &p, ChannelBuffer &op) {
 }
 
 //===----------------------------------------------------------------------===//
-// PipelineStage functions.
+// PipelineStage, ChannelFIFO and ChannelShiftRegister functions.
 //===----------------------------------------------------------------------===//
 
-static ParseResult parsePipelineStage(OpAsmParser &parser,
+/// Parse the clock, reset and input channel of an elastic buffer, with its
+/// attributes.
+static ParseResult parseElasticBuffer(OpAsmParser &parser,
                                       OperationState &result) {
   llvm::SMLoc inputOperandsLoc = parser.getCurrentLocation();
 
@@ -89,6 +91,11 @@ static ParseResult parsePipelineStage(OpAsmParser &parser,
   return success();
 }
 
+static ParseResult parsePipelineStage(OpAsmParser &parser,
+                                      OperationState &result) {
+  return parseElasticBuffer(parser, result);
+}
+
 static void print(OpAsmPrinter &p, PipelineStage &op) {
   p << "esi.stage " << op.clk() << ", " << op.rstn() << ", " << op.input()
     << " ";
@@ -96,6 +103,30 @@ static void print(OpAsmPrinter &p, PipelineStage &op) {
   p << " : " << op.output().getType().cast<ChannelPort>().getInner();
 }
 
+static ParseResult parseChannelFIFO(OpAsmParser &parser,
+                                    OperationState &result) {
+  return parseElasticBuffer(parser, result);
+}
+
+static void print(OpAsmPrinter &p, ChannelFIFO &op) {
+  p << "esi.fifo " << op.clk() << ", " << op.rstn() << ", " << op.input()
+    << " ";
+  p.printOptionalAttrDict(op->getAttrs());
+  p << " : " << op.output().getType().cast<ChannelPort>().getInner();
+}
+
+static ParseResult parseChannelShiftRegister(OpAsmParser &parser,
+                                             OperationState &result) {
+  return parseElasticBuffer(parser, result);
+}
+
+static void print(OpAsmPrinter &p, ChannelShiftRegister &op) {
+  p << "esi.shift_register " << op.clk() << ", " << op.rstn() << ", "
+    << op.input() << " ";
+  p.printOptionalAttrDict(op->getAttrs());
+  p << " : " << op.output().getType().cast<ChannelPort>().getInner();
+}
+
 //===----------------------------------------------------------------------===//
 // Wrap / unwrap.
 //===----------------------------------------------------------------------===//
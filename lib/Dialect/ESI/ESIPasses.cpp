@@ -15,18 +15,25 @@
 #include "circt/Dialect/ESI/ESITypes.h"
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/HW/HWTypes.h"
+#include "circt/Dialect/MSFT/MSFTAttributes.h"
+#include "circt/Dialect/MSFT/PlacementDB.h"
 #include "circt/Dialect/SV/SVOps.h"
+#include "circt/Dialect/Seq/SeqOps.h"
 #include "circt/Support/BackedgeBuilder.h"
 #include "circt/Support/LLVM.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Parallel.h"
 
+#include <atomic>
 #include <memory>
 
 #ifdef CAPNP
@@ -57,18 +64,24 @@ public:
   ESIHWBuilder(Operation *top);
 
   HWModuleExternOp declareStage();
+  HWModuleExternOp declareFIFO();
+  HWModuleExternOp declareShiftRegister();
   // Will be unused when CAPNP is undefined
   HWModuleExternOp declareCosimEndpoint() LLVM_ATTRIBUTE_UNUSED;
 
   InterfaceOp getOrConstructInterface(ChannelPort);
   InterfaceOp constructInterface(ChannelPort);
+  /// Return the interface already constructed for a port type, if any. Unlike
+  /// the above, this doesn't modify the IR so it is safe to call from several
+  /// threads.
+  InterfaceOp lookupInterface(ChannelPort) const;
 
   // A bunch of constants for use in various places below.
   const StringAttr a, aValid, aReady, x, xValid, xReady;
   const StringAttr dataOutValid, dataOutReady, dataOut, dataInValid,
       dataInReady, dataIn;
   const StringAttr clk, rstn;
-  const Identifier width;
+  const Identifier width, depth;
 
   // Various identifier strings. Keep them all here in case we rename them.
   static constexpr char dataStr[] = "data", validStr[] = "valid",
@@ -80,7 +93,13 @@ private:
   /// taken in the symbol table.
   StringAttr constructInterfaceName(ChannelPort);
 
+  /// Declare an elastic buffer external module with the ports of
+  /// 'ESI_PipelineStage'.
+  HWModuleExternOp declareBuffer(StringRef name);
+
   HWModuleExternOp declaredStage;
+  HWModuleExternOp declaredFIFO;
+  HWModuleExternOp declaredShiftRegister;
   HWModuleExternOp declaredCosimEndpoint;
   llvm::DenseMap<Type, InterfaceOp> portTypeLookup;
 };
@@ -108,7 +127,9 @@ ESIHWBuilder::ESIHWBuilder(Operation *top)
       dataIn(StringAttr::get(getContext(), "DataIn")),
       clk(StringAttr::get(getContext(), "clk")),
       rstn(StringAttr::get(getContext(), "rstn")),
-      width(Identifier::get("WIDTH", getContext())), declaredStage(nullptr) {
+      width(Identifier::get("WIDTH", getContext())),
+      depth(Identifier::get("DEPTH", getContext())), declaredStage(nullptr),
+      declaredFIFO(nullptr), declaredShiftRegister(nullptr) {
 
   auto regions = top->getRegions();
   if (regions.size() == 0) {
@@ -168,10 +189,30 @@ StringAttr ESIHWBuilder::constructInterfaceName(ChannelPort port) {
 /// implementation is double-buffered and fully pipelines the reverse-flow ready
 /// signal.
 HWModuleExternOp ESIHWBuilder::declareStage() {
-  if (declaredStage)
-    return declaredStage;
+  if (!declaredStage)
+    declaredStage = declareBuffer("ESI_PipelineStage");
+  return declaredStage;
+}
+
+/// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
+/// module implements a memory backed queue, adding 1 cycle latency.
+HWModuleExternOp ESIHWBuilder::declareFIFO() {
+  if (!declaredFIFO)
+    declaredFIFO = declareBuffer("ESI_FIFO");
+  return declaredFIFO;
+}
 
-  auto name = StringAttr::get(getContext(), "ESI_PipelineStage");
+/// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
+/// module implements a credit based buffer of shift registers, adding one
+/// cycle more latency than its number of stages.
+HWModuleExternOp ESIHWBuilder::declareShiftRegister() {
+  if (!declaredShiftRegister)
+    declaredShiftRegister = declareBuffer("ESI_ShiftRegister");
+  return declaredShiftRegister;
+}
+
+HWModuleExternOp ESIHWBuilder::declareBuffer(StringRef bufferName) {
+  auto name = StringAttr::get(getContext(), bufferName);
   // Since this module has parameterized widths on the a input and x output,
   // give the extern declation a None type since nothing else makes sense.
   // Will be refining this when we decide how to better handle parameterized
@@ -184,8 +225,7 @@ HWModuleExternOp ESIHWBuilder::declareStage() {
                             {x, PortDirection::OUTPUT, getNoneType(), 1},
                             {xValid, PortDirection::OUTPUT, getI1Type(), 2},
                             {xReady, PortDirection::INPUT, getI1Type(), 4}};
-  declaredStage = create<HWModuleExternOp>(name, ports);
-  return declaredStage;
+  return create<HWModuleExternOp>(name, ports);
 }
 
 /// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
@@ -224,6 +264,10 @@ InterfaceOp ESIHWBuilder::getOrConstructInterface(ChannelPort t) {
   return iface;
 }
 
+InterfaceOp ESIHWBuilder::lookupInterface(ChannelPort t) const {
+  return portTypeLookup.lookup(t);
+}
+
 InterfaceOp ESIHWBuilder::constructInterface(ChannelPort chan) {
   return create<InterfaceOp>(constructInterfaceName(chan).getValue(), [&]() {
     create<InterfaceSignalOp>(validStr, getI1Type());
@@ -244,19 +288,92 @@ InterfaceOp ESIHWBuilder::constructInterface(ChannelPort chan) {
 //===----------------------------------------------------------------------===//
 
 namespace {
-/// Lower `ChannelBuffer`s, breaking out the various options. For now, just
-/// replace with the specified number of pipeline stages (since that's the only
-/// option).
+/// The placements of the entities in each module.
+using ModulePlacements = DenseMap<Operation *, msft::PlacementDB>;
+
+/// Lower `ChannelBuffer`s, breaking out the various options. Replace with the
+/// specified number of pipeline stages, or with a FIFO or a shift register if
+/// that's deep enough.
 struct ChannelBufferLowering : public OpConversionPattern<ChannelBuffer> {
 public:
-  using OpConversionPattern::OpConversionPattern;
+  ChannelBufferLowering(MLIRContext *ctxt, unsigned stageDistance,
+                        unsigned fifoThreshold, unsigned shiftRegisterThreshold,
+                        const ModulePlacements &placements)
+      : OpConversionPattern(ctxt), stageDistance(stageDistance),
+        fifoThreshold(fifoThreshold),
+        shiftRegisterThreshold(shiftRegisterThreshold), placements(placements) {
+  }
 
   LogicalResult
   matchAndRewrite(ChannelBuffer buffer, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final;
+
+private:
+  uint64_t placementStages(ChannelBuffer buffer) const;
+
+  unsigned stageDistance;
+  unsigned fifoThreshold;
+  unsigned shiftRegisterThreshold;
+  const ModulePlacements &placements;
 };
 } // anonymous namespace
 
+/// Record the entities placed by the `loc:<entityName>` attributes of the
+/// operations in `mod`. Fail if two of them overlap.
+static LogicalResult collectPlacements(hw::HWModuleOp mod,
+                                       msft::PlacementDB &db) {
+  auto result = mod.walk([&](Operation *op) {
+    for (auto attr : op->getAttrs()) {
+      auto loc = attr.second.dyn_cast<msft::PhysLocationAttr>();
+      StringRef key = attr.first.strref();
+      if (!loc || !key.startswith("loc:"))
+        continue;
+
+      // Name the entity like the Quartus Tcl export does.
+      std::string path = "$parent|";
+      if (auto inst = dyn_cast<hw::InstanceOp>(op))
+        path += (inst.instanceName() + "|").str();
+      else if (auto name = op->getAttrOfType<StringAttr>("name"))
+        path += (name.getValue() + "|").str();
+      path += key.substr(4).str();
+      if (failed(db.addPlacement(loc, {std::move(path), op})))
+        return WalkResult::interrupt();
+    }
+    return WalkResult::advance();
+  });
+  return failure(result.wasInterrupted());
+}
+
+/// Compute the number of stages needed to span the longest Manhattan distance
+/// between an entity placed in the producer of the buffered channel and one
+/// placed in a consumer. Returns 0 if either end isn't placed.
+uint64_t ChannelBufferLowering::placementStages(ChannelBuffer buffer) const {
+  auto it = placements.find(buffer->getParentOfType<hw::HWModuleOp>());
+  if (it == placements.end())
+    return 0;
+  const msft::PlacementDB &db = it->second;
+
+  SmallVector<msft::PhysLocationAttr, 4> producerLocs, consumerLocs;
+  if (auto *producer = buffer.input().getDefiningOp())
+    db.getPlacementsOf(producer, producerLocs);
+  for (auto *user : buffer.output().getUsers())
+    db.getPlacementsOf(user, consumerLocs);
+
+  uint64_t distance = 0;
+  bool placed = false;
+  for (auto from : producerLocs) {
+    for (auto to : consumerLocs) {
+      auto diff = [](uint64_t a, uint64_t b) { return a > b ? a - b : b - a; };
+      distance = std::max(distance, diff(from.getX(), to.getX()) +
+                                        diff(from.getY(), to.getY()));
+      placed = true;
+    }
+  }
+  if (!placed)
+    return 0;
+  return std::max<uint64_t>(1, llvm::divideCeil(distance, stageDistance));
+}
+
 LogicalResult ChannelBufferLowering::matchAndRewrite(
     ChannelBuffer buffer, ArrayRef<Value> operands,
     ConversionPatternRewriter &rewriter) const {
@@ -271,9 +388,41 @@ LogicalResult ChannelBufferLowering::matchAndRewrite(
   if (stages) {
     // Guaranteed positive by the parser.
     numStages = stages.getValue().getLimitedValue();
+  } else if (stageDistance) {
+    if (uint64_t fromPlacement = placementStages(buffer))
+      numStages = fromPlacement;
   }
   Value input = buffer.input();
   StringAttr bufferName = buffer.options().name();
+
+  // Deep buffers are cheaper as a memory than as registers.
+  if (fifoThreshold && numStages >= fifoThreshold) {
+    auto fifo = rewriter.create<ChannelFIFO>(
+        loc, type, buffer.clk(), buffer.rstn(), input,
+        rewriter.getI64IntegerAttr(numStages));
+    if (bufferName) {
+      SmallString<64> fifoName({bufferName.getValue(), "_fifo"});
+      fifo->setAttr("name", StringAttr::get(rewriter.getContext(), fifoName));
+    }
+    rewriter.replaceOp(buffer, fifo.output());
+    return success();
+  }
+
+  // Deep buffers on FPGAs are cheaper without the backpressure logic of every
+  // stage.
+  if (shiftRegisterThreshold && numStages >= shiftRegisterThreshold) {
+    auto shiftRegister = rewriter.create<ChannelShiftRegister>(
+        loc, type, buffer.clk(), buffer.rstn(), input,
+        rewriter.getI64IntegerAttr(numStages));
+    if (bufferName) {
+      SmallString<64> srName({bufferName.getValue(), "_srl"});
+      shiftRegister->setAttr("name",
+                             StringAttr::get(rewriter.getContext(), srName));
+    }
+    rewriter.replaceOp(buffer, shiftRegister.output());
+    return success();
+  }
+
   for (uint64_t i = 0; i < numStages; ++i) {
     // Create the stages, connecting them up as we build.
     auto stage = rewriter.create<PipelineStage>(loc, type, buffer.clk(),
@@ -299,6 +448,17 @@ struct ESIToPhysicalPass : public LowerESIToPhysicalBase<ESIToPhysicalPass> {
 } // anonymous namespace
 
 void ESIToPhysicalPass::runOnOperation() {
+  // Buffers are only sized from the placements if asked to.
+  ModulePlacements placements;
+  if (stageDistance) {
+    for (auto mod : getOperation().getOps<hw::HWModuleOp>()) {
+      if (failed(collectPlacements(mod, placements[mod]))) {
+        signalPassFailure();
+        return;
+      }
+    }
+  }
+
   // Set up a conversion and give it a set of laws.
   ConversionTarget target(getContext());
   target.addLegalDialect<ESIDialect>();
@@ -306,7 +466,9 @@ void ESIToPhysicalPass::runOnOperation() {
 
   // Add all the conversion patterns.
   RewritePatternSet patterns(&getContext());
-  patterns.insert<ChannelBufferLowering>(&getContext());
+  patterns.insert<ChannelBufferLowering>(&getContext(), stageDistance,
+                                         fifoThreshold, shiftRegisterThreshold,
+                                         placements);
 
   // Run the conversion.
   if (failed(
@@ -314,6 +476,204 @@ void ESIToPhysicalPass::runOnOperation() {
     signalPassFailure();
 }
 
+//===----------------------------------------------------------------------===//
+// Channel packing pass.
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Pack the narrow buffered channels between pairs of instances onto one
+/// buffered channel each.
+struct ESIPackChannelsPass : public ESIPackChannelsBase<ESIPackChannelsPass> {
+  void runOnOperation() override;
+
+private:
+  void pack(ArrayRef<ChannelBuffer> buffers, Operation *consumer);
+};
+} // anonymous namespace
+
+/// Return the bits of `value` as a signless integer, bitcasting if necessary.
+static Value asInteger(ImplicitLocOpBuilder &b, Value value, int64_t width) {
+  auto intType = b.getIntegerType(width);
+  if (value.getType() == intType)
+    return value;
+  return b.create<hw::BitcastOp>(intType, value);
+}
+
+/// Replace `buffers`, which all run from the same instance to `consumer`, with
+/// one buffer. Each channel gets a one message holding register on the
+/// receiving side, and a credit for it on the sending side. On the sending
+/// side, the lowest-numbered valid message whose channel has its credit is
+/// tagged with the index of the channel and sent, which takes the credit. On
+/// the receiving side, the tag selects the holding register storing the
+/// message, and the credit is returned once the message leaves it.
+///
+/// Since a message is only sent once its holding register is free, the packed
+/// buffer never waits on the consumer. A consumer which doesn't take the
+/// message of one channel only blocks that channel, so channels whose
+/// messages depend on each other can't deadlock through the shared buffer.
+/// The cost is that each channel has at most one message in flight, so it
+/// only gets one message per round trip through the buffer.
+void ESIPackChannelsPass::pack(ArrayRef<ChannelBuffer> buffers,
+                               Operation *consumer) {
+  ChannelBuffer first = buffers.front();
+  ImplicitLocOpBuilder b(first.getLoc(), consumer);
+  BackedgeBuilder beb(b, first.getLoc());
+  Type i1 = b.getI1Type();
+  Value clk = first.clk();
+
+  SmallVector<int64_t, 8> widths;
+  int64_t dataWidth = 0;
+  for (auto buffer : buffers) {
+    auto inner = buffer.getType().cast<ChannelPort>().getInner();
+    widths.push_back(hw::getBitWidth(inner));
+    dataWidth = std::max(dataWidth, widths.back());
+  }
+  unsigned tagWidth = std::max(1u, llvm::Log2_64_Ceil(buffers.size()));
+  auto tagType = b.getIntegerType(tagWidth);
+  Value trueConst = b.create<hw::ConstantOp>(i1, 1);
+  Value falseConst = b.create<hw::ConstantOp>(i1, 0);
+  Value reset = b.create<XorOp>(first.rstn(), trueConst);
+
+  // A register of `next`, cleared by the reset if `resetValue` is given.
+  auto makeReg = [&](Value next, Value resetValue = {}) -> Value {
+    return b.create<seq::CompRegOp>(next.getType(), next, clk,
+                                    resetValue ? reset : Value(), resetValue);
+  };
+
+  // The credits of the channels: set while a message of the channel is in the
+  // packed buffer or its holding register.
+  SmallVector<Backedge, 8> inFlightNexts;
+  SmallVector<Value, 8> inFlights;
+  for (size_t i = 0, e = buffers.size(); i < e; ++i) {
+    inFlightNexts.push_back(beb.get(i1));
+    inFlights.push_back(makeReg(inFlightNexts.back(), falseConst));
+  }
+
+  // Tag each message, then pick the first valid one with a credit.
+  SmallVector<Backedge, 8> inputReadys;
+  SmallVector<Value, 8> grants, tagged;
+  Value anyValid;
+  for (size_t i = 0, e = buffers.size(); i < e; ++i) {
+    inputReadys.push_back(beb.get(i1));
+    auto unwrap =
+        b.create<UnwrapValidReady>(buffers[i].input(), inputReadys.back());
+    Value data = asInteger(b, unwrap.rawOutput(), widths[i]);
+    SmallVector<Value, 3> fields = {b.create<hw::ConstantOp>(tagType, i)};
+    if (widths[i] < dataWidth)
+      fields.push_back(
+          b.create<hw::ConstantOp>(b.getIntegerType(dataWidth - widths[i]), 0));
+    fields.push_back(data);
+    tagged.push_back(b.create<ConcatOp>(fields));
+
+    Value hasCredit = b.create<XorOp>(inFlights[i], trueConst);
+    Value valid = b.create<AndOp>(unwrap.valid(), hasCredit);
+    if (!anyValid) {
+      grants.push_back(valid);
+      anyValid = valid;
+      continue;
+    }
+    Value noneBefore = b.create<XorOp>(anyValid, trueConst);
+    grants.push_back(b.create<AndOp>(valid, noneBefore));
+    anyValid = b.create<OrOp>(anyValid, valid);
+  }
+  Value packed = tagged.back();
+  for (size_t i = buffers.size() - 1; i-- > 0;)
+    packed = b.create<MuxOp>(grants[i], tagged[i], packed);
+  auto packedWrap = b.create<WrapValidReady>(packed, anyValid);
+  SmallVector<Value, 8> sends;
+  for (size_t i = 0, e = buffers.size(); i < e; ++i) {
+    sends.push_back(b.create<AndOp>(grants[i], packedWrap.ready()));
+    inputReadys[i].setValue(sends.back());
+  }
+
+  // Buffer the packed channel like the deepest of the buffers it replaces.
+  IntegerAttr stages;
+  for (auto buffer : buffers)
+    if (auto bufferStages = buffer.options().stages())
+      if (!stages || bufferStages.getInt() > stages.getInt())
+        stages = bufferStages;
+  StringAttr name;
+  if (auto firstName = first.options().name())
+    name = b.getStringAttr(firstName.getValue() + "_packed");
+  auto packedBuffer = b.create<ChannelBuffer>(
+      packedWrap.chanOutput().getType(), clk, first.rstn(),
+      packedWrap.chanOutput(),
+      ChannelBufferOptions::get(stages, name, b.getContext()));
+
+  // The holding register of a message's channel is always free, so the
+  // packed channel is always ready. Steer each message to its register.
+  auto packedUnwrap =
+      b.create<UnwrapValidReady>(packedBuffer.output(), trueConst);
+  Value tag = b.create<ExtractOp>(tagType, packedUnwrap.rawOutput(), dataWidth);
+  for (size_t i = 0, e = buffers.size(); i < e; ++i) {
+    Value isChannel = b.create<ICmpOp>(ICmpPredicate::eq, tag,
+                                       b.create<hw::ConstantOp>(tagType, i));
+    Value arrive = b.create<AndOp>(packedUnwrap.valid(), isChannel);
+    Value data = b.create<ExtractOp>(b.getIntegerType(widths[i]),
+                                     packedUnwrap.rawOutput(), 0);
+
+    Backedge heldDataNext = beb.get(data.getType());
+    Backedge heldValidNext = beb.get(i1);
+    Value heldData = makeReg(heldDataNext);
+    Value heldValid = makeReg(heldValidNext, falseConst);
+    heldDataNext.setValue(b.create<MuxOp>(arrive, data, heldData));
+
+    auto inner = buffers[i].getType().cast<ChannelPort>().getInner();
+    Value output = heldData;
+    if (output.getType() != inner)
+      output = b.create<hw::BitcastOp>(inner, output);
+    auto wrap = b.create<WrapValidReady>(output, heldValid);
+    buffers[i].output().replaceAllUsesWith(wrap.chanOutput());
+
+    // A message arrives only while the register is empty, so it is kept
+    // until the consumer takes it, which returns the credit.
+    Value take = b.create<AndOp>(heldValid, wrap.ready());
+    Value notTaken = b.create<XorOp>(take, trueConst);
+    heldValidNext.setValue(
+        b.create<OrOp>(arrive, b.create<AndOp>(heldValid, notTaken)));
+    inFlightNexts[i].setValue(
+        b.create<OrOp>(sends[i], b.create<AndOp>(inFlights[i], notTaken)));
+  }
+
+  for (auto buffer : buffers)
+    buffer.erase();
+}
+
+void ESIPackChannelsPass::runOnOperation() {
+  for (auto mod : getOperation().getOps<HWModuleOp>()) {
+    // Group the narrow buffers by the instances they connect. Only buffers
+    // with the same clock and reset as the first of their group join it.
+    llvm::MapVector<std::pair<Operation *, Operation *>,
+                    SmallVector<ChannelBuffer, 4>>
+        groups;
+    mod.walk([&](ChannelBuffer buffer) {
+      auto inner = buffer.getType().cast<ChannelPort>().getInner();
+      int64_t width = hw::getBitWidth(inner);
+      if (width <= 0 || width > maxWidth || !buffer.output().hasOneUse())
+        return;
+      auto producer = buffer.input().getDefiningOp<InstanceOp>();
+      auto consumer = dyn_cast<InstanceOp>(*buffer.output().user_begin());
+      if (!producer || !consumer)
+        return;
+      auto &group = groups[{producer, consumer}];
+      if (!group.empty() && (group.front().clk() != buffer.clk() ||
+                             group.front().rstn() != buffer.rstn()))
+        return;
+      group.push_back(buffer);
+    });
+
+    for (auto &group : groups) {
+      ArrayRef<ChannelBuffer> buffers = group.second;
+      size_t chunk = maxChannels ? maxChannels : buffers.size();
+      for (size_t i = 0, e = buffers.size(); i < e; i += chunk) {
+        auto chunkBuffers = buffers.slice(i, std::min(chunk, e - i));
+        if (chunkBuffers.size() > 1)
+          pack(chunkBuffers, group.first.second);
+      }
+    }
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // Lower ESI ports pass.
 //===----------------------------------------------------------------------===//
@@ -335,7 +695,28 @@ private:
 };
 } // anonymous namespace
 
-/// Iterate through the `hw.module[.extern]`s and lower their ports.
+/// Run `fn` on each index below `numOps`, in parallel if multithreading is
+/// enabled. Each call must only modify the op with that index.
+static void forEachInParallel(MLIRContext &context, size_t numOps,
+                              llvm::function_ref<void(size_t)> fn) {
+  if (context.isMultithreadingEnabled()) {
+    // Diagnostics are ordered by the position of the op in the module.
+    mlir::ParallelDiagnosticHandler diagHandler(&context);
+    llvm::parallelForEachN(0, numOps, [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      fn(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0; i != numOps; ++i)
+      fn(i);
+  }
+}
+
+/// Iterate through the `hw.module[.extern]`s and lower their ports. The
+/// external modules are updated first and serially since they construct the
+/// SV interfaces. Then each module, which holds the instances, is updated
+/// independently of the others.
 void ESIPortsPass::runOnOperation() {
   ModuleOp top = getOperation();
   ESIHWBuilder b(top);
@@ -347,26 +728,35 @@ void ESIPortsPass::runOnOperation() {
     if (updateFunc(mod))
       externModsMutated[mod.getName()] = mod;
 
-  // Find all instances and update them.
-  top.walk([&externModsMutated, this](InstanceOp inst) {
-    auto mapIter = externModsMutated.find(inst.moduleName());
-    if (mapIter != externModsMutated.end())
-      updateInstance(mapIter->second, inst);
+  // Find all instances of those and update them, then try to modify the
+  // modules to have wires with valid/ready semantics. Neither looks at the
+  // other modules so they can run in parallel.
+  SmallVector<HWModuleOp, 0> mods(top.getOps<HWModuleOp>());
+  SmallVector<char, 0> mutated(mods.size(), false);
+  forEachInParallel(getContext(), mods.size(), [&](size_t index) {
+    mods[index].walk([&externModsMutated, this](InstanceOp inst) {
+      auto mapIter = externModsMutated.find(inst.moduleName());
+      if (mapIter != externModsMutated.end())
+        updateInstance(mapIter->second, inst);
+    });
+    mutated[index] = updateFunc(mods[index]);
   });
 
-  // Find all modules and try to modify them to have wires with valid/ready
-  // semantics. Remember the modified ones.
+  // Remember the modified ones.
   DenseMap<StringRef, HWModuleOp> modsMutated;
-  for (auto mod : top.getOps<HWModuleOp>())
-    if (updateFunc(mod))
-      modsMutated[mod.getName()] = mod;
+  for (size_t i = 0, e = mods.size(); i != e; ++i)
+    if (mutated[i])
+      modsMutated[mods[i].getName()] = mods[i];
 
   // Find all instances and update them.
-  top.walk([&modsMutated, this](InstanceOp inst) {
-    auto mapIter = modsMutated.find(inst.moduleName());
-    if (mapIter != modsMutated.end())
-      updateInstance(mapIter->second, inst);
-  });
+  if (!modsMutated.empty())
+    forEachInParallel(getContext(), mods.size(), [&](size_t index) {
+      mods[index].walk([&modsMutated, this](InstanceOp inst) {
+        auto mapIter = modsMutated.find(inst.moduleName());
+        if (mapIter != modsMutated.end())
+          updateInstance(mapIter->second, inst);
+      });
+    });
 
   build = nullptr;
 }
@@ -521,9 +911,9 @@ void ESIPortsPass::updateInstance(HWModuleOp mod, InstanceOp inst) {
       continue;
     }
 
-    auto ready = beb.get(i1);
-    inputReadysToConnect.push_back(ready);
-    auto unwrap = b.create<UnwrapValidReady>(operand, ready);
+    inputReadysToConnect.push_back(beb.get(i1));
+    auto unwrap =
+        b.create<UnwrapValidReady>(operand, inputReadysToConnect.back());
     newOperands.push_back(unwrap.rawOutput());
     newOperands.push_back(unwrap.valid());
   }
@@ -543,9 +933,8 @@ void ESIPortsPass::updateInstance(HWModuleOp mod, InstanceOp inst) {
     }
     resTypes.push_back(cpTy.getInner());
     resTypes.push_back(i1);
-    Backedge ready = beb.get(i1);
-    newOperands.push_back(ready);
-    outputReadysToConnect.push_back(ready);
+    outputReadysToConnect.push_back(beb.get(i1));
+    newOperands.push_back(outputReadysToConnect.back());
   }
   resTypes.append(inputReadysToConnect.size(), i1);
 
@@ -577,7 +966,7 @@ void ESIPortsPass::updateInstance(HWModuleOp mod, InstanceOp inst) {
     readyIdx++;
   }
 
-  for (auto inputReady : inputReadysToConnect) {
+  for (auto &inputReady : inputReadysToConnect) {
     inputReady.setValue(newInst.getResult(newInstResNum));
     newInstResNum++;
   }
@@ -706,10 +1095,11 @@ void ESIPortsPass::updateInstance(HWModuleExternOp mod, InstanceOp inst) {
     }
 
     // Get the interface from the cache, and make sure it's the same one as
-    // being used in the module.
-    auto iface = build->getOrConstructInterface(instChanTy);
-    if (iface.getModportType(ESIHWBuilder::sourceStr) !=
-        funcTy.getInput(opNum)) {
+    // being used in the module. The module signature constructed all the
+    // interfaces it uses.
+    auto iface = build->lookupInterface(instChanTy);
+    if (!iface || iface.getModportType(ESIHWBuilder::sourceStr) !=
+                      funcTy.getInput(opNum)) {
       inst.emitOpError("ESI ChannelPort (operand #")
           << opNum << ") doesn't match module!";
       ++opNum;
@@ -752,8 +1142,9 @@ void ESIPortsPass::updateInstance(HWModuleExternOp mod, InstanceOp inst) {
 
     // Get the interface from the cache, and make sure it's the same one as
     // being used in the module.
-    auto iface = build->getOrConstructInterface(instChanTy);
-    if (iface.getModportType(ESIHWBuilder::sinkStr) != funcTy.getInput(opNum)) {
+    auto iface = build->lookupInterface(instChanTy);
+    if (!iface ||
+        iface.getModportType(ESIHWBuilder::sinkStr) != funcTy.getInput(opNum)) {
       inst.emitOpError("ESI ChannelPort (result #")
           << resNum << ", operand #" << opNum << ") doesn't match module!";
       ++opNum;
@@ -817,15 +1208,91 @@ public:
   matchAndRewrite(PipelineStage stage, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final;
 
+private:
+  ESIHWBuilder &builder;
+};
+
+/// Lower ChannelFIFO ops to an HW implementation, the same way as pipeline
+/// stages.
+struct ChannelFIFOLowering : public OpConversionPattern<ChannelFIFO> {
+public:
+  ChannelFIFOLowering(ESIHWBuilder &builder, MLIRContext *ctxt)
+      : OpConversionPattern(ctxt), builder(builder) {}
+  using OpConversionPattern::OpConversionPattern;
+
+  LogicalResult
+  matchAndRewrite(ChannelFIFO fifo, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const final;
+
+private:
+  ESIHWBuilder &builder;
+};
+
+/// Lower ChannelShiftRegister ops to an HW implementation, the same way as
+/// pipeline stages.
+struct ChannelShiftRegisterLowering
+    : public OpConversionPattern<ChannelShiftRegister> {
+public:
+  ChannelShiftRegisterLowering(ESIHWBuilder &builder, MLIRContext *ctxt)
+      : OpConversionPattern(ctxt), builder(builder) {}
+  using OpConversionPattern::OpConversionPattern;
+
+  LogicalResult
+  matchAndRewrite(ChannelShiftRegister shiftRegister, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const final;
+
 private:
   ESIHWBuilder &builder;
 };
 } // anonymous namespace
 
+/// Replace `op`, which buffers the channel `input`, with an instance named
+/// `instName` of the elastic buffer external module `bufferModule`.
+static void replaceWithBufferInstance(Operation *op, Value clk, Value rstn,
+                                      Value input,
+                                      HWModuleExternOp bufferModule,
+                                      NamedAttrList &params, StringRef instName,
+                                      ConversionPatternRewriter &rewriter) {
+  auto loc = op->getLoc();
+  auto chPort = input.getType().cast<ChannelPort>();
+
+  // Unwrap the channel. The ready signal is a Value we haven't created yet, so
+  // create a temp value and replace it later. Give this constant an odd-looking
+  // type to make debugging easier.
+  circt::BackedgeBuilder back(rewriter, loc);
+  circt::Backedge wrapReady = back.get(rewriter.getI1Type());
+  auto unwrap = rewriter.create<UnwrapValidReady>(loc, input, wrapReady);
+
+  // Instantiate the external module.
+  circt::Backedge bufferReady = back.get(rewriter.getI1Type());
+  Value operands[] = {clk, rstn, unwrap.rawOutput(), unwrap.valid(),
+                      bufferReady};
+  Type resultTypes[] = {rewriter.getI1Type(), unwrap.rawOutput().getType(),
+                        rewriter.getI1Type()};
+  auto bufferInst = rewriter.create<InstanceOp>(
+      loc, resultTypes, instName, bufferModule.getName(), operands,
+      params.getDictionary(rewriter.getContext()), StringAttr());
+  auto bufferInstResults = bufferInst.getResults();
+
+  // Set a_ready (from the unwrap) back edge correctly to its output from the
+  // buffer.
+  wrapReady.setValue(bufferInstResults[0]);
+
+  Value x = bufferInstResults[1];
+  Value xValid = bufferInstResults[2];
+
+  // Wrap up the output of the HW buffer module.
+  auto wrap = rewriter.create<WrapValidReady>(loc, chPort, rewriter.getI1Type(),
+                                              x, xValid);
+  // Set the buffers x_ready backedge correctly.
+  bufferReady.setValue(wrap.ready());
+
+  rewriter.replaceOp(op, wrap.chanOutput());
+}
+
 LogicalResult PipelineStageLowering::matchAndRewrite(
     PipelineStage stage, ArrayRef<Value> stageOperands,
     ConversionPatternRewriter &rewriter) const {
-  auto loc = stage.getLoc();
   auto chPort = stage.input().getType().dyn_cast<ChannelPort>();
   if (!chPort)
     return failure();
@@ -835,42 +1302,62 @@ LogicalResult PipelineStageLowering::matchAndRewrite(
   size_t width = circt::hw::getBitWidth(chPort.getInner());
   stageParams.set(builder.width, rewriter.getUI32IntegerAttr(width));
 
-  // Unwrap the channel. The ready signal is a Value we haven't created yet, so
-  // create a temp value and replace it later. Give this constant an odd-looking
-  // type to make debugging easier.
-  circt::BackedgeBuilder back(rewriter, loc);
-  circt::Backedge wrapReady = back.get(rewriter.getI1Type());
-  auto unwrap =
-      rewriter.create<UnwrapValidReady>(loc, stage.input(), wrapReady);
-
   StringRef pipeStageName = "pipelineStage";
   if (auto name = stage->getAttrOfType<StringAttr>("name"))
     pipeStageName = name.getValue();
 
   // Instantiate the "ESI_PipelineStage" external module.
-  circt::Backedge stageReady = back.get(rewriter.getI1Type());
-  Value operands[] = {stage.clk(), stage.rstn(), unwrap.rawOutput(),
-                      unwrap.valid(), stageReady};
-  Type resultTypes[] = {rewriter.getI1Type(), unwrap.rawOutput().getType(),
-                        rewriter.getI1Type()};
-  auto stageInst = rewriter.create<InstanceOp>(
-      loc, resultTypes, pipeStageName, stageModule.getName(), operands,
-      stageParams.getDictionary(rewriter.getContext()), StringAttr());
-  auto stageInstResults = stageInst.getResults();
+  replaceWithBufferInstance(stage, stage.clk(), stage.rstn(), stage.input(),
+                            stageModule, stageParams, pipeStageName, rewriter);
+  return success();
+}
 
-  // Set a_ready (from the unwrap) back edge correctly to its output from stage.
-  wrapReady.setValue(stageInstResults[0]);
+LogicalResult ChannelFIFOLowering::matchAndRewrite(
+    ChannelFIFO fifo, ArrayRef<Value> fifoOperands,
+    ConversionPatternRewriter &rewriter) const {
+  auto chPort = fifo.input().getType().dyn_cast<ChannelPort>();
+  if (!chPort)
+    return failure();
+  auto fifoModule = builder.declareFIFO();
 
-  Value x = stageInstResults[1];
-  Value xValid = stageInstResults[2];
+  NamedAttrList fifoParams;
+  size_t width = circt::hw::getBitWidth(chPort.getInner());
+  fifoParams.set(builder.width, rewriter.getUI32IntegerAttr(width));
+  fifoParams.set(builder.depth,
+                 rewriter.getUI32IntegerAttr(fifo.depth().getLimitedValue()));
 
-  // Wrap up the output of the HW stage module.
-  auto wrap = rewriter.create<WrapValidReady>(loc, chPort, rewriter.getI1Type(),
-                                              x, xValid);
-  // Set the stages x_ready backedge correctly.
-  stageReady.setValue(wrap.ready());
+  StringRef fifoName = "fifo";
+  if (auto name = fifo->getAttrOfType<StringAttr>("name"))
+    fifoName = name.getValue();
 
-  rewriter.replaceOp(stage, wrap.chanOutput());
+  // Instantiate the "ESI_FIFO" external module.
+  replaceWithBufferInstance(fifo, fifo.clk(), fifo.rstn(), fifo.input(),
+                            fifoModule, fifoParams, fifoName, rewriter);
+  return success();
+}
+
+LogicalResult ChannelShiftRegisterLowering::matchAndRewrite(
+    ChannelShiftRegister shiftRegister, ArrayRef<Value> operands,
+    ConversionPatternRewriter &rewriter) const {
+  auto chPort = shiftRegister.input().getType().dyn_cast<ChannelPort>();
+  if (!chPort)
+    return failure();
+  auto srModule = builder.declareShiftRegister();
+
+  NamedAttrList srParams;
+  size_t width = circt::hw::getBitWidth(chPort.getInner());
+  srParams.set(builder.width, rewriter.getUI32IntegerAttr(width));
+  srParams.set(builder.depth, rewriter.getUI32IntegerAttr(
+                                  shiftRegister.stages().getLimitedValue()));
+
+  StringRef srName = "shiftRegister";
+  if (auto name = shiftRegister->getAttrOfType<StringAttr>("name"))
+    srName = name.getValue();
+
+  // Instantiate the "ESI_ShiftRegister" external module.
+  replaceWithBufferInstance(shiftRegister, shiftRegister.clk(),
+                            shiftRegister.rstn(), shiftRegister.input(),
+                            srModule, srParams, srName, rewriter);
   return success();
 }
 
@@ -1051,8 +1538,9 @@ namespace {
 /// gasket op.
 struct CosimLowering : public OpConversionPattern<CosimEndpoint> {
 public:
-  CosimLowering(ESIHWBuilder &b)
-      : OpConversionPattern(b.getContext(), 1), builder(b) {}
+  CosimLowering(ESIHWBuilder &b, unsigned numStages)
+      : OpConversionPattern(b.getContext(), 1), builder(b),
+        numStages(numStages) {}
 
   using OpConversionPattern::OpConversionPattern;
 
@@ -1062,6 +1550,8 @@ public:
 
 private:
   ESIHWBuilder &builder;
+  /// The elastic stages registering the messages on each side.
+  unsigned numStages;
 };
 } // anonymous namespace
 
@@ -1070,6 +1560,7 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, ArrayRef<Value> operands,
                                ConversionPatternRewriter &rewriter) const {
 #ifndef CAPNP
   (void)builder;
+  (void)numStages;
   return rewriter.notifyMatchFailure(
       ep, "Cosim lowering requires the ESI capnp plugin, which was disabled.");
 #else
@@ -1102,6 +1593,11 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, ArrayRef<Value> operands,
   params.set("RECV_TYPE_SIZE_BITS",
              rewriter.getI32IntegerAttr(recvTypeSchema.size()));
 
+  // Register the messages on their way to the encoder, to cut the path from
+  // the sender to the endpoint.
+  for (unsigned i = 0; i < numStages; ++i)
+    send = rewriter.create<PipelineStage>(loc, send.getType(), clk, rstn, send);
+
   // Set up the egest route to drive the EP's send ports.
   ArrayType egestBitArrayType =
       ArrayType::get(rewriter.getI1Type(), sendTypeSchema.size());
@@ -1139,8 +1635,14 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, ArrayRef<Value> operands,
       loc, decodeData.decodedData(), recvValidFromCosim);
   recvReady.setValue(wrapRecv.ready());
 
+  // Register the decoded messages, to cut the path from the endpoint to the
+  // receiver.
+  Value recv = wrapRecv.chanOutput();
+  for (unsigned i = 0; i < numStages; ++i)
+    recv = rewriter.create<PipelineStage>(loc, recv.getType(), clk, rstn, recv);
+
   // Replace the CosimEndpoint op.
-  rewriter.replaceOp(ep, wrapRecv.chanOutput());
+  rewriter.replaceOp(ep, recv);
 
   return success();
 #endif // CAPNP
@@ -1177,12 +1679,14 @@ namespace {
 /// Lower the decode gasket to SV/HW.
 struct DecoderLowering : public OpConversionPattern<CapnpDecode> {
 public:
-  using OpConversionPattern::OpConversionPattern;
+  DecoderLowering(MLIRContext *ctxt, bool fixedLayout)
+      : OpConversionPattern(ctxt), fixedLayout(fixedLayout) {}
 
   LogicalResult
   matchAndRewrite(CapnpDecode dec, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final {
 #ifndef CAPNP
+    (void)fixedLayout;
     return rewriter.notifyMatchFailure(dec,
                                        "decode.capnp lowering requires the ESI "
                                        "capnp plugin, which was disabled.");
@@ -1190,19 +1694,48 @@ public:
     capnp::TypeSchema decodeType(dec.decodedData().getType());
     if (!decodeType.isSupported())
       return rewriter.notifyMatchFailure(dec, "Type not supported yet");
-    Value decoderOutput = decodeType.buildDecoder(rewriter, operands[0],
-                                                  operands[1], operands[2]);
+    Value decoderOutput = decodeType.buildDecoder(
+        rewriter, operands[0], operands[1], operands[2], fixedLayout);
     assert(decoderOutput && "Error in TypeSchema.buildDecoder()");
     rewriter.replaceOp(dec, decoderOutput);
     return success();
 #endif
   }
+
+private:
+  bool fixedLayout;
 };
 } // namespace
 
 void ESItoHWPass::runOnOperation() {
   auto top = getOperation();
   auto ctxt = &getContext();
+  ESIHWBuilder esiBuilder(top);
+
+  // Cosim endpoints build capnp schemas and declare the endpoint module, which
+  // can't be done from several threads, so lower them first and serially.
+  ConversionTarget cosimTarget(*ctxt);
+  cosimTarget.addIllegalOp<CosimEndpoint>();
+  RewritePatternSet cosimPatterns(ctxt);
+  cosimPatterns.insert<CosimLowering>(esiBuilder, cosimStages);
+  if (failed(
+          applyPartialConversion(top, cosimTarget, std::move(cosimPatterns))))
+    signalPassFailure();
+
+  // Declare the buffer primitives up front, so that the patterns only look
+  // them up.
+  bool hasStages = false, hasFIFOs = false, hasShiftRegisters = false;
+  top.walk([&](Operation *op) {
+    hasStages |= isa<PipelineStage>(op);
+    hasFIFOs |= isa<ChannelFIFO>(op);
+    hasShiftRegisters |= isa<ChannelShiftRegister>(op);
+  });
+  if (hasStages)
+    esiBuilder.declareStage();
+  if (hasFIFOs)
+    esiBuilder.declareFIFO();
+  if (hasShiftRegisters)
+    esiBuilder.declareShiftRegister();
 
   // Set up a conversion and give it a set of laws.
   ConversionTarget pass1Target(*ctxt);
@@ -1213,20 +1746,28 @@ void ESItoHWPass::runOnOperation() {
   pass1Target.addLegalOp<CapnpDecode, CapnpEncode>();
 
   pass1Target.addIllegalOp<WrapSVInterface, UnwrapSVInterface>();
-  pass1Target.addIllegalOp<PipelineStage>();
+  pass1Target.addIllegalOp<PipelineStage, ChannelFIFO, ChannelShiftRegister>();
 
   // Add all the conversion patterns.
-  ESIHWBuilder esiBuilder(top);
   RewritePatternSet pass1Patterns(ctxt);
   pass1Patterns.insert<PipelineStageLowering>(esiBuilder, ctxt);
+  pass1Patterns.insert<ChannelFIFOLowering>(esiBuilder, ctxt);
+  pass1Patterns.insert<ChannelShiftRegisterLowering>(esiBuilder, ctxt);
   pass1Patterns.insert<WrapInterfaceLower>(ctxt);
   pass1Patterns.insert<UnwrapInterfaceLower>(ctxt);
-  pass1Patterns.insert<CosimLowering>(esiBuilder);
   pass1Patterns.insert<NullSourceOpLowering>(ctxt);
-
-  // Run the conversion.
-  if (failed(
-          applyPartialConversion(top, pass1Target, std::move(pass1Patterns))))
+  FrozenRewritePatternSet frozenPass1Patterns(std::move(pass1Patterns));
+
+  // Run the conversion. These patterns only rewrite the module they're in, so
+  // convert the modules in parallel.
+  SmallVector<HWModuleOp, 0> mods(top.getOps<HWModuleOp>());
+  std::atomic<bool> pass1Failed{false};
+  forEachInParallel(*ctxt, mods.size(), [&](size_t index) {
+    if (failed(applyPartialConversion(mods[index], pass1Target,
+                                      frozenPass1Patterns)))
+      pass1Failed = true;
+  });
+  if (pass1Failed)
     signalPassFailure();
 
   ConversionTarget pass2Target(*ctxt);
@@ -1238,7 +1779,7 @@ void ESItoHWPass::runOnOperation() {
   RewritePatternSet pass2Patterns(ctxt);
   pass2Patterns.insert<RemoveWrapUnwrap>(ctxt);
   pass2Patterns.insert<EncoderLowering>(ctxt);
-  pass2Patterns.insert<DecoderLowering>(ctxt);
+  pass2Patterns.insert<DecoderLowering>(ctxt, fixedCapnpLayout);
   if (failed(
           applyPartialConversion(top, pass2Target, std::move(pass2Patterns))))
     signalPassFailure();
@@ -1249,6 +1790,9 @@ namespace esi {
 std::unique_ptr<OperationPass<ModuleOp>> createESIPhysicalLoweringPass() {
   return std::make_unique<ESIToPhysicalPass>();
 }
+std::unique_ptr<OperationPass<ModuleOp>> createESIPackChannelsPass() {
+  return std::make_unique<ESIPackChannelsPass>();
+}
 std::unique_ptr<OperationPass<ModuleOp>> createESIPortLoweringPass() {
   return std::make_unique<ESIPortsPass>();
 }
@@ -71,9 +71,12 @@ public:
   /// Build an HW/SV dialect capnp encoder for this type.
   mlir::Value buildEncoder(mlir::OpBuilder &, mlir::Value clk,
                            mlir::Value valid, mlir::Value rawData) const;
-  /// Build an HW/SV dialect capnp decoder for this type.
+  /// Build an HW/SV dialect capnp decoder for this type. With `fixedLayout`,
+  /// the lists are read where the encoder puts them instead of being located
+  /// through their pointers, which avoids shifting the whole message.
   mlir::Value buildDecoder(mlir::OpBuilder &, mlir::Value clk,
-                           mlir::Value valid, mlir::Value capnpData) const;
+                           mlir::Value valid, mlir::Value capnpData,
+                           bool fixedLayout = false) const;
 
 private:
   /// The implementation of this. Separate to hide the details and avoid having
@@ -82,6 +85,7 @@ private:
 
   /// Cache of the decode/encode modules;
   static llvm::SmallDenseMap<Type, hw::HWModuleOp> decImplMods;
+  static llvm::SmallDenseMap<Type, hw::HWModuleOp> decFixedImplMods;
   static llvm::SmallDenseMap<Type, hw::HWModuleOp> encImplMods;
 };
 
@@ -11,6 +11,7 @@
 
 #include "ESICapnp.h"
 #include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/ESI/ESIDialect.h"
 #include "circt/Dialect/ESI/ESITypes.h"
 #include "circt/Dialect/HW/HWDialect.h"
 #include "circt/Dialect/HW/HWOps.h"
@@ -107,7 +108,7 @@ public:
   /// Build an HW/SV dialect capnp encoder for this type.
   hw::HWModuleOp buildEncoder(Value clk, Value valid, Value);
   /// Build an HW/SV dialect capnp decoder for this type.
-  hw::HWModuleOp buildDecoder(Value clk, Value valid, Value);
+  hw::HWModuleOp buildDecoder(Value clk, Value valid, Value, bool fixedLayout);
 
 private:
   ::capnp::ParsedSchema getSchema() const;
@@ -124,6 +125,8 @@ private:
   ::capnp::SchemaParser parser;
   mutable llvm::Optional<uint64_t> cachedID;
   mutable std::string cachedName;
+  mutable llvm::Optional<size_t> cachedSize;
+  mutable std::string cachedText;
   mutable ::capnp::ParsedSchema rootSchema;
   mutable ::capnp::StructSchema typeSchema;
 };
@@ -334,9 +337,12 @@ static int64_t size(capnp::schema::Node::Struct::Reader cStruct,
 
 // Compute the expected size of the capnp message in bits.
 size_t TypeSchemaImpl::size() const {
+  if (cachedSize)
+    return *cachedSize;
   auto schema = getTypeSchema();
   auto structProto = schema.getProto().getStruct();
-  return ::size(structProto, fieldTypes) * 64;
+  cachedSize = ::size(structProto, fieldTypes) * 64;
+  return *cachedSize;
 }
 
 /// Write a valid Capnp name for 'type'.
@@ -417,7 +423,12 @@ static void emitCapnpType(Type type, IndentingOStream &os) {
 /// This function is essentially a placeholder which only supports ints. It'll
 /// need to be re-worked when we start supporting structs, arrays, unions,
 /// enums, etc.
-LogicalResult TypeSchemaImpl::write(llvm::raw_ostream &rawOS) const {
+LogicalResult TypeSchemaImpl::write(llvm::raw_ostream &outOS) const {
+  if (!cachedText.empty()) {
+    outOS << cachedText;
+    return success();
+  }
+  llvm::raw_string_ostream rawOS(cachedText);
   IndentingOStream os(rawOS);
 
   // Since capnp requires messages to be structs, emit a wrapper struct.
@@ -441,6 +452,7 @@ LogicalResult TypeSchemaImpl::write(llvm::raw_ostream &rawOS) const {
 
   os.reduceIndent();
   os.indent() << "}\n\n";
+  outOS << rawOS.str();
   return success();
 }
 
@@ -998,10 +1010,13 @@ hw::HWModuleOp TypeSchemaImpl::buildEncoder(Value clk, Value valid,
 
 /// Construct the proper operations to decode a capnp list. This only works for
 /// arrays of ints or bools. Will need to be updated for structs and lists of
-/// lists.
+/// lists. If `fixedOffset` is set, the list is expected at that bit offset in
+/// the message instead of being located by its pointer, which saves shifting
+/// the whole message.
 static GasketComponent decodeList(hw::ArrayType type,
                                   capnp::schema::Field::Reader field,
-                                  Slice ptrSection, AssertBuilder &asserts) {
+                                  Slice ptrSection, AssertBuilder &asserts,
+                                  llvm::Optional<uint64_t> fixedOffset) {
   capnp::schema::Type::Reader capnpType = field.getSlot().getType();
   assert(capnpType.isList());
   assert(capnpType.getList().hasElementType());
@@ -1059,14 +1074,22 @@ static GasketComponent decodeList(hw::ArrayType type,
   auto msg = ptr.getRootSlice();
   auto ptrOffset = ptr.getOffsetFromRoot();
   assert(ptrOffset);
-  GasketComponent offsetInBits(
-      b, b.create<comb::ConcatOp>(loc, offset, gb.zero(6)));
-  GasketComponent listOffset(
-      b, b.create<comb::AddOp>(loc, offsetInBits,
-                               gb.constant(36, *ptrOffset + 64)));
-  listOffset.name(field.getName(), "_listOffset");
-  auto listSlice =
-      msg.slice(listOffset, type.getSize() * expectedElemSizeBits).name("list");
+  int64_t listBits = type.getSize() * expectedElemSizeBits;
+  Slice listSlice = [&]() {
+    if (fixedOffset) {
+      // The pointer offset is in words, from the end of the pointer.
+      asserts.assertEqual(offset, (*fixedOffset - *ptrOffset - 64) / 64);
+      return msg.slice(*fixedOffset, listBits);
+    }
+    GasketComponent offsetInBits(
+        b, b.create<comb::ConcatOp>(loc, offset, gb.zero(6)));
+    GasketComponent listOffset(
+        b, b.create<comb::AddOp>(loc, offsetInBits,
+                                 gb.constant(36, *ptrOffset + 64)));
+    listOffset.name(field.getName(), "_listOffset");
+    return msg.slice(listOffset, listBits);
+  }();
+  listSlice.name("list");
 
   // Cast to an array of capnp int elements.
   assert(type.getElementType().isa<IntegerType>() &&
@@ -1093,7 +1116,8 @@ static GasketComponent decodeList(hw::ArrayType type,
 static GasketComponent decodeField(Type type,
                                    capnp::schema::Field::Reader field,
                                    Slice dataSection, Slice ptrSection,
-                                   AssertBuilder &asserts) {
+                                   AssertBuilder &asserts,
+                                   llvm::Optional<uint64_t> fixedOffset) {
   GasketComponent esiValue =
       TypeSwitch<Type, GasketComponent>(type)
           .Case([&](IntegerType it) {
@@ -1103,16 +1127,19 @@ static GasketComponent decodeField(Type type,
             return slice.name(field.getName(), "_bits").cast(type);
           })
           .Case([&](hw::ArrayType at) {
-            return decodeList(at, field, ptrSection, asserts);
+            return decodeList(at, field, ptrSection, asserts, fixedOffset);
           });
   esiValue.name(field.getName().cStr(), "Value");
   return esiValue;
 }
 
 /// Build an HW/SV dialect capnp decoder module for this type. Outputs packed
-/// and unpadded data.
+/// and unpadded data. With `fixedLayout`, the lists are expected where the
+/// encoder puts them: after the root struct, in field order and at their full
+/// length.
 hw::HWModuleOp TypeSchemaImpl::buildDecoder(Value clk, Value valid,
-                                            Value operandVal) {
+                                            Value operandVal,
+                                            bool fixedLayout) {
   auto loc = operandVal.getDefiningOp()->getLoc();
   auto topMod = operandVal.getDefiningOp()->getParentOfType<ModuleOp>();
   OpBuilder b = OpBuilder::atBlockEnd(topMod.getBody());
@@ -1120,6 +1147,8 @@ hw::HWModuleOp TypeSchemaImpl::buildDecoder(Value clk, Value valid,
   SmallString<64> modName;
   modName.append("decode");
   modName.append(name());
+  if (fixedLayout)
+    modName.append("Fixed");
   SmallVector<hw::ModulePortInfo, 4> ports;
   ports.push_back(hw::ModulePortInfo{
       b.getStringAttr("clk"), hw::PortDirection::INPUT, clk.getType(), 0});
@@ -1187,13 +1216,22 @@ hw::HWModuleOp TypeSchemaImpl::buildDecoder(Value clk, Value valid,
                                rootProto.getStruct().getPointerCount() * 64)
                         .name("ptrSection");
 
-  // Loop through fields.
+  // Loop through fields. In the fixed layout, the lists are allocated after
+  // the root struct in field order, as CapnpSegmentBuilder does.
   SmallVector<GasketComponent, 64> fieldValues;
+  uint64_t nextListOffset = 64 * (1 + st.getDataWordCount() +
+                                  st.getPointerCount());
   for (auto field : st.getFields()) {
     uint16_t idx = field.getCodeOrder();
     assert(idx < fieldTypes.size() && "Capnp struct longer than fieldTypes.");
+    llvm::Optional<uint64_t> fixedOffset;
+    if (auto arrTy = fieldTypes[idx].type.dyn_cast<hw::ArrayType>()) {
+      if (fixedLayout)
+        fixedOffset = nextListOffset;
+      nextListOffset += ::size(arrTy, field) * 64;
+    }
     fieldValues.push_back(decodeField(fieldTypes[idx].type, field, dataSection,
-                                      ptrSection, asserts));
+                                      ptrSection, asserts, fixedOffset));
   }
 
   // What to return depends on the type. (e.g. structs have to be constructed
@@ -1223,14 +1261,40 @@ hw::HWModuleOp TypeSchemaImpl::buildDecoder(Value clk, Value valid,
 
 llvm::SmallDenseMap<Type, hw::HWModuleOp>
     circt::esi::capnp::TypeSchema::decImplMods;
+llvm::SmallDenseMap<Type, hw::HWModuleOp>
+    circt::esi::capnp::TypeSchema::decFixedImplMods;
 llvm::SmallDenseMap<Type, hw::HWModuleOp>
     circt::esi::capnp::TypeSchema::encImplMods;
 
+namespace {
+/// The schemas of a context, shared by all the `TypeSchema`s of a type so that
+/// each schema is parsed, hashed and printed only once. Like the encoder and
+/// decoder module caches, this is not thread safe.
+struct SchemaCache {
+  llvm::DenseMap<Type, std::shared_ptr<TypeSchemaImpl>> schemas;
+};
+} // anonymous namespace
+
 circt::esi::capnp::TypeSchema::TypeSchema(Type type) {
   circt::esi::ChannelPort chan = type.dyn_cast<circt::esi::ChannelPort>();
   if (chan) // Unwrap the channel if it's a channel.
     type = chan.getInner();
-  s = std::make_shared<detail::TypeSchemaImpl>(type);
+
+  // The dialect can't be loaded from here since this may run in a pass, so
+  // types of contexts without it don't share their schemas.
+  auto *dialect = type.getContext()->getLoadedDialect<esi::ESIDialect>();
+  if (!dialect) {
+    s = std::make_shared<detail::TypeSchemaImpl>(type);
+    return;
+  }
+
+  if (!dialect->capnpSchemaCache)
+    dialect->capnpSchemaCache = std::make_shared<SchemaCache>();
+  auto &cache = *static_cast<SchemaCache *>(dialect->capnpSchemaCache.get());
+  auto &schema = cache.schemas[type];
+  if (!schema)
+    schema = std::make_shared<detail::TypeSchemaImpl>(type);
+  s = schema;
 }
 Type circt::esi::capnp::TypeSchema::getType() const { return s->getType(); }
 uint64_t circt::esi::capnp::TypeSchema::capnpTypeID() const {
@@ -1275,13 +1339,14 @@ Value circt::esi::capnp::TypeSchema::buildEncoder(OpBuilder &builder, Value clk,
 }
 
 Value circt::esi::capnp::TypeSchema::buildDecoder(OpBuilder &builder, Value clk,
-                                                  Value valid,
-                                                  Value operand) const {
+                                                  Value valid, Value operand,
+                                                  bool fixedLayout) const {
+  auto &implMods = fixedLayout ? decFixedImplMods : decImplMods;
   hw::HWModuleOp decImplMod;
-  auto decImplIT = decImplMods.find(getType());
-  if (decImplIT == decImplMods.end()) {
-    decImplMod = s->buildDecoder(clk, valid, operand);
-    decImplMods[getType()] = decImplMod;
+  auto decImplIT = implMods.find(getType());
+  if (decImplIT == implMods.end()) {
+    decImplMod = s->buildDecoder(clk, valid, operand, fixedLayout);
+    implMods[getType()] = decImplMod;
   } else {
     decImplMod = decImplIT->second;
   }
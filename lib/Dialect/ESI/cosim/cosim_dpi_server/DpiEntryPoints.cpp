@@ -17,17 +17,25 @@
 //===----------------------------------------------------------------------===//
 
 #include "circt/Dialect/ESI/cosim/Server.h"
+#include "circt/Dialect/ESI/cosim/TransactionLog.h"
 #include "circt/Dialect/ESI/cosim/dpi.h"
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 using namespace circt::esi::cosim;
 
 /// If non-null, log to this file. Protected by 'serverMutex`.
 static FILE *logFile;
 static RpcServer *server = nullptr;
+/// If non-null, serves the endpoints of 'server' in place of its RPC server.
+static ShmServer *shmServer = nullptr;
 static std::mutex serverMutex;
+/// If non-null, the messages of the endpoints are recorded to this log.
+static TransactionRecorder *recorder = nullptr;
+/// If non-null, plays the host from a recorded log, in place of any server.
+static TransactionReplayer *replayer = nullptr;
 
 // ---- Helper functions ----
 
@@ -52,6 +60,35 @@ static void log(int epId, bool toClient, Endpoint::BlobPtr msg) {
   fprintf(logFile, "\n");
 }
 
+/// Log and record a message the simulation received from the host.
+static void receivedFromHost(int epId, Endpoint *ep, Endpoint::BlobPtr msg) {
+  log(epId, false, msg);
+  if (recorder)
+    recorder->record(epId, false, ep->simPolls, *msg);
+}
+
+/// Queue, log and record a message from the simulation to the host. When
+/// replaying, check it against the log instead, and hand the blob right back
+/// in place of the client. Return false if the queue is full, in which case
+/// the message is dropped and neither logged nor recorded.
+static bool sendToHost(int epId, Endpoint *ep, Endpoint::BlobPtr msg) {
+  if (replayer) {
+    log(epId, true, msg);
+    replayer->check(epId, *msg);
+    ep->freeMessageToClient(std::move(msg));
+    return true;
+  }
+  // Keep a reference to the message, which the client may already be reading
+  // once it is queued.
+  Endpoint::BlobPtr queued = msg;
+  if (!ep->pushMessageToClient(std::move(msg)))
+    return false;
+  log(epId, true, queued);
+  if (recorder)
+    recorder->record(epId, true, ep->simPolls, *queued);
+  return true;
+}
+
 /// Get the TCP port on which to listen. If the port isn't specified via an
 /// environment variable, return 0 to allow automatic selection.
 static int findPort() {
@@ -64,6 +101,18 @@ static int findPort() {
   return std::strtoull(portEnv, nullptr, 10);
 }
 
+/// Get the number of RPC server threads the endpoints are partitioned over,
+/// one unless specified via an environment variable.
+static unsigned findNumThreads() {
+  const char *threadsEnv = getenv("COSIM_RPC_THREADS");
+  if (threadsEnv == nullptr)
+    return 1;
+  unsigned numThreads = std::max(1UL, std::strtoul(threadsEnv, nullptr, 10));
+  printf("[COSIM] Partitioning the endpoints over %u RPC server threads\n",
+         numThreads);
+  return numThreads;
+}
+
 /// Check that an array is an array of bytes and has some size.
 // NOLINTNEXTLINE(misc-misplaced-const)
 static int validateSvOpenArray(const svOpenArrayHandle data,
@@ -130,6 +179,10 @@ DPI int sv2cCosimserverEpTryGet(unsigned int endpointId,
     return -4;
   }
 
+  ++ep->simPolls;
+  if (replayer)
+    replayer->feed(endpointId, *ep);
+
   Endpoint::BlobPtr msg;
   // Poll for a message.
   if (!ep->getMessageToSim(msg)) {
@@ -141,20 +194,24 @@ DPI int sv2cCosimserverEpTryGet(unsigned int endpointId,
   // simulator is going to poll up to every tick and there's not going to be
   // a message most of the time, this is important for performance.
 
-  log(endpointId, false, msg);
+  receivedFromHost(endpointId, ep, msg);
 
-  if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
-    printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
-           __LINE__);
-    return -2;
+  // The array layout only needs to be validated on the first message.
+  if (ep->simRecvArraySize < 0) {
+    if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
+      printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
+             __LINE__);
+      return -2;
+    }
+    ep->simRecvArraySize = svSizeOfArray(data);
   }
 
   // Detect or verify size of buffer.
   if (*dataSize == ~0u) {
-    *dataSize = svSizeOfArray(data);
-  } else if (*dataSize > (unsigned)svSizeOfArray(data)) {
+    *dataSize = ep->simRecvArraySize;
+  } else if (*dataSize > (unsigned)ep->simRecvArraySize) {
     printf("ERROR: DPI-func=%s line %d event=invalid-size (max %d)\n", __func__,
-           __LINE__, (unsigned)svSizeOfArray(data));
+           __LINE__, (unsigned)ep->simRecvArraySize);
     return -3;
   }
   // Verify it'll fit.
@@ -164,23 +221,19 @@ DPI int sv2cCosimserverEpTryGet(unsigned int endpointId,
     return -5;
   }
 
-  // Copy the message data.
-  size_t i;
-  for (i = 0; i < msgSize; ++i) {
-    auto b = (*msg)[i];
-    *(char *)svGetArrElemPtr1(data, i) = b;
-  }
-  // Zero out the rest of the buffer.
-  for (; i < *dataSize; ++i) {
-    *(char *)svGetArrElemPtr1(data, i) = 0;
-  }
+  // Copy the message data, which has C layout, and zero out the rest of the
+  // buffer.
+  char *buffer = (char *)svGetArrayPtr(data);
+  memcpy(buffer, msg->data(), msgSize);
+  memset(buffer + msgSize, 0, *dataSize - msgSize);
+  ep->freeMessageToSim(std::move(msg));
   // Set the output data size.
-  *dataSize = msg->size();
+  *dataSize = msgSize;
   return 0;
 }
 
 // Attempt to send data to a client.
-// - return 0 on success, negative on failure (unregistered EP).
+// - return 0 on success, negative on failure (unregistered EP, full queue).
 // - if dataSize is negative, attempt to dynamically determine the size of
 //   'data'.
 DPI int sv2cCosimserverEpTryPut(unsigned int endpointId,
@@ -189,34 +242,147 @@ DPI int sv2cCosimserverEpTryPut(unsigned int endpointId,
   if (server == nullptr)
     return -1;
 
-  if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
-    printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
-           __LINE__);
-    return -2;
+  Endpoint *ep = server->endpoints[endpointId];
+  if (!ep) {
+    fprintf(stderr, "Endpoint not found in registry!\n");
+    return -4;
+  }
+
+  // The array layout only needs to be validated on the first message.
+  if (ep->simSendArraySize < 0) {
+    if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
+      printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
+             __LINE__);
+      return -2;
+    }
+    ep->simSendArraySize = svSizeOfArray(data);
   }
 
   // Detect or verify size.
   if (dataSize < 0) {
-    dataSize = svSizeOfArray(data);
-  } else if (dataSize > svSizeOfArray(data)) { // not enough data
+    dataSize = ep->simSendArraySize;
+  } else if (dataSize > ep->simSendArraySize) { // not enough data
     printf("ERROR: DPI-func=%s line %d event=invalid-size limit %d array %d\n",
-           __func__, __LINE__, dataSize, svSizeOfArray(data));
+           __func__, __LINE__, dataSize, ep->simSendArraySize);
     return -3;
   }
 
-  Endpoint::BlobPtr blob = std::make_shared<Endpoint::Blob>(dataSize);
-  // Copy the message data into 'blob'.
-  for (int i = 0; i < dataSize; ++i) {
-    (*blob)[i] = *(char *)svGetArrElemPtr1(data, i);
+  // Copy the message data, which has C layout, into a recycled blob and
+  // queue it.
+  Endpoint::BlobPtr blob = ep->allocMessageToClient(dataSize);
+  memcpy(blob->data(), svGetArrayPtr(data), dataSize);
+  if (!sendToHost(endpointId, ep, std::move(blob))) {
+    fprintf(stderr, "Endpoint queue to the client is full!\n");
+    return -5;
+  }
+  return 0;
+}
+
+// Attempt to recieve up to '*numMsgs' messages from a client in one call.
+//   - Returns negative when call failed (e.g. EP not registered).
+//   - The messages are put into consecutive 'msgSize' byte slots of 'data',
+//     zero padded. '*numMsgs' is set to the number of messages received, 0 if
+//     there was none.
+DPI int sv2cCosimserverEpTryGetBatch(unsigned int endpointId,
+                                     // NOLINTNEXTLINE(misc-misplaced-const)
+                                     const svOpenArrayHandle data,
+                                     unsigned int msgSize,
+                                     unsigned int *numMsgs) {
+  if (server == nullptr)
+    return -1;
+
+  Endpoint *ep = server->endpoints[endpointId];
+  if (!ep) {
+    fprintf(stderr, "Endpoint not found in registry!\n");
+    return -4;
+  }
+
+  ++ep->simPolls;
+  if (replayer)
+    replayer->feed(endpointId, *ep);
+
+  unsigned int maxMsgs = *numMsgs;
+  *numMsgs = 0;
+  Endpoint::BlobPtr msg;
+  // Poll for a message, as cheaply as possible.
+  if (!ep->getMessageToSim(msg))
+    return 0;
+
+  // The array layout only needs to be validated on the first message.
+  if (ep->simRecvArraySize < 0) {
+    if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
+      printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
+             __LINE__);
+      return -2;
+    }
+    ep->simRecvArraySize = svSizeOfArray(data);
+  }
+  if (msgSize == 0 ||
+      (unsigned long long)maxMsgs * msgSize > (unsigned)ep->simRecvArraySize) {
+    printf("ERROR: DPI-func=%s line %d event=invalid-size (max %d)\n", __func__,
+           __LINE__, (unsigned)ep->simRecvArraySize);
+    return -3;
   }
-  // Queue the blob.
+
+  char *buffer = (char *)svGetArrayPtr(data);
+  do {
+    receivedFromHost(endpointId, ep, msg);
+    size_t size = msg->size();
+    if (size > msgSize) {
+      printf("ERROR: Message size too big to fit in HW buffer\n");
+      return -5;
+    }
+    memcpy(buffer, msg->data(), size);
+    memset(buffer + size, 0, msgSize - size);
+    buffer += msgSize;
+    ep->freeMessageToSim(std::move(msg));
+    ++*numMsgs;
+  } while (*numMsgs < maxMsgs && ep->getMessageToSim(msg));
+  return 0;
+}
+
+// Attempt to send 'numMsgs' messages to a client in one call, taken from
+// consecutive 'msgSize' byte slots of 'data'.
+// - return 0 on success, negative on failure (unregistered EP, full queue).
+DPI int sv2cCosimserverEpTryPutBatch(unsigned int endpointId,
+                                     // NOLINTNEXTLINE(misc-misplaced-const)
+                                     const svOpenArrayHandle data, int msgSize,
+                                     int numMsgs) {
+  if (server == nullptr)
+    return -1;
+
   Endpoint *ep = server->endpoints[endpointId];
   if (!ep) {
     fprintf(stderr, "Endpoint not found in registry!\n");
     return -4;
   }
-  log(endpointId, true, blob);
-  ep->pushMessageToClient(blob);
+
+  // The array layout only needs to be validated on the first message.
+  if (ep->simSendArraySize < 0) {
+    if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
+      printf("ERROR: DPI-func=%s line=%d event=invalid-sv-array\n", __func__,
+             __LINE__);
+      return -2;
+    }
+    ep->simSendArraySize = svSizeOfArray(data);
+  }
+  if (msgSize <= 0 || numMsgs < 0 ||
+      (long long)msgSize * numMsgs > ep->simSendArraySize) {
+    printf("ERROR: DPI-func=%s line %d event=invalid-size limit %d x %d array "
+           "%d\n",
+           __func__, __LINE__, numMsgs, msgSize, ep->simSendArraySize);
+    return -3;
+  }
+
+  const char *buffer = (const char *)svGetArrayPtr(data);
+  for (int i = 0; i < numMsgs; ++i, buffer += msgSize) {
+    Endpoint::BlobPtr blob = ep->allocMessageToClient(msgSize);
+    memcpy(blob->data(), buffer, msgSize);
+    if (!sendToHost(endpointId, ep, std::move(blob))) {
+      fprintf(stderr, "Endpoint queue to the client is full!\n");
+      return -5;
+    }
+  }
   return 0;
 }
 
@@ -226,9 +392,21 @@ DPI void sv2cCosimserverFinish() {
   std::lock_guard<std::mutex> g(serverMutex);
   printf("[cosim] Tearing down RPC server.\n");
   if (server != nullptr) {
-    server->stop();
+    if (replayer != nullptr) {
+      replayer->report();
+      delete replayer;
+      replayer = nullptr;
+    } else if (shmServer != nullptr) {
+      shmServer->stop();
+      shmServer = nullptr;
+    } else {
+      server->stop();
+    }
     server = nullptr;
 
+    delete recorder;
+    recorder = nullptr;
+
     fclose(logFile);
     logFile = nullptr;
   }
@@ -246,10 +424,39 @@ DPI int sv2cCosimserverInit() {
       logFile = fopen(logFN, "w");
     }
 
+    server = new RpcServer();
+    // Record the messages of the session if requested.
+    const char *recordPath = getenv("COSIM_RECORD");
+    if (recordPath != nullptr) {
+      printf("[cosim] Recording transactions to: %s\n", recordPath);
+      recorder = new TransactionRecorder();
+      if (!recorder->open(recordPath))
+        return -1;
+    }
+
+    // Replay a recorded session, with no server at all, if requested.
+    const char *replayPath = getenv("COSIM_REPLAY");
+    if (replayPath != nullptr) {
+      printf("[cosim] Replaying transactions from: %s\n", replayPath);
+      replayer = new TransactionReplayer();
+      if (!replayer->load(replayPath))
+        return -1;
+      return 0;
+    }
+
+    // Serve clients on the same machine through shared memory if requested.
+    const char *shmPath = getenv("COSIM_SHM");
+    if (shmPath != nullptr) {
+      printf("[cosim] Starting shared memory server.\n");
+      shmServer = new ShmServer(server->endpoints);
+      if (!shmServer->run(shmPath))
+        return -1;
+      return 0;
+    }
+
     // Find the port and run.
     printf("[cosim] Starting RPC server.\n");
-    server = new RpcServer();
-    server->run(findPort());
+    server->run(findPort(), findNumThreads());
   }
   return 0;
 }
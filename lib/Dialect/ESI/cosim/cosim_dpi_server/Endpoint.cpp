@@ -34,6 +34,11 @@ void Endpoint::returnForUse() {
   inUse = false;
 }
 
+EndpointRegistry::EndpointRegistry() {
+  denseTables.push_back(std::make_unique<std::vector<Endpoint *>>());
+  dense = denseTables.back().get();
+}
+
 bool EndpointRegistry::registerEndpoint(int epId, uint64_t sendTypeId,
                                         int sendTypeMaxSize,
                                         uint64_t recvTypeId,
@@ -45,12 +50,24 @@ bool EndpointRegistry::registerEndpoint(int epId, uint64_t sendTypeId,
   }
   // The following ugliness adds an Endpoint to the map of Endpoints. The
   // Endpoint class has its copy constructor deleted, thus the metaprogramming.
-  endpoints.emplace(std::piecewise_construct,
-                    // Map key.
-                    std::forward_as_tuple(epId),
-                    // Endpoint constructor args.
-                    std::forward_as_tuple(sendTypeId, sendTypeMaxSize,
-                                          recvTypeId, recvTypeMaxSize));
+  auto it = endpoints.emplace(std::piecewise_construct,
+                              // Map key.
+                              std::forward_as_tuple(epId),
+                              // Endpoint constructor args.
+                              std::forward_as_tuple(sendTypeId, sendTypeMaxSize,
+                                                    recvTypeId,
+                                                    recvTypeMaxSize));
+
+  // Publish an extended copy of the dense table. The map nodes never move, so
+  // the table can point into it.
+  if (epId >= 0 && epId < denseIdLimit) {
+    auto table = std::make_unique<std::vector<Endpoint *>>(*dense.load());
+    if (table->size() <= (size_t)epId)
+      table->resize(epId + 1, nullptr);
+    (*table)[epId] = &it.first->second;
+    dense.store(table.get(), std::memory_order_release);
+    denseTables.push_back(std::move(table));
+  }
   return true;
 }
 
@@ -15,11 +15,20 @@
 // A [capnp encoded message](https://capnproto.org/encoding.html) can have
 // multiple 'segments', which is a pain to deal with. (See comments below.)
 //
+// The shared memory server serves the same endpoints through rings in a
+// memory mapped file, for clients on the same machine.
+//
 //===----------------------------------------------------------------------===//
 
 #include "circt/Dialect/ESI/cosim/Server.h"
 #include "circt/Dialect/ESI/cosim/CosimDpi.capnp.h"
+#include "circt/Dialect/ESI/cosim/ShmTransport.h"
+#include <algorithm>
 #include <capnp/ez-rpc.h>
+#include <capnp/serialize.h>
+#include <fcntl.h>
+#include <set>
+#include <sys/mman.h>
 #include <thread>
 #include <unistd.h>
 
@@ -51,15 +60,23 @@ public:
   kj::Promise<void> send(SendContext) override;
   kj::Promise<void> recv(RecvContext) override;
   kj::Promise<void> close(CloseContext) override;
+  kj::Promise<void> sendBatch(SendBatchContext) override;
+  kj::Promise<void> recvBatch(RecvBatchContext) override;
 };
 
-/// Implements the `CosimDpiServer` interface from the RPC schema.
+/// Implements the `CosimDpiServer` interface from the RPC schema, for the
+/// endpoints of one of the server threads.
 class CosimServer final : public CosimDpiServer::Server {
   /// The registry of endpoints. The RpcServer class owns this.
   EndpointRegistry &reg;
+  /// This server serves the endpoints whose ID is `thread` modulo
+  /// `numThreads`.
+  unsigned thread, numThreads;
+
+  bool serves(int id) const { return (unsigned)id % numThreads == thread; }
 
 public:
-  CosimServer(EndpointRegistry &reg);
+  CosimServer(EndpointRegistry &reg, unsigned thread, unsigned numThreads);
 
   /// List all the registered interfaces.
   kj::Promise<void> list(ListContext ctxt) override;
@@ -101,35 +118,95 @@ kj::Promise<void> EndpointServer::recv(RecvContext context) {
     // Create an object which will read the segments into a message on send.
     std::unique_ptr<SegmentArrayMessageReader> msgReader =
         std::make_unique<SegmentArrayMessageReader>(segments);
-    // Send.
+    // Send. The response holds a copy, so the blob can be reused.
     context.getResults().getResp().set(msgReader->getRoot<AnyPointer>());
+    endpoint.freeMessageToClient(std::move(blob));
   }
   return kj::READY_NOW;
 }
 
+/// Copy a message to the simulation into a flat, single segment buffer, which
+/// also holds the root pointer. The message is copied straight into a recycled
+/// blob, which the message builder uses as its single segment. The blob comes
+/// zeroed, as the builder requires.
+static Endpoint::BlobPtr copyMessageToSim(Endpoint &endpoint,
+                                          AnyPointer::Reader capnpMsgPointer) {
+  KJ_REQUIRE(capnpMsgPointer.isStruct(),
+             "Only messages can go in the 'msg' parameter");
+  auto msgSize = capnpMsgPointer.targetSize();
+  size_t segmentWords = msgSize.wordCount + 1;
+  auto blob = endpoint.allocMessageToSim(segmentWords * sizeof(word));
+  kj::ArrayPtr<word> segment((word *)blob->data(), segmentWords);
+  MallocMessageBuilder builder(segment, AllocationStrategy::FIXED_SIZE);
+  builder.setRoot(capnpMsgPointer);
+  auto segments = builder.getSegmentsForOutput();
+  KJ_ASSERT(segments.size() == 1 && segments[0].begin() == segment.begin());
+  blob->resize(segments[0].asBytes().size());
+  return blob;
+}
+
 /// 'Send' is from the client perspective, so this is a message we are
-/// recieving. The only way I could figure out to copy the raw message is a
-/// double copy. I was have issues getting libkj's arrays to play nice with
-/// others.
+/// recieving.
 kj::Promise<void> EndpointServer::send(SendContext context) {
   KJ_REQUIRE(open, "EndPoint closed already");
-  auto capnpMsgPointer = context.getParams().getMsg();
-  KJ_REQUIRE(capnpMsgPointer.isStruct(),
-             "Only messages can go in the 'msg' parameter");
+  auto blob = copyMessageToSim(endpoint, context.getParams().getMsg());
 
-  // Copy the incoming message into a flat, single segment buffer.
-  auto msgSize = capnpMsgPointer.targetSize();
-  auto builder = std::make_unique<MallocMessageBuilder>(
-      msgSize.wordCount + 1, AllocationStrategy::FIXED_SIZE);
-  builder->setRoot(capnpMsgPointer);
-  auto segments = builder->getSegmentsForOutput();
-  KJ_ASSERT(segments.size() == 1);
-
-  // Now copy it into a blob and queue it.
-  auto fstSegmentData = segments[0].asBytes();
-  auto blob = std::make_shared<Endpoint::Blob>(fstSegmentData.begin(),
-                                               fstSegmentData.end());
-  endpoint.pushMessageToSim(blob);
+  // Queue the blob.
+  KJ_REQUIRE(endpoint.pushMessageToSim(std::move(blob)),
+             "Endpoint queue to the simulation is full");
+  return kj::READY_NOW;
+}
+
+/// Queue several messages to the simulation, for clients to not pay a round
+/// trip per message. Stop at the first one which doesn't fit in the queue.
+kj::Promise<void> EndpointServer::sendBatch(SendBatchContext context) {
+  KJ_REQUIRE(open, "EndPoint closed already");
+  uint32_t accepted = 0;
+  for (auto msg : context.getParams().getMsgs()) {
+    KJ_REQUIRE(msg.size() % sizeof(word) == 0,
+               "Message was malformed. Size of message was not a multiple of "
+               "8 bytes.");
+    FlatArrayMessageReader reader(kj::ArrayPtr<const word>(
+        (const word *)msg.begin(), msg.size() / sizeof(word)));
+    auto blob = copyMessageToSim(endpoint, reader.getRoot<AnyPointer>());
+    if (!endpoint.pushMessageToSim(std::move(blob)))
+      break;
+    ++accepted;
+  }
+  context.getResults().setAccepted(accepted);
+  return kj::READY_NOW;
+}
+
+/// Pop up to 'max' messages to the client. The blobs are single segment
+/// messages already, so they are copied as they are.
+kj::Promise<void> EndpointServer::recvBatch(RecvBatchContext context) {
+  KJ_REQUIRE(open, "EndPoint closed already");
+  // The size of the list has to be known before it is built. Each message is
+  // checked before it is popped, and the batch stops before a malformed one,
+  // so that no message is lost if the check fails.
+  std::vector<Endpoint::BlobPtr> blobs;
+  Endpoint::BlobPtr blob;
+  uint32_t max = context.getParams().getMax();
+  while (blobs.size() < max) {
+    Endpoint::BlobPtr *next = endpoint.peekMessageToClient();
+    if (!next)
+      break;
+    if ((*next)->size() % 8 != 0) {
+      KJ_REQUIRE(!blobs.empty(),
+                 "Response msg was malformed. Size of response was not a "
+                 "multiple of 8 bytes.");
+      break;
+    }
+    endpoint.getMessageToClient(blob);
+    blobs.push_back(std::move(blob));
+  }
+
+  auto resps = context.getResults().initResps(blobs.size());
+  for (size_t i = 0, e = blobs.size(); i < e; ++i) {
+    auto data = resps.init(i, blobs[i]->size());
+    memcpy(data.begin(), blobs[i]->data(), blobs[i]->size());
+    endpoint.freeMessageToClient(std::move(blobs[i]));
+  }
   return kj::READY_NOW;
 }
 
@@ -142,22 +219,31 @@ kj::Promise<void> EndpointServer::close(CloseContext context) {
 
 /// ----- CosimServer definitions.
 
-CosimServer::CosimServer(EndpointRegistry &reg) : reg(reg) {}
+CosimServer::CosimServer(EndpointRegistry &reg, unsigned thread,
+                         unsigned numThreads)
+    : reg(reg), thread(thread), numThreads(numThreads) {}
 
 kj::Promise<void> CosimServer::list(ListContext context) {
-  auto ifaces = context.getResults().initIfaces((unsigned int)reg.size());
-  unsigned int ctr = 0u;
+  // The size of the list has to be known before it is built, and endpoints
+  // may register in between two iterations.
+  std::vector<std::pair<int, const Endpoint *>> served;
   reg.iterateEndpoints([&](int id, const Endpoint &ep) {
-    ifaces[ctr].setEndpointID(id);
-    ifaces[ctr].setSendTypeID(ep.getSendTypeId());
-    ifaces[ctr].setRecvTypeID(ep.getRecvTypeId());
-    ++ctr;
+    if (serves(id))
+      served.emplace_back(id, &ep);
   });
+  auto ifaces = context.getResults().initIfaces((unsigned int)served.size());
+  for (unsigned int i = 0, e = served.size(); i < e; ++i) {
+    ifaces[i].setEndpointID(served[i].first);
+    ifaces[i].setSendTypeID(served[i].second->getSendTypeId());
+    ifaces[i].setRecvTypeID(served[i].second->getRecvTypeId());
+  }
   return kj::READY_NOW;
 }
 
 kj::Promise<void> CosimServer::open(OpenContext ctxt) {
-  Endpoint *ep = reg[ctxt.getParams().getIface().getEndpointID()];
+  int id = ctxt.getParams().getIface().getEndpointID();
+  KJ_REQUIRE(serves(id), "Endpoint served on another port");
+  Endpoint *ep = reg[id];
   KJ_REQUIRE(ep != nullptr, "Could not find endpoint");
 
   auto gotLock = ep->setInUse();
@@ -170,29 +256,49 @@ kj::Promise<void> CosimServer::open(OpenContext ctxt) {
 
 /// ----- RpcServer definitions.
 
-RpcServer::RpcServer() : mainThread(nullptr), stopSig(false) {}
+RpcServer::RpcServer() : numPortsKnown(0), stopSig(false) {}
 RpcServer::~RpcServer() { stop(); }
 
-/// Write the port number to a file. Necessary when we allow 'EzRpcServer' to
-/// select its own port. We can't use stdout/stderr because the flushing
-/// semantics are undefined (as in `flush()` doesn't work on all simulators).
-static void writePort(uint16_t port) {
+/// Write the port numbers to a file, one line per server thread in thread
+/// order. Necessary when we allow 'EzRpcServer' to select its own port. We
+/// can't use stdout/stderr because the flushing semantics are undefined (as in
+/// `flush()` doesn't work on all simulators).
+static void writePorts(const std::vector<uint16_t> &ports) {
   // "cosim.cfg" since we may want to include other info in the future.
   FILE *fd = fopen("cosim.cfg", "w");
-  fprintf(fd, "port: %u\n", (unsigned int)port);
+  for (uint16_t port : ports)
+    fprintf(fd, "port: %u\n", (unsigned int)port);
   fclose(fd);
 }
 
-void RpcServer::mainLoop(uint16_t port) {
-  capnp::EzRpcServer rpcServer(kj::heap<CosimServer>(endpoints),
-                               /* bindAddress */ "*", port);
+/// Write the path of the memory mapped file to the same file, so that clients
+/// find it the same way.
+static void writeShmPath(const std::string &path) {
+  FILE *fd = fopen("cosim.cfg", "w");
+  fprintf(fd, "shm: %s\n", path.c_str());
+  fclose(fd);
+}
+
+/// Clients only find the ports in cosim.cfg once all the threads listen.
+void RpcServer::publishPort(unsigned thread, uint16_t port) {
+  Lock g(portsMutex);
+  ports[thread] = port;
+  if (++numPortsKnown == ports.size())
+    writePorts(ports);
+}
+
+void RpcServer::mainLoop(uint16_t port, unsigned thread,
+                         unsigned numThreads) {
+  capnp::EzRpcServer rpcServer(
+      kj::heap<CosimServer>(endpoints, thread, numThreads),
+      /* bindAddress */ "*", port);
   auto &waitScope = rpcServer.getWaitScope();
   // If port is 0, ExRpcSever selects one and we have to wait to get the port.
   if (port == 0) {
     auto portPromise = rpcServer.getPort();
     port = portPromise.wait(waitScope);
   }
-  writePort(port);
+  publishPort(thread, port);
   printf("[COSIM] Listening on port: %u\n", (unsigned int)port);
 
   // OK, this is uber hacky, but it unblocks me and isn't _too_ inefficient. The
@@ -212,22 +318,213 @@ void RpcServer::mainLoop(uint16_t port) {
 }
 
 /// Start the server if not already started.
-void RpcServer::run(uint16_t port) {
+void RpcServer::run(uint16_t port, unsigned numThreads) {
   Lock g(m);
-  if (mainThread == nullptr) {
-    mainThread = new std::thread(&RpcServer::mainLoop, this, port);
-  } else {
+  if (!threads.empty()) {
     fprintf(stderr, "Warning: cannot Run() RPC server more than once!");
+    return;
   }
+  numThreads = std::max(numThreads, 1U);
+  ports.assign(numThreads, 0);
+  for (unsigned i = 0; i < numThreads; ++i)
+    threads.emplace_back(&RpcServer::mainLoop, this,
+                         port ? uint16_t(port + i) : uint16_t(0), i,
+                         numThreads);
 }
 
-/// Signal the RPC server thread to stop. Wait for it to exit.
+/// Signal the RPC server threads to stop. Wait for them to exit.
 void RpcServer::stop() {
   Lock g(m);
-  if (mainThread == nullptr) {
+  if (threads.empty()) {
     fprintf(stderr, "RpcServer not Run()\n");
+  } else if (!stopSig) {
+    stopSig = true;
+    for (auto &thread : threads)
+      thread.join();
+  }
+}
+
+/// ----- ShmServer definitions.
+
+namespace {
+/// The state the shared memory server thread keeps for each endpoint slot.
+struct ShmEndpoint {
+  Endpoint *endpoint;
+  shm::EndpointSlot *slot;
+  bool open = false;
+  /// Messages which didn't fit in the endpoint queue or the ring yet.
+  Endpoint::BlobPtr toSim;
+  Endpoint::BlobPtr toClient;
+};
+} // anonymous namespace
+
+ShmServer::ShmServer(EndpointRegistry &endpoints)
+    : endpoints(endpoints), region(nullptr), mainThread(nullptr),
+      stopSig(false) {}
+ShmServer::~ShmServer() { stop(); }
+
+/// Move the messages of one endpoint between its rings and its queues. Return
+/// true if any message moved.
+static bool serviceEndpoint(ShmEndpoint &ep, std::vector<uint64_t> &words) {
+  shm::EndpointSlot &slot = *ep.slot;
+  bool open = slot.open.load(std::memory_order_acquire);
+  if (open != ep.open) {
+    ep.open = open;
+    if (open)
+      ep.endpoint->setInUse();
+    else
+      ep.endpoint->returnForUse();
+  }
+  if (!open)
+    return false;
+
+  bool moved = false;
+  while (true) {
+    if (!ep.toSim) {
+      if (!slot.toSim.read(words))
+        break;
+      // The client writes flat capnp messages, which must be copied into a
+      // single segment.
+      KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() {
+                    FlatArrayMessageReader reader(kj::ArrayPtr<const word>(
+                        (const word *)words.data(), words.size()));
+                    ep.toSim = copyMessageToSim(*ep.endpoint,
+                                                reader.getRoot<AnyPointer>());
+                  })) {
+        fprintf(stderr, "[COSIM] Dropping malformed message to endpoint %d: "
+                        "%s\n",
+                slot.endpointId, e->getDescription().cStr());
+        continue;
+      }
+    }
+    // Pushing a full queue drops the message it was given, so give it a copy
+    // of the pointer.
+    if (!ep.endpoint->pushMessageToSim(ep.toSim))
+      break;
+    ep.toSim = nullptr;
+    moved = true;
+  }
+
+  while (true) {
+    if (!ep.toClient && !ep.endpoint->getMessageToClient(ep.toClient))
+      break;
+    size_t size = ep.toClient->size();
+    if (size % sizeof(word) != 0 || size / sizeof(word) + 2 > shm::ringWords) {
+      fprintf(stderr, "[COSIM] Dropping message of %zu bytes from endpoint "
+                      "%d: not a multiple of 8 bytes or too large\n",
+              size, slot.endpointId);
+      ep.endpoint->freeMessageToClient(std::move(ep.toClient));
+      ep.toClient = nullptr;
+      continue;
+    }
+    // Frame the blob as a message with one segment, preceded by the segment
+    // table: the segment count minus one, then the segment size in words.
+    size_t segmentWords = size / sizeof(word);
+    words.resize(segmentWords + 1);
+    words[0] = (uint64_t)segmentWords << 32;
+    memcpy(&words[1], ep.toClient->data(), size);
+    if (!slot.toClient.write(words.data(), words.size()))
+      break;
+    ep.endpoint->freeMessageToClient(std::move(ep.toClient));
+    ep.toClient = nullptr;
+    moved = true;
+  }
+  return moved;
+}
+
+void ShmServer::mainLoop() {
+  std::vector<ShmEndpoint> served;
+  std::set<int> published;
+  std::vector<uint64_t> words;
+  unsigned idle = 0;
+  while (!stopSig) {
+    // Publish the endpoints registered since the last iteration. The lookup
+    // can't happen while iterating, as both take the registry lock.
+    if (published.size() < endpoints.size()) {
+      std::vector<int> ids;
+      endpoints.iterateEndpoints([&](int id, const Endpoint &) {
+        if (!published.count(id))
+          ids.push_back(id);
+      });
+      for (int id : ids) {
+        published.insert(id);
+        if (served.size() == shm::maxEndpoints) {
+          fprintf(stderr, "[COSIM] No shared memory slot left for endpoint %d"
+                          "\n",
+                  id);
+          continue;
+        }
+        Endpoint *ep = endpoints[id];
+        shm::EndpointSlot &slot = region->endpoints[served.size()];
+        slot.endpointId = id;
+        slot.sendTypeId = ep->getSendTypeId();
+        slot.recvTypeId = ep->getRecvTypeId();
+        slot.valid.store(1, std::memory_order_release);
+        served.push_back({ep, &slot});
+        region->numEndpoints.store(served.size(), std::memory_order_release);
+      }
+    }
+
+    bool moved = false;
+    for (auto &ep : served)
+      moved |= serviceEndpoint(ep, words);
+
+    // Spin while there is traffic, for the latency, and back off when there
+    // has been none for a while.
+    if (moved)
+      idle = 0;
+    else if (++idle < 10000)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+/// Create the memory mapped file and start the server if not already started.
+bool ShmServer::run(const std::string &path) {
+  Lock g(m);
+  if (mainThread != nullptr) {
+    fprintf(stderr, "Warning: cannot Run() shared memory server more than "
+                    "once!");
+    return false;
+  }
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    perror("[COSIM] Could not create the shared memory file");
+    return false;
+  }
+  void *addr = MAP_FAILED;
+  if (ftruncate(fd, sizeof(shm::Region)) == 0)
+    addr = mmap(nullptr, sizeof(shm::Region), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    perror("[COSIM] Could not map the shared memory file");
+    return false;
+  }
+
+  // The file starts zeroed. Clients wait for the magic number.
+  region = static_cast<shm::Region *>(addr);
+  region->version = shm::regionVersion;
+  region->magic.store(shm::regionMagic, std::memory_order_release);
+  writeShmPath(path);
+  printf("[COSIM] Serving endpoints through: %s\n", path.c_str());
+
+  mainThread = new std::thread(&ShmServer::mainLoop, this);
+  return true;
+}
+
+/// Signal the server thread to stop. Wait for it to exit and unmap the file.
+void ShmServer::stop() {
+  Lock g(m);
+  if (mainThread == nullptr) {
+    fprintf(stderr, "ShmServer not Run()\n");
   } else if (!stopSig) {
     stopSig = true;
     mainThread->join();
+    region->magic.store(0, std::memory_order_release);
+    munmap(region, sizeof(shm::Region));
+    region = nullptr;
   }
 }
@@ -0,0 +1,165 @@
+//===- TransactionLog.cpp - Cosim transaction record and replay -*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Definitions for the cosim transaction recorder and replayer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/ESI/cosim/TransactionLog.h"
+
+using namespace circt::esi::cosim;
+
+/// ----- TransactionRecorder definitions.
+
+TransactionRecorder::~TransactionRecorder() {
+  if (file != nullptr)
+    fclose(file);
+}
+
+bool TransactionRecorder::open(const std::string &path) {
+  file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    perror("[COSIM] Could not create the transaction log");
+    return false;
+  }
+  uint8_t header[12];
+  for (int i = 0; i < 8; ++i)
+    header[i] = transactionLogMagic >> (8 * i);
+  for (int i = 0; i < 4; ++i)
+    header[8 + i] = transactionLogVersion >> (8 * i);
+  fwrite(header, 1, sizeof(header), file);
+  return true;
+}
+
+void TransactionRecorder::writeULEB128(uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0)
+      byte |= 0x80;
+    fputc(byte, file);
+  } while (value != 0);
+}
+
+void TransactionRecorder::record(int epId, bool toHost, uint64_t cycle,
+                                 const Endpoint::Blob &msg) {
+  uint8_t prefix[5];
+  for (int i = 0; i < 4; ++i)
+    prefix[i] = (uint32_t)epId >> (8 * i);
+  prefix[4] = toHost ? 1 : 0;
+  fwrite(prefix, 1, sizeof(prefix), file);
+  writeULEB128(cycle);
+  writeULEB128(msg.size());
+  fwrite(msg.data(), 1, msg.size(), file);
+}
+
+/// ----- TransactionReplayer definitions.
+
+namespace {
+/// Reads the integers of a transaction log, remembering if it ran out of
+/// bytes.
+struct LogReader {
+  const uint8_t *pos;
+  const uint8_t *end;
+  bool truncated = false;
+
+  uint64_t readFixed(int bytes) {
+    if (end - pos < bytes) {
+      truncated = true;
+      pos = end;
+      return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+      value |= (uint64_t)*pos++ << (8 * i);
+    return value;
+  }
+
+  uint64_t readULEB128() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (pos == end) {
+        truncated = true;
+        return 0;
+      }
+      uint8_t byte = *pos++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return value;
+    }
+    truncated = true;
+    return 0;
+  }
+};
+} // end anonymous namespace
+
+bool TransactionReplayer::load(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    perror("[COSIM] Could not open the transaction log");
+    return false;
+  }
+  std::vector<uint8_t> contents;
+  uint8_t chunk[4096];
+  size_t read;
+  while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    contents.insert(contents.end(), chunk, chunk + read);
+  fclose(file);
+
+  LogReader reader{contents.data(), contents.data() + contents.size()};
+  if (reader.readFixed(8) != transactionLogMagic ||
+      reader.readFixed(4) != transactionLogVersion) {
+    fprintf(stderr, "[COSIM] %s is not a transaction log\n", path.c_str());
+    return false;
+  }
+
+  while (reader.pos != reader.end) {
+    int epId = (int)(uint32_t)reader.readFixed(4);
+    bool toHost = reader.readFixed(1) != 0;
+    uint64_t cycle = reader.readULEB128();
+    uint64_t size = reader.readULEB128();
+    if (reader.truncated || (uint64_t)(reader.end - reader.pos) < size) {
+      fprintf(stderr, "[COSIM] Transaction log %s is truncated\n",
+              path.c_str());
+      return false;
+    }
+    Stream &stream = streams[epId];
+    auto &messages = toHost ? stream.toHost : stream.toSim;
+    messages.push_back({cycle, Endpoint::Blob(reader.pos, reader.pos + size)});
+    reader.pos += size;
+  }
+  return true;
+}
+
+void TransactionReplayer::check(int epId, const Endpoint::Blob &msg) {
+  Stream &stream = streams[epId];
+  if (stream.nextToHost == stream.toHost.size()) {
+    if (mismatches++ == 0)
+      fprintf(stderr, "[COSIM] Endpoint %d sent a message which was not "
+                      "recorded\n",
+              epId);
+    return;
+  }
+  size_t index = stream.nextToHost++;
+  if (stream.toHost[index].data != msg && mismatches++ == 0)
+    fprintf(stderr, "[COSIM] Message %zu of endpoint %d differs from the "
+                    "recorded one\n",
+            index, epId);
+}
+
+bool TransactionReplayer::report() {
+  size_t replayed = 0, missing = 0;
+  for (auto &entry : streams) {
+    replayed += entry.second.nextToSim;
+    missing += entry.second.toHost.size() - entry.second.nextToHost;
+  }
+  printf("[cosim] Replayed %zu messages to the simulation. %zu messages to "
+         "the host differed from the log, %zu were not sent.\n",
+         replayed, mismatches, missing);
+  return mismatches == 0 && missing == 0;
+}
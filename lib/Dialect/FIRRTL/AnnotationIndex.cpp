@@ -0,0 +1,116 @@
+//===- AnnotationIndex.cpp - Circuit-wide annotation index ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/AnnotationIndex.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/Parallel.h"
+
+using namespace circt;
+using namespace firrtl;
+
+constexpr unsigned AnnotationTarget::noPort;
+
+AnnotationSet AnnotationTarget::getAnnotations() const {
+  if (isPort())
+    return AnnotationSet::forPort(op, portNo);
+  return AnnotationSet(op);
+}
+
+AnnotationIndex::AnnotationIndex(Operation *operation) {
+  auto circuitOp = cast<CircuitOp>(operation);
+  index(circuitOp);
+
+  // Gather the annotations nested in each operation of the circuit in
+  // parallel, but add them to the index in order, so that the order of the
+  // targets doesn't depend on the threading.
+  SmallVector<Operation *> ops;
+  for (auto &op : *circuitOp.getBody())
+    ops.push_back(&op);
+  SmallVector<SmallVector<Entry>> entries(ops.size());
+  auto gatherNested = [&](size_t i) {
+    ops[i]->walk([&](Operation *op) { gather(op, entries[i]); });
+  };
+  if (circuitOp.getContext()->isMultithreadingEnabled()) {
+    llvm::parallelForEachN(0, ops.size(), gatherNested);
+  } else {
+    for (size_t i = 0, e = ops.size(); i != e; ++i)
+      gatherNested(i);
+  }
+  for (auto &opEntries : entries)
+    insert(opEntries);
+}
+
+void AnnotationIndex::index(Operation *op) {
+  SmallVector<Entry> entries;
+  gather(op, entries);
+  insert(entries);
+}
+
+void AnnotationIndex::insert(ArrayRef<Entry> entries) {
+  for (auto &entry : entries) {
+    auto &classEntry = *classTargets.try_emplace(entry.first).first;
+    classEntry.getValue().push_back(entry.second);
+    auto &classes = opClasses[entry.second.op];
+    if (!llvm::is_contained(classes, classEntry.getKey()))
+      classes.push_back(classEntry.getKey());
+  }
+}
+
+void AnnotationIndex::gather(Operation *op, SmallVectorImpl<Entry> &entries) {
+  auto record = [&](Annotation anno, AnnotationTarget target) {
+    auto className = anno.getClass();
+    if (!className.empty())
+      entries.push_back({className, target});
+  };
+
+  for (auto anno : AnnotationSet(op))
+    record(anno, op);
+
+  if (isa<FModuleOp, FExtModuleOp>(op)) {
+    auto moduleType = mlir::function_like_impl::getFunctionType(op);
+    for (unsigned portNo = 0, e = moduleType.getNumInputs(); portNo != e;
+         ++portNo)
+      for (auto anno : AnnotationSet::forPort(op, portNo))
+        record(anno, {op, portNo});
+  }
+}
+
+ArrayRef<AnnotationTarget>
+AnnotationIndex::lookup(StringRef className) const {
+  auto it = classTargets.find(className);
+  if (it == classTargets.end())
+    return {};
+  return it->getValue();
+}
+
+void AnnotationIndex::getOperations(
+    ArrayRef<StringRef> classNames,
+    SmallVectorImpl<Operation *> &results) const {
+  SmallPtrSet<Operation *, 16> seen;
+  for (auto className : classNames)
+    for (auto target : lookup(className))
+      if (seen.insert(target.op).second)
+        results.push_back(target.op);
+}
+
+void AnnotationIndex::update(Operation *op) {
+  erase(op);
+  index(op);
+}
+
+void AnnotationIndex::erase(Operation *op) {
+  auto it = opClasses.find(op);
+  if (it == opClasses.end())
+    return;
+  for (auto className : it->second) {
+    auto &targets = classTargets[className];
+    llvm::erase_if(targets,
+                   [&](AnnotationTarget target) { return target.op == op; });
+  }
+  opClasses.erase(it);
+}
@@ -28,6 +28,19 @@ static ArrayAttr getAnnotationsFrom(Operation *op) {
   return ArrayAttr::get(op->getContext(), {});
 }
 
+/// Return the dictionary of an annotation attribute, which is either a
+/// DictionaryAttr or a SubAnnotationAttr wrapping one.
+static DictionaryAttr getAnnotationDict(Attribute attr) {
+  if (auto dict = attr.dyn_cast<DictionaryAttr>())
+    return dict;
+  return attr.cast<SubAnnotationAttr>().getAnnotations();
+}
+
+/// Return the class of an annotation dictionary, or null if it has none.
+static StringAttr getAnnotationClass(DictionaryAttr dict) {
+  return dict.getAs<StringAttr>("class");
+}
+
 static ArrayAttr getAnnotationsFrom(ArrayRef<Annotation> annotations,
                                     MLIRContext *context) {
   if (annotations.empty())
@@ -205,31 +218,24 @@ AnnotationSet::applyToPortDictionaryAttr(ArrayRef<NamedAttribute> attrs) const {
                                    false, {});
 }
 
+// Annotation dictionaries are uniqued, so an annotation class and payload that
+// is applied to many operations is only stored once, and the class of every
+// copy is the same StringAttr.  The StringAttr lookups are pointer compares.
 DictionaryAttr AnnotationSet::getAnnotationImpl(StringAttr className) const {
   for (auto annotation : annotations) {
-    DictionaryAttr annotDict;
-    if (auto dict = annotation.dyn_cast<DictionaryAttr>())
-      annotDict = dict;
-    else
-      annotDict = annotation.cast<SubAnnotationAttr>().getAnnotations();
-    if (auto annotClass = annotDict.get("class"))
-      if (annotClass == className)
-        return annotDict;
+    auto annotDict = getAnnotationDict(annotation);
+    if (getAnnotationClass(annotDict) == className)
+      return annotDict;
   }
   return {};
 }
 
 DictionaryAttr AnnotationSet::getAnnotationImpl(StringRef className) const {
   for (auto annotation : annotations) {
-    DictionaryAttr annotDict;
-    if (auto dict = annotation.dyn_cast<DictionaryAttr>())
-      annotDict = dict;
-    else
-      annotDict = annotation.cast<SubAnnotationAttr>().getAnnotations();
-    if (auto annotClass = annotDict.get("class"))
-      if (auto annotClassString = annotClass.dyn_cast<StringAttr>())
-        if (annotClassString.getValue() == className)
-          return annotDict;
+    auto annotDict = getAnnotationDict(annotation);
+    if (auto annotClass = getAnnotationClass(annotDict))
+      if (annotClass.getValue() == className)
+        return annotDict;
   }
   return {};
 }
@@ -316,10 +322,7 @@ bool AnnotationSet::removeAnnotations(
   // Return an Annotation built from an attribute which may be either a
   // DictionaryAttr or a SubAnnotationAttr.
   auto buildAnnotation = [](const Attribute *a) -> Annotation {
-    if (auto b = a->dyn_cast<DictionaryAttr>())
-      return Annotation(b);
-    else
-      return Annotation(a->cast<SubAnnotationAttr>().getAnnotations());
+    return Annotation(getAnnotationDict(*a));
   };
 
   // Search for the first match.
@@ -411,7 +414,7 @@ bool AnnotationSet::removePortAnnotations(
 
 /// Return the 'class' that this annotation is representing.
 StringAttr Annotation::getClassAttr() const {
-  return ((DictionaryAttr)attrDict).getAs<StringAttr>("class");
+  return getAnnotationClass(attrDict);
 }
 
 /// Return the 'class' that this annotation is representing.
@@ -427,8 +430,5 @@ StringRef Annotation::getClass() const {
 
 Annotation AnnotationSetIterator::operator*() const {
   auto attr = this->getBase().getArray()[this->getIndex()];
-  if (auto dictAttr = attr.dyn_cast<DictionaryAttr>())
-    return Annotation(dictAttr);
-  else
-    return Annotation(attr.cast<SubAnnotationAttr>().getAnnotations());
+  return Annotation(getAnnotationDict(attr));
 }
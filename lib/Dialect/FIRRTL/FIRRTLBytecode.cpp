@@ -0,0 +1,805 @@
+//===- FIRRTLBytecode.cpp - Binary serialization of FIRRTL IR -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a compact binary format for FIRRTL circuits.  The
+// format is generic over operations, but is laid out for the shape of FIRRTL
+// IR: a handful of op names, types and attributes are used over and over, and
+// a circuit is a flat list of isolated modules.
+//
+//   file      ::= magic version strings types attrs locs chunks op
+//   magic     ::= 'F' 'I' 'R' 'B'
+//   strings   ::= count (size byte*)*
+//   types     ::= count string-id*         ; textual form of each type
+//   attrs     ::= count string-id*         ; textual form of each attribute
+//   locs      ::= count loc*               ; may only refer to earlier locs
+//   chunks    ::= count (size byte*)*      ; deferred region bodies
+//
+//   op        ::= name-id loc-id attrs-id operands results successors regions
+//   operands  ::= count value-ref*
+//   value-ref ::= (id << 1)                ; an already defined value
+//               | (fwd-id << 1) | 1 type-id?  ; used before being defined
+//   results   ::= count (type-id (fwd-id + 1 | 0))*
+//   regions   ::= count ('\0' region* | '\1' chunk-id)?
+//   region    ::= count block*
+//   block     ::= count (type-id (fwd-id + 1 | 0))* count op*
+//
+// All integers are ULEB128 encoded.  Values are numbered in definition order
+// within a scope.  The regions of isolated operations that don't contain other
+// isolated operations (e.g. modules) are written as separate chunks with their
+// own value numbering, which lets the reader decode them in parallel.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRRTLBytecode.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/Location.h"
+#include "mlir/Parser.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/SourceMgr.h"
+#include <atomic>
+
+using namespace circt;
+using namespace firrtl;
+using llvm::encodeULEB128;
+using llvm::SourceMgr;
+using mlir::LocationAttr;
+using mlir::OwningModuleRef;
+
+static constexpr StringLiteral bytecodeMagic = "FIRB";
+static constexpr uint8_t bytecodeVersion = 1;
+
+namespace {
+/// The kinds of locations stored in the location table.
+enum class LocKind : uint8_t {
+  Unknown = 0,
+  FileLineCol = 1,
+  Name = 2,
+  CallSite = 3,
+  Fused = 4,
+};
+} // end anonymous namespace
+
+bool circt::firrtl::isFIRRTLBytecode(StringRef buffer) {
+  return buffer.startswith(bytecodeMagic);
+}
+
+/// Return true if the regions of this operation should be written as a
+/// separate chunk.  This is the case for non-empty isolated operations that
+/// don't directly contain other isolated operations.
+static bool shouldWriteAsChunk(Operation *op) {
+  if (!op->hasTrait<OpTrait::IsIsolatedFromAbove>())
+    return false;
+  bool isEmpty = true;
+  for (auto &region : op->getRegions())
+    for (auto &block : region) {
+      isEmpty = false;
+      for (auto &nested : block)
+        if (nested.hasTrait<OpTrait::IsIsolatedFromAbove>())
+          return false;
+    }
+  return !isEmpty;
+}
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The value numbering of one scope of the IR.
+struct WriterScope {
+  /// Values that have been defined, mapped to their definition order.
+  DenseMap<Value, unsigned> valueIDs;
+  /// Values that were used before being defined.
+  DenseMap<Value, unsigned> forwardRefIDs;
+};
+
+/// This class accumulates the uniqued tables while encoding operations, and
+/// then emits everything to the output stream.
+class BytecodeWriter {
+public:
+  BytecodeWriter(Operation *rootOp) : rootOp(rootOp), locOS(locBuffer) {}
+
+  void write(raw_ostream &os);
+
+private:
+  unsigned getStringID(StringRef str);
+  unsigned getTypeID(Type type);
+  unsigned getAttrID(Attribute attr);
+  unsigned getLocID(Location loc);
+
+  void writeOp(Operation *op, raw_ostream &os, WriterScope &scope,
+               bool inChunk);
+  void writeRegion(Region &region, raw_ostream &os, WriterScope &scope,
+                   bool inChunk);
+  void writeValueRef(Value value, raw_ostream &os, WriterScope &scope);
+  void defineValue(Value value, raw_ostream &os, WriterScope &scope);
+
+  Operation *rootOp;
+
+  /// The string table.  The vector refers to the keys of the map.
+  llvm::StringMap<unsigned> stringIDs;
+  std::vector<StringRef> strings;
+
+  /// The type and attribute tables, which refer to the string table.
+  DenseMap<Type, unsigned> typeIDs;
+  std::vector<unsigned> typeStrings;
+  DenseMap<Attribute, unsigned> attrIDs;
+  std::vector<unsigned> attrStrings;
+
+  /// The location table, which is encoded as locations are added to it.
+  DenseMap<Location, unsigned> locIDs;
+  unsigned numLocs = 0;
+  std::string locBuffer;
+  llvm::raw_string_ostream locOS;
+
+  /// The index of each block within its parent region, used by successors.
+  DenseMap<Block *, unsigned> blockIDs;
+
+  /// The encoded region bodies of the chunked operations.
+  std::vector<std::string> chunks;
+};
+} // end anonymous namespace
+
+unsigned BytecodeWriter::getStringID(StringRef str) {
+  auto it = stringIDs.try_emplace(str, strings.size());
+  if (it.second)
+    strings.push_back(it.first->getKey());
+  return it.first->second;
+}
+
+unsigned BytecodeWriter::getTypeID(Type type) {
+  auto it = typeIDs.try_emplace(type, typeStrings.size());
+  if (it.second) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    type.print(os);
+    typeStrings.push_back(getStringID(os.str()));
+  }
+  return it.first->second;
+}
+
+unsigned BytecodeWriter::getAttrID(Attribute attr) {
+  auto it = attrIDs.try_emplace(attr, attrStrings.size());
+  if (it.second) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    attr.print(os);
+    attrStrings.push_back(getStringID(os.str()));
+  }
+  return it.first->second;
+}
+
+unsigned BytecodeWriter::getLocID(Location loc) {
+  auto it = locIDs.find(loc);
+  if (it != locIDs.end())
+    return it->second;
+
+  // Opaque locations can't be serialized, so use their fallback instead.
+  if (auto opaqueLoc = loc.dyn_cast<OpaqueLoc>()) {
+    auto fallbackID = getLocID(opaqueLoc.getFallbackLocation());
+    return locIDs[loc] = fallbackID;
+  }
+
+  // Nested locations are added to the table before the location that refers
+  // to them, so compute their IDs before encoding this entry.
+  if (auto fileLoc = loc.dyn_cast<FileLineColLoc>()) {
+    auto filenameID = getStringID(fileLoc.getFilename());
+    locOS << char(LocKind::FileLineCol);
+    encodeULEB128(filenameID, locOS);
+    encodeULEB128(fileLoc.getLine(), locOS);
+    encodeULEB128(fileLoc.getColumn(), locOS);
+  } else if (auto nameLoc = loc.dyn_cast<NameLoc>()) {
+    auto nameID = getStringID(nameLoc.getName().strref());
+    auto childID = getLocID(nameLoc.getChildLoc());
+    locOS << char(LocKind::Name);
+    encodeULEB128(nameID, locOS);
+    encodeULEB128(childID, locOS);
+  } else if (auto callLoc = loc.dyn_cast<CallSiteLoc>()) {
+    auto calleeID = getLocID(callLoc.getCallee());
+    auto callerID = getLocID(callLoc.getCaller());
+    locOS << char(LocKind::CallSite);
+    encodeULEB128(calleeID, locOS);
+    encodeULEB128(callerID, locOS);
+  } else if (auto fusedLoc = loc.dyn_cast<FusedLoc>()) {
+    SmallVector<unsigned> subLocIDs;
+    for (auto subLoc : fusedLoc.getLocations())
+      subLocIDs.push_back(getLocID(subLoc));
+    auto metadata = fusedLoc.getMetadata();
+    auto metadataID = metadata ? getAttrID(metadata) + 1 : 0;
+    locOS << char(LocKind::Fused);
+    encodeULEB128(subLocIDs.size(), locOS);
+    for (auto subLocID : subLocIDs)
+      encodeULEB128(subLocID, locOS);
+    encodeULEB128(metadataID, locOS);
+  } else {
+    locOS << char(LocKind::Unknown);
+  }
+
+  return locIDs[loc] = numLocs++;
+}
+
+void BytecodeWriter::writeValueRef(Value value, raw_ostream &os,
+                                   WriterScope &scope) {
+  auto it = scope.valueIDs.find(value);
+  if (it != scope.valueIDs.end()) {
+    encodeULEB128(uint64_t(it->second) << 1, os);
+    return;
+  }
+
+  // This is a use before the definition.  The first use carries the type so
+  // the reader can create a placeholder.
+  auto fwdIt =
+      scope.forwardRefIDs.try_emplace(value, scope.forwardRefIDs.size());
+  encodeULEB128((uint64_t(fwdIt.first->second) << 1) | 1, os);
+  if (fwdIt.second)
+    encodeULEB128(getTypeID(value.getType()), os);
+}
+
+void BytecodeWriter::defineValue(Value value, raw_ostream &os,
+                                 WriterScope &scope) {
+  encodeULEB128(getTypeID(value.getType()), os);
+  auto fwdIt = scope.forwardRefIDs.find(value);
+  encodeULEB128(fwdIt == scope.forwardRefIDs.end() ? 0 : fwdIt->second + 1,
+                os);
+  scope.valueIDs.try_emplace(value, scope.valueIDs.size());
+}
+
+void BytecodeWriter::writeOp(Operation *op, raw_ostream &os,
+                             WriterScope &scope, bool inChunk) {
+  encodeULEB128(getStringID(op->getName().getStringRef()), os);
+  encodeULEB128(getLocID(op->getLoc()), os);
+  encodeULEB128(getAttrID(op->getAttrDictionary()), os);
+
+  encodeULEB128(op->getNumOperands(), os);
+  for (auto operand : op->getOperands())
+    writeValueRef(operand, os, scope);
+
+  encodeULEB128(op->getNumResults(), os);
+  for (auto result : op->getResults())
+    defineValue(result, os, scope);
+
+  encodeULEB128(op->getNumSuccessors(), os);
+  for (auto *successor : op->getSuccessors())
+    encodeULEB128(blockIDs.lookup(successor), os);
+
+  encodeULEB128(op->getNumRegions(), os);
+  if (op->getNumRegions() == 0)
+    return;
+
+  // Chunks are only split off at one level, nested chunks would serialize the
+  // reader again.
+  if (!inChunk && op != rootOp && shouldWriteAsChunk(op)) {
+    std::string chunk;
+    llvm::raw_string_ostream chunkOS(chunk);
+    WriterScope chunkScope;
+    for (auto &region : op->getRegions())
+      writeRegion(region, chunkOS, chunkScope, /*inChunk=*/true);
+    chunkOS.flush();
+
+    os << char(1);
+    encodeULEB128(chunks.size(), os);
+    chunks.push_back(std::move(chunk));
+    return;
+  }
+
+  os << char(0);
+  for (auto &region : op->getRegions())
+    writeRegion(region, os, scope, inChunk);
+}
+
+void BytecodeWriter::writeRegion(Region &region, raw_ostream &os,
+                                 WriterScope &scope, bool inChunk) {
+  unsigned numBlocks = 0;
+  for (auto &block : region)
+    blockIDs[&block] = numBlocks++;
+  encodeULEB128(numBlocks, os);
+
+  for (auto &block : region) {
+    encodeULEB128(block.getNumArguments(), os);
+    for (auto arg : block.getArguments())
+      defineValue(arg, os, scope);
+
+    encodeULEB128(block.getOperations().size(), os);
+    for (auto &op : block)
+      writeOp(&op, os, scope, inChunk);
+  }
+}
+
+void BytecodeWriter::write(raw_ostream &os) {
+  // Encode the operations first, which fills in all of the tables.
+  std::string body;
+  llvm::raw_string_ostream bodyOS(body);
+  WriterScope scope;
+  writeOp(rootOp, bodyOS, scope, /*inChunk=*/false);
+  bodyOS.flush();
+  locOS.flush();
+
+  os << bytecodeMagic << char(bytecodeVersion);
+
+  encodeULEB128(strings.size(), os);
+  for (auto str : strings) {
+    encodeULEB128(str.size(), os);
+    os << str;
+  }
+
+  encodeULEB128(typeStrings.size(), os);
+  for (auto stringID : typeStrings)
+    encodeULEB128(stringID, os);
+
+  encodeULEB128(attrStrings.size(), os);
+  for (auto stringID : attrStrings)
+    encodeULEB128(stringID, os);
+
+  encodeULEB128(numLocs, os);
+  os << locBuffer;
+
+  encodeULEB128(chunks.size(), os);
+  for (auto &chunk : chunks) {
+    encodeULEB128(chunk.size(), os);
+    os << chunk;
+  }
+
+  os << body;
+}
+
+void circt::firrtl::writeFIRRTLBytecode(Operation *op, raw_ostream &os) {
+  BytecodeWriter(op).write(os);
+}
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A cursor over a range of the input.  Running off the end or reading a
+/// malformed integer puts the cursor in a failed state, in which all reads
+/// return zero.
+struct Cursor {
+  Cursor(StringRef bytes)
+      : ptr(bytes.bytes_begin()), end(bytes.bytes_end()) {}
+
+  uint64_t readInt() {
+    if (failed)
+      return 0;
+    unsigned size;
+    const char *error = nullptr;
+    auto value = llvm::decodeULEB128(ptr, &size, end, &error);
+    if (error)
+      return failed = true, 0;
+    ptr += size;
+    return value;
+  }
+
+  StringRef readBytes(uint64_t size) {
+    if (failed || uint64_t(end - ptr) < size)
+      return failed = true, StringRef();
+    StringRef result(reinterpret_cast<const char *>(ptr), size);
+    ptr += size;
+    return result;
+  }
+
+  uint8_t readByte() {
+    auto bytes = readBytes(1);
+    return bytes.empty() ? 0 : bytes.front();
+  }
+
+  bool atEnd() const { return ptr == end; }
+
+  const uint8_t *ptr, *end;
+  bool failed = false;
+};
+
+/// The value numbering of one scope of the IR.
+struct ReaderScope {
+  ReaderScope(Location loc) : loc(loc) {}
+
+  /// Drop any forward references that never got defined.
+  ~ReaderScope() {
+    for (auto &entry : forwardRefs) {
+      entry.second->getResult(0).dropAllUses();
+      entry.second->destroy();
+    }
+  }
+
+  /// The location used for placeholder operations.
+  Location loc;
+  std::vector<Value> values;
+  DenseMap<uint64_t, Operation *> forwardRefs;
+};
+
+/// An operation whose region bodies are stored in a chunk.
+struct DeferredRegions {
+  Operation *op;
+  uint64_t chunkID;
+};
+
+class BytecodeReader {
+public:
+  BytecodeReader(StringRef buffer, Location fileLoc, MLIRContext *context)
+      : buffer(buffer), fileLoc(fileLoc), context(context) {}
+
+  /// Read the buffer, returning the root operation or null on failure.
+  Operation *read();
+
+private:
+  LogicalResult emitMalformedError() {
+    return mlir::emitError(fileLoc, "malformed FIRRTL bytecode");
+  }
+
+  LogicalResult readTables(Cursor &cursor);
+
+  template <typename T>
+  T lookup(Cursor &cursor, const std::vector<T> &table) {
+    uint64_t id = cursor.readInt();
+    if (cursor.failed || id >= table.size())
+      return cursor.failed = true, T();
+    return table[id];
+  }
+
+  Operation *readOp(Cursor &cursor, ReaderScope &scope,
+                    ArrayRef<Block *> regionBlocks, bool inChunk);
+  LogicalResult readRegion(Cursor &cursor, Region &region, ReaderScope &scope,
+                           bool inChunk);
+  Value readValueRef(Cursor &cursor, ReaderScope &scope);
+  void defineValue(Cursor &cursor, Value value, uint64_t fwdRef,
+                   ReaderScope &scope);
+  LogicalResult readChunk(DeferredRegions &deferred);
+
+  StringRef buffer;
+  Location fileLoc;
+  MLIRContext *context;
+
+  std::vector<StringRef> strings;
+  std::vector<Type> types;
+  std::vector<Attribute> attrs;
+  std::vector<LocationAttr> locs;
+  std::vector<StringRef> chunks;
+
+  /// The chunked operations found while reading the root scope.
+  std::vector<DeferredRegions> deferredRegions;
+};
+} // end anonymous namespace
+
+LogicalResult BytecodeReader::readTables(Cursor &cursor) {
+  auto numStrings = cursor.readInt();
+  for (uint64_t i = 0; i != numStrings && !cursor.failed; ++i)
+    strings.push_back(cursor.readBytes(cursor.readInt()));
+
+  auto numTypes = cursor.readInt();
+  for (uint64_t i = 0; i != numTypes && !cursor.failed; ++i) {
+    auto str = lookup(cursor, strings);
+    if (cursor.failed)
+      break;
+    auto type = mlir::parseType(str, context);
+    if (!type)
+      return failure();
+    types.push_back(type);
+  }
+
+  auto numAttrs = cursor.readInt();
+  for (uint64_t i = 0; i != numAttrs && !cursor.failed; ++i) {
+    auto str = lookup(cursor, strings);
+    if (cursor.failed)
+      break;
+    auto attr = mlir::parseAttribute(str, context);
+    if (!attr)
+      return failure();
+    attrs.push_back(attr);
+  }
+
+  auto numLocs = cursor.readInt();
+  for (uint64_t i = 0; i != numLocs && !cursor.failed; ++i) {
+    switch (LocKind(cursor.readByte())) {
+    case LocKind::Unknown:
+      locs.push_back(UnknownLoc::get(context));
+      break;
+    case LocKind::FileLineCol: {
+      auto filename = lookup(cursor, strings);
+      auto line = cursor.readInt();
+      auto column = cursor.readInt();
+      locs.push_back(FileLineColLoc::get(context, filename, line, column));
+      break;
+    }
+    case LocKind::Name: {
+      auto name = lookup(cursor, strings);
+      auto child = lookup(cursor, locs);
+      if (!cursor.failed)
+        locs.push_back(NameLoc::get(Identifier::get(name, context), child));
+      break;
+    }
+    case LocKind::CallSite: {
+      auto callee = lookup(cursor, locs);
+      auto caller = lookup(cursor, locs);
+      if (!cursor.failed)
+        locs.push_back(CallSiteLoc::get(callee, caller));
+      break;
+    }
+    case LocKind::Fused: {
+      SmallVector<Location> subLocs;
+      auto numSubLocs = cursor.readInt();
+      for (uint64_t j = 0; j != numSubLocs && !cursor.failed; ++j)
+        if (auto subLoc = lookup(cursor, locs))
+          subLocs.push_back(subLoc);
+      // The metadata is stored as an attribute ID plus one.
+      Attribute metadata;
+      auto metadataID = cursor.readInt();
+      if (metadataID > attrs.size())
+        cursor.failed = true;
+      else if (metadataID != 0)
+        metadata = attrs[metadataID - 1];
+      if (!cursor.failed)
+        locs.push_back(FusedLoc::get(context, subLocs, metadata));
+      break;
+    }
+    default:
+      cursor.failed = true;
+      break;
+    }
+  }
+
+  auto numChunks = cursor.readInt();
+  for (uint64_t i = 0; i != numChunks && !cursor.failed; ++i)
+    chunks.push_back(cursor.readBytes(cursor.readInt()));
+
+  if (cursor.failed)
+    return emitMalformedError();
+  return success();
+}
+
+Value BytecodeReader::readValueRef(Cursor &cursor, ReaderScope &scope) {
+  auto ref = cursor.readInt();
+  if (cursor.failed)
+    return {};
+
+  if ((ref & 1) == 0) {
+    auto id = ref >> 1;
+    if (id >= scope.values.size())
+      return cursor.failed = true, Value();
+    return scope.values[id];
+  }
+
+  // This is a forward reference.  The first use carries the type, and gets a
+  // placeholder that is replaced when the value is defined.
+  auto &placeholder = scope.forwardRefs[ref >> 1];
+  if (!placeholder) {
+    auto type = lookup(cursor, types);
+    if (cursor.failed) {
+      scope.forwardRefs.erase(ref >> 1);
+      return {};
+    }
+    placeholder = Operation::create(
+        scope.loc, OperationName("firrtl.bytecode_placeholder", context),
+        ArrayRef<Type>(type), {}, DictionaryAttr::get(context), {},
+        /*numRegions=*/0);
+  }
+  return placeholder->getResult(0);
+}
+
+/// Define the next value in the scope, resolving the forward reference (stored
+/// as the forward reference ID plus one) it provides if there is one.
+void BytecodeReader::defineValue(Cursor &cursor, Value value, uint64_t fwdRef,
+                                 ReaderScope &scope) {
+  scope.values.push_back(value);
+  if (fwdRef == 0)
+    return;
+
+  auto it = scope.forwardRefs.find(fwdRef - 1);
+  if (it == scope.forwardRefs.end() ||
+      it->second->getResult(0).getType() != value.getType()) {
+    cursor.failed = true;
+    return;
+  }
+  it->second->getResult(0).replaceAllUsesWith(value);
+  it->second->destroy();
+  scope.forwardRefs.erase(it);
+}
+
+Operation *BytecodeReader::readOp(Cursor &cursor, ReaderScope &scope,
+                                  ArrayRef<Block *> regionBlocks,
+                                  bool inChunk) {
+  auto name = lookup(cursor, strings);
+  auto loc = lookup(cursor, locs);
+  auto opAttrs = lookup(cursor, attrs).dyn_cast_or_null<DictionaryAttr>();
+  if (cursor.failed || !opAttrs)
+    return nullptr;
+
+  SmallVector<Value, 4> operands;
+  auto numOperands = cursor.readInt();
+  for (uint64_t i = 0; i != numOperands && !cursor.failed; ++i)
+    operands.push_back(readValueRef(cursor, scope));
+
+  // The forward references resolved by the results are processed once the
+  // operation exists.
+  SmallVector<Type, 4> resultTypes;
+  SmallVector<uint64_t, 4> resultFwdRefs;
+  auto numResults = cursor.readInt();
+  for (uint64_t i = 0; i != numResults && !cursor.failed; ++i) {
+    resultTypes.push_back(lookup(cursor, types));
+    resultFwdRefs.push_back(cursor.readInt());
+  }
+
+  SmallVector<Block *, 2> successors;
+  auto numSuccessors = cursor.readInt();
+  for (uint64_t i = 0; i != numSuccessors && !cursor.failed; ++i) {
+    auto blockID = cursor.readInt();
+    if (blockID >= regionBlocks.size())
+      return cursor.failed = true, nullptr;
+    successors.push_back(regionBlocks[blockID]);
+  }
+
+  auto numRegions = cursor.readInt();
+  if (cursor.failed)
+    return nullptr;
+
+  auto *op = Operation::create(loc, OperationName(name, context), resultTypes,
+                               operands, opAttrs, successors, numRegions);
+
+  for (auto resultAndFwdRef : llvm::zip(op->getResults(), resultFwdRefs))
+    defineValue(cursor, std::get<0>(resultAndFwdRef),
+                std::get<1>(resultAndFwdRef), scope);
+
+  if (numRegions != 0 && !cursor.failed) {
+    switch (cursor.readByte()) {
+    case 0:
+      for (auto &region : op->getRegions())
+        if (failed(readRegion(cursor, region, scope, inChunk)))
+          break;
+      break;
+    case 1: {
+      // The regions are in a chunk, which is decoded later.
+      auto chunkID = cursor.readInt();
+      if (inChunk || chunkID >= chunks.size())
+        cursor.failed = true;
+      else
+        deferredRegions.push_back({op, chunkID});
+      break;
+    }
+    default:
+      cursor.failed = true;
+      break;
+    }
+  }
+
+  if (cursor.failed) {
+    op->dropAllReferences();
+    op->destroy();
+    return nullptr;
+  }
+  return op;
+}
+
+LogicalResult BytecodeReader::readRegion(Cursor &cursor, Region &region,
+                                         ReaderScope &scope, bool inChunk) {
+  // Create all of the blocks up front so that successors can refer to them.
+  SmallVector<Block *, 2> blocks;
+  auto numBlocks = cursor.readInt();
+  for (uint64_t i = 0; i != numBlocks && !cursor.failed; ++i) {
+    blocks.push_back(new Block());
+    region.push_back(blocks.back());
+  }
+
+  for (auto *block : blocks) {
+    auto numArgs = cursor.readInt();
+    for (uint64_t i = 0; i != numArgs && !cursor.failed; ++i) {
+      auto type = lookup(cursor, types);
+      auto fwdRef = cursor.readInt();
+      if (cursor.failed)
+        break;
+      defineValue(cursor, block->addArgument(type), fwdRef, scope);
+    }
+
+    auto numOps = cursor.readInt();
+    for (uint64_t i = 0; i != numOps && !cursor.failed; ++i) {
+      auto *op = readOp(cursor, scope, blocks, inChunk);
+      if (!op)
+        break;
+      block->push_back(op);
+    }
+  }
+
+  return failure(cursor.failed);
+}
+
+LogicalResult BytecodeReader::readChunk(DeferredRegions &deferred) {
+  Cursor cursor(chunks[deferred.chunkID]);
+  ReaderScope scope(deferred.op->getLoc());
+  for (auto &region : deferred.op->getRegions())
+    if (failed(readRegion(cursor, region, scope, /*inChunk=*/true)))
+      break;
+
+  if (cursor.failed || !cursor.atEnd() || !scope.forwardRefs.empty())
+    return emitMalformedError();
+  return success();
+}
+
+Operation *BytecodeReader::read() {
+  Cursor cursor(buffer);
+  if (cursor.readBytes(bytecodeMagic.size()) != bytecodeMagic ||
+      cursor.readByte() != bytecodeVersion) {
+    mlir::emitError(fileLoc, "unsupported FIRRTL bytecode version");
+    return nullptr;
+  }
+
+  if (failed(readTables(cursor)))
+    return nullptr;
+
+  Operation *rootOp;
+  {
+    ReaderScope scope(fileLoc);
+    rootOp = readOp(cursor, scope, {}, /*inChunk=*/false);
+    if (!rootOp || !cursor.atEnd() || !scope.forwardRefs.empty()) {
+      if (rootOp) {
+        rootOp->dropAllReferences();
+        rootOp->destroy();
+      }
+      emitMalformedError();
+      return nullptr;
+    }
+  }
+
+  // Each chunk may only be used once, otherwise two operations would share the
+  // same region body.
+  llvm::BitVector usedChunks(chunks.size());
+  for (auto &deferred : deferredRegions) {
+    if (usedChunks.test(deferred.chunkID)) {
+      rootOp->dropAllReferences();
+      rootOp->destroy();
+      emitMalformedError();
+      return nullptr;
+    }
+    usedChunks.set(deferred.chunkID);
+  }
+
+  // Decode the chunks, in parallel if we can.  Each chunk only refers to the
+  // shared tables and fills in the regions of its own isolated operation.
+  std::atomic<bool> anyFailed{false};
+  if (context->isMultithreadingEnabled()) {
+    mlir::ParallelDiagnosticHandler diagHandler(context);
+    llvm::parallelForEachN(0, deferredRegions.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      if (failed(readChunk(deferredRegions[index])))
+        anyFailed = true;
+    });
+  } else {
+    for (auto &deferred : deferredRegions)
+      if (failed(readChunk(deferred))) {
+        anyFailed = true;
+        break;
+      }
+  }
+
+  if (anyFailed) {
+    rootOp->dropAllReferences();
+    rootOp->destroy();
+    return nullptr;
+  }
+  return rootOp;
+}
+
+OwningModuleRef circt::firrtl::importFIRRTLBytecode(SourceMgr &sourceMgr,
+                                                    MLIRContext *context) {
+  auto *sourceBuf = sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID());
+  auto fileLoc = FileLineColLoc::get(
+      context, sourceBuf->getBufferIdentifier(), /*line=*/0, /*column=*/0);
+
+  auto *op = BytecodeReader(sourceBuf->getBuffer(), fileLoc, context).read();
+  if (!op)
+    return {};
+
+  auto module = dyn_cast<ModuleOp>(op);
+  if (!module) {
+    mlir::emitError(op->getLoc(), "FIRRTL bytecode must contain a module");
+    op->destroy();
+    return {};
+  }
+  return module;
+}
@@ -21,10 +21,13 @@
 #include "mlir/IR/DialectImplementation.h"
 #include "mlir/IR/FunctionImplementation.h"
 #include "mlir/IR/PatternMatch.h"
+#include "mlir/IR/Verifier.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 using mlir::RegionRange;
 using namespace circt;
@@ -313,6 +316,41 @@ static LogicalResult verifyCircuitOp(CircuitOp circuit) {
   return success();
 }
 
+LogicalResult firrtl::verifyCircuit(CircuitOp circuit) {
+  // The circuit's own verifier and traits check the symbol table and the
+  // relationships between modules, such as conflicting extmodule defnames.
+  // These need to look at the whole circuit, so they run first and serially.
+  auto *abstractOp = circuit->getAbstractOperation();
+  if (abstractOp && failed(abstractOp->verifyInvariants(circuit)))
+    return failure();
+
+  // Everything else is local to a module: the instance verifier only looks up
+  // the referenced module, which nothing modifies while we verify.
+  SmallVector<Operation *> ops;
+  for (auto &op : *circuit.getBody())
+    ops.push_back(&op);
+
+  auto *context = circuit.getContext();
+  if (!context->isMultithreadingEnabled()) {
+    for (auto *op : ops)
+      if (failed(mlir::verify(op)))
+        return failure();
+    return success();
+  }
+
+  // Keep the diagnostics in the order of the modules, so that the output
+  // doesn't depend on the threading.
+  mlir::ParallelDiagnosticHandler diagHandler(context);
+  std::atomic<bool> anyFailed{false};
+  llvm::parallelForEachN(0, ops.size(), [&](size_t index) {
+    diagHandler.setOrderIDForThread(index);
+    if (failed(mlir::verify(ops[index])))
+      anyFailed = true;
+    diagHandler.eraseOrderIDForThread();
+  });
+  return failure(anyFailed.load());
+}
+
 Region &CircuitOp::getBodyRegion() { return getOperation()->getRegion(0); }
 Block *CircuitOp::getBody() { return &getBodyRegion().front(); }
 
@@ -838,6 +876,15 @@ Operation *InstanceOp::getReferencedModule() {
   return circuit.lookupSymbol(moduleName());
 }
 
+Operation *
+InstanceOp::getReferencedModule(SymbolTableCollection &symbolTable) {
+  auto circuit = (*this)->getParentOfType<CircuitOp>();
+  if (!circuit)
+    return nullptr;
+
+  return symbolTable.lookupSymbolIn(circuit, moduleNameAttr());
+}
+
 void InstanceOp::build(OpBuilder &builder, OperationState &result,
                        TypeRange resultTypes, StringRef moduleName,
                        StringRef name, ArrayRef<Attribute> annotations,
@@ -898,16 +945,31 @@ static LogicalResult verifyInstanceOp(InstanceOp instance) {
     return failure();
   }
 
-  auto *referencedModule = instance.getReferencedModule();
+  if (instance.portAnnotations().size() != instance.getNumResults())
+    return instance.emitOpError("the number of result annotations should be "
+                                "equal to the number of results");
+
+  return success();
+}
+
+/// Verify the referenced module of an InstanceOp. This runs as part of the
+/// circuit's verification, which shares one symbol table across all instances
+/// instead of scanning the circuit for each of them.
+LogicalResult InstanceOp::verifySymbolUses(SymbolTableCollection &symbolTable) {
+  auto module = (*this)->getParentOfType<FModuleOp>();
+  if (!module)
+    return success();
+
+  auto *referencedModule = getReferencedModule(symbolTable);
   if (!referencedModule) {
-    instance.emitOpError("invalid symbol reference");
+    emitOpError("invalid symbol reference");
     return failure();
   }
 
   // Check that this instance doesn't recursively instantiate its wrapping
   // module.
   if (referencedModule == module) {
-    auto diag = instance.emitOpError()
+    auto diag = emitOpError()
                 << "is a recursive instantiation of its containing module";
     diag.attachNote(module.getLoc()) << "containing module declared here";
     return failure();
@@ -916,21 +978,21 @@ static LogicalResult verifyInstanceOp(InstanceOp instance) {
   SmallVector<ModulePortInfo> modulePorts = getModulePortInfo(referencedModule);
 
   // Check that result types are consistent with the referenced module's ports.
-  size_t numResults = instance.getNumResults();
+  size_t numResults = getNumResults();
   if (numResults != modulePorts.size()) {
-    auto diag = instance.emitOpError()
-                << "has a wrong number of results; expected "
-                << modulePorts.size() << " but got " << numResults;
+    auto diag = emitOpError() << "has a wrong number of results; expected "
+                              << modulePorts.size() << " but got "
+                              << numResults;
     diag.attachNote(referencedModule->getLoc())
         << "original module declared here";
     return failure();
   }
 
   for (size_t i = 0; i != numResults; i++) {
-    auto resultType = instance.getResult(i).getType();
+    auto resultType = getResult(i).getType();
     auto expectedType = modulePorts[i].type;
     if (resultType != expectedType) {
-      auto diag = instance.emitOpError()
+      auto diag = emitOpError()
                   << "result type for " << modulePorts[i].name << " must be "
                   << expectedType << ", but got " << resultType;
 
@@ -940,10 +1002,6 @@ static LogicalResult verifyInstanceOp(InstanceOp instance) {
     }
   }
 
-  if (instance.portAnnotations().size() != instance.getNumResults())
-    return instance.emitOpError("the number of result annotations should be "
-                                "equal to the number of results");
-
   return success();
 }
 
@@ -364,6 +364,22 @@ unsigned FIRRTLType::getMaxFieldID() {
       });
 }
 
+FIRRTLType FIRRTLType::getFinalTypeByFieldID(unsigned fieldID) {
+  FIRRTLType type = *this;
+  while (fieldID) {
+    std::pair<FIRRTLType, unsigned> subType;
+    if (auto bundleType = type.dyn_cast<BundleType>())
+      subType = bundleType.getSubTypeByFieldID(fieldID);
+    else if (auto vecType = type.dyn_cast<FVectorType>())
+      subType = vecType.getSubTypeByFieldID(fieldID);
+    else
+      llvm_unreachable("field ID out of range of the type");
+    type = subType.first;
+    fieldID = subType.second;
+  }
+  return type;
+}
+
 std::pair<unsigned, bool> FIRRTLType::rootChildFieldID(unsigned fieldID,
                                                        unsigned index) {
   return TypeSwitch<FIRRTLType, std::pair<unsigned, bool>>(*this)
@@ -584,6 +600,10 @@ llvm::hash_code hash_value(const BundleType::BundleElement &arg) {
 } // namespace firrtl
 } // namespace circt
 
+/// Bundles with at least this many elements look up their elements by name in a
+/// hash table rather than by a linear scan.
+static constexpr size_t minElementsForNameTable = 16;
+
 namespace circt {
 namespace firrtl {
 namespace detail {
@@ -608,6 +628,13 @@ struct BundleTypeStorage : mlir::TypeStorage {
     }
     maxFieldID = fieldID;
     passiveContainsAnalogTypeInfo.setInt(props.toFlags());
+
+    // The table is built here rather than on the first lookup, since types are
+    // shared by passes running in parallel. The first of any duplicate names
+    // wins, like in the linear scan.
+    if (elements.size() >= minElementsForNameTable)
+      for (auto it : llvm::enumerate(elements))
+        nameToIndex.insert({it.value().name.getValue(), it.index()});
   }
 
   bool operator==(const KeyTy &key) const { return key == KeyTy(elements); }
@@ -625,6 +652,9 @@ struct BundleTypeStorage : mlir::TypeStorage {
   SmallVector<unsigned, 4> fieldIDs;
   unsigned maxFieldID;
 
+  /// The index of each element by name, only populated for large bundles.
+  llvm::DenseMap<StringRef, unsigned> nameToIndex;
+
   /// This holds the bits for the type's recursive properties, and can hold a
   /// pointer to a passive version of the type.
   llvm::PointerIntPair<Type, RecursiveTypeProperties::numBits, unsigned>
@@ -677,6 +707,14 @@ FIRRTLType BundleType::getPassiveType() {
 }
 
 llvm::Optional<unsigned> BundleType::getElementIndex(StringRef name) {
+  auto &nameToIndex = getImpl()->nameToIndex;
+  if (!nameToIndex.empty()) {
+    auto it = nameToIndex.find(name);
+    if (it == nameToIndex.end())
+      return None;
+    return it->second;
+  }
+
   for (auto it : llvm::enumerate(getElements())) {
     auto element = it.value();
     if (element.name.getValue() == name) {
@@ -717,12 +755,20 @@ unsigned BundleType::getFieldID(unsigned index) {
 
 unsigned BundleType::getIndexForFieldID(unsigned fieldID) {
   assert(getElements().size() && "Bundle must have >0 fields");
-  auto fieldIDs = getImpl()->fieldIDs;
+  ArrayRef<unsigned> fieldIDs = getImpl()->fieldIDs;
   auto it =
       std::prev(std::upper_bound(fieldIDs.begin(), fieldIDs.end(), fieldID));
   return std::distance(fieldIDs.begin(), it);
 }
 
+std::pair<FIRRTLType, unsigned>
+BundleType::getSubTypeByFieldID(unsigned fieldID) {
+  if (fieldID == 0)
+    return {*this, 0};
+  auto index = getIndexForFieldID(fieldID);
+  return {getElements()[index].type, fieldID - getFieldID(index)};
+}
+
 unsigned BundleType::getMaxFieldID() { return getImpl()->maxFieldID; }
 
 std::pair<unsigned, bool> BundleType::rootChildFieldID(unsigned fieldID,
@@ -747,6 +793,8 @@ struct VectorTypeStorage : mlir::TypeStorage {
   VectorTypeStorage(KeyTy value) : value(value) {
     auto properties = value.first.getRecursiveTypeProperties();
     passiveContainsAnalogTypeInfo.setInt(properties.toFlags());
+    elementFieldIDs = value.first.getMaxFieldID() + 1;
+    maxFieldID = value.second * elementFieldIDs;
   }
 
   bool operator==(const KeyTy &key) const { return key == value; }
@@ -758,6 +806,12 @@ struct VectorTypeStorage : mlir::TypeStorage {
 
   KeyTy value;
 
+  /// The number of field IDs used by each element, including the element
+  /// itself.  Caching this keeps the field ID computations of nested vectors
+  /// from walking the element types.
+  unsigned elementFieldIDs;
+  unsigned maxFieldID;
+
   /// This holds the bits for the type's recursive properties, and can hold a
   /// pointer to a passive version of the type.
   llvm::PointerIntPair<Type, RecursiveTypeProperties::numBits, unsigned>
@@ -805,19 +859,24 @@ FIRRTLType FVectorType::getPassiveType() {
 }
 
 unsigned FVectorType::getFieldID(unsigned index) {
-  return 1 + index * (getElementType().getMaxFieldID() + 1);
+  return 1 + index * getImpl()->elementFieldIDs;
 }
 
 unsigned FVectorType::getIndexForFieldID(unsigned fieldID) {
   assert(fieldID && "fieldID must be at least 1");
   // Divide the field ID by the number of fieldID's per element.
-  return (fieldID - 1) / (getElementType().getMaxFieldID() + 1);
+  return (fieldID - 1) / getImpl()->elementFieldIDs;
 }
 
-unsigned FVectorType::getMaxFieldID() {
-  return getNumElements() * (getElementType().getMaxFieldID() + 1);
+std::pair<FIRRTLType, unsigned>
+FVectorType::getSubTypeByFieldID(unsigned fieldID) {
+  if (fieldID == 0)
+    return {*this, 0};
+  return {getElementType(), (fieldID - 1) % getImpl()->elementFieldIDs};
 }
 
+unsigned FVectorType::getMaxFieldID() { return getImpl()->maxFieldID; }
+
 std::pair<unsigned, bool> FVectorType::rootChildFieldID(unsigned fieldID,
                                                         unsigned index) {
   auto childRoot = getFieldID(index);
@@ -18,6 +18,10 @@
 #include "mlir/IR/OperationSupport.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
+
+#include <atomic>
 
 namespace json = llvm::json;
 
@@ -197,115 +201,177 @@ static A tryGetAs(DictionaryAttr &dict, DictionaryAttr &root, StringRef key,
   return valueA;
 }
 
-/// Deserialize a JSON value into FIRRTL Annotations.  Annotations are
-/// represented as a Target-keyed arrays of attributes.  The input JSON value is
-/// checked, at runtime, to be an array of objects.  Returns true if successful,
-/// false if unsuccessful.
-bool circt::firrtl::fromJSON(json::Value &value, StringRef circuitTarget,
-                             llvm::StringMap<ArrayAttr> &annotationMap,
-                             json::Path path, MLIRContext *context) {
+/// Examine an Annotation JSON object and return an optional string indicating
+/// the target associated with this annotation.  Erase the target from the JSON
+/// object if a target was found.  Automatically convert any legacy Named
+/// targets to actual Targets.  Note: it is expected that a target may not
+/// exist, e.g., any subclass of firrtl.annotations.NoTargetAnnotation will not
+/// have a target.
+static llvm::Optional<std::string> findAndEraseTarget(json::Object *object,
+                                                      json::Path p) {
+  // If no "target" field exists, then promote the annotation to a
+  // CircuitTarget annotation by returning a target of "~".
+  auto maybeTarget = object->get("target");
+  if (!maybeTarget)
+    return llvm::Optional<std::string>("~");
+
+  // Find the target.
+  auto maybeTargetStr = maybeTarget->getAsString();
+  if (!maybeTargetStr) {
+    p.field("target").report("target must be a string type");
+    return {};
+  }
+  auto canonTargetStr = canonicalizeTarget(maybeTargetStr.getValue());
+  if (!canonTargetStr) {
+    p.field("target").report("invalid target string");
+    return {};
+  }
 
-  /// Examine an Annotation JSON object and return an optional string indicating
-  /// the target associated with this annotation.  Erase the target from the
-  /// JSON object if a target was found.  Automatically convert any legacy Named
-  /// targets to actual Targets.  Note: it is expected that a target may not
-  /// exist, e.g., any subclass of firrtl.annotations.NoTargetAnnotation will
-  /// not have a target.
-  auto findAndEraseTarget = [](json::Object *object,
-                               json::Path p) -> llvm::Optional<std::string> {
-    // If no "target" field exists, then promote the annotation to a
-    // CircuitTarget annotation by returning a target of "~".
-    auto maybeTarget = object->get("target");
-    if (!maybeTarget)
-      return llvm::Optional<std::string>("~");
-
-    // Find the target.
-    auto maybeTargetStr = maybeTarget->getAsString();
-    if (!maybeTargetStr) {
-      p.field("target").report("target must be a string type");
-      return {};
-    }
-    auto canonTargetStr = canonicalizeTarget(maybeTargetStr.getValue());
-    if (!canonTargetStr) {
-      p.field("target").report("invalid target string");
-      return {};
-    }
+  auto target = canonTargetStr.getValue();
+
+  // Allow targets through that are instance targets.  Error on anything which
+  // is actually non-local.  E.g., this is allowing:
+  //     ~Foo|Foo/bar:Bar
+  // But, this is disallowing:
+  //     ~Foo|Foo/bar:Bar/baz:Baz
+  bool unsupported = std::count_if(target.begin(), target.end(), [](char a) {
+                       return a == '/' || a == ':';
+                     }) > 2;
+  if (unsupported) {
+    p.field("target").report("unsupported non-local target");
+    return {};
+  }
 
-    auto target = canonTargetStr.getValue();
-
-    // Allow targets through that are instance targets.  Error on anything which
-    // is actually non-local.  E.g., this is allowing:
-    //     ~Foo|Foo/bar:Bar
-    // But, this is disallowing:
-    //     ~Foo|Foo/bar:Bar/baz:Baz
-    bool unsupported = std::count_if(target.begin(), target.end(), [](char a) {
-                         return a == '/' || a == ':';
-                       }) > 2;
-    if (unsupported) {
-      p.field("target").report("unsupported non-local target");
-      return {};
-    }
+  // Remove the target field from the annotation and return the target.
+  object->erase("target");
+  return llvm::Optional<std::string>(target);
+}
 
-    // Remove the target field from the annotation and return the target.
-    object->erase("target");
-    return llvm::Optional<std::string>(target);
-  };
+/// Convert arbitrary JSON to an MLIR Attribute.
+static Attribute convertJSONToAttribute(json::Value &value, json::Path p,
+                                        MLIRContext *context) {
+  // String or quoted JSON
+  if (auto a = value.getAsString()) {
+    // Test to see if this might be quoted JSON (a string that is actually
+    // JSON).  Sometimes FIRRTL developers will do this to serialize objects
+    // that the Scala FIRRTL Compiler doesn't know about.
+    auto unquotedValue = json::parse(a.getValue());
+    auto err = unquotedValue.takeError();
+    // If this parsed without an error, then it's more JSON and recurse on
+    // that.
+    if (!err)
+      return convertJSONToAttribute(unquotedValue.get(), p, context);
+    // If there was an error, then swallow it and handle this as a string.
+    handleAllErrors(std::move(err), [&](const json::ParseError &a) {});
+    return StringAttr::get(context, a.getValue());
+  }
 
-  /// Convert arbitrary JSON to an MLIR Attribute.
-  std::function<Attribute(json::Value &, json::Path)> convertJSONToAttribute =
-      [&](json::Value &value, json::Path p) -> Attribute {
-    // String or quoted JSON
-    if (auto a = value.getAsString()) {
-      // Test to see if this might be quoted JSON (a string that is actually
-      // JSON).  Sometimes FIRRTL developers will do this to serialize objects
-      // that the Scala FIRRTL Compiler doesn't know about.
-      auto unquotedValue = json::parse(a.getValue());
-      auto err = unquotedValue.takeError();
-      // If this parsed without an error, then it's more JSON and recurse on
-      // that.
-      if (!err)
-        return convertJSONToAttribute(unquotedValue.get(), p);
-      // If there was an error, then swallow it and handle this as a string.
-      handleAllErrors(std::move(err), [&](const json::ParseError &a) {});
-      return StringAttr::get(context, a.getValue());
-    }
+  // Integer
+  if (auto a = value.getAsInteger())
+    return IntegerAttr::get(IntegerType::get(context, 64), a.getValue());
+
+  // Float
+  if (auto a = value.getAsNumber())
+    return FloatAttr::get(mlir::FloatType::getF64(context), a.getValue());
+
+  // Boolean
+  if (auto a = value.getAsBoolean())
+    return BoolAttr::get(context, a.getValue());
+
+  // Null
+  if (auto a = value.getAsNull())
+    return mlir::UnitAttr::get(context);
 
-    // Integer
-    if (auto a = value.getAsInteger())
-      return IntegerAttr::get(IntegerType::get(context, 64), a.getValue());
-
-    // Float
-    if (auto a = value.getAsNumber())
-      return FloatAttr::get(mlir::FloatType::getF64(context), a.getValue());
-
-    // Boolean
-    if (auto a = value.getAsBoolean())
-      return BoolAttr::get(context, a.getValue());
-
-    // Null
-    if (auto a = value.getAsNull())
-      return mlir::UnitAttr::get(context);
-
-    // Object
-    if (auto a = value.getAsObject()) {
-      NamedAttrList metadata;
-      for (auto b : *a)
-        metadata.append(b.first,
-                        convertJSONToAttribute(b.second, p.field(b.first)));
-      return DictionaryAttr::get(context, metadata);
+  // Object
+  if (auto a = value.getAsObject()) {
+    NamedAttrList metadata;
+    for (auto b : *a)
+      metadata.append(b.first, convertJSONToAttribute(b.second,
+                                                      p.field(b.first), context));
+    return DictionaryAttr::get(context, metadata);
+  }
+
+  // Array
+  if (auto a = value.getAsArray()) {
+    SmallVector<Attribute> metadata;
+    for (size_t i = 0, e = (*a).size(); i != e; ++i)
+      metadata.push_back(convertJSONToAttribute((*a)[i], p.index(i), context));
+    return ArrayAttr::get(context, metadata);
+  }
+
+  llvm_unreachable("Impossible unhandled JSON type");
+}
+
+/// A mutable map of Target to the Annotations applied to it.
+using MutableAnnotationMap = llvm::StringMap<llvm::SmallVector<Attribute>>;
+
+/// Convert one element of the annotation array into an Annotation and append
+/// it to the map under its target.  Returns true if successful, false if
+/// unsuccessful.
+static bool convertAnnotation(json::Value &value, StringRef circuitTarget,
+                              MutableAnnotationMap &annotationMap,
+                              json::Path p, MLIRContext *context) {
+  auto object = value.getAsObject();
+  if (!object) {
+    p.report("Expected annotations to be an array of objects, but found an "
+             "array of something else.");
+    return false;
+  }
+  // Find and remove the "target" field from the Annotation object if it
+  // exists.  In the FIRRTL Dialect, the target will be implicitly specified
+  // based on where the attribute is applied.
+  auto optTarget = findAndEraseTarget(object, p);
+  if (!optTarget)
+    return false;
+  StringRef targetStrRef = optTarget.getValue();
+
+  if (targetStrRef != "~") {
+    auto circuitFieldEnd = targetStrRef.find_first_of('|');
+    if (circuitTarget != targetStrRef.take_front(circuitFieldEnd)) {
+      p.report("annotation has invalid circuit name");
+      return false;
     }
+  }
+
+  // Build up the Attribute to represent the Annotation and store it in the
+  // global Target -> Attribute mapping.
+  NamedAttrList metadata;
+  // Annotations on the element instance.
+  targetStrRef = splitAndAppendTarget(metadata, targetStrRef, context).first;
 
-    // Array
-    if (auto a = value.getAsArray()) {
-      SmallVector<Attribute> metadata;
-      for (size_t i = 0, e = (*a).size(); i != e; ++i)
-        metadata.push_back(convertJSONToAttribute((*a)[i], p.index(i)));
-      return ArrayAttr::get(context, metadata);
+  for (auto field : *object) {
+    if (auto value = convertJSONToAttribute(field.second, p, context)) {
+      metadata.append(field.first, value);
+      continue;
     }
+    return false;
+  }
+  annotationMap[targetStrRef].push_back(DictionaryAttr::get(context, metadata));
+  return true;
+}
 
-    llvm_unreachable("Impossible unhandled JSON type");
-  };
+/// Append the contents of a mutable annotation map to the result map.
+static void mergeAnnotationMap(MutableAnnotationMap &mutableAnnotationMap,
+                               llvm::StringMap<ArrayAttr> &annotationMap,
+                               MLIRContext *context) {
+  // Convert the mutable Annotation map to a SmallVector<ArrayAttr>.
+  for (auto a : mutableAnnotationMap.keys()) {
+    // If multiple annotations on a single object, then append it.
+    if (annotationMap.count(a))
+      for (auto attr : annotationMap[a])
+        mutableAnnotationMap[a].push_back(attr);
+
+    annotationMap[a] = ArrayAttr::get(context, mutableAnnotationMap[a]);
+  }
+}
 
+/// Deserialize a JSON value into FIRRTL Annotations.  Annotations are
+/// represented as a Target-keyed arrays of attributes.  The input JSON value is
+/// checked, at runtime, to be an array of objects.  Returns true if successful,
+/// false if unsuccessful.
+bool circt::firrtl::fromJSON(json::Value &value, StringRef circuitTarget,
+                             llvm::StringMap<ArrayAttr> &annotationMap,
+                             json::Path path, MLIRContext *context) {
   // The JSON value must be an array of objects.  Anything else is reported as
   // invalid.
   auto array = value.getAsArray();
@@ -316,58 +382,129 @@ bool circt::firrtl::fromJSON(json::Value &value, StringRef circuitTarget,
   }
 
   // Build a mutable map of Target to Annotation.
-  llvm::StringMap<llvm::SmallVector<Attribute>> mutableAnnotationMap;
-  for (size_t i = 0, e = (*array).size(); i != e; ++i) {
-    auto object = (*array)[i].getAsObject();
-    auto p = path.index(i);
-    if (!object) {
-      p.report("Expected annotations to be an array of objects, but found an "
-               "array of something else.");
-      return false;
-    }
-    // Find and remove the "target" field from the Annotation object if it
-    // exists.  In the FIRRTL Dialect, the target will be implicitly specified
-    // based on where the attribute is applied.
-    auto optTarget = findAndEraseTarget(object, p);
-    if (!optTarget)
+  MutableAnnotationMap mutableAnnotationMap;
+  for (size_t i = 0, e = (*array).size(); i != e; ++i)
+    if (!convertAnnotation((*array)[i], circuitTarget, mutableAnnotationMap,
+                           path.index(i), context))
       return false;
-    StringRef targetStrRef = optTarget.getValue();
 
-    if (targetStrRef != "~") {
-      auto circuitFieldEnd = targetStrRef.find_first_of('|');
-      if (circuitTarget != targetStrRef.take_front(circuitFieldEnd)) {
-        p.report("annotation has invalid circuit name");
+  mergeAnnotationMap(mutableAnnotationMap, annotationMap, context);
+  return true;
+}
+
+/// Split the text of a top-level JSON array into the text of its elements,
+/// without building a DOM.  This only tracks nesting and strings; the
+/// elements themselves are validated when they are parsed.  Returns false if
+/// the text does not look like a well formed array.
+static bool splitJSONArray(StringRef text, SmallVectorImpl<StringRef> &elts) {
+  text = text.trim();
+  if (!text.consume_front("[") || !text.consume_back("]"))
+    return false;
+
+  unsigned depth = 0;
+  bool inString = false;
+  size_t eltStart = 0;
+  for (size_t i = 0, e = text.size(); i != e; ++i) {
+    char c = text[i];
+    if (inString) {
+      if (c == '\\')
+        ++i;
+      else if (c == '"')
+        inString = false;
+      continue;
+    }
+    switch (c) {
+    case '"':
+      inString = true;
+      break;
+    case '[':
+    case '{':
+      ++depth;
+      break;
+    case ']':
+    case '}':
+      if (depth == 0)
         return false;
-      }
+      --depth;
+      break;
+    case ',':
+      if (depth != 0)
+        break;
+      elts.push_back(text.slice(eltStart, i).trim());
+      if (elts.back().empty())
+        return false;
+      eltStart = i + 1;
+      break;
     }
+  }
+  if (inString || depth != 0)
+    return false;
 
-    // Build up the Attribute to represent the Annotation and store it in the
-    // global Target -> Attribute mapping.
-    NamedAttrList metadata;
-    // Annotations on the element instance.
-    targetStrRef = splitAndAppendTarget(metadata, targetStrRef, context).first;
+  auto last = text.substr(eltStart).trim();
+  if (last.empty())
+    return elts.empty();
+  elts.push_back(last);
+  return true;
+}
 
-    for (auto field : *object) {
-      if (auto value = convertJSONToAttribute(field.second, p)) {
-        metadata.append(field.first, value);
-        continue;
+/// Deserialize the text of an annotation file into FIRRTL Annotations without
+/// holding the DOM of the whole file.  Each element of the top-level array is
+/// parsed and converted on its own, in parallel if the context allows it, into
+/// per-chunk maps that are merged in file order.  Returns false if anything
+/// went wrong; no diagnostics are produced, and the caller is expected to use
+/// the DOM based fromJSON to report the problem.
+bool circt::firrtl::fromJSONText(StringRef text, StringRef circuitTarget,
+                                 llvm::StringMap<ArrayAttr> &annotationMap,
+                                 MLIRContext *context) {
+  SmallVector<StringRef> elts;
+  if (!splitJSONArray(text, elts))
+    return false;
+
+  // Each chunk covers a contiguous run of elements, so merging the chunks in
+  // order preserves the order of annotations on each target.
+  const size_t chunkSize = 256;
+  size_t numChunks = llvm::divideCeil(elts.size(), chunkSize);
+  std::vector<MutableAnnotationMap> chunkMaps(numChunks);
+  std::atomic<bool> anyFailed{false};
+
+  auto convertChunk = [&](size_t chunk) {
+    auto &chunkMap = chunkMaps[chunk];
+    size_t end = std::min(elts.size(), (chunk + 1) * chunkSize);
+    for (size_t i = chunk * chunkSize; i != end && !anyFailed; ++i) {
+      auto value = json::parse(elts[i]);
+      if (!value) {
+        llvm::consumeError(value.takeError());
+        anyFailed = true;
+        return;
+      }
+      json::Path::Root root;
+      if (!convertAnnotation(value.get(), circuitTarget, chunkMap, root,
+                             context)) {
+        anyFailed = true;
+        return;
       }
-      return false;
     }
-    mutableAnnotationMap[targetStrRef].push_back(
-        DictionaryAttr::get(context, metadata));
-  }
+  };
 
-  // Convert the mutable Annotation map to a SmallVector<ArrayAttr>.
-  for (auto a : mutableAnnotationMap.keys()) {
-    // If multiple annotations on a single object, then append it.
-    if (annotationMap.count(a))
-      for (auto attr : annotationMap[a])
-        mutableAnnotationMap[a].push_back(attr);
+  if (context->isMultithreadingEnabled())
+    llvm::parallelForEachN(0, numChunks, convertChunk);
+  else
+    for (size_t chunk = 0; chunk != numChunks; ++chunk)
+      convertChunk(chunk);
+  if (anyFailed)
+    return false;
 
-    annotationMap[a] = ArrayAttr::get(context, mutableAnnotationMap[a]);
+  MutableAnnotationMap mutableAnnotationMap;
+  for (auto &chunkMap : chunkMaps) {
+    for (auto &entry : chunkMap) {
+      auto &annos = mutableAnnotationMap[entry.getKey()];
+      annos.append(entry.getValue().begin(), entry.getValue().end());
+    }
+    // Release each chunk as soon as it has been merged.
+    chunkMap.clear();
   }
 
+  mergeAnnotationMap(mutableAnnotationMap, annotationMap, context);
   return true;
 }
 
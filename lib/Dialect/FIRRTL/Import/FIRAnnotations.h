@@ -34,6 +34,12 @@ bool fromJSON(llvm::json::Value &value, StringRef circuitTarget,
               llvm::StringMap<ArrayAttr> &annotationMap, llvm::json::Path path,
               MLIRContext *context);
 
+/// Deserialize the text of a JSON annotation array without building a DOM for
+/// the whole array.  Returns false without emitting diagnostics on failure.
+bool fromJSONText(StringRef text, StringRef circuitTarget,
+                  llvm::StringMap<ArrayAttr> &annotationMap,
+                  MLIRContext *context);
+
 bool scatterCustomAnnotations(llvm::StringMap<ArrayAttr> &annotationMap,
                               MLIRContext *context, unsigned &annotationID,
                               Location loc);
@@ -16,6 +16,7 @@
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstring>
 
 using namespace circt;
 using namespace firrtl;
@@ -26,6 +27,15 @@ using llvm::SourceMgr;
 #define isdigit(x) DO_NOT_USE_SLOW_CTYPE_FUNCTIONS
 #define isalpha(x) DO_NOT_USE_SLOW_CTYPE_FUNCTIONS
 
+/// Return a pointer to the first character at or after `ptr` that is one of
+/// `stopChars` or a nul character.  Long runs of uninteresting characters are
+/// skipped with libc's strcspn, which is vectorized on all of our hosts.  This
+/// relies on the buffer being nul terminated, which llvm::MemoryBuffer
+/// guarantees.
+static const char *findFirstOf(const char *ptr, const char *stopChars) {
+  return ptr + strcspn(ptr, stopChars);
+}
+
 //===----------------------------------------------------------------------===//
 // FIRToken
 //===----------------------------------------------------------------------===//
@@ -228,14 +238,19 @@ FIRToken FIRLexer::lexTokenImpl() {
 
       LLVM_FALLTHROUGH; // Treat as whitespace.
 
-    case ' ':
-    case '\t':
     case '\n':
     case '\r':
-    case ',':
       // Handle whitespace.
       continue;
 
+    case ' ':
+    case '\t':
+    case ',':
+      // Indentation produces long runs of horizontal whitespace, skip them in
+      // one go.
+      curPtr += strspn(curPtr, " \t,");
+      continue;
+
     case '_':
       // Handle identifiers.
       return lexIdentifierOrKeyword(tokStart);
@@ -312,6 +327,7 @@ FIRToken FIRLexer::lexTokenImpl() {
 ///
 FIRToken FIRLexer::lexFileInfo(const char *tokStart) {
   while (1) {
+    curPtr = findFirstOf(curPtr, "]\\\n\v\f");
     switch (*curPtr++) {
     case ']': // This is the end of the fileinfo literal.
       return formToken(FIRToken::fileinfo, tokStart);
@@ -414,6 +430,7 @@ FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
 /// Skip a comment line, starting with a ';' and going to end of line.
 void FIRLexer::skipComment() {
   while (true) {
+    curPtr = findFirstOf(curPtr, "\n\r");
     switch (*curPtr++) {
     case '\n':
     case '\r':
@@ -117,6 +117,15 @@ public:
   /// Get an opaque pointer into the lexer state that can be restored later.
   FIRLexerCursor getCursor() const;
 
+  /// Move the lexer to the specified position in the buffer and lex the token
+  /// found there.  The pointer must be at a token boundary in this buffer.
+  void resetPointer(const char *newPointer) {
+    assert(newPointer >= curBuffer.begin() && newPointer <= curBuffer.end() &&
+           "pointer outside of the lexer buffer");
+    curPtr = newPointer;
+    lexToken();
+  }
+
 private:
   FIRToken lexTokenImpl();
 
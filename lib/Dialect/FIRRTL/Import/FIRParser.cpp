@@ -20,18 +20,29 @@
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
-#include "mlir/IR/Verifier.h"
+#include "mlir/Support/Timing.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/PointerEmbeddedInt.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/JSON.h"
 #include "llvm/Support/Parallel.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <future>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define DEBUG_TYPE "firrtl-parser"
+
 using namespace circt;
 using namespace firrtl;
 
@@ -41,6 +52,11 @@ using mlir::LocationAttr;
 
 namespace json = llvm::json;
 
+STATISTIC(numNameAttrCacheHits, "Names resolved from a module's name cache");
+STATISTIC(numNameAttrCacheMisses, "Names uniqued in the MLIRContext");
+STATISTIC(numConstantsCreated, "Constant ops created for integer literals");
+STATISTIC(numConstantsReused, "Integer literals that reused a constant op");
+
 /// Return true if this is a useless temporary name produced by FIRRTL.  We
 /// drop these as they don't convey semantic meaning.
 static bool isUselessName(StringRef name) {
@@ -79,6 +95,30 @@ static bool hasAnnotation(ArrayAttr annotations, DictionaryAttr annotation) {
   return llvm::is_contained(annotations, annotation);
 }
 
+/// The access pattern the parser is about to use on its input buffer.
+enum class BufferAccess { Sequential, Random };
+
+/// Tell the OS how we are about to walk the specified buffer.  The skim over
+/// the circuit touches every page in order, but the deferred module bodies are
+/// parsed in parallel and hop all over the file.  This is only a hint, and is
+/// only meaningful for memory mapped buffers, so failures are ignored.
+static void adviseBufferAccess(const llvm::MemoryBuffer *buffer,
+                               BufferAccess access) {
+#if defined(LLVM_ON_UNIX) && defined(MADV_SEQUENTIAL)
+  if (buffer->getBufferKind() != llvm::MemoryBuffer::MemoryBuffer_MMap)
+    return;
+
+  // madvise requires a page aligned start address.
+  auto pageSize = uintptr_t(::sysconf(_SC_PAGESIZE));
+  auto start = uintptr_t(buffer->getBufferStart());
+  auto alignedStart = start & ~(pageSize - 1);
+  auto length = uintptr_t(buffer->getBufferEnd()) - alignedStart;
+  ::madvise(reinterpret_cast<void *>(alignedStart), length,
+            access == BufferAccess::Sequential ? MADV_SEQUENTIAL
+                                               : MADV_RANDOM);
+#endif
+}
+
 //===----------------------------------------------------------------------===//
 // SharedParserConstants
 //===----------------------------------------------------------------------===//
@@ -415,28 +455,23 @@ private:
   Optional<Location> infoLoc;
 };
 
-/// Parse an @info marker if present.  If so, fill in the specified Location,
-/// if not, ignore it.
-ParseResult FIRParser::parseOptionalInfoLocator(LocationAttr &result) {
-  if (getToken().isNot(FIRToken::fileinfo))
-    return success();
-
-  auto loc = getToken().getLoc();
-
-  // See if we can parse this token into a File/Line/Column record.  If not,
-  // just ignore it with a warning.
-  auto unknownFormat = [&]() -> ParseResult {
-    mlir::emitWarning(translateLocation(loc),
-                      "ignoring unknown @ info record format");
-    return success();
-  };
-
-  auto spelling = getTokenSpelling();
-  consumeToken(FIRToken::fileinfo);
+namespace {
+/// A single file/line/column record decoded from an info locator.
+struct InfoLocatorRecord {
+  StringRef filename;
+  unsigned lineNo, columnNo;
+};
+} // end anonymous namespace
 
-  // The spelling of the token looks something like "@[Decoupled.scala 221:8]".
+/// Decode the spelling of a fileinfo token, which looks something like
+/// "@[Decoupled.scala 221:8]", into its file/line/column records.  Compound
+/// locators produce multiple records, in the order they are written.  This
+/// returns failure if the locator has an unknown format.
+static LogicalResult
+decodeInfoLocator(StringRef spelling,
+                  SmallVectorImpl<InfoLocatorRecord> &records) {
   if (!spelling.startswith("@[") || !spelling.endswith("]"))
-    return unknownFormat();
+    return failure();
 
   spelling = spelling.drop_front(2).drop_back(1);
 
@@ -477,13 +512,74 @@ ParseResult FIRParser::parseOptionalInfoLocator(LocationAttr &result) {
   unsigned lineNo = 0, columnNo = 0;
   StringRef filename = decodeLocator(spelling, lineNo, columnNo);
   if (filename.empty())
-    return unknownFormat();
+    return failure();
+
+  // Compound locators will be combined with spaces, like:
+  //  @[Foo.scala 123:4 Bar.scala 309:14]
+  // and at this point will be parsed as a-long-string-with-two-spaces at
+  // 309:14.   We'd like to parse this into two things and represent it as an
+  // MLIR fused locator, but we want to be conservatively safe for filenames
+  // that have a space in it.  As such, we are careful to make sure we can
+  // decode the filename/loc of the result.  If so, we accumulate results,
+  // backward, in the record list.
+  auto spaceLoc = filename.find_last_of(' ');
+  while (spaceLoc != StringRef::npos) {
+    // Try decoding the thing before the space.  Validates that there is another
+    // space and that the file/line can be decoded in that substring.
+    unsigned nextLineNo = 0, nextColumnNo = 0;
+    auto nextFilename =
+        decodeLocator(filename.take_front(spaceLoc), nextLineNo, nextColumnNo);
+
+    // On failure we didn't have a joined locator.
+    if (nextFilename.empty())
+      break;
+
+    // On success, remember what we already parsed (Bar.Scala / 309:14), and
+    // move on to the next chunk.
+    records.push_back({filename.drop_front(spaceLoc + 1), lineNo, columnNo});
+    filename = nextFilename;
+    lineNo = nextLineNo;
+    columnNo = nextColumnNo;
+    spaceLoc = filename.find_last_of(' ');
+  }
+
+  records.push_back({filename, lineNo, columnNo});
+  std::reverse(records.begin(), records.end());
+  return success();
+}
+
+/// Parse an @info marker if present.  If so, fill in the specified Location,
+/// if not, ignore it.
+ParseResult FIRParser::parseOptionalInfoLocator(LocationAttr &result) {
+  if (getToken().isNot(FIRToken::fileinfo))
+    return success();
+
+  auto loc = getToken().getLoc();
+
+  auto spelling = getTokenSpelling();
+  consumeToken(FIRToken::fileinfo);
+
+  // See if we can parse this token into a File/Line/Column record.  If not,
+  // just ignore it with a warning.
+  SmallVector<InfoLocatorRecord, 2> records;
+  if (failed(decodeInfoLocator(spelling, records))) {
+    mlir::emitWarning(translateLocation(loc),
+                      "ignoring unknown @ info record format");
+    return success();
+  }
 
   // If info locators are ignored, don't actually apply them.  We still do all
   // the verification above though.
   if (constants.options.ignoreInfoLocators)
     return success();
 
+  // If info locators are lazy, just remember where the locator is.  It gets
+  // decoded by materializeInfoLocator if anyone asks for it.
+  if (constants.options.lazyInfoLocators) {
+    result = OpaqueLoc::get(spelling.data(), getContext());
+    return success();
+  }
+
   /// Return an FileLineColLoc for the specified location, but use a bit of
   /// caching to reduce thrasing the MLIRContext.
   auto getFileLineColLoc = [&](StringRef filename, unsigned lineNo,
@@ -510,44 +606,17 @@ ParseResult FIRParser::parseOptionalInfoLocator(LocationAttr &result) {
                FileLineColLoc::get(filenameId, lineNo, columnNo);
   };
 
-  // Compound locators will be combined with spaces, like:
-  //  @[Foo.scala 123:4 Bar.scala 309:14]
-  // and at this point will be parsed as a-long-string-with-two-spaces at
-  // 309:14.   We'd like to parse this into two things and represent it as an
-  // MLIR fused locator, but we want to be conservatively safe for filenames
-  // that have a space in it.  As such, we are careful to make sure we can
-  // decode the filename/loc of the result.  If so, we accumulate results,
-  // backward, in this vector.
-  SmallVector<Location> extraLocs;
-  auto spaceLoc = filename.find_last_of(' ');
-  while (spaceLoc != StringRef::npos) {
-    // Try decoding the thing before the space.  Validates that there is another
-    // space and that the file/line can be decoded in that substring.
-    unsigned nextLineNo = 0, nextColumnNo = 0;
-    auto nextFilename =
-        decodeLocator(filename.take_front(spaceLoc), nextLineNo, nextColumnNo);
-
-    // On failure we didn't have a joined locator.
-    if (nextFilename.empty())
-      break;
-
-    // On success, remember what we already parsed (Bar.Scala / 309:14), and
-    // move on to the next chunk.
-    auto loc =
-        getFileLineColLoc(filename.drop_front(spaceLoc + 1), lineNo, columnNo);
-    extraLocs.push_back(loc);
-    filename = nextFilename;
-    lineNo = nextLineNo;
-    columnNo = nextColumnNo;
-    spaceLoc = filename.find_last_of(' ');
+  if (records.size() == 1) {
+    auto &record = records.front();
+    result = getFileLineColLoc(record.filename, record.lineNo, record.columnNo);
+    return success();
   }
 
-  result = getFileLineColLoc(filename, lineNo, columnNo);
-  if (!extraLocs.empty()) {
-    extraLocs.push_back(result);
-    std::reverse(extraLocs.begin(), extraLocs.end());
-    result = FusedLoc::get(getContext(), extraLocs);
-  }
+  SmallVector<Location> locs;
+  for (auto &record : records)
+    locs.push_back(
+        getFileLineColLoc(record.filename, record.lineNo, record.columnNo));
+  result = FusedLoc::get(getContext(), locs);
   return success();
 }
 
@@ -1174,15 +1243,44 @@ struct FIRModuleContext : public FIRParser {
                             std::string moduleTarget)
       : FIRParser(constants, lexer), moduleTarget(std::move(moduleTarget)) {}
 
+  ~FIRModuleContext() {
+    numNameAttrCacheHits += nameAttrCacheHits;
+    numNameAttrCacheMisses += nameAttrCacheMisses;
+    numConstantsCreated += constantsCreated;
+    numConstantsReused += constantsReused;
+  }
+
   /// This is the module target used by annotations referring to this module.
   std::string moduleTarget;
 
+  /// Return a StringAttr for the specified name.  Each module body is parsed
+  /// by a single thread, so repeated names are served from this module local
+  /// cache instead of going through the MLIRContext's locked uniquer.
+  StringAttr getNameAttr(StringRef name) {
+    auto &entry = nameAttrCache[name];
+    if (entry) {
+      ++nameAttrCacheHits;
+      return entry;
+    }
+    ++nameAttrCacheMisses;
+    return entry = StringAttr::get(getContext(), name);
+  }
+
   // The expression-oriented nature of firrtl syntax produces tons of constant
   // nodes which are obviously redundant.  Instead of literally producing them
   // in the parser, do an implicit CSE to reduce parse time and silliness in the
   // resulting IR.
   llvm::DenseMap<std::pair<Attribute, Type>, Value> constantCache;
 
+  /// The same constants are usually spelled the same way, so we also cache
+  /// them by the spelling of the literal, from the `UInt`/`SInt` keyword to the
+  /// end of the value.  This avoids decoding the value and uniquing its
+  /// attribute and type for every repeated literal.
+  llvm::DenseMap<StringRef, Value> constantSpellingCache;
+
+  /// Statistics about the constant caches, flushed when the module is done.
+  unsigned constantsCreated = 0, constantsReused = 0;
+
   /// Add a symbol entry with the specified name, returning failure if the name
   /// is already defined.
   ParseResult addSymbolEntry(StringRef name, SymbolValueEntry entry, SMLoc loc,
@@ -1251,6 +1349,12 @@ private:
   /// list.  This allows us to "pop" the entries by resetting them to null when
   /// scope is exited.
   std::vector<ModuleSymbolTableEntry *> *currentScopeCollector = nullptr;
+
+  /// The names uniqued by this module, and statistics about their reuse.  The
+  /// counts are accumulated locally and flushed to the (atomic) global
+  /// statistics when the module is done.
+  llvm::StringMap<StringAttr> nameAttrCache;
+  unsigned nameAttrCacheHits = 0, nameAttrCacheMisses = 0;
 };
 
 } // end anonymous namespace
@@ -1317,7 +1421,7 @@ ParseResult FIRModuleContext::resolveSymbolEntry(Value &result,
     return failure();
   }
 
-  auto fieldAttr = StringAttr::get(getContext(), fieldName);
+  auto fieldAttr = getNameAttr(fieldName);
 
   unsigned unbundledId = entry.get<UnbundledID>() - 1;
   assert(unbundledId < unbundledValues.size());
@@ -1933,10 +2037,28 @@ ParseResult FIRStmtParser::parseIntegerLiteralExp(Value &result) {
 
   // Parse a width specifier if present.
   int64_t width;
-  APInt value;
   if (parseOptionalWidth(width) ||
-      parseToken(FIRToken::l_paren, "expected '(' in integer expression") ||
-      parseIntLit(value, "expected integer value") ||
+      parseToken(FIRToken::l_paren, "expected '(' in integer expression"))
+    return failure();
+
+  // If we've seen this exact literal before, reuse the constant without
+  // decoding it again.
+  auto valueEnd = getToken().getEndLoc().getPointer();
+  StringRef spelling(loc.getPointer(), valueEnd - loc.getPointer());
+  if (getToken().isAny(FIRToken::integer, FIRToken::signed_integer,
+                       FIRToken::string)) {
+    if (auto cached = moduleContext.constantSpellingCache.lookup(spelling)) {
+      consumeToken();
+      if (parseToken(FIRToken::r_paren, "expected ')' in integer expression"))
+        return failure();
+      ++moduleContext.constantsReused;
+      result = cached;
+      return success();
+    }
+  }
+
+  APInt value;
+  if (parseIntLit(value, "expected integer value") ||
       parseToken(FIRToken::r_paren, "expected ')' in integer expression"))
     return failure();
 
@@ -1980,6 +2102,8 @@ ParseResult FIRStmtParser::parseIntegerLiteralExp(Value &result) {
   auto &entry = moduleContext.constantCache[{attr, type}];
   if (entry) {
     // If we already had an entry, reuse it.
+    ++moduleContext.constantsReused;
+    moduleContext.constantSpellingCache[spelling] = entry;
     result = entry;
     return success();
   }
@@ -2000,6 +2124,8 @@ ParseResult FIRStmtParser::parseIntegerLiteralExp(Value &result) {
   locationProcessor.setLoc(loc);
   auto op = builder.create<ConstantOp>(type, value);
   entry = op;
+  moduleContext.constantSpellingCache[spelling] = op;
+  ++moduleContext.constantsCreated;
   result = op;
 
   if (savedIP.isSet())
@@ -2934,7 +3060,8 @@ ParseResult FIRStmtParser::parseNode() {
   // dropped, then we don't even need to create a result unless it is annotated.
   Value result;
   if (!name.empty() || !annotations.empty()) {
-    result = builder.create<NodeOp>(initializer.getType(), initializer, name,
+    result = builder.create<NodeOp>(initializer.getType(), initializer,
+                                    moduleContext.getNameAttr(name),
                                     annotations);
   } else
     result = initializer;
@@ -2963,7 +3090,8 @@ ParseResult FIRStmtParser::parseWire() {
       getAnnotations(getModuleTarget() + ">" + id, startTok.getLoc(), type);
   auto name = hasDontTouch(annotations) ? id : filterUselessName(id);
 
-  auto result = builder.create<WireOp>(type, name, annotations);
+  auto result = builder.create<WireOp>(type, moduleContext.getNameAttr(name),
+                                       annotations);
   return moduleContext.addSymbolEntry(id, result, startTok.getLoc());
 }
 
@@ -3053,12 +3181,13 @@ ParseResult FIRStmtParser::parseRegister(unsigned regIndent) {
       getAnnotations(getModuleTarget() + ">" + id, startTok.getLoc(), type);
   auto name = hasDontTouch(annotations) ? id : filterUselessName(id);
 
+  auto nameAttr = moduleContext.getNameAttr(name);
   Value result;
   if (resetSignal)
     result = builder.create<RegResetOp>(type, clock, resetSignal, resetValue,
-                                        name, annotations);
+                                        nameAttr, annotations);
   else
-    result = builder.create<RegOp>(type, clock, name, annotations);
+    result = builder.create<RegOp>(type, clock, nameAttr, annotations);
 
   return moduleContext.addSymbolEntry(id, result, startTok.getLoc());
 }
@@ -3072,8 +3201,8 @@ namespace {
 /// like circuit and module.
 struct FIRCircuitParser : public FIRParser {
   explicit FIRCircuitParser(SharedParserConstants &state, FIRLexer &lexer,
-                            ModuleOp mlirModule)
-      : FIRParser(state, lexer), mlirModule(mlirModule) {}
+                            ModuleOp mlirModule, mlir::TimingScope &ts)
+      : FIRParser(state, lexer), mlirModule(mlirModule), ts(ts) {}
 
   ParseResult parseCircuit(const llvm::MemoryBuffer *annotationsBuf);
 
@@ -3102,9 +3231,24 @@ private:
 
   ParseResult parseModuleBody(DeferredModuleToParse &deferredModule);
 
+  /// Find the start of every line that looks like a module header.
+  void scanForModuleHeaders();
+
+  /// Advance the lexer past the body of the current module to the next module
+  /// header or the end of the file.
+  void skipToNextModule();
+
   std::vector<DeferredModuleToParse> deferredModules;
+
+  /// The start of each line that begins with a `module` or `extmodule`
+  /// keyword, in buffer order.  These are candidate module headers used to
+  /// skip over module bodies without lexing them.
+  std::vector<const char *> moduleHeaderLines;
   ModuleOp mlirModule;
 
+  /// The scope that the phases of the parser are timed in.
+  mlir::TimingScope &ts;
+
   /// A global identifier that can be used to link multiple annotations
   /// together.  This should be incremented on use.
   unsigned annotationID = 0;
@@ -3115,27 +3259,33 @@ private:
 ParseResult FIRCircuitParser::importAnnotations(SMLoc loc,
                                                 StringRef circuitTarget,
                                                 StringRef annotationsStr) {
-
-  auto annotations = json::parse(annotationsStr);
-  if (auto err = annotations.takeError()) {
-    handleAllErrors(std::move(err), [&](const json::ParseError &a) {
-      auto diag = emitError(loc, "Failed to parse JSON Annotations");
-      diag.attachNote() << a.message();
-    });
-    return failure();
-  }
-
-  json::Path::Root root;
+  // Decode the annotations an element at a time, which never holds the DOM of
+  // the whole file.  If that fails, decode the whole DOM anyways to produce a
+  // diagnostic with the context of the problem.
   llvm::StringMap<ArrayAttr> thisAnnotationMap;
-  if (!fromJSON(annotations.get(), circuitTarget, thisAnnotationMap, root,
-                getContext())) {
-    auto diag = emitError(loc, "Invalid/unsupported annotation format");
-    std::string jsonErrorMessage =
-        "See inline comments for problem area in JSON:\n";
-    llvm::raw_string_ostream s(jsonErrorMessage);
-    root.printErrorContext(annotations.get(), s);
-    diag.attachNote() << jsonErrorMessage;
-    return failure();
+  if (!fromJSONText(annotationsStr, circuitTarget, thisAnnotationMap,
+                    getContext())) {
+    auto annotations = json::parse(annotationsStr);
+    if (auto err = annotations.takeError()) {
+      handleAllErrors(std::move(err), [&](const json::ParseError &a) {
+        auto diag = emitError(loc, "Failed to parse JSON Annotations");
+        diag.attachNote() << a.message();
+      });
+      return failure();
+    }
+
+    json::Path::Root root;
+    thisAnnotationMap.clear();
+    if (!fromJSON(annotations.get(), circuitTarget, thisAnnotationMap, root,
+                  getContext())) {
+      auto diag = emitError(loc, "Invalid/unsupported annotation format");
+      std::string jsonErrorMessage =
+          "See inline comments for problem area in JSON:\n";
+      llvm::raw_string_ostream s(jsonErrorMessage);
+      root.printErrorContext(annotations.get(), s);
+      diag.attachNote() << jsonErrorMessage;
+      return failure();
+    }
   }
 
   if (!scatterCustomAnnotations(thisAnnotationMap, getContext(), annotationID,
@@ -3281,26 +3431,10 @@ ParseResult FIRCircuitParser::parseModule(CircuitOp circuit,
     deferredModules.push_back({moduleOp, portLocs, getLexer().getCursor(),
                                std::move(moduleTarget), indent});
 
-    // We're going to defer parsing this module, so just skip tokens until we
-    // get to the next module or the end of the file.
-    while (true) {
-      switch (getToken().getKind()) {
-
-      // End of file or invalid token will be handled by outer level.
-      case FIRToken::eof:
-      case FIRToken::error:
-        return success();
-
-        // If we got to the next module, then we're done.
-      case FIRToken::kw_module:
-      case FIRToken::kw_extmodule:
-        return success();
-
-      default:
-        consumeToken();
-        break;
-      }
-    }
+    // We're going to defer parsing this module, so just skip ahead to the next
+    // module header, or the end of the file.
+    skipToNextModule();
+    return success();
   }
 
   // Otherwise, handle extmodule specific features like parameters.
@@ -3379,6 +3513,94 @@ ParseResult FIRCircuitParser::parseModule(CircuitOp circuit,
   return success();
 }
 
+/// Return true if the line starting at `ptr` begins with the specified keyword
+/// followed by horizontal whitespace.
+static bool lineStartsWithKeyword(const char *ptr, const char *end,
+                                  StringRef keyword) {
+  while (ptr != end && (*ptr == ' ' || *ptr == '\t' || *ptr == ','))
+    ++ptr;
+  if (size_t(end - ptr) <= keyword.size() ||
+      StringRef(ptr, keyword.size()) != keyword)
+    return false;
+  char next = ptr[keyword.size()];
+  return next == ' ' || next == '\t';
+}
+
+/// Scan the main buffer for lines that start with a module or extmodule
+/// keyword.  Large files are split into chunks that are scanned concurrently.
+/// A chunk owns every line that starts inside of it.
+void FIRCircuitParser::scanForModuleHeaders() {
+  auto &sourceMgr = getLexer().getSourceMgr();
+  StringRef buffer =
+      sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())->getBuffer();
+  const char *bufferStart = buffer.begin(), *bufferEnd = buffer.end();
+
+  auto scanChunk = [&](const char *chunkStart, const char *chunkEnd,
+                       std::vector<const char *> &result) {
+    // Move to the first line that starts in this chunk.
+    const char *ptr = chunkStart;
+    if (ptr != bufferStart && ptr[-1] != '\n') {
+      ptr = static_cast<const char *>(
+          memchr(ptr, '\n', size_t(bufferEnd - ptr)));
+      if (!ptr)
+        return;
+      ++ptr;
+    }
+
+    while (ptr < chunkEnd) {
+      if (lineStartsWithKeyword(ptr, bufferEnd, "module") ||
+          lineStartsWithKeyword(ptr, bufferEnd, "extmodule"))
+        result.push_back(ptr);
+      ptr = static_cast<const char *>(
+          memchr(ptr, '\n', size_t(bufferEnd - ptr)));
+      if (!ptr)
+        return;
+      ++ptr;
+    }
+  };
+
+  // Small files, or single threaded contexts, are scanned in one go.
+  const size_t chunkSize = 1 << 20;
+  size_t numChunks = (buffer.size() + chunkSize - 1) / chunkSize;
+  if (numChunks <= 1 || !getContext()->isMultithreadingEnabled()) {
+    scanChunk(bufferStart, bufferEnd, moduleHeaderLines);
+    return;
+  }
+
+  std::vector<std::vector<const char *>> chunkResults(numChunks);
+  llvm::parallelForEachN(0, numChunks, [&](size_t index) {
+    const char *chunkStart = bufferStart + index * chunkSize;
+    const char *chunkEnd =
+        bufferStart + std::min(buffer.size(), (index + 1) * chunkSize);
+    scanChunk(chunkStart, chunkEnd, chunkResults[index]);
+  });
+
+  for (auto &chunkResult : chunkResults)
+    moduleHeaderLines.insert(moduleHeaderLines.end(), chunkResult.begin(),
+                             chunkResult.end());
+}
+
+void FIRCircuitParser::skipToNextModule() {
+  if (getToken().isAny(FIRToken::kw_module, FIRToken::kw_extmodule,
+                       FIRToken::eof, FIRToken::error))
+    return;
+
+  // Jump to the first module header line after the current token.  The token
+  // at that point is checked by the caller just like any other top level token.
+  const char *curPtr = getToken().getLoc().getPointer();
+  auto it = std::upper_bound(moduleHeaderLines.begin(),
+                             moduleHeaderLines.end(), curPtr);
+  if (it != moduleHeaderLines.end()) {
+    getLexer().resetPointer(*it);
+    return;
+  }
+
+  // Otherwise this is the last module in the file.
+  auto &sourceMgr = getLexer().getSourceMgr();
+  getLexer().resetPointer(
+      sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())->getBufferEnd());
+}
+
 // Parse the body of this module.
 ParseResult
 FIRCircuitParser::parseModuleBody(DeferredModuleToParse &deferredModule) {
@@ -3411,7 +3633,14 @@ FIRCircuitParser::parseModuleBody(DeferredModuleToParse &deferredModule) {
   FIRStmtParser stmtParser(*moduleOp.getBodyBlock(), moduleContext);
 
   // Parse the moduleBlock.
-  return stmtParser.parseSimpleStmtBlock(deferredModule.indent);
+  if (stmtParser.parseSimpleStmtBlock(deferredModule.indent))
+    return failure();
+
+  // Hand the finished module off to the client if they asked for it.
+  auto &callback = getConstants().options.moduleBodyCallback;
+  if (callback && failed(callback(moduleOp)))
+    return failure();
+  return success();
 }
 
 /// file ::= circuit
@@ -3442,10 +3671,21 @@ FIRCircuitParser::parseCircuit(const llvm::MemoryBuffer *annotationsBuf) {
 
   std::string circuitTarget = "~" + name.getValue().str();
 
+  // Locate the module headers up front so that the bodies of modules can be
+  // skipped without lexing them.  This only reads the buffer, so it runs
+  // concurrently with the import of the annotations, which can take a while
+  // for large annotation files.
+  std::future<void> headerScan;
+  bool hasAnnotations = !inlineAnnotations.empty() || annotationsBuf;
+  if (hasAnnotations && getContext()->isMultithreadingEnabled())
+    headerScan =
+        std::async(std::launch::async, [&] { scanForModuleHeaders(); });
+
   // Deal with any inline annotations, if they exist.  These are processed first
   // to place any annotations from an annotation file *after* the inline
   // annotations.  While arbitrary, this makes the annotation file have "append"
   // semantics.
+  auto annotationTimer = ts.nest("Annotations");
   if (!inlineAnnotations.empty())
     if (importAnnotations(inlineAnnotationsLoc, circuitTarget,
                           inlineAnnotations))
@@ -3457,6 +3697,7 @@ FIRCircuitParser::parseCircuit(const llvm::MemoryBuffer *annotationsBuf) {
                           annotationsBuf->getBuffer()))
       return failure();
   }
+  annotationTimer.stop();
 
   OpBuilder b(mlirModule.getBodyRegion());
 
@@ -3470,6 +3711,12 @@ FIRCircuitParser::parseCircuit(const llvm::MemoryBuffer *annotationsBuf) {
   auto circuit = b.create<CircuitOp>(info.getLoc(), name, annotations);
   deferredModules.reserve(16);
 
+  auto headerTimer = ts.nest("Module Headers");
+  if (headerScan.valid())
+    headerScan.wait();
+  else
+    scanForModuleHeaders();
+
   // Parse any contained modules.
   while (true) {
     switch (getToken().getKind()) {
@@ -3505,6 +3752,13 @@ FIRCircuitParser::parseCircuit(const llvm::MemoryBuffer *annotationsBuf) {
   }
 
 DoneParsing:
+  headerTimer.stop();
+  auto bodyTimer = ts.nest("Module Bodies");
+
+  // The module bodies are parsed out of order from here on.
+  auto &sourceMgr = getLexer().getSourceMgr();
+  adviseBufferAccess(sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()),
+                     BufferAccess::Random);
 
   // Now that we've parsed all the prototypes and created all the module ops,
   // go ahead and parse all their bodies.  This can be done in parallel.
@@ -3534,7 +3788,8 @@ DoneParsing:
 // Parse the specified .fir file into the specified MLIR context.
 OwningModuleRef circt::firrtl::importFIRRTL(SourceMgr &sourceMgr,
                                             MLIRContext *context,
-                                            FIRParserOptions options) {
+                                            FIRParserOptions options,
+                                            mlir::TimingScope *ts) {
   auto sourceBuf = sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID());
   const llvm::MemoryBuffer *annotationsBuf = nullptr;
   if (sourceMgr.getNumBuffers() > 1)
@@ -3547,19 +3802,80 @@ OwningModuleRef circt::firrtl::importFIRRTL(SourceMgr &sourceMgr,
       FileLineColLoc::get(context, sourceBuf->getBufferIdentifier(), /*line=*/0,
                           /*column=*/0)));
 
+  // The first pass over the circuit skims the whole file front to back.
+  adviseBufferAccess(sourceBuf, BufferAccess::Sequential);
+
+  mlir::TimingScope defaultScope;
+  auto &parserScope = ts ? *ts : defaultScope;
+
   SharedParserConstants state(context, options);
   FIRLexer lexer(sourceMgr, context);
-  if (FIRCircuitParser(state, lexer, *module).parseCircuit(annotationsBuf))
+  if (FIRCircuitParser(state, lexer, *module, parserScope)
+          .parseCircuit(annotationsBuf))
     return nullptr;
 
   // Make sure the parse module has no other structural problems detected by
-  // the verifier.
-  if (failed(verify(*module)))
-    return {};
+  // the verifier.  The parser only produces circuits, whose modules can be
+  // verified in parallel.
+  auto verifyTimer = parserScope.nest("Verify");
+  for (auto circuit : module->getBody()->getOps<CircuitOp>())
+    if (failed(verifyCircuit(circuit)))
+      return {};
 
   return module;
 }
 
+/// If the specified location is a lazy info locator produced by the parser,
+/// decode it into a FileLineColLoc (or FusedLoc, for compound locators).
+/// Fused locations are decoded recursively.  Other locations are returned
+/// unmodified.
+Location circt::firrtl::materializeInfoLocator(Location loc) {
+  if (auto *start = OpaqueLoc::getUnderlyingLocationOrNull<const char *>(loc)) {
+    // Find the end of the fileinfo token.  The lexer already checked that it
+    // is terminated, and that ']' only appears escaped inside of it.
+    const char *end = start + 2;
+    for (; *end != ']'; ++end)
+      if (*end == '\\' && end[1] == ']')
+        ++end;
+
+    SmallVector<InfoLocatorRecord, 2> records;
+    if (failed(decodeInfoLocator(StringRef(start, end - start + 1), records)))
+      return loc.cast<OpaqueLoc>().getFallbackLocation();
+
+    auto *context = loc->getContext();
+    SmallVector<Location> locs;
+    for (auto &record : records)
+      locs.push_back(FileLineColLoc::get(context, record.filename,
+                                         record.lineNo, record.columnNo));
+    if (locs.size() == 1)
+      return locs.front();
+    return FusedLoc::get(context, locs);
+  }
+
+  if (auto fusedLoc = loc.dyn_cast<FusedLoc>()) {
+    bool changed = false;
+    SmallVector<Location> locs;
+    for (auto subLoc : fusedLoc.getLocations()) {
+      locs.push_back(materializeInfoLocator(subLoc));
+      changed |= locs.back() != subLoc;
+    }
+    if (changed)
+      return FusedLoc::get(loc->getContext(), locs, fusedLoc.getMetadata());
+  }
+
+  return loc;
+}
+
+/// Decode all lazy info locators on operations nested within `root`.
+void circt::firrtl::materializeInfoLocators(Operation *root) {
+  root->walk([](Operation *op) {
+    auto loc = op->getLoc();
+    auto newLoc = materializeInfoLocator(loc);
+    if (newLoc != loc)
+      op->setLoc(newLoc);
+  });
+}
+
 void circt::firrtl::registerFromFIRRTLTranslation() {
   static mlir::TranslateToMLIRRegistration fromFIR(
       "import-firrtl", [](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
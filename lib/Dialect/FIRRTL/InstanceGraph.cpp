@@ -11,14 +11,34 @@
 using namespace circt;
 using namespace firrtl;
 
-InstanceRecord *InstanceGraphNode::recordInstance(InstanceOp instance,
-                                                  InstanceGraphNode *target) {
-  moduleInstances.emplace_back(instance, this, target);
-  return &moduleInstances.back();
+/// Return the name of a module or external module.
+static StringRef getModuleName(Operation *module) {
+  if (auto extModule = dyn_cast<FExtModuleOp>(module))
+    return extModule.getName();
+  return cast<FModuleOp>(module).getName();
+}
+
+void InstanceRecord::setTarget(InstanceGraphNode *newTarget) {
+  target->moduleUses.remove(*this);
+  target = newTarget;
+  target->recordUse(this);
+}
+
+void InstanceRecord::erase() {
+  target->moduleUses.remove(*this);
+  parent->moduleInstances.erase(this);
+}
+
+InstanceRecord *InstanceGraphNode::addInstance(InstanceOp instance,
+                                               InstanceGraphNode *target) {
+  auto *record = new InstanceRecord(instance, this, target);
+  moduleInstances.push_back(record);
+  target->recordUse(record);
+  return record;
 }
 
 void InstanceGraphNode::recordUse(InstanceRecord *record) {
-  moduleUses.push_back(record);
+  moduleUses.push_back(*record);
 }
 
 InstanceGraph::InstanceGraph(Operation *operation) {
@@ -36,29 +56,31 @@ InstanceGraph::InstanceGraph(Operation *operation) {
     if (auto module = dyn_cast<FModuleOp>(op)) {
       auto *currentNode = getOrAddNode(module.getName());
       currentNode->module = module;
-      // Find all instance operations in the module body.
-      module.body().walk([&](InstanceOp instanceOp) {
-        // Add an edge to indicate that this module instantiates the target.
-        auto *targetNode = getOrAddNode(instanceOp.moduleName());
-        auto *instanceRecord =
-            currentNode->recordInstance(instanceOp, targetNode);
-        targetNode->recordUse(instanceRecord);
-      });
+      addInstances(module, currentNode);
     }
   }
 }
 
+void InstanceGraph::addInstances(FModuleOp module, InstanceGraphNode *node) {
+  // Find all instance operations in the module body.
+  module.body().walk([&](InstanceOp instanceOp) {
+    // Add an edge to indicate that this module instantiates the target.
+    auto *targetNode = getOrAddNode(instanceOp.moduleName());
+    node->addInstance(instanceOp, targetNode);
+  });
+}
+
 InstanceGraphNode *InstanceGraph::getTopLevelNode() {
-  // The graph always puts the top level module in the array first.
-  if (!nodes.size())
+  // The graph always puts the top level module in the list first.
+  if (nodes.empty())
     return nullptr;
-  return &nodes[0];
+  return &nodes.front();
 }
 
 InstanceGraphNode *InstanceGraph::lookup(StringRef name) {
   auto it = nodeMap.find(name);
   assert(it != nodeMap.end() && "Module not in InstanceGraph!");
-  return &nodes[it->second];
+  return it->second;
 }
 
 InstanceGraphNode *InstanceGraph::lookup(Operation *op) {
@@ -74,18 +96,183 @@ InstanceGraphNode *InstanceGraph::lookup(Operation *op) {
 InstanceGraphNode *InstanceGraph::getOrAddNode(StringRef name) {
   // Try to insert an InstanceGraphNode. If its not inserted, it returns
   // an iterator pointing to the node.
-  auto itAndInserted = nodeMap.try_emplace(name, 0);
-  auto &index = itAndInserted.first->second;
+  auto itAndInserted = nodeMap.try_emplace(name, nullptr);
+  auto *&node = itAndInserted.first->second;
   if (itAndInserted.second) {
     // This is a new node, we have to add an element to the NodeVec.
-    nodes.emplace_back();
-    // Store the node storage index in to the map.
-    index = nodes.size() - 1;
-    return &nodes.back();
+    node = new InstanceGraphNode();
+    nodes.push_back(node);
   }
-  return &nodes[index];
+  return node;
 }
 
 Operation *InstanceGraph::getReferencedModule(InstanceOp op) {
   return lookup(op.moduleName())->getModule();
 }
+
+InstanceGraphNode *InstanceGraph::addModule(Operation *module) {
+  auto *node = getOrAddNode(getModuleName(module));
+  assert(!node->module && "module is already in the InstanceGraph");
+  node->module = module;
+  if (auto fmodule = dyn_cast<FModuleOp>(module))
+    addInstances(fmodule, node);
+  return node;
+}
+
+void InstanceGraph::erase(InstanceGraphNode *node) {
+  assert(node->noUses() && "cannot erase a module which is instantiated");
+  while (!node->moduleInstances.empty())
+    node->moduleInstances.front().erase();
+
+  // The top level node is found by its position, so it can't be erased.
+  assert(node != getTopLevelNode() && "cannot erase the top level module");
+  nodeMap.erase(getModuleName(node->getModule()));
+  nodes.erase(node);
+}
+
+void InstanceGraph::replaceInstance(InstanceOp instance,
+                                    InstanceOp newInstance) {
+  auto *parent = lookup(instance->getParentOfType<FModuleOp>());
+  for (auto *record : *parent) {
+    if (record->getInstance() != instance)
+      continue;
+    record->setInstance(newInstance);
+    auto *target = lookup(newInstance.moduleName());
+    if (target != record->getTarget())
+      record->setTarget(target);
+    return;
+  }
+  llvm_unreachable("instance is not in the InstanceGraph");
+}
+
+void InstanceGraph::replaceModule(Operation *oldModule, Operation *newModule) {
+  auto *oldNode = lookup(oldModule);
+  auto *newNode = lookup(newModule);
+  auto name =
+      FlatSymbolRefAttr::get(newModule->getContext(), getModuleName(newModule));
+  while (!oldNode->noUses()) {
+    auto *record = *oldNode->uses_begin();
+    record->getInstance()->setAttr("moduleName", name);
+    record->setTarget(newNode);
+  }
+}
+
+void InstancePathNode::getPath(SmallVectorImpl<InstanceOp> &path) const {
+  auto begin = path.size();
+  for (auto *node = this; node; node = node->parent)
+    path.push_back(node->instance);
+  std::reverse(path.begin() + begin, path.end());
+}
+
+uint64_t InstancePathCache::getInstanceCount(Operation *module) {
+  return getInstanceCount(instanceGraph.lookup(module));
+}
+
+uint64_t InstancePathCache::getInstanceCount(InstanceGraphNode *node) {
+  if (node == instanceGraph.getTopLevelNode())
+    return 1;
+
+  // Fast path: hit the cache.
+  auto it = instanceCounts.find(node);
+  if (it != instanceCounts.end())
+    return it->second;
+
+  // Each instance of the module is instantiated as often as its parent.
+  uint64_t count = 0;
+  for (auto *record : node->uses())
+    count += getInstanceCount(record->getParent());
+  instanceCounts.insert({node, count});
+  return count;
+}
+
+ArrayRef<const InstancePathNode *>
+InstancePathCache::getPathNodes(Operation *module) {
+  return getPathNodes(instanceGraph.lookup(module));
+}
+
+ArrayRef<const InstancePathNode *>
+InstancePathCache::getPathNodes(InstanceGraphNode *node) {
+  // The top level module has a single empty path.
+  if (node == instanceGraph.getTopLevelNode()) {
+    static const InstancePathNode *empty = nullptr;
+    return empty;
+  }
+
+  // Fast path: hit the cache.
+  auto it = pathNodes.find(node);
+  if (it != pathNodes.end())
+    return it->second;
+
+  // Count the paths first, so that they can be allocated in one go.  This
+  // also fills in the paths of all parent modules.
+  size_t numPaths = 0;
+  for (auto *record : node->uses())
+    numPaths += getPathNodes(record->getParent()).size();
+
+  ArrayRef<const InstancePathNode *> result;
+  if (numPaths) {
+    auto *paths = allocator.Allocate<const InstancePathNode *>(numPaths);
+    auto *nodes = allocator.Allocate<InstancePathNode>(numPaths);
+    size_t i = 0;
+    for (auto *record : node->uses()) {
+      for (auto *parentPath : getPathNodes(record->getParent())) {
+        paths[i] = new (&nodes[i])
+            InstancePathNode(parentPath, record->getInstance());
+        ++i;
+      }
+    }
+    result = ArrayRef<const InstancePathNode *>(paths, numPaths);
+  }
+
+  pathNodes.insert({node, result});
+  return result;
+}
+
+ArrayRef<InstancePath> InstancePathCache::getAbsolutePaths(Operation *module) {
+  auto *node = instanceGraph.lookup(module);
+
+  // Fast path: hit the cache.
+  auto it = absolutePaths.find(node);
+  if (it != absolutePaths.end())
+    return it->second;
+
+  auto nodes = getPathNodes(node);
+  ArrayRef<InstancePath> result;
+  if (!nodes.empty()) {
+    auto *paths = allocator.Allocate<InstancePath>(nodes.size());
+    for (size_t i = 0, e = nodes.size(); i != e; ++i)
+      paths[i] = getAbsolutePath(nodes[i]);
+    result = ArrayRef<InstancePath>(paths, nodes.size());
+  }
+
+  absolutePaths.insert({node, result});
+  return result;
+}
+
+InstancePath InstancePathCache::getAbsolutePath(const InstancePathNode *node) {
+  if (!node)
+    return {};
+
+  // Fast path: hit the cache.
+  auto it = pathArrays.find(node);
+  if (it != pathArrays.end())
+    return it->second;
+
+  // Copy the path of the parent module, and append the instance to it.
+  auto parentPath = getAbsolutePath(node->getParent());
+  auto *path = allocator.Allocate<InstanceOp>(node->size());
+  std::copy(parentPath.begin(), parentPath.end(), path);
+  path[parentPath.size()] = node->getInstance();
+
+  InstancePath result(path, node->size());
+  pathArrays.insert({node, result});
+  return result;
+}
+
+void InstancePathCache::invalidate() {
+  instanceCounts.clear();
+  pathNodes.clear();
+  absolutePaths.clear();
+  pathArrays.clear();
+  allocator.Reset();
+}
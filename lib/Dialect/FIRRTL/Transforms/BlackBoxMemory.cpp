@@ -18,6 +18,7 @@
 #include "mlir/IR/OperationSupport.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Hashing.h"
+#include "llvm/Support/Parallel.h"
 
 using namespace circt;
 using namespace firrtl;
@@ -134,7 +135,8 @@ getBlackBoxPortsForMemOp(MemOp op, ArrayRef<MemOp::NamedPort> memPorts,
 /// Create an external module black box representing the memory operation.
 /// Returns the port list of the external module.
 static FExtModuleOp
-createBlackboxModuleForMem(MemOp op, ArrayRef<ModulePortInfo> extPorts) {
+createBlackboxModuleForMem(SymbolTable &symbolTable, MemOp op,
+                           ArrayRef<ModulePortInfo> extPorts) {
 
   OpBuilder builder(op->getContext());
 
@@ -151,7 +153,6 @@ createBlackboxModuleForMem(MemOp op, ArrayRef<ModulePortInfo> extPorts) {
   // Insert the external module into the circuit.  This will rename the
   // external module if there is a conflict with another module name.
   auto circuitOp = op->getParentOfType<CircuitOp>();
-  SymbolTable symbolTable(circuitOp);
   symbolTable.insert(extModuleOp);
 
   // Move the external module to the beginning of the circuitOp.  Inserting into
@@ -180,7 +181,8 @@ createBlackboxModuleForMem(MemOp op, ArrayRef<ModulePortInfo> extPorts) {
 /// done for compatibility with the Scala FIRRTL compiler and it is unclear if
 /// this will be needed in the long run.
 static FModuleOp
-createWrapperModule(MemOp op, ArrayRef<MemOp::NamedPort> memPorts,
+createWrapperModule(SymbolTable &symbolTable, MemOp op,
+                    ArrayRef<MemOp::NamedPort> memPorts,
                     FExtModuleOp extModuleOp, ArrayRef<ModulePortInfo> extPorts,
                     SmallVectorImpl<ModulePortInfo> &modPorts) {
   OpBuilder builder(op->getContext());
@@ -202,8 +204,6 @@ createWrapperModule(MemOp op, ArrayRef<MemOp::NamedPort> memPorts,
 
   // Insert the externaml module into the circuit.  This will rename the module
   // if there is a conflict with another module name.
-  auto circuitOp = op->getParentOfType<CircuitOp>();
-  SymbolTable symbolTable(circuitOp);
   symbolTable.insert(moduleOp);
 
   // Move the module right after the external module, for readability purposes.
@@ -272,148 +272,120 @@ static void createWiresForMemoryPorts(OpBuilder builder, Location loc, MemOp op,
   }
 }
 
-static void
-replaceMemWithWrapperModule(DenseMap<MemOp, FModuleOp, MemOpInfo> &knownMems,
-                            MemOp memOp) {
-
-  // The module we will be replacing the MemOp with.  If we don't have a
-  // suitable memory module already created, a new one representing the memory
-  // will be created.
-  FModuleOp moduleOp;
-  SmallVector<ModulePortInfo, 2> modPorts;
-
-  // Check if we have already created a suitable wrapper module. If we have not
-  // seen a similar memory, create a new wrapper module.
-  auto it = knownMems.find(memOp);
-  auto found = it != knownMems.end();
-  if (found) {
-    // Create an instance of the wrapping module.  We have to retrieve the
-    // module port information back from the module.
-    moduleOp = it->second;
-    modPorts = getModulePortInfo(moduleOp);
-  } else {
-    // Get the memory port descriptors. This gives us the name and kind of each
-    // memory port created by the MemOp.
-    auto memPorts = memOp.getPorts();
-
-    // Get the pohwist for a module which represents the black box memory.
-    // Typically has 1R + 1W memory port, which has 4+5=9 fields.
-    SmallVector<ModulePortInfo, 9> extPortList;
-    getBlackBoxPortsForMemOp(memOp, memPorts, extPortList);
-    auto extModuleOp = createBlackboxModuleForMem(memOp, extPortList);
-    moduleOp = createWrapperModule(memOp, memPorts, extModuleOp, extPortList,
-                                   modPorts);
-    knownMems[memOp] = moduleOp;
-  }
-
-  // Create an instance of the wrapping module
-  auto instanceOp =
-      createInstance(OpBuilder(memOp), memOp.getLoc(), moduleOp.getName(),
-                     memOp.nameAttr(), modPorts);
-
-  // Replace the memory operation with the module instance
-  memOp.replaceAllUsesWith(instanceOp.getResults());
-
-  // If we are using the memory operation as a key in the map, we cannot delete
-  // it yet.
-  if (found)
-    memOp->erase();
-}
+namespace {
+/// A memory configuration which has been replaced with a module.  Every memory
+/// of the same configuration is replaced with an instance of the same module.
+struct MemConfig {
+  /// The name of the module which replaces the memories.
+  StringRef moduleName;
+  /// The ports of the module.
+  SmallVector<ModulePortInfo, 9> ports;
+};
+} // end anonymous namespace
 
-/// Replaces all memories which match the predicate function with external
-/// modules and simple wrapper module which instantiates it.  Returns true if
-/// any memories were replaced.
-static bool
-replaceMemsWithWrapperModules(CircuitOp circuit,
-                              function_ref<bool(MemOp)> shouldReplace) {
-  /// A set of replaced memory operations.  When two memory operations
-  /// share the same types, they can share the same modules.
-  DenseMap<MemOp, FModuleOp, MemOpInfo> knownMems;
-  for (auto fmodule : circuit.getOps<FModuleOp>()) {
-    for (auto memOp : llvm::make_early_inc_range(fmodule.getOps<MemOp>())) {
-      if (shouldReplace(memOp)) {
-        replaceMemWithWrapperModule(knownMems, memOp);
-      }
-    }
+/// Create the modules for a memory configuration.  The memory is only used as
+/// the representative of its configuration, and is not modified.
+static MemConfig createModulesForMem(SymbolTable &symbolTable, MemOp memOp,
+                                     bool emitWrapper) {
+  // Get the memory port descriptors. This gives us the name and kind of each
+  // memory port created by the MemOp.
+  auto memPorts = memOp.getPorts();
+
+  // Get the pohwist for a module which represents the black box memory.
+  // Typically has 1R + 1W memory port, which has 4+5=9 fields.
+  MemConfig config;
+  SmallVector<ModulePortInfo, 9> extPortList;
+  getBlackBoxPortsForMemOp(memOp, memPorts, extPortList);
+  auto extModuleOp =
+      createBlackboxModuleForMem(symbolTable, memOp, extPortList);
+  if (!emitWrapper) {
+    config.moduleName = extModuleOp.getName();
+    config.ports = std::move(extPortList);
+    return config;
   }
-  // Erase any of the remaining memory operations.  These were kept around
-  // to check if other memory operations were equivalent.
-  for (auto it : knownMems)
-    it.first.erase();
 
-  // Return true if something changed.
-  return !knownMems.empty();
+  auto moduleOp = createWrapperModule(symbolTable, memOp, memPorts,
+                                      extModuleOp, extPortList, config.ports);
+  config.moduleName = moduleOp.getName();
+  return config;
 }
 
-static void
-replaceMemWithExtModule(DenseMap<MemOp, FExtModuleOp, MemOpInfo> &knownMems,
-                        MemOp memOp) {
+/// Replace a memory with an instance of the module created for its
+/// configuration.  Only creates operations next to the memory, so memories in
+/// different modules can be replaced in parallel.
+static void replaceMem(MemOp memOp, const MemConfig &config,
+                       bool emitWrapper) {
+  OpBuilder builder(memOp);
 
-  FExtModuleOp extModuleOp;
-  SmallVector<ModulePortInfo, 9> extPortList;
+  // Create an instance of the module.
+  auto instanceOp = createInstance(builder, memOp.getLoc(), config.moduleName,
+                                   memOp.nameAttr(), config.ports);
 
-  auto it = knownMems.find(memOp);
-  auto found = it != knownMems.end();
-  if (found) {
-    // Create an instance of the wrapping module.  We have to retrieve the
-    // module port information back from the module.
-    extModuleOp = it->second;
-    extPortList = getModulePortInfo(extModuleOp);
-  } else {
-    // Get the memory port descriptors.  This gives us the name and kind of each
-    // memory port created by the MemOp.
-    auto memPorts = memOp.getPorts();
-
-    // Get the pohwist for a module which represents the black box memory.
-    // Typically has 1R + 1W memory port, which has 4+5=9 fields.
-    getBlackBoxPortsForMemOp(memOp, memPorts, extPortList);
-    extModuleOp = createBlackboxModuleForMem(memOp, extPortList);
-    knownMems[memOp] = extModuleOp;
+  // The wrapper module has the same ports as the memory, so the memory can be
+  // replaced with the instance directly.
+  if (emitWrapper) {
+    memOp.replaceAllUsesWith(instanceOp.getResults());
+    memOp.erase();
+    return;
   }
 
-  OpBuilder builder(memOp);
-
-  // Create an instance of the black box module
-  auto instanceOp =
-      createInstance(builder, memOp.getLoc(), extModuleOp.getName(),
-                     memOp.nameAttr(), extPortList);
-
   // Create a wire for every memory port
   SmallVector<Value, 2> results;
   results.reserve(memOp.getNumResults());
   createWiresForMemoryPorts(builder, memOp.getLoc(), memOp, instanceOp,
-                            extPortList, results);
+                            config.ports, results);
 
   // Replace each memory port with a wire
   memOp.replaceAllUsesWith(results);
-
-  // If we are using the memory operation as a key in the map, we cannot delete
-  // it yet.
-  if (found)
-    memOp->erase();
+  memOp.erase();
 }
 
 /// Replaces all memories which match the predicate function with external
-/// modules.  Returns true if any modules were replaced.
-static bool replaceMemsWithExtModules(CircuitOp circuit,
-                                      function_ref<bool(MemOp)> shouldReplace) {
-  /// A set of replaced memory operations.  When two memory operations
-  /// share the same types, they can share the same modules.
-  DenseMap<MemOp, FExtModuleOp, MemOpInfo> knownMems;
+/// modules, and optionally a simple wrapper module which instantiates it.
+/// Memories are grouped by their configuration first, so that the modules are
+/// only created once per configuration, and then the memories of each module
+/// are replaced in parallel.  Returns true if any memories were replaced.
+static bool replaceMems(CircuitOp circuit, bool emitWrapper,
+                        function_ref<bool(MemOp)> shouldReplace) {
+  // The configuration of each group of equivalent memories.  When two memory
+  // operations share the same types, they can share the same modules.
+  DenseMap<MemOp, unsigned, MemOpInfo> configIds;
+  SmallVector<MemConfig> configs;
+
+  // The memories to replace in each module, and their configuration.
+  SmallVector<SmallVector<std::pair<MemOp, unsigned>>> moduleMems;
+
+  SymbolTable symbolTable(circuit);
   for (auto fmodule : circuit.getOps<FModuleOp>()) {
-    for (auto memOp : llvm::make_early_inc_range(fmodule.getOps<MemOp>())) {
-      if (shouldReplace(memOp)) {
-        replaceMemWithExtModule(knownMems, memOp);
-      }
+    SmallVector<std::pair<MemOp, unsigned>> mems;
+    for (auto memOp : fmodule.getOps<MemOp>()) {
+      if (!shouldReplace(memOp))
+        continue;
+      auto it = configIds.insert({memOp, configs.size()});
+      if (it.second)
+        configs.push_back(createModulesForMem(symbolTable, memOp, emitWrapper));
+      mems.push_back({memOp, it.first->second});
     }
+    if (!mems.empty())
+      moduleMems.push_back(std::move(mems));
+  }
+
+  // The memories are about to be erased, so they can no longer be compared.
+  configIds.clear();
+
+  auto replaceModuleMems = [&](ArrayRef<std::pair<MemOp, unsigned>> mems) {
+    for (auto mem : mems)
+      replaceMem(mem.first, configs[mem.second], emitWrapper);
+  };
+  if (circuit.getContext()->isMultithreadingEnabled()) {
+    llvm::parallelForEach(moduleMems.begin(), moduleMems.end(),
+                          replaceModuleMems);
+  } else {
+    llvm::for_each(moduleMems, replaceModuleMems);
   }
-  // Erase any of the remaining memory operations.  These were kept around
-  // to check if other memory operations were equivalent.
-  for (auto op : knownMems)
-    op.first.erase();
 
   // Return true if something changed.
-  return !knownMems.empty();
+  return !configs.empty();
 }
 
 namespace {
@@ -424,15 +396,7 @@ struct BlackBoxMemoryPass : public BlackBoxMemoryBase<BlackBoxMemoryPass> {
     auto shouldReplace = [](MemOp memOp) -> bool {
       return memOp.readLatency() == 1 && memOp.writeLatency() == 1;
     };
-    auto anythingChanged = false;
-    if (emitWrapper)
-      anythingChanged =
-          replaceMemsWithWrapperModules(getOperation(), shouldReplace);
-    else
-      anythingChanged =
-          replaceMemsWithExtModules(getOperation(), shouldReplace);
-
-    if (!anythingChanged)
+    if (!replaceMems(getOperation(), emitWrapper, shouldReplace))
       markAllAnalysesPreserved();
   }
 };
@@ -21,8 +21,11 @@
 #include "mlir/IR/Attributes.h"
 #include "mlir/Support/FileUtilities.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 
 #define DEBUG_TYPE "firrtl-blackbox-reader"
@@ -52,16 +55,42 @@ static void appendPossiblyAbsolutePath(SmallVectorImpl<char> &base,
 //===----------------------------------------------------------------------===//
 
 namespace {
+/// A source file on disk which may be loaded for a black box.  Every path is
+/// only looked up and read once, no matter how many annotations refer to it.
+struct InputFile {
+  /// Whether the file exists and can be read.
+  bool exists = false;
+  /// The size of the file in bytes.
+  uint64_t size = 0;
+  /// Whether the contents of the file are copied into the IR.
+  bool needed = false;
+  /// The contents of the file, once it has been read.
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  /// The reason the file could not be read, if it failed.
+  std::string errorMessage;
+};
+
 struct BlackBoxReaderPass : public BlackBoxReaderBase<BlackBoxReaderPass> {
   void runOnOperation() override;
   bool runOnAnnotation(Operation *op, Annotation anno, OpBuilder &builder);
+  void getInputPaths(Annotation anno, SmallVectorImpl<std::string> &paths);
+  void lookupInputFiles(CircuitOp circuitOp);
   bool loadFile(Operation *op, StringRef inputPath, OpBuilder &builder);
+  void readInputFiles(CircuitOp circuitOp);
   void setOutputFile(VerbatimOp op, StringAttr fileNameAttr);
 
+  using BlackBoxReaderBase::inlineSizeLimit;
   using BlackBoxReaderBase::inputPrefix;
   using BlackBoxReaderBase::resourcePrefix;
 
 private:
+  /// Every path which a path or resource annotation may load a file from.
+  llvm::StringMap<InputFile> inputFiles;
+
+  /// The verbatim ops created for files on disk, which get the contents of
+  /// the file once all files have been read.
+  SmallVector<std::pair<VerbatimOp, InputFile *>> pendingLoads;
+
   /// A set of the files generated so far. This is used to prevent two
   /// annotations from generating the same file.
   SmallPtrSet<Attribute, 8> emittedFiles;
@@ -139,6 +168,10 @@ void BlackBoxReaderPass::runOnOperation() {
                           << "Black box resource file name: "
                           << resourceFileName << "\n");
 
+  // Find out which of the files referenced by the annotations exist before
+  // resolving the annotations, so that the file system is queried in parallel.
+  lookupInputFiles(circuitOp);
+
   // Newly generated IR will be placed at the end of the circuit.
   auto builder = OpBuilder::atBlockEnd(circuitOp->getBlock());
 
@@ -157,6 +190,9 @@ void BlackBoxReaderPass::runOnOperation() {
     anythingChanged |= AnnotationSet(filteredAnnos, context).applyToOperation(&op);
   }
 
+  // Read the contents of all files which are copied into the IR.
+  readInputFiles(circuitOp);
+
   // If we have emitted any files, generate a file list operation that
   // documents the additional annotation-controlled file listing to be
   // created.
@@ -196,10 +232,109 @@ void BlackBoxReaderPass::runOnOperation() {
     markAllAnalysesPreserved();
 
   // Clean up.
+  inputFiles.clear();
+  pendingLoads.clear();
   emittedFiles.clear();
   fileListFiles.clear();
 }
 
+/// Collect the paths which a path or resource annotation may load its file
+/// from, in the order in which they are searched.  Other annotations, and
+/// annotations which are missing their path, have no paths.
+void BlackBoxReaderPass::getInputPaths(Annotation anno,
+                                       SmallVectorImpl<std::string> &paths) {
+  if (anno.isClass("firrtl.transforms.BlackBoxPathAnno")) {
+    if (auto path = anno.getMember<StringAttr>("path")) {
+      SmallString<128> inputPath(inputPrefix);
+      appendPossiblyAbsolutePath(inputPath, path.getValue());
+      paths.push_back(inputPath.str().str());
+    }
+    return;
+  }
+
+  if (anno.isClass("firrtl.transforms.BlackBoxResourceAnno")) {
+    auto resourceId = anno.getMember<StringAttr>("resourceId");
+    if (!resourceId)
+      return;
+
+    // Note that we always treat `resourceId` as a relative path, as the
+    // previous Scala implementation tended to emit `/foo.v` as resourceId.
+    auto relativeResourceId =
+        llvm::sys::path::relative_path(resourceId.getValue());
+
+    SmallVector<StringRef> roots;
+    StringRef(resourcePrefix).split(roots, ':');
+    for (auto root : roots) {
+      SmallString<128> inputPath(root);
+      llvm::sys::path::append(inputPath, relativeResourceId);
+      paths.push_back(inputPath.str().str());
+    }
+  }
+}
+
+/// Query the file system for every file which the annotations in the circuit
+/// may load.  Annotations tend to share files, so each path is only looked up
+/// once.
+void BlackBoxReaderPass::lookupInputFiles(CircuitOp circuitOp) {
+  SmallVector<std::string> paths;
+  for (auto &op : *circuitOp.getBody()) {
+    if (!isa<FModuleOp>(op) && !isa<FExtModuleOp>(op))
+      continue;
+    for (auto anno : AnnotationSet(&op))
+      getInputPaths(anno, paths);
+  }
+
+  SmallVector<llvm::StringMapEntry<InputFile> *> entries;
+  for (auto &path : paths) {
+    auto it = inputFiles.try_emplace(path);
+    if (it.second)
+      entries.push_back(&*it.first);
+  }
+
+  auto lookupFile = [](llvm::StringMapEntry<InputFile> *entry) {
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(entry->getKey(), status) ||
+        !llvm::sys::fs::exists(status) || llvm::sys::fs::is_directory(status))
+      return;
+    entry->getValue().exists = true;
+    entry->getValue().size = status.getSize();
+  };
+  if (circuitOp.getContext()->isMultithreadingEnabled())
+    llvm::parallelForEach(entries.begin(), entries.end(), lookupFile);
+  else
+    llvm::for_each(entries, lookupFile);
+}
+
+/// Read every file which is copied into the IR, and store the contents in the
+/// verbatim ops created for them.
+void BlackBoxReaderPass::readInputFiles(CircuitOp circuitOp) {
+  SmallVector<llvm::StringMapEntry<InputFile> *> entries;
+  for (auto &entry : inputFiles)
+    if (entry.getValue().needed)
+      entries.push_back(&entry);
+
+  auto readFile = [](llvm::StringMapEntry<InputFile> *entry) {
+    auto &file = entry->getValue();
+    file.buffer = mlir::openInputFile(entry->getKey(), &file.errorMessage);
+  };
+  if (circuitOp.getContext()->isMultithreadingEnabled())
+    llvm::parallelForEach(entries.begin(), entries.end(), readFile);
+  else
+    llvm::for_each(entries, readFile);
+
+  for (auto &pendingLoad : pendingLoads) {
+    auto verbatimOp = pendingLoad.first;
+    auto *file = pendingLoad.second;
+    if (!file->buffer) {
+      verbatimOp.emitError("Cannot read file: ") << file->errorMessage;
+      signalPassFailure();
+      continue;
+    }
+    verbatimOp->setAttr("string", StringAttr::get(&getContext(),
+                                                  file->buffer->getBuffer()));
+  }
+}
+
 /// Run on an operation-annotation pair. The annotation need not be a black box
 /// annotation. Returns `true` if the annotation was indeed a black box
 /// annotation (even if it was incomplete) and should be removed from the op.
@@ -241,11 +376,11 @@ bool BlackBoxReaderPass::runOnAnnotation(Operation *op, Annotation anno,
       signalPassFailure();
       return true;
     }
-    SmallString<128> inputPath(inputPrefix);
-    appendPossiblyAbsolutePath(inputPath, path.getValue());
-    if (loadFile(op, inputPath, builder))
+    SmallVector<std::string, 1> inputPaths;
+    getInputPaths(anno, inputPaths);
+    if (loadFile(op, inputPaths.front(), builder))
       return true;
-    op->emitError("Cannot find file ") << inputPath;
+    op->emitError("Cannot find file ") << inputPaths.front();
     signalPassFailure();
     return false;
   }
@@ -260,19 +395,11 @@ bool BlackBoxReaderPass::runOnAnnotation(Operation *op, Annotation anno,
       return true;
     }
 
-    // Note that we always treat `resourceId` as a relative path, as the
-    // previous Scala implementation tended to emit `/foo.v` as resourceId.
-    auto relativeResourceId =
-        llvm::sys::path::relative_path(resourceId.getValue());
-
-    SmallVector<StringRef> roots;
-    StringRef(resourcePrefix).split(roots, ':');
-    for (auto root : roots) {
-      SmallString<128> inputPath(root);
-      llvm::sys::path::append(inputPath, relativeResourceId);
+    SmallVector<std::string> inputPaths;
+    getInputPaths(anno, inputPaths);
+    for (auto &inputPath : inputPaths)
       if (loadFile(op, inputPath, builder))
         return true; // found file
-    }
     op->emitError("Cannot find file ") << resourceId.getValue();
     signalPassFailure();
     return false;
@@ -283,7 +410,9 @@ bool BlackBoxReaderPass::runOnAnnotation(Operation *op, Annotation anno,
 }
 
 /// Copies a black box source file to the appropriate location in the target
-/// directory.
+/// directory.  The contents of the file are filled in by `readInputFiles`,
+/// unless the file is larger than the inline size limit, in which case the
+/// emitted file only includes the original file by its absolute path.
 bool BlackBoxReaderPass::loadFile(Operation *op, StringRef inputPath,
                                   OpBuilder &builder) {
   auto fileName = llvm::sys::path::filename(inputPath);
@@ -295,16 +424,28 @@ bool BlackBoxReaderPass::loadFile(Operation *op, StringRef inputPath,
   if (emittedFiles.count(fileNameAttr))
     return true;
 
-  // Open and read the input file.
-  std::string errorMessage;
-  auto input = mlir::openInputFile(inputPath, &errorMessage);
-  if (!input)
+  // Check that the input file exists.
+  auto it = inputFiles.find(inputPath);
+  assert(it != inputFiles.end() && "input file was not looked up");
+  auto &file = it->getValue();
+  if (!file.exists)
     return false;
 
-  // Create an IR node to hold the contents.
-  auto verbatimOp =
-      builder.create<VerbatimOp>(op->getLoc(), input->getBuffer());
+  // Refer to large files by their path rather than copying them into the IR.
+  if (inlineSizeLimit && file.size > inlineSizeLimit) {
+    SmallString<128> absolutePath(inputPath);
+    llvm::sys::fs::make_absolute(absolutePath);
+    auto verbatimOp = builder.create<VerbatimOp>(
+        op->getLoc(), "`include \"" + absolutePath + "\"\n");
+    setOutputFile(verbatimOp, fileNameAttr);
+    return true;
+  }
+
+  // Create an IR node to hold the contents, which are read later.
+  auto verbatimOp = builder.create<VerbatimOp>(op->getLoc(), "");
   setOutputFile(verbatimOp, fileNameAttr);
+  file.needed = true;
+  pendingLoads.push_back({verbatimOp, &file});
   return true;
 }
 
@@ -343,11 +484,14 @@ void BlackBoxReaderPass::setOutputFile(VerbatimOp op, StringAttr fileNameAttr) {
 
 std::unique_ptr<mlir::Pass> circt::firrtl::createBlackBoxReaderPass(
     llvm::Optional<StringRef> inputPrefix,
-    llvm::Optional<StringRef> resourcePrefix) {
+    llvm::Optional<StringRef> resourcePrefix,
+    llvm::Optional<uint64_t> inlineSizeLimit) {
   auto pass = std::make_unique<BlackBoxReaderPass>();
   if (inputPrefix)
     pass->inputPrefix = inputPrefix->str();
   if (resourcePrefix)
     pass->resourcePrefix = resourcePrefix->str();
+  if (inlineSizeLimit)
+    pass->inlineSizeLimit = *inlineSizeLimit;
   return pass;
 }
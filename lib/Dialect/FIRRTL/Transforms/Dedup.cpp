@@ -0,0 +1,253 @@
+//===- Dedup.cpp - FIRRTL module deduplication ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements FIRRTL module deduplication, which replaces every
+// instance of a module with an instance of a structurally identical module.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/InstanceGraph.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/Parallel.h"
+
+using namespace circt;
+using namespace firrtl;
+
+//===----------------------------------------------------------------------===//
+// Structural Equivalence
+//===----------------------------------------------------------------------===//
+
+/// Return true if the attribute is the name of the module, which is the only
+/// thing allowed to differ between two duplicate modules.
+static bool isModuleName(const NamedAttribute &attr) {
+  return attr.first == SymbolTable::getSymbolAttrName();
+}
+
+namespace {
+/// This computes a hash of the structure of a module: the operations, their
+/// attributes and types, and how values flow between them.  Values are
+/// identified by the order in which they are defined, so the hash doesn't
+/// depend on anything outside of the module except the names of the modules
+/// it instantiates.
+struct StructuralHasher {
+  llvm::hash_code hash(FModuleOp module) {
+    llvm::hash_code result = 0;
+    for (auto &attr : module->getAttrs())
+      if (!isModuleName(attr))
+        result = llvm::hash_combine(result, attr.first.getAsOpaquePointer(),
+                                    attr.second);
+    return llvm::hash_combine(result, hash(module.body()));
+  }
+
+private:
+  llvm::hash_code hash(Region &region) {
+    llvm::hash_code result = region.getBlocks().size();
+    for (auto &block : region) {
+      for (auto arg : block.getArguments()) {
+        valueIds.insert({arg, valueIds.size()});
+        result = llvm::hash_combine(result, arg.getType());
+      }
+      for (auto &op : block)
+        result = llvm::hash_combine(result, hash(&op));
+    }
+    return result;
+  }
+
+  llvm::hash_code hash(Operation *op) {
+    llvm::hash_code result = llvm::hash_combine(
+        op->getName().getAsOpaquePointer(), op->getAttrDictionary());
+    for (auto operand : op->getOperands())
+      result = llvm::hash_combine(result, valueIds.lookup(operand));
+    for (auto &region : op->getRegions())
+      result = llvm::hash_combine(result, hash(region));
+    for (auto value : op->getResults()) {
+      valueIds.insert({value, valueIds.size()});
+      result = llvm::hash_combine(result, value.getType());
+    }
+    return result;
+  }
+
+  /// The number of each value, in the order they are defined.
+  DenseMap<Value, unsigned> valueIds;
+};
+
+/// This checks whether two modules are identical, except for their names.  The
+/// values of the two modules must be used the same way, and every operation
+/// must have the same attributes and types.
+struct StructuralEquivalence {
+  bool isEquivalent(FModuleOp lhs, FModuleOp rhs) {
+    auto lhsAttrs = lhs->getAttrs();
+    auto rhsAttrs = rhs->getAttrs();
+    if (lhsAttrs.size() != rhsAttrs.size())
+      return false;
+    for (auto attrs : llvm::zip(lhsAttrs, rhsAttrs)) {
+      auto &lhsAttr = std::get<0>(attrs);
+      auto &rhsAttr = std::get<1>(attrs);
+      if (lhsAttr.first != rhsAttr.first)
+        return false;
+      if (!isModuleName(lhsAttr) && lhsAttr.second != rhsAttr.second)
+        return false;
+    }
+    return isEquivalent(lhs.body(), rhs.body());
+  }
+
+private:
+  bool isEquivalent(Region &lhs, Region &rhs) {
+    if (lhs.getBlocks().size() != rhs.getBlocks().size())
+      return false;
+    for (auto blocks : llvm::zip(lhs, rhs)) {
+      auto &lhsBlock = std::get<0>(blocks);
+      auto &rhsBlock = std::get<1>(blocks);
+      if (lhsBlock.getNumArguments() != rhsBlock.getNumArguments() ||
+          lhsBlock.getOperations().size() != rhsBlock.getOperations().size())
+        return false;
+      for (auto args : llvm::zip(lhsBlock.getArguments(),
+                                 rhsBlock.getArguments())) {
+        if (std::get<0>(args).getType() != std::get<1>(args).getType())
+          return false;
+        valueMap.insert({std::get<0>(args), std::get<1>(args)});
+      }
+      for (auto ops : llvm::zip(lhsBlock, rhsBlock))
+        if (!isEquivalent(&std::get<0>(ops), &std::get<1>(ops)))
+          return false;
+    }
+    return true;
+  }
+
+  bool isEquivalent(Operation *lhs, Operation *rhs) {
+    if (lhs->getName() != rhs->getName() ||
+        lhs->getAttrDictionary() != rhs->getAttrDictionary() ||
+        lhs->getNumResults() != rhs->getNumResults() ||
+        lhs->getNumOperands() != rhs->getNumOperands() ||
+        lhs->getNumRegions() != rhs->getNumRegions())
+      return false;
+
+    // Operands must be values already known to correspond to each other.
+    for (auto operands : llvm::zip(lhs->getOperands(), rhs->getOperands())) {
+      auto it = valueMap.find(std::get<0>(operands));
+      if (it == valueMap.end() || it->second != std::get<1>(operands))
+        return false;
+    }
+
+    for (auto regions : llvm::zip(lhs->getRegions(), rhs->getRegions()))
+      if (!isEquivalent(std::get<0>(regions), std::get<1>(regions)))
+        return false;
+
+    for (auto results : llvm::zip(lhs->getResults(), rhs->getResults())) {
+      if (std::get<0>(results).getType() != std::get<1>(results).getType())
+        return false;
+      valueMap.insert({std::get<0>(results), std::get<1>(results)});
+    }
+    return true;
+  }
+
+  /// The value of the right hand module corresponding to each value of the
+  /// left hand module.
+  DenseMap<Value, Value> valueMap;
+};
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Pass Infrastructure
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Deduplicate the modules of a circuit.  The modules are processed bottom-up
+/// over the instance graph, so that the instances in a module have already been
+/// redirected to the deduplicated modules by the time it is hashed.  Modules
+/// at the same depth don't instantiate each other, so they are hashed in
+/// parallel.  The first module with a given structure is kept, and every other
+/// module with a matching hash which is actually identical is erased.
+class DedupPass : public DedupBase<DedupPass> {
+  void runOnOperation() override;
+
+  /// Returns true if the module is annotated to be kept apart.
+  bool isNoDedup(FModuleOp module) {
+    return AnnotationSet(module).hasAnnotation(
+        "firrtl.transforms.NoDedupAnnotation");
+  }
+};
+} // end anonymous namespace
+
+void DedupPass::runOnOperation() {
+  auto circuit = getOperation();
+  auto &instanceGraph = getAnalysis<InstanceGraph>();
+  auto *topLevelNode = instanceGraph.getTopLevelNode();
+
+  // Group the modules which can be deduplicated by their height in the
+  // instance graph.  The top level module is never instantiated, so it is
+  // never deduplicated.
+  DenseMap<InstanceGraphNode *, unsigned> heights;
+  SmallVector<SmallVector<FModuleOp>> levels;
+  for (auto *node : llvm::post_order(&instanceGraph)) {
+    unsigned height = 0;
+    for (auto *record : *node)
+      height = std::max(height, heights.lookup(record->getTarget()) + 1);
+    heights[node] = height;
+
+    auto module = dyn_cast_or_null<FModuleOp>(node->getModule());
+    if (!module || node == topLevelNode || isNoDedup(module))
+      continue;
+    if (levels.size() <= height)
+      levels.resize(height + 1);
+    levels[height].push_back(module);
+  }
+
+  // The hash of each module at a level, and its index in the level.
+  SmallVector<std::pair<size_t, size_t>> hashes;
+  SmallVector<FModuleOp, 4> candidates;
+  for (auto &level : levels) {
+    hashes.resize(level.size());
+    auto hashModule = [&](size_t index) {
+      hashes[index] = {StructuralHasher().hash(level[index]), index};
+    };
+    if (circuit.getContext()->isMultithreadingEnabled()) {
+      llvm::parallelForEachN(0, level.size(), hashModule);
+    } else {
+      for (size_t i = 0, e = level.size(); i != e; ++i)
+        hashModule(i);
+    }
+
+    // Replace each module with the first identical module of the same hash.
+    // Sorting keeps the modules with the same hash in their original order.
+    std::stable_sort(hashes.begin(), hashes.end(),
+                     [](const std::pair<size_t, size_t> &lhs,
+                        const std::pair<size_t, size_t> &rhs) {
+                       return lhs.first < rhs.first;
+                     });
+    for (size_t i = 0, e = hashes.size(); i != e; ++i) {
+      if (i == 0 || hashes[i].first != hashes[i - 1].first)
+        candidates.clear();
+
+      auto module = level[hashes[i].second];
+      auto *canonical = llvm::find_if(candidates, [&](FModuleOp candidate) {
+        return StructuralEquivalence().isEquivalent(candidate, module);
+      });
+      if (canonical == candidates.end()) {
+        candidates.push_back(module);
+        continue;
+      }
+
+      instanceGraph.replaceModule(module, *canonical);
+      instanceGraph.erase(instanceGraph.lookup(module));
+      module.erase();
+      ++numErasedModules;
+    }
+  }
+
+  markAnalysesPreserved<InstanceGraph>();
+}
+
+std::unique_ptr<mlir::Pass> circt::firrtl::createDedupPass() {
+  return std::make_unique<DedupPass>();
+}
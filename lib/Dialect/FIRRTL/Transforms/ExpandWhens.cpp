@@ -16,6 +16,7 @@
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Support/FieldRef.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLExtras.h"
 
@@ -168,8 +169,9 @@ public:
   void visitDecl(InstanceOp op) {
     // Track any instance inputs which need to be connected to for init
     // coverage.
+    auto *referencedModule = op.getReferencedModule();
     for (auto result : llvm::enumerate(op.results()))
-      if (getModulePortDirection(op.getReferencedModule(), result.index()) ==
+      if (getModulePortDirection(referencedModule, result.index()) ==
           Direction::Output)
         declareSinks(result.value(), Flow::Source);
       else
@@ -205,8 +207,16 @@ public:
   /// If the value was declared in the block, then it does not need to have been
   /// assigned a previous value.  If the value was declared before the block,
   /// then there is an incomplete initialization error.
+  ///
+  /// Each scope only holds the destinations connected or declared in it, so
+  /// this costs time proportional to the connects in the two blocks, and not
+  /// to the size of the enclosing scope.
   void mergeScopes(ScopeMap &thenScope, ScopeMap &elseScope,
                    Value thenCondition) {
+    // The destinations set in both blocks, which are fully handled while
+    // processing the `then` block.  Erasing them from the `else` scope instead
+    // would be linear in the size of the scope each time.
+    DenseSet<FieldRef> mergedDests;
 
     // Process all connects in the `then` block.
     for (auto &destAndConnect : thenScope) {
@@ -231,7 +241,7 @@ public:
             elseConnect);
         setLastConnect(dest, newConnect);
         // Do not process connect in the else scope.
-        elseScope.erase(dest);
+        mergedDests.insert(dest);
         continue;
       }
 
@@ -256,6 +266,8 @@ public:
     for (auto &destAndConnect : elseScope) {
       auto dest = std::get<0>(destAndConnect);
       auto elseConnect = std::get<1>(destAndConnect);
+      if (mergedDests.count(dest))
+        continue;
 
       // `dest` is set in `then` only.
       auto itAndInserted = scope.insert({dest, elseConnect});
@@ -439,8 +451,15 @@ mlir::FailureOr<bool> ModuleVisitor::run(FModuleOp module) {
     auto *connect = std::get<1>(destAndConnect);
     if (connect)
       continue;
-    // Get the op which defines the sink, and emit an error.
+    // Aggregates kept intact by type lowering are initialized by connecting
+    // the whole value, which also initializes each of its fields.
     auto dest = std::get<0>(destAndConnect);
+    if (dest.getFieldID() != 0) {
+      auto it = outerScope.find({dest.getValue(), 0});
+      if (it != outerScope.end() && it->second)
+        continue;
+    }
+    // Get the op which defines the sink, and emit an error.
     dest.getDefiningOp()->emitError("sink \"" + getFieldName(dest) +
                                     "\" not fully initialized");
     return failure();
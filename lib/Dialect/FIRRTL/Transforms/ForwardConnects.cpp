@@ -0,0 +1,115 @@
+//===- ForwardConnects.cpp - Forward values through wires and nodes -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass which replaces the wires that are connected only
+// once, and the nodes, with the values driving them.  This removes the
+// declarations and their connects before ExpandWhens and the passes after it
+// have to visit them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "mlir/IR/Dominance.h"
+
+using namespace circt;
+using namespace firrtl;
+
+namespace {
+struct ForwardConnectsPass : public ForwardConnectsBase<ForwardConnectsPass> {
+  void runOnOperation() override;
+
+private:
+  bool forwardWire(WireOp wire);
+  bool forwardNode(NodeOp node);
+
+  DominanceInfo *domInfo = nullptr;
+};
+} // end anonymous namespace
+
+/// Replace `wire` with its driver, if the wire is connected exactly once, with
+/// a connect in its own block rather than in a `when`, and the driver is
+/// available at every use of the wire.
+bool ForwardConnectsPass::forwardWire(WireOp wire) {
+  auto type = wire.getType().cast<FIRRTLType>();
+  if (!type.isGround() || type.isa<AnalogType>() ||
+      !AnnotationSet(wire).empty())
+    return false;
+
+  ConnectOp driver;
+  for (auto *user : wire->getUsers()) {
+    if (auto connect = dyn_cast<ConnectOp>(user)) {
+      if (connect.dest() != wire)
+        continue;
+      if (driver || connect->getBlock() != wire->getBlock())
+        return false;
+      driver = connect;
+      continue;
+    }
+    if (auto partialConnect = dyn_cast<PartialConnectOp>(user))
+      if (partialConnect.dest() == wire)
+        return false;
+  }
+  if (!driver)
+    return false;
+
+  Value src = driver.src();
+  if (src == wire || src.getType() != type)
+    return false;
+  for (auto *user : wire->getUsers())
+    if (user != driver && !domInfo->properlyDominates(src, user))
+      return false;
+
+  driver.erase();
+  wire.replaceAllUsesWith(src);
+  wire.erase();
+  return true;
+}
+
+/// Replace `node` with its input, which is always available at its uses.
+bool ForwardConnectsPass::forwardNode(NodeOp node) {
+  if (node.input().getType() != node.getType() ||
+      !AnnotationSet(node).empty())
+    return false;
+  node.replaceAllUsesWith(node.input());
+  node.erase();
+  return true;
+}
+
+void ForwardConnectsPass::runOnOperation() {
+  domInfo = &getAnalysis<DominanceInfo>();
+
+  // Collect the declarations first, since forwarding erases operations.
+  SmallVector<Operation *> decls;
+  getOperation().walk([&](Operation *op) {
+    if (isa<WireOp, NodeOp>(op))
+      decls.push_back(op);
+  });
+
+  size_t wires = 0, nodes = 0;
+  for (auto *op : decls) {
+    if (auto wire = dyn_cast<WireOp>(op))
+      wires += forwardWire(wire);
+    else
+      nodes += forwardNode(cast<NodeOp>(op));
+  }
+
+  numForwardedWires += wires;
+  numForwardedNodes += nodes;
+  // A wire takes its connect with it.
+  numErasedOps += 2 * wires + nodes;
+
+  if (wires == 0 && nodes == 0)
+    markAllAnalysesPreserved();
+}
+
+std::unique_ptr<mlir::Pass> circt::firrtl::createForwardConnectsPass() {
+  return std::make_unique<ForwardConnectsPass>();
+}
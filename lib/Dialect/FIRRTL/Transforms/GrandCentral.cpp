@@ -11,8 +11,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/AnnotationIndex.h"
 #include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
+#include "circt/Dialect/FIRRTL/InstanceGraph.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWDialect.h"
 #include "circt/Dialect/SV/SVOps.h"
@@ -147,10 +149,10 @@ static Optional<AugmentedBundleType> decodeBundleType(Annotation anno) {
 ///    the interface.  However, no information about the _type_ of the elements
 ///    is known.
 ///
-/// 2. With this, information, walk through the circuit to find scattered
-///    information about the types of the interface elements.  Annotations are
-///    scattered during FIRRTL parsing to attach all the annotations associated
-///    with elements on the right components.
+/// 2. With this, information, look up the scattered information about the
+///    types of the interface elements in the annotation index.  Annotations
+///    are scattered during FIRRTL parsing to attach all the annotations
+///    associated with elements on the right components.
 ///
 /// 3. Add interface ops and populate the elements.
 ///
@@ -206,15 +208,14 @@ private:
 public:
   using FIRRTLVisitor<GrandCentralVisitor>::visitDecl;
 
-  /// Visit FModuleOp and FExtModuleOp
-  void visitModule(Operation *op);
+  /// Visit the ports of FModuleOp and FExtModuleOp
+  void visitModule(Operation *op) { handlePorts(op); }
 
   /// Visit ops that can make up an interface element.
   void visitDecl(RegOp op) { handleRef(op); }
   void visitDecl(RegResetOp op) { handleRef(op); }
   void visitDecl(WireOp op) { handleRef(op); }
   void visitDecl(NodeOp op) { handleRef(op); }
-  void visitDecl(InstanceOp op);
 
   /// Process all other ops.  Error if any of these ops contain annotations that
   /// indicate it as being part of an interface.
@@ -226,14 +227,6 @@ public:
 
 } // namespace
 
-void GrandCentralVisitor::visitModule(Operation *op) {
-  handlePorts(op);
-
-  if (isa<FModuleOp>(op))
-    for (auto &stmt : op->getRegion(0).front())
-      dispatchVisitor(&stmt);
-}
-
 /// Process all other operations.  This will throw an error if the operation
 /// contains any annotations that indicates that this should be included in an
 /// interface.  Otherwise, this is a valid nop.
@@ -350,29 +343,6 @@ void GrandCentralVisitor::handlePorts(Operation *op) {
   mlir::function_like_impl::setAllArgAttrDicts(op, newArgAttrs);
 }
 
-void GrandCentralVisitor::visitDecl(InstanceOp op) {
-
-  // If this instance's underlying module has a "companion" annotation, then
-  // move this onto the actual instance op.
-  AnnotationSet annotations(op.getReferencedModule());
-  if (auto anno = annotations.getAnnotation(
-          "sifive.enterprise.grandcentral.GrandCentralView$"
-          "SerializedViewAnnotation")) {
-    auto tpe = anno.getAs<StringAttr>("type");
-    if (!tpe) {
-      op.getReferencedModule()->emitOpError(
-          "contains a GrandcCentralView$SerializedViewAnnotation that does not "
-          "contain a \"type\" field");
-      failed = true;
-      return;
-    }
-    if (tpe.getValue() == "companion")
-      op->setAttr("lowerToBind", BoolAttr::get(op.getContext(), true));
-  }
-
-  visitUnhandledDecl(op);
-}
-
 void GrandCentralPass::runOnOperation() {
   CircuitOp circuitOp = getOperation();
 
@@ -433,25 +403,55 @@ void GrandCentralPass::runOnOperation() {
     return signalPassFailure();
 
   // Remove the processed annotations.
+  auto &annotationIndex = getAnalysis<AnnotationIndex>();
   circuitOp->setAttr("annotations", annotations.getArrayAttr());
+  annotationIndex.update(circuitOp);
+
+  // Visit the operations and modules carrying interface elements to collect
+  // additional information.  Only these need to be looked at, rather than the
+  // whole circuit.  If this fails, signal pass failure.
+  StringRef groundTypeClass =
+      "sifive.enterprise.grandcentral.AugmentedGroundType";
+  StringRef viewClass = "sifive.enterprise.grandcentral.GrandCentralView$"
+                        "SerializedViewAnnotation";
+  SmallVector<Operation *> elementOps;
+  annotationIndex.getOperations(groundTypeClass, elementOps);
+  GrandCentralVisitor visitor(interfaceMap);
+  for (auto *op : elementOps) {
+    if (isa<FModuleOp, FExtModuleOp>(op))
+      visitor.visitModule(op);
+    else
+      visitor.dispatchVisitor(op);
+    annotationIndex.update(op);
+  }
+  if (visitor.hasFailed())
+    return signalPassFailure();
 
-  // Walk through the circuit to collect additional information.  If this fails,
-  // signal pass failure.  Walk in reverse order so that annotations can be
-  // removed from modules after all referring instances have consumed their
-  // annotations.
-  for (auto &op : llvm::reverse(circuitOp.getBody()->getOperations())) {
-    if (isa<FModuleOp, FExtModuleOp>(op)) {
-      GrandCentralVisitor visitor(interfaceMap);
-      visitor.visitModule(&op);
-      if (visitor.hasFailed())
-        return signalPassFailure();
-      AnnotationSet annotations(&op);
-      annotations.removeAnnotations([](auto anno) {
-        return anno.isClass("sifive.enterprise.grandcentral.GrandCentralView$"
-                            "SerializedViewAnnotation");
-      });
-      annotations.applyToOperation(&op);
+  // If a module has a "companion" annotation, then move this onto every
+  // instance of it, and remove the annotation from the module.
+  auto &instanceGraph = getAnalysis<InstanceGraph>();
+  SmallVector<Operation *> viewModules;
+  annotationIndex.getOperations(viewClass, viewModules);
+  for (auto *module : viewModules) {
+    AnnotationSet annotations(module);
+    auto anno = annotations.getAnnotation(viewClass);
+    if (!anno || !isa<FModuleOp, FExtModuleOp>(module))
+      continue;
+    auto tpe = anno.getAs<StringAttr>("type");
+    if (!tpe) {
+      module->emitOpError(
+          "contains a GrandcCentralView$SerializedViewAnnotation that does not "
+          "contain a \"type\" field");
+      return signalPassFailure();
     }
+    if (tpe.getValue() == "companion")
+      for (auto *instance : instanceGraph.lookup(module)->uses())
+        instance->getInstance()->setAttr("lowerToBind",
+                                         BoolAttr::get(&getContext(), true));
+    annotations.removeAnnotations(
+        [&](Annotation anno) { return anno.isClass(viewClass); });
+    annotations.applyToOperation(module);
+    annotationIndex.update(module);
   }
 
   // Populate interfaces.
@@ -521,6 +521,10 @@ void GrandCentralPass::runOnOperation() {
   interfaces.clear();
   interfaceMap.clear();
   interfaceKeys.clear();
+
+  // The annotation index has been kept up to date, and no instances have
+  // changed.
+  markAnalysesPreserved<AnnotationIndex, InstanceGraph>();
 }
 
 //===----------------------------------------------------------------------===//
@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/AnnotationIndex.h"
 #include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
@@ -22,7 +23,6 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TinyPtrVector.h"
-#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormatVariadic.h"
 
@@ -71,9 +71,6 @@ static constexpr const char *internalKeyClass =
 // Utilities
 //===----------------------------------------------------------------------===//
 
-/// An absolute instance path.
-using InstancePath = ArrayRef<InstanceOp>;
-
 template <typename T>
 static T &operator<<(T &os, const InstancePath &path) {
   os << "$root";
@@ -106,80 +103,27 @@ struct TappedValue {
   Annotation anno;
 };
 
-/// A data structure that caches and provides absolute paths to module instances
-/// in the IR.
-struct InstancePaths {
-  /// The instance graph of the IR.
-  InstanceGraph &instanceGraph;
-
-  explicit InstancePaths(InstanceGraph &instanceGraph)
-      : instanceGraph(instanceGraph) {}
-  ArrayRef<InstancePath> getAbsolutePaths(Operation *op);
-
-private:
-  /// An allocator for individual instance paths and entire path lists.
-  llvm::BumpPtrAllocator allocator;
-
-  /// Cached absolute instance paths.
-  DenseMap<Operation *, ArrayRef<InstancePath>> absolutePathsCache;
-
-  /// Append an instance to a path.
-  InstancePath appendInstance(InstancePath path, InstanceOp inst);
-};
-
 /// Necessary information to wire up a port with tapped data or memory location.
 struct PortWiring {
   unsigned portNum;
   ArrayRef<InstancePath> prefices;
   SmallString<16> suffix;
+  /// The index of the tap group of this port, see `TapGroup`.
+  unsigned group = 0;
 };
 
-} // namespace
-
-ArrayRef<InstancePath> InstancePaths::getAbsolutePaths(Operation *op) {
-  assert((isa<FModuleOp, FExtModuleOp>(op))); // extra parens makes parser smile
-
-  // If we have reached the circuit root, we're done.
-  if (op == instanceGraph.getTopLevelNode()->getModule()) {
-    static InstancePath empty{};
-    return empty; // array with single empty path
-  }
-
-  // Fast path: hit the cache.
-  auto cached = absolutePathsCache.find(op);
-  if (cached != absolutePathsCache.end())
-    return cached->second;
-
-  // For each instance, collect the instance paths to its parent and append the
-  // instance itself to each.
-  SmallVector<InstancePath, 8> extendedPaths;
-  for (auto inst : instanceGraph[op]->uses()) {
-    auto instPaths = getAbsolutePaths(inst->getParent()->getModule());
-    extendedPaths.reserve(instPaths.size());
-    for (auto path : instPaths) {
-      extendedPaths.push_back(appendInstance(path, inst->getInstance()));
-    }
-  }
-
-  // Move the list of paths into the bump allocator for later quick retrieval.
-  ArrayRef<InstancePath> pathList;
-  if (!extendedPaths.empty()) {
-    auto paths = allocator.Allocate<InstancePath>(extendedPaths.size());
-    std::copy(extendedPaths.begin(), extendedPaths.end(), paths);
-    pathList = ArrayRef<InstancePath>(paths, extendedPaths.size());
-  }
-
-  absolutePathsCache.insert({op, pathList});
-  return pathList;
-}
+/// The ports which tap into the same module share the same list of absolute
+/// instance paths, and therefore the same hierarchical prefix from each black
+/// box instance.  The prefix is only computed once per group and black box
+/// instance, no matter how many ports tap into the module.
+struct TapGroup {
+  ArrayRef<InstancePath> prefices;
+  /// The hierarchical prefix from the current black box instance, including
+  /// the trailing separator, or None if the tapped module has no instances.
+  Optional<SmallString<128>> hierPrefix;
+};
 
-InstancePath InstancePaths::appendInstance(InstancePath path, InstanceOp inst) {
-  size_t n = path.size() + 1;
-  auto newPath = allocator.Allocate<InstanceOp>(n);
-  std::copy(path.begin(), path.end(), newPath);
-  newPath[path.size()] = inst;
-  return InstancePath(newPath, n);
-}
+} // namespace
 
 /// Return a version of `path` that skips all front instances it has in common
 /// with `other`.
@@ -243,7 +187,7 @@ class GrandCentralTapsPass : public GrandCentralTapsBase<GrandCentralTapsPass> {
   void runOnOperation() override;
   void gatherAnnotations(Operation *op);
   void processAnnotation(AnnotatedPort &portAnno, AnnotatedExtModule &blackBox,
-                         InstancePaths &instancePaths);
+                         InstancePathCache &instancePaths);
 
   // Helpers to simplify collecting taps on the various things.
   void gatherTap(Annotation anno, Port port) {
@@ -255,10 +199,18 @@ class GrandCentralTapsPass : public GrandCentralTapsBase<GrandCentralTapsPass> {
     assert(it.second && "ambiguous tap annotation");
   }
 
+  /// Group the wired ports by the paths they tap into.
+  void planTapGroups();
+
+  /// Compute the hierarchical prefix of each tap group from a black box
+  /// instance.
+  void computeTapPrefixes(InstancePath path);
+
   DenseMap<Key, Operation *> tappedOps;
   DenseMap<Key, Port> tappedPorts;
   SmallDenseMap<Attribute, unsigned, 2> memPortIdx;
   SmallVector<PortWiring, 8> portWiring;
+  SmallVector<TapGroup, 8> tapGroups;
 };
 
 void GrandCentralTapsPass::runOnOperation() {
@@ -344,13 +296,21 @@ void GrandCentralTapsPass::runOnOperation() {
   }
 
   // Build a generator for absolute module and instance paths in the design.
-  InstancePaths instancePaths(getAnalysis<InstanceGraph>());
+  InstancePathCache instancePaths(getAnalysis<InstanceGraph>());
 
   // Gather the annotated ports and operations throughout the design that we are
-  // supposed to tap in one way or another.
+  // supposed to tap in one way or another.  Only the operations carrying one
+  // of the tap annotations need to be looked at.
   tappedPorts.clear();
   tappedOps.clear();
-  circuitOp.walk([&](Operation *op) { gatherAnnotations(op); });
+  auto &annotationIndex = getAnalysis<AnnotationIndex>();
+  SmallVector<Operation *, 8> tapOps;
+  annotationIndex.getOperations(
+      {memTapClass, referenceKeyClass, internalKeyClass}, tapOps);
+  for (auto *op : tapOps) {
+    gatherAnnotations(op);
+    annotationIndex.update(op);
+  }
 
   LLVM_DEBUG({
     llvm::dbgs() << "Tapped ports:\n";
@@ -383,6 +343,7 @@ void GrandCentralTapsPass::runOnOperation() {
     for (auto portAnno : blackBox.portAnnos) {
       processAnnotation(portAnno, blackBox, instancePaths);
     }
+    planTapGroups();
 
     LLVM_DEBUG({
       llvm::dbgs() << "- Wire up as follows:\n";
@@ -425,36 +386,21 @@ void GrandCentralTapsPass::runOnOperation() {
                  << blackBox.extModule.getName() << " for " << path << ")\n");
       auto impl =
           builder.create<FModuleOp>(name, ports, blackBox.filteredModuleAnnos);
+      annotationIndex.update(impl);
       builder.setInsertionPointToEnd(impl.getBodyBlock());
 
       // Connect the output ports to the appropriate tapped object.
-      for (auto port : portWiring) {
+      computeTapPrefixes(path);
+      for (auto &port : portWiring) {
         LLVM_DEBUG(llvm::dbgs() << "- Wiring up port " << port.portNum << "\n");
-        // Determine the shortest hierarchical prefix from this black box
-        // instance to the tapped object.
-        Optional<InstancePath> shortestPrefix;
-        for (auto prefix : port.prefices) {
-          auto relative = stripCommonPrefix(prefix, path);
-          if (!shortestPrefix.hasValue() ||
-              relative.size() < shortestPrefix->size())
-            shortestPrefix = relative;
-        }
-        if (!shortestPrefix.hasValue()) {
+        auto &hierPrefix = tapGroups[port.group].hierPrefix;
+        if (!hierPrefix.hasValue()) {
           LLVM_DEBUG(llvm::dbgs() << "  - Has no prefix, skipping\n");
           continue;
         }
-        LLVM_DEBUG(llvm::dbgs()
-                   << "  - Shortest prefix " << *shortestPrefix << "\n");
 
         // Concatenate the prefix into a proper full hierarchical name.
-        SmallString<128> hname;
-        for (auto inst : shortestPrefix.getValue()) {
-          if (!hname.empty())
-            hname += '.';
-          hname += inst.name();
-        }
-        if (!hname.empty())
-          hname += '.';
+        SmallString<128> hname(*hierPrefix);
         hname += port.suffix;
         LLVM_DEBUG(llvm::dbgs() << "  - Connecting as " << hname << "\n");
 
@@ -475,8 +421,48 @@ void GrandCentralTapsPass::runOnOperation() {
     }
 
     // Drop the original black box module.
+    annotationIndex.erase(blackBox.extModule);
     blackBox.extModule.erase();
   }
+
+  // The annotation index has been kept up to date.
+  markAnalysesPreserved<AnnotationIndex>();
+}
+
+void GrandCentralTapsPass::planTapGroups() {
+  tapGroups.clear();
+  DenseMap<const InstancePath *, unsigned> groupIndices;
+  for (auto &wiring : portWiring) {
+    auto it = groupIndices.insert({wiring.prefices.data(), tapGroups.size()});
+    if (it.second)
+      tapGroups.push_back({wiring.prefices, None});
+    wiring.group = it.first->second;
+  }
+}
+
+void GrandCentralTapsPass::computeTapPrefixes(InstancePath path) {
+  for (auto &group : tapGroups) {
+    // Determine the shortest hierarchical prefix from this black box instance
+    // to the tapped object.
+    group.hierPrefix = None;
+    Optional<InstancePath> shortestPrefix;
+    for (auto prefix : group.prefices) {
+      auto relative = stripCommonPrefix(prefix, path);
+      if (!shortestPrefix.hasValue() ||
+          relative.size() < shortestPrefix->size())
+        shortestPrefix = relative;
+    }
+    if (!shortestPrefix.hasValue())
+      continue;
+    LLVM_DEBUG(llvm::dbgs() << "- Shortest prefix " << *shortestPrefix << "\n");
+
+    // Concatenate the prefix into a hierarchical name.
+    group.hierPrefix.emplace();
+    for (auto inst : shortestPrefix.getValue()) {
+      *group.hierPrefix += inst.name();
+      *group.hierPrefix += '.';
+    }
+  }
 }
 
 /// Gather the annotations on ports and operations into the `tappedPorts` and
@@ -523,7 +509,7 @@ void GrandCentralTapsPass::gatherAnnotations(Operation *op) {
 
 void GrandCentralTapsPass::processAnnotation(AnnotatedPort &portAnno,
                                              AnnotatedExtModule &blackBox,
-                                             InstancePaths &instancePaths) {
+                                             InstancePathCache &instancePaths) {
   LLVM_DEBUG(llvm::dbgs() << "- Processing port " << portAnno.portNum
                           << " anno " << portAnno.anno.getDict() << "\n");
   auto key = getKey(portAnno.anno);
@@ -160,9 +160,28 @@ private:
 } // end anonymous namespace
 
 namespace {
-struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
-  void runOnOperation() override;
-  void rewriteModuleBody(FModuleOp module);
+/// This holds the lattice values of a single module, and drives the
+/// propagation of constants within it.  Each module is solved on its own, so
+/// that modules can be solved in parallel: a change which crosses an instance
+/// boundary is queued in the module it comes from, and delivered to the module
+/// it affects by the pass once every module has converged.
+class ModuleLattice {
+public:
+  using PortMapping = DenseMap<BlockArgument, llvm::TinyPtrVector<Value>>;
+
+  ModuleLattice(FModuleOp module, InstanceGraph &instanceGraph,
+                const PortMapping &resultPortToInstanceResultMapping)
+      : module(module), instanceGraph(instanceGraph),
+        resultPortToInstanceResultMapping(resultPortToInstanceResultMapping) {
+  }
+
+  /// Propagate lattice values through the module until they converge.
+  void solve();
+
+  /// Return true if there are changed values whose users must be revisited.
+  bool hasPendingWork() const { return !changedLatticeValueWorklist.empty(); }
+
+  void rewriteModuleBody();
 
   /// Returns true if the given block is executable.
   bool isBlockExecutable(Block *block) const {
@@ -229,6 +248,14 @@ struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
     }
   }
 
+  /// Return everything known about the value of a port of this module, which
+  /// includes the values driven onto it if it is an output port.
+  LatticeValue getPortLatticeValue(BlockArgument port) const {
+    auto result = latticeValues.lookup(port);
+    result.mergeIn(outputPortValues.lookup(port));
+    return result;
+  }
+
   /// Return the lattice value for the specified SSA value, extended to the
   /// width of the specified destType.  If allowTruncation is true, then this
   /// allows truncating the lattice value to the specified type.
@@ -251,53 +278,183 @@ struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
   void visitPartialConnect(PartialConnectOp connect);
   void visitOperation(Operation *op);
 
+  /// Changes to the lattice values of ports and instance results in other
+  /// modules, waiting to be delivered.
+  SmallVector<std::pair<Value, LatticeValue>, 4> outgoingValues;
+
+  /// Modules instantiated by this one which are waiting to be marked live.
+  SmallVector<FModuleOp, 4> outgoingExecutableModules;
+
+  /// Instance results waiting to be driven by the output port of the
+  /// referenced module they correspond to.
+  SmallVector<std::pair<BlockArgument, Value>, 4> outgoingInstanceResults;
+
 private:
+  FModuleOp module;
+
   /// This is the current instance graph for the Circuit.
-  InstanceGraph *instanceGraph = nullptr;
+  InstanceGraph &instanceGraph;
+
+  /// This keeps track of users the instance results that correspond to output
+  /// ports.  It is shared by all modules, and only updated between rounds.
+  const PortMapping &resultPortToInstanceResultMapping;
 
   /// This keeps track of the current state of each tracked value.
   DenseMap<Value, LatticeValue> latticeValues;
 
+  /// The values driven onto each output port of the module.
+  DenseMap<BlockArgument, LatticeValue> outputPortValues;
+
   /// The set of blocks that are known to execute, or are intrinsically live.
   SmallPtrSet<Block *, 16> executableBlocks;
 
-  /// A worklist containing blocks that need to be processed.
-  SmallVector<Block *, 64> blockWorklist;
-
   /// A worklist of values whose LatticeValue recently changed, indicating the
   /// users need to be reprocessed.
   SmallVector<Value, 64> changedLatticeValueWorklist;
+};
+
+struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
+  void runOnOperation() override;
+
+private:
+  ModuleLattice &getLattice(Value value);
+  void deliverChanges();
+
+  /// The lattice of each module in the circuit, in circuit order.
+  SmallVector<std::unique_ptr<ModuleLattice>> moduleLattices;
+  DenseMap<Operation *, ModuleLattice *> latticeForModule;
 
   /// This keeps track of users the instance results that correspond to output
   /// ports.
-  DenseMap<BlockArgument, llvm::TinyPtrVector<Value>>
-      resultPortToInstanceResultMapping;
+  ModuleLattice::PortMapping resultPortToInstanceResultMapping;
 };
 } // end anonymous namespace
 
 // TODO: handle annotations: [[OptimizableExtModuleAnnotation]]
 void IMConstPropPass::runOnOperation() {
   auto circuit = getOperation();
+  auto *context = circuit.getContext();
+  auto &instanceGraph = getAnalysis<InstanceGraph>();
 
-  instanceGraph = &getAnalysis<InstanceGraph>();
+  for (auto module : circuit.getBody()->getOps<FModuleOp>()) {
+    moduleLattices.push_back(std::make_unique<ModuleLattice>(
+        module, instanceGraph, resultPortToInstanceResultMapping));
+    latticeForModule[module] = moduleLattices.back().get();
+  }
+
+  auto markModuleLive = [&](FModuleOp module) {
+    auto *lattice = latticeForModule[module];
+    lattice->markBlockExecutable(module.getBodyBlock());
+    for (auto port : module.getBodyBlock()->getArguments())
+      lattice->markOverdefined(port);
+  };
 
   // If the top level module is an external module, mark the input ports
   // overdefined.
   if (auto module = dyn_cast<FModuleOp>(circuit.getMainModule())) {
-    markBlockExecutable(module.getBodyBlock());
-    for (auto port : module.getBodyBlock()->getArguments())
-      markOverdefined(port);
+    markModuleLive(module);
   } else {
     // Otherwise, mark all module ports as being overdefined.
-    for (auto &circuitBodyOp : circuit.getBody()->getOperations()) {
-      if (auto module = dyn_cast<FModuleOp>(circuitBodyOp)) {
-        markBlockExecutable(module.getBodyBlock());
-        for (auto port : module.getBodyBlock()->getArguments())
-          markOverdefined(port);
+    for (auto module : circuit.getBody()->getOps<FModuleOp>())
+      markModuleLive(module);
+  }
+  deliverChanges();
+
+  // Solve every module with changed values, then deliver the changes which
+  // cross into other modules, until nothing changes.  The lattice values only
+  // move up, so this reaches the same fixed point as a single worklist.
+  mlir::ParallelDiagnosticHandler diagHandler(context);
+  SmallVector<unsigned> activeModules;
+  while (true) {
+    activeModules.clear();
+    for (unsigned i = 0, e = moduleLattices.size(); i != e; ++i)
+      if (moduleLattices[i]->hasPendingWork())
+        activeModules.push_back(i);
+    if (activeModules.empty())
+      break;
+
+    if (context->isMultithreadingEnabled()) {
+      llvm::parallelForEach(activeModules, [&](unsigned index) {
+        // Notify the handler of the module index to keep diagnostics in order.
+        diagHandler.setOrderIDForThread(index);
+        moduleLattices[index]->solve();
+        diagHandler.eraseOrderIDForThread();
+      });
+    } else {
+      for (auto index : activeModules)
+        moduleLattices[index]->solve();
+    }
+    deliverChanges();
+  }
+
+  // Rewrite any constants in the modules.
+  if (context->isMultithreadingEnabled()) {
+    llvm::parallelForEach(moduleLattices,
+                          [&](auto &lattice) { lattice->rewriteModuleBody(); });
+  } else {
+    for (auto &lattice : moduleLattices)
+      lattice->rewriteModuleBody();
+  }
+
+  // Clean up our state for next time.
+  moduleLattices.clear();
+  latticeForModule.clear();
+  resultPortToInstanceResultMapping.clear();
+}
+
+/// Return the lattice of the module containing the specified port or instance
+/// result.
+ModuleLattice &IMConstPropPass::getLattice(Value value) {
+  Operation *module;
+  if (auto arg = value.dyn_cast<BlockArgument>())
+    module = arg.getOwner()->getParentOp();
+  else
+    module = value.getDefiningOp()->getParentOfType<FModuleOp>();
+  return *latticeForModule[module];
+}
+
+/// Deliver the changes queued by each module to the modules they affect.
+/// Delivering a change can queue more of them, e.g. when a module is marked
+/// live, so keep going until every queue is empty.
+void IMConstPropPass::deliverChanges() {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto &lattice : moduleLattices) {
+      auto executableModules = std::move(lattice->outgoingExecutableModules);
+      auto instanceResults = std::move(lattice->outgoingInstanceResults);
+      auto values = std::move(lattice->outgoingValues);
+      lattice->outgoingExecutableModules.clear();
+      lattice->outgoingInstanceResults.clear();
+      lattice->outgoingValues.clear();
+      if (executableModules.empty() && instanceResults.empty() &&
+          values.empty())
+        continue;
+      changed = true;
+
+      for (auto module : executableModules)
+        latticeForModule[module]->markBlockExecutable(module.getBodyBlock());
+
+      // Remember the instance results driven by each output port, and forward
+      // any value already known for the port.
+      for (auto &portAndResult : instanceResults) {
+        auto port = portAndResult.first;
+        resultPortToInstanceResultMapping[port].push_back(portAndResult.second);
+        lattice->mergeLatticeValue(
+            portAndResult.second,
+            getLattice(port).getPortLatticeValue(port));
       }
+
+      for (auto &valueAndLattice : values)
+        getLattice(valueAndLattice.first)
+            .mergeLatticeValue(valueAndLattice.first, valueAndLattice.second);
     }
   }
+}
 
+/// Revisit the users of each value whose lattice value changed, until nothing
+/// changes.  Changes which affect another module are queued for later.
+void ModuleLattice::solve() {
   // If a value changed lattice state then reprocess any of its users.
   while (!changedLatticeValueWorklist.empty()) {
     Value changedVal = changedLatticeValueWorklist.pop_back_val();
@@ -306,30 +463,14 @@ void IMConstPropPass::runOnOperation() {
         visitOperation(user);
     }
   }
-
-  // Rewrite any constants in the modules.
-  if (circuit.getContext()->isMultithreadingEnabled()) {
-    SmallVector<FModuleOp> ops(circuit.getBody()->getOps<FModuleOp>());
-    llvm::parallelForEach(ops, [&](auto op) { rewriteModuleBody(op); });
-  } else {
-    for (auto &circuitBodyOp : *circuit.getBody())
-      if (auto module = dyn_cast<FModuleOp>(circuitBodyOp))
-        rewriteModuleBody(module);
-  }
-
-  // Clean up our state for next time.
-  instanceGraph = nullptr;
-  latticeValues.clear();
-  executableBlocks.clear();
-  resultPortToInstanceResultMapping.clear();
 }
 
 /// Return the lattice value for the specified SSA value, extended to the width
 /// of the specified destType.  If allowTruncation is true, then this allows
 /// truncating the lattice value to the specified type.
-LatticeValue IMConstPropPass::getExtendedLatticeValue(Value value,
-                                                      FIRRTLType destType,
-                                                      bool allowTruncation) {
+LatticeValue ModuleLattice::getExtendedLatticeValue(Value value,
+                                                    FIRRTLType destType,
+                                                    bool allowTruncation) {
   // If 'value' hasn't been computed yet, then it is unknown.
   auto it = latticeValues.find(value);
   if (it == latticeValues.end())
@@ -367,7 +508,7 @@ LatticeValue IMConstPropPass::getExtendedLatticeValue(Value value,
 /// Mark a block executable if it isn't already.  This does an initial scan of
 /// the block, processing nullary operations like wires, instances, and
 /// constants that only get processed once.
-void IMConstPropPass::markBlockExecutable(Block *block) {
+void ModuleLattice::markBlockExecutable(Block *block) {
   if (!executableBlocks.insert(block).second)
     return; // Already executable.
 
@@ -398,7 +539,7 @@ void IMConstPropPass::markBlockExecutable(Block *block) {
   }
 }
 
-void IMConstPropPass::markWireOrUnresetableRegOp(Operation *wireOrReg) {
+void ModuleLattice::markWireOrUnresetableRegOp(Operation *wireOrReg) {
   // If the wire/reg has a non-ground type, then it is too complex for us to
   // handle, mark it as overdefined.
   // TODO: Eventually add a field-sensitive model.
@@ -410,7 +551,7 @@ void IMConstPropPass::markWireOrUnresetableRegOp(Operation *wireOrReg) {
   mergeLatticeValue(resultValue, InvalidValueAttr::get(resultValue.getType()));
 }
 
-void IMConstPropPass::markRegResetOp(RegResetOp regReset) {
+void ModuleLattice::markRegResetOp(RegResetOp regReset) {
   // If the reg has a non-ground type, then it is too complex for us to handle,
   // mark it as overdefined.
   // TODO: Eventually add a field-sensitive model.
@@ -424,29 +565,29 @@ void IMConstPropPass::markRegResetOp(RegResetOp regReset) {
   mergeLatticeValue(regReset, srcValue);
 }
 
-void IMConstPropPass::markMemOp(MemOp mem) {
+void ModuleLattice::markMemOp(MemOp mem) {
   for (auto result : mem.getResults())
     markOverdefined(result);
 }
 
-void IMConstPropPass::markConstantOp(ConstantOp constant) {
+void ModuleLattice::markConstantOp(ConstantOp constant) {
   mergeLatticeValue(constant, LatticeValue(constant.valueAttr()));
 }
 
-void IMConstPropPass::markSpecialConstantOp(SpecialConstantOp specialConstant) {
+void ModuleLattice::markSpecialConstantOp(SpecialConstantOp specialConstant) {
   mergeLatticeValue(specialConstant, LatticeValue(specialConstant.valueAttr()));
 }
 
-void IMConstPropPass::markInvalidValueOp(InvalidValueOp invalid) {
+void ModuleLattice::markInvalidValueOp(InvalidValueOp invalid) {
   mergeLatticeValue(invalid, InvalidValueAttr::get(invalid.getType()));
 }
 
 /// Instances have no operands, so they are visited exactly once when their
 /// enclosing block is marked live.  This sets up the def-use edges for ports.
-void IMConstPropPass::markInstanceOp(InstanceOp instance) {
+void ModuleLattice::markInstanceOp(InstanceOp instance) {
   // Get the module being reference or a null pointer if this is an extmodule.
-  auto module =
-      dyn_cast<FModuleOp>(instanceGraph->getReferencedModule(instance));
+  auto *referencedModule = instanceGraph.getReferencedModule(instance);
+  auto module = dyn_cast<FModuleOp>(referencedModule);
 
   // If this is an extmodule, just remember that any results and inouts are
   // overdefined.
@@ -456,7 +597,7 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
       auto portVal = instance.getResult(resultNo);
       // If this is an input to the extmodule,
       // we can ignore it.
-      if (getModulePortDirection(instance.getReferencedModule(), resultNo) ==
+      if (getModulePortDirection(referencedModule, resultNo) ==
           Direction::Input)
         continue;
 
@@ -466,17 +607,19 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
     return;
   }
 
-  markBlockExecutable(module.getBodyBlock());
+  // The referenced module is solved separately, so ask for it to be marked
+  // live rather than doing it here.
+  outgoingExecutableModules.push_back(module);
 
-  // Ok, it is a normal internal module reference.  Populate
-  // resultPortToInstanceResultMapping, and forward any already-computed values.
+  // Ok, it is a normal internal module reference.  Queue the instance results
+  // to be added to resultPortToInstanceResultMapping, which also forwards any
+  // already-computed values.
   for (size_t resultNo = 0, e = instance.getNumResults(); resultNo != e;
        ++resultNo) {
     auto instancePortVal = instance.getResult(resultNo);
     // If this is an input to the instance, it will
     // get handled when any connects to it are processed.
-    if (getModulePortDirection(instance.getReferencedModule(), resultNo) ==
-        Direction::Input)
+    if (getModulePortDirection(referencedModule, resultNo) == Direction::Input)
       continue;
     // We only support simple values so far.
     if (!instancePortVal.getType().cast<FIRRTLType>().isGround()) {
@@ -488,16 +631,12 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
     // Otherwise we have a result from the instance.  We need to forward results
     // from the body to this instance result's SSA value, so remember it.
     BlockArgument modulePortVal = module.getPortArgument(resultNo);
-    resultPortToInstanceResultMapping[modulePortVal].push_back(instancePortVal);
-
-    // If there is already a value known for modulePortVal make sure to forward
-    // it here.
-    mergeLatticeValue(instancePortVal, modulePortVal);
+    outgoingInstanceResults.push_back({modulePortVal, instancePortVal});
   }
 }
 
 // We merge the value from the RHS into the value of the LHS.
-void IMConstPropPass::visitConnect(ConnectOp connect) {
+void ModuleLattice::visitConnect(ConnectOp connect) {
   auto destType = connect.dest().getType().cast<FIRRTLType>().getPassiveType();
 
   // TODO: Generalize to subaccesses etc when we have a field sensitive model.
@@ -512,11 +651,17 @@ void IMConstPropPass::visitConnect(ConnectOp connect) {
     return;
 
   // Driving result ports propagates the value to each instance using the
-  // module.
+  // module.  Remember what has been driven so that instances registered later
+  // see it too.
   if (auto blockArg = connect.dest().dyn_cast<BlockArgument>()) {
-    if (!AnnotationSet::get(blockArg).hasDontTouch())
-      for (auto userOfResultPort : resultPortToInstanceResultMapping[blockArg])
-        mergeLatticeValue(userOfResultPort, srcValue);
+    if (AnnotationSet::get(blockArg).hasDontTouch())
+      return;
+    if (!outputPortValues[blockArg].mergeIn(srcValue))
+      return;
+    auto it = resultPortToInstanceResultMapping.find(blockArg);
+    if (it != resultPortToInstanceResultMapping.end())
+      for (auto userOfResultPort : it->second)
+        outgoingValues.push_back({userOfResultPort, srcValue});
     return;
   }
 
@@ -531,13 +676,14 @@ void IMConstPropPass::visitConnect(ConnectOp connect) {
   // referenced module.
   if (auto instance = dest.getDefiningOp<InstanceOp>()) {
     auto module =
-        dyn_cast<FModuleOp>(instanceGraph->getReferencedModule(instance));
+        dyn_cast<FModuleOp>(instanceGraph.getReferencedModule(instance));
     if (!module)
       return;
 
     BlockArgument modulePortVal =
         module.getPortArgument(dest.getResultNumber());
-    return mergeLatticeValue(modulePortVal, srcValue);
+    outgoingValues.push_back({modulePortVal, srcValue});
+    return;
   }
 
   // Driving a memory result is ignored because these are always treated as
@@ -552,7 +698,7 @@ void IMConstPropPass::visitConnect(ConnectOp connect) {
       << "connect destination is here";
 }
 
-void IMConstPropPass::visitPartialConnect(PartialConnectOp partialConnect) {
+void ModuleLattice::visitPartialConnect(PartialConnectOp partialConnect) {
   partialConnect.emitError("IMConstProp cannot handle partial connect");
 }
 
@@ -562,7 +708,7 @@ void IMConstPropPass::visitPartialConnect(PartialConnectOp partialConnect) {
 ///
 /// This should update the lattice value state for any result values.
 ///
-void IMConstPropPass::visitOperation(Operation *op) {
+void ModuleLattice::visitOperation(Operation *op) {
   // If this is a operation with special handling, handle it specially.
   if (auto connectOp = dyn_cast<ConnectOp>(op))
     return visitConnect(connectOp);
@@ -648,7 +794,7 @@ void IMConstPropPass::visitOperation(Operation *op) {
   }
 }
 
-void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
+void ModuleLattice::rewriteModuleBody() {
   auto *body = module.getBodyBlock();
   // If a module is unreachable, just ignore it.
   if (!executableBlocks.count(body))
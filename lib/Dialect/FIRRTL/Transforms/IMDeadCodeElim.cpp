@@ -0,0 +1,325 @@
+//===- IMDeadCodeElim.cpp - Intermodule dead code elimination ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass which removes the declarations, expressions,
+// connects and ports of a circuit whose values are never observed, and the
+// modules left without instances.  Liveness starts at the operations with
+// effects, the annotated operations and ports, and the ports of the top-level,
+// uninstantiated and external modules.  It flows backwards from each live
+// value to the connects driving it, and through the instances to the ports of
+// the instantiated modules.  A port live in one instance of a module is live
+// in all of them, so it is only removed when no instance observes it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/AnnotationIndex.h"
+#include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
+#include "circt/Dialect/FIRRTL/InstanceGraph.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/DenseSet.h"
+
+using namespace circt;
+using namespace firrtl;
+
+/// Return the declaration or port a value is a part of, looking through the
+/// subfields, subindices and subaccesses of aggregates.
+static Value getDeclaration(Value value) {
+  while (auto *op = value.getDefiningOp()) {
+    if (auto subfield = dyn_cast<SubfieldOp>(op))
+      value = subfield.input();
+    else if (auto subindex = dyn_cast<SubindexOp>(op))
+      value = subindex.input();
+    else if (auto subaccess = dyn_cast<SubaccessOp>(op))
+      value = subaccess.input();
+    else
+      break;
+  }
+  return value;
+}
+
+/// Return true if the instance has an annotation on one of its ports.
+static bool hasPortAnnotations(InstanceOp instance) {
+  return llvm::any_of(instance.portAnnotations(), [](Attribute annotations) {
+    return !annotations.cast<ArrayAttr>().empty();
+  });
+}
+
+/// Return true if the operation may be erased once nothing observes its
+/// results: the declarations, connects and instances, whose liveness is
+/// tracked by the pass, and the operations without effects.  Annotated
+/// operations are always kept.
+static bool isDeletable(Operation *op) {
+  if (!AnnotationSet(op).empty())
+    return false;
+  if (auto instance = dyn_cast<InstanceOp>(op))
+    return !hasPortAnnotations(instance);
+  if (isa<WireOp, RegOp, RegResetOp, NodeOp, ConnectOp, PartialConnectOp>(op))
+    return true;
+  return op->getNumRegions() == 0 && MemoryEffectOpInterface::hasNoEffect(op);
+}
+
+namespace {
+struct IMDeadCodeElimPass : public IMDeadCodeElimBase<IMDeadCodeElimPass> {
+  void runOnOperation() override;
+
+private:
+  void visitModule(FModuleOp module, InstanceGraphNode *topLevel);
+  void processValue(Value value);
+  void rewriteModule(FModuleOp module);
+  void removePorts(FModuleOp module);
+
+  void markValueLive(Value value) {
+    if (liveValues.insert(value).second)
+      worklist.push_back(value);
+  }
+  void markOpLive(Operation *op);
+  void markPortLive(Operation *module, unsigned portNo);
+  void markModuleKept(Operation *module);
+
+  InstanceGraph *instanceGraph;
+  AnnotationIndex *annotationIndex;
+
+  /// The live values, and the ones among them yet to be processed.
+  DenseSet<Value> liveValues;
+  SmallVector<Value> worklist;
+
+  /// The operations which are kept.
+  DenseSet<Operation *> liveOps;
+
+  /// The live ports, by module and port number.
+  DenseSet<std::pair<Operation *, unsigned>> livePorts;
+
+  /// The modules whose instances are kept, since they have effects.
+  DenseSet<Operation *> keptModules;
+
+  /// The connects driving each declaration or port, or a part of it.
+  DenseMap<Value, SmallVector<Operation *, 1>> drivers;
+
+  /// The graph records of the instances.
+  DenseMap<Operation *, InstanceRecord *> instanceRecords;
+
+  bool changed;
+};
+} // end anonymous namespace
+
+/// Keep an operation, along with its operands and the operations it is nested
+/// in.
+void IMDeadCodeElimPass::markOpLive(Operation *op) {
+  if (!liveOps.insert(op).second)
+    return;
+  for (auto operand : op->getOperands())
+    markValueLive(operand);
+  auto *parent = op->getParentOp();
+  if (!isa<FModuleOp>(parent))
+    markOpLive(parent);
+}
+
+/// Mark a port live in the module and in every instance of it.
+void IMDeadCodeElimPass::markPortLive(Operation *module, unsigned portNo) {
+  if (!livePorts.insert({module, portNo}).second)
+    return;
+  if (auto fmodule = dyn_cast<FModuleOp>(module))
+    markValueLive(fmodule.getPortArgument(portNo));
+  for (auto *use : instanceGraph->lookup(module)->uses())
+    markValueLive(use->getInstance().getResult(portNo));
+}
+
+/// Keep every instance of a module with effects, and thus the modules
+/// containing them.
+void IMDeadCodeElimPass::markModuleKept(Operation *module) {
+  if (!keptModules.insert(module).second)
+    return;
+  for (auto *use : instanceGraph->lookup(module)->uses()) {
+    markOpLive(use->getInstance());
+    markModuleKept(use->getParent()->getModule());
+  }
+}
+
+/// Record the connects of a module and find its roots of liveness.
+void IMDeadCodeElimPass::visitModule(FModuleOp module,
+                                     InstanceGraphNode *topLevel) {
+  // The ports of the top-level and uninstantiated modules are observed from
+  // the outside.  Aggregate ports are kept whole, and annotated ports are
+  // kept along with the module.
+  auto *node = instanceGraph->lookup(module);
+  bool isPublic = node == topLevel || node->noUses();
+  if (isPublic || !AnnotationSet(module).empty())
+    markModuleKept(module);
+  for (auto port : llvm::enumerate(getModulePortInfo(module)))
+    if (isPublic || !port.value().type.isGround() ||
+        !port.value().annotations.empty())
+      markPortLive(module, port.index());
+
+  module.getBody()->walk([&](Operation *op) {
+    if (isa<ConnectOp, PartialConnectOp>(op))
+      drivers[getDeclaration(op->getOperand(0))].push_back(op);
+    if (isDeletable(op))
+      return;
+    markOpLive(op);
+    for (auto result : op->getResults())
+      markValueLive(result);
+    markModuleKept(module);
+  });
+}
+
+/// Keep the connects driving a live value, and the operation or port it
+/// comes from.
+void IMDeadCodeElimPass::processValue(Value value) {
+  auto it = drivers.find(value);
+  if (it != drivers.end())
+    for (auto *connect : it->second)
+      markOpLive(connect);
+
+  if (auto arg = value.dyn_cast<BlockArgument>()) {
+    markPortLive(arg.getOwner()->getParentOp(), arg.getArgNumber());
+    return;
+  }
+
+  auto *op = value.getDefiningOp();
+  markOpLive(op);
+  if (auto instance = dyn_cast<InstanceOp>(op))
+    markPortLive(instanceGraph->getReferencedModule(instance),
+                 value.cast<OpResult>().getResultNumber());
+}
+
+/// Erase the dead operations of a module.
+void IMDeadCodeElimPass::rewriteModule(FModuleOp module) {
+  // Erase the users before the values they use.
+  SmallVector<Operation *> deadOps;
+  module.getBody()->walk([&](Operation *op) {
+    if (!liveOps.count(op))
+      deadOps.push_back(op);
+  });
+  for (auto *op : llvm::reverse(deadOps)) {
+    if (isa<InstanceOp>(op))
+      instanceRecords.lookup(op)->erase();
+    op->erase();
+  }
+  numErasedOps += deadOps.size();
+  changed |= !deadOps.empty();
+}
+
+/// Remove the dead ports of a module from it and from all its instances.
+void IMDeadCodeElimPass::removePorts(FModuleOp module) {
+  SmallVector<unsigned> deadPorts;
+  for (unsigned i = 0, e = module.getNumArguments(); i != e; ++i)
+    if (!livePorts.count({module, i}))
+      deadPorts.push_back(i);
+  if (deadPorts.empty())
+    return;
+
+  for (auto *use : instanceGraph->lookup(module)->uses()) {
+    auto instance = use->getInstance();
+    OpBuilder builder(instance);
+    auto newInstance =
+        builder.create<InstanceOp>(instance.getLoc(), instance, deadPorts);
+    ArrayRef<Attribute> portAnnotations = instance.portAnnotations().getValue();
+    if (!portAnnotations.empty()) {
+      SmallVector<Attribute> newPortAnnotations;
+      for (unsigned i = 0, j = 0, e = portAnnotations.size(); i != e; ++i) {
+        if (j < deadPorts.size() && deadPorts[j] == i)
+          ++j;
+        else
+          newPortAnnotations.push_back(portAnnotations[i]);
+      }
+      newInstance.setAllPortAnnotations(newPortAnnotations);
+    }
+
+    // The results of the dead ports have no uses left.
+    unsigned newResult = 0;
+    for (auto result : instance.getResults())
+      if (!result.use_empty())
+        result.replaceAllUsesWith(newInstance.getResult(newResult++));
+      else if (livePorts.count({module, result.getResultNumber()}))
+        ++newResult;
+    use->setInstance(newInstance);
+    if (annotationIndex)
+      annotationIndex->erase(instance);
+    instance.erase();
+    if (annotationIndex)
+      annotationIndex->update(newInstance);
+  }
+
+  // The annotations of the remaining ports have moved.
+  module.erasePorts(deadPorts);
+  if (annotationIndex)
+    annotationIndex->update(module);
+  numRemovedPorts += deadPorts.size();
+  changed = true;
+}
+
+void IMDeadCodeElimPass::runOnOperation() {
+  auto circuit = getOperation();
+  instanceGraph = &getAnalysis<InstanceGraph>();
+  auto cachedIndex = getCachedAnalysis<AnnotationIndex>();
+  annotationIndex = cachedIndex ? &cachedIndex->get() : nullptr;
+
+  liveValues.clear();
+  worklist.clear();
+  liveOps.clear();
+  livePorts.clear();
+  keptModules.clear();
+  drivers.clear();
+  instanceRecords.clear();
+  changed = false;
+
+  // Remember the modules which are instantiated before any instance goes.
+  SmallVector<InstanceGraphNode *> instantiated;
+  for (auto *node : *instanceGraph) {
+    if (!node->noUses())
+      instantiated.push_back(node);
+    for (auto *record : node->instances())
+      instanceRecords[record->getInstance()] = record;
+  }
+
+  // Find the roots of liveness, and propagate it once all the connects are
+  // known.  The ports of the external modules are all observed.
+  auto *topLevel = instanceGraph->getTopLevelNode();
+  for (auto &op : *circuit.getBody()) {
+    if (auto module = dyn_cast<FModuleOp>(op)) {
+      visitModule(module, topLevel);
+    } else if (isa<FExtModuleOp>(op)) {
+      markModuleKept(&op);
+      for (unsigned i = 0, e = getModulePortInfo(&op).size(); i != e; ++i)
+        markPortLive(&op, i);
+    }
+  }
+  while (!worklist.empty())
+    processValue(worklist.pop_back_val());
+
+  auto modules = circuit.getBody()->getOps<FModuleOp>();
+  for (auto module : modules)
+    rewriteModule(module);
+  for (auto module : modules)
+    removePorts(module);
+
+  // Erase the modules whose instances all went away.
+  for (auto *node : instantiated) {
+    if (!node->noUses())
+      continue;
+    auto *module = node->getModule();
+    instanceGraph->erase(node);
+    if (annotationIndex)
+      annotationIndex->erase(module);
+    module->erase();
+    ++numErasedModules;
+    changed = true;
+  }
+
+  // The instance graph and the annotations are kept up to date.
+  if (!changed)
+    markAllAnalysesPreserved();
+  else
+    markAnalysesPreserved<InstanceGraph, AnnotationIndex>();
+}
+
+std::unique_ptr<mlir::Pass> circt::firrtl::createIMDeadCodeElimPass() {
+  return std::make_unique<IMDeadCodeElimPass>();
+}
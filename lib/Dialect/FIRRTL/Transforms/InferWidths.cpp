@@ -16,15 +16,19 @@
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Support/FieldRef.h"
+#include "mlir/IR/Diagnostics.h"
 #include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/IntEqClasses.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 #define DEBUG_TYPE "infer-widths"
 
@@ -120,6 +124,10 @@ struct VarExpr : public ExprBase<VarExpr, Expr::Kind::Var> {
   /// The constraint expression this variable is supposed to be greater than or
   /// equal to. This is not part of the variable's hash and equality property.
   Expr *constraint = nullptr;
+
+  /// The value in the IR that this variable was created for, used for error
+  /// reporting.
+  FieldRef fieldRef = {};
 };
 
 /// An identity expression.
@@ -317,6 +325,9 @@ class InternedAllocator {
 public:
   InternedAllocator(llvm::BumpPtrAllocator &allocator) : allocator(allocator) {}
 
+  /// Return the number of bytes used by the interning table.
+  size_t getMemorySize() const { return interned.getMemorySize(); }
+
   /// Allocate a new object if it does not yet exist, or return a pointer to the
   /// existing one. `R` is the type of the object to be allocated. `R` must be
   /// derived from or be the type `T`.
@@ -584,10 +595,10 @@ public:
   VarExpr *var() {
     auto v = vars.alloc();
     exprs.push_back(v);
-    if (currentInfo)
-      info[v].insert(currentInfo);
+    v->fieldRef = currentInfo;
     if (currentLoc)
       locs[v].insert(*currentLoc);
+    ++numVars;
     return v;
   }
   KnownExpr *known(int32_t value) { return alloc<KnownExpr>(knowns, value); }
@@ -608,13 +619,18 @@ public:
   }
 
   void dumpConstraints(llvm::raw_ostream &os);
-  LogicalResult solve();
+  LogicalResult solve(MLIRContext *context);
 
-  using ContextInfo = DenseMap<Expr *, llvm::SmallSetVector<FieldRef, 1>>;
-  const ContextInfo &getContextInfo() const { return info; }
   void setCurrentContextInfo(FieldRef fieldRef) { currentInfo = fieldRef; }
   void setCurrentLocation(Optional<Location> loc) { currentLoc = loc; }
 
+  /// Return the number of expressions and variables in the problem.
+  size_t getNumExprs() const { return exprs.size(); }
+  size_t getNumVars() const { return numVars; }
+
+  /// Return an estimate of the number of bytes used by the solver.
+  size_t getMemorySize() const;
+
 private:
   // Allocator for constraint expressions.
   llvm::BumpPtrAllocator allocator;
@@ -634,20 +650,25 @@ private:
     auto it = allocator.template alloc<R>(std::forward<Args>(args)...);
     if (it.second)
       exprs.push_back(it.first);
-    if (currentInfo)
-      info[it.first].insert(currentInfo);
-    if (currentLoc)
+    // Known constants are shared by the whole problem and never show up in
+    // diagnostics, so don't bother recording where they are used.
+    if (currentLoc && !isa<KnownExpr>(it.first))
       locs[it.first].insert(*currentLoc);
     return it.first;
   }
 
-  /// Contextual information for each expression, indicating which values in the
-  /// IR lead to this expression.
-  ContextInfo info;
+  /// The value in the IR that new variables are created for.
   FieldRef currentInfo = {};
-  DenseMap<Expr *, llvm::SmallSetVector<Location, 1>> locs;
+
+  /// The locations in the IR that lead to each expression, used to attach
+  /// notes to diagnostics.
+  using LocationSet = llvm::SmallSetVector<Location, 1>;
+  DenseMap<Expr *, LocationSet> locs;
   Optional<Location> currentLoc = {};
 
+  /// The number of variables among the expressions.
+  size_t numVars = 0;
+
   // Forbid copyign or moving the solver, which would invalidate the refs to
   // allocator held by the allocators.
   ConstraintSolver(ConstraintSolver &&) = delete;
@@ -657,6 +678,10 @@ private:
 
   bool emitUninferredWidthError(VarExpr *var);
 
+  void partitionVars(std::vector<SmallVector<VarExpr *, 4>> &groups);
+  bool checkVar(VarExpr *var, SmallPtrSetImpl<Expr *> &seenVars);
+  bool solveVar(VarExpr *var, SmallPtrSetImpl<Expr *> &seenVars);
+
   LinIneq checkCycles(VarExpr *var, Expr *expr,
                       SmallPtrSetImpl<Expr *> &seenVars,
                       InFlightDiagnostic *reportInto = nullptr,
@@ -665,6 +690,18 @@ private:
 
 } // namespace
 
+size_t ConstraintSolver::getMemorySize() const {
+  size_t size = allocator.getTotalMemory() + knowns.getMemorySize() +
+                ids.getMemorySize() + uns.getMemorySize() +
+                bins.getMemorySize() + exprs.capacity() * sizeof(Expr *) +
+                locs.getMemorySize();
+  // Location sets with more than one entry spill out of their inline storage.
+  for (auto &entry : locs)
+    if (entry.second.size() > 1)
+      size += entry.second.size() * (sizeof(Location) * 2);
+  return size;
+}
+
 /// Print all constraints in the solver to an output stream.
 void ConstraintSolver::dumpConstraints(llvm::raw_ostream &os) {
   for (auto *e : exprs) {
@@ -897,117 +934,187 @@ static ExprSolution solveExpr(Expr *expr, SmallPtrSetImpl<Expr *> &seenVars,
   return solution;
 }
 
+/// Partition the variables into groups that share no expressions other than
+/// known constants, which are never modified by the solver. Each group can be
+/// checked and solved independently of the others. The groups are sorted by
+/// their first variable, and the variables in each group kept in order.
+void ConstraintSolver::partitionVars(
+    std::vector<SmallVector<VarExpr *, 4>> &groups) {
+  DenseMap<Expr *, unsigned> exprIndices;
+  exprIndices.reserve(exprs.size());
+  for (auto *expr : exprs)
+    exprIndices.insert({expr, exprIndices.size()});
+
+  // Join each expression with the expressions it uses.
+  llvm::IntEqClasses classes(exprs.size());
+  for (auto *expr : exprs) {
+    if (isa<KnownExpr>(expr))
+      continue;
+    auto index = exprIndices.lookup(expr);
+    for (auto *child : llvm::children<Expr *>(expr))
+      if (!isa<KnownExpr>(child))
+        classes.join(index, exprIndices.lookup(child));
+  }
+  classes.compress();
+
+  DenseMap<unsigned, unsigned> groupIndices;
+  for (auto *expr : exprs) {
+    auto *var = dyn_cast<VarExpr>(expr);
+    if (!var)
+      continue;
+    auto it = groupIndices.insert(
+        {classes[exprIndices.lookup(var)], groupIndices.size()});
+    if (it.second)
+      groups.emplace_back();
+    groups[it.first->second].push_back(var);
+  }
+}
+
+/// Check the constraint of a variable for unbreakable cycles. Returns true if
+/// an error was reported, false otherwise.
+bool ConstraintSolver::checkVar(VarExpr *var,
+                                SmallPtrSetImpl<Expr *> &seenVars) {
+  if (!var->constraint)
+    return false;
+  LLVM_DEBUG(llvm::dbgs() << "- Checking " << *var << " >= " << *var->constraint
+                          << "\n");
+
+  // Canonicalize the variable's constraint expression into a form that allows
+  // us to easily determine if any recursion leads to an unsatisfiable
+  // constraint. The `seenVars` set acts as a recursion breaker.
+  seenVars.insert(var);
+  auto ineq = checkCycles(var, var->constraint, seenVars);
+  seenVars.clear();
+
+  // If the constraint is satisfiable, we're done.
+  // TODO: It's possible that this result is already sufficient to arrive at a
+  // solution for the constraint, and the second pass further down is not
+  // necessary. This would require more proper handling of `MinExpr` in the
+  // cycle checking code.
+  if (ineq.sat()) {
+    LLVM_DEBUG(llvm::dbgs() << "  = Breakable since " << ineq
+                            << " satisfiable\n");
+    return false;
+  }
+
+  // If we arrive here, the constraint is not satisfiable at all. To provide
+  // some guidance to the user, we call the cycle checking code again, but
+  // this time with an in-flight diagnostic to attach notes indicating
+  // unsatisfiable paths in the cycle.
+  LLVM_DEBUG(llvm::dbgs() << "  = UNBREAKABLE since " << ineq
+                          << " unsatisfiable\n");
+  // Depending on whether this value stems from an operation or not, create an
+  // appropriate diagnostic identifying the value.
+  auto fieldRef = var->fieldRef;
+  auto op = fieldRef.getDefiningOp();
+  auto diag = op ? op->emitOpError()
+                 : mlir::emitError(fieldRef.getValue().getLoc()) << "value ";
+  diag << "is constrained to be wider than itself";
+
+  // Re-run the cycle checking, but this time reporting into the diagnostic.
+  seenVars.insert(var);
+  checkCycles(var, var->constraint, seenVars, &diag);
+  seenVars.clear();
+  return true;
+}
+
+/// Compute the solution of a variable. Returns true if an error was reported,
+/// false otherwise.
+bool ConstraintSolver::solveVar(VarExpr *var,
+                                SmallPtrSetImpl<Expr *> &seenVars) {
+  // Complain about unconstrained variables.
+  if (!var->constraint) {
+    LLVM_DEBUG(llvm::dbgs() << "- Unconstrained " << *var << "\n");
+    return emitUninferredWidthError(var);
+  }
+
+  // Compute the value for the variable.
+  LLVM_DEBUG(llvm::dbgs() << "- Solving " << *var << " >= " << *var->constraint
+                          << "\n");
+  seenVars.insert(var);
+  auto solution = solveExpr(var->constraint, seenVars);
+  seenVars.clear();
+
+  // Constrain variables >= 0.
+  if (solution.first && *solution.first < 0)
+    solution.first = 0;
+  var->solution = solution.first;
+
+  // In case the width could not be inferred, complain to the user. This might
+  // be the case if the width depends on an unconstrained variable.
+  if (!solution.first) {
+    LLVM_DEBUG(llvm::dbgs() << "  - UNSOLVED " << *var << "\n");
+    return emitUninferredWidthError(var);
+  }
+  LLVM_DEBUG(llvm::dbgs() << "  - Solved " << *var << " = " << solution.first
+                          << " ("
+                          << (solution.second ? "cycle broken" : "unique")
+                          << ")\n");
+  return false;
+}
+
 /// Solve the constraint problem. This is a very simple implementation that
 /// does not fully solve the problem if there are weird dependency cycles
 /// present.
-LogicalResult ConstraintSolver::solve() {
+///
+/// Groups of variables that share no expressions are independent of each
+/// other, and are checked and solved in parallel if the context allows it.
+/// Diagnostics are reported in the order of the groups.
+LogicalResult ConstraintSolver::solve(MLIRContext *context) {
   LLVM_DEBUG({
     llvm::dbgs() << "\n===----- Constraints -----===\n\n";
     dumpConstraints(llvm::dbgs());
   });
 
-  // Ensure that there are no adverse cycles around.
-  LLVM_DEBUG(
-      llvm::dbgs() << "\n===----- Checking for unbreakable loops -----===\n\n");
-  SmallPtrSet<Expr *, 16> seenVars;
-  bool anyFailed = false;
-
-  for (auto *expr : exprs) {
-    // Only work on variables.
-    auto *var = dyn_cast<VarExpr>(expr);
-    if (!var || !var->constraint)
-      continue;
-    LLVM_DEBUG(llvm::dbgs()
-               << "- Checking " << *var << " >= " << *var->constraint << "\n");
-
-    // Canonicalize the variable's constraint expression into a form that allows
-    // us to easily determine if any recursion leads to an unsatisfiable
-    // constraint. The `seenVars` set acts as a recursion breaker.
-    seenVars.insert(var);
-    auto ineq = checkCycles(var, var->constraint, seenVars);
-    seenVars.clear();
-
-    // If the constraint is satisfiable, we're done.
-    // TODO: It's possible that this result is already sufficient to arrive at a
-    // solution for the constraint, and the second pass further down is not
-    // necessary. This would require more proper handling of `MinExpr` in the
-    // cycle checking code.
-    if (ineq.sat()) {
-      LLVM_DEBUG(llvm::dbgs()
-                 << "  = Breakable since " << ineq << " satisfiable\n");
-      continue;
-    }
+  // Run `fn` on every variable. If there is more than one group of variables,
+  // run the groups in parallel. Keep the debug output readable by staying on
+  // one thread when it is enabled.
+  std::vector<SmallVector<VarExpr *, 4>> groups;
+  bool parallel = context->isMultithreadingEnabled();
+  LLVM_DEBUG(parallel = false);
+  if (parallel)
+    partitionVars(groups);
+  parallel &= groups.size() > 1;
+
+  auto forEachVar =
+      [&](llvm::function_ref<bool(VarExpr *, SmallPtrSetImpl<Expr *> &)> fn) {
+        if (!parallel) {
+          SmallPtrSet<Expr *, 16> seenVars;
+          bool anyFailed = false;
+          for (auto *expr : exprs)
+            if (auto *var = dyn_cast<VarExpr>(expr))
+              anyFailed |= fn(var, seenVars);
+          return anyFailed;
+        }
 
-    // If we arrive here, the constraint is not satisfiable at all. To provide
-    // some guidance to the user, we call the cycle checking code again, but
-    // this time with an in-flight diagnostic to attach notes indicating
-    // unsatisfiable paths in the cycle.
-    LLVM_DEBUG(llvm::dbgs()
-               << "  = UNBREAKABLE since " << ineq << " unsatisfiable\n");
-    anyFailed = true;
-    for (auto fieldRef : info.find(var)->second) {
-      // Depending on whether this value stems from an operation or not, create
-      // an appropriate diagnostic identifying the value.
-      auto op = fieldRef.getDefiningOp();
-      auto diag = op ? op->emitOpError()
-                     : mlir::emitError(fieldRef.getValue().getLoc())
-                           << "value ";
-      diag << "is constrained to be wider than itself";
-
-      // Re-run the cycle checking, but this time reporting into the diagnostic.
-      seenVars.insert(var);
-      checkCycles(var, var->constraint, seenVars, &diag);
-      seenVars.clear();
-    }
-  }
+        mlir::ParallelDiagnosticHandler diagHandler(context);
+        std::atomic<bool> anyFailed{false};
+        llvm::parallelForEachN(0, groups.size(), [&](size_t index) {
+          diagHandler.setOrderIDForThread(index);
+          SmallPtrSet<Expr *, 16> seenVars;
+          for (auto *var : groups[index])
+            if (fn(var, seenVars))
+              anyFailed = true;
+        });
+        return bool(anyFailed);
+      };
 
-  // If there were cycles, return now to avoid complaining to the user about
-  // dependent widths not being inferred.
-  if (anyFailed)
+  // Ensure that there are no adverse cycles around. If there were cycles,
+  // return now to avoid complaining to the user about dependent widths not
+  // being inferred.
+  LLVM_DEBUG(
+      llvm::dbgs() << "\n===----- Checking for unbreakable loops -----===\n\n");
+  if (forEachVar([&](VarExpr *var, SmallPtrSetImpl<Expr *> &seenVars) {
+        return checkVar(var, seenVars);
+      }))
     return failure();
 
   // Iterate over the constraint variables and solve each.
   LLVM_DEBUG(llvm::dbgs() << "\n===----- Solving constraints -----===\n\n");
-  for (auto *expr : exprs) {
-    // Only work on variables.
-    auto *var = dyn_cast<VarExpr>(expr);
-    if (!var)
-      continue;
-
-    // Complain about unconstrained variables.
-    if (!var->constraint) {
-      LLVM_DEBUG(llvm::dbgs() << "- Unconstrained " << *var << "\n");
-      if (emitUninferredWidthError(var))
-        anyFailed = true;
-      continue;
-    }
-
-    // Compute the value for the variable.
-    LLVM_DEBUG(llvm::dbgs()
-               << "- Solving " << *var << " >= " << *var->constraint << "\n");
-    seenVars.insert(var);
-    auto solution = solveExpr(var->constraint, seenVars);
-    seenVars.clear();
-
-    // Constrain variables >= 0.
-    if (solution.first && *solution.first < 0)
-      solution.first = 0;
-
-    // In case the width could not be inferred, complain to the user. This might
-    // be the case if the width depends on an unconstrained variable.
-    if (!solution.first) {
-      LLVM_DEBUG(llvm::dbgs() << "  - UNSOLVED " << *var << "\n");
-      if (emitUninferredWidthError(var))
-        anyFailed = true;
-    } else {
-      LLVM_DEBUG(llvm::dbgs()
-                 << "  - Solved " << *var << " = " << solution.first << " ("
-                 << (solution.second ? "cycle broken" : "unique") << ")\n");
-    }
-    var->solution = solution.first;
-  }
-
-  return failure(anyFailed);
+  return failure(
+      forEachVar([&](VarExpr *var, SmallPtrSetImpl<Expr *> &seenVars) {
+        return solveVar(var, seenVars);
+      }));
 }
 
 // Emits the diagnostic to inform the user about an uninferred width in the
@@ -1015,7 +1122,7 @@ LogicalResult ConstraintSolver::solve() {
 // occurs if the unconstrained variable is for an InvalidValueOp, which we
 // ignore.
 bool ConstraintSolver::emitUninferredWidthError(VarExpr *var) {
-  FieldRef fieldRef = info.find(var)->second.back();
+  FieldRef fieldRef = var->fieldRef;
   Value value = fieldRef.getValue();
 
   // We ignore `firrtl.invalidvalue` because we lack the information to infer a
@@ -1126,7 +1233,13 @@ public:
   void setExpr(FieldRef fieldRef, Expr *expr);
 
   /// Return whether a module was skipped due to being fully inferred already.
-  bool isModuleSkipped(ModuleOp module) { return skippedModules.count(module); }
+  bool isModuleSkipped(FModuleOp module) { return skippedModules.count(module); }
+
+  /// Return the number of modules that were skipped.
+  size_t getNumSkippedModules() { return skippedModules.size(); }
+
+  /// Return the number of bytes used by the mapping's side tables.
+  size_t getMemorySize() { return opExprs.getMemorySize(); }
 
   /// Return whether all modules in the mapping were fully inferred.
   bool areAllModulesSkipped() { return allModulesSkipped; }
@@ -1754,7 +1867,7 @@ LogicalResult InferenceTypeUpdate::update(CircuitOp op) {
   anyFailed = false;
   op.walk<WalkOrder::PreOrder>([&](Operation *op) {
     // Skip this module if it had no widths to be inferred at all.
-    if (auto module = dyn_cast<ModuleOp>(op))
+    if (auto module = dyn_cast<FModuleOp>(op))
       if (mapping.isModuleSkipped(module))
         return WalkResult::skip();
 
@@ -2000,13 +2113,17 @@ void InferWidthsPass::runOnOperation() {
     signalPassFailure();
     return;
   }
+  numSkippedModules += mapping.getNumSkippedModules();
+  numExprs += solver.getNumExprs();
+  numVars += solver.getNumVars();
+  solverMemory += (solver.getMemorySize() + mapping.getMemorySize()) / 1024;
   if (mapping.areAllModulesSkipped()) {
     markAllAnalysesPreserved();
     return; // fast path if no inferrable widths are around
   }
 
   // Solve the constraints.
-  if (failed(solver.solve())) {
+  if (failed(solver.solve(&getContext()))) {
     signalPassFailure();
     return;
   }
@@ -25,6 +25,18 @@
 // the worklist.  Often aggregates are shallow, so the new ops are the final
 // ones.
 //
+// When aggregates are preserved, passive bundles which are only read through
+// field accesses and only written as a whole are kept intact, and become
+// hw.struct values when lowered to HW.  This is decided for the whole circuit
+// before any module is lowered, since a module port and the corresponding
+// instance results must agree.
+//
+// Each module is lowered independently, including its signature: instances
+// are lowered based on their own result types, which match the referenced
+// module's original port types, and never look at the referenced module. This
+// lets the modules of a circuit be lowered in parallel without a separate
+// phase to rewrite the module signatures first.
+//
 //===----------------------------------------------------------------------===//
 
 #include "PassDetails.h"
@@ -34,6 +46,9 @@
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Parallel.h"
 #include <deque>
 
@@ -101,6 +116,170 @@ static bool peelType(Type type, SmallVectorImpl<FlatBundleFieldEntry> &fields) {
       .Default([](auto op) { return false; });
 }
 
+/// Return true if the specified type is a bundle which can be kept intact and
+/// lowered to an hw.struct: it is passive, and only contains ground types with
+/// a known, non-zero width, or other such bundles.
+static bool isPreservableAggregate(FIRRTLType type) {
+  auto bundle = type.dyn_cast<BundleType>();
+  if (!bundle)
+    return false;
+  auto props = bundle.getRecursiveTypeProperties();
+  if (!props.isPassive || props.containsAnalog || props.hasUninferredWidth)
+    return false;
+  return llvm::all_of(bundle.getElements(), [](BundleType::BundleElement elt) {
+    if (elt.type.isa<BundleType>())
+      return isPreservableAggregate(elt.type);
+    return elt.type.isGround() && elt.type.getBitWidthOrSentinel() > 0;
+  });
+}
+
+/// Return true if any of the annotations only applies to some of the fields,
+/// which is only handled by splitting the aggregate.
+static bool hasSubAnnotations(ArrayAttr annotations) {
+  return annotations && llvm::any_of(annotations, [](Attribute attr) {
+           return attr.isa<SubAnnotationAttr>();
+         });
+}
+
+/// Return the aggregate that a value reads from, looking through any field
+/// accesses.
+static Value getAccessedAggregate(Value value) {
+  while (auto subfield = value.getDefiningOp<SubfieldOp>())
+    value = subfield.input();
+  return value;
+}
+
+/// Call `fn` on every use of a value and of the field accesses into it.
+static void walkFieldUses(Value value,
+                          llvm::function_ref<void(OpOperand &)> fn) {
+  for (auto &use : value.getUses()) {
+    if (auto subfield = dyn_cast<SubfieldOp>(use.getOwner()))
+      walkFieldUses(subfield, fn);
+    else
+      fn(use);
+  }
+}
+
+/// Find the aggregate values in the circuit which can be kept intact, and
+/// record them for the module they are in.  The candidates are the wires,
+/// nodes, registers, module ports and instance results of a preservable bundle
+/// type.  The lowering of an aggregate only knows how to update field accesses
+/// into it, and HW has no way to write a single field of a struct, so a
+/// candidate must only be written by connecting the whole value from another
+/// intact value outside of any when, and a node or the reset value of a
+/// register must be an intact value.  A module port and all the instance
+/// results for it are kept or lowered together.
+static void
+findPreservedAggregates(CircuitOp circuit,
+                        DenseMap<Operation *, DenseSet<Value>> &results) {
+  SymbolTable symbolTable(circuit);
+
+  // Each group of values is kept or lowered as a unit.
+  SmallVector<SmallVector<Value, 1>> groups;
+  DenseMap<Value, unsigned> groupOf;
+  DenseMap<std::pair<Operation *, unsigned>, unsigned> portGroups;
+  auto addToGroup = [&](Value value, unsigned group) {
+    groups[group].push_back(value);
+    groupOf[value] = group;
+  };
+  auto addGroup = [&](Value value) {
+    groups.emplace_back();
+    addToGroup(value, groups.size() - 1);
+    return groups.size() - 1;
+  };
+
+  for (auto module : circuit.getBody()->getOps<FModuleOp>()) {
+    for (auto port : llvm::enumerate(module.getPorts()))
+      if (isPreservableAggregate(port.value().type) &&
+          !hasSubAnnotations(port.value().annotations.getArrayAttr()))
+        portGroups[{module, port.index()}] =
+            addGroup(module.getPortArgument(port.index()));
+  }
+
+  for (auto module : circuit.getBody()->getOps<FModuleOp>()) {
+    module.walk([&](Operation *op) {
+      if (auto instance = dyn_cast<InstanceOp>(op)) {
+        auto *referencedModule = symbolTable.lookup(instance.moduleName());
+        for (auto result : llvm::enumerate(instance.results())) {
+          auto it = portGroups.find({referencedModule, result.index()});
+          if (it != portGroups.end())
+            addToGroup(result.value(), it->second);
+        }
+        return;
+      }
+      if (!isa<WireOp, NodeOp, RegOp, RegResetOp>(op) ||
+          !isPreservableAggregate(
+              op->getResult(0).getType().cast<FIRRTLType>()) ||
+          hasSubAnnotations(op->getAttrOfType<ArrayAttr>("annotations")))
+        return;
+      addGroup(op->getResult(0));
+    });
+  }
+
+  llvm::BitVector preserved(groups.size(), true);
+  auto isPreserved = [&](Value value) {
+    auto it = groupOf.find(getAccessedAggregate(value));
+    return it != groupOf.end() && preserved[it->second];
+  };
+
+  auto canPreserve = [&](Value value) {
+    if (auto node = value.getDefiningOp<NodeOp>())
+      if (!isPreserved(node.input()))
+        return false;
+    if (auto reg = value.getDefiningOp<RegResetOp>())
+      if (!isPreserved(reg.resetValue()))
+        return false;
+    bool valid = true;
+    walkFieldUses(value, [&](OpOperand &use) {
+      auto *user = use.getOwner();
+      if (!isa<ConnectOp, PartialConnectOp>(user) || use.getOperandNumber())
+        return;
+      auto connect = dyn_cast<ConnectOp>(user);
+      if (!connect || use.get() != value ||
+          !isa<FModuleOp>(connect->getParentOp()) ||
+          connect.src().getType() != value.getType() ||
+          !isPreserved(connect.src()))
+        valid = false;
+    });
+    return valid;
+  };
+
+  // Lowering a group invalidates the values initialized from it, so iterate
+  // until nothing changes.
+  SmallVector<unsigned> worklist;
+  for (unsigned group = 0, e = groups.size(); group != e; ++group)
+    worklist.push_back(group);
+  while (!worklist.empty()) {
+    auto group = worklist.pop_back_val();
+    if (!preserved[group] || llvm::all_of(groups[group], canPreserve))
+      continue;
+    preserved.reset(group);
+    for (auto value : groups[group]) {
+      walkFieldUses(value, [&](OpOperand &use) {
+        Value dependent;
+        if (auto node = dyn_cast<NodeOp>(use.getOwner()))
+          dependent = node.result();
+        else if (auto reg = dyn_cast<RegResetOp>(use.getOwner()))
+          dependent = reg.result();
+        else if (auto connect = dyn_cast<ConnectOp>(use.getOwner()))
+          dependent = connect.dest();
+        auto it = groupOf.find(dependent);
+        if (it != groupOf.end())
+          worklist.push_back(it->second);
+      });
+    }
+  }
+
+  for (auto group : preserved.set_bits()) {
+    for (auto value : groups[group]) {
+      auto *op = value.getParentRegion()->getParentOp();
+      if (!isa<FModuleOp>(op))
+        op = op->getParentOfType<FModuleOp>();
+      results[op].insert(value);
+    }
+  }
+}
+
 /// Look through and collect subfields leading to a subaccess.
 static SmallVector<Operation *> getSAWritePath(Operation *op) {
   SmallVector<Operation *> retval;
@@ -119,7 +298,7 @@ static SmallVector<Operation *> getSAWritePath(Operation *op) {
 /// with "target" key, that do not match the field suffix.
 static ArrayAttr filterAnnotations(MLIRContext *ctxt, ArrayAttr annotations,
                                    FIRRTLType srcType,
-                                   FlatBundleFieldEntry field) {
+                                   const FlatBundleFieldEntry &field) {
   SmallVector<Attribute> retval;
   if (!annotations || annotations.empty())
     return ArrayAttr::get(ctxt, retval);
@@ -147,7 +326,7 @@ static ArrayAttr filterAnnotations(MLIRContext *ctxt, ArrayAttr annotations,
 }
 
 static MemOp cloneMemWithNewType(ImplicitLocOpBuilder *b, MemOp op,
-                                 FlatBundleFieldEntry field) {
+                                 const FlatBundleFieldEntry &field) {
   SmallVector<Type, 8> ports;
   SmallVector<Attribute, 8> portNames;
 
@@ -212,7 +391,8 @@ static MemOp cloneMemWithNewType(ImplicitLocOpBuilder *b, MemOp op,
 namespace {
 struct TypeLoweringVisitor : public FIRRTLVisitor<TypeLoweringVisitor> {
 
-  TypeLoweringVisitor(MLIRContext *context) : context(context) {}
+  TypeLoweringVisitor(MLIRContext *context, DenseSet<Value> &preservedValues)
+      : context(context), preservedValues(preservedValues) {}
   using FIRRTLVisitor<TypeLoweringVisitor>::visitDecl;
   using FIRRTLVisitor<TypeLoweringVisitor>::visitExpr;
   using FIRRTLVisitor<TypeLoweringVisitor>::visitStmt;
@@ -228,7 +408,7 @@ struct TypeLoweringVisitor : public FIRRTLVisitor<TypeLoweringVisitor> {
       SmallVectorImpl<Value> &lowering);
   std::pair<Value, firrtl::ModulePortInfo>
   addArg(Operation *module, unsigned insertPt, FIRRTLType srcType,
-         FlatBundleFieldEntry field, ModulePortInfo &oldArg);
+         const FlatBundleFieldEntry &field, ModulePortInfo &oldArg);
 
   // Helpers to manage state.
   void visitDecl(FExtModuleOp op);
@@ -248,26 +428,64 @@ struct TypeLoweringVisitor : public FIRRTLVisitor<TypeLoweringVisitor> {
   void visitStmt(WhenOp op);
 
 private:
+  bool peelType(Type type, ArrayRef<FlatBundleFieldEntry> &fields);
   void processUsers(Value val, ArrayRef<Value> mapping);
   bool processSAPath(Operation *);
   void lowerBlock(Block *);
   void lowerSAWritePath(Operation *, ArrayRef<Operation *> writePath);
-  void lowerProducer(Operation *op,
-                     llvm::function_ref<Operation *(FlatBundleFieldEntry,
-                                                    StringRef, ArrayAttr)>
-                         clone);
+  void lowerProducer(
+      Operation *op,
+      llvm::function_ref<Operation *(const FlatBundleFieldEntry &, StringRef,
+                                     ArrayAttr)>
+          clone);
   Value getSubWhatever(Value val, size_t index);
 
   MLIRContext *context;
 
+  /// The aggregate values of the current module which are kept intact.
+  DenseSet<Value> &preservedValues;
+
   /// The builder is set and maintained in the main loop.
   ImplicitLocOpBuilder *builder;
 
   /// State to keep track of arguments and operations to clean up at the end.
   SmallVector<Operation *, 16> opsToRemove;
+
+  /// The fields of every type peeled so far, or None for ground types.  The
+  /// same bundle types are usually shared by many declarations and ports, so
+  /// this saves rebuilding the field list and its suffix strings each time.
+  DenseMap<Type, Optional<ArrayRef<FlatBundleFieldEntry>>> peeledTypes;
+
+  /// The storage for the fields in `peeledTypes`.
+  llvm::SpecificBumpPtrAllocator<FlatBundleFieldEntry> fieldAllocator;
 };
 } // namespace
 
+/// Peel one layer of an aggregate type into its components, returning false
+/// for ground types.  The fields remain valid for the lifetime of the visitor.
+bool TypeLoweringVisitor::peelType(Type type,
+                                   ArrayRef<FlatBundleFieldEntry> &fields) {
+  auto it = peeledTypes.find(type);
+  if (it == peeledTypes.end()) {
+    SmallVector<FlatBundleFieldEntry, 8> newFields;
+    Optional<ArrayRef<FlatBundleFieldEntry>> entry;
+    if (::peelType(type, newFields)) {
+      entry = ArrayRef<FlatBundleFieldEntry>();
+      if (!newFields.empty()) {
+        auto *storage = fieldAllocator.Allocate(newFields.size());
+        std::uninitialized_copy(newFields.begin(), newFields.end(), storage);
+        entry = ArrayRef<FlatBundleFieldEntry>(storage, newFields.size());
+      }
+    }
+    it = peeledTypes.try_emplace(type, entry).first;
+  }
+
+  if (!it->second)
+    return false;
+  fields = *it->second;
+  return true;
+}
+
 Value TypeLoweringVisitor::getSubWhatever(Value val, size_t index) {
   if (BundleType bundle = val.getType().dyn_cast<BundleType>()) {
     return builder->create<SubfieldOp>(val, index);
@@ -322,11 +540,14 @@ void TypeLoweringVisitor::lowerBlock(Block *block) {
 
 void TypeLoweringVisitor::lowerProducer(
     Operation *op,
-    llvm::function_ref<Operation *(FlatBundleFieldEntry, StringRef, ArrayAttr)>
+    llvm::function_ref<Operation *(const FlatBundleFieldEntry &, StringRef,
+                                   ArrayAttr)>
         clone) {
-  // If this is not a bundle, there is nothing to do.
+  // If this is not a bundle, or it is kept intact, there is nothing to do.
+  if (preservedValues.count(op->getResult(0)))
+    return;
   auto srcType = op->getResult(0).getType().cast<FIRRTLType>();
-  SmallVector<FlatBundleFieldEntry, 8> fieldTypes;
+  ArrayRef<FlatBundleFieldEntry> fieldTypes;
   if (!peelType(srcType, fieldTypes))
     return;
 
@@ -339,7 +560,7 @@ void TypeLoweringVisitor::lowerProducer(
   auto baseNameLen = loweredName.size();
   auto oldAnno = op->getAttr("annotations").dyn_cast_or_null<ArrayAttr>();
 
-  for (auto field : fieldTypes) {
+  for (auto &field : fieldTypes) {
     if (!loweredName.empty()) {
       loweredName.resize(baseNameLen);
       loweredName += field.suffix;
@@ -385,7 +606,8 @@ void TypeLoweringVisitor::lowerModule(Operation *op) {
 // possibly with a new suffix appended.
 std::pair<Value, firrtl::ModulePortInfo>
 TypeLoweringVisitor::addArg(Operation *module, unsigned insertPt,
-                            FIRRTLType srcType, FlatBundleFieldEntry field,
+                            FIRRTLType srcType,
+                            const FlatBundleFieldEntry &field,
                             ModulePortInfo &oldArg) {
   Value newValue;
   if (auto mod = dyn_cast<FModuleOp>(module)) {
@@ -418,7 +640,7 @@ bool TypeLoweringVisitor::lowerArg(
     SmallVectorImpl<Value> &lowering) {
 
   // Flatten any bundle types.
-  SmallVector<FlatBundleFieldEntry> fieldTypes;
+  ArrayRef<FlatBundleFieldEntry> fieldTypes;
   auto srcType = newArgs[argIndex].first.type.cast<FIRRTLType>();
   if (!peelType(srcType, fieldTypes))
     return false;
@@ -477,8 +699,12 @@ void TypeLoweringVisitor::visitStmt(ConnectOp op) {
   if (processSAPath(op))
     return;
 
+  // Connects to an intact aggregate stay whole.
+  if (preservedValues.count(op.dest()))
+    return;
+
   // Attempt to get the bundle types.
-  SmallVector<FlatBundleFieldEntry> fields;
+  ArrayRef<FlatBundleFieldEntry> fields;
   if (!peelType(op.dest().getType(), fields))
     return;
 
@@ -500,7 +726,7 @@ void TypeLoweringVisitor::visitStmt(PartialConnectOp op) {
   if (processSAPath(op))
     return;
 
-  SmallVector<FlatBundleFieldEntry> srcFields, destFields;
+  ArrayRef<FlatBundleFieldEntry> srcFields, destFields;
   peelType(op.src().getType(), srcFields);
   bool dValid = peelType(op.dest().getType(), destFields);
 
@@ -600,7 +826,7 @@ void TypeLoweringVisitor::visitStmt(WhenOp op) {
 /// element in a memory's data type.
 void TypeLoweringVisitor::visitDecl(MemOp op) {
   // Attempt to get the bundle types.
-  SmallVector<FlatBundleFieldEntry> fields;
+  ArrayRef<FlatBundleFieldEntry> fields;
   if (!peelType(op.getDataType(), fields))
     return;
 
@@ -619,7 +845,7 @@ void TypeLoweringVisitor::visitDecl(MemOp op) {
   }
 
   // Memory for each field
-  for (auto field : fields)
+  for (auto &field : fields)
     newMemories.push_back(cloneMemWithNewType(builder, op, field));
 
   // Hook up the new memories to the wires the old memory was replaced with.
@@ -634,7 +860,7 @@ void TypeLoweringVisitor::visitDecl(MemOp op) {
       // go both directions, depending on the port direction.
       if (name == "data" || name == "mask" || name == "wdata" ||
           name == "wmask" || name == "rdata") {
-        for (auto field : fields) {
+        for (auto &field : fields) {
           auto realOldField = getSubWhatever(oldField, field.index);
           auto newField = getSubWhatever(
               newMemories[field.index].getResult(index), fieldIndex);
@@ -743,6 +969,8 @@ void TypeLoweringVisitor::visitDecl(FModuleOp module) {
   }
 
   for (size_t argIndex = 0; argIndex < newArgs.size(); ++argIndex) {
+    if (preservedValues.count(module.getPortArgument(argIndex)))
+      continue;
     SmallVector<Value> lowerings;
     if (lowerArg(module, argIndex, newArgs, lowerings)) {
       auto arg = module.getPortArgument(argIndex);
@@ -797,7 +1025,7 @@ void TypeLoweringVisitor::visitDecl(FModuleOp module) {
 
 /// Lower a wire op with a bundle to multiple non-bundled wires.
 void TypeLoweringVisitor::visitDecl(WireOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     return builder->create<WireOp>(field.type, name, attrs);
   };
@@ -806,7 +1034,7 @@ void TypeLoweringVisitor::visitDecl(WireOp op) {
 
 /// Lower a reg op with a bundle to multiple non-bundled regs.
 void TypeLoweringVisitor::visitDecl(RegOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     return builder->create<RegOp>(field.type, op.clockVal(), name, attrs);
   };
@@ -815,7 +1043,7 @@ void TypeLoweringVisitor::visitDecl(RegOp op) {
 
 /// Lower a reg op with a bundle to multiple non-bundled regs.
 void TypeLoweringVisitor::visitDecl(RegResetOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     auto resetVal = getSubWhatever(op.resetValue(), field.index);
     return builder->create<RegResetOp>(field.type, op.clockVal(),
@@ -826,7 +1054,7 @@ void TypeLoweringVisitor::visitDecl(RegResetOp op) {
 
 /// Lower a wire op with a bundle to multiple non-bundled wires.
 void TypeLoweringVisitor::visitDecl(NodeOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     auto input = getSubWhatever(op.input(), field.index);
     return builder->create<NodeOp>(field.type, input, name, attrs);
@@ -836,7 +1064,7 @@ void TypeLoweringVisitor::visitDecl(NodeOp op) {
 
 /// Lower an InvalidValue op with a bundle to multiple non-bundled InvalidOps.
 void TypeLoweringVisitor::visitExpr(InvalidValueOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     return builder->create<InvalidValueOp>(field.type);
   };
@@ -845,7 +1073,7 @@ void TypeLoweringVisitor::visitExpr(InvalidValueOp op) {
 
 // Expand muxes of aggregates
 void TypeLoweringVisitor::visitExpr(MuxPrimOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     auto high = getSubWhatever(op.high(), field.index);
     auto low = getSubWhatever(op.low(), field.index);
@@ -856,7 +1084,7 @@ void TypeLoweringVisitor::visitExpr(MuxPrimOp op) {
 
 // Expand AsPassivePrimOp of aggregates
 void TypeLoweringVisitor::visitExpr(AsPassivePrimOp op) {
-  auto clone = [&](FlatBundleFieldEntry field, StringRef name,
+  auto clone = [&](const FlatBundleFieldEntry &field, StringRef name,
                    ArrayAttr attrs) -> Operation * {
     auto input = getSubWhatever(op.input(), field.index);
     return builder->create<AsPassivePrimOp>(field.type, input);
@@ -876,15 +1104,17 @@ void TypeLoweringVisitor::visitDecl(InstanceOp op) {
   for (size_t i = 0, e = op.getNumResults(); i != e; ++i) {
     auto srcType = op.getType(i).cast<FIRRTLType>();
 
-    // Flatten any nested bundle types the usual way.
-    SmallVector<FlatBundleFieldEntry, 8> fieldTypes;
-    if (!peelType(srcType, fieldTypes)) {
+    // Flatten any nested bundle types the usual way, unless the port is kept
+    // intact.
+    ArrayRef<FlatBundleFieldEntry> fieldTypes;
+    if (preservedValues.count(op.getResult(i)) ||
+        !peelType(srcType, fieldTypes)) {
       resultTypes.push_back(srcType);
       newPortAnno.push_back(oldPortAnno[i]);
     } else {
       skip = false;
       // Store the flat type for the new bundle type.
-      for (auto field : fieldTypes) {
+      for (auto &field : fieldTypes) {
         resultTypes.push_back(field.type);
         newPortAnno.push_back(filterAnnotations(
             context, oldPortAnno[i].dyn_cast_or_null<ArrayAttr>(), srcType,
@@ -915,6 +1145,10 @@ void TypeLoweringVisitor::visitDecl(InstanceOp op) {
       processUsers(op.getResult(aggIndex), lowered);
     else
       op.getResult(aggIndex).replaceAllUsesWith(lowered[0]);
+
+    // Keep track of the intact results of the new instance.
+    if (preservedValues.erase(op.getResult(aggIndex)))
+      preservedValues.insert(lowered[0]);
   }
   opsToRemove.push_back(op);
 }
@@ -951,6 +1185,9 @@ struct LowerTypesPass : public LowerFIRRTLTypesBase<LowerTypesPass> {
 
 private:
   void runParallel();
+
+  /// The aggregate values of each module which are kept intact.
+  DenseMap<Operation *, DenseSet<Value>> preservedValues;
 };
 } // end anonymous namespace
 
@@ -961,14 +1198,17 @@ void LowerTypesPass::runParallel() {
   // llvm::enumerate the ops with their index. TODO(mlir): There should really
   // be a way to do this without collecting the operations first.
   std::deque<Operation *> ops;
-  llvm::for_each(getOperation().getBody()->getOperations(),
-                 [&](Operation &op) { ops.push_back(&op); });
+  llvm::for_each(getOperation().getBody()->getOperations(), [&](Operation &op) {
+    ops.push_back(&op);
+    preservedValues.try_emplace(&op);
+  });
 
   mlir::ParallelDiagnosticHandler diagHandler(&getContext());
   llvm::parallelForEachN(0, ops.size(), [&](auto index) {
     // Notify the handler the op index and then perform lowering.
     diagHandler.setOrderIDForThread(index);
-    TypeLoweringVisitor(&getContext()).lowerModule(ops[index]);
+    TypeLoweringVisitor(&getContext(), preservedValues.find(ops[index])->second)
+        .lowerModule(ops[index]);
     diagHandler.eraseOrderIDForThread();
   });
 }
@@ -976,14 +1216,21 @@ void LowerTypesPass::runParallel() {
 // This is the main entrypoint for the lowering pass.
 void LowerTypesPass::runOnOperation() {
   auto *context = &getContext();
+  if (preserveAggregate)
+    findPreservedAggregates(getOperation(), preservedValues);
+
   if (context->isMultithreadingEnabled())
     runParallel();
   else
     for (auto &op : getOperation().getBody()->getOperations())
-      TypeLoweringVisitor(context).lowerModule(&op);
+      TypeLoweringVisitor(context, preservedValues[&op]).lowerModule(&op);
+  preservedValues.clear();
 }
 
 /// This is the pass constructor.
-std::unique_ptr<mlir::Pass> circt::firrtl::createLowerFIRRTLTypesPass() {
-  return std::make_unique<LowerTypesPass>();
+std::unique_ptr<mlir::Pass>
+circt::firrtl::createLowerFIRRTLTypesPass(bool preserveAggregate) {
+  auto pass = std::make_unique<LowerTypesPass>();
+  pass->preserveAggregate = preserveAggregate;
+  return pass;
 }
@@ -15,9 +15,12 @@
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
+#include "circt/Dialect/FIRRTL/InstanceGraph.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Support/LLVM.h"
 #include "mlir/IR/BlockAndValueMapping.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/Parallel.h"
 
 using namespace circt;
 using namespace firrtl;
@@ -90,32 +93,51 @@ static void mapResultsToWires(BlockAndValueMapping &mapper,
 
 /// Inlines, flattens, and removes dead modules in a circuit.
 ///
-/// The inliner works in a top down fashion, starting from the top level module,
-/// and inlines every possible instance. With this method of recursive top-down
-/// inlining, each operation will be cloned directly to its final location.
+/// The inliner first finds the modules which will still be instantiated once
+/// inlining is done, starting from the top level module.  When an instance op
+/// is not inlined, the referenced module is live.  When the inliner is
+/// complete, it deletes every dead module: either all instances of the module
+/// were inlined, or it was not reachable from the top level module.
 ///
-/// The inliner uses a worklist to track which modules need to be processed.
-/// When an instance op is not inlined, the referenced module is added to the
-/// worklist. When the inliner is complete, it deletes every un-processed
-/// module: either all instances of the module were inlined, or it was not
-/// reachable from the top level module.
+/// The live modules are then processed bottom-up over the instance graph, so
+/// that every module a live module clones from is finished before it is read.
+/// A live module which is instantiated by a flattened module is cloned in its
+/// already-inlined form, rather than being inlined again for each parent.  The
+/// modules at the same depth never read each other, and each instance is
+/// cloned in to its own block, so all the instances at a depth are expanded in
+/// parallel.
 ///
-/// During the inlining process, every cloned operation with a name must be
-/// prefixed with the instance's name. The top-down process means that we know
-/// the entire desired prefix when we clone an operation, and can set the name
-/// attribute once. This means that we will not create any intermediate name
-/// attributes (which will be interned by the compiler), and helps keep down the
-/// total memory usage.
+/// Inlining an instance is top down: every instance inside the inlined module
+/// is inlined recursively from the same point, so each operation will be
+/// cloned directly to its final location.  During the inlining process, every
+/// cloned operation with a name must be prefixed with the instance's name.
+/// The top-down process means that we know the entire desired prefix when we
+/// clone an operation, and can set the name attribute once. This means that we
+/// will not create any intermediate name attributes (which will be interned by
+/// the compiler), and helps keep down the total memory usage.
 namespace {
 class Inliner {
 public:
   /// Initialize the inliner to run on this circuit.
-  Inliner(CircuitOp circuit);
+  Inliner(CircuitOp circuit, InstanceGraph &instanceGraph);
 
   /// Run the inliner.
   void run();
 
 private:
+  /// An instance which is going to be replaced by the body of its module.  The
+  /// module is cloned in to a separate block, which is moved in place of the
+  /// instance once all instances at the same depth have been cloned.
+  struct InlineWork {
+    InstanceRecord *record;
+    FModuleOp target;
+    /// True if the target is flattened rather than inlined.
+    bool flatten;
+    /// The cloned body of the target, and the wires replacing its ports.
+    std::unique_ptr<Block> body;
+    SmallVector<Value> wires;
+  };
+
   /// Returns true if the operation is annotated to be flattened.
   bool shouldFlatten(Operation *op);
 
@@ -134,15 +156,26 @@ private:
   void inlineInto(StringRef prefix, OpBuilder &b, BlockAndValueMapping &mapper,
                   FModuleOp target);
 
-  /// Recursively flatten all instances in a module.
-  void flattenInstances(FModuleOp module);
+  /// Record the modules which stay instantiated in a module which is not
+  /// flattened, looking through the instances which get inlined.
+  void findLiveModules(FModuleOp module);
+
+  /// Add the instances of a live module which must be inlined or flattened to
+  /// the work list.
+  void collectInstances(FModuleOp module, SmallVectorImpl<InlineWork> &work);
 
-  /// Inline any instances in the module which were marked for inlining.
-  void inlineInstances(FModuleOp module);
+  /// Clone the body of the target of an instance in to a new block.
+  void cloneInstance(InlineWork &work);
+
+  /// Replace an instance with its cloned body.
+  void replaceInstance(InlineWork &work);
 
   CircuitOp circuit;
   MLIRContext *context;
 
+  /// The instance graph of the circuit, used to order the live modules.
+  InstanceGraph &instanceGraph;
+
   // A symbol table with references to each module in a circuit.
   SymbolTable symbolTable;
 
@@ -150,7 +183,10 @@ private:
   /// removed by dead code elimination.
   DenseSet<Operation *> liveModules;
 
-  /// Worklist of modules to process for inlining or flattening.
+  /// The inlined modules which have already been searched for live modules.
+  DenseSet<Operation *> searchedModules;
+
+  /// Worklist of modules to search for live modules.
   SmallVector<FModuleOp, 16> worklist;
 };
 } // namespace
@@ -173,11 +209,10 @@ void Inliner::flattenInto(StringRef prefix, OpBuilder &b,
       continue;
     }
 
-    // If its not a regular module we can't inline it. Mark is as live.
-    auto module = symbolTable.lookup(instance.moduleName());
-    auto target = dyn_cast<FModuleOp>(module);
+    // If its not a regular module we can't inline it.
+    auto target =
+        dyn_cast<FModuleOp>(symbolTable.lookup(instance.moduleName()));
     if (!target) {
-      liveModules.insert(module);
       cloneAndRename(prefix, b, mapper, op);
       continue;
     }
@@ -192,38 +227,6 @@ void Inliner::flattenInto(StringRef prefix, OpBuilder &b,
   }
 }
 
-void Inliner::flattenInstances(FModuleOp module) {
-  for (auto &op : llvm::make_early_inc_range(*module.getBodyBlock())) {
-    // If its not an instance op, skip it.
-    auto instance = dyn_cast<InstanceOp>(op);
-    if (!instance)
-      continue;
-
-    // If its not a regular module we can't inline it. Mark is as live.
-    auto module = symbolTable.lookup(instance.moduleName());
-    auto target = dyn_cast<FModuleOp>(module);
-    if (!target) {
-      liveModules.insert(module);
-      continue;
-    }
-
-    // Create the wire mapping for results + ports. We RAUW the results instead
-    // of mapping them.
-    BlockAndValueMapping mapper;
-    OpBuilder b(instance);
-    auto nestedPrefix = (instance.name() + "_").str();
-    auto wires = mapPortsToWires(nestedPrefix, b, mapper, target);
-    for (unsigned i = 0, e = instance.getNumResults(); i < e; ++i)
-      instance.getResult(i).replaceAllUsesWith(wires[i]);
-
-    // Recursively flatten the target module.
-    flattenInto(nestedPrefix, b, mapper, target);
-
-    // Erase the replaced instance.
-    instance.erase();
-  }
-}
-
 void Inliner::inlineInto(StringRef prefix, OpBuilder &b,
                          BlockAndValueMapping &mapper, FModuleOp target) {
   for (auto &op : *target.getBodyBlock()) {
@@ -234,20 +237,11 @@ void Inliner::inlineInto(StringRef prefix, OpBuilder &b,
       continue;
     }
 
-    // If its not a regular module we can't inline it. Mark is as live.
-    auto module = symbolTable.lookup(instance.moduleName());
-    auto target = dyn_cast<FModuleOp>(module);
-    if (!target) {
-      liveModules.insert(module);
-      cloneAndRename(prefix, b, mapper, op);
-      continue;
-    }
-
-    // If we aren't inlining the target, add it to the work list.
-    if (!shouldInline(target)) {
-      if (liveModules.insert(target).second) {
-        worklist.push_back(target);
-      }
+    // If its not a regular module we can't inline it, and if we aren't
+    // inlining the target, it has been marked as live.
+    auto target =
+        dyn_cast<FModuleOp>(symbolTable.lookup(instance.moduleName()));
+    if (!target || !shouldInline(target)) {
       cloneAndRename(prefix, b, mapper, op);
       continue;
     }
@@ -266,52 +260,88 @@ void Inliner::inlineInto(StringRef prefix, OpBuilder &b,
   }
 }
 
-void Inliner::inlineInstances(FModuleOp module) {
-  for (auto &op : llvm::make_early_inc_range(*module.getBodyBlock())) {
-    // If its not an instance op, skip it.
-    auto instance = dyn_cast<InstanceOp>(op);
-    if (!instance)
-      continue;
-
-    // If its not a regular module we can't inline it. Mark is as live.
-    auto module = symbolTable.lookup(instance.moduleName());
-    auto target = dyn_cast<FModuleOp>(module);
-    if (!target) {
-      liveModules.insert(module);
+void Inliner::findLiveModules(FModuleOp module) {
+  for (auto instance : module.getBodyBlock()->getOps<InstanceOp>()) {
+    // External modules are marked live while ordering the modules.
+    auto target =
+        dyn_cast<FModuleOp>(symbolTable.lookup(instance.moduleName()));
+    if (!target)
       continue;
-    }
 
     // If we aren't inlining the target, add it to the work list.
     if (!shouldInline(target)) {
-      if (liveModules.insert(target).second) {
+      if (liveModules.insert(target).second)
         worklist.push_back(target);
-      }
       continue;
     }
 
-    // Create the wire mapping for results + ports. We RAUW the results instead
-    // of mapping them.
-    BlockAndValueMapping mapper;
-    OpBuilder b(instance);
-    auto nestedPrefix = (instance.name() + "_").str();
-    auto wires = mapPortsToWires(nestedPrefix, b, mapper, target);
-    for (unsigned i = 0, e = instance.getNumResults(); i < e; ++i)
-      instance.getResult(i).replaceAllUsesWith(wires[i]);
+    // Nothing inside a flattened module stays instantiated.  Otherwise, the
+    // instances of the inlined module end up in this one.
+    if (!shouldFlatten(target) && searchedModules.insert(target).second)
+      findLiveModules(target);
+  }
+}
 
-    // Inline the module, it can be marked as flatten and inline.
-    if (shouldFlatten(target)) {
-      flattenInto(nestedPrefix, b, mapper, target);
-    } else {
-      inlineInto(nestedPrefix, b, mapper, target);
-    }
+void Inliner::collectInstances(FModuleOp module,
+                               SmallVectorImpl<InlineWork> &work) {
+  bool flatten = shouldFlatten(module);
+  for (auto *record : *instanceGraph.lookup(module)) {
+    // Only the instances directly in the body of the module are inlined.
+    if (record->getInstance()->getBlock() != module.getBodyBlock())
+      continue;
+
+    // If its not a regular module we can't inline it.
+    auto target = dyn_cast<FModuleOp>(record->getTarget()->getModule());
+    if (!target)
+      continue;
 
-    // Erase the replaced instance.
-    instance.erase();
+    // A flattened module inlines everything.  Otherwise, the module can be
+    // marked as flatten and inline.
+    if (flatten)
+      work.push_back({record, target, true, nullptr, {}});
+    else if (shouldInline(target))
+      work.push_back({record, target, shouldFlatten(target), nullptr, {}});
   }
 }
 
-Inliner::Inliner(CircuitOp circuit)
-    : circuit(circuit), context(circuit.getContext()), symbolTable(circuit) {}
+void Inliner::cloneInstance(InlineWork &work) {
+  work.body = std::make_unique<Block>();
+  auto b = OpBuilder::atBlockEnd(work.body.get());
+
+  // Create the wire mapping for results + ports. The results are replaced
+  // instead of mapped, once the body is moved in place.
+  BlockAndValueMapping mapper;
+  auto nestedPrefix = (work.record->getInstance().name() + "_").str();
+  work.wires = mapPortsToWires(nestedPrefix, b, mapper, work.target);
+
+  if (work.flatten)
+    flattenInto(nestedPrefix, b, mapper, work.target);
+  else
+    inlineInto(nestedPrefix, b, mapper, work.target);
+}
+
+void Inliner::replaceInstance(InlineWork &work) {
+  // Record the instances cloned in to the parent module in the instance graph.
+  auto *parent = work.record->getParent();
+  work.body->walk([&](InstanceOp instance) {
+    parent->addInstance(instance, instanceGraph.lookup(instance.moduleName()));
+  });
+
+  auto instance = work.record->getInstance();
+  work.record->erase();
+  instance->getBlock()->getOperations().splice(
+      Block::iterator(instance), work.body->getOperations());
+  for (unsigned i = 0, e = instance.getNumResults(); i < e; ++i)
+    instance.getResult(i).replaceAllUsesWith(work.wires[i]);
+
+  // Erase the replaced instance.
+  instance.erase();
+  work.body.reset();
+}
+
+Inliner::Inliner(CircuitOp circuit, InstanceGraph &instanceGraph)
+    : circuit(circuit), context(circuit.getContext()),
+      instanceGraph(instanceGraph), symbolTable(circuit) {}
 
 void Inliner::run() {
   auto topModule = circuit.getMainModule();
@@ -322,22 +352,72 @@ void Inliner::run() {
   if (auto fmodule = dyn_cast<FModuleOp>(topModule))
     worklist.push_back(fmodule);
 
-  // If the module is marked for flattening, flatten it. Otherwise, inline
-  // every instance marked to be inlined.
+  // Find every module which is still instantiated after inlining.
   while (!worklist.empty()) {
     auto module = worklist.pop_back_val();
-    if (shouldFlatten(module)) {
-      flattenInstances(module);
+    if (!shouldFlatten(module))
+      findLiveModules(module);
+  }
+
+  // Group the live modules by their height in the instance graph, so that a
+  // module only reads from modules which have already been processed.  Every
+  // reachable external module stays instantiated somewhere.
+  DenseMap<InstanceGraphNode *, unsigned> heights;
+  SmallVector<SmallVector<FModuleOp>> levels;
+  for (auto *node : llvm::post_order(&instanceGraph)) {
+    auto module = dyn_cast<FModuleOp>(node->getModule());
+    if (!module) {
+      liveModules.insert(node->getModule());
       continue;
     }
-    inlineInstances(module);
+    unsigned height = 0;
+    for (auto *record : *node)
+      height = std::max(height, heights.lookup(record->getTarget()) + 1);
+    heights[node] = height;
+    if (!liveModules.count(module))
+      continue;
+    if (levels.size() <= height)
+      levels.resize(height + 1);
+    levels[height].push_back(module);
   }
 
-  // Delete all unreferenced modules.
+  // If the module is marked for flattening, flatten it. Otherwise, inline
+  // every instance marked to be inlined.
+  SmallVector<InlineWork> work;
+  for (auto &level : levels) {
+    work.clear();
+    for (auto module : level)
+      collectInstances(module, work);
+
+    if (context->isMultithreadingEnabled()) {
+      llvm::parallelForEach(work,
+                            [&](InlineWork &item) { cloneInstance(item); });
+    } else {
+      for (auto &item : work)
+        cloneInstance(item);
+    }
+    for (auto &item : work)
+      replaceInstance(item);
+  }
+
+  // Delete all unreferenced modules.  The dead modules may instantiate each
+  // other, so remove all of their instances from the instance graph first.
+  SmallVector<Operation *> deadModules;
   for (auto &op : llvm::make_early_inc_range(*circuit.getBody())) {
-    if (!liveModules.count(&op))
+    if (liveModules.count(&op))
+      continue;
+    if (isa<FModuleOp, FExtModuleOp>(op))
+      deadModules.push_back(&op);
+    else
       op.erase();
   }
+  for (auto *op : deadModules)
+    for (auto *record : llvm::make_early_inc_range(*instanceGraph.lookup(op)))
+      record->erase();
+  for (auto *op : deadModules) {
+    instanceGraph.erase(instanceGraph.lookup(op));
+    op->erase();
+  }
 }
 
 //===----------------------------------------------------------------------===//
@@ -347,8 +427,9 @@ void Inliner::run() {
 namespace {
 class InlinerPass : public InlinerBase<InlinerPass> {
   void runOnOperation() override {
-    Inliner inliner(getOperation());
+    Inliner inliner(getOperation(), getAnalysis<InstanceGraph>());
     inliner.run();
+    markAnalysesPreserved<InstanceGraph>();
   }
 };
 } // namespace
@@ -5,7 +5,7 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 //===----------------------------------------------------------------------===//
 //
-// Print the module hierarchy.
+// Print the module hierarchy, or the cost profile of its modules.
 //
 //===----------------------------------------------------------------------===//
 
@@ -13,8 +13,10 @@
 #include "circt/Dialect/FIRRTL/InstanceGraph.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "llvm/Support/DOTGraphTraits.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/GraphWriter.h"
 #include "llvm/Support/raw_ostream.h"
+#include <map>
 
 using namespace circt;
 using namespace firrtl;
@@ -45,21 +47,147 @@ struct llvm::DOTGraphTraits<InstanceGraph *>
   }
 };
 
+/// Return the number of bits of a type, counting the ground types of unknown
+/// width as zero.
+static uint64_t getBitWidth(FIRRTLType type) {
+  if (auto bundle = type.dyn_cast<BundleType>()) {
+    uint64_t width = 0;
+    for (auto &element : bundle.getElements())
+      width += getBitWidth(element.type);
+    return width;
+  }
+  if (auto vector = type.dyn_cast<FVectorType>())
+    return vector.getNumElements() * getBitWidth(vector.getElementType());
+  return std::max(type.getBitWidthOrSentinel(), 0);
+}
+
 namespace {
+/// The cost of a module on its own.
+struct ModuleCost {
+  StringRef name;
+  /// The number of times the module is instantiated in the flattened
+  /// hierarchy.
+  uint64_t instances = 0;
+  uint64_t numOps = 0;
+  uint64_t regBits = 0;
+  uint64_t memBits = 0;
+  std::map<StringRef, uint64_t> opsByDialect;
+
+  uint64_t getFlatCost() const { return numOps * instances; }
+};
+
 struct PrintInstanceGraphPass
     : public PrintInstanceGraphBase<PrintInstanceGraphPass> {
   PrintInstanceGraphPass(raw_ostream &os) : os(os) {}
   void runOnOperation() override {
     auto circuitOp = getOperation();
     auto &instanceGraph = getAnalysis<InstanceGraph>();
-    llvm::WriteGraph(os, &instanceGraph, /*ShortNames=*/false,
-                     circuitOp.name());
+    if (profile)
+      printProfile(instanceGraph);
+    else
+      llvm::WriteGraph(os, &instanceGraph, /*ShortNames=*/false,
+                       circuitOp.name());
     markAllAnalysesPreserved();
   }
+
+private:
+  uint64_t getInstanceCount(InstanceGraphNode *node);
+  ModuleCost getModuleCost(InstanceGraphNode *node);
+  void printProfile(InstanceGraph &instanceGraph);
+
   raw_ostream &os;
+  /// The number of instances of each module in the flattened hierarchy.
+  DenseMap<InstanceGraphNode *, uint64_t> instanceCounts;
 };
 } // end anonymous namespace
 
+/// Return the number of times a module is instantiated in the flattened
+/// hierarchy, which is one for the modules without instances.
+uint64_t PrintInstanceGraphPass::getInstanceCount(InstanceGraphNode *node) {
+  auto it = instanceCounts.find(node);
+  if (it != instanceCounts.end())
+    return it->second;
+  uint64_t count = node->noUses() ? 1 : 0;
+  for (auto *use : node->uses())
+    count += getInstanceCount(use->getParent());
+  instanceCounts[node] = count;
+  return count;
+}
+
+ModuleCost PrintInstanceGraphPass::getModuleCost(InstanceGraphNode *node) {
+  ModuleCost cost;
+  auto *module = node->getModule();
+  cost.name = SymbolTable::getSymbolName(module);
+  cost.instances = getInstanceCount(node);
+  auto fmodule = dyn_cast<FModuleOp>(module);
+  if (!fmodule)
+    return cost;
+
+  auto getResultBits = [](Operation *op) {
+    return getBitWidth(op->getResult(0).getType().cast<FIRRTLType>());
+  };
+  fmodule.getBody()->walk([&](Operation *op) {
+    ++cost.numOps;
+    ++cost.opsByDialect[op->getName().getDialectNamespace()];
+    if (isa<RegOp, RegResetOp>(op))
+      cost.regBits += getResultBits(op);
+    else if (auto mem = dyn_cast<MemOp>(op))
+      cost.memBits += mem.depth() * getBitWidth(mem.getDataType());
+    else if (isa<CMemOp, SMemOp>(op))
+      cost.memBits += getResultBits(op);
+  });
+  return cost;
+}
+
+void PrintInstanceGraphPass::printProfile(InstanceGraph &instanceGraph) {
+  instanceCounts.clear();
+  std::vector<ModuleCost> costs;
+  for (auto *node : instanceGraph)
+    costs.push_back(getModuleCost(node));
+  std::stable_sort(costs.begin(), costs.end(),
+                   [](const ModuleCost &a, const ModuleCost &b) {
+                     return a.getFlatCost() > b.getFlatCost();
+                   });
+
+  size_t nameWidth = strlen("module");
+  for (auto &cost : costs)
+    nameWidth = std::max(nameWidth, cost.name.size());
+  auto printRow = [&](const ModuleCost &cost, uint64_t flatCost) {
+    os << llvm::left_justify(cost.name, nameWidth);
+    for (uint64_t value : {cost.instances, cost.numOps, flatCost, cost.regBits,
+                           cost.memBits})
+      os << " " << llvm::format_decimal(value, 10);
+    os << " ";
+    for (auto &entry : cost.opsByDialect)
+      os << " " << entry.first << "=" << entry.second;
+    os << "\n";
+  };
+
+  os << "Module profile of \"" << getOperation().name() << "\":\n"
+     << llvm::left_justify("module", nameWidth);
+  for (StringRef label :
+       {"instances", "ops", "flat cost", "reg bits", "mem bits"})
+    os << " " << llvm::right_justify(label, 10);
+  os << "  ops by dialect\n";
+  ModuleCost total;
+  total.name = "total";
+  uint64_t totalCost = 0;
+  for (auto &cost : costs) {
+    printRow(cost, cost.getFlatCost());
+    totalCost += cost.getFlatCost();
+    total.instances += cost.instances;
+    total.numOps += cost.numOps;
+    total.regBits += cost.regBits * cost.instances;
+    total.memBits += cost.memBits * cost.instances;
+    for (auto &entry : cost.opsByDialect)
+      total.opsByDialect[entry.first] += entry.second;
+  }
+
+  // The bits of the total are those of the flattened hierarchy, and its
+  // operations are those of the circuit.
+  printRow(total, totalCost);
+}
+
 std::unique_ptr<mlir::Pass> circt::firrtl::createPrintInstanceGraphPass() {
   return std::make_unique<PrintInstanceGraphPass>(llvm::errs());
 }
@@ -0,0 +1,226 @@
+//===- RegVectorToMem.cpp - Convert register vectors to memories ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass which converts the annotated registers of vector
+// type into memories, when they are only accessed one element at a time.  Once
+// lowered, such a register is one register per element, a mux tree per read
+// and a decoder per write, which simulators evaluate much more slowly than the
+// array of a memory.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLAnnotations.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+
+using namespace circt;
+using namespace firrtl;
+
+static const char regVectorToMemAnnoClass[] = "circt.RegVectorToMemAnnotation";
+
+/// The fields of the memory ports, see `MemOp::getTypeForPort`.
+enum PortField { AddrField, EnField, ClkField, DataField, MaskField };
+
+/// Return the value connected by `op`, if it is a connect to `dest`.
+static Value getWrittenValue(Operation *op, Value dest) {
+  if (auto connect = dyn_cast<ConnectOp>(op))
+    return connect.dest() == dest ? connect.src() : Value();
+  if (auto partialConnect = dyn_cast<PartialConnectOp>(op))
+    return partialConnect.dest() == dest ? partialConnect.src() : Value();
+  return {};
+}
+
+namespace {
+struct RegVectorToMemPass : public RegVectorToMemBase<RegVectorToMemPass> {
+  void runOnOperation() override;
+
+private:
+  bool convertRegister(RegOp reg);
+};
+} // end anonymous namespace
+
+/// Replace `reg` with a memory with a read port per read of an element and a
+/// write port for the write, if all the uses of the register access a single
+/// element and at most one of them writes it.  The memory reads are
+/// combinational and its writes take effect on the next clock edge, like the
+/// register.
+bool RegVectorToMemPass::convertRegister(RegOp reg) {
+  auto fail = [&](const Twine &reason) {
+    reg.emitWarning("register is not converted to a memory: ") << reason;
+    return false;
+  };
+
+  AnnotationSet annotations(reg);
+  annotations.removeAnnotationsWithClass(regVectorToMemAnnoClass);
+  if (!annotations.empty())
+    return fail("it has other annotations");
+  if (!isa<FModuleOp>(reg->getParentOp()))
+    return fail("it is declared in a when");
+  auto vectorType = reg.getType().dyn_cast<FVectorType>();
+  if (!vectorType || vectorType.getNumElements() == 0)
+    return fail("it is not a vector");
+  auto elementType = vectorType.getElementType().dyn_cast<IntType>();
+  if (!elementType || !elementType.hasWidth())
+    return fail("its elements are not integers of known width");
+
+  // Sort the accesses into reads and the write.  The use list is in reverse
+  // order of creation, which would number the read ports backwards.
+  SmallVector<Operation *> users(reg->getUsers().begin(),
+                                 reg->getUsers().end());
+  SmallVector<Operation *> reads;
+  Operation *write = nullptr, *writeConnect = nullptr;
+  for (auto *user : llvm::reverse(users)) {
+    if (!isa<SubaccessOp, SubindexOp>(user) || user->getOperand(0) != reg)
+      return fail("it is used other than by accessing an element");
+    auto element = user->getResult(0);
+    Operation *connect = nullptr;
+    for (auto *elementUser : element.getUsers())
+      if (getWrittenValue(elementUser, element)) {
+        if (connect)
+          return fail("an element is written more than once");
+        connect = elementUser;
+      }
+    if (!connect) {
+      reads.push_back(user);
+      continue;
+    }
+    if (write)
+      return fail("it is written more than once");
+    if (!element.hasOneUse())
+      return fail("an element is read and written through one access");
+    write = user;
+    writeConnect = connect;
+  }
+  if (reads.empty() && !write)
+    return fail("it is never accessed");
+
+  auto *context = reg.getContext();
+  uint64_t depth = vectorType.getNumElements();
+  ImplicitLocOpBuilder builder(reg.getLoc(), reg);
+
+  SmallVector<Type> portTypes;
+  SmallVector<Attribute> portNames;
+  for (unsigned i = 0, e = reads.size(); i != e; ++i) {
+    portTypes.push_back(
+        MemOp::getTypeForPort(depth, elementType, MemOp::PortKind::Read));
+    portNames.push_back(builder.getStringAttr("r" + Twine(i)));
+  }
+  if (write) {
+    portTypes.push_back(
+        MemOp::getTypeForPort(depth, elementType, MemOp::PortKind::Write));
+    portNames.push_back(builder.getStringAttr("w"));
+  }
+  SmallVector<Attribute> portAnnotations(portTypes.size(),
+                                         builder.getArrayAttr({}));
+  auto mem = builder.create<MemOp>(
+      portTypes, /*readLatency=*/0, /*writeLatency=*/1, depth,
+      RUWAttr::Undefined, portNames, reg.name(), ArrayRef<Attribute>(),
+      portAnnotations);
+
+  // Every port is clocked by the register clock.  The read ports are always
+  // enabled.  The address and data are only connected at each access, which
+  // may be in a when, so they are invalid by default.
+  auto addrType =
+      UIntType::get(context, std::max(1U, llvm::Log2_64_Ceil(depth)));
+  auto bitType = UIntType::get(context, 1);
+  auto one = builder.create<ConstantOp>(bitType, APInt(1, 1));
+  auto connectField = [](ImplicitLocOpBuilder &builder, Value port,
+                         PortField field, Value value) {
+    builder.create<ConnectOp>(builder.create<SubfieldOp>(port, field), value);
+  };
+  for (auto port : mem.getResults()) {
+    connectField(builder, port, AddrField,
+                 builder.create<InvalidValueOp>(addrType));
+    connectField(builder, port, ClkField, reg.clockVal());
+  }
+  for (unsigned i = 0, e = reads.size(); i != e; ++i)
+    connectField(builder, mem.getResult(i), EnField, one);
+  if (write) {
+    auto port = mem.getResults().back();
+    connectField(builder, port, EnField,
+                 builder.create<ConstantOp>(bitType, APInt(1, 0)));
+    connectField(builder, port, DataField,
+                 builder.create<InvalidValueOp>(elementType));
+    connectField(builder, port, MaskField, one);
+  }
+
+  // Return the address of the element an access refers to, and whether it is
+  // in bounds if the index is wider than the address.
+  auto getAddress = [&](ImplicitLocOpBuilder &builder,
+                        Operation *access) -> std::pair<Value, Value> {
+    if (auto subindex = dyn_cast<SubindexOp>(access))
+      return {builder.create<ConstantOp>(
+                  addrType, APInt(addrType.getWidthOrSentinel(),
+                                  subindex.index())),
+              Value()};
+    auto index = cast<SubaccessOp>(access).index();
+    auto indexType = index.getType().cast<UIntType>();
+    int32_t addrWidth = addrType.getWidthOrSentinel();
+    int32_t indexWidth = indexType.getWidthOrSentinel();
+    if (indexWidth <= addrWidth)
+      return {index, Value()};
+    Value inBounds = builder.create<LTPrimOp>(
+        bitType, index,
+        builder.create<ConstantOp>(indexType, APInt(indexWidth, depth)));
+    return {builder.create<BitsPrimOp>(index, addrWidth - 1, 0), inBounds};
+  };
+
+  for (auto it : llvm::enumerate(reads)) {
+    auto *access = it.value();
+    auto port = mem.getResult(it.index());
+    ImplicitLocOpBuilder accessBuilder(access->getLoc(), access);
+    connectField(accessBuilder, port, AddrField,
+                 getAddress(accessBuilder, access).first);
+    access->getResult(0).replaceAllUsesWith(
+        accessBuilder.create<SubfieldOp>(port, DataField));
+    access->erase();
+  }
+
+  // An out of bounds write leaves the memory unchanged, as it does the
+  // register.
+  if (write) {
+    auto port = mem.getResults().back();
+    ImplicitLocOpBuilder connectBuilder(writeConnect->getLoc(), writeConnect);
+    auto address = getAddress(connectBuilder, write);
+    connectField(connectBuilder, port, AddrField, address.first);
+    connectField(connectBuilder, port, EnField,
+                 address.second ? address.second : Value(one));
+    auto data = connectBuilder.create<SubfieldOp>(port, DataField);
+    auto value = getWrittenValue(writeConnect, write->getResult(0));
+    if (isa<ConnectOp>(writeConnect))
+      connectBuilder.create<ConnectOp>(data, value);
+    else
+      connectBuilder.create<PartialConnectOp>(data, value);
+    writeConnect->erase();
+    write->erase();
+  }
+
+  reg.erase();
+  ++numConvertedRegs;
+  return true;
+}
+
+void RegVectorToMemPass::runOnOperation() {
+  SmallVector<RegOp> regs;
+  getOperation().walk([&](RegOp reg) {
+    if (AnnotationSet(reg).hasAnnotation(regVectorToMemAnnoClass))
+      regs.push_back(reg);
+  });
+
+  bool changed = false;
+  for (auto reg : regs)
+    changed |= convertRegister(reg);
+  if (!changed)
+    markAllAnalysesPreserved();
+}
+
+std::unique_ptr<mlir::Pass> circt::firrtl::createRegVectorToMemPass() {
+  return std::make_unique<RegVectorToMemPass>();
+}
@@ -0,0 +1,109 @@
+//===- TestPasses.cpp - Test passes for the FIRRTL analyses ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements test passes for the analyses of the FIRRTL dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/InstanceGraph.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace circt::firrtl;
+
+//===----------------------------------------------------------------------===//
+// InstancePathCache
+//===----------------------------------------------------------------------===//
+
+static StringRef getModuleName(Operation *module) {
+  if (auto extModule = dyn_cast<FExtModuleOp>(module))
+    return extModule.getName();
+  return cast<FModuleOp>(module).getName();
+}
+
+namespace {
+/// Print the instance count and the absolute paths of every module.  Then
+/// erase the instances marked with a `test.erase` attribute, updating the
+/// InstanceGraph, and print them again from the same, invalidated cache.
+struct TestInstancePathsPass
+    : public PassWrapper<TestInstancePathsPass, OperationPass<CircuitOp>> {
+  void runOnOperation() override;
+  void print(InstanceGraph &graph, InstancePathCache &cache);
+};
+} // namespace
+
+void TestInstancePathsPass::print(InstanceGraph &graph,
+                                  InstancePathCache &cache) {
+  auto &os = llvm::errs();
+  for (auto *node : graph) {
+    auto *module = node->getModule();
+    os << getModuleName(module) << ": " << cache.getInstanceCount(module)
+       << " instances\n";
+    auto paths = cache.getAbsolutePaths(module);
+    auto pathNodes = cache.getPathNodes(module);
+    assert(paths.size() == pathNodes.size() && "the path lists differ");
+    for (size_t i = 0, e = paths.size(); i != e; ++i) {
+      os << "  " << getModuleName(graph.getTopLevelNode()->getModule());
+      for (auto instance : paths[i])
+        os << "/" << instance.name();
+      // The trie node must describe the same path as the array.
+      if (cache.getAbsolutePath(pathNodes[i]) != paths[i])
+        os << " (mismatched trie node)";
+      os << "\n";
+    }
+  }
+}
+
+void TestInstancePathsPass::runOnOperation() {
+  InstanceGraph graph(getOperation());
+  InstancePathCache cache(graph);
+  llvm::errs() << "instance paths of \"" << getOperation().name() << "\"\n";
+  print(graph, cache);
+
+  // Asking again must return the cached answers.
+  for (auto *node : graph) {
+    auto *module = node->getModule();
+    if (cache.getAbsolutePaths(module).data() !=
+        cache.getAbsolutePaths(module).data())
+      llvm::errs() << "uncached paths of " << getModuleName(module) << "\n";
+  }
+
+  SmallVector<InstanceRecord *, 4> erased;
+  for (auto *node : graph)
+    for (auto *record : *node)
+      if (record->getInstance()->hasAttr("test.erase"))
+        erased.push_back(record);
+  if (erased.empty())
+    return;
+  for (auto *record : erased) {
+    auto instance = record->getInstance();
+    record->erase();
+    instance.erase();
+  }
+
+  cache.invalidate();
+  llvm::errs() << "instance paths after erasing " << erased.size()
+               << " instances\n";
+  print(graph, cache);
+}
+
+//===----------------------------------------------------------------------===//
+// Pass registration
+//===----------------------------------------------------------------------===//
+
+namespace circt {
+namespace test {
+void registerFIRRTLTestPasses() {
+  PassRegistration<TestInstancePathsPass> instancePathsTester(
+      "test-firrtl-instance-paths",
+      "Print the instance counts and absolute paths of every module");
+}
+} // namespace test
+} // namespace circt
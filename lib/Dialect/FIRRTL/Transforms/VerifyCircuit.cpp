@@ -0,0 +1,33 @@
+//===- VerifyCircuit.cpp - Verify a FIRRTL circuit in parallel --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass which verifies a FIRRTL circuit, checking each
+// module on its own thread.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+
+using namespace circt;
+using namespace firrtl;
+
+namespace {
+struct VerifyCircuitPass : public VerifyCircuitBase<VerifyCircuitPass> {
+  void runOnOperation() override {
+    if (failed(verifyCircuit(getOperation())))
+      signalPassFailure();
+    markAllAnalysesPreserved();
+  }
+};
+} // end anonymous namespace
+
+std::unique_ptr<mlir::Pass> circt::firrtl::createVerifyCircuitPass() {
+  return std::make_unique<VerifyCircuitPass>();
+}
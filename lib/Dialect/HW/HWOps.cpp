@@ -660,6 +660,11 @@ Operation *InstanceOp::getReferencedModule() {
   return topLevelModuleOp.lookupSymbol(moduleName());
 }
 
+Operation *
+InstanceOp::getReferencedModule(SymbolTableCollection &symbolTable) {
+  return symbolTable.lookupNearestSymbolFrom(*this, moduleNameAttr());
+}
+
 // Helper function to verify instance op types
 static LogicalResult verifyInstanceOpTypes(InstanceOp op,
                                            Operation *referencedModule) {
@@ -724,18 +729,20 @@ static LogicalResult verifyInstanceOpTypes(InstanceOp op,
   return success();
 }
 
-static LogicalResult verifyInstanceOp(InstanceOp op) {
-  auto referencedModule = op.getReferencedModule();
+/// The referenced module is verified as a symbol use, which shares the symbol
+/// tables across all instances instead of scanning the top-level module for
+/// each of them.
+LogicalResult InstanceOp::verifySymbolUses(SymbolTableCollection &symbolTable) {
+  auto *referencedModule = getReferencedModule(symbolTable);
   if (referencedModule == nullptr)
-    return op.emitError("Cannot find module definition '")
-           << op.moduleName() << "'";
+    return emitError("Cannot find module definition '") << moduleName() << "'";
 
   // If the referenced module is internal, check that input and result types are
   // consistent with the referenced module.
   if (!isa<HWModuleOp>(referencedModule))
     return success();
 
-  return verifyInstanceOpTypes(op, referencedModule);
+  return verifyInstanceOpTypes(*this, referencedModule);
 }
 
 StringAttr InstanceOp::getResultName(size_t idx) {
@@ -27,6 +27,49 @@ using namespace circt;
 using namespace circt::hw;
 using namespace circt::hw::detail;
 
+/// Structs with at least this many fields look up their fields by name in a
+/// hash table rather than by a linear scan.
+static constexpr size_t minFieldsForNameTable = 16;
+
+namespace circt {
+namespace hw {
+namespace detail {
+struct StructTypeStorage : public mlir::TypeStorage {
+  using KeyTy = std::tuple<ArrayRef<FieldInfo>>;
+
+  StructTypeStorage(ArrayRef<FieldInfo> elements) : elements(elements) {
+    // The table is built here rather than on the first lookup, since types are
+    // shared by passes running in parallel. The first of any duplicate names
+    // wins, like in the linear scan.
+    if (elements.size() >= minFieldsForNameTable)
+      for (auto it : llvm::enumerate(elements))
+        nameToIndex.insert({it.value().name, it.index()});
+  }
+
+  bool operator==(const KeyTy &key) const { return key == KeyTy(elements); }
+
+  static llvm::hash_code hashKey(const KeyTy &key) {
+    return llvm::hash_combine(std::get<0>(key));
+  }
+
+  static StructTypeStorage *construct(mlir::TypeStorageAllocator &allocator,
+                                      const KeyTy &key) {
+    SmallVector<FieldInfo, 4> fields;
+    for (auto &field : std::get<0>(key))
+      fields.push_back(field.allocateInto(allocator));
+    return new (allocator.allocate<StructTypeStorage>())
+        StructTypeStorage(allocator.copyInto(ArrayRef<FieldInfo>(fields)));
+  }
+
+  ArrayRef<FieldInfo> elements;
+
+  /// The index of each field by name, only populated for large structs.
+  llvm::DenseMap<StringRef, unsigned> nameToIndex;
+};
+} // namespace detail
+} // namespace hw
+} // namespace circt
+
 #define GET_TYPEDEF_CLASSES
 #include "circt/Dialect/HW/HWTypes.cpp.inc"
 
@@ -233,12 +276,26 @@ void StructType::print(DialectAsmPrinter &p) const {
 }
 
 Type StructType::getFieldType(mlir::StringRef fieldName) {
-  for (const auto &field : getElements())
-    if (field.name == fieldName)
-      return field.type;
+  if (auto index = getFieldIndex(fieldName))
+    return getElements()[*index].type;
   return Type();
 }
 
+llvm::Optional<unsigned> StructType::getFieldIndex(mlir::StringRef fieldName) {
+  auto &nameToIndex = getImpl()->nameToIndex;
+  if (!nameToIndex.empty()) {
+    auto it = nameToIndex.find(fieldName);
+    if (it == nameToIndex.end())
+      return None;
+    return it->second;
+  }
+
+  for (auto it : llvm::enumerate(getElements()))
+    if (it.value().name == fieldName)
+      return unsigned(it.index());
+  return None;
+}
+
 void StructType::getInnerTypes(SmallVectorImpl<Type> &types) {
   for (const auto &field : getElements())
     types.push_back(field.type);
@@ -14,10 +14,18 @@
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/Visitors.h"
+#include "mlir/Support/FileUtilities.h"
 #include "mlir/Support/LogicalResult.h"
 #include "mlir/Translation.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ToolOutputFile.h"
 
 using namespace mlir;
 using namespace circt;
@@ -28,7 +36,7 @@ class VerilogPrinter {
 public:
   VerilogPrinter(llvm::formatted_raw_ostream &output) : out(output) {}
 
-  LogicalResult printModule(ModuleOp op);
+  LogicalResult printEntity(llhd::EntityOp entity);
   LogicalResult printOperation(Operation *op, unsigned indentAmount = 0);
 
 private:
@@ -57,42 +65,35 @@ private:
   DenseMap<Value, unsigned> timeValueMap;
 };
 
-LogicalResult VerilogPrinter::printModule(ModuleOp module) {
-  WalkResult result = module.walk([this](llhd::EntityOp entity) -> WalkResult {
-    // An EntityOp always has a single block
-    Block &entryBlock = entity.body().front();
-
-    // Print the module signature
-    out << "module _" << entity.getName();
-    if (!entryBlock.args_empty()) {
-      out << "(";
-      for (unsigned int i = 0, e = entryBlock.getNumArguments(); i < e; ++i) {
-        out << (i > 0 ? ", " : "") << (i < entity.ins() ? "input " : "output ");
-        (void)printType(entryBlock.getArgument(i).getType());
-        out << " ";
-        printVariableName(entryBlock.getArgument(i));
-      }
-      out << ")";
+LogicalResult VerilogPrinter::printEntity(llhd::EntityOp entity) {
+  // An EntityOp always has a single block
+  Block &entryBlock = entity.body().front();
+
+  // Print the module signature
+  out << "module _" << entity.getName();
+  if (!entryBlock.args_empty()) {
+    out << "(";
+    for (unsigned int i = 0, e = entryBlock.getNumArguments(); i < e; ++i) {
+      out << (i > 0 ? ", " : "") << (i < entity.ins() ? "input " : "output ");
+      (void)printType(entryBlock.getArgument(i).getType());
+      out << " ";
+      printVariableName(entryBlock.getArgument(i));
     }
-    out << ";\n";
-
-    // Print the operations within the entity
-    for (auto iter = entryBlock.begin();
-         iter != entryBlock.end() && !dyn_cast<llhd::TerminatorOp>(iter);
-         ++iter) {
-      if (failed(printOperation(&(*iter), 4))) {
-        return emitError(iter->getLoc(), "Operation not supported!");
-      }
+    out << ")";
+  }
+  out << ";\n";
+
+  // Print the operations within the entity
+  for (auto iter = entryBlock.begin();
+       iter != entryBlock.end() && !dyn_cast<llhd::TerminatorOp>(iter);
+       ++iter) {
+    if (failed(printOperation(&(*iter), 4))) {
+      return emitError(iter->getLoc(), "Operation not supported!");
     }
+  }
 
-    out << "endmodule\n";
-    // Reset variable name counter as variables only have to be unique within a
-    // module
-    nextValueNum = 0;
-    return WalkResult::advance();
-  });
-  // if printing of a single operation failed, fail the whole translation
-  return failure(result.wasInterrupted());
+  out << "endmodule\n";
+  return success();
 }
 
 LogicalResult VerilogPrinter::printBinaryOp(Operation *inst, StringRef opSymbol,
@@ -420,15 +421,119 @@ void VerilogPrinter::addAliasVariable(Value alias, Value existing) {
 
 } // anonymous namespace
 
+/// Print every entity of the module into its own buffer, with a printer of
+/// its own, as the names only have to be unique within a module. The
+/// entities are printed in parallel if multithreading is enabled. Returns
+/// the number of entities printed before the first one that failed.
+static size_t printEntities(ModuleOp module,
+                            SmallVectorImpl<llhd::EntityOp> &entities,
+                            std::vector<std::string> &buffers) {
+  module.walk([&](llhd::EntityOp entity) { entities.push_back(entity); });
+  buffers.resize(entities.size());
+  std::vector<char> printed(entities.size());
+
+  auto printEntity = [&](size_t index) {
+    llvm::raw_string_ostream os(buffers[index]);
+    llvm::formatted_raw_ostream out(os);
+    VerilogPrinter printer(out);
+    printed[index] = succeeded(printer.printEntity(entities[index]));
+  };
+  MLIRContext *context = module.getContext();
+  if (context->isMultithreadingEnabled()) {
+    // Diagnostics are ordered by the position of the entity in the module.
+    ParallelDiagnosticHandler diagHandler(context);
+    llvm::parallelForEachN(0, entities.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      printEntity(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = entities.size(); i != e; ++i)
+      printEntity(i);
+  }
+
+  return llvm::find(printed, false) - printed.begin();
+}
+
 LogicalResult circt::llhd::exportVerilog(ModuleOp module, raw_ostream &os) {
-  llvm::formatted_raw_ostream out(os);
-  VerilogPrinter printer(out);
-  return printer.printModule(module);
+  SmallVector<llhd::EntityOp, 0> entities;
+  std::vector<std::string> buffers;
+  size_t numPrinted = printEntities(module, entities, buffers);
+
+  // Concatenate the entities in the order of the module, up to the first one
+  // that could not be printed.
+  for (size_t i = 0; i != numPrinted; ++i)
+    os << buffers[i];
+  return success(numPrinted == entities.size());
 }
 
+LogicalResult circt::llhd::exportSplitVerilog(ModuleOp module,
+                                              StringRef dirname) {
+  SmallVector<llhd::EntityOp, 0> entities;
+  std::vector<std::string> buffers;
+  if (printEntities(module, entities, buffers) != entities.size())
+    return failure();
+
+  std::error_code error = llvm::sys::fs::create_directories(dirname);
+  if (error) {
+    module.emitError("cannot create output directory \"")
+        << dirname << "\": " << error.message();
+    return failure();
+  }
+
+  // Write each entity to a file named after it, and list the files in the
+  // order of the module.
+  std::string errorMessage;
+  SmallString<128> filelistPath(dirname);
+  llvm::sys::path::append(filelistPath, "filelist.f");
+  auto filelist = openOutputFile(filelistPath, &errorMessage);
+  if (!filelist) {
+    module.emitError(errorMessage);
+    return failure();
+  }
+  for (size_t i = 0, e = entities.size(); i != e; ++i) {
+    std::string fileName = (entities[i].getName() + ".v").str();
+    SmallString<128> path(dirname);
+    llvm::sys::path::append(path, fileName);
+    auto output = openOutputFile(path, &errorMessage);
+    if (!output) {
+      entities[i].emitError(errorMessage);
+      return failure();
+    }
+    output->os() << buffers[i];
+    output->keep();
+    filelist->os() << fileName << "\n";
+  }
+  filelist->keep();
+  return success();
+}
+
+namespace {
+/// Command line options of the LLHD to Verilog translations, registered
+/// along with them.
+struct TranslationCLOptions {
+  llvm::cl::opt<std::string> splitDirectory{
+      "llhd-split-verilog-dir",
+      llvm::cl::desc("Directory to write the files of "
+                     "--export-llhd-split-verilog to"),
+      llvm::cl::value_desc("directory"), llvm::cl::init(".")};
+};
+} // namespace
+
+static llvm::ManagedStatic<TranslationCLOptions> clOptions;
+
 void circt::llhd::registerToVerilogTranslation() {
+  *clOptions;
   TranslateFromMLIRRegistration registration(
       "export-llhd-verilog", exportVerilog, [](DialectRegistry &registry) {
         registry.insert<mlir::StandardOpsDialect, llhd::LLHDDialect>();
       });
+  TranslateFromMLIRRegistration splitRegistration(
+      "export-llhd-split-verilog",
+      [](ModuleOp module, raw_ostream &) {
+        return exportSplitVerilog(module, clOptions->splitDirectory);
+      },
+      [](DialectRegistry &registry) {
+        registry.insert<mlir::StandardOpsDialect, llhd::LLHDDialect>();
+      });
 }
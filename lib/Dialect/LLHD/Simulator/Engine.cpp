@@ -12,28 +12,143 @@
 
 #include "State.h"
 #include "Trace.h"
+#include "signals-runtime-wrappers.h"
 
 #include "circt/Conversion/LLHDToLLVM/LLHDToLLVM.h"
 #include "circt/Dialect/LLHD/Simulator/Engine.h"
 
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/IR/Builders.h"
+#include "mlir/Target/LLVMIR/Export.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <chrono>
 
 using namespace circt::llhd::sim;
 
+/// Insert the `width` low bits of `drive` in `value` at bit `offset`. A drive
+/// at least as wide as the `valueWidth` bits of the signal replaces its value.
+static uint64_t insertBits(uint64_t value, uint64_t drive, unsigned offset,
+                           unsigned width, unsigned valueWidth) {
+  if (width >= valueWidth) {
+    offset = 0;
+    width = valueWidth;
+  }
+  uint64_t mask = (width >= 64 ? ~0ULL : (1ULL << width) - 1) << offset;
+  return (value & ~mask) | ((drive << offset) & mask);
+}
+
+/// Insert the `width` low bits of `drive` in the `value` bytes at bit `offset`.
+/// Whole bytes are copied directly, the others are merged with a bitmask.
+static void insertBits(uint8_t *value, const uint8_t *drive, unsigned offset,
+                       unsigned width, unsigned valueWidth) {
+  if (width >= valueWidth) {
+    offset = 0;
+    width = valueWidth;
+  }
+  value += offset / 8;
+  unsigned shift = offset % 8;
+
+  if (shift == 0) {
+    std::memcpy(value, drive, width / 8);
+    if (width % 8) {
+      uint8_t mask = (1u << (width % 8)) - 1;
+      value[width / 8] = (value[width / 8] & ~mask) | (drive[width / 8] & mask);
+    }
+    return;
+  }
+
+  // Each byte of the drive straddles two bytes of the value.
+  for (unsigned bit = 0; bit < width; bit += 8) {
+    unsigned bits = std::min(8u, width - bit);
+    unsigned mask = ((1u << bits) - 1) << shift;
+    unsigned byte = (static_cast<unsigned>(drive[bit / 8]) << shift) & mask;
+    auto *dst = value + bit / 8;
+    dst[0] = (dst[0] & ~mask) | byte;
+    if (mask >> 8)
+      dst[1] = (dst[1] & ~(mask >> 8)) | (byte >> 8);
+  }
+}
+
+/// Insert the `width` bits of `drive` at bit `offset` in the `size` bytes of
+/// `value`, and return whether the value changed.
+static bool applyDrive(uint8_t *value, uint64_t size, const uint8_t *drive,
+                       unsigned offset, unsigned width,
+                       SmallVectorImpl<uint8_t> &scratch) {
+  if (size <= 8) {
+    uint64_t old = 0, word;
+    std::memcpy(&old, value, size);
+    std::memcpy(&word, drive, sizeof(word));
+    uint64_t updated = insertBits(old, word, offset, width, size * 8);
+    std::memcpy(value, &updated, size);
+    return updated != old;
+  }
+  scratch.assign(value, value + size);
+  insertBits(scratch.data(), drive, offset, width, size * 8);
+  bool changed = std::memcmp(value, scratch.data(), size) != 0;
+  std::memcpy(value, scratch.data(), size);
+  return changed;
+}
+
 Engine::Engine(
     llvm::raw_ostream &out, ModuleOp module,
     llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
     llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-    std::string root, int mode, ArrayRef<StringRef> sharedLibPaths)
-    : out(out), root(root), traceMode(mode) {
-  state = std::make_unique<State>();
+    std::string root, int mode, ArrayRef<StringRef> sharedLibPaths, int queue,
+    unsigned threads, bool vcd, bool asyncTrace, size_t traceBufferSize,
+    StringRef precompiled)
+    : out(out), root(root), queueKind(queue), llvmTransformer(llvmTransformer),
+      sharedLibPaths(sharedLibPaths.begin(), sharedLibPaths.end()),
+      traceMode(mode), vcd(vcd), asyncTrace(asyncTrace),
+      traceBufferSize(traceBufferSize) {
+  state = std::make_unique<State>(static_cast<QueueKind>(queue));
+
+  // Run the instances woken up in a step in parallel if more than one thread
+  // is requested. Every thread gets several chunks of instances to balance
+  // the load.
+  auto strategy = llvm::hardware_concurrency(threads);
+  if (strategy.compute_thread_count() > 1) {
+    pool = std::make_unique<llvm::ThreadPool>(strategy);
+    staging.resize(4 * pool->getThreadCount());
+  }
   state->root = root + '.' + root;
 
   buildLayout(module);
 
+  this->module = module;
+
+  // A precompiled design only needs the layout, the units are looked up in
+  // the library or object file. The runtime libraries are loaded first, for
+  // the design's references to the signals runtime to resolve against them.
+  if (!precompiled.empty()) {
+    std::string error;
+    for (auto path : sharedLibPaths) {
+      if (llvm::sys::DynamicLibrary::LoadLibraryPermanently(path.str().c_str(),
+                                                            &error)) {
+        llvm::errs() << "failed to load " << path << ": " << error << "\n";
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (failed(loadPrecompiled(precompiled)))
+      exit(EXIT_FAILURE);
+    return;
+  }
+
   auto rootEntity = module.lookupSymbol<EntityOp>(root);
 
   // Insert explicit instantiation of the design root.
@@ -48,77 +163,469 @@ Engine::Engine(
     exit(EXIT_FAILURE);
   }
 
-  this->module = module;
-
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
+}
 
+Engine::~Engine() = default;
+
+mlir::LogicalResult Engine::createJIT() {
+  SmallVector<StringRef, 1> libs(sharedLibPaths.begin(), sharedLibPaths.end());
   auto maybeEngine = mlir::ExecutionEngine::create(
-      this->module, nullptr, llvmTransformer,
-      /*jitCodeGenOptLevel=*/llvm::None, /*sharedLibPaths=*/sharedLibPaths);
-  assert(maybeEngine && "failed to create JIT");
+      module, nullptr, llvmTransformer,
+      /*jitCodeGenOptLevel=*/llvm::None, /*sharedLibPaths=*/libs);
+  if (!maybeEngine) {
+    llvm::errs() << "failed to create JIT: "
+                 << llvm::toString(maybeEngine.takeError()) << "\n";
+    return mlir::failure();
+  }
   engine = std::move(*maybeEngine);
+  return mlir::success();
 }
 
-Engine::~Engine() = default;
+mlir::LogicalResult Engine::createLazyJIT() {
+  std::string error;
+  for (auto &path : sharedLibPaths) {
+    if (llvm::sys::DynamicLibrary::LoadLibraryPermanently(path.c_str(),
+                                                          &error)) {
+      llvm::errs() << "failed to load " << path << ": " << error << "\n";
+      return mlir::failure();
+    }
+  }
+
+  auto reportError = [&](llvm::Error err) {
+    llvm::errs() << "failed to create JIT: " << llvm::toString(std::move(err))
+                 << "\n";
+    return mlir::failure();
+  };
+  // The instances of a step calling their units for the first time at once
+  // wait for them to be compiled on as many threads.
+  auto jit = llvm::orc::LLLazyJITBuilder()
+                 .setNumCompileThreads(pool ? pool->getThreadCount() : 0)
+                 .create();
+  if (!jit)
+    return reportError(jit.takeError());
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          (*jit)->getDataLayout().getGlobalPrefix());
+  if (!generator)
+    return reportError(generator.takeError());
+  (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+  llvm::orc::ThreadSafeContext context(std::make_unique<llvm::LLVMContext>());
+  auto llvmModule =
+      mlir::translateModuleToLLVMIR(module, *context.getContext());
+  if (!llvmModule) {
+    llvm::errs() << "failed to emit LLVM IR\n";
+    return mlir::failure();
+  }
+  llvmModule->setDataLayout((*jit)->getDataLayout());
+  llvmModule->setTargetTriple((*jit)->getTargetTriple().str());
+
+  // Optimize the functions as they are extracted for compilation, rather than
+  // the whole module upfront.
+  auto transformer = llvmTransformer;
+  (*jit)->getIRTransformLayer().setTransform(
+      [transformer](llvm::orc::ThreadSafeModule tsm,
+                    llvm::orc::MaterializationResponsibility &)
+          -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+        if (auto err = tsm.withModuleDo(
+                [&](llvm::Module &m) { return transformer(&m); }))
+          return std::move(err);
+        return std::move(tsm);
+      });
+
+  if (auto err = (*jit)->addLazyIRModule(
+          llvm::orc::ThreadSafeModule(std::move(llvmModule), context)))
+    return reportError(std::move(err));
+  objectJIT = std::move(*jit);
+  return mlir::success();
+}
+
+mlir::LogicalResult Engine::loadPrecompiled(StringRef path) {
+  llvm::file_magic magic;
+  if (auto ec = llvm::identify_magic(path, magic)) {
+    llvm::errs() << "failed to open " << path << ": " << ec.message() << "\n";
+    return mlir::failure();
+  }
+
+  if (magic != llvm::file_magic::elf_relocatable &&
+      magic != llvm::file_magic::macho_object &&
+      magic != llvm::file_magic::coff_object) {
+    std::string error;
+    library = llvm::sys::DynamicLibrary::getPermanentLibrary(path.str().c_str(),
+                                                            &error);
+    if (!library.isValid()) {
+      llvm::errs() << "failed to load " << path << ": " << error << "\n";
+      return mlir::failure();
+    }
+    return mlir::success();
+  }
+
+  // Object files are only linked, not compiled, by a JIT of their own. Their
+  // references to the signals runtime and libc are resolved in the process.
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  auto reportError = [&](llvm::Error err) {
+    llvm::errs() << "failed to load " << path << ": "
+                 << llvm::toString(std::move(err)) << "\n";
+    return mlir::failure();
+  };
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return reportError(jit.takeError());
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          (*jit)->getDataLayout().getGlobalPrefix());
+  if (!generator)
+    return reportError(generator.takeError());
+  (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    llvm::errs() << "failed to open " << path << ": "
+                 << buffer.getError().message() << "\n";
+    return mlir::failure();
+  }
+  if (auto err = (*jit)->addObjectFile(std::move(*buffer)))
+    return reportError(std::move(err));
+  objectJIT = std::move(*jit);
+  return mlir::success();
+}
+
+void *Engine::lookupPrecompiled(StringRef name) {
+  if (library.isValid())
+    return library.getAddressOfSymbol(name.str().c_str());
+  auto symbol = objectJIT->lookup(name);
+  if (!symbol) {
+    llvm::consumeError(symbol.takeError());
+    return nullptr;
+  }
+  return reinterpret_cast<void *>(symbol->getAddress());
+}
+
+mlir::LogicalResult Engine::emitObjectFile(StringRef path) {
+  llvm::LLVMContext llvmContext;
+  auto llvmModule = mlir::translateModuleToLLVMIR(module, llvmContext);
+  if (!llvmModule) {
+    llvm::errs() << "failed to emit LLVM IR\n";
+    return mlir::failure();
+  }
+
+  // The object may be linked into a shared library, so the code has to be
+  // position independent.
+  auto triple = llvm::sys::getProcessTriple();
+  std::string error;
+  auto *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    llvm::errs() << error << "\n";
+    return mlir::failure();
+  }
+  std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+      triple, llvm::sys::getHostCPUName(), "", llvm::TargetOptions(),
+      llvm::Reloc::PIC_));
+  llvmModule->setDataLayout(machine->createDataLayout());
+  llvmModule->setTargetTriple(triple);
+
+  if (auto err = llvmTransformer(llvmModule.get())) {
+    llvm::errs() << "failed to optimize LLVM IR: "
+                 << llvm::toString(std::move(err)) << "\n";
+    return mlir::failure();
+  }
+
+  std::error_code ec;
+  llvm::ToolOutputFile file(path, ec, llvm::sys::fs::OF_None);
+  if (ec) {
+    llvm::errs() << "failed to open " << path << ": " << ec.message() << "\n";
+    return mlir::failure();
+  }
+  llvm::legacy::PassManager pm;
+  if (machine->addPassesToEmitFile(pm, file.os(), nullptr,
+                                   llvm::CGFT_ObjectFile)) {
+    llvm::errs() << "the target cannot emit object files\n";
+    return mlir::failure();
+  }
+  pm.run(*llvmModule);
+  file.keep();
+  return mlir::success();
+}
+
+mlir::LogicalResult Engine::setTraceFilter(ArrayRef<std::string> include,
+                                           ArrayRef<std::string> exclude) {
+  SmallVector<llvm::GlobPattern, 4> includePatterns, excludePatterns;
+  auto compile = [](ArrayRef<std::string> patterns,
+                    SmallVectorImpl<llvm::GlobPattern> &compiled) {
+    for (auto &pattern : patterns) {
+      auto glob = llvm::GlobPattern::create(pattern);
+      if (!glob) {
+        llvm::errs() << "invalid trace filter pattern '" << pattern
+                     << "': " << llvm::toString(glob.takeError()) << "\n";
+        return mlir::failure();
+      }
+      compiled.push_back(std::move(*glob));
+    }
+    return mlir::success();
+  };
+  if (failed(compile(include, includePatterns)) ||
+      failed(compile(exclude, excludePatterns)))
+    return mlir::failure();
+
+  if (traceMode >= 0)
+    state->tracedSignals =
+        Trace::getTracedSignals(*state, static_cast<TraceMode>(traceMode),
+                                includePatterns, excludePatterns);
+  return mlir::success();
+}
 
 void Engine::dumpStateLayout() { state->dumpLayout(); }
 
 void Engine::dumpStateSignalTriggers() { state->dumpSignalTriggers(); }
 
 int Engine::simulate(int n, uint64_t maxTime) {
-  assert(engine && "engine not found");
   assert(state && "state not found");
+  if (failed(prepare(state)))
+    return -1;
+  return run(state, out, n, maxTime);
+}
 
-  auto tm = static_cast<TraceMode>(traceMode);
-  Trace trace(state, out, tm);
+int Engine::simulateBatch(ArrayRef<Stimulus> stimuli,
+                          ArrayRef<llvm::raw_ostream *> outs, int n,
+                          uint64_t maxTime) {
+  assert(stimuli.size() == outs.size() && "one stream per replica expected");
+
+  // The replicas are initialized serially, as the JIT lookups are not meant
+  // to run concurrently.
+  std::vector<std::unique_ptr<State>> replicas;
+  for (auto &stimulus : stimuli) {
+    auto replica = std::make_unique<State>(static_cast<QueueKind>(queueKind));
+    replica->copyLayout(*state);
+    if (failed(prepare(replica)))
+      return -1;
+    for (auto &init : stimulus) {
+      if (auto err = replica->setSignalValue(init.first, init.second)) {
+        llvm::errs() << llvm::toString(std::move(err)) << "\n";
+        return -1;
+      }
+    }
+    replicas.push_back(std::move(replica));
+  }
+
+  // Each replica runs serially on one thread of the pool, or on the main
+  // thread if there is none.
+  std::vector<int> results(replicas.size());
+  for (size_t r = 0, e = replicas.size(); r < e; ++r) {
+    auto task = [&, r] {
+      results[r] = run(replicas[r], *outs[r], n, maxTime, r);
+    };
+    if (pool)
+      pool->async(task);
+    else
+      task();
+  }
+  if (pool)
+    pool->wait();
+
+  for (auto result : results)
+    if (result != 0)
+      return result;
+  return 0;
+}
+
+mlir::LogicalResult Engine::prepare(std::unique_ptr<State> &sim) {
+  if (!library.isValid() && !objectJIT && !engine &&
+      failed(lazyCompilation ? createLazyJIT() : createJIT()))
+    return mlir::failure();
+  // The units of the lazy JIT are called directly, like precompiled ones.
+  bool precompiled = library.isValid() || objectJIT;
 
-  SmallVector<void *, 1> arg({&state});
   // Initialize tbe simulation state.
-  auto invocationResult = engine->invokePacked("llhd_init", arg);
-  if (invocationResult) {
-    llvm::errs() << "Failed invocation of llhd_init: " << invocationResult;
-    return -1;
+  if (precompiled) {
+    auto *init =
+        reinterpret_cast<void (*)(State *)>(lookupPrecompiled("llhd_init"));
+    if (!init) {
+      llvm::errs() << "Could not lookup llhd_init!\n";
+      return mlir::failure();
+    }
+    init(sim.get());
+  } else {
+    SmallVector<void *, 1> arg({&sim});
+    auto invocationResult = engine->invokePacked("llhd_init", arg);
+    if (invocationResult) {
+      llvm::errs() << "Failed invocation of llhd_init: " << invocationResult;
+      return mlir::failure();
+    }
   }
 
+  // All the signals are allocated, move them to contiguous memory.
+  sim->packSignalValues();
+
+  // Add the jitted function pointers to all of the instances to make them
+  // readily available.
+  for (size_t i = 0, e = sim->instances.size(); i < e; ++i) {
+    auto &inst = sim->instances[i];
+    if (precompiled) {
+      auto *fPtr = lookupPrecompiled(inst.unit);
+      if (!fPtr) {
+        llvm::errs() << "Could not lookup " << inst.unit << "!\n";
+        return mlir::failure();
+      }
+      inst.unitPrecompiledFPtr =
+          reinterpret_cast<void (*)(State *, void *, SignalDetail *)>(fPtr);
+      continue;
+    }
+    auto expectedFPtr = engine->lookup(inst.unit);
+    if (!expectedFPtr) {
+      llvm::errs() << "Could not lookup " << inst.unit << "!\n";
+      return mlir::failure();
+    }
+    inst.unitFPtr = *expectedFPtr;
+  }
+
+  return mlir::success();
+}
+
+int Engine::run(std::unique_ptr<State> &sim, llvm::raw_ostream &os, int n,
+                uint64_t maxTime, int replica) {
+  // Only the main simulation gathers statistics, not the batch replicas.
+  bool collect = collectStatistics && replica < 0;
+  if (collect)
+    statistics = Statistics();
+  auto startTime = std::chrono::steady_clock::now();
+  auto traceStart = os.tell();
+  std::vector<uint64_t> activations(collect ? sim->instances.size() : 0);
+  std::chrono::steady_clock::duration unitTime{};
+
+  // Count the values of a histogram in power of two buckets.
+  auto addToHistogram = [](SmallVectorImpl<uint64_t> &histogram,
+                           uint64_t value) {
+    unsigned bucket = value ? llvm::Log2_64(value) : 0;
+    if (histogram.size() <= bucket)
+      histogram.resize(bucket + 1);
+    ++histogram[bucket];
+  };
+
+  // Run an instance, counting and timing its activation if needed.
+  auto runCounted = [&](unsigned i) {
+    if (!collect) {
+      runInstance(*sim, i);
+      return;
+    }
+    ++activations[i];
+    auto start = std::chrono::steady_clock::now();
+    runInstance(*sim, i);
+    unitTime += std::chrono::steady_clock::now() - start;
+  };
+
+  auto tm = static_cast<TraceMode>(traceMode);
+  Trace trace(sim, os, tm, vcd);
+  if (traceMode >= 0 && asyncTrace)
+    trace.writeInBackground(traceBufferSize);
+
+  bool restored = replica < 0 && !restorePath.empty();
+  if (restored && failed(restoreCheckpoint()))
+    return -1;
+
   if (traceMode >= 0) {
     // Add changes for all the signals' initial values.
-    for (size_t i = 0, e = state->signals.size(); i < e; ++i) {
+    for (size_t i = 0, e = sim->signals.size(); i < e; ++i) {
       trace.addChange(i);
     }
+    // The restored values are dumped at the time of the checkpoint.
+    if (restored)
+      trace.flush(/*force=*/true);
   }
 
   // Add a dummy event to get the simulation started.
-  state->queue.push_back(Slot(Time()));
-  ++state->queue.events;
+  if (!restored)
+    sim->queue->getOrCreateSlot(Time());
 
-  // Keep track of the instances that need to wakeup.
-  llvm::SmallVector<unsigned, 8> wakeupQueue;
+  // Keep track of the instances that need to wakeup. A bitmap takes care of
+  // duplicates and keeps the instances in the order they have to run in.
+  llvm::BitVector wakeupQueue(sim->instances.size());
 
-  // Add all instances to the wakeup queue for the first run and add the jitted
-  // function pointers to all of the instances to make them readily available.
-  for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
-    wakeupQueue.push_back(i);
-    auto &inst = state->instances[i];
-    auto expectedFPtr = engine->lookup(inst.unit);
-    if (!expectedFPtr) {
-      llvm::errs() << "Could not lookup " << inst.unit << "!\n";
-      return -1;
+  // The buffer wide signal values are updated in.
+  llvm::SmallVector<uint8_t, 64> scratch;
+
+  // The instances to run in parallel.
+  llvm::SmallVector<unsigned, 0> woken;
+
+  // In cycle-based mode, the combinational entities woken up in a step run
+  // after the other instances, in topological order, and their drives are
+  // applied right away from their own staging buffers.
+  bool evaluateCombinational = cycleBased && !sim->combinationalOrder.empty();
+  llvm::BitVector combinationalWoken(sim->instances.size());
+  UpdateStaging combinationalStaging;
+
+  // Add the instances sensitive to the given signal to the wakeup queue.
+  auto wakeTriggered = [&](unsigned sigIndex) {
+    if (collect)
+      ++statistics.signalChanges;
+    for (size_t t = sim->triggerBegin[sigIndex],
+                te = sim->triggerBegin[sigIndex + 1];
+         t < te; ++t) {
+      auto inst = sim->triggerInsts[t];
+      auto &instance = sim->instances[inst];
+      // Skip if the process is not currently sensible to the signal.
+      if (!instance.isEntity) {
+        auto *senses = instance.procState->senses;
+        if (senses[sim->triggerSenses[t]] == 0)
+          continue;
+
+        // Invalidate scheduled wakeup
+        instance.expectedWakeup = Time();
+      }
+      if (evaluateCombinational && instance.combinational)
+        combinationalWoken.set(inst);
+      else
+        wakeupQueue.set(inst);
     }
-    inst.unitFPtr = *expectedFPtr;
+  };
+
+  // Add all instances to the wakeup queue for the first run, unless they are
+  // resumed from a checkpoint.
+  if (!restored) {
+    wakeupQueue.set();
+    if (evaluateCombinational)
+      for (auto i : sim->combinationalOrder) {
+        wakeupQueue.reset(i);
+        combinationalWoken.set(i);
+      }
   }
 
   int cycle = 0;
-  while (state->queue.events > 0) {
-    const auto &pop = state->queue.top();
+  uint64_t stepsAtRealTime = 0;
+  while (!sim->queue->empty()) {
+    const auto &pop = sim->queue->top();
 
     // Interrupt the simulation if a stop condition is met.
     if ((n > 0 && cycle >= n) || (maxTime > 0 && pop.time.time > maxTime)) {
       break;
     }
 
+    // Write the checkpoint between two steps, once the simulation has started.
+    if (replica < 0 && !checkpointPath.empty() && cycle > 0 &&
+        pop.time.time >= checkpointTime) {
+      if (failed(writeCheckpoint()))
+        return -1;
+      break;
+    }
+
+    if (collect) {
+      ++statistics.steps;
+      statistics.drives += pop.changesSize;
+      statistics.wakeups += pop.scheduled.size();
+      addToHistogram(statistics.queueDepth, sim->queue->events);
+      if (statistics.steps == 1 || pop.time.time != sim->time.time) {
+        ++statistics.realTimeSteps;
+        if (stepsAtRealTime)
+          addToHistogram(statistics.stepsPerRealTime, stepsAtRealTime);
+        stepsAtRealTime = 0;
+      }
+      ++stepsAtRealTime;
+    }
+
     // Update the simulation time.
-    state->time = pop.time;
+    sim->time = pop.time;
 
     if (traceMode >= 0)
       trace.flush();
@@ -127,51 +634,44 @@ int Engine::simulate(int n, uint64_t maxTime) {
     size_t i = 0, e = pop.changesSize;
     while (i < e) {
       const auto sigIndex = pop.changes[i].first;
-      const auto &curr = state->signals[sigIndex];
-      APInt buff(
-          curr.size * 8,
-          llvm::makeArrayRef(reinterpret_cast<uint64_t *>(curr.value.get()),
-                             llvm::divideCeil(curr.size, 8)));
-
-      // Apply the changes to the buffer until we reach the next signal.
-      while (i < e && pop.changes[i].first == sigIndex) {
-        const auto &change = pop.buffers[pop.changes[i].second];
-        const auto offset = change.first;
-        const auto &drive = change.second;
-        if (drive.getBitWidth() < buff.getBitWidth())
-          buff.insertBits(drive, offset);
-        else
-          buff = drive;
-
-        ++i;
+      auto *sigValue = sim->signalValues[sigIndex];
+      const auto sigSize = sim->signalSizes[sigIndex];
+
+      // Apply the changes to the signal value until we reach the next signal.
+      // The value is updated in a word or in a scratch buffer first, to detect
+      // whether it actually changed.
+      bool changed;
+      if (sigSize <= 8) {
+        uint64_t value = 0;
+        std::memcpy(&value, sigValue, sigSize);
+        uint64_t updated = value;
+        for (; i < e && pop.changes[i].first == sigIndex; ++i) {
+          const auto &drive = pop.buffers[pop.changes[i].second];
+          updated = insertBits(updated, pop.words[drive.word], drive.bitOffset,
+                               drive.width, sigSize * 8);
+        }
+        changed = updated != value;
+        if (changed)
+          std::memcpy(sigValue, &updated, sigSize);
+      } else {
+        scratch.assign(sigValue, sigValue + sigSize);
+        for (; i < e && pop.changes[i].first == sigIndex; ++i) {
+          const auto &drive = pop.buffers[pop.changes[i].second];
+          insertBits(scratch.data(),
+                     reinterpret_cast<const uint8_t *>(&pop.words[drive.word]),
+                     drive.bitOffset, drive.width, sigSize * 8);
+        }
+        changed = std::memcmp(sigValue, scratch.data(), sigSize) != 0;
+        if (changed)
+          std::memcpy(sigValue, scratch.data(), sigSize);
       }
 
       // Skip if the updated signal value is equal to the initial value.
-      if (std::memcmp(curr.value.get(), buff.getRawData(), curr.size) == 0)
+      if (!changed)
         continue;
 
-      // Apply the signal update.
-      std::memcpy(curr.value.get(), buff.getRawData(), curr.size);
-
       // Add sensitive instances.
-      for (auto inst : curr.triggers) {
-        // Skip if the process is not currently sensible to the signal.
-        if (!state->instances[inst].isEntity) {
-          const auto &sensList = state->instances[inst].sensitivityList;
-          auto it = std::find_if(sensList.begin(), sensList.end(),
-                                 [sigIndex](const SignalDetail &sig) {
-                                   return sig.globalIndex == sigIndex;
-                                 });
-          if (sensList.end() != it &&
-              state->instances[inst].procState->senses[it - sensList.begin()] ==
-                  0)
-            continue;
-
-          // Invalidate scheduled wakeup
-          state->instances[inst].expectedWakeup = Time();
-        }
-        wakeupQueue.push_back(inst);
-      }
+      wakeTriggered(sigIndex);
 
       // Dump the updated signal.
       if (traceMode >= 0)
@@ -180,34 +680,60 @@ int Engine::simulate(int n, uint64_t maxTime) {
 
     // Add scheduled process resumes to the wakeup queue.
     for (auto inst : pop.scheduled) {
-      if (state->time == state->instances[inst].expectedWakeup)
-        wakeupQueue.push_back(inst);
+      if (sim->time == sim->instances[inst].expectedWakeup)
+        wakeupQueue.set(inst);
     }
 
-    state->queue.pop();
-
-    std::sort(wakeupQueue.begin(), wakeupQueue.end());
-    wakeupQueue.erase(std::unique(wakeupQueue.begin(), wakeupQueue.end()),
-                      wakeupQueue.end());
+    sim->queue->pop();
 
     // Run the instances present in the wakeup queue.
-    for (auto i : wakeupQueue) {
-      auto &inst = state->instances[i];
-      auto signalTable = inst.sensitivityList.data();
-
-      // Gather the instance arguments for unit invocation.
-      SmallVector<void *, 3> args;
-      if (inst.isEntity)
-        args.assign({&state, &inst.entityState, &signalTable});
-      else {
-        args.assign({&state, &inst.procState, &signalTable});
+    if (replica < 0 && pool && wakeupQueue.count() >= 2 * staging.size()) {
+      woken.clear();
+      for (auto i : wakeupQueue.set_bits())
+        woken.push_back(i);
+      // The units running in parallel are timed together.
+      auto start = std::chrono::steady_clock::now();
+      runInstancesInParallel(*sim, woken);
+      if (collect) {
+        unitTime += std::chrono::steady_clock::now() - start;
+        for (auto i : woken)
+          ++activations[i];
       }
-      // Run the unit.
-      (*inst.unitFPtr)(args.data());
+    } else {
+      for (auto i : wakeupQueue.set_bits())
+        runCounted(i);
     }
 
     // Clear wakeup queue.
-    wakeupQueue.clear();
+    wakeupQueue.reset();
+
+    // Evaluate the woken combinational entities, which wake up the later ones
+    // in the order. The other instances they wake up run once all of them
+    // have been evaluated.
+    if (combinationalWoken.any()) {
+      setThreadStaging(&combinationalStaging);
+      for (auto i : sim->combinationalOrder) {
+        if (!combinationalWoken.test(i))
+          continue;
+        runCounted(i);
+        combinationalStaging.drain([&](unsigned sigIndex, int bitOffset,
+                                       const uint8_t *bytes, unsigned width) {
+          if (!applyDrive(sim->signalValues[sigIndex],
+                          sim->signalSizes[sigIndex], bytes, bitOffset, width,
+                          scratch))
+            return;
+          wakeTriggered(sigIndex);
+          if (traceMode >= 0)
+            trace.addChange(sigIndex);
+        });
+      }
+      setThreadStaging(nullptr);
+      combinationalWoken.reset();
+
+      for (auto i : wakeupQueue.set_bits())
+        runCounted(i);
+      wakeupQueue.reset();
+    }
     ++cycle;
   }
 
@@ -216,11 +742,111 @@ int Engine::simulate(int n, uint64_t maxTime) {
     trace.flush(/*force=*/true);
   }
 
-  llvm::errs() << "Finished at " << state->time.dump() << " (" << cycle
-               << " cycles)\n";
+  if (collect) {
+    if (stepsAtRealTime)
+      addToHistogram(statistics.stepsPerRealTime, stepsAtRealTime);
+    for (size_t i = 0, e = activations.size(); i < e; ++i) {
+      statistics.activations += activations[i];
+      if (activations[i])
+        statistics.unitActivations[sim->instances[i].unit] += activations[i];
+    }
+    trace.finish();
+    statistics.traceBytes = os.tell() - traceStart;
+    statistics.unitSeconds =
+        std::chrono::duration<double>(unitTime).count();
+    statistics.totalSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      startTime)
+            .count();
+  }
+
+  // Print the summary in one write, replicas may finish concurrently.
+  std::string summary;
+  llvm::raw_string_ostream summaryStream(summary);
+  if (replica >= 0)
+    summaryStream << "Replica " << replica << ": ";
+  summaryStream << "Finished at " << sim->time.dump() << " (" << cycle
+                << " cycles)\n";
+  llvm::errs() << summaryStream.str();
   return 0;
 }
 
+mlir::LogicalResult Engine::writeCheckpoint() {
+  std::error_code ec;
+  llvm::ToolOutputFile file(checkpointPath, ec, llvm::sys::fs::OF_None);
+  if (ec) {
+    llvm::errs() << "failed to open " << checkpointPath << ": "
+                 << ec.message() << "\n";
+    return mlir::failure();
+  }
+  state->writeCheckpoint(file.os());
+  file.keep();
+  return mlir::success();
+}
+
+mlir::LogicalResult Engine::restoreCheckpoint() {
+  auto buffer = llvm::MemoryBuffer::getFile(restorePath);
+  if (!buffer) {
+    llvm::errs() << "failed to open " << restorePath << ": "
+                 << buffer.getError().message() << "\n";
+    return mlir::failure();
+  }
+  if (auto err = state->restoreCheckpoint((*buffer)->getBuffer())) {
+    llvm::errs() << restorePath << ": " << llvm::toString(std::move(err))
+                 << "\n";
+    return mlir::failure();
+  }
+  return mlir::success();
+}
+
+void Engine::runInstance(State &sim, unsigned index) {
+  auto &inst = sim.instances[index];
+  auto signalTable = inst.sensitivityList.data();
+
+  if (inst.unitPrecompiledFPtr) {
+    void *persistence = inst.isEntity
+                            ? static_cast<void *>(inst.entityState.get())
+                            : static_cast<void *>(inst.procState.get());
+    (*inst.unitPrecompiledFPtr)(&sim, persistence, signalTable);
+    flushDriveBuffer(&sim);
+    return;
+  }
+
+  // Gather the instance arguments for unit invocation.
+  State *statePtr = &sim;
+  SmallVector<void *, 3> args;
+  if (inst.isEntity)
+    args.assign({&statePtr, &inst.entityState, &signalTable});
+  else {
+    args.assign({&statePtr, &inst.procState, &signalTable});
+  }
+  // Run the unit.
+  (*inst.unitFPtr)(args.data());
+  flushDriveBuffer(&sim);
+}
+
+void Engine::runInstancesInParallel(State &sim,
+                                    ArrayRef<unsigned> instances) {
+  // Drives only take effect in later slots, so the instances of a step are
+  // independent of each other. Each chunk of instances records its events in
+  // its own staging buffers, which are inserted in the queue in the order of
+  // the chunks, as if the instances had run serially.
+  size_t chunkSize = llvm::divideCeil(instances.size(), staging.size());
+  size_t numChunks = llvm::divideCeil(instances.size(), chunkSize);
+  for (size_t c = 0; c < numChunks; ++c) {
+    pool->async([&, c] {
+      setThreadStaging(&staging[c]);
+      for (auto i : instances.slice(c * chunkSize).take_front(chunkSize))
+        runInstance(sim, i);
+      setThreadStaging(nullptr);
+    });
+  }
+  pool->wait();
+
+  for (size_t c = 0; c < numChunks; ++c)
+    staging[c].flush(*sim.queue);
+}
+
 void Engine::buildLayout(ModuleOp module) {
   // Start from the root entity.
   auto rootEntity = module.lookupSymbol<EntityOp>(root);
@@ -234,19 +860,120 @@ void Engine::buildLayout(ModuleOp module) {
 
   // Recursively walk the units starting at root.
   walkEntity(rootEntity, rootInst);
+  classifyEntity(rootEntity, rootInst);
 
   // The root is always an instance.
   rootInst.isEntity = true;
   // Store the root instance.
   state->instances.push_back(std::move(rootInst));
 
-  // Add triggers to signals.
+  // Add triggers to signals, along with the index of the first occurrence of
+  // the signal in the sensitivity list, which is the one processes check. The
+  // triggers of each signal are counted first, to store them contiguously.
+  auto &triggerBegin = state->triggerBegin;
+  triggerBegin.assign(state->signals.size() + 1, 0);
+  for (auto &inst : state->instances)
+    for (auto &detail : inst.sensitivityList)
+      ++triggerBegin[detail.globalIndex + 1];
+  for (size_t i = 1, e = triggerBegin.size(); i < e; ++i)
+    triggerBegin[i] += triggerBegin[i - 1];
+
+  state->triggerInsts.resize(triggerBegin.back());
+  state->triggerSenses.resize(triggerBegin.back());
+  std::vector<unsigned> next(triggerBegin.begin(), triggerBegin.end() - 1);
   for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
     auto &inst = state->instances[i];
-    for (auto trigger : inst.sensitivityList) {
-      state->signals[trigger.globalIndex].triggers.push_back(i);
+    llvm::SmallDenseMap<uint64_t, unsigned> firstIndex;
+    for (size_t k = 0, ke = inst.sensitivityList.size(); k < ke; ++k) {
+      auto globalIndex = inst.sensitivityList[k].globalIndex;
+      auto t = next[globalIndex]++;
+      state->triggerInsts[t] = i;
+      state->triggerSenses[t] =
+          firstIndex.try_emplace(globalIndex, k).first->second;
     }
   }
+  state->buildIndex();
+
+  // Order the combinational entities such that each one comes after the ones
+  // driving its signals. The entities on a combinational loop are left out,
+  // they keep being simulated through the event queue.
+  auto &instances = state->instances;
+  std::vector<unsigned> indegree(instances.size(), 0);
+  for (size_t i = 0, e = instances.size(); i < e; ++i)
+    if (instances[i].combinational)
+      for (auto sig : instances[i].drivenSignals)
+        for (auto t : state->getTriggers(sig))
+          if (t != i && instances[t].combinational)
+            ++indegree[t];
+
+  auto &order = state->combinationalOrder;
+  for (size_t i = 0, e = instances.size(); i < e; ++i)
+    if (instances[i].combinational && indegree[i] == 0)
+      order.push_back(i);
+  for (size_t next = 0; next < order.size(); ++next) {
+    auto i = order[next];
+    for (auto sig : instances[i].drivenSignals)
+      for (auto t : state->getTriggers(sig))
+        if (t != i && instances[t].combinational && --indegree[t] == 0)
+          order.push_back(t);
+  }
+  for (size_t i = 0, e = instances.size(); i < e; ++i)
+    if (indegree[i] != 0)
+      instances[i].combinational = false;
+
+  // The signals traced with the trace mode, until a filter is set.
+  if (traceMode >= 0)
+    state->tracedSignals =
+        Trace::getTracedSignals(*state, static_cast<TraceMode>(traceMode));
+}
+
+void Engine::classifyEntity(EntityOp entity, Instance &inst) {
+  inst.combinational = false;
+  inst.drivenSignals.clear();
+  if (!llvm::empty(entity.getBody().getOps<RegOp>()))
+    return;
+
+  // Find the global index of a signal through the subsignal extractions.
+  auto resolve = [&](Value signal) -> Optional<unsigned> {
+    while (signal.getDefiningOp() && !isa<SigOp>(signal.getDefiningOp())) {
+      auto *op = signal.getDefiningOp();
+      if (op->getNumOperands() == 0 ||
+          !op->getOperand(0).getType().isa<SigType>())
+        return llvm::None;
+      signal = op->getOperand(0);
+    }
+    if (auto arg = signal.dyn_cast<BlockArgument>())
+      return inst.sensitivityList[arg.getArgNumber()].globalIndex;
+    auto sig = cast<SigOp>(signal.getDefiningOp());
+    auto it = llvm::find_if(inst.sensitivityList, [&](SignalDetail &detail) {
+      return state->signals[detail.globalIndex].name == sig.name() &&
+             state->signals[detail.globalIndex].owner == inst.name;
+    });
+    if (it == inst.sensitivityList.end())
+      return llvm::None;
+    return it->globalIndex;
+  };
+
+  for (auto drv : entity.getBody().getOps<DrvOp>()) {
+    // The drive has to take effect in the same real-time step.
+    auto time = drv.time().getDefiningOp<ConstOp>();
+    auto timeAttr = time ? time.value().dyn_cast<TimeAttr>() : TimeAttr();
+    if (!timeAttr || timeAttr.getTime() != 0)
+      return;
+    auto signal = resolve(drv.signal());
+    if (!signal)
+      return;
+    inst.drivenSignals.push_back(*signal);
+  }
+
+  // The entity is triggered by the signals it drives, as they are in its
+  // sensitivity list, but only depends on them if it probes them.
+  for (auto prb : entity.getBody().getOps<PrbOp>()) {
+    auto signal = resolve(prb.signal());
+    if (!signal || llvm::is_contained(inst.drivenSignals, *signal))
+      return;
+  }
+  inst.combinational = true;
 }
 
 void Engine::walkEntity(EntityOp entity, Instance &child) {
@@ -307,6 +1034,7 @@ void Engine::walkEntity(EntityOp entity, Instance &child) {
         if (auto ent = dyn_cast<EntityOp>(e)) {
           newChild.isEntity = true;
           walkEntity(ent, newChild);
+          classifyEntity(ent, newChild);
         } else {
           newChild.isEntity = false;
         }
@@ -317,3 +1045,90 @@ void Engine::walkEntity(EntityOp entity, Instance &child) {
     }
   });
 }
+
+//===----------------------------------------------------------------------===//
+// Statistics
+//===----------------------------------------------------------------------===//
+
+/// Return the units sorted by decreasing activation count.
+static std::vector<std::pair<llvm::StringRef, uint64_t>>
+sortUnits(const llvm::StringMap<uint64_t> &unitActivations) {
+  std::vector<std::pair<llvm::StringRef, uint64_t>> units;
+  for (auto &unit : unitActivations)
+    units.push_back({unit.getKey(), unit.getValue()});
+  llvm::sort(units, [](const auto &lhs, const auto &rhs) {
+    return lhs.second != rhs.second ? lhs.second > rhs.second
+                                    : lhs.first < rhs.first;
+  });
+  return units;
+}
+
+void Statistics::print(llvm::raw_ostream &os) const {
+  os << "===" << std::string(73, '-') << "===\n"
+     << std::string(25, ' ') << "... Simulation Statistics ...\n"
+     << "===" << std::string(73, '-') << "===\n";
+  os << "  Steps:                " << steps << " (" << realTimeSteps
+     << " real-time steps)\n";
+  os << "  Drives applied:       " << drives << "\n";
+  os << "  Signal changes:       " << signalChanges << "\n";
+  os << "  Scheduled wakeups:    " << wakeups << "\n";
+  os << "  Unit activations:     " << activations << "\n";
+  os << "  Wall time:            " << llvm::format("%.4f", totalSeconds)
+     << " s\n";
+  os << "  Time in units:        " << llvm::format("%.4f", unitSeconds) << " s";
+  if (totalSeconds > 0)
+    os << " (" << llvm::format("%.1f", 100 * unitSeconds / totalSeconds)
+       << "%)";
+  os << "\n";
+  os << "  Trace bytes:          " << traceBytes << "\n";
+
+  auto printHistogram = [&](llvm::StringRef title,
+                            llvm::ArrayRef<uint64_t> histogram) {
+    os << "\n  " << title << ":\n";
+    for (size_t i = 0, e = histogram.size(); i < e; ++i)
+      if (histogram[i])
+        os << "    " << llvm::format_decimal(1ULL << i, 10) << " - "
+           << llvm::format_decimal((2ULL << i) - 1, 10) << "  "
+           << histogram[i] << "\n";
+  };
+  printHistogram("Steps per real-time step", stepsPerRealTime);
+  printHistogram("Queue depth", queueDepth);
+
+  os << "\n  Activations per unit:\n";
+  for (auto &unit : sortUnits(unitActivations))
+    os << "    " << llvm::format_decimal(unit.second, 10) << "  "
+       << unit.first << "\n";
+}
+
+void Statistics::printJSON(llvm::raw_ostream &os) const {
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  auto histogram = [&](llvm::StringRef name,
+                       llvm::ArrayRef<uint64_t> buckets) {
+    json.attributeArray(name, [&] {
+      for (size_t i = 0, e = buckets.size(); i < e; ++i)
+        json.object([&] {
+          json.attribute("min", int64_t(1ULL << i));
+          json.attribute("max", int64_t((2ULL << i) - 1));
+          json.attribute("count", int64_t(buckets[i]));
+        });
+    });
+  };
+  json.object([&] {
+    json.attribute("steps", int64_t(steps));
+    json.attribute("realTimeSteps", int64_t(realTimeSteps));
+    json.attribute("drives", int64_t(drives));
+    json.attribute("signalChanges", int64_t(signalChanges));
+    json.attribute("wakeups", int64_t(wakeups));
+    json.attribute("activations", int64_t(activations));
+    json.attribute("totalSeconds", totalSeconds);
+    json.attribute("unitSeconds", unitSeconds);
+    json.attribute("traceBytes", int64_t(traceBytes));
+    histogram("stepsPerRealTime", stepsPerRealTime);
+    histogram("queueDepth", queueDepth);
+    json.attributeObject("unitActivations", [&] {
+      for (auto &unit : sortUnits(unitActivations))
+        json.attribute(unit.first, int64_t(unit.second));
+    });
+  });
+  os << "\n";
+}
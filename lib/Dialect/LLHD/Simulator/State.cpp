@@ -13,14 +13,23 @@
 
 #include "State.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemAlloc.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <cstddef>
 #include <string>
 
 using namespace llvm;
 using namespace circt::llhd::sim;
 
+/// The alignment of the signal values arena, the size of a cache line on most
+/// hosts.
+static constexpr size_t signalArenaAlignment = 64;
+
 //===----------------------------------------------------------------------===//
 // Time
 //===----------------------------------------------------------------------===//
@@ -57,17 +66,7 @@ std::string Time::dump() {
 //===----------------------------------------------------------------------===//
 
 Signal::Signal(std::string name, std::string owner)
-    : name(name), owner(owner), size(0), value(nullptr) {}
-
-Signal::Signal(std::string name, std::string owner, uint8_t *value,
-               uint64_t size)
-    : name(name), owner(owner), size(size), value(value) {}
-
-bool Signal::operator==(const Signal &rhs) const {
-  if (owner != rhs.owner || name != rhs.name || size != rhs.size)
-    return false;
-  return std::memcmp(value.get(), rhs.value.get(), size);
-}
+    : name(name), owner(owner) {}
 
 bool Signal::operator<(const Signal &rhs) const {
   if (owner < rhs.owner)
@@ -77,28 +76,6 @@ bool Signal::operator<(const Signal &rhs) const {
   return false;
 }
 
-std::string Signal::dump() {
-  std::string ret;
-  raw_string_ostream ss(ret);
-  ss << "0x";
-  for (int i = size - 1; i >= 0; --i) {
-    ss << format_hex_no_prefix(static_cast<int>(value.get()[i]), 2);
-  }
-  return ss.str();
-}
-
-std::string Signal::dump(unsigned elemIndex) {
-  assert(elements.size() > 0 && "the signal type has to be tuple or array!");
-  auto elemSize = elements[elemIndex].second;
-  auto ptr = value.get() + elements[elemIndex].first;
-  std::string ret;
-  raw_string_ostream ss(ret);
-  ss << "0x";
-  for (int i = elemSize - 1; i >= 0; --i) {
-    ss << format_hex_no_prefix(static_cast<int>(ptr[i]), 2);
-  }
-  return ret;
-}
 //===----------------------------------------------------------------------===//
 // Slot
 //===----------------------------------------------------------------------===//
@@ -109,21 +86,12 @@ bool Slot::operator>(const Slot &rhs) const { return rhs.time < time; }
 
 void Slot::insertChange(int index, int bitOffset, uint8_t *bytes,
                         unsigned width) {
-  // Get the amount of 64 bit words required to store the value in an APInt.
-  auto size = llvm::divideCeil(width, 64);
-
-  if (changesSize >= buffers.size()) {
-    // Create a new change buffer if we don't have any unused one available for
-    // reuse.
-    buffers.push_back(std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size))));
-  } else {
-    // Reuse the first available buffer.
-    buffers[changesSize] = std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size)));
-  }
+  // Copy the value to fresh zeroed words, the last one might not be filled.
+  auto word = words.size();
+  words.resize(word + llvm::divideCeil(width, 64));
+  std::memcpy(words.data() + word, bytes, llvm::divideCeil(width, 8));
+  buffers.push_back({static_cast<unsigned>(bitOffset), width,
+                     static_cast<unsigned>(word)});
 
   // Map the signal index to the change buffer so we can retrieve
   // it after sorting.
@@ -136,6 +104,13 @@ void Slot::insertChange(unsigned inst) { scheduled.push_back(inst); }
 //===----------------------------------------------------------------------===//
 // UpdateQueue
 //===----------------------------------------------------------------------===//
+
+std::unique_ptr<UpdateQueue> UpdateQueue::create(QueueKind kind) {
+  if (kind == slotList)
+    return std::make_unique<SlotListQueue>();
+  return std::make_unique<TimingWheelQueue>();
+}
+
 void UpdateQueue::insertOrUpdate(Time time, int index, int bitOffset,
                                  uint8_t *bytes, unsigned width) {
   auto &slot = getOrCreateSlot(time);
@@ -147,7 +122,18 @@ void UpdateQueue::insertOrUpdate(Time time, unsigned inst) {
   slot.insertChange(inst);
 }
 
-Slot &UpdateQueue::getOrCreateSlot(Time time) {
+//===----------------------------------------------------------------------===//
+// SlotListQueue
+//===----------------------------------------------------------------------===//
+
+Slot &SlotListQueue::getOrCreateSlot(Time time) {
+  // The first slot becomes the top of the queue.
+  if (size() == 0) {
+    push_back(Slot(time));
+    ++events;
+    return back();
+  }
+
   auto &top = begin()[topSlot];
 
   // Directly add to top slot.
@@ -195,7 +181,7 @@ Slot &UpdateQueue::getOrCreateSlot(Time time) {
   return back();
 }
 
-const Slot &UpdateQueue::top() {
+const Slot &SlotListQueue::top() {
   assert(topSlot < size() && "top is pointing out of bounds!");
 
   // Sort the changes of the top slot such that all changes to the same signal
@@ -205,13 +191,15 @@ const Slot &UpdateQueue::top() {
   return top;
 }
 
-void UpdateQueue::pop() {
+void SlotListQueue::pop() {
   // Reset internal structures and decrease the event counter.
   auto &curr = begin()[topSlot];
   curr.unused = true;
   curr.changesSize = 0;
   curr.scheduled.clear();
   curr.changes.clear();
+  curr.buffers.clear();
+  curr.words.clear();
   curr.time = Time();
   --events;
 
@@ -228,53 +216,329 @@ void UpdateQueue::pop() {
       }));
 }
 
+//===----------------------------------------------------------------------===//
+// TimingWheelQueue
+//===----------------------------------------------------------------------===//
+
+/// Return the index of the first set bit of the bitmap after `start`, or -1 if
+/// there is none.
+static int findNextSet(const uint64_t *bitmap, unsigned numWords,
+                       unsigned start) {
+  unsigned bit = start + 1;
+  for (unsigned word = bit / 64; word < numWords; ++word) {
+    uint64_t bits = bitmap[word];
+    // Ignore the bits up to start in the first word.
+    if (word == bit / 64)
+      bits &= ~0ULL << (bit % 64);
+    if (bits)
+      return word * 64 + llvm::countTrailingZeros(bits);
+  }
+  return -1;
+}
+
+unsigned TimingWheelQueue::allocateSlot(Time time) {
+  ++events;
+  if (!unused.empty()) {
+    auto index = unused.pop_back_val();
+    slots[index].unused = false;
+    slots[index].time = time;
+    return index;
+  }
+  slots.push_back(Slot(time));
+  return slots.size() - 1;
+}
+
+void TimingWheelQueue::insertInWheel(unsigned slot) {
+  auto time = slots[slot].time.time;
+  assert(time > now && "slot is not in the future");
+  unsigned level = llvm::Log2_64(time ^ now) / bitsPerLevel;
+  unsigned bucket = (time >> (level * bitsPerLevel)) % bucketsPerLevel;
+  levels[level].buckets[bucket].push_back(slot);
+  levels[level].occupied[bucket / 64] |= 1ULL << (bucket % 64);
+}
+
+void TimingWheelQueue::insertInCurrent(unsigned slot) {
+  auto &time = slots[slot].time;
+  if (current.empty() || slots[current.back()].time < time) {
+    current.push_back(slot);
+    return;
+  }
+  auto it = std::upper_bound(current.begin(), current.end(), time,
+                             [&](const Time &lhs, unsigned other) {
+                               return lhs < slots[other].time;
+                             });
+  current.insert(it, slot);
+}
+
+void TimingWheelQueue::advance() {
+  assert(current.empty() && "zero-time steps are still pending");
+  assert(events > 0 && "the event queue is empty");
+
+  while (current.empty()) {
+    // Find the first non-empty bucket later than the current time, starting
+    // from the finest level. All the buckets of the finer levels are empty.
+    unsigned level = 0;
+    int bucket = -1;
+    for (; level < numLevels; ++level) {
+      unsigned start = (now >> (level * bitsPerLevel)) % bucketsPerLevel;
+      bucket = findNextSet(levels[level].occupied, bucketsPerLevel / 64, start);
+      if (bucket >= 0)
+        break;
+    }
+    assert(bucket >= 0 && "pending events are missing from the wheel");
+
+    // Move to the start of the bucket, which is not later than any of its
+    // slots, and redistribute them relative to the new time.
+    unsigned shift = level * bitsPerLevel;
+    uint64_t upperMask =
+        level + 1 < numLevels ? ~0ULL << (shift + bitsPerLevel) : 0;
+    now = (now & upperMask) | (uint64_t(bucket) << shift);
+
+    Bucket slotsAtBucket;
+    std::swap(slotsAtBucket, levels[level].buckets[bucket]);
+    levels[level].occupied[bucket / 64] &= ~(1ULL << (bucket % 64));
+    for (auto slot : slotsAtBucket) {
+      if (slots[slot].time.time == now)
+        insertInCurrent(slot);
+      else
+        insertInWheel(slot);
+    }
+  }
+}
+
+Slot &TimingWheelQueue::getOrCreateSlot(Time time) {
+  assert(time.time >= now && "cannot schedule an event in the past");
+
+  if (time.time == now) {
+    // Most zero-time steps are scheduled at the end of the current real time.
+    if (!current.empty() && slots[current.back()].time == time)
+      return slots[current.back()];
+    for (auto slot : current)
+      if (slots[slot].time == time)
+        return slots[slot];
+    auto slot = allocateSlot(time);
+    insertInCurrent(slot);
+    return slots[slot];
+  }
+
+  // Look for an existing slot in the bucket the time belongs to.
+  unsigned level = llvm::Log2_64(time.time ^ now) / bitsPerLevel;
+  unsigned bucket = (time.time >> (level * bitsPerLevel)) % bucketsPerLevel;
+  for (auto slot : levels[level].buckets[bucket])
+    if (slots[slot].time == time)
+      return slots[slot];
+
+  auto slot = allocateSlot(time);
+  insertInWheel(slot);
+  return slots[slot];
+}
+
+const Slot &TimingWheelQueue::top() {
+  if (current.empty())
+    advance();
+
+  // Sort the changes of the top slot such that all changes to the same signal
+  // are in succession.
+  auto &top = slots[current.front()];
+  llvm::sort(top.changes.begin(), top.changes.begin() + top.changesSize);
+  return top;
+}
+
+void TimingWheelQueue::pop() {
+  assert(!current.empty() && "top must be called before pop");
+
+  // Reset internal structures and decrease the event counter.
+  auto index = current.front();
+  current.pop_front();
+  auto &curr = slots[index];
+  curr.unused = true;
+  curr.changesSize = 0;
+  curr.scheduled.clear();
+  curr.changes.clear();
+  curr.buffers.clear();
+  curr.words.clear();
+  curr.time = Time();
+  --events;
+
+  // Add to unused slots list for easy retrieval. The current real time is only
+  // advanced by the next call to top, as events can still be scheduled
+  // relative to the popped slot's time.
+  unused.push_back(index);
+}
+
+//===----------------------------------------------------------------------===//
+// UpdateStaging
+//===----------------------------------------------------------------------===//
+
+void UpdateStaging::insertOrUpdate(Time time, int index, int bitOffset,
+                                   uint8_t *bytes, unsigned width) {
+  auto word = words.size();
+  words.resize(word + llvm::divideCeil(width, 64));
+  std::memcpy(words.data() + word, bytes, llvm::divideCeil(width, 8));
+  events.push_back({time, static_cast<unsigned>(index), bitOffset, width,
+                    static_cast<unsigned>(word)});
+}
+
+void UpdateStaging::insertOrUpdate(Time time, unsigned inst) {
+  events.push_back({time, inst, 0, 0, 0});
+}
+
+void UpdateStaging::flush(UpdateQueue &queue) {
+  for (auto &event : events) {
+    if (event.width == 0) {
+      queue.insertOrUpdate(event.time, event.index);
+      continue;
+    }
+    queue.insertOrUpdate(event.time, event.index, event.bitOffset,
+                         reinterpret_cast<uint8_t *>(&words[event.word]),
+                         event.width);
+  }
+  events.clear();
+  words.clear();
+}
+
+void UpdateStaging::drain(
+    function_ref<void(unsigned, int, const uint8_t *, unsigned)> fn) {
+  for (auto &event : events) {
+    assert(event.width != 0 && "unexpected wakeup");
+    fn(event.index, event.bitOffset,
+       reinterpret_cast<const uint8_t *>(&words[event.word]), event.width);
+  }
+  events.clear();
+  words.clear();
+}
+
 //===----------------------------------------------------------------------===//
 // State
 //===----------------------------------------------------------------------===//
 
 State::~State() {
+  auto isInArena = [&](const void *ptr) {
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    auto arenaBegin = reinterpret_cast<uintptr_t>(arena);
+    return arena && address >= arenaBegin && address < arenaBegin + arenaSize;
+  };
+
+  // The states carved out of the arena are freed along with it.
   for (auto &inst : instances) {
+    if (isInArena(inst.entityState.get()))
+      inst.entityState.release();
     if (inst.procState) {
-      std::free(inst.procState->senses);
+      if (!isInArena(inst.procState->senses))
+        std::free(inst.procState->senses);
+      if (isInArena(inst.procState.get()))
+        inst.procState.release();
     }
   }
+
+  if (arena) {
+    llvm::deallocate_buffer(arena, arenaSize, signalArenaAlignment);
+    return;
+  }
+  for (auto *value : signalValues)
+    std::free(value);
+}
+
+void State::packSignalValues() {
+  if (arena)
+    return;
+
+  // The lowered code allocates twice the size of each signal, such that shifts
+  // reading past the signal's value do not segfault. Keep that margin, and
+  // align every value such that it can be accessed by whole words.
+  SmallVector<size_t, 0> offsets;
+  offsets.reserve(signalValues.size());
+  for (auto size : signalSizes) {
+    offsets.push_back(arenaSize);
+    arenaSize += 2 * llvm::alignTo(size, 16);
+  }
+  if (arenaSize == 0)
+    return;
+
+  arena = static_cast<uint8_t *>(
+      llvm::allocate_buffer(arenaSize, signalArenaAlignment));
+  std::memset(arena, 0, arenaSize);
+  for (size_t i = 0, e = signalValues.size(); i < e; ++i) {
+    if (!signalValues[i])
+      continue;
+    std::memcpy(arena + offsets[i], signalValues[i], signalSizes[i]);
+    std::free(signalValues[i]);
+    signalValues[i] = arena + offsets[i];
+  }
+
+  // The signal details point to the start of the value, the bit offset within
+  // it is stored separately.
+  for (auto &inst : instances)
+    for (auto &detail : inst.sensitivityList)
+      detail.value = signalValues[detail.globalIndex];
+}
+
+uint8_t *State::allocateArena(size_t size) {
+  assert(!arena && "the arena is already allocated");
+  arenaSize = size;
+  arena = static_cast<uint8_t *>(
+      llvm::allocate_buffer(arenaSize, signalArenaAlignment));
+  std::memset(arena, 0, arenaSize);
+  return arena;
 }
 
 Slot State::popQueue() {
-  assert(!queue.empty() && "the event queue is empty");
-  Slot pop = queue.top();
-  queue.pop();
+  assert(!queue->empty() && "the event queue is empty");
+  Slot pop = queue->top();
+  queue->pop();
   return pop;
 }
 
-void State::pushQueue(Time t, unsigned inst) {
+void State::pushQueue(Time t, unsigned inst, UpdateStaging *staging) {
   Time newTime = time + t;
-  queue.insertOrUpdate(newTime, inst);
+  if (staging)
+    staging->insertOrUpdate(newTime, inst);
+  else
+    queue->insertOrUpdate(newTime, inst);
   instances[inst].expectedWakeup = newTime;
 }
 
 llvm::SmallVectorTemplateCommon<Instance>::iterator
-State::getInstanceIterator(std::string instName) {
-  auto it =
-      std::find_if(instances.begin(), instances.end(),
-                   [&](const auto &inst) { return instName == inst.name; });
+State::getInstanceIterator(StringRef instName) {
+  auto it = instanceIndex.find(instName);
+  assert(it != instanceIndex.end() && "instance does not exist!");
+  return instances.begin() + it->second;
+}
 
-  assert(it != instances.end() && "instance does not exist!");
+void State::buildIndex() {
+  instanceIndex.clear();
+  signalIndex.clear();
+  // Names shared by several instances resolve to the first one.
+  for (size_t i = 0, e = instances.size(); i < e; ++i)
+    instanceIndex.try_emplace(instances[i].name, i);
+  for (size_t i = 0, e = signals.size(); i < e; ++i)
+    for (auto inst : getTriggers(i))
+      signalIndex.try_emplace(instances[inst].path + "/" + signals[i].name, i);
+}
 
-  return it;
+Optional<unsigned> State::lookupSignal(StringRef path) const {
+  auto it = signalIndex.find(path);
+  if (it == signalIndex.end())
+    return llvm::None;
+  return it->second;
 }
 
 int State::addSignal(std::string name, std::string owner) {
   signals.push_back(Signal(name, owner));
+  signalValues.push_back(nullptr);
+  signalSizes.push_back(0);
   return signals.size() - 1;
 }
 
-void State::addProcPtr(std::string name, ProcState *procStatePtr) {
+void State::addProcPtr(std::string name, ProcState *procStatePtr,
+                       uint64_t size, ArrayRef<StateRelocation> relocations) {
   auto it = getInstanceIterator(name);
 
   // Store instance index in process state.
   procStatePtr->inst = it - instances.begin();
   (*it).procState = std::unique_ptr<ProcState>(procStatePtr);
+  (*it).procStateSize = size;
+  (*it).relocations = relocations;
 }
 
 int State::addSignalData(int index, std::string owner, uint8_t *value,
@@ -282,18 +546,17 @@ int State::addSignalData(int index, std::string owner, uint8_t *value,
   auto it = getInstanceIterator(owner);
 
   uint64_t globalIdx = (*it).sensitivityList[index + (*it).nArgs].globalIndex;
-  auto &sig = signals[globalIdx];
 
   // Add pointer and size to global signal table entry.
-  sig.value = std::unique_ptr<uint8_t>(value);
-  sig.size = size;
+  signalValues[globalIdx] = value;
+  signalSizes[globalIdx] = size;
 
   // Add the value pointer to the signal detail struct for each instance this
   // signal appears in.
-  for (auto inst : signals[globalIdx].triggers) {
+  for (auto inst : getTriggers(globalIdx)) {
     for (auto &detail : instances[inst].sensitivityList) {
       if (detail.globalIndex == globalIdx) {
-        detail.value = sig.value.get();
+        detail.value = value;
       }
     }
   }
@@ -304,14 +567,94 @@ void State::addSignalElement(unsigned index, unsigned offset, unsigned size) {
   signals[index].elements.push_back(std::make_pair(offset, size));
 }
 
+void State::copyLayout(const State &other) {
+  assert(instances.empty() && signals.empty() && "the state has a layout");
+  root = other.root;
+  for (auto &inst : other.instances) {
+    Instance copy(inst.name);
+    copy.path = inst.path;
+    copy.unit = inst.unit;
+    copy.isEntity = inst.isEntity;
+    copy.nArgs = inst.nArgs;
+    copy.combinational = inst.combinational;
+    copy.drivenSignals = inst.drivenSignals;
+    copy.sensitivityList = inst.sensitivityList;
+    for (auto &detail : copy.sensitivityList)
+      detail.value = nullptr;
+    instances.push_back(std::move(copy));
+  }
+  for (auto &sig : other.signals)
+    addSignal(sig.name, sig.owner);
+  triggerBegin = other.triggerBegin;
+  triggerInsts = other.triggerInsts;
+  triggerSenses = other.triggerSenses;
+  combinationalOrder = other.combinationalOrder;
+  tracedSignals = other.tracedSignals;
+  buildIndex();
+}
+
+Error State::setSignalValue(StringRef path, StringRef value) {
+  // A signal can be named by its path in any of the instances it appears in.
+  auto index = lookupSignal(path);
+  if (!index)
+    return make_error<StringError>("unknown signal " + path,
+                                   inconvertibleErrorCode());
+
+  auto i = *index;
+  APInt bits;
+  unsigned width = signalSizes[i] * 8;
+  if (value.getAsInteger(0, bits) || bits.getActiveBits() > width)
+    return make_error<StringError>("invalid value '" + value +
+                                       "' for signal " + path,
+                                   inconvertibleErrorCode());
+  bits = bits.zextOrTrunc(width);
+  for (unsigned byte = 0; byte < signalSizes[i]; ++byte)
+    signalValues[i][byte] = bits.extractBitsAsZExtValue(8, byte * 8);
+  return Error::success();
+}
+
+std::string State::dumpSignalValue(unsigned index, const uint8_t *value) {
+  std::string ret;
+  raw_string_ostream ss(ret);
+  ss << "0x";
+  for (int i = signalSizes[index] - 1; i >= 0; --i) {
+    ss << format_hex_no_prefix(static_cast<int>(value[i]), 2);
+  }
+  return ss.str();
+}
+
+std::string State::dumpSignalValue(unsigned index, unsigned elemIndex,
+                                   const uint8_t *value) {
+  auto &elements = signals[index].elements;
+  assert(elements.size() > 0 && "the signal type has to be tuple or array!");
+  auto elemSize = elements[elemIndex].second;
+  auto ptr = value + elements[elemIndex].first;
+  std::string ret;
+  raw_string_ostream ss(ret);
+  ss << "0x";
+  for (int i = elemSize - 1; i >= 0; --i) {
+    ss << format_hex_no_prefix(static_cast<int>(ptr[i]), 2);
+  }
+  return ret;
+}
+
 void State::dumpSignal(llvm::raw_ostream &out, int index) {
   auto &sig = signals[index];
-  for (auto inst : sig.triggers) {
+  for (auto inst : getTriggers(index)) {
     out << time.dump() << "  " << instances[inst].path << "/" << sig.name
-        << "  " << sig.dump() << "\n";
+        << "  " << dumpSignalValue(index, signalValues[index]) << "\n";
   }
 }
 
+Error State::dumpSignal(llvm::raw_ostream &out, StringRef path) {
+  auto index = lookupSignal(path);
+  if (!index)
+    return make_error<StringError>("unknown signal " + path,
+                                   inconvertibleErrorCode());
+  dumpSignal(out, *index);
+  return Error::success();
+}
+
 void State::dumpLayout() {
   llvm::errs() << "::------------------- Layout -------------------::\n";
   for (const auto &inst : instances) {
@@ -331,10 +674,329 @@ void State::dumpSignalTriggers() {
   llvm::errs() << "::------------- Signal information -------------::\n";
   for (size_t i = 0, e = signals.size(); i < e; ++i) {
     llvm::errs() << signals[i].owner << "/" << signals[i].name << " triggers: ";
-    for (auto trig : signals[i].triggers) {
+    for (auto trig : getTriggers(i)) {
       llvm::errs() << trig << " ";
     }
     llvm::errs() << "\n";
   }
   llvm::errs() << "::----------------------------------------------::\n";
 }
+
+//===----------------------------------------------------------------------===//
+// Checkpoints
+//===----------------------------------------------------------------------===//
+
+/// The first bytes of a checkpoint, followed by the format version.
+static constexpr char checkpointMagic[8] = {'L', 'L', 'H', 'D',
+                                            'C', 'K', 'P', 'T'};
+static constexpr uint32_t checkpointVersion = 2;
+
+/// The persisted values of a process follow the fixed fields of its state.
+static constexpr size_t persistenceOffset = offsetof(ProcState, resumeState);
+
+/// What a relocated field of an instance state points to in a checkpoint.
+enum RelocationTarget : uint8_t {
+  /// Nothing the checkpoint can restore, e.g. a field not written yet.
+  unsetTarget = 0,
+  /// The values of the signal of a signal detail, at an offset.
+  signalValueTarget = 1,
+  /// An entry of the signal table of the instance.
+  signalTableTarget = 2,
+  /// A signal detail in the state of the instance, at an offset.
+  stateTarget = 3,
+};
+
+static void writeTime(support::endian::Writer &writer, const Time &time) {
+  writer.write<uint64_t>(time.time);
+  writer.write<uint64_t>(time.delta);
+  writer.write<uint64_t>(time.eps);
+}
+
+/// Write the bytes of the `size` bytes `state` of `inst` from `begin` on,
+/// followed by the relocation table of its unit and what each relocated field
+/// points to. The pointers themselves are meaningless in another run.
+static void writeInstanceState(support::endian::Writer &writer,
+                               raw_ostream &os, const State &s,
+                               const Instance &inst, const uint8_t *state,
+                               uint64_t begin, uint64_t size) {
+  writer.write<uint64_t>(size - begin);
+  os.write(reinterpret_cast<const char *>(state + begin), size - begin);
+
+  auto stateBegin = reinterpret_cast<uintptr_t>(state);
+  auto tableBegin = reinterpret_cast<uintptr_t>(inst.sensitivityList.data());
+  writer.write<uint64_t>(inst.relocations.size());
+  for (auto &relocation : inst.relocations) {
+    writer.write<uint64_t>(relocation.offset);
+    writer.write<uint64_t>(relocation.kind);
+    const uint8_t *field = state + relocation.offset;
+
+    // The value of a signal detail is stored as an offset into the values of
+    // its signal.
+    if (relocation.kind == StateRelocation::signalDetail) {
+      assert(relocation.offset >= begin &&
+             relocation.offset + sizeof(SignalDetail) <= size &&
+             "relocation out of bounds");
+      SignalDetail detail;
+      std::memcpy(&detail, field, sizeof(detail));
+      auto index = detail.globalIndex;
+      if (index < s.signalValues.size() &&
+          detail.value >= s.signalValues[index] &&
+          detail.value < s.signalValues[index] + s.signalSizes[index]) {
+        writer.write<uint8_t>(signalValueTarget);
+        writer.write<uint64_t>(detail.value - s.signalValues[index]);
+      } else {
+        writer.write<uint8_t>(unsetTarget);
+      }
+      continue;
+    }
+
+    // A pointer to a signal detail is stored as an index into the signal
+    // table, or as an offset into the state.
+    assert(relocation.offset >= begin &&
+           relocation.offset + sizeof(SignalDetail *) <= size &&
+           "relocation out of bounds");
+    uintptr_t target;
+    std::memcpy(&target, field, sizeof(target));
+    auto tableSize = inst.sensitivityList.size() * sizeof(SignalDetail);
+    if (target >= tableBegin && target < tableBegin + tableSize &&
+        (target - tableBegin) % sizeof(SignalDetail) == 0) {
+      writer.write<uint8_t>(signalTableTarget);
+      writer.write<uint64_t>((target - tableBegin) / sizeof(SignalDetail));
+    } else if (target >= stateBegin + begin &&
+               target + sizeof(SignalDetail) <= stateBegin + size) {
+      writer.write<uint8_t>(stateTarget);
+      writer.write<uint64_t>(target - stateBegin);
+    } else {
+      writer.write<uint8_t>(unsetTarget);
+    }
+  }
+}
+
+void State::writeCheckpoint(raw_ostream &os) {
+  support::endian::Writer writer(os, support::little);
+  os.write(checkpointMagic, sizeof(checkpointMagic));
+  writer.write<uint32_t>(checkpointVersion);
+  writeTime(writer, time);
+
+  writer.write<uint64_t>(signalValues.size());
+  for (size_t i = 0, e = signalValues.size(); i < e; ++i) {
+    writer.write<uint64_t>(signalSizes[i]);
+    os.write(reinterpret_cast<const char *>(signalValues[i]), signalSizes[i]);
+  }
+
+  writer.write<uint64_t>(instances.size());
+  for (auto &inst : instances) {
+    writeTime(writer, inst.expectedWakeup);
+    if (inst.isEntity) {
+      writeInstanceState(writer, os, *this, inst, inst.entityState.get(), 0,
+                         inst.entityStateSize);
+      continue;
+    }
+
+    auto *procState = inst.procState.get();
+    writer.write<int32_t>(procState->resume);
+    os.write(reinterpret_cast<const char *>(procState->senses), inst.nArgs);
+    writeInstanceState(writer, os, *this, inst,
+                       reinterpret_cast<const uint8_t *>(procState),
+                       persistenceOffset, inst.procStateSize);
+  }
+
+  // The pending events are written in the order they are popped, each slot
+  // being preceded by a non-zero byte.
+  while (!queue->empty()) {
+    const auto &slot = queue->top();
+    writer.write<uint8_t>(1);
+    writeTime(writer, slot.time);
+    writer.write<uint64_t>(slot.changesSize);
+    for (size_t i = 0; i < slot.changesSize; ++i) {
+      const auto &drive = slot.buffers[slot.changes[i].second];
+      writer.write<uint32_t>(slot.changes[i].first);
+      writer.write<int32_t>(drive.bitOffset);
+      writer.write<uint32_t>(drive.width);
+      os.write(reinterpret_cast<const char *>(&slot.words[drive.word]),
+               llvm::divideCeil(drive.width, 8));
+    }
+    writer.write<uint64_t>(slot.scheduled.size());
+    for (auto inst : slot.scheduled)
+      writer.write<uint32_t>(inst);
+    queue->pop();
+  }
+  writer.write<uint8_t>(0);
+}
+
+namespace {
+/// Read the fields of a checkpoint. Reading past the end of the data yields
+/// zeros and marks the reader as failed.
+struct CheckpointReader {
+  CheckpointReader(StringRef data) : data(data) {}
+
+  template <typename T>
+  T read() {
+    if (data.size() < sizeof(T)) {
+      failed = true;
+      data = {};
+      return T();
+    }
+    auto value = support::endian::read<T, support::little, support::unaligned>(
+        data.data());
+    data = data.drop_front(sizeof(T));
+    return value;
+  }
+
+  StringRef readBytes(size_t size) {
+    if (data.size() < size) {
+      failed = true;
+      data = {};
+      return {};
+    }
+    auto bytes = data.take_front(size);
+    data = data.drop_front(size);
+    return bytes;
+  }
+
+  Time readTime() {
+    auto time = read<uint64_t>();
+    auto delta = read<uint64_t>();
+    auto eps = read<uint64_t>();
+    return Time(time, delta, eps);
+  }
+
+  StringRef data;
+  bool failed = false;
+};
+} // namespace
+
+static Error checkpointError(const Twine &message) {
+  return make_error<StringError>("invalid checkpoint: " + message,
+                                 inconvertibleErrorCode());
+}
+
+/// Restore the state written by writeInstanceState, checking that the state
+/// of `inst` has the same size and relocation table.
+static Error restoreInstanceState(CheckpointReader &reader, const State &s,
+                                  Instance &inst, uint8_t *state,
+                                  uint64_t begin, uint64_t size) {
+  if (reader.read<uint64_t>() != size - begin)
+    return checkpointError("the state of " + inst.name + " differs");
+  auto bytes = reader.readBytes(size - begin);
+  std::memcpy(state + begin, bytes.data(), bytes.size());
+
+  if (reader.read<uint64_t>() != inst.relocations.size())
+    return checkpointError("the state layout of " + inst.name + " differs");
+  for (auto &relocation : inst.relocations) {
+    auto offset = reader.read<uint64_t>();
+    auto kind = reader.read<uint64_t>();
+    if (offset != relocation.offset || kind != relocation.kind)
+      return checkpointError("the state layout of " + inst.name + " differs");
+    auto target = reader.read<uint8_t>();
+    uint8_t *field = state + offset;
+
+    if (kind == StateRelocation::signalDetail) {
+      SignalDetail detail;
+      std::memcpy(&detail, field, sizeof(detail));
+      detail.value = nullptr;
+      if (target == signalValueTarget) {
+        auto valueOffset = reader.read<uint64_t>();
+        auto index = detail.globalIndex;
+        if (index >= s.signalValues.size() ||
+            valueOffset >= s.signalSizes[index])
+          return checkpointError("invalid signal in the state of " +
+                                 inst.name);
+        detail.value = s.signalValues[index] + valueOffset;
+      } else if (target != unsetTarget) {
+        return checkpointError("invalid relocation in the state of " +
+                               inst.name);
+      }
+      std::memcpy(field, &detail, sizeof(detail));
+      continue;
+    }
+
+    SignalDetail *pointer = nullptr;
+    if (target == signalTableTarget) {
+      auto index = reader.read<uint64_t>();
+      if (index >= inst.sensitivityList.size())
+        return checkpointError("invalid signal in the state of " + inst.name);
+      pointer = &inst.sensitivityList[index];
+    } else if (target == stateTarget) {
+      auto targetOffset = reader.read<uint64_t>();
+      if (targetOffset < begin || size < sizeof(SignalDetail) ||
+          targetOffset > size - sizeof(SignalDetail))
+        return checkpointError("invalid relocation in the state of " +
+                               inst.name);
+      pointer = reinterpret_cast<SignalDetail *>(state + targetOffset);
+    } else if (target != unsetTarget) {
+      return checkpointError("invalid relocation in the state of " +
+                             inst.name);
+    }
+    std::memcpy(field, &pointer, sizeof(pointer));
+  }
+  return Error::success();
+}
+
+Error State::restoreCheckpoint(StringRef data) {
+  assert(queue->empty() && "the state has already been simulated");
+  CheckpointReader reader(data);
+  if (reader.readBytes(sizeof(checkpointMagic)) !=
+      StringRef(checkpointMagic, sizeof(checkpointMagic)))
+    return checkpointError("not an LLHD checkpoint");
+  if (reader.read<uint32_t>() != checkpointVersion)
+    return checkpointError("unsupported version");
+  time = reader.readTime();
+
+  if (reader.read<uint64_t>() != signalValues.size())
+    return checkpointError("the number of signals differs");
+  for (size_t i = 0, e = signalValues.size(); i < e; ++i) {
+    if (reader.read<uint64_t>() != signalSizes[i])
+      return checkpointError("the size of signal " + signals[i].owner + "/" +
+                             signals[i].name + " differs");
+    auto value = reader.readBytes(signalSizes[i]);
+    std::memcpy(signalValues[i], value.data(), value.size());
+  }
+
+  if (reader.read<uint64_t>() != instances.size())
+    return checkpointError("the number of instances differs");
+  for (auto &inst : instances) {
+    inst.expectedWakeup = reader.readTime();
+    if (inst.isEntity) {
+      if (auto err = restoreInstanceState(reader, *this, inst,
+                                          inst.entityState.get(), 0,
+                                          inst.entityStateSize))
+        return err;
+      continue;
+    }
+
+    auto *procState = inst.procState.get();
+    procState->resume = reader.read<int32_t>();
+    auto senses = reader.readBytes(inst.nArgs);
+    std::memcpy(procState->senses, senses.data(), senses.size());
+    if (auto err = restoreInstanceState(
+            reader, *this, inst, reinterpret_cast<uint8_t *>(procState),
+            persistenceOffset, inst.procStateSize))
+      return err;
+  }
+
+  SmallVector<uint8_t, 64> value;
+  while (reader.read<uint8_t>() != 0) {
+    auto slotTime = reader.readTime();
+    for (auto i = reader.read<uint64_t>(); i > 0 && !reader.failed; --i) {
+      auto index = reader.read<uint32_t>();
+      auto bitOffset = reader.read<int32_t>();
+      auto width = reader.read<uint32_t>();
+      auto bytes = reader.readBytes(llvm::divideCeil(width, 8));
+      if (index >= signalValues.size())
+        return checkpointError("change to an unknown signal");
+      value.assign(bytes.begin(), bytes.end());
+      queue->insertOrUpdate(slotTime, index, bitOffset, value.data(), width);
+    }
+    for (auto i = reader.read<uint64_t>(); i > 0 && !reader.failed; --i) {
+      auto inst = reader.read<uint32_t>();
+      if (inst >= instances.size())
+        return checkpointError("wakeup of an unknown instance");
+      queue->insertOrUpdate(slotTime, inst);
+    }
+  }
+
+  if (reader.failed)
+    return checkpointError("truncated data");
+  return Error::success();
+}
@@ -15,9 +15,15 @@
 #define CIRCT_DIALECT_LLHD_SIMULATOR_STATE_H
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
 
+#include <deque>
 #include <map>
 #include <queue>
 
@@ -64,41 +70,100 @@ struct SignalDetail {
   uint64_t globalIndex;
 };
 
-/// The simulator's internal representation of a signal.
+/// A drive written by the inline fast path of the lowered units, for signals
+/// of at most 64 bits. The layout is shared with the lowered code.
+struct DriveRecord {
+  SignalDetail *detail;
+  uint64_t value;
+  uint64_t width;
+  uint64_t time;
+  uint64_t delta;
+  uint64_t eps;
+};
+
+/// The drives written by the inline fast path of the units run by a thread,
+/// applied once the unit returns. The lowered code appends to `records` while
+/// `size` is below `capacity`, and calls driveSignal otherwise.
+struct DriveBuffer {
+  uint64_t size;
+  uint64_t capacity;
+  DriveRecord *records;
+};
+
+/// A signal of the layout tables emitted by the static-layout lowering. The
+/// layout is shared with the lowered code.
+struct LayoutSignal {
+  /// The name of the owning instance.
+  char *owner;
+  /// The index of the signal in the signal table of its entity.
+  uint32_t index;
+  /// The constant initial value.
+  uint8_t *init;
+  /// The size passed to allocSignal, and the allocation size of the value.
+  uint64_t size;
+  uint64_t allocSize;
+  /// The elements of an array signal.
+  uint32_t numArrayElements;
+  uint32_t arrayElementSize;
+  /// The range of the elements of a struct signal in the element table.
+  uint32_t firstStructElement;
+  uint32_t numStructElements;
+};
+
+/// An element of a struct signal of the layout tables.
+struct LayoutElement {
+  uint32_t offset;
+  uint32_t size;
+};
+
+/// A field of the state of an instance holding a pointer, which checkpoints
+/// relocate. The lowered code emits a table of them for each unit, whose
+/// layout is shared with the runtime.
+struct StateRelocation {
+  enum Kind : uint64_t {
+    /// A copy of a signal detail, whose value points to the signal values.
+    signalDetail = 0,
+    /// A pointer to a signal detail of the instance's signal table, or to a
+    /// copy in the state itself.
+    signalDetailPtr = 1,
+  };
+
+  /// The offset of the field in the state.
+  uint64_t offset;
+  uint64_t kind;
+};
+
+/// An instance of the layout tables. The state of entities is zeroed, the
+/// state of processes starts with all senses set.
+struct LayoutInstance {
+  char *owner;
+  uint32_t isEntity;
+  uint32_t numSenses;
+  uint64_t stateSize;
+  StateRelocation *relocations;
+  uint64_t numRelocations;
+};
+
+/// The simulator's internal representation of a signal. This only holds the
+/// metadata of the signal, its value and the instances it triggers are stored
+/// in the state's signal arrays, which are accessed on every change.
 struct Signal {
-  /// Construct an "empty" signal.
+  /// Construct a signal with the given name and owner.
   Signal(std::string name, std::string owner);
 
-  /// Construct a signal with the given name, owner and initial value.
-  Signal(std::string name, std::string owner, uint8_t *value, uint64_t size);
-
   /// Default move constructor.
   Signal(Signal &&) = default;
 
   /// Default signal destructor.
   ~Signal() = default;
 
-  /// Returns true if the signals match in name, owner, size and value.
-  bool operator==(const Signal &rhs) const;
-
   /// Returns true if the owner name is lexically smaller than rhs's owner, or
   /// the name is lexically smaller than rhs's name, in case they share the same
   /// owner.
   bool operator<(const Signal &rhs) const;
 
-  /// Return the value of the signal in hexadecimal string format.
-  std::string dump();
-
-  /// Return the value of the i-th element of the signal in hexadecimal string
-  /// format.
-  std::string dump(unsigned);
-
   std::string name;
   std::string owner;
-  // The list of instances this signal triggers.
-  std::vector<unsigned> triggers;
-  uint64_t size;
-  std::unique_ptr<uint8_t> value;
   std::vector<std::pair<unsigned, unsigned>> elements;
 };
 
@@ -119,11 +184,23 @@ struct Slot {
   /// Insert a scheduled process wakeup.
   void insertChange(unsigned inst);
 
+  /// A value driven on a signal. The value is stored in little-endian order in
+  /// the slot's words, such that no allocation is needed once a reused slot
+  /// has grown large enough.
+  struct Drive {
+    unsigned bitOffset;
+    unsigned width;
+    // The index of the first word of the value.
+    unsigned word;
+  };
+
   // A map from signal indexes to change buffers. Makes it easy to sort the
   // changes such that we can process one signal at a time.
   llvm::SmallVector<std::pair<unsigned, unsigned>, 32> changes;
   // Buffers for the signal changes.
-  llvm::SmallVector<std::pair<unsigned, llvm::APInt>, 32> buffers;
+  llvm::SmallVector<Drive, 32> buffers;
+  // The values driven by the changes.
+  llvm::SmallVector<uint64_t, 32> words;
   // The number of used change buffers in the slot.
   size_t changesSize = 0;
 
@@ -133,13 +210,19 @@ struct Slot {
   bool unused = false;
 };
 
-/// This is equivalent to and std::priorityQueue<Slot> ordered using the greater
-/// operator, which adds an insertion method to add changes to a slot.
-class UpdateQueue : public llvm::SmallVector<Slot, 8> {
-  unsigned topSlot = 0;
-  llvm::SmallVector<unsigned, 4> unused;
+/// The event queue implementations available to the simulator.
+enum QueueKind { slotList, timingWheel };
 
+/// The interface of the event queue. This is equivalent to an
+/// std::priorityQueue<Slot> ordered using the greater operator, which adds an
+/// insertion method to add changes to a slot.
+class UpdateQueue {
 public:
+  virtual ~UpdateQueue() = default;
+
+  /// Create an empty queue of the given kind.
+  static std::unique_ptr<UpdateQueue> create(QueueKind kind);
+
   /// Check wheter a slot for the given time already exists. If that's the case,
   /// add the new change to it, else create a new slot and push it to the queue.
   void insertOrUpdate(Time time, int index, int bitOffset, uint8_t *bytes,
@@ -153,19 +236,126 @@ public:
   /// Return a reference to a slot with the given timestamp. If such a slot
   /// already exists, a reference to it will be returned. Otherwise a reference
   /// to a fresh slot is returned.
-  Slot &getOrCreateSlot(Time time);
+  virtual Slot &getOrCreateSlot(Time time) = 0;
 
   /// Get a reference to the current top of the queue (the earliest event
   /// available).
-  const Slot &top();
+  virtual const Slot &top() = 0;
 
   /// Pop the current top of the queue. This marks the current top slot as
   /// unused and resets its internal structures such that they can be reused.
-  void pop();
+  virtual void pop() = 0;
+
+  /// Return true if there are no pending events.
+  bool empty() const { return events == 0; }
 
   unsigned events = 0;
 };
 
+/// An event queue keeping all the slots in a list. Finding the slot of a given
+/// time and the top of the queue are linear in the number of slots.
+class SlotListQueue : public UpdateQueue, llvm::SmallVector<Slot, 8> {
+  unsigned topSlot = 0;
+  llvm::SmallVector<unsigned, 4> unused;
+
+public:
+  Slot &getOrCreateSlot(Time time) override;
+  const Slot &top() override;
+  void pop() override;
+};
+
+/// An event queue made of a hierarchical timing wheel for the real-time steps,
+/// and a queue of the delta and epsilon steps of the current real time.
+///
+/// Level `l` of the wheel has one bucket per value of the `l`-th byte of the
+/// real time. A slot is put in the level of the most significant byte in which
+/// its real time differs from the current one, such that all the slots of a
+/// level-0 bucket share the same real time. When no slot is left at the current
+/// real time, the first non-empty bucket is found with the occupancy bitmaps,
+/// and its slots are redistributed to the lower levels.
+///
+/// Zero-time steps are scheduled in increasing order most of the time, so the
+/// slots of the current real time are appended to the back of their queue in
+/// the common case.
+class TimingWheelQueue : public UpdateQueue {
+public:
+  Slot &getOrCreateSlot(Time time) override;
+  const Slot &top() override;
+  void pop() override;
+
+private:
+  static constexpr unsigned bitsPerLevel = 8;
+  static constexpr unsigned bucketsPerLevel = 1 << bitsPerLevel;
+  static constexpr unsigned numLevels = 64 / bitsPerLevel;
+
+  using Bucket = llvm::SmallVector<unsigned, 2>;
+
+  struct Level {
+    Bucket buckets[bucketsPerLevel];
+    uint64_t occupied[bucketsPerLevel / 64] = {};
+  };
+
+  /// Return a free slot for the given time.
+  unsigned allocateSlot(Time time);
+
+  /// Add a slot with a real time later than the current one to the wheel.
+  void insertInWheel(unsigned slot);
+
+  /// Add a slot of the current real time to the queue of zero-time steps.
+  void insertInCurrent(unsigned slot);
+
+  /// Move the current real time to the earliest slot in the wheel, and move
+  /// the slots scheduled at that time to the queue of zero-time steps.
+  void advance();
+
+  // All the slots, used or not. A deque keeps references to the slots stable.
+  std::deque<Slot> slots;
+  // The slots available for reuse.
+  llvm::SmallVector<unsigned, 4> unused;
+  // The slots of the current real time, ordered by delta and epsilon steps.
+  std::deque<unsigned> current;
+  Level levels[numLevels];
+  // The current real time.
+  uint64_t now = 0;
+};
+
+/// The drives and wakeups scheduled by the instances run by one thread during
+/// a parallel simulation step. They are inserted in the event queue once all
+/// the instances of the step have run, such that the queue is only accessed
+/// by one thread.
+struct UpdateStaging {
+  /// Record a change, copying the driven value.
+  void insertOrUpdate(Time time, int index, int bitOffset, uint8_t *bytes,
+                      unsigned width);
+
+  /// Record a scheduled process wakeup.
+  void insertOrUpdate(Time time, unsigned inst);
+
+  /// Insert all the recorded events in the queue, in the order they were
+  /// recorded, and clear the staging buffers.
+  void flush(UpdateQueue &queue);
+
+  /// Call `fn` with the signal index, bit offset, value bytes and width of the
+  /// recorded changes, in the order they were recorded, and clear the staging
+  /// buffers. There must be no recorded wakeups.
+  void drain(llvm::function_ref<void(unsigned, int, const uint8_t *, unsigned)>
+                 fn);
+
+private:
+  struct Event {
+    Time time;
+    // The signal index of a change, or the instance index of a wakeup.
+    unsigned index;
+    int bitOffset;
+    // The width of the driven value, 0 for wakeups.
+    unsigned width;
+    unsigned word;
+  };
+
+  llvm::SmallVector<Event, 32> events;
+  llvm::SmallVector<uint64_t, 32> words;
+};
+
 /// State structure for process persistence across suspension.
 struct ProcState {
   unsigned inst;
@@ -174,6 +364,8 @@ struct ProcState {
   uint8_t *resumeState;
 };
 
+struct State;
+
 /// The simulator internal representation of an instance.
 struct Instance {
   Instance() = default;
@@ -193,31 +385,79 @@ struct Instance {
   llvm::SmallVector<SignalDetail, 0> sensitivityList;
   std::unique_ptr<ProcState> procState;
   std::unique_ptr<uint8_t> entityState;
+  // Whether this is an entity without registers, whose drives all take effect
+  // in the same real-time step, and which is not on a combinational loop.
+  bool combinational = false;
+  // The signals a combinational entity drives.
+  llvm::SmallVector<unsigned, 2> drivenSignals;
+  // The sizes of the process and entity states allocated by the lowered code.
+  uint64_t procStateSize = 0;
+  uint64_t entityStateSize = 0;
+  // The fields of the state holding pointers, from the table of the unit.
+  llvm::ArrayRef<StateRelocation> relocations;
   Time expectedWakeup;
   // A pointer to the base unit jitted function.
   void (*unitFPtr)(void **);
+  // A pointer to the base unit precompiled function, taking the arguments
+  // unpacked.
+  void (*unitPrecompiledFPtr)(State *, void *, SignalDetail *) = nullptr;
 };
 
 /// The simulator's state. It contains the current simulation time, signal
 /// values and the event queue.
 struct State {
-  /// Construct a new empty (at 0 time) state.
-  State() = default;
+  /// Construct a new empty (at 0 time) state, using the given kind of event
+  /// queue.
+  State(QueueKind kind = timingWheel) : queue(UpdateQueue::create(kind)) {}
 
   /// State destructor, ensures all malloc'd regions stored in the state are
   /// correctly free'd.
   ~State();
 
+  /// Move the values of all the signals to one contiguous arena, and point the
+  /// signal details to it. This must be called once all the signals have been
+  /// allocated, and before any instance runs. The values are already packed if
+  /// they were carved out of the arena of the lowered code.
+  void packSignalValues();
+
+  /// Allocate the zeroed arena of `size` bytes that the lowered code carves
+  /// the states of the instances and the values of the signals out of. They
+  /// are freed along with the arena.
+  uint8_t *allocateArena(size_t size);
+
+  /// Return the instances the given signal triggers.
+  llvm::ArrayRef<unsigned> getTriggers(unsigned index) const {
+    return llvm::makeArrayRef(triggerInsts).slice(
+        triggerBegin[index], triggerBegin[index + 1] - triggerBegin[index]);
+  }
+
+  /// Return the given value of a signal in hexadecimal string format.
+  std::string dumpSignalValue(unsigned index, const uint8_t *value);
+
+  /// Return the i-th element of the given value of a signal in hexadecimal
+  /// string format.
+  std::string dumpSignalValue(unsigned index, unsigned elemIndex,
+                              const uint8_t *value);
+
   /// Pop the head of the queue and update the simulation time.
   Slot popQueue();
 
-  /// Push a new scheduled wakeup event in the event queue.
-  void pushQueue(Time time, unsigned inst);
+  /// Push a new scheduled wakeup event in the event queue, or in the given
+  /// staging buffers if the instance runs in parallel with others.
+  void pushQueue(Time time, unsigned inst, UpdateStaging *staging = nullptr);
 
   /// Find an instance in the instances list by name and return an
   /// iterator for it.
   llvm::SmallVectorTemplateCommon<Instance>::iterator
-  getInstanceIterator(std::string instName);
+  getInstanceIterator(llvm::StringRef instName);
+
+  /// Build the indices of the instances by name and of the signals by
+  /// hierarchical path, once the layout and the triggers are complete.
+  void buildIndex();
+
+  /// Return the index of the signal with the given path in one of the
+  /// instances it appears in, if there is one.
+  llvm::Optional<unsigned> lookupSignal(llvm::StringRef path) const;
 
   /// Add a new signal to the state. Returns the index of the new signal.
   int addSignal(std::string name, std::string owner);
@@ -227,12 +467,32 @@ struct State {
 
   void addSignalElement(unsigned, unsigned, unsigned);
 
-  /// Add a pointer to the process persistence state to a process instance.
-  void addProcPtr(std::string name, ProcState *procStatePtr);
+  /// Copy the instances, signals and triggers of the layout of another state,
+  /// which are then allocated by initializing the design with this state.
+  void copyLayout(const State &other);
+
+  /// Set the value of the signal with the given path in one of its instances,
+  /// from an integer in the syntax of StringRef::getAsInteger.
+  llvm::Error setSignalValue(llvm::StringRef path, llvm::StringRef value);
+
+  /// Add a pointer to the process persistence state of `size` bytes to a
+  /// process instance, with the relocation table of its unit.
+  void addProcPtr(std::string name, ProcState *procStatePtr, uint64_t size,
+                  llvm::ArrayRef<StateRelocation> relocations);
+
+  /// Write the signal values, the instance states and the pending events to
+  /// `os` in a compact binary form. This empties the event queue.
+  void writeCheckpoint(llvm::raw_ostream &os);
+
+  /// Restore the state written by writeCheckpoint, once the signals and the
+  /// instances of the same design have been allocated and the values packed.
+  llvm::Error restoreCheckpoint(llvm::StringRef data);
 
   /// Dump a signal to the out stream. One entry is added for every instance
   /// the signal appears in.
   void dumpSignal(llvm::raw_ostream &out, int index);
+  /// Dump the signal with the given path in one of its instances.
+  llvm::Error dumpSignal(llvm::raw_ostream &out, llvm::StringRef path);
 
   /// Dump the instance layout. Used for testing purposes.
   void dumpLayout();
@@ -244,7 +504,34 @@ struct State {
   std::string root;
   llvm::SmallVector<Instance, 0> instances;
   llvm::SmallVector<Signal, 0> signals;
-  UpdateQueue queue;
+  std::unique_ptr<UpdateQueue> queue;
+
+  // The value of each signal, pointing to the arena once the values are
+  // packed.
+  std::vector<uint8_t *> signalValues;
+  // The size of each signal's value, in bytes.
+  std::vector<uint64_t> signalSizes;
+  // The instances each signal triggers, stored contiguously: the triggers of
+  // signal `i` are between triggerBegin[i] and triggerBegin[i + 1]. For each
+  // trigger, triggerSenses holds the index of the signal in the instance's
+  // sensitivity list, which is also its index in the process' senses.
+  std::vector<unsigned> triggerBegin;
+  std::vector<unsigned> triggerInsts;
+  std::vector<unsigned> triggerSenses;
+  // The combinational entities, each one after the ones driving its signals.
+  std::vector<unsigned> combinationalOrder;
+  // Whether the changes of each signal appear in the trace.
+  llvm::BitVector tracedSignals;
+  // The index of each instance by name, and of each signal by its path in
+  // every instance it appears in.
+  llvm::StringMap<unsigned> instanceIndex;
+  llvm::StringMap<unsigned> signalIndex;
+
+private:
+  // The memory all the signal values are stored in, once packed, along with
+  // the instance states if the lowered code allocated it.
+  uint8_t *arena = nullptr;
+  size_t arenaSize = 0;
 };
 
 } // namespace sim
@@ -13,6 +13,7 @@
 
 #include "Trace.h"
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <regex>
@@ -20,19 +21,44 @@
 using namespace circt::llhd::sim;
 
 Trace::Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
-             TraceMode mode)
-    : out(out), state(state), mode(mode) {
-  auto root = state->root;
-  for (auto &sig : state->signals) {
-    if (mode != full && mode != merged && sig.owner != root) {
-      isTraced.push_back(false);
-    } else if (mode == namedOnly &&
-               std::regex_match(sig.name, std::regex("(sig)?[0-9]*"))) {
-      isTraced.push_back(false);
-    } else {
-      isTraced.push_back(true);
-    }
+             TraceMode mode, bool vcd, const std::vector<uint8_t *> *values)
+    : out(out), state(state), mode(mode),
+      values(values ? values : &state->signalValues), vcd(vcd) {}
+
+Trace::~Trace() = default;
+
+llvm::BitVector Trace::getTracedSignals(
+    const State &state, TraceMode mode,
+    llvm::ArrayRef<llvm::GlobPattern> include,
+    llvm::ArrayRef<llvm::GlobPattern> exclude) {
+  llvm::BitVector traced(state.signals.size());
+  std::regex defaultName("(sig)?[0-9]*");
+  for (size_t i = 0, e = state.signals.size(); i < e; ++i) {
+    auto &sig = state.signals[i];
+    if (mode != full && mode != merged && sig.owner != state.root)
+      continue;
+    if (mode == namedOnly && std::regex_match(sig.name, defaultName))
+      continue;
+
+    auto matches = [&](llvm::ArrayRef<llvm::GlobPattern> patterns) {
+      return llvm::any_of(state.getTriggers(i), [&](unsigned inst) {
+        auto path = state.instances[inst].path + '/' + sig.name;
+        return llvm::any_of(patterns, [&](const llvm::GlobPattern &pattern) {
+          return pattern.match(path);
+        });
+      });
+    };
+    if ((!include.empty() && !matches(include)) ||
+        (!exclude.empty() && matches(exclude)))
+      continue;
+    traced.set(i);
   }
+  return traced;
+}
+
+void Trace::writeInBackground(size_t maxBufferedBytes) {
+  writer = std::make_unique<TraceWriter>(state, out, mode, vcd,
+                                         maxBufferedBytes);
 }
 
 //===----------------------------------------------------------------------===//
@@ -51,10 +77,10 @@ void Trace::pushChange(unsigned inst, unsigned sigIndex, int elem = -1) {
     // Add element index to the hierarchical path.
     ss << '[' << elem << ']';
     // Get element value dump.
-    valueDump = sig.dump(elem);
+    valueDump = state->dumpSignalValue(sigIndex, elem, (*values)[sigIndex]);
   } else {
     // Get signal value dump.
-    valueDump = sig.dump();
+    valueDump = state->dumpSignalValue(sigIndex, (*values)[sigIndex]);
   }
 
   // Check wheter we have an actual change from last value.
@@ -79,20 +105,37 @@ void Trace::pushAllChanges(unsigned inst, unsigned sigIndex) {
 }
 
 void Trace::addChange(unsigned sigIndex) {
-  currentTime = state->time;
-  if (isTraced[sigIndex]) {
-    if (mode == full) {
-      auto &sig = state->signals[sigIndex];
-      // Add a change for each connected instance.
-      for (auto inst : sig.triggers) {
-        pushAllChanges(inst, sigIndex);
-      }
-    } else if (mode == reduced) {
-      // The root is always the last instance in the instances list.
-      pushAllChanges(state->instances.size() - 1, sigIndex);
-    } else if (mode == merged || mode == mergedReduce || mode == namedOnly) {
-      addChangeMerged(sigIndex);
+  if (!state->tracedSignals.test(sigIndex))
+    return;
+  if (writer) {
+    writer->addChange(sigIndex, state->time);
+    return;
+  }
+  addChange(sigIndex, state->time);
+}
+
+void Trace::addChange(unsigned sigIndex, const Time &time) {
+  currentTime = time;
+  if (vcd) {
+    if (vcdBegin.empty())
+      writeVCDHeader();
+    // Only the final value of each real-time step is dumped.
+    if (!vcdDirty[sigIndex]) {
+      vcdDirty[sigIndex] = true;
+      vcdChanged.push_back(sigIndex);
     }
+    return;
+  }
+  if (mode == full) {
+    // Add a change for each connected instance.
+    for (auto inst : state->getTriggers(sigIndex)) {
+      pushAllChanges(inst, sigIndex);
+    }
+  } else if (mode == reduced) {
+    // The root is always the last instance in the instances list.
+    pushAllChanges(state->instances.size() - 1, sigIndex);
+  } else if (mode == merged || mode == mergedReduce || mode == namedOnly) {
+    addChangeMerged(sigIndex);
   }
 }
 
@@ -101,12 +144,13 @@ void Trace::addChangeMerged(unsigned sigIndex) {
   if (sig.elements.size() > 0) {
     // Add a change for all sub-elements
     for (size_t i = 0, e = sig.elements.size(); i < e; ++i) {
-      auto valueDump = sig.dump(i);
+      auto valueDump =
+          state->dumpSignalValue(sigIndex, i, (*values)[sigIndex]);
       mergedChanges[std::make_pair(sigIndex, i)] = valueDump;
     }
   } else {
     // Add one change for the whole signal.
-    auto valueDump = sig.dump();
+    auto valueDump = state->dumpSignalValue(sigIndex, (*values)[sigIndex]);
     mergedChanges[std::make_pair(sigIndex, -1)] = valueDump;
   }
 }
@@ -124,10 +168,23 @@ void Trace::sortChanges() {
 }
 
 void Trace::flush(bool force) {
+  if (writer) {
+    writer->flush(state->time, force);
+    return;
+  }
+  flush(state->time, force);
+}
+
+void Trace::flush(const Time &time, bool force) {
+  if (vcd) {
+    if (time.time > currentTime.time || force)
+      flushVCD();
+    return;
+  }
   if (mode == full || mode == reduced)
     flushFull();
   else if (mode == merged || mode == mergedReduce || mode == namedOnly)
-    if (state->time.time > currentTime.time || force)
+    if (time.time > currentTime.time || force)
       flushMerged();
 }
 
@@ -148,12 +205,11 @@ void Trace::flushMerged() {
   for (auto elem : mergedChanges) {
     auto sigIndex = elem.first.first;
     auto sigElem = elem.first.second;
-    auto &sig = state->signals[sigIndex];
     auto change = elem.second;
 
     if (mode == merged) {
       // Add the changes for all connected instances.
-      for (auto inst : sig.triggers) {
+      for (auto inst : state->getTriggers(sigIndex)) {
         pushChange(inst, sigIndex, sigElem);
       }
     } else {
@@ -174,3 +230,279 @@ void Trace::flushMerged() {
     changes.clear();
   }
 }
+
+//===----------------------------------------------------------------------===//
+// VCD methods
+//===----------------------------------------------------------------------===//
+
+/// Return the VCD identifier code of the variable with the given index, made
+/// of the printable ASCII characters.
+static std::string getVCDIdentifier(unsigned index) {
+  std::string id;
+  do {
+    id.push_back('!' + index % 94);
+    index /= 94;
+  } while (index);
+  return id;
+}
+
+void Trace::writeVCDHeader() {
+  // Collect the variables of each traced signal, seen from every instance it
+  // appears in, or only from the root instance for the reduced formats.
+  auto rootInst = state->instances.size() - 1;
+  vcdBegin.push_back(0);
+  for (size_t sigIndex = 0, e = state->signals.size(); sigIndex < e;
+       ++sigIndex) {
+    if (state->tracedSignals.test(sigIndex)) {
+      auto &elements = state->signals[sigIndex].elements;
+      llvm::SmallVector<unsigned, 4> insts;
+      if (mode == full || mode == merged) {
+        auto triggers = state->getTriggers(sigIndex);
+        insts.append(triggers.begin(), triggers.end());
+      } else {
+        insts.push_back(rootInst);
+      }
+      auto addVariables = [&](int elem) {
+        for (auto inst : insts)
+          vcdVariables.push_back({static_cast<unsigned>(sigIndex), elem, inst,
+                                  getVCDIdentifier(vcdVariables.size())});
+      };
+      if (elements.empty())
+        addVariables(-1);
+      for (size_t elem = 0, ee = elements.size(); elem < ee; ++elem)
+        addVariables(elem);
+    }
+    vcdBegin.push_back(vcdVariables.size());
+  }
+  vcdDirty.assign(state->signals.size(), false);
+
+  // Group the variables by instance, ordered by the hierarchical path.
+  std::map<std::vector<std::string>, std::vector<unsigned>> scopes;
+  for (size_t i = 0, e = vcdVariables.size(); i < e; ++i) {
+    llvm::SmallVector<llvm::StringRef, 4> path;
+    llvm::StringRef(state->instances[vcdVariables[i].inst].path)
+        .split(path, '/');
+    scopes[std::vector<std::string>(path.begin(), path.end())].push_back(i);
+  }
+
+  out << "$timescale 1ps $end\n";
+  std::vector<std::string> current;
+  for (auto &scope : scopes) {
+    auto &path = scope.first;
+    // Close the scopes not shared with the previous instance, and open the new
+    // ones.
+    size_t common = 0;
+    while (common < current.size() && common < path.size() &&
+           current[common] == path[common])
+      ++common;
+    for (size_t i = common, e = current.size(); i < e; ++i)
+      out << "$upscope $end\n";
+    for (size_t i = common, e = path.size(); i < e; ++i)
+      out << "$scope module " << path[i] << " $end\n";
+    current = path;
+
+    for (auto i : scope.second) {
+      auto &var = vcdVariables[i];
+      auto &sig = state->signals[var.sigIndex];
+      auto size = var.elem < 0 ? state->signalSizes[var.sigIndex]
+                               : sig.elements[var.elem].second;
+      out << "$var wire " << size * 8 << ' ' << var.id << ' ' << sig.name;
+      if (var.elem >= 0)
+        out << '[' << var.elem << ']';
+      out << " $end\n";
+    }
+  }
+  for (size_t i = 0, e = current.size(); i < e; ++i)
+    out << "$upscope $end\n";
+  out << "$enddefinitions $end\n";
+}
+
+void Trace::appendVCDValue(const uint8_t *bytes, unsigned size) {
+  vcdBuffer.push_back('b');
+  if (size == 0) {
+    vcdBuffer.push_back('0');
+    return;
+  }
+  // Skip the leading zero bits, keeping at least one digit.
+  int byte = size - 1;
+  while (byte > 0 && bytes[byte] == 0)
+    --byte;
+  int bit = 7;
+  while (bit > 0 && !(bytes[byte] >> bit & 1))
+    --bit;
+  for (; byte >= 0; --byte, bit = 7)
+    for (; bit >= 0; --bit)
+      vcdBuffer.push_back('0' + (bytes[byte] >> bit & 1));
+}
+
+void Trace::flushVCD() {
+  if (vcdChanged.empty())
+    return;
+
+  vcdBuffer.clear();
+  vcdBuffer.push_back('#');
+  vcdBuffer += llvm::utostr(currentTime.time);
+  vcdBuffer.push_back('\n');
+
+  // Dump the signals in the order of their first change in the step.
+  for (auto sigIndex : vcdChanged) {
+    vcdDirty[sigIndex] = false;
+    const auto *value = (*values)[sigIndex];
+    auto &elements = state->signals[sigIndex].elements;
+    for (auto i = vcdBegin[sigIndex], e = vcdBegin[sigIndex + 1]; i < e; ++i) {
+      auto &var = vcdVariables[i];
+      if (var.elem < 0)
+        appendVCDValue(value, state->signalSizes[sigIndex]);
+      else
+        appendVCDValue(value + elements[var.elem].first,
+                       elements[var.elem].second);
+      vcdBuffer.push_back(' ');
+      vcdBuffer += var.id;
+      vcdBuffer.push_back('\n');
+    }
+  }
+  vcdChanged.clear();
+  out << vcdBuffer;
+}
+
+//===----------------------------------------------------------------------===//
+// TraceWriter
+//===----------------------------------------------------------------------===//
+
+/// The size of the chunks handed over to the writer thread.
+static constexpr size_t traceChunkSize = 1 << 16;
+
+TraceWriter::TraceWriter(std::unique_ptr<State> const &state,
+                         llvm::raw_ostream &out, TraceMode mode, bool vcd,
+                         size_t maxBufferedBytes)
+    : state(state), maxBufferedBytes(maxBufferedBytes),
+      trace(state, out, mode, vcd, &shadowValues) {
+  chunk.reserve(traceChunkSize);
+  thread = std::thread([this] { run(); });
+}
+
+TraceWriter::~TraceWriter() {
+  if (!chunk.empty())
+    submit();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  cond.notify_all();
+  thread.join();
+}
+
+void TraceWriter::addChange(unsigned sigIndex, const Time &time) {
+  changedSinceFlush = true;
+  appendRecord(changeRecord, time, sigIndex, state->signalValues[sigIndex],
+               state->signalSizes[sigIndex]);
+}
+
+void TraceWriter::flush(const Time &time, bool force) {
+  // Flushes only have an effect after a change or when the real time moves
+  // on, skip the others to keep the records small.
+  if (!force && !changedSinceFlush && time.time == lastFlush.time)
+    return;
+  changedSinceFlush = false;
+  lastFlush = time;
+  appendRecord(force ? forcedFlushRecord : flushRecord, time, 0, nullptr, 0);
+  if (force)
+    submit();
+}
+
+void TraceWriter::appendRecord(RecordKind kind, const Time &time,
+                               unsigned sigIndex, const uint8_t *bytes,
+                               uint64_t size) {
+  auto append = [&](const void *data, size_t length) {
+    auto *begin = static_cast<const uint8_t *>(data);
+    chunk.insert(chunk.end(), begin, begin + length);
+  };
+  append(&kind, sizeof(kind));
+  append(&time.time, sizeof(time.time));
+  append(&time.delta, sizeof(time.delta));
+  append(&time.eps, sizeof(time.eps));
+  append(&sigIndex, sizeof(sigIndex));
+  append(bytes, size);
+
+  if (chunk.size() >= traceChunkSize)
+    submit();
+}
+
+void TraceWriter::submit() {
+  std::unique_lock<std::mutex> lock(mutex);
+  pendingBytes += chunk.size();
+  pending.push_back(std::move(chunk));
+  cond.notify_all();
+
+  // Wait for the writer to catch up if the pending records take too much
+  // memory.
+  if (maxBufferedBytes)
+    cond.wait(lock, [&] { return pendingBytes <= maxBufferedBytes; });
+
+  // Reuse the memory of a chunk the writer is done with.
+  if (!freeChunks.empty()) {
+    chunk = std::move(freeChunks.back());
+    freeChunks.pop_back();
+  } else {
+    chunk = std::vector<uint8_t>();
+    chunk.reserve(traceChunkSize);
+  }
+}
+
+void TraceWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cond.wait(lock, [&] { return done || !pending.empty(); });
+    if (pending.empty())
+      return;
+
+    auto records = std::move(pending.front());
+    pending.pop_front();
+    lock.unlock();
+    replay(records);
+    lock.lock();
+
+    pendingBytes -= records.size();
+    records.clear();
+    freeChunks.push_back(std::move(records));
+    cond.notify_all();
+  }
+}
+
+void TraceWriter::replay(const std::vector<uint8_t> &records) {
+  // The signals are all allocated by the time the first change is recorded.
+  if (shadowValues.empty()) {
+    size_t size = 0;
+    for (auto sigSize : state->signalSizes)
+      size += sigSize;
+    shadowArena.assign(size, 0);
+    size_t offset = 0;
+    for (auto sigSize : state->signalSizes) {
+      shadowValues.push_back(shadowArena.data() + offset);
+      offset += sigSize;
+    }
+  }
+
+  const uint8_t *ptr = records.data();
+  const uint8_t *end = ptr + records.size();
+  auto read = [&](void *data, size_t length) {
+    std::memcpy(data, ptr, length);
+    ptr += length;
+  };
+  while (ptr < end) {
+    RecordKind kind;
+    Time time;
+    unsigned sigIndex;
+    read(&kind, sizeof(kind));
+    read(&time.time, sizeof(time.time));
+    read(&time.delta, sizeof(time.delta));
+    read(&time.eps, sizeof(time.eps));
+    read(&sigIndex, sizeof(sigIndex));
+    if (kind == changeRecord) {
+      read(shadowValues[sigIndex], state->signalSizes[sigIndex]);
+      trace.addChange(sigIndex, time);
+    } else {
+      trace.flush(time, kind == forcedFlushRecord);
+    }
+  }
+}
@@ -19,7 +19,13 @@
 
 #include "State.h"
 
+#include "llvm/Support/GlobPattern.h"
+
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace llvm {
@@ -32,13 +38,17 @@ namespace sim {
 
 enum TraceMode { full, reduced, merged, mergedReduce, namedOnly };
 
+class TraceWriter;
+
 class Trace {
   llvm::raw_ostream &out;
   std::unique_ptr<State> const &state;
   TraceMode mode;
+  // The signal values the trace is built from.
+  const std::vector<uint8_t *> *values;
+  // The writer formatting the changes on a background thread, if any.
+  std::unique_ptr<TraceWriter> writer;
   Time currentTime;
-  // Each entry defines if the respective signal is active for tracing.
-  std::vector<bool> isTraced;
   // Buffer of changes ready to be flushed.
   std::vector<std::pair<std::string, std::string>> changes;
   // Buffer of changes for the merged formats.
@@ -46,6 +56,27 @@ class Trace {
   // Buffer of last dumped change for each signal.
   std::map<std::pair<std::string, int>, std::string> lastValue;
 
+  // Whether the trace is written in the Value Change Dump format.
+  bool vcd;
+  // A VCD variable: the element of a signal, or the whole signal, seen from
+  // one instance.
+  struct VCDVariable {
+    unsigned sigIndex;
+    int elem;
+    unsigned inst;
+    std::string id;
+  };
+  // The VCD variables, ordered by signal. They are built once all the signals
+  // have been allocated. The variables of signal `i` are between
+  // vcdBegin[i] and vcdBegin[i + 1].
+  std::vector<VCDVariable> vcdVariables;
+  std::vector<unsigned> vcdBegin;
+  // The signals changed during the current real-time step.
+  std::vector<bool> vcdDirty;
+  std::vector<unsigned> vcdChanged;
+  // The buffer the value changes are encoded in before being written.
+  std::string vcdBuffer;
+
   /// Push one change to the changes vector.
   void pushChange(unsigned inst, unsigned sigIndex, int elem);
   /// Push one change for each element of a signal if it is of a structured
@@ -63,17 +94,115 @@ class Trace {
   // Flush the changes buffer to the output stream with merged format.
   void flushMerged();
 
+  /// Build the VCD variables of the traced signals and write the VCD header
+  /// declaring them.
+  void writeVCDHeader();
+  /// Append the VCD encoding of a value with the given bytes to the buffer.
+  void appendVCDValue(const uint8_t *bytes, unsigned size);
+  /// Write the final values of the signals changed in the current real-time
+  /// step to the output stream, in VCD format.
+  void flushVCD();
+
 public:
+  /// Create a trace of the given signal values, the state's ones by default.
   Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
-        TraceMode mode);
+        TraceMode mode, bool vcd = false,
+        const std::vector<uint8_t *> *values = nullptr);
+
+  /// Write the pending changes if they are handled by a background thread.
+  ~Trace();
+
+  /// Return which signals of the state are traced with the given mode. If
+  /// there are `include` patterns, only the signals matching one of them are
+  /// traced, and the signals matching an `exclude` pattern never are. A
+  /// signal matches a pattern if its path in one of its instances does.
+  static llvm::BitVector
+  getTracedSignals(const State &state, TraceMode mode,
+                   llvm::ArrayRef<llvm::GlobPattern> include = {},
+                   llvm::ArrayRef<llvm::GlobPattern> exclude = {});
+
+  /// Format and write the changes on a background thread from now on. If
+  /// `maxBufferedBytes` is not 0, the simulation waits for the writer when
+  /// the unwritten changes would take more memory than that.
+  void writeInBackground(size_t maxBufferedBytes);
 
-  /// Add a value change to the trace changes buffer.
+  /// Add a value change to the trace changes buffer. The changes of
+  /// untraced signals are dropped right away.
   void addChange(unsigned);
 
+  /// Add a value change of a traced signal happening at the given time.
+  void addChange(unsigned, const Time &time);
+
   /// Flush the changes buffer to the output stream. The flush can be forced for
   /// merged changes, flushing even if the next real-time step has not been
   /// reached.
   void flush(bool force = false);
+
+  /// Flush the changes buffer as if the simulation was at the given time.
+  void flush(const Time &time, bool force);
+
+  /// Wait for the background writer, if any, to write all the changes.
+  void finish() { writer.reset(); }
+};
+
+/// Formats and writes the changes of a trace on a background thread. The
+/// simulation appends raw records of the changed values to a chunk, and hands
+/// the full chunks over to the writer thread. The writer replays them on its
+/// own copy of the signal values, with a trace writing to the output stream.
+class TraceWriter {
+public:
+  TraceWriter(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
+              TraceMode mode, bool vcd, size_t maxBufferedBytes);
+
+  /// Write all the pending records and stop the writer thread.
+  ~TraceWriter();
+
+  /// Record a change of the given signal, copying its current value.
+  void addChange(unsigned sigIndex, const Time &time);
+
+  /// Record a flush of the trace.
+  void flush(const Time &time, bool force);
+
+private:
+  enum RecordKind : uint8_t { changeRecord, flushRecord, forcedFlushRecord };
+
+  /// Append a record to the current chunk, handing it over to the writer
+  /// once it is full.
+  void appendRecord(RecordKind kind, const Time &time, unsigned sigIndex,
+                    const uint8_t *bytes, uint64_t size);
+
+  /// Hand the current chunk over to the writer thread, waiting if too many
+  /// chunks are pending.
+  void submit();
+
+  /// The body of the writer thread.
+  void run();
+
+  /// Replay the records of a chunk on the writer's trace.
+  void replay(const std::vector<uint8_t> &records);
+
+  std::unique_ptr<State> const &state;
+  size_t maxBufferedBytes;
+  // The chunk records are appended to.
+  std::vector<uint8_t> chunk;
+  // Whether there were changes since the last recorded flush, and the time of
+  // the last recorded flush.
+  bool changedSinceFlush = false;
+  Time lastFlush;
+
+  // The state shared with the writer thread.
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::vector<uint8_t>> pending;
+  std::vector<std::vector<uint8_t>> freeChunks;
+  size_t pendingBytes = 0;
+  bool done = false;
+
+  // The signal values as seen by the writer thread, and its trace.
+  std::vector<uint8_t> shadowArena;
+  std::vector<uint8_t *> shadowValues;
+  Trace trace;
+  std::thread thread;
 };
 } // namespace sim
 } // namespace llhd
@@ -15,6 +15,9 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <cstdlib>
+#include <cstring>
+
 using namespace llvm;
 using namespace circt::llhd::sim;
 
@@ -22,6 +25,35 @@ using namespace circt::llhd::sim;
 // Runtime interface
 //===----------------------------------------------------------------------===//
 
+/// The staging buffers of the calling thread, set while it runs instances in
+/// parallel with other threads.
+static thread_local UpdateStaging *threadStaging = nullptr;
+
+/// The drives written by the inline fast path of the units run by the calling
+/// thread.
+static constexpr uint64_t driveBufferCapacity = 64;
+static thread_local DriveRecord threadDriveRecords[driveBufferCapacity];
+static thread_local DriveBuffer threadDrives = {0, 0, nullptr};
+
+/// Add a drive to the event queue, or to the staging buffers of the thread.
+static void insertDrive(State *state, SignalDetail *detail, uint8_t *value,
+                        uint64_t width, Time delay) {
+  auto globalIndex = detail->globalIndex;
+  auto offset = detail->offset;
+
+  int bitOffset =
+      (detail->value - state->signalValues[globalIndex]) * 8 + offset;
+
+  // Spawn a new event.
+  Time driveTime = state->time + delay;
+  if (threadStaging)
+    threadStaging->insertOrUpdate(driveTime, globalIndex, bitOffset, value,
+                                  width);
+  else
+    state->queue->insertOrUpdate(driveTime, globalIndex, bitOffset, value,
+                                 width);
+}
+
 int allocSignal(State *state, int index, char *owner, uint8_t *value,
                 int64_t size) {
   assert(state && "alloc_signal: state not found");
@@ -41,31 +73,78 @@ void addSigStructElement(State *state, unsigned index, unsigned offset,
   state->addSignalElement(index, offset, size);
 }
 
-void allocProc(State *state, char *owner, ProcState *procState) {
+void allocProc(State *state, char *owner, ProcState *procState, uint64_t size,
+               StateRelocation *relocations, uint64_t numRelocations) {
   assert(state && "alloc_proc: state not found");
   std::string sOwner(owner);
-  state->addProcPtr(sOwner, procState);
+  state->addProcPtr(sOwner, procState, size,
+                    makeArrayRef(relocations, numRelocations));
 }
 
-void allocEntity(State *state, char *owner, uint8_t *entityState) {
+void allocEntity(State *state, char *owner, uint8_t *entityState,
+                 uint64_t size, StateRelocation *relocations,
+                 uint64_t numRelocations) {
   assert(state && "alloc_entity: state not found");
   auto it = state->getInstanceIterator(owner);
   (*it).entityState = std::unique_ptr<uint8_t>(entityState);
+  (*it).entityStateSize = size;
+  (*it).relocations = makeArrayRef(relocations, numRelocations);
 }
 
-void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
-                 uint64_t width, int time, int delta, int eps) {
-  assert(state && "drive_signal: state not found");
+uint8_t *allocArena(State *state, uint64_t size) {
+  assert(state && "alloc_arena: state not found");
+  return state->allocateArena(size);
+}
 
-  auto globalIndex = detail->globalIndex;
-  auto offset = detail->offset;
+void allocLayout(State *state, LayoutInstance *instances,
+                 uint64_t numInstances, LayoutSignal *signals,
+                 uint64_t numSignals, LayoutElement *elements) {
+  assert(state && "alloc_layout: state not found");
+  for (auto &inst : makeArrayRef(instances, numInstances)) {
+    if (inst.isEntity) {
+      auto *entityState =
+          static_cast<uint8_t *>(std::calloc(1, inst.stateSize));
+      allocEntity(state, inst.owner, entityState, inst.stateSize,
+                  inst.relocations, inst.numRelocations);
+      continue;
+    }
+    auto *procState = static_cast<ProcState *>(std::malloc(inst.stateSize));
+    procState->resume = 0;
+    procState->senses = static_cast<bool *>(std::malloc(inst.numSenses));
+    std::fill_n(procState->senses, inst.numSenses, true);
+    allocProc(state, inst.owner, procState, inst.stateSize, inst.relocations,
+              inst.numRelocations);
+  }
 
-  int bitOffset =
-      (detail->value - state->signals[globalIndex].value.get()) * 8 + offset;
+  for (auto &sig : makeArrayRef(signals, numSignals)) {
+    // Allocate double the required space to make sure signal shifts do not
+    // segfault.
+    auto *value = static_cast<uint8_t *>(std::malloc(sig.allocSize * 2));
+    std::memcpy(value, sig.init, sig.allocSize);
+    auto index = allocSignal(state, sig.index, sig.owner, value, sig.size);
+    if (sig.numArrayElements)
+      addSigArrayElements(state, index, sig.arrayElementSize,
+                          sig.numArrayElements);
+    for (auto &elem : makeArrayRef(elements + sig.firstStructElement,
+                                   sig.numStructElements))
+      addSigStructElement(state, index, elem.offset, elem.size);
+  }
+}
 
-  // Spawn a new event.
-  state->queue.insertOrUpdate(state->time + Time(time, delta, eps), globalIndex,
-                              bitOffset, value, width);
+DriveBuffer *getDriveBuffer(State *state) {
+  if (!threadDrives.records) {
+    threadDrives.records = threadDriveRecords;
+    threadDrives.capacity = driveBufferCapacity;
+  }
+  return &threadDrives;
+}
+
+void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
+                 uint64_t width, int time, int delta, int eps) {
+  assert(state && "drive_signal: state not found");
+  if (threadDrives.size)
+    flushDriveBuffer(state);
+  insertDrive(state, detail, value, width, Time(time, delta, eps));
 }
 
 void llhdSuspend(State *state, ProcState *procState, int time, int delta,
@@ -73,6 +152,22 @@ void llhdSuspend(State *state, ProcState *procState, int time, int delta,
   // Add a new scheduled wake up if a time is specified.
   if (time || delta || eps) {
     Time sTime(time, delta, eps);
-    state->pushQueue(sTime, procState->inst);
+    state->pushQueue(sTime, procState->inst, threadStaging);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Engine interface
+//===----------------------------------------------------------------------===//
+
+void setThreadStaging(UpdateStaging *staging) { threadStaging = staging; }
+
+void flushDriveBuffer(State *state) {
+  for (uint64_t i = 0, e = threadDrives.size; i < e; ++i) {
+    auto &record = threadDrives.records[i];
+    insertDrive(state, record.detail,
+                reinterpret_cast<uint8_t *>(&record.value), record.width,
+                Time(record.time, record.delta, record.eps));
   }
+  threadDrives.size = 0;
 }
@@ -36,15 +36,41 @@ void addSigArrayElements(circt::llhd::sim::State *state, unsigned index,
 void addSigStructElement(circt::llhd::sim::State *state, unsigned index,
                          unsigned offset, unsigned size);
 
-/// Add allocated constructs to a process instance.
+/// Add allocated constructs to a process instance. `size` is the size of the
+/// process state, including the persisted values. `relocations` lists the
+/// fields of the state holding pointers, or is null if there are none.
 void allocProc(circt::llhd::sim::State *state, char *owner,
-               circt::llhd::sim::ProcState *procState);
+               circt::llhd::sim::ProcState *procState, uint64_t size,
+               circt::llhd::sim::StateRelocation *relocations,
+               uint64_t numRelocations);
 
-/// Add allocated entity state to the given instance.
+/// Add allocated entity state of `size` bytes to the given instance, with the
+/// relocation table of its unit.
 void allocEntity(circt::llhd::sim::State *state, char *owner,
-                 uint8_t *entityState);
+                 uint8_t *entityState, uint64_t size,
+                 circt::llhd::sim::StateRelocation *relocations,
+                 uint64_t numRelocations);
 
-/// Drive a value onto a signal.
+/// Allocate the zeroed arena of `size` bytes that the init function of the
+/// arena lowering carves the instance states and signal values out of.
+uint8_t *allocArena(circt::llhd::sim::State *state, uint64_t size);
+
+/// Allocate the instances and signals listed in the layout tables emitted by
+/// the static-layout lowering, in place of the per-instance calls to
+/// allocEntity, allocProc, allocSignal and the element functions.
+void allocLayout(circt::llhd::sim::State *state,
+                 circt::llhd::sim::LayoutInstance *instances,
+                 uint64_t numInstances,
+                 circt::llhd::sim::LayoutSignal *signals, uint64_t numSignals,
+                 circt::llhd::sim::LayoutElement *elements);
+
+/// Return the drive buffer of the calling thread, which the lowered units
+/// append their narrow drives to instead of calling driveSignal.
+circt::llhd::sim::DriveBuffer *
+getDriveBuffer(circt::llhd::sim::State *state);
+
+/// Drive a value onto a signal. The drives buffered by the calling thread are
+/// applied first, to keep the drives in order.
 void driveSignal(circt::llhd::sim::State *state,
                  circt::llhd::sim::SignalDetail *index, uint8_t *value,
                  uint64_t width, int time, int delta, int eps);
@@ -53,6 +79,19 @@ void driveSignal(circt::llhd::sim::State *state,
 void llhdSuspend(circt::llhd::sim::State *state,
                  circt::llhd::sim::ProcState *procState, int time, int delta,
                  int eps);
+
+//===----------------------------------------------------------------------===//
+// Engine interfaces
+//===----------------------------------------------------------------------===//
+
+/// Set the staging buffers the drives and wakeups of the instances run by the
+/// calling thread are recorded in. A null staging makes them go directly to
+/// the event queue.
+void setThreadStaging(circt::llhd::sim::UpdateStaging *staging);
+
+/// Apply the drives buffered by the calling thread. This is called after
+/// every unit invocation.
+void flushDriveBuffer(circt::llhd::sim::State *state);
 }
 
 #endif // CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALS_RUNTIME_WRAPPERS_H
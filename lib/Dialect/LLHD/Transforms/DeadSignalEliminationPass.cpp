@@ -0,0 +1,292 @@
+//===- DeadSignalEliminationPass.cpp - Implement Dead Signal Elimination --===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implement pass to remove the signals, drives and instances that have no
+// observable effect on the root entity of the design.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/LLHD/IR/LLHDOps.h"
+#include "circt/Dialect/LLHD/Transforms/Passes.h"
+#include "mlir/Interfaces/CallInterfaces.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/IntEqClasses.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Regex.h"
+
+using namespace circt;
+using namespace llhd;
+
+namespace {
+
+/// One instance of an entity or process in the elaborated design, with the
+/// signals it reads and drives.
+struct Unit {
+  /// The unit instantiating this one, or -1 for the root.
+  int parent;
+  SmallVector<unsigned, 4> reads;
+  SmallVector<unsigned, 4> writes;
+  /// Whether the unit calls a function, which may have side effects.
+  bool hasEffects = false;
+};
+
+struct DeadSignalEliminationPass
+    : public llhd::DeadSignalEliminationBase<DeadSignalEliminationPass> {
+  DeadSignalEliminationPass(StringRef root, bool namedOnly) {
+    this->root = root.str();
+    this->namedOnly = namedOnly;
+  }
+
+  void runOnOperation() override;
+
+private:
+  unsigned createNode();
+  unsigned getNode(Value value, DenseMap<Value, unsigned> &nodes);
+  void elaborate(Operation *def, ArrayRef<unsigned> ports, int parent);
+
+  /// The signals of the elaborated design, those connected by `llhd.con`
+  /// being in the same class.
+  llvm::IntEqClasses signals;
+  unsigned numNodes = 0;
+  std::vector<Unit> units;
+  /// The signals which are observable regardless of their readers.
+  SmallVector<unsigned, 8> observed;
+  /// The signals driven or connected by each operation, one per instance of
+  /// its unit.
+  DenseMap<Operation *, SmallVector<unsigned, 1>> opSignals;
+  /// The unit instances created by each `llhd.inst`.
+  DenseMap<Operation *, SmallVector<unsigned, 1>> instUnits;
+};
+} // namespace
+
+unsigned DeadSignalEliminationPass::createNode() {
+  signals.grow(++numNodes);
+  return numNodes - 1;
+}
+
+/// Return the elaborated signal a signal value of a unit refers to. Slices
+/// and elements of a signal are not tracked separately.
+unsigned
+DeadSignalEliminationPass::getNode(Value value,
+                                   DenseMap<Value, unsigned> &nodes) {
+  auto it = nodes.find(value);
+  if (it != nodes.end())
+    return it->second;
+
+  Operation *op = value.getDefiningOp();
+  Value base;
+  if (op && !isa<SigOp>(op)) {
+    auto sigOperand = llvm::find_if(op->getOperands(), [](Value operand) {
+      return operand.getType().isa<SigType>();
+    });
+    if (sigOperand != op->operand_end())
+      base = *sigOperand;
+  }
+
+  unsigned node;
+  if (base) {
+    node = getNode(base, nodes);
+  } else {
+    // Signals of unknown origin, like block arguments of a process, are
+    // kept conservatively.
+    node = createNode();
+    if (!isa_and_nonnull<SigOp>(op))
+      observed.push_back(node);
+  }
+  nodes[value] = node;
+  return node;
+}
+
+/// Elaborate an instance of the entity or process `def`, with its arguments
+/// bound to the `ports` signals.
+void DeadSignalEliminationPass::elaborate(Operation *def,
+                                          ArrayRef<unsigned> ports,
+                                          int parent) {
+  unsigned index = units.size();
+  units.push_back({parent});
+  DenseMap<Value, unsigned> nodes;
+  Region &body = def->getRegion(0);
+  for (auto arg : llvm::zip(body.getArguments(), ports))
+    nodes[std::get<0>(arg)] = std::get<1>(arg);
+
+  llvm::Regex defaultName("^(sig)?[0-9]*$");
+  bool isRoot = parent < 0;
+  body.walk([&](Operation *op) {
+    if (auto sigOp = dyn_cast<SigOp>(op)) {
+      unsigned node = getNode(sigOp.result(), nodes);
+      if (isRoot && !(namedOnly && defaultName.match(sigOp.name())))
+        observed.push_back(node);
+      return;
+    }
+    if (auto drvOp = dyn_cast<DrvOp>(op)) {
+      unsigned node = getNode(drvOp.signal(), nodes);
+      units[index].writes.push_back(node);
+      opSignals[op].push_back(node);
+      return;
+    }
+    if (auto regOp = dyn_cast<RegOp>(op)) {
+      unsigned node = getNode(regOp.signal(), nodes);
+      units[index].writes.push_back(node);
+      opSignals[op].push_back(node);
+      for (auto value : regOp.values())
+        if (value.getType().isa<SigType>())
+          units[index].reads.push_back(getNode(value, nodes));
+      return;
+    }
+    if (auto conOp = dyn_cast<ConnectOp>(op)) {
+      unsigned lhs = getNode(conOp.lhs(), nodes);
+      signals.join(lhs, getNode(conOp.rhs(), nodes));
+      opSignals[op].push_back(lhs);
+      return;
+    }
+    if (auto instOp = dyn_cast<InstOp>(op)) {
+      Operation *callee = SymbolTable::lookupNearestSymbolFrom(
+          getOperation(), instOp.calleeAttr());
+      if (!callee || !isa<EntityOp, ProcOp>(callee)) {
+        units[index].hasEffects = true;
+        return;
+      }
+      SmallVector<unsigned, 8> childPorts;
+      for (auto operand : instOp.getOperands())
+        childPorts.push_back(getNode(operand, nodes));
+      instUnits[op].push_back(units.size());
+      elaborate(callee, childPorts, index);
+      return;
+    }
+    if (isa<CallOpInterface>(op)) {
+      units[index].hasEffects = true;
+      return;
+    }
+
+    // Probes, waits and any other uses of signals read them. Slices and
+    // elements of signals are aliases of their operand instead.
+    if (llvm::any_of(op->getResultTypes(),
+                     [](Type type) { return type.isa<SigType>(); }))
+      return;
+    for (auto operand : op->getOperands())
+      if (operand.getType().isa<SigType>())
+        units[index].reads.push_back(getNode(operand, nodes));
+  });
+}
+
+void DeadSignalEliminationPass::runOnOperation() {
+  ModuleOp module = getOperation();
+  auto rootEntity = module.lookupSymbol<EntityOp>(root);
+  if (!rootEntity) {
+    module.emitError("root entity '") << root << "' not found";
+    signalPassFailure();
+    return;
+  }
+
+  SmallVector<unsigned, 8> rootPorts;
+  for (unsigned i = 0, e = rootEntity.getNumArguments(); i < e; ++i) {
+    rootPorts.push_back(createNode());
+    observed.push_back(rootPorts.back());
+  }
+  elaborate(rootEntity, rootPorts, -1);
+
+  // Propagate the liveness from the observable signals to their writers, and
+  // from the live units to the signals they read.
+  DenseMap<unsigned, SmallVector<unsigned, 2>> writers;
+  for (unsigned i = 0, e = units.size(); i < e; ++i)
+    for (auto node : units[i].writes)
+      writers[signals.findLeader(node)].push_back(i);
+
+  llvm::BitVector liveSignals(numNodes), liveUnits(units.size());
+  SmallVector<unsigned, 16> worklist;
+  auto markSignal = [&](unsigned node) {
+    node = signals.findLeader(node);
+    if (!liveSignals.test(node)) {
+      liveSignals.set(node);
+      worklist.push_back(node);
+    }
+  };
+  auto markUnit = [&](unsigned unit) {
+    if (liveUnits.test(unit))
+      return;
+    liveUnits.set(unit);
+    for (auto node : units[unit].reads)
+      markSignal(node);
+  };
+  for (auto node : observed)
+    markSignal(node);
+  for (unsigned i = 0, e = units.size(); i < e; ++i)
+    if (units[i].hasEffects)
+      markUnit(i);
+  while (!worklist.empty()) {
+    unsigned node = worklist.pop_back_val();
+    for (auto unit : writers.lookup(node))
+      markUnit(unit);
+  }
+
+  // A dead unit is still needed if it instantiates a live one. The children
+  // are elaborated after their parent, so a reverse walk sees them first.
+  llvm::BitVector keptUnits = liveUnits;
+  for (unsigned i = units.size(); i-- > 1;)
+    if (keptUnits.test(i))
+      keptUnits.set(units[i].parent);
+
+  SmallVector<Operation *, 16> deadOps;
+  for (auto &entry : opSignals)
+    if (llvm::none_of(entry.second, [&](unsigned node) {
+          return liveSignals.test(signals.findLeader(node));
+        }))
+      deadOps.push_back(entry.first);
+  llvm::StringSet<> removedCallees;
+  for (auto &entry : instUnits) {
+    if (llvm::any_of(entry.second,
+                     [&](unsigned unit) { return keptUnits.test(unit); }))
+      continue;
+    deadOps.push_back(entry.first);
+    removedCallees.insert(cast<InstOp>(entry.first).callee());
+  }
+
+  // Erase the dead operations, and then the signals, probes and pure
+  // operations only they used.
+  auto isRemovable = [](Operation *op) {
+    return op->use_empty() &&
+           (isa<SigOp, PrbOp>(op) || wouldOpBeTriviallyDead(op));
+  };
+  while (!deadOps.empty()) {
+    Operation *op = deadOps.pop_back_val();
+    SmallPtrSet<Operation *, 4> operands;
+    for (auto operand : op->getOperands())
+      if (auto *def = operand.getDefiningOp())
+        operands.insert(def);
+    op->erase();
+    for (auto *def : operands)
+      if (isRemovable(def))
+        deadOps.push_back(def);
+  }
+
+  // Erase the units no longer instantiated anywhere.
+  llvm::StringSet<> callees;
+  module.walk([&](InstOp op) { callees.insert(op.callee()); });
+  for (auto &callee : removedCallees) {
+    if (callee.getKey() == root || callees.count(callee.getKey()))
+      continue;
+    if (auto *def = module.lookupSymbol(callee.getKey()))
+      def->erase();
+  }
+
+  // The analysis state is not needed across runs.
+  signals = llvm::IntEqClasses();
+  numNodes = 0;
+  units.clear();
+  observed.clear();
+  opSignals.clear();
+  instUnits.clear();
+}
+
+std::unique_ptr<OperationPass<ModuleOp>>
+circt::llhd::createDeadSignalEliminationPass(StringRef root, bool namedOnly) {
+  return std::make_unique<DeadSignalEliminationPass>(root, namedOnly);
+}
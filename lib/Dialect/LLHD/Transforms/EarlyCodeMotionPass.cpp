@@ -39,8 +39,8 @@ static SmallVector<Block *, 8> intersection(SmallVectorImpl<Block *> &v1,
 
 void EarlyCodeMotionPass::runOnOperation() {
   llhd::ProcOp proc = getOperation();
-  llhd::TemporalRegionAnalysis trAnalysis = llhd::TemporalRegionAnalysis(proc);
-  mlir::DominanceInfo dom(proc);
+  auto &trAnalysis = getAnalysis<llhd::TemporalRegionAnalysis>();
+  auto &dom = getAnalysis<mlir::DominanceInfo>();
 
   DenseMap<Block *, unsigned> entryDistance;
   SmallPtrSet<Block *, 32> workDone;
@@ -128,6 +128,9 @@ void EarlyCodeMotionPass::runOnOperation() {
       }
     }
   }
+
+  // Operations are only moved between blocks, the control flow is unchanged.
+  markAnalysesPreserved<llhd::TemporalRegionAnalysis, mlir::DominanceInfo>();
 }
 
 std::unique_ptr<OperationPass<llhd::ProcOp>>
@@ -0,0 +1,144 @@
+//===- EntityFusionPass.cpp - Implement Entity Fusion Pass ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implement pass to fuse the instances of entities sensitive to the same
+// signals into a single instance of a generated entity.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Dialect/LLHD/Transforms/Passes.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/SymbolTable.h"
+#include "llvm/ADT/SetVector.h"
+#include <map>
+
+using namespace circt;
+using namespace llhd;
+
+namespace {
+struct EntityFusionPass : public llhd::EntityFusionBase<EntityFusionPass> {
+  void runOnOperation() override;
+
+private:
+  bool isFusible(Operation *callee);
+  void fuseInstances(EntityOp parent, ArrayRef<InstOp> group);
+
+  SymbolTable *symbolTable;
+  /// Whether each instantiated unit can be fused, memoized.
+  DenseMap<Operation *, bool> fusible;
+};
+} // namespace
+
+/// Return true if `callee` is an entity holding no signals or instances. Such
+/// an entity is sensitive to its arguments only.
+bool EntityFusionPass::isFusible(Operation *callee) {
+  auto it = fusible.find(callee);
+  if (it != fusible.end())
+    return it->second;
+  auto entity = dyn_cast_or_null<EntityOp>(callee);
+  bool result = entity && !entity.walk([](Operation *op) {
+                             return isa<SigOp, InstOp>(op)
+                                        ? WalkResult::interrupt()
+                                        : WalkResult::advance();
+                           }).wasInterrupted();
+  fusible[callee] = result;
+  return result;
+}
+
+/// Replace the instances of `group`, which all have the same signals, by one
+/// instance of a new entity running the bodies of all their entities.
+void EntityFusionPass::fuseInstances(EntityOp parent, ArrayRef<InstOp> group) {
+  // The outputs of any of the instances are outputs of the fused entity, the
+  // other signals its inputs, each in order of first use.
+  llvm::SetVector<Value> signals;
+  DenseSet<Value> outputs;
+  for (auto inst : group) {
+    signals.insert(inst.getOperands().begin(), inst.getOperands().end());
+    outputs.insert(inst.outputs().begin(), inst.outputs().end());
+  }
+  SmallVector<Value, 8> ins, outs;
+  for (auto signal : signals)
+    (outputs.count(signal) ? outs : ins).push_back(signal);
+  SmallVector<Value, 8> args(ins.begin(), ins.end());
+  args.append(outs.begin(), outs.end());
+  SmallVector<Type, 8> argTypes;
+  DenseMap<Value, unsigned> argIndices;
+  for (auto arg : llvm::enumerate(args)) {
+    argTypes.push_back(arg.value().getType());
+    argIndices[arg.value()] = arg.index();
+  }
+
+  InstOp first = group.front();
+  OpBuilder builder(parent);
+  auto entity = builder.create<EntityOp>(first.getLoc(), ins.size());
+  entity->setAttr(entity.getTypeAttrName(),
+                  TypeAttr::get(builder.getFunctionType(argTypes, {})));
+  entity.setName((first.callee() + "_fused").str());
+  symbolTable->insert(entity);
+  Block *body = builder.createBlock(&entity.body(), {}, argTypes);
+
+  // The bodies are concatenated in the order of the instances, with the
+  // arguments of each entity bound to the shared ones.
+  for (auto inst : group) {
+    auto callee = symbolTable->lookup<EntityOp>(inst.callee());
+    BlockAndValueMapping mapping;
+    for (auto operand : llvm::enumerate(inst.getOperands()))
+      mapping.map(callee.getArgument(operand.index()),
+                  body->getArgument(argIndices[operand.value()]));
+    for (auto &op : callee.getBodyBlock()->without_terminator())
+      builder.clone(op, mapping);
+  }
+  builder.create<TerminatorOp>(first.getLoc());
+
+  builder.setInsertionPoint(first);
+  builder.create<InstOp>(first.getLoc(), first.name(), entity.getName(), ins,
+                         outs);
+  for (auto inst : group)
+    inst.erase();
+  ++numEntitiesCreated;
+  numInstancesFused += group.size();
+}
+
+void EntityFusionPass::runOnOperation() {
+  ModuleOp module = getOperation();
+  SymbolTable table(module);
+  symbolTable = &table;
+  fusible.clear();
+
+  SmallVector<EntityOp, 0> parents(module.getOps<EntityOp>());
+  for (auto parent : parents) {
+    // Group the instances of the fusible entities by the set of their
+    // signals, which is the set of signals waking them up.
+    std::map<SmallVector<void *, 8>, unsigned> groupIndices;
+    SmallVector<SmallVector<InstOp, 4>, 0> groups;
+    for (auto inst : parent.getBodyBlock()->getOps<InstOp>()) {
+      if (!isFusible(symbolTable->lookup(inst.callee())))
+        continue;
+      SmallVector<void *, 8> key;
+      for (auto operand : inst.getOperands())
+        key.push_back(operand.getAsOpaquePointer());
+      llvm::sort(key);
+      key.erase(std::unique(key.begin(), key.end()), key.end());
+      auto it = groupIndices.try_emplace(std::move(key), groups.size());
+      if (it.second)
+        groups.emplace_back();
+      groups[it.first->second].push_back(inst);
+    }
+
+    for (auto &group : groups)
+      if (group.size() > 1)
+        fuseInstances(parent, group);
+  }
+}
+
+std::unique_ptr<OperationPass<ModuleOp>>
+circt::llhd::createEntityFusionPass() {
+  return std::make_unique<EntityFusionPass>();
+}
@@ -14,7 +14,10 @@
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "circt/Dialect/LLHD/Transforms/Passes.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/Visitors.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 using namespace circt;
 
@@ -27,24 +30,50 @@ struct FunctionEliminationPass
 
 void FunctionEliminationPass::runOnOperation() {
   ModuleOp module = getOperation();
+  MLIRContext &context = getContext();
 
-  WalkResult result = module.walk([](mlir::CallOp op) -> WalkResult {
-    if (isa<llhd::ProcOp>(op->getParentOp()) ||
-        isa<llhd::EntityOp>(op->getParentOp())) {
-      return emitError(
-          op.getLoc(),
-          "Not all functions are inlined, there is at least "
-          "one function call left within a llhd.proc or llhd.entity.");
-    }
-    return WalkResult::advance();
-  });
-
-  if (result.wasInterrupted()) {
+  // Look for calls left in the units in parallel, as their bodies are large
+  // and independent.
+  SmallVector<Operation *, 0> units;
+  for (auto &op : module.getOps())
+    if (isa<llhd::ProcOp, llhd::EntityOp>(op))
+      units.push_back(&op);
+
+  std::atomic<bool> anyCalls{false};
+  auto checkUnit = [&](size_t index) {
+    WalkResult result = units[index]->walk([](mlir::CallOp op) -> WalkResult {
+      if (isa<llhd::ProcOp>(op->getParentOp()) ||
+          isa<llhd::EntityOp>(op->getParentOp())) {
+        return emitError(
+            op.getLoc(),
+            "Not all functions are inlined, there is at least "
+            "one function call left within a llhd.proc or llhd.entity.");
+      }
+      return WalkResult::advance();
+    });
+    if (result.wasInterrupted())
+      anyCalls = true;
+  };
+  if (context.isMultithreadingEnabled()) {
+    // Diagnostics are ordered by the position of the unit in the module.
+    mlir::ParallelDiagnosticHandler diagHandler(&context);
+    llvm::parallelForEachN(0, units.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      checkUnit(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = units.size(); i != e; ++i)
+      checkUnit(i);
+  }
+
+  if (anyCalls) {
     signalPassFailure();
     return;
   }
 
-  module.walk([](mlir::FuncOp op) { op.erase(); });
+  for (auto op : llvm::make_early_inc_range(module.getOps<mlir::FuncOp>()))
+    op.erase();
 }
 } // namespace
 
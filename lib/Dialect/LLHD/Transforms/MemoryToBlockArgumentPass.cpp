@@ -14,7 +14,7 @@
 #include "circt/Dialect/LLHD/Transforms/Passes.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/Dominance.h"
-#include <set>
+#include "llvm/ADT/BitVector.h"
 
 using namespace circt;
 
@@ -27,51 +27,52 @@ struct MemoryToBlockArgumentPass
 
 } // anonymous namespace
 
-/// Add the dominance fontier blocks of 'frontierOf' to the 'df' set
-static void getDominanceFrontier(Block *frontierOf, Operation *op,
-                                 std::set<Block *> &df) {
-  mlir::DominanceInfo dom(op);
-  for (Block &block : op->getRegion(0).getBlocks()) {
+/// Compute the dominance frontier of every block reachable from the entry
+/// block, indexed by the block numbers in `blockIndex`.
+static void
+getDominanceFrontiers(Region &region, mlir::DominanceInfo &dom,
+                      DenseMap<Block *, unsigned> &blockIndex,
+                      SmallVectorImpl<SmallVector<Block *, 2>> &frontiers) {
+  for (Block &block : region) {
+    if (block.hasNoPredecessors() ||
+        std::next(block.pred_begin()) == block.pred_end())
+      continue;
+    auto *node = dom.getNode(&block);
+    if (!node)
+      continue;
+    Block *idom = node->getIDom()->getBlock();
+    SmallPtrSet<Block *, 4> preds;
     for (Block *pred : block.getPredecessors()) {
-      if (dom.dominates(frontierOf, pred) &&
-          !dom.properlyDominates(frontierOf, &block) &&
-          block.getOps<llhd::VarOp>().empty()) {
-        df.insert(&block);
+      if (!preds.insert(pred).second || !dom.getNode(pred))
+        continue;
+      // Walk up the dominator tree from each predecessor to the immediate
+      // dominator of the join point, the blocks on the way have it in their
+      // frontier.
+      for (Block *runner = pred; runner != idom;
+           runner = dom.getNode(runner)->getIDom()->getBlock()) {
+        auto &frontier = frontiers[blockIndex[runner]];
+        if (frontier.empty() || frontier.back() != &block)
+          frontier.push_back(&block);
       }
     }
   }
 }
 
-/// Add the blocks in the closure of the dominance fontier relation of all the
-/// block in 'initialSet' to 'closure'
-static void getDFClosure(SmallVectorImpl<Block *> &initialSet, Operation *op,
-                         std::set<Block *> &closure) {
-  unsigned numElements;
-  for (Block *block : initialSet) {
-    getDominanceFrontier(block, op, closure);
-  }
-  do {
-    numElements = closure.size();
-    for (Block *block : closure) {
-      getDominanceFrontier(block, op, closure);
-    }
-  } while (numElements < closure.size());
-}
-
 /// Add a block argument to a given terminator. Only 'std.br', 'std.cond_br' and
-/// 'llhd.wait' are supported. The successor block has to be provided for the
-/// 'std.cond_br' terminator which has two possible successors.
+/// 'llhd.wait' are supported. The index of the successor has to be provided
+/// for the 'std.cond_br' terminator which has two possible successors.
 static void addBlockOperandToTerminator(Operation *terminator,
-                                        Block *successsor, Value toAppend) {
+                                        unsigned successorIndex,
+                                        Value toAppend) {
   if (auto wait = dyn_cast<llhd::WaitOp>(terminator)) {
     wait.destOpsMutable().append(toAppend);
   } else if (auto br = dyn_cast<mlir::BranchOp>(terminator)) {
     br.destOperandsMutable().append(toAppend);
   } else if (auto condBr = dyn_cast<mlir::CondBranchOp>(terminator)) {
-    if (condBr.falseDest() == successsor) {
-      condBr.falseDestOperandsMutable().append(toAppend);
-    } else {
+    if (successorIndex == 0) {
       condBr.trueDestOperandsMutable().append(toAppend);
+    } else {
+      condBr.falseDestOperandsMutable().append(toAppend);
     }
   } else {
     llvm_unreachable("unsupported terminator op");
@@ -80,7 +81,7 @@ static void addBlockOperandToTerminator(Operation *terminator,
 
 void MemoryToBlockArgumentPass::runOnOperation() {
   Operation *operation = getOperation();
-  OpBuilder builder(operation);
+  Region &region = operation->getRegion(0);
 
   // No operations that have their own region and are not isolated from above
   // are allowed for now.
@@ -90,152 +91,214 @@ void MemoryToBlockArgumentPass::runOnOperation() {
       return WalkResult::interrupt();
     return WalkResult::advance();
   });
-  if (result.wasInterrupted())
+  if (result.wasInterrupted()) {
+    markAllAnalysesPreserved();
     return;
+  }
 
-  // Get all variables defined in the body of this operation
+  // Only block arguments and memory operations are added below, the blocks
+  // and their dominance stay the same.
+  auto &dom = getAnalysis<mlir::DominanceInfo>();
+  auto isReachable = [&](Block *block) {
+    return block->isEntryBlock() || dom.getNode(block);
+  };
+
+  // Get all variables defined in the body of this operation which are only
+  // loaded from and stored to, in blocks reachable from the entry block.
   // Note that variables that are passed as a function argument are not
   // considered.
-  SmallVector<Value, 16> vars;
-  for (llhd::VarOp var : operation->getRegion(0).getOps<llhd::VarOp>()) {
-    vars.push_back(var.result());
+  SmallVector<llhd::VarOp, 16> vars;
+  DenseMap<Value, unsigned> varIndex;
+  for (llhd::VarOp var : region.getOps<llhd::VarOp>()) {
+    if (!isReachable(var->getBlock()))
+      continue;
+    bool promotable = llvm::all_of(var->getUses(), [&](OpOperand &use) {
+      Operation *user = use.getOwner();
+      if (!isReachable(user->getBlock()))
+        return false;
+      if (auto store = dyn_cast<llhd::StoreOp>(user))
+        return store.pointer() == var.result();
+      return isa<llhd::LoadOp>(user);
+    });
+    if (!promotable)
+      continue;
+    varIndex[var.result()] = vars.size();
+    vars.push_back(var);
+  }
+  if (vars.empty()) {
+    markAllAnalysesPreserved();
+    return;
   }
 
-  // Don't consider variables that are used in other operations than load and
-  // store (e.g. as an argument to a call)
-  for (auto var = vars.begin(); var != vars.end(); ++var) {
-    for (Operation *user : var->getUsers()) {
-      if (!isa<llhd::LoadOp>(user) && !isa<llhd::StoreOp>(user)) {
-        vars.erase(var--);
-        break;
-      }
-    }
+  // Number the blocks, for the block sets of every variable to be bit
+  // vectors.
+  DenseMap<Block *, unsigned> blockIndex;
+  SmallVector<Block *, 32> blocks;
+  for (Block &block : region) {
+    blockIndex[&block] = blocks.size();
+    blocks.push_back(&block);
   }
 
-  // For each variable find the blocks where a value is stored to it
-  for (Value var : vars) {
-    SmallVector<Block *, 16> defBlocks;
-    defBlocks.push_back(
-        var.getDefiningOp<llhd::VarOp>().getOperation()->getBlock());
-    operation->walk([&](llhd::StoreOp op) {
-      if (op.pointer() == var)
-        defBlocks.push_back(op.getOperation()->getBlock());
-    });
-    // Remove duplicates from the list
-    std::sort(defBlocks.begin(), defBlocks.end());
-    defBlocks.erase(std::unique(defBlocks.begin(), defBlocks.end()),
-                    defBlocks.end());
-
-    // Calculate initial set of join points
-    std::set<Block *> joinPoints;
-    getDFClosure(defBlocks, operation, joinPoints);
-
-    for (Block *jp : joinPoints) {
-      // Add a block argument for the variable at each join point
-      BlockArgument phi = jp->addArgument(
-          var.getType().cast<llhd::PtrType>().getUnderlyingType());
-
-      // Add a load at the end of every predecessor and pass the loaded value as
-      // the block argument
-      for (Block *pred : jp->getPredecessors()) {
-        // Set insertion point before terminator to insert the load operation
-        builder.setInsertionPoint(pred->getTerminator());
-        Value load = builder.create<llhd::LoadOp>(
-            pred->getTerminator()->getLoc(),
-            var.getType().cast<llhd::PtrType>().getUnderlyingType(), var);
-        // Add the loaded value as additional block argument
-        addBlockOperandToTerminator(pred->getTerminator(), jp, load);
+  // Find the blocks defining each variable, with a var or store operation,
+  // and the blocks reading the variable before defining it, in a single
+  // sweep over all the variables.
+  unsigned numBlocks = blocks.size();
+  SmallVector<llvm::BitVector, 16> defBlocks(vars.size(),
+                                             llvm::BitVector(numBlocks));
+  SmallVector<llvm::BitVector, 16> liveIn(vars.size(),
+                                          llvm::BitVector(numBlocks));
+  llvm::BitVector definedHere(vars.size());
+  for (Block *block : blocks) {
+    definedHere.reset();
+    unsigned index = blockIndex[block];
+    for (Operation &op : *block) {
+      Value pointer;
+      bool isDef = true;
+      if (auto var = dyn_cast<llhd::VarOp>(op)) {
+        pointer = var.result();
+      } else if (auto store = dyn_cast<llhd::StoreOp>(op)) {
+        pointer = store.pointer();
+      } else if (auto load = dyn_cast<llhd::LoadOp>(op)) {
+        pointer = load.pointer();
+        isDef = false;
+      }
+      if (!pointer)
+        continue;
+      auto it = varIndex.find(pointer);
+      if (it == varIndex.end())
+        continue;
+      if (isDef) {
+        defBlocks[it->second].set(index);
+        definedHere.set(it->second);
+      } else if (!definedHere.test(it->second)) {
+        liveIn[it->second].set(index);
       }
-      // Insert a store at the beginning of the join point to make removal of
-      // all the memory operations easier later on
-      builder.setInsertionPointToStart(jp);
-      builder.create<llhd::StoreOp>(jp->front().getLoc(), var, phi);
     }
+  }
 
-    // Basically reaching definitions analysis and replacing the loaded values
-    // by the values stored
-    DenseMap<Block *, Value> outputMap;
-    SmallPtrSet<Block *, 32> workQueue;
-    SmallPtrSet<Block *, 32> workDone;
+  SmallVector<SmallVector<Block *, 2>, 32> frontiers(numBlocks);
+  getDominanceFrontiers(region, dom, blockIndex, frontiers);
 
-    workQueue.insert(&operation->getRegion(0).front());
+  // Place a block argument for a variable at the iterated dominance frontier
+  // of its defining blocks, pruned to the blocks where it is live on entry.
+  using Phi = std::pair<unsigned, BlockArgument>;
+  DenseMap<Block *, SmallVector<Phi, 2>> phis;
+  auto getPhis = [&](Block *block) -> ArrayRef<Phi> {
+    auto it = phis.find(block);
+    return it == phis.end() ? ArrayRef<Phi>() : it->second;
+  };
+  SmallVector<Block *, 32> worklist;
+  llvm::BitVector hasPhi(numBlocks);
+  for (unsigned v = 0, e = vars.size(); v < e; ++v) {
+    // Propagate the liveness backwards up to the defining blocks.
+    for (unsigned b : liveIn[v].set_bits())
+      worklist.push_back(blocks[b]);
+    while (!worklist.empty()) {
+      Block *block = worklist.pop_back_val();
+      for (Block *pred : block->getPredecessors()) {
+        unsigned index = blockIndex[pred];
+        if (defBlocks[v].test(index) || liveIn[v].test(index))
+          continue;
+        liveIn[v].set(index);
+        worklist.push_back(pred);
+      }
+    }
 
-    while (!workQueue.empty()) {
-      // Pop block to process at the front
-      Block *block = *workQueue.begin();
-      workQueue.erase(block);
+    Type type = vars[v].init().getType();
+    hasPhi.reset();
+    for (unsigned b : defBlocks[v].set_bits())
+      worklist.push_back(blocks[b]);
+    while (!worklist.empty()) {
+      Block *block = worklist.pop_back_val();
+      for (Block *frontier : frontiers[blockIndex[block]]) {
+        unsigned index = blockIndex[frontier];
+        if (hasPhi.test(index) || !liveIn[v].test(index))
+          continue;
+        hasPhi.set(index);
+        phis[frontier].push_back({v, frontier->addArgument(type)});
+        if (!defBlocks[v].test(index))
+          worklist.push_back(frontier);
+      }
+    }
+  }
 
-      // Remember the currently stored value
-      Value currStoredValue;
+  // Rename the loaded values to the stored ones, walking the dominator tree
+  // with a stack of the current values of every variable.
+  SmallVector<SmallVector<Value, 4>, 16> values(vars.size());
+  SmallVector<std::pair<Block *, bool>, 32> stack;
+  DenseMap<Block *, SmallVector<unsigned, 4>> pushed;
+  stack.push_back({&region.front(), false});
+  while (!stack.empty()) {
+    auto entry = stack.pop_back_val();
+    Block *block = entry.first;
+    auto &blockPushed = pushed[block];
+    if (entry.second) {
+      for (unsigned v : blockPushed)
+        values[v].pop_back();
+      pushed.erase(block);
+      continue;
+    }
 
-      // Update the value stored for the current variable at the start of this
-      // block
-      for (Block *pred : block->getPredecessors()) {
-        // Get the value at the end of a predecessor block and set it to the
-        // currently stored value at the start of this block
-        // NOTE: because we added block arguments and a store at the beginning
-        // of each join point we can assume that all predecessors have the same
-        // value stored at their end here because if that is not the case the
-        // first instruction in this block is a store instruction and will
-        // update the currently stored value to a correct one
-        if (!currStoredValue && outputMap.count(pred)) {
-          currStoredValue = outputMap[pred];
-          break;
+    for (auto &phi : getPhis(block)) {
+      values[phi.first].push_back(phi.second);
+      blockPushed.push_back(phi.first);
+    }
+    for (Operation &op : llvm::make_early_inc_range(*block)) {
+      if (auto var = dyn_cast<llhd::VarOp>(op)) {
+        auto it = varIndex.find(var.result());
+        if (it != varIndex.end()) {
+          values[it->second].push_back(var.init());
+          blockPushed.push_back(it->second);
         }
-      }
-
-      // Iterate through all operations of the current block
-      for (auto op = block->begin(); op != block->end(); ++op) {
-        // Update currStoredValue at every store operation that stores to the
-        // variable we are currently considering
-        if (auto store = dyn_cast<llhd::StoreOp>(op)) {
-          if (store.pointer() == var) {
-            currStoredValue = store.value();
-            op = std::prev(op);
-            store.getOperation()->dropAllReferences();
-            store.erase();
-          }
-          // Set currStoredValue to the initializer value of the variable
-          // operation that created the variable we are currently considering,
-          // note that before that currStoredValue is uninitialized
-        } else if (auto varOp = dyn_cast<llhd::VarOp>(op)) {
-          if (varOp.result() == var)
-            currStoredValue = varOp.init();
-          // Replace the value returned by a load from the variable we are
-          // currently considering with the currStoredValue and delete the load
-          // operation
-        } else if (auto load = dyn_cast<llhd::LoadOp>(op)) {
-          if (load.pointer() == var && currStoredValue) {
-            op = std::prev(op);
-            load.result().replaceAllUsesWith(currStoredValue);
-            load.getOperation()->dropAllReferences();
-            load.erase();
-          }
+      } else if (auto store = dyn_cast<llhd::StoreOp>(op)) {
+        auto it = varIndex.find(store.pointer());
+        if (it != varIndex.end()) {
+          values[it->second].push_back(store.value());
+          blockPushed.push_back(it->second);
+          store.erase();
+        }
+      } else if (auto load = dyn_cast<llhd::LoadOp>(op)) {
+        auto it = varIndex.find(load.pointer());
+        if (it != varIndex.end()) {
+          load.result().replaceAllUsesWith(values[it->second].back());
+          load.erase();
         }
       }
+    }
 
-      if (currStoredValue)
-        outputMap.insert(std::make_pair(block, currStoredValue));
+    // Pass the current values to the block arguments of the successors.
+    Operation *terminator = block->getTerminator();
+    for (unsigned i = 0, e = terminator->getNumSuccessors(); i < e; ++i)
+      for (auto &phi : getPhis(terminator->getSuccessor(i)))
+        addBlockOperandToTerminator(terminator, i, values[phi.first].back());
 
-      workDone.insert(block);
+    stack.push_back({block, true});
+    if (auto *node = dom.getNode(block))
+      for (auto *child : node->children())
+        stack.push_back({child->getBlock(), false});
+  }
 
-      // Add all successors of this block to the work queue if they are not
-      // already processed
-      for (Block *succ : block->getSuccessors()) {
-        if (!workDone.count(succ))
-          workQueue.insert(succ);
-      }
+  // The unreachable predecessors of a join point pass the initial value, as
+  // there are no dominance requirements in unreachable code.
+  for (auto &entry : phis) {
+    SmallPtrSet<Block *, 4> preds;
+    for (Block *pred : entry.first->getPredecessors()) {
+      if (isReachable(pred) || !preds.insert(pred).second)
+        continue;
+      Operation *terminator = pred->getTerminator();
+      for (unsigned i = 0, e = terminator->getNumSuccessors(); i < e; ++i)
+        if (terminator->getSuccessor(i) == entry.first)
+          for (auto &phi : entry.second)
+            addBlockOperandToTerminator(terminator, i,
+                                        vars[phi.first].init());
     }
   }
 
-  // Remove all variable declarations for which we already removed all loads and
-  // stores
-  for (Value var : vars) {
-    Operation *op = var.getDefiningOp();
-    op->dropAllDefinedValueUses();
-    op->dropAllReferences();
-    op->erase();
-  }
+  // Remove all variable declarations, all their loads and stores are gone.
+  for (llhd::VarOp var : vars)
+    var.erase();
+
+  markAnalysesPreserved<mlir::DominanceInfo>();
 }
 
 std::unique_ptr<OperationPass<llhd::ProcOp>>
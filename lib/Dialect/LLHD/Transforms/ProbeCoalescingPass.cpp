@@ -0,0 +1,126 @@
+//===- ProbeCoalescingPass.cpp - Implement Probe Coalescing Pass ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implement pass to replace the probes of a signal within a temporal region
+// by a single one.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "TemporalRegions.h"
+#include "circt/Dialect/LLHD/Transforms/Passes.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Dominance.h"
+#include "llvm/ADT/MapVector.h"
+
+using namespace circt;
+using namespace llhd;
+
+namespace {
+struct ProbeCoalescingPass
+    : public llhd::ProbeCoalescingBase<ProbeCoalescingPass> {
+  void runOnOperation() override;
+
+private:
+  void coalesceProbes(EntityOp entity);
+  void coalesceProbes(ProcOp proc);
+
+  /// Replace `probe` by `leader`, which probes the same signal.
+  void replaceProbe(PrbOp probe, PrbOp leader) {
+    probe.replaceAllUsesWith(leader.result());
+    probe.erase();
+    ++numProbesRemoved;
+  }
+};
+} // namespace
+
+/// An entity runs all its operations at once, so all the probes of a signal
+/// can use the first one. Entities are graph regions: the first probe cannot
+/// follow any use of the others that does not already precede its definition.
+void ProbeCoalescingPass::coalesceProbes(EntityOp entity) {
+  DenseMap<Value, PrbOp> leaders;
+  for (auto probe :
+       llvm::make_early_inc_range(entity.getBodyBlock()->getOps<PrbOp>())) {
+    auto it = leaders.try_emplace(probe.signal(), probe);
+    if (!it.second)
+      replaceProbe(probe, it.first->second);
+  }
+}
+
+/// A process only observes the signals changing at a wait, so the probes of
+/// a signal within a temporal region all read the same value. They are
+/// replaced by a single probe in the entry block of the region, if that block
+/// dominates them and the signal is available there. Otherwise, a probe is
+/// only replaced by another one dominating it.
+void ProbeCoalescingPass::coalesceProbes(ProcOp proc) {
+  auto &trAnalysis = getChildAnalysis<TemporalRegionAnalysis>(proc);
+  auto &dom = getChildAnalysis<mlir::DominanceInfo>(proc);
+
+  for (int tr = -1, e = trAnalysis.getNumTemporalRegions(); tr < e; ++tr) {
+    llvm::MapVector<Value, SmallVector<PrbOp, 2>> probes;
+    for (Block *block : trAnalysis.getBlocksInTR(tr))
+      for (auto probe : block->getOps<PrbOp>())
+        probes[probe.signal()].push_back(probe);
+
+    Block *entry = trAnalysis.getTREntryBlock(tr);
+    for (auto &signalProbes : probes) {
+      Value signal = signalProbes.first;
+      auto &group = signalProbes.second;
+      if (group.size() < 2)
+        continue;
+
+      bool canHoist =
+          entry && dom.dominates(signal.getParentBlock(), entry) &&
+          llvm::all_of(group, [&](PrbOp probe) {
+            return dom.dominates(entry, probe->getBlock());
+          });
+      if (canHoist) {
+        auto leader = group.front();
+        auto *def = signal.getDefiningOp();
+        if (def && def->getBlock() == entry)
+          leader->moveAfter(def);
+        else
+          leader->moveBefore(&entry->front());
+        for (auto probe : llvm::drop_begin(group, 1))
+          replaceProbe(probe, leader);
+        ++numProbesHoisted;
+        continue;
+      }
+
+      SmallVector<PrbOp, 2> leaders;
+      for (auto probe : group) {
+        auto leader = llvm::find_if(leaders, [&](PrbOp leader) {
+          return dom.properlyDominates(leader.getOperation(),
+                                       probe.getOperation());
+        });
+        if (leader != leaders.end())
+          replaceProbe(probe, *leader);
+        else
+          leaders.push_back(probe);
+      }
+    }
+  }
+}
+
+void ProbeCoalescingPass::runOnOperation() {
+  for (auto &op : *getOperation().getBody()) {
+    if (auto entity = dyn_cast<EntityOp>(op))
+      coalesceProbes(entity);
+    else if (auto proc = dyn_cast<ProcOp>(op))
+      coalesceProbes(proc);
+  }
+
+  // Probes are only moved within their temporal region, the control flow is
+  // unchanged.
+  markAnalysesPreserved<TemporalRegionAnalysis, mlir::DominanceInfo>();
+}
+
+std::unique_ptr<OperationPass<ModuleOp>>
+circt::llhd::createProbeCoalescingPass() {
+  return std::make_unique<ProbeCoalescingPass>();
+}
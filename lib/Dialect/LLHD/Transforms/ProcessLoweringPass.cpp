@@ -14,7 +14,10 @@
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "circt/Dialect/LLHD/Transforms/Passes.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/Visitors.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 using namespace circt;
 
@@ -24,113 +27,138 @@ struct ProcessLoweringPass
     : public llhd::ProcessLoweringBase<ProcessLoweringPass> {
   void runOnOperation() override;
 };
+} // namespace
 
-void ProcessLoweringPass::runOnOperation() {
-  ModuleOp module = getOperation();
-
-  WalkResult result = module.walk([](llhd::ProcOp op) -> WalkResult {
-    // Check invariants
-    size_t numBlocks = op.body().getBlocks().size();
-    if (numBlocks == 1) {
-      if (!isa<llhd::HaltOp>(op.body().back().getTerminator())) {
-        return op.emitOpError("Process-lowering: Entry block is required to be "
-                              "terminated by a HaltOp from the LLHD dialect.");
-      }
-    } else if (numBlocks == 2) {
-      Block &first = op.body().front();
-      Block &last = op.body().back();
-      if (last.getArguments().size() != 0) {
-        return op.emitOpError(
-            "Process-lowering: The second block (containing the "
-            "llhd.wait) is not allowed to have arguments.");
-      }
-      if (!isa<mlir::BranchOp>(first.getTerminator())) {
-        return op.emitOpError(
-            "Process-lowering: The first block has to be terminated "
-            "by a BranchOp from the standard dialect.");
+/// Check that a process can be lowered to an entity, and bring its body into
+/// the form of an entity body. This only modifies the body of the process,
+/// and thus runs on all the processes in parallel.
+static LogicalResult lowerProcessBody(llhd::ProcOp op) {
+  // Check invariants
+  size_t numBlocks = op.body().getBlocks().size();
+  if (numBlocks == 1) {
+    if (!isa<llhd::HaltOp>(op.body().back().getTerminator())) {
+      return op.emitOpError("Process-lowering: Entry block is required to be "
+                            "terminated by a HaltOp from the LLHD dialect.");
+    }
+  } else if (numBlocks == 2) {
+    Block &first = op.body().front();
+    Block &last = op.body().back();
+    if (last.getArguments().size() != 0) {
+      return op.emitOpError(
+          "Process-lowering: The second block (containing the "
+          "llhd.wait) is not allowed to have arguments.");
+    }
+    if (!isa<mlir::BranchOp>(first.getTerminator())) {
+      return op.emitOpError(
+          "Process-lowering: The first block has to be terminated "
+          "by a BranchOp from the standard dialect.");
+    }
+    if (auto wait = dyn_cast<llhd::WaitOp>(last.getTerminator())) {
+      // No optional time argument is allowed
+      if (wait.time()) {
+        return wait.emitOpError(
+            "Process-lowering: llhd.wait terminators with optional time "
+            "argument cannot be lowered to structural LLHD.");
       }
-      if (auto wait = dyn_cast<llhd::WaitOp>(last.getTerminator())) {
-        // No optional time argument is allowed
-        if (wait.time()) {
+      // Every probed signal has to occur in the observed signals list in
+      // the wait instruction
+      WalkResult result = op.walk([&wait](llhd::PrbOp prbOp) -> WalkResult {
+        if (!llvm::is_contained(wait.obs(), prbOp.signal())) {
           return wait.emitOpError(
-              "Process-lowering: llhd.wait terminators with optional time "
-              "argument cannot be lowered to structural LLHD.");
+              "Process-lowering: The wait terminator is required to have "
+              "all probed signals as arguments!");
         }
-        // Every probed signal has to occur in the observed signals list in
-        // the wait instruction
-        WalkResult result = op.walk([&wait](llhd::PrbOp prbOp) -> WalkResult {
-          if (!llvm::is_contained(wait.obs(), prbOp.signal())) {
-            return wait.emitOpError(
-                "Process-lowering: The wait terminator is required to have "
-                "all probed signals as arguments!");
-          }
-          return WalkResult::advance();
-        });
-        if (result.wasInterrupted()) {
-          return result;
-        }
-      } else {
-        return op.emitOpError(
-            "Process-lowering: The second block must be terminated by "
-            "a WaitOp from the LLHD dialect.");
-      }
+        return WalkResult::advance();
+      });
+      if (result.wasInterrupted())
+        return failure();
     } else {
       return op.emitOpError(
-          "Process-lowering only supports processes with either one basic "
-          "block terminated by a llhd.halt operation or two basic blocks where "
-          "the first one contains a std.br terminator and the second one "
-          "is terminated by a llhd.wait operation.");
+          "Process-lowering: The second block must be terminated by "
+          "a WaitOp from the LLHD dialect.");
     }
+  } else {
+    return op.emitOpError(
+        "Process-lowering only supports processes with either one basic "
+        "block terminated by a llhd.halt operation or two basic blocks where "
+        "the first one contains a std.br terminator and the second one "
+        "is terminated by a llhd.wait operation.");
+  }
 
-    OpBuilder builder(op);
+  // In the case that wait is used to suspend the process, we need to merge
+  // the two blocks as we needed the second block to have a target for wait
+  // (the entry block cannot be targeted).
+  if (numBlocks == 2) {
+    Block &first = op.body().front();
+    Block &second = op.body().back();
+    // Delete the BranchOp operation in the entry block
+    first.getTerminator()->dropAllReferences();
+    first.getTerminator()->erase();
+    // Move operations of second block in entry block.
+    first.getOperations().splice(first.end(), second.getOperations());
+    // Drop all references to the second block and delete it.
+    second.dropAllReferences();
+    second.dropAllDefinedValueUses();
+    second.erase();
+  }
 
-    // Replace proc with entity
+  // Replace the llhd.halt or llhd.wait with the implicit entity terminator
+  OpBuilder builder = OpBuilder::atBlockEnd(&op.body().front());
+  Operation *terminator = op.body().front().getTerminator();
+  builder.create<llhd::TerminatorOp>(terminator->getLoc());
+  terminator->dropAllReferences();
+  terminator->dropAllUses();
+  terminator->erase();
+  return success();
+}
+
+void ProcessLoweringPass::runOnOperation() {
+  ModuleOp module = getOperation();
+  MLIRContext &context = getContext();
+  SmallVector<llhd::ProcOp, 0> procs(module.getOps<llhd::ProcOp>());
+
+  std::atomic<bool> anyFailed{false};
+  auto lowerBody = [&](size_t index) {
+    if (failed(lowerProcessBody(procs[index])))
+      anyFailed = true;
+  };
+  if (context.isMultithreadingEnabled()) {
+    // Diagnostics are ordered by the position of the process in the module.
+    mlir::ParallelDiagnosticHandler diagHandler(&context);
+    llvm::parallelForEachN(0, procs.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      lowerBody(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = procs.size(); i != e; ++i)
+      lowerBody(i);
+  }
+  if (anyFailed) {
+    signalPassFailure();
+    return;
+  }
+
+  // Replace the processes with entities, which modifies the module and thus
+  // happens serially. The bodies are moved over without being walked.
+  for (auto op : procs) {
+    OpBuilder builder(op);
     llhd::EntityOp entity =
         builder.create<llhd::EntityOp>(op.getLoc(), op.ins());
     // Set the symbol name of the entity to the same as the process (as the
     // process gets deleted anyways).
     entity.setName(op.getName());
-    // Move all blocks from the process to the entity, the process does not have
-    // a region afterwards.
+    // Move all blocks from the process to the entity, the process does not
+    // have a region afterwards.
     entity.body().takeBody(op.body());
     entity->setAttr("type", op->getAttr("type"));
-    // In the case that wait is used to suspend the process, we need to merge
-    // the two blocks as we needed the second block to have a target for wait
-    // (the entry block cannot be targeted).
-    if (entity.body().getBlocks().size() == 2) {
-      Block &first = entity.body().front();
-      Block &second = entity.body().back();
-      // Delete the BranchOp operation in the entry block
-      first.getTerminator()->dropAllReferences();
-      first.getTerminator()->erase();
-      // Move operations of second block in entry block.
-      first.getOperations().splice(first.end(), second.getOperations());
-      // Drop all references to the second block and delete it.
-      second.dropAllReferences();
-      second.dropAllDefinedValueUses();
-      second.erase();
-    }
 
     // Delete the process as it is now replaced by an entity.
     op.getOperation()->dropAllReferences();
     op.getOperation()->dropAllDefinedValueUses();
     op.getOperation()->erase();
-
-    // Replace the llhd.halt or llhd.wait with the implicit entity terminator
-    builder.setInsertionPointToEnd(&entity.body().front());
-    Operation *terminator = entity.body().front().getTerminator();
-    builder.create<llhd::TerminatorOp>(terminator->getLoc());
-    terminator->dropAllReferences();
-    terminator->dropAllUses();
-    terminator->erase();
-
-    return WalkResult::advance();
-  });
-
-  if (result.wasInterrupted())
-    signalPassFailure();
+  }
 }
-} // namespace
 
 std::unique_ptr<OperationPass<ModuleOp>>
 circt::llhd::createProcessLoweringPass() {
@@ -13,103 +13,87 @@
 
 #include "TemporalRegions.h"
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/BitVector.h"
 
 using namespace circt;
 
-static void addBlockToTR(Block *block, int tr, DenseMap<Block *, int> &blockMap,
-                         DenseMap<int, SmallVector<Block *, 8>> &trMap) {
-  blockMap.insert(std::make_pair(block, tr));
-  SmallVector<Block *, 8> b;
-  b.push_back(block);
-  trMap.insert(std::make_pair(tr, b));
-}
-
 static bool anyPredecessorHasWait(Block *block) {
   return std::any_of(block->pred_begin(), block->pred_end(), [](Block *pred) {
     return isa<llhd::WaitOp>(pred->getTerminator());
   });
 }
 
-static bool allPredecessorTRsKnown(Block *block,
-                                   SmallPtrSetImpl<Block *> &known) {
-  return std::all_of(block->pred_begin(), block->pred_end(), [&](Block *pred) {
-    return std::find(known.begin(), known.end(), pred) != known.end();
-  });
-}
-
 void llhd::TemporalRegionAnalysis::recalculate(Operation *operation) {
   assert(isa<ProcOp>(operation) &&
          "TemporalRegionAnalysis: operation needs to be llhd::ProcOp");
   ProcOp proc = cast<ProcOp>(operation);
-  int nextTRnum = -1;
   blockMap.clear();
   trMap.clear();
 
-  SmallPtrSet<Block *, 32> workQueue;
-  SmallPtrSet<Block *, 32> workDone;
-
-  // Add the entry block and all blocks targeted by a wait terminator to the
-  // initial work queue because they are always the entry block of a new TR
-  workQueue.insert(&proc.body().front());
-  proc.walk([&](WaitOp wait) { workQueue.insert(wait.dest()); });
-
-  while (!workQueue.empty()) {
-    // Find basic block in the work queue which has all predecessors already
-    // processed or at least one predecessor has a wait terminator
-    auto iter =
-        std::find_if(workQueue.begin(), workQueue.end(), [&](Block *block) {
-          return allPredecessorTRsKnown(block, workDone) ||
-                 anyPredecessorHasWait(block);
-        });
-
-    // If no element in the work queue has all predecessors finished or is
-    // targeted by a wait, there is probably a loop within a TR, in this case we
-    // are conservatively assign a new temporal region
-    if (iter == workQueue.end())
-      iter = workQueue.begin();
-
-    // This is the current block to be processed
-    Block *block = *iter;
-
-    // Delete this block from the work queue and add it to the list of alredy
-    // processed blocks
-    workQueue.erase(block);
-    workDone.insert(block);
+  // Number the blocks, for the sets of blocks below to be bit vectors.
+  DenseMap<Block *, unsigned> blockIndex;
+  for (Block &block : proc.body()) {
+    unsigned index = blockIndex.size();
+    blockIndex[&block] = index;
+  }
 
-    // Add all successors of this block which were not already processed to the
-    // work queue
-    for (Block *succ : block->getSuccessors()) {
-      if (!workDone.count(succ))
-        workQueue.insert(succ);
+  // Compute a post-order of the blocks reachable from the entry block, and
+  // then of the ones only reachable from a wait, as these start a new TR
+  // anyway.
+  SmallVector<Block *, 32> postOrder;
+  llvm::BitVector visited(blockIndex.size());
+  SmallVector<std::pair<Block *, Block::succ_iterator>, 16> stack;
+  auto visit = [&](Block *root) {
+    if (visited.test(blockIndex[root]))
+      return;
+    visited.set(blockIndex[root]);
+    stack.push_back({root, root->succ_begin()});
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      if (top.second == top.first->succ_end()) {
+        postOrder.push_back(top.first);
+        stack.pop_back();
+        continue;
+      }
+      Block *succ = *top.second++;
+      if (!visited.test(blockIndex[succ])) {
+        visited.set(blockIndex[succ]);
+        stack.push_back({succ, succ->succ_begin()});
+      }
     }
-
-    // The entry block is always assigned -1 as a placeholder as this block must
-    // not contain any temporal operations
+  };
+  visit(&proc.body().front());
+  proc.walk([&](WaitOp wait) { visit(wait.dest()); });
+
+  // In reverse post-order, all the predecessors of a block are assigned a TR
+  // before the block itself, except along the back edges of loops. A block
+  // inherits the TR of its predecessors if they all have the same one and
+  // none of them is terminated by a wait. Otherwise, including for the
+  // headers of loops within a TR, it conservatively starts a new TR.
+  llvm::BitVector known(blockIndex.size());
+  int nextTRnum = 0;
+  for (Block *block : llvm::reverse(postOrder)) {
+    int tr;
+    // The entry block is always assigned -1 as a placeholder as this block
+    // must not contain any temporal operations
     if (block->isEntryBlock()) {
-      addBlockToTR(block, -1, blockMap, trMap);
-      // If at least one predecessor has a wait terminator or at least one
-      // predecessor has an unknown temporal region or not all predecessors have
-      // the same TR, create a new TR
-    } else if (!allPredecessorTRsKnown(block, workDone) ||
-               anyPredecessorHasWait(block) ||
-               !(std::adjacent_find(block->pred_begin(), block->pred_end(),
-                                    [&](Block *pred1, Block *pred2) {
-                                      return blockMap[pred1] != blockMap[pred2];
-                                    }) == block->pred_end())) {
-      addBlockToTR(block, ++nextTRnum, blockMap, trMap);
-      // If all predecessors have the same TR and none has a wait terminator,
-      // inherit the TR
+      tr = -1;
+    } else if (!block->hasNoPredecessors() && !anyPredecessorHasWait(block) &&
+               llvm::all_of(block->getPredecessors(), [&](Block *pred) {
+                 return known.test(blockIndex[pred]) &&
+                        blockMap.lookup(pred) ==
+                            blockMap.lookup(*block->pred_begin());
+               })) {
+      tr = blockMap.lookup(*block->pred_begin());
     } else {
-      int tr = blockMap[*block->pred_begin()];
-      blockMap.insert(std::make_pair(block, tr));
-      trMap[tr].push_back(block);
-      trMap[tr].erase(std::unique(trMap[tr].begin(), trMap[tr].end()),
-                      trMap[tr].end());
+      tr = nextTRnum++;
     }
+    blockMap[block] = tr;
+    trMap[tr].push_back(block);
+    known.set(blockIndex[block]);
   }
 
-  numTRs = nextTRnum + 1;
+  numTRs = nextTRnum;
 }
 
 int llhd::TemporalRegionAnalysis::getBlockTR(Block *block) {
@@ -15,11 +15,17 @@
 #define DIALECT_LLHD_TRANSFORMS_TEMPORALREGIONS_H
 
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Dominance.h"
 #include "mlir/IR/Operation.h"
+#include "mlir/Pass/AnalysisManager.h"
 
 namespace circt {
 namespace llhd {
 
+/// The temporal regions of an `llhd.proc`. This is an analysis of the pass
+/// manager, computed in a single pass over the blocks in reverse post-order.
+/// As the regions only depend on the control flow, the analysis stays valid
+/// as long as the passes preserve it or the dominance information.
 struct TemporalRegionAnalysis {
   using BlockMapT = DenseMap<Block *, int>;
   using TRMapT = DenseMap<int, SmallVector<Block *, 8>>;
@@ -28,6 +34,11 @@ struct TemporalRegionAnalysis {
 
   void recalculate(Operation *);
 
+  bool isInvalidated(const mlir::AnalysisManager::PreservedAnalyses &pa) {
+    return !pa.isPreserved<TemporalRegionAnalysis>() &&
+           !pa.isPreserved<mlir::DominanceInfo>();
+  }
+
   unsigned getNumTemporalRegions() { return numTRs; }
 
   int getBlockTR(Block *);
@@ -0,0 +1,77 @@
+//===- PlacementDB.cpp - Database of placed entities ----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/MSFT/PlacementDB.h"
+
+#include "mlir/IR/Operation.h"
+
+using namespace circt;
+using namespace msft;
+
+LogicalResult PlacementDB::addPlacement(PhysLocationAttr loc,
+                                        PlacedInstance inst) {
+  auto existing = locations.find(loc);
+  if (existing != locations.end()) {
+    auto &other = placements[existing->second].second;
+    auto diag = inst.op->emitError("Could not place '")
+                << inst.path << "' since its location is already occupied "
+                << "by '" << other.path << "'";
+    diag.attachNote(other.op->getLoc()) << "other placement is here";
+    return failure();
+  }
+
+  locations[loc] = placements.size();
+  opPlacements[inst.op].push_back(placements.size());
+  grid[getCell(loc.getDevType().getValue(), loc.getX(), loc.getY())]
+      .push_back(loc);
+  placements.push_back({loc, std::move(inst)});
+  return success();
+}
+
+const PlacementDB::PlacedInstance *
+PlacementDB::getInstanceAt(PhysLocationAttr loc) const {
+  auto it = locations.find(loc);
+  if (it == locations.end())
+    return nullptr;
+  return &placements[it->second].second;
+}
+
+void PlacementDB::getPlacementsOf(
+    Operation *op, SmallVectorImpl<PhysLocationAttr> &locs) const {
+  auto it = opPlacements.find(op);
+  if (it == opPlacements.end())
+    return;
+  for (unsigned index : it->second)
+    locs.push_back(placements[index].first);
+}
+
+void PlacementDB::getNearby(DeviceType devType, uint64_t x, uint64_t y,
+                            uint64_t radius,
+                            SmallVectorImpl<PhysLocationAttr> &locs) const {
+  uint64_t minX = x > radius ? x - radius : 0;
+  uint64_t minY = y > radius ? y - radius : 0;
+  uint64_t maxX = x + radius, maxY = y + radius;
+
+  // Only the cells overlapping the bounding box need to be looked at.
+  for (uint64_t cellX = minX / gridSize; cellX <= maxX / gridSize; ++cellX)
+    for (uint64_t cellY = minY / gridSize; cellY <= maxY / gridSize; ++cellY) {
+      auto cell = grid.find(GridCell((unsigned)devType, cellX, cellY));
+      if (cell == grid.end())
+        continue;
+      for (auto loc : cell->second)
+        if (loc.getX() >= minX && loc.getX() <= maxX && loc.getY() >= minY &&
+            loc.getY() <= maxY)
+          locs.push_back(loc);
+    }
+}
+
+void PlacementDB::walkPlacements(
+    function_ref<void(PhysLocationAttr, const PlacedInstance &)> fn) const {
+  for (auto &placement : placements)
+    fn(placement.first, placement.second);
+}
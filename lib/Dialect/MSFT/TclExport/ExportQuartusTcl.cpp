@@ -13,6 +13,7 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/MSFT/ExportTcl.h"
 #include "circt/Dialect/MSFT/MSFTAttributes.h"
+#include "circt/Dialect/MSFT/PlacementDB.h"
 #include "circt/Support/LLVM.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/StringSet.h"
@@ -40,6 +41,9 @@ struct TclOutputState {
   /// Track which modules have been examined so we can issue warnings for
   /// instance-specific annotations if we write out the same one twice.
   SmallPtrSet<Operation *, 32> modulesEmitted;
+
+  /// The placements of the module currently being emitted.
+  PlacementDB *placements = nullptr;
 };
 } // anonymous namespace
 
@@ -48,22 +52,25 @@ namespace {
 /// particular instance in the module-instance hierarchy.
 struct Entity {
   Entity(TclOutputState &s)
-      : s(s), parent(nullptr), name("$parent"), insideEmittedModule(false) {}
+      : s(s), parent(nullptr), name("$parent"), path("$parent|"),
+        insideEmittedModule(false) {}
   Entity(Entity *parent, StringRef name, bool insideEmittedModule)
       : s(parent->s), parent(parent), name(name),
+        path((Twine(parent->path) + name + "|").str()),
         insideEmittedModule(insideEmittedModule) {}
 
   /// Return the entity inside this instance.
   Optional<Entity> enter(InstanceOp inst);
-  /// Emit a physical location tcl command.
+  /// Record the physical location of an entity.
   LogicalResult emit(Operation *, StringRef attrName, StringRef instName,
                      PhysLocationAttr);
-  /// Emit the entity hierarchy.
-  void emitPath();
 
   TclOutputState &s;
   Entity *parent;
   StringRef name;
+  /// The entity hierarchy up to and including this entity, separated by '|'.
+  /// It is built once per entity, and shared by all the placements within.
+  std::string path;
   bool insideEmittedModule;
 
   StringSet<> emittedAttrKeys;
@@ -81,8 +88,8 @@ Optional<Entity> Entity::enter(InstanceOp inst) {
   return Entity(this, inst.instanceName(), modEmitted);
 }
 
-/// Emit tcl in the form of:
-/// "set_location_assignment MPDSP_X34_Y285_N0 -to $parent|fooInst|entityName"
+/// Add the location to the placements of the current module, which are
+/// emitted once the whole module has been visited.
 LogicalResult Entity::emit(Operation *op, StringRef attrKey, StringRef instName,
                            PhysLocationAttr pla) {
   if (insideEmittedModule)
@@ -98,6 +105,30 @@ LogicalResult Entity::emit(Operation *op, StringRef attrKey, StringRef instName,
   if (childEntity.empty())
     return op->emitError("Entity name cannot be empty in 'loc:<entityName>'");
 
+  // To which entity does this apply?
+  std::string entityPath = path;
+  llvm::raw_string_ostream pathStream(entityPath);
+  // If instance name is specified, add it in between the parent entity path and
+  // the child entity patch.
+  if (!instName.empty())
+    pathStream << instName << '|';
+  else if (auto name = op->getAttrOfType<StringAttr>("name"))
+    pathStream << name.getValue() << '|';
+  pathStream << childEntity;
+
+  emittedAttrKeys.insert(attrKey);
+
+  // The placements of a module instantiated more than once were emitted with
+  // its first instance, and would overlap with themselves.
+  if (insideEmittedModule)
+    return success();
+  return s.placements->addPlacement(pla, {pathStream.str(), op});
+}
+
+/// Emit tcl in the form of:
+/// "set_location_assignment MPDSP_X34_Y285_N0 -to $parent|fooInst|entityName"
+static void emitPlacement(TclOutputState &s, PhysLocationAttr pla,
+                          const PlacementDB::PlacedInstance &inst) {
   s.indent() << "set_location_assignment ";
 
   // Different devices have different 'number' letters (the 'N' in 'N0'). M20Ks
@@ -119,26 +150,7 @@ LogicalResult Entity::emit(Operation *op, StringRef attrKey, StringRef instName,
   s.os << "_X" << pla.getX() << "_Y" << pla.getY() << "_" << numCharacter
        << pla.getNum();
 
-  // To which entity does this apply?
-  s.os << " -to ";
-  emitPath();
-  // If instance name is specified, add it in between the parent entity path and
-  // the child entity patch.
-  if (!instName.empty())
-    s.os << instName << '|';
-  else if (auto name = op->getAttrOfType<StringAttr>("name"))
-    s.os << name.getValue() << '|';
-  s.os << childEntity << '\n';
-
-  emittedAttrKeys.insert(attrKey);
-  return success();
-}
-
-void Entity::emitPath() {
-  if (parent)
-    parent->emitPath();
-  // Names are separated by '|'.
-  s.os << name << "|";
+  s.os << " -to " << inst.path << '\n';
 }
 
 /// Export the TCL for a particular entity, corresponding to op. Do this
@@ -168,12 +180,14 @@ static LogicalResult exportTcl(Entity &entity, Operation *op) {
         return failure();
   }
 
-  auto result = op->walk([&](Operation *innerOp) {
-    if (innerOp != op && failed(exportTcl(entity, innerOp)))
-      return mlir::WalkResult::interrupt();
-    return mlir::WalkResult::advance();
-  });
-  return failure(result.wasInterrupted());
+  // Descend into the nested operations. Each of them visits its own nested
+  // operations, so only the immediate children are visited here.
+  for (auto &region : op->getRegions())
+    for (auto &block : region)
+      for (auto &innerOp : block)
+        if (failed(exportTcl(entity, &innerOp)))
+          return failure();
+  return success();
 }
 
 /// Write out all the relevant tcl commands. Create one 'proc' per module (since
@@ -188,10 +202,17 @@ LogicalResult circt::msft::exportQuartusTcl(ModuleOp module,
     auto hwMod = dyn_cast<HWModuleOp>(op);
     if (!hwMod)
       continue;
-    os << "proc " << hwMod.getName() << "_config { parent } {\n";
+    PlacementDB placements;
+    state.placements = &placements;
     Entity entity(state);
     if (failed(exportTcl(entity, hwMod)))
       return failure();
+
+    os << "proc " << hwMod.getName() << "_config { parent } {\n";
+    placements.walkPlacements(
+        [&](PhysLocationAttr pla, const PlacementDB::PlacedInstance &inst) {
+          emitPlacement(state, pla, inst);
+        });
     os << "}\n\n";
   }
   return success();
@@ -19,7 +19,6 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
-#include "llvm/Support/ManagedStatic.h"
 
 using namespace circt;
 using namespace circt::sv;
@@ -47,23 +46,31 @@ void SVDialect::initialize() {
 // Name conflict resolution
 //===----------------------------------------------------------------------===//
 
-/// Return a StringSet that contains all of the reserved names (e.g. Verilog
-/// keywords) that we need to avoid for fear of name conflicts.
-struct ReservedWordsCreator {
-  static void *call() {
-    auto set = std::make_unique<StringSet<>>();
-    static const char *const reservedWords[] = {
+/// Return true if the name is a reserved word (e.g. a Verilog or VHDL keyword)
+/// that we need to avoid to prevent naming conflicts.  The set is built once,
+/// on first use, and is only read afterwards, so it is safe to query from
+/// multiple threads.
+static bool isReservedWord(StringRef name) {
+  struct ReservedWords {
+    ReservedWords() {
+      static const char *const words[] = {
 #include "ReservedWords.def"
-    };
-    for (auto *word : reservedWords)
-      set->insert(word);
-    return set.release();
-  }
-};
+      };
+      for (auto *word : words) {
+        set.insert(word);
+        maxLength = std::max(maxLength, strlen(word));
+      }
+    }
+    StringSet<> set;
+    size_t maxLength = 0;
+  };
+  static const ReservedWords reservedWords;
 
-/// A StringSet that contains all of the reserved names (e.g., Verilog and VHDL
-/// keywords) that we need to avoid to prevent naming conflicts.
-static llvm::ManagedStatic<StringSet<>, ReservedWordsCreator> reservedWords;
+  // Most names are longer than any keyword, don't bother hashing those.
+  if (name.size() > reservedWords.maxLength)
+    return false;
+  return reservedWords.set.count(name);
+}
 
 /// Given string \p origName, generate a new name if it conflicts with any
 /// keyword or any other name in the set \p recordNames. Use the int \p
@@ -72,12 +79,11 @@ static llvm::ManagedStatic<StringSet<>, ReservedWordsCreator> reservedWords;
 StringRef circt::sv::resolveKeywordConflict(StringRef origName,
                                             llvm::StringSet<> &recordNames,
                                             size_t &nextGeneratedNameID) {
-  // Get the list of reserved words we need to avoid.  We could prepopulate this
-  // into the used words cache, but it is large and immutable, so we just query
-  // it when needed.
+  // We could prepopulate the reserved words into the used words cache, but the
+  // set is large and immutable, so we just query it when needed.
 
   // Fast path: name is valid
-  if (!reservedWords->count(origName)) {
+  if (!isReservedWord(origName)) {
     auto itAndInserted = recordNames.insert(origName);
     if (itAndInserted.second)
       return itAndInserted.first->getKey();
@@ -159,5 +165,5 @@ bool circt::sv::isNameValid(StringRef name) {
     if (!isValidVerilogCharacter(ch))
       return false;
   }
-  return reservedWords->count(name) == 0;
+  return !isReservedWord(name);
 }
@@ -15,9 +15,16 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVPasses.h"
 #include "mlir/IR/Builders.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace circt;
 using namespace sv;
@@ -29,13 +36,32 @@ using namespace hw;
 
 namespace {
 
+/// One invocation of the generator program.  Generated modules with the same
+/// arguments share a request, so the generator runs once for them.
+struct GeneratorRequest {
+  /// The arguments, starting with the executable.
+  SmallVector<std::string> args;
+  /// The key of the request in the on-disk cache.
+  std::string cacheKey;
+  /// The first line of the generator output, once it has run.
+  std::string output;
+  /// Why the request failed, or empty if it succeeded.
+  std::string error;
+  /// The generated modules the request was made for.
+  SmallVector<HWModuleGeneratedOp, 1> modules;
+};
+
 struct HWGeneratorCalloutPass
     : public sv::HWGeneratorCalloutPassBase<HWGeneratorCalloutPass> {
   void runOnOperation() override;
 
-  void processGenerator(HWModuleGeneratedOp generatedModuleOp,
-                        StringRef generatorExe,
-                        ArrayRef<StringRef> extraGeneratorArgs);
+  LogicalResult getGeneratorArgs(HWModuleGeneratedOp generatedModuleOp,
+                                 StringRef generatorExe,
+                                 ArrayRef<StringRef> extraGeneratorArgs,
+                                 SmallVectorImpl<std::string> &generatorArgs);
+  void runGenerator(GeneratorRequest &request);
+  bool readCache(GeneratorRequest &request);
+  void writeCache(const GeneratorRequest &request);
 };
 } // end anonymous namespace
 
@@ -58,27 +84,94 @@ void HWGeneratorCalloutPass::runOnOperation() {
                    execPath + "'");
     return;
   }
-  for (auto &op : llvm::make_early_inc_range(root.getBody()->getOperations())) {
-    if (auto generator = dyn_cast<HWModuleGeneratedOp>(op))
-      processGenerator(generator, *generatorExe, extraGeneratorArgs);
+
+  // The cached outputs are only valid for the version of the generator they
+  // were produced by, so its modification time is part of the cache key.
+  std::string exeStamp;
+  llvm::sys::fs::file_status exeStatus;
+  if (!llvm::sys::fs::status(*generatorExe, exeStatus))
+    exeStamp = std::to_string(
+        exeStatus.getLastModificationTime().time_since_epoch().count());
+
+  // Gather the generator invocations up front, merging identical ones.
+  std::vector<GeneratorRequest> requests;
+  llvm::StringMap<size_t> requestIndices;
+  for (auto generator : root.getBody()->getOps<HWModuleGeneratedOp>()) {
+    SmallVector<std::string> args;
+    if (failed(getGeneratorArgs(generator, *generatorExe, genOptions, args)) ||
+        args.empty())
+      continue;
+
+    std::string key = exeStamp;
+    for (auto &arg : args) {
+      key += '\0';
+      key += arg;
+    }
+    auto it = requestIndices.insert({key, requests.size()});
+    if (it.second) {
+      requests.emplace_back();
+      requests.back().args = std::move(args);
+      requests.back().cacheKey = std::move(key);
+    }
+    requests[it.first->second].modules.push_back(generator);
+  }
+
+  // Run the generators, which don't touch the IR, on a bounded number of
+  // threads.
+  auto run = [&](GeneratorRequest &request) {
+    if (!readCache(request)) {
+      runGenerator(request);
+      writeCache(request);
+    }
+  };
+  if (getContext().isMultithreadingEnabled() && requests.size() > 1) {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(numJobs));
+    for (auto &request : requests)
+      pool.async([&run, &request] { run(request); });
+    pool.wait();
+  } else {
+    llvm::for_each(requests, run);
+  }
+
+  // Replace the generated modules with the external modules described by the
+  // generator output.
+  for (auto &request : requests) {
+    for (auto generatedModuleOp : request.modules) {
+      if (!request.error.empty()) {
+        generatedModuleOp.emitError(request.error);
+        continue;
+      }
+      OpBuilder builder(generatedModuleOp);
+      auto extMod = builder.create<hw::HWModuleExternOp>(
+          generatedModuleOp.getLoc(),
+          generatedModuleOp.getVerilogModuleNameAttr(),
+          generatedModuleOp.getPorts());
+      // Attach an attribute to which file the definition of the external
+      // module exists in.
+      extMod->setAttr("filenames", builder.getStringAttr(request.output));
+      generatedModuleOp.erase();
+    }
   }
 }
 
-void HWGeneratorCalloutPass::processGenerator(
+/// Compute the arguments to call the generator with for a generated module.
+/// Leaves the arguments empty if the module isn't generated by the schema
+/// this pass processes.
+LogicalResult HWGeneratorCalloutPass::getGeneratorArgs(
     HWModuleGeneratedOp generatedModuleOp, StringRef generatorExe,
-    ArrayRef<StringRef> extraGeneratorArgs) {
+    ArrayRef<StringRef> extraGeneratorArgs,
+    SmallVectorImpl<std::string> &generatorArgs) {
   // Get the corresponding schema associated with this generated op.
   auto genSchema =
       dyn_cast<HWGeneratorSchemaOp>(generatedModuleOp.getGeneratorKindOp());
   if (!genSchema)
-    return;
+    return success();
 
   // Ignore the generator op if the schema does not match the user specified
   // schema name from command line "-schema-name"
   if (genSchema.descriptor().str() != schemaName)
-    return;
+    return success();
 
-  SmallVector<std::string> generatorArgs;
   // First argument should be the executable name.
   generatorArgs.push_back(generatorExe.str());
   for (auto o : extraGeneratorArgs)
@@ -110,23 +203,30 @@ void HWGeneratorCalloutPass::processGenerator(
           " value specified on the rtl.module.generated operation is not "
           "handled, "
           "only integer and string types supported.");
-      return;
+      return failure();
     }
   }
+  return success();
+}
+
+/// Run the generator program of a request and record the first line of its
+/// output.  This is called concurrently and must not touch the IR.
+void HWGeneratorCalloutPass::runGenerator(GeneratorRequest &request) {
+  StringRef generatorExe = request.args.front();
   SmallVector<StringRef> generatorArgStrRef;
-  for (const std::string &a : generatorArgs)
+  for (const std::string &a : request.args)
     generatorArgStrRef.push_back(a);
 
-  std::string errMsg;
   SmallString<32> genExecOutFileName;
-  auto errCode = llvm::sys::fs::getPotentiallyUniqueTempFileName(
+  auto errCode = llvm::sys::fs::createTemporaryFile(
       "generatorCalloutTemp", StringRef(""), genExecOutFileName);
-  // Default error code is 0.
-  std::error_code ok;
-  if (errCode != ok) {
-    generatedModuleOp.emitError("cannot generate a unique temporary file name");
+  if (errCode) {
+    request.error = "cannot generate a unique temporary file name";
     return;
   }
+  llvm::FileRemover outFileRemover(genExecOutFileName);
+
+  std::string errMsg;
   Optional<StringRef> redirects[] = {None, StringRef(genExecOutFileName), None};
   int result = llvm::sys::ExecuteAndWait(
       generatorExe, generatorArgStrRef, /*Env=*/None,
@@ -134,28 +234,69 @@ void HWGeneratorCalloutPass::processGenerator(
       /*SecondsToWait=*/0, /*MemoryLimit=*/0, &errMsg);
 
   if (result != 0) {
-    generatedModuleOp.emitError("execution of '" + generatorExe + "' failed");
+    request.error = ("execution of '" + generatorExe + "' failed").str();
     return;
   }
 
   auto bufferRead = llvm::MemoryBuffer::getFile(genExecOutFileName);
   if (!bufferRead || !*bufferRead) {
-    generatedModuleOp.emitError("execution of '" + generatorExe +
-                                "' did not produce any output file named '" +
-                                genExecOutFileName + "'");
+    request.error = ("execution of '" + generatorExe +
+                     "' did not produce any output file named '" +
+                     genExecOutFileName + "'")
+                        .str();
     return;
   }
 
   // Only extract the first line from the output.
-  auto fileContent = (*bufferRead)->getBuffer().split('\n').first.str();
-  OpBuilder builder(generatedModuleOp);
-  auto extMod = builder.create<hw::HWModuleExternOp>(
-      generatedModuleOp.getLoc(), generatedModuleOp.getVerilogModuleNameAttr(),
-      generatedModuleOp.getPorts());
-  // Attach an attribute to which file the definition of the external
-  // module exists in.
-  extMod->setAttr("filenames", builder.getStringAttr(fileContent));
-  generatedModuleOp.erase();
+  request.output = (*bufferRead)->getBuffer().split('\n').first.str();
+}
+
+/// Return the path of the cache entry of a request.
+static void getCachePath(StringRef cacheDir, const GeneratorRequest &request,
+                         SmallVectorImpl<char> &path) {
+  llvm::MD5 hash;
+  hash.update(request.cacheKey);
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  path.assign(cacheDir.begin(), cacheDir.end());
+  llvm::sys::path::append(path, result.digest());
+}
+
+/// Look the output of a request up in the on-disk cache.  Returns true if it
+/// was found.
+bool HWGeneratorCalloutPass::readCache(GeneratorRequest &request) {
+  if (cacheDir.empty())
+    return false;
+  SmallString<128> path;
+  getCachePath(cacheDir, request, path);
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return false;
+  request.output = (*buffer)->getBuffer().split('\n').first.str();
+  return true;
+}
+
+/// Record the output of a successful request in the on-disk cache.  The entry
+/// is written to a temporary file first, so that concurrent compilations never
+/// see a partial entry.  Failing to write the cache isn't an error.
+void HWGeneratorCalloutPass::writeCache(const GeneratorRequest &request) {
+  if (cacheDir.empty() || !request.error.empty())
+    return;
+  if (llvm::sys::fs::create_directories(cacheDir))
+    return;
+
+  SmallString<128> path, tempPath;
+  getCachePath(cacheDir, request, path);
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(Twine(path) + "-%%%%%%%%", fd,
+                                         tempPath))
+    return;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << request.output << '\n';
+  }
+  if (llvm::sys::fs::rename(tempPath, path))
+    llvm::sys::fs::remove(tempPath);
 }
 
 std::unique_ptr<Pass> circt::sv::createHWGeneratorCalloutPass() {
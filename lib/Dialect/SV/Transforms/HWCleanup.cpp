@@ -14,6 +14,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetail.h"
+#include "circt/Dialect/Comb/CombAnalysis.h"
+#include "circt/Dialect/Comb/CombOps.h"
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVPasses.h"
 
@@ -25,13 +27,15 @@ using namespace circt;
 
 namespace {
 
-/// Check the equivalence of operations by doing a deep comparison of operands
-/// and attributes, but does not compare the content of any regions attached to
-/// each op.
+/// Key operations on their name, attributes and operands, which for the
+/// always blocks are the clock and reset edges and values.  The content of the
+/// regions attached to each op is not looked at.
 struct SimpleOperationInfo : public llvm::DenseMapInfo<Operation *> {
   static unsigned getHashValue(const Operation *opC) {
-    return mlir::OperationEquivalence::computeHash(
-        const_cast<Operation *>(opC));
+    auto *op = const_cast<Operation *>(opC);
+    return llvm::hash_combine(
+        op->getName().getAsOpaquePointer(), op->getAttrDictionary(),
+        llvm::hash_combine_range(op->operand_begin(), op->operand_end()));
   }
   static bool isEqual(const Operation *lhsC, const Operation *rhsC) {
     auto *lhs = const_cast<Operation *>(lhsC);
@@ -41,7 +45,9 @@ struct SimpleOperationInfo : public llvm::DenseMapInfo<Operation *> {
     if (lhs == getTombstoneKey() || lhs == getEmptyKey() ||
         rhs == getTombstoneKey() || rhs == getEmptyKey())
       return false;
-    return mlir::OperationEquivalence::isEquivalentTo(lhs, rhs);
+    return lhs->getName() == rhs->getName() &&
+           lhs->getAttrDictionary() == rhs->getAttrDictionary() &&
+           llvm::equal(lhs->getOperands(), rhs->getOperands());
   }
 };
 
@@ -69,6 +75,19 @@ static void mergeRegions(Region *region1, Region *region2) {
   }
 }
 
+/// Return true if `op` contains verbatim code which may define or undefine
+/// macros, in which case the condition of an ifdef doesn't hold throughout its
+/// regions.
+static bool mayDefineMacros(Operation *op) {
+  auto result = op->walk([](sv::VerbatimOp verbatim) {
+    if (verbatim.string().contains("`define") ||
+        verbatim.string().contains("`undef"))
+      return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return result.wasInterrupted();
+}
+
 //===----------------------------------------------------------------------===//
 // HWCleanupPass
 //===----------------------------------------------------------------------===//
@@ -78,26 +97,46 @@ struct HWCleanupPass : public sv::HWCleanupBase<HWCleanupPass> {
   void runOnOperation() override;
 
   void runOnRegionsInOp(Operation &op);
-  void runOnGraphRegion(Region &region, bool shallow);
-  void runOnProceduralRegion(Region &region, bool shallow);
+  void runOnRegion(Operation &op, Region &region);
+  void runOnGraphRegion(Region &region);
+  void runOnProceduralRegion(Region &region);
 
 private:
+  /// Replace the ifdefs of `body` on the macros in `knownMacros` with the
+  /// contents of the region which is always taken.
+  void inlineKnownIfDefs(Block &body);
+
+  /// Replace the Comb operations of `body` whose bits are all known with
+  /// constants, and drop the and/or masks which only touch bits already known
+  /// or never demanded.
+  void foldKnownBits(Block &body);
+
   /// Inline all regions from the second operation into the first and delete the
   /// second operation.
-  void mergeOperationsIntoFrom(Operation *op1, Operation *op2,
-                               DenseSet<Operation *> &opsToRevisitRegionsIn) {
+  void mergeOperationsIntoFrom(Operation *op1, Operation *op2) {
     assert(op1 != op2 && "Cannot merge an op into itself");
     for (size_t i = 0, e = op1->getNumRegions(); i != e; ++i)
       mergeRegions(&op1->getRegion(i), &op2->getRegion(i));
-
-    // Remember that we need to revisit op1 because it changed.
-    opsToRevisitRegionsIn.erase(op2);
-    opsToRevisitRegionsIn.insert(op1);
     op2->erase();
     anythingChanged = true;
   }
 
+  /// Process the regions of the operations left in a block once the block
+  /// itself has been cleaned up.
+  void runOnNestedRegions(Block &body) {
+    for (auto &op : body)
+      if (op.getNumRegions() != 0)
+        runOnRegionsInOp(op);
+  }
+
   bool anythingChanged;
+
+  /// The macros known to be defined, or not, from the ifdefs enclosing the
+  /// region being cleaned up.
+  llvm::SmallDenseMap<Attribute, bool, 4> knownMacros;
+
+  /// The known and demanded bits of the values of the block being cleaned up.
+  comb::BitAnalysis bitAnalysis;
 };
 } // end anonymous namespace
 
@@ -105,7 +144,7 @@ void HWCleanupPass::runOnOperation() {
   // Keeps track if anything changed during this pass, used to determine if
   // the analyses were preserved.
   anythingChanged = false;
-  runOnGraphRegion(getOperation().getBody(), /*shallow=*/false);
+  runOnGraphRegion(getOperation().getBody());
 
   // If we did not change anything in the graph mark all analysis as
   // preserved.
@@ -116,21 +155,73 @@ void HWCleanupPass::runOnOperation() {
 /// Recursively process all of the regions in the specified op, dispatching to
 /// graph or procedural processing as appropriate.
 void HWCleanupPass::runOnRegionsInOp(Operation &op) {
-  if (op.hasTrait<sv::ProceduralRegion>()) {
-    for (auto &region : op.getRegions())
-      runOnProceduralRegion(region, /*shallow=*/false);
-  } else {
-    for (auto &region : op.getRegions())
-      runOnGraphRegion(region, /*shallow=*/false);
+  // The macro of an ifdef is defined throughout its then region and undefined
+  // throughout its else region, unless the ifdef changes macros itself.
+  if (isa<sv::IfDefOp, sv::IfDefProceduralOp>(op)) {
+    auto cond = op.getAttr("cond");
+    if (!knownMacros.count(cond) && !mayDefineMacros(&op)) {
+      knownMacros[cond] = true;
+      runOnRegion(op, op.getRegion(0));
+      knownMacros[cond] = false;
+      runOnRegion(op, op.getRegion(1));
+      knownMacros.erase(cond);
+      return;
+    }
   }
+
+  for (auto &region : op.getRegions())
+    runOnRegion(op, region);
+}
+
+/// Process a region of `op`, dispatching to graph or procedural processing as
+/// appropriate.
+void HWCleanupPass::runOnRegion(Operation &op, Region &region) {
+  if (op.hasTrait<sv::ProceduralRegion>())
+    runOnProceduralRegion(region);
+  else
+    runOnGraphRegion(region);
 }
 
-/// Run simplifications on the specified graph region.  If shallow is true, then
-/// we only look at the specified region, we don't recurse into subregions.
-void HWCleanupPass::runOnGraphRegion(Region &region, bool shallow) {
+void HWCleanupPass::inlineKnownIfDefs(Block &body) {
+  if (knownMacros.empty())
+    return;
+
+  for (auto it = body.begin(), e = body.end(); it != e;) {
+    Operation &op = *it;
+    if (!isa<sv::IfDefOp, sv::IfDefProceduralOp>(op)) {
+      ++it;
+      continue;
+    }
+    auto known = knownMacros.find(op.getAttr("cond"));
+    if (known == knownMacros.end()) {
+      ++it;
+      continue;
+    }
+
+    // Move the operations of the taken region in front of the ifdef, and
+    // continue with them, since they may contain ifdefs on known macros too.
+    Region &taken = op.getRegion(known->second ? 0 : 1);
+    auto next = std::next(it);
+    if (!taken.empty() && !taken.front().empty()) {
+      next = taken.front().begin();
+      body.getOperations().splice(it, taken.front().getOperations());
+    }
+    op.erase();
+    anythingChanged = true;
+    it = next;
+  }
+}
+
+/// Run simplifications on the specified graph region.  The operations of the
+/// region are merged first, and the regions nested in the surviving operations
+/// are processed afterwards, so that each region is only visited once, after
+/// everything has been merged into it.
+void HWCleanupPass::runOnGraphRegion(Region &region) {
   if (region.getBlocks().size() != 1)
     return;
   Block &body = region.front();
+  inlineKnownIfDefs(body);
+  foldKnownBits(body);
 
   // A set of operations in the current block which are mergable. Any
   // operation in this set is a candidate for another similar operation to
@@ -140,24 +231,16 @@ void HWCleanupPass::runOnGraphRegion(Region &region, bool shallow) {
   sv::InitialOp initialOpSeen;
   sv::AlwaysCombOp alwaysCombOpSeen;
 
-  // As we merge operations with regions, we need to revisit the regions within
-  // them to see if merging the outer level allows simplifications in the inner
-  // level.  We do that after our pass so we only revisit each subregion once.
-  DenseSet<Operation *> opsToRevisitRegionsIn;
-
   for (Operation &op : llvm::make_early_inc_range(body)) {
-    // Recursively process any regions in the op before we visit it.
-    if (!shallow && op.getNumRegions() != 0)
-      runOnRegionsInOp(op);
     // Merge alwaysff and always operations by hashing them to check to see if
-    // we've already encountered one.  If so, merge them and reprocess the body.
+    // we've already encountered one.  If so, merge them.
     if (isa<sv::AlwaysOp, sv::AlwaysFFOp>(op)) {
       // Merge identical alwaysff's together and delete the old operation.
       auto itAndInserted = alwaysFFOpsSeen.insert(&op);
       if (itAndInserted.second)
         continue;
       auto *existingAlways = *itAndInserted.first;
-      mergeOperationsIntoFrom(&op, existingAlways, opsToRevisitRegionsIn);
+      mergeOperationsIntoFrom(&op, existingAlways);
 
       *itAndInserted.first = &op;
       continue;
@@ -167,7 +250,7 @@ void HWCleanupPass::runOnGraphRegion(Region &region, bool shallow) {
     if (auto ifdefOp = dyn_cast<sv::IfDefOp>(op)) {
       auto *&entry = ifdefOps[ifdefOp.condAttr()];
       if (entry)
-        mergeOperationsIntoFrom(ifdefOp, entry, opsToRevisitRegionsIn);
+        mergeOperationsIntoFrom(ifdefOp, entry);
 
       entry = ifdefOp;
       continue;
@@ -176,8 +259,7 @@ void HWCleanupPass::runOnGraphRegion(Region &region, bool shallow) {
     // Merge initial ops anywhere in the module.
     if (auto initialOp = dyn_cast<sv::InitialOp>(op)) {
       if (initialOpSeen)
-        mergeOperationsIntoFrom(initialOp, initialOpSeen,
-                                opsToRevisitRegionsIn);
+        mergeOperationsIntoFrom(initialOp, initialOpSeen);
       initialOpSeen = initialOp;
       continue;
     }
@@ -185,42 +267,80 @@ void HWCleanupPass::runOnGraphRegion(Region &region, bool shallow) {
     // Merge always_comb ops anywhere in the module.
     if (auto alwaysComb = dyn_cast<sv::AlwaysCombOp>(op)) {
       if (alwaysCombOpSeen)
-        mergeOperationsIntoFrom(alwaysComb, alwaysCombOpSeen,
-                                opsToRevisitRegionsIn);
+        mergeOperationsIntoFrom(alwaysComb, alwaysCombOpSeen);
       alwaysCombOpSeen = alwaysComb;
       continue;
     }
   }
 
-  // Reprocess the merged body because this may have uncovered other
-  // simplifications.  Note that iterating over a set is generally not a stable
-  // thing to do, but this is a parallel operation whose order of visitation
-  // doesn't matter.
-  // TODO: This could be a parallel for-each loop.
-  for (auto *op : opsToRevisitRegionsIn) {
-    for (auto &reg : op->getRegions())
-      runOnGraphRegion(reg, /*shallow=*/true);
+  runOnNestedRegions(body);
+}
+
+void HWCleanupPass::foldKnownBits(Block &body) {
+  // The operations are visited in order, so the bits of their operands are
+  // usually computed and cached first.  The bits of each value are computed
+  // once, which keeps this linear in the size of the block, unlike querying
+  // from the folders of each operation.  Replaced operations are only erased
+  // at the end, so that no new value takes the place of one in the cache.
+  SmallVector<Operation *, 8> deadOps;
+  OpBuilder builder(&getContext());
+  for (Operation &op : body) {
+    if (!isa<comb::ExtractOp, comb::AndOp, comb::OrOp, comb::ICmpOp>(op))
+      continue;
+    auto result = op.getResult(0);
+    if (!result.getType().isa<IntegerType>())
+      continue;
+
+    // extract(concat(x, 0)) of the zero bits -> 0, and likewise for and, or
+    // and the eq/ne compares of values differing in a known bit.
+    auto known = bitAnalysis.getKnownBits(result);
+    if (known.isConstant()) {
+      builder.setInsertionPoint(&op);
+      auto constant =
+          builder.create<hw::ConstantOp>(op.getLoc(), known.getConstant());
+      result.replaceAllUsesWith(constant);
+      deadOps.push_back(&op);
+      continue;
+    }
+
+    // and(x, c) -> x if every bit cleared by the mask is already zero in x, or
+    // is never looked at by the users of the and.  or(x, c) -> x likewise for
+    // the bits set by the constant.
+    if (!isa<comb::AndOp, comb::OrOp>(op) || op.getNumOperands() != 2)
+      continue;
+    auto mask = op.getOperand(1).getDefiningOp<hw::ConstantOp>();
+    if (!mask)
+      continue;
+    auto input = op.getOperand(0);
+    auto inputBits = bitAnalysis.getKnownBits(input);
+    APInt changed = isa<comb::AndOp>(op) ? ~mask.value() & ~inputBits.Zero
+                                         : mask.value() & ~inputBits.One;
+    if (!(changed & bitAnalysis.getDemandedBits(result)).isNullValue())
+      continue;
+    result.replaceAllUsesWith(input);
+    deadOps.push_back(&op);
+
+    // The input may know fewer bits than the mask did, and is demanded by the
+    // users of the mask now.
+    bitAnalysis.clear();
   }
+
+  for (auto *op : deadOps)
+    op->erase();
+  bitAnalysis.clear();
+  anythingChanged |= !deadOps.empty();
 }
 
-/// Run simplifications on the specified procedural region.  If shallow is true,
-/// then we only look at the specified region, we don't recurse into subregions.
-void HWCleanupPass::runOnProceduralRegion(Region &region, bool shallow) {
+/// Run simplifications on the specified procedural region.  Like graph regions,
+/// nested regions are processed once this region has been cleaned up.
+void HWCleanupPass::runOnProceduralRegion(Region &region) {
   if (region.getBlocks().size() != 1)
     return;
   Block &body = region.front();
-
-  // As we merge operations with regions, we need to revisit the regions within
-  // them to see if merging the outer level allows simplifications in the inner
-  // level.  We do that after our pass so we only revisit each subregion once.
-  DenseSet<Operation *> opsToRevisitRegionsIn;
+  inlineKnownIfDefs(body);
 
   Operation *lastSideEffectingOp = nullptr;
   for (Operation &op : llvm::make_early_inc_range(body)) {
-    // Recursively process any regions in the op before we visit it.
-    if (!shallow && op.getNumRegions() != 0)
-      runOnRegionsInOp(op);
-
     // Merge procedural ifdefs with neighbors in the procedural region.
     if (auto ifdef = dyn_cast<sv::IfDefProceduralOp>(op)) {
       if (auto prevIfDef =
@@ -228,7 +348,7 @@ void HWCleanupPass::runOnProceduralRegion(Region &region, bool shallow) {
         if (ifdef.cond() == prevIfDef.cond()) {
           // We know that there are no side effective operations between the
           // two, so merge the first one into this one.
-          mergeOperationsIntoFrom(ifdef, prevIfDef, opsToRevisitRegionsIn);
+          mergeOperationsIntoFrom(ifdef, prevIfDef);
         }
       }
     }
@@ -239,7 +359,7 @@ void HWCleanupPass::runOnProceduralRegion(Region &region, bool shallow) {
         if (ifop.cond() == prevIf.cond()) {
           // We know that there are no side effective operations between the
           // two, so merge the first one into this one.
-          mergeOperationsIntoFrom(ifop, prevIf, opsToRevisitRegionsIn);
+          mergeOperationsIntoFrom(ifop, prevIf);
         }
       }
     }
@@ -249,15 +369,7 @@ void HWCleanupPass::runOnProceduralRegion(Region &region, bool shallow) {
       lastSideEffectingOp = &op;
   }
 
-  // Reprocess the merged body because this may have uncovered other
-  // simplifications.  Note that iterating over a set is generally not a stable
-  // thing to do, but this is a parallel operation whose order of visitation
-  // doesn't matter.
-  // TODO: This could be a parallel for-each loop.
-  for (auto *op : opsToRevisitRegionsIn) {
-    for (auto &region : op->getRegions())
-      runOnProceduralRegion(region, /*shallow=*/true);
-  }
+  runOnNestedRegions(body);
 }
 
 std::unique_ptr<Pass> circt::sv::createHWCleanupPass() {
@@ -14,6 +14,8 @@
 #include "PassDetail.h"
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVPasses.h"
+#include "llvm/Support/Parallel.h"
+#include <atomic>
 
 using namespace circt;
 using namespace sv;
@@ -63,7 +65,7 @@ struct HWLegalizeNamesPass
 private:
   bool anythingChanged;
 
-  void runOnModule(hw::HWModuleOp module);
+  bool runOnModule(hw::HWModuleOp module);
   void runOnInterface(sv::InterfaceOp intf, mlir::SymbolUserMap &symbolUsers);
 };
 } // end anonymous namespace
@@ -105,11 +107,25 @@ void HWLegalizeNamesPass::runOnOperation() {
     anythingChanged = true;
   }
 
-  // Rename individual operations.
+  // Rename the ports and the declarations inside each module.  Only the module
+  // names are shared between modules and they are settled by now, so the
+  // modules are independent of each other.
+  SmallVector<HWModuleOp> modules(root.getOps<HWModuleOp>());
+  if (getContext().isMultithreadingEnabled()) {
+    std::atomic<bool> modulesChanged(false);
+    llvm::parallelForEach(modules.begin(), modules.end(), [&](auto module) {
+      if (runOnModule(module))
+        modulesChanged = true;
+    });
+    anythingChanged |= modulesChanged;
+  } else {
+    for (auto module : modules)
+      anythingChanged |= runOnModule(module);
+  }
+
+  // Rename the inside of interfaces and check the external modules.
   for (auto &op : *root.getBody()) {
-    if (auto module = dyn_cast<HWModuleOp>(op)) {
-      runOnModule(module);
-    } else if (auto intf = dyn_cast<InterfaceOp>(op)) {
+    if (auto intf = dyn_cast<InterfaceOp>(op)) {
       runOnInterface(intf, symbolUsers);
     } else if (auto extMod = dyn_cast<HWModuleExternOp>(op)) {
       auto name = extMod.getVerilogModuleName();
@@ -125,8 +141,11 @@ void HWLegalizeNamesPass::runOnOperation() {
     markAllAnalysesPreserved();
 }
 
-void HWLegalizeNamesPass::runOnModule(hw::HWModuleOp module) {
+/// Legalize the port names and the names of the declarations in a module.
+/// Returns true if anything was renamed.
+bool HWLegalizeNamesPass::runOnModule(hw::HWModuleOp module) {
   NameCollisionResolver nameResolver;
+  bool changed = false;
 
   bool changedArgNames = false, changedOutputNames = false;
   SmallVector<Attribute> argNames, outputNames;
@@ -148,11 +167,11 @@ void HWLegalizeNamesPass::runOnModule(hw::HWModuleOp module) {
 
   if (changedArgNames) {
     setModuleArgumentNames(module, argNames);
-    anythingChanged = true;
+    changed = true;
   }
   if (changedOutputNames) {
     setModuleResultNames(module, outputNames);
-    anythingChanged = true;
+    changed = true;
   }
 
   // Rename the instances, regs, and wires.
@@ -161,17 +180,18 @@ void HWLegalizeNamesPass::runOnModule(hw::HWModuleOp module) {
       auto newName = nameResolver.getLegalName(instanceOp.getNameAttr());
       if (!newName.empty()) {
         instanceOp.setName(newName);
-        anythingChanged = true;
+        changed = true;
       }
     } else if (isa<RegOp>(op) || isa<WireOp>(op)) {
       auto oldName = op.getAttrOfType<StringAttr>("name");
       auto newName = nameResolver.getLegalName(oldName);
       if (!newName.empty()) {
         op.setAttr("name", StringAttr::get(op.getContext(), newName));
-        anythingChanged = true;
+        changed = true;
       }
     }
   }
+  return changed;
 }
 
 void HWLegalizeNamesPass::runOnInterface(InterfaceOp interface,
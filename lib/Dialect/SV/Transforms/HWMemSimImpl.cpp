@@ -42,6 +42,8 @@ struct HWMemSimImplPass : public sv::HWMemSimImplBase<HWMemSimImplPass> {
 
 private:
   void generateMemory(hw::HWModuleOp op, FirMemory mem);
+  void generateInitializer(ImplicitLocOpBuilder &b, hw::HWModuleOp op,
+                           Value reg, FirMemory mem);
 };
 } // end anonymous namespace
 
@@ -171,15 +173,49 @@ void HWMemSimImplPass::generateMemory(hw::HWModuleOp op, FirMemory mem) {
     });
   }
 
+  if (randomizeInit || readMemInit)
+    generateInitializer(b, op, reg, mem);
+
   auto outputOp = op.getBodyBlock()->getTerminator();
   outputOp->setOperands(outputs);
 }
 
+/// Emit an initial block filling the memory for simulation.  Each of the
+/// initializers is a single statement, which the simulator runs as a loop,
+/// rather than one statement per element.
+void HWMemSimImplPass::generateInitializer(ImplicitLocOpBuilder &b,
+                                           hw::HWModuleOp op, Value reg,
+                                           FirMemory mem) {
+  b.create<sv::IfDefOp>("SYNTHESIS", std::function<void()>(), [&]() {
+    b.create<sv::InitialOp>([&]() {
+      if (randomizeInit) {
+        // Fill each element with as many 32-bit random values as it takes.
+        std::string random = "{`RANDOM";
+        for (size_t i = 32; i < mem.dataWidth; i += 32)
+          random += ", `RANDOM";
+        random += "}";
+        b.create<sv::IfDefProceduralOp>("RANDOMIZE_MEM_INIT", [&]() {
+          b.create<sv::VerbatimOp>(
+              b.getStringAttr("for (integer i = 0; i < " + Twine(mem.depth) +
+                              "; i = i + 1)\n  {{0}}[i] = " + random + ";"),
+              ValueRange{reg});
+        });
+      }
+      // Any element listed in the data file overrides its random value.
+      if (readMemInit)
+        b.create<sv::VerbatimOp>(
+            b.getStringAttr("$readmemh(\"" + op.getName() + ".hex\", {{0}});"),
+            ValueRange{reg});
+    });
+  });
+}
+
 void HWMemSimImplPass::runOnOperation() {
   auto topModule = getOperation().getBody();
 
   SmallVector<hw::HWModuleGeneratedOp> toErase;
   bool anythingChanged = false;
+  bool definedRandom = false;
 
   for (auto op : llvm::make_early_inc_range(
            topModule->getOps<hw::HWModuleGeneratedOp>())) {
@@ -192,6 +228,18 @@ void HWMemSimImplPass::runOnOperation() {
       auto mem = analyzeMemOp(oldModule);
 
       OpBuilder builder(oldModule);
+
+      // The random initializers need `RANDOM, make sure it is defined once
+      // before the first memory.
+      if (randomizeInit && !definedRandom) {
+        builder.create<sv::IfDefOp>(
+            oldModule.getLoc(), "RANDOM", std::function<void()>(), [&]() {
+              builder.create<sv::VerbatimOp>(oldModule.getLoc(),
+                                             "`define RANDOM {$random}");
+            });
+        definedRandom = true;
+      }
+
       auto nameAttr = builder.getStringAttr(oldModule.getName());
       auto newModule = builder.create<hw::HWModuleOp>(
           oldModule.getLoc(), nameAttr, oldModule.getPorts());
@@ -205,6 +253,10 @@ void HWMemSimImplPass::runOnOperation() {
     markAllAnalysesPreserved();
 }
 
-std::unique_ptr<Pass> circt::sv::createHWMemSimImplPass() {
-  return std::make_unique<HWMemSimImplPass>();
+std::unique_ptr<Pass> circt::sv::createHWMemSimImplPass(bool randomizeInit,
+                                                       bool readMemInit) {
+  auto pass = std::make_unique<HWMemSimImplPass>();
+  pass->randomizeInit = randomizeInit;
+  pass->readMemInit = readMemInit;
+  return pass;
 }
@@ -0,0 +1,194 @@
+//===- HWMiter.cpp - Build miter circuits of module pairs -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This transformation pass builds a miter circuit for each pair of modules to
+// be checked for equivalence, and replaces all other modules with them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/SV/SVPasses.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+using namespace circt;
+
+//===----------------------------------------------------------------------===//
+// HWMiter Pass
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct HWMiterPass : public sv::HWMiterBase<HWMiterPass> {
+  void runOnOperation() override;
+
+private:
+  LogicalResult inlineModule(hw::HWModuleOp module, ValueRange inputs,
+                             OpBuilder &builder,
+                             SmallVectorImpl<Value> &outputs);
+
+  SymbolTable *symbolTable = nullptr;
+
+  /// The modules being inlined, to reject recursive instantiations.
+  llvm::SmallPtrSet<Operation *, 8> activeModules;
+};
+} // end anonymous namespace
+
+/// Clone the body of `module` at the insertion point of `builder`, with
+/// `inputs` in place of its arguments, and return the values of its outputs in
+/// `outputs`. Instances are inlined recursively. The body is a graph region, so
+/// the operations are cloned in topological order.
+LogicalResult HWMiterPass::inlineModule(hw::HWModuleOp module,
+                                        ValueRange inputs, OpBuilder &builder,
+                                        SmallVectorImpl<Value> &outputs) {
+  if (!activeModules.insert(module).second)
+    return module.emitError("cannot inline the recursive instantiation of ")
+           << "module '" << module.getName() << "'";
+
+  Block *body = module.getBodyBlock();
+  BlockAndValueMapping mapping;
+  mapping.map(body->getArguments(), inputs);
+
+  // Count the operands of each operation that other operations define.
+  DenseMap<Operation *, unsigned> numPending;
+  SmallVector<Operation *> ready;
+  for (auto &op : *body) {
+    if (!isa<hw::ConstantOp, hw::InstanceOp, hw::OutputOp>(op) &&
+        !isa<comb::CombDialect>(op.getDialect()))
+      return op.emitOpError("is not supported in a miter, which can only be "
+                            "built of combinational modules");
+    unsigned pending = llvm::count_if(op.getOperands(), [](Value operand) {
+      return operand.getDefiningOp() != nullptr;
+    });
+    numPending[&op] = pending;
+    if (pending == 0)
+      ready.push_back(&op);
+  }
+
+  unsigned numInlined = 0;
+  while (!ready.empty()) {
+    auto *op = ready.pop_back_val();
+    ++numInlined;
+
+    if (auto output = dyn_cast<hw::OutputOp>(op)) {
+      for (auto operand : output.getOperands())
+        outputs.push_back(mapping.lookup(operand));
+    } else if (auto instance = dyn_cast<hw::InstanceOp>(op)) {
+      auto child = symbolTable->lookup<hw::HWModuleOp>(instance.moduleName());
+      if (!child)
+        return instance.emitOpError("cannot be inlined into a miter, since '")
+               << instance.moduleName() << "' is not an hw.module";
+
+      SmallVector<Value> childInputs, childOutputs;
+      for (auto operand : instance.inputs())
+        childInputs.push_back(mapping.lookup(operand));
+      if (failed(inlineModule(child, childInputs, builder, childOutputs)))
+        return failure();
+      mapping.map(instance.getResults(), childOutputs);
+    } else {
+      builder.clone(*op, mapping);
+    }
+
+    for (auto *user : op->getUsers())
+      if (--numPending[user] == 0)
+        ready.push_back(user);
+  }
+
+  if (numInlined != body->getOperations().size()) {
+    for (auto &op : *body)
+      if (numPending[&op] != 0)
+        return op.emitOpError("is part of a combinational cycle");
+  }
+
+  activeModules.erase(module);
+  return success();
+}
+
+void HWMiterPass::runOnOperation() {
+  if (pairs.empty())
+    return;
+
+  auto topModule = getOperation();
+  SymbolTable symbolTable(topModule);
+  this->symbolTable = &symbolTable;
+  OpBuilder builder(&getContext());
+  builder.setInsertionPointToEnd(topModule.getBody());
+
+  llvm::SmallPtrSet<Operation *, 4> miters;
+  for (auto &pair : pairs) {
+    StringRef first, second;
+    std::tie(first, second) = StringRef(pair).split(':');
+    auto lhs = symbolTable.lookup<hw::HWModuleOp>(first);
+    auto rhs = symbolTable.lookup<hw::HWModuleOp>(second);
+    if (!lhs || !rhs) {
+      topModule.emitError("cannot find the modules to compare in '")
+          << pair << "'";
+      return signalPassFailure();
+    }
+    if (hw::getModuleType(lhs) != hw::getModuleType(rhs)) {
+      auto diag = rhs.emitError("module '")
+                  << second << "' has different ports than '" << first
+                  << "'";
+      diag.attachNote(lhs.getLoc()) << "other module declared here";
+      return signalPassFailure();
+    }
+
+    auto loc = lhs.getLoc();
+    SmallVector<hw::ModulePortInfo> ports;
+    for (auto &port : lhs.getPorts())
+      if (!port.isOutput())
+        ports.push_back(port);
+    ports.push_back({builder.getStringAttr("differ"), hw::PortDirection::OUTPUT,
+                     builder.getI1Type(), 0});
+    auto miter = builder.create<hw::HWModuleOp>(
+        loc, builder.getStringAttr(first + "_" + second + "_miter"), ports);
+    miters.insert(miter);
+
+    auto *outputOp = miter.getBodyBlock()->getTerminator();
+    OpBuilder bodyBuilder(outputOp);
+    SmallVector<Value> lhsOutputs, rhsOutputs;
+    if (failed(inlineModule(lhs, miter.getArguments(), bodyBuilder,
+                            lhsOutputs)) ||
+        failed(inlineModule(rhs, miter.getArguments(), bodyBuilder,
+                            rhsOutputs)))
+      return signalPassFailure();
+
+    SmallVector<Value> differences;
+    for (auto outputs : llvm::zip(lhsOutputs, rhsOutputs)) {
+      if (!std::get<0>(outputs).getType().isa<IntegerType>()) {
+        lhs.emitError("cannot compare outputs of type ")
+            << std::get<0>(outputs).getType() << " in a miter";
+        return signalPassFailure();
+      }
+      differences.push_back(bodyBuilder.create<comb::ICmpOp>(
+          loc, comb::ICmpPredicate::ne, std::get<0>(outputs),
+          std::get<1>(outputs)));
+    }
+
+    Value differ;
+    if (differences.empty())
+      differ = bodyBuilder.create<hw::ConstantOp>(loc, APInt(1, 0));
+    else if (differences.size() == 1)
+      differ = differences.front();
+    else
+      differ = bodyBuilder.create<comb::OrOp>(loc, builder.getI1Type(),
+                                              differences);
+    outputOp->setOperands(differ);
+  }
+
+  // The miters don't instantiate anything, so all other modules can go.
+  for (auto &op : llvm::make_early_inc_range(*topModule.getBody()))
+    if (hw::isAnyModule(&op) && !miters.count(&op))
+      op.erase();
+}
+
+std::unique_ptr<Pass> circt::sv::createHWMiterPass() {
+  return std::make_unique<HWMiterPass>();
+}
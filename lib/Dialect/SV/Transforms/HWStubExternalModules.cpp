@@ -7,6 +7,8 @@
 //===----------------------------------------------------------------------===//
 //
 // This transformation pass converts external modules to empty normal modules.
+// In interface-only mode, it also reduces the bodies of all other modules to
+// their instances.
 //
 //===----------------------------------------------------------------------===//
 
@@ -14,6 +16,7 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVPasses.h"
 #include "mlir/IR/Builders.h"
+#include "llvm/ADT/DenseSet.h"
 
 using namespace circt;
 
@@ -28,11 +31,72 @@ struct HWStubExternalModulesPass
 };
 } // end anonymous namespace
 
+/// Return a value of the given type with no particular value.  Inout values
+/// are backed by a fresh wire.
+static Value createUndrivenValue(OpBuilder &builder, Location loc, Type type) {
+  if (auto inoutType = type.dyn_cast<hw::InOutType>())
+    return builder.create<sv::WireOp>(loc, inoutType.getElementType());
+  return builder.create<sv::ConstantXOp>(loc, type);
+}
+
+/// Replace the body of a module with its instances.  The instances are moved
+/// out of any nested regions.  Their inputs and the outputs of the module keep
+/// the ports and instance results they are directly connected to, everything
+/// else is driven with x.
+static void stubModuleBody(hw::HWModuleOp module) {
+  auto *body = module.getBodyBlock();
+  auto *outputOp = body->getTerminator();
+  OpBuilder builder(outputOp);
+  DenseSet<Operation *> keep;
+  keep.insert(outputOp);
+
+  auto stubOperands = [&](Operation *op) {
+    SmallVector<Value, 8> values;
+    for (auto operand : op->getOperands()) {
+      auto *definingOp = operand.getDefiningOp();
+      if (definingOp ? isa<hw::InstanceOp>(definingOp)
+                     : operand.getParentBlock() == body) {
+        values.push_back(operand);
+        continue;
+      }
+      values.push_back(
+          createUndrivenValue(builder, op->getLoc(), operand.getType()));
+      keep.insert(values.back().getDefiningOp());
+    }
+    op->setOperands(values);
+  };
+
+  SmallVector<hw::InstanceOp> instances;
+  module.walk([&](hw::InstanceOp inst) { instances.push_back(inst); });
+  for (auto inst : instances) {
+    inst->moveBefore(outputOp);
+    builder.setInsertionPoint(inst);
+    stubOperands(inst);
+    keep.insert(inst);
+  }
+  builder.setInsertionPoint(outputOp);
+  stubOperands(outputOp);
+
+  // Everything else is dead now.
+  for (auto &op : llvm::make_early_inc_range(*body)) {
+    if (keep.count(&op))
+      continue;
+    op.dropAllDefinedValueUses();
+    op.erase();
+  }
+}
+
 void HWStubExternalModulesPass::runOnOperation() {
   auto topModule = getOperation().getBody();
   OpBuilder builder(topModule->getParentOp()->getContext());
   builder.setInsertionPointToEnd(topModule);
 
+  // Stub out the normal modules before any external ones are turned into
+  // normal modules.
+  if (interfaceOnly)
+    for (auto module : topModule->getOps<hw::HWModuleOp>())
+      stubModuleBody(module);
+
   for (auto &op : llvm::make_early_inc_range(*topModule))
     if (auto module = dyn_cast<hw::HWModuleExternOp>(op)) {
       SmallVector<hw::ModulePortInfo> ports = module.getPorts();
@@ -62,6 +126,9 @@ void HWStubExternalModulesPass::runOnOperation() {
     }
 }
 
-std::unique_ptr<Pass> circt::sv::createHWStubExternalModulesPass() {
-  return std::make_unique<HWStubExternalModulesPass>();
+std::unique_ptr<Pass>
+circt::sv::createHWStubExternalModulesPass(bool interfaceOnly) {
+  auto pass = std::make_unique<HWStubExternalModulesPass>();
+  pass->interfaceOnly = interfaceOnly;
+  return pass;
 }
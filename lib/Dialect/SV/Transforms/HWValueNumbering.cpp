@@ -0,0 +1,178 @@
+//===- HWValueNumbering.cpp - Value numbering for hw.module bodies --------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This transformation pass numbers the pure HW and Comb operations of a
+// hw.module body, bringing the operands of commutative operations into a
+// canonical order and merging operations which compute the same value.  Unlike
+// CSE, this catches `comb.and %a, %b` and `comb.and %b, %a` as the same value,
+// and since operations are visited operands first, whole identical subgraphs
+// are merged even when they are spread over the module.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/SV/SVPasses.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/Hashing.h"
+
+using namespace circt;
+
+/// Return true if the operation computes a value only from its operands and
+/// attributes, so that two such operations with the same inputs can be merged.
+static bool isNumberable(Operation *op) {
+  if (!isa_and_nonnull<comb::CombDialect, hw::HWDialect>(op->getDialect()))
+    return false;
+  return op->getNumResults() != 0 && op->getNumRegions() == 0 &&
+         mlir::MemoryEffectOpInterface::hasNoEffect(op);
+}
+
+namespace {
+struct HWValueNumberingPass
+    : public sv::HWValueNumberingBase<HWValueNumberingPass> {
+  void runOnOperation() override;
+
+private:
+  /// Return the number of a value, giving it a fresh one if it has none yet.
+  unsigned getNumber(Value value) {
+    return valueNumbers.insert({value, valueNumbers.size()}).first->second;
+  }
+
+  /// Sort the operands of a commutative operation by their number, keeping
+  /// constants last like the canonicalizer does.  Returns true if the operands
+  /// changed.
+  bool canonicalizeOperands(Operation *op);
+
+  /// Return true if the two operations compute the same value.
+  bool isEquivalent(Operation *lhs, Operation *rhs);
+
+  /// Return the operation computing the same value as `op` if there is one,
+  /// otherwise number the results of `op` and return null.
+  Operation *findOrInsert(Operation *op);
+
+  /// The number of each value visited so far.
+  DenseMap<Value, unsigned> valueNumbers;
+
+  /// The numbered operations, by the hash of their name, attributes, result
+  /// types and operand numbers.
+  DenseMap<size_t, SmallVector<Operation *, 1>> buckets;
+};
+} // end anonymous namespace
+
+bool HWValueNumberingPass::canonicalizeOperands(Operation *op) {
+  if (op->getNumOperands() < 2 ||
+      !op->hasTrait<mlir::OpTrait::IsCommutative>())
+    return false;
+
+  auto getKey = [&](Value value) {
+    auto *def = value.getDefiningOp();
+    bool isConstant = def && def->hasTrait<mlir::OpTrait::ConstantLike>();
+    return std::make_pair(isConstant, getNumber(value));
+  };
+  SmallVector<Value, 4> operands(op->getOperands());
+  std::stable_sort(operands.begin(), operands.end(), [&](Value lhs, Value rhs) {
+    return getKey(lhs) < getKey(rhs);
+  });
+  if (llvm::equal(operands, op->getOperands()))
+    return false;
+  op->setOperands(operands);
+  ++numCanonicalized;
+  return true;
+}
+
+bool HWValueNumberingPass::isEquivalent(Operation *lhs, Operation *rhs) {
+  return lhs->getName() == rhs->getName() &&
+         lhs->getAttrDictionary() == rhs->getAttrDictionary() &&
+         llvm::equal(lhs->getResultTypes(), rhs->getResultTypes()) &&
+         llvm::equal(lhs->getOperands(), rhs->getOperands());
+}
+
+Operation *HWValueNumberingPass::findOrInsert(Operation *op) {
+  auto hash = llvm::hash_combine(
+      op->getName().getAsOpaquePointer(), op->getAttrDictionary(),
+      llvm::hash_combine_range(op->result_type_begin(), op->result_type_end()));
+  for (auto operand : op->getOperands())
+    hash = llvm::hash_combine(hash, getNumber(operand));
+
+  auto &bucket = buckets[hash];
+  for (auto *candidate : bucket)
+    if (isEquivalent(candidate, op))
+      return candidate;
+
+  bucket.push_back(op);
+  for (auto result : op->getResults())
+    getNumber(result);
+  return nullptr;
+}
+
+void HWValueNumberingPass::runOnOperation() {
+  auto *body = getOperation().getBodyBlock();
+
+  // Number the values which aren't computed by a numberable operation up
+  // front, in the order they appear, so that the sorted operand order doesn't
+  // depend on the order in which the values are first compared.
+  for (auto arg : body->getArguments())
+    getNumber(arg);
+  for (auto &op : *body)
+    if (!isNumberable(&op))
+      for (auto result : op.getResults())
+        getNumber(result);
+
+  // Visit each operation once all of the numberable operations defining its
+  // operands have been visited, so that its operands are in their final form.
+  // Operations defining values used before they are computed, like those of a
+  // combinational loop, are left alone.
+  DenseMap<Operation *, unsigned> pendingOperands;
+  SmallVector<Operation *> worklist;
+  for (auto &op : *body) {
+    if (!isNumberable(&op))
+      continue;
+    unsigned pending = 0;
+    for (auto operand : op.getOperands()) {
+      auto *def = operand.getDefiningOp();
+      if (def && def->getBlock() == body && isNumberable(def))
+        ++pending;
+    }
+    pendingOperands[&op] = pending;
+    if (pending == 0)
+      worklist.push_back(&op);
+  }
+
+  bool anythingChanged = false;
+  for (size_t i = 0; i != worklist.size(); ++i) {
+    auto *op = worklist[i];
+
+    // Release the users of the operation.
+    for (auto result : op->getResults()) {
+      for (auto *user : result.getUsers()) {
+        auto it = pendingOperands.find(user);
+        if (it != pendingOperands.end() && --it->second == 0)
+          worklist.push_back(user);
+      }
+    }
+
+    anythingChanged |= canonicalizeOperands(op);
+    if (auto *leader = findOrInsert(op)) {
+      op->replaceAllUsesWith(leader);
+      op->erase();
+      ++numErased;
+      anythingChanged = true;
+    }
+  }
+
+  valueNumbers.clear();
+  buckets.clear();
+  if (!anythingChanged)
+    markAllAnalysesPreserved();
+}
+
+std::unique_ptr<Pass> circt::sv::createHWValueNumberingPass() {
+  return std::make_unique<HWValueNumberingPass>();
+}
@@ -20,7 +20,6 @@
 #include "circt/Dialect/SV/SVPasses.h"
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
-#include "mlir/IR/Matchers.h"
 
 using namespace circt;
 
@@ -150,8 +149,9 @@ void PrettifyVerilogPass::runOnOperation() {
     if (isVerilogUnaryOperator(op))
       return prettifyUnaryOperator(op);
     // Sink or duplicate constant ops into the same block as their use.  This
-    // will allow the verilog emitter to inline constant expressions.
-    if (matchPattern(op, mlir::m_Constant()))
+    // will allow the verilog emitter to inline constant expressions.  Only the
+    // trait is checked here, matching the constant would also fold it.
+    if (op->hasTrait<mlir::OpTrait::ConstantLike>())
       return sinkOpToUses(op);
 
     // Sink "free" operations which make Verilog prettier.
@@ -18,6 +18,7 @@
 #include "circt/Dialect/SV/SVPasses.h"
 #include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/IR/Builders.h"
+#include "llvm/Support/Parallel.h"
 
 #include <set>
 
@@ -30,10 +31,11 @@ using namespace sv;
 //===----------------------------------------------------------------------===//
 
 // Reimplemented from SliceAnalysis to use a worklist rather than recursion and
-// non-insert ordered set.
+// non-insert ordered set.  Operations already in the slice aren't visited
+// again, so the cones shared by many roots are only walked once.
 static void getBackwardSliceSimple(Operation *rootOp,
                                    SmallPtrSetImpl<Operation *> &backwardSlice,
-                                   std::function<bool(Operation *)> filter) {
+                                   function_ref<bool(Operation *)> filter) {
   SmallVector<Operation *> worklist;
   worklist.push_back(rootOp);
 
@@ -50,6 +52,11 @@ static void getBackwardSliceSimple(Operation *rootOp,
     if (filter && !filter(op))
       continue;
 
+    // An operation may have been queued by several users before it was
+    // visited.
+    if (!backwardSlice.insert(op).second && op != rootOp)
+      continue;
+
     for (auto en : llvm::enumerate(op->getOperands())) {
       auto operand = en.value();
       if (auto *definingOp = operand.getDefiningOp()) {
@@ -69,8 +76,6 @@ static void getBackwardSliceSimple(Operation *rootOp,
         llvm_unreachable("No definingOp and not a block argument.");
       }
     }
-
-    backwardSlice.insert(op);
   }
 
   // Don't insert the top level operation, we just queried on it and don't
@@ -136,14 +141,24 @@ StringRef getNameForPort(Value val, ArrayAttr modulePorts) {
   return "";
 }
 
+namespace {
+/// A module of extracted test code and the bind instantiating it.  Both are
+/// created detached, since the modules are extracted concurrently, and are
+/// inserted into the top-level module once all modules are done.
+struct ExtractedModule {
+  hw::HWModuleOp module;
+  sv::BindOp bind;
+};
+} // end anonymous namespace
+
 // Given a set of values, construct a module and bind instance of that module
-// that passes those values through.  Returns the new module and the instance
-// pointing to it.
-static hw::HWModuleOp createModuleForCut(hw::HWModuleOp op,
-                                         SetVector<Value> &inputs,
-                                         BlockAndValueMapping &cutMap,
-                                         StringRef suffix, StringRef path) {
-  OpBuilder b(op->getParentOfType<mlir::ModuleOp>()->getRegion(0));
+// that passes those values through.  Returns the new module and the bind of
+// the instance pointing to it, neither of which is inserted anywhere yet.
+static ExtractedModule createModuleForCut(hw::HWModuleOp op,
+                                          SetVector<Value> &inputs,
+                                          BlockAndValueMapping &cutMap,
+                                          StringRef suffix, StringRef path) {
+  OpBuilder b(op.getContext());
 
   // Construct the ports, this is just the input Values
   SmallVector<hw::ModulePortInfo> ports;
@@ -175,10 +190,9 @@ static hw::HWModuleOp createModuleForCut(hw::HWModuleOp op,
       b.getStringAttr(
           ("__ETC_" + getVerilogModuleNameAttr(op).getValue() + suffix).str()));
   inst->setAttr("doNotPrint", b.getBoolAttr(true));
-  b = OpBuilder::atBlockEnd(
-      &op->getParentOfType<mlir::ModuleOp>()->getRegion(0).front());
-  b.create<sv::BindOp>(op.getLoc(), b.getSymbolRefAttr(inst));
-  return newMod;
+  b.clearInsertionPoint();
+  auto bind = b.create<sv::BindOp>(op.getLoc(), b.getSymbolRefAttr(inst));
+  return {newMod, bind};
 }
 
 // Some blocks have terminators, some don't
@@ -250,11 +264,12 @@ struct SVExtractTestCodeImplPass
   void runOnOperation() override;
 
 private:
-  void doModule(hw::HWModuleOp module, std::function<bool(Operation *)> fn,
-                StringRef suffix, StringRef path) {
+  void doModule(hw::HWModuleOp module, function_ref<bool(Operation *)> fn,
+                StringRef suffix, StringRef path,
+                SmallVectorImpl<ExtractedModule> &extracted) {
     // Find Operations of interest.
     SmallPtrSet<Operation *, 8> roots;
-    module->walk([&fn, &roots](Operation *op) {
+    module->walk([&](Operation *op) {
       if (fn(op))
         roots.insert(op);
     });
@@ -274,9 +289,10 @@ private:
 
     // Make a module to contain the clone set, with arguments being the cut
     BlockAndValueMapping cutMap;
-    auto bmod = createModuleForCut(module, inputs, cutMap, suffix, path);
+    auto cut = createModuleForCut(module, inputs, cutMap, suffix, path);
+    extracted.push_back(cut);
     // do the clone
-    migrateOps(module, bmod, opsToClone, cutMap);
+    migrateOps(module, cut.module, opsToClone, cutMap);
     // erase old operations of interest
     for (auto op : roots)
       op->erase();
@@ -287,18 +303,38 @@ private:
 
 void SVExtractTestCodeImplPass::runOnOperation() {
   auto *topLevelModule = getOperation().getBody();
-  for (auto &op : topLevelModule->getOperations())
-    if (auto rtlmod = dyn_cast<hw::HWModuleOp>(op)) {
-      // Extract two sets of ops to different modules
-      auto isAssert = [](Operation *op) -> bool {
-        return isa<AssertOp>(op) || isa<AssumeOp>(op) || isa<FinishOp>(op) ||
-               isa<FWriteOp>(op);
-      };
-      auto isCover = [](Operation *op) -> bool { return isa<CoverOp>(op); };
-
-      doModule(rtlmod, isAssert, "_assert", "generated/asserts");
-      doModule(rtlmod, isCover, "_cover", "generated/covers");
+  auto rtlmods = llvm::to_vector<8>(topLevelModule->getOps<hw::HWModuleOp>());
+
+  // Extract the test code of each module concurrently.  The modules only
+  // touch their own body and the detached operations they create.
+  std::vector<SmallVector<ExtractedModule, 2>> extracted(rtlmods.size());
+  auto extract = [&](size_t i) {
+    // Extract two sets of ops to different modules
+    auto isAssert = [](Operation *op) -> bool {
+      return isa<AssertOp>(op) || isa<AssumeOp>(op) || isa<FinishOp>(op) ||
+             isa<FWriteOp>(op);
+    };
+    auto isCover = [](Operation *op) -> bool { return isa<CoverOp>(op); };
+
+    doModule(rtlmods[i], isAssert, "_assert", "generated/asserts",
+             extracted[i]);
+    doModule(rtlmods[i], isCover, "_cover", "generated/covers", extracted[i]);
+  };
+  if (getContext().isMultithreadingEnabled())
+    llvm::parallelForEachN(0, rtlmods.size(), extract);
+  else
+    for (size_t i = 0, e = rtlmods.size(); i != e; ++i)
+      extract(i);
+
+  // Insert the new modules at the start of the top-level module, each before
+  // the previous one, and the binds at its end, in the order the modules were
+  // extracted.
+  for (auto &moduleExtracted : extracted) {
+    for (auto &cut : moduleExtracted) {
+      topLevelModule->push_front(cut.module);
+      topLevelModule->push_back(cut.bind);
     }
+  }
 }
 
 std::unique_ptr<Pass> circt::sv::createSVExtractTestCodePass() {
@@ -0,0 +1,350 @@
+//===- Retiming.cpp - Retime registers across combinational logic ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the minimum-period retiming of `seq.compreg` ops
+// across `comb` logic, following C. E. Leiserson and J. B. Saxe, "Retiming
+// Synchronous Circuitry", Algorithmica 1991.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/Seq/SeqOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace seq;
+
+namespace circt {
+namespace seq {
+#define GEN_PASS_CLASSES
+#include "circt/Dialect/Seq/SeqPasses.h.inc"
+} // namespace seq
+} // namespace circt
+
+/// The default delays of the combinational operations, in arbitrary units.
+/// Operations not listed take one unit.
+static const std::pair<StringRef, unsigned> defaultDelays[] = {
+    {"comb.add", 2},     {"comb.sub", 2},  {"comb.icmp", 2},
+    {"comb.mul", 4},     {"comb.divu", 8}, {"comb.divs", 8},
+    {"comb.modu", 8},    {"comb.mods", 8}, {"comb.concat", 0},
+    {"comb.extract", 0}, {"comb.sext", 0}};
+
+namespace {
+
+/// The retiming graph of the registers of one clock in a module. Its vertices
+/// are the combinational operations, and each of their operands is an edge
+/// weighted with the number of registers between the operand's source and the
+/// operation. Everything else, i.e. module ports, other operations, nested
+/// operations, and registers with a reset or another clock, is fixed in place.
+class RetimingGraph {
+public:
+  RetimingGraph(Block &body, Value clock,
+                const llvm::StringMap<unsigned> &delays)
+      : body(body), clock(clock), delays(delays) {}
+
+  /// Build the graph. Return false if the registers can't be retimed, e.g.
+  /// because they form a cycle without combinational logic.
+  bool build();
+
+  /// Return the period of the circuit retimed with `lags`, or None if the
+  /// retiming is illegal.
+  Optional<unsigned> getPeriod(ArrayRef<int> lags);
+
+  /// Compute a retiming achieving at most `period`, using the FEAS algorithm.
+  /// Return None if none was found.
+  Optional<SmallVector<int>> findRetiming(unsigned period);
+
+  /// Move the registers according to `lags`.
+  void apply(ArrayRef<int> lags);
+
+  unsigned getNumVertices() { return vertices.size(); }
+  unsigned getMaxDelay() {
+    unsigned maxDelay = 0;
+    for (unsigned delay : vertexDelays)
+      maxDelay = std::max(maxDelay, delay);
+    return maxDelay;
+  }
+
+private:
+  /// An operand of a vertex or a fixed operation, connected to `source` via
+  /// `weight` registers.
+  struct Edge {
+    Operation *user;
+    unsigned operandIdx;
+    Value source;
+    unsigned weight;
+    /// The vertex indices of the endpoints, or -1 if they are fixed.
+    int from, to;
+  };
+
+  bool isRetimable(Operation *op) {
+    auto reg = dyn_cast<CompRegOp>(op);
+    return reg && reg->getBlock() == &body && reg.clk() == clock &&
+           !reg.reset();
+  }
+
+  int getVertex(Value value) {
+    if (auto *op = value.getDefiningOp()) {
+      auto it = vertexIndices.find(op);
+      if (it != vertexIndices.end())
+        return it->second;
+    }
+    return -1;
+  }
+
+  /// Compute the combinational arrival time at each vertex's result.
+  Optional<SmallVector<unsigned>> getArrivalTimes(ArrayRef<int> lags);
+
+  int getRetimedWeight(const Edge &edge, ArrayRef<int> lags) {
+    int fromLag = edge.from < 0 ? 0 : lags[edge.from];
+    int toLag = edge.to < 0 ? 0 : lags[edge.to];
+    return (int)edge.weight + toLag - fromLag;
+  }
+
+  Block &body;
+  Value clock;
+  const llvm::StringMap<unsigned> &delays;
+
+  SmallVector<Operation *> vertices;
+  SmallVector<unsigned> vertexDelays;
+  DenseMap<Operation *, int> vertexIndices;
+  SmallVector<Edge> edges;
+  SmallVector<CompRegOp> registers;
+};
+
+} // end anonymous namespace
+
+bool RetimingGraph::build() {
+  for (auto &op : body) {
+    if (isRetimable(&op)) {
+      registers.push_back(cast<CompRegOp>(op));
+      continue;
+    }
+    if (!isa<comb::CombDialect>(op.getDialect()) || op.getNumResults() != 1)
+      continue;
+    vertexIndices[&op] = vertices.size();
+    vertices.push_back(&op);
+    auto delay = delays.find(op.getName().getStringRef());
+    vertexDelays.push_back(delay == delays.end() ? 1 : delay->second);
+  }
+
+  auto result = body.walk([&](Operation *op) {
+    if (isRetimable(op))
+      return WalkResult::advance();
+    auto vertex = vertexIndices.find(op);
+    int to = vertex == vertexIndices.end() ? -1 : vertex->second;
+    for (auto &operand : op->getOpOperands()) {
+      // Follow the chain of registers back to the source of the operand.
+      Value source = operand.get();
+      unsigned weight = 0;
+      while (auto reg = source.getDefiningOp<CompRegOp>()) {
+        if (!isRetimable(reg))
+          break;
+        if (++weight > registers.size())
+          return WalkResult::interrupt();
+        source = reg.input();
+      }
+
+      // Registers on constants are simply dropped.
+      if (auto *def = source.getDefiningOp())
+        if (def->hasTrait<OpTrait::ConstantLike>())
+          weight = 0;
+
+      edges.push_back({op, operand.getOperandNumber(), source, weight,
+                       getVertex(source), to});
+    }
+    return WalkResult::advance();
+  });
+  return !result.wasInterrupted();
+}
+
+Optional<SmallVector<unsigned>>
+RetimingGraph::getArrivalTimes(ArrayRef<int> lags) {
+  // Sort the vertices topologically along the edges without registers.
+  unsigned numVertices = vertices.size();
+  SmallVector<SmallVector<unsigned, 2>> successors(numVertices);
+  SmallVector<unsigned> numPreds(numVertices, 0);
+  for (auto &edge : edges) {
+    if (edge.from < 0 || edge.to < 0 || getRetimedWeight(edge, lags) != 0)
+      continue;
+    successors[edge.from].push_back(edge.to);
+    ++numPreds[edge.to];
+  }
+
+  SmallVector<unsigned> order;
+  for (unsigned v = 0; v < numVertices; ++v)
+    if (numPreds[v] == 0)
+      order.push_back(v);
+  SmallVector<unsigned> arrivals(vertexDelays.begin(), vertexDelays.end());
+  for (unsigned i = 0; i < order.size(); ++i) {
+    unsigned v = order[i];
+    for (unsigned succ : successors[v]) {
+      arrivals[succ] =
+          std::max(arrivals[succ], arrivals[v] + vertexDelays[succ]);
+      if (--numPreds[succ] == 0)
+        order.push_back(succ);
+    }
+  }
+
+  // A combinational cycle.
+  if (order.size() != numVertices)
+    return None;
+  return arrivals;
+}
+
+Optional<unsigned> RetimingGraph::getPeriod(ArrayRef<int> lags) {
+  for (auto &edge : edges)
+    if (getRetimedWeight(edge, lags) < 0)
+      return None;
+  auto arrivals = getArrivalTimes(lags);
+  if (!arrivals)
+    return None;
+  unsigned period = 0;
+  for (unsigned arrival : *arrivals)
+    period = std::max(period, arrival);
+  return period;
+}
+
+Optional<SmallVector<int>> RetimingGraph::findRetiming(unsigned period) {
+  // Delay the retiming of each vertex whose arrival time exceeds the period,
+  // i.e. move a register from its outputs to its inputs.
+  SmallVector<int> lags(vertices.size(), 0);
+  for (unsigned i = 0, e = vertices.size(); i < e; ++i) {
+    auto arrivals = getArrivalTimes(lags);
+    if (!arrivals)
+      return None;
+    bool changed = false;
+    for (unsigned v = 0; v < e; ++v) {
+      if ((*arrivals)[v] > period) {
+        ++lags[v];
+        changed = true;
+      }
+    }
+    if (!changed)
+      break;
+  }
+
+  auto achieved = getPeriod(lags);
+  if (!achieved || *achieved > period)
+    return None;
+  return lags;
+}
+
+void RetimingGraph::apply(ArrayRef<int> lags) {
+  // The chains of registers delaying each source by one cycle per register.
+  DenseMap<Value, SmallVector<Value, 2>> delayed;
+  auto getDelayed = [&](Value source, unsigned weight) -> Value {
+    auto &chain = delayed[source];
+    if (chain.empty())
+      chain.push_back(source);
+    while (chain.size() <= weight) {
+      OpBuilder builder(body.getParentOp()->getContext());
+      if (auto *def = chain.back().getDefiningOp())
+        builder.setInsertionPointAfter(def);
+      else
+        builder.setInsertionPointToStart(&body);
+      chain.push_back(builder.create<CompRegOp>(
+          source.getLoc(), source.getType(), chain.back(), clock, Value(),
+          Value()));
+    }
+    return chain[weight];
+  };
+
+  for (auto &edge : edges) {
+    unsigned weight = getRetimedWeight(edge, lags);
+    if (auto *def = edge.source.getDefiningOp())
+      if (def->hasTrait<OpTrait::ConstantLike>())
+        weight = 0;
+    edge.user->setOperand(edge.operandIdx, getDelayed(edge.source, weight));
+  }
+
+  // The original registers are now only used by each other.
+  for (auto reg : registers)
+    reg->dropAllUses();
+  for (auto reg : registers)
+    reg.erase();
+}
+
+namespace {
+struct RetimingPass : public RetimingBase<RetimingPass> {
+  void runOnOperation() override;
+
+private:
+  void retime(Block &body, Value clock,
+              const llvm::StringMap<unsigned> &delayModel);
+};
+} // anonymous namespace
+
+/// Retime the registers of `clock` in `body` for the minimum period, found by
+/// a binary search over the periods between the largest delay of a single
+/// operation and the current period.
+void RetimingPass::retime(Block &body, Value clock,
+                          const llvm::StringMap<unsigned> &delayModel) {
+  RetimingGraph graph(body, clock, delayModel);
+  if (!graph.build())
+    return;
+
+  SmallVector<int> noLags(graph.getNumVertices(), 0);
+  auto current = graph.getPeriod(noLags);
+  if (!current)
+    return;
+
+  unsigned low = graph.getMaxDelay(), high = *current;
+  Optional<SmallVector<int>> best;
+  while (low < high) {
+    unsigned period = low + (high - low) / 2;
+    if (auto lags = graph.findRetiming(period)) {
+      best = std::move(lags);
+      high = period;
+    } else {
+      low = period + 1;
+    }
+  }
+
+  if (best)
+    graph.apply(*best);
+}
+
+void RetimingPass::runOnOperation() {
+  llvm::StringMap<unsigned> delayModel;
+  for (auto &entry : defaultDelays)
+    delayModel[entry.first] = entry.second;
+  for (auto &delay : delays) {
+    StringRef name, value;
+    std::tie(name, value) = StringRef(delay).split('=');
+    unsigned parsed;
+    if (value.getAsInteger(10, parsed)) {
+      getOperation().emitError("invalid delay '") << delay << "'";
+      return signalPassFailure();
+    }
+    delayModel[name] = parsed;
+  }
+
+  for (auto module : getOperation().getOps<hw::HWModuleOp>()) {
+    Block &body = *module.getBodyBlock();
+    llvm::SetVector<Value> clocks;
+    for (auto reg : body.getOps<CompRegOp>())
+      if (!reg.reset())
+        clocks.insert(reg.clk());
+    for (auto clock : clocks)
+      retime(body, clock, delayModel);
+  }
+}
+
+namespace circt {
+namespace seq {
+std::unique_ptr<OperationPass<ModuleOp>> createSeqRetimingPass() {
+  return std::make_unique<RetimingPass>();
+}
+} // namespace seq
+} // namespace circt
@@ -6,6 +6,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVOps.h"
 #include "circt/Dialect/Seq/SeqOps.h"
 #include "mlir/IR/Builders.h"
@@ -27,9 +29,25 @@ namespace seq {
 namespace {
 struct SeqToSVPass : public LowerSeqToSVBase<SeqToSVPass> {
   void runOnOperation() override;
+
+private:
+  void lowerRegisters(Block &body);
 };
 } // anonymous namespace
 
+/// Create the `sv.reg` holding the value of `reg`.
+static sv::RegOp createSVReg(OpBuilder &builder, CompRegOp reg) {
+  auto svReg =
+      builder.create<sv::RegOp>(reg.getLoc(), reg.getResult().getType());
+  DictionaryAttr regAttrs = reg->getAttrDictionary();
+  if (!regAttrs.empty())
+    svReg->setAttrs(regAttrs);
+  if (!svReg->hasAttrOfType<StringAttr>("name"))
+    // sv.reg requires a name attribute.
+    svReg->setAttr("name", builder.getStringAttr(""));
+  return svReg;
+}
+
 namespace {
 /// Lower CompRegOp to `sv.reg` and `sv.alwaysff`. Use a posedge clock and
 /// synchronous reset.
@@ -42,13 +60,7 @@ public:
                   ConversionPatternRewriter &rewriter) const final {
     Location loc = reg.getLoc();
 
-    auto svReg = rewriter.create<sv::RegOp>(loc, reg.getResult().getType());
-    DictionaryAttr regAttrs = reg->getAttrDictionary();
-    if (!regAttrs.empty())
-      svReg->setAttrs(regAttrs);
-    if (!svReg->hasAttrOfType<StringAttr>("name"))
-      // sv.reg requires a name attribute.
-      svReg->setAttr("name", rewriter.getStringAttr(""));
+    auto svReg = createSVReg(rewriter, reg);
     auto regVal = rewriter.create<sv::ReadInOutOp>(loc, svReg);
 
     if (reg.reset() && reg.resetValue()) {
@@ -71,10 +83,91 @@ public:
 };
 
 } // namespace
+
+/// If `reg` only loads a new value when an enable is set, i.e. its input is a
+/// `comb.mux` selecting between the register's own value and a new one,
+/// return the enable and the new value.
+static Optional<std::pair<Value, Value>> matchEnable(OpBuilder &builder,
+                                                     CompRegOp reg) {
+  auto mux = reg.input().getDefiningOp<comb::MuxOp>();
+  if (!mux)
+    return None;
+  if (mux.falseValue() == reg.data())
+    return std::make_pair(mux.cond(), mux.trueValue());
+  if (mux.trueValue() != reg.data())
+    return None;
+
+  // The register holds its value while the condition is set.
+  Location loc = reg.getLoc();
+  auto one = builder.create<hw::ConstantOp>(loc, APInt(1, 1));
+  Value enable = builder.create<comb::XorOp>(loc, mux.cond(), one);
+  return std::make_pair(enable, mux.falseValue());
+}
+
+/// Lower the registers in `body`. Registers with the same clock and reset
+/// share a single `sv.alwaysff` if `mergeAlwaysBlocks` is set. Registers with
+/// an input of the form `mux(en, d, q)`, where `q` is the register's own
+/// value, only assign `d` within an `sv.if` on the enable if `extractEnables`
+/// is set.
+void SeqToSVPass::lowerRegisters(Block &body) {
+  DenseMap<std::pair<Value, Value>, sv::AlwaysFFOp> alwaysBlocks;
+  for (auto reg : llvm::make_early_inc_range(body.getOps<CompRegOp>())) {
+    Location loc = reg.getLoc();
+    OpBuilder builder(reg);
+    auto svReg = createSVReg(builder, reg);
+    auto regVal = builder.create<sv::ReadInOutOp>(loc, svReg);
+
+    bool hasReset = reg.reset() && reg.resetValue();
+    Value reset = hasReset ? reg.reset() : Value();
+    sv::AlwaysFFOp &always = alwaysBlocks[{reg.clk(), reset}];
+    if (!always || !mergeAlwaysBlocks) {
+      // Shared blocks follow all register declarations.
+      OpBuilder alwaysBuilder =
+          mergeAlwaysBlocks ? OpBuilder(body.getTerminator()) : builder;
+      if (hasReset)
+        always = alwaysBuilder.create<sv::AlwaysFFOp>(
+            loc, sv::EventControl::AtPosEdge, reg.clk(), ResetType::SyncReset,
+            sv::EventControl::AtPosEdge, reset);
+      else
+        always = alwaysBuilder.create<sv::AlwaysFFOp>(
+            loc, sv::EventControl::AtPosEdge, reg.clk());
+    }
+
+    Value input = reg.input();
+    Optional<std::pair<Value, Value>> enable;
+    if (extractEnables)
+      enable = matchEnable(builder, reg);
+
+    auto bodyBuilder = OpBuilder::atBlockEnd(always.getBodyBlock());
+    if (enable) {
+      bodyBuilder.create<sv::IfOp>(loc, enable->first, [&]() {
+        bodyBuilder.create<sv::PAssignOp>(loc, svReg, enable->second);
+      });
+    } else {
+      bodyBuilder.create<sv::PAssignOp>(loc, svReg, input);
+    }
+    if (hasReset) {
+      auto resetBuilder = OpBuilder::atBlockEnd(always.getResetBlock());
+      resetBuilder.create<sv::PAssignOp>(loc, svReg, reg.resetValue());
+    }
+
+    reg.replaceAllUsesWith(regVal.getResult());
+    reg.erase();
+    if (enable && input.use_empty())
+      input.getDefiningOp()->erase();
+  }
+}
+
 void SeqToSVPass::runOnOperation() {
   ModuleOp top = getOperation();
   MLIRContext &ctxt = getContext();
 
+  if (mergeAlwaysBlocks || extractEnables) {
+    for (auto module : top.getOps<hw::HWModuleOp>())
+      lowerRegisters(*module.getBodyBlock());
+    return;
+  }
+
   ConversionTarget target(ctxt);
   target.addIllegalDialect<SeqDialect>();
   target.addLegalDialect<sv::SVDialect>();
@@ -90,6 +183,7 @@ namespace seq {
 std::unique_ptr<OperationPass<ModuleOp>> createSeqLowerToSVPass() {
   return std::make_unique<SeqToSVPass>();
 }
+std::unique_ptr<OperationPass<ModuleOp>> createSeqRetimingPass();
 } // namespace seq
 } // namespace circt
 
@@ -0,0 +1,367 @@
+//===- CycleSimulator.cpp - Cycle-based simulator of HW modules -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the cycle-based simulator. The flattened design is
+// compiled into a list of instructions on a flat vector of values, which is
+// sorted topologically once, so that each evaluation is a single pass over it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Seq/Simulator/CycleSimulator.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/Seq/SeqOps.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace seq;
+using namespace sim;
+
+CycleSimulator::CycleSimulator(hw::HWModuleOp top) : top(top) {}
+
+StringRef CycleSimulator::getInputName(unsigned idx) {
+  return hw::getModuleArgumentName(top, idx);
+}
+
+StringRef CycleSimulator::getOutputName(unsigned idx) {
+  return hw::getModuleResultName(top, idx);
+}
+
+auto CycleSimulator::getKind(Operation *op) -> Optional<Kind> {
+  return TypeSwitch<Operation *, Optional<Kind>>(op)
+      .Case([](comb::AddOp) { return Kind::Add; })
+      .Case([](comb::SubOp) { return Kind::Sub; })
+      .Case([](comb::MulOp) { return Kind::Mul; })
+      .Case([](comb::DivUOp) { return Kind::DivU; })
+      .Case([](comb::DivSOp) { return Kind::DivS; })
+      .Case([](comb::ModUOp) { return Kind::ModU; })
+      .Case([](comb::ModSOp) { return Kind::ModS; })
+      .Case([](comb::ShlOp) { return Kind::Shl; })
+      .Case([](comb::ShrUOp) { return Kind::ShrU; })
+      .Case([](comb::ShrSOp) { return Kind::ShrS; })
+      .Case([](comb::AndOp) { return Kind::And; })
+      .Case([](comb::OrOp) { return Kind::Or; })
+      .Case([](comb::XorOp) { return Kind::Xor; })
+      .Case([](comb::ICmpOp) { return Kind::ICmp; })
+      .Case([](comb::ParityOp) { return Kind::Parity; })
+      .Case([](comb::ExtractOp) { return Kind::Extract; })
+      .Case([](comb::SExtOp) { return Kind::SExt; })
+      .Case([](comb::ConcatOp) { return Kind::Concat; })
+      .Case([](comb::MuxOp) { return Kind::Mux; })
+      .Default([](Operation *) { return None; });
+}
+
+Optional<unsigned> CycleSimulator::addSlot(Type type) {
+  auto intType = type.dyn_cast<IntegerType>();
+  if (!intType)
+    return None;
+  values.push_back(APInt(intType.getWidth(), 0));
+  return values.size() - 1;
+}
+
+LogicalResult CycleSimulator::build() {
+  for (auto arg : top.getArguments()) {
+    auto slot = addSlot(arg.getType());
+    if (!slot)
+      return top.emitError("cycle simulator doesn't support port type ")
+             << arg.getType();
+    inputSlots.push_back(*slot);
+  }
+
+  if (failed(compileModule(top, inputSlots, outputSlots)) || failed(levelize()))
+    return failure();
+
+  for (auto &reg : registers)
+    nextValues.push_back(values[reg.data]);
+  return success();
+}
+
+/// Compile the body of `module`, whose arguments are held in `argSlots`, and
+/// append the slots of its outputs to `resultSlots`. Instances are compiled
+/// recursively, with their operands as the arguments of the child module.
+LogicalResult
+CycleSimulator::compileModule(hw::HWModuleOp module,
+                              ArrayRef<unsigned> argSlots,
+                              SmallVectorImpl<unsigned> &resultSlots) {
+  if (!activeModules.insert(module).second)
+    return module.emitError("cannot simulate the recursive instantiation of ")
+           << "module '" << SymbolTable::getSymbolName(module) << "'";
+
+  Block *body = module.getBodyBlock();
+  DenseMap<Value, unsigned> slots;
+  for (auto arg : llvm::zip(body->getArguments(), argSlots))
+    slots[std::get<0>(arg)] = std::get<1>(arg);
+
+  // The body is a graph region, so values may be used before they are
+  // defined. Allocate all slots up front.
+  for (auto &op : *body) {
+    for (auto result : op.getResults()) {
+      auto slot = addSlot(result.getType());
+      if (!slot)
+        return op.emitOpError("has type ")
+               << result.getType() << ", which the cycle simulator doesn't "
+               << "support";
+      slots[result] = *slot;
+    }
+  }
+
+  auto getSlots = [&](ValueRange operands) {
+    SmallVector<unsigned, 2> operandSlots;
+    for (auto operand : operands)
+      operandSlots.push_back(slots.lookup(operand));
+    return operandSlots;
+  };
+
+  for (auto &op : *body) {
+    if (auto output = dyn_cast<hw::OutputOp>(op)) {
+      auto outputs = getSlots(output.getOperands());
+      resultSlots.append(outputs.begin(), outputs.end());
+      continue;
+    }
+
+    if (auto constant = dyn_cast<hw::ConstantOp>(op)) {
+      values[slots[constant]] = constant.value();
+      continue;
+    }
+
+    if (auto reg = dyn_cast<CompRegOp>(op)) {
+      Register newReg{slots[reg], slots.lookup(reg.input()), None, None};
+      if (reg.reset() && reg.resetValue()) {
+        newReg.reset = slots.lookup(reg.reset());
+        newReg.resetValue = slots.lookup(reg.resetValue());
+      }
+      clockSlots.insert(slots.lookup(reg.clk()));
+      registers.push_back(newReg);
+      continue;
+    }
+
+    if (auto instance = dyn_cast<hw::InstanceOp>(op)) {
+      auto child = dyn_cast_or_null<hw::HWModuleOp>(
+          instance.getReferencedModule(symbolTable));
+      if (!child)
+        return instance.emitOpError("instantiates '")
+               << instance.moduleName()
+               << "', which the cycle simulator can't simulate";
+
+      SmallVector<unsigned> childResults;
+      if (failed(compileModule(child, getSlots(instance.inputs()),
+                               childResults)))
+        return failure();
+      for (auto result : llvm::zip(instance.getResults(), childResults)) {
+        instructions.push_back(
+            {Kind::Copy, slots[std::get<0>(result)], {std::get<1>(result)}});
+        instructionOps.push_back(instance);
+      }
+      continue;
+    }
+
+    auto kind = getKind(&op);
+    if (!kind)
+      return op.emitOpError("is not supported by the cycle simulator");
+
+    Instruction inst{*kind, slots[op.getResult(0)], getSlots(op.getOperands())};
+    if (auto icmp = dyn_cast<comb::ICmpOp>(op))
+      inst.attr = (unsigned)icmp.predicate();
+    else if (auto extract = dyn_cast<comb::ExtractOp>(op))
+      inst.attr = extract.lowBit();
+    instructions.push_back(std::move(inst));
+    instructionOps.push_back(&op);
+  }
+
+  activeModules.erase(module);
+  return success();
+}
+
+/// Sort the instructions topologically. The inputs, constants and registers
+/// are not computed by any instruction, so they start the order.
+LogicalResult CycleSimulator::levelize() {
+  unsigned numInsts = instructions.size();
+  SmallVector<int> producers(values.size(), -1);
+  for (unsigned i = 0; i < numInsts; ++i)
+    producers[instructions[i].result] = i;
+
+  SmallVector<SmallVector<unsigned, 2>> users(numInsts);
+  SmallVector<unsigned> numPreds(numInsts, 0);
+  for (unsigned i = 0; i < numInsts; ++i) {
+    for (auto operand : instructions[i].operands) {
+      int producer = producers[operand];
+      if (producer < 0)
+        continue;
+      users[producer].push_back(i);
+      ++numPreds[i];
+    }
+  }
+
+  SmallVector<unsigned> order;
+  for (unsigned i = 0; i < numInsts; ++i)
+    if (numPreds[i] == 0)
+      order.push_back(i);
+  for (unsigned i = 0; i < order.size(); ++i)
+    for (auto user : users[order[i]])
+      if (--numPreds[user] == 0)
+        order.push_back(user);
+
+  if (order.size() != numInsts) {
+    for (unsigned i = 0; i < numInsts; ++i)
+      if (numPreds[i] != 0)
+        return instructionOps[i]->emitOpError(
+            "is part of a combinational cycle");
+  }
+
+  SmallVector<Instruction> sorted;
+  sorted.reserve(numInsts);
+  for (auto i : order)
+    sorted.push_back(std::move(instructions[i]));
+  instructions = std::move(sorted);
+  instructionOps.clear();
+  return success();
+}
+
+static bool compare(comb::ICmpPredicate predicate, const APInt &lhs,
+                    const APInt &rhs) {
+  switch (predicate) {
+  case comb::ICmpPredicate::eq:
+    return lhs.eq(rhs);
+  case comb::ICmpPredicate::ne:
+    return lhs.ne(rhs);
+  case comb::ICmpPredicate::slt:
+    return lhs.slt(rhs);
+  case comb::ICmpPredicate::sle:
+    return lhs.sle(rhs);
+  case comb::ICmpPredicate::sgt:
+    return lhs.sgt(rhs);
+  case comb::ICmpPredicate::sge:
+    return lhs.sge(rhs);
+  case comb::ICmpPredicate::ult:
+    return lhs.ult(rhs);
+  case comb::ICmpPredicate::ule:
+    return lhs.ule(rhs);
+  case comb::ICmpPredicate::ugt:
+    return lhs.ugt(rhs);
+  case comb::ICmpPredicate::uge:
+    return lhs.uge(rhs);
+  }
+  llvm_unreachable("unknown comparison predicate");
+}
+
+void CycleSimulator::execute(const Instruction &inst) {
+  APInt &result = values[inst.result];
+  auto operand = [&](unsigned idx) -> const APInt & {
+    return values[inst.operands[idx]];
+  };
+  unsigned numOperands = inst.operands.size();
+
+  switch (inst.kind) {
+  case Kind::Add:
+    result = operand(0);
+    for (unsigned i = 1; i < numOperands; ++i)
+      result += operand(i);
+    break;
+  case Kind::Sub:
+    result = operand(0) - operand(1);
+    break;
+  case Kind::Mul:
+    result = operand(0);
+    for (unsigned i = 1; i < numOperands; ++i)
+      result *= operand(i);
+    break;
+  // Division by zero is undefined, the simulator produces zero.
+  case Kind::DivU:
+    result = operand(1).isNullValue() ? APInt(result.getBitWidth(), 0)
+                                      : operand(0).udiv(operand(1));
+    break;
+  case Kind::DivS:
+    result = operand(1).isNullValue() ? APInt(result.getBitWidth(), 0)
+                                      : operand(0).sdiv(operand(1));
+    break;
+  case Kind::ModU:
+    result = operand(1).isNullValue() ? APInt(result.getBitWidth(), 0)
+                                      : operand(0).urem(operand(1));
+    break;
+  case Kind::ModS:
+    result = operand(1).isNullValue() ? APInt(result.getBitWidth(), 0)
+                                      : operand(0).srem(operand(1));
+    break;
+  case Kind::Shl:
+    result = operand(0).shl(operand(1));
+    break;
+  case Kind::ShrU:
+    result = operand(0).lshr(operand(1));
+    break;
+  case Kind::ShrS:
+    result = operand(0).ashr(operand(1));
+    break;
+  case Kind::And:
+    result = operand(0);
+    for (unsigned i = 1; i < numOperands; ++i)
+      result &= operand(i);
+    break;
+  case Kind::Or:
+    result = operand(0);
+    for (unsigned i = 1; i < numOperands; ++i)
+      result |= operand(i);
+    break;
+  case Kind::Xor:
+    result = operand(0);
+    for (unsigned i = 1; i < numOperands; ++i)
+      result ^= operand(i);
+    break;
+  case Kind::ICmp:
+    result = APInt(1, compare((comb::ICmpPredicate)inst.attr, operand(0),
+                              operand(1)));
+    break;
+  case Kind::Parity:
+    result = APInt(1, operand(0).countPopulation() & 1);
+    break;
+  case Kind::Extract:
+    result = operand(0).extractBits(result.getBitWidth(), inst.attr);
+    break;
+  case Kind::SExt:
+    result = operand(0).sext(result.getBitWidth());
+    break;
+  case Kind::Concat: {
+    // The first operand holds the most significant bits.
+    unsigned lowBit = result.getBitWidth();
+    for (unsigned i = 0; i < numOperands; ++i) {
+      lowBit -= operand(i).getBitWidth();
+      result.insertBits(operand(i), lowBit);
+    }
+    break;
+  }
+  case Kind::Mux:
+    result = operand(0).getBoolValue() ? operand(1) : operand(2);
+    break;
+  case Kind::Copy:
+    result = operand(0);
+    break;
+  }
+}
+
+void CycleSimulator::setInput(unsigned idx, const APInt &value) {
+  assert(value.getBitWidth() == getInputWidth(idx) && "input width mismatch");
+  values[inputSlots[idx]] = value;
+}
+
+void CycleSimulator::eval() {
+  for (auto &inst : instructions)
+    execute(inst);
+}
+
+void CycleSimulator::step() {
+  // All registers sample their inputs before any of them changes.
+  for (unsigned i = 0, e = registers.size(); i < e; ++i) {
+    auto &reg = registers[i];
+    if (reg.reset && values[*reg.reset].getBoolValue())
+      nextValues[i] = values[*reg.resetValue];
+    else
+      nextValues[i] = values[reg.input];
+  }
+  for (unsigned i = 0, e = registers.size(); i < e; ++i)
+    values[registers[i].data] = nextValues[i];
+  ++cycle;
+}
@@ -0,0 +1,559 @@
+//===- Firtool.cpp - The firtool compilation pipeline ---------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pipeline of firtool: parsing an input, the passes
+// from FIRRTL down to HW and the emission of the output.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Firtool/Firtool.h"
+#include "circt/Conversion/Passes.h"
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/FIRRTL/FIRParser.h"
+#include "circt/Dialect/FIRRTL/FIRRTLBytecode.h"
+#include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/SV/SVDialect.h"
+#include "circt/Dialect/SV/SVPasses.h"
+#include "circt/Transforms/Passes.h"
+#include "circt/Translation/ExportVerilog.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/Verifier.h"
+#include "mlir/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Support/FileUtilities.h"
+#include "mlir/Transforms/Passes.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace firtool;
+
+/// The attribute of a checkpoint, recording the stage it was written after,
+/// and the input and black box root of the run which wrote it.
+static constexpr StringLiteral checkpointAttrName = "firtool.checkpoint";
+
+/// The attribute naming the input while the pipeline runs, so that the
+/// checkpoints can record it.
+static constexpr StringLiteral inputAttrName = "firtool.input";
+
+StringRef firtool::getCheckpointStageName(CheckpointStage stage) {
+  switch (stage) {
+  case CheckpointStage::None:
+    return "none";
+  case CheckpointStage::Parse:
+    return "parse";
+  case CheckpointStage::LowerTypes:
+    return "lower-types";
+  case CheckpointStage::LowerToHW:
+    return "lower-to-hw";
+  case CheckpointStage::Cleanup:
+    return "cleanup";
+  }
+  llvm_unreachable("unknown checkpoint stage");
+}
+
+namespace {
+/// Write the module to `<checkpoint-dir>/<stage>.firbc`, marked with the stage
+/// so that a later run given the checkpoint continues after it.  The black box
+/// root is recorded as an absolute path, since the checkpoint is usually
+/// somewhere else than the input.
+struct CheckpointPass
+    : public PassWrapper<CheckpointPass, OperationPass<ModuleOp>> {
+  CheckpointPass(StringRef checkpointDir, CheckpointStage stage,
+                 StringRef blackBoxRoot)
+      : checkpointDir(checkpointDir.str()), stage(stage),
+        blackBoxRoot(blackBoxRoot) {
+    llvm::sys::fs::make_absolute(this->blackBoxRoot);
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+    SmallString<128> path(checkpointDir);
+    llvm::sys::path::append(path, getCheckpointStageName(stage) + ".firbc");
+
+    std::string errorMessage;
+    auto output = openOutputFile(path, &errorMessage);
+    if (!output) {
+      module.emitError(errorMessage);
+      return signalPassFailure();
+    }
+    Builder builder(&getContext());
+    SmallVector<NamedAttribute, 3> fields;
+    fields.push_back(builder.getNamedAttr(
+        "stage", builder.getStringAttr(getCheckpointStageName(stage))));
+    fields.push_back(builder.getNamedAttr(
+        "blackBoxRoot", builder.getStringAttr(blackBoxRoot)));
+    if (auto input = module->getAttrOfType<StringAttr>(inputAttrName))
+      fields.push_back(builder.getNamedAttr("input", input));
+    module->setAttr(checkpointAttrName, builder.getDictionaryAttr(fields));
+    firrtl::writeFIRRTLBytecode(module, output->os());
+    module->removeAttr(checkpointAttrName);
+    output->keep();
+    markAllAnalysesPreserved();
+  }
+
+  std::string checkpointDir;
+  CheckpointStage stage;
+  SmallString<128> blackBoxRoot;
+};
+} // namespace
+
+void firtool::loadFirtoolDialects(MLIRContext &context) {
+  context.loadDialect<firrtl::FIRRTLDialect, hw::HWDialect, comb::CombDialect,
+                      sv::SVDialect>();
+}
+
+void firtool::populateFirtoolPipeline(PassManager &pm,
+                                      const FirtoolOptions &options,
+                                      InputFormatKind format,
+                                      StringRef blackBoxRoot,
+                                      CheckpointStage resumeStage) {
+  auto addCheckpoint = [&](CheckpointStage stage) {
+    if (!options.checkpointDir.empty())
+      pm.addPass(std::make_unique<CheckpointPass>(options.checkpointDir, stage,
+                                                  blackBoxRoot));
+  };
+  bool lowering = options.isLowering();
+  // The module bodies are discarded in interface-only mode, so there is no
+  // point in optimizing them.
+  bool optimize = !options.disableOptimization && !options.interfaceOnly;
+  bool incrementalCanonicalize = options.incrementalCanonicalize;
+
+  if (resumeStage < CheckpointStage::Parse)
+    addCheckpoint(CheckpointStage::Parse);
+
+  if (resumeStage < CheckpointStage::LowerTypes) {
+    // CSE already ran on each module during parsing when streaming.
+    bool streamedCSE = options.streamModulePasses && format == InputFIRFile;
+    if (optimize && !streamedCSE) {
+      pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>().addPass(
+          createCSEPass());
+    }
+
+    // Width inference creates canonicalization opportunities.
+    if (options.inferWidths)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createInferWidthsPass());
+
+    // Convert the register vectors annotated for it into memories, before
+    // LowerTypes splits them up.
+    if (options.lowerTypes)
+      pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>().addPass(
+          firrtl::createRegVectorToMemPass());
+
+    // Deduplicate once the widths are known, since identical modules may have
+    // ports inferred to different widths.
+    if (options.dedup)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createDedupPass());
+
+    // The input mlir file could be firrtl dialect so we might need to clean
+    // things up.
+    if (options.lowerTypes) {
+      pm.addNestedPass<firrtl::CircuitOp>(
+          firrtl::createLowerFIRRTLTypesPass(options.preserveAggregate));
+      // Only enable expand whens if lower types is also enabled.
+      if (options.expandWhens) {
+        auto &modulePM =
+            pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>();
+        if (options.forwardConnects)
+          modulePM.addPass(firrtl::createForwardConnectsPass());
+        modulePM.addPass(firrtl::createExpandWhensPass());
+      }
+    }
+    addCheckpoint(CheckpointStage::LowerTypes);
+  }
+
+  if (resumeStage < CheckpointStage::LowerToHW) {
+    // If we parsed a FIRRTL file and have optimizations enabled, clean it up.
+    if (optimize) {
+      auto &modulePM = pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>();
+      modulePM.addPass(createSimpleCanonicalizerPass(incrementalCanonicalize));
+    }
+
+    if (options.inliner)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createInlinerPass());
+
+    if (options.imconstprop && !options.interfaceOnly)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createIMConstPropPass());
+
+    if (options.imdce && !options.interfaceOnly)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createIMDeadCodeElimPass());
+
+    if (options.blackBoxMemory)
+      pm.nest<firrtl::CircuitOp>().addPass(firrtl::createBlackBoxMemoryPass());
+
+    // Read black box source files into the IR.
+    StringRef blackBoxResourceRoot = options.blackBoxRootResourcePath;
+    pm.nest<firrtl::CircuitOp>().addPass(firrtl::createBlackBoxReaderPass(
+        blackBoxRoot,
+        blackBoxResourceRoot.empty() ? blackBoxRoot : blackBoxResourceRoot,
+        options.blackBoxInlineSizeLimit));
+
+    if (options.grandCentral) {
+      auto &circuitPM = pm.nest<firrtl::CircuitOp>();
+      circuitPM.addPass(firrtl::createGrandCentralPass());
+      circuitPM.addPass(firrtl::createGrandCentralTapsPass());
+    }
+
+    // Lower if we are going to verilog or if lowering was specifically
+    // requested.
+    if (lowering) {
+      // When only verifying at the boundaries, this is where the output of
+      // the FIRRTL passes is checked.
+      if (options.verifyBoundaries)
+        pm.nest<firrtl::CircuitOp>().addPass(
+            firrtl::createVerifyCircuitPass());
+      pm.addPass(createLowerFIRRTLToHWPass(options.enableAnnotationWarning,
+                                           options.groupDebugStatements));
+      addCheckpoint(CheckpointStage::LowerToHW);
+    }
+  }
+
+  if (lowering && resumeStage < CheckpointStage::Cleanup) {
+    pm.addPass(sv::createHWMemSimImplPass(options.randomizeMemInit,
+                                          options.readMemInit));
+
+    // Drop the module bodies, including the ones of the memories, leaving
+    // nothing for the remaining passes to do.
+    if (options.interfaceOnly)
+      pm.addPass(sv::createHWStubExternalModulesPass(/*interfaceOnly=*/true));
+
+    if (options.extractTestCode && !options.interfaceOnly)
+      pm.addPass(sv::createSVExtractTestCodePass());
+
+    // If enabled, run the optimizer.
+    if (optimize) {
+      auto &modulePM = pm.nest<hw::HWModuleOp>();
+      modulePM.addPass(sv::createHWCleanupPass());
+      modulePM.addPass(createCSEPass());
+      modulePM.addPass(sv::createHWValueNumberingPass());
+      modulePM.addPass(createSimpleCanonicalizerPass(incrementalCanonicalize));
+    }
+    addCheckpoint(CheckpointStage::Cleanup);
+  }
+
+  // Add passes specific to Verilog emission if we're going there.
+  if (options.outputFormat == OutputVerilog ||
+      options.outputFormat == OutputSplitVerilog) {
+    // Legalize the module names.
+    pm.addPass(sv::createHWLegalizeNamesPass());
+
+    // Tidy up the IR to improve verilog emission quality.
+    if (optimize) {
+      auto &modulePM = pm.nest<hw::HWModuleOp>();
+      modulePM.addPass(sv::createPrettifyVerilogPass());
+    }
+  }
+}
+
+LogicalResult firtool::compileFirtoolInput(
+    std::unique_ptr<llvm::MemoryBuffer> input,
+    std::unique_ptr<llvm::MemoryBuffer> annotations, InputFormatKind format,
+    const FirtoolOptions &options, MLIRContext &context, TimingScope &ts,
+    const FirtoolCallbacks &callbacks,
+    function_ref<LogicalResult(ModuleOp, TimingScope &)> output,
+    OwningModuleRef *result) {
+  llvm::SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(input), llvm::SMLoc());
+
+  // Add the annotation file if one was explicitly specified.
+  if (annotations)
+    sourceMgr.AddNewSourceBuffer(std::move(annotations), llvm::SMLoc());
+
+  std::unique_ptr<ScopedDiagnosticHandler> diagnosticHandler;
+  if (callbacks.getDiagnosticHandler)
+    diagnosticHandler = callbacks.getDiagnosticHandler(sourceMgr);
+
+  // Lazy info locators are decoded when a diagnostic is reported against them.
+  // The diagnostic is reported again with the decoded locations, so that it
+  // reaches the other handlers like any other.
+  Optional<ScopedDiagnosticHandler> lazyLocatorHandler;
+  if (options.lazyFIRLocations)
+    lazyLocatorHandler.emplace(&context, [&](Diagnostic &diag) {
+      auto loc = firrtl::materializeInfoLocator(diag.getLocation());
+      bool changed = loc != diag.getLocation();
+      SmallVector<Location> noteLocs;
+      for (auto &note : diag.getNotes()) {
+        noteLocs.push_back(firrtl::materializeInfoLocator(note.getLocation()));
+        changed |= noteLocs.back() != note.getLocation();
+      }
+
+      // Let the other handlers deal with normal diagnostics themselves.
+      if (!changed)
+        return failure();
+
+      Diagnostic decoded(loc, diag.getSeverity());
+      decoded << diag.str();
+      for (auto noteAndLoc : llvm::zip(diag.getNotes(), noteLocs))
+        decoded.attachNote(std::get<1>(noteAndLoc))
+            << std::get<0>(noteAndLoc).str();
+      context.getDiagEngine().emit(std::move(decoded));
+      return success();
+    });
+
+  auto parsed = [&](TimingScope &parserTimer) {
+    if (callbacks.afterParse)
+      callbacks.afterParse(parserTimer);
+  };
+  OwningModuleRef module;
+  if (format == InputFIRFile) {
+    auto parserTimer = ts.nest("FIR Parser");
+    firrtl::FIRParserOptions parserOptions;
+    parserOptions.ignoreInfoLocators = options.ignoreFIRLocations;
+    parserOptions.lazyInfoLocators = options.lazyFIRLocations;
+    // Only the passes that run before width inference are safe to run on
+    // freshly parsed modules, which is just CSE.  Each module gets its own
+    // pass manager since this is called from the parser's threads.
+    if (options.streamModulePasses && !options.disableOptimization &&
+        !options.interfaceOnly)
+      parserOptions.moduleBodyCallback = [&](Operation *op) -> LogicalResult {
+        PassManager modulePM(&context, firrtl::FModuleOp::getOperationName());
+        modulePM.enableVerifier(options.verifyPasses &&
+                                !options.verifyBoundaries);
+        modulePM.addPass(createCSEPass());
+        return modulePM.run(op);
+      };
+    module = importFIRRTL(sourceMgr, &context, parserOptions, &parserTimer);
+    parsed(parserTimer);
+  } else if (format == InputFIRBytecodeFile) {
+    auto parserTimer = ts.nest("FIRRTL Bytecode Reader");
+    module = firrtl::importFIRRTLBytecode(sourceMgr, &context);
+    parsed(parserTimer);
+  } else {
+    auto parserTimer = ts.nest("MLIR Parser");
+    assert(format == InputMLIRFile);
+    module = parseSourceFile(sourceMgr, &context);
+    parsed(parserTimer);
+  }
+  if (!module)
+    return failure();
+
+  // A checkpoint records the stage it was written after, and the pipeline
+  // resumes from there.  Its black box root is used unless another one is
+  // given, and the checkpoints written from here on name the original input.
+  auto resumeStage = CheckpointStage::None;
+  StringRef checkpointBlackBoxRoot;
+  StringRef inputName =
+      sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())
+          ->getBufferIdentifier();
+  if (auto checkpoint = module->getAttr(checkpointAttrName)) {
+    auto fields = checkpoint.dyn_cast<DictionaryAttr>();
+    auto stageAttr = fields ? fields.getAs<StringAttr>("stage") : StringAttr();
+    auto rootAttr =
+        fields ? fields.getAs<StringAttr>("blackBoxRoot") : StringAttr();
+    if (!stageAttr || !rootAttr) {
+      module->emitError("malformed checkpoint: expected its stage and black "
+                        "box root");
+      return failure();
+    }
+    for (auto stage : {CheckpointStage::Parse, CheckpointStage::LowerTypes,
+                       CheckpointStage::LowerToHW, CheckpointStage::Cleanup})
+      if (stageAttr.getValue() == getCheckpointStageName(stage))
+        resumeStage = stage;
+    if (resumeStage == CheckpointStage::None) {
+      module->emitError("unknown checkpoint stage '")
+          << stageAttr.getValue() << "'";
+      return failure();
+    }
+    checkpointBlackBoxRoot = rootAttr.getValue();
+    if (auto inputAttr = fields.getAs<StringAttr>("input"))
+      inputName = inputAttr.getValue();
+    module->removeAttr(checkpointAttrName);
+  }
+
+  if (callbacks.prepareModule)
+    callbacks.prepareModule(module.get());
+
+  std::unique_ptr<PassManager> ownedPM;
+  PassManager *pm;
+  if (callbacks.getPipelineAfter) {
+    pm = &callbacks.getPipelineAfter(resumeStage, checkpointBlackBoxRoot);
+  } else {
+    ownedPM = std::make_unique<PassManager>(&context);
+    ownedPM->enableVerifier(options.verifyPasses && !options.verifyBoundaries);
+    ownedPM->enableTiming(ts);
+    StringRef blackBoxRoot = options.blackBoxRootPath;
+    if (blackBoxRoot.empty())
+      blackBoxRoot = checkpointBlackBoxRoot;
+    populateFirtoolPipeline(*ownedPM, options, format, blackBoxRoot,
+                            resumeStage);
+    pm = ownedPM.get();
+  }
+  if (!options.checkpointDir.empty())
+    module->setAttr(inputAttrName, StringAttr::get(&context, inputName));
+  auto pipelineResult = pm->run(module.get());
+  module->removeAttr(inputAttrName);
+  if (failed(pipelineResult))
+    return failure();
+
+  // The pass manager doesn't verify the result of the pipeline unless it
+  // verifies after each pass.
+  if (options.verifyBoundaries && failed(verify(module.get())))
+    return failure();
+
+  auto outputTimer = ts.nest("Output");
+
+  // Decode the info locators that survived the pipeline so that they show up
+  // in the output.
+  if (options.lazyFIRLocations)
+    firrtl::materializeInfoLocators(module.get());
+
+  auto outputResult = output(module.get(), outputTimer);
+  if (result)
+    *result = std::move(module);
+  return outputResult;
+}
+
+namespace {
+/// A piece of the MLIR output: an operation printed on its own, or the text
+/// around the contents of an operation holding others.
+struct MLIRPiece {
+  Operation *op;
+  std::string text;
+  unsigned indent;
+};
+} // namespace
+
+/// Split the output of `op` into pieces, opening the module and the FIRRTL
+/// circuit so that the operations they hold are printed apart.  The
+/// operations which aren't isolated from above are cloned to be printed on
+/// their own.  Fail if an operation defines values at the top level, which
+/// the others could use.
+static LogicalResult splitMLIROutput(Operation *op, unsigned indent,
+                                     std::vector<MLIRPiece> &pieces,
+                                     SmallVectorImpl<Operation *> &clones) {
+  if (!isa<ModuleOp, firrtl::CircuitOp>(op)) {
+    if (op->getNumResults())
+      return failure();
+    if (!op->hasTrait<OpTrait::IsIsolatedFromAbove>()) {
+      op = op->clone();
+      clones.push_back(op);
+    }
+    pieces.push_back({op, "", indent});
+    return success();
+  }
+
+  // Print the operation with an empty body to get the text around it.
+  std::string text;
+  {
+    Operation *shell = op->cloneWithoutRegions();
+    shell->getRegion(0).push_back(new Block);
+    llvm::raw_string_ostream os(text);
+    shell->print(os, OpPrintingFlags().useLocalScope());
+    shell->destroy();
+  }
+  size_t close = text.rfind('}');
+  if (close == std::string::npos)
+    return failure();
+  pieces.push_back({nullptr, StringRef(text).take_front(close).rtrim().str(),
+                    indent});
+
+  for (auto &child : op->getRegion(0).front()) {
+    if (child.hasTrait<OpTrait::IsTerminator>())
+      continue;
+    if (failed(splitMLIROutput(&child, indent + 2, pieces, clones)))
+      return failure();
+  }
+  pieces.push_back({nullptr, StringRef(text).drop_front(close).rtrim().str(),
+                    indent});
+  return success();
+}
+
+/// Print the pieces of the MLIR output and write them to `os` in order.  The
+/// pieces are printed in batches, each written out before the next one is
+/// printed, so that only part of the output is held in memory.
+static void writeMLIRPieces(std::vector<MLIRPiece> &pieces, bool parallel,
+                            raw_ostream &os) {
+  auto printPiece = [&](size_t index) {
+    auto &piece = pieces[index];
+    if (!piece.op)
+      return;
+    llvm::raw_string_ostream pieceOS(piece.text);
+    piece.op->print(pieceOS, OpPrintingFlags().useLocalScope());
+  };
+
+  const size_t batchSize = 256;
+  for (size_t begin = 0, e = pieces.size(); begin < e; begin += batchSize) {
+    size_t end = std::min(begin + batchSize, e);
+    if (parallel) {
+      llvm::parallelForEachN(begin, end, printPiece);
+    } else {
+      for (size_t i = begin; i != end; ++i)
+        printPiece(i);
+    }
+    for (size_t i = begin; i != end; ++i) {
+      StringRef text = pieces[i].text;
+      while (!text.empty()) {
+        StringRef line;
+        std::tie(line, text) = text.split('\n');
+        if (!line.empty())
+          os.indent(pieces[i].indent);
+        os << line << '\n';
+      }
+      pieces[i].text = std::string();
+    }
+  }
+}
+
+/// Print `module` one top-level module at a time on all the threads of its
+/// context, and write the modules in order.  The modules are printed without
+/// aliases, in the local scope of each.  This names their values like the
+/// printer of the whole module does, since they are isolated from above.
+static void printMLIRInParallel(ModuleOp module, raw_ostream &os) {
+  std::vector<MLIRPiece> pieces;
+  SmallVector<Operation *> clones;
+  if (succeeded(splitMLIROutput(module, 0, pieces, clones)))
+    writeMLIRPieces(pieces, module.getContext()->isMultithreadingEnabled(),
+                    os);
+  else
+    module->print(os);
+  for (auto *clone : clones)
+    clone->destroy();
+}
+
+LogicalResult firtool::emitFirtoolOutput(ModuleOp module,
+                                         const FirtoolOptions &options,
+                                         raw_ostream *os,
+                                         StringRef outputDirectory,
+                                         TimingScope &ts,
+                                         ExportVerilogStatistics *statistics) {
+  switch (options.outputFormat) {
+  case OutputMLIR:
+    if (options.parallelMLIROutput)
+      printMLIRInParallel(module, *os);
+    else
+      module->print(*os);
+    return success();
+  case OutputFIRBytecode:
+    firrtl::writeFIRRTLBytecode(module, *os);
+    return success();
+  case OutputDisabled:
+    return success();
+  case OutputVerilog:
+    return exportVerilog(module, *os, &ts, statistics);
+  case OutputSplitVerilog: {
+    SplitVerilogCache cache{options.splitVerilogCacheDir,
+                            options.splitVerilogCacheSalt};
+    // Unless the caller keeps the module, nothing looks at it after it has
+    // been emitted, so let the emitter drop each module as soon as its file
+    // is written.
+    return exportSplitVerilog(
+        module, outputDirectory, options.releaseEmittedModules,
+        options.incrementalSplitVerilog, &ts, statistics,
+        options.splitVerilogCacheDir.empty() ? nullptr : &cache);
+  }
+  }
+  return failure();
+}
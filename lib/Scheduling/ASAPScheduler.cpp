@@ -18,10 +18,21 @@ using namespace circt;
 using namespace circt::scheduling;
 
 LogicalResult scheduling::scheduleASAP(Problem &prob) {
-  auto allOps = prob.getOperations();
+  if (!prob.isFinalized())
+    prob.finalize();
+
+  // Operations are referred to by their dense indices
+  auto &allOps = prob.getOperations();
+  unsigned numOps = allOps.size();
+  llvm::SmallVector<unsigned> latencies;
+  latencies.reserve(numOps);
+  for (auto *op : allOps)
+    latencies.push_back(*prob.getLatency(*prob.getLinkedOperatorType(op)));
+
   // Keep track of ops that don't have a start time yet
-  llvm::SmallVector<Operation *> unscheduledOps;
-  unscheduledOps.insert(unscheduledOps.begin(), allOps.begin(), allOps.end());
+  llvm::SmallVector<unsigned> unscheduledOps;
+  for (unsigned i = 0; i < numOps; ++i)
+    unscheduledOps.push_back(i);
 
   // We may need multiple attempts to schedule all operations in case the
   // problem's operation list is not in a topological order w.r.t. the
@@ -34,17 +45,18 @@ LogicalResult scheduling::scheduleASAP(Problem &prob) {
 
     // Set up the worklist for this attempt, and initialize it in reverse order
     // so that we can pop off its back later.
-    llvm::SmallVector<Operation *> worklist;
+    llvm::SmallVector<unsigned> worklist;
     worklist.insert(worklist.begin(), unscheduledOps.rbegin(),
                     unscheduledOps.rend());
     unscheduledOps.clear();
 
     while (!worklist.empty()) {
-      Operation *op = worklist.pop_back_val();
+      unsigned op = worklist.pop_back_val();
 
       // Operations with no predecessors are scheduled at time step 0
-      if (prob.getDependences(op).empty()) {
-        prob.setStartTime(op, 0);
+      auto deps = prob.getIndexedDependences(op);
+      if (deps.empty()) {
+        prob.setStartTimeAt(op, 0);
         continue;
       }
 
@@ -52,13 +64,11 @@ LogicalResult scheduling::scheduleASAP(Problem &prob) {
       //   max_{p : preds} startTime[p] + latency[linkedOpr[p]]
       unsigned startTime = 0;
       bool startTimeIsValid = true;
-      for (auto &dep : prob.getDependences(op)) {
-        Operation *pred = dep.getSource();
-        if (auto predStart = prob.getStartTime(pred)) {
+      for (auto &dep : deps) {
+        unsigned pred = dep.sourceIndex;
+        if (auto predStart = prob.getStartTimeAt(pred)) {
           // pred is already scheduled
-          auto predOpr = *prob.getLinkedOperatorType(pred);
-          unsigned predLatency = *prob.getLatency(predOpr);
-          startTime = std::max(startTime, *predStart + predLatency);
+          startTime = std::max(startTime, *predStart + latencies[pred]);
         } else {
           // pred is not yet scheduled, give up and try again later
           startTimeIsValid = false;
@@ -67,7 +77,7 @@ LogicalResult scheduling::scheduleASAP(Problem &prob) {
       }
 
       if (startTimeIsValid)
-        prob.setStartTime(op, startTime);
+        prob.setStartTimeAt(op, startTime);
       else
         unscheduledOps.push_back(op);
     }
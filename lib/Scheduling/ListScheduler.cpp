@@ -0,0 +1,111 @@
+//===- ListScheduler.cpp - Resource-constrained list scheduler ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implementation of a list scheduler for acyclic problems with limited operator
+// types, prioritizing operations on the critical path.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Scheduling/Algorithms.h"
+
+#include "mlir/IR/Operation.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+using namespace circt;
+using namespace circt::scheduling;
+
+LogicalResult scheduling::scheduleList(SharedOperatorsProblem &prob) {
+  if (!prob.isFinalized())
+    prob.finalize();
+
+  // Operations are referred to by their dense indices
+  auto &ops = prob.getOperations();
+  unsigned numOps = ops.size();
+  SmallVector<unsigned> latencies;
+  latencies.reserve(numOps);
+  for (auto *op : ops)
+    latencies.push_back(*prob.getLatency(*prob.getLinkedOperatorType(op)));
+
+  // Sort the operations topologically, counting each operation's unscheduled
+  // predecessors (one per dependence) on the way.
+  SmallVector<SmallVector<unsigned, 4>> successors(numOps);
+  SmallVector<unsigned> numPreds(numOps, 0);
+  for (unsigned op = 0; op < numOps; ++op) {
+    for (auto &dep : prob.getIndexedDependences(op)) {
+      successors[dep.sourceIndex].push_back(op);
+      ++numPreds[op];
+    }
+  }
+
+  SmallVector<unsigned> topoOrder;
+  SmallVector<unsigned> remainingPreds = numPreds;
+  for (unsigned op = 0; op < numOps; ++op)
+    if (remainingPreds[op] == 0)
+      topoOrder.push_back(op);
+  for (unsigned i = 0; i < topoOrder.size(); ++i)
+    for (unsigned succ : successors[topoOrder[i]])
+      if (--remainingPreds[succ] == 0)
+        topoOrder.push_back(succ);
+
+  if (topoOrder.size() != numOps)
+    return prob.getContainingOp()->emitError() << "dependence cycle detected";
+
+  // The priority of an operation is the length of the longest path from its
+  // start to the end of the schedule, i.e. operations on the critical path are
+  // scheduled first.
+  SmallVector<unsigned> heights(numOps, 0);
+  for (unsigned op : llvm::reverse(topoOrder)) {
+    unsigned height = 0;
+    for (unsigned succ : successors[op])
+      height = std::max(height, heights[succ]);
+    heights[op] = height + latencies[op];
+  }
+
+  // The number of operations started on each limited operator type in each
+  // time step
+  DenseMap<std::pair<Problem::OperatorType, unsigned>, unsigned> reservations;
+
+  // Operations become ready once all of their predecessors are scheduled
+  SmallVector<unsigned> ready;
+  for (unsigned op = 0; op < numOps; ++op)
+    if (numPreds[op] == 0)
+      ready.push_back(op);
+
+  while (!ready.empty()) {
+    // Ties are broken in favor of the operation that became ready first
+    auto it = std::max_element(
+        ready.begin(), ready.end(),
+        [&](unsigned a, unsigned b) { return heights[a] < heights[b]; });
+    unsigned op = *it;
+    ready.erase(it);
+
+    // Start after all predecessors' results are available, and delay the
+    // operation further while its operator type is fully occupied
+    unsigned startTime = 0;
+    for (auto &dep : prob.getIndexedDependences(op)) {
+      unsigned pred = dep.sourceIndex;
+      startTime =
+          std::max(startTime, *prob.getStartTimeAt(pred) + latencies[pred]);
+    }
+
+    auto opr = *prob.getLinkedOperatorType(ops[op]);
+    if (auto limit = prob.getLimit(opr)) {
+      while (reservations[{opr, startTime}] >= *limit)
+        ++startTime;
+      ++reservations[{opr, startTime}];
+    }
+    prob.setStartTimeAt(op, startTime);
+
+    for (unsigned succ : successors[op])
+      if (--numPreds[succ] == 0)
+        ready.push_back(succ);
+  }
+
+  return success();
+}
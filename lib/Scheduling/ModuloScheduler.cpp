@@ -0,0 +1,209 @@
+//===- ModuloScheduler.cpp - Iterative modulo scheduler -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implementation of an iterative modulo scheduler for cyclic problems with
+// limited operator types.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Scheduling/Algorithms.h"
+
+#include "mlir/IR/Operation.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+using namespace circt;
+using namespace circt::scheduling;
+
+/// The number of scheduling steps per operation the scheduler may take for one
+/// initiation interval before giving up and trying the next one.
+static constexpr unsigned budgetRatio = 6;
+
+namespace {
+class ModuloScheduler {
+public:
+  ModuloScheduler(ModuloProblem &prob) : prob(prob) {}
+
+  LogicalResult schedule();
+
+private:
+  using Dependence = Problem::Dependence;
+
+  unsigned getResMII();
+  bool computeEarliestTimes(unsigned ii);
+  bool scheduleWithII(unsigned ii);
+
+  unsigned getLatency(Operation *op) {
+    return *prob.getLatency(*prob.getLinkedOperatorType(op));
+  }
+
+  /// Return the minimum number of time steps between the start times of the
+  /// endpoints of \p dep, which is negative for loop-carried dependences
+  /// spanning more time steps than the source's latency.
+  int getDelay(Dependence dep, unsigned ii) {
+    int dist = prob.getDistance(dep).getValueOr(0);
+    return (int)getLatency(dep.getSource()) - dist * (int)ii;
+  }
+
+  ModuloProblem &prob;
+
+  /// The outgoing dependences of each operation.
+  DenseMap<Operation *, SmallVector<Dependence, 4>> successors;
+
+  /// The earliest start times w.r.t. the dependences only, for the current II.
+  /// Operations with smaller times are scheduled first.
+  DenseMap<Operation *, int> earliest;
+};
+} // anonymous namespace
+
+/// Return the lower bound for the II imposed by the limited operator types.
+unsigned ModuloScheduler::getResMII() {
+  DenseMap<Problem::OperatorType, unsigned> numUses;
+  for (auto *op : prob.getOperations())
+    ++numUses[*prob.getLinkedOperatorType(op)];
+
+  unsigned resMII = 1;
+  for (auto &entry : numUses)
+    if (auto limit = prob.getLimit(entry.first))
+      resMII = std::max(resMII, (entry.second + *limit - 1) / *limit);
+  return resMII;
+}
+
+/// Compute the longest paths through the dependence graph for \p ii. Return
+/// false if a dependence cycle has a positive delay, i.e. \p ii is below the
+/// lower bound imposed by the recurrences.
+bool ModuloScheduler::computeEarliestTimes(unsigned ii) {
+  auto &ops = prob.getOperations();
+  earliest.clear();
+  for (auto *op : ops)
+    earliest[op] = 0;
+
+  // Without a positive cycle, the longest paths settle after at most as many
+  // rounds as there are operations.
+  for (unsigned round = 0, e = ops.size(); round <= e; ++round) {
+    bool changed = false;
+    for (auto *op : ops) {
+      for (auto &dep : prob.getDependences(op)) {
+        int time = earliest[dep.getSource()] + getDelay(dep, ii);
+        if (time > earliest[op]) {
+          earliest[op] = time;
+          changed = true;
+        }
+      }
+    }
+    if (!changed)
+      return true;
+  }
+  return false;
+}
+
+/// Try to place all operations into a modulo reservation table for \p ii.
+/// Return false if the budget of scheduling steps is exhausted.
+bool ModuloScheduler::scheduleWithII(unsigned ii) {
+  auto &ops = prob.getOperations();
+  DenseMap<Operation *, int> startTimes, lastTimes;
+  // The operations of each operator type, started in each time step modulo II
+  DenseMap<std::pair<Problem::OperatorType, unsigned>,
+           SmallVector<Operation *, 2>>
+      reservations;
+
+  SmallVector<Operation *> unscheduled(ops.begin(), ops.end());
+  auto unschedule = [&](Operation *op) {
+    auto opr = *prob.getLinkedOperatorType(op);
+    auto &users = reservations[{opr, startTimes[op] % ii}];
+    users.erase(llvm::find(users, op));
+    startTimes.erase(op);
+    unscheduled.push_back(op);
+  };
+
+  unsigned budget = ops.size() * budgetRatio;
+  while (!unscheduled.empty()) {
+    if (budget-- == 0)
+      return false;
+
+    auto it = std::min_element(
+        unscheduled.begin(), unscheduled.end(),
+        [&](Operation *a, Operation *b) { return earliest[a] < earliest[b]; });
+    Operation *op = *it;
+    unscheduled.erase(it);
+
+    // Start no earlier than allowed by the scheduled predecessors
+    int estart = 0;
+    for (auto &dep : prob.getDependences(op)) {
+      auto pred = startTimes.find(dep.getSource());
+      if (pred != startTimes.end())
+        estart = std::max(estart, pred->second + getDelay(dep, ii));
+    }
+
+    // Look for a free slot in the next II time steps, which cover every
+    // row of the reservation table
+    auto opr = *prob.getLinkedOperatorType(op);
+    auto limit = prob.getLimit(opr);
+    Optional<int> slot;
+    for (int t = estart; t < estart + (int)ii && !slot; ++t)
+      if (!limit || reservations[{opr, t % ii}].size() < *limit)
+        slot = t;
+
+    // Otherwise, make room by evicting another operation. Move past the
+    // previous attempt for op, so the scheduler doesn't get stuck.
+    if (!slot) {
+      auto last = lastTimes.find(op);
+      if (last == lastTimes.end() || estart > last->second)
+        slot = estart;
+      else
+        slot = last->second + 1;
+      unschedule(reservations[{opr, *slot % ii}].front());
+    }
+
+    startTimes[op] = *slot;
+    lastTimes[op] = *slot;
+    reservations[{opr, *slot % ii}].push_back(op);
+
+    // Evict the scheduled successors whose dependences are now violated
+    for (auto &dep : successors.lookup(op)) {
+      auto succ = startTimes.find(dep.getDestination());
+      if (succ != startTimes.end() &&
+          *slot + getDelay(dep, ii) > succ->second)
+        unschedule(dep.getDestination());
+    }
+  }
+
+  for (auto *op : ops)
+    prob.setStartTime(op, startTimes[op]);
+  prob.setInitiationInterval(ii);
+  return true;
+}
+
+LogicalResult ModuloScheduler::schedule() {
+  if (!prob.isFinalized())
+    prob.finalize();
+
+  auto &ops = prob.getOperations();
+  for (auto *op : ops)
+    for (auto &dep : prob.getDependences(op))
+      successors[dep.getSource()].push_back(dep);
+
+  // Executing the operations one after another is the worst case for any
+  // valid problem, which bounds the II we need to try.
+  unsigned resMII = getResMII();
+  unsigned maxII = resMII + ops.size();
+  for (auto *op : ops)
+    maxII += getLatency(op);
+
+  for (unsigned ii = resMII; ii <= maxII; ++ii)
+    if (computeEarliestTimes(ii) && scheduleWithII(ii))
+      return success();
+
+  return prob.getContainingOp()->emitError()
+         << "no modulo schedule found for an initiation interval up to "
+         << maxII;
+}
+
+LogicalResult scheduling::scheduleModulo(ModuloProblem &prob) {
+  return ModuloScheduler(prob).schedule();
+}
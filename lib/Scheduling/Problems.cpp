@@ -24,6 +24,8 @@ using namespace circt::scheduling::detail;
 //===----------------------------------------------------------------------===//
 
 LogicalResult Problem::insertDependence(Dependence dep) {
+  assert(!finalized && "problem is finalized");
+
   Operation *src = dep.getSource();
   Operation *dst = dep.getDestination();
 
@@ -55,6 +57,31 @@ Problem::DependenceRange Problem::getDependences(Operation *op) {
                          DependenceIterator(*this, op, /*end=*/true));
 }
 
+void Problem::finalize() {
+  assert(!finalized && "problem is already finalized");
+
+  for (unsigned i = 0, e = operations.size(); i < e; ++i)
+    operationIndices[operations[i]] = i;
+
+  // Collect the dependences through the iterator, which still consults the
+  // SSA graph and the auxiliary dependences at this point.
+  dependenceOffsets.reserve(operations.size() + 1);
+  dependenceOffsets.push_back(0);
+  for (auto *op : operations) {
+    for (auto &dep : getDependences(op)) {
+      unsigned idx = indexedDependences.size();
+      dependenceIndices[dep] = idx;
+      indexedDependences.push_back(
+          {dep, idx, operationIndices.lookup(dep.getSource())});
+    }
+    dependenceOffsets.push_back(indexedDependences.size());
+  }
+
+  linkedOperatorType.freeze(operationIndices);
+  startTime.freeze(operationIndices);
+  finalized = true;
+}
+
 LogicalResult Problem::checkOperation(Operation *op) {
   if (!getLinkedOperatorType(op))
     return op->emitError("Operation is not linked to an operator type");
@@ -141,6 +168,115 @@ LogicalResult Problem::verify() {
   return verifyProblem();
 }
 
+//===----------------------------------------------------------------------===//
+// CyclicProblem
+//===----------------------------------------------------------------------===//
+
+void CyclicProblem::finalize() {
+  Problem::finalize();
+  distance.freeze(dependenceIndices);
+}
+
+LogicalResult CyclicProblem::verifyInitiationInterval() {
+  if (!getInitiationInterval() || *getInitiationInterval() == 0)
+    return getContainingOp()->emitError("Invalid initiation interval");
+  return success();
+}
+
+LogicalResult CyclicProblem::verifyDependence(Dependence dep) {
+  if (failed(verifyInitiationInterval()))
+    return failure();
+
+  Operation *i = dep.getSource();
+  Operation *j = dep.getDestination();
+
+  unsigned stI = *getStartTime(i);
+  unsigned latI = *getLatency(*getLinkedOperatorType(i));
+  unsigned stJ = *getStartTime(j);
+  unsigned dist = getDistance(dep).getValueOr(0);
+  unsigned ii = *getInitiationInterval();
+
+  // check if i's result is available before j starts, dist-many iterations
+  // (i.e. dist * II time steps) later
+  if (!(stI + latI <= stJ + dist * ii))
+    return getContainingOp()->emitError()
+           << "Precedence violated for dependence."
+           << "\n  from: " << *i << ", result available in t=" << (stI + latI)
+           << "\n  to:   " << *j << ", starts in t=" << stJ
+           << "\n  distance: " << dist << ", II=" << ii;
+
+  return success();
+}
+
+LogicalResult CyclicProblem::verifyProblem() {
+  return verifyInitiationInterval();
+}
+
+//===----------------------------------------------------------------------===//
+// SharedOperatorsProblem
+//===----------------------------------------------------------------------===//
+
+LogicalResult SharedOperatorsProblem::checkOperatorType(OperatorType opr) {
+  if (failed(Problem::checkOperatorType(opr)))
+    return failure();
+
+  if (getLimit(opr) && *getLimit(opr) == 0)
+    return getContainingOp()->emitError()
+           << "Operator type '" << opr << "' has a limit of zero";
+
+  return success();
+}
+
+LogicalResult SharedOperatorsProblem::verifyOperatorType(OperatorType opr) {
+  auto lim = getLimit(opr);
+  if (!lim)
+    return success();
+
+  // count the operations started on opr in each time step
+  llvm::SmallDenseMap<unsigned, unsigned> reservations;
+  for (auto *op : getOperations())
+    if (*getLinkedOperatorType(op) == opr)
+      ++reservations[*getStartTime(op)];
+
+  for (auto &slot : reservations)
+    if (slot.second > *lim)
+      return getContainingOp()->emitError()
+             << "Operator type '" << opr << "' is oversubscribed."
+             << "\n  time step: " << slot.first
+             << "\n  #operations: " << slot.second << "\n  limit: " << *lim;
+
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// ModuloProblem
+//===----------------------------------------------------------------------===//
+
+LogicalResult ModuloProblem::verifyOperatorType(OperatorType opr) {
+  auto lim = getLimit(opr);
+  if (!lim)
+    return success();
+
+  if (failed(verifyInitiationInterval()))
+    return failure();
+  unsigned ii = *getInitiationInterval();
+
+  // fill the modulo reservation table for opr
+  llvm::SmallDenseMap<unsigned, unsigned> reservations;
+  for (auto *op : getOperations())
+    if (*getLinkedOperatorType(op) == opr)
+      ++reservations[*getStartTime(op) % ii];
+
+  for (auto &slot : reservations)
+    if (slot.second > *lim)
+      return getContainingOp()->emitError()
+             << "Operator type '" << opr << "' is oversubscribed."
+             << "\n  time step (modulo II): " << slot.first
+             << "\n  #operations: " << slot.second << "\n  limit: " << *lim;
+
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // Dependence
 //===----------------------------------------------------------------------===//
@@ -183,8 +319,19 @@ bool Dependence::operator==(const Dependence &other) const {
 DependenceIterator::DependenceIterator(Problem &problem, Operation *op,
                                        bool end)
     : problem(problem), op(op), operandIdx(0), auxPredIdx(0), auxPreds(nullptr),
-      dep() {
+      frozenDep(nullptr), frozenEnd(nullptr), dep() {
   if (!end) {
+    if (problem.isFinalized()) {
+      if (problem.hasOperation(op)) {
+        auto deps =
+            problem.getIndexedDependences(problem.getOperationIndex(op));
+        frozenDep = deps.begin();
+        frozenEnd = deps.end();
+      }
+      findNextDependence();
+      return;
+    }
+
     if (problem.auxDependences.count(op))
       auxPreds = &problem.auxDependences[op];
 
@@ -193,6 +340,12 @@ DependenceIterator::DependenceIterator(Problem &problem, Operation *op,
 }
 
 void DependenceIterator::findNextDependence() {
+  // Finalized problems store the dependences contiguously.
+  if (problem.isFinalized()) {
+    dep = frozenDep != frozenEnd ? (frozenDep++)->dep : Dependence();
+    return;
+  }
+
   // Yield dependences corresponding to values used by `op`'s operands...
   while (operandIdx < op->getNumOperands()) {
     dep = Dependence(&op->getOpOperand(operandIdx++));
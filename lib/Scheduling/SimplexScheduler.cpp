@@ -0,0 +1,274 @@
+//===- SimplexScheduler.cpp - Linear programming-based scheduler ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Implementation of a scheduler that formulates the basic scheduling problem
+// as a system of difference constraints (SDC), and solves it optimally with an
+// in-tree simplex solver.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Scheduling/Algorithms.h"
+
+#include "mlir/IR/Operation.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace circt;
+using namespace circt::scheduling;
+
+//===----------------------------------------------------------------------===//
+// SimplexSolver
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A two-phase simplex solver on a dense tableau, for linear programs of the
+/// form `min c^T x s.t. Ax <= b, x >= 0`. Bland's rule is used for pivoting,
+/// which guarantees termination also for the degenerate programs that arise
+/// from scheduling problems.
+///
+/// The constraint matrix of an SDC is totally unimodular, hence the optimal
+/// basic solutions are integral for integer bounds.
+class SimplexSolver {
+public:
+  explicit SimplexSolver(unsigned numVars) : numVars(numVars) {}
+
+  /// Add the constraint `sum(coefficient * variable) <= bound`.
+  void addConstraint(ArrayRef<std::pair<unsigned, int>> terms, int bound) {
+    constraints.push_back({{terms.begin(), terms.end()}, bound});
+  }
+
+  /// Minimize the objective given by the \p costs of the variables, and store
+  /// the variables' values in \p values. Return false if the program is
+  /// infeasible or unbounded.
+  bool solve(ArrayRef<int> costs, SmallVectorImpl<int> &values);
+
+private:
+  struct Constraint {
+    SmallVector<std::pair<unsigned, int>, 2> terms;
+    int bound;
+  };
+
+  void setObjective(ArrayRef<double> costs);
+  void pivot(unsigned row, unsigned col);
+  bool optimize(unsigned numEnterableCols);
+
+  unsigned numVars;
+  SmallVector<Constraint> constraints;
+
+  /// One row per constraint, followed by the reduced costs of the objective.
+  /// The last column holds the right-hand sides.
+  std::vector<std::vector<double>> tableau;
+  /// The basic variable of each constraint row.
+  SmallVector<unsigned> basis;
+};
+} // anonymous namespace
+
+static constexpr double epsilon = 1e-9;
+
+/// Compute the reduced costs of the current basis for \p costs.
+void SimplexSolver::setObjective(ArrayRef<double> costs) {
+  auto &objRow = tableau.back();
+  unsigned rhs = objRow.size() - 1;
+  for (unsigned j = 0; j < rhs; ++j)
+    objRow[j] = costs[j];
+  objRow[rhs] = 0;
+
+  for (unsigned i = 0, e = basis.size(); i < e; ++i) {
+    double basisCost = costs[basis[i]];
+    if (basisCost == 0)
+      continue;
+    for (unsigned j = 0; j <= rhs; ++j)
+      objRow[j] -= basisCost * tableau[i][j];
+  }
+}
+
+void SimplexSolver::pivot(unsigned row, unsigned col) {
+  auto &pivotRow = tableau[row];
+  double factor = pivotRow[col];
+  for (auto &elem : pivotRow)
+    elem /= factor;
+
+  for (unsigned i = 0, e = tableau.size(); i < e; ++i) {
+    if (i == row || tableau[i][col] == 0)
+      continue;
+    double scale = tableau[i][col];
+    for (unsigned j = 0, f = pivotRow.size(); j < f; ++j)
+      tableau[i][j] -= scale * pivotRow[j];
+  }
+  basis[row] = col;
+}
+
+/// Pivot until the objective can't be improved by any of the first
+/// \p numEnterableCols columns. Return false if the objective is unbounded.
+bool SimplexSolver::optimize(unsigned numEnterableCols) {
+  auto &objRow = tableau.back();
+  unsigned rhs = objRow.size() - 1;
+  while (true) {
+    // the entering column is the first one with a negative reduced cost
+    unsigned col = 0;
+    while (col < numEnterableCols && objRow[col] >= -epsilon)
+      ++col;
+    if (col == numEnterableCols)
+      return true;
+
+    // the leaving row minimizes the ratio, ties are broken by the basis index
+    Optional<unsigned> row;
+    double bestRatio = 0;
+    for (unsigned i = 0, e = basis.size(); i < e; ++i) {
+      if (tableau[i][col] <= epsilon)
+        continue;
+      double ratio = tableau[i][rhs] / tableau[i][col];
+      if (!row || ratio < bestRatio - epsilon ||
+          (ratio < bestRatio + epsilon && basis[i] < basis[*row])) {
+        row = i;
+        bestRatio = ratio;
+      }
+    }
+    if (!row)
+      return false;
+
+    pivot(*row, col);
+  }
+}
+
+bool SimplexSolver::solve(ArrayRef<int> costs, SmallVectorImpl<int> &values) {
+  unsigned numRows = constraints.size();
+  unsigned numArtificial = llvm::count_if(
+      constraints, [](const Constraint &c) { return c.bound < 0; });
+
+  // Columns: variables, slack variables, artificial variables, right-hand side
+  unsigned firstSlack = numVars;
+  unsigned firstArtificial = firstSlack + numRows;
+  unsigned rhs = firstArtificial + numArtificial;
+  tableau.assign(numRows + 1, std::vector<double>(rhs + 1, 0));
+  basis.assign(numRows, 0);
+
+  // Rows with a negative bound are negated, and start out with an artificial
+  // variable in the basis instead of their slack variable.
+  unsigned artificial = firstArtificial;
+  for (unsigned i = 0; i < numRows; ++i) {
+    auto &constraint = constraints[i];
+    double sign = constraint.bound < 0 ? -1 : 1;
+    for (auto &term : constraint.terms)
+      tableau[i][term.first] += sign * term.second;
+    tableau[i][firstSlack + i] = sign;
+    tableau[i][rhs] = sign * constraint.bound;
+    if (sign < 0) {
+      tableau[i][artificial] = 1;
+      basis[i] = artificial++;
+    } else {
+      basis[i] = firstSlack + i;
+    }
+  }
+
+  // Phase 1: find a feasible basis by driving the artificial variables to 0
+  if (numArtificial > 0) {
+    SmallVector<double> phase1Costs(rhs, 0);
+    for (unsigned j = firstArtificial; j < rhs; ++j)
+      phase1Costs[j] = 1;
+    setObjective(phase1Costs);
+    optimize(rhs);
+    if (tableau.back()[rhs] < -epsilon)
+      return false;
+
+    // Artificial variables remaining in the basis are 0, and can be replaced
+    // unless their row is redundant.
+    for (unsigned i = 0; i < numRows; ++i) {
+      if (basis[i] < firstArtificial)
+        continue;
+      for (unsigned j = 0; j < firstArtificial; ++j) {
+        if (std::abs(tableau[i][j]) > epsilon) {
+          pivot(i, j);
+          break;
+        }
+      }
+    }
+  }
+
+  // Phase 2: optimize the actual objective, without the artificial variables
+  SmallVector<double> phase2Costs(rhs, 0);
+  for (unsigned j = 0; j < numVars; ++j)
+    phase2Costs[j] = costs[j];
+  setObjective(phase2Costs);
+  if (!optimize(firstArtificial))
+    return false;
+
+  values.assign(numVars, 0);
+  for (unsigned i = 0; i < numRows; ++i)
+    if (basis[i] < numVars)
+      values[basis[i]] = std::lround(tableau[i][rhs]);
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// SimplexScheduler
+//===----------------------------------------------------------------------===//
+
+LogicalResult scheduling::scheduleSimplex(Problem &prob,
+                                          SimplexObjective objective) {
+  if (!prob.isFinalized())
+    prob.finalize();
+
+  // The variables are indexed like the operations
+  auto &ops = prob.getOperations();
+  unsigned numOps = ops.size();
+  SmallVector<int> latencies;
+  latencies.reserve(numOps);
+  for (auto *op : ops)
+    latencies.push_back(*prob.getLatency(*prob.getLinkedOperatorType(op)));
+
+  // Each dependence i -> j contributes the difference constraint
+  //   startTime[i] - startTime[j] <= -latency[i]
+  auto addPrecedences = [&](SimplexSolver &solver) {
+    for (unsigned j = 0; j < numOps; ++j)
+      for (auto &dep : prob.getIndexedDependences(j))
+        solver.addConstraint({{dep.sourceIndex, 1}, {j, -1}},
+                             -latencies[dep.sourceIndex]);
+  };
+
+  // Minimizing the sum of the start times yields the latency-optimal schedule
+  SimplexSolver latencySolver(numOps);
+  addPrecedences(latencySolver);
+  SmallVector<int> costs(numOps, 1), startTimes;
+  if (!latencySolver.solve(costs, startTimes))
+    return prob.getContainingOp()->emitError() << "dependence cycle detected";
+
+  if (objective == SimplexObjective::RegisterLifetime) {
+    int latency = 0;
+    for (unsigned i = 0; i < numOps; ++i)
+      latency = std::max(latency, startTimes[i] + latencies[i]);
+
+    // The second half of the variables holds the time step in which the last
+    // user of each operation's results starts. An operation's lifetime is the
+    // difference to its own start time (plus its constant latency).
+    SimplexSolver lifetimeSolver(2 * numOps);
+    addPrecedences(lifetimeSolver);
+    SmallVector<int> lifetimeCosts(2 * numOps, 0), values;
+    for (unsigned i = 0; i < numOps; ++i) {
+      lifetimeSolver.addConstraint({{i, 1}}, latency - latencies[i]);
+      for (auto &dep : prob.getIndexedDependences(i)) {
+        if (!dep.dep.isDefUse())
+          continue;
+        unsigned src = dep.sourceIndex;
+        lifetimeSolver.addConstraint({{i, 1}, {numOps + src, -1}}, 0);
+        lifetimeCosts[src] = -1;
+        lifetimeCosts[numOps + src] = 1;
+      }
+    }
+
+    if (!lifetimeSolver.solve(lifetimeCosts, values))
+      return prob.getContainingOp()->emitError()
+             << "register lifetime minimization failed";
+    startTimes.assign(values.begin(), values.begin() + numOps);
+  }
+
+  for (unsigned i = 0; i < numOps; ++i)
+    prob.setStartTimeAt(i, startTimes[i]);
+  return success();
+}
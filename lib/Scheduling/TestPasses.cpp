@@ -15,6 +15,11 @@
 #include "mlir/IR/Builders.h"
 #include "mlir/Pass/Pass.h"
 
+#include "llvm/Support/JSON.h"
+
+#include <chrono>
+#include <mutex>
+
 using namespace mlir;
 using namespace circt;
 using namespace circt::scheduling;
@@ -54,11 +59,12 @@ static LogicalResult constructProblem(Problem &prob, FuncOp func) {
   }
 
   // parse auxiliary dependences in the testcase, encoded as an array of
-  // 2-element arrays of integer attributes (see `test_asap.mlir`)
+  // 2-element arrays of integer attributes (see `test_asap.mlir`). Cyclic
+  // problems may carry the dependence distance as a third element.
   if (auto attr = func->getAttrOfType<ArrayAttr>("auxdeps")) {
     auto &ops = prob.getOperations();
     for (auto auxDepAttr : attr.getAsRange<ArrayAttr>()) {
-      if (auxDepAttr.size() != 2)
+      if (auxDepAttr.size() != 2 && auxDepAttr.size() != 3)
         continue;
       auto fromIdxAttr = auxDepAttr[0].dyn_cast<IntegerAttr>();
       auto toIdxAttr = auxDepAttr[1].dyn_cast<IntegerAttr>();
@@ -80,6 +86,76 @@ static LogicalResult constructProblem(Problem &prob, FuncOp func) {
   return success();
 }
 
+static LogicalResult constructCyclicProblem(CyclicProblem &prob, FuncOp func) {
+  if (failed(constructProblem(prob, func)))
+    return failure();
+
+  // parse the distances of the auxiliary dependences, given as their optional
+  // third element
+  if (auto attr = func->getAttrOfType<ArrayAttr>("auxdeps")) {
+    auto &ops = prob.getOperations();
+    for (auto auxDepAttr : attr.getAsRange<ArrayAttr>()) {
+      if (auxDepAttr.size() != 3)
+        continue;
+      auto fromIdxAttr = auxDepAttr[0].dyn_cast<IntegerAttr>();
+      auto toIdxAttr = auxDepAttr[1].dyn_cast<IntegerAttr>();
+      auto distAttr = auxDepAttr[2].dyn_cast<IntegerAttr>();
+      if (!fromIdxAttr || !toIdxAttr || !distAttr)
+        continue;
+      unsigned fromIdx = fromIdxAttr.getInt();
+      unsigned toIdx = toIdxAttr.getInt();
+      if (fromIdx >= ops.size() || toIdx >= ops.size())
+        continue;
+
+      prob.setDistance(std::make_pair(ops[fromIdx], ops[toIdx]),
+                       distAttr.getInt());
+    }
+  }
+
+  return success();
+}
+
+/// Parse the operator type limits attached to the test case.
+static void parseLimits(SharedOperatorsProblem &prob, FuncOp func) {
+  if (auto attr = func->getAttrOfType<ArrayAttr>("operatortypes")) {
+    for (auto oprAttr : attr.getAsRange<DictionaryAttr>()) {
+      auto name = oprAttr.getAs<StringAttr>("name");
+      auto limit = oprAttr.getAs<IntegerAttr>("limit");
+      if (!(name && limit))
+        continue;
+
+      auto opr = prob.getOrInsertOperatorType(name.getValue());
+      prob.setLimit(opr, limit.getInt());
+    }
+  }
+}
+
+static LogicalResult
+constructSharedOperatorsProblem(SharedOperatorsProblem &prob, FuncOp func) {
+  if (failed(constructProblem(prob, func)))
+    return failure();
+  parseLimits(prob, func);
+  return success();
+}
+
+static LogicalResult constructModuloProblem(ModuloProblem &prob, FuncOp func) {
+  if (failed(constructCyclicProblem(prob, func)))
+    return failure();
+  parseLimits(prob, func);
+  return success();
+}
+
+/// Import the schedule and initiation interval encoded in the test case.
+static void importCyclicSolution(CyclicProblem &prob, FuncOp func) {
+  for (auto *op : prob.getOperations())
+    if (auto startTimeAttr = op->getAttrOfType<IntegerAttr>("problemStartTime"))
+      prob.setStartTime(op, startTimeAttr.getInt());
+
+  if (auto iiAttr =
+          func->getAttrOfType<IntegerAttr>("problemInitiationInterval"))
+    prob.setInitiationInterval(iiAttr.getInt());
+}
+
 //===----------------------------------------------------------------------===//
 // (Basic) Problem
 //===----------------------------------------------------------------------===//
@@ -115,6 +191,108 @@ void TestProblemPass::runOnFunction() {
   }
 }
 
+//===----------------------------------------------------------------------===//
+// CyclicProblem
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestCyclicProblemPass
+    : public PassWrapper<TestCyclicProblemPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // namespace
+
+void TestCyclicProblemPass::runOnFunction() {
+  auto func = getFunction();
+
+  CyclicProblem prob(func);
+  if (failed(constructCyclicProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  importCyclicSolution(prob, func);
+
+  if (failed(prob.verify())) {
+    func->emitError("problem verification failed");
+    return signalPassFailure();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// SharedOperatorsProblem
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestSharedOperatorsProblemPass
+    : public PassWrapper<TestSharedOperatorsProblemPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // namespace
+
+void TestSharedOperatorsProblemPass::runOnFunction() {
+  auto func = getFunction();
+
+  SharedOperatorsProblem prob(func);
+  if (failed(constructSharedOperatorsProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  // get schedule from the test case
+  for (auto *op : prob.getOperations())
+    if (auto startTimeAttr = op->getAttrOfType<IntegerAttr>("problemStartTime"))
+      prob.setStartTime(op, startTimeAttr.getInt());
+
+  if (failed(prob.verify())) {
+    func->emitError("problem verification failed");
+    return signalPassFailure();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// ModuloProblem
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestModuloProblemPass
+    : public PassWrapper<TestModuloProblemPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // namespace
+
+void TestModuloProblemPass::runOnFunction() {
+  auto func = getFunction();
+
+  ModuloProblem prob(func);
+  if (failed(constructModuloProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  importCyclicSolution(prob, func);
+
+  if (failed(prob.verify())) {
+    func->emitError("problem verification failed");
+    return signalPassFailure();
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // ASAPScheduler
 //===----------------------------------------------------------------------===//
@@ -157,6 +335,251 @@ void TestASAPSchedulerPass::runOnFunction() {
   }
 }
 
+//===----------------------------------------------------------------------===//
+// ListScheduler
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestListSchedulerPass
+    : public PassWrapper<TestListSchedulerPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // anonymous namespace
+
+void TestListSchedulerPass::runOnFunction() {
+  auto func = getFunction();
+
+  SharedOperatorsProblem prob(func);
+  if (failed(constructSharedOperatorsProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  if (failed(scheduleList(prob))) {
+    func->emitError("scheduling failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.verify())) {
+    func->emitError("schedule verification failed");
+    return signalPassFailure();
+  }
+
+  OpBuilder builder(func.getContext());
+  for (auto *op : prob.getOperations()) {
+    unsigned startTime = *prob.getStartTime(op);
+    op->setAttr("listStartTime", builder.getI32IntegerAttr(startTime));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// ModuloScheduler
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestModuloSchedulerPass
+    : public PassWrapper<TestModuloSchedulerPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // anonymous namespace
+
+void TestModuloSchedulerPass::runOnFunction() {
+  auto func = getFunction();
+
+  ModuloProblem prob(func);
+  if (failed(constructModuloProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  if (failed(scheduleModulo(prob))) {
+    func->emitError("scheduling failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.verify())) {
+    func->emitError("schedule verification failed");
+    return signalPassFailure();
+  }
+
+  OpBuilder builder(func.getContext());
+  func->setAttr("moduloInitiationInterval",
+                builder.getI32IntegerAttr(*prob.getInitiationInterval()));
+  for (auto *op : prob.getOperations()) {
+    unsigned startTime = *prob.getStartTime(op);
+    op->setAttr("moduloStartTime", builder.getI32IntegerAttr(startTime));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// SimplexScheduler
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestSimplexSchedulerPass
+    : public PassWrapper<TestSimplexSchedulerPass, FunctionPass> {
+  void runOnFunction() override;
+};
+} // anonymous namespace
+
+void TestSimplexSchedulerPass::runOnFunction() {
+  auto func = getFunction();
+
+  Problem prob(func);
+  if (failed(constructProblem(prob, func))) {
+    func->emitError("problem construction failed");
+    return signalPassFailure();
+  }
+
+  if (failed(prob.check())) {
+    func->emitError("problem check failed");
+    return signalPassFailure();
+  }
+
+  // emit the solutions for both objectives, to compare them side by side
+  OpBuilder builder(func.getContext());
+  std::pair<SimplexObjective, StringRef> objectives[] = {
+      {SimplexObjective::Latency, "simplexStartTime"},
+      {SimplexObjective::RegisterLifetime, "simplexLifetimeStartTime"}};
+  for (auto &objective : objectives) {
+    prob.clearSolution();
+    if (failed(scheduleSimplex(prob, objective.first))) {
+      func->emitError("scheduling failed");
+      return signalPassFailure();
+    }
+
+    if (failed(prob.verify())) {
+      func->emitError("schedule verification failed");
+      return signalPassFailure();
+    }
+
+    for (auto *op : prob.getOperations()) {
+      unsigned startTime = *prob.getStartTime(op);
+      op->setAttr(objective.second, builder.getI32IntegerAttr(startTime));
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Benchmark
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct TestSchedulingBenchmarkPass
+    : public PassWrapper<TestSchedulingBenchmarkPass, FunctionPass> {
+  TestSchedulingBenchmarkPass() = default;
+  TestSchedulingBenchmarkPass(const TestSchedulingBenchmarkPass &pass)
+      : PassWrapper(pass) {}
+
+  void runOnFunction() override;
+
+  Option<unsigned> simplexMaxOps{
+      *this, "simplex-max-ops",
+      llvm::cl::desc("Skip the simplex scheduler on larger functions, as its "
+                     "dense tableau grows quadratically"),
+      llvm::cl::init(200)};
+};
+} // anonymous namespace
+
+static void reportInitiationInterval(Problem &prob, llvm::json::OStream &json) {
+}
+
+static void reportInitiationInterval(CyclicProblem &prob,
+                                     llvm::json::OStream &json) {
+  json.attribute("ii", int64_t(*prob.getInitiationInterval()));
+}
+
+/// Time the construction, check, scheduling and verification of a problem
+/// for \p func, and report them together with the quality of the schedule.
+template <typename ProblemT>
+static void
+benchmarkScheduler(FuncOp func, StringRef name, llvm::json::OStream &json,
+                   function_ref<LogicalResult(ProblemT &, FuncOp)> construct,
+                   function_ref<LogicalResult(ProblemT &)> schedule) {
+  using Clock = std::chrono::steady_clock;
+  json.attributeObject(name, [&] {
+    ProblemT prob(func);
+    auto phase = [&](StringRef phaseName, function_ref<LogicalResult()> fn) {
+      auto start = Clock::now();
+      bool ok = succeeded(fn());
+      json.attribute(
+          (phaseName + "_sec").str(),
+          std::chrono::duration<double>(Clock::now() - start).count());
+      if (!ok)
+        json.attribute("failed", phaseName);
+      return ok;
+    };
+
+    if (!phase("construct", [&] { return construct(prob, func); }) ||
+        !phase("check", [&] { return prob.check(); }) ||
+        !phase("schedule", [&] { return schedule(prob); }) ||
+        !phase("verify", [&] { return prob.verify(); }))
+      return;
+
+    unsigned latency = 0;
+    for (auto *op : prob.getOperations())
+      latency = std::max(latency, *prob.getStartTime(op) +
+                                      *prob.getLatency(
+                                          *prob.getLinkedOperatorType(op)));
+    json.attribute("latency", int64_t(latency));
+    reportInitiationInterval(prob, json);
+  });
+}
+
+void TestSchedulingBenchmarkPass::runOnFunction() {
+  auto func = getFunction();
+
+  // The size of the dependence graph, as seen by the basic problem
+  Problem sizeProb(func);
+  if (failed(constructProblem(sizeProb, func)))
+    return;
+  unsigned numDeps = 0;
+  for (auto *op : sizeProb.getOperations())
+    for (auto &dep : sizeProb.getDependences(op)) {
+      (void)dep;
+      ++numDeps;
+    }
+  unsigned numOps = sizeProb.getOperations().size();
+
+  std::string report;
+  llvm::raw_string_ostream os(report);
+  llvm::json::OStream json(os);
+  json.object([&] {
+    json.attribute("function", func.getName());
+    json.attribute("operations", int64_t(numOps));
+    json.attribute("dependences", int64_t(numDeps));
+    json.attributeObject("algorithms", [&] {
+      benchmarkScheduler<Problem>(func, "asap", json, constructProblem,
+                                  scheduleASAP);
+      benchmarkScheduler<SharedOperatorsProblem>(
+          func, "list", json, constructSharedOperatorsProblem, scheduleList);
+      benchmarkScheduler<ModuloProblem>(func, "modulo", json,
+                                        constructModuloProblem, scheduleModulo);
+      if (numOps <= simplexMaxOps)
+        benchmarkScheduler<Problem>(
+            func, "simplex", json, constructProblem,
+            [](Problem &prob) { return scheduleSimplex(prob); });
+    });
+  });
+  os.flush();
+
+  // Functions may be processed in parallel, keep their reports on separate
+  // lines.
+  static std::mutex outputMutex;
+  std::lock_guard<std::mutex> lock(outputMutex);
+  llvm::outs() << report << "\n";
+}
+
 //===----------------------------------------------------------------------===//
 // Pass registration
 //===----------------------------------------------------------------------===//
@@ -168,6 +591,24 @@ void registerSchedulingTestPasses() {
       "test-scheduling-problem", "Import a schedule encoded as attributes");
   PassRegistration<TestASAPSchedulerPass> asapTester(
       "test-asap-scheduler", "Emit ASAP scheduler's solution as attributes");
+  PassRegistration<TestSimplexSchedulerPass> simplexTester(
+      "test-simplex-scheduler",
+      "Emit simplex scheduler's solutions as attributes");
+  PassRegistration<TestCyclicProblemPass> cyclicProblemTester(
+      "test-cyclic-problem", "Import a cyclic schedule encoded as attributes");
+  PassRegistration<TestSharedOperatorsProblemPass> sharedOperatorsTester(
+      "test-shared-operators-problem",
+      "Import a resource-constrained schedule encoded as attributes");
+  PassRegistration<TestListSchedulerPass> listTester(
+      "test-list-scheduler", "Emit list scheduler's solution as attributes");
+  PassRegistration<TestModuloProblemPass> moduloProblemTester(
+      "test-modulo-problem", "Import a modulo schedule encoded as attributes");
+  PassRegistration<TestSchedulingBenchmarkPass> benchmark(
+      "test-scheduling-benchmark",
+      "Time all schedulers on each function and print the results as JSON");
+  PassRegistration<TestModuloSchedulerPass> moduloTester(
+      "test-modulo-scheduler",
+      "Emit modulo scheduler's solution as attributes");
 }
 } // namespace test
 } // namespace circt
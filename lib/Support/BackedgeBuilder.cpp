@@ -16,12 +16,29 @@
 
 using namespace circt;
 
-Backedge::Backedge(mlir::Operation *op) : value(op->getResult(0)) {}
+Backedge::Backedge(BackedgeBuilder *owner, mlir::Operation *op)
+    : owner(owner), value(op->getResult(0)) {}
+
+Backedge::Backedge(Backedge &&other) : owner(other.owner), value(other.value) {
+  other.owner = nullptr;
+}
+
+Backedge &Backedge::operator=(Backedge &&other) {
+  owner = other.owner;
+  value = other.value;
+  other.owner = nullptr;
+  return *this;
+}
 
 void Backedge::setValue(mlir::Value newValue) {
   assert(value.getType() == newValue.getType());
-  for (auto &use : value.getUses())
-    use.set(newValue);
+  value.replaceAllUsesWith(newValue);
+
+  // Hand the placeholder back to the builder the first time this is assigned.
+  if (owner) {
+    owner->release(value.getDefiningOp());
+    owner = nullptr;
+  }
   value = newValue;
 }
 
@@ -47,9 +64,23 @@ BackedgeBuilder::BackedgeBuilder(PatternRewriter &rewriter, Location loc)
   loc.getContext()->allowUnregisteredDialects();
 }
 Backedge BackedgeBuilder::get(Type t) {
+  // Reuse a free placeholder if there is one of the right type.  It must be in
+  // the current block, so that it is erased along with the other placeholders
+  // rather than with whatever contains the block it was created in.
+  auto *block = builder.getInsertionBlock();
+  auto it = llvm::find_if(freeEdges, [&](Operation *op) {
+    return op->getResult(0).getType() == t && op->getBlock() == block;
+  });
+  if (it != freeEdges.end()) {
+    auto *op = *it;
+    *it = freeEdges.back();
+    freeEdges.pop_back();
+    return Backedge(this, op);
+  }
+
   OperationState s(loc, "TemporaryBackedge");
   s.addTypes(t);
   auto op = builder.createOperation(s);
   edges.push_back(op);
-  return Backedge(op);
+  return Backedge(this, op);
 }
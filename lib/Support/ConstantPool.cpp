@@ -0,0 +1,51 @@
+//===- ConstantPool.cpp - Share the constants of a block ------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pool of constants shared by the users in a block.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Support/ConstantPool.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/Matchers.h"
+
+using namespace circt;
+
+Value ConstantPool::getOrCreate(OpBuilder &builder, Attribute value, Type type,
+                                llvm::function_ref<Value()> create) {
+  auto &entry = constants[{value, type}];
+  if (entry)
+    return entry;
+
+  OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(block);
+  entry = create();
+  return entry;
+}
+
+Value ConstantPool::insert(Operation *op) {
+  assert(op->getNumResults() == 1 && "constants have a single result");
+  Attribute value;
+  bool isConstant = matchPattern(op, mlir::m_Constant(&value));
+  assert(isConstant && "only constants can be pooled");
+  (void)isConstant;
+
+  Value result = op->getResult(0);
+  auto &entry = constants[{value, result.getType()}];
+  if (entry == result) {
+    // The constant is already in the pool, nothing to do.
+  } else if (entry) {
+    // Use the constant we already have instead of the new one.
+    op->erase();
+  } else {
+    entry = result;
+    op->moveBefore(block, block->begin());
+  }
+  return entry;
+}
@@ -47,6 +47,21 @@ void LoweringOptions::parse(StringRef text, ErrorHandlerT errorHandler) {
         errorHandler("expected integer source width");
         emittedLineLength = 90;
       }
+    } else if (option == "disallowLocationInfo") {
+      disallowLocationInfo = true;
+    } else if (option.startswith("maximumMuxChainDepth=")) {
+      option = option.drop_front(strlen("maximumMuxChainDepth="));
+      if (option.getAsInteger(10, maximumMuxChainDepth)) {
+        errorHandler("expected integer mux chain depth");
+        maximumMuxChainDepth = 0;
+      }
+    } else if (option == "shareVariadicSubterms") {
+      shareVariadicSubterms = true;
+    } else if (option.startswith("profile=")) {
+      option = option.drop_front(strlen("profile="));
+      if (!applyProfile(option))
+        errorHandler(llvm::Twine("unknown emission profile \'") + option +
+                     "\'");
     } else {
       errorHandler(llvm::Twine("unknown style option \'") + option + "\'");
       // We continue parsing options after a failure.
@@ -61,6 +76,13 @@ std::string LoweringOptions::toString() const {
     options += "alwaysFF,";
   if (emittedLineLength != 90)
     options += "emittedLineLength=" + std::to_string(emittedLineLength) + ',';
+  if (disallowLocationInfo)
+    options += "disallowLocationInfo,";
+  if (maximumMuxChainDepth != 0)
+    options +=
+        "maximumMuxChainDepth=" + std::to_string(maximumMuxChainDepth) + ',';
+  if (shareVariadicSubterms)
+    options += "shareVariadicSubterms,";
 
   // Remove a trailing comma if present.
   if (!options.empty()) {
@@ -70,6 +92,15 @@ std::string LoweringOptions::toString() const {
   return options;
 }
 
+bool LoweringOptions::applyProfile(StringRef profile) {
+  if (profile == "simulator") {
+    disallowLocationInfo = true;
+    maximumMuxChainDepth = 4;
+    return true;
+  }
+  return false;
+}
+
 void LoweringOptions::setAsAttribute(ModuleOp module) {
   module->setAttr("circt.loweringOptions",
                   StringAttr::get(module.getContext(), toString()));
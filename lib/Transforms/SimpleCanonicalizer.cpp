@@ -7,22 +7,277 @@
 //===----------------------------------------------------------------------===//
 //
 // This file implements a simplified canonicalizer pass that doesn't do CFG
-// optimizations and other things that aren't helpful for many hardware IRs.
+// optimizations and other things that aren't helpful for many hardware IRs.
 //
 //===----------------------------------------------------------------------===//
 
 #include "circt/Transforms/Passes.h"
 
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Dialect.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Rewrite/PatternApplicator.h"
 #include "mlir/Transforms/FoldUtils.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <mutex>
 using namespace circt;
 
 #define GEN_PASS_CLASSES
 #include "circt/Transforms/Passes.h.inc"
 
+//===----------------------------------------------------------------------===//
+// Pattern Statistics
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The number of times a pattern or folder was tried and succeeded, and the
+/// time spent trying it.
+struct PatternCounts {
+  uint64_t attempts = 0;
+  uint64_t hits = 0;
+  std::chrono::steady_clock::duration time{};
+
+  void record(bool hit, std::chrono::steady_clock::duration elapsed) {
+    ++attempts;
+    hits += hit;
+    time += elapsed;
+  }
+  void merge(const PatternCounts &other) {
+    attempts += other.attempts;
+    hits += other.hits;
+    time += other.time;
+  }
+};
+
+/// The statistics of every pattern and folder, shared by all the copies of the
+/// pass which run on different threads.  Each run collects its counts locally
+/// and merges them in once it is done.  The table is printed when the last
+/// copy of the pass is destroyed, along with the pass manager.
+class PatternStatistics {
+public:
+  ~PatternStatistics() { print(llvm::errs()); }
+
+  void merge(const llvm::StringMap<PatternCounts> &counts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : counts)
+      table[entry.getKey()].merge(entry.getValue());
+  }
+
+  void print(raw_ostream &os) {
+    if (table.empty())
+      return;
+    // Show the patterns which took the most time first.
+    SmallVector<llvm::StringMapEntry<PatternCounts> *> entries;
+    for (auto &entry : table)
+      entries.push_back(&entry);
+    llvm::sort(entries, [](auto *lhs, auto *rhs) {
+      if (lhs->getValue().time != rhs->getValue().time)
+        return lhs->getValue().time > rhs->getValue().time;
+      return lhs->getKey() < rhs->getKey();
+    });
+
+    os << "===" << std::string(73, '-') << "===\n"
+       << "  SimpleCanonicalizer pattern statistics\n"
+       << "===" << std::string(73, '-') << "===\n"
+       << "      Time (s)      Hits  Attempts  Pattern\n";
+    for (auto *entry : entries) {
+      auto &counts = entry->getValue();
+      auto seconds = std::chrono::duration<double>(counts.time).count();
+      os << llvm::format("  %12.6f  %8llu  %8llu  ", seconds,
+                         (unsigned long long)counts.hits,
+                         (unsigned long long)counts.attempts)
+         << entry->getKey() << "\n";
+    }
+  }
+
+private:
+  std::mutex mutex;
+  llvm::StringMap<PatternCounts> table;
+};
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Incremental Rewrite Driver
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// This driver visits every operation once, and afterwards only revisits the
+/// operations affected by a fold or rewrite: the users of replaced values, the
+/// newly created operations, and the defining operations of the operands of
+/// erased operations.  Unlike the greedy driver, it never rescans the whole
+/// region to check for a fixpoint.
+class IncrementalRewriteDriver : public PatternRewriter {
+public:
+  IncrementalRewriteDriver(MLIRContext *context,
+                           const mlir::FrozenRewritePatternSet &patterns,
+                           const DenseSet<Dialect *> &patternDialects,
+                           llvm::StringMap<PatternCounts> *counts,
+                           const DenseMap<const Pattern *, std::string>
+                               &patternNames)
+      : PatternRewriter(context), matcher(patterns), folder(context),
+        patternDialects(patternDialects), counts(counts),
+        patternNames(patternNames) {
+    matcher.applyDefaultCostModel();
+  }
+
+  /// Simplify the operations in the regions.
+  void simplify(MutableArrayRef<Region> regions);
+
+  uint64_t numFolds = 0;
+  uint64_t numRewrites = 0;
+  uint64_t numErased = 0;
+
+protected:
+  void notifyOperationInserted(Operation *op) override { addToWorklist(op); }
+
+  void notifyOperationRemoved(Operation *op) override {
+    addOperandsToWorklist(op->getOperands());
+    op->walk([this](Operation *nested) {
+      removeFromWorklist(nested);
+      folder.notifyRemoval(nested);
+    });
+  }
+
+  void notifyRootReplaced(Operation *op) override {
+    for (auto result : op->getResults())
+      for (auto *user : result.getUsers())
+        addToWorklist(user);
+  }
+
+  void finalizeRootUpdate(Operation *op) override { addToWorklist(op); }
+
+private:
+  void addToWorklist(Operation *op) {
+    if (worklistMap.count(op))
+      return;
+    worklistMap[op] = worklist.size();
+    worklist.push_back(op);
+  }
+
+  void removeFromWorklist(Operation *op) {
+    auto it = worklistMap.find(op);
+    if (it == worklistMap.end())
+      return;
+    worklist[it->second] = nullptr;
+    worklistMap.erase(it);
+  }
+
+  void addOperandsToWorklist(ValueRange operands) {
+    for (auto operand : operands)
+      if (auto *defOp = operand.getDefiningOp())
+        addToWorklist(defOp);
+  }
+
+  /// Try to fold or rewrite an operation.
+  void process(Operation *op);
+
+  mlir::PatternApplicator matcher;
+  mlir::OperationFolder folder;
+
+  /// The dialects which have canonicalization patterns.  The operations of
+  /// other dialects are only folded.
+  const DenseSet<Dialect *> &patternDialects;
+
+  /// The counts of each pattern, if pattern statistics are enabled.
+  llvm::StringMap<PatternCounts> *counts;
+  const DenseMap<const Pattern *, std::string> &patternNames;
+
+  /// The operations to visit.  Erased operations are replaced with null.
+  std::vector<Operation *> worklist;
+  DenseMap<Operation *, unsigned> worklistMap;
+};
+} // end anonymous namespace
+
+void IncrementalRewriteDriver::simplify(MutableArrayRef<Region> regions) {
+  // Visit the operations top-down, in the order in which they appear.
+  for (auto &region : regions)
+    region.walk<mlir::WalkOrder::PreOrder>(
+        [this](Operation *op) { addToWorklist(op); });
+  std::reverse(worklist.begin(), worklist.end());
+  for (unsigned i = 0, e = worklist.size(); i != e; ++i)
+    worklistMap[worklist[i]] = i;
+
+  while (!worklist.empty()) {
+    auto *op = worklist.back();
+    worklist.pop_back();
+    if (!op)
+      continue;
+    worklistMap.erase(op);
+    process(op);
+  }
+}
+
+void IncrementalRewriteDriver::process(Operation *op) {
+  using Clock = std::chrono::steady_clock;
+
+  // Erase dead operations.
+  if (isOpTriviallyDead(op)) {
+    notifyOperationRemoved(op);
+    op->erase();
+    ++numErased;
+    return;
+  }
+
+  // Try to fold the operation.
+  auto preReplaceAction = [this](Operation *op) {
+    // Revisit the users of the replaced results, and the operands which may
+    // have become dead.
+    notifyRootReplaced(op);
+    notifyOperationRemoved(op);
+  };
+  auto collectConstants = [this](Operation *op) { addToWorklist(op); };
+  bool inPlaceUpdate = false;
+  auto foldStart = Clock::now();
+  bool folded = succeeded(folder.tryToFold(op, collectConstants,
+                                           preReplaceAction, &inPlaceUpdate));
+  if (counts)
+    (*counts)[("fold(" + op->getName().getStringRef() + ")").str()].record(
+        folded, Clock::now() - foldStart);
+  if (folded) {
+    ++numFolds;
+    if (!inPlaceUpdate)
+      return;
+  }
+
+  // Try the canonicalization patterns of the operation, unless its dialect
+  // has none.
+  if (!patternDialects.count(op->getDialect()))
+    return;
+  if (!counts) {
+    if (succeeded(matcher.matchAndRewrite(op, *this)))
+      ++numRewrites;
+    return;
+  }
+
+  // Time every pattern which is tried.
+  Clock::time_point patternStart;
+  auto recordPattern = [&](const Pattern &pattern, bool hit) {
+    auto it = patternNames.find(&pattern);
+    StringRef name =
+        it != patternNames.end() ? StringRef(it->second) : "<unknown>";
+    (*counts)[name].record(hit, Clock::now() - patternStart);
+  };
+  auto canApply = [&](const Pattern &) {
+    patternStart = Clock::now();
+    return true;
+  };
+  auto onFailure = [&](const Pattern &pattern) {
+    recordPattern(pattern, false);
+  };
+  auto onSuccess = [&](const Pattern &pattern) {
+    recordPattern(pattern, true);
+    return success();
+  };
+  if (succeeded(
+          matcher.matchAndRewrite(op, *this, canApply, onFailure, onSuccess)))
+    ++numRewrites;
+}
+
 //===----------------------------------------------------------------------===//
 // SimpleCanonicalizer
 //===----------------------------------------------------------------------===//
@@ -35,18 +290,62 @@ struct SimpleCanonicalizer
   /// execution.
   LogicalResult initialize(MLIRContext *context) override {
     RewritePatternSet owningPatterns(context);
-    for (auto *op : context->getRegisteredOperations())
+    patternDialects.clear();
+    patternNames.clear();
+    llvm::StringMap<unsigned> rootCounts;
+    for (auto *op : context->getRegisteredOperations()) {
+      auto numPatterns = owningPatterns.getNativePatterns().size();
       op->getCanonicalizationPatterns(owningPatterns, context);
+      auto &nativePatterns = owningPatterns.getNativePatterns();
+      if (nativePatterns.size() != numPatterns)
+        patternDialects.insert(&op->dialect);
+
+      // Name the new patterns after their root operation.  These names are
+      // only used for the pattern statistics.
+      for (auto i = numPatterns, e = nativePatterns.size(); i != e; ++i) {
+        auto &pattern = *nativePatterns[i];
+        StringRef root = "<any>";
+        if (auto rootKind = pattern.getRootKind())
+          root = rootKind->getStringRef();
+        patternNames[&pattern] =
+            (root + "#" + Twine(rootCounts[root]++)).str();
+      }
+    }
     patterns = std::move(owningPatterns);
+    if (patternStatistics && !statistics)
+      statistics = std::make_shared<PatternStatistics>();
     return success();
   }
   void runOnOperation() override;
 
   mlir::FrozenRewritePatternSet patterns;
+
+  /// The dialects with at least one canonicalization pattern.
+  DenseSet<Dialect *> patternDialects;
+
+  /// A readable name for each pattern.
+  DenseMap<const Pattern *, std::string> patternNames;
+
+  /// The pattern statistics shared by all copies of this pass.
+  std::shared_ptr<PatternStatistics> statistics;
 };
 } // end anonymous namespace
 
 void SimpleCanonicalizer::runOnOperation() {
+  if (incremental) {
+    llvm::StringMap<PatternCounts> counts;
+    IncrementalRewriteDriver driver(&getContext(), patterns, patternDialects,
+                                    statistics ? &counts : nullptr,
+                                    patternNames);
+    driver.simplify(getOperation()->getRegions());
+    numFolds += driver.numFolds;
+    numRewrites += driver.numRewrites;
+    numErasedOps += driver.numErased;
+    if (statistics)
+      statistics->merge(counts);
+    return;
+  }
+
   mlir::GreedyRewriteConfig config;
   config.useTopDownTraversal = true;
   config.enableRegionSimplification = false;
@@ -56,6 +355,8 @@ void SimpleCanonicalizer::runOnOperation() {
 }
 
 /// Create a Canonicalizer pass.
-std::unique_ptr<Pass> circt::createSimpleCanonicalizerPass() {
-  return std::make_unique<SimpleCanonicalizer>();
+std::unique_ptr<Pass> circt::createSimpleCanonicalizerPass(bool incremental) {
+  auto pass = std::make_unique<SimpleCanonicalizer>();
+  pass->incremental = incremental;
+  return pass;
 }
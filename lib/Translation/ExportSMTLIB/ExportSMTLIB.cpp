@@ -0,0 +1,290 @@
+//===- ExportSMTLIB.cpp - SMT-LIB Emitter ---------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is the SMT-LIB emitter, which turns combinational modules into queries
+// over bit vectors for an SMT solver.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Translation/ExportSMTLIB.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/Translation.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+
+using namespace circt;
+using namespace comb;
+using namespace hw;
+
+/// Return the SMT-LIB function computing the predicate of a comparison.
+static StringRef getCompareFunction(ICmpPredicate predicate) {
+  switch (predicate) {
+  case ICmpPredicate::eq:
+    return "=";
+  case ICmpPredicate::ne:
+    return "distinct";
+  case ICmpPredicate::slt:
+    return "bvslt";
+  case ICmpPredicate::sle:
+    return "bvsle";
+  case ICmpPredicate::sgt:
+    return "bvsgt";
+  case ICmpPredicate::sge:
+    return "bvsge";
+  case ICmpPredicate::ult:
+    return "bvult";
+  case ICmpPredicate::ule:
+    return "bvule";
+  case ICmpPredicate::ugt:
+    return "bvugt";
+  case ICmpPredicate::uge:
+    return "bvuge";
+  }
+  llvm_unreachable("unknown comparison predicate");
+}
+
+namespace {
+/// Emits the query of a single module.
+class ModuleEmitter {
+public:
+  explicit ModuleEmitter(raw_ostream &os) : os(os) {}
+
+  LogicalResult emitModule(HWModuleOp module);
+
+private:
+  LogicalResult emitOperation(Operation *op);
+  LogicalResult checkType(Operation *op, Type type);
+
+  /// Emit `function` applied to `operands`, nested to the left if there are
+  /// more than two of them.
+  void emitNested(StringRef function, ValueRange operands);
+
+  raw_ostream &os;
+
+  /// The SMT-LIB term of every value defined so far.
+  DenseMap<Value, std::string> terms;
+  unsigned nextValueID = 0;
+};
+} // end anonymous namespace
+
+LogicalResult ModuleEmitter::checkType(Operation *op, Type type) {
+  auto intType = type.dyn_cast<IntegerType>();
+  if (!intType || intType.getWidth() == 0)
+    return op->emitError("cannot export values of type ")
+           << type << " to SMT-LIB";
+  return success();
+}
+
+void ModuleEmitter::emitNested(StringRef function, ValueRange operands) {
+  for (size_t i = 1, e = operands.size(); i < e; ++i)
+    os << '(' << function << ' ';
+  os << terms[operands[0]];
+  for (size_t i = 1, e = operands.size(); i < e; ++i)
+    os << ' ' << terms[operands[i]] << ')';
+}
+
+LogicalResult ModuleEmitter::emitOperation(Operation *op) {
+  if (auto constant = dyn_cast<hw::ConstantOp>(op)) {
+    if (failed(checkType(op, constant.getType())))
+      return failure();
+    auto value = constant.getValue();
+    terms[constant] = ("(_ bv" + value.toString(10, /*Signed=*/false) + " " +
+                       Twine(value.getBitWidth()) + ")")
+                          .str();
+    return success();
+  }
+
+  if (isa<hw::InstanceOp>(op))
+    return op->emitOpError("must be inlined, e.g. with -hw-miter, before "
+                           "exporting to SMT-LIB");
+  if (!isa<CombDialect>(op->getDialect()) || op->getNumResults() != 1)
+    return op->emitOpError("cannot be exported to SMT-LIB");
+  auto result = op->getResult(0);
+  if (failed(checkType(op, result.getType())))
+    return failure();
+
+  std::string name = "|%" + std::to_string(nextValueID++) + "|";
+  os << "(define-fun " << name << " () (_ BitVec "
+     << result.getType().getIntOrFloatBitWidth() << ") ";
+  auto nested = [&](StringRef function) {
+    return [=](auto op) {
+      emitNested(function, op->getOperands());
+      return true;
+    };
+  };
+  bool emitted =
+      TypeSwitch<Operation *, bool>(op)
+          .Case<AddOp>(nested("bvadd"))
+          .Case<SubOp>(nested("bvsub"))
+          .Case<MulOp>(nested("bvmul"))
+          .Case<DivUOp>(nested("bvudiv"))
+          .Case<DivSOp>(nested("bvsdiv"))
+          .Case<ModUOp>(nested("bvurem"))
+          .Case<ModSOp>(nested("bvsrem"))
+          .Case<ShlOp>(nested("bvshl"))
+          .Case<ShrUOp>(nested("bvlshr"))
+          .Case<ShrSOp>(nested("bvashr"))
+          .Case<AndOp>(nested("bvand"))
+          .Case<OrOp>(nested("bvor"))
+          .Case<XorOp>(nested("bvxor"))
+          .Case<ConcatOp>(nested("concat"))
+          .Case([&](ICmpOp op) {
+            os << "(ite (" << getCompareFunction(op.predicate()) << ' '
+               << terms[op.lhs()] << ' ' << terms[op.rhs()] << ") #b1 #b0)";
+            return true;
+          })
+          .Case([&](ExtractOp op) {
+            unsigned lowBit = op.lowBit();
+            unsigned highBit = lowBit + op.getType().getWidth() - 1;
+            os << "((_ extract " << highBit << ' ' << lowBit << ") "
+               << terms[op.input()] << ')';
+            return true;
+          })
+          .Case([&](SExtOp op) {
+            unsigned extension = op.getType().getWidth() -
+                                 op.input().getType().getIntOrFloatBitWidth();
+            os << "((_ sign_extend " << extension << ") " << terms[op.input()]
+               << ')';
+            return true;
+          })
+          .Case([&](ParityOp op) {
+            // Exclusive-or all bits of the input together.
+            unsigned width = op.input().getType().getIntOrFloatBitWidth();
+            auto &input = terms[op.input()];
+            for (unsigned i = 1; i < width; ++i)
+              os << "(bvxor ";
+            for (unsigned i = 0; i < width; ++i) {
+              os << "((_ extract " << i << ' ' << i << ") " << input << ')';
+              os << (i == 0 ? "" : ")");
+              if (i + 1 != width)
+                os << ' ';
+            }
+            return true;
+          })
+          .Case([&](MuxOp op) {
+            os << "(ite (= " << terms[op.cond()] << " #b1) "
+               << terms[op.trueValue()] << ' ' << terms[op.falseValue()]
+               << ')';
+            return true;
+          })
+          .Default([](Operation *) { return false; });
+  if (!emitted)
+    return op->emitOpError("cannot be exported to SMT-LIB");
+  os << ")\n";
+  terms[result] = std::move(name);
+  return success();
+}
+
+/// Emit the query of `module`: its inputs are declared as constants, each
+/// operation is defined in terms of its operands, and the output is asserted
+/// to be 1.
+LogicalResult ModuleEmitter::emitModule(HWModuleOp module) {
+  auto outputTypes = module.getType().getResults();
+  if (outputTypes.size() != 1 || !outputTypes[0].isInteger(1))
+    return module.emitError("module '")
+           << module.getName()
+           << "' must have a single i1 output to be exported to SMT-LIB";
+
+  os << "; hw.module @" << module.getName() << "\n(push 1)\n(echo \""
+     << module.getName() << "\")\n";
+  for (auto &port : module.getPorts()) {
+    if (port.isOutput())
+      continue;
+    if (failed(checkType(module, port.type)))
+      return failure();
+    std::string name = ("|" + port.getName() + "|").str();
+    os << "(declare-const " << name << " (_ BitVec "
+       << port.type.getIntOrFloatBitWidth() << "))\n";
+    terms[module.getArgument(port.argNum)] = std::move(name);
+  }
+
+  // The body is a graph region, so define the operations in topological
+  // order.
+  Block *body = module.getBodyBlock();
+  DenseMap<Operation *, unsigned> numPending;
+  SmallVector<Operation *> ready;
+  for (auto &op : *body) {
+    unsigned pending = llvm::count_if(op.getOperands(), [](Value operand) {
+      return operand.getDefiningOp() != nullptr;
+    });
+    numPending[&op] = pending;
+    if (pending == 0)
+      ready.push_back(&op);
+  }
+
+  unsigned numEmitted = 0;
+  while (!ready.empty()) {
+    auto *op = ready.pop_back_val();
+    ++numEmitted;
+    if (auto output = dyn_cast<hw::OutputOp>(op)) {
+      os << "(assert (= " << terms[output.getOperand(0)] << " #b1))\n";
+      continue;
+    }
+    if (failed(emitOperation(op)))
+      return failure();
+    for (auto *user : op->getUsers())
+      if (--numPending[user] == 0)
+        ready.push_back(user);
+  }
+
+  if (numEmitted != body->getOperations().size()) {
+    for (auto &op : *body)
+      if (numPending[&op] != 0)
+        return op.emitOpError("is part of a combinational cycle");
+  }
+
+  os << "(check-sat)\n(pop 1)\n";
+  return success();
+}
+
+LogicalResult circt::exportSMTLIB(ModuleOp module, raw_ostream &os) {
+  SmallVector<HWModuleOp> modules(module.getOps<HWModuleOp>());
+
+  // The queries are independent, so emit them into separate buffers in
+  // parallel and print the buffers in order.
+  SmallVector<std::string> buffers(modules.size());
+  std::atomic<bool> encounteredError(false);
+  auto emit = [&](size_t index) {
+    llvm::raw_string_ostream bufferStream(buffers[index]);
+    if (failed(ModuleEmitter(bufferStream).emitModule(modules[index])))
+      encounteredError = true;
+  };
+  auto *context = module.getContext();
+  if (context->isMultithreadingEnabled()) {
+    // Keep the diagnostics of the modules in order.
+    mlir::ParallelDiagnosticHandler diagHandler(context);
+    llvm::parallelForEachN(0, modules.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      emit(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = modules.size(); i != e; ++i)
+      emit(i);
+  }
+  if (encounteredError)
+    return failure();
+
+  os << "(set-logic QF_BV)\n";
+  for (auto &buffer : buffers)
+    os << buffer;
+  return success();
+}
+
+void circt::registerToSMTLIBTranslation() {
+  mlir::TranslateFromMLIRRegistration toSMTLIB(
+      "export-smtlib", exportSMTLIB, [](mlir::DialectRegistry &registry) {
+        registry.insert<CombDialect, HWDialect>();
+      });
+}
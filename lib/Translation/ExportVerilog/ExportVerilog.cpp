@@ -24,17 +24,26 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/Support/FileUtilities.h"
+#include "mlir/Support/Timing.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/SaveAndRestore.h"
+#include "llvm/Support/StringSaver.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <mutex>
 
 using namespace circt;
 
@@ -371,20 +380,9 @@ enum VerilogPrecedence {
 };
 } // end anonymous namespace
 
-/// Return the location information as a (potentially empty) string.
-static std::string
-getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
-  std::string resultStr;
-  llvm::raw_string_ostream sstr(resultStr);
-
-  // Multiple operations may come from the same location or may not have useful
-  // location info.  Unique it now.
-  SmallPtrSet<Attribute, 8> locations;
-  for (auto *op : ops) {
-    if (auto loc = op->getLoc().dyn_cast<FileLineColLoc>())
-      locations.insert(loc);
-  }
-
+/// Print a set of distinct, non-empty `FileLineColLoc`s as a trailing comment.
+static void printLocationInfo(ArrayRef<Attribute> locations,
+                              raw_ostream &sstr) {
   auto printLoc = [&](FileLineColLoc loc) {
     sstr << loc.getFilename();
     if (auto line = loc.getLine()) {
@@ -394,16 +392,17 @@ getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
     }
   };
 
-  switch (locations.size()) {
-  case 1:
-    printLoc((*locations.begin()).cast<FileLineColLoc>());
-    LLVM_FALLTHROUGH;
-  case 0:
-    return sstr.str();
-  default:
-    break;
+  if (locations.size() == 1) {
+    auto loc = locations.front().cast<FileLineColLoc>();
+    if (!loc.getFilename().empty() || loc.getLine()) {
+      sstr << "\t// ";
+      printLoc(loc);
+    }
+    return;
   }
 
+  sstr << "\t// ";
+
   // Sort the entries.
   SmallVector<FileLineColLoc, 8> locVector;
   locVector.reserve(locations.size());
@@ -461,8 +460,6 @@ getLocationInfoAsString(const SmallPtrSet<Operation *, 8> &ops) {
     }
     sstr << '}';
   }
-
-  return sstr.str();
 }
 
 /// Append a path to an existing path, replacing it if the other path is
@@ -487,6 +484,65 @@ static void appendPossiblyAbsolutePath(SmallVectorImpl<char> &base,
 
 namespace {
 
+/// The ports and name of a module, which every instance of it needs to be
+/// prepared and emitted.
+struct InstantiatedModuleInfo {
+  Operation *module = nullptr;
+  StringAttr verilogName;
+  SmallVector<ModulePortInfo> ports;
+  /// Whether each port has a zero width type, and is commented out.
+  SmallVector<bool> isZeroWidth;
+  /// One past the last port that isn't zero width, which is the last port to
+  /// be followed by a comma.
+  size_t endOfNonZeroWidthPorts = 0;
+  /// The length of the longest port name, to align the connections.
+  size_t maxNameLength = 0;
+
+  /// Return whether the port is followed by a comma, if a port was printed
+  /// before it.
+  bool needsComma(size_t portNum) const {
+    return !isZeroWidth[portNum] || portNum + 1 < endOfNonZeroWidthPorts;
+  }
+};
+
+/// The information of every module in the design, by name.  It is computed
+/// once up front rather than for every instance, and only read afterwards, so
+/// that the modules can be prepared and emitted concurrently.
+class InstantiatedModules {
+public:
+  explicit InstantiatedModules(ModuleOp rootOp);
+
+  const InstantiatedModuleInfo &lookup(InstanceOp op) const {
+    auto it = infos.find(op.moduleName());
+    assert(it != infos.end() && "Invalid IR");
+    return it->second;
+  }
+
+private:
+  llvm::StringMap<InstantiatedModuleInfo> infos;
+};
+} // namespace
+
+InstantiatedModules::InstantiatedModules(ModuleOp rootOp) {
+  for (auto &op : *rootOp.getBody()) {
+    if (!isAnyModule(&op))
+      continue;
+    auto name = op.getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+    auto &info = infos[name.getValue()];
+    info.module = &op;
+    info.verilogName = getVerilogModuleNameAttr(&op);
+    info.ports = getModulePortInfo(&op);
+    for (auto &port : info.ports) {
+      info.isZeroWidth.push_back(isZeroBitType(port.type));
+      if (!info.isZeroWidth.back())
+        info.endOfNonZeroWidthPorts = info.isZeroWidth.size();
+      info.maxNameLength = std::max(info.maxNameLength, port.getName().size());
+    }
+  }
+}
+
+namespace {
+
 /// This class maintains the mutable state that cross-cuts and is shared by the
 /// various emitters.
 class VerilogEmitterState {
@@ -496,12 +552,30 @@ public:
   /// The emitter options which control verilog emission.
   LoweringOptions options;
 
+  /// The modules of the design, to emit their instances.
+  const InstantiatedModules *instantiatedModules = nullptr;
+
   /// The stream to emit to.
   raw_ostream &os;
 
   bool encounteredError = false;
   unsigned currentIndent = 0;
 
+  /// The buffer statements are emitted into before they are written to the
+  /// stream.  It is reused for every module emitted with this state, so that
+  /// it only has to grow to the size of the largest module once.
+  SmallString<0> statementBuffer;
+
+  /// The rendered location comments, by the set of locations they describe,
+  /// and the storage backing them.
+  DenseMap<ArrayRef<Attribute>, StringRef> locationComments;
+  llvm::BumpPtrAllocator locationAllocator;
+
+  /// The number of temporaries introduced to break up long expressions, and
+  /// the number of expressions emitted out of line, so far.
+  size_t numTemporaries = 0;
+  size_t numSpilledWires = 0;
+
 private:
   VerilogEmitterState(const VerilogEmitterState &) = delete;
   void operator=(const VerilogEmitterState &) = delete;
@@ -648,12 +722,7 @@ public:
   /// If we have location information for any of the specified operations,
   /// aggregate it together and print a pretty comment specifying where the
   /// operations came from.  In any case, print a newline.
-  void emitLocationInfoAndNewLine(const SmallPtrSet<Operation *, 8> &ops) {
-    auto locInfo = getLocationInfoAsString(ops);
-    if (!locInfo.empty())
-      os << "\t// " << locInfo;
-    os << '\n';
-  }
+  void emitLocationInfoAndNewLine(const SmallPtrSet<Operation *, 8> &ops);
 
   void emitTextWithSubstitutions(StringRef string, Operation *op,
                                  std::function<void(Value)> operandEmitter);
@@ -664,6 +733,51 @@ private:
 };
 } // end anonymous namespace
 
+/// If we have location information for any of the specified operations,
+/// aggregate it together and print a pretty comment specifying where the
+/// operations came from.  In any case, print a newline.
+void EmitterBase::emitLocationInfoAndNewLine(
+    const SmallPtrSet<Operation *, 8> &ops) {
+  if (state.options.disallowLocationInfo) {
+    os << '\n';
+    return;
+  }
+
+  // Multiple operations may come from the same location or may not have useful
+  // location info.  Unique it now.  The order only matters for the cache key,
+  // the comment itself is sorted by file, line and column.
+  SmallVector<Attribute, 8> locations;
+  for (auto *op : ops) {
+    if (auto loc = op->getLoc().dyn_cast<FileLineColLoc>())
+      locations.push_back(loc);
+  }
+  if (locations.empty()) {
+    os << '\n';
+    return;
+  }
+  llvm::sort(locations, [](Attribute lhs, Attribute rhs) {
+    return lhs.getAsOpaquePointer() < rhs.getAsOpaquePointer();
+  });
+  locations.erase(std::unique(locations.begin(), locations.end()),
+                  locations.end());
+
+  // Statements derived from the same source constructs carry the same sets of
+  // locations, so each comment is rendered once per emission.
+  auto &comments = state.locationComments;
+  auto it = comments.find(locations);
+  if (it == comments.end()) {
+    SmallString<64> comment;
+    llvm::raw_svector_ostream commentStream(comment);
+    printLocationInfo(locations, commentStream);
+
+    auto key = ArrayRef<Attribute>(locations).copy(state.locationAllocator);
+    auto value =
+        llvm::StringSaver(state.locationAllocator).save(commentStream.str());
+    it = comments.insert({key, value}).first;
+  }
+  os << it->second << '\n';
+}
+
 void EmitterBase::emitTextWithSubstitutions(
     StringRef string, Operation *op,
     std::function<void(Value)> operandEmitter) {
@@ -750,6 +864,9 @@ public:
 
 public:
   void verifyModuleName(Operation *, StringAttr nameAttr);
+  void collectOutOfLineExpressions(Operation *op);
+  unsigned getInlineMuxChainDepth(MuxOp mux,
+                                  DenseMap<Operation *, unsigned> &depths);
 
   /// This set keeps track of all of the expression nodes that need to be
   /// emitted as standalone wire declarations.  This can happen because they are
@@ -1025,6 +1142,7 @@ void ExprEmitter::retroactivelyEmitExpressionIntoTemporary(Operation *op) {
 
   emitter.outOfLineExpressions.insert(op);
   names.addName(op->getResult(0), "_tmp");
+  ++state.numTemporaries;
 
   // Remember that this subexpr needs to be emitted independently.
   tooLargeSubExpressions.push_back(op);
@@ -1547,11 +1665,9 @@ void NameCollector::collectNames(Block &block) {
       // name.
       if (isExpr) {
         // If this expression is dead, or can be emitted inline, ignore it.
-        if (result.use_empty() || isExpressionEmittedInline(&op))
+        if (result.use_empty() ||
+            !moduleEmitter.outOfLineExpressions.count(&op))
           continue;
-
-        // Remember that this expression should be emitted out of line.
-        moduleEmitter.outOfLineExpressions.insert(&op);
       }
 
       // Otherwise, it must be an expression or a declaration like a
@@ -2380,11 +2496,10 @@ LogicalResult StmtEmitter::visitStmt(InstanceOp op) {
   SmallPtrSet<Operation *, 8> ops;
   ops.insert(op);
 
-  auto *moduleOp = op.getReferencedModule();
-  assert(moduleOp && "Invalid IR");
+  auto &moduleInfo = state.instantiatedModules->lookup(op);
 
   // Use the specified name or the symbol name as appropriate.
-  auto verilogName = getVerilogModuleNameAttr(moduleOp);
+  auto verilogName = moduleInfo.verilogName;
   emitter.verifyModuleName(op, verilogName);
   indent() << prefix << verilogName.getValue();
 
@@ -2445,13 +2560,8 @@ LogicalResult StmtEmitter::visitStmt(InstanceOp op) {
 
   os << ' ' << names.getName(op) << " (";
 
-  SmallVector<ModulePortInfo> portInfo = getModulePortInfo(moduleOp);
-
-  // Get the max port name length so we can align the '('.
-  size_t maxNameLength = 0;
-  for (auto &elt : portInfo) {
-    maxNameLength = std::max(maxNameLength, elt.getName().size());
-  }
+  ArrayRef<ModulePortInfo> portInfo = moduleInfo.ports;
+  size_t maxNameLength = moduleInfo.maxNameLength;
 
   auto getWireForValue = [&](Value result) {
     return result.getUsers().begin()->getOperand(0);
@@ -2472,25 +2582,12 @@ LogicalResult StmtEmitter::visitStmt(InstanceOp op) {
     // Figure out which value we are emitting.
     auto &elt = portInfo[portNum];
     Value portVal = portValues[portNum];
-    bool isZeroWidth = isZeroBitType(portVal.getType());
+    bool isZeroWidth = moduleInfo.isZeroWidth[portNum];
 
     // Decide if we should print a comma.  We can't do this if we're the first
     // port or if all the subsequent ports are zero width.
-    if (!isFirst) {
-      bool shouldPrintComma = true;
-      if (isZeroWidth) {
-        shouldPrintComma = false;
-        for (size_t i = (&elt - portInfo.data()) + 1, e = portInfo.size();
-             i != e; ++i)
-          if (!isZeroBitType(portValues[i].getType())) {
-            shouldPrintComma = true;
-            break;
-          }
-      }
-
-      if (shouldPrintComma)
-        os << ',';
-    }
+    if (!isFirst && moduleInfo.needsComma(portNum))
+      os << ',';
     emitLocationInfoAndNewLine(ops);
 
     // Emit the port's name.
@@ -2696,14 +2793,68 @@ void StmtEmitter::emitStatementBlock(Block &body) {
   reduceIndent();
 }
 
+/// Decide once, up front, which of the expressions under an operation are
+/// emitted out of line, so that the emitter only has to look the decision up
+/// for each block and each use.
+void ModuleEmitter::collectOutOfLineExpressions(Operation *op) {
+  DenseMap<Operation *, unsigned> muxDepths;
+  op->walk([&](Operation *nested) {
+    if (!isVerilogExpression(nested) || nested->use_empty())
+      return;
+    if (!isExpressionEmittedInline(nested)) {
+      if (outOfLineExpressions.insert(nested).second)
+        ++state.numSpilledWires;
+      return;
+    }
+    if (auto mux = dyn_cast<MuxOp>(nested))
+      if (state.options.maximumMuxChainDepth)
+        getInlineMuxChainDepth(mux, muxDepths);
+  });
+}
+
+/// Return the number of muxes nested into each other in the expression emitted
+/// for `mux`, counting the arms which are emitted inline.  A mux which brings
+/// the chain to the maximum depth is emitted out of line, so that it starts a
+/// new chain for its users.
+unsigned
+ModuleEmitter::getInlineMuxChainDepth(MuxOp mux,
+                                      DenseMap<Operation *, unsigned> &depths) {
+  auto it = depths.find(mux);
+  if (it != depths.end())
+    return it->second;
+
+  unsigned depth = 0;
+  for (auto arm : {mux.trueValue(), mux.falseValue()}) {
+    auto armMux = arm.getDefiningOp<MuxOp>();
+    if (armMux && !outOfLineExpressions.count(armMux) &&
+        isExpressionEmittedInline(armMux))
+      depth = std::max(depth, getInlineMuxChainDepth(armMux, depths));
+  }
+
+  // Only the muxes used by another mux continue the chain.
+  ++depth;
+  if (depth >= state.options.maximumMuxChainDepth &&
+      isa<MuxOp>(*mux->user_begin()) && outOfLineExpressions.insert(mux).second)
+    ++state.numSpilledWires;
+  if (outOfLineExpressions.count(mux))
+    depth = 0;
+  depths.insert({mux, depth});
+  return depth;
+}
+
 void ModuleEmitter::emitStatement(Operation *op, ModuleNameManager &names) {
-  SmallString<128> outputBuffer;
+  collectOutOfLineExpressions(op);
+  auto &outputBuffer = state.statementBuffer;
+  outputBuffer.clear();
   StmtEmitter(*this, outputBuffer, names).emitStatement(op);
   os << outputBuffer;
 }
 
 void ModuleEmitter::emitStatementBlock(Block &body, ModuleNameManager &names) {
-  SmallString<128> outputBuffer;
+  for (auto &op : body)
+    collectOutOfLineExpressions(&op);
+  auto &outputBuffer = state.statementBuffer;
+  outputBuffer.clear();
   StmtEmitter(*this, outputBuffer, names).emitStatementBlock(body);
   os << outputBuffer;
 }
@@ -2737,49 +2888,31 @@ void ModuleEmitter::emitBind(BindOp op) {
   auto parentVerilogName = getVerilogModuleNameAttr(parentMod);
   verifyModuleName(op, parentVerilogName);
 
-  Operation *childMod = inst.getReferencedModule();
-  auto childVerilogName = getVerilogModuleNameAttr(childMod);
+  auto &childInfo = state.instantiatedModules->lookup(inst);
+  auto childVerilogName = childInfo.verilogName;
   verifyModuleName(op, childVerilogName);
 
   indent() << "bind " << parentVerilogName.getValue() << " "
            << childVerilogName.getValue() << ' ' << inst.getName() << " (";
 
   SmallVector<ModulePortInfo> parentPortInfo = parentMod.getPorts();
-  SmallVector<ModulePortInfo> childPortInfo = getModulePortInfo(childMod);
-
-  // Get the max port name length so we can align the '('.
-  size_t maxNameLength = 0;
-  for (auto &elt : childPortInfo) {
-    maxNameLength = std::max(maxNameLength, elt.getName().size());
-  }
+  ArrayRef<ModulePortInfo> childPortInfo = childInfo.ports;
+  size_t maxNameLength = childInfo.maxNameLength;
 
   // Emit the argument and result ports.
   auto opArgs = inst.inputs();
   auto opResults = inst.getResults();
   bool isFirst = true; // True until we print a port.
-  for (auto &elt : childPortInfo) {
+  for (size_t portNum = 0, e = childPortInfo.size(); portNum < e; ++portNum) {
     // Figure out which value we are emitting.
+    auto &elt = childPortInfo[portNum];
     Value portVal = elt.isOutput() ? opResults[elt.argNum] : opArgs[elt.argNum];
-    bool isZeroWidth = isZeroBitType(elt.type);
+    bool isZeroWidth = childInfo.isZeroWidth[portNum];
 
     // Decide if we should print a comma.  We can't do this if we're the first
     // port or if all the subsequent ports are zero width.
-    if (!isFirst) {
-      bool shouldPrintComma = true;
-      if (isZeroWidth) {
-        shouldPrintComma = false;
-        for (size_t i = (&elt - childPortInfo.data()) + 1,
-                    e = childPortInfo.size();
-             i != e; ++i)
-          if (!isZeroBitType(childPortInfo[i].type)) {
-            shouldPrintComma = true;
-            break;
-          }
-      }
-
-      if (shouldPrintComma)
-        os << ',';
-    }
+    if (!isFirst && childInfo.needsComma(portNum))
+      os << ',';
     os << "\n";
 
     // Emit the port's name.
@@ -2835,7 +2968,8 @@ static bool isSimpleReadOrPort(Value v) {
 
 // Given an invisible instance, make sure all inputs are driven from
 // wires or ports.
-static void lowerBoundInstance(InstanceOp op) {
+static void lowerBoundInstance(InstanceOp op,
+                               const InstantiatedModuleInfo &moduleInfo) {
   Block *block = op->getParentOfType<HWModuleOp>().getBodyBlock();
   auto builder = ImplicitLocOpBuilder::atBlockBegin(op.getLoc(), block);
 
@@ -2844,7 +2978,7 @@ static void lowerBoundInstance(InstanceOp op) {
   auto namePrefixSize = nameTmp.size();
 
   size_t nextOpNo = 0;
-  for (auto &port : getModulePortInfo(op.getReferencedModule())) {
+  for (auto &port : moduleInfo.ports) {
     if (port.isOutput())
       continue;
 
@@ -2878,7 +3012,8 @@ static bool onlyUseIsAssign(Value v) {
 }
 
 // Ensure that each output of an instance are used only by a wire
-static void lowerInstanceResults(InstanceOp op) {
+static void lowerInstanceResults(InstanceOp op,
+                                 const InstantiatedModuleInfo &moduleInfo) {
   Block *block = op->getParentOfType<HWModuleOp>().getBodyBlock();
   auto builder = ImplicitLocOpBuilder::atBlockBegin(op.getLoc(), block);
 
@@ -2887,7 +3022,7 @@ static void lowerInstanceResults(InstanceOp op) {
   auto namePrefixSize = nameTmp.size();
 
   size_t nextResultNo = 0;
-  for (auto &port : getModulePortInfo(op.getReferencedModule())) {
+  for (auto &port : moduleInfo.ports) {
     if (!port.isOutput())
       continue;
 
@@ -3000,9 +3135,16 @@ static Value lowerMergeOp(MergeOp merge) {
   return b.create<ReadInOutOp>(wire);
 }
 
+/// The binary operations created by `lowerVariadicCommutativeOp`, by operation
+/// name and operands.
+using SubtermCache =
+    DenseMap<std::pair<const void *, std::pair<Value, Value>>, Value>;
+
 /// Lower a commutative operation into an expression tree.  This enables
-/// long-line splitting to work with them.
-static Value lowerVariadicCommutativeOp(Operation &op, OperandRange operands) {
+/// long-line splitting to work with them.  If `subterms` is given, the terms
+/// which recur among the operations of the block are created once and shared.
+static Value lowerVariadicCommutativeOp(Operation &op, OperandRange operands,
+                                        SubtermCache *subterms) {
   Value lhs, rhs;
   switch (operands.size()) {
   case 0:
@@ -3016,16 +3158,28 @@ static Value lowerVariadicCommutativeOp(Operation &op, OperandRange operands) {
     break;
   default:
     auto firstHalf = operands.size() / 2;
-    lhs = lowerVariadicCommutativeOp(op, operands.take_front(firstHalf));
-    rhs = lowerVariadicCommutativeOp(op, operands.drop_front(firstHalf));
+    lhs = lowerVariadicCommutativeOp(op, operands.take_front(firstHalf),
+                                     subterms);
+    rhs = lowerVariadicCommutativeOp(op, operands.drop_front(firstHalf),
+                                     subterms);
     break;
   }
 
+  auto *name = op.getName().getAsOpaquePointer();
+  if (subterms) {
+    if (auto term = subterms->lookup({name, {lhs, rhs}}))
+      return term;
+    if (auto term = subterms->lookup({name, {rhs, lhs}}))
+      return term;
+  }
+
   OperationState state(op.getLoc(), op.getName());
   state.addOperands(ValueRange{lhs, rhs});
   state.addTypes(op.getResult(0).getType());
   auto *newOp = Operation::create(state);
   op.getBlock()->getOperations().insert(Block::iterator(&op), newOp);
+  if (subterms)
+    subterms->insert({{name, {lhs, rhs}}, newOp->getResult(0)});
   return newOp->getResult(0);
 }
 
@@ -3207,6 +3361,13 @@ struct FileInfo {
 
   /// Whether to include this file as part of the emitted file list.
   bool addToFilelist = true;
+
+  /// The hash of the emitted contents, when emitting split files
+  /// incrementally.
+  SmallString<32> contentHash;
+
+  /// The key of the file in the split Verilog cache, if it may be cached.
+  SmallString<32> cacheKey;
 };
 
 /// A base class for all MLIR module emitters.
@@ -3214,6 +3375,9 @@ struct RootEmitterBase {
   /// The MLIR module to emit.
   ModuleOp rootOp;
 
+  /// The emitter options, read out of the module.
+  LoweringOptions options;
+
   /// The main file that collects all operations that are neither replicated
   /// per-file ops nor specifically assigned to a file.
   FileInfo rootFile;
@@ -3232,23 +3396,40 @@ struct RootEmitterBase {
   /// Legalized names for each module
   llvm::DenseMap<Operation *, ModuleNameManager> legalizedNames;
 
-  explicit RootEmitterBase(ModuleOp rootOp) : rootOp(rootOp) {}
+  /// The ports and names of the modules, for their instances.
+  InstantiatedModules instantiatedModules;
+
+  /// The statistics to record the emitted modules into, if any.  Modules are
+  /// emitted concurrently, so recording goes through the mutex.
+  ExportVerilogStatistics *statistics = nullptr;
+  std::mutex statisticsMutex;
+
+  explicit RootEmitterBase(ModuleOp rootOp)
+      : rootOp(rootOp), options(rootOp), instantiatedModules(rootOp) {}
   void prepareAllModules();
+  void prepareModule(HWModuleOp module);
   void gatherFiles(bool separateModules);
+  void collectOperations(const FileInfo &fileInfo,
+                         SmallVectorImpl<Operation *> &ops);
   void emitFile(const FileInfo &fileInfo, VerilogEmitterState &state);
   void emitOperation(VerilogEmitterState &state, Operation *op);
+  void emitHWModule(VerilogEmitterState &state, HWModuleOp module);
+  void sortStatistics();
 };
 
 } // namespace
 
 /// For each module we emit, do a prepass over the structure, pre-lowering and
 /// otherwise rewriting operations we don't want to emit.
-static void prepareHWModule(Block &block, ModuleNameManager &names) {
+static void prepareHWModule(Block &block, ModuleNameManager &names,
+                            const InstantiatedModules &modules,
+                            const LoweringOptions &options) {
+  SubtermCache subterms;
   for (auto &op : llvm::make_early_inc_range(block)) {
     // If the operations has regions, lower each of the regions.
     for (auto &region : op.getRegions()) {
       if (!region.empty())
-        prepareHWModule(region.front(), names);
+        prepareHWModule(region.front(), names, modules, options);
     }
 
     // Duplicate "always inline" expression for each of their users and move
@@ -3275,7 +3456,9 @@ static void prepareHWModule(Block &block, ModuleNameManager &names) {
         op.getNumRegions() == 0 && op.getNumSuccessors() == 0 &&
         op.getAttrs().empty()) {
       // Lower this operation to a balanced binary tree of the same operation.
-      auto result = lowerVariadicCommutativeOp(op, op.getOperands());
+      auto result = lowerVariadicCommutativeOp(
+          op, op.getOperands(),
+          options.shareVariadicSubterms ? &subterms : nullptr);
       op.getResult(0).replaceAllUsesWith(result);
       op.erase();
       continue;
@@ -3287,11 +3470,12 @@ static void prepareHWModule(Block &block, ModuleNameManager &names) {
     // them now ensures any temporary generated will not use one of the names
     // previously declared.
     if (auto instance = dyn_cast<InstanceOp>(op)) {
+      auto &moduleInfo = modules.lookup(instance);
       // Anchor return values to wires early
-      lowerInstanceResults(instance);
+      lowerInstanceResults(instance, moduleInfo);
       // Anchor ports of bound instances
       if (instance->hasAttr("doNotPrint"))
-        lowerBoundInstance(instance);
+        lowerBoundInstance(instance, moduleInfo);
       names.addLegalName(&op, instance.instanceName(), &op);
     } else if (auto wire = dyn_cast<WireOp>(op))
       names.addLegalName(op.getResult(0), wire.name(), &op);
@@ -3351,13 +3535,36 @@ static void prepareHWModule(Block &block, ModuleNameManager &names) {
 }
 
 void RootEmitterBase::prepareAllModules() {
-  bool hasError = false;
+  // Create the name table of every module first, so that the modules can be
+  // prepared concurrently without modifying the map.
+  SmallVector<HWModuleOp, 0> modules;
   for (auto op : rootOp.getBody()->getOps<HWModuleOp>()) {
-    auto &names = legalizedNames[op];
-    prepareHWModule(*op.getBodyBlock(), names);
-    hasError |= names.hadError();
+    legalizedNames[op];
+    modules.push_back(op);
+  }
+
+  auto *context = rootOp.getContext();
+  if (context->isMultithreadingEnabled()) {
+    // Keep the diagnostics of the modules in order.
+    mlir::ParallelDiagnosticHandler diagHandler(context);
+    llvm::parallelForEachN(0, modules.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      prepareModule(modules[index]);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (auto op : modules)
+      prepareModule(op);
   }
-  if (hasError)
+}
+
+/// Prepare a single module for emission.  The name table of the module must
+/// already be in `legalizedNames` if other modules are prepared concurrently.
+void RootEmitterBase::prepareModule(HWModuleOp module) {
+  auto &names = legalizedNames[module];
+  prepareHWModule(*module.getBodyBlock(), names, instantiatedModules,
+                  options);
+  if (names.hadError())
     encounteredError = true;
 }
 
@@ -3452,10 +3659,10 @@ void RootEmitterBase::gatherFiles(bool separateModules) {
   }
 }
 
-/// Emit the operations in a `FileInfo` to an output stream. This handles the
-/// correct interpolation of replicated operations.
-void RootEmitterBase::emitFile(const FileInfo &file,
-                               VerilogEmitterState &state) {
+/// Collect the operations in a `FileInfo` in the order they are emitted. This
+/// handles the correct interpolation of replicated operations.
+void RootEmitterBase::collectOperations(const FileInfo &file,
+                                        SmallVectorImpl<Operation *> &ops) {
   size_t lastReplicatedOp = 0;
 
   // Emit each operation in the file preceded by the replicated ops not yet
@@ -3466,17 +3673,26 @@ void RootEmitterBase::emitFile(const FileInfo &file,
     if (file.emitReplicatedOps)
       for (; lastReplicatedOp < std::min(opInfo.position, replicatedOps.size());
            ++lastReplicatedOp)
-        emitOperation(state, replicatedOps[lastReplicatedOp]);
+        ops.push_back(replicatedOps[lastReplicatedOp]);
 
     // Emit the operation itself.
-    emitOperation(state, opInfo.op);
+    ops.push_back(opInfo.op);
   }
 
   // Emit the replicated per-file operations after the last operation (if
   // enabled).
   if (file.emitReplicatedOps)
     for (; lastReplicatedOp < replicatedOps.size(); lastReplicatedOp++)
-      emitOperation(state, replicatedOps[lastReplicatedOp]);
+      ops.push_back(replicatedOps[lastReplicatedOp]);
+}
+
+/// Emit the operations in a `FileInfo` to an output stream.
+void RootEmitterBase::emitFile(const FileInfo &file,
+                               VerilogEmitterState &state) {
+  SmallVector<Operation *> ops;
+  collectOperations(file, ops);
+  for (auto *op : ops)
+    emitOperation(state, op);
 
   if (state.encounteredError)
     encounteredError = true;
@@ -3484,9 +3700,7 @@ void RootEmitterBase::emitFile(const FileInfo &file,
 
 void RootEmitterBase::emitOperation(VerilogEmitterState &state, Operation *op) {
   TypeSwitch<Operation *>(op)
-      .Case<HWModuleOp>([&](auto op) {
-        ModuleEmitter(state).emitHWModule(op, legalizedNames[op]);
-      })
+      .Case<HWModuleOp>([&](auto op) { emitHWModule(state, op); })
       .Case<HWModuleExternOp>(
           [&](auto op) { ModuleEmitter(state).emitHWExternModule(op); })
       .Case<HWModuleGeneratedOp>(
@@ -3506,6 +3720,82 @@ void RootEmitterBase::emitOperation(VerilogEmitterState &state, Operation *op) {
       });
 }
 
+/// Emit a module, recording its statistics if requested.
+void RootEmitterBase::emitHWModule(VerilogEmitterState &state,
+                                   HWModuleOp module) {
+  if (!statistics) {
+    ModuleEmitter(state).emitHWModule(module, legalizedNames[module]);
+    return;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto startTime = Clock::now();
+  auto startBytes = state.os.tell();
+  auto startTemporaries = state.numTemporaries;
+  auto startSpilledWires = state.numSpilledWires;
+
+  ModuleEmitter(state).emitHWModule(module, legalizedNames[module]);
+
+  ExportVerilogStatistics::ModuleStatistics moduleStatistics;
+  moduleStatistics.name = module.getVerilogModuleName().str();
+  moduleStatistics.bytesEmitted = state.os.tell() - startBytes;
+  moduleStatistics.temporaries = state.numTemporaries - startTemporaries;
+  moduleStatistics.spilledWires = state.numSpilledWires - startSpilledWires;
+  moduleStatistics.seconds =
+      std::chrono::duration<double>(Clock::now() - startTime).count();
+
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  statistics->modules.push_back(std::move(moduleStatistics));
+}
+
+/// Bring the recorded statistics into a deterministic order, independent of
+/// the order in which the modules were emitted.
+void RootEmitterBase::sortStatistics() {
+  if (!statistics)
+    return;
+  llvm::sort(statistics->modules, [](const auto &lhs, const auto &rhs) {
+    return lhs.name < rhs.name;
+  });
+}
+
+void ExportVerilogStatistics::printJSON(llvm::raw_ostream &os) const {
+  size_t totalBytes = 0, totalTemporaries = 0, totalSpilledWires = 0;
+  double totalSeconds = 0;
+  for (auto &module : modules) {
+    totalBytes += module.bytesEmitted;
+    totalTemporaries += module.temporaries;
+    totalSpilledWires += module.spilledWires;
+    totalSeconds += module.seconds;
+  }
+
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  auto printCounts = [&](size_t bytes, size_t temporaries, size_t spilledWires,
+                         double seconds) {
+    json.attribute("bytes", int64_t(bytes));
+    json.attribute("temporaries", int64_t(temporaries));
+    json.attribute("spilledWires", int64_t(spilledWires));
+    json.attribute("seconds", seconds);
+  };
+  json.object([&] {
+    json.attributeObject("total", [&] {
+      json.attribute("modules", int64_t(modules.size()));
+      printCounts(totalBytes, totalTemporaries, totalSpilledWires,
+                  totalSeconds);
+      json.attribute("cachedFiles", int64_t(cachedFiles));
+    });
+    json.attributeArray("modules", [&] {
+      for (auto &module : modules) {
+        json.object([&] {
+          json.attribute("name", module.name);
+          printCounts(module.bytesEmitted, module.temporaries,
+                      module.spilledWires, module.seconds);
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
 //===----------------------------------------------------------------------===//
 // Unified Emitter
 //===----------------------------------------------------------------------===//
@@ -3526,21 +3816,53 @@ struct UnifiedEmitter : public RootEmitterBase {
 } // namespace
 
 void UnifiedEmitter::emitMLIRModule() {
-  VerilogEmitterState state(os);
   gatherFiles(false);
 
-  // Read the emitter options out of the module.
-  state.options.parseFromAttribute(rootOp);
+  // Lay out the main file, a container for anything not explicitly split out
+  // into a separate file, followed by the separate files.  Remember where each
+  // of the separate files starts to print a separator there.
+  SmallVector<Operation *, 0> ops;
+  SmallVector<std::pair<size_t, Identifier>> fileStarts;
+  collectOperations(rootFile, ops);
+  for (const auto &it : files) {
+    fileStarts.push_back({ops.size(), it.first});
+    collectOperations(it.second, ops);
+  }
 
-  // Emit the main file. This is a container for anything not explicitly split
-  // out into a separate file.
-  emitFile(rootFile, state);
+  // Emit each top-level operation into its own buffer, in parallel if enabled.
+  // The operations don't share any emitter state.
+  std::vector<std::string> buffers(ops.size());
+  auto emit = [&](size_t index) {
+    llvm::raw_string_ostream bufferStream(buffers[index]);
+    VerilogEmitterState state(bufferStream);
+    state.options = options;
+    state.instantiatedModules = &instantiatedModules;
+    emitOperation(state, ops[index]);
+    if (state.encounteredError)
+      encounteredError = true;
+  };
+  auto *context = rootOp.getContext();
+  if (context->isMultithreadingEnabled()) {
+    // Keep the diagnostics of the operations in order.
+    mlir::ParallelDiagnosticHandler diagHandler(context);
+    llvm::parallelForEachN(0, ops.size(), [&](size_t index) {
+      diagHandler.setOrderIDForThread(index);
+      emit(index);
+      diagHandler.eraseOrderIDForThread();
+    });
+  } else {
+    for (size_t i = 0, e = ops.size(); i != e; ++i)
+      emit(i);
+  }
 
-  // Emit the separate files.
-  for (const auto &it : files) {
-    state.os << "\n// ----- 8< ----- FILE \"" << it.first
-             << "\" ----- 8< -----\n\n";
-    emitFile(it.second, state);
+  // Concatenate the buffers in order.
+  auto fileStart = fileStarts.begin();
+  for (size_t i = 0, e = ops.size(); i <= e; ++i) {
+    for (; fileStart != fileStarts.end() && fileStart->first == i; ++fileStart)
+      os << "\n// ----- 8< ----- FILE \"" << fileStart->second
+         << "\" ----- 8< -----\n\n";
+    if (i != e)
+      os << buffers[i];
   }
 }
 
@@ -3548,19 +3870,76 @@ void UnifiedEmitter::emitMLIRModule() {
 // Split Emitter
 //===----------------------------------------------------------------------===//
 
+namespace {
+/// A stream handing its buffer to a callback whenever the buffer fills up.
+class ChunkedCallbackStream : public raw_ostream {
+public:
+  ChunkedCallbackStream(function_ref<void(StringRef)> callback,
+                        size_t chunkSize)
+      : callback(callback) {
+    SetBufferSize(chunkSize);
+  }
+  ~ChunkedCallbackStream() override { flush(); }
+
+private:
+  void write_impl(const char *ptr, size_t size) override {
+    position += size;
+    callback(StringRef(ptr, size));
+  }
+
+  uint64_t current_pos() const override { return position; }
+
+  function_ref<void(StringRef)> callback;
+  uint64_t position = 0;
+};
+} // namespace
+
 namespace {
 
 /// A Verilog emitter that separates modules into individual output files.
+/// Modules are prepared right before the file they are emitted into is
+/// written, rather than all up front, so that preparation runs in parallel with
+/// the emission of other files.
 struct SplitEmitter : public RootEmitterBase {
-  explicit SplitEmitter(StringRef dirname, ModuleOp rootOp)
-      : RootEmitterBase(rootOp), dirname(dirname) {}
+  explicit SplitEmitter(StringRef dirname, ModuleOp rootOp,
+                        bool releaseModules, bool incremental)
+      : RootEmitterBase(rootOp), dirname(dirname),
+        releaseModules(releaseModules), incremental(incremental) {}
 
   /// The directory to emit files into.
   StringRef dirname;
 
+  /// Whether to drop the body of each module once its file has been written.
+  bool releaseModules;
+
+  /// Whether to leave the files whose contents didn't change since the
+  /// previous run untouched.
+  bool incremental;
+
+  /// The content hashes recorded by the previous run, by file name.
+  llvm::StringMap<std::string> previousHashes;
+
+  /// The cache to copy the unchanged files from, if any.
+  const SplitVerilogCache *cache = nullptr;
+
+  /// The number of files copied from the cache.
+  std::atomic<size_t> cachedFiles = {};
+
+  /// The modules containing instances bound by an `sv.bind`.  These are
+  /// prepared before any file is written, since the bind files look into
+  /// them, and they are never released.
+  SmallPtrSet<Operation *, 8> boundParents;
+
   void emitMLIRModule();
+  void getOutputPath(Identifier fileName, SmallVectorImpl<char> &path);
+  void createOutputDirectories();
+  void computeCacheKeys(const LoweringOptions &options,
+                        ArrayRef<std::pair<Identifier, FileInfo *>> fileList);
+  void emitFiles(const LoweringOptions &options,
+                 ArrayRef<std::pair<Identifier, FileInfo *>> fileList);
   void createFile(const LoweringOptions &options, Identifier fileName,
                   FileInfo &file);
+  void releaseModule(HWModuleOp module);
 };
 
 } // namespace
@@ -3568,35 +3947,253 @@ struct SplitEmitter : public RootEmitterBase {
 void SplitEmitter::emitMLIRModule() {
   gatherFiles(true);
 
-  // Load any emitter options from the top-level module.
-  LoweringOptions options(rootOp);
+  // Create the name table of every module now, so that the modules can be
+  // prepared concurrently without modifying the map.
+  for (auto op : rootOp.getBody()->getOps<HWModuleOp>())
+    legalizedNames[op];
+
+  // Binds look up their instance through the whole design and emit the ports
+  // prepared in the parent module, so the files containing them are emitted
+  // first, before any module is released.
+  SmallPtrSet<Operation *, 8> bindContainers;
+  SmallVector<HWModuleOp> parentsToPrepare;
+  rootOp.walk([&](BindOp bind) {
+    Operation *container = bind;
+    while (container->getParentOp() != rootOp)
+      container = container->getParentOp();
+    bindContainers.insert(container);
+
+    if (auto inst = bind.getReferencedInstance())
+      if (auto parent = inst->getParentOfType<HWModuleOp>())
+        if (boundParents.insert(parent).second)
+          parentsToPrepare.push_back(parent);
+  });
 
-  // Emit operations to separate files in parallel if enabled.
-  if (rootOp.getContext()->isMultithreadingEnabled())
-    llvm::parallelForEach(files.begin(), files.end(), [&](auto &it) {
-      createFile(options, it.first, it.second);
+  SmallVector<std::pair<Identifier, FileInfo *>> bindFiles, otherFiles;
+  for (auto &it : files) {
+    bool hasBind = llvm::any_of(it.second.ops, [&](const OpFileInfo &info) {
+      return bindContainers.count(info.op);
     });
+    (hasBind ? bindFiles : otherFiles).push_back({it.first, &it.second});
+  }
+
+  // The keys cover the IR handed to the emitter, so they are computed before
+  // any module is prepared.
+  if (cache)
+    computeCacheKeys(options, otherFiles);
+  for (auto parent : parentsToPrepare)
+    prepareModule(parent);
+
+  createOutputDirectories();
+  emitFiles(options, bindFiles);
+  emitFiles(options, otherFiles);
+}
+
+/// Determine the output path of a file from the output directory and the file
+/// name.
+void SplitEmitter::getOutputPath(Identifier fileName,
+                                 SmallVectorImpl<char> &path) {
+  path.assign(dirname.begin(), dirname.end());
+  appendPossiblyAbsolutePath(path, fileName.strref());
+}
+
+/// Create the directories of all output files once, up front, rather than
+/// asking the file system again for each of the files sharing a directory.
+void SplitEmitter::createOutputDirectories() {
+  llvm::StringSet<> outputDirs;
+  for (auto &it : files) {
+    SmallString<128> outputFilename;
+    getOutputPath(it.first, outputFilename);
+    auto outputDir = llvm::sys::path::parent_path(outputFilename);
+    if (!outputDirs.insert(outputDir).second)
+      continue;
+
+    std::error_code error = llvm::sys::fs::create_directory(outputDir);
+    if (error) {
+      mlir::emitError(it.second.ops[0].op->getLoc(),
+                      "cannot create output directory \"" + outputDir +
+                          "\": " + error.message());
+      encounteredError = true;
+    }
+  }
+}
+
+/// Compute the cache key of each file, in parallel if enabled.  The key covers
+/// everything the emitted contents depend on: the operations of the file and
+/// the attributes of the modules instantiated in them, which hold their ports
+/// and Verilog names.
+void SplitEmitter::computeCacheKeys(
+    const LoweringOptions &options,
+    ArrayRef<std::pair<Identifier, FileInfo *>> fileList) {
+  auto optionsString = options.toString();
+  auto computeKey = [&](const std::pair<Identifier, FileInfo *> &it) {
+    llvm::MD5 hash;
+    auto update = [&](StringRef data) {
+      hash.update(data);
+      hash.update(StringRef("\0", 1));
+    };
+    update(cache->salt);
+    update(optionsString);
+    update(it.first.strref());
+
+    SmallVector<Operation *> ops;
+    collectOperations(*it.second, ops);
+    auto hashChunk = [&](StringRef chunk) { hash.update(chunk); };
+    {
+      ChunkedCallbackStream os(hashChunk, 1 << 16);
+      auto flags = OpPrintingFlags().enableDebugInfo().useLocalScope();
+      llvm::SetVector<Operation *> instantiated;
+      for (auto *op : ops) {
+        op->print(os, flags);
+        op->walk([&](InstanceOp inst) {
+          instantiated.insert(instantiatedModules.lookup(inst).module);
+        });
+      }
+      for (auto *module : instantiated) {
+        os << module->getName() << ' ';
+        module->getAttrDictionary().print(os);
+      }
+    }
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    it.second->cacheKey = result.digest();
+  };
+  if (rootOp.getContext()->isMultithreadingEnabled())
+    llvm::parallelForEach(fileList.begin(), fileList.end(), computeKey);
   else
-    for (auto &it : files)
-      createFile(options, it.first, it.second);
+    llvm::for_each(fileList, computeKey);
+}
+
+/// Return the path of the cache entry of the given key.  The prefix lets
+/// LLVM's cache pruning recognize the entries.
+static void getCacheEntryPath(const SplitVerilogCache &cache, StringRef key,
+                              SmallVectorImpl<char> &path) {
+  path.assign(cache.directory.begin(), cache.directory.end());
+  llvm::sys::path::append(path, Twine("llvmcache-") + key);
+}
+
+/// Read the cache entry of the given key into \p contents, and mark it as
+/// recently used, so that it is pruned last.  Return false if there is no
+/// such entry.
+static bool readCacheEntry(const SplitVerilogCache &cache, StringRef key,
+                           std::string &contents) {
+  SmallString<128> path;
+  getCacheEntryPath(cache, key, path);
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return false;
+  contents = (*buffer)->getBuffer().str();
+
+  int fd;
+  if (!llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::CD_OpenExisting,
+                                       llvm::sys::fs::OF_Append)) {
+    auto now = std::chrono::system_clock::now();
+    (void)llvm::sys::fs::setLastAccessAndModificationTime(fd, now, now);
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+  return true;
+}
+
+/// Add an emitted file to the cache.  The entry is written to a temporary file
+/// first, so that concurrent runs never see a partial entry.  Failing to write
+/// the cache isn't an error.
+static void writeCacheEntry(const SplitVerilogCache &cache, StringRef key,
+                            StringRef contents) {
+  SmallString<128> path, tempPath;
+  getCacheEntryPath(cache, key, path);
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(Twine(path) + "-%%%%%%%%", fd, tempPath))
+    return;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << contents;
+  }
+  if (llvm::sys::fs::rename(tempPath, path))
+    llvm::sys::fs::remove(tempPath);
+}
+
+/// Emit a list of files, in parallel if enabled.
+void SplitEmitter::emitFiles(
+    const LoweringOptions &options,
+    ArrayRef<std::pair<Identifier, FileInfo *>> fileList) {
+  auto emit = [&](const std::pair<Identifier, FileInfo *> &it) {
+    createFile(options, it.first, *it.second);
+  };
+  if (rootOp.getContext()->isMultithreadingEnabled())
+    llvm::parallelForEach(fileList.begin(), fileList.end(), emit);
+  else
+    llvm::for_each(fileList, emit);
+}
+
+/// Drop the body of a module whose file has been written, leaving only the
+/// terminator behind.  The module is no longer valid afterwards.
+void SplitEmitter::releaseModule(HWModuleOp module) {
+  auto *body = module.getBodyBlock();
+  auto *terminator = body->getTerminator();
+  body->dropAllReferences();
+  for (auto &op : llvm::make_early_inc_range(llvm::reverse(*body)))
+    if (&op != terminator)
+      op.erase();
+  legalizedNames.find(module)->second = ModuleNameManager();
 }
 
 void SplitEmitter::createFile(const LoweringOptions &options,
                               Identifier fileName, FileInfo &file) {
-  // Determine the output path from the output directory and filename.
-  SmallString<128> outputFilename(dirname);
-  appendPossiblyAbsolutePath(outputFilename, fileName.strref());
-  auto outputDir = llvm::sys::path::parent_path(outputFilename);
-
-  // Create the output directory if needed.
-  std::error_code error = llvm::sys::fs::create_directory(outputDir);
-  if (error) {
-    mlir::emitError(file.ops[0].op->getLoc(),
-                    "cannot create output directory \"" + outputDir +
-                        "\": " + error.message());
-    encounteredError = true;
+  // Copy the file from the cache if an earlier run emitted the same one.
+  std::string contents;
+  if (!file.cacheKey.empty() &&
+      readCacheEntry(*cache, file.cacheKey, contents)) {
+    ++cachedFiles;
+  } else {
+    // Prepare the modules in the file, unless a bind already needed them.
+    for (auto &info : file.ops)
+      if (auto module = dyn_cast<HWModuleOp>(info.op))
+        if (!boundParents.count(module))
+          prepareModule(module);
+
+    // Emit the file into memory, copying the global options into the
+    // individual module state.  The file is then written out in one large
+    // block, since many small writes are slow on network file systems.
+    llvm::raw_string_ostream contentsStream(contents);
+    VerilogEmitterState state(contentsStream);
+    state.options = options;
+    state.instantiatedModules = &instantiatedModules;
+    emitFile(file, state);
+    contentsStream.flush();
+
+    if (!file.cacheKey.empty() && !state.encounteredError)
+      writeCacheEntry(*cache, file.cacheKey, contents);
   }
 
+  SmallString<128> outputFilename;
+  getOutputPath(fileName, outputFilename);
+
+  // Leave the file alone if the previous run wrote the same contents, so that
+  // downstream builds don't see it as modified.
+  bool unchanged = false;
+  if (incremental) {
+    llvm::MD5 hash;
+    hash.update(contents);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    file.contentHash = result.digest();
+
+    auto it = previousHashes.find(fileName.strref());
+    unchanged = it != previousHashes.end() &&
+                it->second == file.contentHash.str() &&
+                llvm::sys::fs::exists(outputFilename);
+  }
+
+  if (releaseModules)
+    for (auto &info : file.ops)
+      if (auto module = dyn_cast<HWModuleOp>(info.op))
+        if (!boundParents.count(module))
+          releaseModule(module);
+
+  if (unchanged)
+    return;
+
   // Open the output file.
   std::string errorMessage;
   auto output = mlir::openOutputFile(outputFilename, &errorMessage);
@@ -3606,11 +4203,7 @@ void SplitEmitter::createFile(const LoweringOptions &options,
     return;
   }
 
-  // Emit the file, copying the global options into the individual module
-  // state.
-  VerilogEmitterState state(output->os());
-  state.options = options;
-  emitFile(file, state);
+  output->os() << contents;
   output->keep();
 }
 
@@ -3618,19 +4211,85 @@ void SplitEmitter::createFile(const LoweringOptions &options,
 // MLIRModuleEmitter
 //===----------------------------------------------------------------------===//
 
-LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os) {
+LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os,
+                                   mlir::TimingScope *ts,
+                                   ExportVerilogStatistics *statistics) {
+  mlir::TimingScope defaultScope;
+  auto &scope = ts ? *ts : defaultScope;
+
   UnifiedEmitter emitter(os, module);
-  emitter.prepareAllModules();
-  emitter.emitMLIRModule();
+  emitter.statistics = statistics;
+  {
+    auto prepareTimer = scope.nest("Prepare Modules");
+    emitter.prepareAllModules();
+  }
+  {
+    auto emitTimer = scope.nest("Emit Modules");
+    emitter.emitMLIRModule();
+  }
+  emitter.sortStatistics();
   return failure(emitter.encounteredError);
 }
 
-LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname) {
-  SplitEmitter emitter(dirname, module);
-  emitter.prepareAllModules();
-  emitter.emitMLIRModule();
+LogicalResult circt::exportVerilog(ModuleOp module,
+                                   function_ref<void(StringRef)> callback,
+                                   size_t chunkSize, mlir::TimingScope *ts,
+                                   ExportVerilogStatistics *statistics) {
+  ChunkedCallbackStream os(callback, chunkSize);
+  return exportVerilog(module, os, ts, statistics);
+}
+
+/// Read the content hashes recorded next to the file list by a previous
+/// incremental run.  Each line holds a hash and a file name.  A missing or
+/// unreadable manifest simply means that every file is written.
+static void readHashManifest(StringRef path,
+                             llvm::StringMap<std::string> &hashes) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return;
+
+  SmallVector<StringRef> lines;
+  (*buffer)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  for (auto line : lines) {
+    auto hashAndName = line.split(' ');
+    if (!hashAndName.second.empty())
+      hashes[hashAndName.second] = hashAndName.first.str();
+  }
+}
+
+LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname,
+                                        bool releaseModules, bool incremental,
+                                        mlir::TimingScope *ts,
+                                        ExportVerilogStatistics *statistics,
+                                        const SplitVerilogCache *cache) {
+  mlir::TimingScope defaultScope;
+  auto &scope = ts ? *ts : defaultScope;
+
+  SplitEmitter emitter(dirname, module, releaseModules, incremental);
+  emitter.statistics = statistics;
+
+  // A cache directory which cannot be created is simply not used.
+  if (cache && !llvm::sys::fs::create_directories(cache->directory))
+    emitter.cache = cache;
+
+  SmallString<128> manifestPath(dirname);
+  llvm::sys::path::append(manifestPath, "filelist.md5");
+  if (incremental)
+    readHashManifest(manifestPath, emitter.previousHashes);
+
+  {
+    // Modules are prepared as their files are emitted, so both are timed
+    // together.
+    auto emitTimer = scope.nest("Emit Files");
+    emitter.emitMLIRModule();
+  }
+  emitter.sortStatistics();
+  if (statistics)
+    statistics->cachedFiles = emitter.cachedFiles;
 
   // Write the file list.
+  auto filelistTimer = scope.nest("Write File List");
   SmallString<128> filelistPath(dirname);
   llvm::sys::path::append(filelistPath, "filelist.f");
 
@@ -3647,6 +4306,19 @@ LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname) {
   }
   output->keep();
 
+  // Record the content hashes for the next incremental run.
+  if (incremental) {
+    auto manifest = mlir::openOutputFile(manifestPath, &errorMessage);
+    if (!manifest) {
+      module->emitError(errorMessage);
+      return failure();
+    }
+    for (const auto &it : emitter.files)
+      if (!it.second.contentHash.empty())
+        manifest->os() << it.second.contentHash << " " << it.first << "\n";
+    manifest->keep();
+  }
+
   return failure(emitter.encounteredError);
 }
 
@@ -0,0 +1,55 @@
+// RUN: circt-opt -lower-firrtl-to-hw='group-debug-statements=true' %s | FileCheck %s
+
+firrtl.circuit "Debug" {
+  // CHECK-LABEL: hw.module @Debug
+  firrtl.module @Debug(in %clock: !firrtl.clock, in %reset: !firrtl.uint<1>,
+                       in %en: !firrtl.uint<1>, in %a: !firrtl.uint<4>,
+                       in %cond: !firrtl.uint<1>) {
+    %c1_ui1 = firrtl.constant 1 : !firrtl.uint<1>
+
+    // The consecutive prints check `PRINTF_COND_ once, and the ones with the
+    // same condition share the check of it.
+    // CHECK:      sv.always posedge %clock {
+    // CHECK-NEXT:   sv.ifdef.procedural "SYNTHESIS" {
+    // CHECK-NEXT:   } else {
+    // CHECK-NEXT:     %PRINTF_COND_ = sv.verbatim.expr "`PRINTF_COND_" : () -> i1
+    // CHECK-NEXT:     sv.if %PRINTF_COND_ {
+    // CHECK-NEXT:       sv.if %reset {
+    // CHECK-NEXT:         sv.fwrite "a\0A"
+    // CHECK-NEXT:         sv.fwrite "b %x\0A"(%a) : i4
+    // CHECK-NEXT:       }
+    // CHECK-NEXT:       sv.if %en {
+    // CHECK-NEXT:         sv.fwrite "c\0A"
+    // CHECK-NEXT:       }
+    // CHECK-NEXT:     }
+    // CHECK-NEXT:     %STOP_COND_ = sv.verbatim.expr "`STOP_COND_" : () -> i1
+    // CHECK-NEXT:     sv.if %STOP_COND_ {
+    // CHECK-NEXT:       sv.if %reset {
+    // CHECK-NEXT:         sv.fatal
+    // CHECK-NEXT:         sv.finish
+    // CHECK-NEXT:       }
+    // CHECK-NEXT:     }
+    // CHECK-NEXT:   }
+    firrtl.printf %clock, %reset, "a\0A"
+    firrtl.printf %clock, %reset, "b %x\0A"(%a) : !firrtl.uint<4>
+    firrtl.printf %clock, %en, "c\0A"
+    firrtl.stop %clock, %reset, 1
+    firrtl.stop %clock, %reset, 0
+
+    // A verification statement in between keeps the order, and a print which
+    // is always enabled only checks `PRINTF_COND_.
+    // CHECK-NEXT:   sv.if %en {
+    // CHECK-NEXT:     sv.assert %cond : i1
+    // CHECK-NEXT:   }
+    // CHECK-NEXT:   sv.ifdef.procedural "SYNTHESIS" {
+    // CHECK-NEXT:   } else {
+    // CHECK-NEXT:     %PRINTF_COND__0 = sv.verbatim.expr "`PRINTF_COND_" : () -> i1
+    // CHECK-NEXT:     sv.if %PRINTF_COND__0 {
+    // CHECK-NEXT:       sv.fwrite "d\0A"
+    // CHECK-NEXT:     }
+    // CHECK-NEXT:   }
+    // CHECK-NEXT: }
+    firrtl.assert %clock, %cond, %en, "assert0"
+    firrtl.printf %clock, %c1_ui1, "d\0A"
+  }
+}
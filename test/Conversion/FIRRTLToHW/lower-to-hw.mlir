@@ -706,6 +706,35 @@ firrtl.circuit "Simple" {
     firrtl.connect %fldout, %2 : !firrtl.uint<64>, !firrtl.uint<64>
   }
 
+  // Bundles kept intact by type lowering are connected as a whole.
+  // CHECK-LABEL: hw.module @StructConnect(%source: !hw.struct<a: i1, b: i2>) -> (%sink: !hw.struct<a: i1, b: i2>) {
+  // CHECK:    %w = sv.wire
+  // CHECK:    sv.assign %w, %source : !hw.struct<a: i1, b: i2>
+  // CHECK:    hw.output
+  firrtl.module @StructConnect(in %source: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                               out %sink: !firrtl.bundle<a: uint<1>, b: uint<2>>) {
+    %w = firrtl.wire : !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %w, %source : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %sink, %w : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+  }
+
+  // Registers of bundles kept intact by type lowering hold a struct, which is
+  // randomly initialized as a whole.
+  // CHECK-LABEL: hw.module @StructReg
+  firrtl.module @StructReg(in %clock: !firrtl.clock,
+                           in %source: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                           out %sink: !firrtl.bundle<a: uint<1>, b: uint<2>>) {
+    // CHECK: %r = sv.reg : !hw.inout<{{.*}}struct<a: i1, b: i2>>
+    // CHECK: %RANDOM = sv.verbatim.expr.se "`RANDOM" : () -> i32
+    // CHECK-NEXT: [[BITS:%.+]] = comb.extract %RANDOM from 0 : (i32) -> i3
+    // CHECK-NEXT: [[RAND:%.+]] = hw.bitcast [[BITS]] : (i3) -> !hw.struct<a: i1, b: i2>
+    // CHECK-NEXT: sv.bpassign %r, [[RAND]] : !hw.struct<a: i1, b: i2>
+    // CHECK: sv.passign %r, %source : !hw.struct<a: i1, b: i2>
+    %r = firrtl.reg %clock {name = "r"} : (!firrtl.clock) -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %r, %source : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %sink, %r : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+  }
+
   // CHECK-LABEL: IsInvalidIssue572
   // https://github.com/llvm/circt/issues/572
   firrtl.module @IsInvalidIssue572(in %a: !firrtl.analog<1>) {
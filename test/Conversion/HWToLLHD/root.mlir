@@ -0,0 +1,30 @@
+// RUN: circt-opt --convert-hw-to-llhd=root=Top --verify-diagnostics %s | FileCheck %s
+
+// Only the modules instantiated below the root are converted, the others are
+// erased.
+module {
+  // CHECK-NOT: @Unused
+  hw.module @Unused(%in: i1) -> (%out: i1) {
+    hw.output %in : i1
+  }
+
+  // CHECK-LABEL: llhd.entity @Leaf
+  hw.module @Leaf(%in: i1) -> (%out: i1) {
+    hw.output %in : i1
+  }
+
+  // CHECK-LABEL: llhd.entity @Mid
+  // CHECK: llhd.inst "leaf" @Leaf
+  hw.module @Mid(%in: i1) -> (%out: i1) {
+    %0 = hw.instance "leaf" @Leaf (%in) : (i1) -> i1
+    hw.output %0 : i1
+  }
+
+  // CHECK-LABEL: llhd.entity @Top
+  // CHECK: llhd.inst "mid" @Mid
+  hw.module @Top(%in: i1) -> (%out: i1) {
+    %0 = hw.instance "mid" @Mid (%in) : (i1) -> i1
+    hw.output %0 : i1
+  }
+  // CHECK-NOT: @Unused
+}
@@ -0,0 +1,44 @@
+// RUN: circt-opt -lower-handshake-to-firrtl="pipeline-ops=merge,fork pipeline-stages=2" %s | FileCheck %s
+// RUN: circt-opt -lower-handshake-to-firrtl %s | FileCheck %s --check-prefix=DEFAULT
+// RUN: not circt-opt -lower-handshake-to-firrtl="pipeline-ops=mux" %s 2>&1 | FileCheck %s --check-prefix=ERROR
+
+// The merge gets a clock and a reset for its buffer stages, and its logic
+// drives wires which are registered before the output port.
+
+// CHECK-LABEL: firrtl.module @handshake_merge_2ins_1outs_ui64_2stages(
+// CHECK-SAME:  out %arg2: !firrtl.bundle<valid: uint<1>, ready flip: uint<1>, data: uint<64>>,
+// CHECK-SAME:  in %clock: !firrtl.clock, in %reset: !firrtl.uint<1>) {
+// CHECK:   %out0Valid = firrtl.wire : !firrtl.uint<1>
+// CHECK:   %out0Ready = firrtl.wire : !firrtl.uint<1>
+// CHECK:   %out0Data = firrtl.wire : !firrtl.uint<64>
+// CHECK:   firrtl.connect %out0Valid, %{{.+}}
+// CHECK:   %validReg0 = firrtl.regreset %clock, %reset
+// CHECK:   %dataReg0 = firrtl.regreset %clock, %reset
+// CHECK:   %validReg1 = firrtl.regreset %clock, %reset
+// CHECK:   %dataReg1 = firrtl.regreset %clock, %reset
+// CHECK-NOT: %validReg2
+
+// The fork already has a clock, each of its outputs is buffered.
+
+// CHECK-LABEL: firrtl.module @handshake_fork_1ins_2outs_ctrl_2stages(
+// CHECK:   %out0Valid = firrtl.wire : !firrtl.uint<1>
+// CHECK:   %out1Valid = firrtl.wire : !firrtl.uint<1>
+// CHECK:   %validReg0 = firrtl.regreset %clock, %reset
+// CHECK:   %validReg0{{.+}} = firrtl.regreset %clock, %reset
+
+// CHECK-LABEL: firrtl.module @test_pipeline_ops(
+// CHECK:   firrtl.instance @handshake_merge_2ins_1outs_ui64_2stages
+// CHECK:   firrtl.connect %{{.+}}, %clock : !firrtl.clock, !firrtl.clock
+// CHECK:   firrtl.instance @handshake_fork_1ins_2outs_ctrl_2stages
+
+// DEFAULT-LABEL: firrtl.module @handshake_merge_2ins_1outs_ui64(
+// DEFAULT-NOT:   validReg
+// DEFAULT-LABEL: firrtl.module @handshake_fork_1ins_2outs_ctrl(
+
+// ERROR: Unknown pipelined operation: mux
+
+handshake.func @test_pipeline_ops(%arg0: index, %arg1: index, %arg2: none, ...) -> (index, none, none) {
+  %0 = "handshake.merge"(%arg0, %arg1) : (index, index) -> index
+  %1:2 = "handshake.fork"(%arg2) {control = true} : (none) -> (none, none)
+  handshake.return %0, %1#0, %1#1 : index, none, none
+}
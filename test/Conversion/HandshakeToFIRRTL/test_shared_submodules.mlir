@@ -0,0 +1,27 @@
+// RUN: circt-opt -lower-handshake-to-firrtl %s | FileCheck %s
+
+// Every circuit holds the sub-modules it instantiates, also when they were
+// generated for an earlier function.
+
+// CHECK-LABEL: firrtl.circuit "first"
+// CHECK:       firrtl.module @handshake_sink_1ins_0outs_ui64(
+// CHECK:         firrtl.connect %0, %c1_ui1 : !firrtl.uint<1>, !firrtl.uint<1>
+// CHECK:       firrtl.module @first(
+// CHECK:         firrtl.instance @handshake_sink_1ins_0outs_ui64
+// CHECK:         firrtl.instance @handshake_sink_1ins_0outs_ui64
+handshake.func @first(%arg0: index, %arg1: index, %arg2: none, ...) -> (none) {
+  "handshake.sink"(%arg0) : (index) -> ()
+  "handshake.sink"(%arg1) : (index) -> ()
+  handshake.return %arg2 : none
+}
+
+// CHECK-LABEL: firrtl.circuit "second"
+// CHECK:       firrtl.module @handshake_sink_1ins_0outs_ui64(
+// CHECK:         firrtl.connect %0, %c1_ui1 : !firrtl.uint<1>, !firrtl.uint<1>
+// CHECK-NOT:   firrtl.module @handshake_sink_1ins_0outs_ui64(
+// CHECK:       firrtl.module @second(
+// CHECK:         firrtl.instance @handshake_sink_1ins_0outs_ui64
+handshake.func @second(%arg0: index, %arg1: none, ...) -> (none) {
+  "handshake.sink"(%arg0) : (index) -> ()
+  handshake.return %arg1 : none
+}
@@ -0,0 +1,48 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm=arena | FileCheck %s
+
+// CHECK-NOT: @malloc
+// CHECK: llvm.func @allocArena(!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+
+// The offset of each allocation and the size of the arena are computed before
+// the arena is allocated, each allocation being rounded up to 16 bytes.
+// CHECK-LABEL: llvm.func @llhd_init(
+// CHECK-SAME:  %[[STATE:.*]]: !llvm.ptr<i8>) {
+// CHECK:         %[[OFFSET0:.*]] = llvm.mlir.constant(0 : i64) : i64
+// CHECK:         %[[SIZE0:.*]] = llvm.ptrtoint %{{.*}} : !llvm.ptr<struct<()>> to i64
+// CHECK:         %[[END0:.*]] = llvm.add %[[OFFSET0]], %[[SIZE0]] : i64
+// CHECK:         %[[MASK0:.*]] = llvm.mlir.constant(15 : i64) : i64
+// CHECK:         %[[ROUND0:.*]] = llvm.add %[[END0]], %[[MASK0]] : i64
+// CHECK:         %[[ALIGN0:.*]] = llvm.mlir.constant(-16 : i64) : i64
+// CHECK:         %[[OFFSET1:.*]] = llvm.and %[[ROUND0]], %[[ALIGN0]] : i64
+// The signal values are allocated twice.
+// CHECK:         %[[SIGSIZE:.*]] = llvm.ptrtoint %{{.*}} : !llvm.ptr<i1> to i64
+// CHECK:         %[[TWO:.*]] = llvm.mlir.constant(2 : i64) : i64
+// CHECK:         %[[SIZE1:.*]] = llvm.mul %[[SIGSIZE]], %[[TWO]] : i64
+// CHECK:         llvm.add %[[OFFSET1]], %[[SIZE1]] : i64
+// CHECK:         %[[OFFSET2:.*]] = llvm.and
+// CHECK:         %[[OFFSET3:.*]] = llvm.and
+// CHECK:         %[[END:.*]] = llvm.and
+// CHECK:         %[[ARENA:.*]] = llvm.call @allocArena(%[[STATE]], %[[END]]) : (!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// CHECK-NOT:     @malloc
+// CHECK:         llvm.getelementptr %[[ARENA]]{{\[}}%[[OFFSET0]]] : (!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// CHECK:         llvm.call @allocEntity
+// CHECK:         llvm.getelementptr %[[ARENA]]{{\[}}%[[OFFSET1]]] : (!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// CHECK:         llvm.call @allocSignal
+// CHECK:         llvm.getelementptr %[[ARENA]]{{\[}}%[[OFFSET2]]] : (!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// CHECK:         llvm.getelementptr %[[ARENA]]{{\[}}%[[OFFSET3]]] : (!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// CHECK:         llvm.call @allocProc
+// CHECK-NEXT:    llvm.return
+
+llhd.entity @root () -> () {
+  llhd.inst "child" @child () -> () : () -> ()
+  llhd.inst "proc" @proc () -> () : () -> ()
+}
+
+llhd.entity @child () -> () {
+  %0 = llhd.const 1 : i1
+  %s = llhd.sig "s" %0 : i1
+}
+
+llhd.proc @proc () -> () {
+  llhd.halt
+}
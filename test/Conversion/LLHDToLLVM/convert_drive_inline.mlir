@@ -0,0 +1,44 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm=inline-drives | FileCheck %s
+
+// CHECK-LABEL: llvm.func @getDriveBuffer(!llvm.ptr<i8>) -> !llvm.ptr<struct<(i64, i64, ptr<struct<(ptr<struct<(ptr<i8>, i64, i64, i64)>>, i64, i64, i64, i64, i64)>>)>>
+// CHECK-SAME: passthrough = ["readnone", "nounwind"]
+
+// CHECK-LABEL: llvm.func @drive_narrow(
+// CHECK-SAME: %[[STATE:.*]]: !llvm.ptr<i8>,
+// CHECK:   %[[BUFFER:.*]] = llvm.call @getDriveBuffer(%[[STATE]])
+// CHECK:   %[[SIZE:.*]] = llvm.load %{{.*}} : !llvm.ptr<i64>
+// CHECK:   %[[CAPACITY:.*]] = llvm.load %{{.*}} : !llvm.ptr<i64>
+// CHECK:   %[[FULL:.*]] = llvm.icmp "uge" %[[SIZE]], %[[CAPACITY]] : i64
+// CHECK:   llvm.cond_br %[[FULL]], ^[[SLOW:bb[0-9]+]], ^[[FAST:bb[0-9]+]]
+// CHECK: ^[[FAST]]:
+// CHECK:   %[[VALUE:.*]] = llvm.zext %{{.*}} : i8 to i64
+// CHECK:   llvm.store %[[VALUE]], %{{.*}} : !llvm.ptr<i64>
+// CHECK:   %[[NEXT:.*]] = llvm.add %[[SIZE]], %{{.*}} : i64
+// CHECK:   llvm.store %[[NEXT]], %{{.*}} : !llvm.ptr<i64>
+// CHECK:   llvm.br ^[[CONTINUE:bb[0-9]+]]
+// CHECK: ^[[SLOW]]:
+// CHECK:   llvm.call @driveSignal
+// CHECK:   llvm.br ^[[CONTINUE]]
+// CHECK: ^[[CONTINUE]]:
+// CHECK:   llvm.return
+llhd.entity @drive_narrow (%s : !llhd.sig<i8>) -> () {
+  %c = llhd.const 5 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i8>
+}
+
+// Drives of aggregates and wide integers always go through the runtime.
+// CHECK-LABEL: llvm.func @drive_wide(
+// CHECK-NOT:   @getDriveBuffer
+// CHECK:       llvm.call @driveSignal
+// CHECK-NOT:   @getDriveBuffer
+// CHECK:       llvm.call @driveSignal
+// CHECK:       llvm.return
+llhd.entity @drive_wide (%s : !llhd.sig<i65>, %a : !llhd.sig<!llhd.array<2xi1>>) -> () {
+  %c = llhd.const 0 : i65
+  %b = llhd.const 0 : i1
+  %arr = llhd.array_uniform %b : !llhd.array<2xi1>
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i65>
+  llhd.drv %a, %arr after %t : !llhd.sig<!llhd.array<2xi1>>
+}
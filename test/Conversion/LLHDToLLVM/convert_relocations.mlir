@@ -0,0 +1,57 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm | FileCheck %s
+// RUN: circt-opt %s --convert-llhd-to-llvm=static-layout | FileCheck %s --check-prefix=LAYOUT
+
+// The persisted signal of the process is the only field to relocate.
+// CHECK-LABEL: llvm.mlir.global internal constant @relocations.proc() : !llvm.array<1 x struct<(i64, i64)>>
+// CHECK:         %[[NULL:.*]] = llvm.mlir.null : !llvm.ptr<struct<(i32, i32, ptr<array<1 x i1>>, struct<(struct<(ptr<i8>, i64, i64, i64)>)>)>>
+// CHECK:         %[[GEP:.*]] = llvm.getelementptr %[[NULL]][%{{.*}}, %{{.*}}, %{{.*}}] : {{.*}} -> !llvm.ptr<struct<(ptr<i8>, i64, i64, i64)>>
+// CHECK:         %[[OFFSET:.*]] = llvm.ptrtoint %[[GEP]] : !llvm.ptr<struct<(ptr<i8>, i64, i64, i64)>> to i64
+// CHECK:         llvm.insertvalue %[[OFFSET]], %{{.*}}[0 : i32] : !llvm.struct<(i64, i64)>
+// CHECK:         %[[KIND:.*]] = llvm.mlir.constant(0 : i64) : i64
+// CHECK:         llvm.insertvalue %[[KIND]], %{{.*}}[1 : i32] : !llvm.struct<(i64, i64)>
+// CHECK:         llvm.return
+// CHECK-NOT:   @relocations.child
+
+// CHECK: llvm.func @allocEntity(!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.ptr<i8>, i64, !llvm.ptr<i8>, i64)
+// CHECK: llvm.func @allocProc(!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.ptr<i8>, i64, !llvm.ptr<i8>, i64)
+
+// The entity state holds no signals, so it has no table.
+// CHECK-LABEL: llvm.func @llhd_init(
+// CHECK:         %[[NOTABLE:.*]] = llvm.mlir.null : !llvm.ptr<i8>
+// CHECK:         %[[NONE:.*]] = llvm.mlir.constant(0 : i64) : i64
+// CHECK:         llvm.call @allocEntity(%{{.*}}, %{{.*}}, %{{.*}}, %{{.*}}, %[[NOTABLE]], %[[NONE]])
+// CHECK:         %[[TABLE:.*]] = llvm.mlir.addressof @relocations.proc
+// CHECK:         %[[TABLEBC:.*]] = llvm.bitcast %[[TABLE]]
+// CHECK:         %[[ONE:.*]] = llvm.mlir.constant(1 : i64) : i64
+// CHECK:         llvm.call @allocProc(%{{.*}}, %{{.*}}, %{{.*}}, %{{.*}}, %[[TABLEBC]], %[[ONE]])
+
+// LAYOUT-LABEL: llvm.mlir.global internal constant @layout.instances() : !llvm.array<2 x struct<(ptr<i8>, i32, i32, i64, ptr<i8>, i64)>>
+// LAYOUT:         llvm.mlir.addressof @instance.root.child
+// LAYOUT:         llvm.mlir.null : !llvm.ptr<i8>
+// LAYOUT:         llvm.mlir.constant(0 : i64) : i64
+// LAYOUT:         llvm.mlir.addressof @instance.root.proc
+// LAYOUT:         llvm.mlir.addressof @relocations.proc
+// LAYOUT:         llvm.mlir.constant(1 : i64) : i64
+// LAYOUT:         llvm.return
+// LAYOUT-LABEL: llvm.mlir.global internal constant @relocations.proc() : !llvm.array<1 x struct<(i64, i64)>>
+
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i32
+  %s = llhd.sig "s" %0 : i32
+  llhd.inst "child" @child () -> () : () -> ()
+  llhd.inst "proc" @proc () -> (%s) : () -> (!llhd.sig<i32>)
+}
+
+llhd.entity @child () -> () {}
+
+func @dummy_subsig(%0 : !llhd.sig<i10>) {
+  return
+}
+
+llhd.proc @proc () -> (%out : !llhd.sig<i32>) {
+  %0 = llhd.extract_slice %out, 0 : !llhd.sig<i32> -> !llhd.sig<i10>
+  br ^resume
+^resume:
+  call @dummy_subsig(%0) : (!llhd.sig<i10>) -> ()
+  br ^resume
+}
@@ -208,3 +208,18 @@ llhd.entity @convert_reg () -> () {
   %2 = llhd.sig "sig" %1: i1
   llhd.reg %2, (%1, "fall" %1 after %0 : i1), (%1, "rise" %1 after %0 : i1), (%1, "low" %1 after %0 : i1), (%1, "high" %1 after %0 : i1), (%1, "both" %1 after %0 : i1) : !llhd.sig<i1>
 }
+
+// The value pointer and offset of a signal are only loaded once per block.
+// CHECK-LABEL:   llvm.func @convert_prb_reuse(
+// CHECK:           %[[PTR:.*]] = llvm.load %{{.*}} : !llvm.ptr<ptr<i8>>
+// CHECK:           %[[OFFSET:.*]] = llvm.load %{{.*}} : !llvm.ptr<i64>
+// CHECK:           llvm.bitcast %[[PTR]] : !llvm.ptr<i8> to !llvm.ptr<i16>
+// CHECK-NOT:       llvm.load %{{.*}} : !llvm.ptr<ptr<i8>>
+// CHECK:           llvm.bitcast %[[PTR]] : !llvm.ptr<i8> to !llvm.ptr<i16>
+// CHECK:           llvm.trunc %[[OFFSET]] : i64 to i16
+// CHECK:           llvm.return
+// CHECK:         }
+llhd.entity @convert_prb_reuse (%sI1 : !llhd.sig<i1>) -> () {
+  %p0 = llhd.prb %sI1 : !llhd.sig<i1>
+  %p1 = llhd.prb %sI1 : !llhd.sig<i1>
+}
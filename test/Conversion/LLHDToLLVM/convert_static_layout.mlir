@@ -0,0 +1,65 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm=static-layout | FileCheck %s
+
+// CHECK: llvm.func @allocLayout(!llvm.ptr<i8>, !llvm.ptr<i8>, i64, !llvm.ptr<i8>, i64, !llvm.ptr<i8>)
+
+// The struct signals have one element row per field.
+// CHECK-LABEL: llvm.mlir.global internal constant @layout.elements() : !llvm.array<4 x struct<(i32, i32)>>
+// CHECK:         llvm.mlir.null : !llvm.ptr<struct<(i1, i8)>>
+// CHECK:         llvm.return
+
+// CHECK-LABEL: llvm.mlir.global internal constant @layout.signals() : !llvm.array<4 x struct<(ptr<i8>, i32, ptr<i8>, i64, i64, i32, i32, i32, i32)>>
+// CHECK:         llvm.mlir.addressof @instance.root.child0
+// CHECK:         llvm.mlir.addressof @init.child.0
+// CHECK:         llvm.mlir.addressof @instance.root.child0
+// CHECK:         llvm.mlir.addressof @init.child.1
+// CHECK:         llvm.mlir.addressof @instance.root.child1
+// CHECK:         llvm.mlir.addressof @init.child.0
+// CHECK:         llvm.mlir.addressof @instance.root.child1
+// CHECK:         llvm.mlir.addressof @init.child.1
+// CHECK:         llvm.return
+
+// CHECK-LABEL: llvm.mlir.global internal constant @layout.instances() : !llvm.array<3 x struct<(ptr<i8>, i32, i32, i64, ptr<i8>, i64)>>
+// CHECK:         llvm.mlir.addressof @instance.root.child0
+// CHECK:         llvm.mlir.addressof @instance.root.child1
+// CHECK:         llvm.mlir.addressof @instance.root.proc
+// CHECK:         llvm.return
+
+// The initial values are cloned once per entity.
+// CHECK-LABEL: llvm.mlir.global internal constant @init.child.1() : !llvm.struct<(i1, i8)>
+// CHECK:         %[[C0:.*]] = llvm.mlir.constant(true) : i1
+// CHECK:         %[[C1:.*]] = llvm.mlir.constant(0 : i8) : i8
+// CHECK:         llvm.insertvalue %[[C0]], %{{.*}}[0 : i32] : !llvm.struct<(i1, i8)>
+// CHECK:         llvm.insertvalue %[[C1]], %{{.*}}[1 : i32] : !llvm.struct<(i1, i8)>
+// CHECK:         llvm.return
+// CHECK-LABEL: llvm.mlir.global internal constant @init.child.0() : i1
+// CHECK:         llvm.mlir.constant(true) : i1
+// CHECK:         llvm.return
+// CHECK-NOT:   @init.child
+
+// The init function only maps the tables.
+// CHECK-LABEL: llvm.func @llhd_init(
+// CHECK-SAME:  %[[STATE:.*]]: !llvm.ptr<i8>) {
+// CHECK-NOT:     llvm.call @malloc
+// CHECK:         llvm.mlir.addressof @layout.instances
+// CHECK:         llvm.mlir.addressof @layout.signals
+// CHECK:         llvm.mlir.addressof @layout.elements
+// CHECK:         llvm.call @allocLayout(%[[STATE]], %{{.*}}, %{{.*}}, %{{.*}}, %{{.*}}, %{{.*}})
+// CHECK-NEXT:    llvm.return
+
+llhd.entity @root () -> () {
+  llhd.inst "child0" @child () -> () : () -> ()
+  llhd.inst "child1" @child () -> () : () -> ()
+  llhd.inst "proc" @proc () -> () : () -> ()
+}
+
+llhd.entity @child () -> () {
+  %0 = llhd.const 1 : i1
+  %s = llhd.sig "s" %0 : i1
+  %1 = llhd.const 0 : i8
+  %2 = llhd.tuple %0, %1 : tuple<i1, i8>
+  %t = llhd.sig "t" %2 : tuple<i1, i8>
+}
+
+llhd.proc @proc () -> () {
+  llhd.halt
+}
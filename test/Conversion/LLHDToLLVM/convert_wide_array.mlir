@@ -0,0 +1,55 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm | FileCheck %s
+
+// Slices of at least eight elements are copied through memory at once.
+
+// CHECK-LABEL: llvm.func @convert_wide_extract_slice(
+// CHECK-SAME:  %[[ARR:.*]]: !llvm.array<16 x i8>) {
+// CHECK:         %[[TARGET:.*]] = llvm.alloca %{{.*}} x !llvm.array<16 x i8>
+// CHECK:         llvm.store %[[ARR]], %[[TARGET]] : !llvm.ptr<array<16 x i8>>
+// CHECK:         %[[SRC:.*]] = llvm.getelementptr %[[TARGET]]{{\[}}%{{.*}}, %{{.*}}] : (!llvm.ptr<array<16 x i8>>, i64, i64) -> !llvm.ptr<i8>
+// CHECK:         %[[SLICE:.*]] = llvm.alloca %{{.*}} x !llvm.array<8 x i8>
+// CHECK:         "llvm.intr.memcpy"
+// CHECK:         llvm.load %[[SLICE]] : !llvm.ptr<array<8 x i8>>
+// CHECK-NOT:     llvm.extractvalue
+// CHECK:         llvm.return
+func @convert_wide_extract_slice(%arr : !llhd.array<16xi8>) {
+  %0 = llhd.extract_slice %arr, 4 : !llhd.array<16xi8> -> !llhd.array<8xi8>
+  return
+}
+
+// The start index is clamped to the length of the target, which is followed
+// by zeros in the copied buffer.
+// CHECK-LABEL: llvm.func @convert_wide_dyn_extract_slice(
+// CHECK-SAME:  %[[ARR:.*]]: !llvm.array<16 x i8>, %[[START:.*]]: i32) {
+// CHECK:         %[[BUFFER:.*]] = llvm.alloca %{{.*}} x !llvm.array<24 x i8>
+// CHECK:         llvm.store %[[ARR]], %{{.*}} : !llvm.ptr<array<16 x i8>>
+// CHECK:         %[[LENGTH:.*]] = llvm.mlir.constant(16 : i64) : i64
+// CHECK:         llvm.getelementptr %[[BUFFER]]{{\[}}%{{.*}}, %[[LENGTH]]]
+// CHECK:         llvm.store %{{.*}}, %{{.*}} : !llvm.ptr<array<8 x i8>>
+// CHECK:         %[[ZEXT:.*]] = llvm.zext %[[START]] : i32 to i64
+// CHECK:         %[[IN_BOUNDS:.*]] = llvm.icmp "ult" %[[ZEXT]], %[[LENGTH]] : i64
+// CHECK:         %[[CLAMPED:.*]] = llvm.select %[[IN_BOUNDS]], %[[ZEXT]], %[[LENGTH]] : i1, i64
+// CHECK:         llvm.getelementptr %[[BUFFER]]{{\[}}%{{.*}}, %[[CLAMPED]]]
+// CHECK:         "llvm.intr.memcpy"
+// CHECK:         llvm.load %{{.*}} : !llvm.ptr<array<8 x i8>>
+// CHECK-NOT:     llvm.cond_br
+// CHECK:         llvm.return
+func @convert_wide_dyn_extract_slice(%arr : !llhd.array<16xi8>, %start : i32) {
+  %0 = llhd.dyn_extract_slice %arr, %start : (!llhd.array<16xi8>, i32) -> !llhd.array<8xi8>
+  return
+}
+
+// CHECK-LABEL: llvm.func @convert_wide_insert_slice(
+// CHECK-SAME:  %[[ARR:.*]]: !llvm.array<16 x i8>, %[[SLICE:.*]]: !llvm.array<8 x i8>) {
+// CHECK:         %[[TARGET:.*]] = llvm.alloca %{{.*}} x !llvm.array<16 x i8>
+// CHECK:         llvm.store %[[ARR]], %[[TARGET]] : !llvm.ptr<array<16 x i8>>
+// CHECK:         %[[DST:.*]] = llvm.getelementptr %[[TARGET]]{{\[}}%{{.*}}, %{{.*}}] : (!llvm.ptr<array<16 x i8>>, i32, i32) -> !llvm.ptr<i8>
+// CHECK:         %[[CAST:.*]] = llvm.bitcast %[[DST]] : !llvm.ptr<i8> to !llvm.ptr<array<8 x i8>>
+// CHECK:         llvm.store %[[SLICE]], %[[CAST]] : !llvm.ptr<array<8 x i8>>
+// CHECK:         llvm.load %[[TARGET]] : !llvm.ptr<array<16 x i8>>
+// CHECK-NOT:     llvm.insertvalue
+// CHECK:         llvm.return
+func @convert_wide_insert_slice(%arr : !llhd.array<16xi8>, %slice : !llhd.array<8xi8>) {
+  %0 = llhd.insert_slice %arr, %slice, 4 : !llhd.array<16xi8>, !llhd.array<8xi8>
+  return
+}
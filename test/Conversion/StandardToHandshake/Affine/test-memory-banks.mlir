@@ -0,0 +1,49 @@
+// RUN: circt-opt %s -split-input-file -create-dataflow="memory-banks=2" | FileCheck %s --check-prefix=CYCLIC
+// RUN: circt-opt %s -split-input-file -create-dataflow="memory-banks=2 memory-banking=block" | FileCheck %s --check-prefix=BLOCK
+// RUN: circt-opt %s -split-input-file -create-dataflow | FileCheck %s --check-prefix=DEFAULT
+
+// The even and odd elements of the unrolled loop go to separate banks with
+// cyclic banking. With block banking, the bank of the accesses depends on
+// the loop, so the memory is kept whole.
+
+// CYCLIC-LABEL: handshake.func @unrolled(
+// CYCLIC-DAG:     "handshake.memory"({{.+}}) {id = {{[0-9]+}} : i32, ld_count = 1 : i32, lsq = false, st_count = 1 : i32, type = memref<4xi32>}
+// CYCLIC-DAG:     "handshake.memory"({{.+}}) {id = {{[0-9]+}} : i32, ld_count = 1 : i32, lsq = false, st_count = 0 : i32, type = memref<4xi32>}
+
+// BLOCK-LABEL: handshake.func @unrolled(
+// BLOCK:         "handshake.memory"({{.+}}) {id = 0 : i32, ld_count = 2 : i32, lsq = false, st_count = 1 : i32, type = memref<8xi32>}
+
+// DEFAULT-LABEL: handshake.func @unrolled(
+// DEFAULT:         type = memref<8xi32>
+
+func @unrolled() {
+  %A = memref.alloc() : memref<8xi32>
+  affine.for %i = 0 to 4 {
+    %0 = affine.load %A[%i * 2] : memref<8xi32>
+    %1 = affine.load %A[%i * 2 + 1] : memref<8xi32>
+    %2 = addi %0, %1 : i32
+    affine.store %2, %A[%i * 2] : memref<8xi32>
+  }
+  return
+}
+
+// -----
+
+// Constant accesses to the two halves of the memory go to separate banks
+// with block banking, and to the same bank with cyclic banking.
+
+// CYCLIC-LABEL: handshake.func @halves(
+// CYCLIC-NOT:     type = memref<8xi32>
+// CYCLIC:         "handshake.memory"({{.+}}) {id = 0 : i32, ld_count = 1 : i32, lsq = false, st_count = 1 : i32, type = memref<4xi32>}
+// CYCLIC-NOT:     "handshake.memory"
+
+// BLOCK-LABEL: handshake.func @halves(
+// BLOCK-DAG:      "handshake.memory"({{.+}}) {id = {{[0-9]+}} : i32, ld_count = 1 : i32, lsq = false, st_count = 0 : i32, type = memref<4xi32>}
+// BLOCK-DAG:      "handshake.memory"({{.+}}) {id = {{[0-9]+}} : i32, ld_count = 0 : i32, lsq = false, st_count = 1 : i32, type = memref<4xi32>}
+
+func @halves() {
+  %A = memref.alloc() : memref<8xi32>
+  %0 = affine.load %A[1] : memref<8xi32>
+  affine.store %0, %A[5] : memref<8xi32>
+  return
+}
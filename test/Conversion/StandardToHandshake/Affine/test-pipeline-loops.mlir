@@ -0,0 +1,36 @@
+// RUN: circt-opt %s -create-dataflow="pipeline-loops=true" | FileCheck %s
+// RUN: circt-opt %s -create-dataflow | FileCheck %s --check-prefix=DEFAULT
+
+// The iterations of the first loop access distinct elements, so their
+// accesses complete in the background: a control-only token merged in the
+// header collects their completion instead of the control of the body.
+
+// CHECK-LABEL: handshake.func @independent(
+// CHECK:         "handshake.mux"(%{{.+}}, %{{.+}}, %{{.+}}) : (index, none, none) -> none
+// CHECK:         handshake.return
+func @independent() {
+  %A = memref.alloc() : memref<10xi32>
+  affine.for %i = 0 to 10 {
+    %0 = affine.load %A[%i] : memref<10xi32>
+    %1 = addi %0, %0 : i32
+    affine.store %1, %A[%i] : memref<10xi32>
+  }
+  return
+}
+
+// Each iteration of the second loop reads the element the previous one
+// wrote, so it still waits for it.
+
+// CHECK-LABEL: handshake.func @carried(
+// CHECK-NOT:     (index, none, none) -> none
+// CHECK:         handshake.return
+func @carried() {
+  %A = memref.alloc() : memref<11xi32>
+  affine.for %i = 0 to 10 {
+    %0 = affine.load %A[%i] : memref<11xi32>
+    affine.store %0, %A[%i + 1] : memref<11xi32>
+  }
+  return
+}
+
+// DEFAULT-NOT: (index, none, none) -> none
@@ -0,0 +1,36 @@
+// RUN: circt-opt -handshake-insert-buffer=strategies=throughput %s | FileCheck %s
+// RUN: circt-opt -handshake-insert-buffer="strategies=throughput target-ii=2" %s | FileCheck %s --check-prefix=II2
+// RUN: circt-opt -handshake-insert-buffer=strategies=profile %s | FileCheck %s --check-prefix=PROFILE
+
+// The direct path from the fork to the second addition is three cycles
+// shorter than the one through the first addition and the casts, and the
+// control token is five cycles ahead of the result.
+
+// CHECK-LABEL: handshake.func @reconverge
+// CHECK:       %[[FORK:.+]]:3 = "handshake.fork"(%arg0)
+// CHECK:       %[[CAST:.+]] = index_cast %{{.+}} : i32 to index
+// CHECK-NEXT:  %[[EARLY:.+]] = "handshake.buffer"(%[[FORK]]#2) {control = false, sequential = false, slots = 3 : i32} : (index) -> index
+// CHECK-NEXT:  %[[SUM:.+]] = addi %[[CAST]], %[[EARLY]] : index
+// CHECK-NEXT:  %[[CTRL:.+]] = "handshake.buffer"(%arg1) {control = true, sequential = false, slots = 5 : i32} : (none) -> none
+// CHECK-NEXT:  handshake.return %[[SUM]], %[[CTRL]] : index, none
+
+// II2: "handshake.buffer"(%{{.+}}#2) {control = false, sequential = false, slots = 2 : i32}
+// II2: "handshake.buffer"(%arg1) {control = true, sequential = false, slots = 3 : i32}
+
+// PROFILE-LABEL: handshake.func @reconverge
+// PROFILE:       %[[FORK:.+]]:3 = "handshake.fork"(%arg0) {control = false} : (index) -> (index, index, index)
+// PROFILE-NEXT:  %[[EARLY:.+]] = "handshake.buffer"(%[[FORK]]#0) {control = false, sequential = false, slots = 3 : i32} : (index) -> index
+// PROFILE-NEXT:  addi %[[EARLY]], %[[FORK]]#1 : index
+// PROFILE-NOT:   perf
+// PROFILE-NOT:   "handshake.buffer"
+
+module {
+  handshake.func @reconverge(%arg0: index, %arg1: none, ...) -> (index, none) {
+    %0:3 = "handshake.fork"(%arg0) {control = false, perf = {blocked = [6, 0, 0], fires = 2, input_wait = 0, tokens = [2, 2, 2], waiting = [0, 0, 0]}} : (index) -> (index, index, index)
+    %1 = addi %0#0, %0#1 {perf = {blocked = [0], fires = 2, input_wait = 0, tokens = [2], waiting = [0]}} : index
+    %2 = index_cast %1 : index to i32
+    %3 = index_cast %2 : i32 to index
+    %4 = addi %3, %0#2 : index
+    handshake.return %4, %arg1 : index, none
+  }
+}
@@ -0,0 +1,62 @@
+// RUN: circt-opt -handshake-optimize %s | FileCheck %s
+
+// CHECK-LABEL: handshake.func @fork_tree(
+// CHECK-SAME:      %[[ARG0:.*]]: none, ...)
+// CHECK-NEXT:    %[[FORK:.*]]:3 = "handshake.fork"(%[[ARG0]]) {control = true} : (none) -> (none, none, none)
+// CHECK-NEXT:    handshake.return %[[FORK]]#0, %[[FORK]]#1, %[[FORK]]#2 : none, none, none
+handshake.func @fork_tree(%arg0: none, ...) -> (none, none, none) {
+  %0:3 = "handshake.fork"(%arg0) {control = true} : (none) -> (none, none, none)
+  %1:2 = "handshake.fork"(%0#1) {control = true} : (none) -> (none, none)
+  "handshake.sink"(%0#2) : (none) -> ()
+  handshake.return %0#0, %1#0, %1#1 : none, none, none
+}
+
+// CHECK-LABEL: handshake.func @dead_ops(
+// CHECK-SAME:      %[[ARG0:.*]]: index, %[[ARG1:.*]]: none, ...)
+// CHECK-NEXT:    "handshake.sink"(%[[ARG0]]) : (index) -> ()
+// CHECK-NEXT:    handshake.return %[[ARG1]] : none
+handshake.func @dead_ops(%arg0: index, %arg1: none, ...) -> none {
+  %0:2 = "handshake.fork"(%arg1) {control = true} : (none) -> (none, none)
+  %1 = "handshake.constant"(%0#0) {value = 42 : index} : (none) -> index
+  %2 = addi %arg0, %1 : index
+  %3 = "handshake.buffer"(%2) {control = false, sequential = true, slots = 2 : i32} : (index) -> index
+  "handshake.sink"(%3) : (index) -> ()
+  handshake.return %0#1 : none
+}
+
+// CHECK-LABEL: handshake.func @buffers(
+// CHECK-SAME:      %[[ARG0:.*]]: index, %[[ARG1:.*]]: none, ...)
+// CHECK-NEXT:    %[[SEQ:.*]] = "handshake.buffer"(%[[ARG0]]) {control = false, sequential = true, slots = 5 : i32} : (index) -> index
+// CHECK-NEXT:    %[[FIFO:.*]] = "handshake.buffer"(%[[SEQ]]) {control = false, sequential = false, slots = 1 : i32} : (index) -> index
+// CHECK-NEXT:    handshake.return %[[FIFO]], %[[ARG1]] : index, none
+handshake.func @buffers(%arg0: index, %arg1: none, ...) -> (index, none) {
+  %0 = "handshake.buffer"(%arg0) {control = false, sequential = true, slots = 3 : i32} : (index) -> index
+  %1 = "handshake.buffer"(%0) {control = false, sequential = true, slots = 2 : i32} : (index) -> index
+  %2 = "handshake.buffer"(%1) {control = false, sequential = false, slots = 1 : i32} : (index) -> index
+  handshake.return %2, %arg1 : index, none
+}
+
+// CHECK-LABEL: handshake.func @constant_branch(
+// CHECK-SAME:      %[[ARG0:.*]]: index, %[[ARG1:.*]]: index, %[[ARG2:.*]]: none, ...)
+// CHECK-NEXT:    handshake.return %[[ARG0]], %[[ARG1]], %[[ARG2]] : index, index, none
+handshake.func @constant_branch(%arg0: index, %arg1: index, %arg2: none, ...) -> (index, index, none) {
+  %0:2 = "handshake.fork"(%arg2) {control = true} : (none) -> (none, none)
+  %1 = "handshake.constant"(%0#0) {value = true} : (none) -> i1
+  %2, %3 = "handshake.conditional_branch"(%1, %arg0) {control = false} : (i1, index) -> (index, index)
+  %4 = "handshake.merge"(%3, %arg1) : (index, index) -> index
+  handshake.return %2, %4, %0#1 : index, index, none
+}
+
+// CHECK-LABEL: handshake.func @forked_constant(
+// CHECK-SAME:      %[[ARG0:.*]]: index, %[[ARG1:.*]]: index, %[[ARG2:.*]]: none, ...)
+// CHECK-NEXT:    "handshake.sink"(%[[ARG2]]) : (none) -> ()
+// CHECK-NEXT:    handshake.return %[[ARG0]], %[[ARG1]] : index, index
+handshake.func @forked_constant(%arg0: index, %arg1: index, %arg2: none, ...) -> (index, index) {
+  %0 = "handshake.constant"(%arg2) {value = false} : (none) -> i1
+  %1:2 = "handshake.fork"(%0) {control = false} : (i1) -> (i1, i1)
+  %2, %3 = "handshake.conditional_branch"(%1#0, %arg0) {control = false} : (i1, index) -> (index, index)
+  %4, %5 = "handshake.conditional_branch"(%1#1, %arg1) {control = false} : (i1, index) -> (index, index)
+  "handshake.sink"(%2) : (index) -> ()
+  "handshake.sink"(%4) : (index) -> ()
+  handshake.return %3, %5 : index, index
+}
@@ -0,0 +1,53 @@
+// RUN: circt-opt -create-pipeline=scheduler=asap %s | FileCheck %s --check-prefix=ASAP
+// RUN: circt-opt -create-pipeline=scheduler=modulo %s | FileCheck %s --check-prefix=MODULO
+
+// Multiplications take three cycles, loads take two, and all other operations
+// take one. Each stage passes the values used later on to the next one.
+
+// ASAP-LABEL: func @mac
+// ASAP:         %[[RES:.+]] = "staticlogic.pipeline"(%arg2, %arg3, %arg0, %arg1) ( {
+// ASAP-NEXT:    ^bb0(%[[A:.+]]: i32, %[[B:.+]]: i32, %[[MEM:.+]]: memref<8xi32>, %[[I:.+]]: index):
+// ASAP-NEXT:      %[[MUL:.+]] = muli %[[A]], %[[B]] : i32
+// ASAP-NEXT:      %[[LOAD:.+]] = memref.load %[[MEM]][%[[I]]] : memref<8xi32>
+// ASAP-NEXT:      br ^bb1(%[[MUL]], %[[LOAD]], %[[MEM]], %[[I]] : i32, i32, memref<8xi32>, index)
+// ASAP-NEXT:    ^bb1(%{{.+}}: i32, %{{.+}}: i32, %{{.+}}: memref<8xi32>, %{{.+}}: index):
+// ASAP-NEXT:      br ^bb2
+// ASAP-NEXT:    ^bb2(%{{.+}}: i32, %{{.+}}: i32, %{{.+}}: memref<8xi32>, %{{.+}}: index):
+// ASAP-NEXT:      br ^bb3
+// ASAP-NEXT:    ^bb3(%[[MUL3:.+]]: i32, %[[LOAD3:.+]]: i32, %[[MEM3:.+]]: memref<8xi32>, %[[I3:.+]]: index):
+// ASAP-NEXT:      %[[ADD:.+]] = addi %[[MUL3]], %[[LOAD3]] : i32
+// ASAP-NEXT:      br ^bb4(%[[ADD]], %[[MEM3]], %[[I3]] : i32, memref<8xi32>, index)
+// ASAP-NEXT:    ^bb4(%[[ADD4:.+]]: i32, %[[MEM4:.+]]: memref<8xi32>, %[[I4:.+]]: index):
+// ASAP-NEXT:      memref.store %[[ADD4]], %[[MEM4]][%[[I4]]] : memref<8xi32>
+// ASAP-NEXT:      br ^bb5(%[[ADD4]] : i32)
+// ASAP-NEXT:    ^bb5(%[[ADD5:.+]]: i32):
+// ASAP-NEXT:      "staticlogic.return"(%[[ADD5]]) : (i32) -> ()
+// ASAP-NEXT:    }) : (i32, i32, memref<8xi32>, index) -> i32
+// ASAP-NEXT:    return %[[RES]] : i32
+
+// The store feeds the load of the next iteration, which bounds the II.
+
+// MODULO-LABEL: func @mac
+// MODULO:         ^bb0({{.+}}):
+// MODULO-NEXT:      muli
+// MODULO-NEXT:      br ^bb1
+// MODULO:         ^bb1({{.+}}):
+// MODULO-NEXT:      memref.load
+// MODULO-NEXT:      br ^bb2
+// MODULO:         ^bb3({{.+}}):
+// MODULO-NEXT:      addi
+// MODULO-NEXT:      br ^bb4
+// MODULO:         ^bb4({{.+}}):
+// MODULO-NEXT:      memref.store
+// MODULO-NEXT:      br ^bb5
+// MODULO:         ^bb5({{.+}}):
+// MODULO-NEXT:      "staticlogic.return"
+// MODULO-NEXT:    }) {II = 4 : i64} : (i32, i32, memref<8xi32>, index) -> i32
+
+func @mac(%mem: memref<8xi32>, %i: index, %a: i32, %b: i32) -> i32 {
+  %0 = muli %a, %b : i32
+  %1 = memref.load %mem[%i] : memref<8xi32>
+  %2 = addi %0, %1 : i32
+  memref.store %2, %mem[%i] : memref<8xi32>
+  return %2 : i32
+}
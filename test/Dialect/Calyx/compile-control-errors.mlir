@@ -0,0 +1,48 @@
+// RUN: circt-opt -pass-pipeline='calyx.program(calyx.component(calyx-compile-control))' %s -split-input-file -verify-diagnostics
+
+calyx.program {
+  calyx.component @A(%go: i1) -> (%done: i1) {
+    calyx.wires {}
+    calyx.control {}
+  }
+  calyx.component @main() -> () {
+    %a.go, %a.done = calyx.cell "a" @A : i1, i1
+    calyx.wires {
+      calyx.group @Group1 {
+        calyx.group_done %a.done : i1
+      }
+    }
+    calyx.control {
+      calyx.seq {
+        // expected-error @+1 {{'calyx.enable' op enables group 'Group1' without a go signal; run 'calyx-go-insertion' first}}
+        calyx.enable @Group1
+      }
+    }
+  }
+}
+
+// -----
+
+calyx.program {
+  calyx.component @A(%go: i1) -> (%done: i1) {
+    calyx.wires {}
+    calyx.control {}
+  }
+  calyx.component @main() -> () {
+    %a.go, %a.done = calyx.cell "a" @A : i1, i1
+    %undef = calyx.undef : i1
+    calyx.wires {
+      calyx.group @Group1 {
+        %go = calyx.group_go %undef : i1
+        %done = comb.and %a.done, %go : i1
+        calyx.group_done %done : i1
+      }
+    }
+    calyx.control {
+      calyx.seq {
+        // expected-error @+1 {{'calyx.enable' op enables group 'Group1' whose done signal is computed within the group}}
+        calyx.enable @Group1
+      }
+    }
+  }
+}
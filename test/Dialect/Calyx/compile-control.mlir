@@ -0,0 +1,96 @@
+// RUN: circt-opt -pass-pipeline='calyx.program(calyx.component(calyx-go-insertion, calyx-compile-control))' %s | FileCheck %s
+
+calyx.program {
+  calyx.component @A(%in: i8, %go: i1) -> (%out: i8, %done: i1) {
+    calyx.wires {}
+    calyx.control {}
+  }
+
+  // CHECK-LABEL: calyx.component @main
+  calyx.component @main() -> () {
+    // CHECK:       %[[FSM:.+]]:6 = calyx.register "seq_fsm" : i2
+    %a.in, %a.go, %a.out, %a.done = calyx.cell "a" @A : i8, i1, i8, i1
+    %b.in, %b.go, %b.out, %b.done = calyx.cell "b" @A : i8, i1, i8, i1
+    calyx.wires {
+      // CHECK:       calyx.group @A {
+      // CHECK-NEXT:    calyx.group_go %true, %[[A_GO:[^ ]+]] ? : i1
+      calyx.group @A {
+        calyx.assign %a.in = %b.out : i8
+        calyx.group_done %a.done : i1
+      }
+      // CHECK:       calyx.group @B {
+      // CHECK-NEXT:    calyx.group_go %true, %[[B_GO:[^ ]+]] ? : i1
+      calyx.group @B {
+        calyx.assign %b.in = %a.out : i8
+        calyx.group_done %b.done : i1
+      }
+      // CHECK:       %[[RUNNING:.+]] = calyx.undef : i1
+      // CHECK-NEXT:  calyx.group @seq {
+      // CHECK-NEXT:    calyx.group_go %[[RUNNING]] : i1
+      // CHECK-NEXT:    calyx.assign %[[FSM]]#0 = %{{.+}}, %[[A_DONE:[^ ]+]] ? : i2
+      // CHECK-NEXT:    calyx.assign %[[FSM]]#1 = %true, %[[A_DONE]] ? : i1
+      // CHECK-NEXT:    calyx.assign %[[FSM]]#0 = %{{.+}}, %[[B_DONE:[^ ]+]] ? : i2
+      // CHECK-NEXT:    calyx.assign %[[FSM]]#1 = %true, %[[B_DONE]] ? : i1
+      // CHECK-NEXT:    calyx.group_done %true, %[[FINAL:[^ ]+]] ? : i1
+      // CHECK-NEXT:  }
+      // CHECK:       %[[A_STATE:.+]] = comb.icmp eq %[[FSM]]#4, %{{.+}} : i2
+      // CHECK-NEXT:  %[[A_ACTIVE:.+]] = comb.and %[[A_STATE]], %[[RUNNING]] : i1
+      // CHECK-NEXT:  %[[A_NOT_DONE:.+]] = comb.xor %0#3, %true : i1
+      // CHECK-NEXT:  %[[A_GO]] = comb.and %[[A_ACTIVE]], %[[A_NOT_DONE]] : i1
+      // CHECK-NEXT:  %[[A_DONE]] = comb.and %[[A_ACTIVE]], %0#3 : i1
+      // CHECK:       %[[B_STATE:.+]] = comb.icmp eq %[[FSM]]#4, %{{.+}} : i2
+      // CHECK-NEXT:  %[[B_ACTIVE:.+]] = comb.and %[[B_STATE]], %[[RUNNING]] : i1
+      // CHECK-NEXT:  %[[B_NOT_DONE:.+]] = comb.xor %1#3, %true : i1
+      // CHECK-NEXT:  %[[B_GO]] = comb.and %[[B_ACTIVE]], %[[B_NOT_DONE]] : i1
+      // CHECK-NEXT:  %[[B_DONE]] = comb.and %[[B_ACTIVE]], %1#3 : i1
+      // CHECK:       %[[FINAL]] = comb.icmp eq %[[FSM]]#4, %{{.+}} : i2
+      // CHECK-NEXT:  %[[INITIAL:.+]] = hw.constant 0 : i2
+      // CHECK-NEXT:  calyx.assign %[[FSM]]#0 = %[[INITIAL]], %[[FINAL]] ? : i2
+      // CHECK-NEXT:  calyx.assign %[[FSM]]#1 = %true, %[[FINAL]] ? : i1
+      // CHECK-NEXT: }
+    }
+    // CHECK:       calyx.control {
+    // CHECK-NEXT:    calyx.enable @seq
+    // CHECK-NEXT:  }
+    calyx.control {
+      calyx.seq {
+        calyx.enable @A
+        calyx.enable @B
+      }
+    }
+  }
+
+  // CHECK-LABEL: calyx.component @Nested
+  calyx.component @Nested(%go: i1) -> (%done: i1) {
+    // CHECK:       %[[INNER:.+]]:6 = calyx.register "seq_fsm" : i1
+    // CHECK:       %[[OUTER:.+]]:6 = calyx.register "seq_0_fsm" : i2
+    %a.in, %a.go, %a.out, %a.done = calyx.cell "a" @A : i8, i1, i8, i1
+    calyx.wires {
+      // A group enabled twice runs for either enable.
+      // CHECK:       calyx.group @A {
+      // CHECK-NEXT:    calyx.group_go %true{{[^,]*}}, %[[A_GO:[^ ]+]] ? : i1
+      calyx.group @A {
+        calyx.assign %a.in = %a.out : i8
+        calyx.group_done %a.done : i1
+      }
+      // The go signal of the inner sequence is guarded by the outer one.
+      // CHECK:       calyx.group @seq {
+      // CHECK-NEXT:    calyx.group_go %[[INNER_GO:[^ ]+]] : i1
+      // CHECK:       comb.and %{{.+}}, %[[INNER_GO]] : i1
+      // CHECK:       calyx.group @seq_0 {
+      // CHECK:       %[[INNER_GO]] = comb.and %{{.+}}, %{{.+}} : i1
+      // CHECK:       %[[A_GO]] = comb.or %{{.+}}, %{{.+}} : i1
+    }
+    // CHECK:       calyx.control {
+    // CHECK-NEXT:    calyx.enable @seq_0
+    // CHECK-NEXT:  }
+    calyx.control {
+      calyx.seq {
+        calyx.seq {
+          calyx.enable @A
+        }
+        calyx.enable @A
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+// RUN: circt-opt -pass-pipeline='calyx.program(calyx-infer-static-timing)' %s | FileCheck %s
+
+calyx.program {
+  // CHECK-LABEL: calyx.component @Mul
+  // CHECK-SAME:    attributes {static = 3 : i64}
+  calyx.component @Mul(%left: i8, %right: i8, %go: i1) -> (%out: i8, %done: i1) attributes {static = 3} {
+    calyx.wires {}
+    calyx.control {}
+  }
+
+  // The latency of @Twice is only known after visiting it.
+  // CHECK-LABEL: calyx.component @Top
+  // CHECK-SAME:    attributes {static = 6 : i64}
+  calyx.component @Top(%go: i1) -> (%done: i1) {
+    %twice.go, %twice.done = calyx.cell "twice" @Twice : i1, i1
+    %c1_i1 = constant 1 : i1
+    calyx.wires {
+      // CHECK: calyx.group @Run {
+      // CHECK: } {static = 6 : i64}
+      calyx.group @Run {
+        calyx.assign %twice.go = %c1_i1 : i1
+        calyx.group_done %twice.done : i1
+      }
+    }
+    calyx.control {
+      calyx.seq { calyx.enable @Run }
+    }
+  }
+
+  // CHECK-LABEL: calyx.component @Twice
+  // CHECK-SAME:    attributes {static = 6 : i64}
+  calyx.component @Twice(%go: i1) -> (%done: i1) {
+    %l0, %r0, %g0, %o0, %d0 = calyx.cell "mul0" @Mul : i8, i8, i1, i8, i1
+    %l1, %r1, %g1, %o1, %d1 = calyx.cell "mul1" @Mul : i8, i8, i1, i8, i1
+    %c1_i1 = constant 1 : i1
+    calyx.wires {
+      // CHECK: calyx.group @First {
+      // CHECK: } {static = 3 : i64}
+      calyx.group @First {
+        calyx.assign %g0 = %c1_i1 : i1
+        calyx.group_done %d0 : i1
+      }
+      // CHECK: calyx.group @Second {
+      // CHECK: } {static = 3 : i64}
+      calyx.group @Second {
+        calyx.assign %l1 = %o0 : i8
+        calyx.assign %g1 = %c1_i1 : i1
+        calyx.group_done %d1 : i1
+      }
+    }
+    // CHECK: calyx.seq {
+    // CHECK: } {static = 6 : i64}
+    calyx.control {
+      calyx.seq {
+        calyx.enable @First
+        calyx.enable @Second
+      }
+    }
+  }
+
+  // CHECK-LABEL: calyx.component @main
+  // CHECK-SAME:    () -> () {
+  calyx.component @main() -> () {
+    %l0, %r0, %g0, %o0, %d0 = calyx.cell "mul0" @Mul : i8, i8, i1, i8, i1
+    %c1_i1 = constant 1 : i1
+    calyx.wires {
+      // A guarded go signal may start the cell late.
+      // CHECK: calyx.group @Guarded {
+      // CHECK: }{{$}}
+      calyx.group @Guarded {
+        calyx.assign %g0 = %c1_i1, %d0 ? : i1
+        calyx.group_done %d0 : i1
+      }
+      // The group finishes independently of the cell.
+      // CHECK: calyx.group @Constant {
+      // CHECK: }{{$}}
+      calyx.group @Constant {
+        calyx.assign %g0 = %c1_i1 : i1
+        calyx.group_done %c1_i1 : i1
+      }
+    }
+    // CHECK: calyx.seq {
+    // CHECK: }{{$}}
+    calyx.control {
+      calyx.seq {
+        calyx.enable @Guarded
+        calyx.enable @Constant
+      }
+    }
+  }
+}
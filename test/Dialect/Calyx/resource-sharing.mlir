@@ -0,0 +1,69 @@
+// RUN: circt-opt -pass-pipeline='calyx.program(calyx.component(calyx-resource-sharing))' %s | FileCheck %s
+
+calyx.program {
+  // CHECK-LABEL: calyx.component @Add(%left: i8, %right: i8) -> (%out: i8) attributes {share} {
+  calyx.component @Add(%left: i8, %right: i8) -> (%out: i8) attributes {share} {
+    calyx.wires {}
+    calyx.control {}
+  }
+  calyx.component @Mem(%addr: i8) -> (%data: i8) {
+    calyx.wires {}
+    calyx.control {}
+  }
+
+  // CHECK-LABEL: calyx.component @Sequential
+  calyx.component @Sequential(%a: i8, %b: i8) -> () {
+    // CHECK:      %0:3 = calyx.cell "add0" @Add : i8, i8, i8
+    // CHECK-NOT:  "add1"
+    // CHECK:      %1:2 = calyx.cell "mem0" @Mem : i8, i8
+    // CHECK:      %2:2 = calyx.cell "mem1" @Mem : i8, i8
+    %l0, %r0, %o0 = calyx.cell "add0" @Add : i8, i8, i8
+    %l1, %r1, %o1 = calyx.cell "add1" @Add : i8, i8, i8
+    %a0, %d0 = calyx.cell "mem0" @Mem : i8, i8
+    %a1, %d1 = calyx.cell "mem1" @Mem : i8, i8
+    %c1_i1 = constant 1 : i1
+    calyx.wires {
+      // CHECK:      calyx.group @First {
+      // CHECK-NEXT:   calyx.assign %0#0 = %a : i8
+      // CHECK-NEXT:   calyx.assign %1#0 = %0#2 : i8
+      calyx.group @First {
+        calyx.assign %l0 = %a : i8
+        calyx.assign %a0 = %o0 : i8
+        calyx.group_done %c1_i1 : i1
+      }
+      // CHECK:      calyx.group @Second {
+      // CHECK-NEXT:   calyx.assign %0#0 = %b : i8
+      // CHECK-NEXT:   calyx.assign %2#0 = %0#2 : i8
+      calyx.group @Second {
+        calyx.assign %l1 = %b : i8
+        calyx.assign %a1 = %o1 : i8
+        calyx.group_done %c1_i1 : i1
+      }
+    }
+    calyx.control {
+      calyx.seq {
+        calyx.enable @First
+        calyx.enable @Second
+      }
+    }
+  }
+
+  // CHECK-LABEL: calyx.component @main
+  calyx.component @main(%a: i8) -> () {
+    // CHECK: calyx.cell "add0" @Add
+    // CHECK: calyx.cell "add1" @Add
+    %l0, %r0, %o0 = calyx.cell "add0" @Add : i8, i8, i8
+    %l1, %r1, %o1 = calyx.cell "add1" @Add : i8, i8, i8
+    %c1_i1 = constant 1 : i1
+    calyx.wires {
+      calyx.group @Both {
+        calyx.assign %l0 = %a : i8
+        calyx.assign %l1 = %o0 : i8
+        calyx.group_done %c1_i1 : i1
+      }
+    }
+    calyx.control {
+      calyx.seq { calyx.enable @Both }
+    }
+  }
+}
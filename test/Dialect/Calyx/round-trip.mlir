@@ -29,6 +29,14 @@ calyx.program {
     calyx.control {}
   }
 
+  // CHECK-LABEL: calyx.component @ComponentWithRegister() -> () {
+  calyx.component @ComponentWithRegister() -> () {
+    // CHECK: %0:6 = calyx.register "r" : i8
+    %r.in, %r.write_en, %r.clk, %r.reset, %r.out, %r.done = calyx.register "r" : i8
+    calyx.wires {}
+    calyx.control {}
+  }
+
   calyx.component @A(%in: i8) -> (%out: i8) {
     calyx.wires {}
     calyx.control {}
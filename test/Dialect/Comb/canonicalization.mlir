@@ -1,4 +1,11 @@
 // RUN: circt-opt %s -simple-canonicalizer | FileCheck %s
+// RUN: circt-opt %s -simple-canonicalizer='incremental=true' | FileCheck %s
+// RUN: circt-opt %s -simple-canonicalizer='incremental=true pattern-statistics=true' -o /dev/null 2>&1 | FileCheck %s --check-prefix=STATS
+
+// STATS: SimpleCanonicalizer pattern statistics
+// STATS: Time (s) Hits Attempts Pattern
+// STATS-DAG: fold(comb.
+// STATS-DAG: comb.{{.*}}#0
 
 // CHECK-LABEL: @narrowMux
 hw.module @narrowMux(%a: i8, %b: i8, %c: i1) -> (%o: i4) {
@@ -302,3 +309,41 @@ hw.module @extractCatOnMultiplePartialElements(%arg0: i8, %arg1: i9, %arg2: i10)
   // CHECK-NEXT: hw.output [[RESULT1:%.+]], [[RESULT2:%.+]]
   hw.output %1, %2 : i11, i5
 }
+
+// Validates that a chain of muxes comparing one selector against constants is
+// turned into an array lookup, in which the outermost compare wins.
+// CHECK-LABEL: hw.module @muxChainToArray
+hw.module @muxChainToArray(%sel: i2, %a: i8, %b: i8, %c: i8, %d: i8, %e: i8) -> (%o: i8) {
+  // CHECK-NEXT: [[ARRAY:%.+]] = hw.array_create %e, %c, %b, %a : i8
+  // CHECK-NEXT: [[RESULT:%.+]] = hw.array_get [[ARRAY]][%sel] : !hw.array<4xi8>
+  // CHECK-NEXT: hw.output [[RESULT]] : i8
+  %c0_i2 = hw.constant 0 : i2
+  %c1_i2 = hw.constant 1 : i2
+  %c-2_i2 = hw.constant -2 : i2
+  %0 = comb.icmp eq %sel, %c0_i2 : i2
+  %1 = comb.icmp ne %sel, %c1_i2 : i2
+  %2 = comb.icmp eq %c-2_i2, %sel : i2
+  %3 = comb.icmp eq %sel, %c0_i2 : i2
+  %4 = comb.mux %3, %d, %e : i8
+  %5 = comb.mux %2, %c, %4 : i8
+  %6 = comb.mux %1, %5, %b : i8
+  %7 = comb.mux %0, %a, %6 : i8
+  hw.output %7 : i8
+}
+
+// Validates that short mux chains are left alone.
+// CHECK-LABEL: hw.module @shortMuxChain
+hw.module @shortMuxChain(%sel: i2, %a: i8, %b: i8, %c: i8, %d: i8) -> (%o: i8) {
+  // CHECK-NOT: hw.array_create
+  // CHECK: hw.output
+  %c0_i2 = hw.constant 0 : i2
+  %c1_i2 = hw.constant 1 : i2
+  %c-2_i2 = hw.constant -2 : i2
+  %0 = comb.icmp eq %sel, %c0_i2 : i2
+  %1 = comb.icmp eq %sel, %c1_i2 : i2
+  %2 = comb.icmp eq %sel, %c-2_i2 : i2
+  %3 = comb.mux %2, %c, %d : i8
+  %4 = comb.mux %1, %b, %3 : i8
+  %5 = comb.mux %0, %a, %4 : i8
+  hw.output %5 : i8
+}
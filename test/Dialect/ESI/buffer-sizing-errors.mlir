@@ -0,0 +1,14 @@
+// RUN: circt-opt %s --lower-esi-to-physical="stage-distance=10" -split-input-file -verify-diagnostics
+
+hw.module.extern @Sender() -> (%x: !esi.channel<i4>)
+hw.module.extern @Reciever(%a: !esi.channel<i4>)
+
+hw.module @overlap(%clk:i1, %rstn:i1) {
+  // expected-note @+1 {{other placement is here}}
+  %first = hw.instance "first" @Sender () {"loc:out" = #msft.physloc<M20K, 0, 0, 0>} : () -> (!esi.channel<i4>)
+  // expected-error @+1 {{Could not place '$parent|second|out' since its location is already occupied by '$parent|first|out'}}
+  %second = hw.instance "second" @Sender () {"loc:out" = #msft.physloc<M20K, 0, 0, 0>} : () -> (!esi.channel<i4>)
+  %buffered = esi.buffer %clk, %rstn, %first { } : i4
+  hw.instance "recv" @Reciever (%buffered) {"loc:in" = #msft.physloc<M20K, 20, 5, 0>} : (!esi.channel<i4>) -> ()
+  hw.instance "other" @Reciever (%second) : (!esi.channel<i4>) -> ()
+}
@@ -0,0 +1,56 @@
+// RUN: circt-opt %s --lower-esi-to-physical="stage-distance=10 fifo-threshold=8" -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck %s
+// RUN: circt-opt %s --lower-esi-to-physical="stage-distance=10 fifo-threshold=8" --lower-esi-ports --lower-esi-to-hw -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=HW %s
+// RUN: circt-opt %s --lower-esi-to-physical="stage-distance=10 shift-register-threshold=8" -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=SRL %s
+// RUN: circt-opt %s --lower-esi-to-physical="stage-distance=10 shift-register-threshold=8" --lower-esi-ports --lower-esi-to-hw -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=SRL-HW %s
+
+hw.module.extern @Sender() -> (%x: !esi.channel<i4>)
+hw.module.extern @Reciever(%a: !esi.channel<i4>)
+
+// CHECK-LABEL: hw.module @test(
+hw.module @test(%clk:i1, %rstn:i1) {
+  // Placed 25 units apart, which takes 3 stages.
+  %near = hw.instance "near" @Sender () {"loc:out" = #msft.physloc<M20K, 0, 0, 0>} : () -> (!esi.channel<i4>)
+  %nearBuffered = esi.buffer %clk, %rstn, %near { } : i4
+  hw.instance "nearRecv" @Reciever (%nearBuffered) {"loc:in" = #msft.physloc<M20K, 20, 5, 0>} : (!esi.channel<i4>) -> ()
+  // CHECK:      %near.x = hw.instance "near" @Sender()
+  // CHECK-NEXT: [[S0:%.+]] = esi.stage %clk, %rstn, %near.x : i4
+  // CHECK-NEXT: [[S1:%.+]] = esi.stage %clk, %rstn, [[S0]] : i4
+  // CHECK-NEXT: [[S2:%.+]] = esi.stage %clk, %rstn, [[S1]] : i4
+  // CHECK-NEXT: hw.instance "nearRecv" @Reciever([[S2]])
+
+  // Explicit stage counts win over the placement.
+  %pinned = hw.instance "pinned" @Sender () {"loc:out" = #msft.physloc<M20K, 0, 0, 1>} : () -> (!esi.channel<i4>)
+  %pinnedBuffered = esi.buffer %clk, %rstn, %pinned { stages = 1 } : i4
+  hw.instance "pinnedRecv" @Reciever (%pinnedBuffered) {"loc:in" = #msft.physloc<M20K, 20, 5, 1>} : (!esi.channel<i4>) -> ()
+  // CHECK:      %pinned.x = hw.instance "pinned" @Sender()
+  // CHECK-NEXT: [[P0:%.+]] = esi.stage %clk, %rstn, %pinned.x : i4
+  // CHECK-NEXT: hw.instance "pinnedRecv" @Reciever([[P0]])
+
+  // Unplaced buffers keep the default.
+  %free = hw.instance "free" @Sender () : () -> (!esi.channel<i4>)
+  %freeBuffered = esi.buffer %clk, %rstn, %free { } : i4
+  hw.instance "freeRecv" @Reciever (%freeBuffered) : (!esi.channel<i4>) -> ()
+  // CHECK:      %free.x = hw.instance "free" @Sender()
+  // CHECK-NEXT: [[F0:%.+]] = esi.stage %clk, %rstn, %free.x : i4
+  // CHECK-NEXT: hw.instance "freeRecv" @Reciever([[F0]])
+
+  // Deep buffers become FIFOs.
+  %far = hw.instance "far" @Sender () {"loc:out" = #msft.physloc<M20K, 0, 0, 2>} : () -> (!esi.channel<i4>)
+  %farBuffered = esi.buffer %clk, %rstn, %far { name = "longHaul" } : i4
+  hw.instance "farRecv" @Reciever (%farBuffered) {"loc:in" = #msft.physloc<M20K, 90, 40, 0>} : (!esi.channel<i4>) -> ()
+  // CHECK:      %far.x = hw.instance "far" @Sender()
+  // CHECK-NEXT: [[Q:%.+]] = esi.fifo %clk, %rstn, %far.x {depth = 13 : i64, name = "longHaul_fifo"} : i4
+  // CHECK-NEXT: hw.instance "farRecv" @Reciever([[Q]])
+
+  // Or shift registers, which keep the short buffers as stages.
+  // SRL:      esi.stage %clk, %rstn, %near.x : i4
+  // SRL:      %far.x = hw.instance "far" @Sender()
+  // SRL-NEXT: [[R:%.+]] = esi.shift_register %clk, %rstn, %far.x {name = "longHaul_srl", stages = 13 : i64} : i4
+  // SRL-NEXT: hw.instance "farRecv" @Reciever([[R]])
+
+  // HW-LABEL: hw.module @test(
+  // HW:         hw.instance "longHaul_fifo" @ESI_FIFO(%clk, %rstn, {{.*}}DEPTH = 13 : ui32, WIDTH = 4 : ui32
+
+  // SRL-HW-LABEL: hw.module @test(
+  // SRL-HW:         hw.instance "longHaul_srl" @ESI_ShiftRegister(%clk, %rstn, {{.*}}DEPTH = 13 : ui32, WIDTH = 4 : ui32
+}
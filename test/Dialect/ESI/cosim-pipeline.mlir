@@ -0,0 +1,18 @@
+// REQUIRES: capnp
+// RUN: circt-opt %s --lower-esi-ports --lower-esi-to-hw="fixed-capnp-layout cosim-stages=1" -verify-diagnostics | FileCheck %s
+
+hw.module.extern @Sender() -> (%x: !esi.channel<si14>)
+hw.module.extern @ArrReciever(%x: !esi.channel<!hw.array<4xsi64>>)
+
+// CHECK-LABEL: hw.module @top(
+// CHECK-DAG:     hw.instance "pipelineStage" @ESI_PipelineStage
+// CHECK-DAG:     hw.instance "pipelineStage" @ESI_PipelineStage
+// CHECK-DAG:     hw.instance "{{.*}}" @decode{{.*}}Fixed(
+// CHECK-LABEL: hw.module @decode{{.*}}Fixed(
+// CHECK-NOT:     comb.add
+// CHECK:         hw.output
+hw.module @top(%clk:i1, %rstn:i1) -> () {
+  %send.x = hw.instance "send" @Sender () : () -> (!esi.channel<si14>)
+  %cosimArrRecv = esi.cosim %clk, %rstn, %send.x, 2 {name="ArrTestEP"} : !esi.channel<si14> -> !esi.channel<!hw.array<4xsi64>>
+  hw.instance "arrRecv" @ArrReciever (%cosimArrRecv) : (!esi.channel<!hw.array<4 x si64>>) -> ()
+}
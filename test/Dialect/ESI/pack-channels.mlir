@@ -0,0 +1,54 @@
+// RUN: circt-opt %s --esi-pack-channels -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck %s
+// RUN: circt-opt %s --esi-pack-channels --lower-esi-to-physical --lower-esi-ports --lower-esi-to-hw -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=HW %s
+
+hw.module.extern @Sender() -> (%a: !esi.channel<i4>, %b: !esi.channel<i2>, %wide: !esi.channel<i32>)
+hw.module.extern @Reciever(%a: !esi.channel<i4>, %b: !esi.channel<i2>, %wide: !esi.channel<i32>)
+
+// Each channel sends only while it holds its credit, which it gets back once
+// the consumer takes the message out of its holding register.  The packed
+// buffer is then always ready, so a stalled channel doesn't block the other.
+// CHECK-LABEL: hw.module @test(%clk: i1, %rstn: i1) {
+// CHECK:         %send.a, %send.b, %send.wide = hw.instance "send" @Sender()
+// CHECK:         [[WIDE:%.+]] = esi.buffer %clk, %rstn, %send.wide {stages = 2 : i64} : i32
+// CHECK:         [[RESET:%.+]] = comb.xor %rstn, %true : i1
+// CHECK:         [[AINFLIGHT:%.+]] = seq.compreg [[AINFLIGHTNEXT:%[^,]+]], %clk, [[RESET]], %false : i1
+// CHECK:         [[BINFLIGHT:%.+]] = seq.compreg [[BINFLIGHTNEXT:%[^,]+]], %clk, [[RESET]], %false : i1
+// CHECK:         [[A:%[^,]+]], [[AVALID:%[^ ]+]] = esi.unwrap.vr %send.a, [[ASEND:%[^ ]+]] : i4
+// CHECK:         [[ATAGGED:%.+]] = comb.concat %false{{[_0-9]+}}, [[A]] : (i1, i4) -> i5
+// CHECK:         [[ACREDIT:%.+]] = comb.xor [[AINFLIGHT]], %true : i1
+// CHECK:         [[AGRANT:%.+]] = comb.and [[AVALID]], [[ACREDIT]] : i1
+// CHECK:         [[B:%[^,]+]], {{%[^ ]+}} = esi.unwrap.vr %send.b, {{%.+}} : i2
+// CHECK:         [[BTAGGED:%.+]] = comb.concat %true{{[_0-9]+}}, %c0_i2, [[B]] : (i1, i2, i2) -> i5
+// CHECK:         [[PACKED:%.+]] = comb.mux [[AGRANT]], [[ATAGGED]], [[BTAGGED]] : i5
+// CHECK:         [[CHAN:%[^,]+]], [[READY:%[^ ]+]] = esi.wrap.vr [[PACKED]], {{%.+}} : i5
+// CHECK:         [[ASEND]] = comb.and [[AGRANT]], [[READY]] : i1
+// CHECK:         [[BUFFERED:%.+]] = esi.buffer %clk, %rstn, [[CHAN]] {name = "aLink_packed", stages = 3 : i64} : i5
+// CHECK:         [[OUT:%[^,]+]], [[OUTVALID:%[^ ]+]] = esi.unwrap.vr [[BUFFERED]], %true : i5
+// CHECK:         [[AARRIVE:%.+]] = comb.and [[OUTVALID]], {{%.+}} : i1
+// CHECK:         [[ADATA:%.+]] = comb.extract [[OUT]] from 0 : (i5) -> i4
+// CHECK:         [[AHELD:%.+]] = seq.compreg [[AHELDNEXT:%[^,]+]], %clk : i4
+// CHECK:         [[AHELDVALID:%.+]] = seq.compreg [[AHELDVALIDNEXT:%[^,]+]], %clk, [[RESET]], %false : i1
+// CHECK:         [[AHELDNEXT]] = comb.mux [[AARRIVE]], [[ADATA]], [[AHELD]] : i4
+// CHECK:         [[AOUT:%[^,]+]], [[AREADY:%[^ ]+]] = esi.wrap.vr [[AHELD]], [[AHELDVALID]] : i4
+// CHECK:         [[ATAKE:%.+]] = comb.and [[AHELDVALID]], [[AREADY]] : i1
+// CHECK:         [[ANOTTAKEN:%.+]] = comb.xor [[ATAKE]], %true : i1
+// CHECK:         [[AKEEP:%.+]] = comb.and [[AHELDVALID]], [[ANOTTAKEN]] : i1
+// CHECK:         [[AHELDVALIDNEXT]] = comb.or [[AARRIVE]], [[AKEEP]] : i1
+// CHECK:         [[ASTILL:%.+]] = comb.and [[AINFLIGHT]], [[ANOTTAKEN]] : i1
+// CHECK:         [[AINFLIGHTNEXT]] = comb.or [[ASEND]], [[ASTILL]] : i1
+// CHECK:         [[BOUT:%[^,]+]], {{%[^ ]+}} = esi.wrap.vr {{%.+}}, {{%.+}} : i2
+// CHECK:         [[BINFLIGHTNEXT]] = comb.or {{%.+}}, {{%.+}} : i1
+// CHECK:         hw.instance "recv" @Reciever([[AOUT]], [[BOUT]], [[WIDE]])
+// CHECK-NOT:     esi.buffer
+
+// HW-LABEL: hw.module @test(
+// HW-COUNT-2: hw.instance "pipelineStage" @ESI_PipelineStage
+// HW-COUNT-3: hw.instance "aLink_packed_stage{{[0-9]}}" @ESI_PipelineStage
+// HW-NOT:     @ESI_PipelineStage
+hw.module @test(%clk: i1, %rstn: i1) {
+  %a, %b, %wide = hw.instance "send" @Sender () : () -> (!esi.channel<i4>, !esi.channel<i2>, !esi.channel<i32>)
+  %aBuf = esi.buffer %clk, %rstn, %a { name = "aLink", stages = 3 } : i4
+  %bBuf = esi.buffer %clk, %rstn, %b { stages = 1 } : i2
+  %wideBuf = esi.buffer %clk, %rstn, %wide { stages = 2 } : i32
+  hw.instance "recv" @Reciever (%aBuf, %bBuf, %wideBuf) : (!esi.channel<i4>, !esi.channel<i2>, !esi.channel<i32>) -> ()
+}
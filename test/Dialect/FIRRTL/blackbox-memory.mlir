@@ -488,3 +488,30 @@ firrtl.circuit "Duplicate" {
 // INLINE-NEXT:     firrtl.connect %WriteMemory2_W0_mask, %32 : !firrtl.uint<1>, !firrtl.uint<1>
 // INLINE-NEXT:   }
 // INLINE-NEXT: }
+
+// Memories of the same configuration in different modules share one module.
+firrtl.circuit "Shared" {
+  firrtl.module @Shared() {
+    firrtl.instance @SharedChild {name = "child", portNames = []}
+    %0 = firrtl.mem Undefined {depth = 16 : i64, name = "ReadMemory", portNames = ["read0"], readLatency = 1 : i32, writeLatency = 1 : i32} : !firrtl.bundle<addr: uint<4>, en: uint<1>, clk: clock, data flip: sint<8>>
+  }
+  firrtl.module @SharedChild() {
+    %0 = firrtl.mem Undefined {depth = 16 : i64, name = "OtherMemory", portNames = ["read0"], readLatency = 1 : i32, writeLatency = 1 : i32} : !firrtl.bundle<addr: uint<4>, en: uint<1>, clk: clock, data flip: sint<8>>
+  }
+}
+
+// WRAPPER-LABEL: firrtl.circuit "Shared" {
+// WRAPPER-NEXT:   firrtl.extmodule @ReadMemory_ext(
+// WRAPPER-NEXT:   firrtl.module @ReadMemory(
+// WRAPPER-NOT:    firrtl.extmodule
+// WRAPPER-LABEL:  firrtl.module @Shared() {
+// WRAPPER:          firrtl.instance @ReadMemory {name = "ReadMemory"}
+// WRAPPER-LABEL:  firrtl.module @SharedChild() {
+// WRAPPER-NEXT:     firrtl.instance @ReadMemory {name = "OtherMemory"}
+
+// INLINE-LABEL: firrtl.circuit "Shared" {
+// INLINE-NEXT:   firrtl.extmodule @ReadMemory_ext(
+// INLINE-NEXT:   firrtl.module @Shared() {
+// INLINE:          firrtl.instance @ReadMemory_ext {name = "ReadMemory"}
+// INLINE-LABEL:  firrtl.module @SharedChild() {
+// INLINE-NEXT:     firrtl.instance @ReadMemory_ext {name = "OtherMemory"}
@@ -0,0 +1,85 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-dedup)' %s | FileCheck %s
+
+// CHECK-LABEL: firrtl.circuit "Simple"
+firrtl.circuit "Simple" {
+  // CHECK: firrtl.module @Simple
+  firrtl.module @Simple() {
+    // CHECK-NEXT: firrtl.instance @A {name = "a0"}
+    // CHECK-NEXT: firrtl.instance @A {name = "a1"}
+    firrtl.instance @A {name = "a0"}
+    firrtl.instance @A_ {name = "a1"}
+  }
+  // CHECK: firrtl.module @A()
+  firrtl.module @A() {
+    %w = firrtl.wire : !firrtl.uint<1>
+  }
+  // CHECK-NOT: firrtl.module @A_()
+  firrtl.module @A_() {
+    %w = firrtl.wire : !firrtl.uint<1>
+  }
+}
+
+// Modules are only identical when their instances are: @Parent_ becomes a
+// duplicate of @Parent once @Child_ has been replaced with @Child.
+// CHECK-LABEL: firrtl.circuit "Hierarchy"
+firrtl.circuit "Hierarchy" {
+  // CHECK: firrtl.module @Hierarchy
+  firrtl.module @Hierarchy(in %in: !firrtl.uint<1>) {
+    // CHECK-NEXT: %p0_in = firrtl.instance @Parent {name = "p0"}
+    // CHECK: %p1_in = firrtl.instance @Parent {name = "p1"}
+    %p0_in = firrtl.instance @Parent {name = "p0"} : !firrtl.uint<1>
+    firrtl.connect %p0_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+    %p1_in = firrtl.instance @Parent_ {name = "p1"} : !firrtl.uint<1>
+    firrtl.connect %p1_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+  // CHECK: firrtl.module @Parent
+  // CHECK-NEXT: firrtl.instance @Child {name = "c"}
+  firrtl.module @Parent(in %in: !firrtl.uint<1>) {
+    %c_in = firrtl.instance @Child {name = "c"} : !firrtl.uint<1>
+    firrtl.connect %c_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+  // CHECK-NOT: firrtl.module @Parent_
+  firrtl.module @Parent_(in %in: !firrtl.uint<1>) {
+    %c_in = firrtl.instance @Child_ {name = "c"} : !firrtl.uint<1>
+    firrtl.connect %c_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+  // CHECK: firrtl.module @Child
+  firrtl.module @Child(in %in: !firrtl.uint<1>) {
+    %n = firrtl.node %in : !firrtl.uint<1>
+  }
+  // CHECK-NOT: firrtl.module @Child_
+  firrtl.module @Child_(in %in: !firrtl.uint<1>) {
+    %n = firrtl.node %in : !firrtl.uint<1>
+  }
+}
+
+// Modules which differ, or are annotated with NoDedup, are kept.
+// CHECK-LABEL: firrtl.circuit "Different"
+firrtl.circuit "Different" {
+  firrtl.module @Different() {
+    // CHECK: firrtl.instance @A {name = "a"}
+    // CHECK-NEXT: firrtl.instance @B {name = "b"}
+    // CHECK-NEXT: firrtl.instance @C {name = "c"}
+    // CHECK-NEXT: firrtl.instance @D {name = "d"}
+    firrtl.instance @A {name = "a"}
+    firrtl.instance @B {name = "b"}
+    firrtl.instance @C {name = "c"}
+    firrtl.instance @D {name = "d"}
+  }
+  // CHECK: firrtl.module @A
+  firrtl.module @A() {
+    %w = firrtl.wire : !firrtl.uint<1>
+  }
+  // CHECK: firrtl.module @B
+  firrtl.module @B() {
+    %w = firrtl.wire : !firrtl.uint<2>
+  }
+  // CHECK: firrtl.module @C
+  firrtl.module @C() {
+    %x = firrtl.wire : !firrtl.uint<1>
+  }
+  // CHECK: firrtl.module @D
+  firrtl.module @D() attributes {annotations = [{class = "firrtl.transforms.NoDedupAnnotation"}]} {
+    %w = firrtl.wire : !firrtl.uint<1>
+  }
+}
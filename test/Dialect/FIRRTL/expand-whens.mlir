@@ -404,4 +404,20 @@ firrtl.module @analog(out %analog : !firrtl.analog<1>) {
   firrtl.connect %w_a, %c1 : !firrtl.uint<1>, !firrtl.uint<1>
 }
 
+// Test that connecting a whole bundle initializes all of its fields.
+// CHECK-LABEL: firrtl.module @whole_bundle
+firrtl.module @whole_bundle(in %in : !firrtl.bundle<a: uint<1>, b: uint<2>>) {
+  %w = firrtl.wire : !firrtl.bundle<a: uint<1>, b: uint<2>>
+  firrtl.connect %w, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+}
+
+// Test that connecting to an element of a vector initializes that element.
+// CHECK-LABEL: firrtl.module @vector_element
+firrtl.module @vector_element(in %in : !firrtl.uint<1>, out %out : !firrtl.vector<uint<1>, 1>) {
+  // CHECK: [[OUT_0:%.*]] = firrtl.subindex %out[0]
+  // CHECK-NEXT: firrtl.connect [[OUT_0]], %in
+  %0 = firrtl.subindex %out[0] : !firrtl.vector<uint<1>, 1>
+  firrtl.connect %0, %in : !firrtl.uint<1>, !firrtl.uint<1>
+}
+
 }
@@ -0,0 +1,49 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl.module(firrtl-forward-connects))' %s | FileCheck %s
+firrtl.circuit "ForwardConnects" {
+firrtl.module @ForwardConnects() {}
+
+// Chains of wires and nodes are forwarded, even if the driver is defined
+// after the wire.
+// CHECK-LABEL: firrtl.module @chain
+firrtl.module @chain(in %a: !firrtl.uint<4>, in %b: !firrtl.uint<4>, out %x: !firrtl.uint<4>) {
+  // CHECK-NEXT: %0 = firrtl.and %a, %b
+  // CHECK-NEXT: firrtl.connect %x, %0
+  // CHECK-NEXT: }
+  %w1 = firrtl.wire : !firrtl.uint<4>
+  %w2 = firrtl.wire : !firrtl.uint<4>
+  %0 = firrtl.and %a, %b : (!firrtl.uint<4>, !firrtl.uint<4>) -> !firrtl.uint<4>
+  firrtl.connect %w1, %0 : !firrtl.uint<4>, !firrtl.uint<4>
+  %n = firrtl.node %w1 : !firrtl.uint<4>
+  firrtl.connect %w2, %n : !firrtl.uint<4>, !firrtl.uint<4>
+  firrtl.connect %x, %w2 : !firrtl.uint<4>, !firrtl.uint<4>
+}
+
+// CHECK-LABEL: firrtl.module @kept
+firrtl.module @kept(in %a: !firrtl.uint<4>, in %p: !firrtl.uint<1>, out %x: !firrtl.uint<4>, out %y: !firrtl.uint<4>, out %z: !firrtl.uint<4>) {
+  // Wires connected more than once or in a when are left to ExpandWhens.
+  // CHECK: %twice = firrtl.wire
+  %twice = firrtl.wire : !firrtl.uint<4>
+  firrtl.connect %twice, %a : !firrtl.uint<4>, !firrtl.uint<4>
+  firrtl.connect %twice, %a : !firrtl.uint<4>, !firrtl.uint<4>
+  firrtl.connect %x, %twice : !firrtl.uint<4>, !firrtl.uint<4>
+  // CHECK: %inWhen = firrtl.wire
+  %inWhen = firrtl.wire : !firrtl.uint<4>
+  firrtl.when %p {
+    firrtl.connect %inWhen, %a : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  firrtl.connect %y, %inWhen : !firrtl.uint<4>, !firrtl.uint<4>
+
+  // The driver must be available at every use.
+  // CHECK: %early = firrtl.wire
+  %early = firrtl.wire : !firrtl.uint<4>
+  %0 = firrtl.not %early : (!firrtl.uint<4>) -> !firrtl.uint<4>
+  %1 = firrtl.not %a : (!firrtl.uint<4>) -> !firrtl.uint<4>
+  firrtl.connect %early, %1 : !firrtl.uint<4>, !firrtl.uint<4>
+  firrtl.connect %z, %0 : !firrtl.uint<4>, !firrtl.uint<4>
+
+  // Annotations are kept.
+  // CHECK: %dontTouch = firrtl.wire
+  %dontTouch = firrtl.wire {annotations = [{class = "firrtl.transforms.DontTouchAnnotation"}]} : !firrtl.uint<4>
+  firrtl.connect %dontTouch, %a : !firrtl.uint<4>, !firrtl.uint<4>
+}
+}
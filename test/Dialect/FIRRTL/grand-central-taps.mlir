@@ -1,4 +1,5 @@
 // RUN: circt-opt %s --firrtl-grand-central-taps | FileCheck %s
+// RUN: circt-opt %s --firrtl-grand-central --firrtl-grand-central-taps | FileCheck %s
 
 firrtl.circuit "TestHarness" attributes {
   annotations = [{
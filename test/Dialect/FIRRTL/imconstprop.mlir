@@ -1,4 +1,5 @@
 // RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-imconstprop)' --split-input-file  %s | FileCheck %s
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-imconstprop)' --split-input-file --mlir-disable-threading %s | FileCheck %s
 
 firrtl.circuit "Test" {
 
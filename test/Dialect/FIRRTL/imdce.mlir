@@ -0,0 +1,99 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-imdeadcodeelim)' --split-input-file %s | FileCheck %s
+
+firrtl.circuit "Top" {
+
+  // The unused output and its logic are removed, along with the input only it
+  // used.
+  // CHECK-LABEL: firrtl.module @Child
+  // CHECK-SAME: (in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>)
+  firrtl.module @Child(in %a: !firrtl.uint<1>, in %unused: !firrtl.uint<1>,
+                       out %b: !firrtl.uint<1>, out %c: !firrtl.uint<1>) {
+    // CHECK-NEXT: %w = firrtl.wire
+    // CHECK-NEXT: firrtl.connect %w, %a
+    // CHECK-NEXT: firrtl.connect %b, %w
+    // CHECK-NEXT: }
+    %w = firrtl.wire : !firrtl.uint<1>
+    firrtl.connect %w, %a : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %b, %w : !firrtl.uint<1>, !firrtl.uint<1>
+    %dead = firrtl.wire : !firrtl.uint<1>
+    %0 = firrtl.not %unused : (!firrtl.uint<1>) -> !firrtl.uint<1>
+    firrtl.connect %dead, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %c, %dead : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+
+  // A module whose outputs are all unobserved goes away with its instance.
+  // CHECK-NOT: @Unused
+  firrtl.module @Unused(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) {
+    firrtl.connect %b, %a : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+
+  // A module with effects is kept, even if it has no observed ports.
+  // CHECK-LABEL: firrtl.module @Effects
+  // CHECK-SAME: (in %clock: !firrtl.clock, in %en: !firrtl.uint<1>)
+  firrtl.module @Effects(in %clock: !firrtl.clock, in %en: !firrtl.uint<1>,
+                         in %x: !firrtl.uint<1>) {
+    // CHECK-NEXT: firrtl.printf %clock, %en, "hello"
+    firrtl.printf %clock, %en, "hello"
+  }
+
+  // Annotated declarations and ports are kept.
+  // CHECK-LABEL: firrtl.module @Annotated
+  // CHECK-SAME: in %a: !firrtl.uint<1> {firrtl.annotations = [{class = "foo"}]}
+  firrtl.module @Annotated(in %a: !firrtl.uint<1> {firrtl.annotations = [{class = "foo"}]}) {
+    // CHECK-NEXT: %keep = firrtl.wire
+    %keep = firrtl.wire {annotations = [{class = "firrtl.transforms.DontTouchAnnotation"}]} : !firrtl.uint<1>
+  }
+
+  // The ports of the top-level module are all kept.
+  // CHECK-LABEL: firrtl.module @Top
+  // CHECK-SAME: out %unusedOut: !firrtl.uint<1>
+  firrtl.module @Top(in %clock: !firrtl.clock, in %x: !firrtl.uint<1>,
+                     out %y: !firrtl.uint<1>, out %unusedOut: !firrtl.uint<1>) {
+    // CHECK-NEXT: %c_a, %c_b = firrtl.instance @Child {name = "c"} : !firrtl.uint<1>, !firrtl.uint<1>
+    %c_a, %c_unused, %c_b, %c_c = firrtl.instance @Child {name = "c"} : !firrtl.uint<1>, !firrtl.uint<1>, !firrtl.uint<1>, !firrtl.uint<1>
+    // CHECK-NEXT: firrtl.connect %c_a, %x
+    // CHECK-NEXT: firrtl.connect %y, %c_b
+    firrtl.connect %c_a, %x : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %c_unused, %x : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %y, %c_b : !firrtl.uint<1>, !firrtl.uint<1>
+
+    // The output of the second instance is observed by nothing.
+    %c2_a, %c2_unused, %c2_b, %c2_c = firrtl.instance @Child {name = "c2"} : !firrtl.uint<1>, !firrtl.uint<1>, !firrtl.uint<1>, !firrtl.uint<1>
+    // CHECK-NEXT: %c2_a, %c2_b = firrtl.instance @Child {name = "c2"}
+    // CHECK-NEXT: firrtl.connect %c2_a, %x
+    firrtl.connect %c2_a, %x : !firrtl.uint<1>, !firrtl.uint<1>
+
+    %u_a, %u_b = firrtl.instance @Unused {name = "u"} : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %u_a, %x : !firrtl.uint<1>, !firrtl.uint<1>
+
+    // CHECK-NEXT: %e_clock, %e_en = firrtl.instance @Effects {name = "e"}
+    // CHECK-NEXT: firrtl.connect %e_clock, %clock
+    // CHECK-NEXT: firrtl.connect %e_en, %x
+    %e_clock, %e_en, %e_x = firrtl.instance @Effects {name = "e"} : !firrtl.clock, !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %e_clock, %clock : !firrtl.clock, !firrtl.clock
+    firrtl.connect %e_en, %x : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %e_x, %x : !firrtl.uint<1>, !firrtl.uint<1>
+
+    // CHECK-NEXT: %an_a = firrtl.instance @Annotated {name = "an"}
+    %an_a = firrtl.instance @Annotated {name = "an"} : !firrtl.uint<1>
+
+    // CHECK-NEXT: firrtl.connect %unusedOut, %x
+    // CHECK-NEXT: }
+    firrtl.connect %unusedOut, %x : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
+
+// -----
+
+// The ports of external modules are all observed.
+firrtl.circuit "External" {
+  firrtl.extmodule @Ext(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>)
+
+  // CHECK-LABEL: firrtl.module @External
+  firrtl.module @External(in %x: !firrtl.uint<1>) {
+    // CHECK-NEXT: %ext_a, %ext_b = firrtl.instance @Ext
+    // CHECK-NEXT: firrtl.connect %ext_a, %x
+    %ext_a, %ext_b = firrtl.instance @Ext {name = "ext"} : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %ext_a, %x : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
@@ -1,4 +1,5 @@
 // RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' --verify-diagnostics --split-input-file %s
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' --verify-diagnostics --split-input-file --mlir-disable-threading %s
 
 firrtl.circuit "Foo" {
   firrtl.module @Foo(in %clk: !firrtl.clock) {
@@ -1,4 +1,12 @@
 // RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' --verify-diagnostics %s | FileCheck %s
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' --verify-diagnostics --mlir-disable-threading %s | FileCheck %s
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' --pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=STATS
+
+// STATS: InferWidths
+// STATS-DAG: {{[0-9]+}} skipped-modules
+// STATS-DAG: {{[0-9]+}} exprs
+// STATS-DAG: {{[0-9]+}} vars
+// STATS-DAG: {{[0-9]+}} solver-memory-kb
 
 firrtl.circuit "Foo" {
   // CHECK-LABEL: @InferConstant
@@ -0,0 +1,34 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-inliner,firrtl-print-instance-graph)' %s -o %t 2>&1 | FileCheck %s
+
+// The inliner keeps the instance graph up to date, so it is printed without
+// being rebuilt.  Inlined instances are replaced by the instances cloned from
+// the inlined module, and dead modules are removed.
+
+// CHECK: digraph "Top"
+// CHECK:   [[TOP:.*]] [shape=record,label="{Top}"];
+// CHECK:   [[TOP]] -> [[CAT:.*]][label=cat];
+// CHECK:   [[TOP]] -> [[CAT]][label=bear_cat];
+// CHECK:   [[CAT]] [shape=record,label="{Cat}"];
+// CHECK-NOT: Bear
+// CHECK-NOT: Dead
+// CHECK: }
+
+firrtl.circuit "Top" {
+
+firrtl.module @Top() {
+  firrtl.instance @Bear {name = "bear"}
+  firrtl.instance @Cat {name = "cat"}
+}
+
+firrtl.module @Bear() attributes {annotations =
+        [{class = "firrtl.passes.InlineAnnotation"}]} {
+  firrtl.instance @Cat {name = "cat"}
+}
+
+firrtl.module @Cat() { }
+
+firrtl.module @Dead() {
+  firrtl.instance @Cat {name = "cat"}
+}
+
+}
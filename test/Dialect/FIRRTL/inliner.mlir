@@ -1,4 +1,5 @@
 // RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-inliner)' %s | FileCheck %s
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-inliner)' --mlir-disable-threading %s | FileCheck %s
 
 // Test that an external module as the main module works.
 firrtl.circuit "main_extmodule" {
@@ -115,6 +116,42 @@ firrtl.module @test3() {
 // CHECK-NEXT: }
 
 
+// Test that a live module, which has already had its instances inlined, is
+// flattened in to a parent the same way as if it had not been.
+firrtl.circuit "reuse" {
+firrtl.module @reuse() {
+  firrtl.instance @flat {name = "flat"}
+  firrtl.instance @live {name = "live"}
+}
+firrtl.module @flat() attributes {annotations =
+        [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+  firrtl.instance @live {name = "live"}
+}
+firrtl.module @live() {
+  %test_wire = firrtl.wire : !firrtl.uint<2>
+  firrtl.instance @leaf {name = "leaf"}
+}
+firrtl.module @leaf() attributes {annotations =
+        [{class = "firrtl.passes.InlineAnnotation"}]} {
+  %test_wire = firrtl.wire : !firrtl.uint<2>
+}
+}
+// CHECK-LABEL: firrtl.circuit "reuse" {
+// CHECK-NEXT:   firrtl.module @reuse() {
+// CHECK-NEXT:     firrtl.instance @flat  {name = "flat"}
+// CHECK-NEXT:     firrtl.instance @live  {name = "live"}
+// CHECK-NEXT:   }
+// CHECK-NEXT:   firrtl.module @flat() attributes {annotations = [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+// CHECK-NEXT:     %live_test_wire = firrtl.wire  : !firrtl.uint<2>
+// CHECK-NEXT:     %live_leaf_test_wire = firrtl.wire  : !firrtl.uint<2>
+// CHECK-NEXT:   }
+// CHECK-NEXT:   firrtl.module @live() {
+// CHECK-NEXT:     %test_wire = firrtl.wire  : !firrtl.uint<2>
+// CHECK-NEXT:     %leaf_test_wire = firrtl.wire  : !firrtl.uint<2>
+// CHECK-NEXT:   }
+// CHECK-NEXT: }
+
+
 // This is testing that connects are properly replaced when inlining. This is
 // also testing that the deep clone and remapping values is working correctly.
 firrtl.circuit "TestConnections" {
@@ -0,0 +1,61 @@
+// RUN: circt-opt -test-firrtl-instance-paths %s -o %t 2>&1 | FileCheck %s
+
+// A diamond: C is reached through both A and B, and so is the external module
+// below it.  Unreachable modules have no paths.
+// CHECK-LABEL: instance paths of "Top"
+// CHECK-NEXT: Top: 1 instances
+// CHECK-NEXT:   Top{{$}}
+// CHECK-NEXT: A: 1 instances
+// CHECK-NEXT:   Top/a{{$}}
+// CHECK-NEXT: B: 1 instances
+// CHECK-NEXT:   Top/b{{$}}
+// CHECK-NEXT: C: 2 instances
+// CHECK-NEXT:   Top/a/c{{$}}
+// CHECK-NEXT:   Top/b/c{{$}}
+// CHECK-NEXT: D: 2 instances
+// CHECK-NEXT:   Top/a/c/d{{$}}
+// CHECK-NEXT:   Top/b/c/d{{$}}
+// CHECK-NEXT: Unused: 0 instances
+// CHECK-NOT: uncached
+
+// Erasing the instance of C in B must be seen once the cache is invalidated.
+// CHECK-LABEL: instance paths after erasing 1 instances
+// CHECK-NEXT: Top: 1 instances
+// CHECK-NEXT:   Top{{$}}
+// CHECK-NEXT: A: 1 instances
+// CHECK-NEXT:   Top/a{{$}}
+// CHECK-NEXT: B: 1 instances
+// CHECK-NEXT:   Top/b{{$}}
+// CHECK-NEXT: C: 1 instances
+// CHECK-NEXT:   Top/a/c{{$}}
+// CHECK-NEXT: D: 1 instances
+// CHECK-NEXT:   Top/a/c/d{{$}}
+// CHECK-NEXT: Unused: 0 instances
+// CHECK-NOT: mismatched
+
+firrtl.circuit "Top" {
+
+firrtl.module @Top() {
+  firrtl.instance @A {name = "a"}
+  firrtl.instance @B {name = "b"}
+}
+
+firrtl.module @A() {
+  firrtl.instance @C {name = "c"}
+}
+
+firrtl.module @B() {
+  firrtl.instance @C {name = "c", test.erase}
+}
+
+firrtl.module @C() {
+  firrtl.instance @D {name = "d"}
+}
+
+firrtl.extmodule @D()
+
+firrtl.module @Unused() {
+  firrtl.instance @C {name = "c"}
+}
+
+}
@@ -0,0 +1,93 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-lower-types{preserve-aggregate=true})' %s | FileCheck %s
+
+firrtl.circuit "Top" {
+
+  // Ports, wires and nodes which are only connected as a whole stay intact.
+  // CHECK-LABEL: firrtl.module @Child
+  // CHECK-SAME: in %in: !firrtl.bundle<a: uint<1>, b: uint<2>>
+  // CHECK-SAME: out %out: !firrtl.bundle<a: uint<1>, b: uint<2>>
+  firrtl.module @Child(in %in: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                       out %out: !firrtl.bundle<a: uint<1>, b: uint<2>>) {
+    // CHECK-NEXT: %w = firrtl.wire {{.*}}: !firrtl.bundle<a: uint<1>, b: uint<2>>
+    // CHECK-NEXT: firrtl.connect %w, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    // CHECK-NEXT: %n = firrtl.node %w {{.*}}: !firrtl.bundle<a: uint<1>, b: uint<2>>
+    // CHECK-NEXT: firrtl.connect %out, %n : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    %w = firrtl.wire : !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %w, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    %n = firrtl.node %w : !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %out, %n : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+  }
+
+  // Writing a single field of a port splits it, both in the module and at
+  // every instance of it.
+  // CHECK-LABEL: firrtl.module @FieldWrite
+  // CHECK-SAME: in %in_a: !firrtl.uint<1>
+  // CHECK-SAME: out %out_a: !firrtl.uint<1>
+  firrtl.module @FieldWrite(in %in: !firrtl.bundle<a: uint<1>>,
+                            out %out: !firrtl.bundle<a: uint<1>>) {
+    // CHECK-NEXT: firrtl.connect %out_a, %in_a
+    %0 = firrtl.subfield %in(0) : (!firrtl.bundle<a: uint<1>>) -> !firrtl.uint<1>
+    %1 = firrtl.subfield %out(0) : (!firrtl.bundle<a: uint<1>>) -> !firrtl.uint<1>
+    firrtl.connect %1, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+
+  // Registers connected as a whole are kept intact too, and a register with
+  // reset needs a reset value which is kept intact.
+  // CHECK-LABEL: firrtl.module @Regs
+  firrtl.module @Regs(in %clock: !firrtl.clock, in %reset: !firrtl.uint<1>,
+                      in %in: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                      out %out: !firrtl.bundle<a: uint<1>, b: uint<2>>) {
+    // CHECK-NEXT: %r = firrtl.reg %clock {{.*}}: (!firrtl.clock) -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    // CHECK-NEXT: %rr = firrtl.regreset %clock, %reset, %in {{.*}} -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    %r = firrtl.reg %clock {name = "r"} : (!firrtl.clock) -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    %rr = firrtl.regreset %clock, %reset, %in {name = "rr"} : (!firrtl.clock, !firrtl.uint<1>, !firrtl.bundle<a: uint<1>, b: uint<2>>) -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %r, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %rr, %r : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %out, %rr : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+
+    // A register written one field at a time is split.
+    // CHECK: %s_a = firrtl.reg
+    // CHECK: %s_b = firrtl.reg
+    %s = firrtl.reg %clock {name = "s"} : (!firrtl.clock) -> !firrtl.bundle<a: uint<1>, b: uint<2>>
+    %0 = firrtl.subfield %s(0) : (!firrtl.bundle<a: uint<1>, b: uint<2>>) -> !firrtl.uint<1>
+    firrtl.connect %0, %reset : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+
+  // CHECK-LABEL: firrtl.module @Top
+  // CHECK-SAME: in %in: !firrtl.bundle<a: uint<1>, b: uint<2>>
+  // CHECK-SAME: out %out: !firrtl.bundle<a: uint<1>, b: uint<2>>
+  // CHECK-SAME: out %val: !firrtl.uint<1>
+  // CHECK-SAME: out %flip_a: !firrtl.uint<1>
+  // CHECK-SAME: in %flip_b: !firrtl.uint<1>
+  firrtl.module @Top(in %in: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                     out %out: !firrtl.bundle<a: uint<1>, b: uint<2>>,
+                     out %val: !firrtl.uint<1>,
+                     out %flip: !firrtl.bundle<a: uint<1>, b flip: uint<1>>,
+                     in %p: !firrtl.uint<1>) {
+    // CHECK-NEXT: %c_in, %c_out = firrtl.instance @Child {name = "c"} : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    // CHECK-NEXT: firrtl.connect %c_in, %in
+    // CHECK-NEXT: firrtl.connect %out, %c_out
+    %c_in, %c_out = firrtl.instance @Child {name = "c"} : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %c_in, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.connect %out, %c_out : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+
+    // Reading a field of an intact aggregate is left alone.
+    // CHECK-NEXT: [[FIELD:%.+]] = firrtl.subfield %c_out(0)
+    // CHECK-NEXT: firrtl.connect %val, [[FIELD]]
+    %0 = firrtl.subfield %c_out(0) : (!firrtl.bundle<a: uint<1>, b: uint<2>>) -> !firrtl.uint<1>
+    firrtl.connect %val, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+
+    // CHECK-NEXT: %f_in_a, %f_out_a = firrtl.instance @FieldWrite {name = "f"} : !firrtl.uint<1>, !firrtl.uint<1>
+    %f_in, %f_out = firrtl.instance @FieldWrite {name = "f"} : !firrtl.bundle<a: uint<1>>, !firrtl.bundle<a: uint<1>>
+    firrtl.connect %f_in, %f_out : !firrtl.bundle<a: uint<1>>, !firrtl.bundle<a: uint<1>>
+
+    // A wire connected from a flipped bundle, or inside a when, is split.
+    // CHECK-NOT: firrtl.wire {{.*}}: !firrtl.bundle
+    %w = firrtl.wire : !firrtl.bundle<a: uint<1>, b: uint<2>>
+    firrtl.when %p {
+      firrtl.connect %w, %in : !firrtl.bundle<a: uint<1>, b: uint<2>>, !firrtl.bundle<a: uint<1>, b: uint<2>>
+    }
+    %x = firrtl.wire : !firrtl.bundle<a: uint<1>, b flip: uint<1>>
+    firrtl.connect %flip, %x : !firrtl.bundle<a: uint<1>, b flip: uint<1>>, !firrtl.bundle<a: uint<1>, b flip: uint<1>>
+  }
+}
@@ -1,4 +1,5 @@
 // RUN: circt-opt -firrtl-print-instance-graph %s -o %t 2>&1 | FileCheck %s
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-print-instance-graph{profile=true})' %s -o %t 2>&1 | FileCheck %s --check-prefix=PROFILE
 
 // CHECK: digraph "Top"
 // CHECK:   label="Top";
@@ -11,6 +12,15 @@
 // CHECK:   [[BEAR]] [shape=record,label="{Bear}"];
 // CHECK:   [[BEAR]] -> [[CAT]][label=cat];
 
+// The modules are sorted by their flattened cost.  Cat is instantiated twice.
+// PROFILE: Module profile of "Top":
+// PROFILE-NEXT: module instances ops flat cost reg bits mem bits ops by dialect
+// PROFILE-NEXT: Cat 2 3 6 32 128 firrtl=3
+// PROFILE-NEXT: Top 1 2 2 0 0 firrtl=2
+// PROFILE-NEXT: Alligator 1 1 1 0 0 firrtl=1
+// PROFILE-NEXT: Bear 1 1 1 0 0 firrtl=1
+// PROFILE-NEXT: total 5 7 10 64 256 firrtl=7
+
 firrtl.circuit "Top" {
 
 firrtl.module @Top() {
@@ -26,6 +36,10 @@ firrtl.module @Bear() {
   firrtl.instance @Cat {name = "cat" }
 }
 
-firrtl.module @Cat() { }
+firrtl.module @Cat() {
+  %clock = firrtl.wire : !firrtl.clock
+  %r = firrtl.reg %clock : (!firrtl.clock) -> !firrtl.vector<uint<8>, 4>
+  %m_r = firrtl.mem Undefined {depth = 16 : i64, name = "m", portNames = ["r"], readLatency = 0 : i32, writeLatency = 1 : i32} : !firrtl.bundle<addr: uint<4>, en: uint<1>, clk: clock, data flip: uint<8>>
+}
 
 }
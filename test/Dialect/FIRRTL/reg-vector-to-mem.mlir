@@ -0,0 +1,99 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl.module(firrtl-reg-vector-to-mem))' -verify-diagnostics %s | FileCheck %s
+
+firrtl.circuit "RegVectorToMem" {
+
+// CHECK-LABEL: firrtl.module @RegVectorToMem
+firrtl.module @RegVectorToMem(in %clock: !firrtl.clock, in %raddr: !firrtl.uint<2>,
+                              in %waddr: !firrtl.uint<2>, in %wen: !firrtl.uint<1>,
+                              in %wdata: !firrtl.uint<8>, out %rdata: !firrtl.uint<8>,
+                              out %first: !firrtl.uint<8>) {
+  // CHECK-NOT: firrtl.reg
+  // CHECK: %regs_r0, %regs_r1, %regs_w = firrtl.mem Undefined {depth = 4 : i64, name = "regs", portNames = ["r0", "r1", "w"], readLatency = 0 : i32, writeLatency = 1 : i32}
+  // CHECK-SAME: !firrtl.bundle<addr: uint<2>, en: uint<1>, clk: clock, data flip: uint<8>>, !firrtl.bundle<addr: uint<2>, en: uint<1>, clk: clock, data flip: uint<8>>, !firrtl.bundle<addr: uint<2>, en: uint<1>, clk: clock, data: uint<8>, mask: uint<1>>
+  %regs = firrtl.reg %clock {annotations = [{class = "circt.RegVectorToMemAnnotation"}]} : (!firrtl.clock) -> !firrtl.vector<uint<8>, 4>
+
+  // The ports are clocked by the register clock, the reads are enabled and
+  // the write is not by default.
+  // CHECK: %[[CLK0:.+]] = firrtl.subfield %regs_r0(2)
+  // CHECK-NEXT: firrtl.connect %[[CLK0]], %clock
+  // CHECK: %[[EN0:.+]] = firrtl.subfield %regs_r0(1)
+  // CHECK-NEXT: firrtl.connect %[[EN0]], %c1_ui1
+  // CHECK: %[[EN1:.+]] = firrtl.subfield %regs_r1(1)
+  // CHECK-NEXT: firrtl.connect %[[EN1]], %c1_ui1
+  // CHECK: %[[WEN0:.+]] = firrtl.subfield %regs_w(1)
+  // CHECK-NEXT: firrtl.connect %[[WEN0]], %c0_ui1
+  // CHECK: %[[MASK:.+]] = firrtl.subfield %regs_w(4)
+  // CHECK-NEXT: firrtl.connect %[[MASK]], %c1_ui1
+
+  // The dynamic read.
+  // CHECK-NEXT: %[[ADDR0:.+]] = firrtl.subfield %regs_r0(0)
+  // CHECK-NEXT: firrtl.connect %[[ADDR0]], %raddr
+  // CHECK-NEXT: %[[DATA0:.+]] = firrtl.subfield %regs_r0(3)
+  // CHECK-NEXT: firrtl.connect %rdata, %[[DATA0]]
+  %0 = firrtl.subaccess %regs[%raddr] : !firrtl.vector<uint<8>, 4>, !firrtl.uint<2>
+  firrtl.connect %rdata, %0 : !firrtl.uint<8>, !firrtl.uint<8>
+
+  // The static read.
+  // CHECK-NEXT: %c0_ui2 = firrtl.constant 0
+  // CHECK-NEXT: %[[ADDR1:.+]] = firrtl.subfield %regs_r1(0)
+  // CHECK-NEXT: firrtl.connect %[[ADDR1]], %c0_ui2
+  // CHECK-NEXT: %[[DATA1:.+]] = firrtl.subfield %regs_r1(3)
+  // CHECK-NEXT: firrtl.connect %first, %[[DATA1]]
+  %1 = firrtl.subindex %regs[0] : !firrtl.vector<uint<8>, 4>
+  firrtl.connect %first, %1 : !firrtl.uint<8>, !firrtl.uint<8>
+
+  // The conditional write.
+  // CHECK-NEXT: firrtl.when %wen {
+  // CHECK-NEXT: %[[WADDR:.+]] = firrtl.subfield %regs_w(0)
+  // CHECK-NEXT: firrtl.connect %[[WADDR]], %waddr
+  // CHECK-NEXT: %[[WEN:.+]] = firrtl.subfield %regs_w(1)
+  // CHECK-NEXT: firrtl.connect %[[WEN]], %c1_ui1
+  // CHECK-NEXT: %[[WDATA:.+]] = firrtl.subfield %regs_w(3)
+  // CHECK-NEXT: firrtl.connect %[[WDATA]], %wdata
+  // CHECK-NEXT: }
+  firrtl.when %wen {
+    %2 = firrtl.subaccess %regs[%waddr] : !firrtl.vector<uint<8>, 4>, !firrtl.uint<2>
+    firrtl.connect %2, %wdata : !firrtl.uint<8>, !firrtl.uint<8>
+  }
+}
+
+// A write through an index wider than the address is only enabled in bounds.
+// CHECK-LABEL: firrtl.module @WideIndex
+firrtl.module @WideIndex(in %clock: !firrtl.clock, in %waddr: !firrtl.uint<4>,
+                         in %wdata: !firrtl.uint<8>) {
+  // CHECK: firrtl.mem Undefined {depth = 3 : i64, name = "regs", portNames = ["w"]
+  %regs = firrtl.reg %clock {annotations = [{class = "circt.RegVectorToMemAnnotation"}]} : (!firrtl.clock) -> !firrtl.vector<uint<8>, 3>
+  // CHECK: %[[INBOUNDS:.+]] = firrtl.lt %waddr, %c3_ui4
+  // CHECK-NEXT: %[[ADDR:.+]] = firrtl.bits %waddr 1 to 0
+  // CHECK: firrtl.connect {{.+}}, %[[ADDR]]
+  // CHECK: firrtl.connect {{.+}}, %[[INBOUNDS]]
+  %0 = firrtl.subaccess %regs[%waddr] : !firrtl.vector<uint<8>, 3>, !firrtl.uint<4>
+  firrtl.connect %0, %wdata : !firrtl.uint<8>, !firrtl.uint<8>
+}
+
+// Registers which don't fit are left alone with a warning.
+// CHECK-LABEL: firrtl.module @NotConverted
+firrtl.module @NotConverted(in %clock: !firrtl.clock, in %a: !firrtl.uint<2>,
+                            in %b: !firrtl.uint<2>, in %wdata: !firrtl.uint<8>,
+                            in %all: !firrtl.vector<uint<8>, 4>) {
+  // CHECK: %twice = firrtl.reg
+  // expected-warning @+1 {{register is not converted to a memory: it is written more than once}}
+  %twice = firrtl.reg %clock {annotations = [{class = "circt.RegVectorToMemAnnotation"}]} : (!firrtl.clock) -> !firrtl.vector<uint<8>, 4>
+  %0 = firrtl.subaccess %twice[%a] : !firrtl.vector<uint<8>, 4>, !firrtl.uint<2>
+  firrtl.connect %0, %wdata : !firrtl.uint<8>, !firrtl.uint<8>
+  %1 = firrtl.subaccess %twice[%b] : !firrtl.vector<uint<8>, 4>, !firrtl.uint<2>
+  firrtl.connect %1, %wdata : !firrtl.uint<8>, !firrtl.uint<8>
+
+  // CHECK: %whole = firrtl.reg
+  // expected-warning @+1 {{register is not converted to a memory: it is used other than by accessing an element}}
+  %whole = firrtl.reg %clock {annotations = [{class = "circt.RegVectorToMemAnnotation"}]} : (!firrtl.clock) -> !firrtl.vector<uint<8>, 4>
+  firrtl.connect %whole, %all : !firrtl.vector<uint<8>, 4>, !firrtl.vector<uint<8>, 4>
+
+  // Without the annotation, nothing is converted.
+  // CHECK: %plain = firrtl.reg
+  %plain = firrtl.reg %clock : (!firrtl.clock) -> !firrtl.vector<uint<8>, 4>
+  %2 = firrtl.subaccess %plain[%a] : !firrtl.vector<uint<8>, 4>, !firrtl.uint<2>
+  firrtl.connect %2, %wdata : !firrtl.uint<8>, !firrtl.uint<8>
+}
+
+}
@@ -0,0 +1,25 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-verify)' %s | FileCheck %s
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-verify)' -mlir-disable-threading %s | FileCheck %s
+
+// The verifier doesn't change a valid circuit.
+// CHECK-LABEL: firrtl.circuit "Top"
+firrtl.circuit "Top" {
+  // CHECK: firrtl.extmodule @Ext
+  firrtl.extmodule @Ext(in %in: !firrtl.uint<1>) attributes {defname = "Ext"}
+
+  // CHECK: firrtl.module @Child
+  firrtl.module @Child(in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+    firrtl.connect %out, %in : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+
+  // CHECK: firrtl.module @Top
+  // CHECK-NEXT: firrtl.instance @Child
+  // CHECK-NEXT: firrtl.instance @Ext
+  firrtl.module @Top(in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+    %c_in, %c_out = firrtl.instance @Child {name = "c"} : !firrtl.uint<1>, !firrtl.uint<1>
+    %e_in = firrtl.instance @Ext {name = "e"} : !firrtl.uint<1>
+    firrtl.connect %c_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %e_in, %c_out : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %out, %c_out : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
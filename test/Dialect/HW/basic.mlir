@@ -136,3 +136,13 @@ hw.module @signed_arrays(%arg0: si8) -> (%out: !hw.array<2xsi8>) {
   %result = sv.read_inout %wireArray : !hw.inout<!hw.array<2xsi8>>
   hw.output %result : !hw.array<2xsi8>
 }
+
+// Structs this large look up their fields in a hash table.
+// CHECK-LABEL: hw.module @largeStruct
+hw.module @largeStruct(%a: !hw.struct<f0: i1, f1: i2, f2: i3, f3: i4, f4: i5, f5: i6, f6: i7, f7: i8, f8: i9, f9: i10, f10: i11, f11: i12, f12: i13, f13: i14, f14: i15, f15: i16>) -> (i1, i16) {
+  // CHECK-NEXT: = hw.struct_extract %a["f0"] : !hw.struct<f0: i1, f1: i2, f2: i3, f3: i4, f4: i5, f5: i6, f6: i7, f7: i8, f8: i9, f9: i10, f10: i11, f11: i12, f12: i13, f13: i14, f14: i15, f15: i16>
+  %0 = hw.struct_extract %a["f0"] : !hw.struct<f0: i1, f1: i2, f2: i3, f3: i4, f4: i5, f5: i6, f6: i7, f7: i8, f8: i9, f9: i10, f10: i11, f11: i12, f12: i13, f13: i14, f14: i15, f15: i16>
+  // CHECK-NEXT: = hw.struct_extract %a["f15"] : !hw.struct<f0: i1, f1: i2, f2: i3, f3: i4, f4: i5, f5: i6, f6: i7, f7: i8, f8: i9, f9: i10, f10: i11, f11: i12, f12: i13, f13: i14, f14: i15, f15: i16>
+  %1 = hw.struct_extract %a["f15"] : !hw.struct<f0: i1, f1: i2, f2: i3, f3: i4, f4: i5, f5: i6, f6: i7, f7: i8, f8: i9, f9: i10, f10: i11, f11: i12, f12: i13, f13: i14, f14: i15, f15: i16>
+  hw.output %0, %1 : i1, i16
+}
@@ -0,0 +1,41 @@
+// RUN: circt-opt -hw-stub-external-modules=interface-only %s | FileCheck %s
+
+// CHECK-LABEL: hw.module @Top(%clk: i1, %a: i8) -> (%x: i8, %y: i8) {
+// CHECK-NEXT:    %x_i1 = sv.constantX : i1
+// CHECK-NEXT:    %child.x = hw.instance "child" @Child(%x_i1, %a) : (i1, i8) -> i8
+// CHECK-NEXT:    %[[WIRE:.+]] = sv.wire : !hw.inout<i1>
+// CHECK-NEXT:    %ext.y = hw.instance "ext" @Ext(%[[WIRE]], %child.x) : (!hw.inout<i1>, i8) -> i8
+// CHECK-NEXT:    %x_i8 = sv.constantX : i8
+// CHECK-NEXT:    hw.output %ext.y, %x_i8 : i8, i8
+// CHECK-NEXT:  }
+hw.module @Top(%clk: i1, %a: i8) -> (%x: i8, %y: i8) {
+  %c1_i8 = hw.constant 1 : i8
+  %0 = comb.add %a, %c1_i8 : i8
+  %en = comb.icmp eq %a, %c1_i8 : i8
+  %child.x = hw.instance "child" @Child(%en, %a) : (i1, i8) -> i8
+  %w = sv.wire : !hw.inout<i1>
+  sv.ifdef "SYNTHESIS" {
+  } else {
+    sv.always posedge %clk {
+      sv.fwrite "child: %d"(%child.x) : i8
+    }
+  }
+  %ext.y = hw.instance "ext" @Ext(%w, %child.x) : (!hw.inout<i1>, i8) -> i8
+  hw.output %ext.y, %0 : i8, i8
+}
+
+// CHECK-LABEL: hw.module @Child(%en: i1, %a: i8) -> (%x: i8) {
+// CHECK-NEXT:    %x_i8 = sv.constantX : i8
+// CHECK-NEXT:    hw.output %x_i8 : i8
+// CHECK-NEXT:  }
+hw.module @Child(%en: i1, %a: i8) -> (%x: i8) {
+  %0 = comb.mux %en, %a, %a : i8
+  hw.output %0 : i8
+}
+
+// The external modules are stubbed as usual.
+// CHECK-LABEL: hw.module @Ext(%io: !hw.inout<i1>, %a: i8) -> (%y: i8) {
+// CHECK-NEXT:    %x_i8 = sv.constantX : i8
+// CHECK-NEXT:    hw.output %x_i8 : i8
+// CHECK-NEXT:  }
+hw.module.extern @Ext(%io: !hw.inout<i1>, %a: i8) -> (%y: i8)
@@ -0,0 +1,22 @@
+// RUN: rm -rf %t
+// RUN: circt-translate --export-llhd-split-verilog --llhd-split-verilog-dir=%t %s
+// RUN: FileCheck %s --check-prefix=FILELIST < %t/filelist.f
+// RUN: FileCheck %s --check-prefix=FIRST < %t/first.v
+// RUN: FileCheck %s --check-prefix=SECOND < %t/second.v
+
+// FILELIST:      first.v
+// FILELIST-NEXT: second.v
+
+// FIRST:      module _first;
+// FIRST-NEXT:   wire [63:0] _{{.*}} = 64'd0;
+// FIRST-NEXT: endmodule
+llhd.entity @first () -> () {
+  %0 = llhd.const 0 : i64
+}
+
+// SECOND:      module _second(input [63:0] _{{.*}});
+// SECOND-NEXT:   _first inst_{{.*}};
+// SECOND-NEXT: endmodule
+llhd.entity @second (%arg0 : !llhd.sig<i64>) -> () {
+  llhd.inst "inst" @first () -> () : () -> ()
+}
@@ -0,0 +1,21 @@
+// REQUIRES: llhd-sim
+// RUN: printf 'Foo/toggle=0\n# Start high.\nFoo/toggle=0x1\n' > %t.batch
+// RUN: llhd-sim %s -n 3 -r Foo -batch=%t.batch -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s -n 3 -r Foo -batch=%t.batch -threads=2 -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+
+// CHECK: replica 0
+// CHECK-NEXT: 0ps 0d 0e  Foo/toggle  0x00
+// CHECK-NEXT: 1000ps 0d 0e  Foo/toggle  0x01
+// CHECK-NEXT: 2000ps 0d 0e  Foo/toggle  0x00
+// CHECK-NEXT: replica 1
+// CHECK-NEXT: 0ps 0d 0e  Foo/toggle  0x01
+// CHECK-NEXT: 1000ps 0d 0e  Foo/toggle  0x00
+// CHECK-NEXT: 2000ps 0d 0e  Foo/toggle  0x01
+llhd.entity @Foo () -> () {
+  %0 = llhd.const 0 : i1
+  %toggle = llhd.sig "toggle" %0 : i1
+  %1 = llhd.prb %toggle : !llhd.sig<i1>
+  %2 = llhd.not %1 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %toggle, %2 after %dt : !llhd.sig<i1>
+}
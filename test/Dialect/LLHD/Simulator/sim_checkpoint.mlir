@@ -0,0 +1,41 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -checkpoint-at=3000 -checkpoint-file=%t.checkpoint -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=CKPT
+// RUN: llhd-sim %s -T 5000 -restore=%t.checkpoint -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=RESTORE
+
+// CKPT: 0ps 0d 0e  root/count  0x00
+// CKPT-NEXT: 0ps 0d 0e  root/proc/count  0x00
+// CKPT-NEXT: 1000ps 0d 1e  root/count  0x01
+// CKPT-NEXT: 1000ps 0d 1e  root/proc/count  0x01
+// CKPT-NEXT: 2000ps 0d 1e  root/count  0x02
+// CKPT-NEXT: 2000ps 0d 1e  root/proc/count  0x02
+// CKPT-NOT: 3000ps
+
+// RESTORE: 2000ps 0d 1e  root/count  0x02
+// RESTORE-NEXT: 2000ps 0d 1e  root/proc/count  0x02
+// RESTORE-NEXT: 3000ps 0d 1e  root/count  0x03
+// RESTORE-NEXT: 3000ps 0d 1e  root/proc/count  0x03
+// RESTORE-NEXT: 4000ps 0d 1e  root/count  0x04
+// RESTORE-NEXT: 4000ps 0d 1e  root/proc/count  0x04
+// RESTORE-NEXT: 5000ps 0d 1e  root/count  0x05
+// RESTORE-NEXT: 5000ps 0d 1e  root/proc/count  0x05
+// RESTORE-NOT: 6000ps
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %count = llhd.sig "count" %0 : i8
+  llhd.inst "proc" @proc () -> (%count) : () -> (!llhd.sig<i8>)
+}
+
+// The next value of the counter is persisted across the wait.
+llhd.proc @proc () -> (%count : !llhd.sig<i8>) {
+  %c0 = llhd.const 0 : i8
+  br ^loop(%c0 : i8)
+^loop(%value : i8):
+  %c1 = llhd.const 1 : i8
+  %next = addi %value, %c1 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.wait for %t, ^drive(%next : i8)
+^drive(%driven : i8):
+  %e = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %count, %driven after %e : !llhd.sig<i8>
+  br ^loop(%driven : i8)
+}
@@ -0,0 +1,43 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -checkpoint-at=3000 -checkpoint-file=%t.checkpoint -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=CKPT
+// RUN: llhd-sim %s -T 5000 -restore=%t.checkpoint -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=RESTORE
+
+// CKPT: 0ps 0d 0e  root/count  0x00
+// CKPT-NEXT: 0ps 0d 0e  root/proc/count  0x00
+// CKPT-NEXT: 1000ps 0d 1e  root/count  0x01
+// CKPT-NEXT: 1000ps 0d 1e  root/proc/count  0x01
+// CKPT-NEXT: 2000ps 0d 1e  root/count  0x02
+// CKPT-NEXT: 2000ps 0d 1e  root/proc/count  0x02
+// CKPT-NOT: 3000ps
+
+// RESTORE: 2000ps 0d 1e  root/count  0x02
+// RESTORE-NEXT: 2000ps 0d 1e  root/proc/count  0x02
+// RESTORE-NEXT: 3000ps 0d 1e  root/count  0x03
+// RESTORE-NEXT: 3000ps 0d 1e  root/proc/count  0x03
+// RESTORE-NEXT: 4000ps 0d 1e  root/count  0x04
+// RESTORE-NEXT: 4000ps 0d 1e  root/proc/count  0x04
+// RESTORE-NEXT: 5000ps 0d 1e  root/count  0x05
+// RESTORE-NEXT: 5000ps 0d 1e  root/proc/count  0x05
+// RESTORE-NOT: 6000ps
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %count = llhd.sig "count" %0 : i8
+  llhd.inst "proc" @proc () -> (%count) : () -> (!llhd.sig<i8>)
+}
+
+// The slice of the counter signal is persisted across the wait, and has to
+// point to the restored signal values.
+llhd.proc @proc () -> (%count : !llhd.sig<i8>) {
+  %low = llhd.extract_slice %count, 0 : !llhd.sig<i8> -> !llhd.sig<i4>
+  %c0 = llhd.const 0 : i4
+  br ^loop(%c0 : i4)
+^loop(%value : i4):
+  %c1 = llhd.const 1 : i4
+  %next = addi %value, %c1 : i4
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.wait for %t, ^drive(%next : i4)
+^drive(%driven : i4):
+  %e = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %low, %driven after %e : !llhd.sig<i4>
+  br ^loop(%driven : i4)
+}
@@ -0,0 +1,41 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=EVENT
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -cycle-based -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=CYCLE
+
+// EVENT: 1000ps 0d 0e  root/a  0x01
+// EVENT-NEXT: 1000ps 1d 0e  root/b  0x00
+// EVENT-NEXT: 1000ps 2d 0e  root/c  0x01
+// EVENT-NEXT: 2000ps 0d 0e  root/a  0x00
+// EVENT-NEXT: 2000ps 1d 0e  root/b  0x01
+// EVENT-NEXT: 2000ps 2d 0e  root/c  0x00
+
+// The inverters are evaluated in order within the step changing their inputs.
+// CYCLE: 1000ps 0d 0e  root/a  0x01
+// CYCLE-NEXT: 1000ps 0d 0e  root/b  0x00
+// CYCLE-NEXT: 1000ps 0d 0e  root/c  0x01
+// CYCLE-NEXT: 2000ps 0d 0e  root/a  0x00
+// CYCLE-NEXT: 2000ps 0d 0e  root/b  0x01
+// CYCLE-NEXT: 2000ps 0d 0e  root/c  0x00
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %a = llhd.sig "a" %0 : i1
+  %b = llhd.sig "b" %0 : i1
+  %c = llhd.sig "c" %0 : i1
+  llhd.inst "toggle" @toggle() -> (%a) : () -> !llhd.sig<i1>
+  llhd.inst "inv0" @inv(%a) -> (%b) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+  llhd.inst "inv1" @inv(%b) -> (%c) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+}
+
+llhd.entity @toggle () -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %out : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
+
+llhd.entity @inv (%in : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
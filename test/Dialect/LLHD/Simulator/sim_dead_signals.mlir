@@ -0,0 +1,44 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -eliminate-dead-signals=false -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s --trace-format=reduced -dump-layout -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s --check-prefix=REDUCED
+// RUN: llhd-sim %s --trace-format=full -dump-layout -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s --check-prefix=FULL
+
+// CHECK: 0ps 0d 0e  root/a  0x00
+// CHECK-NEXT: 1000ps 0d 0e  root/a  0x01
+// CHECK-NEXT: 2000ps 0d 0e  root/a  0x00
+
+// The inverter only drives a signal of its parent, which is not traced.
+// REDUCED: ---path: root/toggle
+// REDUCED-NOT: ---path: root/shadow
+// REDUCED: Signal information
+
+// FULL: ---path: root/toggle
+// FULL: ---path: root/shadow
+// FULL: ---path: root/shadow/inv
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %a = llhd.sig "a" %0 : i1
+  llhd.inst "toggle" @toggle() -> (%a) : () -> !llhd.sig<i1>
+  llhd.inst "shadow" @shadow(%a) -> () : (!llhd.sig<i1>) -> ()
+}
+
+llhd.entity @toggle () -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %out : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
+
+llhd.entity @shadow (%in : !llhd.sig<i1>) -> () {
+  %0 = llhd.const 0 : i1
+  %c = llhd.sig "c" %0 : i1
+  llhd.inst "inv" @inv(%in) -> (%c) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+}
+
+llhd.entity @inv (%in : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
@@ -0,0 +1,48 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s -T 2000 --trace-format=reduced -fuse-entities -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s --trace-format=full -fuse-entities -dump-layout -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s --check-prefix=LAYOUT
+
+// CHECK: 0ps 1d 0e  root/b  0x01
+// CHECK-NEXT: 1000ps 0d 0e  root/a  0x01
+// CHECK-NEXT: 1000ps 1d 0e  root/b  0x00
+// CHECK-NEXT: 1000ps 1d 0e  root/c  0x01
+// CHECK-NEXT: 2000ps 0d 0e  root/a  0x00
+// CHECK-NEXT: 2000ps 1d 0e  root/b  0x01
+// CHECK-NEXT: 2000ps 1d 0e  root/c  0x00
+
+// Both halves of the decoder are sensitive to the same signals, and are run
+// as a single instance.
+// LAYOUT: ---path: root/toggle
+// LAYOUT: ---path: root/lo
+// LAYOUT-NOT: ---path: root/hi
+// LAYOUT: Signal information
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %a = llhd.sig "a" %0 : i1
+  %b = llhd.sig "b" %0 : i1
+  %c = llhd.sig "c" %0 : i1
+  llhd.inst "toggle" @toggle() -> (%a) : () -> !llhd.sig<i1>
+  llhd.inst "lo" @lo(%a) -> (%b, %c) : (!llhd.sig<i1>) -> (!llhd.sig<i1>, !llhd.sig<i1>)
+  llhd.inst "hi" @hi(%a) -> (%b, %c) : (!llhd.sig<i1>) -> (!llhd.sig<i1>, !llhd.sig<i1>)
+}
+
+llhd.entity @toggle () -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %out : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
+
+llhd.entity @lo (%in : !llhd.sig<i1>) -> (%lo : !llhd.sig<i1>, %hi : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %lo, %1 after %dt : !llhd.sig<i1>
+}
+
+llhd.entity @hi (%in : !llhd.sig<i1>) -> (%lo : !llhd.sig<i1>, %hi : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %hi, %0 after %dt : !llhd.sig<i1>
+}
@@ -0,0 +1,16 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -r Foo -emit-object=%t.o
+// RUN: llvm-nm %t.o | FileCheck %s
+
+// CHECK-DAG: T Foo
+// CHECK-DAG: T llhd_init
+// CHECK-DAG: U allocSignal
+// CHECK-DAG: U driveSignal
+llhd.entity @Foo () -> () {
+  %0 = llhd.const 0 : i1
+  %toggle = llhd.sig "toggle" %0 : i1
+  %1 = llhd.prb %toggle : !llhd.sig<i1>
+  %2 = llhd.not %1 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %toggle, %2 after %dt : !llhd.sig<i1>
+}
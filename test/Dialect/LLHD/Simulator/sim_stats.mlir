@@ -0,0 +1,34 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -n 10 -r Foo -sim-stats -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 >/dev/null | FileCheck %s
+// RUN: llhd-sim %s -n 10 -r Foo -sim-stats-json=%t.json -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext && FileCheck %s --check-prefix=JSON < %t.json
+
+// CHECK: ... Simulation Statistics ...
+// CHECK: Steps: 10 (10 real-time steps)
+// CHECK-NEXT: Drives applied: 9
+// CHECK-NEXT: Signal changes: 9
+// CHECK-NEXT: Scheduled wakeups: 0
+// CHECK-NEXT: Unit activations: 10
+// CHECK: Trace bytes: {{[1-9][0-9]*}}
+// CHECK: Steps per real-time step:
+// CHECK-NEXT: 1 - 1 10
+// CHECK: Queue depth:
+// CHECK-NEXT: 1 - 1 10
+// CHECK: Activations per unit:
+// CHECK-NEXT: 10 Foo
+
+// JSON: "steps": 10,
+// JSON-NEXT: "realTimeSteps": 10,
+// JSON-NEXT: "drives": 9,
+// JSON-NEXT: "signalChanges": 9,
+// JSON-NEXT: "wakeups": 0,
+// JSON-NEXT: "activations": 10,
+// JSON: "unitActivations": {
+// JSON-NEXT: "Foo": 10
+llhd.entity @Foo () -> () {
+  %0 = llhd.const 0 : i1
+  %toggle = llhd.sig "toggle" %0 : i1
+  %1 = llhd.prb %toggle : !llhd.sig<i1>
+  %2 = llhd.not %1 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %toggle, %2 after %dt : !llhd.sig<i1>
+}
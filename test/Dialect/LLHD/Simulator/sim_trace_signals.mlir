@@ -0,0 +1,34 @@
+// REQUIRES: llhd-sim
+// RUN: printf 'root/*\n# Leave out the numbered signals.\n!root/[0-9]*\n' > %t.filter
+// RUN: llhd-sim %s -T 2000 -trace-signals=%t.filter -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: printf '!*/s\n' > %t.exclude
+// RUN: llhd-sim %s -T 2000 --trace-format=merged -trace-signals=%t.exclude -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=EXCLUDE
+
+// CHECK-NOT: root/1
+// CHECK: 0ps 0d 0e  root/foo/s  0x01
+// CHECK-NEXT: 0ps 0d 0e  root/s  0x01
+// CHECK-NEXT: 0ps 0d 1e  root/foo/s  0x02
+// CHECK-NEXT: 0ps 0d 1e  root/s  0x02
+// CHECK-NOT: root/1
+
+// EXCLUDE: 0ps
+// EXCLUDE-NEXT:   root/1  0x01
+// EXCLUDE-NOT: root/s
+// EXCLUDE-NOT: root/foo/s
+llhd.entity @root () -> () {
+  %0 = llhd.const 1 : i8
+  %s = llhd.sig "s" %0 : i8
+  %1 = llhd.sig "1" %0 : i8
+  llhd.inst "foo" @foo () -> (%s) : () -> (!llhd.sig<i8>)
+}
+
+llhd.proc @foo () -> (%s : !llhd.sig<i8>) {
+  br ^entry
+^entry:
+  %1 = llhd.prb %s : !llhd.sig<i8>
+  %2 = addi %1, %1 : i8
+  %t0 = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %s, %2 after %t0 : !llhd.sig<i8>
+  %t1 = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.wait for %t1, ^entry
+}
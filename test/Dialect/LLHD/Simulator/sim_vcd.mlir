@@ -0,0 +1,54 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 -vcd -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s
+// RUN: llhd-sim %s -T 2000 -vcd --trace-format=named-only -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=NAMED
+
+// CHECK:      $timescale 1ps $end
+// CHECK-NEXT: $scope module root $end
+// CHECK-NEXT: $var wire 8 " s $end
+// CHECK-NEXT: $var wire 8 # 1 $end
+// CHECK-NEXT: $scope module foo $end
+// CHECK-NEXT: $var wire 8 ! s $end
+// CHECK-NEXT: $upscope $end
+// CHECK-NEXT: $upscope $end
+// CHECK-NEXT: $enddefinitions $end
+// CHECK-NEXT: #0
+// CHECK-NEXT: b11 !
+// CHECK-NEXT: b11 "
+// CHECK-NEXT: b1 #
+// CHECK-NEXT: #1000
+// CHECK-NEXT: b1001 !
+// CHECK-NEXT: b1001 "
+// CHECK-NEXT: #2000
+// CHECK-NEXT: b11011 !
+// CHECK-NEXT: b11011 "
+
+// NAMED:      $timescale 1ps $end
+// NAMED-NEXT: $scope module root $end
+// NAMED-NEXT: $var wire 8 ! s $end
+// NAMED-NEXT: $upscope $end
+// NAMED-NEXT: $enddefinitions $end
+// NAMED-NEXT: #0
+// NAMED-NEXT: b11 !
+// NAMED-NEXT: #1000
+// NAMED-NEXT: b1001 !
+
+llhd.entity @root () -> () {
+  %0 = llhd.const 1 : i8
+  %s = llhd.sig "s" %0 : i8
+  %1 = llhd.sig "1" %0 : i8
+  llhd.inst "foo" @foo () -> (%s) : () -> (!llhd.sig<i8>)
+}
+
+llhd.proc @foo () -> (%s : !llhd.sig<i8>) {
+  br ^entry
+^entry:
+  %1 = llhd.prb %s : !llhd.sig<i8>
+  %2 = addi %1, %1 : i8
+  %t0 = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %s, %2 after %t0 : !llhd.sig<i8>
+  %3 = addi %2, %1 : i8
+  %t1 = llhd.const #llhd.time<0ns, 0d, 2e> : !llhd.time
+  llhd.drv %s, %3 after %t1 : !llhd.sig<i8>
+  %t2= llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.wait for %t2, ^entry
+}
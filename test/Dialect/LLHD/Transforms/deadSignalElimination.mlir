@@ -0,0 +1,88 @@
+// RUN: circt-opt %s -llhd-dead-signal-elimination | FileCheck %s
+// RUN: circt-opt %s -llhd-dead-signal-elimination="named-only=true" | FileCheck %s --check-prefix=NAMED
+
+// CHECK-LABEL: llhd.entity @root
+// CHECK-NEXT:    llhd.const
+// CHECK-NEXT:    %[[OUT:.*]] = llhd.sig "out"
+// CHECK-NEXT:    %[[TMP:.*]] = llhd.sig "0"
+// CHECK-NEXT:    %[[IN:.*]] = llhd.sig "in"
+// CHECK-NEXT:    llhd.inst "gen" @gen() -> (%[[IN]])
+// CHECK-NEXT:    llhd.inst "pass" @pass(%[[IN]]) -> (%[[OUT]])
+// CHECK-NEXT:    llhd.inst "keep" @pass(%[[IN]]) -> (%[[TMP]])
+// CHECK-NEXT:    llhd.inst "user" @user(%[[IN]]) -> ()
+// CHECK-NEXT:  }
+
+// The unnamed root signal is not observable with named-only, which leaves the
+// instance driving it dead.
+// NAMED-LABEL: llhd.entity @root
+// NAMED-NOT:     llhd.sig "0"
+// NAMED-NOT:     "keep"
+// NAMED:         llhd.inst "user"
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %out = llhd.sig "out" %0 : i8
+  %tmp = llhd.sig "0" %0 : i8
+  %in = llhd.sig "in" %0 : i8
+  llhd.inst "gen" @gen() -> (%in) : () -> !llhd.sig<i8>
+  llhd.inst "pass" @pass(%in) -> (%out) : (!llhd.sig<i8>) -> !llhd.sig<i8>
+  llhd.inst "keep" @pass(%in) -> (%tmp) : (!llhd.sig<i8>) -> !llhd.sig<i8>
+  llhd.inst "dead" @hidden(%in) -> () : (!llhd.sig<i8>) -> ()
+  llhd.inst "user" @user(%in) -> () : (!llhd.sig<i8>) -> ()
+}
+
+// CHECK-LABEL: llhd.proc @gen
+// CHECK:         llhd.drv
+llhd.proc @gen () -> (%out : !llhd.sig<i8>) {
+  br ^loop
+^loop:
+  %0 = llhd.prb %out : !llhd.sig<i8>
+  %1 = llhd.const 1 : i8
+  %2 = addi %0, %1 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %out, %2 after %t : !llhd.sig<i8>
+  llhd.wait for %t, ^loop
+}
+
+// Only the drive of the live output is kept, along with the probe feeding it.
+// CHECK-LABEL: llhd.entity @pass
+// CHECK-NEXT:    %[[V:.*]] = llhd.prb %{{.*}}
+// CHECK-NEXT:    llhd.const
+// CHECK-NEXT:    llhd.drv %{{.*}}, %[[V]]
+// CHECK-NEXT:  }
+llhd.entity @pass (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %t = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %0 after %t : !llhd.sig<i8>
+  %1 = llhd.const 0 : i8
+  %unused = llhd.sig "unused" %1 : i8
+  %2 = llhd.not %0 : i8
+  llhd.drv %unused, %2 after %t : !llhd.sig<i8>
+}
+
+// The entities only instantiated by dead instances are removed.
+// CHECK-NOT: @hidden
+// CHECK-NOT: @sink
+llhd.entity @hidden (%in : !llhd.sig<i8>) -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  llhd.inst "sink" @sink(%in) -> (%s) : (!llhd.sig<i8>) -> !llhd.sig<i8>
+}
+
+llhd.entity @sink (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %t = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %0 after %t : !llhd.sig<i8>
+}
+
+// Function calls may have side effects, the calling units are kept.
+// CHECK-LABEL: llhd.proc @user
+// CHECK:         call @report
+llhd.proc @user (%in : !llhd.sig<i8>) -> () {
+  br ^loop
+^loop:
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  call @report(%0) : (i8) -> ()
+  llhd.wait (%in : !llhd.sig<i8>), ^loop
+}
+
+func private @report(i8)
@@ -0,0 +1,69 @@
+// RUN: circt-opt %s -llhd-fuse-entities | FileCheck %s
+
+// The fused entity runs the bodies of the instantiated ones in order. The
+// outputs of any of them are its outputs.
+// CHECK-LABEL: llhd.entity @and_fused
+// CHECK-SAME:    (%[[A:.*]] : !llhd.sig<i1>) -> (%[[B:.*]] : !llhd.sig<i1>, %[[C:.*]] : !llhd.sig<i1>) {
+// CHECK-NEXT:    %[[PA:.*]] = llhd.prb %[[A]]
+// CHECK-NEXT:    %[[PB:.*]] = llhd.prb %[[B]]
+// CHECK-NEXT:    %[[AND:.*]] = llhd.and %[[PA]], %[[PB]]
+// CHECK-NEXT:    %[[DT:.*]] = llhd.const
+// CHECK-NEXT:    llhd.drv %[[C]], %[[AND]] after %[[DT]]
+// CHECK-NEXT:    %[[PC:.*]] = llhd.prb %[[C]]
+// CHECK-NEXT:    %[[PA2:.*]] = llhd.prb %[[A]]
+// CHECK-NEXT:    %[[AND2:.*]] = llhd.and %[[PC]], %[[PA2]]
+// CHECK-NEXT:    %[[DT2:.*]] = llhd.const
+// CHECK-NEXT:    llhd.drv %[[B]], %[[AND2]] after %[[DT2]]
+// CHECK-NEXT:  }
+
+// Only the instances bound to the same set of signals are fused.
+// CHECK-LABEL: llhd.entity @root
+// CHECK-NEXT:    %[[C0:.*]] = llhd.const 0 : i1
+// CHECK-NEXT:    %[[A:.*]] = llhd.sig "a"
+// CHECK-NEXT:    %[[B:.*]] = llhd.sig "b"
+// CHECK-NEXT:    %[[C:.*]] = llhd.sig "c"
+// CHECK-NEXT:    llhd.inst "x" @and_fused(%[[A]]) -> (%[[B]], %[[C]])
+// CHECK-NEXT:    llhd.inst "z" @inv(%[[B]]) -> (%[[C]])
+// CHECK-NEXT:    llhd.inst "w" @holder(%[[A]]) -> (%[[B]])
+// CHECK-NEXT:    llhd.inst "v" @holder(%[[A]]) -> (%[[B]])
+// CHECK-NEXT:  }
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %a = llhd.sig "a" %0 : i1
+  %b = llhd.sig "b" %0 : i1
+  %c = llhd.sig "c" %0 : i1
+  llhd.inst "x" @and(%a, %b) -> (%c) : (!llhd.sig<i1>, !llhd.sig<i1>) -> !llhd.sig<i1>
+  llhd.inst "y" @and(%c, %a) -> (%b) : (!llhd.sig<i1>, !llhd.sig<i1>) -> !llhd.sig<i1>
+  // Sensitive to b and c only.
+  llhd.inst "z" @inv(%b) -> (%c) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+  // Entities holding signals are sensitive to them as well.
+  llhd.inst "w" @holder(%a) -> (%b) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+  llhd.inst "v" @holder(%a) -> (%b) : (!llhd.sig<i1>) -> !llhd.sig<i1>
+}
+
+// The instantiated entities are kept.
+// CHECK-LABEL: llhd.entity @and (
+llhd.entity @and (%x : !llhd.sig<i1>, %y : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %x : !llhd.sig<i1>
+  %1 = llhd.prb %y : !llhd.sig<i1>
+  %2 = llhd.and %0, %1 : i1
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %2 after %dt : !llhd.sig<i1>
+}
+
+// CHECK-LABEL: llhd.entity @inv
+llhd.entity @inv (%in : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
+
+// CHECK-LABEL: llhd.entity @holder
+llhd.entity @holder (%in : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.const 0 : i1
+  %s = llhd.sig "s" %0 : i1
+  %1 = llhd.prb %in : !llhd.sig<i1>
+  %dt = llhd.const #llhd.time<0ns, 1d, 0e> : !llhd.time
+  llhd.drv %out, %1 after %dt : !llhd.sig<i1>
+}
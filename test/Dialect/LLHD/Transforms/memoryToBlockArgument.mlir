@@ -371,3 +371,30 @@ llhd.proc @more_complicated() -> () {
   %res11 = llhd.not %ld11 : i8
   llhd.halt
 }
+
+// The variable is not read after the join point, it gets no block argument.
+// CHECK-LABEL:   llhd.proc @dead_after_join() -> () {
+// CHECK:           %[[VAL_0:.*]] = llhd.const 5 : i32
+// CHECK:           %[[VAL_1:.*]] = llhd.const true : i1
+// CHECK:           cond_br %[[VAL_1]], ^bb1, ^bb2
+// CHECK:         ^bb1:
+// CHECK:           %[[VAL_2:.*]] = llhd.const 6 : i32
+// CHECK:           %[[VAL_3:.*]] = llhd.not %[[VAL_2]] : i32
+// CHECK:           br ^bb2
+// CHECK:         ^bb2:
+// CHECK-NEXT:      llhd.halt
+// CHECK:         }
+llhd.proc @dead_after_join() -> () {
+  %c5 = llhd.const 5 : i32
+  %cond = llhd.const 1 : i1
+  %ptr = llhd.var %c5 : i32
+  cond_br %cond, ^bb1, ^bb2
+^bb1:
+  %c6 = llhd.const 6 : i32
+  llhd.store %ptr, %c6 : !llhd.ptr<i32>
+  %ld = llhd.load %ptr : !llhd.ptr<i32>
+  %res = llhd.not %ld : i32
+  br ^bb2
+^bb2:
+  llhd.halt
+}
@@ -0,0 +1,91 @@
+// RUN: circt-opt %s -llhd-probe-coalescing | FileCheck %s
+
+// CHECK-LABEL: llhd.entity @entity
+// CHECK-SAME:    (%[[IN:.*]] : !llhd.sig<i8>) -> (%[[OUT:.*]] : !llhd.sig<i8>) {
+// CHECK-NEXT:    %[[TIME:.*]] = llhd.const
+// CHECK-NEXT:    %[[PRB:.*]] = llhd.prb %[[IN]] : !llhd.sig<i8>
+// CHECK-NEXT:    %[[SUM:.*]] = addi %[[PRB]], %[[PRB]] : i8
+// CHECK-NEXT:    llhd.drv %[[OUT]], %[[SUM]] after %[[TIME]] : !llhd.sig<i8>
+// CHECK-NEXT:  }
+llhd.entity @entity (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.prb %in : !llhd.sig<i8>
+  %2 = addi %0, %1 : i8
+  llhd.drv %out, %2 after %t : !llhd.sig<i8>
+}
+
+// The probes in both branches are hoisted to the entry of their temporal
+// region.
+// CHECK-LABEL: llhd.proc @hoist_branches
+// CHECK-SAME:    (%[[SIG:.*]] : !llhd.sig<i32>, %[[COND:.*]] : !llhd.sig<i1>) -> (%[[OUT:.*]] : !llhd.sig<i32>) {
+// CHECK:       ^bb1:
+// CHECK-NEXT:    %[[PRB:.*]] = llhd.prb %[[SIG]] : !llhd.sig<i32>
+// CHECK-NEXT:    %[[C:.*]] = llhd.prb %[[COND]] : !llhd.sig<i1>
+// CHECK-NEXT:    cond_br %[[C]], ^bb2, ^bb3
+// CHECK:       ^bb2:
+// CHECK-NEXT:    llhd.drv %[[OUT]], %[[PRB]] after %{{.*}} : !llhd.sig<i32>
+// CHECK:       ^bb3:
+// CHECK-NEXT:    llhd.drv %[[OUT]], %[[PRB]] after %{{.*}} : !llhd.sig<i32>
+llhd.proc @hoist_branches (%sig : !llhd.sig<i32>, %cond : !llhd.sig<i1>) -> (%out : !llhd.sig<i32>) {
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  br ^bb1
+^bb1:
+  %c = llhd.prb %cond : !llhd.sig<i1>
+  cond_br %c, ^bb2, ^bb3
+^bb2:
+  %0 = llhd.prb %sig : !llhd.sig<i32>
+  llhd.drv %out, %0 after %t : !llhd.sig<i32>
+  br ^bb4
+^bb3:
+  %1 = llhd.prb %sig : !llhd.sig<i32>
+  llhd.drv %out, %1 after %t : !llhd.sig<i32>
+  br ^bb4
+^bb4:
+  llhd.wait (%sig, %cond : !llhd.sig<i32>, !llhd.sig<i1>), ^bb1
+}
+
+// The probes in different temporal regions are kept.
+// CHECK-LABEL: llhd.proc @separate_regions
+// CHECK:         llhd.prb
+// CHECK:         llhd.wait
+// CHECK:         llhd.prb
+// CHECK:         llhd.halt
+llhd.proc @separate_regions (%sig : !llhd.sig<i32>) -> (%out : !llhd.sig<i32>) {
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  br ^bb1
+^bb1:
+  %0 = llhd.prb %sig : !llhd.sig<i32>
+  llhd.drv %out, %0 after %t : !llhd.sig<i32>
+  llhd.wait (%sig : !llhd.sig<i32>), ^bb2
+^bb2:
+  %1 = llhd.prb %sig : !llhd.sig<i32>
+  llhd.drv %out, %1 after %t : !llhd.sig<i32>
+  llhd.halt
+}
+
+// A subsignal defined after the entry of the region is not hoisted, but its
+// dominated probes are replaced.
+// CHECK-LABEL: llhd.proc @dominated
+// CHECK:       ^bb2:
+// CHECK-NEXT:    %[[SUB:.*]] = llhd.extract_slice
+// CHECK-NEXT:    %[[PRB:.*]] = llhd.prb %[[SUB]] : !llhd.sig<i8>
+// CHECK-NEXT:    br ^bb3
+// CHECK:       ^bb3:
+// CHECK-NEXT:    llhd.drv %{{.*}}, %[[PRB]] after %{{.*}} : !llhd.sig<i8>
+// CHECK-NOT:     llhd.prb
+// CHECK:         llhd.wait
+llhd.proc @dominated (%sig : !llhd.sig<i32>) -> (%out : !llhd.sig<i8>) {
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  br ^bb1
+^bb1:
+  br ^bb2
+^bb2:
+  %sub = llhd.extract_slice %sig, 0 : !llhd.sig<i32> -> !llhd.sig<i8>
+  %0 = llhd.prb %sub : !llhd.sig<i8>
+  br ^bb3
+^bb3:
+  %1 = llhd.prb %sub : !llhd.sig<i8>
+  llhd.drv %out, %1 after %t : !llhd.sig<i8>
+  llhd.wait (%sig : !llhd.sig<i32>), ^bb1
+}
@@ -39,3 +39,14 @@ hw.module @top() {
   hw.instance "bar1" @bar() : () -> ()
   hw.instance "bar2" @bar() : () -> ()
 }
+
+// -----
+
+hw.module.extern @Foo()
+
+hw.module @top() {
+  // expected-note @+1 {{other placement is here}}
+  hw.instance "foo1" @Foo() {"loc:memBank" = #msft.physloc<M20K, 3, 7, 0> } : () -> ()
+  // expected-error @+1 {{Could not place '$parent|foo2|memBank' since its location is already occupied by '$parent|foo1|memBank'}}
+  hw.instance "foo2" @Foo() {"loc:memBank" = #msft.physloc<M20K, 3, 7, 0> } : () -> ()
+}
@@ -274,3 +274,109 @@ hw.module @alwayscomb_basic(%a: i1, %b: i1) -> (%x: i1, %y: i1) {
 
   hw.output %out1, %out2 : i1, i1
 }
+
+// CHECK-LABEL: hw.module @ifdef_nested(%arg0: i1) {
+// CHECK-NEXT:    sv.ifdef "SYNTHESIS" {
+// CHECK-NEXT:      sv.verbatim "A"
+// CHECK-NEXT:      sv.verbatim "C"
+// CHECK-NEXT:    } else {
+// CHECK-NEXT:      sv.initial {
+// CHECK-NEXT:        sv.ifdef.procedural "RANDOMIZE_REG_INIT" {
+// CHECK-NEXT:          sv.fwrite "B"
+// CHECK-NEXT:          sv.fwrite "D"
+// CHECK-NEXT:        }
+// CHECK-NEXT:      }
+// CHECK-NEXT:    }
+// CHECK-NEXT:    hw.output
+// CHECK-NEXT:  }
+hw.module @ifdef_nested(%arg0: i1) {
+  sv.ifdef "SYNTHESIS" {
+    sv.ifdef "SYNTHESIS" {
+      sv.verbatim "A"
+    } else {
+      sv.verbatim "never"
+    }
+  } else {
+    sv.initial {
+      sv.ifdef.procedural "SYNTHESIS" {
+        sv.fwrite "never"
+      } else {
+        sv.ifdef.procedural "RANDOMIZE_REG_INIT" {
+          sv.fwrite "B"
+        }
+      }
+    }
+  }
+  sv.ifdef "SYNTHESIS" {
+    sv.verbatim "C"
+  } else {
+    sv.initial {
+      sv.ifdef.procedural "RANDOMIZE_REG_INIT" {
+        sv.ifdef.procedural "RANDOMIZE_REG_INIT" {
+          sv.fwrite "D"
+        }
+      }
+    }
+  }
+  hw.output
+}
+
+// Ifdefs which may change macros don't tell anything about their regions.
+// CHECK-LABEL: hw.module @ifdef_nested_define(%arg0: i1) {
+// CHECK-NEXT:    sv.ifdef "FOO" {
+// CHECK-NEXT:      sv.verbatim "`undef FOO"
+// CHECK-NEXT:      sv.ifdef "FOO" {
+// CHECK-NEXT:        sv.verbatim "A"
+// CHECK-NEXT:      }
+// CHECK-NEXT:    }
+hw.module @ifdef_nested_define(%arg0: i1) {
+  sv.ifdef "FOO" {
+    sv.verbatim "`undef FOO"
+    sv.ifdef "FOO" {
+      sv.verbatim "A"
+    }
+  }
+  hw.output
+}
+
+// Validates that results whose bits are all known are replaced with constants.
+// CHECK-LABEL: hw.module @knownBitsFold
+// CHECK-DAG: [[ZERO:%.+]] = hw.constant 0 : i4
+// CHECK-DAG: [[FALSE:%.+]] = hw.constant false
+// CHECK-DAG: [[TRUE:%.+]] = hw.constant true
+// CHECK-NOT: comb.extract
+// CHECK-NOT: comb.icmp
+// CHECK: hw.output [[ZERO]], [[FALSE]], [[TRUE]] : i4, i1, i1
+hw.module @knownBitsFold(%arg0: i8) -> (%o1: i4, %o2: i1, %o3: i1) {
+  %c-16_i8 = hw.constant -16 : i8
+  %c1_i8 = hw.constant 1 : i8
+  %c0_i8 = hw.constant 0 : i8
+  %0 = comb.and %arg0, %c-16_i8 : i8
+  %1 = comb.extract %0 from 0 : (i8) -> i4
+  %2 = comb.or %arg0, %c1_i8 : i8
+  %3 = comb.icmp eq %2, %c0_i8 : i8
+  %4 = comb.icmp ne %2, %c0_i8 : i8
+  hw.output %1, %3, %4 : i4, i1, i1
+}
+
+// Validates that masks which only touch bits already known or never used are
+// removed.
+// CHECK-LABEL: hw.module @knownBitsMask
+// CHECK: [[CONCAT:%.+]] = comb.concat %c0_i4, %arg0 : (i4, i4) -> i8
+// CHECK-NOT: comb.and
+// CHECK-NOT: comb.or
+// CHECK: [[LOW1:%.+]] = comb.extract %arg1 from 0 : (i8) -> i4
+// CHECK-NEXT: [[LOW2:%.+]] = comb.extract %arg1 from 0 : (i8) -> i4
+// CHECK-NEXT: hw.output [[CONCAT]], [[LOW1]], [[LOW2]] : i8, i4, i4
+hw.module @knownBitsMask(%arg0: i4, %arg1: i8) -> (%o1: i8, %o2: i4, %o3: i4) {
+  %c0_i4 = hw.constant 0 : i4
+  %c15_i8 = hw.constant 15 : i8
+  %c-16_i8 = hw.constant -16 : i8
+  %0 = comb.concat %c0_i4, %arg0 : (i4, i4) -> i8
+  %1 = comb.and %0, %c15_i8 : i8
+  %2 = comb.and %arg1, %c15_i8 : i8
+  %3 = comb.extract %2 from 0 : (i8) -> i4
+  %4 = comb.or %arg1, %c-16_i8 : i8
+  %5 = comb.extract %4 from 0 : (i8) -> i4
+  hw.output %1, %3, %5 : i8, i4, i4
+}
@@ -1,4 +1,13 @@
 // RUN:  circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=echo generator-executable-arguments=file1.v,file2.v,file3.v,file4.v ' %s | FileCheck %s
+// RUN:  circt-opt -mlir-disable-threading -hw-generator-callout='schema-name=Schema_Name generator-executable=echo generator-executable-arguments=file1.v,file2.v,file3.v,file4.v ' %s | FileCheck %s
+
+// The outputs recorded in the cache directory are reused by later runs.
+// RUN:  rm -rf %t.cache
+// RUN:  circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=echo generator-executable-arguments=file1.v,file2.v,file3.v,file4.v cache-dir=%t.cache jobs=2' %s | FileCheck %s
+// RUN:  cat %t.cache/* | FileCheck %s --check-prefix=CACHE
+// RUN:  circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=echo generator-executable-arguments=file1.v,file2.v,file3.v,file4.v cache-dir=%t.cache' %s | FileCheck %s
+
+// CACHE: file1.v,file2.v,file3.v,file4.v --moduleName sampleModuleName --port1 10 --port2 2
 
 module attributes {firrtl.mainModule = "top_mod"}  {
   hw.generator.schema @SchemaVar, "Schema_Name", ["port1", "port2"]
@@ -1,4 +1,5 @@
 // RUN: circt-opt -hw-memory-sim %s | FileCheck %s
+// RUN: circt-opt -hw-memory-sim='randomize-init=true readmem-init=true' %s | FileCheck %s --check-prefix=INIT
 
 hw.generator.schema @FIRRTLMem, "FIRRTL_Memory", ["depth", "numReadPorts", "numWritePorts", "numReadWritePorts", "readLatency", "writeLatency", "width", "readUnderWrite"]
 
@@ -18,6 +19,22 @@ hw.module @simple(%clock: i1, %reset: i1, %r0en: i1, %mode: i1, %data0: i16) ->
   hw.output %tmp41.ro_data_0, %tmp41.rw_rdata_0 : i16, i16
 }
 
+// INIT:      sv.ifdef "RANDOM" {
+// INIT-NEXT: } else {
+// INIT-NEXT:   sv.verbatim "`define RANDOM {$random}"
+// INIT-NEXT: }
+// INIT-NEXT: hw.module @FIRRTLMem_1_1_1_16_10_0_1_0
+// INIT:        sv.ifdef "SYNTHESIS" {
+// INIT-NEXT:   } else {
+// INIT-NEXT:     sv.initial {
+// INIT-NEXT:       sv.ifdef.procedural "RANDOMIZE_MEM_INIT" {
+// INIT-NEXT:         sv.verbatim "for (integer i = 0; i < 10; i = i + 1)\0A  {{[{][{]0[}][}]}}[i] = {`RANDOM};"(%Memory) : !hw.inout<uarray<10xi16>>
+// INIT-NEXT:       }
+// INIT-NEXT:       sv.verbatim "$readmemh(\22FIRRTLMem_1_1_1_16_10_0_1_0.hex\22, {{[{][{]0[}][}]}});"(%Memory) : !hw.inout<uarray<10xi16>>
+// INIT-NEXT:     }
+// INIT-NEXT:   }
+// INIT-NEXT:   hw.output
+
 hw.module.generated @FIRRTLMem_1_1_1_16_10_0_1_0, @FIRRTLMem(%ro_clock_0: i1, %ro_en_0: i1, %ro_addr_0: i4, %rw_clock_0: i1, %rw_en_0: i1, %rw_addr_0: i4, %rw_wmode_0: i1, %rw_wmask_0: i1, %rw_wdata_0: i16, %wo_clock_0: i1, %wo_en_0: i1, %wo_addr_0: i4, %wo_mask_0: i1, %wo_data_0: i16) -> (%ro_data_0: i16, %rw_rdata_0: i16) attributes {depth = 10 : i64, numReadPorts = 1 : ui32, numReadWritePorts = 1 : ui32, numWritePorts = 1 : ui32, readLatency = 0 : ui32, readUnderWrite = 0 : ui32, width = 16 : ui32, writeLatency = 1 : ui32}
 
 //CHECK-LABEL: @FIRRTLMem_1_1_1_16_10_0_1_0
@@ -80,3 +97,11 @@ hw.module.generated @FIRRTLMem_1_1_1_16_10_2_4_0, @FIRRTLMem(%ro_clock_0: i1, %r
 //CHECK-NEXT:    }
 //CHECK-NEXT:    %7 = sv.read_inout %6 : !hw.inout<i4>
 //CHECK-NEXT:    %8 = sv.array_index_inout %Memory[%7] : !hw.inout<uarray<10xi16>>, i4
+
+hw.module.generated @FIRRTLMem_1_0_0_40_4_0_1_0, @FIRRTLMem(%ro_clock_0: i1, %ro_en_0: i1, %ro_addr_0: i2) -> (%ro_data_0: i40) attributes {depth = 4 : i64, numReadPorts = 1 : ui32, numReadWritePorts = 0 : ui32, numWritePorts = 0 : ui32, readLatency = 0 : ui32, readUnderWrite = 0 : ui32, width = 40 : ui32, writeLatency = 1 : ui32}
+
+// Wide elements are filled with several random values at once, and `RANDOM is
+// only defined once.
+// INIT-NOT:  sv.ifdef "RANDOM"
+// INIT-LABEL: hw.module @FIRRTLMem_1_0_0_40_4_0_1_0
+// INIT:       sv.verbatim "for (integer i = 0; i < 4; i = i + 1)\0A  {{[{][{]0[}][}]}}[i] = {`RANDOM, `RANDOM};"(%Memory) : !hw.inout<uarray<4xi40>>
@@ -0,0 +1,37 @@
+// RUN: circt-opt -hw-miter=pairs=spec:impl %s | FileCheck %s
+// RUN: circt-opt -hw-miter=pairs=spec:other -verify-diagnostics %s
+
+// CHECK-NOT: hw.module @spec
+// CHECK-NOT: hw.module @impl
+// CHECK-LABEL: hw.module @spec_impl_miter(%a: i4, %b: i4) -> (%differ: i1) {
+// CHECK-NEXT:    %0 = comb.xor %a, %b : i4
+// CHECK-NEXT:    %1 = comb.add %a, %b : i4
+// CHECK-NEXT:    %2 = comb.sub %a, %b : i4
+// CHECK-NEXT:    %3 = comb.xor %a, %b : i4
+// CHECK-NEXT:    %4 = comb.icmp ne %1, %2 : i4
+// CHECK-NEXT:    %5 = comb.icmp ne %0, %3 : i4
+// CHECK-NEXT:    %6 = comb.or %4, %5 : i1
+// CHECK-NEXT:    hw.output %6 : i1
+// CHECK-NEXT:  }
+hw.module @spec(%a: i4, %b: i4) -> (%x: i4, %y: i4) {
+  %0 = comb.add %a, %b : i4
+  %1 = hw.instance "xor" @xor(%a, %b) : (i4, i4) -> i4
+  hw.output %0, %1 : i4, i4
+}
+
+hw.module @xor(%a: i4, %b: i4) -> (%x: i4) {
+  %0 = comb.xor %a, %b : i4
+  hw.output %0 : i4
+}
+
+// The body of a module is a graph region, so uses may precede definitions.
+hw.module @impl(%a: i4, %b: i4) -> (%x: i4, %y: i4) {
+  hw.output %0, %1 : i4, i4
+  %1 = hw.instance "xor" @xor(%a, %b) : (i4, i4) -> i4
+  %0 = comb.sub %a, %b : i4
+}
+
+// expected-error @+1 {{module 'other' has different ports than 'spec'}}
+hw.module @other(%a: i4) -> (%x: i4, %y: i4) {
+  hw.output %a, %a : i4, i4
+}
@@ -0,0 +1,62 @@
+// RUN: circt-opt -hw-value-numbering %s | FileCheck %s
+
+// CHECK-LABEL: hw.module @commutative
+hw.module @commutative(%a: i4, %b: i4, %c: i4) -> (%x: i4, %y: i4, %z: i4) {
+  // CHECK-NEXT: %0 = comb.and %a, %b : i4
+  // CHECK-NEXT: %1 = comb.add %a, %b, %c : i4
+  // CHECK-NEXT: hw.output %0, %0, %1 : i4, i4, i4
+  %0 = comb.and %a, %b : i4
+  %1 = comb.and %b, %a : i4
+  %2 = comb.add %c, %b, %a : i4
+  hw.output %0, %1, %2 : i4, i4, i4
+}
+
+// Constants are sorted after the other operands.
+// CHECK-LABEL: hw.module @constants
+hw.module @constants(%a: i4, %b: i4) -> (%x: i4, %y: i4) {
+  // CHECK-NEXT: %c1_i4 = hw.constant 1 : i4
+  // CHECK-NEXT: %0 = comb.or %a, %b, %c1_i4 : i4
+  // CHECK-NEXT: hw.output %0, %0 : i4, i4
+  %c1_i4 = hw.constant 1 : i4
+  %c1_i4_0 = hw.constant 1 : i4
+  %0 = comb.or %c1_i4, %b, %a : i4
+  %1 = comb.or %a, %c1_i4_0, %b : i4
+  hw.output %0, %1 : i4, i4
+}
+
+// Non-commutative operations keep their operand order.
+// CHECK-LABEL: hw.module @noncommutative
+hw.module @noncommutative(%a: i4, %b: i4) -> (%x: i4, %y: i4) {
+  // CHECK-NEXT: %0 = comb.sub %a, %b : i4
+  // CHECK-NEXT: %1 = comb.sub %b, %a : i4
+  // CHECK-NEXT: hw.output %0, %1 : i4, i4
+  %0 = comb.sub %a, %b : i4
+  %1 = comb.sub %b, %a : i4
+  hw.output %0, %1 : i4, i4
+}
+
+// Identical subgraphs feeding different outputs are merged, even when they
+// are defined after their users.
+// CHECK-LABEL: hw.module @subgraph
+hw.module @subgraph(%a: i4, %b: i4, %c: i4) -> (%x: i4, %y: i4) {
+  // CHECK-NEXT: %0 = comb.mul %c, %1 : i4
+  // CHECK-NEXT: %1 = comb.xor %a, %b : i4
+  // CHECK-NEXT: hw.output %0, %0 : i4, i4
+  %0 = comb.mul %1, %c : i4
+  %1 = comb.xor %a, %b : i4
+  %2 = comb.xor %b, %a : i4
+  %3 = comb.mul %c, %2 : i4
+  hw.output %0, %3 : i4, i4
+}
+
+// Operations with side effects are never merged.
+// CHECK-LABEL: hw.module @effects
+hw.module @effects() -> (%x: i4, %y: i4) {
+  // CHECK-NEXT: %0 = sv.wire : !hw.inout<i4>
+  // CHECK-NEXT: %1 = sv.wire : !hw.inout<i4>
+  %0 = sv.wire : !hw.inout<i4>
+  %1 = sv.wire : !hw.inout<i4>
+  %2 = sv.read_inout %0 : !hw.inout<i4>
+  %3 = sv.read_inout %1 : !hw.inout<i4>
+  hw.output %2, %3 : i4, i4
+}
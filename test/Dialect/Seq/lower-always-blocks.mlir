@@ -0,0 +1,71 @@
+// RUN: circt-opt %s --lower-seq-to-sv='merge-always-blocks=true extract-enables=true' | FileCheck %s
+// RUN: circt-opt %s --lower-seq-to-sv='merge-always-blocks=true' | FileCheck %s --check-prefix=MERGE
+// RUN: circt-opt %s --lower-seq-to-sv='extract-enables=true' | FileCheck %s --check-prefix=ENABLE
+
+hw.module @top(%clk: i1, %clk2: i1, %rst: i1, %en: i1, %i: i32) {
+  %rv = hw.constant 0 : i32
+
+  %r0 = seq.compreg %i, %clk, %rst, %rv : i32
+  %m1 = comb.mux %en, %i, %r1 : i32
+  %r1 = seq.compreg %m1, %clk, %rst, %rv : i32
+  %m2 = comb.mux %en, %r2, %i : i32
+  %r2 = seq.compreg %m2, %clk : i32
+  %r3 = seq.compreg %i, %clk2 : i32
+}
+
+// CHECK-LABEL: hw.module @top
+// CHECK-NOT:     comb.mux
+// CHECK:         [[REG0:%.+]] = sv.reg  : !hw.inout<i32>
+// CHECK-NOT:     comb.mux
+// CHECK:         [[REG1:%.+]] = sv.reg  : !hw.inout<i32>
+// CHECK-NOT:     comb.mux
+// CHECK:         [[NOT_EN:%.+]] = comb.xor %en, %true : i1
+// CHECK-NOT:     comb.mux
+// CHECK:         [[REG2:%.+]] = sv.reg  : !hw.inout<i32>
+// CHECK:         [[REG3:%.+]] = sv.reg  : !hw.inout<i32>
+// CHECK:         sv.alwaysff(posedge %clk)  {
+// CHECK-NEXT:      sv.passign [[REG0]], %i : i32
+// CHECK-NEXT:      sv.if %en  {
+// CHECK-NEXT:        sv.passign [[REG1]], %i : i32
+// CHECK-NEXT:      }
+// CHECK-NEXT:    }(syncreset : posedge %rst)  {
+// CHECK-NEXT:      sv.passign [[REG0]], %c0_i32 : i32
+// CHECK-NEXT:      sv.passign [[REG1]], %c0_i32 : i32
+// CHECK-NEXT:    }
+// CHECK-NEXT:    sv.alwaysff(posedge %clk)  {
+// CHECK-NEXT:      sv.if [[NOT_EN]]  {
+// CHECK-NEXT:        sv.passign [[REG2]], %i : i32
+// CHECK-NEXT:      }
+// CHECK-NEXT:    }
+// CHECK-NEXT:    sv.alwaysff(posedge %clk2)  {
+// CHECK-NEXT:      sv.passign [[REG3]], %i : i32
+// CHECK-NEXT:    }
+
+// MERGE-LABEL: hw.module @top
+// MERGE:         [[REG0:%.+]] = sv.reg  : !hw.inout<i32>
+// MERGE:         [[MUX1:%.+]] = comb.mux %en, %i, {{%.+}} : i32
+// MERGE:         [[REG1:%.+]] = sv.reg  : !hw.inout<i32>
+// MERGE:         sv.alwaysff(posedge %clk)  {
+// MERGE-NEXT:      sv.passign [[REG0]], %i : i32
+// MERGE-NEXT:      sv.passign [[REG1]], [[MUX1]] : i32
+// MERGE-NEXT:    }(syncreset : posedge %rst)  {
+// MERGE-NEXT:      sv.passign [[REG0]], %c0_i32 : i32
+// MERGE-NEXT:      sv.passign [[REG1]], %c0_i32 : i32
+// MERGE-NEXT:    }
+// MERGE-NEXT:    sv.alwaysff(posedge %clk)  {
+// MERGE-NEXT:      sv.passign {{%.+}}, {{%.+}} : i32
+// MERGE-NEXT:    }
+// MERGE-NEXT:    sv.alwaysff(posedge %clk2)  {
+// MERGE-NEXT:      sv.passign {{%.+}}, %i : i32
+// MERGE-NEXT:    }
+
+// Without merging, each register keeps its own always_ff block.
+// ENABLE-LABEL: hw.module @top
+// ENABLE:         sv.alwaysff(posedge %clk)  {
+// ENABLE-NEXT:      sv.passign {{%.+}}, %i : i32
+// ENABLE-NEXT:    }(syncreset : posedge %rst)  {
+// ENABLE:         sv.alwaysff(posedge %clk)  {
+// ENABLE-NEXT:      sv.if %en  {
+// ENABLE:         sv.alwaysff(posedge %clk)  {
+// ENABLE-NEXT:      sv.if {{%.+}}  {
+// ENABLE:         sv.alwaysff(posedge %clk2)  {
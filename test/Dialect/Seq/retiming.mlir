@@ -0,0 +1,44 @@
+// RUN: circt-opt %s --seq-retime | FileCheck %s
+// RUN: circt-opt %s --seq-retime='delays=comb.mul=0' | FileCheck %s --check-prefix=DELAY
+
+// CHECK-LABEL: hw.module @pipeline
+// CHECK-NEXT:    [[C1:%.+]] = seq.compreg %c, %clk : i32
+// CHECK-NEXT:    [[C2:%.+]] = seq.compreg [[C1]], %clk : i32
+// CHECK-NEXT:    [[ADD:%.+]] = comb.add %a, %b : i32
+// CHECK-NEXT:    [[ADD_R:%.+]] = seq.compreg [[ADD]], %clk : i32
+// CHECK-NEXT:    [[MUL:%.+]] = comb.mul [[ADD_R]], [[ADD_R]] : i32
+// CHECK-NEXT:    [[MUL_R:%.+]] = seq.compreg [[MUL]], %clk : i32
+// CHECK-NEXT:    [[OUT:%.+]] = comb.add [[MUL_R]], [[C2]] : i32
+// CHECK-NEXT:    hw.output [[OUT]] : i32
+
+// DELAY-LABEL: hw.module @pipeline
+// DELAY-NEXT:    [[C1:%.+]] = seq.compreg %c, %clk : i32
+// DELAY-NEXT:    [[ADD:%.+]] = comb.add %a, %b : i32
+// DELAY-NEXT:    [[MUL:%.+]] = comb.mul [[ADD]], [[ADD]] : i32
+// DELAY-NEXT:    [[MUL_R:%.+]] = seq.compreg [[MUL]], %clk : i32
+// DELAY-NEXT:    [[OUT:%.+]] = comb.add [[MUL_R]], [[C1]] : i32
+// DELAY-NEXT:    [[OUT_R:%.+]] = seq.compreg [[OUT]], %clk : i32
+// DELAY-NEXT:    hw.output [[OUT_R]] : i32
+hw.module @pipeline(%clk: i1, %a: i32, %b: i32, %c: i32) -> (%out: i32) {
+  %0 = comb.add %a, %b : i32
+  %1 = comb.mul %0, %0 : i32
+  %2 = comb.add %1, %c : i32
+  %3 = seq.compreg %2, %clk : i32
+  %4 = seq.compreg %3, %clk : i32
+  hw.output %4 : i32
+}
+
+// Registers with a reset stay in place.
+// CHECK-LABEL: hw.module @reset
+// CHECK-NEXT:    %c0_i32 = hw.constant 0 : i32
+// CHECK-NEXT:    [[ADD:%.+]] = comb.add %a, %b : i32
+// CHECK-NEXT:    [[MUL:%.+]] = comb.mul [[ADD]], [[ADD]] : i32
+// CHECK-NEXT:    [[REG:%.+]] = seq.compreg [[MUL]], %clk, %rst, %c0_i32  : i32
+// CHECK-NEXT:    hw.output [[REG]] : i32
+hw.module @reset(%clk: i1, %rst: i1, %a: i32, %b: i32) -> (%out: i32) {
+  %c0_i32 = hw.constant 0 : i32
+  %0 = comb.add %a, %b : i32
+  %1 = comb.mul %0, %0 : i32
+  %2 = seq.compreg %1, %clk, %rst, %c0_i32 : i32
+  hw.output %2 : i32
+}
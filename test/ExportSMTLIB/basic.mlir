@@ -0,0 +1,53 @@
+// RUN: circt-translate -export-smtlib -verify-diagnostics -split-input-file %s | FileCheck %s
+
+// CHECK-LABEL: (set-logic QF_BV)
+// CHECK-NEXT:  ; hw.module @miter
+// CHECK-NEXT:  (push 1)
+// CHECK-NEXT:  (echo "miter")
+// CHECK-NEXT:  (declare-const |a| (_ BitVec 4))
+// CHECK-NEXT:  (declare-const |b| (_ BitVec 4))
+// CHECK-NEXT:  (declare-const |c| (_ BitVec 1))
+// CHECK-NEXT:  (declare-const |d| (_ BitVec 8))
+// CHECK-NEXT:  (define-fun |%0| () (_ BitVec 4) (bvadd (bvadd |a| |b|) (_ bv3 4)))
+// CHECK-NEXT:  (define-fun |%1| () (_ BitVec 3) ((_ extract 3 1) |%0|))
+// CHECK-NEXT:  (define-fun |%2| () (_ BitVec 1) (bvxor (bvxor ((_ extract 0 0) |%1|) ((_ extract 1 1) |%1|)) ((_ extract 2 2) |%1|)))
+// CHECK-NEXT:  (define-fun |%3| () (_ BitVec 5) (concat |%2| |b|))
+// CHECK-NEXT:  (define-fun |%4| () (_ BitVec 8) ((_ sign_extend 3) |%3|))
+// CHECK-NEXT:  (define-fun |%5| () (_ BitVec 8) (ite (= |c| #b1) |%4| |d|))
+// CHECK-NEXT:  (define-fun |%6| () (_ BitVec 1) (ite (bvult |%5| |d|) #b1 #b0))
+// CHECK-NEXT:  (define-fun |%7| () (_ BitVec 1) (bvxor |%6| |c|))
+// CHECK-NEXT:  (assert (= |%7| #b1))
+// CHECK-NEXT:  (check-sat)
+// CHECK-NEXT:  (pop 1)
+hw.module @miter(%a: i4, %b: i4, %c: i1, %d: i8) -> (%differ: i1) {
+  // The body is a graph region, so uses may precede definitions.
+  hw.output %7 : i1
+  %c3_i4 = hw.constant 3 : i4
+  %0 = comb.add %a, %b, %c3_i4 : i4
+  %1 = comb.extract %0 from 1 : (i4) -> i3
+  %2 = comb.parity %1 : i3
+  %3 = comb.concat %2, %b : (i1, i4) -> i5
+  %4 = comb.sext %3 : (i5) -> i8
+  %5 = comb.mux %c, %4, %d : i8
+  %6 = comb.icmp ult %5, %d : i8
+  %7 = comb.xor %6, %c : i1
+}
+
+// -----
+
+// expected-error @+1 {{module 'wide' must have a single i1 output to be exported to SMT-LIB}}
+hw.module @wide(%a: i4) -> (%x: i4) {
+  hw.output %a : i4
+}
+
+// -----
+
+hw.module @child(%a: i1) -> (%x: i1) {
+  hw.output %a : i1
+}
+
+hw.module @parent(%a: i1) -> (%x: i1) {
+  // expected-error @+1 {{'hw.instance' op must be inlined, e.g. with -hw-miter, before exporting to SMT-LIB}}
+  %0 = hw.instance "child" @child(%a) : (i1) -> i1
+  hw.output %0 : i1
+}
@@ -0,0 +1,47 @@
+// RUN: circt-translate --export-verilog %s | FileCheck %s --check-prefix=DEFAULT
+// RUN: circt-translate --lowering-options=maximumMuxChainDepth=2 --export-verilog %s | FileCheck %s --check-prefix=DEPTH
+// RUN: circt-translate --lowering-options=disallowLocationInfo --export-verilog %s | FileCheck %s --check-prefix=NOLOC
+// RUN: circt-translate --lowering-options=profile=simulator --export-verilog %s | FileCheck %s --check-prefix=SIM
+// RUN: circt-translate --lowering-options=shareVariadicSubterms --export-verilog %s | FileCheck %s --check-prefix=SHARE
+
+hw.module @chain(%a: i8, %b: i8, %c0: i1, %c1: i1, %c2: i1, %c3: i1, %c4: i1)
+    -> (%x: i8) {
+  %0 = comb.mux %c0, %a, %b : i8
+  %1 = comb.mux %c1, %0, %b : i8
+  %2 = comb.mux %c2, %1, %b : i8
+  %3 = comb.mux %c3, %2, %b : i8
+  %4 = comb.mux %c4, %3, %b : i8
+  hw.output %4 : i8 loc("Chain.fir":3:4)
+}
+
+// DEFAULT-LABEL: module chain
+// DEFAULT:         assign x = c4 ? (c3 ? (c2 ? (c1 ? (c0 ? a : b) : b) : b) : b) : b;{{.*}}// Chain.fir:3:4
+
+// DEPTH-LABEL: module chain
+// DEPTH:         wire [7:0] [[T0:[_a-zA-Z0-9]+]] = c1 ? (c0 ? a : b) : b;
+// DEPTH-NEXT:    wire [7:0] [[T1:[_a-zA-Z0-9]+]] = c3 ? (c2 ? [[T0]] : b) : b;
+// DEPTH:         assign x = c4 ? [[T1]] : b;
+
+// NOLOC-LABEL: module chain
+// NOLOC:         assign x = {{.+}};{{$}}
+
+// SIM-LABEL: module chain
+// SIM:         wire [7:0] [[T0:[_a-zA-Z0-9]+]] = c3 ? (c2 ? (c1 ? (c0 ? a : b) : b) : b) : b;{{$}}
+// SIM:         assign x = c4 ? [[T0]] : b;{{$}}
+
+hw.module @terms(%a: i8, %b: i8, %c: i8, %d: i8, %e: i8) -> (%x: i8, %y: i8) {
+  %0 = comb.and %a, %b, %c, %d : i8
+  %1 = comb.and %b, %a, %e, %d : i8
+  hw.output %0, %1 : i8, i8
+}
+
+// DEFAULT-LABEL: module terms
+// DEFAULT-NOT:     wire
+// DEFAULT:         assign x =
+// DEFAULT:         assign y =
+
+// The balanced trees of both ands share the term of a and b.
+// SHARE-LABEL: module terms
+// SHARE:         wire [7:0] [[T0:[_a-zA-Z0-9]+]] = a & b;
+// SHARE:         assign x = [[T0]] & {{.*}}c & d
+// SHARE:         assign y = [[T0]] & {{.*}}e & d
@@ -0,0 +1,14 @@
+// RUN: circt-opt %s -test-scheduling-benchmark -allow-unregistered-dialect -o /dev/null | FileCheck %s
+
+// CHECK: "function":"chain","operations":3,"dependences":3
+// CHECK-SAME: "asap":{"construct_sec":{{[^}]*}},"latency":5}
+// CHECK-SAME: "list":{"construct_sec":{{[^}]*}},"latency":5}
+// CHECK-SAME: "modulo":{"construct_sec":{{[^}]*}},"latency":5,"ii":1}
+// CHECK-SAME: "simplex":{"construct_sec":{{[^}]*}},"latency":5}
+func @chain(%a : i32) -> i32 attributes {
+  operatortypes = [ { name = "add", latency = 3, limit = 1 } ]
+  } {
+  %0 = addi %a, %a { opr = "add" } : i32
+  %1 = addi %0, %0 : i32
+  return %1 : i32
+}
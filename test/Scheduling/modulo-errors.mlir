@@ -0,0 +1,12 @@
+// RUN: circt-opt %s -test-modulo-scheduler -verify-diagnostics -split-input-file
+
+// expected-error@+2 {{no modulo schedule found}}
+// expected-error@+1 {{scheduling failed}}
+func @cycle_without_distance() attributes {
+  auxdeps = [ [0,1], [1,2], [2,0] ]
+  } {
+  %0 = constant 0 : i32
+  %1 = constant 1 : i32
+  %2 = constant 2 : i32
+  return
+}
@@ -0,0 +1,47 @@
+// RUN: circt-opt %s -test-modulo-problem -verify-diagnostics -split-input-file
+
+// expected-error@+2 {{Operator type 'mul' has a limit of zero}}
+// expected-error@+1 {{problem check failed}}
+func @zero_limit() attributes {
+  operatortypes = [ { name = "mul", latency = 2, limit = 0 } ]
+  } {
+  %0 = constant { opr = "mul", problemStartTime = 0 } 0 : i32
+  return { problemStartTime = 2 }
+}
+
+// -----
+
+// expected-error@+2 {{Invalid initiation interval}}
+// expected-error@+1 {{problem verification failed}}
+func @no_ii() {
+  %0 = constant { problemStartTime = 0 } 0 : i32
+  return { problemStartTime = 1 }
+}
+
+// -----
+
+// expected-error@+2 {{Precedence violated for dependence}}
+// expected-error@+1 {{problem verification failed}}
+func @loop_carried_dep_violated(%a : i32) -> i32 attributes {
+  operatortypes = [ { name = "add", latency = 3 } ],
+  auxdeps = [ [2,1,1] ],
+  problemInitiationInterval = 3
+  } {
+  %0 = addi %a, %a { problemStartTime = 0 } : i32
+  %1 = addi %0, %0 { opr = "add", problemStartTime = 1 } : i32
+  %2 = addi %1, %1 { problemStartTime = 4 } : i32
+  return { problemStartTime = 5 } %2 : i32
+}
+
+// -----
+
+// expected-error@+2 {{Operator type 'mul' is oversubscribed}}
+// expected-error@+1 {{problem verification failed}}
+func @oversubscribed(%a : i32, %b : i32) attributes {
+  operatortypes = [ { name = "mul", latency = 2, limit = 1 } ],
+  problemInitiationInterval = 2
+  } {
+  %0 = muli %a, %a { opr = "mul", problemStartTime = 0 } : i32
+  %1 = muli %b, %b { opr = "mul", problemStartTime = 2 } : i32
+  return { problemStartTime = 4 }
+}
@@ -0,0 +1,36 @@
+// RUN: circt-opt %s -test-cyclic-problem
+// RUN: circt-opt %s -test-modulo-problem
+// RUN: circt-opt %s -test-modulo-scheduler | FileCheck %s -check-prefix=MODULO
+
+// MODULO-LABEL: func @recurrence
+// MODULO-SAME: moduloInitiationInterval = 4
+func @recurrence(%a : i32) -> i32 attributes {
+  operatortypes = [ { name = "add", latency = 3 } ],
+  auxdeps = [ [2,1,1] ],
+  problemInitiationInterval = 4
+  } {
+  // MODULO-NEXT: moduloStartTime = 0
+  %0 = addi %a, %a { problemStartTime = 0 } : i32
+  // MODULO-NEXT: moduloStartTime = 1
+  %1 = addi %0, %0 { opr = "add", problemStartTime = 1 } : i32
+  // MODULO-NEXT: moduloStartTime = 4
+  %2 = addi %1, %1 { problemStartTime = 4 } : i32
+  // MODULO-NEXT: moduloStartTime = 5
+  return { problemStartTime = 5 } %2 : i32
+}
+
+// MODULO-LABEL: func @shared_multiplier
+// MODULO-SAME: moduloInitiationInterval = 2
+func @shared_multiplier(%a : i32, %b : i32) -> i32 attributes {
+  operatortypes = [ { name = "mul", latency = 2, limit = 1 } ],
+  problemInitiationInterval = 2
+  } {
+  // MODULO-NEXT: moduloStartTime = 0
+  %0 = muli %a, %a { opr = "mul", problemStartTime = 0 } : i32
+  // MODULO-NEXT: moduloStartTime = 1
+  %1 = muli %b, %b { opr = "mul", problemStartTime = 1 } : i32
+  // MODULO-NEXT: moduloStartTime = 3
+  %2 = addi %0, %1 { problemStartTime = 3 } : i32
+  // MODULO-NEXT: moduloStartTime = 4
+  return { problemStartTime = 4 } %2 : i32
+}
@@ -0,0 +1,22 @@
+// RUN: circt-opt %s -test-shared-operators-problem -verify-diagnostics -split-input-file
+
+// expected-error@+2 {{Operator type 'mul' has a limit of zero}}
+// expected-error@+1 {{problem check failed}}
+func @zero_limit() attributes {
+  operatortypes = [ { name = "mul", latency = 2, limit = 0 } ]
+  } {
+  %0 = constant { opr = "mul", problemStartTime = 0 } 0 : i32
+  return { problemStartTime = 2 }
+}
+
+// -----
+
+// expected-error@+2 {{Operator type 'mul' is oversubscribed}}
+// expected-error@+1 {{problem verification failed}}
+func @oversubscribed(%a : i32, %b : i32) attributes {
+  operatortypes = [ { name = "mul", latency = 2, limit = 1 } ]
+  } {
+  %0 = muli %a, %a { opr = "mul", problemStartTime = 1 } : i32
+  %1 = muli %b, %b { opr = "mul", problemStartTime = 1 } : i32
+  return { problemStartTime = 3 }
+}
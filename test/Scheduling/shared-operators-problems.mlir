@@ -0,0 +1,34 @@
+// RUN: circt-opt %s -test-shared-operators-problem
+// RUN: circt-opt %s -test-list-scheduler | FileCheck %s -check-prefix=LIST
+
+// LIST-LABEL: critical_path
+func @critical_path(%a : i32, %b : i32, %c : i32, %d : i32) -> i32 attributes {
+  operatortypes = [ { name = "mul", latency = 3, limit = 1 } ]
+  } {
+  // LIST-NEXT: listStartTime = 0
+  %0 = muli %a, %b { opr = "mul", problemStartTime = 0 } : i32
+  // LIST-NEXT: listStartTime = 1
+  %1 = muli %c, %d { opr = "mul", problemStartTime = 1 } : i32
+  // LIST-NEXT: listStartTime = 4
+  %2 = muli %0, %1 { opr = "mul", problemStartTime = 4 } : i32
+  // LIST-NEXT: listStartTime = 0
+  %3 = addi %a, %c { problemStartTime = 0 } : i32
+  // LIST-NEXT: listStartTime = 7
+  %4 = addi %2, %3 { problemStartTime = 7 } : i32
+  // LIST-NEXT: listStartTime = 8
+  return { problemStartTime = 8 } %4 : i32
+}
+
+// LIST-LABEL: unlimited
+func @unlimited(%a : i32, %b : i32) -> i32 attributes {
+  operatortypes = [ { name = "mul", latency = 3 } ]
+  } {
+  // LIST-NEXT: listStartTime = 0
+  %0 = muli %a, %a { opr = "mul", problemStartTime = 0 } : i32
+  // LIST-NEXT: listStartTime = 0
+  %1 = muli %b, %b { opr = "mul", problemStartTime = 0 } : i32
+  // LIST-NEXT: listStartTime = 3
+  %2 = addi %0, %1 { problemStartTime = 3 } : i32
+  // LIST-NEXT: listStartTime = 4
+  return { problemStartTime = 4 } %2 : i32
+}
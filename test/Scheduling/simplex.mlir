@@ -0,0 +1,56 @@
+// RUN: circt-opt %s -test-simplex-scheduler -allow-unregistered-dialect | FileCheck %s -check-prefix=SIMPLEX
+// RUN: circt-opt %s -test-simplex-scheduler -allow-unregistered-dialect | FileCheck %s -check-prefix=LIFETIME
+
+// SIMPLEX-LABEL: arbitrary_latencies
+// LIFETIME-LABEL: arbitrary_latencies
+func @arbitrary_latencies(%v : complex<f32>) -> f32 attributes {
+  operatortypes = [
+    { name = "extr", latency = 0 },
+    { name = "add", latency = 3 },
+    { name = "mult", latency = 6 },
+    { name = "sqrt", latency = 10 }
+  ] } {
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 0
+  %0 = "complex.re"(%v) { opr = "extr" } : (complex<f32>) -> f32
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 0
+  %1 = "complex.im"(%v) { opr = "extr" } : (complex<f32>) -> f32
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 0
+  %2 = mulf %0, %0 { opr = "mult" } : f32
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 0
+  %3 = mulf %1, %1 { opr = "mult" } : f32
+  // SIMPLEX-NEXT: simplexStartTime = 6
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 6
+  %4 = addf %2, %3 { opr = "add" } : f32
+  // SIMPLEX-NEXT: simplexStartTime = 9
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 9
+  %5 = "math.sqrt"(%4) { opr = "sqrt" } : (f32) -> f32
+  // SIMPLEX-NEXT: simplexStartTime = 19
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 19
+  return %5 : f32
+}
+
+// SIMPLEX-LABEL: late_user
+// LIFETIME-LABEL: late_user
+func @late_user(%a : i32) -> i32 attributes {
+  operatortypes = [ { name = "mul", latency = 3 } ]
+  } {
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 0
+  %0 = addi %a, %a : i32
+  // SIMPLEX-NEXT: simplexStartTime = 1
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 1
+  %1 = muli %0, %0 { opr = "mul" } : i32
+  // SIMPLEX-NEXT: simplexStartTime = 0
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 3
+  %2 = addi %a, %a : i32
+  // SIMPLEX-NEXT: simplexStartTime = 4
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 4
+  %3 = addi %1, %2 : i32
+  // SIMPLEX-NEXT: simplexStartTime = 5
+  // LIFETIME-NEXT: simplexLifetimeStartTime = 5
+  return %3 : i32
+}
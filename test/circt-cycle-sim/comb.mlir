@@ -0,0 +1,17 @@
+// RUN: printf '200 3\n0xFF 0\n1 0b10\n' > %t.stim
+// RUN: circt-cycle-sim %s -stimulus=%t.stim | FileCheck %s
+
+// CHECK:      203 51203 12 65480 66 0
+// CHECK-NEXT: 255 65280 15 65535 0 0
+// CHECK-NEXT: 3 258 0 1 0 1
+
+hw.module @comb(%a: i8, %b: i8) -> (%sum: i8, %cat: i16, %hi: i4, %sx: i16,
+                                     %div: i8, %lt: i1) {
+  %sum = comb.add %a, %b : i8
+  %cat = comb.concat %a, %b : (i8, i8) -> i16
+  %hi = comb.extract %a from 4 : (i8) -> i4
+  %sx = comb.sext %a : (i8) -> i16
+  %div = comb.divu %a, %b : i8
+  %lt = comb.icmp ult %a, %b : i8
+  hw.output %sum, %cat, %hi, %sx, %div, %lt : i8, i16, i4, i16, i8, i1
+}
@@ -0,0 +1,30 @@
+// RUN: printf '1 0\n0 1\n# Count to three.\n0 1\n0 1\n\n1 1\n0 0\n' > %t.stim
+// RUN: circt-cycle-sim %s -stimulus=%t.stim -cycles=8 | FileCheck %s
+
+// The outputs are printed before the clock edge of each cycle, and the
+// inputs of the last line are held until the last cycle.
+// CHECK:      0 0
+// CHECK-NEXT: 0 0
+// CHECK-NEXT: 1 0
+// CHECK-NEXT: 2 0
+// CHECK-NEXT: 3 0
+// CHECK-NEXT: 0 0
+// CHECK-NEXT: 0 0
+// CHECK-NEXT: 0 0
+// CHECK-NOT: {{.}}
+
+hw.module @inc(%a: i8) -> (%b: i8) {
+  %c1_i8 = hw.constant 1 : i8
+  %0 = comb.add %a, %c1_i8 : i8
+  hw.output %0 : i8
+}
+
+hw.module @counter(%clk: i1, %rst: i1, %en: i1) -> (%count: i8, %max: i1) {
+  %c0_i8 = hw.constant 0 : i8
+  %c-1_i8 = hw.constant -1 : i8
+  %next = comb.mux %en, %inc.b, %count : i8
+  %count = seq.compreg %next, %clk, %rst, %c0_i8 : i8
+  %inc.b = hw.instance "inc" @inc(%count) : (i8) -> i8
+  %max = comb.icmp eq %count, %c-1_i8 : i8
+  hw.output %count, %max : i8, i1
+}
@@ -0,0 +1,17 @@
+// RUN: not circt-cycle-sim %s -top=cycle 2>&1 | FileCheck %s --check-prefix=CYCLE
+// RUN: not circt-cycle-sim %s -top=unsupported 2>&1 | FileCheck %s --check-prefix=UNSUPPORTED
+
+// CYCLE: error: 'comb.add' op is part of a combinational cycle
+hw.module @cycle(%a: i8) -> (%b: i8) {
+  %0 = comb.add %a, %1 : i8
+  %1 = comb.xor %a, %0 : i8
+  hw.output %1 : i8
+}
+
+hw.module.extern @ext(%a: i8) -> (%b: i8)
+
+// UNSUPPORTED: error: 'hw.instance' op instantiates 'ext', which the cycle simulator can't simulate
+hw.module @unsupported(%a: i8) -> (%b: i8) {
+  %0 = hw.instance "ext" @ext(%a) : (i8) -> i8
+  hw.output %0 : i8
+}
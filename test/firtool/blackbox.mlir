@@ -7,6 +7,16 @@
 // RUN: FileCheck %s --check-prefix=VERILOG-GIB < %t/magic/blackbox-path.v
 // RUN: FileCheck %s --check-prefix=LIST-TOP < %t/filelist.f
 // RUN: FileCheck %s --check-prefix=LIST-BLACK-BOX < %t/magic.f
+// RUN: rm -rf %t.limit
+// RUN: firtool %s --split-verilog -o=%t.limit --blackbox-path=%S --blackbox-resource-path=%S/.. --blackbox-inline-size-limit=1
+// RUN: FileCheck %s --check-prefix=VERILOG-FOO < %t.limit/magic/blackbox-inline.v
+// RUN: FileCheck %s --check-prefix=LIMIT-BAR < %t.limit/magic/blackbox-resource.v
+// RUN: FileCheck %s --check-prefix=LIMIT-GIB < %t.limit/magic/blackbox-path.v
+
+// Files on disk above the size limit are included by path, while inline
+// sources are always copied.
+// LIMIT-BAR: `include "{{.*}}firtool{{/|\\}}blackbox-resource.v"
+// LIMIT-GIB: `include "{{.*}}firtool{{/|\\}}blackbox-path.v"
 
 // LIST-TOP: test_mod.sv
 
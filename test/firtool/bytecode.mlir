@@ -0,0 +1,26 @@
+// RUN: firtool %s --format=mlir -firbc -disable-opt -o %t.firbc
+// RUN: firtool %t.firbc -mlir -disable-opt | FileCheck %s
+// RUN: firtool %t.firbc -mlir -disable-opt -mlir-disable-threading | FileCheck %s
+
+firrtl.circuit "Top" {
+  firrtl.module @Child(in %in : !firrtl.uint<8>, out %out : !firrtl.uint<8>) {
+    firrtl.connect %out, %in : !firrtl.uint<8>, !firrtl.uint<8>
+  }
+  firrtl.module @Top(in %clock : !firrtl.clock, in %in : !firrtl.uint<8>,
+                     out %out : !firrtl.uint<8>) {
+    %c_in, %c_out = firrtl.instance @Child {name = "c"} : !firrtl.uint<8>, !firrtl.uint<8>
+    firrtl.connect %c_in, %in : !firrtl.uint<8>, !firrtl.uint<8>
+    %r = firrtl.reg %clock : (!firrtl.clock) -> !firrtl.uint<8>
+    firrtl.connect %r, %c_out : !firrtl.uint<8>, !firrtl.uint<8>
+    firrtl.connect %out, %r : !firrtl.uint<8>, !firrtl.uint<8>
+  }
+}
+
+// CHECK-LABEL: firrtl.circuit "Top" {
+// CHECK-LABEL: firrtl.module @Child(in %in: !firrtl.uint<8>, out %out: !firrtl.uint<8>) {
+// CHECK-NEXT:    firrtl.connect %out, %in : !firrtl.uint<8>, !firrtl.uint<8>
+// CHECK-LABEL: firrtl.module @Top(
+// CHECK:         %c_in, %c_out = firrtl.instance @Child {{ *}}{name = "c"}
+// CHECK:         %r = firrtl.reg %clock
+// CHECK:         firrtl.connect %r, %c_out
+// CHECK:         firrtl.connect %out, %r
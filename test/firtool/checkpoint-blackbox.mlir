@@ -0,0 +1,32 @@
+// RUN: rm -rf %t
+// RUN: firtool %s -verilog -checkpoint-dir=%t -o %t.v
+// RUN: FileCheck %s < %t.v
+
+// The black boxes of a checkpoint are found next to the original input,
+// rather than in the checkpoint directory.
+// RUN: firtool %t/parse.firbc -verilog | FileCheck %s
+// RUN: firtool %t/parse.firbc -verilog -checkpoint-dir=%t.resumed -o %t.resumed.v
+// RUN: firtool %t.resumed/lower-types.firbc -mlir | FileCheck %s --check-prefix=MLIR
+
+// A black box root given on the command line still wins.
+// RUN: not firtool %t/parse.firbc -verilog --blackbox-path=%t 2>&1 | FileCheck %s --check-prefix=MISSING
+
+// CHECK: module ExtPath(); endmodule
+
+// The attributes recording the checkpoint don't leak into the output.
+// MLIR-NOT: firtool.input
+// MLIR-NOT: firtool.checkpoint
+// MLIR: hw.module @checkpoint_blackbox
+
+// MISSING: error: Cannot find file
+
+firrtl.circuit "checkpoint_blackbox" {
+  firrtl.module @checkpoint_blackbox() {
+    firrtl.instance @ExtPath {name = "gib", portNames = []}
+  }
+
+  firrtl.extmodule @ExtPath() attributes {annotations = [{
+    class = "firrtl.transforms.BlackBoxPathAnno",
+    path = "blackbox-path.v"
+  }]}
+}
@@ -0,0 +1,38 @@
+// RUN: firtool %s --format=mlir -disable-opt -parallel-mlir-output | FileCheck %s
+// RUN: firtool %s --format=mlir -disable-opt -parallel-mlir-output -mlir-disable-threading | FileCheck %s
+// RUN: firtool %s --format=mlir -disable-opt -parallel-mlir-output | circt-opt | FileCheck %s
+// RUN: firtool %s --format=mlir -lower-to-hw -parallel-mlir-output | FileCheck %s --check-prefix=HW
+
+firrtl.circuit "Top" {
+  firrtl.module @Child(in %in : !firrtl.uint<8>, out %out : !firrtl.uint<8>) {
+    firrtl.connect %out, %in : !firrtl.uint<8>, !firrtl.uint<8>
+  }
+  firrtl.module @Top(in %clock : !firrtl.clock, in %in : !firrtl.uint<8>,
+                     out %out : !firrtl.uint<8>) {
+    %c_in, %c_out = firrtl.instance @Child {name = "c"} : !firrtl.uint<8>, !firrtl.uint<8>
+    firrtl.connect %c_in, %in : !firrtl.uint<8>, !firrtl.uint<8>
+    %r = firrtl.reg %clock : (!firrtl.clock) -> !firrtl.uint<8>
+    firrtl.connect %r, %c_out : !firrtl.uint<8>, !firrtl.uint<8>
+    firrtl.connect %out, %r : !firrtl.uint<8>, !firrtl.uint<8>
+  }
+}
+
+// The modules are written in order, indented as in the output of the whole
+// module, which can be parsed back.
+// CHECK:      {{^}}module
+// CHECK-NEXT: {{^}}  firrtl.circuit "Top"
+// CHECK-NEXT: {{^}}    firrtl.module @Child(in %in: !firrtl.uint<8>, out %out: !firrtl.uint<8>) {
+// CHECK-NEXT: {{^}}      firrtl.connect %out, %in : !firrtl.uint<8>, !firrtl.uint<8>
+// CHECK-NEXT: {{^}}    }
+// CHECK-NEXT: {{^}}    firrtl.module @Top(
+// CHECK-NEXT: {{^}}      %c_in, %c_out = firrtl.instance @Child {{ *}}{name = "c"}
+// CHECK:      {{^}}      %r = firrtl.reg %clock
+// CHECK:      {{^}}      firrtl.connect %out, %r
+// CHECK-NEXT: {{^}}    }
+// CHECK-NEXT: {{^}}  }
+// CHECK-NEXT: {{^}}}
+
+// HW:      {{^}}module
+// HW:      {{^}}  hw.module @Child
+// HW:      {{^}}  hw.module @Top
+// HW:      {{^}}}
@@ -7,8 +7,26 @@
 // RUN: FileCheck %s --check-prefix=VERILOG-INOUT-3 < %t/inout_3.sv
 // RUN: FileCheck %s --check-prefix=VERILOG-CUSTOM-1 < %t/custom1.sv
 // RUN: FileCheck %s --check-prefix=VERILOG-CUSTOM-2 < %t/custom2.sv
+// RUN: FileCheck %s --check-prefix=VERILOG-BIND < %t/bindfile
+// RUN: FileCheck %s --check-prefix=VERILOG-BOUND < %t/BindParent.sv
 // RUN: FileCheck %s --check-prefix=LIST < %t/filelist.f
 
+// Files with the same contents as in the previous incremental run are left
+// untouched, everything else is written again.
+// RUN: rm -rf %t.inc
+// RUN: firtool %s --format=mlir -split-verilog -incremental-split-verilog -o=%t.inc
+// RUN: FileCheck %s --check-prefix=HASHES < %t.inc/filelist.md5
+// RUN: echo "// untouched" > %t.inc/foo.sv
+// RUN: rm %t.inc/bar.sv
+// RUN: firtool %s --format=mlir -split-verilog -incremental-split-verilog -o=%t.inc
+// RUN: FileCheck %s --check-prefix=UNTOUCHED < %t.inc/foo.sv
+// RUN: FileCheck %s --check-prefix=VERILOG-BAR < %t.inc/bar.sv
+// RUN: FileCheck %s --check-prefix=LIST < %t.inc/filelist.f
+
+// The emission statistics list every module by its Verilog name.
+// RUN: firtool %s --format=mlir -split-verilog -o=%t --export-verilog-stats=%t.json
+// RUN: FileCheck %s --check-prefix=STATS < %t.json
+
 sv.verbatim "// I'm everywhere"
 sv.ifdef "VERILATOR" {
   sv.verbatim "// Hello"
@@ -43,6 +61,14 @@ hw.module.extern @inout_0 () -> ()
 hw.module.extern @inout_1 () -> ()
 hw.module.extern @inout_2 () -> ()
 
+// The bind file reads the ports prepared in `@BindParent`, which must still be
+// around when the file is written.
+hw.module @BindParent() {
+  %0 = hw.constant 1 : i1
+  %1 = hw.instance "child" sym @bindChild @bar(%0) {doNotPrint = 1} : (i1) -> i1
+}
+sv.bind @bindChild
+
 sv.verbatim "// Foo" {output_file = {name = "custom1.sv"}}
 sv.verbatim "// Bar" {output_file = {name = "custom2.sv", exclude_from_filelist = true}}
 
@@ -50,9 +76,29 @@ sv.verbatim "// Bar" {output_file = {name = "custom2.sv", exclude_from_filelist
 // LIST-NEXT: bar.sv
 // LIST-NEXT: usb.sv
 // LIST-NEXT: inout_3.sv
+// LIST-NEXT: BindParent.sv
+// LIST-NEXT: bindfile
 // LIST-NEXT: custom1.sv
 // LIST-NOT:  custom2.sv
 
+// HASHES:      {{^[0-9a-f]+}} foo.sv
+// HASHES-NEXT: {{^[0-9a-f]+}} bar.sv
+// HASHES:      {{^[0-9a-f]+}} custom2.sv
+
+// UNTOUCHED:     // untouched
+// UNTOUCHED-NOT: module
+
+// STATS:      "total": {
+// STATS-NEXT:   "modules": 4,
+// STATS-NEXT:   "bytes": {{[1-9][0-9]*}},
+// STATS-NEXT:   "temporaries": 0,
+// STATS-NEXT:   "spilledWires":
+// STATS-NEXT:   "seconds":
+// STATS:      "name": "BindParent"
+// STATS:      "name": "bar"
+// STATS:      "name": "foo"
+// STATS:      "name": "inout_3"
+
 // VERILOG-FOO:       // I'm everywhere
 // VERILOG-FOO-NEXT:  `ifdef VERILATOR
 // VERILOG-FOO-NEXT:    // Hello
@@ -93,6 +139,15 @@ sv.verbatim "// Bar" {output_file = {name = "custom2.sv", exclude_from_filelist
 // VERILOG-INOUT-3-LABEL: module inout_3(
 // VERILOG-INOUT-3:       endmodule
 
+// VERILOG-BOUND-LABEL: module BindParent();
+// VERILOG-BOUND:         assign child_x = 1'h1;
+// VERILOG-BOUND:         // This instance is elsewhere emitted as a bind statement
+// VERILOG-BOUND-NEXT:    // bar child (
+// VERILOG-BOUND:       endmodule
+
+// VERILOG-BIND:      bind BindParent bar child (
+// VERILOG-BIND-NEXT:   .x (child_x),
+
 // VERILOG-CUSTOM-1: // Foo
 // VERILOG-CUSTOM-2: // Bar
 
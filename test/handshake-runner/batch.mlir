@@ -0,0 +1,16 @@
+// RUN: printf '1 2\n# Comment.\n3 4\n\n10 5\n' > %t.batch
+// RUN: handshake-runner %s -batch=%t.batch 2>&1 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -batch=%t.batch 2>&1 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -batch=%t.batch -compiled 2>&1 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -batch=%t.batch -pipelined 2>&1 | FileCheck %s
+// CHECK: 3
+// CHECK-NEXT: 7
+// CHECK-NEXT: 15
+// CHECK-NEXT: 3 results in {{[0-9]+}} cycles, {{[0-9.]+}} cycles per result, {{[0-9.]+}} tokens per second
+
+module {
+  func @main(%a: index, %b: index) -> index {
+    %0 = addi %a, %b : index
+    return %0 : index
+  }
+}
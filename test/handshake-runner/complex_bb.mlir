@@ -1,5 +1,6 @@
 // RUN: handshake-runner %s | FileCheck %s
 // RUN: circt-opt -create-dataflow %s | handshake-runner | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -compiled | FileCheck %s
 // CHECK: 763 2996
 module {
   func @main() -> (index, index) {
@@ -1,5 +1,7 @@
 // RUN: handshake-runner %s 2 | FileCheck %s
 // RUN: circt-opt -create-dataflow %s | handshake-runner - 2 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -compiled - 2 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner -memory-latency=2 -memory-ports=1 - 2 | FileCheck %s
 // CHECK: 1
 
 module {
@@ -0,0 +1,17 @@
+// RUN: printf 'ABCD' > %t.bin
+// RUN: handshake-runner %s bin:%t.bin 2 | FileCheck %s
+// RUN: printf 'bin:%t.bin 1\n1,2,3,4 3\n' > %t.batch
+// RUN: handshake-runner %s -batch=%t.batch | FileCheck %s --check-prefix=BATCH
+// RUN: printf 'ABC' > %t.short
+// RUN: not handshake-runner %s bin:%t.short 0 2>&1 | FileCheck %s --check-prefix=SHORT
+// CHECK: 67 65,66,67,68
+// BATCH: 66 65,66,67,68
+// BATCH-NEXT: 4 1,2,3,4
+// SHORT: does not hold the 4 elements of memref<4xi8>
+
+module {
+  func @main(%m: memref<4xi8>, %i: index) -> i8 {
+    %0 = memref.load %m[%i] : memref<4xi8>
+    return %0 : i8
+  }
+}
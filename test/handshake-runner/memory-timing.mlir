@@ -0,0 +1,27 @@
+// RUN: printf '1,2,3,4 0 1\n' > %t.near
+// RUN: printf '1,2,3,4 0 2\n' > %t.far
+// RUN: handshake-runner %s -batch=%t.near 2>&1 | FileCheck %s --check-prefix=DEFAULT
+// RUN: handshake-runner %s -batch=%t.near -memory-latency=3 2>&1 | FileCheck %s --check-prefix=LATENCY
+// RUN: handshake-runner %s -batch=%t.near -memory-ports=1 2>&1 | FileCheck %s --check-prefix=CONFLICT
+// RUN: handshake-runner %s -batch=%t.near -memory-ports=1 -memory-banks=2 2>&1 | FileCheck %s --check-prefix=DEFAULT
+// RUN: handshake-runner %s -batch=%t.far -memory-ports=1 -memory-banks=2 2>&1 | FileCheck %s --check-prefix=CONFLICT
+
+// The loads issue in the same cycle, and complete in it unless they wait for
+// the memory.
+// DEFAULT: {{[34]}} 1,2,3,4
+// DEFAULT-NEXT: 1 results in 2 cycles
+// LATENCY: 3 1,2,3,4
+// LATENCY-NEXT: 1 results in 5 cycles
+
+// The second load waits a cycle for the port of its bank.
+// CONFLICT: {{[34]}} 1,2,3,4
+// CONFLICT-NEXT: 1 results in 3 cycles
+
+module {
+  func @main(%a: memref<4xi32>, %i: index, %j: index) -> i32 {
+    %0 = memref.load %a[%i] : memref<4xi32>
+    %1 = memref.load %a[%j] : memref<4xi32>
+    %2 = addi %0, %1 : i32
+    return %2 : i32
+  }
+}
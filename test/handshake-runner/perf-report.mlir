@@ -0,0 +1,26 @@
+// RUN: circt-opt -create-dataflow %s | handshake-runner -perf-report - 1 2 2>&1 | FileCheck %s
+// RUN: printf '1 2\n3 4\n10 5\n' > %t.batch
+// RUN: circt-opt -create-dataflow %s | handshake-runner -batch=%t.batch -annotate-perf=%t.mlir
+// RUN: FileCheck %s --check-prefix=ANNOTATE < %t.mlir
+// RUN: not handshake-runner %s -perf-report 1 2 2>&1 | FileCheck %s --check-prefix=STD
+
+// CHECK: 3
+// CHECK: ... Handshake Performance Report ...
+// CHECK: Runs: 1, {{[0-9]+}} cycles
+// CHECK: Blocked channels:
+// CHECK: Operations waiting on inputs:
+// CHECK: Critical path of the last run:
+// CHECK-NEXT: time  channel
+// CHECK-NEXT: argument
+
+// ANNOTATE: addi {{.*}}perf = {blocked = [0], {{.*}}fires = 3, input_wait = {{[0-9]+}}, tokens = [3]
+// ANNOTATE: handshake.return {{.*}}perf = {blocked = [], {{.*}}fires = 3
+
+// STD: Performance counters are only available for handshake functions
+
+module {
+  func @main(%a: index, %b: index) -> index {
+    %0 = addi %a, %b : index
+    return %0 : index
+  }
+}
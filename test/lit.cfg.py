@@ -57,7 +57,7 @@ tool_dirs = [
 ]
 tools = [
     'firtool', 'handshake-runner', 'circt-opt', 'circt-translate',
-    'circt-capi-ir-test', 'esi-tester'
+    'circt-capi-ir-test', 'circt-cycle-sim', 'esi-tester'
 ]
 
 # Enable Verilator if it has been detected.
@@ -0,0 +1,160 @@
+//===- circt-cycle-sim.cpp - Cycle-based simulator of HW modules ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Tool which simulates a `hw.module` of `comb` logic and `seq.compreg`
+// registers cycle by cycle, without going through Verilog.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/Seq/SeqDialect.h"
+#include "circt/Dialect/Seq/Simulator/CycleSimulator.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Parser.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+
+using namespace llvm;
+using namespace mlir;
+using namespace circt;
+
+static cl::OptionCategory mainCategory("Application options");
+
+static cl::opt<std::string> inputFileName(cl::Positional,
+                                          cl::desc("<input file>"),
+                                          cl::init("-"), cl::cat(mainCategory));
+
+static cl::opt<std::string>
+    topModule("top", cl::Optional,
+              cl::desc("The module to simulate. Defaults to the last module"),
+              cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<std::string> stimulusFile(
+    "stimulus", cl::Optional,
+    cl::desc("File with one line per cycle, holding the values of the "
+             "inputs other than clocks"),
+    cl::value_desc("filename"), cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<unsigned>
+    numCycles("cycles", cl::Optional,
+              cl::desc("Cycles to simulate. The inputs of the last line of "
+                       "the stimulus are held after it ends"),
+              cl::init(0), cl::cat(mainCategory));
+
+/// Read the input values of each cycle from `path`, skipping empty lines and
+/// comments.
+static LogicalResult readStimulus(StringRef path,
+                                  SmallVectorImpl<std::string> &lines) {
+  auto fileOrErr = MemoryBuffer::getFileOrSTDIN(path);
+  if (std::error_code error = fileOrErr.getError()) {
+    errs() << "could not open stimulus file '" << path
+           << "': " << error.message() << "\n";
+    return failure();
+  }
+
+  SmallVector<StringRef> allLines;
+  (*fileOrErr)->getBuffer().split(allLines, '\n');
+  for (auto line : allLines) {
+    line = line.trim();
+    if (!line.empty() && !line.startswith("#"))
+      lines.push_back(line.str());
+  }
+  return success();
+}
+
+/// Set the inputs other than clocks from the whitespace-separated values of
+/// `line`, which may be decimal or prefixed with 0x or 0b.
+static LogicalResult setInputs(seq::sim::CycleSimulator &sim, StringRef line) {
+  SmallVector<StringRef> fields;
+  SplitString(line, fields);
+  unsigned field = 0;
+  for (unsigned i = 0, e = sim.getNumInputs(); i < e; ++i) {
+    if (sim.isClockInput(i))
+      continue;
+    if (field == fields.size()) {
+      errs() << "missing value for input '" << sim.getInputName(i) << "'\n";
+      return failure();
+    }
+    APInt value;
+    if (fields[field].getAsInteger(0, value)) {
+      errs() << "invalid value '" << fields[field] << "' for input '"
+             << sim.getInputName(i) << "'\n";
+      return failure();
+    }
+    sim.setInput(i, value.zextOrTrunc(sim.getInputWidth(i)));
+    ++field;
+  }
+  if (field != fields.size()) {
+    errs() << "too many values in line '" << line << "'\n";
+    return failure();
+  }
+  return success();
+}
+
+int main(int argc, char **argv) {
+  InitLLVM y(argc, argv);
+  cl::HideUnrelatedOptions(mainCategory);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "CIRCT cycle-based simulator\n\n"
+      "This application simulates a module cycle by cycle, and prints the\n"
+      "values of its outputs in each cycle, before the clock edge.\n");
+
+  auto fileOrErr = MemoryBuffer::getFileOrSTDIN(inputFileName.c_str());
+  if (std::error_code error = fileOrErr.getError()) {
+    errs() << argv[0] << ": could not open input file '" << inputFileName
+           << "': " << error.message() << "\n";
+    return 1;
+  }
+
+  MLIRContext context;
+  context.loadDialect<hw::HWDialect, comb::CombDialect, seq::SeqDialect>();
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(*fileOrErr), SMLoc());
+  OwningModuleRef module(parseSourceFile(sourceMgr, &context));
+  if (!module)
+    return 1;
+
+  hw::HWModuleOp top;
+  if (topModule.empty()) {
+    for (auto hwModule : module->getOps<hw::HWModuleOp>())
+      top = hwModule;
+  } else {
+    top = module->lookupSymbol<hw::HWModuleOp>(topModule);
+  }
+  if (!top) {
+    errs() << "Top module " << topModule << " not found!\n";
+    return 1;
+  }
+
+  seq::sim::CycleSimulator sim(top);
+  if (failed(sim.build()))
+    return 1;
+
+  SmallVector<std::string> stimulus;
+  if (!stimulusFile.empty() && failed(readStimulus(stimulusFile, stimulus)))
+    return 1;
+
+  size_t cycles = std::max<size_t>(stimulus.size(), numCycles);
+  for (size_t cycle = 0; cycle < cycles; ++cycle) {
+    if (cycle < stimulus.size() && failed(setInputs(sim, stimulus[cycle])))
+      return 1;
+    sim.eval();
+    for (unsigned i = 0, e = sim.getNumOutputs(); i < e; ++i) {
+      if (i != 0)
+        outs() << ' ';
+      outs() << sim.getOutput(i).toString(10, /*Signed=*/false);
+    }
+    outs() << '\n';
+    sim.step();
+  }
+  return 0;
+}
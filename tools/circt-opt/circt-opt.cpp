@@ -20,14 +20,29 @@
 #include "mlir/Pass/PassRegistry.h"
 #include "mlir/Support/MlirOptMain.h"
 #include "mlir/Transforms/Passes.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Threading.h"
 
 // Defined in the test directory, no public header.
 namespace circt {
 namespace test {
+void registerFIRRTLTestPasses();
 void registerSchedulingTestPasses();
 } // namespace test
 } // namespace circt
 
+// The thread pool running the passes is created on first use, which is after
+// the command line is parsed.
+static llvm::cl::opt<unsigned> numThreads(
+    "threads",
+    llvm::cl::desc("Number of threads to run the passes on, 0 uses all the "
+                   "cores"),
+    llvm::cl::init(0), llvm::cl::callback([](const unsigned &threads) {
+      if (threads)
+        llvm::parallel::strategy = llvm::hardware_concurrency(threads);
+    }));
+
 int main(int argc, char **argv) {
   mlir::DialectRegistry registry;
 
@@ -46,6 +61,7 @@ int main(int argc, char **argv) {
   mlir::registerInlinerPass();
 
   // Register test passes
+  circt::test::registerFIRRTLTestPasses();
   circt::test::registerSchedulingTestPasses();
 
   return mlir::failed(
@@ -0,0 +1,419 @@
+//===- esi-cosim-bench.cpp - ESI cosim transport benchmark ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the message throughput and the round-trip latency of the cosim
+// transports, through loopback endpoints which send back every message they
+// receive. The tool is the client of the endpoints, which either run in a
+// real simulation (`--connect`, found through its cosim.cfg) or are played
+// by the tool itself. In the latter case, the tool calls the DPI entry points
+// of the cosim server library from a thread, like a simulator would, and
+// provides the few svdpi functions they use in place of the MtiPli stub, so
+// that no simulator is needed.
+//
+// The results are printed as a JSON object.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/ESI/cosim/CosimDpi.capnp.h"
+#include "circt/Dialect/ESI/cosim/ShmTransport.h"
+#include "circt/Dialect/ESI/cosim/dpi.h"
+#include <algorithm>
+#include <atomic>
+#include <capnp/ez-rpc.h>
+#include <capnp/serialize.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace capnp;
+using namespace circt::esi::cosim;
+using Clock = std::chrono::steady_clock;
+
+// ---- The svdpi functions used by the DPI entry points ----
+
+namespace {
+/// What the open array handles given to the DPI entry points point to.
+struct OpenArray {
+  uint8_t *data;
+  int size;
+};
+} // anonymous namespace
+
+// These take precedence over the MtiPli stub the server library is linked
+// with, as the executable exports them.
+int svDimensions(const svOpenArrayHandle h) { return 1; }
+void *svGetArrayPtr(const svOpenArrayHandle h) {
+  return static_cast<OpenArray *>(h)->data;
+}
+int svSizeOfArray(const svOpenArrayHandle h) {
+  return static_cast<OpenArray *>(h)->size;
+}
+int svSize(const svOpenArrayHandle h, int d) {
+  return static_cast<OpenArray *>(h)->size;
+}
+
+// ---- Options ----
+
+namespace {
+struct Options {
+  /// "rpc" or "shm". Ignored with `connect`, where cosim.cfg tells.
+  std::string transport = "rpc";
+  /// The number of RPC server threads the endpoints are partitioned over.
+  /// Ignored with `connect`.
+  unsigned rpcThreads = 1;
+  /// Use the endpoints of a running simulation instead of playing them.
+  bool connect = false;
+  unsigned endpoints = 1;
+  /// The ID of the first endpoint, the others being numbered consecutively.
+  int firstEndpoint = 1;
+  /// The size of the data in each message, in bytes.
+  unsigned size = 8;
+  /// The number of round trips timed one at a time.
+  unsigned latencyMessages = 1000;
+  /// The number of messages sent for the throughput, and how many of them
+  /// each endpoint has in flight.
+  unsigned throughputMessages = 10000;
+  unsigned window = 16;
+};
+} // anonymous namespace
+
+static bool parseOptions(int argc, char **argv, Options &opts) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    auto number = [&]() {
+      return (unsigned)std::strtoul(value.c_str(), nullptr, 0);
+    };
+    if (name == "--transport" && (value == "rpc" || value == "shm"))
+      opts.transport = value;
+    else if (name == "--rpc-threads")
+      opts.rpcThreads = number();
+    else if (name == "--connect")
+      opts.connect = true;
+    else if (name == "--endpoints")
+      opts.endpoints = number();
+    else if (name == "--first-endpoint")
+      opts.firstEndpoint = number();
+    else if (name == "--size")
+      opts.size = number();
+    else if (name == "--latency-messages")
+      opts.latencyMessages = number();
+    else if (name == "--throughput-messages")
+      opts.throughputMessages = number();
+    else if (name == "--window")
+      opts.window = number();
+    else {
+      fprintf(stderr, "error: unknown option '%s'\n", argv[i]);
+      return false;
+    }
+  }
+  if (opts.endpoints == 0 || opts.window == 0) {
+    fprintf(stderr, "error: --endpoints and --window must be positive\n");
+    return false;
+  }
+  return true;
+}
+
+// ---- The simulation side ----
+
+namespace {
+/// Plays the loopback endpoints on a thread, polling each of them once per
+/// iteration, which stands for a clock cycle.
+class LoopbackSim {
+public:
+  LoopbackSim(const Options &opts) : opts(opts) {}
+
+  void start() { thread = std::thread(&LoopbackSim::mainLoop, this); }
+  void stop() {
+    stopSig = true;
+    thread.join();
+    sv2cCosimserverFinish();
+  }
+
+private:
+  void mainLoop() {
+    // The loopback sends back what it receives, so both directions hold the
+    // whole message: a root pointer, the data pointer and the data.
+    int msgSize = 16 + (opts.size + 7) / 8 * 8;
+    uint64_t typeId = capnp::typeId<UntypedData>();
+    for (unsigned i = 0; i < opts.endpoints; ++i)
+      if (sv2cCosimserverEpRegister(opts.firstEndpoint + i, typeId, msgSize,
+                                    typeId, msgSize) != 0)
+        fprintf(stderr, "error: could not register endpoint %u\n", i);
+
+    std::vector<uint8_t> buffer(msgSize);
+    OpenArray array = {buffer.data(), msgSize};
+    while (!stopSig) {
+      for (unsigned i = 0; i < opts.endpoints; ++i) {
+        unsigned int size = msgSize;
+        if (sv2cCosimserverEpTryGet(opts.firstEndpoint + i, &array, &size) ==
+                0 &&
+            size > 0)
+          sv2cCosimserverEpTryPut(opts.firstEndpoint + i, &array, size);
+      }
+    }
+  }
+
+  const Options &opts;
+  std::thread thread;
+  std::atomic<bool> stopSig{false};
+};
+} // anonymous namespace
+
+// ---- The client side ----
+
+namespace {
+/// A client of the loopback endpoints, through one of the transports.
+class Client {
+public:
+  virtual ~Client() = default;
+  /// Send a message of `size` data bytes to an endpoint.
+  virtual void send(unsigned ep, unsigned size) = 0;
+  /// Receive a message from an endpoint, if there is one.
+  virtual bool poll(unsigned ep) = 0;
+};
+
+/// Connects to every port of the server, as each serves the endpoints whose
+/// ID is its index modulo the number of ports.
+class RpcClient : public Client {
+public:
+  RpcClient(const std::vector<uint16_t> &ports, const Options &opts) {
+    for (uint16_t port : ports)
+      clients.push_back(std::make_unique<EzRpcClient>("localhost", port));
+    // The clients of a thread share its event loop.
+    auto &waitScope = getWaitScope();
+
+    // Wait for the simulation to register all the endpoints.
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    for (unsigned i = 0; i < opts.endpoints; ++i) {
+      int id = opts.firstEndpoint + (int)i;
+      auto cosim = clients[(unsigned)id % clients.size()]
+                       ->getMain<CosimDpiServer>();
+      while (true) {
+        auto list = cosim.listRequest().send().wait(waitScope);
+        bool found = false;
+        for (auto iface : list.getIfaces()) {
+          if (iface.getEndpointID() != id)
+            continue;
+          auto req = cosim.openRequest<AnyPointer, AnyPointer>();
+          req.setIface(iface);
+          eps.push_back(req.send().wait(waitScope).getIface());
+          found = true;
+          break;
+        }
+        if (found)
+          break;
+        KJ_REQUIRE(Clock::now() < deadline, "The endpoints never showed up");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+  }
+  ~RpcClient() override {
+    for (auto &ep : eps)
+      ep.closeRequest().send().wait(getWaitScope());
+  }
+
+  void send(unsigned ep, unsigned size) override {
+    auto req = eps[ep].sendRequest();
+    req.getMsg().initAs<UntypedData>().initData(size);
+    req.send().wait(getWaitScope());
+  }
+
+  bool poll(unsigned ep) override {
+    auto req = eps[ep].recvRequest();
+    req.setBlock(false);
+    return req.send().wait(getWaitScope()).getHasData();
+  }
+
+private:
+  kj::WaitScope &getWaitScope() { return clients.front()->getWaitScope(); }
+
+  std::vector<std::unique_ptr<EzRpcClient>> clients;
+  std::vector<EsiDpiEndpoint<AnyPointer, AnyPointer>::Client> eps;
+};
+
+class ShmClient : public Client {
+public:
+  ShmClient(const std::string &path, const Options &opts) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    KJ_REQUIRE(fd >= 0, "Could not open the shared memory file", path);
+    void *addr = mmap(nullptr, sizeof(shm::Region), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    ::close(fd);
+    KJ_REQUIRE(addr != MAP_FAILED, "Could not map the shared memory file");
+    region = static_cast<shm::Region *>(addr);
+
+    // Wait for the simulation to publish the endpoints.
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (slots.size() < opts.endpoints) {
+      KJ_REQUIRE(Clock::now() < deadline, "The endpoints never showed up");
+      slots.clear();
+      if (region->magic.load(std::memory_order_acquire) == shm::regionMagic)
+        for (unsigned i = 0; i < opts.endpoints; ++i)
+          for (uint32_t s = 0, e = region->numEndpoints.load(); s < e; ++s)
+            if (region->endpoints[s].endpointId == opts.firstEndpoint + (int)i)
+              slots.push_back(&region->endpoints[s]);
+      std::this_thread::yield();
+    }
+    for (auto *slot : slots) {
+      uint32_t closed = 0;
+      KJ_REQUIRE(slot->open.compare_exchange_strong(closed, 1),
+                 "Endpoint in use");
+    }
+  }
+  ~ShmClient() override {
+    for (auto *slot : slots)
+      slot->open.store(0, std::memory_order_release);
+    munmap(region, sizeof(shm::Region));
+  }
+
+  void send(unsigned ep, unsigned size) override {
+    MallocMessageBuilder builder;
+    builder.initRoot<UntypedData>().initData(size);
+    auto words = messageToFlatArray(builder);
+    while (!slots[ep]->toSim.write((const uint64_t *)words.begin(),
+                                   words.size()))
+      std::this_thread::yield();
+  }
+
+  bool poll(unsigned ep) override { return slots[ep]->toClient.read(msg); }
+
+private:
+  shm::Region *region;
+  std::vector<shm::EndpointSlot *> slots;
+  std::vector<uint64_t> msg;
+};
+} // anonymous namespace
+
+/// Read the ports or the shared memory file of the simulation from
+/// cosim.cfg, waiting for it to be written.
+static bool readConfig(std::vector<uint16_t> &ports, std::string &shmPath) {
+  auto deadline = Clock::now() + std::chrono::seconds(10);
+  while (Clock::now() < deadline) {
+    std::ifstream cfg("cosim.cfg");
+    std::string key, value;
+    while (cfg >> key >> value) {
+      if (key == "port:")
+        ports.push_back(std::strtoul(value.c_str(), nullptr, 10));
+      if (key == "shm:") {
+        shmPath = value;
+        return true;
+      }
+    }
+    if (!ports.empty())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  fprintf(stderr, "error: cosim.cfg was never written\n");
+  return false;
+}
+
+static double percentile(std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[i];
+}
+
+static void receive(Client &client, unsigned ep) {
+  while (!client.poll(ep))
+    std::this_thread::yield();
+}
+
+static void runBenchmark(Client &client, const std::string &transport,
+                         const Options &opts) {
+  // One message in flight at a time, cycling through the endpoints.
+  std::vector<double> latencies;
+  for (unsigned i = 0; i < opts.latencyMessages; ++i) {
+    unsigned ep = i % opts.endpoints;
+    auto start = Clock::now();
+    client.send(ep, opts.size);
+    receive(client, ep);
+    latencies.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  // Keep a window of messages in flight on every endpoint.
+  unsigned sent = 0;
+  auto start = Clock::now();
+  while (sent < opts.throughputMessages) {
+    for (unsigned ep = 0; ep < opts.endpoints; ++ep)
+      for (unsigned w = 0; w < opts.window; ++w)
+        client.send(ep, opts.size);
+    for (unsigned ep = 0; ep < opts.endpoints; ++ep)
+      for (unsigned w = 0; w < opts.window; ++w)
+        receive(client, ep);
+    sent += opts.endpoints * opts.window;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  printf("{\"transport\": \"%s\", \"endpoints\": %u, \"size\": %u, "
+         "\"msgs_per_sec\": %.1f, \"latency_us\": {\"p50\": %.2f, "
+         "\"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}}\n",
+         transport.c_str(), opts.endpoints, opts.size,
+         seconds > 0 ? sent / seconds : 0.0, percentile(latencies, 0.5),
+         percentile(latencies, 0.9), percentile(latencies, 0.99),
+         latencies.empty() ? 0.0 : latencies.back());
+}
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parseOptions(argc, argv, opts))
+    return 1;
+
+  // Play the endpoints, on the requested transport.
+  std::unique_ptr<LoopbackSim> sim;
+  if (!opts.connect) {
+    unlink("cosim.cfg");
+    if (opts.transport == "shm") {
+      setenv("COSIM_SHM", "cosim.shm", 1);
+    } else {
+      unsetenv("COSIM_SHM");
+      setenv("COSIM_PORT", "0", 1);
+      setenv("COSIM_RPC_THREADS", std::to_string(opts.rpcThreads).c_str(), 1);
+    }
+    sim = std::make_unique<LoopbackSim>(opts);
+    sim->start();
+  }
+
+  std::vector<uint16_t> ports;
+  std::string shmPath;
+  int rc = 1;
+  if (readConfig(ports, shmPath)) {
+    rc = 0;
+    KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() {
+                  if (shmPath.empty()) {
+                    RpcClient client(ports, opts);
+                    runBenchmark(client, "rpc", opts);
+                  } else {
+                    ShmClient client(shmPath, opts);
+                    runBenchmark(client, "shm", opts);
+                  }
+                })) {
+      fprintf(stderr, "error: %s\n", e->getDescription().cStr());
+      rc = 1;
+    }
+  }
+
+  if (sim)
+    sim->stop();
+  return rc;
+}
@@ -11,53 +11,82 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include "circt/Conversion/Passes.h"
-#include "circt/Dialect/Comb/CombDialect.h"
-#include "circt/Dialect/FIRRTL/FIRParser.h"
-#include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
-#include "circt/Dialect/FIRRTL/Passes.h"
-#include "circt/Dialect/HW/HWDialect.h"
-#include "circt/Dialect/HW/HWOps.h"
-#include "circt/Dialect/SV/SVDialect.h"
-#include "circt/Dialect/SV/SVPasses.h"
+#include "circt/Firtool/Firtool.h"
 #include "circt/Support/LoweringOptions.h"
-#include "circt/Transforms/Passes.h"
 #include "circt/Translation/ExportVerilog.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/AsmState.h"
 #include "mlir/IR/BuiltinOps.h"
-#include "mlir/Parser.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/Pass/Pass.h"
+#include "mlir/Pass/PassInstrumentation.h"
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Support/FileUtilities.h"
 #include "mlir/Support/Timing.h"
-#include "mlir/Transforms/Passes.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
 using namespace llvm;
 using namespace mlir;
 using namespace circt;
+using namespace circt::firtool;
 
 /// Allow the user to specify the input file format.  This can be used to
 /// override the input, and can be used to specify ambiguous cases like standard
 /// input.
-enum InputFormatKind { InputUnspecified, InputFIRFile, InputMLIRFile };
-
 static cl::opt<InputFormatKind> inputFormat(
     "format", cl::desc("Specify input file format:"),
     cl::values(clEnumValN(InputUnspecified, "autodetect",
                           "Autodetect input format"),
                clEnumValN(InputFIRFile, "fir", "Parse as .fir file"),
-               clEnumValN(InputMLIRFile, "mlir", "Parse as .mlir file")),
+               clEnumValN(InputMLIRFile, "mlir", "Parse as .mlir file"),
+               clEnumValN(InputFIRBytecodeFile, "firbc",
+                          "Read as a FIRRTL bytecode file")),
     cl::init(InputUnspecified));
 
-static cl::opt<std::string>
-    inputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+static cl::list<std::string> inputFilenames(cl::Positional,
+                                            cl::desc("<input files>"),
+                                            cl::ZeroOrMore);
+
+static cl::opt<unsigned> numJobs(
+    "j",
+    cl::desc("With multiple inputs, the number of inputs compiled "
+             "concurrently (default: the number of hardware threads)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<bool> batchMode(
+    "batch",
+    cl::desc("Treat the input as a list of requests, one per line, each "
+             "naming an input file and optionally its output, and compile "
+             "them one after the other with the same context and pass "
+             "pipeline; outputs default to files in the -o directory"),
+    cl::init(false));
 
 static cl::opt<std::string>
     outputFilename("o",
@@ -67,10 +96,20 @@ static cl::opt<std::string>
 static cl::opt<bool> disableOptimization("disable-opt",
                                          cl::desc("disable optimizations"));
 
+static cl::opt<bool> incrementalCanonicalize(
+    "incremental-canonicalize",
+    cl::desc("only revisit operations affected by previous rewrites when "
+             "canonicalizing"),
+    cl::init(false));
+
 static cl::opt<bool> inliner("inline",
                              cl::desc("Run the FIRRTL module inliner"),
                              cl::init(false));
 
+static cl::opt<bool>
+    dedup("dedup", cl::desc("deduplicate structurally identical modules"),
+          cl::init(false));
+
 static cl::opt<bool> lowerToHW("lower-to-hw",
                                cl::desc("run the lower-to-hw pass"));
 
@@ -79,21 +118,55 @@ static cl::opt<bool> enableAnnotationWarning(
     cl::desc("Warn about annotations that were not removed by lower-to-hw"),
     cl::init(false));
 
+static cl::opt<bool> groupDebugStatements(
+    "group-debug-statements",
+    cl::desc("Share the guards of consecutive prints and stops in lower-to-hw"),
+    cl::init(false));
+
 static cl::opt<bool> imconstprop(
     "imconstprop",
     cl::desc(
         "Enable intermodule constant propagation and dead code elimination"),
     cl::init(true));
 
+static cl::opt<bool>
+    imdce("imdce",
+          cl::desc("Enable intermodule dead code and dead port elimination"),
+          cl::init(false));
+
 static cl::opt<bool>
     lowerTypes("lower-types",
                cl::desc("run the lower-types pass within lower-to-hw"),
                cl::init(true));
 
+static cl::opt<bool> preserveAggregate(
+    "preserve-aggregate",
+    cl::desc("keep passive bundles intact where they can be lowered to "
+             "structs, instead of lowering them to ground types"),
+    cl::init(false));
+
+static cl::opt<bool> randomizeMemInit(
+    "randomize-mem-init",
+    cl::desc("emit random initializers for the memory simulation models, "
+             "guarded by RANDOMIZE_MEM_INIT"),
+    cl::init(false));
+
+static cl::opt<bool>
+    readMemInit("readmem-init",
+                cl::desc("load the memory simulation models from "
+                         "<module>.hex files with $readmemh"),
+                cl::init(false));
+
 static cl::opt<bool> expandWhens("expand-whens",
                                  cl::desc("disable the expand-whens pass"),
                                  cl::init(true));
 
+static cl::opt<bool> forwardConnects(
+    "forward-connects",
+    cl::desc("replace wires connected once and nodes with their drivers "
+             "before expand-whens"),
+    cl::init(false));
+
 static cl::opt<bool>
     blackBoxMemory("blackbox-memory",
                    cl::desc("Create a black box for all memory operations"),
@@ -104,6 +177,18 @@ static cl::opt<bool>
                        cl::desc("ignore the @info locations in the .fir file"),
                        cl::init(false));
 
+static cl::opt<bool> lazyFIRLocations(
+    "lazy-fir-locators",
+    cl::desc("only decode the @info locations in the .fir file for the "
+             "operations that survive to the output or get diagnostics"),
+    cl::init(false));
+
+static cl::opt<bool> streamModulePasses(
+    "stream-module-passes",
+    cl::desc("run the module-local cleanups on each module as soon as it is "
+             "parsed, overlapping them with parsing"),
+    cl::init(false));
+
 static cl::opt<bool>
     inferWidths("infer-widths",
                 cl::desc("run the width inference pass on firrtl"),
@@ -112,22 +197,24 @@ static cl::opt<bool>
 static cl::opt<bool> extractTestCode("extract-test-code",
                                      cl::desc("run the extract test code pass"),
                                      cl::init(false));
+
+static cl::opt<bool> interfaceOnly(
+    "interface-only",
+    cl::desc("only keep the ports and instances of the modules, stubbing out "
+             "everything else, for quick checks of the design hierarchy"),
+    cl::init(false));
+
 static cl::opt<bool>
     grandCentral("firrtl-grand-central",
                  cl::desc("create interfaces and data/memory taps from SiFive "
                           "Grand Central annotations"),
                  cl::init(false));
 
-enum OutputFormatKind {
-  OutputMLIR,
-  OutputVerilog,
-  OutputSplitVerilog,
-  OutputDisabled
-};
-
 static cl::opt<OutputFormatKind> outputFormat(
     cl::desc("Specify output format:"),
     cl::values(clEnumValN(OutputMLIR, "mlir", "Emit MLIR dialect"),
+               clEnumValN(OutputFIRBytecode, "firbc",
+                          "Emit MLIR dialect as FIRRTL bytecode"),
                clEnumValN(OutputVerilog, "verilog", "Emit Verilog"),
                clEnumValN(OutputSplitVerilog, "split-verilog",
                           "Emit Verilog (one file per module; specify "
@@ -136,11 +223,78 @@ static cl::opt<OutputFormatKind> outputFormat(
                           "Do not output anything")),
     cl::init(OutputMLIR));
 
+static cl::opt<bool> incrementalSplitVerilog(
+    "incremental-split-verilog",
+    cl::desc("with -split-verilog, only rewrite the files whose contents "
+             "changed since the previous run"),
+    cl::init(false));
+
+static cl::opt<bool> parallelMLIROutput(
+    "parallel-mlir-output",
+    cl::desc("with -mlir, print the modules on several threads and write "
+             "them in order. The types and attributes are printed in full "
+             "rather than through aliases"),
+    cl::init(false));
+
+static cl::opt<std::string> exportVerilogStats(
+    "export-verilog-stats",
+    cl::desc("Write the size, temporaries, spilled wires and emission time of "
+             "each Verilog module to this file as JSON"),
+    cl::value_desc("filename"), cl::init(""));
+
+static cl::opt<std::string> memoryProfile(
+    "memory-profile",
+    cl::desc("Write the number of live operations and the resident set size "
+             "before and after each pass of the pipeline to this file as "
+             "JSON"),
+    cl::value_desc("filename"), cl::init(""));
+
+static cl::opt<bool> parallelEfficiency(
+    "parallel-efficiency",
+    cl::desc("Print the wall time of each nested pass pipeline against the "
+             "time summed over the modules it ran on"),
+    cl::init(false));
+
+static cl::opt<unsigned>
+    numThreads("threads",
+               cl::desc("Number of threads to run the passes on, 0 uses all "
+                        "the cores"),
+               cl::init(0));
+
+static cl::opt<std::string> cacheDir(
+    "cache-dir",
+    cl::desc("Keep the output of each run in this directory, keyed by the "
+             "input, the annotation file and the flags, and reuse it when "
+             "the same input is compiled again.  Split Verilog is kept per "
+             "file instead, and only the files of the changed modules are "
+             "emitted again"),
+    cl::value_desc("directory"), cl::init(""));
+
+static cl::opt<std::string> cachePolicy(
+    "cache-policy",
+    cl::desc("When to evict entries from the -cache-dir, as an LLVM cache "
+             "pruning policy like prune_after=24h:cache_size_bytes=1g"),
+    cl::init(""));
+
+static cl::opt<std::string> checkpointDir(
+    "checkpoint-dir",
+    cl::desc("Write the IR to this directory in the FIRRTL bytecode format "
+             "after parsing, lowering the types, lowering to HW and cleaning "
+             "up the HW; firtool resumes the pipeline after the stage a "
+             "checkpoint was written at when given one as input"),
+    cl::value_desc("directory"), cl::init(""));
+
 static cl::opt<bool>
     verifyPasses("verify-each",
                  cl::desc("Run the verifier after each transformation pass"),
                  cl::init(true));
 
+static cl::opt<bool> verifyBoundaries(
+    "verify-boundaries",
+    cl::desc("Only run the verifier on the FIRRTL circuit before lowering to "
+             "HW and on the final output, instead of after each pass"),
+    cl::init(false));
+
 static cl::opt<std::string>
     inputAnnotationFilename("annotation-file",
                             cl::desc("Optional input annotation file"),
@@ -157,227 +311,905 @@ static cl::opt<std::string> blackBoxRootResourcePath(
         "Optional path to use as the root of black box resource annotations"),
     cl::value_desc("path"), cl::init(""));
 
-/// Process a single buffer of the input.
-static LogicalResult
-processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
-              StringRef annotationFilename, TimingScope &ts,
-              MLIRContext &context,
-              std::function<LogicalResult(ModuleOp)> callback) {
-  // Register our dialects.
-  context.loadDialect<firrtl::FIRRTLDialect, hw::HWDialect, comb::CombDialect,
-                      sv::SVDialect>();
+static cl::opt<uint64_t> blackBoxInlineSizeLimit(
+    "blackbox-inline-size-limit",
+    cl::desc("Include black box source files larger than this many bytes by "
+             "path instead of copying them (0 copies all files)"),
+    cl::value_desc("bytes"), cl::init(0));
 
-  llvm::SourceMgr sourceMgr;
-  sourceMgr.AddNewSourceBuffer(std::move(ownedBuffer), llvm::SMLoc());
-  SourceMgrDiagnosticHandler sourceMgrHandler(sourceMgr, &context);
+/// Return the peak resident set size of this process in bytes, or zero if the
+/// host doesn't tell us.
+static uint64_t getPeakRSS() {
+#ifdef LLVM_ON_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return uint64_t(usage.ru_maxrss);
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
 
-  // Add the annotation file if one was explicitly specified.
-  std::string annotationFilenameDetermined;
-  if (!annotationFilename.empty()) {
-    if (!(sourceMgr.AddIncludeFile(annotationFilename.str(), llvm::SMLoc(),
-                                   annotationFilenameDetermined))) {
-      llvm::errs() << "cannot open input annotation file '"
-                   << annotationFilename << "': No such file or directory\n";
-      return failure();
-    }
+/// Record the peak RSS as a (zero-length) nested timer so that it shows up
+/// next to the phase in the `-mlir-timing` report.
+static void reportPeakRSS(TimingScope &ts) {
+  if (auto peakRSS = getPeakRSS())
+    ts.nest(("Peak RSS: " + Twine(peakRSS >> 20) + " MiB").str());
+}
+
+/// Return the current resident set size of this process in bytes, or the peak
+/// RSS if the host doesn't tell us.
+static uint64_t getCurrentRSS() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size, resident;
+  if (statm >> size >> resident)
+    return resident * llvm::sys::Process::getPageSizeEstimate();
+#endif
+  return getPeakRSS();
+}
+
+namespace {
+/// Records the number of live operations in the design and the resident set
+/// size of the process before and after each pass.  Only the passes running
+/// on the top-level module or on the FIRRTL circuit are recorded.  The passes
+/// nested below them run on many operations concurrently, and their memory is
+/// attributed to the pipeline running them.
+class MemoryProfiler : public PassInstrumentation {
+public:
+  void runBeforePass(Pass *pass, Operation *op) override {
+    if (!isProfiled(op))
+      return;
+    Entry entry;
+    entry.pass = pass->getName().str();
+    entry.op = op->getName().getStringRef().str();
+    entry.depth = openEntries.size();
+    entry.opsBefore = countOperations(op);
+    entry.rssBefore = getCurrentRSS();
+    openEntries.push_back(entries.size());
+    entries.push_back(std::move(entry));
   }
 
-  OwningModuleRef module;
-  if (inputFormat == InputFIRFile) {
-    auto parserTimer = ts.nest("FIR Parser");
-    firrtl::FIRParserOptions options;
-    options.ignoreInfoLocators = ignoreFIRLocations;
-    module = importFIRRTL(sourceMgr, &context, options);
-  } else {
-    auto parserTimer = ts.nest("MLIR Parser");
-    assert(inputFormat == InputMLIRFile);
-    module = parseSourceFile(sourceMgr, &context);
+  void runAfterPass(Pass *pass, Operation *op) override { finishEntry(op); }
+  void runAfterPassFailed(Pass *pass, Operation *op) override {
+    finishEntry(op);
   }
-  if (!module)
-    return failure();
 
-  // Apply any pass manager command line options.
-  PassManager pm(&context);
-  pm.enableVerifier(verifyPasses);
-  pm.enableTiming(ts);
-  applyPassManagerCLOptions(pm);
-
-  if (!disableOptimization) {
-    pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>().addPass(
-        createCSEPass());
-  }
-
-  // Width inference creates canonicalization opportunities.
-  if (inferWidths)
-    pm.nest<firrtl::CircuitOp>().addPass(firrtl::createInferWidthsPass());
-
-  // The input mlir file could be firrtl dialect so we might need to clean
-  // things up.
-  if (lowerTypes) {
-    pm.addNestedPass<firrtl::CircuitOp>(firrtl::createLowerFIRRTLTypesPass());
-    // Only enable expand whens if lower types is also enabled.
-    if (expandWhens) {
-      auto &modulePM = pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>();
-      modulePM.addPass(firrtl::createExpandWhensPass());
+  /// Print the recorded passes in the order they started.  The depth of each
+  /// entry is the number of recorded passes nesting it.
+  void printJSON(raw_ostream &os) const {
+    llvm::json::OStream json(os, /*IndentSize=*/2);
+    json.object([&] {
+      json.attribute("peakRSS", int64_t(getPeakRSS()));
+      json.attributeArray("passes", [&] {
+        for (auto &entry : entries) {
+          json.object([&] {
+            json.attribute("pass", entry.pass);
+            json.attribute("op", entry.op);
+            json.attribute("depth", int64_t(entry.depth));
+            json.attribute("opsBefore", int64_t(entry.opsBefore));
+            json.attribute("opsAfter", int64_t(entry.opsAfter));
+            json.attribute("rssBefore", int64_t(entry.rssBefore));
+            json.attribute("rssAfter", int64_t(entry.rssAfter));
+          });
+        }
+      });
+    });
+    os << "\n";
+  }
+
+private:
+  struct Entry {
+    std::string pass;
+    std::string op;
+    size_t depth = 0;
+    uint64_t opsBefore = 0, opsAfter = 0;
+    uint64_t rssBefore = 0, rssAfter = 0;
+  };
+
+  static bool isProfiled(Operation *op) {
+    return isa<ModuleOp, firrtl::CircuitOp>(op);
+  }
+
+  /// Count the operations of the whole design containing `op`.
+  static uint64_t countOperations(Operation *op) {
+    while (auto *parent = op->getParentOp())
+      op = parent;
+    uint64_t count = 0;
+    op->walk([&](Operation *) { ++count; });
+    return count;
+  }
+
+  void finishEntry(Operation *op) {
+    if (!isProfiled(op))
+      return;
+    auto &entry = entries[openEntries.pop_back_val()];
+    entry.opsAfter = countOperations(op);
+    entry.rssAfter = getCurrentRSS();
+  }
+
+  std::vector<Entry> entries;
+  SmallVector<size_t> openEntries;
+};
+} // namespace
+
+namespace {
+/// Measure how well the nested pass pipelines parallelize.  For each pass
+/// manager nested in a pass, like the one running on every `hw.module` of a
+/// `builtin.module`, this compares the wall time of the enclosing pass with
+/// the time the nested passes spent on each module, summed over all threads.
+///
+/// The instrumentation is called from the threads running the nested
+/// pipelines, so all bookkeeping happens under a lock.
+class ParallelEfficiencyReport : public PassInstrumentation {
+public:
+  ParallelEfficiencyReport(unsigned numThreads) : numThreads(numThreads) {}
+
+  void runBeforePipeline(Identifier name,
+                         const PipelineParentInfo &parentInfo) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    threadPipelines[llvm::get_threadid()].push_back(parentInfo.parentPass);
+    if (!parentInfo.parentPass)
+      return;
+    auto &pipeline = nested[parentInfo.parentPass];
+    if (pipeline.opName.empty()) {
+      pipeline.opName = name.str();
+      nestingOrder.push_back(parentInfo.parentPass);
     }
   }
 
-  // If we parsed a FIRRTL file and have optimizations enabled, clean it up.
-  if (!disableOptimization) {
-    auto &modulePM = pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>();
-    modulePM.addPass(createSimpleCanonicalizerPass());
+  void runAfterPipeline(Identifier name,
+                        const PipelineParentInfo &parentInfo) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    threadPipelines[llvm::get_threadid()].pop_back();
+  }
+
+  void runBeforePass(Pass *pass, Operation *op) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    startTimes[{pass, op}] = std::chrono::steady_clock::now();
   }
 
-  if (inliner)
-    pm.nest<firrtl::CircuitOp>().addPass(firrtl::createInlinerPass());
+  void runAfterPass(Pass *pass, Operation *op) override {
+    finishPass(pass, op);
+  }
+  void runAfterPassFailed(Pass *pass, Operation *op) override {
+    finishPass(pass, op);
+  }
 
-  if (imconstprop)
-    pm.nest<firrtl::CircuitOp>().addPass(firrtl::createIMConstPropPass());
+  /// Print the nested pipelines in the order they first ran.
+  void print(raw_ostream &os) const {
+    os << "===" << std::string(73, '-') << "===\n"
+       << std::string(24, ' ') << "... Parallel Efficiency Report ...\n"
+       << "===" << std::string(73, '-') << "===\n"
+       << "  Threads: " << numThreads << "\n";
 
-  if (blackBoxMemory)
-    pm.nest<firrtl::CircuitOp>().addPass(firrtl::createBlackBoxMemoryPass());
+    for (auto *parentPass : nestingOrder) {
+      auto &pipeline = nested.find(parentPass)->second;
+      auto &parentRun = passRuns.find(parentPass)->second;
+      auto wall = parentRun.seconds;
+      os << "\n  '" << pipeline.opName << "' pipeline on '" << parentRun.opName
+         << "'\n";
+      os << "    Wall time:      " << llvm::format("%.4f", wall) << " s\n";
+      os << "    Module time:    " << llvm::format("%.4f", pipeline.total)
+         << " s";
+      if (wall > 0)
+        os << " (speedup " << llvm::format("%.2f", pipeline.total / wall)
+           << "x, efficiency "
+           << llvm::format("%.1f", 100 * pipeline.total / wall / numThreads)
+           << "%)";
+      os << "\n";
+      os << "    Modules:        " << pipeline.modules.size() << "\n";
 
-  // Read black box source files into the IR.
-  StringRef blackBoxRoot = blackBoxRootPath.empty()
-                               ? llvm::sys::path::parent_path(inputFilename)
-                               : blackBoxRootPath;
-  pm.nest<firrtl::CircuitOp>().addPass(firrtl::createBlackBoxReaderPass(
-      blackBoxRoot, blackBoxRootResourcePath.empty()
-                        ? blackBoxRoot
-                        : blackBoxRootResourcePath));
-
-  if (grandCentral) {
-    auto &circuitPM = pm.nest<firrtl::CircuitOp>();
-    circuitPM.addPass(firrtl::createGrandCentralPass());
-    circuitPM.addPass(firrtl::createGrandCentralTapsPass());
-  }
-
-  // Lower if we are going to verilog or if lowering was specifically requested.
-  if (lowerToHW || outputFormat == OutputVerilog ||
-      outputFormat == OutputSplitVerilog) {
-    pm.addPass(createLowerFIRRTLToHWPass(enableAnnotationWarning.getValue()));
-    pm.addPass(sv::createHWMemSimImplPass());
-
-    if (extractTestCode)
-      pm.addPass(sv::createSVExtractTestCodePass());
-
-    // If enabled, run the optimizer.
-    if (!disableOptimization) {
-      auto &modulePM = pm.nest<hw::HWModuleOp>();
-      modulePM.addPass(sv::createHWCleanupPass());
-      modulePM.addPass(createCSEPass());
-      modulePM.addPass(createSimpleCanonicalizerPass());
+      const ModuleTime *largest = nullptr;
+      for (auto &module : pipeline.modules)
+        if (!largest || module.second.seconds > largest->seconds)
+          largest = &module.second;
+      if (largest) {
+        os << "    Largest module: " << largest->name << ", "
+           << llvm::format("%.4f", largest->seconds) << " s";
+        if (pipeline.total > 0)
+          os << " ("
+             << llvm::format("%.1f", 100 * largest->seconds / pipeline.total)
+             << "% of the module time)";
+        os << "\n";
+      }
+
+      os << "    Passes:\n";
+      for (auto &pass : pipeline.passes)
+        os << "      " << llvm::format("%.4f", pass.second) << " s  "
+           << pass.first->getName() << "\n";
     }
   }
 
-  // Add passes specific to Verilog emission if we're going there.
-  if (outputFormat == OutputVerilog || outputFormat == OutputSplitVerilog) {
-    // Legalize the module names.
-    pm.addPass(sv::createHWLegalizeNamesPass());
+private:
+  struct PassRun {
+    std::string opName;
+    double seconds = 0;
+  };
+
+  struct ModuleTime {
+    std::string name;
+    double seconds = 0;
+  };
 
-    // Tidy up the IR to improve verilog emission quality.
-    if (!disableOptimization) {
-      auto &modulePM = pm.nest<hw::HWModuleOp>();
-      modulePM.addPass(sv::createPrettifyVerilogPass());
+  struct NestedPipeline {
+    std::string opName;
+    double total = 0;
+    llvm::MapVector<Operation *, ModuleTime> modules;
+    llvm::MapVector<Pass *, double> passes;
+  };
+
+  void finishPass(Pass *pass, Operation *op) {
+    auto end = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = startTimes.find({pass, op});
+    if (it == startTimes.end())
+      return;
+    double seconds = std::chrono::duration<double>(end - it->second).count();
+    startTimes.erase(it);
+    auto &run = passRuns[pass];
+    if (run.opName.empty())
+      run.opName = op->getName().getStringRef().str();
+    run.seconds += seconds;
+
+    // Account the time to the innermost pipeline running on this thread.
+    auto &pipelines = threadPipelines[llvm::get_threadid()];
+    if (pipelines.empty() || !pipelines.back())
+      return;
+    auto &pipeline = nested[pipelines.back()];
+    pipeline.total += seconds;
+    pipeline.passes[pass] += seconds;
+    auto &module = pipeline.modules[op];
+    if (module.name.empty()) {
+      auto name =
+          op->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+      module.name = name ? name.getValue().str()
+                         : op->getName().getStringRef().str();
     }
+    module.seconds += seconds;
   }
 
+  unsigned numThreads;
+  std::mutex mutex;
+  DenseMap<std::pair<Pass *, Operation *>,
+           std::chrono::steady_clock::time_point>
+      startTimes;
+  DenseMap<Pass *, PassRun> passRuns;
+  DenseMap<Pass *, NestedPipeline> nested;
+  SmallVector<Pass *> nestingOrder;
+  DenseMap<uint64_t, SmallVector<Pass *>> threadPipelines;
+};
+} // namespace
+
+/// The pass pipelines built so far, keyed by the input format, the black box
+/// root directory and the stage they start after.  Batch runs compile many
+/// inputs with the same pipeline, which is only built once.
+using PipelineCache = llvm::StringMap<std::unique_ptr<PassManager>>;
+
+/// Collect the options of the pipeline from the command line.
+static firtool::FirtoolOptions getFirtoolOptions() {
+  firtool::FirtoolOptions options;
+  options.outputFormat = outputFormat;
+  options.disableOptimization = disableOptimization;
+  options.incrementalCanonicalize = incrementalCanonicalize;
+  options.inliner = inliner;
+  options.dedup = dedup;
+  options.lowerToHW = lowerToHW;
+  options.enableAnnotationWarning = enableAnnotationWarning;
+  options.groupDebugStatements = groupDebugStatements;
+  options.imconstprop = imconstprop;
+  options.imdce = imdce;
+  options.lowerTypes = lowerTypes;
+  options.preserveAggregate = preserveAggregate;
+  options.randomizeMemInit = randomizeMemInit;
+  options.readMemInit = readMemInit;
+  options.expandWhens = expandWhens;
+  options.forwardConnects = forwardConnects;
+  options.blackBoxMemory = blackBoxMemory;
+  options.inferWidths = inferWidths;
+  options.extractTestCode = extractTestCode;
+  options.interfaceOnly = interfaceOnly;
+  options.grandCentral = grandCentral;
+  options.ignoreFIRLocations = ignoreFIRLocations;
+  options.lazyFIRLocations = lazyFIRLocations;
+  options.streamModulePasses = streamModulePasses;
+  options.verifyPasses = verifyPasses;
+  options.verifyBoundaries = verifyBoundaries;
+  options.blackBoxRootPath = blackBoxRootPath;
+  options.blackBoxRootResourcePath = blackBoxRootResourcePath;
+  options.blackBoxInlineSizeLimit = blackBoxInlineSizeLimit;
+  options.checkpointDir = checkpointDir;
+  options.incrementalSplitVerilog = incrementalSplitVerilog;
+  options.parallelMLIROutput = parallelMLIROutput;
+  return options;
+}
+
+/// Return the pass pipeline for inputs of the given format which resumes
+/// after `resumeStage`, building it if this is the first input needing it.
+/// The pass timings of all runs of the pipeline are collected under \p ts.
+static PassManager &getPipeline(MLIRContext &context, PipelineCache &pipelines,
+                                InputFormatKind format, StringRef blackBoxRoot,
+                                CheckpointStage resumeStage, TimingScope &ts) {
+  auto key = (Twine(int(format)) + ":" + Twine(int(resumeStage)) + ":" +
+              blackBoxRoot)
+                 .str();
+  auto &pm = pipelines[key];
+  if (!pm) {
+    // Apply any pass manager command line options.
+    pm = std::make_unique<PassManager>(&context);
+    pm->enableVerifier(verifyPasses && !verifyBoundaries);
+    pm->enableTiming(ts);
+    applyPassManagerCLOptions(*pm);
+    firtool::populateFirtoolPipeline(*pm, getFirtoolOptions(), format,
+                                     blackBoxRoot, resumeStage);
+  }
+  return *pm;
+}
+
+/// Process a single buffer of the input.  The pass pipeline is requested once
+/// the input is parsed, since a checkpoint determines where it starts.
+static LogicalResult
+processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
+              std::unique_ptr<llvm::MemoryBuffer> annotations,
+              InputFormatKind format,
+              function_ref<PassManager &(CheckpointStage, StringRef)>
+                  getPipelineAfter,
+              TimingScope &ts, MLIRContext &context,
+              std::function<LogicalResult(ModuleOp, TimingScope &)> callback) {
+  firtool::FirtoolCallbacks callbacks;
+  callbacks.afterParse = reportPeakRSS;
   // Load the emitter options from the command line. Command line options if
   // specified will override any module options.
-  applyLoweringCLOptions(module.get());
-
-  if (failed(pm.run(module.get())))
-    return failure();
+  callbacks.prepareModule = applyLoweringCLOptions;
+  callbacks.getPipelineAfter = getPipelineAfter;
+  // Inputs compiled in parallel share the handler of `executeParallel`,
+  // rather than each register one on the shared context.
+  if (batchMode || inputFilenames.size() == 1)
+    callbacks.getDiagnosticHandler = [&](llvm::SourceMgr &sourceMgr) {
+      return std::make_unique<SourceMgrDiagnosticHandler>(sourceMgr,
+                                                          &context);
+    };
 
-  auto outputTimer = ts.nest("Output");
+  OwningModuleRef module;
+  auto result = firtool::compileFirtoolInput(
+      std::move(ownedBuffer), std::move(annotations), format,
+      getFirtoolOptions(), context, ts, callbacks, callback, &module);
 
   // Note that we intentionally "leak" the Module into the MLIRContext instead
   // of deallocating it.  There is no need to deallocate it right before
-  // process exit.
-  return callback(module.release());
+  // process exit.  Batch runs and runs with several inputs keep using the
+  // context, so the module is destroyed there.
+  if (!batchMode && inputFilenames.size() == 1)
+    (void)module.release();
+  return result;
 }
 
-/// This implements the top-level logic for the firtool command, invoked once
-/// command line options are parsed and LLVM/MLIR are all set up and ready to
-/// go.
-static LogicalResult executeFirtool(MLIRContext &context) {
-  // Create the timing manager we use to sample execution times.
-  DefaultTimingManager tm;
-  applyDefaultTimingManagerCLOptions(tm);
-  auto ts = tm.getRootScope();
+/// Determine the format of an input file from its extension, unless one was
+/// specified on the command line.  Returns `InputUnspecified` if the format is
+/// unknown.
+static InputFormatKind getInputFormat(StringRef filename) {
+  if (inputFormat != InputUnspecified)
+    return inputFormat;
+  if (filename.endswith(".fir"))
+    return InputFIRFile;
+  if (filename.endswith(".mlir"))
+    return InputMLIRFile;
+  if (filename.endswith(".firbc"))
+    return InputFIRBytecodeFile;
+  return InputUnspecified;
+}
 
-  // Figure out the input format if unspecified.
-  if (inputFormat == InputUnspecified) {
-    if (StringRef(inputFilename).endswith(".fir"))
-      inputFormat = InputFIRFile;
-    else if (StringRef(inputFilename).endswith(".mlir"))
-      inputFormat = InputMLIRFile;
-    else {
-      llvm::errs() << "unknown input format: "
-                      "specify with -format=fir or -format=mlir\n";
-      return failure();
+//===----------------------------------------------------------------------===//
+// Output Cache
+//===----------------------------------------------------------------------===//
+
+/// The command line flags which go into the key of the output cache.
+static std::string cacheKeyFlags;
+
+/// Record the command line flags which go into the key of the output cache.
+/// The input and output names, and the flags which only control how firtool
+/// runs rather than what it produces, are left out.
+static void recordCacheKeyFlags(int argc, char **argv) {
+  static const llvm::StringSet<> ignoredFlags = {
+      "o",         "j",           "batch",      "threads",
+      "cache-dir", "cache-policy", "mlir-timing", "mlir-timing-display",
+      "mlir-disable-threading"};
+  auto &options = cl::getRegisteredOptions();
+  for (int i = 1; i < argc; ++i) {
+    StringRef arg = argv[i];
+    // Positional arguments are the input names.
+    if (!arg.startswith("-") || arg == "-")
+      continue;
+    auto flag = arg.ltrim('-');
+    auto name = flag.split('=').first;
+    auto *option = options.lookup(name);
+    bool valueFollows = option && name.size() == flag.size() && i + 1 < argc &&
+                        option->getValueExpectedFlag() == cl::ValueRequired;
+    if (ignoredFlags.count(name)) {
+      i += valueFollows;
+      continue;
     }
+    cacheKeyFlags += flag.str();
+    if (valueFollows)
+      cacheKeyFlags += "=" + std::string(argv[++i]);
+    cacheKeyFlags += '\0';
+  }
+}
+
+/// Identify the firtool binary by its path and modification time, so that a
+/// rebuilt firtool doesn't reuse the output of the previous one.
+static std::string getExecutableIdentity() {
+  static int anchor;
+  auto path = llvm::sys::fs::getMainExecutable("firtool", &anchor);
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status))
+    return path;
+  return path + ":" +
+         std::to_string(
+             status.getLastModificationTime().time_since_epoch().count());
+}
+
+/// Return the path of the cache entry holding the output of the given input,
+/// or an empty path if the output isn't cached.  Only outputs written to a
+/// single file, without any side outputs, are cached.
+static std::string getCachePath(StringRef inputName,
+                                const llvm::MemoryBuffer &input,
+                                const llvm::MemoryBuffer *annotations) {
+  if (cacheDir.empty() || (outputFormat != OutputMLIR &&
+                           outputFormat != OutputFIRBytecode &&
+                           outputFormat != OutputVerilog))
+    return {};
+  if (!exportVerilogStats.empty() || !memoryProfile.empty() ||
+      !checkpointDir.empty() || parallelEfficiency)
+    return {};
+
+  llvm::MD5 hash;
+  auto update = [&](StringRef data) {
+    hash.update(data);
+    hash.update(StringRef("\0", 1));
+  };
+  update(getExecutableIdentity());
+  update(cacheKeyFlags);
+  update(inputName);
+  update(input.getBuffer());
+  if (annotations)
+    update(annotations->getBuffer());
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+
+  // The prefix lets LLVM's cache pruning recognize the entries.
+  SmallString<128> path(cacheDir);
+  llvm::sys::path::append(path, Twine("llvmcache-") + result.digest());
+  return std::string(path);
+}
+
+/// Mark a cache entry as recently used, so that it is pruned last.
+static void touchCacheEntry(StringRef path) {
+  int fd;
+  if (llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::CD_OpenExisting,
+                                      llvm::sys::fs::OF_Append))
+    return;
+  auto now = std::chrono::system_clock::now();
+  (void)llvm::sys::fs::setLastAccessAndModificationTime(fd, now, now);
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+/// Record the output of a successful run in the cache.  The entry is written
+/// to a temporary file first, so that concurrent runs never see a partial
+/// entry.  Failing to write the cache isn't an error.
+static void writeCacheEntry(StringRef path, StringRef output) {
+  if (llvm::sys::fs::create_directories(cacheDir))
+    return;
+  int fd;
+  SmallString<128> tempPath;
+  if (llvm::sys::fs::createUniqueFile(Twine(path) + "-%%%%%%%%", fd,
+                                       tempPath))
+    return;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << output;
   }
+  if (llvm::sys::fs::rename(tempPath, path))
+    llvm::sys::fs::remove(tempPath);
+}
+
+/// Compile one input file into the given output file, or output directory for
+/// split Verilog.  The parser and output timings are nested under \p ts, the
+/// pass timings under \p pipelineTs.
+static LogicalResult compileInput(MLIRContext &context,
+                                  PipelineCache &pipelines,
+                                  TimingScope &pipelineTs, TimingScope &ts,
+                                  StringRef inputName, StringRef outputName) {
+  auto format = getInputFormat(inputName);
+  if (format == InputUnspecified) {
+    llvm::errs() << "unknown input format: "
+                    "specify with -format=fir, -format=mlir or "
+                    "-format=firbc\n";
+    return failure();
+  }
+
+  // Read the annotation file on another thread while the input is read,
+  // since on a cold network file system both reads mostly wait.
+  std::future<llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>>
+      annotationsFuture;
+  if (!inputAnnotationFilename.empty())
+    annotationsFuture = std::async(
+        context.isMultithreadingEnabled() ? std::launch::async
+                                          : std::launch::deferred,
+        [] { return llvm::MemoryBuffer::getFile(inputAnnotationFilename); });
 
   // Set up the input file.
   std::string errorMessage;
-  auto input = openInputFile(inputFilename, &errorMessage);
+  auto input = openInputFile(inputName, &errorMessage);
   if (!input) {
     llvm::errs() << errorMessage << "\n";
     return failure();
   }
 
+  std::unique_ptr<llvm::MemoryBuffer> annotations;
+  if (annotationsFuture.valid()) {
+    auto buffer = annotationsFuture.get();
+    if (!buffer) {
+      llvm::errs() << "cannot open input annotation file '"
+                   << inputAnnotationFilename
+                   << "': " << buffer.getError().message() << "\n";
+      return failure();
+    }
+    annotations = std::move(*buffer);
+  }
+
   // Create the output directory or output file depending on our mode.
   Optional<std::unique_ptr<llvm::ToolOutputFile>> outputFile;
   if (outputFormat != OutputSplitVerilog) {
     // Create an output file.
-    outputFile.emplace(openOutputFile(outputFilename, &errorMessage));
+    outputFile.emplace(openOutputFile(outputName, &errorMessage));
     if (!outputFile.getValue()) {
       llvm::errs() << errorMessage << "\n";
       return failure();
     }
   } else {
     // Create an output directory.
-    if (outputFilename.isDefaultOption() || outputFilename == "-") {
+    if (outputName == "-") {
       llvm::errs() << "missing output directory: specify with -o=<dir>\n";
       return failure();
     }
-    auto error = llvm::sys::fs::create_directory(outputFilename);
+    auto error = llvm::sys::fs::create_directory(outputName);
     if (error) {
-      llvm::errs() << "cannot create output directory '" << outputFilename
+      llvm::errs() << "cannot create output directory '" << outputName
                    << "': " << error.message() << "\n";
       return failure();
     }
   }
 
-  // Emit a single file or multiple files depending on the output format.
-  auto emitCallback = [&](ModuleOp module) -> LogicalResult {
-    switch (outputFormat) {
-    case OutputMLIR:
-      module->print(outputFile.getValue()->os());
-      return success();
-    case OutputDisabled:
+  // Reuse the output of an earlier run compiling the same input with the same
+  // flags.
+  auto cachePath = getCachePath(inputName, *input, annotations.get());
+  if (!cachePath.empty()) {
+    if (auto cached = llvm::MemoryBuffer::getFile(cachePath)) {
+      auto hitTimer = ts.nest("Output Cache Hit");
+      outputFile.getValue()->os() << (*cached)->getBuffer();
+      outputFile.getValue()->keep();
+      touchCacheEntry(cachePath);
       return success();
-    case OutputVerilog:
-      return exportVerilog(module, outputFile.getValue()->os());
-    case OutputSplitVerilog:
-      return exportSplitVerilog(module, outputFilename);
     }
-    return failure();
+  }
+
+  // When caching, the output is collected so that it can be stored as well.
+  std::string cachedOutput;
+  llvm::raw_string_ostream cacheStream(cachedOutput);
+  raw_ostream *os = outputFile ? &outputFile.getValue()->os() : nullptr;
+  if (!cachePath.empty())
+    os = &cacheStream;
+
+  // Emit a single file or multiple files depending on the output format.
+  ExportVerilogStatistics statistics;
+  auto *statisticsPtr = exportVerilogStats.empty() ? nullptr : &statistics;
+  auto emitCallback = [&](ModuleOp module,
+                          TimingScope &outputTimer) -> LogicalResult {
+    auto options = getFirtoolOptions();
+    options.splitVerilogCacheDir = cacheDir;
+    options.splitVerilogCacheSalt = getExecutableIdentity();
+    return firtool::emitFirtoolOutput(module, options, os, outputName,
+                                      outputTimer, statisticsPtr);
   };
 
-  auto result = processBuffer(std::move(input), inputAnnotationFilename, ts,
-                              context, std::move(emitCallback));
+  StringRef blackBoxRoot = blackBoxRootPath.empty()
+                               ? llvm::sys::path::parent_path(inputName)
+                               : StringRef(blackBoxRootPath);
+  MemoryProfiler *profiler = nullptr;
+  ParallelEfficiencyReport *efficiencyReport = nullptr;
+  auto getPipelineAfter =
+      [&](CheckpointStage resumeStage,
+          StringRef checkpointBlackBoxRoot) -> PassManager & {
+    // The black boxes of a checkpoint are looked up where the run writing it
+    // looked for them, rather than next to the checkpoint.
+    StringRef root = blackBoxRoot;
+    if (blackBoxRootPath.empty() && !checkpointBlackBoxRoot.empty())
+      root = checkpointBlackBoxRoot;
+    auto &pm = getPipeline(context, pipelines, format, root, resumeStage,
+                           pipelineTs);
+    if (!memoryProfile.empty()) {
+      auto instrumentation = std::make_unique<MemoryProfiler>();
+      profiler = instrumentation.get();
+      pm.addInstrumentation(std::move(instrumentation));
+    }
+    if (parallelEfficiency) {
+      unsigned threads = context.isMultithreadingEnabled()
+                             ? llvm::parallel::strategy.compute_thread_count()
+                             : 1;
+      auto instrumentation =
+          std::make_unique<ParallelEfficiencyReport>(threads);
+      efficiencyReport = instrumentation.get();
+      pm.addInstrumentation(std::move(instrumentation));
+    }
+    return pm;
+  };
+
+  // Create the checkpoint directory up front, rather than in each checkpoint.
+  if (!checkpointDir.empty()) {
+    auto error = llvm::sys::fs::create_directories(checkpointDir);
+    if (error) {
+      llvm::errs() << "cannot create checkpoint directory '" << checkpointDir
+                   << "': " << error.message() << "\n";
+      return failure();
+    }
+  }
+
+  auto result =
+      processBuffer(std::move(input), std::move(annotations), format,
+                    getPipelineAfter, ts, context, std::move(emitCallback));
+
+  // Write out the memory profile even if the pipeline failed, since it shows
+  // how far the pipeline got.
+  if (profiler) {
+    auto profileFile = openOutputFile(memoryProfile, &errorMessage);
+    if (!profileFile) {
+      llvm::errs() << errorMessage << "\n";
+      return failure();
+    }
+    profiler->printJSON(profileFile->os());
+    profileFile->keep();
+  }
+
+  if (efficiencyReport)
+    efficiencyReport->print(llvm::errs());
+
   if (failed(result))
     return failure();
 
+  if (!cachePath.empty()) {
+    auto missTimer = ts.nest("Output Cache Miss");
+    cacheStream.flush();
+    outputFile.getValue()->os() << cachedOutput;
+    writeCacheEntry(cachePath, cachedOutput);
+  }
+
   // If the result succeeded and we're emitting a file, close it.
   if (outputFile.hasValue())
     outputFile.getValue()->keep();
 
+  // Write out the emission statistics if requested.
+  if (statisticsPtr) {
+    auto statsFile = openOutputFile(exportVerilogStats, &errorMessage);
+    if (!statsFile) {
+      llvm::errs() << errorMessage << "\n";
+      return failure();
+    }
+    statistics.printJSON(statsFile->os());
+    statsFile->keep();
+  }
+
+  return success();
+}
+
+/// Check the options of a run compiling several inputs into the output
+/// directory, and create the directory.
+static LogicalResult prepareOutputDirectory() {
+  if (outputFilename.isDefaultOption() || outputFilename == "-") {
+    llvm::errs() << "missing output directory: specify with -o=<dir>\n";
+    return failure();
+  }
+  if (!inputAnnotationFilename.empty() || !exportVerilogStats.empty() ||
+      !memoryProfile.empty() || !checkpointDir.empty() || parallelEfficiency) {
+    llvm::errs() << "-annotation-file, -export-verilog-stats, -memory-profile, "
+                    "-checkpoint-dir and -parallel-efficiency cannot be used "
+                    "with -batch or multiple inputs\n";
+    return failure();
+  }
+  auto error = llvm::sys::fs::create_directories(outputFilename);
+  if (error) {
+    llvm::errs() << "cannot create output directory '" << outputFilename
+                 << "': " << error.message() << "\n";
+    return failure();
+  }
+  return success();
+}
+
+/// Return the output an input is compiled into when compiling several inputs
+/// and no output is named for it: a file, or directory for split Verilog,
+/// named like the input in the output directory.
+static std::string getOutputNameInDirectory(StringRef inputName) {
+  if (outputFormat == OutputDisabled)
+    return "-";
+
+  SmallString<128> outputName(outputFilename);
+  llvm::sys::path::append(outputName, llvm::sys::path::stem(inputName));
+  switch (outputFormat) {
+  case OutputMLIR:
+    outputName += ".mlir";
+    break;
+  case OutputFIRBytecode:
+    outputName += ".firbc";
+    break;
+  case OutputVerilog:
+    outputName += ".sv";
+    break;
+  case OutputSplitVerilog:
+  case OutputDisabled:
+    break;
+  }
+  return std::string(outputName);
+}
+
+/// Compile the requests of a batch, read from the input one line at a time so
+/// that they can be streamed in through a pipe.  Each line names an input file
+/// and optionally the output to compile it into.  Once a request is done, a
+/// line with its status, input and compile time in seconds is printed.  A
+/// failing request doesn't stop the batch.
+static LogicalResult executeBatch(MLIRContext &context, TimingScope &ts) {
+  if (inputFilenames.size() != 1) {
+    llvm::errs() << "-batch takes a single list of requests\n";
+    return failure();
+  }
+  if (failed(prepareOutputDirectory()))
+    return failure();
+
+  std::ifstream requestFile;
+  std::istream *requests = &std::cin;
+  StringRef requestFilename = inputFilenames.front();
+  if (requestFilename != "-") {
+    requestFile.open(requestFilename.str());
+    if (!requestFile) {
+      llvm::errs() << "cannot open batch file '" << requestFilename << "'\n";
+      return failure();
+    }
+    requests = &requestFile;
+  }
+
+  PipelineCache pipelines;
+  bool anyFailed = false;
+  std::string line;
+  while (std::getline(*requests, line)) {
+    auto request = StringRef(line).trim();
+    if (request.empty() || request.startswith("#"))
+      continue;
+    auto inputAndOutput = request.split(' ');
+    auto inputName = inputAndOutput.first;
+    auto outputName = inputAndOutput.second.trim().str();
+    if (outputName.empty())
+      outputName = getOutputNameInDirectory(inputName);
+
+    using Clock = std::chrono::steady_clock;
+    auto startTime = Clock::now();
+    LogicalResult result = failure();
+    {
+      auto requestTimer = ts.nest(inputName);
+      result = compileInput(context, pipelines, ts, requestTimer, inputName,
+                            outputName);
+    }
+    auto seconds =
+        std::chrono::duration<double>(Clock::now() - startTime).count();
+    anyFailed |= failed(result);
+
+    llvm::outs() << (failed(result) ? "error " : "ok ") << inputName << " "
+                 << llvm::format("%.3f", seconds) << "\n";
+    llvm::outs().flush();
+  }
+  return failure(anyFailed);
+}
+
+/// Compile several inputs concurrently on a bounded number of threads, each
+/// into a file or directory named like it in the output directory.  Every
+/// input gets its own pass manager, but they all share the context, so that
+/// types and attributes common to the inputs are only uniqued once.  Each
+/// input is timed under a scope named after it.  The diagnostics are held
+/// back until all the inputs are compiled, and then printed in the order of
+/// the inputs.
+static LogicalResult executeParallel(MLIRContext &context, TimingScope &ts) {
+  if (failed(prepareOutputDirectory()))
+    return failure();
+
+  // Inputs with the same name would overwrite each other's output.
+  llvm::StringSet<> outputNames;
+  for (auto &inputName : inputFilenames) {
+    if (outputFormat != OutputDisabled &&
+        !outputNames.insert(getOutputNameInDirectory(inputName)).second) {
+      llvm::errs() << "multiple inputs are compiled into '"
+                   << getOutputNameInDirectory(inputName) << "'\n";
+      return failure();
+    }
+  }
+
+  // The source manager handler reads the lines it prints from the input
+  // files, so it doesn't need the buffers of the inputs.  The parallel
+  // handler orders the diagnostics by the index of the input of the thread
+  // reporting them, and hands them to it when it goes away.
+  llvm::SourceMgr sourceMgr;
+  SourceMgrDiagnosticHandler sourceMgrHandler(sourceMgr, &context);
+  ParallelDiagnosticHandler parallelHandler(&context);
+
+  std::atomic<bool> anyFailed(false);
+  auto compile = [&](size_t index) {
+    StringRef inputName = inputFilenames[index];
+    parallelHandler.setOrderIDForThread(index);
+    {
+      auto inputTimer = ts.nest(inputName);
+      PipelineCache pipelines;
+      if (failed(compileInput(context, pipelines, inputTimer, inputTimer,
+                              inputName,
+                              getOutputNameInDirectory(inputName))))
+        anyFailed = true;
+    }
+    parallelHandler.eraseOrderIDForThread();
+  };
+
+  if (!context.isMultithreadingEnabled()) {
+    for (size_t i = 0, e = inputFilenames.size(); i != e; ++i)
+      compile(i);
+  } else {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(numJobs));
+    for (size_t i = 0, e = inputFilenames.size(); i != e; ++i)
+      pool.async([&compile, i] { compile(i); });
+    pool.wait();
+  }
+  return failure(anyFailed);
+}
+
+/// Evict the entries of the output cache according to the -cache-policy.
+static LogicalResult pruneOutputCache() {
+  auto policy = llvm::parseCachePruningPolicy(cachePolicy);
+  if (!policy) {
+    llvm::errs() << "invalid -cache-policy: "
+                 << llvm::toString(policy.takeError()) << "\n";
+    return failure();
+  }
+  llvm::pruneCache(cacheDir, *policy);
   return success();
 }
 
+/// This implements the top-level logic for the firtool command, invoked once
+/// command line options are parsed and LLVM/MLIR are all set up and ready to
+/// go.
+static LogicalResult executeFirtool(MLIRContext &context) {
+  // Create the timing manager we use to sample execution times.
+  DefaultTimingManager tm;
+  applyDefaultTimingManagerCLOptions(tm);
+  auto ts = tm.getRootScope();
+
+  // Register our dialects.
+  firtool::loadFirtoolDialects(context);
+
+  // Read from stdin if no input is named.
+  if (inputFilenames.empty())
+    inputFilenames.push_back("-");
+
+  // Make room in the cache before adding to it.
+  if (!cacheDir.empty() && failed(pruneOutputCache()))
+    return failure();
+
+  if (batchMode)
+    return executeBatch(context, ts);
+  if (inputFilenames.size() > 1)
+    return executeParallel(context, ts);
+
+  PipelineCache pipelines;
+  return compileInput(context, pipelines, ts, ts, inputFilenames.front(),
+                      outputFilename);
+}
+
 /// Main driver for firtool command.  This sets up LLVM and MLIR, and parses
 /// command line options before passing off to 'executeFirtool'.  This is set up
 /// so we can `exit(0)` at the end of the program to avoid teardown of the
@@ -399,7 +1231,15 @@ int main(int argc, char **argv) {
   if (disableOptimization && imconstprop.getNumOccurrences() == 0)
     imconstprop = false;
 
+  // Size the thread pool running the passes before anything uses it.
+  if (numThreads)
+    llvm::parallel::strategy = llvm::hardware_concurrency(numThreads);
+
   MLIRContext context;
+  if (numThreads == 1)
+    context.disableMultithreading();
+
+  recordCacheKeyFlags(argc, argv);
 
   // Do the guts of the firtool process.
   auto result = executeFirtool(context);
@@ -11,14 +11,29 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <list>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 
 #include "circt/Dialect/Handshake/HandshakeOps.h"
 #include "circt/Dialect/Handshake/Simulation.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Support/FileUtilities.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #define DEBUG_TYPE "runner"
 
@@ -31,94 +46,526 @@ using namespace circt;
 STATISTIC(instructionsExecuted, "Instructions Executed");
 STATISTIC(simulatedTime, "Simulated Time");
 
-void executeOp(mlir::ConstantIndexOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
+//===----------------------------------------------------------------------===//
+// Typed values
+//===----------------------------------------------------------------------===//
+
+static uint64_t truncateTo(uint64_t bits, unsigned width) {
+  return bits & maskTrailingOnes<uint64_t>(width);
+}
+
+static int64_t signExtendFrom(uint64_t bits, unsigned width) {
+  return SignExtend64(bits, width);
+}
+
+static double roundFloat(double value, bool isF32) {
+  return isF32 ? static_cast<double>(static_cast<float>(value)) : value;
+}
+
+namespace {
+/// A value of the simulation. Integers of up to 64 bits are kept inline and
+/// zero-extended, only wider ones as APInt. Floats are kept as doubles,
+/// rounded to single precision for `f32` values. Buffers refer to an
+/// allocation of the store.
+class SimValue {
+public:
+  enum class Kind : uint8_t { Empty, Int, WideInt, Float, Buffer };
+
+  SimValue() = default;
+
+  static SimValue getInt(unsigned width, uint64_t bits) {
+    SimValue value(Kind::Int, width);
+    value.bits = truncateTo(bits, width);
+    return value;
+  }
+  static SimValue get(const APInt &wide) {
+    if (wide.getBitWidth() <= 64)
+      return getInt(wide.getBitWidth(), wide.getZExtValue());
+    SimValue value(Kind::WideInt, wide.getBitWidth());
+    value.wide = wide;
+    return value;
+  }
+  static SimValue getFloat(double fp, bool isF32) {
+    SimValue value(Kind::Float, isF32 ? 32 : 64);
+    value.fp = roundFloat(fp, isF32);
+    return value;
+  }
+  static SimValue getBuffer(unsigned ptr) {
+    SimValue value(Kind::Buffer, 0);
+    value.bits = ptr;
+    return value;
+  }
+
+  Kind getKind() const { return kind; }
+  unsigned getWidth() const { return width; }
+  bool isWide() const { return kind == Kind::WideInt; }
+  bool isF32() const { return kind == Kind::Float && width == 32; }
+
+  uint64_t getBits() const {
+    assert(kind == Kind::Int && "not an inline integer");
+    return bits;
+  }
+  int64_t getSExtValue() const {
+    return isWide() ? wide.getSExtValue() : signExtendFrom(bits, width);
+  }
+  APInt getAPInt() const { return isWide() ? wide : APInt(width, bits); }
+  double getFloat() const {
+    assert(kind == Kind::Float && "not a float");
+    return fp;
+  }
+  unsigned getBuffer() const {
+    assert(kind == Kind::Buffer && "not a buffer");
+    return bits;
+  }
+
+  /// Convert from and to the values of the handshake execution interfaces.
+  static SimValue fromAny(const Any &value) {
+    if (any_isa<APInt>(value))
+      return get(any_cast<APInt>(value));
+    if (any_isa<APFloat>(value)) {
+      const APFloat &fp = any_cast<APFloat>(value);
+      return getFloat(fp.convertToDouble(),
+                      &fp.getSemantics() == &APFloat::IEEEsingle());
+    }
+    return getBuffer(any_cast<unsigned>(value));
+  }
+  Any toAny() const {
+    switch (kind) {
+    case Kind::Int:
+    case Kind::WideInt:
+      return getAPInt();
+    case Kind::Float:
+      if (isF32())
+        return APFloat(static_cast<float>(fp));
+      return APFloat(fp);
+    case Kind::Buffer:
+      return getBuffer();
+    case Kind::Empty:
+      break;
+    }
+    return {};
+  }
+
+  void print(raw_ostream &os) const {
+    switch (kind) {
+    case Kind::Int:
+    case Kind::WideInt:
+      os << getAPInt() << " (APInt<" << width << ">)";
+      break;
+    case Kind::Float:
+      os << fp << " (" << (isF32() ? "f32" : "f64") << ")";
+      break;
+    case Kind::Buffer:
+      os << "Buffer " << bits;
+      break;
+    case Kind::Empty:
+      os << "<empty>";
+      break;
+    }
+  }
+
+private:
+  SimValue(Kind kind, unsigned width) : kind(kind), width(width) {}
+
+  Kind kind = Kind::Empty;
+  unsigned width = 0;
+  union {
+    uint64_t bits = 0;
+    double fp;
+  };
+  APInt wide;
+};
+
+/// An allocation of the store. The elements are kept densely in their native
+/// type, and only integers of more than 64 bits as APInt.
+class SimMemory {
+public:
+  SimMemory(mlir::Type elementType, size_t numElements)
+      : numElements(numElements) {
+    if (elementType.isIndex()) {
+      width = INDEX_WIDTH;
+    } else if (auto floatType = elementType.dyn_cast<mlir::FloatType>()) {
+      assert((floatType.isF32() || floatType.isF64()) &&
+             "Unknown element type!");
+      width = floatType.getWidth();
+      isFloat = true;
+    } else {
+      width = elementType.getIntOrFloatBitWidth();
+    }
+    if (width > 64) {
+      wide.assign(numElements, APInt(width, 0));
+      return;
+    }
+    elementSize = width <= 8 ? 1 : width <= 16 ? 2 : width <= 32 ? 4 : 8;
+    bytes.assign(numElements * elementSize, 0);
+  }
+
+  size_t size() const { return numElements; }
+  bool holdsFloats() const { return isFloat; }
+  unsigned getWidth() const { return width; }
+
+  uint64_t loadInt(size_t index) const {
+    assert(index < numElements && !isFloat && wide.empty());
+    switch (elementSize) {
+    case 1:
+      return read<uint8_t>(index);
+    case 2:
+      return read<uint16_t>(index);
+    case 4:
+      return read<uint32_t>(index);
+    default:
+      return read<uint64_t>(index);
+    }
+  }
+  void storeInt(size_t index, uint64_t bits) {
+    assert(index < numElements && !isFloat && wide.empty());
+    switch (elementSize) {
+    case 1:
+      return write<uint8_t>(index, bits);
+    case 2:
+      return write<uint16_t>(index, bits);
+    case 4:
+      return write<uint32_t>(index, bits);
+    default:
+      return write<uint64_t>(index, bits);
+    }
+  }
+  double loadFloat(size_t index) const {
+    assert(index < numElements && isFloat);
+    if (width == 32)
+      return read<float>(index);
+    return read<double>(index);
+  }
+  void storeFloat(size_t index, double fp) {
+    assert(index < numElements && isFloat);
+    if (width == 32)
+      return write<float>(index, fp);
+    write<double>(index, fp);
+  }
+
+  /// Zero all elements.
+  void clear() {
+    std::fill(bytes.begin(), bytes.end(), 0);
+    std::fill(wide.begin(), wide.end(), APInt(width, 0));
+  }
+  /// Set the elements to the binary contents of a file, which holds them in
+  /// host byte order at a width of 1, 2, 4 or 8 bytes. Returns false if the
+  /// size of `data` does not match.
+  bool readBinary(StringRef data) {
+    if (!wide.empty() || data.size() != bytes.size())
+      return false;
+    std::copy(data.begin(), data.end(), bytes.begin());
+    return true;
+  }
+
+  SimValue load(size_t index) const {
+    if (isFloat)
+      return SimValue::getFloat(loadFloat(index), width == 32);
+    if (!wide.empty())
+      return SimValue::get(wide[index]);
+    return SimValue::getInt(width, loadInt(index));
+  }
+  void store(size_t index, const SimValue &value) {
+    if (isFloat)
+      storeFloat(index, value.getFloat());
+    else if (!wide.empty())
+      wide[index] = value.getAPInt();
+    else
+      storeInt(index, value.getBits());
+  }
+
+private:
+  template <typename T>
+  T read(size_t index) const {
+    T value;
+    std::memcpy(&value, bytes.data() + index * sizeof(T), sizeof(T));
+    return value;
+  }
+  template <typename T, typename U>
+  void write(size_t index, U value) {
+    T element = static_cast<T>(value);
+    std::memcpy(bytes.data() + index * sizeof(T), &element, sizeof(T));
+  }
+
+  size_t numElements;
+  unsigned width = 0;
+  unsigned elementSize = 0;
+  bool isFloat = false;
+  std::vector<uint8_t> bytes;
+  std::vector<APInt> wide;
+};
+
+/// The timing of the accesses to a memory. Its addresses are interleaved over
+/// banks, each of which serves as many accesses per cycle as it has ports,
+/// and an access completes `latency` cycles after it is served. The accesses
+/// are served in the order they execute in, which the interpreters keep
+/// close to the order of their times.
+class MemoryTiming {
+public:
+  MemoryTiming(unsigned latency = 0, unsigned ports = 0, unsigned banks = 1)
+      : latency(latency), ports(ports), banks(std::max(banks, 1U)) {}
+
+  /// Return the time an access to `address` issued at `time` completes at,
+  /// and keep a port of its bank busy for the cycle it is served in.
+  double access(uint64_t address, double time) {
+    if (!ports)
+      return time + latency;
+    if (portsFree.empty())
+      portsFree.assign(size_t(ports) * banks, 0.0);
+    auto bank = portsFree.begin() + (address % banks) * ports;
+    auto port = std::min_element(bank, bank + ports);
+    time = std::max(time, *port);
+    *port = time + 1;
+    return time + latency;
+  }
+  /// Free all the ports.
+  void reset() { portsFree.clear(); }
+
+private:
+  unsigned latency, ports, banks;
+  /// The time each port is free again at, by bank.
+  std::vector<double> portsFree;
+};
+} // namespace
+
+/// Return the timing of `op`, which is the one of `defaults` unless it has
+/// `latency`, `ports` or `banks` attributes.
+static MemoryTiming getMemoryTiming(mlir::Operation *op,
+                                    const SimulationOptions &defaults) {
+  auto get = [&](StringRef name, unsigned value) -> unsigned {
+    if (auto attr = op->getAttrOfType<mlir::IntegerAttr>(name))
+      return attr.getValue().getZExtValue();
+    return value;
+  };
+  return MemoryTiming(get("latency", defaults.memoryLatency),
+                      get("ports", defaults.memoryPorts),
+                      get("banks", defaults.memoryBanks));
+}
+
+/// Return true if `op` has attributes of the memory timing model.
+static bool hasMemoryTiming(mlir::Operation *op) {
+  return op->hasAttr("latency") || op->hasAttr("ports") ||
+         op->hasAttr("banks");
+}
+
+static bool compareIntegers(mlir::CmpIPredicate predicate, uint64_t lhs,
+                            uint64_t rhs, unsigned width) {
+  int64_t slhs = signExtendFrom(lhs, width);
+  int64_t srhs = signExtendFrom(rhs, width);
+  switch (predicate) {
+  case mlir::CmpIPredicate::eq:
+    return lhs == rhs;
+  case mlir::CmpIPredicate::ne:
+    return lhs != rhs;
+  case mlir::CmpIPredicate::slt:
+    return slhs < srhs;
+  case mlir::CmpIPredicate::sle:
+    return slhs <= srhs;
+  case mlir::CmpIPredicate::sgt:
+    return slhs > srhs;
+  case mlir::CmpIPredicate::sge:
+    return slhs >= srhs;
+  case mlir::CmpIPredicate::ult:
+    return lhs < rhs;
+  case mlir::CmpIPredicate::ule:
+    return lhs <= rhs;
+  case mlir::CmpIPredicate::ugt:
+    return lhs > rhs;
+  case mlir::CmpIPredicate::uge:
+    return lhs >= rhs;
+  }
+  llvm_unreachable("unknown comparison predicate");
+}
+
+static bool compareFloats(mlir::CmpFPredicate predicate, double lhs,
+                          double rhs) {
+  bool unordered = std::isnan(lhs) || std::isnan(rhs);
+  switch (predicate) {
+  case mlir::CmpFPredicate::AlwaysFalse:
+    return false;
+  case mlir::CmpFPredicate::OEQ:
+    return !unordered && lhs == rhs;
+  case mlir::CmpFPredicate::OGT:
+    return !unordered && lhs > rhs;
+  case mlir::CmpFPredicate::OGE:
+    return !unordered && lhs >= rhs;
+  case mlir::CmpFPredicate::OLT:
+    return !unordered && lhs < rhs;
+  case mlir::CmpFPredicate::OLE:
+    return !unordered && lhs <= rhs;
+  case mlir::CmpFPredicate::ONE:
+    return !unordered && lhs != rhs;
+  case mlir::CmpFPredicate::ORD:
+    return !unordered;
+  case mlir::CmpFPredicate::UEQ:
+    return unordered || lhs == rhs;
+  case mlir::CmpFPredicate::UGT:
+    return unordered || lhs > rhs;
+  case mlir::CmpFPredicate::UGE:
+    return unordered || lhs >= rhs;
+  case mlir::CmpFPredicate::ULT:
+    return unordered || lhs < rhs;
+  case mlir::CmpFPredicate::ULE:
+    return unordered || lhs <= rhs;
+  case mlir::CmpFPredicate::UNE:
+    return unordered || lhs != rhs;
+  case mlir::CmpFPredicate::UNO:
+    return unordered;
+  case mlir::CmpFPredicate::AlwaysTrue:
+    return true;
+  }
+  llvm_unreachable("unknown comparison predicate");
+}
+
+/// Apply an integer operation to the inline bits of two values, or to their
+/// APInts if they are wide.
+template <typename InlineFn, typename WideFn>
+static SimValue applyIntOp(const SimValue &lhs, const SimValue &rhs,
+                           InlineFn inlineFn, WideFn wideFn) {
+  if (lhs.isWide())
+    return SimValue::get(wideFn(lhs.getAPInt(), rhs.getAPInt()));
+  return SimValue::getInt(lhs.getWidth(),
+                          inlineFn(lhs.getBits(), rhs.getBits()));
+}
+
+/// Apply a float operation, rounding the result to the precision of the
+/// operands.
+template <typename Fn>
+static SimValue applyFloatOp(const SimValue &lhs, const SimValue &rhs,
+                             Fn fn) {
+  return SimValue::getFloat(fn(lhs.getFloat(), rhs.getFloat()), lhs.isF32());
+}
+
+//===----------------------------------------------------------------------===//
+// Standard operations
+//===----------------------------------------------------------------------===//
+
+void executeOp(mlir::ConstantIndexOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
   auto attr = op->getAttrOfType<mlir::IntegerAttr>("value");
-  out[0] = attr.getValue().sextOrTrunc(INDEX_WIDTH);
+  out[0] = SimValue::getInt(INDEX_WIDTH, attr.getValue().getZExtValue());
 }
 
-void executeOp(mlir::ConstantIntOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
+void executeOp(mlir::ConstantIntOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
   auto attr = op->getAttrOfType<mlir::IntegerAttr>("value");
-  out[0] = attr.getValue();
+  out[0] = SimValue::get(attr.getValue());
 }
 
-void executeOp(mlir::AddIOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APInt>(in[0]) + any_cast<APInt>(in[1]);
+void executeOp(mlir::AddIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyIntOp(
+      in[0], in[1], [](uint64_t lhs, uint64_t rhs) { return lhs + rhs; },
+      [](const APInt &lhs, const APInt &rhs) { return lhs + rhs; });
 }
 
-void executeOp(mlir::AddFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) + any_cast<APFloat>(in[1]);
+void executeOp(mlir::AddFOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyFloatOp(in[0], in[1],
+                        [](double lhs, double rhs) { return lhs + rhs; });
 }
 
-void executeOp(mlir::CmpIOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  APInt in0 = any_cast<APInt>(in[0]);
-  APInt in1 = any_cast<APInt>(in[1]);
-  APInt out0(1, mlir::applyCmpPredicate(op.getPredicate(), in0, in1));
-  out[0] = out0;
+void executeOp(mlir::CmpIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  bool result = in[0].isWide()
+                    ? mlir::applyCmpPredicate(op.getPredicate(),
+                                              in[0].getAPInt(),
+                                              in[1].getAPInt())
+                    : compareIntegers(op.getPredicate(), in[0].getBits(),
+                                      in[1].getBits(), in[0].getWidth());
+  out[0] = SimValue::getInt(1, result);
 }
 
-void executeOp(mlir::CmpFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  APFloat in0 = any_cast<APFloat>(in[0]);
-  APFloat in1 = any_cast<APFloat>(in[1]);
-  APInt out0(1, mlir::applyCmpPredicate(op.getPredicate(), in0, in1));
-  out[0] = out0;
+void executeOp(mlir::CmpFOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = SimValue::getInt(1, compareFloats(op.getPredicate(),
+                                             in[0].getFloat(),
+                                             in[1].getFloat()));
 }
 
-void executeOp(mlir::SubIOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APInt>(in[0]) - any_cast<APInt>(in[1]);
+void executeOp(mlir::SubIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyIntOp(
+      in[0], in[1], [](uint64_t lhs, uint64_t rhs) { return lhs - rhs; },
+      [](const APInt &lhs, const APInt &rhs) { return lhs - rhs; });
 }
 
-void executeOp(mlir::SubFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) + any_cast<APFloat>(in[1]);
+void executeOp(mlir::SubFOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyFloatOp(in[0], in[1],
+                        [](double lhs, double rhs) { return lhs - rhs; });
 }
 
-void executeOp(mlir::MulIOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APInt>(in[0]) * any_cast<APInt>(in[1]);
+void executeOp(mlir::MulIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyIntOp(
+      in[0], in[1], [](uint64_t lhs, uint64_t rhs) { return lhs * rhs; },
+      [](const APInt &lhs, const APInt &rhs) { return lhs * rhs; });
 }
 
-void executeOp(mlir::MulFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) * any_cast<APFloat>(in[1]);
+void executeOp(mlir::MulFOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyFloatOp(in[0], in[1],
+                        [](double lhs, double rhs) { return lhs * rhs; });
 }
 
-void executeOp(mlir::SignedDivIOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
-  assert(any_cast<APInt>(in[1]).getZExtValue() && "Division By Zero!");
-  out[0] = any_cast<APInt>(in[0]).sdiv(any_cast<APInt>(in[1]));
+void executeOp(mlir::SignedDivIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  assert(in[1].getAPInt().getBoolValue() && "Division By Zero!");
+  unsigned width = in[0].getWidth();
+  out[0] = applyIntOp(
+      in[0], in[1],
+      [&](uint64_t lhs, uint64_t rhs) -> uint64_t {
+        int64_t slhs = signExtendFrom(lhs, width);
+        int64_t srhs = signExtendFrom(rhs, width);
+        // The only overflowing division wraps around to the dividend.
+        return srhs == -1 ? 0 - lhs : slhs / srhs;
+      },
+      [](const APInt &lhs, const APInt &rhs) { return lhs.sdiv(rhs); });
 }
 
-void executeOp(mlir::UnsignedDivIOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
-  assert(any_cast<APInt>(in[1]).getZExtValue() && "Division By Zero!");
-  out[0] = any_cast<APInt>(in[0]).udiv(any_cast<APInt>(in[1]));
+void executeOp(mlir::UnsignedDivIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  assert(in[1].getAPInt().getBoolValue() && "Division By Zero!");
+  out[0] = applyIntOp(
+      in[0], in[1], [](uint64_t lhs, uint64_t rhs) { return lhs / rhs; },
+      [](const APInt &lhs, const APInt &rhs) { return lhs.udiv(rhs); });
 }
 
-void executeOp(mlir::DivFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) / any_cast<APFloat>(in[1]);
+void executeOp(mlir::DivFOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  out[0] = applyFloatOp(in[0], in[1],
+                        [](double lhs, double rhs) { return lhs / rhs; });
 }
 
-void executeOp(mlir::IndexCastOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
+void executeOp(mlir::IndexCastOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
   out[0] = in[0];
 }
 
-void executeOp(mlir::SignExtendIOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
-  int64_t width = op.getType().getIntOrFloatBitWidth();
-  out[0] = any_cast<APInt>(in[0]).sext(width);
+void executeOp(mlir::SignExtendIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  unsigned width = op.getType().getIntOrFloatBitWidth();
+  if (width > 64 || in[0].isWide())
+    out[0] = SimValue::get(in[0].getAPInt().sext(width));
+  else
+    out[0] = SimValue::getInt(width, in[0].getSExtValue());
 }
 
-void executeOp(mlir::ZeroExtendIOp op, std::vector<Any> &in,
-               std::vector<Any> &out) {
-  int64_t width = op.getType().getIntOrFloatBitWidth();
-  out[0] = any_cast<APInt>(in[0]).zext(width);
+void executeOp(mlir::ZeroExtendIOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out) {
+  unsigned width = op.getType().getIntOrFloatBitWidth();
+  if (width > 64 || in[0].isWide())
+    out[0] = SimValue::get(in[0].getAPInt().zext(width));
+  else
+    out[0] = SimValue::getInt(width, in[0].getBits());
 }
 
 // Allocate a new matrix with dimensions given by the type, in the
 // given store.  Return the pseuddo-pointer to the new matrix in the
 // store (i.e. the first dimension index)
-unsigned allocateMemRef(mlir::MemRefType type, std::vector<Any> &in,
-                        std::vector<std::vector<Any>> &store,
+unsigned allocateMemRef(mlir::MemRefType type, std::vector<SimValue> &in,
+                        std::vector<SimMemory> &store,
                         std::vector<double> &storeTimes) {
   ArrayRef<int64_t> shape = type.getShape();
   int64_t allocationSize = 1;
@@ -128,59 +575,45 @@ unsigned allocateMemRef(mlir::MemRefType type, std::vector<Any> &in,
       allocationSize *= dim;
     else {
       assert(count < in.size());
-      allocationSize *= any_cast<APInt>(in[count++]).getSExtValue();
+      allocationSize *= in[count++].getSExtValue();
     }
   }
   unsigned ptr = store.size();
-  store.resize(ptr + 1);
-  storeTimes.resize(ptr + 1);
-  store[ptr].resize(allocationSize);
-  storeTimes[ptr] = 0.0;
-  mlir::Type elementType = type.getElementType();
-  int64_t width = elementType.getIntOrFloatBitWidth();
-  for (int i = 0; i < allocationSize; i++) {
-    if (elementType.isa<mlir::IntegerType>()) {
-      store[ptr][i] = APInt(width, 0);
-    } else if (elementType.isa<mlir::FloatType>()) {
-      store[ptr][i] = APFloat(0.0);
-    } else {
-      llvm_unreachable("Unknown result type!\n");
-    }
-  }
+  store.emplace_back(type.getElementType(), allocationSize);
+  storeTimes.push_back(0.0);
   return ptr;
 }
 
-void executeOp(mlir::memref::LoadOp op, std::vector<Any> &in,
-               std::vector<Any> &out, std::vector<std::vector<Any>> &store) {
-  ArrayRef<int64_t> shape = op.getMemRefType().getShape();
+/// Return the offset of the element of a memref of the given shape at
+/// `indices`.
+static unsigned getAddress(ArrayRef<int64_t> shape,
+                           ArrayRef<SimValue> indices) {
   unsigned address = 0;
-  for (unsigned i = 0; i < shape.size(); i++) {
-    address = address * shape[i] + any_cast<APInt>(in[i + 1]).getZExtValue();
-  }
-  unsigned ptr = any_cast<unsigned>(in[0]);
+  for (unsigned i = 0; i < shape.size(); i++)
+    address = address * shape[i] + indices[i].getBits();
+  return address;
+}
+
+void executeOp(mlir::memref::LoadOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out, std::vector<SimMemory> &store) {
+  unsigned address = getAddress(op.getMemRefType().getShape(),
+                                ArrayRef<SimValue>(in).drop_front());
+  unsigned ptr = in[0].getBuffer();
   assert(ptr < store.size());
   auto &ref = store[ptr];
   assert(address < ref.size());
-  //  LLVM_DEBUG(dbgs() << "Load " << ref[address] << " from " << ptr << "[" <<
-  //  address << "]\n");
-  Any result = ref[address];
-  out[0] = result;
+  out[0] = ref.load(address);
 }
 
-void executeOp(mlir::memref::StoreOp op, std::vector<Any> &in,
-               std::vector<Any> &out, std::vector<std::vector<Any>> &store) {
-  ArrayRef<int64_t> shape = op.getMemRefType().getShape();
-  unsigned address = 0;
-  for (unsigned i = 0; i < shape.size(); i++) {
-    address = address * shape[i] + any_cast<APInt>(in[i + 2]).getZExtValue();
-  }
-  unsigned ptr = any_cast<unsigned>(in[1]);
+void executeOp(mlir::memref::StoreOp op, std::vector<SimValue> &in,
+               std::vector<SimValue> &out, std::vector<SimMemory> &store) {
+  unsigned address = getAddress(op.getMemRefType().getShape(),
+                                ArrayRef<SimValue>(in).drop_front(2));
+  unsigned ptr = in[1].getBuffer();
   assert(ptr < store.size());
   auto &ref = store[ptr];
-  //  LLVM_DEBUG(dbgs() << "Store " << in[0] << " to " << ptr << "[" << address
-  //  << "]\n");
   assert(address < ref.size());
-  ref[address] = in[0];
+  ref.store(address, in[0]);
 }
 
 void debugArg(const std::string &head, mlir::Value op, const APInt &value,
@@ -213,20 +646,23 @@ void debugArg(const std::string &head, mlir::Value op, const Any &value,
   }
 }
 
-Any readValueWithType(mlir::Type type, std::string in) {
+void debugArg(const std::string &head, mlir::Value op, const SimValue &value,
+              double time) {
+  LLVM_DEBUG(dbgs() << "  " << head << ":  " << op << " = ";
+             value.print(dbgs()); dbgs() << " @" << time << "\n");
+}
+
+SimValue readValueWithType(mlir::Type type, std::string in) {
   std::stringstream arg(in);
   if (type.isIndex()) {
     int64_t x;
     arg >> x;
-    int64_t width = INDEX_WIDTH;
-    APInt aparg(width, x);
-    return aparg;
+    return SimValue::getInt(INDEX_WIDTH, x);
   } else if (type.isa<mlir::IntegerType>()) {
     int64_t x;
     arg >> x;
     int64_t width = type.getIntOrFloatBitWidth();
-    APInt aparg(width, x);
-    return aparg;
+    return SimValue::get(APInt(width, x));
     // } else if (type.isF16()) {
     //   half x;
     //   arg >> x;
@@ -235,26 +671,24 @@ Any readValueWithType(mlir::Type type, std::string in) {
   } else if (type.isF32()) {
     float x;
     arg >> x;
-    APFloat aparg(x);
-    return aparg;
+    return SimValue::getFloat(x, true);
   } else if (type.isF64()) {
     double x;
     arg >> x;
-    APFloat aparg(x);
-    return aparg;
+    return SimValue::getFloat(x, false);
   } else {
     assert(0 && "unknown argument type!\n");
     return {};
   }
 }
 
-std::string printAnyValueWithType(mlir::Type type, Any &value) {
+std::string printValueWithType(mlir::Type type, const SimValue &value) {
   std::stringstream out;
   if (type.isa<mlir::IntegerType>() || type.isa<mlir::IndexType>()) {
-    out << any_cast<APInt>(value).getSExtValue();
+    out << value.getSExtValue();
     return out.str();
   } else if (type.isa<mlir::FloatType>()) {
-    out << any_cast<APFloat>(value).convertToDouble();
+    out << value.getFloat();
     return out.str();
   } else if (type.isa<mlir::NoneType>()) {
     return "none";
@@ -278,8 +712,8 @@ void scheduleUses(std::list<mlir::Operation *> &readyList,
   }
 }
 
-bool executeStdOp(mlir::Operation &op, std::vector<Any> &inValues,
-                  std::vector<Any> &outValues) {
+bool executeStdOp(mlir::Operation &op, std::vector<SimValue> &inValues,
+                  std::vector<SimValue> &outValues) {
   if (auto stdOp = dyn_cast<mlir::ConstantIndexOp>(op))
     executeOp(stdOp, inValues, outValues);
   else if (auto stdOp = dyn_cast<mlir::ConstantIntOp>(op))
@@ -318,23 +752,35 @@ bool executeStdOp(mlir::Operation &op, std::vector<Any> &inValues,
 }
 
 void executeFunction(mlir::FuncOp &toplevel,
-                     llvm::DenseMap<mlir::Value, Any> &valueMap,
+                     llvm::DenseMap<mlir::Value, SimValue> &valueMap,
                      llvm::DenseMap<mlir::Value, double> &timeMap,
-                     std::vector<Any> &results,
+                     std::vector<SimValue> &results,
                      std::vector<double> &resultTimes,
-                     std::vector<std::vector<Any>> &store,
-                     std::vector<double> &storeTimes) {
+                     std::vector<SimMemory> &store,
+                     std::vector<double> &storeTimes,
+                     const SimulationOptions &options) {
   mlir::Block &entryBlock = toplevel.getBody().front();
   // An iterator which walks over the instructions.
   mlir::Block::iterator instIter = entryBlock.begin();
+  // The timing of the accesses to each allocation of the store.
+  std::vector<MemoryTiming> memoryTimings;
+  auto accessMemory = [&](unsigned ptr, ArrayRef<int64_t> shape,
+                          ArrayRef<SimValue> indices, double time) {
+    if (ptr >= memoryTimings.size())
+      memoryTimings.resize(store.size(),
+                           MemoryTiming(options.memoryLatency,
+                                        options.memoryPorts,
+                                        options.memoryBanks));
+    return memoryTimings[ptr].access(getAddress(shape, indices), time);
+  };
 
   // Main executive loop.  Start at the first instruction of the entry
   // block.  Fetch and execute instructions until we hit a terminator.
   while (true) {
     mlir::Operation &op = *instIter;
     int64_t i = 0;
-    std::vector<Any> inValues(op.getNumOperands());
-    std::vector<Any> outValues(op.getNumResults());
+    std::vector<SimValue> inValues(op.getNumOperands());
+    std::vector<SimValue> outValues(op.getNumResults());
     LLVM_DEBUG(dbgs() << "OP:  " << op.getName() << "\n");
     double time = 0.0;
     for (mlir::Value in : op.getOperands()) {
@@ -345,24 +791,28 @@ void executeFunction(mlir::FuncOp &toplevel,
     }
     if (executeStdOp(op, inValues, outValues)) {
     } else if (auto allocOp = dyn_cast<mlir::memref::AllocOp>(op)) {
-      outValues[0] =
+      unsigned ptr =
           allocateMemRef(allocOp.getType(), inValues, store, storeTimes);
-      unsigned ptr = any_cast<unsigned>(outValues[0]);
+      outValues[0] = SimValue::getBuffer(ptr);
       storeTimes[ptr] = time;
     } else if (auto loadOp = dyn_cast<mlir::memref::LoadOp>(op)) {
       executeOp(loadOp, inValues, outValues, store);
-      unsigned ptr = any_cast<unsigned>(inValues[0]);
+      unsigned ptr = inValues[0].getBuffer();
       double storeTime = storeTimes[ptr];
       LLVM_DEBUG(dbgs() << "STORE: " << storeTime << "\n");
       time = std::max(time, storeTime);
       storeTimes[ptr] = time;
+      time = accessMemory(ptr, loadOp.getMemRefType().getShape(),
+                          ArrayRef<SimValue>(inValues).drop_front(), time);
     } else if (auto storeOp = dyn_cast<mlir::memref::StoreOp>(op)) {
       executeOp(storeOp, inValues, outValues, store);
-      unsigned ptr = any_cast<unsigned>(inValues[1]);
+      unsigned ptr = inValues[1].getBuffer();
       double storeTime = storeTimes[ptr];
       LLVM_DEBUG(dbgs() << "STORE: " << storeTime << "\n");
       time = std::max(time, storeTime);
       storeTimes[ptr] = time;
+      time = accessMemory(ptr, storeOp.getMemRefType().getShape(),
+                          ArrayRef<SimValue>(inValues).drop_front(2), time);
     } else if (auto branchOp = dyn_cast<mlir::BranchOp>(op)) {
       mlir::Block *dest = branchOp.getDest();
       unsigned arg = 0;
@@ -375,11 +825,10 @@ void executeFunction(mlir::FuncOp &toplevel,
       instIter = dest->begin();
       continue;
     } else if (auto condBranchOp = dyn_cast<mlir::CondBranchOp>(op)) {
-      APInt condition = any_cast<APInt>(inValues[0]);
       mlir::Block *dest;
-      std::vector<Any> inArgs;
+      std::vector<SimValue> inArgs;
       double time = 0.0;
-      if (condition != 0) {
+      if (inValues[0].getBits() != 0) {
         dest = condBranchOp.getTrueDest();
         inArgs.resize(condBranchOp.getNumTrueOperands());
         for (mlir::Value in : condBranchOp.getTrueOperands()) {
@@ -420,11 +869,11 @@ void executeFunction(mlir::FuncOp &toplevel,
         mlir::FunctionType ftype = funcOp.getType();
         unsigned inputs = ftype.getNumInputs();
         unsigned outputs = ftype.getNumResults();
-        llvm::DenseMap<mlir::Value, Any> newValueMap;
+        llvm::DenseMap<mlir::Value, SimValue> newValueMap;
         llvm::DenseMap<mlir::Value, double> newTimeMap;
-        std::vector<Any> results(outputs);
+        std::vector<SimValue> results(outputs);
         std::vector<double> resultTimes(outputs);
-        std::vector<std::vector<Any>> store;
+        std::vector<SimMemory> store;
         std::vector<double> storeTimes;
         mlir::Block &entryBlock = funcOp.getBody().front();
         mlir::Block::BlockArgListType blockArgs = entryBlock.getArguments();
@@ -434,7 +883,7 @@ void executeFunction(mlir::FuncOp &toplevel,
           newTimeMap[blockArgs[i]] = timeMap[op.getOperand(i)];
         }
         executeFunction(funcOp, newValueMap, newTimeMap, results, resultTimes,
-                        store, storeTimes);
+                        store, storeTimes, options);
         i = 0;
         for (mlir::Value out : op.getResults()) {
           valueMap[out] = results[i];
@@ -551,7 +1000,14 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
     for (mlir::Value in : op.getOperands()) {
       valueMap.erase(in);
     }
-    if (executeStdOp(op, inValues, outValues)) {
+    // The standard operations execute on typed values.
+    std::vector<SimValue> typedInValues;
+    std::vector<SimValue> typedOutValues(op.getNumResults());
+    for (Any &value : inValues)
+      typedInValues.push_back(SimValue::fromAny(value));
+    if (executeStdOp(op, typedInValues, typedOutValues)) {
+      for (unsigned i = 0; i < outValues.size(); i++)
+        outValues[i] = typedOutValues[i].toAny();
     } else if (auto returnOp = dyn_cast<handshake::ReturnOp>(op)) {
       for (unsigned i = 0; i < results.size(); i++) {
         results[i] = inValues[i];
@@ -577,81 +1033,1240 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
   }
 }
 
-bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
-              mlir::OwningModuleRef &module, mlir::MLIRContext &context) {
-  // The store associates each allocation in the program
-  // (represented by a int) with a vector of values which can be
-  // accessed by it.  Currently values are assumed to be an integer.
-  std::vector<std::vector<Any>> store;
-  std::vector<double> storeTimes;
+//===----------------------------------------------------------------------===//
+// Compiled execution of handshake functions
+//===----------------------------------------------------------------------===//
+//
+// The compiled engine lowers a handshake function into a flat list of
+// instructions before running it. Every value of the function gets a dense
+// slot index, and the tokens live in typed registers indexed by slot instead
+// of the `llvm::Any` value maps the interpreter looks up on every operation.
+// The ready list, the firing rules and the timing follow the interpreter, so
+// both engines produce the same results.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// The contents of a register. Integers are kept zero-extended to 64 bits,
+/// and floats in double precision, rounded to single precision after every
+/// operation on `f32` values.
+union Word {
+  uint64_t i;
+  double f;
+};
+
+enum class Opcode : uint8_t {
+  // Standard operations, which fire once all their operands hold a token.
+  ConstantInt,
+  AddI,
+  SubI,
+  MulI,
+  DivSI,
+  DivUI,
+  CmpI,
+  AddF,
+  SubF,
+  MulF,
+  DivF,
+  CmpF,
+  SignExtend,
+  ZeroExtend,
+  // Handshake operations which fire once all their operands hold a token and
+  // none of their results does.
+  Fork,
+  Join,
+  Branch,
+  Store,
+  Constant,
+  // Handshake operations with firing rules of their own.
+  Merge,
+  Mux,
+  ControlMerge,
+  ConditionalBranch,
+  Sink,
+  Nop,
+  Load,
+  Memory,
+  Return,
+};
+
+struct Instruction {
+  Opcode opcode;
+  /// The width of the integer results, or whether the float results are
+  /// single precision.
+  unsigned width;
+  /// The latency of the handshake operations, the source width of the
+  /// extensions, the predicate of the comparisons, or the index of the
+  /// memory.
+  unsigned imm;
+  Word constant;
+  /// The range of the operand and result slots in the slot lists.
+  unsigned operands, numOperands;
+  unsigned results, numResults;
+  mlir::Operation *op;
+};
+
+struct Memory {
+  unsigned numLoads, numStores;
+  SimMemory elements;
+  MemoryTiming timing;
+};
+
+/// The instructions queued on a worker of a parallel run.
+struct WorkQueue {
+  std::mutex mutex;
+  std::deque<unsigned> items;
+};
+
+/// The scheduling states of an instruction in a parallel run.
+enum InstructionState : uint8_t { Idle, Queued, Running, Rerun };
+
+/// The worker the current thread runs in a parallel run.
+static thread_local unsigned currentWorker = 0;
+
+/// The bookkeeping of the instruction firing on the current thread.
+struct Firing {
+  /// The latest time of the operands present when it started.
+  double time = 0.0;
+  /// The earliest and the latest time of the tokens it consumed, and the
+  /// slot of the latest one.
+  double firstConsumed = 0.0, lastConsumed = 0.0;
+  int critical = -1;
+  unsigned numConsumed = 0;
+  SmallVector<unsigned, 4> produced;
+};
+static thread_local Firing firing;
+
+/// The performance counters of a compiled function, summed over its runs.
+/// A channel is blocked for the cycles a token waits for the previous one to
+/// be consumed, and an operation waits on its inputs for the cycles between
+/// the first and the last operand it consumes.
+struct Counters {
+  // Per instruction.
+  std::vector<uint64_t> fires;
+  std::vector<double> inputWait;
+  // Per slot.
+  std::vector<uint64_t> tokens;
+  std::vector<double> waiting;
+  std::vector<double> blocked;
+  /// The time the last token was consumed at in the current run.
+  std::vector<double> consumedAt;
+  /// The operand slot the last token was computed from last, or -1.
+  std::vector<int> criticalSources;
+  /// The operand of the last return that arrived last.
+  int criticalEnd = -1;
+  unsigned numRuns = 0;
+  double cycles = 0.0;
+};
+
+/// A handshake function lowered to instructions over slots.
+///
+/// Several argument vectors are pipelined into the function: the next value
+/// of an argument is put into its slot one cycle after the previous one was
+/// consumed, and the function finishes once it has returned once per vector.
+/// The results are expected in the order of the vectors. The producers then
+/// wait for their results to be consumed, but the times of the tokens do not
+/// account for these stalls.
+///
+/// With more than one thread, the ready instructions are distributed over
+/// work-stealing queues, one per thread. Every slot is a channel with a
+/// single producer and a single consumer: the producer fills it only while it
+/// is empty and the consumer empties it only once it has read it, so the
+/// tokens are handed over with atomic flags only. The time of a token only
+/// depends on the times of the tokens it was computed from, so the timing
+/// model does not depend on the order of execution either.
+class CompiledFunction {
+public:
+  /// Lower `function`, returning false if it uses operations or types the
+  /// compiled engine does not support. The memories are timed by the memory
+  /// model of `options`.
+  bool compile(handshake::FuncOp function, const SimulationOptions &options);
+
+  /// Execute the function on `argVectors`, appending the results of each
+  /// vector and the time they were returned at to `results` and
+  /// `returnTimes`.
+  void execute(ArrayRef<std::vector<SimValue>> argVectors, unsigned numThreads,
+               std::vector<std::vector<SimValue>> &results,
+               std::vector<double> &returnTimes);
+
+  /// Count the tokens, waits and stalls of every operation and channel in
+  /// the following runs.
+  void enableCounters();
+  void printReport(raw_ostream &os) const;
+  /// Attach the counters to the operations as a `perf` dictionary.
+  void annotate() const;
+
+private:
+  bool addSlot(mlir::Value value);
+  bool addInstruction(mlir::Operation &op, const SimulationOptions &options);
+  bool hasSingleUsers() const;
+  void schedule(unsigned inst);
+  void scheduleUsers(unsigned slot);
+  bool isPresent(unsigned slot) const {
+    return present[slot].load(std::memory_order_acquire);
+  }
+  /// Whether a token can be put into `slot`. A single sequential run
+  /// overwrites tokens like the interpreter does.
+  bool canProduce(unsigned slot) const {
+    return !backpressure || !isPresent(slot);
+  }
+  bool canProduce(const Instruction &inst) const;
+  bool allOperandsPresent(const Instruction &inst) const;
+  double operandTime(const Instruction &inst) const;
+  void consume(unsigned slot);
+  void consumeOperands(const Instruction &inst);
+  void produce(unsigned slot, Word value, double time);
+  bool fire(unsigned index, std::vector<std::vector<SimValue>> &results,
+            std::vector<double> &resultTimes);
+  bool step(unsigned index, std::vector<std::vector<SimValue>> &results,
+            std::vector<double> &resultTimes);
+  std::vector<unsigned> getCriticalPath() const;
+  std::string describeSlot(unsigned slot) const;
+  bool popWork(unsigned worker, unsigned &inst);
+  void runWorker(unsigned worker, std::vector<std::vector<SimValue>> &results,
+                 std::vector<double> &resultTimes);
+
+  mlir::Block *body = nullptr;
+  llvm::DenseMap<mlir::Value, unsigned> slotIndices;
+  std::vector<mlir::Value> slotValues;
+  std::vector<Instruction> instructions;
+  std::vector<unsigned> slotLists;
+  std::vector<Memory> memories;
+  /// The instructions using each slot, in the order of the uses of its value,
+  /// as offsets into `userLists`.
+  std::vector<unsigned> userOffsets;
+  std::vector<unsigned> userLists;
+  /// The instruction producing each slot, or -1 for the arguments.
+  std::vector<int> producers;
+
+  std::vector<Word> values;
+  std::vector<double> times;
+  std::unique_ptr<std::atomic<bool>[]> present;
+  std::atomic<bool> returned{false};
+  std::atomic<uint64_t> numExecuted{0};
+
+  // The argument vectors of a pipelined run.
+  ArrayRef<std::vector<SimValue>> inputs;
+  /// The index of the next vector of each argument.
+  std::vector<size_t> nextInputs;
+  size_t numReturned = 0;
+
+  std::unique_ptr<Counters> counters;
+
+  // The ready list of a sequential run.
+  std::deque<unsigned> readyList;
+  llvm::BitVector queued;
+
+  /// Whether the producers wait for their results to be consumed, which the
+  /// parallel and the pipelined runs need.
+  bool backpressure = false;
+
+  // The work queues of a parallel run.
+  bool parallel = false;
+  std::unique_ptr<std::atomic<uint8_t>[]> states;
+  std::vector<std::unique_ptr<WorkQueue>> workQueues;
+  /// The number of queued and running instructions.
+  std::atomic<unsigned> numPending{0};
+};
+} // namespace
+
+/// Return the width of the integer registers of `type`, or zero if it has
+/// none. Float registers have a width of 32 or 64.
+static unsigned getRegisterWidth(mlir::Type type) {
+  if (type.isIndex())
+    return INDEX_WIDTH;
+  if (type.isa<mlir::NoneType>())
+    return 1;
+  if (auto intType = type.dyn_cast<mlir::IntegerType>())
+    return intType.getWidth() <= 64 ? intType.getWidth() : 0;
+  if (type.isF32())
+    return 32;
+  if (type.isF64())
+    return 64;
+  return 0;
+}
+
+bool CompiledFunction::addSlot(mlir::Value value) {
+  mlir::Type type = value.getType();
+  if (!type.isa<mlir::MemRefType>() && !getRegisterWidth(type))
+    return false;
+  slotIndices[value] = slotValues.size();
+  slotValues.push_back(value);
+  return true;
+}
+
+bool CompiledFunction::addInstruction(mlir::Operation &op,
+                                      const SimulationOptions &options) {
+  Instruction inst;
+  inst.width = 0;
+  inst.imm = 0;
+  inst.constant.i = 0;
+  inst.op = &op;
+  if (op.getNumResults()) {
+    mlir::Type type = op.getResult(0).getType();
+    inst.width = type.isa<mlir::FloatType>() ? type.isF32()
+                                             : getRegisterWidth(type);
+  }
+
+  if (isa<mlir::ConstantIndexOp, mlir::ConstantIntOp>(op)) {
+    inst.opcode = Opcode::ConstantInt;
+    auto attr = op.getAttrOfType<mlir::IntegerAttr>("value");
+    inst.constant.i = truncateTo(attr.getValue().getZExtValue(), inst.width);
+  } else if (isa<mlir::AddIOp>(op)) {
+    inst.opcode = Opcode::AddI;
+  } else if (isa<mlir::SubIOp>(op)) {
+    inst.opcode = Opcode::SubI;
+  } else if (isa<mlir::MulIOp>(op)) {
+    inst.opcode = Opcode::MulI;
+  } else if (isa<mlir::SignedDivIOp>(op)) {
+    inst.opcode = Opcode::DivSI;
+  } else if (isa<mlir::UnsignedDivIOp>(op)) {
+    inst.opcode = Opcode::DivUI;
+  } else if (auto cmpOp = dyn_cast<mlir::CmpIOp>(op)) {
+    inst.opcode = Opcode::CmpI;
+    inst.width = getRegisterWidth(cmpOp.lhs().getType());
+    inst.imm = static_cast<unsigned>(cmpOp.getPredicate());
+  } else if (isa<mlir::AddFOp>(op)) {
+    inst.opcode = Opcode::AddF;
+  } else if (isa<mlir::SubFOp>(op)) {
+    inst.opcode = Opcode::SubF;
+  } else if (isa<mlir::MulFOp>(op)) {
+    inst.opcode = Opcode::MulF;
+  } else if (isa<mlir::DivFOp>(op)) {
+    inst.opcode = Opcode::DivF;
+  } else if (auto cmpOp = dyn_cast<mlir::CmpFOp>(op)) {
+    inst.opcode = Opcode::CmpF;
+    inst.imm = static_cast<unsigned>(cmpOp.getPredicate());
+  } else if (isa<mlir::IndexCastOp, mlir::SignExtendIOp>(op)) {
+    inst.opcode = Opcode::SignExtend;
+    inst.imm = getRegisterWidth(op.getOperand(0).getType());
+  } else if (isa<mlir::ZeroExtendIOp>(op)) {
+    inst.opcode = Opcode::ZeroExtend;
+  } else if (isa<handshake::ForkOp>(op)) {
+    inst.opcode = Opcode::Fork;
+    inst.imm = 1;
+  } else if (isa<handshake::JoinOp>(op)) {
+    inst.opcode = Opcode::Join;
+    inst.imm = 1;
+  } else if (isa<handshake::BranchOp>(op)) {
+    inst.opcode = Opcode::Branch;
+  } else if (isa<handshake::StoreOp>(op)) {
+    inst.opcode = Opcode::Store;
+    inst.imm = 1;
+    if (op.getNumOperands() != 3)
+      return false;
+  } else if (isa<handshake::ConstantOp>(op)) {
+    inst.opcode = Opcode::Constant;
+    auto attr = op.getAttrOfType<mlir::IntegerAttr>("value");
+    if (!attr || !inst.width)
+      return false;
+    inst.constant.i = truncateTo(attr.getValue().getZExtValue(), inst.width);
+  } else if (isa<handshake::MergeOp>(op)) {
+    inst.opcode = Opcode::Merge;
+  } else if (isa<handshake::MuxOp>(op)) {
+    inst.opcode = Opcode::Mux;
+  } else if (isa<handshake::ControlMergeOp>(op)) {
+    inst.opcode = Opcode::ControlMerge;
+  } else if (isa<handshake::ConditionalBranchOp>(op)) {
+    inst.opcode = Opcode::ConditionalBranch;
+  } else if (isa<handshake::SinkOp>(op)) {
+    inst.opcode = Opcode::Sink;
+  } else if (isa<handshake::StartOp, handshake::EndOp>(op)) {
+    inst.opcode = Opcode::Nop;
+  } else if (isa<handshake::LoadOp>(op)) {
+    inst.opcode = Opcode::Load;
+    if (op.getNumOperands() != 3)
+      return false;
+  } else if (auto memoryOp = dyn_cast<handshake::MemoryOp>(op)) {
+    inst.opcode = Opcode::Memory;
+    auto type = memoryOp.getMemRefType();
+    if (type.getRank() != 1 || !type.hasStaticShape() ||
+        !getRegisterWidth(type.getElementType()))
+      return false;
+    inst.imm = memories.size();
+    memories.push_back(
+        {unsigned(memoryOp.getLdCount().getZExtValue()),
+         unsigned(memoryOp.getStCount().getZExtValue()),
+         SimMemory(type.getElementType(), type.getNumElements()),
+         getMemoryTiming(&op, options)});
+  } else if (isa<handshake::ReturnOp>(op)) {
+    inst.opcode = Opcode::Return;
+  } else {
+    LLVM_DEBUG(dbgs() << "Cannot compile " << op << "\n");
+    return false;
+  }
+
+  inst.operands = slotLists.size();
+  inst.numOperands = op.getNumOperands();
+  for (mlir::Value operand : op.getOperands()) {
+    auto it = slotIndices.find(operand);
+    if (it == slotIndices.end())
+      return false;
+    slotLists.push_back(it->second);
+  }
+  inst.results = slotLists.size();
+  inst.numResults = op.getNumResults();
+  for (mlir::Value result : op.getResults())
+    slotLists.push_back(slotIndices.lookup(result));
+  instructions.push_back(inst);
+  return true;
+}
+
+bool CompiledFunction::compile(handshake::FuncOp function,
+                               const SimulationOptions &options) {
+  body = &function.getBody().front();
+  for (mlir::Value arg : body->getArguments())
+    if (!addSlot(arg))
+      return false;
+  // All values get their slot before the operands are resolved, as the
+  // operations of a dataflow graph may use values defined after them.
+  for (mlir::Operation &op : *body)
+    for (mlir::Value result : op.getResults())
+      if (!addSlot(result))
+        return false;
+
+  DenseMap<mlir::Operation *, unsigned> instIndices;
+  for (mlir::Operation &op : *body) {
+    instIndices[&op] = instructions.size();
+    if (!addInstruction(op, options))
+      return false;
+  }
+
+  producers.assign(slotValues.size(), -1);
+  for (auto &entry : instIndices)
+    for (mlir::Value result : entry.first->getResults())
+      producers[slotIndices.lookup(result)] = entry.second;
+
+  userOffsets.reserve(slotValues.size() + 1);
+  for (mlir::Value value : slotValues) {
+    userOffsets.push_back(userLists.size());
+    for (auto &use : value.getUses())
+      userLists.push_back(instIndices.lookup(use.getOwner()));
+  }
+  userOffsets.push_back(userLists.size());
+  return true;
+}
+
+void CompiledFunction::schedule(unsigned inst) {
+  if (!parallel) {
+    if (queued.test(inst))
+      return;
+    queued.set(inst);
+    readyList.push_back(inst);
+    return;
+  }
+
+  // An instruction is queued at most once, and one that is running is
+  // marked to run again once it is done.
+  uint8_t state = states[inst].load(std::memory_order_acquire);
+  uint8_t next;
+  do {
+    if (state == Queued || state == Rerun)
+      return;
+    next = state == Idle ? Queued : Rerun;
+  } while (!states[inst].compare_exchange_weak(state, next,
+                                              std::memory_order_acq_rel));
+  if (next != Queued)
+    return;
+  numPending.fetch_add(1, std::memory_order_acq_rel);
+  WorkQueue &queue = *workQueues[currentWorker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  queue.items.push_back(inst);
+}
+
+void CompiledFunction::scheduleUsers(unsigned slot) {
+  for (unsigned i = userOffsets[slot], e = userOffsets[slot + 1]; i != e; ++i)
+    schedule(userLists[i]);
+}
+
+bool CompiledFunction::allOperandsPresent(const Instruction &inst) const {
+  for (unsigned i = 0; i != inst.numOperands; ++i)
+    if (!isPresent(slotLists[inst.operands + i]))
+      return false;
+  return true;
+}
+
+bool CompiledFunction::canProduce(const Instruction &inst) const {
+  for (unsigned i = 0; i != inst.numResults; ++i)
+    if (!canProduce(slotLists[inst.results + i]))
+      return false;
+  return true;
+}
+
+double CompiledFunction::operandTime(const Instruction &inst) const {
+  double time = 0.0;
+  for (unsigned i = 0; i != inst.numOperands; ++i)
+    time = std::max(time, times[slotLists[inst.operands + i]]);
+  return time;
+}
+
+static Word toWord(const SimValue &value) {
+  Word word;
+  if (value.getKind() == SimValue::Kind::Float)
+    word.f = value.getFloat();
+  else if (value.getKind() == SimValue::Kind::Buffer)
+    word.i = value.getBuffer();
+  else
+    word.i = value.getBits();
+  return word;
+}
+
+void CompiledFunction::consume(unsigned slot) {
+  if (counters) {
+    double time = times[slot];
+    counters->waiting[slot] += firing.time - time;
+    counters->consumedAt[slot] = firing.time;
+    if (!firing.numConsumed++ || time < firing.firstConsumed)
+      firing.firstConsumed = time;
+    if (firing.critical < 0 || time >= firing.lastConsumed) {
+      firing.lastConsumed = time;
+      firing.critical = slot;
+    }
+  }
+  present[slot].store(false, std::memory_order_release);
+  if (slot < nextInputs.size() && nextInputs[slot] < inputs.size()) {
+    produce(slot, toWord(inputs[nextInputs[slot]++][slot]), firing.time + 1);
+    scheduleUsers(slot);
+    return;
+  }
+  // Without the retries of the sequential engine, the producer has to be
+  // woken up once the channel has room again.
+  if (parallel && producers[slot] >= 0)
+    schedule(producers[slot]);
+}
+
+void CompiledFunction::consumeOperands(const Instruction &inst) {
+  for (unsigned i = 0; i != inst.numOperands; ++i)
+    consume(slotLists[inst.operands + i]);
+}
 
-  // The valueMap associates each SSA statement in the program
-  // (represented by a Value*) with it's corresponding value.
-  // Currently the value is assumed to be an integer.
-  llvm::DenseMap<mlir::Value, Any> valueMap;
+void CompiledFunction::produce(unsigned slot, Word value, double time) {
+  if (counters) {
+    ++counters->tokens[slot];
+    counters->blocked[slot] +=
+        std::max(0.0, counters->consumedAt[slot] - time);
+    firing.produced.push_back(slot);
+  }
+  values[slot] = value;
+  times[slot] = time;
+  present[slot].store(true, std::memory_order_release);
+}
+
+/// Try to fire the instruction `index`, returning false if it has to be
+/// rescheduled. The operands are read before they are consumed, which hands
+/// their channels back to the producers.
+bool CompiledFunction::fire(unsigned index,
+                            std::vector<std::vector<SimValue>> &results,
+                            std::vector<double> &resultTimes) {
+  const Instruction &inst = instructions[index];
+  const unsigned *ins = slotLists.data() + inst.operands;
+  const unsigned *outs = slotLists.data() + inst.results;
+  auto in = [&](unsigned i) { return values[ins[i]]; };
+
+  switch (inst.opcode) {
+  case Opcode::Fork:
+  case Opcode::Join:
+  case Opcode::Branch:
+  case Opcode::Store:
+  case Opcode::Constant: {
+    if (!allOperandsPresent(inst))
+      return false;
+    for (unsigned i = 0; i != inst.numResults; ++i)
+      if (isPresent(outs[i]))
+        return false;
+    double time = operandTime(inst) + inst.imm;
+    for (unsigned i = 0; i != inst.numResults; ++i) {
+      Word value = inst.opcode == Opcode::Constant ? inst.constant
+                   : inst.opcode == Opcode::Store  ? in(i)
+                                                   : in(0);
+      produce(outs[i], value, time);
+    }
+    consumeOperands(inst);
+    for (unsigned i = 0; i != inst.numResults; ++i)
+      scheduleUsers(outs[i]);
+    return true;
+  }
+
+  case Opcode::Merge:
+  case Opcode::ControlMerge: {
+    if (!canProduce(inst))
+      return false;
+    bool found = false;
+    for (unsigned i = 0; i != inst.numOperands; ++i) {
+      if (!isPresent(ins[i]))
+        continue;
+      if (found) {
+        // A pipelined run keeps the other inputs for the next firing.
+        if (inputs.size() > 1) {
+          schedule(index);
+          break;
+        }
+        inst.op->emitError("More than one valid input to Merge!");
+      }
+      double time = times[ins[i]];
+      produce(outs[0], in(i), time);
+      if (inst.opcode == Opcode::ControlMerge)
+        produce(outs[1], Word{i}, time);
+      consume(ins[i]);
+      found = true;
+    }
+    if (!found) {
+      // Parallel and pipelined runs wake up the merges whenever their
+      // results are consumed, not only when an input arrives.
+      if (backpressure)
+        return false;
+      inst.op->emitError("No valid input to Merge!");
+    }
+    for (unsigned i = 0; i != inst.numResults; ++i)
+      scheduleUsers(outs[i]);
+    return true;
+  }
+
+  case Opcode::Mux: {
+    if (!isPresent(ins[0]) || !canProduce(outs[0]))
+      return false;
+    uint64_t select = std::min<uint64_t>(in(0).i, inst.numOperands - 2);
+    unsigned data = ins[1 + select];
+    if (!isPresent(data))
+      return false;
+    produce(outs[0], values[data], std::max(times[ins[0]], times[data]));
+    consume(ins[0]);
+    consume(data);
+    scheduleUsers(outs[0]);
+    return true;
+  }
+
+  case Opcode::ConditionalBranch: {
+    if (!isPresent(ins[0]) || !isPresent(ins[1]))
+      return false;
+    unsigned out = in(0).i ? outs[0] : outs[1];
+    if (!canProduce(out))
+      return false;
+    produce(out, in(1), std::max(times[ins[0]], times[ins[1]]));
+    scheduleUsers(out);
+    consume(ins[0]);
+    consume(ins[1]);
+    return true;
+  }
+
+  case Opcode::Sink:
+    consume(ins[0]);
+    return true;
+
+  case Opcode::Nop:
+    return true;
+
+  case Opcode::Load: {
+    bool address = isPresent(ins[0]);
+    bool data = isPresent(ins[1]);
+    bool nonce = isPresent(ins[2]);
+    if (address != nonce || (!address && !data))
+      return false;
+    if (address) {
+      if (!canProduce(outs[1]))
+        return false;
+      produce(outs[1], in(0), std::max(times[ins[0]], times[ins[2]]));
+      consume(ins[0]);
+      consume(ins[2]);
+      scheduleUsers(outs[1]);
+    } else {
+      if (!canProduce(outs[0]))
+        return false;
+      produce(outs[0], in(1), times[ins[1]]);
+      consume(ins[1]);
+      scheduleUsers(outs[0]);
+    }
+    return true;
+  }
 
-  // The timeMap associates each value with the time it was created.
-  llvm::DenseMap<mlir::Value, double> timeMap;
+  case Opcode::Memory: {
+    // A memory services the ports that are ready and stays scheduled if any
+    // other one is not. It is rescheduled ahead of the users of the results,
+    // like in the interpreter. A pipelined run keeps it scheduled for the
+    // ports whose results are not consumed yet.
+    Memory &memory = memories[inst.imm];
+    if (!parallel && (inputs.size() > 1 || !allOperandsPresent(inst)))
+      schedule(index);
+    unsigned operand = 0;
+    for (unsigned i = 0; i != memory.numStores; ++i, operand += 2) {
+      unsigned data = ins[operand], address = ins[operand + 1];
+      unsigned nonce = outs[memory.numLoads + i];
+      if (!isPresent(data) || !isPresent(address) || !canProduce(nonce))
+        continue;
+      uint64_t offset = values[address].i;
+      if (memory.elements.holdsFloats())
+        memory.elements.storeFloat(offset, values[data].f);
+      else
+        memory.elements.storeInt(offset, values[data].i);
+      produce(nonce, Word{0},
+              memory.timing.access(offset,
+                                   std::max(times[address], times[data])));
+      scheduleUsers(nonce);
+      consume(data);
+      consume(address);
+    }
+    for (unsigned i = 0; i != memory.numLoads; ++i, ++operand) {
+      unsigned address = ins[operand];
+      unsigned nonce = outs[memory.numLoads + memory.numStores + i];
+      if (!isPresent(address) || !canProduce(outs[i]) || !canProduce(nonce))
+        continue;
+      uint64_t offset = values[address].i;
+      Word element;
+      if (memory.elements.holdsFloats())
+        element.f = memory.elements.loadFloat(offset);
+      else
+        element.i = memory.elements.loadInt(offset);
+      double time = memory.timing.access(offset, times[address]);
+      produce(outs[i], element, time);
+      produce(nonce, Word{0}, time);
+      scheduleUsers(outs[i]);
+      scheduleUsers(nonce);
+      consume(address);
+    }
+    return true;
+  }
+
+  case Opcode::Return: {
+    if (!allOperandsPresent(inst))
+      return false;
+    // The last operand is the control token.
+    std::vector<SimValue> values;
+    double time = 0.0;
+    for (unsigned i = 0; i + 1 < inst.numOperands; ++i) {
+      mlir::Type type = slotValues[ins[i]].getType();
+      Word value = in(i);
+      if (type.isa<mlir::FloatType>())
+        values.push_back(SimValue::getFloat(value.f, type.isF32()));
+      else if (type.isa<mlir::MemRefType>())
+        values.push_back(SimValue::getBuffer(value.i));
+      else
+        values.push_back(SimValue::getInt(getRegisterWidth(type), value.i));
+      time = std::max(time, times[ins[i]]);
+    }
+    results.push_back(std::move(values));
+    resultTimes.push_back(time);
+    consumeOperands(inst);
+    if (++numReturned == inputs.size())
+      returned.store(true, std::memory_order_release);
+    return true;
+  }
+
+  default:
+    break;
+  }
+
+  // The standard operations consume their operands as soon as all of them
+  // are available, with a latency of one.
+  if (!allOperandsPresent(inst) || !canProduce(inst))
+    return false;
+  double time = operandTime(inst) + 1;
+  Word result;
+  unsigned width = inst.width;
+  switch (inst.opcode) {
+  case Opcode::ConstantInt:
+    result = inst.constant;
+    break;
+  case Opcode::AddI:
+    result.i = truncateTo(in(0).i + in(1).i, width);
+    break;
+  case Opcode::SubI:
+    result.i = truncateTo(in(0).i - in(1).i, width);
+    break;
+  case Opcode::MulI:
+    result.i = truncateTo(in(0).i * in(1).i, width);
+    break;
+  case Opcode::DivSI: {
+    assert(in(1).i && "Division By Zero!");
+    int64_t lhs = signExtendFrom(in(0).i, width);
+    int64_t rhs = signExtendFrom(in(1).i, width);
+    // The only overflowing division wraps around to the dividend.
+    result.i = truncateTo(rhs == -1 ? 0 - uint64_t(lhs) : lhs / rhs, width);
+    break;
+  }
+  case Opcode::DivUI:
+    assert(in(1).i && "Division By Zero!");
+    result.i = in(0).i / in(1).i;
+    break;
+  case Opcode::CmpI:
+    result.i = compareIntegers(static_cast<mlir::CmpIPredicate>(inst.imm),
+                               in(0).i, in(1).i, width);
+    break;
+  case Opcode::AddF:
+    result.f = roundFloat(in(0).f + in(1).f, width);
+    break;
+  case Opcode::SubF:
+    result.f = roundFloat(in(0).f - in(1).f, width);
+    break;
+  case Opcode::MulF:
+    result.f = roundFloat(in(0).f * in(1).f, width);
+    break;
+  case Opcode::DivF:
+    result.f = roundFloat(in(0).f / in(1).f, width);
+    break;
+  case Opcode::CmpF:
+    result.i = compareFloats(static_cast<mlir::CmpFPredicate>(inst.imm),
+                             in(0).f, in(1).f);
+    break;
+  case Opcode::SignExtend:
+    result.i = truncateTo(signExtendFrom(in(0).i, inst.imm), width);
+    break;
+  case Opcode::ZeroExtend:
+    result.i = in(0).i;
+    break;
+  default:
+    llvm_unreachable("unknown opcode");
+  }
+  for (unsigned i = 0; i != inst.numResults; ++i)
+    produce(outs[i], result, time);
+  consumeOperands(inst);
+  for (unsigned i = 0; i != inst.numResults; ++i)
+    scheduleUsers(outs[i]);
+  numExecuted.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+/// Fire the instruction `index` and account it in the counters.
+bool CompiledFunction::step(unsigned index,
+                            std::vector<std::vector<SimValue>> &results,
+                            std::vector<double> &resultTimes) {
+  if (!counters && inputs.size() <= 1)
+    return fire(index, results, resultTimes);
+
+  // The tokens consumed by the firing leave at the time of the latest one
+  // present.
+  const Instruction &inst = instructions[index];
+  firing.time = 0.0;
+  for (unsigned i = 0; i != inst.numOperands; ++i) {
+    unsigned slot = slotLists[inst.operands + i];
+    if (isPresent(slot))
+      firing.time = std::max(firing.time, times[slot]);
+  }
+  if (!counters)
+    return fire(index, results, resultTimes);
+
+  firing.critical = -1;
+  firing.numConsumed = 0;
+  firing.produced.clear();
+  bool fired = fire(index, results, resultTimes);
+  if (firing.numConsumed) {
+    ++counters->fires[index];
+    counters->inputWait[index] += firing.lastConsumed - firing.firstConsumed;
+  }
+  for (unsigned slot : firing.produced)
+    if (producers[slot] >= 0)
+      counters->criticalSources[slot] = firing.critical;
+  if (inst.opcode == Opcode::Return && firing.numConsumed)
+    counters->criticalEnd = firing.critical;
+  return fired;
+}
+
+bool CompiledFunction::popWork(unsigned worker, unsigned &inst) {
+  // Take the most recently scheduled instruction of the own queue, whose
+  // operands are likely still in the cache, or steal the oldest one of
+  // another worker.
+  for (unsigned i = 0, e = workQueues.size(); i != e; ++i) {
+    WorkQueue &queue = *workQueues[(worker + i) % e];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.items.empty())
+      continue;
+    if (i == 0) {
+      inst = queue.items.back();
+      queue.items.pop_back();
+    } else {
+      inst = queue.items.front();
+      queue.items.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void CompiledFunction::runWorker(unsigned worker,
+                                 std::vector<std::vector<SimValue>> &results,
+                                 std::vector<double> &resultTimes) {
+  currentWorker = worker;
+  while (!returned.load(std::memory_order_acquire)) {
+    unsigned inst;
+    if (!popWork(worker, inst)) {
+      // Nothing is queued or running anymore without the function having
+      // returned: the graph is deadlocked.
+      if (numPending.load(std::memory_order_acquire) == 0)
+        return;
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Instructions which cannot fire are not retried, they are scheduled
+    // again once one of their channels changes.
+    states[inst].store(Running, std::memory_order_release);
+    while (true) {
+      step(inst, results, resultTimes);
+      uint8_t state = Running;
+      if (states[inst].compare_exchange_strong(state, Idle,
+                                               std::memory_order_acq_rel))
+        break;
+      // The instruction was scheduled again while it ran.
+      states[inst].store(Running, std::memory_order_release);
+    }
+    numPending.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+
+/// Return whether every slot has at most one user, which makes the channels
+/// single-producer single-consumer and lets them be handed over without
+/// locks.
+bool CompiledFunction::hasSingleUsers() const {
+  for (unsigned slot = 0, e = slotValues.size(); slot != e; ++slot)
+    if (userOffsets[slot + 1] - userOffsets[slot] > 1)
+      return false;
+  return true;
+}
+
+void CompiledFunction::execute(ArrayRef<std::vector<SimValue>> argVectors,
+                               unsigned numThreads,
+                               std::vector<std::vector<SimValue>> &results,
+                               std::vector<double> &returnTimes) {
+  assert(!argVectors.empty());
+  unsigned numSlots = slotValues.size();
+  values.assign(numSlots, Word{0});
+  times.assign(numSlots, 0.0);
+  present.reset(new std::atomic<bool>[numSlots]());
+  returned = false;
+  numExecuted = 0;
+  numReturned = 0;
+  inputs = argVectors;
+  nextInputs.assign(body->getNumArguments(), 1);
+  for (Memory &memory : memories) {
+    memory.elements.clear();
+    memory.timing.reset();
+  }
+  if (counters) {
+    counters->consumedAt.assign(numSlots, 0.0);
+    counters->criticalSources.assign(numSlots, -1);
+    counters->criticalEnd = -1;
+  }
+
+  // A pipelined run feeds the arguments from the consumers, which the
+  // parallel engine does not support.
+  parallel = numThreads > 1 && argVectors.size() == 1 && hasSingleUsers();
+  backpressure = parallel || argVectors.size() > 1;
+  if (numThreads > 1 && !parallel)
+    LLVM_DEBUG(dbgs() << "Executing serially\n");
+  workQueues.clear();
+  if (parallel) {
+    states.reset(new std::atomic<uint8_t>[instructions.size()]());
+    for (unsigned i = 0; i != numThreads; ++i)
+      workQueues.push_back(std::make_unique<WorkQueue>());
+  } else {
+    readyList.clear();
+    queued.clear();
+    queued.resize(instructions.size());
+  }
+
+  // Load the arguments into their registers.
+  for (auto it : llvm::zip(body->getArguments(), argVectors.front()))
+    produce(slotIndices.lookup(std::get<0>(it)), toWord(std::get<1>(it)),
+            0.0);
+  currentWorker = 0;
+  for (mlir::Value arg : body->getArguments())
+    scheduleUsers(slotIndices[arg]);
+
+  if (parallel) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i != numThreads; ++i)
+      threads.emplace_back([&, i] { runWorker(i, results, returnTimes); });
+    runWorker(0, results, returnTimes);
+    for (auto &thread : threads)
+      thread.join();
+  } else {
+    while (!returned && !readyList.empty()) {
+      unsigned index = readyList.front();
+      readyList.pop_front();
+      queued.reset(index);
+      if (!step(index, results, returnTimes))
+        schedule(index);
+    }
+  }
+  if (!returned)
+    report_fatal_error("dataflow graph deadlocked before returning");
+  instructionsExecuted += numExecuted;
+  if (counters) {
+    ++counters->numRuns;
+    counters->cycles += returnTimes.back();
+  }
+}
+
+void CompiledFunction::enableCounters() {
+  counters = std::make_unique<Counters>();
+  counters->fires.assign(instructions.size(), 0);
+  counters->inputWait.assign(instructions.size(), 0.0);
+  counters->tokens.assign(slotValues.size(), 0);
+  counters->waiting.assign(slotValues.size(), 0.0);
+  counters->blocked.assign(slotValues.size(), 0.0);
+}
+
+/// Return the slots of the tokens the last return was computed from, each
+/// one from the previous one, starting at an argument.
+std::vector<unsigned> CompiledFunction::getCriticalPath() const {
+  std::vector<unsigned> path;
+  llvm::BitVector visited(slotValues.size());
+  // The sources are those of the last token of each channel, and a loop ends
+  // the path where it reaches a channel again.
+  for (int slot = counters->criticalEnd; slot >= 0 && !visited.test(slot);
+       slot = counters->criticalSources[slot]) {
+    visited.set(slot);
+    path.push_back(slot);
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+/// Return the producer and the first consumer of the channel `slot`.
+std::string CompiledFunction::describeSlot(unsigned slot) const {
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  mlir::Value value = slotValues[slot];
+  if (auto arg = value.dyn_cast<mlir::BlockArgument>())
+    os << "argument " << arg.getArgNumber();
+  else
+    os << '#' << producers[slot] << ' ' << value.getDefiningOp()->getName()
+       << " result " << value.cast<mlir::OpResult>().getResultNumber();
+  if (userOffsets[slot] != userOffsets[slot + 1]) {
+    unsigned user = userLists[userOffsets[slot]];
+    os << " -> #" << user << ' ' << instructions[user].op->getName();
+  }
+  return os.str();
+}
+
+void CompiledFunction::printReport(raw_ostream &os) const {
+  os << "===" << std::string(73, '-') << "===\n"
+     << std::string(22, ' ') << "... Handshake Performance Report ...\n"
+     << "===" << std::string(73, '-') << "===\n"
+     << "  Runs: " << counters->numRuns << ", " << counters->cycles
+     << " cycles\n";
+
+  // The channels the most cycles are lost to, which are where more
+  // buffering would raise the throughput, and the operations starving for
+  // their inputs.
+  const unsigned numListed = 10;
+  std::vector<unsigned> slots(slotValues.size());
+  std::iota(slots.begin(), slots.end(), 0);
+  llvm::stable_sort(slots, [&](unsigned lhs, unsigned rhs) {
+    return counters->blocked[lhs] > counters->blocked[rhs];
+  });
+  os << "\n  Blocked channels:\n"
+     << "    blocked  waiting   tokens  channel\n";
+  for (unsigned slot : ArrayRef<unsigned>(slots).take_front(numListed)) {
+    if (counters->blocked[slot] <= 0)
+      break;
+    os << format("    %7.0f  %7.0f  %7llu  ", counters->blocked[slot],
+                 counters->waiting[slot],
+                 (unsigned long long)counters->tokens[slot])
+       << describeSlot(slot) << "\n";
+  }
+
+  std::vector<unsigned> insts(instructions.size());
+  std::iota(insts.begin(), insts.end(), 0);
+  llvm::stable_sort(insts, [&](unsigned lhs, unsigned rhs) {
+    return counters->inputWait[lhs] > counters->inputWait[rhs];
+  });
+  os << "\n  Operations waiting on inputs:\n"
+     << "    waiting    fires  operation\n";
+  for (unsigned inst : ArrayRef<unsigned>(insts).take_front(numListed)) {
+    if (counters->inputWait[inst] <= 0)
+      break;
+    os << format("    %7.0f  %7llu  #%u ", counters->inputWait[inst],
+                 (unsigned long long)counters->fires[inst], inst)
+       << instructions[inst].op->getName() << "\n";
+  }
+
+  std::vector<unsigned> path = getCriticalPath();
+  os << "\n  Critical path of the last run:\n"
+     << "       time  channel\n";
+  for (unsigned slot : path)
+    os << format("    %7.0f  ", times[slot]) << describeSlot(slot) << "\n";
+}
+
+void CompiledFunction::annotate() const {
+  llvm::BitVector critical(instructions.size());
+  for (unsigned slot : getCriticalPath())
+    if (producers[slot] >= 0)
+      critical.set(producers[slot]);
+
+  for (unsigned i = 0, e = instructions.size(); i != e; ++i) {
+    const Instruction &inst = instructions[i];
+    mlir::Builder builder(inst.op->getContext());
+    auto count = [&](double value) {
+      return builder.getI64IntegerAttr(int64_t(value));
+    };
+    SmallVector<mlir::Attribute, 4> tokens, waiting, blocked;
+    for (unsigned j = 0; j != inst.numResults; ++j) {
+      unsigned slot = slotLists[inst.results + j];
+      tokens.push_back(count(counters->tokens[slot]));
+      waiting.push_back(count(counters->waiting[slot]));
+      blocked.push_back(count(counters->blocked[slot]));
+    }
+    SmallVector<mlir::NamedAttribute, 6> attrs;
+    attrs.push_back(builder.getNamedAttr("fires", count(counters->fires[i])));
+    attrs.push_back(
+        builder.getNamedAttr("input_wait", count(counters->inputWait[i])));
+    attrs.push_back(
+        builder.getNamedAttr("tokens", builder.getArrayAttr(tokens)));
+    attrs.push_back(
+        builder.getNamedAttr("waiting", builder.getArrayAttr(waiting)));
+    attrs.push_back(
+        builder.getNamedAttr("blocked", builder.getArrayAttr(blocked)));
+    if (critical.test(i))
+      attrs.push_back(builder.getNamedAttr("critical", builder.getUnitAttr()));
+    inst.op->setAttr("perf", builder.getDictionaryAttr(attrs));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Toplevel
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The toplevel function of a simulation. It reads the argument vectors of the
+/// command line or of a batch file, executes them and prints their results.
+class Simulator {
+public:
+  Simulator(mlir::ModuleOp module, StringRef toplevelFunction,
+            const SimulationOptions &options)
+      : module(module), toplevelFunction(toplevelFunction), options(options) {}
+
+  /// Check the signature of the toplevel function and compile it if
+  /// requested. Returns false after printing an error otherwise.
+  bool initialize();
+  /// Report the performance counters once all runs are done.
+  bool finish();
+  /// Whether handshake functions execute with the compiled engine.
+  bool isCompiled() const { return compiledFunction != nullptr; }
+
+  /// Parse the arguments of one execution, allocating their memrefs in
+  /// `store`. A memref is either a comma-separated list of values, or `bin:`
+  /// followed by the path of a file holding the binary contents.
+  bool readArguments(ArrayRef<std::string> inputArgs,
+                     std::vector<SimValue> &args, std::vector<SimMemory> &store,
+                     std::vector<double> &storeTimes);
+  /// Execute the function on `argVectors`, appending the results and the
+  /// time of each vector to `results` and `times`. More than one vector is
+  /// pipelined into the compiled engine.
+  void run(ArrayRef<std::vector<SimValue>> argVectors,
+           std::vector<SimMemory> &store, std::vector<double> &storeTimes,
+           std::vector<std::vector<SimValue>> &results,
+           std::vector<double> &times);
+  /// Print the results of an execution and the final contents of its memref
+  /// arguments.
+  void print(ArrayRef<SimValue> args, ArrayRef<SimValue> results,
+             ArrayRef<SimMemory> store);
+
+private:
+  mlir::ModuleOp module;
+  StringRef toplevelFunction;
+  const SimulationOptions &options;
+
+  mlir::FuncOp stdFunction;
+  handshake::FuncOp handshakeFunction;
+  std::unique_ptr<CompiledFunction> compiledFunction;
 
   // We need three things in a function-type independent way.
   // The type signature of the function.
   mlir::FunctionType ftype;
   // The arguments of the entry block.
   mlir::Block::BlockArgListType blockArgs;
-
-  // The number of inputs to the function in the IR.
-  unsigned inputs;
-  unsigned outputs;
   // The number of 'real' inputs.  This avoids the dummy input
   // associated with the handshake control logic for handshake
   // functions.
   unsigned realInputs;
   unsigned realOutputs;
+};
+} // namespace
 
-  if (mlir::FuncOp toplevel =
-          module->lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
-    ftype = toplevel.getType();
-    mlir::Block &entryBlock = toplevel.getBody().front();
-    blockArgs = entryBlock.getArguments();
-
-    // Get the primary inputs of toplevel off the command line.
-    inputs = ftype.getNumInputs();
-    realInputs = inputs;
-    outputs = ftype.getNumResults();
-    realOutputs = outputs;
-  } else if (handshake::FuncOp toplevel =
-                 module->lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
-    ftype = toplevel.getType();
-    mlir::Block &entryBlock = toplevel.getBody().front();
-    blockArgs = entryBlock.getArguments();
-
-    // Get the primary inputs of toplevel off the command line.
-    inputs = ftype.getNumInputs();
-    realInputs = inputs - 1;
-    outputs = ftype.getNumResults();
-    realOutputs = outputs - 1;
-    if (inputs == 0) {
-      errs() << "Function " << toplevelFunction << " is expected to have "
-             << "at least one dummy argument.\n";
-      return 1;
-    }
-    if (outputs == 0) {
-      errs() << "Function " << toplevelFunction << " is expected to have "
-             << "at least one dummy result.\n";
-      return 1;
-    }
-    // Implicit none argument
-    APInt apnonearg(1, 0);
-    valueMap[blockArgs[blockArgs.size() - 1]] = apnonearg;
-  } else {
+bool Simulator::initialize() {
+  if ((stdFunction = module.lookupSymbol<mlir::FuncOp>(toplevelFunction))) {
+    ftype = stdFunction.getType();
+    blockArgs = stdFunction.getBody().front().getArguments();
+    realInputs = ftype.getNumInputs();
+    realOutputs = ftype.getNumResults();
+    return true;
+  }
+
+  handshakeFunction = module.lookupSymbol<handshake::FuncOp>(toplevelFunction);
+  if (!handshakeFunction)
     llvm_unreachable("Function not supported.\n");
+  ftype = handshakeFunction.getType();
+  blockArgs = handshakeFunction.getBody().front().getArguments();
+  if (ftype.getNumInputs() == 0) {
+    errs() << "Function " << toplevelFunction << " is expected to have "
+           << "at least one dummy argument.\n";
+    return false;
+  }
+  if (ftype.getNumResults() == 0) {
+    errs() << "Function " << toplevelFunction << " is expected to have "
+           << "at least one dummy result.\n";
+    return false;
+  }
+  realInputs = ftype.getNumInputs() - 1;
+  realOutputs = ftype.getNumResults() - 1;
+
+  // The interpreter does not model the timing of the memories.
+  bool timedMemories = options.hasMemoryModel();
+  handshakeFunction.walk([&](handshake::MemoryOp op) {
+    timedMemories |= hasMemoryTiming(op);
+  });
+  if (options.needsCompiled() || timedMemories) {
+    compiledFunction = std::make_unique<CompiledFunction>();
+    if (!compiledFunction->compile(handshakeFunction, options)) {
+      LLVM_DEBUG(dbgs() << "Falling back to the interpreter\n");
+      compiledFunction.reset();
+    }
+  }
+  if (timedMemories && !compiledFunction) {
+    errs() << "The memory timing model is only available for standard "
+           << "functions and handshake functions supported by the compiled "
+           << "engine.\n";
+    return false;
+  }
+  if (!options.perfReport && options.annotatePerf.empty())
+    return true;
+  if (!compiledFunction) {
+    errs() << "Performance counters are only available for handshake "
+           << "functions supported by the compiled engine.\n";
+    return false;
   }
+  compiledFunction->enableCounters();
+  return true;
+}
+
+bool Simulator::finish() {
+  if (options.perfReport)
+    compiledFunction->printReport(errs());
+  if (options.annotatePerf.empty())
+    return true;
 
+  std::string errorMessage;
+  auto output = mlir::openOutputFile(options.annotatePerf, &errorMessage);
+  if (!output) {
+    errs() << errorMessage << "\n";
+    return false;
+  }
+  compiledFunction->annotate();
+  module.print(output->os());
+  output->keep();
+  return true;
+}
+
+bool Simulator::readArguments(ArrayRef<std::string> inputArgs,
+                              std::vector<SimValue> &args,
+                              std::vector<SimMemory> &store,
+                              std::vector<double> &storeTimes) {
   if (inputArgs.size() != realInputs) {
     errs() << "Toplevel function " << toplevelFunction << " has " << realInputs
            << " actual arguments, but " << inputArgs.size()
            << " arguments were provided on the command line.\n";
-    return 1;
+    return false;
   }
 
   for (unsigned i = 0; i < realInputs; i++) {
@@ -659,40 +2274,103 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
     if (type.isa<mlir::MemRefType>()) {
       // We require this memref type to be fully specified.
       auto memreftype = type.dyn_cast<mlir::MemRefType>();
-      std::vector<Any> nothing;
+      std::vector<SimValue> nothing;
       std::string x;
       unsigned buffer = allocateMemRef(memreftype, nothing, store, storeTimes);
-      valueMap[blockArgs[i]] = buffer;
-      timeMap[blockArgs[i]] = 0.0;
+      args.push_back(SimValue::getBuffer(buffer));
+      StringRef arg = inputArgs[i];
+      if (arg.consume_front("bin:")) {
+        auto file = MemoryBuffer::getFile(arg);
+        if (std::error_code error = file.getError()) {
+          errs() << "could not open memory file '" << arg
+                 << "': " << error.message() << "\n";
+          return false;
+        }
+        if (!store[buffer].readBinary((*file)->getBuffer())) {
+          errs() << "memory file '" << arg << "' does not hold the "
+                 << memreftype.getNumElements() << " elements of " << type
+                 << "\n";
+          return false;
+        }
+        continue;
+      }
       int64_t i = 0;
-      std::stringstream arg(inputArgs[i]);
-      while (!arg.eof()) {
-        getline(arg, x, ',');
-        store[buffer][i++] = readValueWithType(memreftype.getElementType(), x);
+      std::stringstream elements(arg.str());
+      while (!elements.eof()) {
+        getline(elements, x, ',');
+        store[buffer].store(i++,
+                            readValueWithType(memreftype.getElementType(), x));
       }
     } else {
-      Any value = readValueWithType(type, inputArgs[i]);
-      valueMap[blockArgs[i]] = value;
-      timeMap[blockArgs[i]] = 0.0;
+      args.push_back(readValueWithType(type, inputArgs[i]));
     }
   }
+  // Implicit none argument
+  if (handshakeFunction)
+    args.push_back(SimValue::getInt(1, 0));
+  return true;
+}
+
+void Simulator::run(ArrayRef<std::vector<SimValue>> argVectors,
+                    std::vector<SimMemory> &store,
+                    std::vector<double> &storeTimes,
+                    std::vector<std::vector<SimValue>> &results,
+                    std::vector<double> &times) {
+  if (compiledFunction) {
+    compiledFunction->execute(argVectors, options.numThreads, results, times);
+    return;
+  }
 
-  std::vector<Any> results(realOutputs);
+  assert(argVectors.size() == 1 && "only the compiled engine pipelines");
+  ArrayRef<SimValue> args = argVectors.front();
+  std::vector<SimValue> values(realOutputs);
   std::vector<double> resultTimes(realOutputs);
-  if (mlir::FuncOp toplevel =
-          module->lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
-    executeFunction(toplevel, valueMap, timeMap, results, resultTimes, store,
-                    storeTimes);
-  } else if (handshake::FuncOp toplevel =
-                 module->lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
-    executeHandshakeFunction(toplevel, valueMap, timeMap, results, resultTimes,
-                             store, storeTimes);
+  if (stdFunction) {
+    // The valueMap associates each SSA statement in the program
+    // (represented by a Value*) with it's corresponding value.
+    llvm::DenseMap<mlir::Value, SimValue> valueMap;
+    // The timeMap associates each value with the time it was created.
+    llvm::DenseMap<mlir::Value, double> timeMap;
+    for (unsigned i = 0; i < realInputs; i++) {
+      valueMap[blockArgs[i]] = args[i];
+      timeMap[blockArgs[i]] = 0.0;
+    }
+    executeFunction(stdFunction, valueMap, timeMap, values, resultTimes, store,
+                    storeTimes, options);
+  } else {
+    // The handshake operations execute on the untyped values of their
+    // execution interface.
+    llvm::DenseMap<mlir::Value, Any> valueMap;
+    llvm::DenseMap<mlir::Value, double> timeMap;
+    for (unsigned i = 0; i < args.size(); i++) {
+      valueMap[blockArgs[i]] = args[i].toAny();
+      timeMap[blockArgs[i]] = 0.0;
+    }
+    std::vector<Any> anyResults(realOutputs);
+    std::vector<std::vector<Any>> anyStore(store.size());
+    for (unsigned ptr = 0; ptr < store.size(); ptr++)
+      for (size_t j = 0; j < store[ptr].size(); j++)
+        anyStore[ptr].push_back(store[ptr].load(j).toAny());
+    executeHandshakeFunction(handshakeFunction, valueMap, timeMap, anyResults,
+                             resultTimes, anyStore, storeTimes);
+    for (unsigned ptr = 0; ptr < store.size(); ptr++)
+      for (size_t j = 0; j < store[ptr].size(); j++)
+        store[ptr].store(j, SimValue::fromAny(anyStore[ptr][j]));
+    for (unsigned i = 0; i < realOutputs; i++)
+      values[i] = SimValue::fromAny(anyResults[i]);
   }
   double time = 0.0;
+  for (double resultTime : resultTimes)
+    time = std::max(resultTime, time);
+  results.push_back(std::move(values));
+  times.push_back(time);
+}
+
+void Simulator::print(ArrayRef<SimValue> args, ArrayRef<SimValue> results,
+                      ArrayRef<SimMemory> store) {
   for (unsigned i = 0; i < results.size(); i++) {
     mlir::Type t = ftype.getResult(i);
-    outs() << printAnyValueWithType(t, results[i]) << " ";
-    time = std::max(resultTimes[i], time);
+    outs() << printValueWithType(t, results[i]) << " ";
   }
   // Go back through the arguments and output any memrefs.
   for (unsigned i = 0; i < realInputs; i++) {
@@ -700,19 +2378,115 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
     if (type.isa<mlir::MemRefType>()) {
       // We require this memref type to be fully specified.
       auto memreftype = type.dyn_cast<mlir::MemRefType>();
-      unsigned buffer = any_cast<unsigned>(valueMap[blockArgs[i]]);
+      unsigned buffer = args[i].getBuffer();
       auto elementType = memreftype.getElementType();
       for (int j = 0; j < memreftype.getNumElements(); j++) {
         if (j != 0)
           outs() << ",";
-        outs() << printAnyValueWithType(elementType, store[buffer][j]);
+        outs() << printValueWithType(elementType, store[buffer].load(j));
       }
       outs() << " ";
     }
   }
   outs() << "\n";
+}
 
-  simulatedTime += (int)time;
+bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
+              mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+              const SimulationOptions &options) {
+  Simulator simulator(*module, toplevelFunction, options);
+  if (!simulator.initialize())
+    return 1;
 
-  return 0;
+  // The store associates each allocation in the program
+  // (represented by a int) with the values which can be accessed by it.
+  std::vector<SimMemory> store;
+  std::vector<double> storeTimes;
+  // The values of the arguments of the function.
+  std::vector<SimValue> args;
+  if (!simulator.readArguments(inputArgs, args, store, storeTimes))
+    return 1;
+
+  std::vector<std::vector<SimValue>> results;
+  std::vector<double> times;
+  simulator.run(args, store, storeTimes, results, times);
+  simulator.print(args, results.front(), store);
+  simulatedTime += (int)times.front();
+
+  outs().flush();
+  return !simulator.finish();
+}
+
+bool simulateBatch(StringRef toplevelFunction, StringRef batchFile,
+                   mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+                   const SimulationOptions &options) {
+  Simulator simulator(*module, toplevelFunction, options);
+  if (!simulator.initialize())
+    return 1;
+  if (options.pipelined && !simulator.isCompiled()) {
+    errs() << "Toplevel function " << toplevelFunction
+           << " cannot be pipelined, only handshake functions supported by "
+           << "the compiled engine can.\n";
+    return 1;
+  }
+
+  auto file = MemoryBuffer::getFileOrSTDIN(batchFile);
+  if (std::error_code error = file.getError()) {
+    errs() << "could not open batch file '" << batchFile
+           << "': " << error.message() << "\n";
+    return 1;
+  }
+
+  // Every line holds the arguments of one execution. Empty lines and lines
+  // starting with '#' are skipped.
+  std::vector<SimMemory> store;
+  std::vector<double> storeTimes;
+  std::vector<std::vector<SimValue>> argVectors;
+  SmallVector<StringRef, 8> lines;
+  (*file)->getBuffer().split(lines, '\n');
+  for (StringRef line : lines) {
+    line = line.trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    SmallVector<StringRef, 8> fields;
+    SplitString(line, fields);
+    std::vector<std::string> inputArgs(fields.begin(), fields.end());
+    argVectors.emplace_back();
+    if (!simulator.readArguments(inputArgs, argVectors.back(), store,
+                                 storeTimes))
+      return 1;
+  }
+  if (argVectors.empty())
+    return 0;
+
+  // The vectors are either executed back-to-back, each one starting at time
+  // zero once the previous one returned, or pipelined in a single run.
+  std::vector<std::vector<SimValue>> results;
+  std::vector<double> times;
+  double cycles = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  if (options.pipelined) {
+    simulator.run(argVectors, store, storeTimes, results, times);
+    cycles = times.back();
+  } else {
+    for (auto &args : argVectors) {
+      simulator.run(args, store, storeTimes, results, times);
+      cycles += times.back();
+    }
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  for (size_t i = 0, e = argVectors.size(); i != e; ++i)
+    simulator.print(argVectors[i], results[i], store);
+  simulatedTime += (int)cycles;
+
+  outs().flush();
+  size_t numResults = results.size();
+  errs() << numResults << " results in " << cycles << " cycles, "
+         << format("%.2f", cycles / numResults) << " cycles per result, "
+         << format("%.1f", numResults / std::max(seconds, 1e-9))
+         << " tokens per second\n";
+  return !simulator.finish();
 }
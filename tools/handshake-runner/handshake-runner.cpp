@@ -41,6 +41,61 @@ static cl::opt<std::string>
                      cl::desc("The toplevel function to execute"),
                      cl::init("main"), cl::cat(mainCategory));
 
+static cl::opt<bool>
+    compiled("compiled", cl::Optional,
+             cl::desc("Execute handshake functions with the compiled engine"),
+             cl::init(false), cl::cat(mainCategory));
+
+static cl::opt<unsigned>
+    numThreads("threads", cl::Optional,
+               cl::desc("Number of threads executing the handshake operations "
+                        "with the compiled engine. The default of one keeps "
+                        "the deterministic order of the interpreter"),
+               cl::init(1), cl::cat(mainCategory));
+
+static cl::opt<std::string>
+    batchFile("batch", cl::Optional,
+              cl::desc("Execute the function once for every line of the given "
+                       "file, which holds the input args of one execution"),
+              cl::value_desc("filename"), cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<bool> pipelined(
+    "pipelined", cl::Optional,
+    cl::desc("Feed the lines of the batch file into the handshake function as "
+             "fast as it accepts them, instead of executing them "
+             "back-to-back. Implies -compiled"),
+    cl::init(false), cl::cat(mainCategory));
+
+static cl::opt<bool> perfReport(
+    "perf-report", cl::Optional,
+    cl::desc("Print the tokens, waits and stalls of the handshake operations "
+             "and channels, and the critical path, on stderr. Implies "
+             "-compiled"),
+    cl::init(false), cl::cat(mainCategory));
+
+static cl::opt<std::string> annotatePerf(
+    "annotate-perf", cl::Optional,
+    cl::desc("Write the module with the performance counters attached to the "
+             "handshake operations to the given file. Implies -compiled"),
+    cl::value_desc("filename"), cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<unsigned> memoryLatency(
+    "memory-latency", cl::Optional,
+    cl::desc("Number of cycles the accesses to a memory take on top of the "
+             "operations issuing them"),
+    cl::init(0), cl::cat(mainCategory));
+
+static cl::opt<unsigned> memoryPorts(
+    "memory-ports", cl::Optional,
+    cl::desc("Number of accesses each bank of a memory serves per cycle, or "
+             "0 for any number"),
+    cl::init(0), cl::cat(mainCategory));
+
+static cl::opt<unsigned> memoryBanks(
+    "memory-banks", cl::Optional,
+    cl::desc("Number of banks the addresses of a memory are interleaved over"),
+    cl::init(1), cl::cat(mainCategory));
+
 // static opt<bool> runStats("runStats", cl::Optional,
 //                           cl::desc("Print Execution Statistics"),
 //                           cl::init(false), cl::cat(mainCategory));
@@ -53,7 +108,8 @@ int main(int argc, char **argv) {
       "This application executes a function in the given MLIR module\n"
       "Arguments to the function are passed on the command line and\n"
       "results are returned on stdout.\n"
-      "Memref types are specified as a comma-separated list of values.\n");
+      "Memref types are specified as a comma-separated list of values,\n"
+      "or as bin: followed by a file holding their binary contents.\n");
 
   auto file_or_err = MemoryBuffer::getFileOrSTDIN(inputFileName.c_str());
   if (std::error_code error = file_or_err.getError()) {
@@ -80,5 +136,22 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  return simulate(toplevelFunction, inputArgs, module, context);
+  SimulationOptions options;
+  options.compiled = compiled;
+  options.numThreads = numThreads;
+  options.pipelined = pipelined;
+  options.perfReport = perfReport;
+  options.annotatePerf = annotatePerf;
+  options.memoryLatency = memoryLatency;
+  options.memoryPorts = memoryPorts;
+  options.memoryBanks = memoryBanks;
+  if (!batchFile.empty()) {
+    if (!inputArgs.empty()) {
+      errs() << "Input args cannot be combined with -batch.\n";
+      return 1;
+    }
+    return simulateBatch(toplevelFunction, batchFile, module, context,
+                         options);
+  }
+  return simulate(toplevelFunction, inputArgs, module, context, options);
 }
@@ -13,6 +13,7 @@
 #include "circt/Conversion/LLHDToLLVM/LLHDToLLVM.h"
 #include "circt/Dialect/LLHD/IR/LLHDDialect.h"
 #include "circt/Dialect/LLHD/Simulator/Engine.h"
+#include "circt/Dialect/LLHD/Transforms/Passes.h"
 
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
@@ -24,7 +25,12 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "mlir/Transforms/Passes.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/ToolOutputFile.h"
 
@@ -103,6 +109,153 @@ static cl::opt<TraceFormat> traceMode(
             "instance and signals not having the default name '(sig)?[0-9]*'"),
         clEnumValN(noTrace, "no-trace", "Don't dump a signal trace")));
 
+enum QueueFormat { slotList, timingWheel };
+
+static cl::opt<QueueFormat> eventQueue(
+    "event-queue", cl::desc("Choose the event queue implementation:"),
+    cl::init(timingWheel),
+    cl::values(clEnumValN(slotList, "slot-list",
+                          "Keep the pending events in a list, searched "
+                          "linearly"),
+               clEnumValN(timingWheel, "timing-wheel",
+                          "Keep the pending events in a hierarchical timing "
+                          "wheel")));
+
+static cl::opt<std::string> traceSignals(
+    "trace-signals",
+    cl::desc("Only trace the signals selected by the given file, listing one "
+             "glob pattern over the signal paths per line. Signals matching "
+             "a pattern prefixed with '!' are left out, and if there are "
+             "other patterns, only the signals matching one of them are "
+             "traced"),
+    cl::value_desc("filename"));
+
+static cl::opt<bool>
+    vcd("vcd", cl::desc("Write the trace in the Value Change Dump format, with "
+                        "the final value of each real-time step"));
+
+static cl::opt<bool> asyncTrace(
+    "async-trace",
+    cl::desc("Format and write the trace on a background thread"));
+
+static cl::opt<unsigned long long> traceBufferSize(
+    "trace-buffer-size",
+    cl::desc("With -async-trace, pause the simulation while the unwritten "
+             "changes take more than the given number of bytes, 0 meaning "
+             "no limit"),
+    cl::init(0));
+
+static cl::opt<unsigned> threads(
+    "threads",
+    cl::desc("Run the instances woken up in a step on the given number of "
+             "threads, 0 meaning all the hardware threads"),
+    cl::init(1));
+
+static cl::opt<std::string> emitObject(
+    "emit-object",
+    cl::desc("Compile the design to a native object file instead of "
+             "simulating it. The object, or a shared library built from it, "
+             "can be simulated with -precompiled"),
+    cl::value_desc("filename"));
+
+static cl::opt<std::string> precompiled(
+    "precompiled",
+    cl::desc("Simulate the design with the units of an object file written "
+             "by -emit-object, or of a shared library built from one, "
+             "without compiling the design"),
+    cl::value_desc("filename"));
+
+static cl::opt<std::string> objectCache(
+    "object-cache",
+    cl::desc("Keep the compiled designs in the given directory, keyed by the "
+             "input, the root and the optimization level, and simulate them "
+             "from there on later runs"),
+    cl::value_desc("directory"));
+
+static cl::opt<uint64_t> checkpointAt(
+    "checkpoint-at",
+    cl::desc("Stop the simulation before the first step at or after the "
+             "given simulation time in picoseconds, and write its state to "
+             "the -checkpoint-file"),
+    cl::value_desc("time"));
+
+static cl::opt<std::string> checkpointFile(
+    "checkpoint-file", cl::desc("The checkpoint written by -checkpoint-at"),
+    cl::value_desc("filename"), cl::init("llhd-sim.checkpoint"));
+
+static cl::opt<std::string>
+    restore("restore",
+            cl::desc("Resume the simulation from a checkpoint written by "
+                     "-checkpoint-at for the same design"),
+            cl::value_desc("filename"));
+
+static cl::opt<bool> cycleBased(
+    "cycle-based",
+    cl::desc("Evaluate the combinational entities once per step in "
+             "topological order, without scheduling their drives in later "
+             "delta and epsilon steps"));
+
+static cl::opt<bool> lazyJIT(
+    "lazy-jit",
+    cl::desc("Compile each unit on its first invocation instead of compiling "
+             "the whole design before simulating it. The units invoked at "
+             "once are compiled on the -threads threads"));
+
+static cl::opt<bool> inlineDrives(
+    "inline-drives",
+    cl::desc("Lower the drives of integers of at most 64 bits to an inline "
+             "append to a drive buffer, only calling into the runtime when it "
+             "is full"));
+
+static cl::opt<bool> staticLayout(
+    "static-layout",
+    cl::desc("Emit the instances and signals of the design as constant "
+             "tables at compile time, mapped by a single runtime call at "
+             "startup"));
+
+static cl::opt<bool> coalesceProbes(
+    "coalesce-probes",
+    cl::desc("Probe each signal once per temporal region of the processes, "
+             "and once per entity"));
+
+static cl::opt<bool> fuseEntities(
+    "fuse-entities",
+    cl::desc("Fuse the instances of entities sensitive to the same signals "
+             "into one instance before simulating. A design compiled or "
+             "checkpointed with this option must be run with it as well"));
+
+static cl::opt<bool> arena(
+    "arena",
+    cl::desc("Allocate the states and signal values of all instances at once "
+             "at startup, grouped by instance, rather than one at a time"));
+
+static cl::opt<bool> eliminateDeadSignals(
+    "eliminate-dead-signals",
+    cl::desc("With the reduced trace formats, remove the signals and units "
+             "that cannot affect the traced signals before simulating"),
+    cl::init(true));
+
+static cl::opt<bool> simStats(
+    "sim-stats",
+    cl::desc("Print the performance counters of the simulation to stderr at "
+             "exit: the events processed, the steps per real-time step, the "
+             "activations per unit, the time spent in the units, the queue "
+             "depth and the trace size"));
+
+static cl::opt<std::string> simStatsJSON(
+    "sim-stats-json",
+    cl::desc("Write the performance counters of the simulation to this file "
+             "as JSON"),
+    cl::value_desc("filename"));
+
+static cl::opt<std::string> batch(
+    "batch",
+    cl::desc("Simulate one replica of the design per line of the given file, "
+             "listing the initial 'path=value' signal values of the replica. "
+             "The traces go to the output file suffixed with the replica "
+             "index, or to stdout one after the other"),
+    cl::value_desc("filename"));
+
 static cl::list<std::string>
     sharedLibs("shared-libs",
                cl::desc("Libraries to link dynamically. Specify absolute path "
@@ -140,11 +293,186 @@ static int dumpLLVM(ModuleOp module, MLIRContext &context) {
 static LogicalResult applyMLIRPasses(ModuleOp module) {
   PassManager pm(module.getContext());
 
-  pm.addPass(createConvertLLHDToLLVMPass());
+  if (coalesceProbes)
+    pm.addPass(llhd::createProbeCoalescingPass());
+  pm.addPass(createConvertLLHDToLLVMPass(inlineDrives, staticLayout, arena));
 
   return pm.run(module);
 }
 
+/// Whether to remove the parts of the design not affecting the trace. The
+/// designs are left as they are if their signals are looked up by name, or
+/// if they have to match a design compiled or checkpointed on another run.
+static bool shouldEliminateDeadSignals() {
+  if (!eliminateDeadSignals ||
+      (traceMode != reduced && traceMode != mergedReduce &&
+       traceMode != namedOnly))
+    return false;
+  return traceSignals.empty() && batch.empty() && restore.empty() &&
+         !checkpointAt.getNumOccurrences() && emitObject.empty() &&
+         precompiled.empty();
+}
+
+/// Compute the name of the design's object in the object cache. The cached
+/// objects of other builds of llhd-sim are not reused, as the lowering may
+/// have changed.
+static std::string getCacheKey(StringRef input, const char *argv0) {
+  llvm::SHA1 hash;
+  hash.update(input);
+  hash.update(root);
+  hash.update(std::to_string(optimizationLevel));
+  hash.update(inlineDrives ? "inline-drives" : "");
+  hash.update(staticLayout ? "static-layout" : "");
+  hash.update(arena ? "arena" : "");
+  hash.update(coalesceProbes ? "coalesce-probes" : "");
+  hash.update(fuseEntities ? "fuse-entities" : "");
+  if (shouldEliminateDeadSignals())
+    hash.update("dead-signals-" + std::to_string(traceMode));
+  auto executable =
+      llvm::sys::fs::getMainExecutable(argv0, (void *)&getCacheKey);
+  llvm::sys::fs::file_status status;
+  if (!llvm::sys::fs::status(executable, status)) {
+    hash.update(executable);
+    hash.update(std::to_string(
+        status.getLastModificationTime().time_since_epoch().count()));
+  }
+  return llvm::toHex(hash.final(), /*LowerCase=*/true);
+}
+
+/// Compile the design to an object at `path` in the object cache. The object
+/// is written to a temporary file first, for the concurrent runs of the same
+/// design to only ever see complete objects.
+static LogicalResult compileToCache(ModuleOp module, StringRef path,
+                                    raw_ostream &out) {
+  std::error_code ec =
+      llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path));
+  SmallString<128> tempPath;
+  int fd;
+  if (!ec)
+    ec = llvm::sys::fs::createUniqueFile(path + "-%%%%%%%%.tmp", fd, tempPath);
+  if (ec) {
+    llvm::errs() << "failed to write to the object cache: " << ec.message()
+                 << "\n";
+    return failure();
+  }
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+  // The original module is needed unlowered by the simulation engine.
+  OwningModuleRef copy(module.clone());
+  llhd::sim::Engine compiler(
+      out, *copy, &applyMLIRPasses,
+      makeOptimizingTransformer(optimizationLevel, 0, nullptr), root, noTrace,
+      {});
+  if (failed(compiler.emitObjectFile(tempPath)) ||
+      llvm::sys::fs::rename(tempPath, path)) {
+    llvm::sys::fs::remove(tempPath);
+    return failure();
+  }
+  return success();
+}
+
+/// Parse the stimuli of a batch simulation. Each line describes one replica,
+/// with space separated 'path=value' pairs. Empty lines and lines starting
+/// with '#' are skipped.
+static LogicalResult parseBatch(StringRef path,
+                                SmallVectorImpl<llhd::sim::Stimulus> &stimuli) {
+  std::string errorMessage;
+  auto file = openInputFile(path, &errorMessage);
+  if (!file) {
+    llvm::errs() << errorMessage << "\n";
+    return failure();
+  }
+
+  SmallVector<StringRef, 8> lines, pairs;
+  file->getBuffer().split(lines, '\n');
+  for (auto line : lines) {
+    line = line.trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    llhd::sim::Stimulus stimulus;
+    pairs.clear();
+    line.split(pairs, ' ', -1, /*KeepEmpty=*/false);
+    for (auto pair : pairs) {
+      auto parts = pair.split('=');
+      if (parts.second.empty()) {
+        llvm::errs() << path << ": expected 'path=value', got '" << pair
+                     << "'\n";
+        return failure();
+      }
+      stimulus.push_back({parts.first.str(), parts.second.str()});
+    }
+    stimuli.push_back(std::move(stimulus));
+  }
+  return success();
+}
+
+/// Parse the signal filter of the trace. Each line holds one glob pattern,
+/// excluding the matching signals if it is prefixed with '!'. Empty lines and
+/// lines starting with '#' are skipped.
+static LogicalResult parseTraceFilter(StringRef path,
+                                      std::vector<std::string> &include,
+                                      std::vector<std::string> &exclude) {
+  std::string errorMessage;
+  auto file = openInputFile(path, &errorMessage);
+  if (!file) {
+    llvm::errs() << errorMessage << "\n";
+    return failure();
+  }
+
+  SmallVector<StringRef, 8> lines;
+  file->getBuffer().split(lines, '\n');
+  for (auto line : lines) {
+    line = line.trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    if (line.consume_front("!"))
+      exclude.push_back(line.ltrim().str());
+    else
+      include.push_back(line.str());
+  }
+  return success();
+}
+
+/// Simulate the replicas of a batch, writing their traces to files suffixed
+/// with their index, or to `output` in order if it is stdout.
+static int simulateBatch(llhd::sim::Engine &engine, ToolOutputFile &output) {
+  SmallVector<llhd::sim::Stimulus, 0> stimuli;
+  if (failed(parseBatch(batch, stimuli)))
+    return 1;
+
+  std::vector<std::string> buffers(stimuli.size());
+  std::vector<std::unique_ptr<raw_string_ostream>> bufferStreams;
+  std::vector<std::unique_ptr<ToolOutputFile>> files;
+  SmallVector<raw_ostream *, 0> outs;
+  bool toStdout = outputFilename == "-";
+  for (size_t i = 0, e = stimuli.size(); i < e; ++i) {
+    if (toStdout) {
+      bufferStreams.push_back(std::make_unique<raw_string_ostream>(buffers[i]));
+      outs.push_back(bufferStreams.back().get());
+      continue;
+    }
+    std::string errorMessage;
+    auto file = openOutputFile(outputFilename + "." + std::to_string(i),
+                               &errorMessage);
+    if (!file) {
+      llvm::errs() << errorMessage << "\n";
+      return 1;
+    }
+    outs.push_back(&file->os());
+    files.push_back(std::move(file));
+  }
+
+  if (engine.simulateBatch(stimuli, outs, nSteps, maxTime))
+    return 1;
+
+  for (size_t i = 0, e = bufferStreams.size(); i < e; ++i)
+    output.os() << "replica " << i << "\n" << bufferStreams[i]->str();
+  for (auto &file : files)
+    file->keep();
+  output.keep();
+  return 0;
+}
+
 int main(int argc, char **argv) {
   InitLLVM y(argc, argv);
 
@@ -182,13 +510,44 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  // The passes changing the instance layout run before the engine builds it.
+  bool eliminate = shouldEliminateDeadSignals();
+  if (eliminate || fuseEntities) {
+    PassManager pm(&context);
+    if (eliminate)
+      pm.addPass(llhd::createDeadSignalEliminationPass(
+          root, /*namedOnly=*/traceMode == namedOnly));
+    if (fuseEntities)
+      pm.addPass(llhd::createEntityFusionPass());
+    if (failed(pm.run(*module)))
+      return 1;
+  }
+
   SmallVector<StringRef, 1> sharedLibPaths(sharedLibs.begin(),
                                            sharedLibs.end());
 
+  // Simulate the design from the object cache, compiling it there first if
+  // it is missing.
+  std::string precompiledPath = precompiled;
+  if (!objectCache.empty() && precompiledPath.empty() && emitObject.empty() &&
+      !dumpLLVMDialect && !dumpLLVMIR) {
+    auto input = mgr.getMemoryBuffer(mgr.getMainFileID())->getBuffer();
+    SmallString<128> path(objectCache);
+    llvm::sys::path::append(path, getCacheKey(input, argv[0]) + ".o");
+    if (!llvm::sys::fs::exists(path) &&
+        failed(compileToCache(*module, path, output->os())))
+      return 1;
+    precompiledPath = std::string(path);
+  }
+
   llhd::sim::Engine engine(
       output->os(), *module, &applyMLIRPasses,
       makeOptimizingTransformer(optimizationLevel, 0, nullptr), root, traceMode,
-      sharedLibPaths);
+      sharedLibPaths, eventQueue, threads, vcd, asyncTrace, traceBufferSize,
+      precompiledPath);
+
+  if (!emitObject.empty())
+    return failed(engine.emitObjectFile(emitObject)) ? 1 : 0;
 
   if (dumpLLVMDialect || dumpLLVMIR) {
     return dumpLLVM(engine.getModule(), context);
@@ -200,8 +559,38 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  if (checkpointAt.getNumOccurrences())
+    engine.checkpointAt(checkpointAt, checkpointFile);
+  if (!restore.empty())
+    engine.restoreFrom(restore);
+  engine.setCycleBased(cycleBased);
+  engine.setLazyCompilation(lazyJIT);
+
+  if (!traceSignals.empty()) {
+    std::vector<std::string> include, exclude;
+    if (failed(parseTraceFilter(traceSignals, include, exclude)) ||
+        failed(engine.setTraceFilter(include, exclude)))
+      return 1;
+  }
+
+  if (!batch.empty())
+    return simulateBatch(engine, *output);
+
+  engine.enableStatistics(simStats || !simStatsJSON.empty());
   engine.simulate(nSteps, maxTime);
 
+  if (simStats)
+    engine.getStatistics().print(llvm::errs());
+  if (!simStatsJSON.empty()) {
+    auto statsFile = openOutputFile(simStatsJSON, &errorMessage);
+    if (!statsFile) {
+      llvm::errs() << errorMessage << "\n";
+      return 1;
+    }
+    engine.getStatistics().printJSON(statsFile->os());
+    statsFile->keep();
+  }
+
   output->keep();
   return 0;
 }
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+# ===- calyx-control-bench.py - Control compilation benchmark -*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate a Calyx program with many components, each running a long, nested
+# sequence of groups, and time the Go Insertion and Compile Control passes
+# over it.  These passes run on each component independently, so the program
+# is compiled once on a single thread and once with the default thread pool,
+# and the wall-clock times of both runs are reported as JSON.
+#
+# Usage: calyx-control-bench.py --circt-opt build/bin/circt-opt \
+#            --components 1000 --groups 50
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+Pipeline = ("calyx.program(calyx.component(calyx-go-insertion, "
+            "calyx-compile-control))")
+
+
+def generate_component(name, groups, nesting):
+  """Return a component running `groups` groups in sequences nested
+  `nesting` deep."""
+  lines = ["  calyx.component @{}() -> () {{".format(name)]
+  for i in range(groups):
+    lines.append("    %in{0}, %go{0}, %out{0}, %done{0} = "
+                 "calyx.cell \"c{0}\" @Cell : i32, i1, i32, i1".format(i))
+  lines.append("    calyx.wires {")
+  for i in range(groups):
+    lines += [
+        "      calyx.group @G{} {{".format(i),
+        "        calyx.assign %in{} = %out{} : i32".format(
+            i, (i + groups - 1) % groups),
+        "        calyx.group_done %done{} : i1".format(i), "      }"
+    ]
+  lines.append("    }")
+
+  # Split the groups evenly over the nesting levels.
+  lines.append("    calyx.control {")
+  per_level = max(1, groups // nesting)
+  depth = 0
+  for i in range(groups):
+    if i % per_level == 0 and depth < nesting:
+      lines.append("    " + "  " * (depth + 1) + "calyx.seq {")
+      depth += 1
+    lines.append("    " + "  " * (depth + 1) + "calyx.enable @G{}".format(i))
+  for level in reversed(range(depth)):
+    lines.append("    " + "  " * (level + 1) + "}")
+  lines += ["    }", "  }"]
+  return lines
+
+
+def run(args, mlir_path, threads):
+  """Return the wall-clock time of compiling `mlir_path` in seconds."""
+  cmd = [
+      args.circt_opt, mlir_path, "-pass-pipeline=" + Pipeline,
+      "-mlir-timing", "-o", os.devnull
+  ]
+  if not threads:
+    cmd.append("-mlir-disable-threading")
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stderr)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+  match = re.search(r"Total Execution Time: ([0-9.]+) seconds", result.stderr)
+  return float(match.group(1)) if match else None
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the speed of the Calyx control compilation.")
+  parser.add_argument("--circt-opt",
+                      default="circt-opt",
+                      help="circt-opt binary")
+  parser.add_argument("--components",
+                      type=int,
+                      default=1000,
+                      help="Components in the generated program")
+  parser.add_argument("--groups",
+                      type=int,
+                      default=50,
+                      help="Groups in each component")
+  parser.add_argument("--nesting",
+                      type=int,
+                      default=4,
+                      help="Nesting depth of the sequences")
+  args = parser.parse_args()
+
+  lines = [
+      "calyx.program {", "  calyx.component @Cell(%in: i32, %go: i1) -> "
+      "(%out: i32, %done: i1) {", "    calyx.wires {}", "    calyx.control {}",
+      "  }"
+  ]
+  for i in range(args.components):
+    name = "main" if i == 0 else "C{}".format(i)
+    lines += generate_component(name, args.groups, args.nesting)
+  lines.append("}")
+
+  workdir = tempfile.mkdtemp(prefix="calyx-control-bench")
+  generated = os.path.join(workdir, "program.mlir")
+  with open(generated, "w") as f:
+    f.write("\n".join(lines) + "\n")
+
+  single = run(args, generated, threads=False)
+  multi = run(args, generated, threads=True)
+  if single is None or multi is None:
+    return 1
+
+  json.dump(
+      {
+          "parameters": {
+              "components": args.components,
+              "groups": args.groups,
+              "nesting": args.nesting,
+          },
+          "single_thread_sec": single,
+          "multi_thread_sec": multi,
+      },
+      sys.stdout,
+      indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+
+# ===- esi-cosim-bench.py - ESI cosim transport benchmark -----*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Run esi-cosim-bench over every combination of transport, message size and
+# endpoint count, and report the throughput and the round-trip latency
+# percentiles of each as JSON.  esi-cosim-bench plays the loopback endpoints
+# itself, so no simulator is needed; see integration_test/ESI/cosim/bench.sv
+# for the same measurements against a simulation.
+#
+# Usage: esi-cosim-bench.py --bench build/bin/esi-cosim-bench \
+#            --transports rpc shm --sizes 8 256 4096 --endpoints 1 4
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import subprocess
+import sys
+import tempfile
+
+
+def run(args, transport, size, endpoints, workdir):
+  cmd = [
+      args.bench, "--transport=" + transport, "--size={}".format(size),
+      "--endpoints={}".format(endpoints),
+      "--latency-messages={}".format(args.latency_messages),
+      "--throughput-messages={}".format(args.throughput_messages),
+      "--window={}".format(args.window)
+  ]
+  # The benchmark writes cosim.cfg and the shared memory file to its working
+  # directory.
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          cwd=workdir,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stderr)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+  return json.loads(result.stdout)
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the throughput and latency of the cosim transports.")
+  parser.add_argument("--bench",
+                      default="esi-cosim-bench",
+                      help="esi-cosim-bench binary")
+  parser.add_argument("--transports",
+                      nargs="+",
+                      default=["rpc", "shm"],
+                      choices=["rpc", "shm"],
+                      help="Transports to measure")
+  parser.add_argument("--sizes",
+                      type=int,
+                      nargs="+",
+                      default=[8, 256, 4096],
+                      help="Message data sizes in bytes")
+  parser.add_argument("--endpoints",
+                      type=int,
+                      nargs="+",
+                      default=[1, 4],
+                      help="Numbers of endpoints used at once")
+  parser.add_argument("--latency-messages",
+                      type=int,
+                      default=1000,
+                      help="Round trips timed one at a time")
+  parser.add_argument("--throughput-messages",
+                      type=int,
+                      default=10000,
+                      help="Messages sent to measure the throughput")
+  parser.add_argument("--window",
+                      type=int,
+                      default=16,
+                      help="Messages in flight on each endpoint")
+  args = parser.parse_args()
+
+  workdir = tempfile.mkdtemp(prefix="esi-cosim-bench")
+  results = []
+  for transport in args.transports:
+    for size in args.sizes:
+      for endpoints in args.endpoints:
+        result = run(args, transport, size, endpoints, workdir)
+        if result is None:
+          return 1
+        results.append(result)
+
+  json.dump({"window": args.window, "runs": results}, sys.stdout, indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+
+# ===- expand-whens-bench.py - ExpandWhens scaling benchmark ---*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate decoder-like circuits with `when` statements nested N deep, run
+# firtool over each one and report the time spent in ExpandWhens as JSON.  The
+# time per connect should stay roughly constant as the depth grows.
+#
+# Usage: expand-whens-bench.py --firtool build/bin/firtool 100 200 400 800
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# Matches a line of the list display of -mlir-timing.
+TimingRegex = re.compile(r'^\s*(\d+\.\d+)\s+\(\s*[\d.]+%\)\s+(.*)$')
+
+
+def generate(depth, outputs):
+  """Return a module with `depth` nested whens, and its number of connects."""
+  lines = [
+      "circuit Top :", "  module Top :", "    input sel : UInt<32>",
+      "    input in : UInt<8>"
+  ]
+  for o in range(outputs):
+    lines.append("    output out_{} : UInt<8>".format(o))
+  lines.append("")
+  for o in range(outputs):
+    lines.append("    out_{} <= UInt<8>(0)".format(o))
+  connects = outputs
+
+  indent = "    "
+  for d in range(depth):
+    lines.append("{}when eq(sel, UInt<32>({})) :".format(indent, d))
+    lines.append("{}  out_{} <= in".format(indent, d % outputs))
+    lines.append("{}else :".format(indent))
+    lines.append("{}  out_{} <= UInt<8>({})".format(indent, (d + 1) % outputs,
+                                                    d % 256))
+    connects += 2
+    indent += "  "
+  return "\n".join(lines) + "\n", connects
+
+
+def expand_whens_time(output):
+  """Return the total time spent in ExpandWhens from -mlir-timing output."""
+  total = 0.0
+  for line in output.splitlines():
+    match = TimingRegex.match(line)
+    if match and match.group(2).strip() == "ExpandWhens":
+      total += float(match.group(1))
+  return total
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Check that ExpandWhens scales linearly with when depth.")
+  parser.add_argument("--firtool", default="firtool", help="firtool binary")
+  parser.add_argument("--outputs",
+                      type=int,
+                      default=16,
+                      help="Outputs driven by the nested whens")
+  parser.add_argument("depths",
+                      type=int,
+                      nargs="*",
+                      default=[100, 200, 400, 800],
+                      help="Nesting depths to measure")
+  args = parser.parse_args()
+
+  workdir = tempfile.mkdtemp(prefix="expand-whens-bench")
+  results = []
+  for depth in args.depths:
+    fir, connects = generate(depth, args.outputs)
+    fir_path = os.path.join(workdir, "nested-{}.fir".format(depth))
+    with open(fir_path, "w") as f:
+      f.write(fir)
+
+    cmd = [
+        args.firtool, fir_path, "-disable-opt", "-imconstprop=false",
+        "-disable-output", "-mlir-timing", "-mlir-timing-display=list"
+    ]
+    result = subprocess.run(cmd,
+                            stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT,
+                            universal_newlines=True)
+    if result.returncode != 0:
+      sys.stderr.write(result.stdout)
+      sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+      return 1
+
+    seconds = expand_whens_time(result.stdout)
+    results.append({
+        "depth": depth,
+        "connects": connects,
+        "expand_whens_sec": seconds,
+        "usec_per_connect": seconds * 1e6 / connects
+    })
+
+  json.dump(results, sys.stdout, indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+# ===- export-verilog-bench.py - Verilog emission benchmark ----*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate a design with many expression-heavy hw.modules, emit it with
+# -export-verilog and report the emission throughput in MB/s of Verilog as
+# JSON.  The time to parse the design, measured by running circt-opt over it,
+# is subtracted from the time spent in circt-translate.
+#
+# Usage: export-verilog-bench.py --bin build/bin --modules 100 --exprs 10000
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+Ops = ["add", "and", "or", "xor", "mul", "sub"]
+
+
+def generate_module(name, exprs):
+  """Return a module computing `exprs` chained expressions."""
+  lines = [
+      "hw.module @{}(%a: i32, %b: i32, %c: i1) -> (%x: i32, %y: i32) {{".format(
+          name)
+  ]
+  prev = ["%a", "%b"]
+  for i in range(exprs):
+    op = Ops[i % len(Ops)]
+    lines.append("  %e{} = comb.{} {}, {} : i32".format(i, op, prev[-1],
+                                                        prev[-2]))
+    # Every few expressions, use a value twice so it needs a temporary, and
+    # mux on it so the expression trees don't grow without bound.
+    if i % 4 == 3:
+      lines.append("  %m{0} = comb.mux %c, %e{0}, %e{1} : i32".format(
+          i, i - 1))
+      prev.append("%m{}".format(i))
+    else:
+      prev.append("%e{}".format(i))
+  lines.append("  hw.output {}, {} : i32, i32".format(prev[-1], prev[-2]))
+  lines.append("}")
+  return lines
+
+
+def time_command(cmd):
+  start = time.perf_counter()
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+  elapsed = time.perf_counter() - start
+  if result.returncode != 0:
+    sys.stderr.write(result.stdout)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+  return elapsed
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the Verilog emission throughput.")
+  parser.add_argument("--bin",
+                      default="",
+                      help="Directory containing circt-opt and circt-translate")
+  parser.add_argument("--modules",
+                      type=int,
+                      default=100,
+                      help="Number of modules")
+  parser.add_argument("--exprs",
+                      type=int,
+                      default=10000,
+                      help="Expressions in each module")
+  parser.add_argument("--runs",
+                      type=int,
+                      default=3,
+                      help="Number of runs, the fastest one is reported")
+  parser.add_argument("--disable-threading",
+                      action="store_true",
+                      help="Emit the modules on a single thread")
+  args = parser.parse_args()
+
+  lines = []
+  for i in range(args.modules):
+    lines += generate_module("Module{}".format(i), args.exprs)
+
+  workdir = tempfile.mkdtemp(prefix="export-verilog-bench")
+  mlir_path = os.path.join(workdir, "design.mlir")
+  verilog_path = os.path.join(workdir, "design.sv")
+  with open(mlir_path, "w") as f:
+    f.write("\n".join(lines) + "\n")
+
+  threading = ["-mlir-disable-threading"] if args.disable_threading else []
+  parse_cmd = [os.path.join(args.bin, "circt-opt"), mlir_path, "-o", os.devnull
+              ] + threading
+  emit_cmd = [
+      os.path.join(args.bin, "circt-translate"), mlir_path, "-export-verilog",
+      "-o", verilog_path
+  ] + threading
+
+  parse_times, emit_times = [], []
+  for _ in range(args.runs):
+    parse_time = time_command(parse_cmd)
+    emit_time = time_command(emit_cmd)
+    if parse_time is None or emit_time is None:
+      return 1
+    parse_times.append(parse_time)
+    emit_times.append(emit_time)
+
+  emitted_bytes = os.path.getsize(verilog_path)
+  emission_sec = max(min(emit_times) - min(parse_times), 1e-9)
+  json.dump(
+      {
+          "modules": args.modules,
+          "exprs_per_module": args.exprs,
+          "threaded": not args.disable_threading,
+          "verilog_bytes": emitted_bytes,
+          "parse_sec": min(parse_times),
+          "translate_sec": min(emit_times),
+          "emission_mb_per_sec": emitted_bytes / emission_sec / 1e6,
+      },
+      sys.stdout,
+      indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
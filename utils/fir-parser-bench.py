@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+
+# ===- fir-parser-bench.py - FIRRTL parser throughput benchmark -*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate a synthetic .fir circuit (and annotation file) of a configurable
+# size, run firtool's parser over it and report the time spent in each phase
+# of the parser as JSON.
+#
+# Usage: fir-parser-bench.py --firtool build/bin/firtool --modules 1000
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# Rough approximation of the FIRRTL lexer, used to report tokens per second.
+TokenRegex = re.compile(r'@\[[^\]]*\]|"[^"]*"|[A-Za-z_][A-Za-z0-9_$]*|'
+                        r'-?\d+|<=|<-|=>|\S')
+
+# Matches a line of the tree display of -mlir-timing.
+TimingRegex = re.compile(r'^\s*(\d+\.\d+)\s+\(\s*[\d.]+%\)(\s+)(.*)$')
+
+PeakRSSRegex = re.compile(r'Peak RSS: (\d+) MiB')
+
+
+def bundle_type(depth, width):
+  """Return a bundle type nested `depth` levels deep."""
+  ty = "UInt<{}>".format(width)
+  for _ in range(depth):
+    ty = "{{a : {}, b : UInt<{}>}}".format(ty, width)
+  return ty
+
+
+def generate(args):
+  """Generate the circuit and annotations, returning (fir, annos, stats)."""
+  width = args.width
+  wire_type = bundle_type(args.bundle_depth, width)
+  leaf = "w" + ".a" * args.bundle_depth
+  lines = ["circuit Top :"]
+  annos = []
+  statements = 0
+
+  for m in range(args.modules):
+    name = "Mod_{}".format(m)
+    lines.append("  module {} :".format(name))
+    lines.append("    input clock : Clock")
+    lines.append("    input in : UInt<{}>".format(width))
+    lines.append("    output out : UInt<{}>".format(width))
+    lines.append("")
+    lines.append("    wire w : {} @[Gen.scala {}:5]".format(wire_type, m))
+    lines.append("    {} <= in".format(leaf))
+    prev = leaf
+    for s in range(args.statements):
+      lines.append("    node n_{} = tail(add({}, UInt<{}>({})), 1) "
+                   "@[Gen.scala {}:{}]".format(s, prev, width, s % 256, m, s))
+      prev = "n_{}".format(s)
+    lines.append("    reg r : UInt<{}>, clock".format(width))
+    lines.append("    r <= {}".format(prev))
+    lines.append("    out <= r")
+    statements += args.statements + 4
+
+    for a in range(min(args.annotations, args.statements)):
+      annos.append({
+          "class": "firrtl.transforms.DontTouchAnnotation",
+          "target": "~Top|{}>n_{}".format(name, a)
+      })
+
+  lines.append("  module Top :")
+  lines.append("    input clock : Clock")
+  lines.append("    input in : UInt<{}>".format(width))
+  lines.append("    output out : UInt<{}>".format(width))
+  lines.append("")
+  prev = "in"
+  for m in range(args.modules):
+    lines.append("    inst m_{} of Mod_{}".format(m, m))
+    lines.append("    m_{}.clock <= clock".format(m))
+    lines.append("    m_{}.in <= {}".format(m, prev))
+    prev = "m_{}.out".format(m)
+  lines.append("    out <= {}".format(prev))
+  statements += 3 * args.modules + 1
+
+  fir = "\n".join(lines) + "\n"
+  stats = {
+      "bytes": len(fir),
+      "tokens": len(TokenRegex.findall(fir)),
+      "statements": statements,
+      "annotations": len(annos)
+  }
+  return fir, annos, stats
+
+
+def parse_timing(output):
+  """Extract the parser timers from the tree display of -mlir-timing."""
+  phases = {}
+  peak_rss = None
+  in_parser = False
+  parser_indent = 0
+  for line in output.splitlines():
+    match = PeakRSSRegex.search(line)
+    if match:
+      peak_rss = int(match.group(1))
+      continue
+    match = TimingRegex.match(line)
+    if not match:
+      continue
+    seconds, indent, name = float(match.group(1)), len(match.group(2)), \
+        match.group(3).strip()
+    if name == "FIR Parser":
+      phases["total"] = seconds
+      in_parser, parser_indent = True, indent
+    elif in_parser and indent > parser_indent:
+      phases[name] = seconds
+    else:
+      in_parser = False
+  return phases, peak_rss
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Benchmark the FIRRTL parser on a synthetic circuit.")
+  parser.add_argument("--firtool", default="firtool", help="firtool binary")
+  parser.add_argument("--modules", type=int, default=100)
+  parser.add_argument("--statements",
+                      type=int,
+                      default=100,
+                      help="Nodes in each module")
+  parser.add_argument("--bundle-depth", type=int, default=2)
+  parser.add_argument("--annotations",
+                      type=int,
+                      default=10,
+                      help="Annotations targeting each module")
+  parser.add_argument("--width", type=int, default=8)
+  parser.add_argument("--keep",
+                      metavar="DIR",
+                      help="Write the generated files to DIR")
+  parser.add_argument("firtool_args",
+                      nargs=argparse.REMAINDER,
+                      help="Extra arguments passed to firtool")
+  args = parser.parse_args()
+
+  fir, annos, stats = generate(args)
+
+  workdir = args.keep or tempfile.mkdtemp(prefix="fir-parser-bench")
+  os.makedirs(workdir, exist_ok=True)
+  fir_path = os.path.join(workdir, "bench.fir")
+  anno_path = os.path.join(workdir, "bench.anno.json")
+  with open(fir_path, "w") as f:
+    f.write(fir)
+  with open(anno_path, "w") as f:
+    json.dump(annos, f)
+
+  # Disable everything after the parser so that only it is measured.
+  cmd = [
+      args.firtool, fir_path, "-annotation-file=" + anno_path, "-disable-opt",
+      "-infer-widths=false", "-lower-types=false", "-imconstprop=false",
+      "-disable-output", "-mlir-timing", "-mlir-timing-display=tree"
+  ] + args.firtool_args
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stdout)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return 1
+
+  phases, peak_rss = parse_timing(result.stdout)
+  total = phases.get("total", 0.0)
+  report = {
+      "config": {
+          "modules": args.modules,
+          "statements": args.statements,
+          "bundle_depth": args.bundle_depth,
+          "annotations": args.annotations
+      },
+      "input": stats,
+      "phases": phases,
+      "peak_rss_mib": peak_rss,
+  }
+  if total > 0:
+    report["throughput"] = {
+        "bytes_per_sec": stats["bytes"] / total,
+        "tokens_per_sec": stats["tokens"] / total,
+        "ops_per_sec": stats["statements"] / total
+    }
+  json.dump(report, sys.stdout, indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,291 @@
+#!/usr/bin/env python3
+
+# ===- firtool-scaling-bench.py - firtool design size scaling --*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate parametric FIRRTL circuits at several scales, run the whole firtool
+# pipeline down to Verilog over each one and report the time and memory of
+# every pass as JSON.  For each pass, the growth exponent between consecutive
+# scales is reported as well: 1 means the pass scales linearly with the design
+# size, and passes growing faster than --superlinear are listed separately.
+#
+# The circuit is a tree of distinct modules `--depth` levels deep, each node
+# instantiating `--fanout` children.  Every port is a bundle of `--width`
+# fields, and each leaf holds `--logic` registers per unit of scale, updated
+# under `when` statements nested `--when-depth` deep, and `--memories`
+# memories.
+#
+# Usage: firtool-scaling-bench.py --firtool build/bin/firtool 1 2 4 8
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# Matches a line of the list display of -mlir-timing.  Multithreaded runs
+# print the user time before the wall time, only the last column is used.
+TimingRegex = re.compile(r'^\s*((?:\d+\.\d+\s+\(\s*[\d.]+%\)\s+)+)(.*)$')
+TimeRegex = re.compile(r'(\d+\.\d+)\s+\(')
+
+
+def bundle_type(width):
+  fields = ", ".join("a_{} : UInt<8>".format(i) for i in range(width))
+  return "{" + fields + "}"
+
+
+def generate_leaf(name, args, registers):
+  """Return a leaf module with `registers` registers and the memories."""
+  w = args.width
+  lines = [
+      "  module {} :".format(name), "    input clock : Clock",
+      "    input in : {}".format(bundle_type(w)),
+      "    output out : {}".format(bundle_type(w)), ""
+  ]
+  for r in range(registers):
+    lines.append("    reg r_{} : UInt<8>, clock".format(r))
+    indent = "    "
+    for d in range(args.when_depth):
+      lines.append("{}when bits(in.a_{}, {}, {}) :".format(
+          indent, (r + d) % w, d % 8, d % 8))
+      indent += "  "
+    prev = "r_{}".format(r - 1) if r else "in.a_0"
+    lines.append("{}r_{} <= tail(add({}, in.a_{}), 1)".format(
+        indent, r, prev, (r + 1) % w))
+
+  for m in range(args.memories):
+    lines += [
+        "    mem m_{} :".format(m), "      data-type => UInt<8>",
+        "      depth => 16", "      read-latency => 0",
+        "      write-latency => 1", "      reader => r", "      writer => w",
+        "      read-under-write => undefined",
+        "    m_{}.r.addr <= bits(in.a_{}, 3, 0)".format(m, m % w),
+        "    m_{}.r.en <= UInt<1>(1)".format(m),
+        "    m_{}.r.clk <= clock".format(m),
+        "    m_{}.w.addr <= bits(in.a_{}, 7, 4)".format(m, m % w),
+        "    m_{}.w.en <= UInt<1>(1)".format(m),
+        "    m_{}.w.clk <= clock".format(m),
+        "    m_{}.w.data <= in.a_{}".format(m, (m + 1) % w),
+        "    m_{}.w.mask <= UInt<1>(1)".format(m)
+    ]
+
+  for f in range(w):
+    value = "in.a_{}".format(f)
+    if registers:
+      value = "xor({}, r_{})".format(value, registers - 1 - f % registers)
+    if args.memories:
+      value = "xor({}, m_{}.r.data)".format(value, f % args.memories)
+    lines.append("    out.a_{} <= {}".format(f, value))
+  return lines
+
+
+def generate_node(name, args, children):
+  """Return a module instantiating the given child modules."""
+  w = args.width
+  lines = [
+      "  module {} :".format(name), "    input clock : Clock",
+      "    input in : {}".format(bundle_type(w)),
+      "    output out : {}".format(bundle_type(w)), ""
+  ]
+  for i, child in enumerate(children):
+    lines.append("    inst c_{} of {}".format(i, child))
+    lines.append("    c_{}.clock <= clock".format(i))
+    lines.append("    c_{}.in <= in".format(i))
+  for f in range(w):
+    value = "c_0.out.a_{}".format(f)
+    for i in range(1, len(children)):
+      value = "xor({}, c_{}.out.a_{})".format(value, i, f)
+    lines.append("    out.a_{} <= {}".format(f, value))
+  return lines
+
+
+def generate(args, scale):
+  """Return the text of the circuit at the given scale and its module count."""
+  modules = []
+  counter = [0]
+
+  def build(depth):
+    name = "M{}".format(counter[0])
+    counter[0] += 1
+    if depth == args.depth:
+      modules.append(generate_leaf(name, args, args.logic * scale))
+      return name
+    children = [build(depth + 1) for _ in range(args.fanout)]
+    modules.append(generate_node(name, args, children))
+    return name
+
+  top = build(0)
+  lines = ["circuit {} :".format(top)]
+  # FIRRTL requires the top module to be named after the circuit, and the
+  # order of the modules doesn't matter otherwise.
+  for module in reversed(modules):
+    lines += module
+    lines.append("")
+  return "\n".join(lines) + "\n", len(modules)
+
+
+def parse_timing(output):
+  """Return the wall time of each pass in the -mlir-timing list display."""
+  times = {}
+  for line in output.splitlines():
+    match = TimingRegex.match(line)
+    if not match:
+      continue
+    name = match.group(2).strip()
+    seconds = float(TimeRegex.findall(match.group(1))[-1])
+    times[name] = times.get(name, 0.0) + seconds
+  return times
+
+
+def parse_memory(path):
+  """Return the peak RSS and the RSS growth of each pass."""
+  with open(path) as f:
+    profile = json.load(f)
+  growth = {}
+  for entry in profile["passes"]:
+    # Only count the outermost passes, nested ones are contained in them.
+    if entry["depth"] != 0:
+      continue
+    delta = entry["rssAfter"] - entry["rssBefore"]
+    growth[entry["pass"]] = growth.get(entry["pass"], 0) + delta
+  return profile["peakRSS"], growth
+
+
+def run(args, workdir, scale):
+  text, num_modules = generate(args, scale)
+  fir_path = os.path.join(workdir, "scale{}.fir".format(scale))
+  memory_path = os.path.join(workdir, "scale{}.json".format(scale))
+  with open(fir_path, "w") as f:
+    f.write(text)
+
+  cmd = [
+      args.firtool, fir_path, "-verilog", "-o", os.devnull, "-mlir-timing",
+      "-mlir-timing-display=list", "-memory-profile=" + memory_path
+  ]
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stdout)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+
+  times = parse_timing(result.stdout)
+  peak_rss, rss_growth = parse_memory(memory_path)
+  total = times.pop("Total", 0.0)
+  return {
+      "scale": scale,
+      "modules": num_modules,
+      "fir_bytes": len(text),
+      "total_sec": total,
+      "peak_rss": peak_rss,
+      "pass_sec": times,
+      "pass_rss_growth": rss_growth,
+  }
+
+
+def growth_exponents(results, min_sec):
+  """Return the growth exponent of each pass between consecutive scales.
+
+  Passes taking less than `min_sec` at the smaller scale are too noisy to
+  tell anything and are left out.
+  """
+  exponents = {}
+  for smaller, larger in zip(results, results[1:]):
+    ratio = math.log(larger["scale"] / smaller["scale"])
+    for name, seconds in smaller["pass_sec"].items():
+      if seconds < min_sec or name not in larger["pass_sec"]:
+        continue
+      exponent = math.log(max(larger["pass_sec"][name], 1e-9) / seconds) / ratio
+      exponents.setdefault(name, []).append(round(exponent, 2))
+  return exponents
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure how each firtool pass scales with the design size.")
+  parser.add_argument("--firtool", default="firtool", help="firtool binary")
+  parser.add_argument("--depth",
+                      type=int,
+                      default=2,
+                      help="Levels of hierarchy below the top module")
+  parser.add_argument("--fanout",
+                      type=int,
+                      default=4,
+                      help="Children instantiated by each non-leaf module")
+  parser.add_argument("--width",
+                      type=int,
+                      default=8,
+                      help="Fields of the port bundles")
+  parser.add_argument("--logic",
+                      type=int,
+                      default=50,
+                      help="Registers in each leaf module per unit of scale")
+  parser.add_argument("--when-depth",
+                      type=int,
+                      default=3,
+                      help="Nesting depth of the whens updating the registers")
+  parser.add_argument("--memories",
+                      type=int,
+                      default=1,
+                      help="Memories in each leaf module")
+  parser.add_argument("--min-sec",
+                      type=float,
+                      default=0.01,
+                      help="Passes faster than this are left out of the "
+                      "growth exponents")
+  parser.add_argument("--superlinear",
+                      type=float,
+                      default=1.3,
+                      help="Growth exponent above which a pass is flagged")
+  parser.add_argument("scales",
+                      type=int,
+                      nargs="*",
+                      default=[1, 2, 4, 8],
+                      help="Multiples of --logic to measure")
+  args = parser.parse_args()
+
+  workdir = tempfile.mkdtemp(prefix="firtool-scaling-bench")
+  results = []
+  for scale in sorted(args.scales):
+    result = run(args, workdir, scale)
+    if result is None:
+      return 1
+    results.append(result)
+
+  exponents = growth_exponents(results, args.min_sec)
+  superlinear = sorted(name for name, values in exponents.items()
+                       if max(values) > args.superlinear)
+  json.dump(
+      {
+          "parameters": {
+              "depth": args.depth,
+              "fanout": args.fanout,
+              "width": args.width,
+              "logic": args.logic,
+              "when_depth": args.when_depth,
+              "memories": args.memories,
+          },
+          "runs": results,
+          "growth_exponents": exponents,
+          "superlinear": superlinear,
+      },
+      sys.stdout,
+      indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+
+# ===- hw-cleanup-bench.py - HW cleanup pass benchmark ---------*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate a design with many small hw.modules and a few huge ones, full of
+# always blocks and ifdefs to merge, run hw-cleanup and prettify-verilog over
+# it with and without threading and report the time spent in each pass as
+# JSON.  With threading, the wall time is bounded by the largest modules.
+#
+# Usage: hw-cleanup-bench.py --circt-opt build/bin/circt-opt --huge 2
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# Matches a line of the list display of -mlir-timing.
+TimingRegex = re.compile(r'^\s*(\d+\.\d+)\s+\(\s*[\d.]+%\)\s+(.*)$')
+
+# Matches the total time line of -mlir-timing.
+TotalRegex = re.compile(r'Total Execution Time:\s+(\d+\.\d+)')
+
+Passes = ["HWCleanup", "PrettifyVerilog"]
+
+
+def generate_module(name, blocks, clocks):
+  """Return a module with `blocks` always blocks spread over `clocks`."""
+  lines = [
+      "hw.module @{}(%clk: i{}, %a: i8) -> (%x: i8) {{".format(name, clocks)
+  ]
+  lines.append("  %c1_i8 = hw.constant 1 : i8")
+  for c in range(clocks):
+    lines.append("  %clk{0} = comb.extract %clk from {0} : (i{1}) -> i1".format(
+        c, clocks))
+  for b in range(blocks):
+    lines.append("  %r{} = sv.reg : !hw.inout<i8>".format(b))
+    lines.append("  sv.alwaysff(posedge %clk{}) {{".format(b % clocks))
+    lines.append("    sv.passign %r{}, %a : i8".format(b))
+    lines.append("  }")
+    lines.append("  sv.ifdef \"COND{}\" {{".format(b % clocks))
+    lines.append("    %rd{0} = sv.read_inout %r{0} : !hw.inout<i8>".format(b))
+    lines.append("    %sum{0} = comb.add %rd{0}, %c1_i8 : i8".format(b))
+    lines.append("    sv.assign %r{}, %sum{} : i8".format(b, b))
+    lines.append("  }")
+  lines.append("  hw.output %a : i8")
+  lines.append("}")
+  return lines
+
+
+def run(args, mlir_path, threaded):
+  cmd = [
+      args.circt_opt, mlir_path,
+      "-pass-pipeline=hw.module(hw-cleanup,prettify-verilog)", "-o",
+      os.devnull, "-mlir-timing", "-mlir-timing-display=list"
+  ]
+  if not threaded:
+    cmd.append("-mlir-disable-threading")
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stdout)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+
+  times = {"threaded": threaded, "total_sec": 0.0}
+  for line in result.stdout.splitlines():
+    match = TotalRegex.search(line)
+    if match:
+      times["total_sec"] = float(match.group(1))
+      continue
+    match = TimingRegex.match(line)
+    if match and match.group(2).strip() in Passes:
+      times[match.group(2).strip() + "_sec"] = float(match.group(1))
+  return times
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Time hw-cleanup and prettify-verilog on skewed designs.")
+  parser.add_argument("--circt-opt",
+                      default="circt-opt",
+                      help="circt-opt binary")
+  parser.add_argument("--small",
+                      type=int,
+                      default=200,
+                      help="Number of small modules")
+  parser.add_argument("--huge",
+                      type=int,
+                      default=2,
+                      help="Number of huge modules")
+  parser.add_argument("--blocks",
+                      type=int,
+                      default=20000,
+                      help="Always blocks in each huge module")
+  parser.add_argument("--clocks",
+                      type=int,
+                      default=8,
+                      help="Distinct clocks and ifdef conditions per module")
+  args = parser.parse_args()
+
+  lines = []
+  for i in range(args.huge):
+    lines += generate_module("Huge{}".format(i), args.blocks, args.clocks)
+  for i in range(args.small):
+    lines += generate_module("Small{}".format(i), args.clocks * 4,
+                             args.clocks)
+
+  workdir = tempfile.mkdtemp(prefix="hw-cleanup-bench")
+  mlir_path = os.path.join(workdir, "design.mlir")
+  with open(mlir_path, "w") as f:
+    f.write("\n".join(lines) + "\n")
+
+  results = []
+  for threaded in [False, True]:
+    times = run(args, mlir_path, threaded)
+    if times is None:
+      return 1
+    results.append(times)
+
+  json.dump(results, sys.stdout, indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
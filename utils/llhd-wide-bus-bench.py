@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+
+# ===- llhd-wide-bus-bench.py - LLHD wide datapath benchmark ---*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate LLHD designs driving a wide bus of bytes, sliced by `--lanes`
+# entities with static and dynamic slices, simulate them with llhd-sim for
+# several bus widths and report the time spent in the units as JSON.  The
+# bus is updated by a process every nanosecond, inserting a slice of half the
+# width.  With `--baseline`, a second llhd-sim binary is run over the same
+# designs, to compare the code generated by two builds.
+#
+# Usage: llhd-wide-bus-bench.py --llhd-sim build/bin/llhd-sim \
+#            --shared-libs build/lib/libcirct-llhd-signals-runtime-wrappers.so \
+#            16 64 256
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def generate(width, lanes):
+  """Return a design with a bus of `width` bytes and `lanes` slicers."""
+  half = width // 2
+  bus = "!llhd.array<{}xi8>".format(width)
+  slice_ty = "!llhd.array<{}xi8>".format(half)
+  quarter_ty = "!llhd.array<{}xi8>".format(width // 4)
+  lines = [
+      "llhd.entity @root () -> () {", "  %z = llhd.const 0 : i8",
+      "  %c0 = llhd.const 0 : i32",
+      "  %a = llhd.array_uniform %z : {}".format(bus),
+      "  %h = llhd.array_uniform %z : {}".format(slice_ty),
+      "  %bus = llhd.sig \"bus\" %a : {}".format(bus),
+      "  %idx = llhd.sig \"idx\" %c0 : i32",
+      "  llhd.inst \"gen\" @gen () -> (%bus, %idx) : () -> "
+      "(!llhd.sig<{}>, !llhd.sig<i32>)".format(bus)
+  ]
+  for lane in range(lanes):
+    lines += [
+        "  %out{} = llhd.sig \"out{}\" %h : {}".format(lane, lane, slice_ty),
+        "  llhd.inst \"slice{0}\" @slice (%bus, %idx) -> (%out{0}) : "
+        "(!llhd.sig<{1}>, !llhd.sig<i32>) -> (!llhd.sig<{2}>)".format(
+            lane, bus, slice_ty)
+    ]
+  lines += [
+      "}", "",
+      "llhd.proc @gen () -> (%bus : !llhd.sig<{}>, %idx : !llhd.sig<i32>) "
+      "{{".format(bus), "  br ^loop", "^loop:",
+      "  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time",
+      "  llhd.wait for %t, ^drive", "^drive:",
+      "  %i = llhd.prb %idx : !llhd.sig<i32>",
+      "  %b = llhd.prb %bus : !llhd.sig<{}>".format(bus),
+      "  %v = trunci %i : i32 to i8",
+      "  %u = llhd.array_uniform %v : {}".format(slice_ty),
+      "  %n = llhd.insert_slice %b, %u, {} : {}, {}".format(
+          half // 2, bus, slice_ty), "  %c1 = llhd.const 1 : i32",
+      "  %next = addi %i, %c1 : i32",
+      "  %e = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time",
+      "  llhd.drv %bus, %n after %e : !llhd.sig<{}>".format(bus),
+      "  llhd.drv %idx, %next after %e : !llhd.sig<i32>", "  br ^loop", "}",
+      "",
+      "llhd.entity @slice (%bus : !llhd.sig<{}>, %idx : !llhd.sig<i32>) -> "
+      "(%out : !llhd.sig<{}>) {{".format(bus, slice_ty),
+      "  %b = llhd.prb %bus : !llhd.sig<{}>".format(bus),
+      "  %i = llhd.prb %idx : !llhd.sig<i32>",
+      "  %mask = llhd.const {} : i32".format(width - 1),
+      "  %start = llhd.and %i, %mask : i32",
+      "  %d = llhd.dyn_extract_slice %b, %start : ({}, i32) -> {}".format(
+          bus, slice_ty),
+      "  %s = llhd.extract_slice %b, {} : {} -> {}".format(
+          half, bus, quarter_ty),
+      "  %x = llhd.insert_slice %d, %s, 0 : {}, {}".format(
+          slice_ty, quarter_ty),
+      "  %e = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time",
+      "  llhd.drv %out, %x after %e : !llhd.sig<{}>".format(slice_ty), "}"
+  ]
+  return "\n".join(lines) + "\n"
+
+
+def run(llhd_sim, args, mlir_path, stats_path):
+  cmd = [
+      llhd_sim, mlir_path, "-T",
+      str(args.cycles * 1000), "-trace-format=no-trace",
+      "-sim-stats-json=" + stats_path
+  ]
+  if args.shared_libs:
+    cmd.append("-shared-libs=" + args.shared_libs)
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stdout)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+  with open(stats_path) as f:
+    stats = json.load(f)
+  return {
+      "total_sec": stats["totalSeconds"],
+      "unit_sec": stats["unitSeconds"],
+      "activations": stats["activations"],
+  }
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the simulation speed of wide array datapaths.")
+  parser.add_argument("--llhd-sim", default="llhd-sim", help="llhd-sim binary")
+  parser.add_argument("--baseline",
+                      default="",
+                      help="llhd-sim binary to compare against")
+  parser.add_argument("--shared-libs",
+                      default="",
+                      help="Path to the llhd signals runtime wrappers")
+  parser.add_argument("--lanes",
+                      type=int,
+                      default=16,
+                      help="Entities slicing the bus")
+  parser.add_argument("--cycles",
+                      type=int,
+                      default=10000,
+                      help="Nanoseconds to simulate, one bus update each")
+  parser.add_argument("widths",
+                      type=int,
+                      nargs="*",
+                      default=[16, 64, 256],
+                      help="Bus widths in bytes, multiples of four")
+  args = parser.parse_args()
+
+  workdir = tempfile.mkdtemp(prefix="llhd-wide-bus-bench")
+  results = []
+  for width in args.widths:
+    mlir_path = os.path.join(workdir, "bus{}.mlir".format(width))
+    stats_path = os.path.join(workdir, "bus{}.json".format(width))
+    with open(mlir_path, "w") as f:
+      f.write(generate(width, args.lanes))
+
+    result = {"width": width}
+    for name, binary in [("current", args.llhd_sim),
+                         ("baseline", args.baseline)]:
+      if not binary:
+        continue
+      times = run(binary, args, mlir_path, stats_path)
+      if times is None:
+        return 1
+      result[name] = times
+    if "baseline" in result:
+      result["unit_speedup"] = result["baseline"]["unit_sec"] / max(
+          result["current"]["unit_sec"], 1e-9)
+    results.append(result)
+
+  json.dump(
+      {
+          "lanes": args.lanes,
+          "cycles": args.cycles,
+          "runs": results,
+      },
+      sys.stdout,
+      indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+
+# ===- scheduling-bench.py - Scheduling library benchmark ------*- python -*-//
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+# ===---------------------------------------------------------------------===//
+#
+# Generate random dataflow graphs of several sizes, acyclic ones and ones with
+# loop-carried dependences, and run -test-scheduling-benchmark over them.  It
+# times the problem construction, check, scheduling and verification of every
+# scheduler on each function, and reports them as JSON together with the
+# achieved latency and initiation interval.  Additional MLIR files, e.g. the
+# inputs of the StandardToHandshake and StandardToStaticLogic tests, can be
+# given to benchmark the first block of each of their functions.  Schedulers
+# failing on a graph, like the acyclic ones on cyclic graphs, report the
+# failing phase instead.
+#
+# Usage: scheduling-bench.py --circt-opt build/bin/circt-opt \
+#            --sizes 100 1000 test/Conversion/StandardToStaticLogic/*.mlir
+#
+# ===---------------------------------------------------------------------===//
+
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+# Operator types shared by all generated graphs: name, latency and limit.
+OperatorTypes = [("add", 1, None), ("mul", 3, 2), ("mem", 2, 1)]
+
+
+def generate_function(name, size, back_edges, window, rng):
+  """Return a function of `size` operations with `back_edges` loop-carried
+  dependences, each operation using values from the `window` before it."""
+  types = []
+  for opr, latency, limit in OperatorTypes:
+    entry = "{{ name = \"{}\", latency = {}".format(opr, latency)
+    if limit is not None:
+      entry += ", limit = {}".format(limit)
+    types.append(entry + " }")
+
+  auxdeps = []
+  for _ in range(back_edges):
+    src = rng.randrange(1, size)
+    dst = rng.randrange(max(0, src - window), src)
+    auxdeps.append("[{}, {}, {}]".format(src, dst, rng.randint(1, 3)))
+
+  lines = [
+      "func @{}(%a : i32, %b : i32) -> i32 attributes {{".format(name),
+      "  operatortypes = [ {} ],".format(", ".join(types)),
+      "  auxdeps = [ {} ]".format(", ".join(auxdeps)), "  } {"
+  ]
+  for i in range(size):
+    operands = []
+    for _ in range(rng.randint(1, 2)):
+      if i == 0:
+        operands.append(rng.choice(["%a", "%b"]))
+      else:
+        operands.append("%v{}".format(rng.randrange(max(0, i - window), i)))
+    opr = rng.choice(OperatorTypes)[0]
+    lines.append("  %v{} = \"bench.op\"({}) {{ opr = \"{}\" }} : ({}) -> i32".
+                 format(i, ", ".join(operands), opr,
+                        ", ".join(["i32"] * len(operands))))
+  lines.append("  return %v{} : i32".format(size - 1))
+  lines.append("}")
+  return lines
+
+
+def run(args, mlir_path):
+  """Return the reports of all functions in `mlir_path`."""
+  cmd = [
+      args.circt_opt, mlir_path, "-allow-unregistered-dialect",
+      "-mlir-disable-threading",
+      "-test-scheduling-benchmark=simplex-max-ops={}".format(
+          args.simplex_max_ops), "-o", os.devnull
+  ]
+  result = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.stderr.write(result.stderr)
+    sys.stderr.write("error: '{}' failed\n".format(" ".join(cmd)))
+    return None
+  return [json.loads(line) for line in result.stdout.splitlines() if line]
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the speed and quality of the schedulers.")
+  parser.add_argument("--circt-opt",
+                      default="circt-opt",
+                      help="circt-opt binary")
+  parser.add_argument("--sizes",
+                      type=int,
+                      nargs="+",
+                      default=[100, 1000, 5000],
+                      help="Operations in the generated graphs")
+  parser.add_argument("--window",
+                      type=int,
+                      default=20,
+                      help="Distance within which operations use each other")
+  parser.add_argument("--back-edges",
+                      type=float,
+                      default=0.05,
+                      help="Loop-carried dependences per operation in the "
+                      "cyclic graphs")
+  parser.add_argument("--simplex-max-ops",
+                      type=int,
+                      default=200,
+                      help="Largest function to run the simplex scheduler on")
+  parser.add_argument("--seed", type=int, default=0, help="Random seed")
+  parser.add_argument("inputs",
+                      nargs="*",
+                      help="Additional MLIR files to benchmark")
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  lines = []
+  for size in args.sizes:
+    lines += generate_function("dag_{}".format(size), size, 0, args.window,
+                               rng)
+    lines += generate_function("cyclic_{}".format(size), size,
+                               max(1, int(size * args.back_edges)),
+                               args.window, rng)
+
+  workdir = tempfile.mkdtemp(prefix="scheduling-bench")
+  generated = os.path.join(workdir, "graphs.mlir")
+  with open(generated, "w") as f:
+    f.write("\n".join(lines) + "\n")
+
+  runs = []
+  for path in [generated] + args.inputs:
+    functions = run(args, path)
+    if functions is None:
+      return 1
+    runs.append({"input": path, "functions": functions})
+
+  json.dump(
+      {
+          "parameters": {
+              "sizes": args.sizes,
+              "window": args.window,
+              "back_edges": args.back_edges,
+              "seed": args.seed,
+          },
+          "runs": runs,
+      },
+      sys.stdout,
+      indent=2)
+  sys.stdout.write("\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())